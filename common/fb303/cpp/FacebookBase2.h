@@ -11,7 +11,11 @@
 
 #include <time.h>
 
+#include <map>
+#include <string>
+
 #include <common/fb303/if/gen-cpp2/FacebookService.h>
+#include "common/stats/ServiceData.h"
 
 namespace folly {
 class EventBaseManager;
@@ -32,6 +36,10 @@ public:
     // crude implementation because QsfpCache depends on it
     return (uint64_t) startTime;
   }
+
+  void getCounters(std::map<std::string, int64_t>& _return) override {
+    fbData->getCounters(_return);
+  }
 };
 
 }}
@@ -0,0 +1,98 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "common/stats/ExportedHistogramMap.h"
+
+#include <folly/Conv.h>
+#include <vector>
+
+namespace facebook { namespace stats {
+
+ExportedHistogramMap::LockAndHistogram
+ExportedHistogramMap::getOrCreateLockAndHistogram(
+    folly::StringPiece name, const ExportedHistogram* copyMe,
+    bool* createdPtr) {
+  if (createdPtr) {
+    *createdPtr = false;
+  }
+  if (auto entry = find(name)) {
+    return entry->item;
+  }
+  if (!copyMe) {
+    return LockAndHistogram();
+  }
+
+  auto histograms = histograms_.wlock();
+  auto& slot = (*histograms)[name.str()];
+  if (!slot) {
+    slot = std::make_shared<Entry>();
+    slot->item.first = std::make_shared<SpinLock>();
+    slot->item.second = std::make_shared<ExportedHistogram>(*copyMe);
+    if (createdPtr) {
+      *createdPtr = true;
+    }
+  }
+  return slot->item;
+}
+
+bool ExportedHistogramMap::exportStat(folly::StringPiece name,
+                                      ExportType type) {
+  auto entry = find(name);
+  if (!entry) {
+    return false;
+  }
+  entry->exports.fetch_or(detail::exportBit(type), std::memory_order_relaxed);
+  return true;
+}
+
+bool ExportedHistogramMap::exportPercentile(folly::StringPiece name,
+                                            int percentile) {
+  auto entry = find(name);
+  if (!entry) {
+    return false;
+  }
+  std::lock_guard<SpinLock> g(*entry->item.first);
+  entry->percentiles.insert(percentile);
+  return true;
+}
+
+void ExportedHistogramMap::getCounters(std::map<std::string, int64_t>& out,
+                                       StatsTimePoint now) const {
+  std::vector<std::pair<std::string, std::shared_ptr<Entry>>> entries;
+  {
+    auto histograms = histograms_.rlock();
+    entries.assign(histograms->begin(), histograms->end());
+  }
+  for (const auto& entry : entries) {
+    auto mask = entry.second->exports.load(std::memory_order_relaxed);
+    const auto& item = entry.second->item;
+    std::lock_guard<SpinLock> g(*item.first);
+    if (!mask && entry.second->percentiles.empty()) {
+      continue;
+    }
+    item.second->update(now);
+    detail::exportSeries(entry.first, *item.second, mask, out);
+    for (auto pct : entry.second->percentiles) {
+      auto suffix = folly::to<std::string>("p", pct);
+      for (size_t level = 0; level < kNumStatLevels; ++level) {
+        out[detail::exportedName(entry.first, suffix, level)] =
+            item.second->getPercentileEstimate(pct, level);
+      }
+    }
+  }
+}
+
+std::shared_ptr<ExportedHistogramMap::Entry> ExportedHistogramMap::find(
+    folly::StringPiece name) const {
+  auto histograms = histograms_.rlock();
+  auto it = histograms->find(name.str());
+  return it == histograms->end() ? nullptr : it->second;
+}
+
+}}
@@ -9,50 +9,124 @@
  */
 #pragma once
 
+#include <folly/stats/Histogram.h>
+#include <folly/stats/TimeseriesHistogram.h>
+#include <set>
+
 #include "common/stats/ExportedStatMap.h"
 
 namespace facebook { namespace stats {
 
-class ExportedHistogram {
-public:
-  ExportedHistogram() {}
-  ExportedHistogram(int, int, size_t) {}
-  void addValue(std::chrono::seconds, int, int64_t) {}
-  int numLevels() {return 1;}
-  int sum(int numLevels) {return 0;}
+/*
+ * A histogram kept over the windows in kStatLevels.
+ */
+class ExportedHistogram : public folly::TimeseriesHistogram<int64_t> {
+ public:
+  ExportedHistogram(int64_t bucketWidth, int64_t min, int64_t max)
+      : folly::TimeseriesHistogram<int64_t>(
+            bucketWidth, min, max,
+            folly::MultiLevelTimeSeries<int64_t>(
+                kNumStatBuckets, kNumStatLevels, kStatLevels)) {}
+
+  using folly::TimeseriesHistogram<int64_t>::addValue;
+  void addValue(std::chrono::seconds now, int64_t value, int64_t times = 1) {
+    addValue(StatsTimePoint(now), value, times);
+  }
+  void addValue(std::chrono::seconds::rep now, int64_t value,
+                int64_t times = 1) {
+    addValue(std::chrono::seconds(now), value, times);
+  }
 };
 
+/*
+ * The registry of histograms, exported by getCounters() as the export
+ * types and percentiles asked for with exportStat() and exportPercentile().
+ * It is locked the same way as ExportedStatMap.
+ */
 class ExportedHistogramMap {
-public:
-  class SpinLockGuard {
-      /* no op */
-  };
+ public:
+  using SpinLockGuard = std::unique_lock<SpinLock>;
 
   struct LockAndHistogram {
     std::shared_ptr<SpinLock> first;
     std::shared_ptr<ExportedHistogram> second;
   };
 
-  LockAndHistogram getOrCreateLockAndHistogram(folly::StringPiece,
-                                                const ExportedHistogram*,
-                                                bool* createdPtr = nullptr) {
-    if (createdPtr) *createdPtr = true;
-    return LockAndHistogram();
-  }
+  /*
+   * Find a histogram, or create it as a copy of copyMe.  Returns an empty
+   * LockAndHistogram when there is no such histogram and copyMe is null.
+   */
+  LockAndHistogram getOrCreateLockAndHistogram(folly::StringPiece name,
+                                               const ExportedHistogram* copyMe,
+                                               bool* createdPtr = nullptr);
 
-  struct LockableHistogram : public ExportedHistogram {
-    SpinLockGuard makeLockGuard() {return SpinLockGuard();}
-    void addValueLocked(SpinLockGuard&, std::chrono::seconds::rep, int, uint64_t) {}
-  };
+  /*
+   * A handle on a histogram that takes its lock for each update, or only
+   * once for a run of addValueLocked() calls.  A default constructed one
+   * ignores its values.
+   */
+  struct LockableHistogram {
+    LockableHistogram() {}
+    explicit LockableHistogram(LockAndHistogram item)
+        : item_(std::move(item)) {}
 
-  LockableHistogram getOrCreateLockableHistogram(folly::StringPiece,
-                                                const ExportedHistogram*,
-                                                bool* createdPtr = nullptr) {
-    if (createdPtr) {
-        *createdPtr = true;
+    SpinLockGuard makeLockGuard() {
+      return item_.first ? SpinLockGuard(*item_.first) : SpinLockGuard();
+    }
+    void addValueLocked(SpinLockGuard& /*guard*/, std::chrono::seconds::rep now,
+                        int64_t value, int64_t times = 1) {
+      if (item_.second) {
+        item_.second->addValue(now, value, times);
+      }
     }
-    return LockableHistogram();
+    void addValue(std::chrono::seconds::rep now, int64_t value,
+                  int64_t times = 1) {
+      auto guard = makeLockGuard();
+      addValueLocked(guard, now, value, times);
+    }
+    void addValues(StatsTimePoint now,
+                   const folly::Histogram<int64_t>& values) {
+      if (item_.second) {
+        auto guard = makeLockGuard();
+        item_.second->addValues(now, values);
+      }
+    }
+
+   private:
+    LockAndHistogram item_;
+  };
+
+  LockableHistogram getOrCreateLockableHistogram(
+      folly::StringPiece name, const ExportedHistogram* copyMe,
+      bool* createdPtr = nullptr) {
+    return LockableHistogram(
+        getOrCreateLockAndHistogram(name, copyMe, createdPtr));
   }
+
+  /*
+   * Export a histogram that already exists.  Return false if it doesn't.
+   */
+  bool exportStat(folly::StringPiece name, ExportType type);
+  bool exportPercentile(folly::StringPiece name, int percentile);
+
+  /*
+   * Add the exported values of every histogram, as of now, to out.
+   */
+  void getCounters(std::map<std::string, int64_t>& out,
+                   StatsTimePoint now) const;
+
+ private:
+  struct Entry {
+    LockAndHistogram item;
+    std::atomic<detail::ExportMask> exports{0};
+    // Under the lock of the histogram
+    std::set<int> percentiles;
+  };
+
+  std::shared_ptr<Entry> find(folly::StringPiece name) const;
+
+  folly::Synchronized<std::unordered_map<std::string, std::shared_ptr<Entry>>>
+    histograms_;
 };
 
 }}
@@ -0,0 +1,92 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "common/stats/ExportedStatMap.h"
+
+#include <folly/Conv.h>
+#include <vector>
+
+namespace facebook { namespace stats {
+
+namespace detail {
+
+std::string exportedName(folly::StringPiece stat, folly::StringPiece suffix,
+                         size_t level) {
+  if (kStatLevels[level].count() == 0) {
+    return folly::to<std::string>(stat, ".", suffix);
+  }
+  return folly::to<std::string>(
+      stat, ".", suffix, ".", kStatLevels[level].count());
+}
+
+const char* exportTypeName(ExportType type) {
+  switch (type) {
+    case SUM:
+      return "sum";
+    case COUNT:
+      return "count";
+    case AVG:
+      return "avg";
+    case RATE:
+      return "rate";
+    case PERCENT:
+      return "pct";
+  }
+  return "unknown";
+}
+
+}
+
+ExportedStatMap::LockAndStatItem ExportedStatMap::getLockAndStatItem(
+    folly::StringPiece name, const ExportType* type) {
+  std::shared_ptr<Entry> entry;
+  {
+    auto stats = stats_.rlock();
+    auto it = stats->find(name.str());
+    if (it != stats->end()) {
+      entry = it->second;
+    }
+  }
+  if (!entry) {
+    auto stats = stats_.wlock();
+    auto& slot = (*stats)[name.str()];
+    if (!slot) {
+      slot = std::make_shared<Entry>();
+      slot->item.first = std::make_shared<SpinLock>();
+      slot->item.second = std::make_shared<ExportedStat>();
+    }
+    entry = slot;
+  }
+  if (type) {
+    entry->exports.fetch_or(detail::exportBit(*type),
+                            std::memory_order_relaxed);
+  }
+  return entry->item;
+}
+
+void ExportedStatMap::getCounters(std::map<std::string, int64_t>& out,
+                                  StatsTimePoint now) const {
+  std::vector<std::pair<std::string, std::shared_ptr<Entry>>> entries;
+  {
+    auto stats = stats_.rlock();
+    entries.assign(stats->begin(), stats->end());
+  }
+  for (const auto& entry : entries) {
+    auto mask = entry.second->exports.load(std::memory_order_relaxed);
+    if (!mask) {
+      continue;
+    }
+    const auto& item = entry.second->item;
+    std::lock_guard<SpinLock> g(*item.first);
+    item.second->update(now);
+    detail::exportSeries(entry.first, *item.second, mask, out);
+  }
+}
+
+}}
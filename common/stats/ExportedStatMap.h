@@ -10,62 +10,237 @@
 #pragma once
 
 #include <folly/Range.h>
+#include <folly/SpinLock.h>
+#include <folly/Synchronized.h>
+#include <folly/stats/MultiLevelTimeSeries.h>
+#include <atomic>
 #include <chrono>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
 
 #include "common/stats/ExportType.h"
 
 namespace facebook {
 
 class SpinLock {
+ public:
+  void lock() {
+    lock_.lock();
+  }
+  void unlock() {
+    lock_.unlock();
+  }
+
+ private:
+  folly::SpinLock lock_;
 };
 
 class SpinLockHolder {
-public:
-  explicit SpinLockHolder(SpinLock*) {}
+ public:
+  explicit SpinLockHolder(SpinLock* lock) : guard_(*lock) {}
+
+ private:
+  std::lock_guard<SpinLock> guard_;
 };
 
 namespace stats {
 
-struct ExportedStat {
-  void addValue(std::chrono::seconds, int64_t) {}
-  void addValue(std::chrono::seconds::rep, uint64_t) {}
-  void addValueLocked(std::chrono::seconds::rep, uint64_t) {}
-  int numLevels() {return 1;}
-  int getSum(int level) {return 0;}
-  int sum(int level) {return 0;}
+/*
+ * The windows every stat is kept over, the last being all time.
+ */
+constexpr std::chrono::seconds kStatLevels[] = {
+    std::chrono::seconds{60},
+    std::chrono::seconds{600},
+    std::chrono::seconds{3600},
+    std::chrono::seconds{0},
+};
+constexpr size_t kNumStatLevels = sizeof(kStatLevels) / sizeof(kStatLevels[0]);
+constexpr size_t kNumStatBuckets = 60;
+
+using StatsTimePoint = folly::MultiLevelTimeSeries<int64_t>::TimePoint;
+
+/*
+ * The time stats are bucketed by.  This is the wall clock in seconds, the
+ * same time the hardware stats are sampled at, so values from any caller
+ * land in the same buckets.
+ */
+inline StatsTimePoint statsNow() {
+  return StatsTimePoint(std::chrono::duration_cast<std::chrono::seconds>(
+      std::chrono::system_clock::now().time_since_epoch()));
+}
+
+namespace detail {
+
+// The counter a stat is exported as, e.g. "trapped.pkts.rate.60", or with
+// no window for all time, e.g. "trapped.pkts.sum"
+std::string exportedName(folly::StringPiece stat, folly::StringPiece suffix,
+                         size_t level);
+const char* exportTypeName(ExportType type);
+
+using ExportMask = uint32_t;
+inline ExportMask exportBit(ExportType type) {
+  return ExportMask(1) << type;
+}
+
+// Export every type in the mask, at every level, of a timeseries or of a
+// histogram
+template <typename Series>
+void exportSeries(folly::StringPiece name, const Series& series,
+                  ExportMask mask, std::map<std::string, int64_t>& out) {
+  for (size_t level = 0; level < kNumStatLevels; ++level) {
+    for (auto type : {SUM, COUNT, AVG, RATE, PERCENT}) {
+      if (!(mask & exportBit(type))) {
+        continue;
+      }
+      int64_t value = 0;
+      switch (type) {
+        case SUM:
+          value = series.sum(level);
+          break;
+        case COUNT:
+          value = series.count(level);
+          break;
+        case AVG:
+          value = series.template avg<int64_t>(level);
+          break;
+        case RATE:
+          value = series.template rate<int64_t>(level);
+          break;
+        case PERCENT:
+          value = series.template avg<double>(level) * 100;
+          break;
+      }
+      out[exportedName(name, exportTypeName(type), level)] = value;
+    }
+  }
+}
+
+}
+
+/*
+ * A value kept over the windows in kStatLevels.  Times may be given as
+ * seconds, or as a plain count of seconds.
+ */
+class ExportedStat : public folly::MultiLevelTimeSeries<int64_t> {
+ public:
+  ExportedStat()
+      : folly::MultiLevelTimeSeries<int64_t>(
+            kNumStatBuckets, kNumStatLevels, kStatLevels) {}
+
+  using folly::MultiLevelTimeSeries<int64_t>::addValue;
+  void addValue(std::chrono::seconds now, int64_t value) {
+    addValue(StatsTimePoint(now), value);
+  }
+  void addValue(std::chrono::seconds::rep now, int64_t value) {
+    addValue(std::chrono::seconds(now), value);
+  }
+  void addValueLocked(std::chrono::seconds::rep now, int64_t value) {
+    addValue(now, value);
+  }
+  int64_t getSum(int level) const {
+    return sum(level);
+  }
 };
 
+/*
+ * The registry of stats, each exported as a counter per export type and
+ * level by getCounters().
+ *
+ * Every stat has a lock of its own.  The registry itself is only locked
+ * exclusively to add a stat, so finding one only contends with other
+ * readers, and the export types are a mask that is updated atomically.
+ */
 class ExportedStatMap {
-public:
+ public:
   class LockAndStatItem {
   public:
     std::shared_ptr<SpinLock> first;
     std::shared_ptr<ExportedStat> second;
   };
-  LockAndStatItem getLockAndStatItem(folly::StringPiece,
-                                     const ExportType* = nullptr) {
-    static LockAndStatItem it = {
-      std::make_shared<SpinLock>(), std::make_shared<ExportedStat>()
-    };
-    return it;
-  }
 
-  class LockableStat : public ExportedStat {
+  /*
+   * A handle on a stat that takes its lock for each value added.  A default
+   * constructed one ignores its values.
+   */
+  class LockableStat {
+   public:
+    LockableStat() {}
+    explicit LockableStat(LockAndStatItem item) : item_(std::move(item)) {}
+
+    template <typename Time>
+    void addValue(Time now, int64_t value) {
+      if (item_.second) {
+        std::lock_guard<SpinLock> g(*item_.first);
+        item_.second->addValue(now, value);
+      }
+    }
+    void addValueAggregated(StatsTimePoint now, int64_t sum, int64_t count) {
+      if (item_.second) {
+        std::lock_guard<SpinLock> g(*item_.first);
+        item_.second->addValueAggregated(now, sum, count);
+      }
+    }
+
+   private:
+    LockAndStatItem item_;
   };
 
-  LockableStat getLockableStat(folly::StringPiece,
-                               const ExportType* = nullptr) {
-    static LockableStat stat;
-    return stat;
-  }
+  /*
+   * A stat, locked for as long as this is held.
+   */
+  class LockedStatPtr {
+   public:
+    explicit LockedStatPtr(const LockAndStatItem& item)
+        : guard_(*item.first), stat_(item.second) {}
 
-  std::shared_ptr<ExportedStat> getLockedStatPtr(folly::StringPiece name) {
-      return std::make_shared<ExportedStat>();
-  }
+    ExportedStat* operator->() const {
+      return stat_.get();
+    }
+    ExportedStat& operator*() const {
+      return *stat_;
+    }
+
+   private:
+    std::unique_lock<SpinLock> guard_;
+    std::shared_ptr<ExportedStat> stat_;
+  };
 
+  /*
+   * Find or create a stat, and add the export type to it, if one is given.
+   */
+  LockAndStatItem getLockAndStatItem(folly::StringPiece name,
+                                     const ExportType* type = nullptr);
+  LockableStat getLockableStat(folly::StringPiece name,
+                               const ExportType* type = nullptr) {
+    return LockableStat(getLockAndStatItem(name, type));
+  }
+  LockedStatPtr getLockedStatPtr(folly::StringPiece name) {
+    return LockedStatPtr(getLockAndStatItem(name));
+  }
   std::shared_ptr<ExportedStat> getStatPtr(folly::StringPiece name) {
-      return std::make_shared<ExportedStat>();
+    return getLockAndStatItem(name).second;
   }
+  void exportStat(folly::StringPiece name, ExportType type) {
+    getLockAndStatItem(name, &type);
+  }
+
+  /*
+   * Add the exported values of every stat, as of now, to out.
+   */
+  void getCounters(std::map<std::string, int64_t>& out,
+                   StatsTimePoint now) const;
+
+ private:
+  struct Entry {
+    LockAndStatItem item;
+    std::atomic<detail::ExportMask> exports{0};
+  };
+
+  folly::Synchronized<std::unordered_map<std::string, std::shared_ptr<Entry>>>
+    stats_;
 };
 
 }}
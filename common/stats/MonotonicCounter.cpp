@@ -0,0 +1,41 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "common/stats/MonotonicCounter.h"
+
+#include <utility>
+
+#include "common/stats/ServiceData.h"
+
+namespace facebook { namespace stats {
+
+MonotonicCounter::MonotonicCounter(
+    folly::StringPiece name, ExportType type1, ExportType type2)
+    : name_(name.str()) {
+  auto statMap = fbData->getStatMap();
+  statMap->exportStat(name, type1);
+  stat_ = statMap->getLockableStat(name, &type2);
+}
+
+void MonotonicCounter::updateValue(std::chrono::seconds now, int64_t value) {
+  if (hasPrev_) {
+    stat_.addValue(now, value >= prev_ ? value - prev_ : value);
+  }
+  hasPrev_ = true;
+  prev_ = value;
+}
+
+void MonotonicCounter::swap(MonotonicCounter& counter) {
+  std::swap(name_, counter.name_);
+  std::swap(stat_, counter.stat_);
+  std::swap(hasPrev_, counter.hasPrev_);
+  std::swap(prev_, counter.prev_);
+}
+
+}}
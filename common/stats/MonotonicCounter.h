@@ -14,11 +14,31 @@
 
 namespace facebook { namespace stats {
 
+/*
+ * Tracks a counter that only ever increases, such as a hardware packet
+ * counter, by adding the increase between samples to the ServiceData stat
+ * of the same name, so the stat exports its sum and rate.
+ *
+ * The first sample is only a baseline.  A sample lower than the last one
+ * means the counter was reset, and is taken as the increase since then.
+ */
 class MonotonicCounter {
 public:
-  MonotonicCounter(folly::StringPiece, ExportType, ExportType) {}
-  void updateValue(std::chrono::seconds, int64_t) {}
-  void swap(MonotonicCounter& counter) {}
+  MonotonicCounter(folly::StringPiece name, ExportType type1,
+                   ExportType type2);
+
+  void updateValue(std::chrono::seconds now, int64_t value);
+  void swap(MonotonicCounter& counter);
+
+  const std::string& getName() const {
+    return name_;
+  }
+
+private:
+  std::string name_;
+  ExportedStatMap::LockableStat stat_;
+  bool hasPrev_{false};
+  int64_t prev_{0};
 };
 
 }}
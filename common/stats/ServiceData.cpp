@@ -9,6 +9,8 @@
  */
 #include "common/stats/ServiceData.h"
 
+#include <utility>
+
 static facebook::stats::ServiceData payload;
 
 namespace facebook {
@@ -17,6 +19,77 @@ namespace stats {
 ServiceData* ServiceData::get() {
   return &payload;
 }
+
+std::map<std::string, int64_t> ServiceData::getCounters() const {
+  std::map<std::string, int64_t> out;
+  getCounters(out);
+  return out;
+}
+
+void ServiceData::getCounters(std::map<std::string, int64_t>& out) const {
+  {
+    auto counters = counters_.rlock();
+    for (const auto& counter : *counters) {
+      out[counter.first] = counter.second->load(std::memory_order_relaxed);
+    }
+  }
+  auto now = statsNow();
+  statMap_.getCounters(out, now);
+  histogramMap_.getCounters(out, now);
+}
+
+int64_t ServiceData::getCounter(folly::StringPiece key) const {
+  {
+    auto counters = counters_.rlock();
+    auto it = counters->find(key.str());
+    if (it != counters->end()) {
+      return it->second->load(std::memory_order_relaxed);
+    }
+  }
+  // Only the exported stats are left, which are computed all together
+  auto all = getCounters();
+  auto it = all.find(key.str());
+  return it == all.end() ? 0 : it->second;
+}
+
+int64_t ServiceData::clearCounter(folly::StringPiece key) {
+  return counters_.wlock()->erase(key.str());
+}
+
+void ServiceData::setCounter(folly::StringPiece key, int64_t value) {
+  auto name = key.str();
+  {
+    auto counters = counters_.rlock();
+    auto it = counters->find(name);
+    if (it != counters->end()) {
+      it->second->store(value, std::memory_order_relaxed);
+      return;
+    }
+  }
+  auto counters = counters_.wlock();
+  auto& counter = (*counters)[std::move(name)];
+  if (!counter) {
+    counter = std::make_unique<std::atomic<int64_t>>(0);
+  }
+  counter->store(value, std::memory_order_relaxed);
+}
+
+int64_t ServiceData::incrementCounter(folly::StringPiece key, int64_t amount) {
+  auto name = key.str();
+  {
+    auto counters = counters_.rlock();
+    auto it = counters->find(name);
+    if (it != counters->end()) {
+      return it->second->fetch_add(amount, std::memory_order_relaxed) + amount;
+    }
+  }
+  auto counters = counters_.wlock();
+  auto& counter = (*counters)[std::move(name)];
+  if (!counter) {
+    counter = std::make_unique<std::atomic<int64_t>>(0);
+  }
+  return counter->fetch_add(amount, std::memory_order_relaxed) + amount;
+}
 } // namespace stats
 
 facebook::stats::ServiceData* fbData = &payload;
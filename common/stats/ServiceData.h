@@ -13,7 +13,12 @@
 #include "common/stats/ExportedStatMap.h"
 #include "common/stats/DynamicCounters.h"
 #include <folly/Range.h>
+#include <folly/Synchronized.h>
+#include <atomic>
 #include <map>
+#include <memory>
+#include <string>
+#include <unordered_map>
 
 namespace facebook { namespace stats {
 
@@ -22,27 +27,40 @@ class ServiceData {
   static ServiceData* get();
 
   ExportedStatMap* getStatMap() {
-    static ExportedStatMap it;
-    return &it;
+    return &statMap_;
   }
   ExportedHistogramMap* getHistogramMap() {
-    static ExportedHistogramMap it;
-    return &it;
+    return &histogramMap_;
   }
-  std::map<std::string, int64_t> getCounters() const {
-    return std::map<std::string, int64_t>{};
-  }
-  void getCounters(std::map<std::string, int64_t>&) const {}
-  long getCounter(folly::StringPiece) const { return 0; };
-  long clearCounter(folly::StringPiece) { return 0; };
+  /*
+   * The exported counters: those set directly, and the current values of
+   * the stats and histograms, which are computed for each call.  This is
+   * what fb303 getCounters() returns.
+   *
+   * Counters are atomics in a map that is only locked exclusively to add or
+   * remove one, so updating an existing counter never waits on a writer.
+   */
+  std::map<std::string, int64_t> getCounters() const;
+  void getCounters(std::map<std::string, int64_t>& out) const;
+  int64_t getCounter(folly::StringPiece key) const;
+  // Returns the number of counters removed, 0 or 1
+  int64_t clearCounter(folly::StringPiece key);
+  void setCounter(folly::StringPiece key, int64_t value);
+  int64_t incrementCounter(folly::StringPiece key, int64_t amount = 1);
+
   void setUseOptionsAsFlags(bool) {}
-  void setCounter(folly::StringPiece, uint32_t) {}
   DynamicCounters *getDynamicCounters() {
-    return &counters_;
+    return &dynamicCounters_;
   }
 
  private:
-  DynamicCounters counters_;
+  // The atomics are only updated under the read lock, so they can't be
+  // removed underneath an update
+  folly::Synchronized<std::unordered_map<
+    std::string, std::unique_ptr<std::atomic<int64_t>>>> counters_;
+  ExportedStatMap statMap_;
+  ExportedHistogramMap histogramMap_;
+  DynamicCounters dynamicCounters_;
 };
 
 }
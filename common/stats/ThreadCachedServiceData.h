@@ -11,60 +11,79 @@
 
 #include <cstdint>
 #include <folly/Range.h>
+#include <folly/ThreadLocal.h>
+#include <memory>
+#include <string>
+#include <unordered_map>
 #include "common/stats/ExportedStatMap.h"
+#include "common/stats/ServiceData.h"
+#include "common/stats/ThreadLocalStats.h"
 
 namespace facebook { namespace stats {
 
+/*
+ * Thread local stats on top of ServiceData.  Each thread gets its own
+ * ThreadLocalStatsMap from getThreadStats(), and publishStats() aggregates
+ * all of them into the ServiceData stats they are exported from.
+ *
+ * Nothing publishes in the background here, so the owner has to call
+ * publishStats() periodically.
+ */
 class ThreadCachedServiceData {
 public:
-  class ThreadLocalStatsMap {
-  };
-
-  class TLTimeseries {
-  public:
-    TLTimeseries(ThreadLocalStatsMap*, folly::StringPiece,
-                 ExportType, ExportType = ExportType()) {}
-    void addValue(int64_t) {}
-  };
-
-  class TLHistogram {
-  public:
-    TLHistogram(ThreadLocalStatsMap*, folly::StringPiece, int, int, int) {}
-    TLHistogram(
-        ThreadLocalStatsMap*, folly::StringPiece, int, int, int,
-        facebook::stats::ExportType, int, int) {}
-    void addValue(int64_t) {}
-    void addRepeatedValue(int64_t /*value*/, int64_t /*nsamples*/) {}
-  };
-
-  class TLCounter {
-    public:
-      TLCounter(ThreadLocalStatsMap*, folly::StringPiece) {}
-      void incrementValue(int64_t) {}
-
-  };
+  using ThreadLocalStatsMap = ThreadLocalStatsT<TLStatsThreadSafe>;
+  using TLTimeseries = ThreadLocalStatsMap::TLTimeseries;
+  using TLHistogram = ThreadLocalStatsMap::TLHistogram;
+  using TLCounter = ThreadLocalStatsMap::TLCounter;
 
   static ThreadCachedServiceData* get() {
     static ThreadCachedServiceData it;
     return &it;
   }
   ThreadLocalStatsMap* getThreadStats() {
-    static ThreadLocalStatsMap it;
-    return &it;
+    return &threadStats_->map;
   }
   bool publishThreadRunning() const {
     return false;
   }
   void publishStats() {
+    ThreadLocalStatsMap::aggregateAll();
   }
 
-  void addStatValue(const std::string& key, int64_t value = 1) {}
+  /*
+   * Add to a stat by name, creating a thread local timeseries for it the
+   * first time each thread uses the name.
+   */
+  void addStatValue(const std::string& key, int64_t value = 1) {
+    addStatValue(key, value, AVG);
+  }
   void addStatValue(
     const std::string& key,
     int64_t value,
-    stats::ExportType exportType) {}
-  int64_t setCounter(const std::string& key, int64_t value) { return 0; }
-  void clearCounter(const std::string& key) {}
+    stats::ExportType exportType) {
+    auto& timeseries = threadStats_->timeseries[key];
+    if (!timeseries) {
+      timeseries = std::make_unique<TLTimeseries>(
+          &threadStats_->map, key, exportType);
+    }
+    timeseries->addValue(value);
+  }
+  int64_t setCounter(const std::string& key, int64_t value) {
+    ServiceData::get()->setCounter(key, value);
+    return value;
+  }
+  void clearCounter(const std::string& key) {
+    ServiceData::get()->clearCounter(key);
+  }
+
+private:
+  struct ThreadStats {
+    ThreadLocalStatsMap map;
+    // The stats added by name, destroyed before the map they are in
+    std::unordered_map<std::string, std::unique_ptr<TLTimeseries>> timeseries;
+  };
+
+  folly::ThreadLocal<ThreadStats> threadStats_;
 };
 
 }} // unnamed facebook::stats
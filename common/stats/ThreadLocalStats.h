@@ -1,53 +1,338 @@
 // Copyright 2004-present Facebook. All Rights Reserved.
 #pragma once
 
-#include <chrono>
+#include <atomic>
 #include <folly/Range.h>
-#include <folly/Synchronized.h>
-#include <folly/stats/TimeseriesHistogram.h>
+#include <folly/SpinLock.h>
+#include <folly/stats/Histogram.h>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
 
 #include "common/stats/ExportType.h"
+#include "common/stats/ServiceData.h"
 
 namespace facebook { namespace stats {
 
-class TLStatsThreadSafe {};
+/*
+ * The exports of a histogram: export types, and the percentiles to export
+ * given as plain ints, in any order, e.g. (AVG, 50, 95, 100).
+ */
+struct HistogramExports {
+  HistogramExports() {}
+  template <typename... Args>
+  explicit HistogramExports(Args... args) {
+    add(args...);
+  }
 
+  std::vector<ExportType> types;
+  std::vector<int> percentiles;
+
+ private:
+  void add() {}
+  template <typename... Args>
+  void add(ExportType type, Args... args) {
+    types.push_back(type);
+    add(args...);
+  }
+  template <typename... Args>
+  void add(int percentile, Args... args) {
+    percentiles.push_back(percentile);
+    add(args...);
+  }
+};
+
+/*
+ * Lock traits for ThreadLocalStatsT.
+ *
+ * With TLStatsThreadSafe the stats are updated by the thread that owns
+ * them, while aggregate() may be called from any thread.  Each stat has a
+ * spinlock of its own, so updates from different threads never contend; an
+ * update only waits if that very stat is being aggregated.
+ *
+ * With TLStatsNoLocking the stats, and aggregate(), must only ever be used
+ * from one thread.
+ */
+class TLStatsThreadSafe {
+ public:
+  using RegistryLock = std::mutex;
+  using StatLock = folly::SpinLock;
+};
+
+class TLStatsNoLocking {
+ public:
+  class NoLock {
+   public:
+    void lock() {}
+    void unlock() {}
+  };
+  using RegistryLock = NoLock;
+  using StatLock = NoLock;
+};
+
+/*
+ * A set of stats that are cheap to update from one thread.  Updates only
+ * touch the stat's own thread local values, and aggregate() periodically
+ * folds those into the ServiceData stat, histogram or counter of the same
+ * name, which is what gets exported.  Stats of the same name share it, with
+ * the exports of all of them.
+ *
+ * Stats may outlive the container they were created in, e.g. if its thread
+ * exits first.  They are then still picked up by aggregateAll().
+ */
 template <class LockTraits>
 class ThreadLocalStatsT {
+  struct Registry;
+
  public:
-  // TODO: This stub implementation just uses folly::Synchronized, and is not
-  // actually thread-local for now.
-  class TLHistogram {
+  /*
+   * The base of the thread local stats.  Derived classes link themselves
+   * into the container once constructed, and unlink before they are
+   * destroyed, so aggregate() never sees a stat that is only partly built.
+   */
+  class TLStat {
+   public:
+    virtual ~TLStat() {}
+
+    const std::string& name() const {
+      return name_;
+    }
+
+   protected:
+    TLStat(ThreadLocalStatsT* container, folly::StringPiece name)
+        : registry_(container->registry_), name_(name.str()) {}
+
+    void link() {
+      std::lock_guard<typename LockTraits::RegistryLock> g(registry_->lock);
+      registry_->stats.insert(this);
+    }
+    // Aggregates whatever was added since the last aggregate(), so no value
+    // is lost when a stat goes away
+    void unlink() {
+      std::lock_guard<typename LockTraits::RegistryLock> g(registry_->lock);
+      if (registry_->stats.erase(this)) {
+        aggregate(statsNow());
+      }
+    }
+
+    typename LockTraits::StatLock lock_;
+
+   private:
+    friend class ThreadLocalStatsT;
+    friend struct ThreadLocalStatsT::Registry;
+
+    // Forbidden copy constructor and assignment operator
+    TLStat(TLStat const &) = delete;
+    TLStat& operator=(TLStat const &) = delete;
+
+    // Called with the registry locked
+    virtual void aggregate(StatsTimePoint now) = 0;
+
+    std::shared_ptr<Registry> registry_;
+    const std::string name_;
+  };
+
+  class TLTimeseries : public TLStat {
+   public:
+    template <typename... Exports>
+    TLTimeseries(ThreadLocalStatsT* container, folly::StringPiece name,
+                 Exports... exports)
+        : TLStat(container, name) {
+      auto statMap = fbData->getStatMap();
+      for (auto type : std::vector<ExportType>{exports...}) {
+        statMap->exportStat(name, type);
+      }
+      aggregated_ = statMap->getLockableStat(name);
+      this->link();
+    }
+    ~TLTimeseries() override {
+      this->unlink();
+    }
+
+    void addValue(int64_t value) {
+      addValueAggregated(value, 1);
+    }
+    void addValueAggregated(int64_t sum, int64_t count) {
+      std::lock_guard<typename LockTraits::StatLock> g(this->lock_);
+      sum_ += sum;
+      count_ += count;
+    }
+
+   private:
+    void aggregate(StatsTimePoint now) override {
+      int64_t sum = 0;
+      int64_t count = 0;
+      {
+        std::lock_guard<typename LockTraits::StatLock> g(this->lock_);
+        std::swap(sum, sum_);
+        std::swap(count, count_);
+      }
+      if (count > 0) {
+        aggregated_.addValueAggregated(now, sum, count);
+      }
+    }
+
+    ExportedStatMap::LockableStat aggregated_;
+    int64_t sum_{0};
+    int64_t count_{0};
+  };
+
+  class TLHistogram : public TLStat {
    public:
-     template <typename... ExportArgs>
-     TLHistogram(ThreadLocalStatsT *container, folly::StringPiece name,
-                 size_t bucketWidth, int64_t minValue, int64_t maxValue,
-                 ExportArgs... exports)
-         : histogram_(
-               folly::in_place, bucketWidth, minValue, maxValue,
-               folly::MultiLevelTimeSeries<int64_t>{
-                   /* num buckets */ 60,
-                   {
-                       std::chrono::seconds{60}, std::chrono::seconds{600},
-                       std::chrono::seconds{3600}, std::chrono::seconds{0},
-                   }}) {
-       // We don't handle setting up exports for now.
+    template <typename... Exports>
+    TLHistogram(ThreadLocalStatsT* container, folly::StringPiece name,
+                int64_t bucketWidth, int64_t min, int64_t max,
+                Exports... exports)
+        : TLStat(container, name),
+          pending_(bucketWidth, min, max),
+          aggregating_(bucketWidth, min, max) {
+      // Later stats of the same name share the first one's buckets,
+      // whatever they ask for, since the values are merged
+      auto histMap = fbData->getHistogramMap();
+      ExportedHistogram prototype(bucketWidth, min, max);
+      aggregated_ = histMap->getOrCreateLockableHistogram(name, &prototype);
+      HistogramExports histExports(exports...);
+      for (auto type : histExports.types) {
+        histMap->exportStat(name, type);
+      }
+      for (auto pct : histExports.percentiles) {
+        histMap->exportPercentile(name, pct);
+      }
+      this->link();
+    }
+    ~TLHistogram() override {
+      this->unlink();
     }
 
     void addValue(int64_t value) {
-      // The default TimeseriesHistogram clock does not implement now;
-      // set the time using steady_clock here.
-      auto now = std::chrono::duration_cast<
-          folly::TimeseriesHistogram<int64_t>::Duration>(
-          std::chrono::steady_clock::now().time_since_epoch());
-      histogram_->addValue(now, value);
+      std::lock_guard<typename LockTraits::StatLock> g(this->lock_);
+      pending_.addValue(value);
+      hasPending_ = true;
+    }
+    void addRepeatedValue(int64_t value, int64_t nsamples) {
+      std::lock_guard<typename LockTraits::StatLock> g(this->lock_);
+      pending_.addRepeatedValue(value, nsamples);
+      hasPending_ = true;
+    }
+
+   private:
+    void aggregate(StatsTimePoint now) override {
+      {
+        // Only the buckets are swapped under the lock, the aggregation
+        // happens outside it
+        std::lock_guard<typename LockTraits::StatLock> g(this->lock_);
+        if (!hasPending_) {
+          return;
+        }
+        std::swap(pending_, aggregating_);
+        hasPending_ = false;
+      }
+      aggregated_.addValues(now, aggregating_);
+      aggregating_.clear();
+    }
+
+    ExportedHistogramMap::LockableHistogram aggregated_;
+    folly::Histogram<int64_t> pending_;
+    // Only used by aggregate(), which the registry lock serializes
+    folly::Histogram<int64_t> aggregating_;
+    bool hasPending_{false};
+  };
+
+  class TLCounter : public TLStat {
+   public:
+    TLCounter(ThreadLocalStatsT* container, folly::StringPiece name)
+        : TLStat(container, name) {
+      this->link();
+    }
+    ~TLCounter() override {
+      this->unlink();
     }
 
-  private:
-    folly::Synchronized<folly::TimeseriesHistogram<int64_t>> histogram_;
+    void incrementValue(int64_t delta) {
+      value_.fetch_add(delta, std::memory_order_relaxed);
+    }
+
+   private:
+    void aggregate(StatsTimePoint /*now*/) override {
+      auto delta = value_.exchange(0, std::memory_order_relaxed);
+      if (delta != 0) {
+        fbData->incrementCounter(this->name(), delta);
+      }
+    }
+
+    std::atomic<int64_t> value_{0};
+  };
+
+  ThreadLocalStatsT() : registry_(std::make_shared<Registry>()) {
+    auto& all = allRegistries();
+    std::lock_guard<std::mutex> g(all.lock);
+    all.registries.push_back(registry_);
+  }
+  ~ThreadLocalStatsT() {
+    aggregate();
+  }
+
+  /*
+   * Fold the values added to the stats since the last call into their
+   * aggregates.
+   */
+  void aggregate() {
+    registry_->aggregate(statsNow());
+  }
+
+  /*
+   * Aggregate the stats of every container, including stats whose container
+   * has already gone.
+   */
+  static void aggregateAll() {
+    auto now = statsNow();
+    auto& all = allRegistries();
+    std::lock_guard<std::mutex> g(all.lock);
+    auto it = all.registries.begin();
+    while (it != all.registries.end()) {
+      if (auto registry = it->lock()) {
+        registry->aggregate(now);
+        ++it;
+      } else {
+        it = all.registries.erase(it);
+      }
+    }
+  }
+
+ private:
+  // Forbidden copy constructor and assignment operator
+  ThreadLocalStatsT(ThreadLocalStatsT const &) = delete;
+  ThreadLocalStatsT& operator=(ThreadLocalStatsT const &) = delete;
+
+  // Shared by the container and its stats, so it lasts as long as any of
+  // them
+  struct Registry {
+    typename LockTraits::RegistryLock lock;
+    std::set<TLStat*> stats;
+
+    void aggregate(StatsTimePoint now) {
+      std::lock_guard<typename LockTraits::RegistryLock> g(lock);
+      for (auto* stat : stats) {
+        stat->aggregate(now);
+      }
+    }
+  };
+
+  struct AllRegistries {
+    std::mutex lock;
+    std::vector<std::weak_ptr<Registry>> registries;
   };
 
-  void aggregate() {}
+  static AllRegistries& allRegistries() {
+    // Leaked, as stats in other static objects may outlive it
+    static auto* all = new AllRegistries();
+    return *all;
+  }
+
+  std::shared_ptr<Registry> registry_;
 };
 
 } // stats
@@ -0,0 +1,309 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "fboss/agent/AclCompiler.h"
+
+#include "fboss/agent/state/AclEntry.h"
+
+#include <algorithm>
+#include <tuple>
+
+using folly::CIDRNetwork;
+
+namespace facebook { namespace fboss {
+
+namespace {
+
+// The fields an entry matches on
+enum : uint32_t {
+  kSrcIp = 1 << 0,
+  kDstIp = 1 << 1,
+  kProto = 1 << 2,
+  kTcpFlags = 1 << 3,
+  kSrcPort = 1 << 4,
+  kDstPort = 1 << 5,
+  kSrcL4PortRange = 1 << 6,
+  kDstL4PortRange = 1 << 7,
+  kPktLenRange = 1 << 8,
+  kIpFrag = 1 << 9,
+  kIcmpType = 1 << 10,
+  kIcmpCode = 1 << 11,
+  kDscp = 1 << 12,
+  kIpType = 1 << 13,
+  kTtl = 1 << 14,
+  kDstMac = 1 << 15,
+};
+
+uint32_t matchedFields(const AclEntryFields& f) {
+  return (f.srcIp.second > 0 ? kSrcIp : 0) |
+    (f.dstIp.second > 0 ? kDstIp : 0) |
+    (f.proto ? kProto : 0) |
+    (f.tcpFlagsBitMap ? kTcpFlags : 0) |
+    (f.srcPort ? kSrcPort : 0) |
+    (f.dstPort ? kDstPort : 0) |
+    (f.srcL4PortRange ? kSrcL4PortRange : 0) |
+    (f.dstL4PortRange ? kDstL4PortRange : 0) |
+    (f.pktLenRange ? kPktLenRange : 0) |
+    (f.ipFrag ? kIpFrag : 0) |
+    (f.icmpType ? kIcmpType : 0) |
+    (f.icmpCode ? kIcmpCode : 0) |
+    (f.dscp ? kDscp : 0) |
+    (f.ipType ? kIpType : 0) |
+    (f.ttl ? kTtl : 0) |
+    (f.dstMac ? kDstMac : 0);
+}
+
+auto matchKey(const AclEntryFields& f) {
+  return std::tie(f.srcIp, f.dstIp, f.proto, f.tcpFlagsBitMap, f.srcPort,
+                  f.dstPort, f.srcL4PortRange, f.dstL4PortRange,
+                  f.pktLenRange, f.ipFrag, f.icmpType, f.icmpCode, f.dscp,
+                  f.ipType, f.ttl, f.dstMac);
+}
+
+bool prefixCovers(const CIDRNetwork& a, const CIDRNetwork& b) {
+  return a.first.family() == b.first.family() && a.second <= b.second &&
+    b.first.inSubnet(a.first, a.second);
+}
+
+template <typename Range>
+bool rangeCovers(const Range& a, const Range& b) {
+  return a.getMin() <= b.getMin() && b.getMax() <= a.getMax();
+}
+
+template <typename Range>
+bool rangesDisjoint(const Range& a, const Range& b) {
+  return a.getMax() < b.getMin() || b.getMax() < a.getMin();
+}
+
+// Whether a matches every packet b does
+bool covers(const AclEntryFields& a, const AclEntryFields& b) {
+  auto fields = matchedFields(a);
+  if (fields & ~matchedFields(b)) {
+    return false;
+  }
+  if (((fields & kSrcIp) && !prefixCovers(a.srcIp, b.srcIp)) ||
+      ((fields & kDstIp) && !prefixCovers(a.dstIp, b.dstIp)) ||
+      ((fields & kSrcL4PortRange) &&
+       !rangeCovers(*a.srcL4PortRange, *b.srcL4PortRange)) ||
+      ((fields & kDstL4PortRange) &&
+       !rangeCovers(*a.dstL4PortRange, *b.dstL4PortRange)) ||
+      ((fields & kPktLenRange) &&
+       !rangeCovers(*a.pktLenRange, *b.pktLenRange))) {
+    return false;
+  }
+  if (fields & kTtl) {
+    auto mask = a.ttl->getMask();
+    if ((mask & ~b.ttl->getMask()) ||
+        ((a.ttl->getValue() ^ b.ttl->getValue()) & mask)) {
+      return false;
+    }
+  }
+  // The rest only match exact values
+  return (!(fields & kProto) || a.proto == b.proto) &&
+    (!(fields & kTcpFlags) || a.tcpFlagsBitMap == b.tcpFlagsBitMap) &&
+    (!(fields & kSrcPort) || a.srcPort == b.srcPort) &&
+    (!(fields & kDstPort) || a.dstPort == b.dstPort) &&
+    (!(fields & kIpFrag) || a.ipFrag == b.ipFrag) &&
+    (!(fields & kIcmpType) || a.icmpType == b.icmpType) &&
+    (!(fields & kIcmpCode) || a.icmpCode == b.icmpCode) &&
+    (!(fields & kDscp) || a.dscp == b.dscp) &&
+    (!(fields & kIpType) || a.ipType == b.ipType) &&
+    (!(fields & kDstMac) || a.dstMac == b.dstMac);
+}
+
+// Whether no packet can match both.  The IP type, fragment and TCP flag
+// matches overlap in ways not modelled here, so they never tell entries
+// apart.
+bool disjoint(const AclEntryFields& a, const AclEntryFields& b) {
+  auto fields = matchedFields(a) & matchedFields(b);
+  if (fields & kTtl) {
+    if ((a.ttl->getValue() ^ b.ttl->getValue()) &
+        a.ttl->getMask() & b.ttl->getMask()) {
+      return true;
+    }
+  }
+  return ((fields & kSrcIp) && !prefixCovers(a.srcIp, b.srcIp) &&
+          !prefixCovers(b.srcIp, a.srcIp)) ||
+    ((fields & kDstIp) && !prefixCovers(a.dstIp, b.dstIp) &&
+     !prefixCovers(b.dstIp, a.dstIp)) ||
+    ((fields & kSrcL4PortRange) &&
+     rangesDisjoint(*a.srcL4PortRange, *b.srcL4PortRange)) ||
+    ((fields & kDstL4PortRange) &&
+     rangesDisjoint(*a.dstL4PortRange, *b.dstL4PortRange)) ||
+    ((fields & kPktLenRange) &&
+     rangesDisjoint(*a.pktLenRange, *b.pktLenRange)) ||
+    ((fields & kProto) && a.proto != b.proto) ||
+    ((fields & kSrcPort) && a.srcPort != b.srcPort) ||
+    ((fields & kDstPort) && a.dstPort != b.dstPort) ||
+    ((fields & kIcmpType) && a.icmpType != b.icmpType) ||
+    ((fields & kIcmpCode) && a.icmpCode != b.icmpCode) ||
+    ((fields & kDscp) && a.dscp != b.dscp) ||
+    ((fields & kDstMac) && a.dstMac != b.dstMac);
+}
+
+bool sameAction(const AclEntryFields& a, const AclEntryFields& b) {
+  return a.actionType == b.actionType && a.aclAction == b.aclAction;
+}
+
+bool hasCounter(const AclEntryFields& f) {
+  return f.aclAction && f.aclAction->getPacketCounter();
+}
+
+// The prefix both are half of, if they are the two halves of one
+folly::Optional<CIDRNetwork> mergePrefixes(
+    const CIDRNetwork& a,
+    const CIDRNetwork& b) {
+  if (a.second == 0 || a.second != b.second ||
+      a.first.family() != b.first.family() || a.first == b.first) {
+    return folly::none;
+  }
+  uint8_t len = a.second - 1;
+  auto merged = a.first.mask(len);
+  if (merged != b.first.mask(len)) {
+    return folly::none;
+  }
+  return std::make_pair(merged, len);
+}
+
+folly::Optional<AclL4PortRange> mergeRanges(
+    const folly::Optional<AclL4PortRange>& a,
+    const folly::Optional<AclL4PortRange>& b) {
+  if (!a || !b || a->isExactMatch() || b->isExactMatch() ||
+      a->getMax() + 1 < b->getMin() || b->getMax() + 1 < a->getMin()) {
+    return folly::none;
+  }
+  return AclL4PortRange(std::min(a->getMin(), b->getMin()),
+                        std::max(a->getMax(), b->getMax()));
+}
+
+// An entry matching what a and b match, when they differ in one field that
+// can hold both
+std::shared_ptr<AclEntry> merge(const AclEntry& a, const AclEntry& b) {
+  const auto& fa = *a.getFields();
+  const auto& fb = *b.getFields();
+  if (!sameAction(fa, fb) || hasCounter(fa) || hasCounter(fb) ||
+      matchedFields(fa) != matchedFields(fb)) {
+    return nullptr;
+  }
+  // b with one field of a's is a exactly, if that is the only difference
+  auto onlyDiffers = [&](auto setField) {
+    auto fields = fb;
+    setField(fields, fa);
+    return matchKey(fields) == matchKey(fa);
+  };
+
+  if (auto prefix = mergePrefixes(fa.srcIp, fb.srcIp)) {
+    if (onlyDiffers([](auto& f, const auto& from) {
+          f.srcIp = from.srcIp;
+        })) {
+      auto merged = a.clone();
+      merged->setSrcIp(*prefix);
+      return merged;
+    }
+  }
+  if (auto prefix = mergePrefixes(fa.dstIp, fb.dstIp)) {
+    if (onlyDiffers([](auto& f, const auto& from) {
+          f.dstIp = from.dstIp;
+        })) {
+      auto merged = a.clone();
+      merged->setDstIp(*prefix);
+      return merged;
+    }
+  }
+  if (auto range = mergeRanges(fa.srcL4PortRange, fb.srcL4PortRange)) {
+    if (onlyDiffers([](auto& f, const auto& from) {
+          f.srcL4PortRange = from.srcL4PortRange;
+        })) {
+      auto merged = a.clone();
+      merged->setSrcL4PortRange(*range);
+      return merged;
+    }
+  }
+  if (auto range = mergeRanges(fa.dstL4PortRange, fb.dstL4PortRange)) {
+    if (onlyDiffers([](auto& f, const auto& from) {
+          f.dstL4PortRange = from.dstL4PortRange;
+        })) {
+      auto merged = a.clone();
+      merged->setDstL4PortRange(*range);
+      return merged;
+    }
+  }
+  return nullptr;
+}
+
+} // unnamed namespace
+
+CompiledAcls compileAcls(std::vector<std::shared_ptr<AclEntry>> entries) {
+  CompiledAcls result;
+
+  // Drop the entries an earlier one hides.  Each step only drops what the
+  // entries kept so far never let through, so the result matches the same.
+  std::vector<std::shared_ptr<AclEntry>> visible;
+  for (auto& entry : entries) {
+    const auto& fields = *entry->getFields();
+    bool shadowed = !hasCounter(fields) &&
+      std::any_of(visible.begin(), visible.end(), [&](const auto& earlier) {
+        return covers(*earlier->getFields(), fields);
+      });
+    if (shadowed) {
+      result.shadowed.push_back(entry->getID());
+    } else {
+      visible.push_back(std::move(entry));
+    }
+  }
+
+  // Fold each entry into the one right before it where they combine, and
+  // keep folding the result back, so that four quarters make a whole
+  std::vector<std::shared_ptr<AclEntry>> merged;
+  for (auto& entry : visible) {
+    merged.push_back(std::move(entry));
+    while (merged.size() > 1) {
+      auto combined = merge(*merged[merged.size() - 2], *merged.back());
+      if (!combined) {
+        break;
+      }
+      result.merged.push_back(merged.back()->getID());
+      merged.pop_back();
+      merged.back() = std::move(combined);
+    }
+  }
+
+  // Drop the entries a later one with the same action stands in for.  Going
+  // from the last entry up, each is checked against what is left after it.
+  std::vector<bool> kept(merged.size(), true);
+  for (size_t idx = merged.size(); idx-- > 0;) {
+    const auto& fields = *merged[idx]->getFields();
+    if (hasCounter(fields)) {
+      continue;
+    }
+    for (size_t later = idx + 1; later < merged.size(); ++later) {
+      if (!kept[later]) {
+        continue;
+      }
+      const auto& laterFields = *merged[later]->getFields();
+      if (sameAction(fields, laterFields)) {
+        if (covers(laterFields, fields)) {
+          kept[idx] = false;
+          result.redundant.push_back(merged[idx]->getID());
+          break;
+        }
+      } else if (!disjoint(fields, laterFields)) {
+        break;
+      }
+    }
+  }
+  for (size_t idx = 0; idx < merged.size(); ++idx) {
+    if (kept[idx]) {
+      result.entries.push_back(std::move(merged[idx]));
+    }
+  }
+  return result;
+}
+
+}} // facebook::fboss
@@ -0,0 +1,43 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace facebook { namespace fboss {
+
+class AclEntry;
+
+struct CompiledAcls {
+  // What is left, still in priority order
+  std::vector<std::shared_ptr<AclEntry>> entries;
+  // Entries an earlier entry matches every packet of, so they never match
+  std::vector<std::string> shadowed;
+  // Entries a later entry with the same action matches every packet of,
+  // with nothing in between that could match them differently
+  std::vector<std::string> redundant;
+  // Entries folded into the entry right before them
+  std::vector<std::string> merged;
+};
+
+/*
+ * Reduce ACL entries, given in priority order, to a smaller set that
+ * matches every packet with the same action, to save TCAM entries and the
+ * time to program them.
+ *
+ * Entries with a packet counter are left alone, as their counts are seen
+ * from outside.  Port ranges are only merged when neither is a single port,
+ * so merging never uses up another range checker.
+ */
+CompiledAcls compileAcls(std::vector<std::shared_ptr<AclEntry>> entries);
+
+}} // facebook::fboss
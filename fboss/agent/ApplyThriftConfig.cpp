@@ -11,12 +11,17 @@
 
 #include <folly/FileUtil.h>
 #include <folly/gen/Base.h>
+#include <folly/hash/SpookyHashV2.h>
+#include <folly/logging/xlog.h>
+#include <gflags/gflags.h>
 #include <thrift/lib/cpp2/protocol/Serializer.h>
 
+#include "fboss/agent/AclCompiler.h"
 #include "fboss/agent/FbossError.h"
 #include "fboss/agent/LacpTypes.h"
 #include "fboss/agent/LoadBalancerConfigApplier.h"
 #include "fboss/agent/Platform.h"
+#include "fboss/agent/StartupProfiler.h"
 #include "fboss/agent/state/AclEntry.h"
 #include "fboss/agent/state/AclMap.h"
 #include "fboss/agent/state/AggregatePort.h"
@@ -45,6 +50,7 @@
 #include <boost/container/flat_map.hpp>
 #include <cmath>
 #include <folly/Range.h>
+#include <future>
 #include <utility>
 #include <vector>
 
@@ -60,6 +66,11 @@ using folly::CIDRNetwork;
 using std::make_shared;
 using std::shared_ptr;
 
+DEFINE_bool(compile_acls, false,
+            "Drop the ACL entries that can never match or that a later "
+            "entry stands in for, and merge adjacent entries that combine, "
+            "before programming the ACLs");
+
 namespace {
 
 const uint8_t kV6LinkLocalAddrMask{64};
@@ -82,11 +93,13 @@ class ThriftConfigApplier {
   ThriftConfigApplier(const std::shared_ptr<SwitchState>& orig,
                       const cfg::SwitchConfig* config,
                       const Platform* platform,
-                      const cfg::SwitchConfig* prevCfg)
+                      const cfg::SwitchConfig* prevCfg,
+                      bool prevCfgApplied)
     : orig_(orig),
       cfg_(config),
       platform_(platform),
-      prevCfg_(prevCfg) {}
+      prevCfg_(prevCfg),
+      prevCfgApplied_(prevCfgApplied) {}
 
   std::shared_ptr<SwitchState> run();
 
@@ -164,6 +177,7 @@ class ThriftConfigApplier {
       const std::shared_ptr<PortQueue>& orig,
       const cfg::PortQueue* cfg);
   std::shared_ptr<PortQueue> createPortQueue(const cfg::PortQueue& cfg);
+  folly::Optional<cfg::PortBuffer> getPortBuffer(const cfg::Port* cfg);
   std::shared_ptr<AggregatePortMap> updateAggregatePorts();
   std::shared_ptr<AggregatePort> updateAggPort(
       const std::shared_ptr<AggregatePort>& orig,
@@ -178,6 +192,8 @@ class ThriftConfigApplier {
   std::shared_ptr<Vlan> updateVlan(const std::shared_ptr<Vlan>& orig,
                                    const cfg::Vlan* config);
   std::shared_ptr<AclMap> updateAcls();
+  // Reduce the ACLs with compileAcls(), for --compile_acls
+  std::shared_ptr<AclMap> compileAcls(AclMap::NodeContainer acls);
   std::shared_ptr<AclEntry> createAcl(const cfg::AclEntry* config,
       int priority,
       const MatchAction* action = nullptr);
@@ -191,9 +207,10 @@ class ThriftConfigApplier {
   bool updateNeighborResponseTables(Vlan* vlan, const cfg::Vlan* config);
   bool updateDhcpOverrides(Vlan* vlan, const cfg::Vlan* config);
   std::shared_ptr<InterfaceMap> updateInterfaces();
-  std::shared_ptr<RouteTableMap> updateInterfaceRoutes();
-  std::shared_ptr<RouteTableMap> updateStaticRoutes(
-      const std::shared_ptr<RouteTableMap>& curRoutingTables);
+  // The interface and static routes go through one RouteUpdater, so that
+  // all of them are resolved in a single pass
+  std::shared_ptr<RouteTableMap> updateRoutes();
+  void updateInterfaceRoutes(RouteUpdater* updater);
   shared_ptr<Interface> createInterface(const cfg::Interface* config,
                                         const Interface::Addresses& addrs);
   shared_ptr<Interface> updateInterface(const shared_ptr<Interface>& orig,
@@ -210,10 +227,24 @@ class ThriftConfigApplier {
       const cfg::SflowCollector* config);
   shared_ptr<ControlPlane> updateControlPlane();
 
+  /*
+   * Whether a section of the config is the same as in the config orig_ was
+   * built from, so that it need not be computed again.  Only the sections
+   * nothing but the config changes in the state are checked: the ports are
+   * also changed by setPortState(), and the interfaces and VLANs fill in
+   * the tables the routes are computed from.
+   */
+  bool controlPlaneUnchanged() const;
+  bool aclsUnchanged() const;
+  bool aggregatePortsUnchanged() const;
+  bool sflowCollectorsUnchanged() const;
+
   std::shared_ptr<SwitchState> orig_;
   const cfg::SwitchConfig* cfg_{nullptr};
   const Platform* platform_{nullptr};
   const cfg::SwitchConfig* prevCfg_{nullptr};
+  // Whether orig_ was built from prevCfg_, rather than from nothing
+  bool prevCfgApplied_{false};
 
   struct VlanIpInfo {
     VlanIpInfo(uint8_t mask, MacAddress mac, InterfaceID intf)
@@ -241,7 +272,8 @@ shared_ptr<SwitchState> ThriftConfigApplier::run() {
   bool changed = false;
 
   {
-    auto newControlPlane = updateControlPlane();
+    auto newControlPlane = controlPlaneUnchanged() ?
+      nullptr : updateControlPlane();
     if (newControlPlane) {
       newState->resetControlPlane(std::move(newControlPlane));
       changed = true;
@@ -250,8 +282,33 @@ shared_ptr<SwitchState> ThriftConfigApplier::run() {
 
   processVlanPorts();
 
+  // The ACLs, ports, aggregate ports and sFlow collectors only read orig_,
+  // cfg_ and portVlans_, so they are computed on their own threads while
+  // the interfaces, VLANs and routes are computed on this one.  Each
+  // section still lands in newState in the same order as before.
+  auto aclsFuture = std::async(std::launch::async, [this] {
+    return aclsUnchanged() ? nullptr : updateAcls();
+  });
+  auto portsFuture = std::async(std::launch::async, [this] {
+    return updatePorts();
+  });
+  auto aggPortsFuture = std::async(std::launch::async, [this] {
+    return aggregatePortsUnchanged() ? nullptr : updateAggregatePorts();
+  });
+  auto collectorsFuture = std::async(std::launch::async, [this] {
+    return sflowCollectorsUnchanged() ? nullptr : updateSflowCollectors();
+  });
+
+  auto newIntfs = updateInterfaces();
+  // Note: updateInterfaces() must be called before updateVlans(),
+  // as updateInterfaces() populates the vlanInterfaces_ data structure.
+  auto newVlans = updateVlans();
+  // Note: updateInterfaces() must be called before updateRoutes(),
+  // as updateInterfaces() populates the intfRouteTables_ data structure.
+  auto newTables = updateRoutes();
+
   {
-    auto newAcls = updateAcls();
+    auto newAcls = aclsFuture.get();
     if (newAcls) {
       newState->resetAcls(std::move(newAcls));
       changed = true;
@@ -259,7 +316,7 @@ shared_ptr<SwitchState> ThriftConfigApplier::run() {
   }
 
   {
-    auto newPorts = updatePorts();
+    auto newPorts = portsFuture.get();
     if (newPorts) {
       newState->resetPorts(std::move(newPorts));
       changed = true;
@@ -267,45 +324,26 @@ shared_ptr<SwitchState> ThriftConfigApplier::run() {
   }
 
   {
-    auto newAggPorts = updateAggregatePorts();
+    auto newAggPorts = aggPortsFuture.get();
     if (newAggPorts) {
       newState->resetAggregatePorts(std::move(newAggPorts));
       changed = true;
     }
   }
 
-  {
-    auto newIntfs = updateInterfaces();
-    if (newIntfs) {
-      newState->resetIntfs(std::move(newIntfs));
-      changed = true;
-    }
+  if (newIntfs) {
+    newState->resetIntfs(std::move(newIntfs));
+    changed = true;
   }
 
-  // Note: updateInterfaces() must be called before updateVlans(),
-  // as updateInterfaces() populates the vlanInterfaces_ data structure.
-  {
-    auto newVlans = updateVlans();
-    if (newVlans) {
-      newState->resetVlans(std::move(newVlans));
-      changed = true;
-    }
+  if (newVlans) {
+    newState->resetVlans(std::move(newVlans));
+    changed = true;
   }
 
-  // Note: updateInterfaces() must be called before updateInterfaceRoutes(),
-  // as updateInterfaces() populates the intfRouteTables_ data structure.
-  {
-    auto newTables = updateInterfaceRoutes();
-    if (newTables) {
-      newState->resetRouteTables(newTables);
-      changed = true;
-    }
-    auto newerTables = updateStaticRoutes(newTables ? newTables :
-        orig_->getRouteTables());
-    if (newerTables) {
-      newState->resetRouteTables(std::move(newerTables));
-      changed = true;
-    }
+  if (newTables) {
+    newState->resetRouteTables(std::move(newTables));
+    changed = true;
   }
 
   auto newVlans = newState->getVlans();
@@ -397,9 +435,32 @@ shared_ptr<SwitchState> ThriftConfigApplier::run() {
     changed = true;
   }
 
+  folly::Optional<cfg::LinkFlapDampening> linkFlapDampening;
+  if (cfg_->__isset.linkFlapDampening) {
+    const auto& dampening = cfg_->linkFlapDampening;
+    if (dampening.penaltyPerFlap <= 0 || dampening.reuseThreshold <= 0 ||
+        dampening.halfLifeSeconds <= 0 || dampening.maxSuppressSeconds <= 0) {
+      throw FbossError(
+          "Link flap dampening penalty, reuse threshold, half life and "
+          "max suppress time must be positive");
+    }
+    if (dampening.suppressThreshold <= dampening.reuseThreshold) {
+      throw FbossError(
+          "Link flap dampening suppress threshold ",
+          dampening.suppressThreshold,
+          " must be over the reuse threshold ",
+          dampening.reuseThreshold);
+    }
+    linkFlapDampening = dampening;
+  }
+  if (orig_->getLinkFlapDampening() != linkFlapDampening) {
+    newState->setLinkFlapDampening(std::move(linkFlapDampening));
+    changed = true;
+  }
+
   // Add sFlow collectors
   {
-    auto newCollectors = updateSflowCollectors();
+    auto newCollectors = collectorsFuture.get();
     if (newCollectors) {
       newState->resetSflowCollectors(std::move(newCollectors));
       changed = true;
@@ -541,6 +602,7 @@ std::shared_ptr<PortQueue> ThriftConfigApplier::updatePortQueue(
       orig->getScheduling() == cfg->scheduling &&
       orig->getWeight() == cfg->weight &&
       orig->getReservedBytes() == cfg->reservedBytes &&
+      orig->getSharedBytes() == cfg->sharedBytes &&
       orig->getScalingFactor() == cfg->scalingFactor &&
       orig->getAqm() == cfg->aqm) {
     return orig;
@@ -555,6 +617,9 @@ std::shared_ptr<PortQueue> ThriftConfigApplier::updatePortQueue(
   if (cfg->__isset.reservedBytes) {
     newQueue->setReservedBytes(cfg->reservedBytes);
   }
+  if (cfg->__isset.sharedBytes) {
+    newQueue->setSharedBytes(cfg->sharedBytes);
+  }
   if (cfg->__isset.scalingFactor) {
     newQueue->setScalingFactor(cfg->scalingFactor);
   }
@@ -580,6 +645,9 @@ std::shared_ptr<PortQueue> ThriftConfigApplier::createPortQueue(
   if (cfg.__isset.reservedBytes) {
     queue->setReservedBytes(cfg.reservedBytes);
   }
+  if (cfg.__isset.sharedBytes) {
+    queue->setSharedBytes(cfg.sharedBytes);
+  }
   if (cfg.__isset.scalingFactor) {
     queue->setScalingFactor(cfg.scalingFactor);
   }
@@ -634,6 +702,7 @@ shared_ptr<Port> ThriftConfigApplier::updatePort(const shared_ptr<Port>& orig,
   auto vlans = portVlans_[orig->getID()];
 
   auto portQueues = updatePortQueues(orig, portConf);
+  auto buffer = getPortBuffer(portConf);
   bool queuesUnchanged = portQueues.size() == orig->getPortQueues().size();
   for (int i=0; i<portQueues.size() && queuesUnchanged; i++) {
     if (*(portQueues.at(i)) != *(orig->getPortQueues().at(i))) {
@@ -651,6 +720,7 @@ shared_ptr<Port> ThriftConfigApplier::updatePort(const shared_ptr<Port>& orig,
       portConf->description == orig->getDescription() &&
       vlans == orig->getVlans() &&
       portConf->fec == orig->getFEC() &&
+      buffer == orig->getBuffer() &&
       queuesUnchanged) {
     return nullptr;
   }
@@ -666,10 +736,25 @@ shared_ptr<Port> ThriftConfigApplier::updatePort(const shared_ptr<Port>& orig,
   newPort->setName(portConf->name);
   newPort->setDescription(portConf->description);
   newPort->setFEC(portConf->fec);
+  newPort->setBuffer(buffer);
   newPort->resetPortQueues(portQueues);
   return newPort;
 }
 
+folly::Optional<cfg::PortBuffer> ThriftConfigApplier::getPortBuffer(
+    const cfg::Port* portConf) {
+  if (!portConf->__isset.buffer) {
+    return folly::none;
+  }
+  const auto& buffer = portConf->buffer;
+  if ((buffer.__isset.reservedBytes && buffer.reservedBytes < 0) ||
+      (buffer.__isset.headroomBytes && buffer.headroomBytes < 0)) {
+    throw FbossError(
+        "Buffer sizes of port ", portConf->logicalID, " must not be negative");
+  }
+  return buffer;
+}
+
 shared_ptr<AggregatePortMap> ThriftConfigApplier::updateAggregatePorts() {
   auto origAggPorts = orig_->getAggregatePorts();
   AggregatePortMap::NodeContainer newAggPorts;
@@ -1019,6 +1104,10 @@ std::shared_ptr<AclMap> ThriftConfigApplier::updateAcls() {
       | folly::gen::appendTo(newAcls);;
   }
 
+  if (FLAGS_compile_acls) {
+    return compileAcls(std::move(newAcls));
+  }
+
   if (numExistingProcessed != orig_->getAcls()->size()) {
     // Some existing ACLs were removed.
     changed = true;
@@ -1030,6 +1119,45 @@ std::shared_ptr<AclMap> ThriftConfigApplier::updateAcls() {
   return orig_->getAcls()->clone(std::move(newAcls));
 }
 
+std::shared_ptr<AclMap> ThriftConfigApplier::compileAcls(
+    AclMap::NodeContainer acls) {
+  std::vector<std::shared_ptr<AclEntry>> entries;
+  for (const auto& acl : acls) {
+    entries.push_back(acl.second);
+  }
+  std::sort(entries.begin(), entries.end(),
+            [](const auto& a, const auto& b) {
+              return a->getPriority() < b->getPriority();
+            });
+  auto compiled = facebook::fboss::compileAcls(std::move(entries));
+  for (const auto& name : compiled.shadowed) {
+    XLOG(WARNING) << "ACL " << name << " is hidden by an earlier entry";
+  }
+  XLOG(INFO) << "Compiled ACLs to " << compiled.entries.size()
+             << " entries: " << compiled.shadowed.size() << " shadowed, "
+             << compiled.redundant.size() << " redundant, "
+             << compiled.merged.size() << " merged";
+
+  // Merged entries are new, so keep what didn't change from orig_ to leave
+  // it out of the delta
+  const auto& origAcls = orig_->getAcls();
+  AclMap::NodeContainer newAcls;
+  bool changed = compiled.entries.size() != origAcls->size();
+  for (auto& entry : compiled.entries) {
+    auto origAcl = origAcls->getEntryIf(entry->getID());
+    if (origAcl && *origAcl == *entry) {
+      entry = origAcl;
+    } else {
+      changed = true;
+    }
+    newAcls.emplace(entry->getID(), entry);
+  }
+  if (!changed) {
+    return nullptr;
+  }
+  return origAcls->clone(std::move(newAcls));
+}
+
 std::shared_ptr<AclEntry> ThriftConfigApplier::updateAcl(
     const cfg::AclEntry& acl,
     int priority,
@@ -1250,10 +1378,37 @@ bool ThriftConfigApplier::updateNeighborResponseTables(
   return changed;
 }
 
-shared_ptr<RouteTableMap> ThriftConfigApplier::updateInterfaceRoutes() {
+shared_ptr<RouteTableMap> ThriftConfigApplier::updateRoutes() {
+  using Clock = StartupProfiler::Clock;
+  RouteUpdater updater(orig_->getRouteTables());
+  updateInterfaceRoutes(&updater);
+
+  auto begin = Clock::now();
+  updater.updateStaticRoutes(*cfg_, *prevCfg_);
+  auto loaded = Clock::now();
+  auto newTables = updater.updateDone();
+  auto done = Clock::now();
+
+  auto numStaticRoutes = cfg_->staticRoutesToNull.size() +
+    cfg_->staticRoutesToCPU.size() + cfg_->staticRoutesWithNhops.size();
+  auto loadDuration =
+    std::chrono::duration_cast<std::chrono::microseconds>(loaded - begin);
+  XLOG(DBG1) << "Loaded " << numStaticRoutes << " static routes in "
+             << loadDuration.count() << "us, resolved routes in "
+             << updater.getResolveDuration().count() << "us";
+  // Only the initial config is part of the startup profile, so reloads do
+  // not keep adding to it
+  if (!prevCfgApplied_) {
+    auto profiler = StartupProfiler::get();
+    profiler->record("config.static_routes", begin, loaded);
+    profiler->record("config.route_resolve", loaded, done);
+  }
+  return newTables;
+}
+
+void ThriftConfigApplier::updateInterfaceRoutes(RouteUpdater* updater) {
   flat_set<RouterID> newToAddTables;
   flat_set<RouterID> oldToDeleteTables;
-  RouteUpdater updater(orig_->getRouteTables());
   // add or update the interface routes
   for (const auto& table : intfRouteTables_) {
     for (const auto& entry : table.second) {
@@ -1261,7 +1416,7 @@ shared_ptr<RouteTableMap> ThriftConfigApplier::updateInterfaceRoutes() {
       const auto& addr = entry.second.second;
       auto len = entry.first.second;
       auto nhop = ResolvedNextHop(addr, intf, UCMP_DEFAULT_WEIGHT);
-      updater.addRoute(table.first,
+      updater->addRoute(table.first,
                        addr,
                        len,
                        StdClientIds2ClientID(StdClientIds::INTERFACE_ROUTE),
@@ -1292,7 +1447,7 @@ shared_ptr<RouteTableMap> ThriftConfigApplier::updateInterfaceRoutes() {
         }
       }
       if (!found) {
-        updater.delRoute(id,
+        updater->delRoute(id,
                          addr.first,
                          addr.second,
                          StdClientIds2ClientID(StdClientIds::INTERFACE_ROUTE));
@@ -1301,21 +1456,12 @@ shared_ptr<RouteTableMap> ThriftConfigApplier::updateInterfaceRoutes() {
   }
   // delete v6 link route from no long existing router ID
   for (auto id : oldToDeleteTables) {
-    updater.delLinkLocalRoutes(id);
+    updater->delLinkLocalRoutes(id);
   }
   // add v6 link route to the new router
   for (auto id : newToAddTables) {
-    updater.addLinkLocalRoutes(id);
+    updater->addLinkLocalRoutes(id);
   }
-  return updater.updateDone();
-}
-
-
-std::shared_ptr<RouteTableMap> ThriftConfigApplier::updateStaticRoutes(
-    const std::shared_ptr<RouteTableMap>& curRoutingTables) {
-  RouteUpdater updater(curRoutingTables);
-  updater.updateStaticRoutes(*cfg_, *prevCfg_);
-  return updater.updateDone();
 }
 
 std::shared_ptr<InterfaceMap> ThriftConfigApplier::updateInterfaces() {
@@ -1413,7 +1559,13 @@ shared_ptr<SflowCollectorMap> ThriftConfigApplier::updateSflowCollectors() {
 
 shared_ptr<SflowCollector> ThriftConfigApplier::createSflowCollector(
     const cfg::SflowCollector* config) {
-  return make_shared<SflowCollector>(config->ip, config->port);
+  if (config->maxSamplesPerSec < 0) {
+    throw FbossError("sFlow collector ", config->ip, ":", config->port,
+                     " has a negative maxSamplesPerSec ",
+                     config->maxSamplesPerSec);
+  }
+  return make_shared<SflowCollector>(
+      config->ip, config->port, config->maxSamplesPerSec);
 }
 
 shared_ptr<SflowCollector> ThriftConfigApplier::updateSflowCollector(
@@ -1421,7 +1573,8 @@ shared_ptr<SflowCollector> ThriftConfigApplier::updateSflowCollector(
     const cfg::SflowCollector* config) {
   auto newCollector = createSflowCollector(config);
 
-  if (orig->getAddress() == newCollector->getAddress()) {
+  if (orig->getAddress() == newCollector->getAddress() &&
+      orig->getMaxSamplesPerSec() == newCollector->getMaxSamplesPerSec()) {
     return nullptr;
   }
 
@@ -1467,9 +1620,128 @@ shared_ptr<Interface> ThriftConfigApplier::updateInterface(
   return newIntf;
 }
 
+bool ThriftConfigApplier::controlPlaneUnchanged() const {
+  return prevCfgApplied_ &&
+    cfg_->__isset.cpuTrafficPolicy == prevCfg_->__isset.cpuTrafficPolicy &&
+    cfg_->cpuTrafficPolicy == prevCfg_->cpuTrafficPolicy;
+}
+
+bool ThriftConfigApplier::aclsUnchanged() const {
+  return prevCfgApplied_ &&
+    cfg_->acls == prevCfg_->acls &&
+    cfg_->__isset.globalEgressTrafficPolicy ==
+      prevCfg_->__isset.globalEgressTrafficPolicy &&
+    cfg_->globalEgressTrafficPolicy == prevCfg_->globalEgressTrafficPolicy;
+}
+
+bool ThriftConfigApplier::aggregatePortsUnchanged() const {
+  // The forwarding state LACP changes is left alone by updateAggPort()
+  return prevCfgApplied_ &&
+    cfg_->aggregatePorts == prevCfg_->aggregatePorts &&
+    cfg_->__isset.lacp == prevCfg_->__isset.lacp &&
+    cfg_->lacp == prevCfg_->lacp;
+}
+
+bool ThriftConfigApplier::sflowCollectorsUnchanged() const {
+  return prevCfgApplied_ &&
+    cfg_->sFlowCollectors == prevCfg_->sFlowCollectors;
+}
+
 shared_ptr<ControlPlane> ThriftConfigApplier::updateControlPlane() {
   // TODO(joseph5wu) Add processing cpu queue setting and reason mapping logics
-  return nullptr;
+  ControlPlane::SoftwarePolicers policers;
+  if (cfg_->__isset.cpuTrafficPolicy &&
+      cfg_->cpuTrafficPolicy.__isset.softwarePolicers) {
+    flat_set<std::string> names;
+    for (const auto& policerCfg : cfg_->cpuTrafficPolicy.softwarePolicers) {
+      if (!names.insert(policerCfg.name).second) {
+        throw FbossError("Duplicate CPU software policer ", policerCfg.name);
+      }
+      if (policerCfg.etherType < 0 || policerCfg.etherType > 0xffff) {
+        throw FbossError("Invalid ethertype ", policerCfg.etherType,
+                         " for CPU software policer ", policerCfg.name);
+      }
+      if (policerCfg.packetsPerSec <= 0 || policerCfg.burstSize <= 0) {
+        throw FbossError("CPU software policer ", policerCfg.name,
+                         " must have a positive rate and burst size");
+      }
+      CPUSoftwarePolicer policer;
+      policer.name = policerCfg.name;
+      policer.etherType = policerCfg.etherType;
+      if (policerCfg.__isset.ipProtocol) {
+        policer.ipProtocol = policerCfg.ipProtocol;
+      }
+      if (policerCfg.__isset.port) {
+        policer.port = PortID(policerCfg.port);
+      }
+      policer.packetsPerSec = policerCfg.packetsPerSec;
+      policer.burstSize = policerCfg.burstSize;
+      auto minPacketsPerSec = policerCfg.__isset.minPacketsPerSec ?
+        policerCfg.minPacketsPerSec : policerCfg.packetsPerSec;
+      auto maxPacketsPerSec = policerCfg.__isset.maxPacketsPerSec ?
+        policerCfg.maxPacketsPerSec : policerCfg.packetsPerSec;
+      if (minPacketsPerSec <= 0 ||
+          minPacketsPerSec > policerCfg.packetsPerSec ||
+          maxPacketsPerSec < policerCfg.packetsPerSec) {
+        throw FbossError("CPU software policer ", policerCfg.name,
+                         " must have a positive minimum rate no higher than"
+                         " its rate, and a maximum rate no lower");
+      }
+      policer.minPacketsPerSec = minPacketsPerSec;
+      policer.maxPacketsPerSec = maxPacketsPerSec;
+      policers.push_back(std::move(policer));
+    }
+  }
+
+  // Policers that are configured as before keep the rate they were tuned to
+  auto origControlPlane = orig_->getControlPlane();
+  for (auto& policer : policers) {
+    for (const auto& origPolicer : origControlPlane->getSoftwarePolicers()) {
+      auto untuned = origPolicer;
+      untuned.tunedPacketsPerSec = folly::none;
+      if (untuned == policer) {
+        policer.tunedPacketsPerSec = origPolicer.tunedPacketsPerSec;
+      }
+    }
+  }
+
+  folly::Optional<IcmpErrorRateLimit> icmpErrorRateLimit;
+  if (cfg_->__isset.cpuTrafficPolicy &&
+      cfg_->cpuTrafficPolicy.__isset.icmpErrorRateLimit) {
+    const auto& limitCfg = cfg_->cpuTrafficPolicy.icmpErrorRateLimit;
+    if (limitCfg.packetsPerSec <= 0 || limitCfg.burstSize <= 0) {
+      throw FbossError(
+          "ICMP error rate limit must have a positive rate and burst size");
+    }
+    if (limitCfg.perSourcePacketsPerSec < 0 ||
+        limitCfg.perSourceBurstSize <= 0) {
+      throw FbossError("ICMP error per-source rate limit must have a "
+                       "non-negative rate and a positive burst size");
+    }
+    if (limitCfg.v4SourcePrefixLength < 0 ||
+        limitCfg.v4SourcePrefixLength > 32 ||
+        limitCfg.v6SourcePrefixLength < 0 ||
+        limitCfg.v6SourcePrefixLength > 128) {
+      throw FbossError("Invalid ICMP error rate limit source prefix length");
+    }
+    IcmpErrorRateLimit limit;
+    limit.packetsPerSec = limitCfg.packetsPerSec;
+    limit.burstSize = limitCfg.burstSize;
+    limit.perSourcePacketsPerSec = limitCfg.perSourcePacketsPerSec;
+    limit.perSourceBurstSize = limitCfg.perSourceBurstSize;
+    limit.v4SourcePrefixLength = limitCfg.v4SourcePrefixLength;
+    limit.v6SourcePrefixLength = limitCfg.v6SourcePrefixLength;
+    icmpErrorRateLimit = limit;
+  }
+
+  if (origControlPlane->getSoftwarePolicers() == policers &&
+      origControlPlane->getIcmpErrorRateLimit() == icmpErrorRateLimit) {
+    return nullptr;
+  }
+  auto newControlPlane = origControlPlane->clone();
+  newControlPlane->resetSoftwarePolicers(std::move(policers));
+  newControlPlane->setIcmpErrorRateLimit(std::move(icmpErrorRateLimit));
+  return newControlPlane;
 }
 
 std::string
@@ -1548,7 +1820,7 @@ shared_ptr<SwitchState> applyThriftConfig(
     const cfg::SwitchConfig* prevConfig) {
   cfg::SwitchConfig emptyConfig;
   return ThriftConfigApplier(state, config, platform,
-      prevConfig ? prevConfig : &emptyConfig).run();
+      prevConfig ? prevConfig : &emptyConfig, prevConfig != nullptr).run();
 }
 
 std::pair<std::shared_ptr<SwitchState>, std::string> applyThriftConfigFile(
@@ -1566,11 +1838,30 @@ std::pair<std::shared_ptr<SwitchState>, std::string> applyThriftConfigFile(
   if (!folly::readFile(path.toString().c_str(), configStr)) {
     throw FbossError("unable to read ", path);
   }
-  apache::thrift::SimpleJSONSerializer::deserialize<cfg::SwitchConfig>(
-      configStr.c_str(), config);
+  configStr = parseThriftConfig(path, std::move(configStr), &config);
 
   return std::make_pair(
       applyThriftConfig(state, &config, platform, prevConfig), configStr);
 }
 
+std::string parseThriftConfig(
+    folly::StringPiece path,
+    std::string contents,
+    cfg::SwitchConfig* config) {
+  if (!path.endsWith(kCompactConfigSuffix)) {
+    apache::thrift::SimpleJSONSerializer::deserialize<cfg::SwitchConfig>(
+        contents, *config);
+    return contents;
+  }
+  apache::thrift::CompactSerializer::deserialize<cfg::SwitchConfig>(
+      contents, *config);
+  return apache::thrift::SimpleJSONSerializer::serialize<std::string>(
+      *config);
+}
+
+uint64_t hashThriftConfig(folly::StringPiece contents) {
+  return folly::hash::SpookyHashV2::Hash64(
+      contents.data(), contents.size(), 0);
+}
+
 }} // facebook::fboss
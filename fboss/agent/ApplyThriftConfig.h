@@ -10,7 +10,9 @@
 #pragma once
 
 #include <folly/Range.h>
+#include <cstdint>
 #include <memory>
+#include <string>
 
 namespace facebook { namespace fboss {
 
@@ -26,6 +28,9 @@ class SwitchState;
  *
  * Returns a new SwitchState object with the resulting state, or null if
  * the config file results in no changes.
+ *
+ * prevConfig is the config the state was last built from, if any.  Sections
+ * that are the same in both are left as they are in the state.
  */
 std::shared_ptr<SwitchState> applyThriftConfig(
   const std::shared_ptr<SwitchState>& state,
@@ -39,6 +44,27 @@ std::pair<std::shared_ptr<SwitchState>, std::string> applyThriftConfigFile(
   const Platform* platform,
   const cfg::SwitchConfig* prevConfig);
 
+// Config files with this suffix hold the thrift compact encoding of the
+// config rather than JSON.  They parse much faster for large configs.
+constexpr folly::StringPiece kCompactConfigSuffix{".compact"};
+
+/*
+ * Parse the contents of the config file at path into config.
+ *
+ * Returns the config as JSON, which is what getRunningConfig() reports,
+ * whichever encoding the file used.
+ */
+std::string parseThriftConfig(
+  folly::StringPiece path,
+  std::string contents,
+  cfg::SwitchConfig* config);
+
+/*
+ * A hash of the contents of a config file, to tell whether it changed since
+ * it was last applied without parsing it.
+ */
+uint64_t hashThriftConfig(folly::StringPiece contents);
+
 std::pair<std::shared_ptr<SwitchState>, std::string> applyThriftConfigDefault(
   const std::shared_ptr<SwitchState> state,
   const Platform* platform,
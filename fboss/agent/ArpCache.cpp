@@ -18,9 +18,10 @@
 
 namespace facebook { namespace fboss {
 
-ArpCache::ArpCache(SwSwitch* sw, const SwitchState* state,
-                   VlanID vlanID, std::string vlanName, InterfaceID intfID)
-    : NeighborCache<ArpTable>(sw, vlanID, vlanName, intfID,
+ArpCache::ArpCache(SwSwitch* sw, NeighborTimer* timer,
+                   const SwitchState* state, VlanID vlanID,
+                   std::string vlanName, InterfaceID intfID)
+    : NeighborCache<ArpTable>(sw, timer, vlanID, vlanName, intfID,
                               state->getArpTimeout(),
                               state->getMaxNeighborProbes(),
                               state->getStaleEntryInterval()) {}
@@ -25,7 +25,7 @@ enum ArpOpCode : uint16_t;
 
 class ArpCache : public NeighborCache<ArpTable> {
  public:
-  ArpCache(SwSwitch* sw, const SwitchState* state,
+  ArpCache(SwSwitch* sw, NeighborTimer* timer, const SwitchState* state,
            VlanID vlanID, std::string vlanName, InterfaceID intfID);
 
   void sentArpRequest(folly::IPAddressV4 ip);
@@ -12,6 +12,7 @@
 #include <folly/IPAddressV4.h>
 #include <folly/MacAddress.h>
 #include <folly/io/Cursor.h>
+#include <folly/io/IOBuf.h>
 #include <folly/logging/xlog.h>
 #include "fboss/agent/FbossError.h"
 #include "fboss/agent/HwSwitch.h"
@@ -49,6 +50,18 @@ enum : uint8_t {
   ARP_PLEN_IPV4 = 4,
 };
 
+// Where the fields a reply template leaves out are, after the 802.1Q tagged
+// ethernet header
+enum : uint32_t {
+  ARP_ETH_DST_OFFSET = 0,
+  ARP_TARGET_MAC_OFFSET = 36,
+  ARP_TARGET_IP_OFFSET = 42,
+};
+
+// Templates are only added for the addresses in the ARP response tables.
+// This is just in case they keep changing.
+constexpr size_t kMaxReplyTemplates = 1024;
+
 namespace facebook { namespace fboss {
 
 ArpHandler::ArpHandler(SwSwitch* sw)
@@ -86,7 +99,7 @@ void ArpHandler::handlePacket(
   }
 
   // Look up the Vlan state.
-  auto state = sw_->getState();
+  auto state = sw_->getStateSnapshot();
   auto vlan = state->getVlans()->getVlanIf(pkt->getSrcVlan());
   if (!vlan) {
     // Hmm, we don't actually have this VLAN configured.
@@ -143,6 +156,34 @@ void ArpHandler::handlePacket(
   (void)targetMac; // unused
 }
 
+static void writeArp(RWPrivateCursor* cursor,
+                     VlanID vlan,
+                     ArpOpCode op,
+                     MacAddress senderMac,
+                     IPAddressV4 senderIP,
+                     MacAddress targetMac,
+                     IPAddressV4 targetIP) {
+  // TODO: We need a more robust mechanism for setting up the ethernet
+  // header in the response.  The HwSwitch should probably be responsible for
+  // setting it up, and determinine whether or not a VLAN tag needs to be
+  // present.
+  TxPacket::writeEthHeader(cursor, targetMac, senderMac, vlan,
+                           ArpHandler::ETHERTYPE_ARP);
+  cursor->writeBE<uint16_t>(ARP_HTYPE_ETHERNET);
+  cursor->writeBE<uint16_t>(ARP_PTYPE_IPV4);
+  cursor->writeBE<uint8_t>(ARP_HLEN_ETHERNET);
+  cursor->writeBE<uint8_t>(ARP_PLEN_IPV4);
+  cursor->writeBE<uint16_t>(op);
+  cursor->push(senderMac.bytes(), MacAddress::SIZE);
+  cursor->write<uint32_t>(senderIP.toLong());
+  cursor->push(((op == ARP_OP_REQUEST)
+                ? MacAddress::ZERO.bytes() : targetMac.bytes()),
+               MacAddress::SIZE);
+  cursor->write<uint32_t>(targetIP.toLong());
+  // Fill the padding with 0s
+  memset(cursor->writableData(), 0, cursor->length());
+}
+
 static void sendArp(SwSwitch *sw,
                     VlanID vlan,
                     ArpOpCode op,
@@ -154,33 +195,9 @@ static void sendArp(SwSwitch *sw,
              << " on vlan " << vlan << " to " << targetIP.str() << " ("
              << targetMac << "): " << senderIP.str() << " is " << senderMac;
 
-  // TODO: We need a more robust mechanism for setting up the ethernet
-  // header in the response.  The HwSwitch should probably be responsible for
-  // setting it up, and determinine whether or not a VLAN tag needs to be
-  // present.
-  //
-  // The minimum packet length is 64.  We use 68 here on the assumption that
-  // the packet will go out untagged, which will remove 4 bytes.
-  uint32_t pktLen = 68;
-  auto pkt = sw->allocatePacket(pktLen);
+  auto pkt = sw->allocatePacket(ArpHandler::ARP_PKT_LEN);
   RWPrivateCursor cursor(pkt->buf());
-
-  pkt->writeEthHeader(&cursor, targetMac, senderMac, vlan,
-                      ArpHandler::ETHERTYPE_ARP);
-  cursor.writeBE<uint16_t>(ARP_HTYPE_ETHERNET);
-  cursor.writeBE<uint16_t>(ARP_PTYPE_IPV4);
-  cursor.writeBE<uint8_t>(ARP_HLEN_ETHERNET);
-  cursor.writeBE<uint8_t>(ARP_PLEN_IPV4);
-  cursor.writeBE<uint16_t>(op);
-  cursor.push(senderMac.bytes(), MacAddress::SIZE);
-  cursor.write<uint32_t>(senderIP.toLong());
-  cursor.push(((op == ARP_OP_REQUEST)
-               ? MacAddress::ZERO.bytes() : targetMac.bytes()),
-              MacAddress::SIZE);
-  cursor.write<uint32_t>(targetIP.toLong());
-  // Fill the padding with 0s
-  memset(cursor.writableData(), 0, cursor.length());
-
+  writeArp(&cursor, vlan, op, senderMac, senderIP, targetMac, targetIP);
   sw->sendPacketSwitched(std::move(pkt));
 }
 
@@ -207,7 +224,49 @@ void ArpHandler::sendArpReply(VlanID vlan,
                               MacAddress targetMac,
                               IPAddressV4 targetIP) {
   sw_->portStats(port)->arpReplyTx();
-  sendArp(sw_, vlan, ARP_OP_REPLY, senderMac, senderIP, targetMac, targetIP);
+  XLOG(DBG4) << "sending ARP reply on vlan " << vlan << " to "
+             << targetIP.str() << " (" << targetMac << "): " << senderIP.str()
+             << " is " << senderMac;
+
+  auto reply = getReplyTemplate(vlan, senderMac, senderIP);
+  memcpy(&reply[ARP_ETH_DST_OFFSET], targetMac.bytes(), MacAddress::SIZE);
+  memcpy(&reply[ARP_TARGET_MAC_OFFSET], targetMac.bytes(), MacAddress::SIZE);
+  auto targetIPLong = targetIP.toLong();
+  memcpy(&reply[ARP_TARGET_IP_OFFSET], &targetIPLong, sizeof(targetIPLong));
+
+  auto pkt = sw_->allocatePacket(ARP_PKT_LEN);
+  RWPrivateCursor cursor(pkt->buf());
+  cursor.push(reply.data(), reply.size());
+  sw_->sendPacketSwitched(std::move(pkt));
+}
+
+ArpHandler::ReplyTemplate ArpHandler::getReplyTemplate(
+    VlanID vlan,
+    MacAddress senderMac,
+    IPAddressV4 senderIP) {
+  auto key = std::make_tuple(vlan, senderMac, senderIP);
+  {
+    auto templates = replyTemplates_.rlock();
+    auto it = templates->find(key);
+    if (it != templates->end()) {
+      return it->second;
+    }
+  }
+
+  auto buf = folly::IOBuf::create(ARP_PKT_LEN);
+  buf->append(ARP_PKT_LEN);
+  RWPrivateCursor cursor(buf.get());
+  writeArp(&cursor, vlan, ARP_OP_REPLY, senderMac, senderIP,
+           MacAddress::ZERO, IPAddressV4());
+  ReplyTemplate reply;
+  memcpy(reply.data(), buf->data(), reply.size());
+
+  auto templates = replyTemplates_.wlock();
+  if (templates->size() >= kMaxReplyTemplates) {
+    templates->clear();
+  }
+  templates->emplace(key, reply);
+  return reply;
 }
 
 void ArpHandler::sendArpRequest(SwSwitch* sw,
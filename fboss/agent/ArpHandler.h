@@ -14,10 +14,15 @@
 #include "fboss/agent/state/Interface.h"
 #include "fboss/agent/state/Vlan.h"
 
+#include <array>
 #include <memory>
+#include <tuple>
 
+#include <boost/container/flat_map.hpp>
 #include <folly/IPAddressV4.h>
 #include <folly/MacAddress.h>
+#include <folly/SharedMutex.h>
+#include <folly/Synchronized.h>
 
 namespace folly { namespace io {
 class Cursor;
@@ -38,6 +43,9 @@ enum ArpOpCode : uint16_t {
 class ArpHandler {
  public:
   enum : uint16_t { ETHERTYPE_ARP = 0x0806 };
+  // The minimum packet length is 64.  We use 68 here on the assumption that
+  // the packet will go out untagged, which will remove 4 bytes.
+  enum : uint32_t { ARP_PKT_LEN = 68 };
 
   explicit ArpHandler(SwSwitch* sw);
 
@@ -72,6 +80,21 @@ class ArpHandler {
   ArpHandler(ArpHandler const &) = delete;
   ArpHandler& operator=(ArpHandler const &) = delete;
 
+  /*
+   * A reply from one of our addresses is the same but for who it is to.
+   * The reply from each address is written once, and copied from then on.
+   */
+  using ReplyTemplate = std::array<uint8_t, ARP_PKT_LEN>;
+  // The VLAN, sender MAC and sender IP of the replies
+  using ReplyTemplateKey =
+      std::tuple<VlanID, folly::MacAddress, folly::IPAddressV4>;
+  using ReplyTemplates =
+      boost::container::flat_map<ReplyTemplateKey, ReplyTemplate>;
+
+  ReplyTemplate getReplyTemplate(VlanID vlan,
+                                 folly::MacAddress senderMac,
+                                 folly::IPAddressV4 senderIP);
+
   void sendArpReply(VlanID vlan, PortID port,
                     folly::MacAddress senderMac,
                     folly::IPAddressV4 senderIP,
@@ -79,6 +102,8 @@ class ArpHandler {
                     folly::IPAddressV4 targetIP);
 
   SwSwitch* sw_{nullptr};
+  // Keyed by everything in them, so they never go stale
+  folly::Synchronized<ReplyTemplates, folly::SharedMutex> replyTemplates_;
 };
 
 }} // facebook::fboss
@@ -0,0 +1,121 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "fboss/agent/BfdTypes.h"
+
+#include <folly/Conv.h>
+
+#include <ostream>
+
+namespace facebook {
+namespace fboss {
+
+using std::chrono::microseconds;
+
+BfdControlPacket BfdControlPacket::from(folly::io::Cursor* cursor) {
+  BfdControlPacket pkt;
+
+  auto versionAndDiag = cursor->read<uint8_t>();
+  pkt.version = versionAndDiag >> 5;
+  pkt.diag = static_cast<Diag>(versionAndDiag & 0x1f);
+
+  auto stateAndFlags = cursor->read<uint8_t>();
+  pkt.state = static_cast<State>(stateAndFlags >> 6);
+  pkt.flags = stateAndFlags & 0x3f;
+
+  pkt.detectMult = cursor->read<uint8_t>();
+  pkt.length = cursor->read<uint8_t>();
+  pkt.myDiscriminator = cursor->readBE<uint32_t>();
+  pkt.yourDiscriminator = cursor->readBE<uint32_t>();
+  pkt.desiredMinTxInterval = microseconds(cursor->readBE<uint32_t>());
+  pkt.requiredMinRxInterval = microseconds(cursor->readBE<uint32_t>());
+  pkt.requiredMinEchoRxInterval = microseconds(cursor->readBE<uint32_t>());
+
+  return pkt;
+}
+
+void BfdControlPacket::to(folly::io::RWPrivateCursor* cursor) const {
+  cursor->write<uint8_t>((version << 5) | static_cast<uint8_t>(diag));
+  cursor->write<uint8_t>((static_cast<uint8_t>(state) << 6) | flags);
+  cursor->write<uint8_t>(detectMult);
+  cursor->write<uint8_t>(length);
+  cursor->writeBE<uint32_t>(myDiscriminator);
+  cursor->writeBE<uint32_t>(yourDiscriminator);
+  cursor->writeBE<uint32_t>(desiredMinTxInterval.count());
+  cursor->writeBE<uint32_t>(requiredMinRxInterval.count());
+  cursor->writeBE<uint32_t>(requiredMinEchoRxInterval.count());
+}
+
+bool BfdControlPacket::isValid() const {
+  if (version != kVersion || detectMult == 0 || myDiscriminator == 0) {
+    return false;
+  }
+  // Without authentication, the packet is exactly as long as the header
+  if (hasFlag(AUTHENTICATION_PRESENT) || length != LENGTH) {
+    return false;
+  }
+  if (hasFlag(MULTIPOINT)) {
+    return false;
+  }
+  // Only packets that start a session may not know who they are for
+  return yourDiscriminator != 0 || state == State::DOWN ||
+      state == State::ADMIN_DOWN;
+}
+
+std::string BfdControlPacket::describe() const {
+  return folly::to<std::string>(
+      "(State ",
+      state,
+      ", Diag ",
+      static_cast<int>(diag),
+      ", Flags ",
+      flags,
+      ", DetectMult ",
+      detectMult,
+      ", MyDiscriminator ",
+      myDiscriminator,
+      ", YourDiscriminator ",
+      yourDiscriminator,
+      ", DesiredMinTx ",
+      desiredMinTxInterval.count(),
+      "us, RequiredMinRx ",
+      requiredMinRxInterval.count(),
+      "us)");
+}
+
+void toAppend(BfdControlPacket::State state, std::string* result) {
+  std::string stateAsString;
+
+  switch (state) {
+    case BfdControlPacket::State::ADMIN_DOWN:
+      stateAsString = "admin-down";
+      break;
+    case BfdControlPacket::State::DOWN:
+      stateAsString = "down";
+      break;
+    case BfdControlPacket::State::INIT:
+      stateAsString = "init";
+      break;
+    case BfdControlPacket::State::UP:
+      stateAsString = "up";
+      break;
+  }
+
+  folly::toAppend(stateAsString, result);
+}
+
+// Needed for CHECK_* macros to work with BfdControlPacket::State
+std::ostream& operator<<(std::ostream& out, BfdControlPacket::State state) {
+  std::string stateAsString;
+  toAppend(state, &stateAsString);
+  return (out << stateAsString);
+}
+
+} // namespace fboss
+} // namespace facebook
@@ -0,0 +1,102 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#pragma once
+
+#include <chrono>
+#include <string>
+
+#include <folly/MacAddress.h>
+#include <folly/io/Cursor.h>
+
+namespace facebook {
+namespace fboss {
+
+/*
+ * A BFD Control packet, as in RFC 5880 4.1, without the optional
+ * Authentication Section, which we neither send nor accept.
+ */
+struct BfdControlPacket {
+  // The packets are always this long, as there is no Authentication Section
+  enum { LENGTH = 24 };
+  // The UDP destination port of micro-BFD over LAG members (RFC 7130 2.2)
+  enum : uint16_t { kMicroBfdPort = 6784 };
+  enum : uint8_t { kVersion = 1 };
+
+  enum class State : uint8_t {
+    ADMIN_DOWN = 0,
+    DOWN = 1,
+    INIT = 2,
+    UP = 3,
+  };
+
+  enum class Diag : uint8_t {
+    NONE = 0,
+    DETECTION_TIME_EXPIRED = 1,
+    ECHO_FAILED = 2,
+    NEIGHBOR_DOWN = 3,
+    FORWARDING_PLANE_RESET = 4,
+    PATH_DOWN = 5,
+    CONCATENATED_PATH_DOWN = 6,
+    ADMIN_DOWN = 7,
+    REVERSE_CONCATENATED_PATH_DOWN = 8,
+  };
+
+  enum Flags : uint8_t {
+    POLL = 0x20,
+    FINAL = 0x10,
+    CONTROL_PLANE_INDEPENDENT = 0x08,
+    AUTHENTICATION_PRESENT = 0x04,
+    DEMAND = 0x02,
+    MULTIPOINT = 0x01,
+  };
+
+  /*
+   * Reads a packet, throwing std::out_of_range if there isn't enough of it.
+   * It may still not be valid.
+   */
+  static BfdControlPacket from(folly::io::Cursor* cursor);
+  void to(folly::io::RWPrivateCursor* cursor) const;
+
+  /*
+   * The checks of RFC 5880 6.8.6 that don't depend on the session the packet
+   * is for.
+   */
+  bool isValid() const;
+
+  bool hasFlag(Flags flag) const {
+    return flags & flag;
+  }
+
+  std::string describe() const;
+
+  // The destination MAC address of micro-BFD packets (RFC 7130 2.3)
+  static const folly::MacAddress& kMicroBfdDstMac() {
+    static const folly::MacAddress microBfdDstMac("01:00:5e:90:00:01");
+    return microBfdDstMac;
+  }
+
+  uint8_t version{kVersion};
+  Diag diag{Diag::NONE};
+  State state{State::DOWN};
+  uint8_t flags{0};
+  uint8_t detectMult{0};
+  uint8_t length{LENGTH};
+  uint32_t myDiscriminator{0};
+  uint32_t yourDiscriminator{0};
+  std::chrono::microseconds desiredMinTxInterval{0};
+  std::chrono::microseconds requiredMinRxInterval{0};
+  std::chrono::microseconds requiredMinEchoRxInterval{0};
+};
+
+void toAppend(BfdControlPacket::State state, std::string* result);
+std::ostream& operator<<(std::ostream& out, BfdControlPacket::State state);
+
+} // namespace fboss
+} // namespace facebook
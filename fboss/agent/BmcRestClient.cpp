@@ -21,4 +21,8 @@ namespace facebook { namespace fboss {
   bool BmcRestClient::resetCP2112() {
     return(RestClient::request("/api/sys/usb2i2c_reset"));
  }
+
+  folly::Future<bool> BmcRestClient::resetCP2112Async() {
+    return RestClient::requestAsync("/api/sys/usb2i2c_reset");
+  }
 }} // namespace facebook::fboss
@@ -21,6 +21,7 @@ class BmcRestClient: public RestClient {
     * Endpoints for BMC Rest api
     */
     bool resetCP2112();
+    folly::Future<bool> resetCP2112Async();
  };
 
 }} // namespace facebook::fboss
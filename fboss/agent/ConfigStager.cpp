@@ -0,0 +1,180 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "fboss/agent/ConfigStager.h"
+
+#include "fboss/agent/state/AclEntry.h"
+#include "fboss/agent/state/AclMap.h"
+#include "fboss/agent/state/AggregatePortMap.h"
+#include "fboss/agent/state/InterfaceMap.h"
+#include "fboss/agent/state/LoadBalancerMap.h"
+#include "fboss/agent/state/PortMap.h"
+#include "fboss/agent/state/RouteDelta.h"
+#include "fboss/agent/state/SflowCollectorMap.h"
+#include "fboss/agent/state/StateDelta.h"
+#include "fboss/agent/state/SwitchState.h"
+#include "fboss/agent/state/VlanMap.h"
+#include "fboss/agent/state/VlanMapDelta.h"
+
+#include <deque>
+
+namespace facebook { namespace fboss {
+
+namespace {
+
+template <typename Delta>
+int32_t countChanged(const Delta& delta) {
+  int32_t count = 0;
+  for (const auto& entry : delta) {
+    (void)entry;
+    ++count;
+  }
+  return count;
+}
+
+} // unnamed namespace
+
+ConfigStager::ConfigStager(
+    const std::shared_ptr<SwitchState>& oldState,
+    const std::shared_ptr<SwitchState>& newState,
+    uint32_t maxAclChangesPerStage) {
+  if (oldState->getAcls() == newState->getAcls()) {
+    firstStage_ = newState;
+    return;
+  }
+  planAclChanges(oldState, newState, maxAclChangesPerStage);
+  firstStage_ = newState->clone();
+  firstStage_->resetAcls(oldState->getAcls());
+}
+
+void ConfigStager::planAclChanges(
+    const std::shared_ptr<SwitchState>& oldState,
+    const std::shared_ptr<SwitchState>& newState,
+    uint32_t maxAclChangesPerStage) {
+  const auto& oldAcls = oldState->getAcls();
+  const auto& newAcls = newState->getAcls();
+
+  // The entry at each priority, as the changes planned so far leave it
+  std::map<int, std::string> occupants;
+  for (const auto& entry : *oldAcls) {
+    occupants.emplace(entry->getPriority(), entry->getID());
+  }
+
+  std::vector<AclChange> changes;
+  for (const auto& entry : *oldAcls) {
+    if (!newAcls->getEntryIf(entry->getID())) {
+      occupants.erase(entry->getPriority());
+      changes.push_back(AclChange{entry->getID(), nullptr});
+    }
+  }
+
+  // Entries that move to, or are added at, a priority, by that priority
+  struct Pending {
+    std::shared_ptr<AclEntry> entry;
+    std::shared_ptr<AclEntry> old;
+  };
+  std::map<int, Pending> pending;
+  std::deque<int> ready;
+  for (const auto& entry : *newAcls) {
+    auto old = oldAcls->getEntryIf(entry->getID());
+    if (old == entry) {
+      continue;
+    }
+    if (old && old->getPriority() == entry->getPriority()) {
+      changes.push_back(AclChange{entry->getID(), entry});
+      continue;
+    }
+    pending.emplace(entry->getPriority(), Pending{entry, old});
+  }
+  for (const auto& item : pending) {
+    if (occupants.find(item.first) == occupants.end()) {
+      ready.push_back(item.first);
+    }
+  }
+
+  while (!pending.empty()) {
+    while (!ready.empty()) {
+      auto priority = ready.front();
+      ready.pop_front();
+      auto it = pending.find(priority);
+      const auto& entry = it->second.entry;
+      if (it->second.old) {
+        // Moving away frees the entry's old priority for whoever waits on it
+        auto from = it->second.old->getPriority();
+        occupants.erase(from);
+        if (pending.find(from) != pending.end()) {
+          ready.push_back(from);
+        }
+      }
+      occupants[priority] = entry->getID();
+      changes.push_back(AclChange{entry->getID(), entry});
+      pending.erase(it);
+    }
+    if (pending.empty()) {
+      break;
+    }
+    // What is left waits in cycles, every entry on a priority another one
+    // of them holds.  Break one by removing the entry in the way, to add it
+    // again once its own priority is free.
+    auto priority = pending.begin()->first;
+    auto blocker = oldAcls->getEntry(occupants[priority]);
+    auto blocked = pending.find(newAcls->getEntry(blocker->getID())
+        ->getPriority());
+    blocked->second.old = nullptr;
+    occupants.erase(priority);
+    changes.push_back(AclChange{blocker->getID(), nullptr});
+    ready.push_back(priority);
+  }
+
+  auto perStage = maxAclChangesPerStage > 0 ?
+    maxAclChangesPerStage : changes.size();
+  for (size_t start = 0; start < changes.size(); start += perStage) {
+    auto end = std::min(start + perStage, changes.size());
+    aclStages_.emplace_back(
+        std::make_move_iterator(changes.begin() + start),
+        std::make_move_iterator(changes.begin() + end));
+  }
+}
+
+std::shared_ptr<SwitchState> ConfigStager::applyAclStage(
+    size_t stage,
+    const std::shared_ptr<SwitchState>& state) const {
+  auto newState = state;
+  auto acls = newState->getAcls()->modify(&newState);
+  for (const auto& change : aclStages_.at(stage)) {
+    if (!change.entry) {
+      acls->removeEntry(change.name);
+    } else if (acls->getEntryIf(change.name)) {
+      acls->updateNode(change.entry);
+    } else {
+      acls->addEntry(change.entry);
+    }
+  }
+  return newState;
+}
+
+std::map<std::string, int32_t> countStateChanges(const StateDelta& delta) {
+  std::map<std::string, int32_t> changes;
+  changes["ports"] = countChanged(delta.getPortsDelta());
+  changes["aggregatePorts"] = countChanged(delta.getAggregatePortsDelta());
+  changes["vlans"] = countChanged(delta.getVlansDelta());
+  changes["interfaces"] = countChanged(delta.getIntfsDelta());
+  changes["acls"] = countChanged(delta.getAclsDelta());
+  changes["sflowCollectors"] = countChanged(delta.getSflowCollectorsDelta());
+  changes["loadBalancers"] = countChanged(delta.getLoadBalancersDelta());
+  int32_t routes = 0;
+  for (const auto& rtDelta : delta.getRouteTablesDelta()) {
+    routes += countChanged(rtDelta.getRoutesV4Delta());
+    routes += countChanged(rtDelta.getRoutesV6Delta());
+  }
+  changes["routes"] = routes;
+  return changes;
+}
+
+}} // facebook::fboss
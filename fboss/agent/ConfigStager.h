@@ -0,0 +1,80 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace facebook { namespace fboss {
+
+class AclEntry;
+class StateDelta;
+class SwitchState;
+
+/*
+ * Splits the change a new config makes to the switch state into stages, so
+ * that a config touching thousands of ACLs doesn't reach the hardware as one
+ * huge delta that holds up every other state update.
+ *
+ * The first stage is everything but the ACLs, as the other sections refer
+ * to one another and go to the hardware together.  The ACLs follow in
+ * stages of at most maxAclChangesPerStage entries each.  ACL entries are
+ * programmed by priority, so the stages are ordered to never have two
+ * entries at the same priority: an entry only moves to a priority once the
+ * entry there has moved away or been removed.
+ */
+class ConfigStager {
+ public:
+  ConfigStager(const std::shared_ptr<SwitchState>& oldState,
+               const std::shared_ptr<SwitchState>& newState,
+               uint32_t maxAclChangesPerStage);
+
+  const std::shared_ptr<SwitchState>& getFirstStage() const {
+    return firstStage_;
+  }
+
+  size_t numAclStages() const {
+    return aclStages_.size();
+  }
+
+  /*
+   * Applies the ACL changes of a stage to state, which may have had other
+   * updates since the previous stage.  Stages must be applied in order.
+   */
+  std::shared_ptr<SwitchState> applyAclStage(
+      size_t stage,
+      const std::shared_ptr<SwitchState>& state) const;
+
+ private:
+  struct AclChange {
+    std::string name;
+    // null to remove the entry
+    std::shared_ptr<AclEntry> entry;
+  };
+
+  void planAclChanges(
+      const std::shared_ptr<SwitchState>& oldState,
+      const std::shared_ptr<SwitchState>& newState,
+      uint32_t maxAclChangesPerStage);
+
+  std::shared_ptr<SwitchState> firstStage_;
+  std::vector<std::vector<AclChange>> aclStages_;
+};
+
+/*
+ * The number of nodes a delta adds, removes or changes in each section of
+ * the state, as a measure of the work it takes to program.
+ */
+std::map<std::string, int32_t> countStateChanges(const StateDelta& delta);
+
+}} // facebook::fboss
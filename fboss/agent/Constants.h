@@ -28,6 +28,7 @@ auto constexpr kMac = "mac";
 auto constexpr kPaths = "paths";
 auto constexpr kRouteTable = "routeTable";
 auto constexpr kSwSwitch = "swSwitch";
+auto constexpr kWeights = "weights";
 auto constexpr kVrf = "vrf";
 auto constexpr kWarmBootCache = "warmBootCache";
 
@@ -9,6 +9,7 @@
  */
 #include "DHCPv4Handler.h"
 #include <arpa/inet.h>
+#include <algorithm>
 #include <folly/IPAddress.h>
 #include <folly/io/Cursor.h>
 #include <folly/io/IOBuf.h>
@@ -73,14 +74,15 @@ EthHdr makeEthHdr(MacAddress srcMac, MacAddress dstMac, VlanID vlan) {
   return EthHdr(dstMac, srcMac, vlanTags, ETHERTYPE_IPV4);
 }
 
+template<typename DHCPBodyFn>
 void sendDHCPPacket(SwSwitch* sw, const EthHdr& ethHdr, const IPv4Hdr& ipHdr,
-    const UDPHeader& udpHdr, const DHCPv4Packet& dhcpPacket) {
+    const UDPHeader& udpHdr, uint32_t dhcpLength, DHCPBodyFn serializeDhcp) {
   // Allocate packet
   auto txPacket = sw->allocatePacket(
       18 + // ethernet header
       ipHdr.size() +
       udpHdr.size() +
-      dhcpPacket.size());
+      dhcpLength);
   const auto& vlanTags = ethHdr.getVlanTags();
   CHECK(!vlanTags.empty());
 
@@ -96,7 +98,7 @@ void sendDHCPPacket(SwSwitch* sw, const EthHdr& ethHdr, const IPv4Hdr& ipHdr,
   rwCursor.skip(2);
   folly::io::Cursor payloadStart(rwCursor);
 
-  dhcpPacket.write(&rwCursor);
+  serializeDhcp(&rwCursor);
   uint16_t csum = udpHdr.computeChecksum(ipHdr, payloadStart);
   csumCursor.writeBE<uint16_t>(csum);
 
@@ -107,6 +109,14 @@ void sendDHCPPacket(SwSwitch* sw, const EthHdr& ethHdr, const IPv4Hdr& ipHdr,
   sw->sendPacketSwitched(std::move(txPacket));
 }
 
+void sendDHCPPacket(SwSwitch* sw, const EthHdr& ethHdr, const IPv4Hdr& ipHdr,
+    const UDPHeader& udpHdr, const DHCPv4Packet& dhcpPacket) {
+  auto serializeDhcp = [&](RWPrivateCursor* cursor) {
+    dhcpPacket.write(cursor);
+  };
+  sendDHCPPacket(sw, ethHdr, ipHdr, udpHdr, dhcpPacket.size(), serializeDhcp);
+}
+
 int processOption(const DHCPv4Packet::Options& optionsIn, int optIndex,
     DHCPv4Packet& dhcpPacketOut, bool toAppend) {
 
@@ -128,6 +138,16 @@ int processOption(const DHCPv4Packet::Options& optionsIn, int optIndex,
 
 namespace facebook { namespace fboss {
 
+namespace {
+// Offsets in the fixed part of the DHCP packet
+constexpr size_t kHopsOffset = 3;
+constexpr size_t kGiaddrOffset = 24;
+// Incrementing hops is optional for relay agent forwarding,
+// however it seems safer in case of loops. Also seen cases
+// where not incrementing this on the DHCP request causes
+// the server to drop our request.
+constexpr int kMaxHops = 255;
+}
 
 constexpr uint16_t DHCPv4Handler::kBootPSPort;
 constexpr uint16_t DHCPv4Handler::kBootPCPort;
@@ -154,6 +174,20 @@ void DHCPv4Handler::handlePacket(
     return;
   }
 
+  // Requests are relayed straight from the buffer they were received in,
+  // which they fill up to the end of the packet.
+  auto bytes = cursor.peekBytes();
+  if (bytes.size() == cursor.totalLength() &&
+      bytes.size() >= DHCPv4Packet::minSize() &&
+      bytes[0] == BOOTREQUEST &&
+      memcmp(bytes.data() + DHCPv4Packet::kFixedPartBytes,
+             DHCPv4Packet::kOptionsCookie,
+             DHCPv4Packet::kOptionsCookieSize) == 0) {
+    XLOG(DBG4) << " Got boot request ";
+    relayRequest(sw, std::move(pkt), srcMac, ipHdr, bytes);
+    return;
+  }
+
   // Parse dhcp packet
   DHCPv4Packet dhcpPkt;
   try {
@@ -187,56 +221,161 @@ void DHCPv4Handler::handlePacket(
 }
 
 
-void DHCPv4Handler::processRequest(SwSwitch* sw, std::unique_ptr<RxPacket> pkt,
-    MacAddress srcMac, const IPv4Hdr& origIPHdr,
-    const DHCPv4Packet& dhcpPacket) {
-  auto dhcpPacketOut(dhcpPacket);
-  auto state = sw->getState();
+bool DHCPv4Handler::getRelayAddresses(SwSwitch* sw, const RxPacket* pkt,
+    MacAddress srcMac, IPAddressV4* dhcpServer, IPAddressV4* switchIp) {
+  auto state = sw->getStateSnapshot();
   auto vlan = state->getVlans()->getVlanIf(pkt->getSrcVlan());
   if (!vlan) {
     sw->stats()->dhcpV4DropPkt();
     XLOG(DBG4) << " VLAN  " << pkt->getSrcVlan() << " is no longer present "
                << " dropped dhcp packet received on a port in this VLAN";
-    return;
+    return false;
   }
-  auto dhcpServer = vlan->getDhcpV4Relay();
+  *dhcpServer = vlan->getDhcpV4Relay();
 
   XLOG(DBG4) << "srcMac: " << srcMac.toString();
   // look in the override map, and use relevant destination
-  auto dhcpOverrideMap = vlan->getDhcpV4RelayOverrides();
-  if (dhcpOverrideMap.find(srcMac) != dhcpOverrideMap.end()) {
-    dhcpServer = dhcpOverrideMap[srcMac];
-    XLOG(DBG4) << "dhcpServer: " << dhcpServer;
+  const auto& dhcpOverrideMap = vlan->getDhcpV4RelayOverrides();
+  auto dhcpOverride = dhcpOverrideMap.find(srcMac);
+  if (dhcpOverride != dhcpOverrideMap.end()) {
+    *dhcpServer = dhcpOverride->second;
+    XLOG(DBG4) << "dhcpServer: " << *dhcpServer;
   }
 
-  if (dhcpServer.isZero()) {
+  if (dhcpServer->isZero()) {
     sw->stats()->dhcpV4DropPkt();
     XLOG(DBG4) << " No relay configured for VLAN : " << vlan->getID()
                << " dropped dhcp packet ";
-    return;
+    return false;
   }
 
-  auto switchIp = state->getDhcpV4RelaySrc();
-  if (switchIp.isZero()) {
+  *switchIp = state->getDhcpV4RelaySrc();
+  if (switchIp->isZero()) {
     auto vlanInterface = state->getInterfaces()->getInterfaceInVlanIf(
         pkt->getSrcVlan());
     auto& addresses = vlanInterface->getAddresses();
     for (auto address: addresses) {
       if (address.first.isV4()) {
-        switchIp = address.first.asV4();
+        *switchIp = address.first.asV4();
         break;
       }
     }
   }
 
-  if (switchIp.isZero()) {
+  if (switchIp->isZero()) {
     sw->stats()->dhcpV4DropPkt();
     XLOG(ERR) << "Could not find a SVI interface on vlan : "
               << pkt->getSrcVlan() << "DHCP packet dropped ";
+    return false;
+  }
+
+  XLOG(DBG4) << " Got switch ip : " << *switchIp;
+  return true;
+}
+
+void DHCPv4Handler::relayRequest(SwSwitch* sw, std::unique_ptr<RxPacket> pkt,
+    MacAddress srcMac, const IPv4Hdr& origIPHdr, folly::ByteRange request) {
+  IPAddressV4 dhcpServer;
+  IPAddressV4 switchIp;
+  if (!getRelayAddresses(sw, pkt.get(), srcMac, &dhcpServer, &switchIp)) {
+    return;
+  }
+
+  // Check the options as addAgentOptions() does, finding the end of the
+  // ones that are copied
+  const uint8_t* options = request.data() + DHCPv4Packet::minSize();
+  size_t optionsLen = request.size() - DHCPv4Packet::minSize();
+  size_t copyLen = 0;
+  bool isDHCP = false;
+  bool valid = true;
+  uint16_t maxMsgSize = 0;
+  while (copyLen < optionsLen && options[copyLen] != END) {
+    uint8_t op = options[copyLen];
+    if (DHCPv4Packet::isOptionWithoutLength(op)) {
+      ++copyLen;
+      continue;
+    }
+    if (copyLen + 2 > optionsLen ||
+        copyLen + 2 + options[copyLen + 1] > optionsLen) {
+      valid = false;
+      break;
+    }
+    uint8_t optLen = options[copyLen + 1];
+    const uint8_t* optBytes = options + copyLen + 2;
+    if (op == DHCP_MESSAGE_TYPE) {
+      isDHCP = true;
+    } else if (op == DHCP_MAX_MESSAGE_SIZE && optLen >= 2) {
+      maxMsgSize = (static_cast<uint16_t>(optBytes[0]) << 8) | optBytes[1];
+    } else if (op == DHCP_AGENT_OPTIONS && isDHCP) {
+      // FIXME We should really forward this along unchanged.
+      // see t3862629 for details.
+      LOG (INFO) <<" Agent options already present dropping DHCP packet";
+      valid = false;
+      break;
+    }
+    copyLen += 2 + optLen;
+  }
+
+  uint8_t agentOption[] = {
+      DHCP_AGENT_OPTIONS,
+      static_cast<uint8_t>(2 + IPAddressV4::byteCount()),
+      AGENT_CIRCUIT_ID,
+      static_cast<uint8_t>(IPAddressV4::byteCount()),
+      0, 0, 0, 0};
+  memcpy(agentOption + 4, switchIp.bytes(), IPAddressV4::byteCount());
+  size_t unpaddedLen =
+      DHCPv4Packet::minSize() + copyLen + sizeof(agentOption) + 1;
+  size_t dhcpLen = std::max<size_t>(unpaddedLen, DHCPv4Packet::kMinSize);
+  if (!valid || !isDHCP || (maxMsgSize && dhcpLen > maxMsgSize)) {
+    sw->portStats(pkt->getSrcPort())->dhcpV4BadPkt();
+    XLOG(DBG4) << "Bad DHCP packet, error adding agent options."
+               << " DHCP packet dropped";
+    return;
+  }
+  uint8_t hops = request[kHopsOffset];
+  if (hops >= kMaxHops) {
+    XLOG(DBG4) << "Max hops exceeded for dhcp packet";
+    sw->portStats(pkt->getSrcPort())->dhcpV4BadPkt();
+    return;
+  }
+
+  // The request with hops and giaddr updated, the options before the end,
+  // the agent option, the end and then padding
+  auto serializeDhcp = [&](RWPrivateCursor* cursor) {
+    cursor->push(request.data(), kHopsOffset);
+    cursor->write<uint8_t>(hops + 1);
+    cursor->push(request.data() + kHopsOffset + 1,
+                 kGiaddrOffset - kHopsOffset - 1);
+    cursor->push(switchIp.bytes(), IPAddressV4::byteCount());
+    auto rest = kGiaddrOffset + IPAddressV4::byteCount();
+    cursor->push(request.data() + rest,
+                 DHCPv4Packet::minSize() + copyLen - rest);
+    cursor->push(agentOption, sizeof(agentOption));
+    cursor->write<uint8_t>(END);
+    for (size_t i = unpaddedLen; i < dhcpLen; ++i) {
+      cursor->write<uint8_t>(PAD);
+    }
+  };
+
+  // Look up cpu mac from platform
+  MacAddress cpuMac = sw->getPlatform()->getLocalMac();
+  EthHdr ethHdr = makeEthHdr(cpuMac, cpuMac, pkt->getSrcVlan());
+  auto ipHdr = makeIpv4Header(switchIp, dhcpServer, origIPHdr.ttl - 1,
+      IPv4Hdr::minSize() + UDPHeader::size() + dhcpLen);
+  UDPHeader udpHdr(kBootPSPort, kBootPSPort, UDPHeader::size() + dhcpLen);
+  sendDHCPPacket(sw, ethHdr, ipHdr, udpHdr, dhcpLen, serializeDhcp);
+}
+
+void DHCPv4Handler::processRequest(SwSwitch* sw, std::unique_ptr<RxPacket> pkt,
+    MacAddress srcMac, const IPv4Hdr& origIPHdr,
+    const DHCPv4Packet& dhcpPacket) {
+  auto dhcpPacketOut(dhcpPacket);
+  IPAddressV4 dhcpServer;
+  IPAddressV4 switchIp;
+  if (!getRelayAddresses(sw, pkt.get(), srcMac, &dhcpServer, &switchIp)) {
     return;
   }
 
-  XLOG(DBG4) << " Got switch ip : " << switchIp;
   // Prepare DHCP packet to relay
   if (!addAgentOptions(sw, pkt->getSrcPort(), switchIp, dhcpPacket,
         dhcpPacketOut)) {
@@ -245,11 +384,6 @@ void DHCPv4Handler::processRequest(SwSwitch* sw, std::unique_ptr<RxPacket> pkt,
                << " DHCP packet dropped";
     return;
   }
-  // Incrementing hops is optional for relay agent forwarding,
-  // however it seems safer in case of loops. Also seen cases
-  // where not incrementing this on the DHCP request causes
-  // the server to drop our request.
-  const int kMaxHops = 255;
   if (dhcpPacketOut.hops < kMaxHops) {
     dhcpPacketOut.hops++;
   } else {
@@ -340,7 +474,10 @@ bool DHCPv4Handler::addAgentOptions(
         isDHCP = true;
         break;
       case DHCP_MAX_MESSAGE_SIZE:
-        maxMsgSize = ntohs(optionsIn[optIndex + 2]);
+        if (optIndex + 3 < optionsIn.size()) {
+          maxMsgSize = (static_cast<uint16_t>(optionsIn[optIndex + 2]) << 8) |
+              optionsIn[optIndex + 3];
+        }
         break;
       case DHCP_AGENT_OPTIONS:
         if (isDHCP) {
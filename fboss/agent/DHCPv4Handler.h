@@ -10,6 +10,7 @@
 #pragma once
 #include <stdint.h>
 #include <memory>
+#include <folly/Range.h>
 #include <folly/io/Cursor.h>
 #include <folly/IPAddressV4.h>
 #include <folly/MacAddress.h>
@@ -43,6 +44,22 @@ class DHCPv4Handler {
       folly::MacAddress dstMac,
       const IPv4Hdr& ipHdr, const UDPHeader& udpHdr, folly::io::Cursor cursor);
  private:
+  /*
+   * Relay a DHCP request that is in one buffer by copying it into the
+   * relayed packet with the agent option added, without parsing it into a
+   * DHCPv4Packet.
+   */
+  static void relayRequest(SwSwitch* sw, std::unique_ptr<RxPacket> pkt,
+      folly::MacAddress srcMac, const IPv4Hdr& ipHdr,
+      folly::ByteRange request);
+  /*
+   * Find the server to relay a request from srcMac to, and the switch IP
+   * to relay it from.  Returns false, having counted the drop, if there
+   * isn't one.
+   */
+  static bool getRelayAddresses(SwSwitch* sw, const RxPacket* pkt,
+      folly::MacAddress srcMac, folly::IPAddressV4* dhcpServer,
+      folly::IPAddressV4* switchIp);
   static void processRequest(SwSwitch* sw, std::unique_ptr<RxPacket> pkt,
       folly::MacAddress srcMac, const IPv4Hdr& ipHdr,
       const DHCPv4Packet& dhcpPacket);
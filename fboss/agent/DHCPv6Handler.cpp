@@ -120,6 +120,18 @@ void DHCPv6Handler::handlePacket(
     const UDPHeader& /*udpHdr*/,
     Cursor cursor) {
   sw->portStats(pkt->getSrcPort())->dhcpV6Pkt();
+  // Client messages are relayed without being parsed
+  if (cursor.totalLength() >=
+      DHCPv6Packet::TYPE_BYTES + DHCPv6Packet::TRANSACTIONID_BYTES) {
+    auto type = Cursor(cursor).read<uint8_t>();
+    if (type != DHCPv6_RELAY_FORWARD && type != DHCPv6_RELAY_REPLY) {
+      XLOG(DBG4) << "Received DHCPv6 packet: type: " << (int)type
+                 << " length: " << cursor.totalLength();
+      processDHCPv6Packet(sw, std::move(pkt), srcMac, dstMac, ipHdr, cursor);
+      return;
+    }
+  }
+
   // Parse dhcp packet
   DHCPv6Packet dhcp6Pkt;
   try {
@@ -133,13 +145,10 @@ void DHCPv6Handler::handlePacket(
                << dhcp6Pkt.toString();
     processDHCPv6RelayForward(sw, std::move(pkt), srcMac, dstMac,
                              ipHdr, dhcp6Pkt);
-  } else if (dhcp6Pkt.type == DHCPv6_RELAY_REPLY) {
+  } else {
     XLOG(DBG4) << "Received DHCPv6 relay reply packet: " << dhcp6Pkt.toString();
     processDHCPv6RelayReply(sw, std::move(pkt), srcMac, dstMac,
                              ipHdr, dhcp6Pkt);
-  } else {
-    XLOG(DBG4) << "Received DHCPv6 packet: " << dhcp6Pkt.toString();
-    processDHCPv6Packet(sw, std::move(pkt), srcMac, dstMac, ipHdr, dhcp6Pkt);
   }
 }
 
@@ -149,9 +158,9 @@ void DHCPv6Handler::processDHCPv6Packet(
     MacAddress srcMac,
     MacAddress /*dstMac*/,
     const IPv6Hdr& ipHdr,
-    const DHCPv6Packet& dhcpPacket) {
+    Cursor cursor) {
   auto vlanId = pkt->getSrcVlan();
-  auto states = sw->getState();
+  auto states = sw->getStateSnapshot();
   auto vlan = states->getVlans()->getVlanIf(vlanId);
   if (!vlan) {
     sw->stats()->dhcpV6DropPkt();
@@ -164,8 +173,8 @@ void DHCPv6Handler::processDHCPv6Packet(
 
   // look in the override map, and use relevant destination
   XLOG(DBG4) << "srcMac: " << srcMac.toString();
-  auto dhcpOverrideMap = vlan->getDhcpV6RelayOverrides();
-  for (auto o : dhcpOverrideMap) {
+  const auto& dhcpOverrideMap = vlan->getDhcpV6RelayOverrides();
+  for (const auto& o : dhcpOverrideMap) {
     if (MacAddress(o.first) == srcMac) {
       dhcp6ServerIp = o.second;
       XLOG(DBG4) << "dhcp6ServerIp: " << dhcp6ServerIp;
@@ -185,19 +194,12 @@ void DHCPv6Handler::processDHCPv6Packet(
     switchIp = getSwitchVlanIPv6(states, vlanId);
   }
 
-  // link address set to unspecified
-  IPAddressV6 la("::");
-  // ip src -> peer-address
-  IPAddressV6 pa = ipHdr.srcAddr;
-  DHCPv6Packet relayFwdPkt(DHCPv6_RELAY_FORWARD, 0, la, pa);
-
-  // use the client src mac address as the interface id
-  relayFwdPkt.addInterfaceIDOption(srcMac);
-  // add relay message option
-  relayFwdPkt.addRelayMessageOption(dhcpPacket);
-
-  if (relayFwdPkt.computePacketLength() >
-      DHCPv6Packet::MAX_DHCPV6_MSG_LENGTH) {
+  // relay header, interface id option and relay message option
+  size_t msgLen = cursor.totalLength();
+  size_t relayFwdLen = DHCPv6Packet::TYPE_BYTES +
+      DHCPv6Packet::HOPCOUNT_BYTES + DHCPv6Packet::LINKADDR_BYTES +
+      DHCPv6Packet::PEERADDR_BYTES + 4 + MacAddress::SIZE + 4 + msgLen;
+  if (relayFwdLen > DHCPv6Packet::MAX_DHCPV6_MSG_LENGTH) {
     XLOG(DBG2) << "DHCPv6 relay forward message exceeds max length, drop it.";
     sw->portStats(pkt->getSrcPort())->dhcpV6BadPkt();
     return;
@@ -207,13 +209,26 @@ void DHCPv6Handler::processDHCPv6Packet(
   // vlanIp -> ip src, ipHdr.dst -> ip dst, srcMac -> mac src, dstMac -> mac dst
   MacAddress cpuMac = sw->getPlatform()->getLocalMac();
   auto serializeBody = [&](RWPrivateCursor* sendCursor) {
-    relayFwdPkt.write(sendCursor);
+    sendCursor->write<uint8_t>(DHCPv6_RELAY_FORWARD);
+    sendCursor->write<uint8_t>(0);
+    // link address set to unspecified
+    sendCursor->push(IPAddressV6("::").bytes(), IPAddressV6::byteCount());
+    // ip src -> peer-address
+    sendCursor->push(ipHdr.srcAddr.bytes(), IPAddressV6::byteCount());
+    // use the client src mac address as the interface id
+    sendCursor->writeBE<uint16_t>(DHCPv6_OPTION_INTERFACE_ID);
+    sendCursor->writeBE<uint16_t>(MacAddress::SIZE);
+    sendCursor->push(srcMac.bytes(), MacAddress::SIZE);
+    // relay message option
+    sendCursor->writeBE<uint16_t>(DHCPv6_OPTION_RELAY_MSG);
+    sendCursor->writeBE<uint16_t>(msgLen);
+    sendCursor->push(cursor, msgLen);
   };
 
   sendDHCPv6Packet(sw, cpuMac, cpuMac, vlanId, dhcp6ServerIp, switchIp,
       DHCPv6Packet::DHCP6_SERVERAGENT_UDPPORT,
       DHCPv6Packet::DHCP6_SERVERAGENT_UDPPORT,
-      relayFwdPkt.computePacketLength(), serializeBody);
+      relayFwdLen, serializeBody);
 }
 
 void DHCPv6Handler::processDHCPv6RelayForward(SwSwitch* sw,
@@ -38,11 +38,14 @@ class DHCPv6Handler {
  private:
   /**
    * process DHCPv6 packet from client and send relay forward
+   *
+   * The client message is relayed as received, so it is copied from the
+   * cursor into the relay message option without being parsed.
    */
   static void processDHCPv6Packet(SwSwitch* sw, std::unique_ptr<RxPacket> pkt,
       folly::MacAddress srcMac,
       folly::MacAddress dstMac,
-      const IPv6Hdr& ipHdr, const DHCPv6Packet& dhcpPacket);
+      const IPv6Hdr& ipHdr, folly::io::Cursor cursor);
 
   /**
    * process relay reply from server or relay forward message from other agents
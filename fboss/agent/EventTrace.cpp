@@ -0,0 +1,227 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "fboss/agent/EventTrace.h"
+
+#include <folly/Conv.h>
+#include <folly/FileUtil.h>
+#include <folly/system/ThreadId.h>
+#include <folly/system/ThreadName.h>
+
+#include <algorithm>
+#include <memory>
+#include <mutex>
+
+DEFINE_bool(event_tracing, true,
+            "Keep the latest hot path events of each thread in a binary "
+            "trace, dumped over thrift and on a fatal error");
+
+using std::chrono::duration_cast;
+using std::chrono::microseconds;
+using std::chrono::steady_clock;
+using std::chrono::system_clock;
+
+namespace facebook { namespace fboss {
+
+constexpr size_t EventTrace::kRecordsPerThread;
+
+std::atomic<bool> EventTrace::enabled_{true};
+
+struct EventTrace::Registry {
+  std::mutex lock;
+  std::vector<std::unique_ptr<Buffer>> buffers;
+};
+
+/*
+ * The cycle counter and the clocks at the same moment, to turn cycles into
+ * times with
+ */
+struct EventTrace::Epoch {
+  uint64_t cycles;
+  steady_clock::time_point steady;
+  system_clock::time_point system;
+};
+
+EventTrace::Registry* EventTrace::getRegistry() {
+  // Intentionally leaked, so events can be recorded during shutdown
+  static auto* registry = new Registry();
+  return registry;
+}
+
+const EventTrace::Epoch& EventTrace::getEpoch() {
+  static const Epoch epoch{
+      readCycles(), steady_clock::now(), system_clock::now()};
+  return epoch;
+}
+
+uint64_t EventTrace::addressArg(const folly::IPAddressV6& addr) {
+  uint64_t arg = 0;
+  for (size_t i = 8; i < 16; ++i) {
+    arg = arg << 8 | addr.bytes()[i];
+  }
+  return arg;
+}
+
+void EventTrace::setEnabled(bool enabled) {
+  enabled_.store(enabled, std::memory_order_relaxed);
+}
+
+EventTrace::Buffer* EventTrace::threadBuffer() {
+  // Hands the buffer back for reuse when the thread exits
+  struct ThreadBuffer {
+    ~ThreadBuffer() {
+      if (buffer) {
+        std::lock_guard<std::mutex> guard(getRegistry()->lock);
+        buffer->inUse = false;
+      }
+    }
+    Buffer* buffer{nullptr};
+  };
+  static thread_local ThreadBuffer owned;
+  if (!owned.buffer) {
+    owned.buffer = acquireBuffer();
+  }
+  return owned.buffer;
+}
+
+EventTrace::Buffer* EventTrace::acquireBuffer() {
+  // Before the first record, so that no record is older than the epoch
+  getEpoch();
+  auto* registry = getRegistry();
+  std::lock_guard<std::mutex> guard(registry->lock);
+  Buffer* buffer = nullptr;
+  for (auto& unused : registry->buffers) {
+    if (!unused->inUse) {
+      buffer = unused.get();
+      break;
+    }
+  }
+  if (!buffer) {
+    registry->buffers.push_back(std::make_unique<Buffer>());
+    buffer = registry->buffers.back().get();
+  }
+  buffer->next.store(0, std::memory_order_relaxed);
+  buffer->threadId = folly::getOSThreadID();
+  buffer->threadName = folly::getCurrentThreadName().value_or("");
+  buffer->inUse = true;
+  return buffer;
+}
+
+std::vector<EventTrace::Entry> EventTrace::dump() {
+  std::vector<Entry> entries;
+  auto* registry = getRegistry();
+  std::vector<Record> records;
+  std::lock_guard<std::mutex> guard(registry->lock);
+  if (registry->buffers.empty()) {
+    return entries;
+  }
+
+  // The rate of the cycle counter, measured since the epoch
+  const auto& epoch = getEpoch();
+  auto cycles = readCycles();
+  auto elapsed = duration_cast<microseconds>(steady_clock::now() -
+                                             epoch.steady).count();
+  double cyclesPerUs = 1;
+  if (elapsed > 0 && cycles > epoch.cycles) {
+    cyclesPerUs = static_cast<double>(cycles - epoch.cycles) / elapsed;
+  }
+  auto epochUs =
+      duration_cast<microseconds>(epoch.system.time_since_epoch()).count();
+
+  for (const auto& buffer : registry->buffers) {
+    auto end = buffer->next.load(std::memory_order_acquire);
+    auto begin = end > kRecordsPerThread ? end - kRecordsPerThread : 0;
+    records.clear();
+    for (auto i = begin; i < end; ++i) {
+      records.push_back(buffer->records[i % kRecordsPerThread]);
+    }
+    // Those the thread went on to write over while they were copied,
+    // including the one it may be writing now, which is published as
+    // record written but is stored over record written - kRecordsPerThread
+    std::atomic_thread_fence(std::memory_order_acquire);
+    auto written = buffer->next.load(std::memory_order_relaxed);
+    auto valid =
+        written + 1 > kRecordsPerThread ? written + 1 - kRecordsPerThread : 0;
+    for (auto i = std::max(begin, valid); i < end; ++i) {
+      const auto& record = records[i - begin];
+      Entry entry;
+      auto sinceEpoch = static_cast<int64_t>(record.cycles - epoch.cycles);
+      entry.timestampUs = epochUs + static_cast<int64_t>(
+          sinceEpoch / cyclesPerUs);
+      entry.threadId = buffer->threadId;
+      entry.threadName = buffer->threadName;
+      entry.event = record.event;
+      entry.arg0 = record.arg0;
+      entry.arg1 = record.arg1;
+      entries.push_back(std::move(entry));
+    }
+  }
+  std::stable_sort(
+      entries.begin(), entries.end(), [](const Entry& a, const Entry& b) {
+        return a.timestampUs < b.timestampUs;
+      });
+  return entries;
+}
+
+bool EventTrace::dumpToFile(const std::string& filename) {
+  std::string out;
+  for (const auto& entry : dump()) {
+    folly::toAppend(
+        entry.timestampUs, " ", entry.threadId, " ", entry.threadName, " ",
+        eventName(entry.event), " ", &out);
+    if (entry.event == Event::HW_PHASE_START ||
+        entry.event == Event::HW_PHASE_END) {
+      folly::toAppend(hwPhaseName(entry.arg0), &out);
+    } else {
+      folly::toAppend(entry.arg0, &out);
+    }
+    folly::toAppend(" ", entry.arg1, "\n", &out);
+  }
+  return folly::writeFile(out, filename.c_str());
+}
+
+folly::StringPiece EventTrace::eventName(Event event) {
+  switch (event) {
+    case Event::STATE_UPDATE_START:
+      return "state_update_start";
+    case Event::STATE_UPDATE_END:
+      return "state_update_end";
+    case Event::HW_UPDATE_START:
+      return "hw_update_start";
+    case Event::HW_UPDATE_END:
+      return "hw_update_end";
+    case Event::HW_PHASE_START:
+      return "hw_phase_start";
+    case Event::HW_PHASE_END:
+      return "hw_phase_end";
+    case Event::PACKET_RX:
+      return "packet_rx";
+    case Event::NEIGHBOR_STATE:
+      return "neighbor_state";
+  }
+  return "unknown";
+}
+
+folly::StringPiece EventTrace::hwPhaseName(uint32_t phase) {
+  switch (static_cast<HwPhase>(phase)) {
+    case HwPhase::REMOVED_ROUTES:
+      return "removed_routes";
+    case HwPhase::NEIGHBORS:
+      return "neighbors";
+    case HwPhase::ACLS:
+      return "acls";
+    case HwPhase::ADDED_CHANGED_ROUTES:
+      return "added_changed_routes";
+    case HwPhase::PORTS:
+      return "ports";
+  }
+  return "unknown";
+}
+
+}} // facebook::fboss
@@ -0,0 +1,186 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#pragma once
+
+#include <folly/IPAddressV4.h>
+#include <folly/IPAddressV6.h>
+#include <folly/Range.h>
+#include <gflags/gflags.h>
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#if defined(__x86_64__)
+#include <x86intrin.h>
+#endif
+
+DECLARE_bool(event_tracing);
+
+namespace facebook { namespace fboss {
+
+/*
+ * EventTrace keeps the latest hot path events of each thread, such as
+ * state updates, hardware programming phases, packets and neighbor
+ * transitions, in a binary ring, so that detailed tracing can stay on in
+ * production where logging every event would cost too much.
+ *
+ * Recording an event writes one fixed-size record, stamped with the CPU
+ * cycle counter, to a buffer owned by the thread: no lock, no allocation
+ * and no formatting.  The records are only decoded when the trace is
+ * dumped, over thrift or to a file when the agent exits on a fatal error.
+ * Each thread keeps its last kRecordsPerThread events, and the buffer of a
+ * thread that exits is reused, records cleared, by the next new thread.
+ */
+class EventTrace {
+ public:
+  enum class Event : uint16_t {
+    // arg0: the generation of the new state
+    STATE_UPDATE_START,
+    // arg0: the generation of the new state, arg1: microseconds taken
+    STATE_UPDATE_END,
+    HW_UPDATE_START,
+    // arg1: microseconds taken
+    HW_UPDATE_END,
+    // arg0: the HwPhase
+    HW_PHASE_START,
+    HW_PHASE_END,
+    // arg0: the source port, arg1: the length of the packet
+    PACKET_RX,
+    // arg0: the VLAN and the NeighborEntryState it entered, as
+    // vlan << 8 | state, arg1: addressArg() of the neighbor
+    NEIGHBOR_STATE,
+  };
+
+  // The steps of programming a state update in hardware
+  enum class HwPhase : uint32_t {
+    REMOVED_ROUTES,
+    NEIGHBORS,
+    ACLS,
+    ADDED_CHANGED_ROUTES,
+    PORTS,
+  };
+
+  struct Record {
+    uint64_t cycles;
+    Event event;
+    uint32_t arg0;
+    uint64_t arg1;
+  };
+
+  // A decoded record
+  struct Entry {
+    // Microseconds since the epoch
+    int64_t timestampUs{0};
+    uint64_t threadId{0};
+    std::string threadName;
+    Event event;
+    uint32_t arg0{0};
+    uint64_t arg1{0};
+  };
+
+  static constexpr size_t kRecordsPerThread = 4096;
+
+  /*
+   * Records the phase from construction to destruction.
+   */
+  class Scope {
+   public:
+    explicit Scope(HwPhase phase) : phase_(static_cast<uint32_t>(phase)) {
+      record(Event::HW_PHASE_START, phase_);
+    }
+    ~Scope() {
+      record(Event::HW_PHASE_END, phase_);
+    }
+
+   private:
+    // Forbidden copy constructor and assignment operator
+    Scope(Scope const &) = delete;
+    Scope& operator=(Scope const &) = delete;
+
+    const uint32_t phase_;
+  };
+
+  static void record(Event event, uint32_t arg0 = 0, uint64_t arg1 = 0) {
+    if (!enabled_.load(std::memory_order_relaxed)) {
+      return;
+    }
+    auto* buffer = threadBuffer();
+    auto next = buffer->next.load(std::memory_order_relaxed);
+    auto& record = buffer->records[next % kRecordsPerThread];
+    record.cycles = readCycles();
+    record.event = event;
+    record.arg0 = arg0;
+    record.arg1 = arg1;
+    buffer->next.store(next + 1, std::memory_order_release);
+  }
+
+  // An address as an event argument: IPv6 addresses keep their low 64 bits
+  static uint64_t addressArg(const folly::IPAddressV4& addr) {
+    return addr.toLongHBO();
+  }
+  static uint64_t addressArg(const folly::IPAddressV6& addr);
+
+  static bool isEnabled() {
+    return enabled_.load(std::memory_order_relaxed);
+  }
+  static void setEnabled(bool enabled);
+
+  /*
+   * The events of all threads, oldest first.  Records being overwritten
+   * while they are read are left out, and so is the oldest record of a full
+   * buffer, which its thread may be overwriting.
+   */
+  static std::vector<Entry> dump();
+
+  /*
+   * Writes the events, one per line, to a file.  Returns false if it can't
+   * be written.
+   */
+  static bool dumpToFile(const std::string& filename);
+
+  static folly::StringPiece eventName(Event event);
+  static folly::StringPiece hwPhaseName(uint32_t phase);
+
+ private:
+  struct Buffer {
+    std::array<Record, kRecordsPerThread> records;
+    // The number of records ever written to the buffer
+    std::atomic<uint64_t> next{0};
+    // Of the thread that owns the buffer
+    uint64_t threadId{0};
+    std::string threadName;
+    bool inUse{false};
+  };
+
+  static uint64_t readCycles() {
+#if defined(__x86_64__)
+    return __rdtsc();
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+  }
+
+  struct Registry;
+  struct Epoch;
+
+  static Buffer* threadBuffer();
+  static Buffer* acquireBuffer();
+  static Registry* getRegistry();
+  static const Epoch& getEpoch();
+
+  static std::atomic<bool> enabled_;
+};
+
+}} // facebook::fboss
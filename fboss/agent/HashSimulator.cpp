@@ -0,0 +1,214 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "fboss/agent/HashSimulator.h"
+
+#include "fboss/agent/FbossError.h"
+#include "fboss/agent/packet/Ethertype.h"
+#include "fboss/agent/packet/IPProto.h"
+#include "fboss/agent/packet/ParsedPacket.h"
+
+#include <folly/io/Cursor.h>
+#include <folly/io/IOBuf.h>
+
+#include <algorithm>
+#include <numeric>
+
+using folly::IOBuf;
+using folly::io::Cursor;
+
+namespace facebook { namespace fboss {
+
+namespace {
+
+constexpr uint32_t kTransportPortsLen = 4;
+
+// CRC16-CCITT, polynomial 0x1021, most significant bit first
+uint16_t crc16Ccitt(uint16_t crc, const uint8_t* data, size_t length) {
+  for (size_t i = 0; i < length; ++i) {
+    crc ^= static_cast<uint16_t>(data[i]) << 8;
+    for (int bit = 0; bit < 8; ++bit) {
+      crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+    }
+  }
+  return crc;
+}
+
+// The hash key, the selected fields back to back in network byte order
+class HashKey {
+ public:
+  void add(const folly::IPAddress& addr) {
+    append(addr.bytes(), addr.byteCount());
+  }
+  void add(uint16_t value) {
+    uint8_t bytes[] = {uint8_t(value >> 8), uint8_t(value)};
+    append(bytes, sizeof(bytes));
+  }
+  void addFlowLabel(uint32_t label) {
+    uint8_t bytes[] = {uint8_t(label >> 16), uint8_t(label >> 8),
+                       uint8_t(label)};
+    append(bytes, sizeof(bytes));
+  }
+
+  const uint8_t* data() const {
+    return bytes_;
+  }
+  size_t size() const {
+    return size_;
+  }
+
+ private:
+  void append(const uint8_t* bytes, size_t length) {
+    std::copy(bytes, bytes + length, bytes_ + size_);
+    size_ += length;
+  }
+
+  // Both IPv6 addresses, the flow label and the ports
+  uint8_t bytes_[16 + 16 + 3 + 4];
+  size_t size_{0};
+};
+
+} // unnamed namespace
+
+folly::Optional<HashFlow> HashFlow::fromPacket(const IOBuf* buf) {
+  auto parsed = ParsedPacket::parse(buf);
+  if (!parsed.isValid() || (parsed.etherType != ETHERTYPE_IPV4 &&
+                            parsed.etherType != ETHERTYPE_IPV6)) {
+    return folly::none;
+  }
+  // parse() checked that the fixed IP header is all there
+  HashFlow flow;
+  flow.protocol = parsed.ipProtocol;
+  Cursor cursor(buf);
+  cursor.skip(parsed.l3Offset);
+  if (parsed.etherType == ETHERTYPE_IPV4) {
+    uint8_t addrs[8];
+    cursor.skip(12);
+    cursor.pull(addrs, sizeof(addrs));
+    flow.srcIp = folly::IPAddressV4::fromBinary(folly::ByteRange(addrs, 4));
+    flow.dstIp =
+        folly::IPAddressV4::fromBinary(folly::ByteRange(addrs + 4, 4));
+  } else {
+    uint8_t addrs[32];
+    flow.flowLabel = cursor.readBE<uint32_t>() & 0xFFFFF;
+    cursor.skip(4);
+    cursor.pull(addrs, sizeof(addrs));
+    flow.srcIp = folly::IPAddressV6::fromBinary(folly::ByteRange(addrs, 16));
+    flow.dstIp =
+        folly::IPAddressV6::fromBinary(folly::ByteRange(addrs + 16, 16));
+  }
+  // parse() only checks that UDP headers are all there, and samples are
+  // often cut short, so check for the ports here
+  if (parsed.hasL4() &&
+      (flow.protocol == IP_PROTO_TCP || flow.protocol == IP_PROTO_UDP) &&
+      buf->computeChainDataLength() >=
+          parsed.l4Offset + kTransportPortsLen) {
+    Cursor l4(buf);
+    l4.skip(parsed.l4Offset);
+    flow.hasPorts = true;
+    flow.srcPort = l4.readBE<uint16_t>();
+    flow.dstPort = l4.readBE<uint16_t>();
+  }
+  return flow;
+}
+
+HashSimulator::HashSimulator(
+    const LoadBalancer& loadBalancer,
+    size_t numMembers)
+    : v4Fields_(
+          loadBalancer.getIPv4Fields().begin(),
+          loadBalancer.getIPv4Fields().end()),
+      v6Fields_(
+          loadBalancer.getIPv6Fields().begin(),
+          loadBalancer.getIPv6Fields().end()),
+      transportFields_(
+          loadBalancer.getTransportFields().begin(),
+          loadBalancer.getTransportFields().end()),
+      // The hardware takes a 16 bit seed
+      seed_(loadBalancer.getSeed() ^ (loadBalancer.getSeed() >> 16)),
+      loads_(numMembers, 0) {
+  if (numMembers == 0) {
+    throw FbossError("a hash simulation needs at least one member");
+  }
+  switch (loadBalancer.getAlgorithm()) {
+    case cfg::HashingAlgorithm::CRC16_CCITT:
+      break;
+    default:
+      throw FbossError(
+          "no model of hashing algorithm ",
+          static_cast<int>(loadBalancer.getAlgorithm()));
+  }
+}
+
+uint16_t HashSimulator::hash(const HashFlow& flow) const {
+  HashKey key;
+  if (flow.srcIp.isV4()) {
+    if (v4Fields_.count(LoadBalancer::IPv4Field::SOURCE_ADDRESS)) {
+      key.add(flow.srcIp);
+    }
+    if (v4Fields_.count(LoadBalancer::IPv4Field::DESTINATION_ADDRESS)) {
+      key.add(flow.dstIp);
+    }
+  } else {
+    if (v6Fields_.count(LoadBalancer::IPv6Field::SOURCE_ADDRESS)) {
+      key.add(flow.srcIp);
+    }
+    if (v6Fields_.count(LoadBalancer::IPv6Field::DESTINATION_ADDRESS)) {
+      key.add(flow.dstIp);
+    }
+    if (v6Fields_.count(LoadBalancer::IPv6Field::FLOW_LABEL)) {
+      key.addFlowLabel(flow.flowLabel);
+    }
+  }
+  if (flow.hasPorts) {
+    if (transportFields_.count(LoadBalancer::TransportField::SOURCE_PORT)) {
+      key.add(flow.srcPort);
+    }
+    if (transportFields_.count(
+            LoadBalancer::TransportField::DESTINATION_PORT)) {
+      key.add(flow.dstPort);
+    }
+  }
+  return crc16Ccitt(seed_, key.data(), key.size());
+}
+
+void HashSimulator::addFlow(const HashFlow& flow, uint64_t weight) {
+  loads_[getMember(flow)] += weight;
+  ++numFlows_;
+}
+
+bool HashSimulator::addPacket(const IOBuf* buf, uint64_t weight) {
+  auto flow = HashFlow::fromPacket(buf);
+  if (!flow) {
+    ++numUnhashed_;
+    return false;
+  }
+  addFlow(*flow, weight);
+  return true;
+}
+
+double HashSimulator::getMaxImbalance() const {
+  auto total = std::accumulate(loads_.begin(), loads_.end(), uint64_t(0));
+  if (total == 0) {
+    return 0;
+  }
+  auto max = *std::max_element(loads_.begin(), loads_.end());
+  return static_cast<double>(max) * loads_.size() / total;
+}
+
+HashDistribution HashSimulator::toThrift() const {
+  HashDistribution distribution;
+  distribution.memberLoads.assign(loads_.begin(), loads_.end());
+  distribution.numFlows = numFlows_;
+  distribution.numUnhashed = numUnhashed_;
+  distribution.maxImbalance = getMaxImbalance();
+  return distribution;
+}
+
+}} // facebook::fboss
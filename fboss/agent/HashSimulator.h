@@ -0,0 +1,108 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#pragma once
+
+#include "fboss/agent/if/gen-cpp2/ctrl_types.h"
+#include "fboss/agent/state/LoadBalancer.h"
+
+#include <folly/IPAddress.h>
+#include <folly/Optional.h>
+
+#include <cstdint>
+#include <vector>
+
+namespace folly {
+class IOBuf;
+}
+
+namespace facebook { namespace fboss {
+
+/*
+ * The fields of a packet a LoadBalancer may hash on.
+ */
+struct HashFlow {
+  folly::IPAddress srcIp;
+  folly::IPAddress dstIp;
+  uint8_t protocol{0};
+  // Only set for TCP and UDP packets that have the ports
+  bool hasPorts{false};
+  uint16_t srcPort{0};
+  uint16_t dstPort{0};
+  // IPv6 only
+  uint32_t flowLabel{0};
+
+  /*
+   * The flow of an Ethernet frame, such as an sFlow sample or a packet of a
+   * pcap file.  None if it isn't a well formed IP packet.
+   */
+  static folly::Optional<HashFlow> fromPacket(const folly::IOBuf* buf);
+};
+
+/*
+ * HashSimulator replays flows through a software model of the ECMP or LAG
+ * hash a LoadBalancer configures, to predict how evenly its field selection
+ * and seed spread traffic over the members of a group.
+ *
+ * The model follows the hardware in what it hashes: only the fields the
+ * LoadBalancer selects for the packet's address family, plus the transport
+ * fields for TCP and UDP, go through the configured algorithm seeded with
+ * the LoadBalancer's seed, and the member is the hash modulo the group
+ * size.  It isn't bit exact with any ASIC, so use it to compare
+ * configurations, not to tell which member a given flow will use.
+ */
+class HashSimulator {
+ public:
+  HashSimulator(const LoadBalancer& loadBalancer, size_t numMembers);
+
+  uint16_t hash(const HashFlow& flow) const;
+  size_t getMember(const HashFlow& flow) const {
+    return hash(flow) % loads_.size();
+  }
+
+  /*
+   * Add a flow carrying weight (packets or bytes) to its member's load.
+   */
+  void addFlow(const HashFlow& flow, uint64_t weight = 1);
+  /*
+   * Add the flow of an Ethernet frame.  Returns false, counting it as
+   * unhashed, if it isn't an IP packet.
+   */
+  bool addPacket(const folly::IOBuf* buf, uint64_t weight = 1);
+
+  const std::vector<uint64_t>& getLoads() const {
+    return loads_;
+  }
+  uint64_t getNumFlows() const {
+    return numFlows_;
+  }
+  uint64_t getNumUnhashed() const {
+    return numUnhashed_;
+  }
+  /*
+   * The load of the busiest member over the mean load, 1 for a perfectly
+   * even spread and the number of members for all of it on one.  0 if
+   * there is no load.
+   */
+  double getMaxImbalance() const;
+
+  HashDistribution toThrift() const;
+
+ private:
+  LoadBalancer::IPv4Fields v4Fields_;
+  LoadBalancer::IPv6Fields v6Fields_;
+  LoadBalancer::TransportFields transportFields_;
+  uint16_t seed_;
+
+  std::vector<uint64_t> loads_;
+  uint64_t numFlows_{0};
+  uint64_t numUnhashed_{0};
+};
+
+}} // facebook::fboss
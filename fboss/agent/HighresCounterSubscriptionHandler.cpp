@@ -9,9 +9,14 @@
  */
 #include "HighresCounterSubscriptionHandler.h"
 
+#include <folly/Conv.h>
 #include <folly/MoveWrapper.h>
 #include <folly/logging/xlog.h>
+#include <glog/logging.h>
 
+#include <algorithm>
+
+#include "common/stats/ServiceData.h"
 #include "fboss/agent/Utils.h"
 
 using folly::EventBase;
@@ -20,172 +25,168 @@ using std::shared_ptr;
 using std::string;
 using std::unique_ptr;
 
-using std::chrono::duration_cast;
 using std::chrono::high_resolution_clock;
-using std::chrono::nanoseconds;
 using std::chrono::seconds;
 
 namespace facebook { namespace fboss {
 
+namespace {
+
+std::atomic<int64_t> nextSubscriptionId{0};
+
+// Handles the result of a oneway publish
+class PublishCallback {
+ public:
+  PublishCallback(shared_ptr<Signal> killSwitch,
+                  shared_ptr<FbossHighresClientAsyncClient> client)
+      : killSwitch_(std::move(killSwitch)), client_(std::move(client)) {}
+
+  void operator()(apache::thrift::ClientReceiveState&& state) {
+    // For oneway functions like this one, only exceptions make it here.
+    if (state.isException()) {
+      if (!killSwitch_->set()) {
+        XLOG(ERR) << "Exception sending publication: " << state.exception();
+      }
+      // else, we were already dying so don't beat a dead horse
+    } else {
+      XLOG(ERR) << "There was a result to a oneway call";
+    }
+  }
+
+ private:
+  shared_ptr<Signal> killSwitch_;
+  // Keeps the client alive until the call is done
+  shared_ptr<FbossHighresClientAsyncClient> client_;
+};
+
+} // unnamed namespace
+
 // Wrapper for the actual Thrift call
-inline void SampleSender::publish(unique_ptr<CounterPublication> pub) {
+void SampleSender::publish(unique_ptr<CounterPublication> pub) {
+  backlog_.fetch_sub(1, std::memory_order_relaxed);
   if (!killSwitch_->isSet()) {
     // Note that it's okay to give the callback a shared_ptr to the client
     // without the eventBase because the actual call and callback are run in
     // the eventbase thread.
-    auto& client = client_;
-    auto& killSwitch = killSwitch_;
-    client->publishCounters(
-        [killSwitch, client](
-            apache::thrift::ClientReceiveState&& state) mutable {
-          // For oneway functions like this one, only exceptions make it here.
-          if (state.isException()) {
-            if (!killSwitch->set()) {
-              XLOG(ERR) << "Exception sending publication: "
-                        << state.exception();
-            }
-            // else, we were already dying so don't beat a dead horse
-          } else {
-            XLOG(ERR) << "There was a result to a oneway call";
-          }
-        },
-        *pub);
+    client_->publishCounters(PublishCallback(killSwitch_, client_), *pub);
     rateCalc_.finishedSamples(pub->times.size() * numCounters_);
   }
 }
 
-SampleProducer::SampleProducer(unique_ptr<HighresSamplerList> samplers,
+void SampleSender::publish(unique_ptr<CompactCounterPublication> pub) {
+  backlog_.fetch_sub(1, std::memory_order_relaxed);
+  if (!killSwitch_->isSet()) {
+    client_->publishCompactCounters(
+        PublishCallback(killSwitch_, client_), *pub);
+    rateCalc_.finishedSamples(pub->numSamples * numCounters_);
+  }
+}
+
+SampleProducer::SampleProducer(std::vector<CounterRequest> counters,
                                shared_ptr<SampleSender> sender,
                                shared_ptr<Signal> killSwitch,
                                EventBase* const eventBase,
-                               const CounterSubscribeRequest& req,
-                               const int numCounters)
-    : samplers_(std::move(samplers)),
-      killSwitch_(std::move(killSwitch)),
+                               const CounterSubscribeRequest& req)
+    : killSwitch_(std::move(killSwitch)),
       sender_(std::move(sender)),
       eventBase_(eventBase),
       hostname_(getLocalHostname()),
       maxTime_(seconds(req.maxTime)),
       maxCount_(req.maxCount),
-      interval_(nanoseconds(req.intervalInNs)),
-      batchSize_(req.batchSize),
-      sleepMethod_(req.sleepMethod),
+      compact_(req.compact),
+      counters_(std::move(counters)),
+      batch_(counters_.size()),
+      minBatchSize_(std::max(req.batchSize, 1)),
+      maxBatchSize_(std::max(req.maxBatchSize, minBatchSize_)),
+      batchSize_(minBatchSize_),
       rateCalc_("SampleProducer"),
-      numCounters_(numCounters) {
-  overloadWarningCounter_ = 0;
-  numSamplesAtLastOverloadWarning_ = 0;
+      numCounters_(counters_.size()),
+      statPrefix_(folly::to<string>(
+          "highres.subscription.",
+          nextSubscriptionId.fetch_add(1, std::memory_order_relaxed), ".")) {
+  fbData->setCounter(statPrefix_ + "counters", numCounters_);
 }
 
-inline void SampleProducer::nanosleepHelper(const nanoseconds& timeLeft) {
-  const int64_t kNsPerS = 1000 * 1000 * 1000;
-  const auto count = timeLeft.count();
+bool SampleProducer::addSample(const high_resolution_clock::time_point& time,
+                               const int64_t* values) {
+  if (numSamples_ == 0) {
+    sender_->initialize();
+    rateCalc_.initialize();
+    timeout_ = time + maxTime_;
+  }
+  if (killSwitch_->isSet() || numSamples_ >= maxCount_ || time >= timeout_) {
+    return false;
+  }
+
+  std::copy(values, values + numCounters_, batch_.addSample(time));
+
+  // Print out the sampling rate every second
+  rateCalc_.finishedSamples(numCounters_);
+  ++numSamples_;
 
-  timespec ts;
-  ts.tv_sec = count / kNsPerS;
-  ts.tv_nsec = count % kNsPerS;
+  // Check if we have a full batch.  If so move it to the queue and start a
+  // new one.
+  if (batch_.size() >= static_cast<size_t>(batchSize_)) {
+    adjustBatchSize();
+    publishBatch();
+  }
+  return true;
+}
 
-  // Ignore signals
-  if (nanosleep(&ts, nullptr)) {
-    PCHECK(errno == EINTR);
+void SampleProducer::finish() {
+  if (batch_.size() > 0) {
+    publishBatch();
+  }
+  for (const auto& name : {"counters", "samples", "publications",
+                           "batch_size", "backlog"}) {
+    fbData->clearCounter(statPrefix_ + name);
   }
 }
 
-inline void SampleProducer::sleepNs(high_resolution_clock::time_point* start) {
-  auto endTime = *start + interval_;
-  auto currentTime = high_resolution_clock::now();
-  auto timeLeft = endTime - currentTime;
-
-  if (timeLeft < nanoseconds(0)) {
-    // If processing took longer than an interval, warn of a possible overload
-    if (++overloadWarningCounter_ % kOverloadWarningEveryN == 0) {
-      double percent = ((double)kOverloadWarningEveryN) /
-                       (numSamples_ - numSamplesAtLastOverloadWarning_) * 100;
-      XLOG(WARNING) << "Interval is too small for " << percent
-                    << "% of samples. Exceeded by "
-                    << -duration_cast<nanoseconds>(timeLeft).count() << " ns.";
-
-      numSamplesAtLastOverloadWarning_ = numSamples_;
-      overloadWarningCounter_ = 0;
+void SampleProducer::publishBatch() {
+  if (compact_) {
+    auto pub = make_unique<CompactCounterPublication>();
+    pub->hostname = hostname_;
+    pub->sequence = sequence_;
+    if (sequence_ == 0) {
+      pub->counters = counters_;
     }
+    batch_.toCompactPublication(pub.get());
+    publish(std::move(pub));
   } else {
-    // Else, we need to sleep for a bit.  There are two ways to do it:
-    if (sleepMethod_ == SleepMethod::NANOSLEEP) {
-      nanosleepHelper(duration_cast<nanoseconds>(timeLeft));
-      currentTime = high_resolution_clock::now();
-    } else if (sleepMethod_ == SleepMethod::PAUSE) {
-      do {
-        // If we need to have *precise* timing, and it's not achievable with any
-        // other means like 'nanosleep' or EventBase.
-        asm volatile("pause");
-        currentTime = high_resolution_clock::now();
-      } while (currentTime < endTime);
-    }
+    auto pub = make_unique<CounterPublication>();
+    pub->hostname = hostname_;
+    batch_.toPublication(counters_, pub.get());
+    publish(std::move(pub));
   }
+  ++sequence_;
+  batch_.clear();
 
-  *start = currentTime;
+  fbData->setCounter(statPrefix_ + "samples", numSamples_);
+  fbData->setCounter(statPrefix_ + "publications", sequence_);
+  fbData->setCounter(statPrefix_ + "batch_size", batchSize_);
+  fbData->setCounter(statPrefix_ + "backlog", sender_->getBacklog());
 }
 
-inline void SampleProducer::buildPublication(
-    CounterPublication* pub,
-    const high_resolution_clock::time_point& currentTime) {
-  auto duration = duration_cast<nanoseconds>(currentTime.time_since_epoch());
-
-  auto time_s = duration_cast<seconds>(duration).count();
-  auto time_ns = duration_cast<nanoseconds>(duration % seconds(1)).count();
-
-  pub->times.emplace_back(
-      apache::thrift::FragileConstructor::FRAGILE, time_s, time_ns);
-
-  // Add a round of values
-  for (const auto& sampler : (*samplers_.get())) {
-    sampler->sample(pub);
+void SampleProducer::adjustBatchSize() {
+  // A publication still waiting to be sent means the sender isn't keeping
+  // up, so send fewer, larger ones until it does
+  if (sender_->getBacklog() > 0) {
+    batchSize_ = std::min(batchSize_ * 2, maxBatchSize_);
+  } else {
+    batchSize_ = std::max(batchSize_ / 2, minBatchSize_);
   }
 }
 
-void SampleProducer::publish(unique_ptr<CounterPublication> pub) {
+template <typename Publication>
+void SampleProducer::publish(unique_ptr<Publication> pub) {
   auto& sender = sender_;
   auto wrappedPub = folly::makeMoveWrapper(std::move(pub));
+  sender->queued();
   // Schedule the send in a eb thread.  We include the a shared pointer to the
   // sender so it doesn't get destroyed too early.
   eventBase_->runInEventBaseThread(
       [sender, wrappedPub]() mutable { sender->publish(wrappedPub.move()); });
 }
 
-void SampleProducer::produce() {
-  auto pub = make_unique<CounterPublication>();
-
-  pub->hostname = hostname_;
-  auto batchCounter = 0;
-
-  sender_->initialize();
-  rateCalc_.initialize();
-  auto currentTime = high_resolution_clock::now();
-  auto timeout = currentTime + maxTime_;
-
-  for (int i = 0;
-       !killSwitch_->isSet() && i < maxCount_ && currentTime < timeout;
-       ++i) {
-    buildPublication(pub.get(), currentTime);
-
-    // Check if we have a full batch.  If so move it to the queue and make a new
-    // publication.
-    if (++batchCounter >= batchSize_) {
-      publish(std::move(pub));
-      pub = make_unique<CounterPublication>();
-      pub->hostname = hostname_;
-      batchCounter = 0;
-    }
-
-    // Print out the sampling rate every second
-    rateCalc_.finishedSamples(numCounters_);
-    ++numSamples_;
-
-    // Sleep for the remaining portion of interval
-    sleepNs(&currentTime);
-  }
-
-  if (batchCounter > 0) {
-    publish(std::move(pub));
-  }
-}
 }} // facebook::fboss
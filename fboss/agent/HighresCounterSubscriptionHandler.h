@@ -13,39 +13,53 @@
  *
  *    1. Thrift call comes into async_tm_subscribeToCounters in some EventBase
  *       thread.
- *    2. In that function thread, we create the HighresSampler objects and other
- *       relevant objects (SampleProducer, etc.).
- *    3. Also in the function, we fork off a SampleProducer thread
- *    4. The SampleProducer thread has a loop that calls sample()
+ *    2. In that function thread, we check which counters are valid, and
+ *       create the SampleProducer and SampleSender for the subscription.
+ *    3. Also in the function, we hand the SampleProducer to the
+ *       HighresSamplingScheduler, which adds it to the sampling thread of the
+ *       subscriptions with the same interval and thread settings, or starts a
+ *       new one.
+ *    4. The sampling thread has a loop that calls sample() on the samplers of
+ *       all the counters of its subscriptions, and gives each SampleProducer
+ *       the values of its own counters
  *    5. Occasionally, the SampleProducer issues a Thrift call to send a batch
  *       of samples to a separate service. This Thrift call uses the original
  *       EventBase thread for event handling.
  *
  *  Basically, there are two threads that are involved: (1) the Thrift
- *  EventBase that got the request and (2) the separate SampleProducer thread
- *  that we fork off. The EventBase thread handles the original request and the
- *  infrequent batch sample send. Utilization of this thread should be minimal.
- *  The SampleProducer thread just sits in a tight loop around sample(). The
- *  utilization of this thread can be tuned via sampling rate, sleep method,
- *  and Linux thread "niceness".
+ *  EventBase that got the request and (2) the sampling thread, which may be
+ *  shared with other subscriptions. The EventBase thread handles the original
+ *  request and the infrequent batch sample send. Utilization of this thread
+ *  should be minimal.  The sampling thread just sits in a tight loop around
+ *  sample(). The utilization of this thread can be tuned via sampling rate,
+ *  sleep method, Linux thread "niceness", and the CPU it is pinned to.
  *
- *  The HighresSampler objects, SampleProducer, and SampleSender will be
- *  destroyed when the Producer thread exits.  This happens if we pass maxTime,
- *  maxCount, the agent dies, or the killSwitch is activated (because we got an
- *  error on the channel or the collector stopped sending keepalives).
+ *  Samples are published in batches, either as a CounterPublication, or for
+ *  subscriptions that ask for it as a CompactCounterPublication, which sends
+ *  the counter names once and the values as delta encoded columns.  While
+ *  the EventBase thread falls behind on sending them, batches grow up to
+ *  maxBatchSize samples, and shrink back to batchSize once it catches up.
+ *
+ *  The SampleProducer and SampleSender will be destroyed when the
+ *  subscription is over.  This happens if we pass maxTime, maxCount, the
+ *  agent dies, or the killSwitch is activated (because we got an error on the
+ *  channel or the collector stopped sending keepalives).  Each subscription
+ *  reports how it is doing in the "highres.subscription.<id>." counters while
+ *  it lasts.
  */
 #pragma once
 
 #include <folly/MoveWrapper.h>
 
+#include <atomic>
+#include <vector>
+
 #include "fboss/agent/HighresCounterUtil.h"
+#include "fboss/agent/HighresSamplingScheduler.h"
 #include "fboss/agent/if/gen-cpp2/FbossHighresClient.h"
 
 namespace facebook { namespace fboss {
 
-// How often to print out load warnings
-const int kOverloadWarningEveryN = 1000;
-
 /*
  * A simple, atomic flag that starts unset, but can later be set.  Wrapped in a
  * folly::Synchronized wrapper and shared_ptr, it becomes an atomic, thread-safe
@@ -110,6 +124,17 @@ class SampleSender {
    */
   void initialize() { rateCalc_.initialize(); }
 
+  /*
+   * Note that a publication was scheduled to be published.  publish() takes
+   * it off the backlog again.
+   */
+  void queued() { backlog_.fetch_add(1, std::memory_order_relaxed); }
+
+  /*
+   * The number of publications that were queued but not published yet.
+   */
+  int getBacklog() const { return backlog_.load(std::memory_order_relaxed); }
+
   /*
    * Publish the counters back to the duplex client.  This should be called from
    * the event base thread where client_ came from.
@@ -118,6 +143,7 @@ class SampleSender {
    *                     after this function returns.
    */
   void publish(std::unique_ptr<CounterPublication> pub);
+  void publish(std::unique_ptr<CompactCounterPublication> pub);
 
  private:
   // Non-copyable
@@ -129,22 +155,24 @@ class SampleSender {
   folly::EventBase* const eventBase_;
   SharedRateCalculator rateCalc_;
   const int numCounters_;
+  std::atomic<int> backlog_{0};
 };
 
 /*
  * The class that builds updates for the subscribed client. When a thrift
- * server gets a subscription request, it spawns a Producer and (mostly) forgets
- * about it. The producer will then continue on its own for a preset amount of
- * time or until a kill signal is received.
+ * server gets a subscription request, it hands a Producer to the
+ * HighresSamplingScheduler and (mostly) forgets about it. The producer then
+ * gets samples for a preset amount of time or until a kill signal is
+ * received.
  */
-class SampleProducer {
+class SampleProducer : public HighresSubscriber {
  public:
   /*
    * Constructor.  It pulls out information from the request and sets up a bunch
    * of internal state
    *
-   * @param[in]     samplers    The entire set of samplers to query in each
-   *                            round.
+   * @param[in]     counters    The valid counters of the subscription, in the
+   *                            order of the values of a sample.
    * @param[out]    sender      The SampleSender that we call to publish data
    *                            back to the client.
    * @param[in]     killSwitch  A shared kill switch that lets different
@@ -154,46 +182,51 @@ class SampleProducer {
    * @param[in]     req         The subscription request, which specifies the
    *                            counter names, timeouts, sampling intervals,
    *                            etc.
-   * @param[in]     numCounters The total number of counters that we are
-   *                            sampling. Used for rate calculations.
    */
-  SampleProducer(std::unique_ptr<HighresSamplerList> samplers,
+  SampleProducer(std::vector<CounterRequest> counters,
                  std::shared_ptr<SampleSender> sender,
                  std::shared_ptr<Signal> killSwitch,
                  folly::EventBase* const eventBase,
-                 const CounterSubscribeRequest& req,
-                 const int numCounters);
+                 const CounterSubscribeRequest& req);
+
+  const std::vector<CounterRequest>& getCounters() const override {
+    return counters_;
+  }
 
   /*
-   * Continue producing until we get a kill signal or for a fixed amount of
+   * Add a sample until we get a kill signal or for a fixed amount of
    * time/samples, whichever comes first.
    */
-  void produce();
+  bool addSample(const std::chrono::high_resolution_clock::time_point& time,
+                 const int64_t* values) override;
+
+  /*
+   * Publish what is left, and stop reporting on the subscription.
+   */
+  void finish() override;
+
+  /*
+   * The prefix of the counters that report on the subscription.
+   */
+  const std::string& getStatPrefix() const {
+    return statPrefix_;
+  }
 
  private:
   // Non-copyable
   SampleProducer(const SampleProducer&) = delete;
   SampleProducer& operator=(const SampleProducer&) = delete;
 
-  // A wrapper for nanosleep that takes std::chrono::nanoseconds
-  inline void nanosleepHelper(const std::chrono::nanoseconds& timeLeft);
+  // Turn the batch into a publication and schedule it
+  void publishBatch();
 
-  // Sleep until we are ready to take another sample.  We will try to sleep
-  // until start + interval_.  It takes a start time so we can account for the
-  // time that has already elapsed while taking samples.  After this function
-  // executes, start >= start + interval.
-  inline void sleepNs(std::chrono::high_resolution_clock::time_point* start);
-
-  // Iteratively build the publication by querying all the samplers once
-  inline void buildPublication(
-      CounterPublication* pub,
-      const std::chrono::high_resolution_clock::time_point& time);
+  // Grow or shrink the batches as the sender keeps up or not
+  void adjustBatchSize();
 
   // Schedule the SampleSender in a tm thread
-  inline void publish(std::unique_ptr<CounterPublication> pub);
+  template <typename Publication>
+  void publish(std::unique_ptr<Publication> pub);
 
-  // For the normal polling loop
-  std::unique_ptr<HighresSamplerList> samplers_;
   std::shared_ptr<Signal> killSwitch_;
 
   // For sending the publications
@@ -204,15 +237,21 @@ class SampleProducer {
   const std::string hostname_;
   const std::chrono::seconds maxTime_;
   const int64_t maxCount_;
-  const std::chrono::nanoseconds interval_;
-  const int32_t batchSize_;
-  const SleepMethod sleepMethod_;
+  const bool compact_;
+  std::chrono::high_resolution_clock::time_point timeout_;
+
+  // For batching the samples
+  const std::vector<CounterRequest> counters_;
+  SampleBatch batch_;
+  const int32_t minBatchSize_;
+  const int32_t maxBatchSize_;
+  int32_t batchSize_;
+  int64_t sequence_{0};
 
   // For keeping track of the rate at which we are processing updates
   SingleThreadRateCalculator rateCalc_;
   const int numCounters_;
-  int numSamples_;
-  int overloadWarningCounter_;
-  int numSamplesAtLastOverloadWarning_;
+  int64_t numSamples_{0};
+  const std::string statPrefix_;
 };
 }} // facebook::fboss
@@ -12,14 +12,131 @@
 #include <sys/stat.h>
 
 #include <folly/logging/xlog.h>
+#include <glog/logging.h>
 #include <sstream>
+#include <stdexcept>
 
 DEFINE_bool(print_rates,
             false,
             "Whether to enable RateCalculator calculations and printouts.");
 
+using std::chrono::duration_cast;
+using std::chrono::high_resolution_clock;
+using std::chrono::nanoseconds;
+using std::chrono::seconds;
+
 namespace facebook { namespace fboss {
 
+namespace {
+
+int64_t toNanoseconds(high_resolution_clock::time_point time) {
+  return duration_cast<nanoseconds>(time.time_since_epoch()).count();
+}
+
+} // unnamed namespace
+
+class SampleBatch::ColumnEncoder {
+ public:
+  void add(int64_t value) {
+    // Unsigned, so that large differences wrap rather than overflow
+    auto delta = static_cast<int64_t>(static_cast<uint64_t>(value) - previous_);
+    auto zigzag = (static_cast<uint64_t>(delta) << 1) ^
+        static_cast<uint64_t>(delta >> 63);
+    while (zigzag >= 0x80) {
+      column_.push_back(static_cast<char>((zigzag & 0x7f) | 0x80));
+      zigzag >>= 7;
+    }
+    column_.push_back(static_cast<char>(zigzag));
+    previous_ = static_cast<uint64_t>(value);
+  }
+
+  std::string finish() {
+    return std::move(column_);
+  }
+
+ private:
+  std::string column_;
+  uint64_t previous_{0};
+};
+
+int64_t* SampleBatch::addSample(high_resolution_clock::time_point time) {
+  times_.push_back(time);
+  values_.resize(values_.size() + numCounters_);
+  return values_.data() + values_.size() - numCounters_;
+}
+
+void SampleBatch::toPublication(const std::vector<CounterRequest>& counters,
+                                CounterPublication* pub) const {
+  CHECK_EQ(counters.size(), numCounters_);
+  for (auto time : times_) {
+    auto duration = duration_cast<nanoseconds>(time.time_since_epoch());
+    auto time_s = duration_cast<seconds>(duration).count();
+    auto time_ns = duration_cast<nanoseconds>(duration % seconds(1)).count();
+    pub->times.emplace_back(
+        apache::thrift::FragileConstructor::FRAGILE, time_s, time_ns);
+  }
+  for (size_t counter = 0; counter < numCounters_; ++counter) {
+    auto& list = pub->counterValues[counters[counter]];
+    for (size_t idx = counter; idx < values_.size(); idx += numCounters_) {
+      list.push_back(values_[idx]);
+    }
+  }
+}
+
+void SampleBatch::toCompactPublication(CompactCounterPublication* pub) const {
+  pub->numSamples = times_.size();
+
+  ColumnEncoder times;
+  for (auto time : times_) {
+    times.add(toNanoseconds(time));
+  }
+  pub->times = times.finish();
+
+  pub->columns.reserve(numCounters_);
+  for (size_t counter = 0; counter < numCounters_; ++counter) {
+    ColumnEncoder column;
+    for (size_t idx = counter; idx < values_.size(); idx += numCounters_) {
+      column.add(values_[idx]);
+    }
+    pub->columns.push_back(column.finish());
+  }
+}
+
+std::string SampleBatch::encodeColumn(const std::vector<int64_t>& values) {
+  ColumnEncoder column;
+  for (auto value : values) {
+    column.add(value);
+  }
+  return column.finish();
+}
+
+std::vector<int64_t> SampleBatch::decodeColumn(folly::StringPiece column) {
+  std::vector<int64_t> values;
+  uint64_t previous = 0;
+  uint64_t zigzag = 0;
+  int shift = 0;
+  for (auto c : column) {
+    auto byte = static_cast<uint8_t>(c);
+    if (shift > 63) {
+      throw std::invalid_argument("varint in column is too long");
+    }
+    zigzag |= static_cast<uint64_t>(byte & 0x7f) << shift;
+    if (byte & 0x80) {
+      shift += 7;
+      continue;
+    }
+    auto delta = (zigzag >> 1) ^ -(zigzag & 1);
+    previous += delta;
+    values.push_back(static_cast<int64_t>(previous));
+    zigzag = 0;
+    shift = 0;
+  }
+  if (shift) {
+    throw std::invalid_argument("column ends within a varint");
+  }
+  return values;
+}
+
 DumbCounterSampler::DumbCounterSampler(
     const std::set<CounterRequest>& counters) {
   for (const auto& c: counters) {
@@ -34,8 +151,17 @@ DumbCounterSampler::DumbCounterSampler(
   }
 }
 
-void DumbCounterSampler::sample(CounterPublication* pub) {
-  pub->counterValues[req_].push_back(++counter_);
+void DumbCounterSampler::sample(int64_t* values) {
+  if (numCounters_) {
+    values[0] = ++counter_;
+  }
+}
+
+void DumbCounterSampler::getCounters(
+    std::vector<CounterRequest>* counters) const {
+  if (numCounters_) {
+    counters->push_back(req_);
+  }
 }
 
 InterfaceRateSampler::InterfaceRateSampler(
@@ -55,7 +181,7 @@ InterfaceRateSampler::InterfaceRateSampler(
   }
 }
 
-void InterfaceRateSampler::sample(CounterPublication* pub) {
+void InterfaceRateSampler::sample(int64_t* values) {
   uint64_t sin = -1;
   uint64_t sout = -1;
 
@@ -86,10 +212,15 @@ void InterfaceRateSampler::sample(CounterPublication* pub) {
 
   for (const auto& c : counters_) {
     if (c.counterName == kTxBytesCounterName) {
-      pub->counterValues[c].push_back(sout);
+      *values++ = sout;
     } else if (c.counterName == kRxBytesCounterName) {
-      pub->counterValues[c].push_back(sin);
+      *values++ = sin;
     }
   }
 }
+
+void InterfaceRateSampler::getCounters(
+    std::vector<CounterRequest>* counters) const {
+  counters->insert(counters->end(), counters_.begin(), counters_.end());
+}
 }} // facebook::fboss
@@ -9,6 +9,7 @@
  */
  #pragma once
 
+#include <folly/Range.h>
 #include <folly/Synchronized.h>
 #include <folly/logging/xlog.h>
 
@@ -17,6 +18,8 @@
 #include <chrono>
 #include <fstream>
 #include <set>
+#include <string>
+#include <vector>
 
 DECLARE_bool(print_rates);
 
@@ -36,11 +39,12 @@ class HighresSampler {
 
   /*
    * Virtual sample function. This is the function that is called by the server
-   * in a loop.  It should add the the requested set of counter values to pub.
+   * in a loop.  It should write the value of each of its counters, in the order
+   * of getCounters(), to values.
    *
-   * @param[out]   pub    The publication to which we should add counter values.
+   * @param[out]   values    Where to write numCounters() values.
    */
-  virtual void sample(CounterPublication* pub) = 0;
+  virtual void sample(int64_t* values) = 0;
 
   /*
    * The number of counters handled by this sampler.  Potential reasons why a
@@ -51,6 +55,63 @@ class HighresSampler {
    * @return    The number of valid counters handled by this sampler
    */
   virtual int numCounters() const = 0;
+
+  /*
+   * Append the valid counters handled by this sampler, in the order sample()
+   * writes their values.
+   *
+   * @param[out]   counters  Where to append the counters.
+   */
+  virtual void getCounters(std::vector<CounterRequest>* counters) const = 0;
+};
+
+/*
+ * The samples of a batch, kept as one row of values per sample, so taking a
+ * sample doesn't allocate once the batch has grown to its size.  It is then
+ * turned into a publication in either format, and cleared for the next batch.
+ */
+class SampleBatch {
+ public:
+  explicit SampleBatch(size_t numCounters) : numCounters_(numCounters) {}
+
+  /*
+   * Add a sample taken at time, and return where its numCounters values go.
+   */
+  int64_t* addSample(std::chrono::high_resolution_clock::time_point time);
+
+  size_t size() const {
+    return times_.size();
+  }
+  // Keeps the memory for the next batch
+  void clear() {
+    times_.clear();
+    values_.clear();
+  }
+
+  /*
+   * Add the samples to pub: a time for each sample, and its values to the
+   * lists of counters, which are in the same order as the values of a sample.
+   */
+  void toPublication(const std::vector<CounterRequest>& counters,
+                     CounterPublication* pub) const;
+  /*
+   * Set the sample count, times and columns of pub.
+   */
+  void toCompactPublication(CompactCounterPublication* pub) const;
+
+  /*
+   * Encode values as a column of a CompactCounterPublication, and back.
+   * Decoding throws std::invalid_argument if the column is cut short.
+   */
+  static std::string encodeColumn(const std::vector<int64_t>& values);
+  static std::vector<int64_t> decodeColumn(folly::StringPiece column);
+
+ private:
+  class ColumnEncoder;
+
+  const size_t numCounters_;
+  std::vector<std::chrono::high_resolution_clock::time_point> times_;
+  std::vector<int64_t> values_;
 };
 
 /*
@@ -61,8 +122,9 @@ class DumbCounterSampler : public HighresSampler {
  public:
   explicit DumbCounterSampler(const std::set<CounterRequest>& counters);
   ~DumbCounterSampler() override {}
-  void sample(CounterPublication* pub) override;
+  void sample(int64_t* values) override;
   int numCounters() const override {return numCounters_;}
+  void getCounters(std::vector<CounterRequest>* counters) const override;
 
   /// constant strings representing the namespace and counter names.  We store
   /// everything explicitly for speed.
@@ -82,9 +144,10 @@ class InterfaceRateSampler : public HighresSampler {
  public:
   explicit InterfaceRateSampler(const std::set<CounterRequest>& counters);
   ~InterfaceRateSampler() override {}
-  void sample(CounterPublication* pub) override;
+  void sample(int64_t* values) override;
 
   int numCounters() const override { return counters_.size(); }
+  void getCounters(std::vector<CounterRequest>* counters) const override;
 
   /// constant strings representing the namespace and counter names.  We store
   /// everything explicitly for speed.
@@ -0,0 +1,315 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "fboss/agent/HighresSamplingScheduler.h"
+
+#include <folly/logging/xlog.h>
+#include <glog/logging.h>
+
+#include <time.h>
+
+#include "fboss/agent/Utils.h"
+
+using std::unique_ptr;
+using std::chrono::duration_cast;
+using std::chrono::high_resolution_clock;
+using std::chrono::nanoseconds;
+
+namespace facebook { namespace fboss {
+
+namespace {
+
+// The value of counters that are no longer there, e.g. with their port
+const int64_t kMissingValue = -1;
+
+} // unnamed namespace
+
+class HighresSamplingScheduler::Group {
+ public:
+  Group(const GroupKey& key, const SamplerFactory& factory)
+      : key_(key), factory_(factory) {}
+  ~Group() {
+    stop();
+    if (thread_.joinable()) {
+      thread_.join();
+    }
+  }
+
+  // Start the thread, once the first subscription was added
+  void start() {
+    thread_ = std::thread([this] { run(); });
+  }
+
+  /*
+   * Add a subscriber.  Returns false, and leaves subscriber alone, if the
+   * group is already over.
+   */
+  bool add(unique_ptr<HighresSubscriber>&& subscriber) {
+    std::lock_guard<std::mutex> g(lock_);
+    if (done_) {
+      return false;
+    }
+    subscriptions_.emplace_back();
+    subscriptions_.back().subscriber = std::move(subscriber);
+    rebuild();
+    return true;
+  }
+
+  void stop() {
+    std::lock_guard<std::mutex> g(lock_);
+    stop_ = true;
+  }
+
+  bool isDone() const {
+    std::lock_guard<std::mutex> g(lock_);
+    return done_;
+  }
+
+ private:
+  struct Subscription {
+    unique_ptr<HighresSubscriber> subscriber;
+    // Where the values of its counters are in row_
+    std::vector<size_t> columns;
+    std::vector<int64_t> values;
+  };
+
+  // Forbidden copy constructor and assignment operator
+  Group(Group const &) = delete;
+  Group& operator=(Group const &) = delete;
+
+  void run();
+  // Sample every counter once, and hand out the values.  Called with lock_
+  // held
+  void tick(const high_resolution_clock::time_point& time);
+  // Create the samplers for the counters of all subscriptions.  Called with
+  // lock_ held
+  void rebuild();
+
+  // Sleep until we are ready to take another sample.  We will try to sleep
+  // until start + interval.  After this function executes, start >= start +
+  // interval.
+  void sleepNs(high_resolution_clock::time_point* start);
+
+  const GroupKey key_;
+  const SamplerFactory& factory_;
+
+  mutable std::mutex lock_;
+  std::vector<Subscription> subscriptions_;
+  HighresSamplerList samplers_;
+  std::vector<int64_t> row_;
+  bool stop_{false};
+  bool done_{false};
+
+  // Only used by the thread
+  int numSamples_{0};
+  int overloadWarningCounter_{0};
+  int numSamplesAtLastOverloadWarning_{0};
+
+  std::thread thread_;
+};
+
+void HighresSamplingScheduler::Group::run() {
+  if (key_.veryNice) {
+    incNiceValue(20);
+  }
+  if (key_.samplerCpu >= 0) {
+    pinThreadToCpu(key_.samplerCpu);
+  }
+
+  auto currentTime = high_resolution_clock::now();
+  while (true) {
+    {
+      std::lock_guard<std::mutex> g(lock_);
+      if (!stop_) {
+        tick(currentTime);
+      }
+      if (stop_ || subscriptions_.empty()) {
+        for (auto& subscription : subscriptions_) {
+          subscription.subscriber->finish();
+        }
+        subscriptions_.clear();
+        samplers_.clear();
+        done_ = true;
+        return;
+      }
+    }
+    ++numSamples_;
+
+    // Sleep for the remaining portion of interval
+    sleepNs(&currentTime);
+  }
+}
+
+void HighresSamplingScheduler::Group::tick(
+    const high_resolution_clock::time_point& time) {
+  auto values = row_.data();
+  for (const auto& sampler : samplers_) {
+    sampler->sample(values);
+    values += sampler->numCounters();
+  }
+
+  auto ended = false;
+  auto it = subscriptions_.begin();
+  while (it != subscriptions_.end()) {
+    for (size_t idx = 0; idx < it->columns.size(); ++idx) {
+      it->values[idx] = row_[it->columns[idx]];
+    }
+    if (it->subscriber->addSample(time, it->values.data())) {
+      ++it;
+    } else {
+      it->subscriber->finish();
+      it = subscriptions_.erase(it);
+      ended = true;
+    }
+  }
+  if (ended && !subscriptions_.empty()) {
+    // Stop sampling the counters nobody is subscribed to anymore
+    rebuild();
+  }
+}
+
+void HighresSamplingScheduler::Group::rebuild() {
+  std::set<CounterRequest> counters;
+  for (const auto& subscription : subscriptions_) {
+    const auto& subscribed = subscription.subscriber->getCounters();
+    counters.insert(subscribed.begin(), subscribed.end());
+  }
+
+  samplers_.clear();
+  factory_(&samplers_, counters);
+  std::vector<CounterRequest> sampled;
+  for (const auto& sampler : samplers_) {
+    sampler->getCounters(&sampled);
+  }
+  std::map<CounterRequest, size_t> columns;
+  for (size_t idx = 0; idx < sampled.size(); ++idx) {
+    columns.emplace(sampled[idx], idx);
+  }
+
+  // One more slot, for counters that were valid when subscribed to, but
+  // aren't anymore
+  auto missing = sampled.size();
+  row_.assign(sampled.size() + 1, 0);
+  row_[missing] = kMissingValue;
+
+  for (auto& subscription : subscriptions_) {
+    const auto& subscribed = subscription.subscriber->getCounters();
+    subscription.columns.clear();
+    for (const auto& counter : subscribed) {
+      auto it = columns.find(counter);
+      if (it == columns.end()) {
+        XLOG(WARNING) << "Subscribed counter " << counter.namespaceName
+                      << "::" << counter.counterName
+                      << " can no longer be sampled";
+      }
+      subscription.columns.push_back(
+          it == columns.end() ? missing : it->second);
+    }
+    subscription.values.resize(subscribed.size());
+  }
+}
+
+void HighresSamplingScheduler::Group::sleepNs(
+    high_resolution_clock::time_point* start) {
+  auto endTime = *start + key_.interval;
+  auto currentTime = high_resolution_clock::now();
+  auto timeLeft = endTime - currentTime;
+
+  if (timeLeft < nanoseconds(0)) {
+    // If processing took longer than an interval, warn of a possible overload
+    if (++overloadWarningCounter_ % kOverloadWarningEveryN == 0) {
+      double percent = ((double)kOverloadWarningEveryN) /
+                       (numSamples_ - numSamplesAtLastOverloadWarning_) * 100;
+      XLOG(WARNING) << "Interval is too small for " << percent
+                    << "% of samples. Exceeded by "
+                    << -duration_cast<nanoseconds>(timeLeft).count() << " ns.";
+
+      numSamplesAtLastOverloadWarning_ = numSamples_;
+      overloadWarningCounter_ = 0;
+    }
+  } else {
+    // Else, we need to sleep for a bit.  There are two ways to do it:
+    if (key_.sleepMethod == SleepMethod::NANOSLEEP) {
+      const int64_t kNsPerS = 1000 * 1000 * 1000;
+      const auto count = duration_cast<nanoseconds>(timeLeft).count();
+
+      timespec ts;
+      ts.tv_sec = count / kNsPerS;
+      ts.tv_nsec = count % kNsPerS;
+
+      // Ignore signals
+      if (nanosleep(&ts, nullptr)) {
+        PCHECK(errno == EINTR);
+      }
+      currentTime = high_resolution_clock::now();
+    } else if (key_.sleepMethod == SleepMethod::PAUSE) {
+      do {
+        // If we need to have *precise* timing, and it's not achievable with any
+        // other means like 'nanosleep' or EventBase.
+        asm volatile("pause");
+        currentTime = high_resolution_clock::now();
+      } while (currentTime < endTime);
+    }
+  }
+
+  *start = currentTime;
+}
+
+HighresSamplingScheduler::HighresSamplingScheduler(SamplerFactory factory)
+    : factory_(std::move(factory)) {}
+
+HighresSamplingScheduler::~HighresSamplingScheduler() {
+  std::lock_guard<std::mutex> g(lock_);
+  // Stop them all first, so their threads exit together
+  for (auto& group : groups_) {
+    group.second->stop();
+  }
+  groups_.clear();
+}
+
+void HighresSamplingScheduler::subscribe(
+    unique_ptr<HighresSubscriber> subscriber,
+    const CounterSubscribeRequest& req) {
+  GroupKey key{nanoseconds(req.intervalInNs), req.sleepMethod, req.veryNice,
+               req.samplerCpu};
+
+  std::lock_guard<std::mutex> g(lock_);
+  // Drop the groups whose last subscription is over
+  auto it = groups_.begin();
+  while (it != groups_.end()) {
+    if (it->second->isDone()) {
+      it = groups_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+
+  auto& group = groups_[key];
+  if (group && group->add(std::move(subscriber))) {
+    return;
+  }
+  // The group may have ended since it was checked above
+  group.reset();
+  group = std::make_unique<Group>(key, factory_);
+  CHECK(group->add(std::move(subscriber)));
+  group->start();
+}
+
+size_t HighresSamplingScheduler::numGroups() const {
+  std::lock_guard<std::mutex> g(lock_);
+  size_t count = 0;
+  for (const auto& group : groups_) {
+    if (!group.second->isDone()) {
+      ++count;
+    }
+  }
+  return count;
+}
+
+}} // facebook::fboss
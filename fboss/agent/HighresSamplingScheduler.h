@@ -0,0 +1,121 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#pragma once
+
+#include "fboss/agent/HighresCounterUtil.h"
+
+#include <chrono>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+namespace facebook { namespace fboss {
+
+// How often to print out load warnings
+const int kOverloadWarningEveryN = 1000;
+
+/*
+ * What a HighresSamplingScheduler hands the samples of a subscription to.
+ */
+class HighresSubscriber {
+ public:
+  virtual ~HighresSubscriber() {}
+
+  /*
+   * The counters of the subscription, which must not change.
+   */
+  virtual const std::vector<CounterRequest>& getCounters() const = 0;
+
+  /*
+   * Add a sample.  Returns false, without adding it, once the subscription
+   * is over.
+   *
+   * @param[in]   time     When the sample was taken.
+   * @param[in]   values   The value of each counter of getCounters(), in the
+   *                       same order.
+   */
+  virtual bool addSample(
+      const std::chrono::high_resolution_clock::time_point& time,
+      const int64_t* values) = 0;
+
+  /*
+   * Called once the subscription is over, or the scheduler goes away.
+   */
+  virtual void finish() = 0;
+};
+
+/*
+ * Samples the counters of every highres subscription.
+ *
+ * Subscriptions with the same interval, sleep method and thread settings
+ * share a group, with a single thread that samples each of their counters
+ * once per interval, and hands every subscription the values of its own
+ * counters.  So any number of subscribers to the same counters cost one set
+ * of reads, and one thread.  The samplers of a group are created anew for
+ * all of its counters whenever a subscription joins or leaves.
+ *
+ * A group's thread exits once its last subscription is over.
+ */
+class HighresSamplingScheduler {
+ public:
+  /*
+   * Creates the samplers for a set of counters, and returns the number of
+   * counters they handle.  Like SwSwitch::getHighresSamplers().
+   */
+  using SamplerFactory = std::function<int(
+      HighresSamplerList* samplers, const std::set<CounterRequest>& counters)>;
+
+  explicit HighresSamplingScheduler(SamplerFactory factory);
+  // Finishes every subscription, and waits for the threads to exit
+  ~HighresSamplingScheduler();
+
+  /*
+   * Start sampling for a subscriber, with the interval, sleep method and
+   * thread settings of req.
+   */
+  void subscribe(std::unique_ptr<HighresSubscriber> subscriber,
+                 const CounterSubscribeRequest& req);
+
+  /*
+   * The number of groups that are sampling.
+   */
+  size_t numGroups() const;
+
+ private:
+  struct GroupKey {
+    bool operator<(const GroupKey& other) const {
+      return std::tie(interval, sleepMethod, veryNice, samplerCpu) <
+          std::tie(other.interval, other.sleepMethod, other.veryNice,
+                   other.samplerCpu);
+    }
+
+    std::chrono::nanoseconds interval;
+    SleepMethod sleepMethod;
+    bool veryNice;
+    int32_t samplerCpu;
+  };
+  class Group;
+
+  // Forbidden copy constructor and assignment operator
+  HighresSamplingScheduler(HighresSamplingScheduler const &) = delete;
+  HighresSamplingScheduler& operator=(
+      HighresSamplingScheduler const &) = delete;
+
+  const SamplerFactory factory_;
+  mutable std::mutex lock_;
+  std::map<GroupKey, std::unique_ptr<Group>> groups_;
+};
+
+}} // facebook::fboss
@@ -0,0 +1,167 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "fboss/agent/HugePageAllocator.h"
+
+#include "fboss/agent/FbossError.h"
+
+#include <folly/logging/xlog.h>
+
+#include <string.h>
+#include <sys/mman.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <new>
+
+DEFINE_string(huge_page_tables, "",
+              "Back the large hardware tables with huge pages: "
+              "\"transparent\", \"explicit\" for the pages reserved in "
+              "vm.nr_hugepages, or \"\" for none");
+
+namespace facebook { namespace fboss {
+
+constexpr size_t HugePageResource::kHugePageSize;
+constexpr size_t HugePageResource::kMinHugePageAlloc;
+
+void* HugePageResource::allocate(size_t bytes) {
+  if (!usesHugePages(bytes)) {
+    return ::operator new(bytes);
+  }
+  auto size = mappedSize(bytes);
+  void* ptr = nullptr;
+  if (mode_ == HugePageMode::EXPLICIT) {
+    ptr = mmap(
+        nullptr,
+        size,
+        PROT_READ | PROT_WRITE,
+        MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB,
+        -1,
+        0);
+    if (ptr == MAP_FAILED) {
+      ptr = nullptr;
+      if (explicitFallbacks_.fetch_add(1, std::memory_order_relaxed) == 0) {
+        XLOG(WARN) << "No reserved huge pages for " << size << " bytes ("
+                   << strerror(errno) << "), using transparent huge pages";
+      }
+    }
+  }
+  if (!ptr) {
+    ptr = mapTransparent(size);
+  }
+  mappedBytes_.fetch_add(size, std::memory_order_relaxed);
+  return ptr;
+}
+
+void HugePageResource::deallocate(void* ptr, size_t bytes) noexcept {
+  if (!usesHugePages(bytes)) {
+    ::operator delete(ptr);
+    return;
+  }
+  auto size = mappedSize(bytes);
+  munmap(ptr, size);
+  mappedBytes_.fetch_sub(size, std::memory_order_relaxed);
+}
+
+void* HugePageResource::mapTransparent(size_t size) {
+  // Map an extra huge page so that the block can start on a huge page
+  // boundary, and unmap what is left over on either side
+  auto mapped = mmap(
+      nullptr,
+      size + kHugePageSize,
+      PROT_READ | PROT_WRITE,
+      MAP_PRIVATE | MAP_ANONYMOUS,
+      -1,
+      0);
+  if (mapped == MAP_FAILED) {
+    throw std::bad_alloc();
+  }
+  auto start = reinterpret_cast<uintptr_t>(mapped);
+  auto aligned = (start + kHugePageSize - 1) & ~(kHugePageSize - 1);
+  if (aligned > start) {
+    munmap(mapped, aligned - start);
+  }
+  auto tail = start + kHugePageSize - aligned;
+  if (tail) {
+    munmap(reinterpret_cast<void*>(aligned + size), tail);
+  }
+  auto ptr = reinterpret_cast<void*>(aligned);
+  if (madvise(ptr, size, MADV_HUGEPAGE) != 0) {
+    // Transparent huge pages are disabled, the memory still works
+    XLOG(DBG2) << "madvise(MADV_HUGEPAGE) failed: " << strerror(errno);
+  }
+  return ptr;
+}
+
+HugePageBlockPool::HugePageBlockPool(
+    HugePageResource* resource,
+    size_t blockBytes)
+    : resource_(resource),
+      blockBytes_(blockBytes),
+      stride_(std::max(
+          (blockBytes + alignof(std::max_align_t) - 1) &
+              ~(alignof(std::max_align_t) - 1),
+          sizeof(void*))) {}
+
+HugePageBlockPool::~HugePageBlockPool() {
+  for (auto* page : hugePages_) {
+    resource_->deallocate(page, HugePageResource::kHugePageSize);
+  }
+}
+
+void* HugePageBlockPool::allocate(size_t bytes) {
+  if (!pooled(bytes)) {
+    return resource_->allocate(bytes);
+  }
+  if (freeList_) {
+    auto* block = freeList_;
+    freeList_ = *static_cast<void**>(block);
+    return block;
+  }
+  if (static_cast<size_t>(end_ - next_) < stride_) {
+    hugePages_.reserve(hugePages_.size() + 1);
+    auto* page = static_cast<char*>(
+        resource_->allocate(HugePageResource::kHugePageSize));
+    hugePages_.push_back(page);
+    next_ = page;
+    end_ = page + HugePageResource::kHugePageSize;
+  }
+  auto* block = next_;
+  next_ += stride_;
+  return block;
+}
+
+void HugePageBlockPool::deallocate(void* ptr, size_t bytes) noexcept {
+  if (!pooled(bytes)) {
+    resource_->deallocate(ptr, bytes);
+    return;
+  }
+  *static_cast<void**>(ptr) = freeList_;
+  freeList_ = ptr;
+}
+
+HugePageResource* HugePageResource::forTables() {
+  // Leaked, as the tables may outlive static destruction
+  static auto* resource =
+      new HugePageResource(parseMode(FLAGS_huge_page_tables));
+  return resource;
+}
+
+HugePageMode HugePageResource::parseMode(const std::string& mode) {
+  if (mode.empty() || mode == "none") {
+    return HugePageMode::NONE;
+  } else if (mode == "transparent") {
+    return HugePageMode::TRANSPARENT;
+  } else if (mode == "explicit") {
+    return HugePageMode::EXPLICIT;
+  }
+  throw FbossError("Unknown huge page mode \"", mode, "\"");
+}
+
+}} // facebook::fboss
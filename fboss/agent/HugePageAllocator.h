@@ -0,0 +1,253 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#pragma once
+
+#include <boost/container/flat_map.hpp>
+#include <gflags/gflags.h>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+DECLARE_string(huge_page_tables);
+
+namespace facebook { namespace fboss {
+
+enum class HugePageMode {
+  // Plain operator new
+  NONE,
+  // Huge page aligned mappings the kernel is asked to back with
+  // transparent huge pages
+  TRANSPARENT,
+  // Mappings of the huge pages reserved in vm.nr_hugepages, falling back to
+  // TRANSPARENT when there are none left
+  EXPLICIT,
+};
+
+/*
+ * HugePageResource hands out the memory of large, randomly accessed arrays,
+ * such as the flat maps of the hardware tables, from huge pages so that
+ * looking up and moving their entries does not take a TLB miss per page.
+ *
+ * Only allocations of at least kMinHugePageAlloc bytes are mapped, rounded
+ * up to whole huge pages; smaller ones come from operator new.  Whether an
+ * allocation was mapped only depends on its size and the mode, so it must
+ * be freed with the same size and resource it was allocated with, as the
+ * standard allocators do.
+ */
+class HugePageResource {
+ public:
+  static constexpr size_t kHugePageSize = 2 << 20;
+  static constexpr size_t kMinHugePageAlloc = kHugePageSize / 2;
+
+  explicit HugePageResource(HugePageMode mode) : mode_(mode) {}
+
+  void* allocate(size_t bytes);
+  void deallocate(void* ptr, size_t bytes) noexcept;
+
+  HugePageMode getMode() const {
+    return mode_;
+  }
+  // The bytes currently mapped for huge pages
+  uint64_t mappedBytes() const {
+    return mappedBytes_.load(std::memory_order_relaxed);
+  }
+  // How many EXPLICIT allocations found no reserved huge pages
+  uint64_t explicitFallbacks() const {
+    return explicitFallbacks_.load(std::memory_order_relaxed);
+  }
+
+  /*
+   * The resource of the hardware tables, in the mode --huge_page_tables
+   * gives.  Throws FbossError if the flag is not a mode.
+   */
+  static HugePageResource* forTables();
+
+  static HugePageMode parseMode(const std::string& mode);
+
+ private:
+  // Forbidden copy constructor and assignment operator
+  HugePageResource(HugePageResource const &) = delete;
+  HugePageResource& operator=(HugePageResource const &) = delete;
+
+  bool usesHugePages(size_t bytes) const {
+    return mode_ != HugePageMode::NONE && bytes >= kMinHugePageAlloc;
+  }
+  static size_t mappedSize(size_t bytes) {
+    return (bytes + kHugePageSize - 1) & ~(kHugePageSize - 1);
+  }
+  static void* mapTransparent(size_t size);
+
+  const HugePageMode mode_;
+  std::atomic<uint64_t> mappedBytes_{0};
+  std::atomic<uint64_t> explicitFallbacks_{0};
+};
+
+/*
+ * A standard allocator that draws memory from a HugePageResource, by
+ * default the one of the hardware tables.
+ */
+template <typename T>
+class HugePageAllocator {
+ public:
+  using value_type = T;
+  // The memory must go back to the resource it came from
+  using propagate_on_container_copy_assignment = std::true_type;
+  using propagate_on_container_move_assignment = std::true_type;
+  using propagate_on_container_swap = std::true_type;
+
+  template <typename U>
+  struct rebind {
+    using other = HugePageAllocator<U>;
+  };
+
+  HugePageAllocator() : resource_(HugePageResource::forTables()) {}
+  /* implicit */ HugePageAllocator(HugePageResource* resource)
+      : resource_(resource) {}
+  template <typename U>
+  /* implicit */ HugePageAllocator(const HugePageAllocator<U>& other)
+      : resource_(other.getResource()) {}
+
+  T* allocate(size_t n) {
+    return static_cast<T*>(resource_->allocate(n * sizeof(T)));
+  }
+  void deallocate(T* ptr, size_t n) noexcept {
+    resource_->deallocate(ptr, n * sizeof(T));
+  }
+
+  HugePageResource* getResource() const {
+    return resource_;
+  }
+
+  template <typename U>
+  bool operator==(const HugePageAllocator<U>& other) const {
+    return resource_ == other.getResource();
+  }
+  template <typename U>
+  bool operator!=(const HugePageAllocator<U>& other) const {
+    return resource_ != other.getResource();
+  }
+
+ private:
+  HugePageResource* resource_;
+};
+
+/*
+ * HugePageBlockPool hands out allocations of one fixed size, too small to be
+ * mapped on their own, from huge pages of a HugePageResource, so that a
+ * table made of many such blocks, like a SortedBlockMap, is still backed by
+ * huge pages.  Freed blocks are kept for reuse, and the huge pages are only
+ * given back to the resource when the pool is destroyed.
+ *
+ * Allocations of any other size, and all of them when the resource doesn't
+ * use huge pages, go straight to the resource.  The pool is not thread
+ * safe: the table it backs must already only be changed by one thread at a
+ * time.
+ */
+class HugePageBlockPool {
+ public:
+  HugePageBlockPool(HugePageResource* resource, size_t blockBytes);
+  ~HugePageBlockPool();
+
+  void* allocate(size_t bytes);
+  void deallocate(void* ptr, size_t bytes) noexcept;
+
+  HugePageResource* getResource() const {
+    return resource_;
+  }
+  // The huge pages the pool has taken from the resource
+  size_t numHugePages() const {
+    return hugePages_.size();
+  }
+
+ private:
+  // Forbidden copy constructor and assignment operator
+  HugePageBlockPool(HugePageBlockPool const &) = delete;
+  HugePageBlockPool& operator=(HugePageBlockPool const &) = delete;
+
+  bool pooled(size_t bytes) const {
+    // Blocks big enough to be mapped on their own already are
+    return bytes == blockBytes_ &&
+        stride_ < HugePageResource::kMinHugePageAlloc &&
+        resource_->getMode() != HugePageMode::NONE;
+  }
+
+  HugePageResource* const resource_;
+  const size_t blockBytes_;
+  // blockBytes_ rounded up so that every block is suitably aligned
+  const size_t stride_;
+  std::vector<void*> hugePages_;
+  // The unused end of the last huge page
+  char* next_{nullptr};
+  char* end_{nullptr};
+  // Freed blocks, each holding the pointer to the next one
+  void* freeList_{nullptr};
+};
+
+/*
+ * A standard allocator that draws memory from a HugePageBlockPool.
+ */
+template <typename T>
+class HugePageBlockAllocator {
+ public:
+  using value_type = T;
+  // The memory must go back to the pool it came from
+  using propagate_on_container_copy_assignment = std::true_type;
+  using propagate_on_container_move_assignment = std::true_type;
+  using propagate_on_container_swap = std::true_type;
+
+  template <typename U>
+  struct rebind {
+    using other = HugePageBlockAllocator<U>;
+  };
+
+  /* implicit */ HugePageBlockAllocator(HugePageBlockPool* pool)
+      : pool_(pool) {}
+  template <typename U>
+  /* implicit */ HugePageBlockAllocator(const HugePageBlockAllocator<U>& other)
+      : pool_(other.getPool()) {}
+
+  T* allocate(size_t n) {
+    return static_cast<T*>(pool_->allocate(n * sizeof(T)));
+  }
+  void deallocate(T* ptr, size_t n) noexcept {
+    pool_->deallocate(ptr, n * sizeof(T));
+  }
+
+  HugePageBlockPool* getPool() const {
+    return pool_;
+  }
+
+  template <typename U>
+  bool operator==(const HugePageBlockAllocator<U>& other) const {
+    return pool_ == other.getPool();
+  }
+  template <typename U>
+  bool operator!=(const HugePageBlockAllocator<U>& other) const {
+    return pool_ != other.getPool();
+  }
+
+ private:
+  HugePageBlockPool* pool_;
+};
+
+template <typename KeyT, typename ValueT, typename CompareT = std::less<KeyT>>
+using HugePageFlatMap = boost::container::flat_map<
+    KeyT,
+    ValueT,
+    CompareT,
+    HugePageAllocator<std::pair<KeyT, ValueT>>>;
+
+}} // facebook::fboss
@@ -9,6 +9,34 @@
  */
 #include "fboss/agent/HwSwitch.h"
 
+#include "fboss/agent/L2TableMirror.h"
+#include "fboss/agent/TxPacket.h"
+
 namespace facebook { namespace fboss {
 
+size_t HwSwitch::sendPacketsBatch(std::vector<BatchTxPacket> pkts) noexcept {
+  size_t sent = 0;
+  for (auto& pkt : pkts) {
+    bool ok = pkt.port ? sendPacketOutOfPort(std::move(pkt.pkt), *pkt.port)
+                       : sendPacketSwitched(std::move(pkt.pkt));
+    sent += ok;
+  }
+  return sent;
+}
+
+void HwSwitch::fetchL2TablePage(
+    const L2TableQuery& query,
+    const std::string& cursor,
+    size_t maxEntries,
+    L2TablePage* page) {
+  std::vector<L2EntryThrift> entries;
+  fetchL2Table(&entries);
+  L2TableMirror table;
+  for (const auto& entry : entries) {
+    table.learned(
+        VlanID(entry.vlanID), folly::MacAddress(entry.mac), entry.port);
+  }
+  table.getPage(query, cursor, maxEntries, page);
+}
+
 }} // facebook::fboss
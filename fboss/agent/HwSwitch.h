@@ -12,12 +12,16 @@
 #include "fboss/agent/HighresCounterUtil.h"
 #include "fboss/agent/types.h"
 #include "fboss/agent/if/gen-cpp2/FbossCtrl.h"
+#include "fboss/agent/state/PortDescriptor.h"
 #include "fboss/agent/gen-cpp2/switch_config_types.h"
 
 #include <folly/IPAddress.h>
+#include <folly/MacAddress.h>
+#include <folly/Optional.h>
 
 #include <memory>
 #include <utility>
+#include <vector>
 
 namespace folly{
 struct dynamic;
@@ -31,6 +35,34 @@ class StateDelta;
 class RxPacket;
 class TxPacket;
 
+/*
+ * A packet to send as part of a batch, out of port if it is set, and with
+ * switching logic otherwise.
+ */
+struct BatchTxPacket {
+  std::unique_ptr<TxPacket> pkt;
+  folly::Optional<PortID> port;
+};
+
+/*
+ * A MAC learned or aged out by the hardware, for software MAC learning.
+ */
+struct L2LearningUpdate {
+  enum class Type : uint8_t {
+    LEARN,
+    AGE,
+  };
+
+  L2LearningUpdate(
+      Type type, VlanID vlan, folly::MacAddress mac, PortDescriptor port)
+      : type(type), vlan(vlan), mac(mac), port(port) {}
+
+  Type type;
+  VlanID vlan;
+  folly::MacAddress mac;
+  PortDescriptor port;
+};
+
 struct HwInitResult {
   std::shared_ptr<SwitchState> switchState{nullptr};
   std::shared_ptr<SwitchState> switchStateDesired{nullptr};
@@ -83,6 +115,14 @@ class HwSwitch {
      */
     virtual void linkStateChanged(PortID port, bool up) = 0;
 
+    /*
+     * l2LearningUpdateReceived() is invoked by the HwSwitch when it learns
+     * or ages out a MAC, from the thread of its L2 callbacks.  It must not
+     * block.
+     */
+    virtual void l2LearningUpdateReceived(
+        const L2LearningUpdate& /*update*/) noexcept {}
+
     /*
      * Used to notify the SwSwitch of a fatal error so the implementation can
      * provide special behavior when a crash occurs.
@@ -156,6 +196,58 @@ class HwSwitch {
   virtual bool sendPacketOutOfPort(std::unique_ptr<TxPacket> pkt,
                                    PortID portID) noexcept = 0;
 
+  /*
+   * Send a burst of packets.  A HwSwitch that can hand them all to the
+   * hardware at once, with one completion for the lot, overrides this;
+   * by default they are sent one at a time.
+   *
+   * @return The number of packets successfully sent to HW.
+   */
+  virtual size_t sendPacketsBatch(std::vector<BatchTxPacket> pkts) noexcept;
+
+  /*
+   * Periodically trace synthetic packets through the hardware pipeline, as
+   * the config asks, keeping the latest samples.
+   *
+   * @return If the HwSwitch can trace packets.
+   */
+  virtual bool startPacketTraceSampling(
+      const PacketTraceSamplingConfig& /* config */) {
+    return false;
+  }
+  virtual void stopPacketTraceSampling() {}
+  virtual std::vector<PacketTraceSample> getPacketTraceSamples() const {
+    return {};
+  }
+
+  /*
+   * Count and time the calls made into the hardware SDK.
+   *
+   * @return If the HwSwitch can profile its SDK calls.
+   */
+  virtual bool setSdkCallProfiling(bool /* enable */) {
+    return false;
+  }
+  virtual std::vector<SdkCallProfile> getSdkCallProfile() const {
+    return {};
+  }
+
+  /*
+   * Enable or disable forwarding over a member port of an aggregate port in
+   * hardware right away, ahead of the state update that records the change,
+   * for fast LAG failover.  May be called from any thread, and doesn't wait
+   * for a state update being applied.
+   *
+   * @return If the hardware was changed.  If not, only the state update
+   *         changes it.
+   */
+  virtual bool setAggregatePortMemberForwarding(
+      AggregatePortID /* aggPort */,
+      PortID /* port */,
+      bool /* enable */) {
+    return false;
+  }
+
   /*
    * Allows hardware-specific code to record switch statistics.
    */
@@ -181,6 +273,20 @@ class HwSwitch {
 
   virtual void fetchL2Table(std::vector<L2EntryThrift> *l2Table) = 0;
 
+  /*
+   * One page of the L2 table entries matching the query, for
+   * getL2TablePage().
+   *
+   * By default this fetches the whole L2 table and pages through a copy of
+   * it.  Implementations that keep a copy of the table, like BcmSwitch, page
+   * through that instead.
+   */
+  virtual void fetchL2TablePage(
+      const L2TableQuery& query,
+      const std::string& cursor,
+      size_t maxEntries,
+      L2TablePage* page);
+
   /*
    * Allow hardware to perform any warm boot related cleanup
    * before we exit the application.
@@ -232,6 +338,17 @@ class HwSwitch {
    */
   virtual bool getAndClearNeighborHit(RouterID vrf,
                                       folly::IPAddress& ip) = 0;
+
+  /*
+   * Returns the VRFs and addresses of all of the arp/ndp entries that have
+   * been hit since the last call, clearing their hit bits, with a single
+   * pass over the host table.  Returns folly::none if the hardware can't
+   * report them in bulk, in which case getAndClearNeighborHit() is used.
+   */
+  virtual folly::Optional<std::vector<std::pair<RouterID, folly::IPAddress>>>
+  getAndClearNeighborHits() {
+    return folly::none;
+  }
  private:
   // Forbidden copy constructor and assignment operator
   HwSwitch(HwSwitch const &) = delete;
@@ -19,6 +19,7 @@
 #include "fboss/agent/FbossError.h"
 #include "fboss/agent/HwSwitch.h"
 #include "fboss/agent/IPHeaderV4.h"
+#include "fboss/agent/IcmpErrorLimiter.h"
 #include "fboss/agent/NeighborUpdater.h"
 #include "fboss/agent/Platform.h"
 #include "fboss/agent/PortStats.h"
@@ -30,6 +31,7 @@
 #include "fboss/agent/Utils.h"
 #include "fboss/agent/packet/ICMPHdr.h"
 #include "fboss/agent/packet/IPv4Hdr.h"
+#include "fboss/agent/packet/ParsedPacket.h"
 #include "fboss/agent/state/ArpResponseTable.h"
 #include "fboss/agent/state/ArpTable.h"
 #include "fboss/agent/state/Interface.h"
@@ -80,11 +82,17 @@ IPv4Handler::IPv4Handler(SwSwitch* sw)
   : sw_(sw) {
 }
 
-void IPv4Handler::sendICMPTimeExceeded(VlanID srcVlan,
+void IPv4Handler::sendICMPTimeExceeded(PortID srcPort,
+                                       VlanID srcVlan,
                                        MacAddress dst,
                                        MacAddress src,
                                        IPv4Hdr& v4Hdr,
                                        Cursor cursor) {
+  if (!sw_->getIcmpErrorLimiter()->admit(v4Hdr.srcAddr)) {
+    sw_->portStats(srcPort)->icmpErrorRateLimited();
+    return;
+  }
+
   auto state = sw_->getState();
 
   // payload serialization function
@@ -111,21 +119,23 @@ void IPv4Handler::sendICMPTimeExceeded(VlanID srcVlan,
 }
 
 void IPv4Handler::handlePacket(unique_ptr<RxPacket> pkt,
-                               MacAddress dst,
-                               MacAddress src,
-                               Cursor cursor) {
+                               const ParsedPacket& parsed) {
   SwitchStats* stats = sw_->stats();
   PortID port = pkt->getSrcPort();
+  const auto& dst = parsed.dstMac;
+  const auto& src = parsed.srcMac;
 
-  const uint32_t l3Len = pkt->getLength() - (cursor - Cursor(pkt->buf()));
+  const uint32_t l3Len = pkt->getLength() - parsed.l3Offset;
   stats->port(port)->ipv4Rx();
+  Cursor cursor(pkt->buf());
+  cursor += parsed.l3Offset;
   IPv4Hdr v4Hdr(cursor);
   XLOG(DBG4) << "Rx IPv4 packet (" << l3Len << " bytes) " << v4Hdr.srcAddr.str()
              << " --> " << v4Hdr.dstAddr.str() << " proto: 0x" << std::hex
              << static_cast<int>(v4Hdr.protocol);
 
   // retrieve the current switch state
-  auto state = sw_->getState();
+  auto state = sw_->getStateSnapshot();
   // Need to check if the packet is for self or not. We store our IP
   // in the ARP response table. Use that for now.
   auto vlan = state->getVlans()->getVlanIf(pkt->getSrcVlan());
@@ -134,10 +144,10 @@ void IPv4Handler::handlePacket(unique_ptr<RxPacket> pkt,
     return;
   }
 
-  if (v4Hdr.protocol == IPPROTO_UDP) {
+  if (v4Hdr.protocol == IPPROTO_UDP && parsed.hasL4()) {
     Cursor udpCursor(cursor);
     UDPHeader udpHdr;
-    udpHdr.parse(sw_, port, &udpCursor);
+    udpHdr.parse(&udpCursor);
     XLOG(DBG4) << "UDP packet, Source port :" << udpHdr.srcPort
                << " destination port: " << udpHdr.dstPort;
     if (DHCPv4Handler::isDHCPv4Packet(udpHdr)) {
@@ -196,7 +206,8 @@ void IPv4Handler::handlePacket(unique_ptr<RxPacket> pkt,
     stats->port(port)->ipv4TtlExceeded();
     // Look up cpu mac from platform
     MacAddress cpuMac = sw_->getPlatform()->getLocalMac();
-    sendICMPTimeExceeded(pkt->getSrcVlan(), cpuMac, cpuMac, v4Hdr, cursor);
+    sendICMPTimeExceeded(
+        port, pkt->getSrcVlan(), cpuMac, cpuMac, v4Hdr, cursor);
     return;
   }
 
@@ -23,6 +23,7 @@ class Cursor;
 
 namespace facebook { namespace fboss {
 
+struct ParsedPacket;
 class RxPacket;
 class SwitchState;
 class SwSwitch;
@@ -34,10 +35,12 @@ class IPv4Handler {
 
   explicit IPv4Handler(SwSwitch* sw);
 
+  /*
+   * The headers up to and including the IP header have been checked by
+   * ParsedPacket::parse().
+   */
   void handlePacket(std::unique_ptr<RxPacket> pkt,
-                    folly::MacAddress dst,
-                    folly::MacAddress src,
-                    folly::io::Cursor cursor);
+                    const ParsedPacket& parsed);
 
   /*
    * TODO(aeckert): t17949183 unify packet handling pipeline and then
@@ -48,7 +51,11 @@ class IPv4Handler {
                   folly::IPAddressV4 dest);
 
  private:
-  void sendICMPTimeExceeded(VlanID srcVlan,
+  /*
+   * ICMP errors over the configured rate limit are not sent.
+   */
+  void sendICMPTimeExceeded(PortID srcPort,
+                            VlanID srcVlan,
                             folly::MacAddress dst,
                             folly::MacAddress src,
                             IPv4Hdr& v4Hdr,
@@ -14,6 +14,7 @@
 #include <folly/logging/xlog.h>
 #include "fboss/agent/DHCPv6Handler.h"
 #include "fboss/agent/FbossError.h"
+#include "fboss/agent/IcmpErrorLimiter.h"
 #include "fboss/agent/NeighborUpdater.h"
 #include "fboss/agent/Platform.h"
 #include "fboss/agent/RxPacket.h"
@@ -25,6 +26,7 @@
 #include "fboss/agent/packet/ICMPHdr.h"
 #include "fboss/agent/packet/IPv6Hdr.h"
 #include "fboss/agent/packet/NDP.h"
+#include "fboss/agent/packet/ParsedPacket.h"
 #include "fboss/agent/packet/PktUtil.h"
 #include "fboss/agent/state/Interface.h"
 #include "fboss/agent/state/InterfaceMap.h"
@@ -48,6 +50,11 @@ using std::shared_ptr;
 
 namespace facebook { namespace fboss {
 
+namespace {
+// Where unsolicited neighbor advertisements are sent
+const IPAddressV6 kAllNodesInterfaceLocal("ff01::1");
+} // unnamed namespace
+
 template<typename BodyFn>
 std::unique_ptr<TxPacket> createICMPv6Pkt(SwSwitch* sw,
                                           folly::MacAddress dstMac,
@@ -84,20 +91,20 @@ struct IPv6Handler::ICMPHeaders {
 
 IPv6Handler::IPv6Handler(SwSwitch* sw)
     : AutoRegisterStateObserver(sw, "IPv6Handler"),
-      sw_(sw) {
+      sw_(sw),
+      routeAdvertiser_(sw) {
 }
 
 void IPv6Handler::stateUpdated(const StateDelta& delta) {
+  updateNdpCache(delta);
+
   for (const auto& entry : delta.getIntfsDelta()) {
     if (!entry.getOld()) {
-      intfAdded(delta.newState().get(), entry.getNew().get());
+      intfAdded(entry.getNew().get());
     } else if (!entry.getNew()) {
       intfDeleted(entry.getOld().get());
     } else {
-      // TODO: We could add an intfChanged() method to re-use the existing
-      // IPv6RouteAdvertiser object.
-      intfDeleted(entry.getOld().get());
-      intfAdded(delta.newState().get(), entry.getNew().get());
+      intfChanged(entry.getOld().get(), entry.getNew().get());
     }
   }
 }
@@ -106,30 +113,89 @@ bool IPv6Handler::raEnabled(const Interface* intf) const {
   return intf->getNdpConfig().routerAdvertisementSeconds > 0;
 }
 
-void IPv6Handler::intfAdded(const SwitchState* state, const Interface* intf) {
+void IPv6Handler::intfAdded(const Interface* intf) {
   // If IPv6 router advertisement isn't enabled on this interface, ignore it.
   if (!raEnabled(intf)) {
     return;
   }
+  routeAdvertiser_.addInterface(intf);
+}
 
-  IPv6RouteAdvertiser adv(sw_, state, intf);
-  auto ret = routeAdvertisers_.emplace(intf->getID(), std::move(adv));
-  CHECK(ret.second);
+void IPv6Handler::intfChanged(const Interface* oldIntf,
+                              const Interface* newIntf) {
+  if (!raEnabled(oldIntf)) {
+    intfAdded(newIntf);
+  } else if (!raEnabled(newIntf)) {
+    intfDeleted(oldIntf);
+  } else {
+    // Only builds the advertisement again if it changed
+    routeAdvertiser_.changeInterface(oldIntf, newIntf);
+  }
 }
 
 void IPv6Handler::intfDeleted(const Interface* intf) {
   if (!raEnabled(intf)) {
     return;
   }
-  auto numErased = routeAdvertisers_.erase(intf->getID());
-  CHECK_EQ(numErased, 1);
+  routeAdvertiser_.removeInterface(intf);
+}
+
+void IPv6Handler::updateNdpCache(const StateDelta& delta) {
+  // Most VLAN changes are neighbor updates, which leave the response
+  // tables alone, so only the tables that changed are swapped in
+  std::vector<std::pair<VlanID, std::shared_ptr<NdpResponseTable>>> changed;
+  for (const auto& vlanDelta : delta.getVlansDelta()) {
+    const auto& oldVlan = vlanDelta.getOld();
+    const auto& newVlan = vlanDelta.getNew();
+    if (!newVlan) {
+      changed.emplace_back(oldVlan->getID(), nullptr);
+    } else if (
+        !oldVlan ||
+        oldVlan->getNdpResponseTable() != newVlan->getNdpResponseTable()) {
+      changed.emplace_back(newVlan->getID(), newVlan->getNdpResponseTable());
+    }
+  }
+  if (changed.empty()) {
+    return;
+  }
+  auto cache = ndpCache_.wlock();
+  for (auto& vlanAndTable : changed) {
+    if (vlanAndTable.second) {
+      (*cache)[vlanAndTable.first] = std::move(vlanAndTable.second);
+    } else {
+      cache->erase(vlanAndTable.first);
+    }
+  }
+}
+
+bool IPv6Handler::getNdpResponse(
+    VlanID vlanID,
+    const IPAddressV6& ip,
+    folly::Optional<NeighborResponseEntry>* entry) const {
+  {
+    auto cache = ndpCache_.rlock();
+    auto vlanIt = cache->find(vlanID);
+    if (vlanIt != cache->end()) {
+      *entry = vlanIt->second->getEntry(ip);
+      return true;
+    }
+  }
+
+  auto vlan = sw_->getState()->getVlans()->getVlanIf(vlanID);
+  if (!vlan) {
+    return false;
+  }
+  *entry = vlan->getNdpResponseTable()->getEntry(ip);
+  return true;
 }
 
 void IPv6Handler::handlePacket(unique_ptr<RxPacket> pkt,
-                               MacAddress dst,
-                               MacAddress src,
-                               Cursor cursor) {
-  const uint32_t l3Len = pkt->getLength() - (cursor - Cursor(pkt->buf()));
+                               const ParsedPacket& parsed) {
+  const auto& dst = parsed.dstMac;
+  const auto& src = parsed.srcMac;
+  const uint32_t l3Len = pkt->getLength() - parsed.l3Offset;
+  Cursor cursor(pkt->buf());
+  cursor += parsed.l3Offset;
   IPv6Hdr ipv6(cursor);  // note: advances our cursor object
   XLOG(DBG4) << "IPv6 (" << l3Len
              << " bytes)"
@@ -140,7 +206,7 @@ void IPv6Handler::handlePacket(unique_ptr<RxPacket> pkt,
              << " nextHeader: " << static_cast<int>(ipv6.nextHeader);
 
   // retrieve the current switch state
-  auto state = sw_->getState();
+  auto state = sw_->getStateSnapshot();
   PortID port = pkt->getSrcPort();
 
   // NOTE: DHCPv6 solicit packet from client has hoplimit set to 1,
@@ -148,7 +214,7 @@ void IPv6Handler::handlePacket(unique_ptr<RxPacket> pkt,
   if (ipv6.nextHeader == IP_PROTO_UDP) {
     UDPHeader udpHdr;
     Cursor udpCursor(cursor);
-    udpHdr.parse(sw_, port, &udpCursor);
+    udpHdr.parse(&udpCursor);
     XLOG(DBG4) << "DHCP UDP packet, source port :" << udpHdr.srcPort
                << " destination port: " << udpHdr.dstPort;
     if (DHCPv6Handler::isForDHCPv6RelayOrServer(udpHdr)) {
@@ -193,7 +259,8 @@ void IPv6Handler::handlePacket(unique_ptr<RxPacket> pkt,
     sw_->portStats(port)->ipv6HopExceeded();
     // Look up cpu mac from platform
     MacAddress cpuMac = sw_->getPlatform()->getLocalMac();
-    sendICMPv6TimeExceeded(pkt->getSrcVlan(), cpuMac, cpuMac, ipv6, cursor);
+    sendICMPv6TimeExceeded(
+        port, pkt->getSrcVlan(), cpuMac, cpuMac, ipv6, cursor);
     return;
   }
 
@@ -328,11 +395,17 @@ void IPv6Handler::handleRouterSolicitation(unique_ptr<RxPacket> pkt,
   XLOG(DBG4) << "sending router advertisement in response to solicitation from "
              << dstIP.str() << " (" << dstMac << ")";
 
-  uint32_t pktLen = IPv6RouteAdvertiser::getPacketSize(intf.get());
-  auto resp = sw_->allocatePacket(pktLen);
-  RWPrivateCursor respCursor(resp->buf());
-  IPv6RouteAdvertiser::createAdvertisementPacket(
-    intf.get(), &respCursor, dstMac, dstIP);
+  // Answered from the interface's cached advertisement, unless it isn't
+  // sending them periodically
+  auto resp = routeAdvertiser_.createSolicitedAdvertisement(
+      intf->getID(), dstMac, dstIP);
+  if (!resp) {
+    uint32_t pktLen = IPv6RouteAdvertiser::getPacketSize(intf.get());
+    resp = sw_->allocatePacket(pktLen);
+    RWPrivateCursor respCursor(resp->buf());
+    IPv6RouteAdvertiser::createAdvertisementPacket(
+      intf.get(), &respCursor, dstMac, dstIP);
+  }
   sw_->sendPacketSwitched(std::move(resp));
 }
 
@@ -376,9 +449,10 @@ void IPv6Handler::handleNeighborSolicitation(unique_ptr<RxPacket> pkt,
   }
   XLOG(DBG4) << "got neighbor solicitation for " << targetIP.str();
 
-  auto state = sw_->getState();
-  auto vlan = state->getVlans()->getVlanIf(pkt->getSrcVlan());
-  if (!vlan) {
+  // Check to see if this IP address is in our NDP response table.
+  auto vlanID = pkt->getSrcVlan();
+  folly::Optional<NeighborResponseEntry> entry;
+  if (!getNdpResponse(vlanID, targetIP, &entry)) {
     // Hmm, we don't actually have this VLAN configured.
     // Perhaps the state has changed since we received the packet.
     sw_->portStats(pkt)->pktDropped();
@@ -388,16 +462,14 @@ void IPv6Handler::handleNeighborSolicitation(unique_ptr<RxPacket> pkt,
   auto updater = sw_->getNeighborUpdater();
   auto type = ICMPV6_TYPE_NDP_NEIGHBOR_SOLICITATION;
 
-  // Check to see if this IP address is in our NDP response table.
-  auto entry = vlan->getNdpResponseTable()->getEntry(targetIP);
   if (!entry) {
-    updater->receivedNdpNotMine(vlan->getID(), hdr.ipv6->srcAddr, hdr.src,
+    updater->receivedNdpNotMine(vlanID, hdr.ipv6->srcAddr, hdr.src,
                                 PortDescriptor::fromRxPacket(*pkt.get()),
                                 type, 0);
     return;
   }
 
-  updater->receivedNdpMine(vlan->getID(), hdr.ipv6->srcAddr, hdr.src,
+  updater->receivedNdpMine(vlanID, hdr.ipv6->srcAddr, hdr.src,
                            PortDescriptor::fromRxPacket(*pkt.get()),
                            type, 0);
 
@@ -405,7 +477,7 @@ void IPv6Handler::handleNeighborSolicitation(unique_ptr<RxPacket> pkt,
   // whether our IP is tentative or not.
 
   // Send the response
-  sendNeighborAdvertisement(pkt->getSrcVlan(),
+  sendNeighborAdvertisement(vlanID,
                             entry.value().mac, targetIP,
                             hdr.src, hdr.ipv6->srcAddr);
 }
@@ -450,9 +522,10 @@ void IPv6Handler::handleNeighborAdvertisement(unique_ptr<RxPacket> pkt,
     return;
   }
 
-  auto state = sw_->getState();
-  auto vlan = state->getVlans()->getVlanIf(pkt->getSrcVlan());
-  if (!vlan) {
+  // Check to see if this IP address is in our NDP response table.
+  auto vlanID = pkt->getSrcVlan();
+  folly::Optional<NeighborResponseEntry> entry;
+  if (!getNdpResponse(vlanID, hdr.ipv6->dstAddr, &entry)) {
     // Hmm, we don't actually have this VLAN configured.
     // Perhaps the state has changed since we received the packet.
     sw_->portStats(pkt)->pktDropped();
@@ -465,26 +538,30 @@ void IPv6Handler::handleNeighborAdvertisement(unique_ptr<RxPacket> pkt,
   auto updater = sw_->getNeighborUpdater();
   auto type = ICMPV6_TYPE_NDP_NEIGHBOR_ADVERTISEMENT;
 
-  // Check to see if this IP address is in our NDP response table.
-  auto entry = vlan->getNdpResponseTable()->getEntry(hdr.ipv6->dstAddr);
   if (!entry) {
-    updater->receivedNdpNotMine(vlan->getID(), targetIP, hdr.src,
+    updater->receivedNdpNotMine(vlanID, targetIP, hdr.src,
                                 PortDescriptor::fromRxPacket(*pkt.get()),
                                 type, flags);
     return;
   }
 
-  updater->receivedNdpMine(vlan->getID(), targetIP, hdr.src,
+  updater->receivedNdpMine(vlanID, targetIP, hdr.src,
                            PortDescriptor::fromRxPacket(*pkt.get()),
                            type, flags);
 }
 
 
-void IPv6Handler::sendICMPv6TimeExceeded(VlanID srcVlan,
+void IPv6Handler::sendICMPv6TimeExceeded(PortID srcPort,
+                              VlanID srcVlan,
                               MacAddress dst,
                               MacAddress src,
                               IPv6Hdr& v6Hdr,
                               folly::io::Cursor cursor) {
+  if (!sw_->getIcmpErrorLimiter()->admit(v6Hdr.srcAddr)) {
+    sw_->portStats(srcPort)->icmpErrorRateLimited();
+    return;
+  }
+
   auto state = sw_->getState();
 
   // payload serialization function
@@ -524,6 +601,11 @@ void IPv6Handler::sendICMPv6PacketTooBig(
     IPv6Hdr& v6Hdr,
     int expectedMtu,
     folly::io::Cursor cursor) {
+  if (!sw_->getIcmpErrorLimiter()->admit(v6Hdr.srcAddr)) {
+    sw_->portStats(srcPort)->icmpErrorRateLimited();
+    return;
+  }
+
   auto state = sw_->getState();
 
   // payload serialization function
@@ -783,8 +865,7 @@ void IPv6Handler::sendNeighborAdvertisement(VlanID vlan,
 
   uint32_t flags = 0xa0000000; // router, override
   if (dstIP.isZero()) {
-    // TODO: add a constructor that doesn't require string processing
-    dstIP = IPAddressV6("ff01::1");
+    dstIP = kAllNodesInterfaceLocal;
   } else {
     // Set the solicited flag
     flags |= 0x40000000;
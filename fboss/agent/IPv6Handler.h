@@ -12,11 +12,15 @@
 #include "fboss/agent/types.h"
 #include "fboss/agent/ndp/IPv6RouteAdvertiser.h"
 #include "fboss/agent/StateObserver.h"
+#include "fboss/agent/state/NdpResponseTable.h"
 
 #include <memory>
 #include <boost/container/flat_map.hpp>
 #include <folly/IPAddressV6.h>
 #include <folly/MacAddress.h>
+#include <folly/Optional.h>
+#include <folly/SharedMutex.h>
+#include <folly/Synchronized.h>
 namespace folly { namespace io {
 class Cursor;
 }}
@@ -25,6 +29,7 @@ namespace facebook { namespace fboss {
 
 class IPv6Hdr;
 class Interface;
+struct ParsedPacket;
 class RxPacket;
 class StateDelta;
 class SwitchState;
@@ -39,10 +44,12 @@ class IPv6Handler : public AutoRegisterStateObserver {
 
   void stateUpdated(const StateDelta& delta) override;
 
+  /*
+   * The headers up to and including the IP header have been checked by
+   * ParsedPacket::parse().
+   */
   void handlePacket(std::unique_ptr<RxPacket> pkt,
-                    folly::MacAddress dst,
-                    folly::MacAddress src,
-                    folly::io::Cursor cursor);
+                    const ParsedPacket& parsed);
 
   void floodNeighborAdvertisements();
   void sendNeighborSolicitation(const folly::IPAddressV6& targetIP,
@@ -72,17 +79,41 @@ class IPv6Handler : public AutoRegisterStateObserver {
 
  private:
   struct ICMPHeaders;
-  typedef boost::container::flat_map<InterfaceID, IPv6RouteAdvertiser> RAMap;
+  /*
+   * The NDP response table of each VLAN, which has every address of its
+   * interface, link-local included, with the MAC to answer with.  The
+   * published tables are taken out of the SwitchState whenever those of
+   * the VLANs change, so that neighbor solicitations and advertisements
+   * don't have to walk the state, and are looked up in their hash.
+   */
+  typedef boost::container::flat_map<
+      VlanID, std::shared_ptr<NdpResponseTable>>
+    NdpCache;
 
   // Forbidden copy constructor and assignment operator
   IPv6Handler(IPv6Handler const &) = delete;
   IPv6Handler& operator=(IPv6Handler const &) = delete;
 
   bool raEnabled(const Interface* intf) const;
-  void intfAdded(const SwitchState* state, const Interface* intf);
+  void intfAdded(const Interface* intf);
+  void intfChanged(const Interface* oldIntf, const Interface* newIntf);
   void intfDeleted(const Interface* intf);
 
-  void sendICMPv6TimeExceeded(VlanID srcVlan,
+  void updateNdpCache(const StateDelta& delta);
+  /*
+   * Looks up the NDP response for an address on a VLAN, returning false
+   * if the VLAN is not configured.  VLANs not yet in the cache, because
+   * their state update is still being applied, are looked up in the state.
+   */
+  bool getNdpResponse(VlanID vlanID,
+                      const folly::IPAddressV6& ip,
+                      folly::Optional<NeighborResponseEntry>* entry) const;
+
+  /*
+   * ICMP errors over the configured rate limit are not sent.
+   */
+  void sendICMPv6TimeExceeded(PortID srcPort,
+                              VlanID srcVlan,
                               folly::MacAddress dst,
                               folly::MacAddress src,
                               IPv6Hdr& v6Hdr,
@@ -143,7 +174,8 @@ class IPv6Handler : public AutoRegisterStateObserver {
       folly::io::Cursor cursor);
 
   SwSwitch* sw_{nullptr};
-  RAMap routeAdvertisers_;
+  IPv6RouteAdvertiser routeAdvertiser_;
+  folly::Synchronized<NdpCache, folly::SharedMutex> ndpCache_;
 };
 
 }} // facebook::fboss
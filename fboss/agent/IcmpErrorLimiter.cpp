@@ -0,0 +1,96 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "fboss/agent/IcmpErrorLimiter.h"
+
+#include "fboss/agent/state/StateDelta.h"
+#include "fboss/agent/state/SwitchState.h"
+
+#include <folly/ScopeGuard.h>
+#include <folly/logging/xlog.h>
+
+namespace facebook { namespace fboss {
+
+IcmpErrorLimiter::IcmpErrorLimiter() {}
+
+IcmpErrorLimiter::~IcmpErrorLimiter() {}
+
+void IcmpErrorLimiter::stateUpdated(const StateDelta& delta) {
+  const auto& oldLimit =
+      delta.oldState()->getControlPlane()->getIcmpErrorRateLimit();
+  const auto& newLimit =
+      delta.newState()->getControlPlane()->getIcmpErrorRateLimit();
+  if (oldLimit != newLimit) {
+    setLimit(newLimit);
+  }
+}
+
+void IcmpErrorLimiter::setLimit(
+    const folly::Optional<IcmpErrorRateLimit>& limit) {
+  std::lock_guard<std::mutex> guard(lock_);
+  std::unique_ptr<Limiter> limiter;
+  if (!limit) {
+    XLOG(DBG2) << "Not limiting ICMP errors";
+  } else {
+    XLOG(DBG2) << "Limiting ICMP errors to " << limit->packetsPerSec
+               << "/s, and " << limit->perSourcePacketsPerSec
+               << "/s per source prefix";
+    limiter = std::make_unique<Limiter>(*limit);
+  }
+  current_.store(limiter.get(), std::memory_order_seq_cst);
+  if (owned_) {
+    retired_.push_back(std::move(owned_));
+  }
+  owned_ = std::move(limiter);
+  // Any admit() that starts from here on only sees the new limiter
+  if (readers_.load(std::memory_order_seq_cst) == 0) {
+    retired_.clear();
+  }
+}
+
+size_t IcmpErrorLimiter::numLimiters() {
+  std::lock_guard<std::mutex> guard(lock_);
+  return retired_.size() + (owned_ ? 1 : 0);
+}
+
+bool IcmpErrorLimiter::admit(const folly::IPAddress& dst) {
+  return admit(dst, folly::DynamicTokenBucket::defaultClockNow());
+}
+
+bool IcmpErrorLimiter::admit(const folly::IPAddress& dst,
+                             double nowInSeconds) {
+  readers_.fetch_add(1, std::memory_order_seq_cst);
+  SCOPE_EXIT {
+    readers_.fetch_sub(1, std::memory_order_release);
+  };
+  auto limiter = current_.load(std::memory_order_seq_cst);
+  if (!limiter) {
+    return true;
+  }
+  const auto& config = limiter->config;
+
+  // The source's bucket is checked first, so that a source over its limit
+  // doesn't use up the tokens of the others.
+  if (config.perSourcePacketsPerSec > 0) {
+    auto prefixLength = dst.isV4() ? config.v4SourcePrefixLength
+                                   : config.v6SourcePrefixLength;
+    auto index = dst.mask(prefixLength).hash() % kNumSourceBuckets;
+    if (!limiter->perSource[index].consume(
+            1,
+            config.perSourcePacketsPerSec,
+            config.perSourceBurstSize,
+            nowInSeconds)) {
+      return false;
+    }
+  }
+  return limiter->global.consume(
+      1, config.packetsPerSec, config.burstSize, nowInSeconds);
+}
+
+}} // facebook::fboss
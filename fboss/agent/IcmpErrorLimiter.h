@@ -0,0 +1,90 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#pragma once
+
+#include "fboss/agent/StateObserver.h"
+#include "fboss/agent/state/ControlPlane.h"
+
+#include <folly/IPAddress.h>
+#include <folly/Optional.h>
+#include <folly/TokenBucket.h>
+
+#include <array>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace facebook { namespace fboss {
+
+/*
+ * IcmpErrorLimiter applies the ICMP error rate limit configured in the
+ * ControlPlane to the time exceeded and packet too big errors we send, with
+ * a token bucket for the whole switch and one for each source prefix.  The
+ * errors are checked before they are built, so those over the limit cost
+ * little more than the check.
+ *
+ * admit() is called from the packet receive threads and never blocks.  The
+ * limit is replaced from the update thread when the ControlPlane changes.
+ */
+class IcmpErrorLimiter : public StateObserver {
+ public:
+  // The number of per-source buckets, which prefixes that collide share
+  enum : size_t { kNumSourceBuckets = 1024 };
+
+  IcmpErrorLimiter();
+  ~IcmpErrorLimiter() override;
+
+  void stateUpdated(const StateDelta& delta) override;
+
+  /*
+   * Replace the limit, refilling all of the buckets.  Errors are not limited
+   * without one.
+   */
+  void setLimit(const folly::Optional<IcmpErrorRateLimit>& limit);
+
+  /*
+   * Returns false if an ICMP error to dst, the source of the packet that
+   * caused it, should not be sent.
+   */
+  bool admit(const folly::IPAddress& dst);
+  bool admit(const folly::IPAddress& dst, double nowInSeconds);
+
+  // The number of limiters still allocated, including the one in use
+  size_t numLimiters();
+
+ private:
+  struct Limiter {
+    explicit Limiter(const IcmpErrorRateLimit& config) : config(config) {}
+
+    const IcmpErrorRateLimit config;
+    folly::DynamicTokenBucket global;
+    std::array<folly::DynamicTokenBucket, kNumSourceBuckets> perSource;
+  };
+
+  // Forbidden copy constructor and assignment operator
+  IcmpErrorLimiter(IcmpErrorLimiter const &) = delete;
+  IcmpErrorLimiter& operator=(IcmpErrorLimiter const &) = delete;
+
+  /*
+   * The limiter in use, or null for no limit.  Errors may still be using
+   * the previous limiters after they are replaced, so those are retired,
+   * and only freed by a later setLimit() once no admit() is in progress.
+   * admit() counts itself in readers_ before loading current_, so a reader
+   * that isn't counted can only see the newest limiter.
+   */
+  std::atomic<Limiter*> current_{nullptr};
+  std::atomic<uint32_t> readers_{0};
+  std::mutex lock_;
+  std::unique_ptr<Limiter> owned_;
+  std::vector<std::unique_ptr<Limiter>> retired_;
+};
+
+}} // facebook::fboss
@@ -0,0 +1,257 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "fboss/agent/L2TableMirror.h"
+
+#include "fboss/agent/FbossError.h"
+
+#include <folly/Conv.h>
+#include <folly/Optional.h>
+
+#include <cctype>
+
+using folly::MacAddress;
+
+namespace facebook { namespace fboss {
+
+namespace {
+
+constexpr size_t kMacNibbles = 12;
+
+/*
+ * The MACs starting with a prefix such as "02:00:0", as the number of low
+ * bits any MAC may have after it and the high bits of every MAC with it.
+ */
+struct MacPrefix {
+  uint32_t freeBits{kMacNibbles * 4};
+  uint64_t bits{0};
+
+  uint64_t first() const {
+    return bits << freeBits;
+  }
+  bool matches(MacAddress mac) const {
+    return (mac.u64HBO() >> freeBits) == bits;
+  }
+};
+
+MacPrefix parseMacPrefix(const std::string& str) {
+  MacPrefix prefix;
+  for (auto c : str) {
+    if (c == ':') {
+      continue;
+    }
+    if (!isxdigit(c) || prefix.freeBits == 0) {
+      throw FbossError("invalid MAC prefix \"", str, "\"");
+    }
+    auto nibble = isdigit(c) ? c - '0' : tolower(c) - 'a' + 10;
+    prefix.bits = (prefix.bits << 4) | nibble;
+    prefix.freeBits -= 4;
+  }
+  return prefix;
+}
+
+// Cursors are the last entry of the previous page, as "<vlan>/<mac>"
+std::string encodeL2Cursor(VlanID vlan, MacAddress mac) {
+  return folly::to<std::string>(
+      static_cast<uint16_t>(vlan), "/", mac.toString());
+}
+
+folly::Optional<std::pair<VlanID, MacAddress>> parseL2Cursor(
+    const std::string& cursor) {
+  if (cursor.empty()) {
+    return folly::none;
+  }
+  auto sep = cursor.find('/');
+  if (sep == std::string::npos) {
+    throw FbossError("invalid L2 table cursor \"", cursor, "\"");
+  }
+  try {
+    return std::make_pair(
+        VlanID(folly::to<uint16_t>(cursor.substr(0, sep))),
+        MacAddress(cursor.substr(sep + 1)));
+  } catch (const std::exception& ex) {
+    throw FbossError("invalid L2 table cursor \"", cursor, "\": ", ex.what());
+  }
+}
+
+template <typename KeyT>
+const KeyT& keyOf(const KeyT& key) {
+  return key;
+}
+template <typename KeyT, typename ValueT>
+const KeyT& keyOf(const std::pair<const KeyT, ValueT>& entry) {
+  return entry.first;
+}
+
+} // unnamed namespace
+
+void L2TableMirror::learned(VlanID vlan, MacAddress mac, int32_t port) {
+  Key key(vlan, mac);
+  auto tables = tables_.wlock();
+  auto it = tables->entries.find(key);
+  if (it != tables->entries.end()) {
+    if (it->second == port) {
+      return;
+    }
+    // A station move
+    removeFromPort(*tables, key, it->second);
+    it->second = port;
+  } else {
+    tables->entries.emplace(key, port);
+    tables->byMac.emplace(mac, vlan);
+  }
+  tables->byPort[port].insert(key);
+}
+
+void L2TableMirror::aged(VlanID vlan, MacAddress mac) {
+  Key key(vlan, mac);
+  auto tables = tables_.wlock();
+  auto it = tables->entries.find(key);
+  if (it == tables->entries.end()) {
+    return;
+  }
+  removeEntry(*tables, key, it->second);
+}
+
+void L2TableMirror::clear() {
+  auto tables = tables_.wlock();
+  tables->entries.clear();
+  tables->byPort.clear();
+  tables->byMac.clear();
+}
+
+size_t L2TableMirror::size() const {
+  return tables_.rlock()->entries.size();
+}
+
+void L2TableMirror::getAll(std::vector<L2EntryThrift>* entries) const {
+  auto tables = tables_.rlock();
+  entries->reserve(entries->size() + tables->entries.size());
+  for (const auto& entry : tables->entries) {
+    entries->push_back(makeEntry(entry.first, entry.second));
+  }
+}
+
+void L2TableMirror::getPage(
+    const L2TableQuery& query,
+    const std::string& cursor,
+    size_t maxEntries,
+    L2TablePage* page) const {
+  auto after = parseL2Cursor(cursor);
+  if (maxEntries == 0) {
+    return;
+  }
+  folly::Optional<MacPrefix> macPrefix;
+  if (query.__isset.macPrefix) {
+    macPrefix = parseMacPrefix(query.macPrefix);
+  }
+  auto matches = [&](const Key& key, int32_t port) {
+    return (!query.__isset.vlanID || key.first == VlanID(query.vlanID)) &&
+        (!query.__isset.port || port == query.port) &&
+        (!macPrefix || macPrefix->matches(key.second));
+  };
+  folly::Optional<Key> last;
+  // Returns false once the page is full
+  auto add = [&](const Key& key, int32_t port) {
+    if (!matches(key, port)) {
+      return true;
+    }
+    if (page->entries.size() == maxEntries) {
+      // There is more, continue after the last entry of this page
+      page->nextCursor = encodeL2Cursor(last->first, last->second);
+      return false;
+    }
+    page->entries.push_back(makeEntry(key, port));
+    last = key;
+    return true;
+  };
+  // Where to start in an index, the first key of the query or the one
+  // after the cursor, whichever is later
+  auto start = [](const auto& index, const auto& first, const auto& after) {
+    auto it = index.lower_bound(first);
+    if (after && it != index.end() &&
+        !index.key_comp()(*after, keyOf(*it))) {
+      it = index.upper_bound(*after);
+    }
+    return it;
+  };
+
+  auto tables = tables_.rlock();
+  const auto& entries = tables->entries;
+  if (query.__isset.vlanID || (!query.__isset.port && !macPrefix)) {
+    // The entries are ordered by VLAN, so a VLAN is a range of them
+    VlanID vlan(query.__isset.vlanID ? query.vlanID : 0);
+    for (auto it = start(entries, Key(vlan, MacAddress()), after);
+         it != entries.end(); ++it) {
+      if (query.__isset.vlanID && it->first.first != vlan) {
+        break;
+      }
+      if (!add(it->first, it->second)) {
+        break;
+      }
+    }
+  } else if (query.__isset.port) {
+    auto portIt = tables->byPort.find(query.port);
+    if (portIt == tables->byPort.end()) {
+      return;
+    }
+    const auto& keys = portIt->second;
+    for (auto it = start(keys, Key(VlanID(0), MacAddress()), after);
+         it != keys.end(); ++it) {
+      if (!add(*it, query.port)) {
+        break;
+      }
+    }
+  } else {
+    // Only a MAC prefix, so pages are ordered by MAC and then VLAN instead
+    using MacKey = std::pair<MacAddress, VlanID>;
+    folly::Optional<MacKey> afterMac;
+    if (after) {
+      afterMac = MacKey(after->second, after->first);
+    }
+    const auto& byMac = tables->byMac;
+    MacKey first(MacAddress::fromHBO(macPrefix->first()), VlanID(0));
+    for (auto it = start(byMac, first, afterMac);
+         it != byMac.end() && macPrefix->matches(it->first); ++it) {
+      Key key(it->second, it->first);
+      if (!add(key, entries.at(key))) {
+        break;
+      }
+    }
+  }
+}
+
+void L2TableMirror::removeEntry(
+    Tables& tables, const Key& key, int32_t port) {
+  removeFromPort(tables, key, port);
+  tables.byMac.erase(std::make_pair(key.second, key.first));
+  tables.entries.erase(key);
+}
+
+void L2TableMirror::removeFromPort(
+    Tables& tables, const Key& key, int32_t port) {
+  auto portIt = tables.byPort.find(port);
+  if (portIt == tables.byPort.end()) {
+    return;
+  }
+  portIt->second.erase(key);
+  if (portIt->second.empty()) {
+    tables.byPort.erase(portIt);
+  }
+}
+
+L2EntryThrift L2TableMirror::makeEntry(const Key& key, int32_t port) {
+  L2EntryThrift entry;
+  entry.mac = key.second.toString();
+  entry.port = port;
+  entry.vlanID = key.first;
+  return entry;
+}
+
+}} // facebook::fboss
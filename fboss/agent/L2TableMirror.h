@@ -0,0 +1,92 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#pragma once
+
+#include "fboss/agent/if/gen-cpp2/ctrl_types.h"
+#include "fboss/agent/types.h"
+
+#include <folly/MacAddress.h>
+#include <folly/Synchronized.h>
+
+#include <map>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace facebook { namespace fboss {
+
+/*
+ * L2TableMirror is a software copy of the hardware L2 table, kept up to
+ * date from the L2 learn and age callbacks, so that the L2 table can be
+ * listed without traversing the hardware table.
+ *
+ * Besides the entries themselves, ordered by VLAN and then MAC, it indexes
+ * them by port and by MAC, so a query for a port or for a MAC prefix only
+ * walks the entries it returns.
+ *
+ * It is thread safe: the callbacks update it from the SDK's L2 thread
+ * while thrift threads query it.
+ */
+class L2TableMirror {
+ public:
+  L2TableMirror() {}
+
+  /*
+   * An entry was learned, or moved to another port.
+   */
+  void learned(VlanID vlan, folly::MacAddress mac, int32_t port);
+  /*
+   * An entry was aged out or deleted.
+   */
+  void aged(VlanID vlan, folly::MacAddress mac);
+  void clear();
+
+  size_t size() const;
+
+  /*
+   * Every entry, ordered by VLAN and then MAC.
+   */
+  void getAll(std::vector<L2EntryThrift>* entries) const;
+
+  /*
+   * Up to maxEntries of the entries matching the query, starting after the
+   * cursor, which is empty for the first page.  page->nextCursor is set if
+   * there are more.
+   *
+   * Throws FbossError if the MAC prefix or the cursor are malformed.
+   */
+  void getPage(
+      const L2TableQuery& query,
+      const std::string& cursor,
+      size_t maxEntries,
+      L2TablePage* page) const;
+
+ private:
+  // Forbidden copy constructor and assignment operator
+  L2TableMirror(L2TableMirror const &) = delete;
+  L2TableMirror& operator=(L2TableMirror const &) = delete;
+
+  using Key = std::pair<VlanID, folly::MacAddress>;
+  struct Tables {
+    // The port of each entry
+    std::map<Key, int32_t> entries;
+    std::map<int32_t, std::set<Key>> byPort;
+    std::set<std::pair<folly::MacAddress, VlanID>> byMac;
+  };
+
+  static void removeEntry(Tables& tables, const Key& key, int32_t port);
+  static void removeFromPort(Tables& tables, const Key& key, int32_t port);
+  static L2EntryThrift makeEntry(const Key& key, int32_t port);
+
+  folly::Synchronized<Tables> tables_;
+};
+
+}} // facebook::fboss
@@ -24,22 +24,22 @@ using std::string;
 
 LacpController::LacpController(
     PortID portID,
-    folly::EventBase* evb,
+    LacpTimer* timer,
     LacpServicerIf* servicer)
     : portID_(portID),
-      tx_(*this, evb, servicer),
-      rx_(*this, evb),
-      periodicTx_(*this, evb),
-      mux_(*this, evb, servicer),
+      tx_(*this, timer, servicer),
+      rx_(*this, timer),
+      periodicTx_(*this, timer),
+      mux_(*this, timer, servicer),
       selector_(*this),
-      evb_(evb),
+      evb_(timer->getEventBase()),
       servicer_(servicer) {
   actorState_ &= ~LacpState::AGGREGATABLE;
 }
 
 LacpController::LacpController(
     PortID portID,
-    folly::EventBase* evb,
+    LacpTimer* timer,
     uint16_t portPriority,
     cfg::LacpPortRate rate,
     cfg::LacpPortActivity activity,
@@ -52,12 +52,12 @@ LacpController::LacpController(
       portID_(portID),
       portPriority_(portPriority),
       systemPriority_(systemPriority),
-      tx_(*this, evb, servicer),
-      rx_(*this, evb),
-      periodicTx_(*this, evb),
-      mux_(*this, evb, servicer),
+      tx_(*this, timer, servicer),
+      rx_(*this, timer),
+      periodicTx_(*this, timer),
+      mux_(*this, timer, servicer),
       selector_(*this, minLinkCount),
-      evb_(evb),
+      evb_(timer->getEventBase()),
       servicer_(servicer) {
   std::memcpy(systemID_.begin(), systemID.bytes(), systemID_.size());
 
@@ -150,7 +150,11 @@ ParticipantInfo LacpController::partnerInfo() const {
 }
 
 void LacpController::ntt() {
-  tx_.ntt(LACPDU(actorInfo(), partnerInfo()));
+  tx_.ntt();
+}
+
+void LacpController::periodicNtt(std::chrono::steady_clock::time_point due) {
+  tx_.periodicNtt(due);
 }
 
 PortID LacpController::portID() const {
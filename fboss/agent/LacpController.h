@@ -13,10 +13,13 @@
 #include <folly/io/Cursor.h>
 
 #include "fboss/agent/LacpMachines.h"
+#include "fboss/agent/LacpTimer.h"
 #include "fboss/agent/LacpTypes.h"
 #include "fboss/agent/LinkAggregationManager.h"
 #include "fboss/agent/types.h"
 
+#include <chrono>
+
 namespace folly {
 class EventBase;
 }
@@ -31,11 +34,11 @@ class LacpController : public std::enable_shared_from_this<LacpController> {
  public:
   LacpController(
       PortID portID,
-      folly::EventBase* evb,
+      LacpTimer* timer,
       LacpServicerIf* servicer);
   LacpController(
       PortID portID,
-      folly::EventBase* evb,
+      LacpTimer* timer,
       uint16_t portPriority,
       cfg::LacpPortRate rate,
       cfg::LacpPortActivity activity,
@@ -50,7 +53,8 @@ class LacpController : public std::enable_shared_from_this<LacpController> {
   void startMachines();
   void stopMachines();
 
-  // All of machines.cpp should execute in the context of the EventBase *evb()
+  // All of machines.cpp should execute in the context of the EventBase *evb(),
+  // which is that of the LacpTimer the machines are scheduled on
   folly::EventBase* evb() const;
 
   // Invoked from LinkAggregationManager
@@ -70,6 +74,7 @@ class LacpController : public std::enable_shared_from_this<LacpController> {
   void setActorState(LacpState state);
 
   void ntt();
+  void periodicNtt(std::chrono::steady_clock::time_point due);
   void selected();
   void selected(folly::Range<std::vector<PortID>::const_iterator> ports);
 
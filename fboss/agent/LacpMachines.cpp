@@ -141,10 +141,8 @@ std::ostream& operator<<(std::ostream& out, MuxMachine::MuxState s) {
 const std::chrono::seconds ReceiveMachine::FAST_EPOCH_DURATION(3);
 const std::chrono::seconds ReceiveMachine::SLOW_EPOCH_DURATION(90);
 
-ReceiveMachine::ReceiveMachine(
-    LacpController& controller,
-    folly::EventBase* evb)
-    : folly::AsyncTimeout(evb), controller_(controller) {}
+ReceiveMachine::ReceiveMachine(LacpController& controller, LacpTimer* timer)
+    : controller_(controller), timer_(timer) {}
 
 ReceiveMachine::~ReceiveMachine() {}
 
@@ -315,7 +313,7 @@ void ReceiveMachine::recordPDU(LACPDU& lacpdu) {
 }
 
 void ReceiveMachine::startNextEpoch(std::chrono::seconds duration) {
-  scheduleTimeout(duration);
+  timer_->scheduleTimeout(this, duration);
 }
 
 void ReceiveMachine::endThisEpoch() {
@@ -323,6 +321,7 @@ void ReceiveMachine::endThisEpoch() {
 }
 
 void ReceiveMachine::timeoutExpired() noexcept {
+  timer_->expiring();
   try {
     switch (state_) {
       case ReceiveState::CURRENT:
@@ -368,8 +367,8 @@ const std::chrono::seconds PeriodicTransmissionMachine::LONG_PERIOD(30);
 
 PeriodicTransmissionMachine::PeriodicTransmissionMachine(
     LacpController& controller,
-    folly::EventBase* evb)
-    : folly::AsyncTimeout(evb), controller_(controller) {}
+    LacpTimer* timer)
+    : controller_(controller), timer_(timer) {}
 
 PeriodicTransmissionMachine::~PeriodicTransmissionMachine() {}
 
@@ -401,12 +400,14 @@ void PeriodicTransmissionMachine::beginNextPeriod() {
     case PeriodicState::SLOW:
       XLOG(DBG4) << "PeriodicTransmissionMachine[" << controller_.portID()
                  << "]: scheduling timeout for long period";
-      scheduleTimeout(LONG_PERIOD);
+      due_ = std::chrono::steady_clock::now() + LONG_PERIOD;
+      timer_->scheduleTimeout(this, LONG_PERIOD);
       break;
     case PeriodicState::FAST:
       XLOG(DBG4) << "PeriodicTransmissionMachine[" << controller_.portID()
                  << "]: scheduling timeout for short period";
-      scheduleTimeout(SHORT_PERIOD);
+      due_ = std::chrono::steady_clock::now() + SHORT_PERIOD;
+      timer_->scheduleTimeout(this, SHORT_PERIOD);
       break;
     case PeriodicState::NONE:
       XLOG(DBG4) << "PeriodicTransmissionMachine[" << controller_.portID()
@@ -419,13 +420,14 @@ void PeriodicTransmissionMachine::beginNextPeriod() {
 }
 
 void PeriodicTransmissionMachine::timeoutExpired() noexcept {
+  timer_->expiring();
   try {
     XLOG(DBG4) << "PeriodicTransmissionMachine[" << controller_.portID()
                << "]: end of period";
 
     state_ = PeriodicState::TX;
 
-    controller_.ntt();
+    controller_.periodicNtt(due_);
 
     state_ = determineTransmissionRate();
 
@@ -458,21 +460,31 @@ const int TransmitMachine::MAX_TRANSMISSIONS_IN_SHORT_PERIOD = 3;
 
 TransmitMachine::TransmitMachine(
     LacpController& controller,
-    folly::EventBase* evb,
+    LacpTimer* timer,
     LacpServicerIf* servicer)
-    : folly::AsyncTimeout(evb), controller_(controller), servicer_(servicer) {}
+    : controller_(controller), timer_(timer), servicer_(servicer) {}
 
-TransmitMachine::~TransmitMachine() {}
+TransmitMachine::~TransmitMachine() {
+  if (ntt_) {
+    timer_->cancelTransmit(this);
+  }
+}
 
 void TransmitMachine::start() {
-  scheduleTimeout(TransmitMachine::TX_REPLENISH_RATE);
+  timer_->scheduleTimeout(this, TransmitMachine::TX_REPLENISH_RATE);
 }
 
 void TransmitMachine::stop() {
   cancelTimeout();
+  if (ntt_) {
+    timer_->cancelTransmit(this);
+    ntt_ = false;
+    periodicDue_ = folly::none;
+  }
 }
 
 void TransmitMachine::timeoutExpired() noexcept {
+  timer_->expiring();
   replenishTranmissionsLeft();
 }
 
@@ -480,12 +492,35 @@ void TransmitMachine::replenishTranmissionsLeft() noexcept {
   transmissionsLeft_ = std::min(
       transmissionsLeft_ + 1,
       TransmitMachine::MAX_TRANSMISSIONS_IN_SHORT_PERIOD);
-  scheduleTimeout(TransmitMachine::TX_REPLENISH_RATE);
+  timer_->scheduleTimeout(this, TransmitMachine::TX_REPLENISH_RATE);
+}
+
+void TransmitMachine::ntt() {
+  CHECK(controller_.evb()->inRunningEventBaseThread());
+
+  if (ntt_) {
+    XLOG(DBG4) << "TransmitMachine[" << controller_.portID() << "]: "
+               << "ntt already pending";
+    return;
+  }
+  ntt_ = true;
+  timer_->transmitSoon(this);
+}
+
+void TransmitMachine::periodicNtt(std::chrono::steady_clock::time_point due) {
+  if (!periodicDue_ || due < *periodicDue_) {
+    periodicDue_ = due;
+  }
+  ntt();
 }
 
-void TransmitMachine::ntt(LACPDU lacpdu) {
+void TransmitMachine::transmit() {
   CHECK(controller_.evb()->inRunningEventBaseThread());
 
+  ntt_ = false;
+  auto periodicDue = periodicDue_;
+  periodicDue_ = folly::none;
+
   if (transmissionsLeft_ == 0) {
     // TODO(samank): figure out stale ntt details
     XLOG(DBG4) << "TransmitMachine[" << controller_.portID() << "]: "
@@ -493,6 +528,9 @@ void TransmitMachine::ntt(LACPDU lacpdu) {
     return;
   }
 
+  // The LACPDU carries the state the machines were left in by everything
+  // that asked for it
+  LACPDU lacpdu(controller_.actorInfo(), controller_.partnerInfo());
   auto outPort = controller_.portID();
   if (!servicer_->transmit(lacpdu, outPort)) {
     return;
@@ -503,14 +541,19 @@ void TransmitMachine::ntt(LACPDU lacpdu) {
 
   --transmissionsLeft_;
   XLOG(DBG4) << transmissionsLeft_ << " transmissions left";
+
+  if (periodicDue) {
+    timer_->periodicTransmitted(
+        std::chrono::steady_clock::now() - *periodicDue);
+  }
 }
 
 const std::chrono::seconds MuxMachine::AGGREGATE_WAIT_DURATION(2);
 MuxMachine::MuxMachine(
     LacpController& controller,
-    folly::EventBase* evb,
+    LacpTimer* timer,
     LacpServicerIf* servicer)
-    : AsyncTimeout(evb), controller_(controller), servicer_(servicer) {}
+    : controller_(controller), timer_(timer), servicer_(servicer) {}
 
 MuxMachine::~MuxMachine() {}
 
@@ -623,7 +666,9 @@ void MuxMachine::notMatched() {
 
 void MuxMachine::start() {}
 
-void MuxMachine::stop() {}
+void MuxMachine::stop() {
+  cancelTimeout();
+}
 
 void MuxMachine::enableCollectingDistributing() const {
   auto portID = controller_.portID();
@@ -675,11 +720,12 @@ void MuxMachine::waiting(bool shouldScheduleTimeout) {
   updateState(MuxState::WAITING);
 
   if (shouldScheduleTimeout) {
-    scheduleTimeout(AGGREGATE_WAIT_DURATION);
+    timer_->scheduleTimeout(this, AGGREGATE_WAIT_DURATION);
   }
 }
 
 void MuxMachine::timeoutExpired() noexcept {
+  timer_->expiring();
   try {
     attached();
     if (matched_) {
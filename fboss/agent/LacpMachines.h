@@ -9,15 +9,16 @@
  */
 #pragma once
 
-#include <folly/io/async/AsyncTimeout.h>
 #include <folly/Optional.h>
 
 #include <boost/container/flat_map.hpp>
 
+#include "fboss/agent/LacpTimer.h"
 #include "fboss/agent/LacpTypes.h"
 #include "fboss/agent/state/AggregatePort.h"
 #include "fboss/agent/types.h"
 
+#include <chrono>
 #include <iosfwd>
 
 namespace facebook {
@@ -29,11 +30,14 @@ class LacpServicerIf;
 
 /*
  * See IEEE 802.3AD-2000 43.4.3 for an overview of each state machine
+ *
+ * The timeouts of the machines are all scheduled on the LacpTimer shared by
+ * every LacpController.
  */
 
-class ReceiveMachine : private folly::AsyncTimeout {
+class ReceiveMachine : private LacpTimer::Callback {
  public:
-  explicit ReceiveMachine(LacpController& controller, folly::EventBase* evb);
+  ReceiveMachine(LacpController& controller, LacpTimer* timer);
   ~ReceiveMachine() override;
 
   // thread-safe
@@ -70,6 +74,7 @@ class ReceiveMachine : private folly::AsyncTimeout {
 
   // Timer-related
   void timeoutExpired() noexcept override;
+  void callbackCanceled() noexcept override {}
   void startNextEpoch(std::chrono::seconds duration);
   void endThisEpoch();
 
@@ -90,15 +95,14 @@ class ReceiveMachine : private folly::AsyncTimeout {
   ParticipantInfo partnerInfo_; // operational
 
   LacpController& controller_;
+  LacpTimer* timer_{nullptr};
 };
 void toAppend(ReceiveMachine::ReceiveState state, std::string* result);
 std::ostream& operator<<(std::ostream& out, ReceiveMachine::ReceiveState s);
 
-class PeriodicTransmissionMachine : private folly::AsyncTimeout {
+class PeriodicTransmissionMachine : private LacpTimer::Callback {
  public:
-  explicit PeriodicTransmissionMachine(
-      LacpController& controller,
-      folly::EventBase* evb);
+  PeriodicTransmissionMachine(LacpController& controller, LacpTimer* timer);
   ~PeriodicTransmissionMachine() override;
 
   void portUp();
@@ -118,25 +122,36 @@ class PeriodicTransmissionMachine : private folly::AsyncTimeout {
       std::string* result);
 
   void timeoutExpired() noexcept override;
+  void callbackCanceled() noexcept override {}
   void beginNextPeriod();
   PeriodicState determineTransmissionRate();
 
   PeriodicState state_{PeriodicState::NONE};
+  // When the transmission ending the current period is due
+  std::chrono::steady_clock::time_point due_;
   LacpController& controller_;
+  LacpTimer* timer_{nullptr};
 };
 void toAppend(
     PeriodicTransmissionMachine::PeriodicState state,
     std::string* result);
 
-class TransmitMachine : private folly::AsyncTimeout {
+class TransmitMachine : private LacpTimer::Callback {
  public:
   TransmitMachine(
       LacpController& controller,
-      folly::EventBase* evb,
+      LacpTimer* timer,
       LacpServicerIf* servicer);
   ~TransmitMachine() override;
 
-  void ntt(LACPDU lacpdu);
+  // Need To Transmit: the LACPDU goes out at the end of the loop iteration,
+  // once, however many times this is called before then.  A periodic
+  // transmission also says when it was due, to record how late it went out.
+  void ntt();
+  void periodicNtt(std::chrono::steady_clock::time_point due);
+
+  // Invoked by the LacpTimer at the end of the loop iteration
+  void transmit();
 
   void start();
   void stop();
@@ -145,21 +160,25 @@ class TransmitMachine : private folly::AsyncTimeout {
   enum class PeriodicState { NONE, SLOW, FAST, TX };
 
   void timeoutExpired() noexcept override;
+  void callbackCanceled() noexcept override {}
   void replenishTranmissionsLeft() noexcept;
 
   static const int MAX_TRANSMISSIONS_IN_SHORT_PERIOD;
   static const std::chrono::seconds TX_REPLENISH_RATE;
 
   int transmissionsLeft_{MAX_TRANSMISSIONS_IN_SHORT_PERIOD};
+  bool ntt_{false};
+  folly::Optional<std::chrono::steady_clock::time_point> periodicDue_;
   LacpController& controller_;
+  LacpTimer* timer_{nullptr};
   LacpServicerIf* servicer_{nullptr};
 };
 
-class MuxMachine : private folly::AsyncTimeout {
+class MuxMachine : private LacpTimer::Callback {
  public:
   MuxMachine(
       LacpController& controller,
-      folly::EventBase* evb,
+      LacpTimer* timer,
       LacpServicerIf* servicer);
   ~MuxMachine() override;
 
@@ -192,6 +211,7 @@ class MuxMachine : private folly::AsyncTimeout {
   void disableCollectingDistributing() const;
 
   void timeoutExpired() noexcept override;
+  void callbackCanceled() noexcept override {}
 
   void updateState(MuxState nextState);
 
@@ -200,6 +220,7 @@ class MuxMachine : private folly::AsyncTimeout {
   bool matched_{false};
   AggregatePortID selection_;
   LacpController& controller_;
+  LacpTimer* timer_{nullptr};
   LacpServicerIf* servicer_{nullptr};
 
   static const std::chrono::seconds AGGREGATE_WAIT_DURATION;
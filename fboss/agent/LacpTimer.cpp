@@ -0,0 +1,101 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "fboss/agent/LacpTimer.h"
+
+#include "fboss/agent/LacpMachines.h"
+#include "fboss/agent/SwSwitch.h"
+#include "fboss/agent/SwitchStats.h"
+
+#include <algorithm>
+
+using std::chrono::duration_cast;
+using std::chrono::microseconds;
+using std::chrono::milliseconds;
+using std::chrono::steady_clock;
+
+namespace facebook {
+namespace fboss {
+
+constexpr milliseconds LacpTimer::kTickInterval;
+
+LacpTimer::LacpTimer(folly::EventBase* evb, SwSwitch* sw)
+    : evb_(evb),
+      sw_(sw),
+      timer_(folly::HHWheelTimer::newTimer(evb_, kTickInterval)) {}
+
+LacpTimer::~LacpTimer() {
+  // The machines have all been stopped by now, but the wheel and the loop
+  // callback still belong to the LACP thread.
+  evb_->runImmediatelyOrRunInEventBaseThreadAndWait([this]() {
+    cancelLoopCallback();
+    pendingTx_.clear();
+    timer_.reset();
+  });
+}
+
+void LacpTimer::scheduleTimeout(Callback* cb, milliseconds timeout) {
+  DCHECK(evb_->isInEventBaseThread());
+  timer_->scheduleTimeout(cb, timeout);
+}
+
+void LacpTimer::expiring() {
+  DCHECK(evb_->isInEventBaseThread());
+  if (inTick_) {
+    return;
+  }
+  inTick_ = true;
+  tickStart_ = steady_clock::now();
+  scheduleLoopCallback();
+}
+
+void LacpTimer::transmitSoon(TransmitMachine* tx) {
+  DCHECK(evb_->isInEventBaseThread());
+  pendingTx_.push_back(tx);
+  scheduleLoopCallback();
+}
+
+void LacpTimer::cancelTransmit(TransmitMachine* tx) {
+  pendingTx_.erase(
+      std::remove(pendingTx_.begin(), pendingTx_.end(), tx),
+      pendingTx_.end());
+}
+
+void LacpTimer::periodicTransmitted(steady_clock::duration late) {
+  if (sw_) {
+    sw_->stats()->lacpTxJitter(duration_cast<milliseconds>(late));
+  }
+}
+
+void LacpTimer::scheduleLoopCallback() {
+  if (!isLoopCallbackScheduled()) {
+    evb_->runInLoop(this);
+  }
+}
+
+void LacpTimer::runLoopCallback() noexcept {
+  // Transmitting doesn't lead to more transmissions, but anything that asks
+  // for one from here on gets the next loop iteration.
+  std::vector<TransmitMachine*> pendingTx;
+  pendingTx.swap(pendingTx_);
+  for (auto tx : pendingTx) {
+    tx->transmit();
+  }
+
+  if (inTick_) {
+    inTick_ = false;
+    if (sw_) {
+      sw_->stats()->lacpTimerTick(
+          duration_cast<microseconds>(steady_clock::now() - tickStart_));
+    }
+  }
+}
+
+} // namespace fboss
+} // namespace facebook
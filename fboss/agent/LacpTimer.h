@@ -0,0 +1,99 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#pragma once
+
+#include <folly/io/async/EventBase.h>
+#include <folly/io/async/HHWheelTimer.h>
+
+#include <chrono>
+#include <vector>
+
+namespace facebook {
+namespace fboss {
+
+class SwSwitch;
+class TransmitMachine;
+
+/*
+ * LacpTimer is the timer wheel the timeouts of the state machines of every
+ * LacpController are scheduled on, on the LACP thread.
+ *
+ * With fast rate LACP each member port has a handful of timeouts going every
+ * second.  On the wheel they are a single timeout on the EventBase, and those
+ * that expire in the same tick are processed together.  The LACP timeouts are
+ * all whole seconds, so rounding them up to kTickInterval costs nothing.
+ *
+ * The LACPDUs the machines need to transmit are batched too: a TransmitMachine
+ * asked to transmit any number of times in one loop iteration transmits once,
+ * at the end of it, with the state the machines are left in.
+ *
+ * Each tick, the time spent processing the timeouts that expired and the
+ * transmissions they led to is added to the SwitchStats, as is how late each
+ * periodic transmission was sent.
+ */
+class LacpTimer : private folly::EventBase::LoopCallback {
+ public:
+  using Callback = folly::HHWheelTimer::Callback;
+
+  static constexpr std::chrono::milliseconds kTickInterval{50};
+
+  /*
+   * sw is only used for the stats, and may be null.
+   */
+  LacpTimer(folly::EventBase* evb, SwSwitch* sw);
+  ~LacpTimer() override;
+
+  folly::EventBase* getEventBase() const {
+    return evb_;
+  }
+
+  /*
+   * Schedule cb to expire after timeout.  Must be called on the LACP thread.
+   */
+  void scheduleTimeout(Callback* cb, std::chrono::milliseconds timeout);
+
+  /*
+   * Called by each callback as it expires, to time the tick it expires in.
+   */
+  void expiring();
+
+  /*
+   * Transmit the LACPDU of tx at the end of this loop iteration.  tx keeps
+   * track of whether it already will be.  Must be called on the LACP thread.
+   */
+  void transmitSoon(TransmitMachine* tx);
+  void cancelTransmit(TransmitMachine* tx);
+
+  /*
+   * Called by a TransmitMachine as it sends a periodic transmission.
+   */
+  void periodicTransmitted(std::chrono::steady_clock::duration late);
+
+ private:
+  // Runs at the end of the event loop iteration that ran a tick or asked for
+  // a transmission
+  void runLoopCallback() noexcept override;
+  void scheduleLoopCallback();
+
+  // Forbidden copy constructor and assignment operator
+  LacpTimer(LacpTimer const&) = delete;
+  LacpTimer& operator=(LacpTimer const&) = delete;
+
+  folly::EventBase* evb_{nullptr};
+  SwSwitch* sw_{nullptr};
+  folly::HHWheelTimer::UniquePtr timer_;
+  std::vector<TransmitMachine*> pendingTx_;
+  // When the callbacks of the current tick started expiring, if they have
+  bool inTick_{false};
+  std::chrono::steady_clock::time_point tickStart_;
+};
+
+} // namespace fboss
+} // namespace facebook
@@ -9,25 +9,31 @@
  */
 #include "fboss/agent/LinkAggregationManager.h"
 
+#include "fboss/agent/HwSwitch.h"
 #include "fboss/agent/Platform.h"
 #include "fboss/agent/state/AggregatePortMap.h"
 #include "fboss/agent/LacpController.h"
+#include "fboss/agent/LacpTimer.h"
 #include "fboss/agent/LacpTypes.h"
 #include "fboss/agent/LacpTypes-defs.h"
+#include "fboss/agent/RxPacket.h"
 #include "fboss/agent/state/Port.h"
 #include "fboss/agent/state/PortMap.h"
 #include "fboss/agent/TxPacket.h"
 #include "fboss/agent/state/SwitchState.h"
 #include "fboss/agent/SwSwitch.h"
+#include "fboss/agent/SwitchStats.h"
 #include "fboss/agent/state/AggregatePort.h"
 #include "fboss/agent/state/DeltaFunctions.h"
 #include "fboss/agent/state/Port.h"
 #include "fboss/agent/state/SwitchState.h"
 
+#include <folly/ExceptionString.h>
 #include <folly/io/async/EventBase.h>
 #include <folly/logging/xlog.h>
 
 #include <algorithm>
+#include <chrono>
 #include <iterator>
 #include <tuple>
 #include <utility>
@@ -35,6 +41,8 @@
 namespace facebook {
 namespace fboss {
 
+constexpr size_t LinkAggregationManager::kMaxPendingLacpdus;
+
 namespace {
 class ProgramForwardingState {
  public:
@@ -88,29 +96,103 @@ std::ostream& operator<<(
 
 LinkAggregationManager::LinkAggregationManager(SwSwitch* sw)
     : AutoRegisterStateObserver(sw, "LinkAggregationManager"),
+      timer_(std::make_unique<LacpTimer>(sw->getLacpEvb(), sw)),
       portToController_(),
+      controllerTable_(std::make_shared<const ControllerTable>()),
+      pendingLacpdus_(kMaxPendingLacpdus),
       sw_(sw) {}
 
 void LinkAggregationManager::handlePacket(
     std::unique_ptr<RxPacket> pkt,
     folly::io::Cursor c) {
-  // TODO(samank): check this is running in RX thread?
-  folly::SharedMutexWritePriority::ReadHolder g(&controllersLock_);
   auto ingressPort = pkt->getSrcPort();
 
-  auto it = portToController_.find(ingressPort);
-  if (it == portToController_.end()) {
+  if (!getController(ingressPort)) {
     XLOG(ERR) << "No LACP controller found for port " << ingressPort;
     return;
   }
 
-  auto lacpdu = LACPDU::from(&c);
-  if (!lacpdu.isValid()) {
-    XLOG(ERR) << "Invalid LACP data unit";
+  if (!pendingLacpdus_.write(
+          PendingLacpdu{std::move(pkt), c.getCurrentPosition()})) {
+    XLOG(DBG2) << "Dropping LACPDU from port " << ingressPort
+               << ": too many LACPDUs waiting for the LACP thread";
+    sw_->stats()->port(ingressPort)->pktDropped();
     return;
   }
 
-  it->second->received(lacpdu);
+  // One pass over the queue picks up all of the LACPDUs queued until it
+  // starts
+  if (!receiveScheduled_.exchange(true)) {
+    sw_->getLacpEvb()->runInEventBaseThread([this]() { receivePending(); });
+  }
+}
+
+void LinkAggregationManager::receivePending() {
+  CHECK(sw_->getLacpEvb()->inRunningEventBaseThread());
+
+  receiveScheduled_.store(false);
+
+  PendingLacpdu pending;
+  while (pendingLacpdus_.read(pending)) {
+    auto ingressPort = pending.pkt->getSrcPort();
+    // The controller may have been replaced since the LACPDU was queued
+    auto controller = getController(ingressPort);
+    if (!controller) {
+      continue;
+    }
+
+    folly::io::Cursor c(pending.pkt->buf());
+    c += pending.offset;
+    LACPDU lacpdu;
+    try {
+      lacpdu = LACPDU::from(&c);
+    } catch (const std::exception& ex) {
+      XLOG(ERR) << "Truncated LACP data unit from port " << ingressPort
+                << ": " << folly::exceptionStr(ex);
+      sw_->stats()->port(ingressPort)->pktError();
+      continue;
+    }
+    if (!lacpdu.isValid()) {
+      XLOG(ERR) << "Invalid LACP data unit";
+      continue;
+    }
+
+    controller->received(lacpdu);
+  }
+}
+
+std::shared_ptr<LacpController> LinkAggregationManager::getController(
+    PortID portID) const {
+  auto& snapshot = *controllerTableSnapshots_;
+  if (snapshot.version !=
+      controllerTableVersion_.load(std::memory_order_acquire)) {
+    folly::SpinLockGuard guard(controllerTableLock_);
+    snapshot.table = controllerTable_;
+    snapshot.version = controllerTableVersion_.load(std::memory_order_relaxed);
+  }
+
+  auto index = static_cast<size_t>(portID);
+  if (!snapshot.table || index >= snapshot.table->size()) {
+    return nullptr;
+  }
+  return (*snapshot.table)[index];
+}
+
+void LinkAggregationManager::publishControllers() {
+  auto table = std::make_shared<ControllerTable>();
+  if (!portToController_.empty()) {
+    // Sorted by PortID, so the last one is the largest
+    auto maxPort = static_cast<size_t>(portToController_.rbegin()->first);
+    table->resize(maxPort + 1);
+  }
+  for (const auto& portAndController : portToController_) {
+    (*table)[static_cast<size_t>(portAndController.first)] =
+        portAndController.second;
+  }
+
+  folly::SpinLockGuard guard(controllerTableLock_);
+  controllerTable_ = std::move(table);
+  controllerTableVersion_.fetch_add(1, std::memory_order_release);
 }
 
 void LinkAggregationManager::stateUpdated(const StateDelta& delta) {
@@ -118,6 +200,10 @@ void LinkAggregationManager::stateUpdated(const StateDelta& delta) {
 
   folly::SharedMutexWritePriority::WriteHolder writeGuard(&controllersLock_);
 
+  bool controllersChanged = !initialized_ ||
+      delta.oldState()->getAggregatePorts() !=
+          delta.newState()->getAggregatePorts();
+
   if (!initialized_) {
     bool inserted;
     for (const auto& port : *(delta.newState()->getPorts())) {
@@ -125,7 +211,7 @@ void LinkAggregationManager::stateUpdated(const StateDelta& delta) {
       std::tie(std::ignore, inserted) = portToController_.insert(std::make_pair(
           port->getID(),
           std::make_shared<LacpController>(
-              port->getID(), sw_->getLacpEvb(), this)));
+              port->getID(), timer_.get(), this)));
       CHECK(inserted);
     }
 
@@ -142,6 +228,10 @@ void LinkAggregationManager::stateUpdated(const StateDelta& delta) {
       &LinkAggregationManager::aggregatePortRemoved,
       this);
 
+  if (controllersChanged) {
+    publishControllers();
+  }
+
   // Downgrade to a reader lock
   folly::SharedMutexWritePriority::ReadHolder readGuard(std::move(writeGuard));
 
@@ -159,7 +249,7 @@ void LinkAggregationManager::aggregatePortAdded(
     it->second->stopMachines();
     it->second.reset(new LacpController(
         subport.portID,
-        sw_->getLacpEvb(),
+        timer_.get(),
         subport.priority,
         subport.rate,
         subport.activity,
@@ -180,7 +270,7 @@ void LinkAggregationManager::aggregatePortRemoved(
     CHECK_NE(it, portToController_.end());
     it->second->stopMachines();
     it->second.reset(
-        new LacpController(subport.portID, sw_->getLacpEvb(), this));
+        new LacpController(subport.portID, timer_.get(), this));
     it->second->startMachines();
   }
 }
@@ -309,11 +399,17 @@ void LinkAggregationManager::enableForwarding(
     AggregatePortID aggPortID) {
   CHECK(sw_->getLacpEvb()->inRunningEventBaseThread());
 
-  auto enableFwdStateFn = ProgramForwardingState(
-      portID, aggPortID, AggregatePort::Forwarding::ENABLED);
+  auto members = memberForwarding_.wlock();
+  auto& member = (*members)[portID];
+  member.aggPortID = aggPortID;
+  member.enabled = true;
+  if (!member.alive) {
+    XLOG(DBG2) << "Not enabling member " << portID << " of " << aggPortID
+               << " until its micro-BFD session is up";
+    return;
+  }
 
-  sw_->updateStateNoCoalescing(
-      "AggregatePort ForwardingState", std::move(enableFwdStateFn));
+  setForwarding(portID, aggPortID, true);
 }
 
 void LinkAggregationManager::disableForwarding(
@@ -321,11 +417,63 @@ void LinkAggregationManager::disableForwarding(
     AggregatePortID aggPortID) {
   CHECK(sw_->getLacpEvb()->inRunningEventBaseThread());
 
-  auto disableFwdStateFn = ProgramForwardingState(
-      portID, aggPortID, AggregatePort::Forwarding::DISABLED);
+  auto members = memberForwarding_.wlock();
+  auto& member = (*members)[portID];
+  member.aggPortID = aggPortID;
+  member.enabled = false;
+
+  setForwarding(portID, aggPortID, false);
+}
+
+void LinkAggregationManager::memberLivenessChanged(PortID portID, bool alive) {
+  auto members = memberForwarding_.wlock();
+  auto& member = (*members)[portID];
+  if (member.alive == alive) {
+    return;
+  }
+  member.alive = alive;
+
+  XLOG(INFO) << "Member " << portID << " is " << (alive ? "alive" : "dead")
+             << " by micro-BFD";
+  if (member.enabled) {
+    setForwarding(portID, member.aggPortID, alive);
+  }
+}
+
+void LinkAggregationManager::setForwarding(
+    PortID portID,
+    AggregatePortID aggPortID,
+    bool enable) {
+  programForwardingInHw(portID, aggPortID, enable);
+
+  auto fwdStateFn = ProgramForwardingState(
+      portID,
+      aggPortID,
+      enable ? AggregatePort::Forwarding::ENABLED
+             : AggregatePort::Forwarding::DISABLED);
 
   sw_->updateStateNoCoalescing(
-      "AggregatePort ForwardingState", std::move(disableFwdStateFn));
+      "AggregatePort ForwardingState",
+      std::move(fwdStateFn),
+      StateUpdateClass::LINK);
+}
+
+void LinkAggregationManager::programForwardingInHw(
+    PortID portID,
+    AggregatePortID aggPortID,
+    bool enable) {
+  // Change the hardware straight away, rather than waiting for the state
+  // update behind whatever else is queued.  The state update still follows
+  // to record the change.
+  auto start = std::chrono::steady_clock::now();
+  if (!sw_->getHw()->setAggregatePortMemberForwarding(
+          aggPortID, portID, enable)) {
+    sw_->stats()->lagForwardingChangeDeferred();
+    return;
+  }
+  sw_->stats()->lagForwardingChanged(
+      std::chrono::duration_cast<std::chrono::microseconds>(
+          std::chrono::steady_clock::now() - start));
 }
 
 std::vector<std::shared_ptr<LacpController>>
@@ -352,6 +500,16 @@ LinkAggregationManager::getControllersFor(
   return controllers;
 }
 
-LinkAggregationManager::~LinkAggregationManager() {}
+LinkAggregationManager::~LinkAggregationManager() {
+  // Let a pass over the queued LACPDUs that is already scheduled run before
+  // the queue goes away
+  sw_->getLacpEvb()->runImmediatelyOrRunInEventBaseThreadAndWait([]() {});
+
+  // The machines are scheduled on timer_, so they have to be stopped before
+  // it goes away, even if something still holds on to their controllers.
+  for (const auto& portAndController : portToController_) {
+    portAndController.second->stopMachines();
+  }
+}
 } // namespace fboss
 } // namespace facebook
@@ -15,9 +15,14 @@
 
 #include <boost/container/flat_map.hpp>
 
+#include <folly/MPMCQueue.h>
 #include <folly/SharedMutex.h>
+#include <folly/SpinLock.h>
+#include <folly/Synchronized.h>
+#include <folly/ThreadLocal.h>
 #include <folly/io/Cursor.h>
 
+#include <atomic>
 #include <memory>
 #include <vector>
 
@@ -26,6 +31,7 @@ namespace fboss {
 
 class LacpController;
 class LacpPartnerPair;
+class LacpTimer;
 class RxPacket;
 class StateDelta;
 class SwSwitch;
@@ -46,10 +52,19 @@ struct LacpServicerIf {
 class LinkAggregationManager : public AutoRegisterStateObserver,
                                public LacpServicerIf {
  public:
+  // LACPDUs come at most once a second per port, short of a storm, so the
+  // queue only fills up when the LACP thread is stuck
+  static constexpr size_t kMaxPendingLacpdus = 1024;
+
   explicit LinkAggregationManager(SwSwitch* sw);
   ~LinkAggregationManager() override;
 
   void stateUpdated(const StateDelta& delta) override;
+  /*
+   * Queue a LACPDU for its controller, to be parsed and handled on the LACP
+   * thread.  LACPDUs for ports without a controller, or beyond what the
+   * queue holds, are dropped without taking any lock.
+   */
   void handlePacket(std::unique_ptr<RxPacket> pkt, folly::io::Cursor c);
 
   void populatePartnerPair(PortID portID, LacpPartnerPair& partnerPair);
@@ -61,7 +76,27 @@ class LinkAggregationManager : public AutoRegisterStateObserver,
   std::vector<std::shared_ptr<LacpController>> getControllersFor(
       folly::Range<std::vector<PortID>::const_iterator> ports) override;
 
+  /*
+   * The liveness of a member port, as detected by its micro-BFD session.  A
+   * member that isn't alive doesn't forward, whatever LACP says, and it is
+   * taken out of its aggregate port straight from the calling thread.  It
+   * forwards again once it is alive, if LACP still enables it.
+   *
+   * Members are alive until told otherwise, so a member whose peer doesn't
+   * run micro-BFD is left to LACP alone.  Thread-safe.
+   */
+  void memberLivenessChanged(PortID portID, bool alive);
+
  private:
+  struct MemberForwarding {
+    AggregatePortID aggPortID{0};
+    // Whether LACP has enabled forwarding over the member
+    bool enabled{false};
+    bool alive{true};
+  };
+  using PortIDToMemberForwarding =
+      boost::container::flat_map<PortID, MemberForwarding>;
+
   void aggregatePortRemoved(const std::shared_ptr<AggregatePort>& aggPort);
   void aggregatePortAdded(const std::shared_ptr<AggregatePort>& aggPort);
   void aggregatePortChanged(
@@ -70,6 +105,18 @@ class LinkAggregationManager : public AutoRegisterStateObserver,
   void portChanged(
       const std::shared_ptr<Port>& oldPort,
       const std::shared_ptr<Port>& newPort);
+  void programForwardingInHw(
+      PortID portID,
+      AggregatePortID aggPortID,
+      bool enable);
+  void setForwarding(PortID portID, AggregatePortID aggPortID, bool enable);
+
+  // Handle the queued LACPDUs.  On the LACP thread.
+  void receivePending();
+  // The controller of a port in the latest table, or null
+  std::shared_ptr<LacpController> getController(PortID portID) const;
+  // Must be called with controllersLock_ held for writing
+  void publishControllers();
 
   // Forbidden copy constructor and assignment operator
   LinkAggregationManager(LinkAggregationManager const&) = delete;
@@ -81,8 +128,40 @@ class LinkAggregationManager : public AutoRegisterStateObserver,
       std::ostream& out,
       const PortIDToController::iterator& it);
 
+  // Declared ahead of the controllers, whose machines are scheduled on it
+  std::unique_ptr<LacpTimer> timer_;
   PortIDToController portToController_;
   mutable folly::SharedMutexWritePriority controllersLock_;
+
+  /*
+   * portToController_ indexed by PortID, published anew whenever a
+   * controller is replaced, so packets find their controller without taking
+   * controllersLock_.  As with the states of SwSwitch, each thread keeps its
+   * own copy of the table, and only takes controllerTableLock_ to refresh it
+   * once controllerTableVersion_ moved on.
+   */
+  using ControllerTable = std::vector<std::shared_ptr<LacpController>>;
+  struct ControllerTableSnapshot {
+    uint64_t version{0};
+    std::shared_ptr<const ControllerTable> table;
+  };
+  std::shared_ptr<const ControllerTable> controllerTable_;
+  mutable folly::SpinLock controllerTableLock_;
+  std::atomic<uint64_t> controllerTableVersion_{1};
+  mutable folly::ThreadLocal<ControllerTableSnapshot> controllerTableSnapshots_;
+
+  // LACPDUs received, waiting for the LACP thread
+  struct PendingLacpdu {
+    std::unique_ptr<RxPacket> pkt;
+    // Where the LACPDU starts in pkt
+    size_t offset{0};
+  };
+  folly::MPMCQueue<PendingLacpdu> pendingLacpdus_;
+  std::atomic<bool> receiveScheduled_{false};
+
+  // Held while forwarding is changed, so that LACP and micro-BFD change it in
+  // the order they decide to
+  folly::Synchronized<PortIDToMemberForwarding> memberForwarding_;
   bool initialized_{false};
   SwSwitch* sw_{nullptr};
 };
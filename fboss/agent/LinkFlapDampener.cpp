@@ -0,0 +1,127 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "fboss/agent/LinkFlapDampener.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace facebook { namespace fboss {
+
+using std::chrono::duration;
+using std::chrono::duration_cast;
+
+std::vector<PortID> LinkFlapDampener::setConfig(
+    const folly::Optional<cfg::LinkFlapDampening>& config) {
+  std::vector<PortID> released;
+  if (config == config_) {
+    return released;
+  }
+  for (const auto& entry : ports_) {
+    if (entry.second.suppressed && entry.second.up) {
+      released.push_back(entry.first);
+    }
+  }
+  ports_.clear();
+  config_ = config;
+  return released;
+}
+
+bool LinkFlapDampener::linkChanged(
+    PortID port, bool up, Clock::time_point now) {
+  if (!config_) {
+    return true;
+  }
+  if (up) {
+    auto it = ports_.find(port);
+    if (it == ports_.end()) {
+      return true;
+    }
+    it->second.up = true;
+    return !it->second.suppressed;
+  }
+
+  auto& state = ports_[port];
+  bool wasSuppressed = state.suppressed;
+  // The cap on the penalty, that decays to the reuse threshold over the max
+  // suppress time
+  double maxPenalty = config_->reuseThreshold *
+      std::exp2(static_cast<double>(config_->maxSuppressSeconds) /
+                config_->halfLifeSeconds);
+  state.penalty = std::min(
+      getDecayedPenalty(state, now) + config_->penaltyPerFlap, maxPenalty);
+  state.updated = now;
+  state.up = false;
+  if (state.penalty > config_->suppressThreshold) {
+    state.suppressed = true;
+  }
+  return !wasSuppressed;
+}
+
+std::vector<PortID> LinkFlapDampener::reuse(Clock::time_point now) {
+  std::vector<PortID> released;
+  for (auto& entry : ports_) {
+    auto& state = entry.second;
+    if (!state.suppressed || getReuseTime(state) > now) {
+      continue;
+    }
+    state.suppressed = false;
+    if (state.up) {
+      released.push_back(entry.first);
+    }
+  }
+  return released;
+}
+
+folly::Optional<LinkFlapDampener::Clock::time_point>
+LinkFlapDampener::getNextReuse() const {
+  folly::Optional<Clock::time_point> next;
+  for (const auto& entry : ports_) {
+    if (!entry.second.suppressed) {
+      continue;
+    }
+    auto reuseTime = getReuseTime(entry.second);
+    if (!next || reuseTime < *next) {
+      next = reuseTime;
+    }
+  }
+  return next;
+}
+
+double LinkFlapDampener::getPenalty(PortID port, Clock::time_point now) const {
+  auto it = ports_.find(port);
+  return it == ports_.end() ? 0 : getDecayedPenalty(it->second, now);
+}
+
+bool LinkFlapDampener::isSuppressed(PortID port) const {
+  auto it = ports_.find(port);
+  return it != ports_.end() && it->second.suppressed;
+}
+
+double LinkFlapDampener::getDecayedPenalty(
+    const PortState& port, Clock::time_point now) const {
+  if (port.penalty == 0 || now <= port.updated) {
+    return port.penalty;
+  }
+  auto elapsed = duration<double>(now - port.updated).count();
+  return port.penalty * std::exp2(-elapsed / config_->halfLifeSeconds);
+}
+
+LinkFlapDampener::Clock::time_point LinkFlapDampener::getReuseTime(
+    const PortState& port) const {
+  if (port.penalty <= config_->reuseThreshold) {
+    return port.updated;
+  }
+  duration<double> decay(
+      config_->halfLifeSeconds *
+      std::log2(port.penalty / config_->reuseThreshold));
+  return port.updated + duration_cast<Clock::duration>(decay);
+}
+
+}} // facebook::fboss
@@ -0,0 +1,94 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#pragma once
+
+#include "fboss/agent/gen-cpp2/switch_config_types.h"
+#include "fboss/agent/types.h"
+
+#include <folly/Optional.h>
+
+#include <chrono>
+#include <map>
+#include <vector>
+
+namespace facebook { namespace fboss {
+
+/*
+ * LinkFlapDampener decides which link state changes of flapping ports are
+ * passed on, as configured by cfg::LinkFlapDampening.
+ *
+ * Each link down adds to the port's penalty, which decays exponentially
+ * with the configured half life.  A port whose penalty goes over the
+ * suppress threshold is suppressed: its link coming back up isn't passed
+ * on until the penalty has decayed under the reuse threshold.  The penalty
+ * is capped so that a port is never suppressed for longer than the max
+ * suppress time after its last flap.
+ *
+ * It only does the bookkeeping: the caller passes on the changes, runs
+ * reuse() at getNextReuse(), and does the locking.
+ */
+class LinkFlapDampener {
+ public:
+  typedef std::chrono::steady_clock Clock;
+
+  LinkFlapDampener() {}
+
+  /*
+   * Start dampening as configured, or stop if the config isn't set.  Does
+   * nothing if the config is unchanged.  Otherwise every port starts over
+   * without a penalty, and the suppressed ports whose links are up are
+   * released and returned, for their link up to be passed on.
+   */
+  std::vector<PortID> setConfig(
+      const folly::Optional<cfg::LinkFlapDampening>& config);
+
+  /*
+   * Record a link state change, and return whether to pass it on.  Link
+   * downs are passed on unless the port is already suppressed, and so kept
+   * down, and link ups unless it is suppressed.
+   */
+  bool linkChanged(PortID port, bool up, Clock::time_point now);
+
+  /*
+   * Release the suppressed ports whose penalty has decayed under the reuse
+   * threshold by now, and return those whose links are up.
+   */
+  std::vector<PortID> reuse(Clock::time_point now);
+
+  /*
+   * When the next suppressed port is to be released, if any is suppressed.
+   */
+  folly::Optional<Clock::time_point> getNextReuse() const;
+
+  double getPenalty(PortID port, Clock::time_point now) const;
+  bool isSuppressed(PortID port) const;
+
+ private:
+  // Forbidden copy constructor and assignment operator
+  LinkFlapDampener(LinkFlapDampener const &) = delete;
+  LinkFlapDampener& operator=(LinkFlapDampener const &) = delete;
+
+  struct PortState {
+    // The penalty as of updated
+    double penalty{0};
+    Clock::time_point updated;
+    bool up{false};
+    bool suppressed{false};
+  };
+
+  double getDecayedPenalty(const PortState& port, Clock::time_point now) const;
+  Clock::time_point getReuseTime(const PortState& port) const;
+
+  folly::Optional<cfg::LinkFlapDampening> config_;
+  // Only the ports that have flapped since the config was set
+  std::map<PortID, PortState> ports_;
+};
+
+}} // facebook::fboss
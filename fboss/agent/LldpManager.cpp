@@ -16,9 +16,12 @@
 #include <folly/io/Cursor.h>
 #include <folly/logging/xlog.h>
 #include <unistd.h>
+#include <vector>
 #include "fboss/agent/RxPacket.h"
 #include "fboss/agent/SwSwitch.h"
 #include "fboss/agent/TxPacket.h"
+#include "fboss/agent/state/DeltaFunctions.h"
+#include "fboss/agent/state/StateDelta.h"
 
 using folly::MacAddress;
 using folly::io::RWPrivateCursor;
@@ -32,7 +35,8 @@ namespace facebook { namespace fboss {
 const MacAddress LldpManager::LLDP_DEST_MAC("01:80:c2:00:00:0e");
 
 LldpManager::LldpManager(SwSwitch* sw)
-  : folly::AsyncTimeout(sw->getBackgroundEvb()),
+  : AutoRegisterStateObserver(sw, "LldpManager"),
+    folly::AsyncTimeout(sw->getBackgroundEvb()),
     sw_(sw),
     interval_(LLDP_INTERVAL) {}
 
@@ -70,22 +74,83 @@ void LldpManager::handlePacket(
   db_.update(neighbor);
 }
 
+void LldpManager::stateUpdated(const StateDelta& delta) {
+  // Forget the frames of the ports they no longer match
+  std::vector<PortID> stale;
+  DeltaFunctions::forEachChanged(
+      delta.getPortsDelta(),
+      [&](const shared_ptr<Port>& oldPort, const shared_ptr<Port>& newPort) {
+        if (oldPort->getName() != newPort->getName() ||
+            oldPort->getIngressVlan() != newPort->getIngressVlan()) {
+          stale.push_back(newPort->getID());
+        }
+      },
+      [&](const shared_ptr<Port>& /*added*/) {},
+      [&](const shared_ptr<Port>& removed) {
+        stale.push_back(removed->getID());
+      });
+  if (stale.empty()) {
+    return;
+  }
+
+  auto cache = frameCache_.wlock();
+  for (auto portID : stale) {
+    cache->frames.erase(portID);
+  }
+}
+
 void LldpManager::timeoutExpired() noexcept {
+  // Neighbors that expired are noticed within a tick, and their removal
+  // goes out to the clients following the neighbor updates
+  db_.pruneExpiredNeighbors();
   try {
-    sendLldpOnAllPorts(true);
+    sendLldp(true, nextSlot_);
   } catch (const std::exception& ex) {
-    XLOG(ERR) << "Failed to send LLDP on all ports. Error:"
-              << folly::exceptionStr(ex);
+    XLOG(ERR) << "Failed to send LLDP on the ports of slot " << nextSlot_
+              << ". Error:" << folly::exceptionStr(ex);
   }
-  scheduleTimeout(interval_);
+  nextSlot_ = (nextSlot_ + 1) % TX_SLOTS;
+  // Every port is still sent to once an interval
+  scheduleTimeout(interval_ / TX_SLOTS);
 }
 
 void LldpManager::sendLldpOnAllPorts(bool checkPortStatusFlag) {
-  // send lldp frames through all the ports here.
+  sendLldp(checkPortStatusFlag, -1);
+}
+
+std::string localHostname() {
+  const size_t kMaxLen = 64;
+  char hostname[kMaxLen];
+
+  if (0 == gethostname(hostname, kMaxLen)) {
+    // make sure it is null terminated
+    hostname[kMaxLen - 1] = '\0';
+  } else {
+    hostname[0] = '\0';
+  }
+  return hostname;
+}
+
+void LldpManager::sendLldp(bool checkPortStatusFlag, int slot) {
   std::shared_ptr<SwitchState> state = sw_->getState();
+  auto hostname = localHostname();
+  MacAddress cpuMac = sw_->getPlatform()->getLocalMac();
+
+  // Ahead of the cache lock, so the packets go out once it is released
+  SwSwitch::TxPacketBatch batch(sw_);
+  auto cache = frameCache_.wlock();
+  if (cache->hostname != hostname || cache->cpuMac != cpuMac) {
+    cache->hostname = hostname;
+    cache->cpuMac = cpuMac;
+    cache->frames.clear();
+  }
+
   for (const auto& port : *state->getPorts()) {
+    if (slot >= 0 && static_cast<int>(port->getID()) % TX_SLOTS != slot) {
+      continue;
+    }
     if (checkPortStatusFlag == false || port->isPortUp()) {
-      sendLldpInfo(sw_, state, port);
+      sendLldpInfo(port, &*cache);
     } else {
       XLOG(DBG5) << "Skipping LLDP send as this port is disabled "
                  << port->getID();
@@ -130,28 +195,42 @@ void writeTlv(uint16_t type, const ByteRange& value,
 }
 
 void LldpManager::sendLldpInfo(
-    SwSwitch* sw,
-    const std::shared_ptr<SwitchState>& /*swState*/,
-    const std::shared_ptr<Port>& port) {
-  MacAddress cpuMac = sw->getPlatform()->getLocalMac();
-  const size_t kMaxLen = 64;
-  char hostname[kMaxLen];
-
-  if (0 == gethostname(hostname, kMaxLen)) {
-    // make sure it is null terminated
-    hostname[kMaxLen - 1] = '\0';
-  } else {
-    hostname[0] = '\0';
+    const std::shared_ptr<Port>& port,
+    FrameCache* cache) {
+  PortID thisPortID = port->getID();
+  auto& cached = cache->frames[thisPortID];
+  if (!cached.frame || cached.portName != port->getName() ||
+      cached.vlan != port->getIngressVlan()) {
+    cached.portName = port->getName();
+    cached.vlan = port->getIngressVlan();
+    cached.frame = buildLldpFrame(port, *cache);
   }
 
+  auto pkt = sw_->allocatePacket(cached.frame->length());
+  memcpy(
+      pkt->buf()->writableData(), cached.frame->data(),
+      cached.frame->length());
+  // this LLDP packet HAS to exit out of the port specified here.
+  sw_->sendPacketOutOfPort(std::move(pkt), thisPortID);
+  XLOG(DBG4) << "sent LLDP "
+             << " on port " << port->getID() << " with CPU MAC "
+             << cache->cpuMac.toString() << " port id " << port->getName()
+             << " and vlan " << port->getIngressVlan();
+}
+
+std::unique_ptr<folly::IOBuf> LldpManager::buildLldpFrame(
+    const std::shared_ptr<Port>& port,
+    const FrameCache& cache) const {
+  const MacAddress& cpuMac = cache.cpuMac;
+
   // The minimum packet length is 64.We use 68 on the assumption that
   // the packet will go out untagged, which will remove 4 bytes.
   uint32_t frameLen = 98;
-  auto pkt = sw->allocatePacket(frameLen);
-  PortID thisPortID = port->getID();
-  RWPrivateCursor cursor(pkt->buf());
-  pkt->writeEthHeader(&cursor, LLDP_DEST_MAC,
-                      cpuMac, port->getIngressVlan(), ETHERTYPE_LLDP);
+  auto frame = folly::IOBuf::create(frameLen);
+  frame->append(frameLen);
+  RWPrivateCursor cursor(frame.get());
+  TxPacket::writeEthHeader(&cursor, LLDP_DEST_MAC,
+                           cpuMac, port->getIngressVlan(), ETHERTYPE_LLDP);
   // now write chassis ID TLV
   writeTlv(CHASSIS_TLV_TYPE, CHASSIS_TLV_SUB_TYPE_MAC,
            ByteRange(cpuMac.bytes(), 6), &cursor);
@@ -168,9 +247,9 @@ void LldpManager::sendLldpInfo(
 
   // now write optional TLVs
   // system name TLV
-  if (strlen(hostname) > 0) {
+  if (!cache.hostname.empty()) {
     writeTlv(SYSTEM_NAME_TLV_TYPE,
-             StringPiece(hostname), &cursor);
+             StringPiece(cache.hostname), &cursor);
   }
 
   // system description TLV
@@ -186,12 +265,7 @@ void LldpManager::sendLldpInfo(
 
   // Fill the padding with 0s
   memset(cursor.writableData(), 0, cursor.length());
-  // this LLDP packet HAS to exit out of the port specified here.
-  sw->sendPacketOutOfPort(std::move(pkt), thisPortID);
-  XLOG(DBG4) << "sent LLDP "
-             << " on port " << port->getID() << " with CPU MAC "
-             << cpuMac.toString() << " port id " << port->getName()
-             << " and vlan " << port->getIngressVlan();
+  return frame;
 }
 
 }} // facebook::fboss
@@ -9,10 +9,14 @@
  */
 // Copyright 2014-present Facebook. All Rights Reserved.
 #pragma once
+#include <folly/Synchronized.h>
+#include <folly/io/IOBuf.h>
 #include <folly/io/async/AsyncTimeout.h>
 #include <unordered_map>
 #include <memory>
+#include <string>
 #include "fboss/agent/Platform.h"
+#include "fboss/agent/StateObserver.h"
 #include "fboss/agent/lldp/LinkNeighborDB.h"
 #include "fboss/agent/state/Port.h"
 #include "fboss/agent/state/PortMap.h"
@@ -25,7 +29,8 @@ class Cursor;
 namespace facebook { namespace fboss {
 class RxPacket;
 
-class LldpManager : private folly::AsyncTimeout {
+class LldpManager : public AutoRegisterStateObserver,
+                    private folly::AsyncTimeout {
   /*
    * LldpManager is the class that manages Lldp support.
    * Responsible for processing received LLDP frames and maintaining the
@@ -33,6 +38,11 @@ class LldpManager : private folly::AsyncTimeout {
    * Also, responsible for periodically sending LLDP frames on all the ports
    * to inform of this switch's presence to its neighbors. Hence inheriting
    * the AsyncTimeout class for that purpose.
+   *
+   * The frame of each port is built once and kept until the port's name or
+   * VLAN, the hostname or the CPU MAC change, as observed from the state
+   * deltas.  The ports are sent to in TX_SLOTS groups spread over the
+   * interval, rather than all together.
    */
  public:
   enum : uint16_t { ETHERTYPE_LLDP = 0x88CC,
@@ -56,7 +66,8 @@ class LldpManager : private folly::AsyncTimeout {
                     TTL_TLV_LENGTH = 0x2,
                     TTL_TLV_VALUE = 120,
                     PDU_END_TLV_TYPE = 0,
-                    PDU_END_TLV_LENGTH = 0};
+                    PDU_END_TLV_LENGTH = 0,
+                    TX_SLOTS = 15};
   explicit LldpManager(SwSwitch* sw);
   ~LldpManager() override;
   static const folly::MacAddress LLDP_DEST_MAC;
@@ -81,6 +92,8 @@ class LldpManager : private folly::AsyncTimeout {
                     folly::MacAddress src,
                     folly::io::Cursor cursor);
 
+  void stateUpdated(const StateDelta& delta) override;
+
   // This function is internal.  It is only public for use in unit tests.
   void sendLldpOnAllPorts(bool checkPortStatusFlag);
 
@@ -93,13 +106,35 @@ class LldpManager : private folly::AsyncTimeout {
   }
 
  private:
+  struct CachedFrame {
+    // The port as the frame was built for it, in case the frame was built
+    // from a state older than the last delta
+    std::string portName;
+    VlanID vlan{0};
+    std::unique_ptr<folly::IOBuf> frame;
+  };
+  using PortIDToFrame = std::unordered_map<PortID, CachedFrame>;
+  struct FrameCache {
+    // What the frames were built with
+    std::string hostname;
+    folly::MacAddress cpuMac;
+    PortIDToFrame frames;
+  };
+
   void timeoutExpired() noexcept override;
-  void sendLldpInfo(SwSwitch* sw, const std::shared_ptr<SwitchState>& swState,
-                    const std::shared_ptr<Port>& port);
+  // Send on the ports of one of the TX_SLOTS, or all of them if slot < 0
+  void sendLldp(bool checkPortStatusFlag, int slot);
+  void sendLldpInfo(const std::shared_ptr<Port>& port, FrameCache* cache);
+  std::unique_ptr<folly::IOBuf> buildLldpFrame(
+      const std::shared_ptr<Port>& port,
+      const FrameCache& cache) const;
 
   SwSwitch* sw_{nullptr};
   std::chrono::milliseconds interval_;
   LinkNeighborDB db_;
+  // The slot to send on next.  Only used on the background thread.
+  int nextSlot_{0};
+  folly::Synchronized<FrameCache> frameCache_;
 };
 
 }} // facebook::fboss
@@ -0,0 +1,343 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "fboss/agent/LoadImbalanceMonitor.h"
+
+#include "common/stats/ServiceData.h"
+#include "fboss/agent/state/AggregatePort.h"
+#include "fboss/agent/state/AggregatePortMap.h"
+#include "fboss/agent/state/ArpTable.h"
+#include "fboss/agent/state/Interface.h"
+#include "fboss/agent/state/InterfaceMap.h"
+#include "fboss/agent/state/NdpTable.h"
+#include "fboss/agent/state/Port.h"
+#include "fboss/agent/state/PortMap.h"
+#include "fboss/agent/state/Route.h"
+#include "fboss/agent/state/RouteTable.h"
+#include "fboss/agent/state/RouteTableMap.h"
+#include "fboss/agent/state/RouteTableRib.h"
+#include "fboss/agent/state/SwitchState.h"
+#include "fboss/agent/state/Vlan.h"
+#include "fboss/agent/state/VlanMap.h"
+
+#include <folly/Conv.h>
+#include <folly/Optional.h>
+#include <folly/String.h>
+
+#include <algorithm>
+
+DEFINE_int32(load_imbalance_interval_s, 10,
+             "How often to measure how evenly ECMP groups and aggregate "
+             "ports spread traffic over their members, 0 to never");
+DEFINE_int64(load_imbalance_min_bytes, 10 * 1000 * 1000,
+             "Leave out groups that carried fewer bytes than this over the "
+             "interval");
+DEFINE_double(load_imbalance_alert_ratio, 1.5,
+              "Count groups with a busiest member over this many times the "
+              "mean as imbalanced");
+
+namespace facebook { namespace fboss {
+
+namespace {
+
+using Member = LoadImbalanceMonitor::Member;
+using Group = LoadImbalanceMonitor::Group;
+
+std::string getPortName(const SwitchState& state, PortID id) {
+  auto port = state.getPorts()->getPortIf(id);
+  return port && !port->getName().empty()
+      ? port->getName()
+      : folly::to<std::string>("port", id);
+}
+
+// The subports of an aggregate port that traffic is sent out of
+std::vector<PortID> getForwardingSubports(const AggregatePort& aggPort) {
+  std::vector<PortID> ports;
+  for (const auto& subport : aggPort.subportAndFwdState()) {
+    if (subport.second == AggregatePort::Forwarding::ENABLED) {
+      ports.push_back(subport.first);
+    }
+  }
+  return ports;
+}
+
+folly::Optional<Member> getMember(
+    const SwitchState& state, PortDescriptor port) {
+  if (port.isPhysicalPort()) {
+    return Member{getPortName(state, port.phyPortID()), {port.phyPortID()}};
+  }
+  auto aggPort = state.getAggregatePorts()->getAggregatePortIf(
+      port.aggPortID());
+  if (!aggPort) {
+    return folly::none;
+  }
+  return Member{aggPort->getName(), getForwardingSubports(*aggPort)};
+}
+
+// The port a resolved next hop sends out of, if its neighbor is resolved
+template <typename NextHopT>
+folly::Optional<PortDescriptor> getNextHopPort(
+    const SwitchState& state, const NextHopT& nhop) {
+  auto intf = state.getInterfaces()->getInterfaceIf(nhop.intf());
+  if (!intf) {
+    return folly::none;
+  }
+  auto vlan = state.getVlans()->getVlanIf(intf->getVlanID());
+  if (!vlan) {
+    return folly::none;
+  }
+  auto addr = nhop.addr();
+  folly::Optional<PortDescriptor> port;
+  if (addr.isV4()) {
+    auto entry = vlan->getArpTable()->getEntryIf(addr.asV4());
+    if (entry && !entry->isPending()) {
+      port = entry->getPort();
+    }
+  } else {
+    auto entry = vlan->getNdpTable()->getEntryIf(addr.asV6());
+    if (entry && !entry->isPending()) {
+      port = entry->getPort();
+    }
+  }
+  return port;
+}
+
+template <typename RibT>
+void findEcmpGroups(
+    const SwitchState& state,
+    const RibT& rib,
+    std::map<std::vector<std::string>, Group>* groups) {
+  for (const auto& route : *rib.routes()) {
+    if (!route->isResolved() || route->isDrop() || route->isToCPU()) {
+      continue;
+    }
+    const auto& nhops = route->getForwardInfo().getNextHopSet();
+    if (nhops.size() < 2) {
+      continue;
+    }
+    std::map<std::string, Member> members;
+    for (const auto& nhop : nhops) {
+      if (!nhop.isResolved()) {
+        continue;
+      }
+      auto port = getNextHopPort(state, nhop);
+      if (!port) {
+        continue;
+      }
+      auto member = getMember(state, *port);
+      if (member) {
+        members.emplace(member->name, std::move(*member));
+      }
+    }
+    if (members.size() < 2) {
+      continue;
+    }
+    std::vector<std::string> key;
+    for (const auto& member : members) {
+      key.push_back(member.first);
+    }
+    auto it = groups->find(key);
+    if (it == groups->end()) {
+      Group group;
+      group.type = LoadBalancedGroupType::ECMP;
+      group.name = folly::join(",", key);
+      for (auto& member : members) {
+        group.members.push_back(std::move(member.second));
+      }
+      it = groups->emplace(std::move(key), std::move(group)).first;
+    }
+    ++it->second.numRoutes;
+  }
+}
+
+} // unnamed namespace
+
+void LoadImbalanceMonitor::update(
+    const std::shared_ptr<SwitchState>& state,
+    const PortStatsSnapshot::Snapshot& counters,
+    std::chrono::steady_clock::time_point now) {
+  if (FLAGS_load_imbalance_interval_s <= 0 ||
+      (!lastBytes_.empty() &&
+       now - lastUpdate_ <
+           std::chrono::seconds(FLAGS_load_imbalance_interval_s))) {
+    return;
+  }
+  lastUpdate_ = now;
+  if (groupsChanged(*state)) {
+    groups_ = findGroups(*state);
+    routeTables_ = state->getRouteTables();
+    vlans_ = state->getVlans();
+    interfaces_ = state->getInterfaces();
+    aggregatePorts_ = state->getAggregatePorts();
+  }
+  measure(counters);
+}
+
+std::vector<GroupImbalanceThrift> LoadImbalanceMonitor::getTopImbalanced(
+    size_t count) const {
+  auto results = results_.rlock();
+  return std::vector<GroupImbalanceThrift>(
+      results->begin(),
+      results->begin() + std::min(count, results->size()));
+}
+
+std::vector<Group> LoadImbalanceMonitor::findGroups(const SwitchState& state) {
+  std::vector<Group> groups;
+  for (const auto& aggPort : *state.getAggregatePorts()) {
+    auto ports = getForwardingSubports(*aggPort);
+    if (ports.size() < 2) {
+      continue;
+    }
+    Group group;
+    group.type = LoadBalancedGroupType::LAG;
+    group.name = aggPort->getName();
+    for (auto port : ports) {
+      group.members.push_back(Member{getPortName(state, port), {port}});
+    }
+    groups.push_back(std::move(group));
+  }
+
+  // Many routes share each group, so only keep each set of members once
+  std::map<std::vector<std::string>, Group> ecmpGroups;
+  for (const auto& routeTable : *state.getRouteTables()) {
+    findEcmpGroups(state, *routeTable->getRibV4(), &ecmpGroups);
+    findEcmpGroups(state, *routeTable->getRibV6(), &ecmpGroups);
+  }
+  for (auto& group : ecmpGroups) {
+    groups.push_back(std::move(group.second));
+  }
+  return groups;
+}
+
+bool LoadImbalanceMonitor::groupsChanged(const SwitchState& state) const {
+  return routeTables_ != state.getRouteTables() ||
+      vlans_ != state.getVlans() || interfaces_ != state.getInterfaces() ||
+      aggregatePorts_ != state.getAggregatePorts();
+}
+
+void LoadImbalanceMonitor::measure(
+    const PortStatsSnapshot::Snapshot& counters) {
+  std::map<PortID, int64_t> bytes;
+  for (const auto& entry : counters) {
+    bytes.emplace(entry.first, entry.second.output.bytes);
+  }
+  // The bytes sent out of a port since the last measurement, none if it is
+  // new or its counters were reset
+  auto getDelta = [&](PortID port) -> folly::Optional<int64_t> {
+    auto cur = bytes.find(port);
+    auto last = lastBytes_.find(port);
+    if (cur == bytes.end() || last == lastBytes_.end() ||
+        cur->second < last->second) {
+      return folly::none;
+    }
+    return cur->second - last->second;
+  };
+
+  std::vector<GroupImbalanceThrift> results;
+  for (const auto& group : groups_) {
+    GroupImbalanceThrift result;
+    result.type = group.type;
+    result.name = group.name;
+    result.numRoutes = group.numRoutes;
+    bool complete = true;
+    int64_t total = 0;
+    int64_t max = 0;
+    for (const auto& member : group.members) {
+      int64_t memberBytes = 0;
+      for (auto port : member.ports) {
+        auto delta = getDelta(port);
+        if (!delta) {
+          complete = false;
+          break;
+        }
+        memberBytes += *delta;
+      }
+      if (!complete) {
+        break;
+      }
+      result.members.push_back(member.name);
+      result.memberBytes.push_back(memberBytes);
+      total += memberBytes;
+      max = std::max(max, memberBytes);
+    }
+    if (!complete || total == 0 || total < FLAGS_load_imbalance_min_bytes) {
+      continue;
+    }
+    result.imbalance =
+        static_cast<double>(max) * group.members.size() / total;
+    results.push_back(std::move(result));
+  }
+  std::sort(
+      results.begin(),
+      results.end(),
+      [](const GroupImbalanceThrift& a, const GroupImbalanceThrift& b) {
+        return a.imbalance > b.imbalance;
+      });
+  lastBytes_ = std::move(bytes);
+
+  publish(results);
+  *results_.wlock() = std::move(results);
+}
+
+void LoadImbalanceMonitor::publish(
+    const std::vector<GroupImbalanceThrift>& results) {
+  struct Summary {
+    const char* name;
+    double maxImbalance{0};
+    int64_t numGroups{0};
+    int64_t numImbalanced{0};
+  };
+  Summary ecmp{"ecmp"};
+  Summary lag{"lag"};
+  // Aggregate ports left out of the results, for too little traffic, are
+  // exported as 0
+  std::map<std::string, double> lagImbalances;
+  for (const auto& group : groups_) {
+    if (group.type == LoadBalancedGroupType::LAG) {
+      lagImbalances[group.name] = 0;
+    }
+  }
+  for (const auto& result : results) {
+    auto& summary = result.type == LoadBalancedGroupType::ECMP ? ecmp : lag;
+    summary.maxImbalance = std::max(summary.maxImbalance, result.imbalance);
+    ++summary.numGroups;
+    if (result.imbalance > FLAGS_load_imbalance_alert_ratio) {
+      ++summary.numImbalanced;
+    }
+    if (result.type == LoadBalancedGroupType::LAG) {
+      lagImbalances[result.name] = result.imbalance;
+    }
+  }
+  auto lagCounter = [](const std::string& name) {
+    return folly::to<std::string>("load_imbalance.lag.", name, ".pct");
+  };
+  // Imbalances are exported as percentages, so 100 is an even spread
+  std::set<std::string> exportedLags;
+  for (const auto& lagImbalance : lagImbalances) {
+    fbData->setCounter(
+        lagCounter(lagImbalance.first), lagImbalance.second * 100);
+    exportedLags.insert(lagImbalance.first);
+  }
+  // Aggregate ports that were removed, or no longer have the members to be
+  // a group, don't keep their last imbalance
+  for (const auto& name : exportedLags_) {
+    if (!exportedLags.count(name)) {
+      fbData->clearCounter(lagCounter(name));
+    }
+  }
+  exportedLags_ = std::move(exportedLags);
+  for (const auto& summary : {ecmp, lag}) {
+    auto prefix = folly::to<std::string>("load_imbalance.", summary.name);
+    fbData->setCounter(prefix + ".max_pct", summary.maxImbalance * 100);
+    fbData->setCounter(prefix + ".groups", summary.numGroups);
+    fbData->setCounter(prefix + ".imbalanced_groups", summary.numImbalanced);
+  }
+}
+
+}} // facebook::fboss
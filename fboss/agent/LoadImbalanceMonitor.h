@@ -0,0 +1,122 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#pragma once
+
+#include "fboss/agent/PortStatsSnapshot.h"
+#include "fboss/agent/if/gen-cpp2/ctrl_types.h"
+#include "fboss/agent/types.h"
+
+#include <folly/Synchronized.h>
+#include <gflags/gflags.h>
+
+#include <chrono>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+DECLARE_int32(load_imbalance_interval_s);
+DECLARE_int64(load_imbalance_min_bytes);
+DECLARE_double(load_imbalance_alert_ratio);
+
+namespace facebook { namespace fboss {
+
+class AggregatePortMap;
+class InterfaceMap;
+class RouteTableMap;
+class SwitchState;
+class VlanMap;
+
+/*
+ * LoadImbalanceMonitor measures how evenly each ECMP group and aggregate
+ * port spreads traffic over its members, to catch hash polarization.
+ *
+ * Every load_imbalance_interval_s it takes the egress bytes of each member
+ * over the interval from the port counters, and computes the busiest
+ * member's bytes over the mean.  An ECMP member's bytes are those of the
+ * port, or all the ports of the aggregate port, its next hop resolves to.
+ * Since port counters also count traffic that isn't for the group, this is
+ * exact for aggregate ports but an estimate for ECMP groups that share
+ * members.  Groups that carried less than load_imbalance_min_bytes are left
+ * out, as their spread is noise.
+ *
+ * ECMP groups are the distinct sets of members of the multipath routes.
+ * They are only found again when the routes, neighbors, interfaces or
+ * aggregate ports change, rather than on every interval.
+ *
+ * It exports the worst imbalance of each kind of group, how many are over
+ * load_imbalance_alert_ratio, and the imbalance of each aggregate port, and
+ * keeps the groups of the last interval for getTopImbalanced().
+ */
+class LoadImbalanceMonitor {
+ public:
+  struct Member {
+    std::string name;
+    // An aggregate port's subports, or the one port
+    std::vector<PortID> ports;
+  };
+  struct Group {
+    LoadBalancedGroupType type;
+    std::string name;
+    std::vector<Member> members;
+    int32_t numRoutes{0};
+  };
+
+  LoadImbalanceMonitor() {}
+
+  /*
+   * Called from the stats thread after each stats update.  Does nothing
+   * until an interval has passed since the last measurement.
+   */
+  void update(
+      const std::shared_ptr<SwitchState>& state,
+      const PortStatsSnapshot::Snapshot& counters,
+      std::chrono::steady_clock::time_point now);
+
+  /*
+   * The count groups of the last interval with the highest imbalance, most
+   * imbalanced first.  Can be called from any thread.
+   */
+  std::vector<GroupImbalanceThrift> getTopImbalanced(size_t count) const;
+
+  /*
+   * The ECMP groups and aggregate ports of a state.
+   */
+  static std::vector<Group> findGroups(const SwitchState& state);
+
+ private:
+  // Forbidden copy constructor and assignment operator
+  LoadImbalanceMonitor(LoadImbalanceMonitor const &) = delete;
+  LoadImbalanceMonitor& operator=(LoadImbalanceMonitor const &) = delete;
+
+  bool groupsChanged(const SwitchState& state) const;
+  void measure(const PortStatsSnapshot::Snapshot& counters);
+  void publish(const std::vector<GroupImbalanceThrift>& results);
+
+  // Only used from the stats thread
+  std::chrono::steady_clock::time_point lastUpdate_;
+  // The egress bytes of each port at the last measurement
+  std::map<PortID, int64_t> lastBytes_;
+  std::vector<Group> groups_;
+  // The nodes groups_ were found from
+  std::shared_ptr<RouteTableMap> routeTables_;
+  std::shared_ptr<VlanMap> vlans_;
+  std::shared_ptr<InterfaceMap> interfaces_;
+  std::shared_ptr<AggregatePortMap> aggregatePorts_;
+  // The aggregate ports whose imbalance is exported, so the counters of
+  // those removed can be cleared
+  std::set<std::string> exportedLags_;
+
+  // Sorted by imbalance, highest first
+  folly::Synchronized<std::vector<GroupImbalanceThrift>> results_;
+};
+
+}} // facebook::fboss
@@ -0,0 +1,176 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "fboss/agent/MacLearner.h"
+
+#include "fboss/agent/state/MacEntry.h"
+#include "fboss/agent/state/MacTable.h"
+#include "fboss/agent/state/SwitchState.h"
+#include "fboss/agent/state/Vlan.h"
+#include "fboss/agent/state/VlanMap.h"
+
+#include <folly/logging/xlog.h>
+#include <folly/system/ThreadName.h>
+
+#include <chrono>
+#include <map>
+#include <utility>
+
+DEFINE_bool(enable_sw_mac_learning, false,
+            "Keep the MACs the hardware learns in the MAC tables of the "
+            "VLANs in the switch state");
+DEFINE_int32(mac_learning_queue_size, 16384,
+             "How many MAC learning updates can be queued before the rest "
+             "are dropped");
+DEFINE_int32(mac_learning_batch_ms, 50,
+             "How long to batch MAC learning updates for before applying "
+             "them to the switch state");
+DEFINE_int32(max_mac_learns_per_sec, 10000,
+             "The most MACs to learn a second, 0 for no limit");
+
+namespace facebook { namespace fboss {
+
+MacLearner::MacLearner(std::function<void(Batch)> apply)
+    : apply_(std::move(apply)),
+      queue_(FLAGS_mac_learning_queue_size) {
+  if (FLAGS_max_mac_learns_per_sec > 0) {
+    // Allow up to a second's worth of MACs in a burst
+    learnLimit_ = std::make_unique<folly::TokenBucket>(
+        FLAGS_max_mac_learns_per_sec, FLAGS_max_mac_learns_per_sec);
+  }
+  thread_ = std::thread([this] {
+    folly::setThreadName("MacLearner");
+    run();
+  });
+}
+
+MacLearner::~MacLearner() {
+  stop();
+}
+
+MacLearner::EnqueueResult MacLearner::enqueue(
+    const L2LearningUpdate& update) {
+  if (update.type == L2LearningUpdate::Type::LEARN && learnLimit_ &&
+      !learnLimit_->consume(1)) {
+    return EnqueueResult::RATE_LIMITED;
+  }
+  if (!queue_.write(update)) {
+    return EnqueueResult::QUEUE_FULL;
+  }
+  if (sleeping_.load()) {
+    std::lock_guard<std::mutex> g(lock_);
+    wakeup_.notify_one();
+  }
+  return EnqueueResult::QUEUED;
+}
+
+void MacLearner::stop() {
+  if (!thread_.joinable()) {
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> g(lock_);
+    stopping_.store(true, std::memory_order_release);
+    wakeup_.notify_one();
+  }
+  thread_.join();
+}
+
+void MacLearner::run() {
+  auto stopping = [this] {
+    return stopping_.load(std::memory_order_acquire);
+  };
+  while (!stopping()) {
+    {
+      std::unique_lock<std::mutex> guard(lock_);
+      sleeping_.store(true);
+      // Recheck the queue now that producers will wake us
+      wakeup_.wait(guard, [&] { return stopping() || !queue_.isEmpty(); });
+      sleeping_.store(false);
+      // Let the rest of the batch arrive
+      wakeup_.wait_for(
+          guard,
+          std::chrono::milliseconds(FLAGS_mac_learning_batch_ms),
+          stopping);
+    }
+    if (stopping()) {
+      break;
+    }
+    auto batch = drain();
+    if (!batch.empty()) {
+      apply_(std::move(batch));
+    }
+  }
+}
+
+MacLearner::Batch MacLearner::drain() {
+  std::map<std::pair<VlanID, folly::MacAddress>, L2LearningUpdate> latest;
+  L2LearningUpdate update(
+      L2LearningUpdate::Type::AGE,
+      VlanID(0),
+      folly::MacAddress(),
+      PortDescriptor(PortID(0)));
+  // Only take what was queued by now, so a flood can't keep us here
+  auto count = queue_.size();
+  while (count-- > 0 && queue_.read(update)) {
+    auto key = std::make_pair(update.vlan, update.mac);
+    auto it = latest.find(key);
+    if (it == latest.end()) {
+      latest.emplace(key, update);
+    } else {
+      it->second = update;
+    }
+  }
+  Batch batch;
+  batch.reserve(latest.size());
+  for (const auto& entry : latest) {
+    batch.push_back(entry.second);
+  }
+  return batch;
+}
+
+std::shared_ptr<SwitchState> MacLearner::applyBatch(
+    const std::shared_ptr<SwitchState>& state, const Batch& batch) {
+  auto newState = state;
+  bool changed = false;
+  for (const auto& update : batch) {
+    auto* vlan = newState->getVlans()->getVlanIf(update.vlan).get();
+    if (!vlan) {
+      XLOG(DBG4) << "Ignoring MAC " << update.mac << " on unknown VLAN "
+                 << update.vlan;
+      continue;
+    }
+    auto entry = vlan->getMacTable()->getMacIf(update.mac);
+    if (update.type == L2LearningUpdate::Type::LEARN) {
+      if (entry && entry->getPort() == update.port) {
+        continue;
+      }
+      auto* macTable = vlan->getMacTable()->modify(&vlan, &newState);
+      auto newEntry = std::make_shared<MacEntry>(update.mac, update.port);
+      if (entry) {
+        XLOG(DBG3) << "MAC " << update.mac << " on VLAN " << update.vlan
+                   << " moved from " << entry->getPort() << " to "
+                   << update.port;
+        macTable->updateEntry(newEntry);
+      } else {
+        macTable->addEntry(newEntry);
+      }
+    } else {
+      if (!entry) {
+        continue;
+      }
+      auto* macTable = vlan->getMacTable()->modify(&vlan, &newState);
+      macTable->removeEntry(update.mac);
+    }
+    changed = true;
+  }
+  return changed ? newState : nullptr;
+}
+
+}} // facebook::fboss
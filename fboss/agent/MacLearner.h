@@ -0,0 +1,104 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#pragma once
+
+#include "fboss/agent/HwSwitch.h"
+
+#include <folly/MPMCQueue.h>
+#include <folly/TokenBucket.h>
+#include <gflags/gflags.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+DECLARE_bool(enable_sw_mac_learning);
+DECLARE_int32(mac_learning_queue_size);
+DECLARE_int32(mac_learning_batch_ms);
+DECLARE_int32(max_mac_learns_per_sec);
+
+namespace facebook { namespace fboss {
+
+class SwitchState;
+
+/*
+ * MacLearner is the software MAC learning pipeline: it takes the MACs the
+ * HwSwitch learns and ages out, and turns them into batched updates of the
+ * MacTables of the VLANs in the SwitchState.
+ *
+ * The HwSwitch's L2 callbacks only push each update onto a bounded
+ * lock-free queue, and updates that arrive while it is full are dropped.
+ * A dedicated thread waits mac_learning_batch_ms after the first update of
+ * a batch, drains the queue, keeps only the latest update of each MAC and
+ * hands the batch to be applied as a single state update.
+ *
+ * To keep a MAC flood from swamping the state updates, no more than
+ * max_mac_learns_per_sec MACs are learned a second.  The rest are dropped,
+ * and are learned again when the hardware reports them again.  Ageing
+ * isn't limited, since it only ever shrinks the tables.
+ */
+class MacLearner {
+ public:
+  using Batch = std::vector<L2LearningUpdate>;
+
+  enum class EnqueueResult {
+    QUEUED,
+    QUEUE_FULL,
+    RATE_LIMITED,
+  };
+
+  explicit MacLearner(std::function<void(Batch)> apply);
+  ~MacLearner();
+
+  /*
+   * Queue an update from the HwSwitch.  Never blocks.
+   */
+  EnqueueResult enqueue(const L2LearningUpdate& update);
+
+  /*
+   * Stop the thread, dropping any updates still queued.
+   */
+  void stop();
+
+  /*
+   * Apply a batch of updates to the MacTables of state.  Returns null if
+   * nothing changed.  Updates for VLANs that don't exist are ignored.
+   */
+  static std::shared_ptr<SwitchState> applyBatch(
+      const std::shared_ptr<SwitchState>& state, const Batch& batch);
+
+ private:
+  // Forbidden copy constructor and assignment operator
+  MacLearner(MacLearner const &) = delete;
+  MacLearner& operator=(MacLearner const &) = delete;
+
+  void run();
+  // The latest update of each MAC queued
+  Batch drain();
+
+  std::function<void(Batch)> apply_;
+  folly::MPMCQueue<L2LearningUpdate> queue_;
+  // Null if learning isn't rate limited
+  std::unique_ptr<folly::TokenBucket> learnLimit_;
+
+  // Sleeping is set while the thread waits on wakeup_ for updates to
+  // arrive.  Producers only take lock_ to wake it.
+  std::atomic<bool> sleeping_{false};
+  std::atomic<bool> stopping_{false};
+  std::mutex lock_;
+  std::condition_variable wakeup_;
+  std::thread thread_;
+};
+
+}} // facebook::fboss
@@ -24,10 +24,13 @@
 #include "fboss/agent/ApplyThriftConfig.h"
 #include "fboss/agent/HwSwitch.h"
 #include "fboss/agent/Platform.h"
+#include "fboss/agent/StartupProfiler.h"
+#include "fboss/agent/WarmBootTimeline.h"
 #include "fboss/agent/SwSwitch.h"
 #include "fboss/agent/SwitchStats.h"
 #include "fboss/agent/ThriftHandler.h"
 #include "fboss/agent/TunManager.h"
+#include "fboss/lib/OpenMetricsServer.h"
 
 #include <chrono>
 #include <condition_variable>
@@ -73,6 +76,9 @@ DEFINE_bool(enable_nhops_prober, true,
             "Enables prober for unresolved next hops");
 DEFINE_int32(flush_warmboot_cache_secs, 60,
     "Seconds to wait before flushing warm boot cache");
+DEFINE_int32(metrics_port, 0,
+             "Port to serve the counters on over HTTP, in the OpenMetrics "
+             "format, or 0 to not serve them");
 using facebook::fboss::SwSwitch;
 using facebook::fboss::ThriftHandler;
 
@@ -152,14 +158,20 @@ class Initializer {
 
     // Initialize the switch.  This operation can take close to a minute
     // on some of our current platforms.
-    sw_->init(nullptr, setupFlags());
+    {
+      StartupProfiler::Scope phase("switch_init");
+      sw_->init(nullptr, setupFlags());
+    }
 
     // Wait for the local MAC address to be available.
     ret.wait();
     auto localMac = ret.get();
     XLOG(INFO) << "local MAC is " << localMac;
 
-    sw_->applyConfig("apply initial config");
+    {
+      StartupProfiler::Scope phase("apply_initial_config");
+      sw_->applyConfig("apply initial config");
+    }
     // Enable route update logging for all routes so that when we are told
     // the first set of routes after a warm boot, we can log any changes
     // from what was programmed before the warm boot.
@@ -262,6 +274,7 @@ class SignalHandler : public AsyncSignalHandler {
 };
 
 int fbossMain(int argc, char** argv, PlatformInitFn initPlatform) {
+  WarmBootTimeline::get()->mark(WarmBootTimeline::Event::PROCESS_START);
 
   fbossInit(argc, argv);
 
@@ -285,7 +298,10 @@ int fbossMain(int argc, char** argv, PlatformInitFn initPlatform) {
   freopen("/dev/null", "r", stdin);
 
   // Now that we have parsed the command line flags, create the Platform object
-  unique_ptr<Platform> platform = initPlatform();
+  unique_ptr<Platform> platform = [&] {
+    StartupProfiler::Scope phase("platform_init");
+    return initPlatform();
+  }();
 
   // Create the SwSwitch and thrift handler
   SwSwitch sw(std::move(platform));
@@ -329,8 +345,19 @@ int fbossMain(int argc, char** argv, PlatformInitFn initPlatform) {
       std::chrono::milliseconds(FLAGS_stat_publish_interval_ms));
   statsPublisher.start();
 
+  std::unique_ptr<OpenMetricsServer> metricsServer;
+  if (FLAGS_metrics_port > 0) {
+    metricsServer = std::make_unique<OpenMetricsServer>(
+        "fboss_agent", FLAGS_metrics_port,
+        std::chrono::milliseconds(FLAGS_metrics_refresh_interval_ms));
+    metricsServer->start();
+  }
+
   auto stopServices = [&]() {
     statsPublisher.cancelTimeout();
+    if (metricsServer) {
+      metricsServer->stop();
+    }
     init.stopFunctionScheduler();
     fbossFinalize();
   };
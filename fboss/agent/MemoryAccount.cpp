@@ -0,0 +1,55 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "fboss/agent/MemoryAccount.h"
+
+#include <mutex>
+#include <unordered_set>
+#include <utility>
+
+namespace facebook { namespace fboss {
+
+namespace {
+
+struct AccountRegistry {
+  std::mutex lock;
+  std::unordered_set<const MemoryAccount*> accounts;
+};
+
+AccountRegistry& accountRegistry() {
+  // Leaked, so that accounts in static objects can outlive it safely
+  static auto* registry = new AccountRegistry();
+  return *registry;
+}
+
+} // unnamed namespace
+
+MemoryAccount::MemoryAccount(std::string name) : name_(std::move(name)) {
+  auto& registry = accountRegistry();
+  std::lock_guard<std::mutex> g(registry.lock);
+  registry.accounts.insert(this);
+}
+
+MemoryAccount::~MemoryAccount() {
+  auto& registry = accountRegistry();
+  std::lock_guard<std::mutex> g(registry.lock);
+  registry.accounts.erase(this);
+}
+
+std::map<std::string, uint64_t> MemoryAccount::totals() {
+  std::map<std::string, uint64_t> totals;
+  auto& registry = accountRegistry();
+  std::lock_guard<std::mutex> g(registry.lock);
+  for (const auto* account : registry.accounts) {
+    totals[account->getName()] += account->get();
+  }
+  return totals;
+}
+
+}} // facebook::fboss
@@ -0,0 +1,82 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+
+namespace facebook { namespace fboss {
+
+/*
+ * MemoryAccount tracks the memory a subsystem outside of the SwitchState
+ * holds, such as the hardware tables' shadow copies, the neighbor caches
+ * and the packet capture buffers.
+ *
+ * The owner keeps the account next to the memory it measures, and sets it
+ * whenever the memory changes size, from estimates of its containers'
+ * capacities.  Accounts are published by name: all those alive with the
+ * same name, as the caches of every VLAN, are summed together.
+ */
+class MemoryAccount {
+ public:
+  explicit MemoryAccount(std::string name);
+  ~MemoryAccount();
+
+  void set(uint64_t bytes) {
+    bytes_.store(bytes, std::memory_order_relaxed);
+  }
+  uint64_t get() const {
+    return bytes_.load(std::memory_order_relaxed);
+  }
+  const std::string& getName() const {
+    return name_;
+  }
+
+  /*
+   * The bytes held under each name, summed over the accounts alive.
+   */
+  static std::map<std::string, uint64_t> totals();
+
+ private:
+  // Forbidden copy constructor and assignment operator
+  MemoryAccount(MemoryAccount const &) = delete;
+  MemoryAccount& operator=(MemoryAccount const &) = delete;
+
+  const std::string name_;
+  std::atomic<uint64_t> bytes_{0};
+};
+
+namespace detail {
+template <typename ContainerT>
+auto containerMemoryBytes(const ContainerT& container, int)
+    -> decltype(static_cast<uint64_t>(container.capacity())) {
+  return container.capacity() * sizeof(typename ContainerT::value_type);
+}
+template <typename ContainerT>
+uint64_t containerMemoryBytes(const ContainerT& container, long) {
+  return container.size() *
+      (sizeof(typename ContainerT::value_type) + 2 * sizeof(void*));
+}
+} // namespace detail
+
+/*
+ * An estimate of the memory a container's elements take, not counting what
+ * they point to: the capacity of vectors and flat containers, and a node of
+ * two pointers per element for the others.
+ */
+template <typename ContainerT>
+uint64_t containerMemoryBytes(const ContainerT& container) {
+  return detail::containerMemoryBytes(container, 0);
+}
+
+}} // facebook::fboss
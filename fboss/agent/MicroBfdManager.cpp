@@ -0,0 +1,339 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "fboss/agent/MicroBfdManager.h"
+
+#include "fboss/agent/IPv4Handler.h"
+#include "fboss/agent/LinkAggregationManager.h"
+#include "fboss/agent/Platform.h"
+#include "fboss/agent/RxPacket.h"
+#include "fboss/agent/SwSwitch.h"
+#include "fboss/agent/SwitchStats.h"
+#include "fboss/agent/TxPacket.h"
+#include "fboss/agent/UDPHeader.h"
+#include "fboss/agent/Utils.h"
+#include "fboss/agent/packet/IPProto.h"
+#include "fboss/agent/packet/IPv4Hdr.h"
+#include "fboss/agent/packet/ParsedPacket.h"
+#include "fboss/agent/state/AggregatePort.h"
+#include "fboss/agent/state/AggregatePortMap.h"
+#include "fboss/agent/state/Interface.h"
+#include "fboss/agent/state/InterfaceMap.h"
+#include "fboss/agent/state/Port.h"
+#include "fboss/agent/state/PortMap.h"
+#include "fboss/agent/state/StateDelta.h"
+#include "fboss/agent/state/SwitchState.h"
+
+#include <folly/Random.h>
+#include <folly/logging/xlog.h>
+#include <folly/system/ThreadName.h>
+
+#include <gflags/gflags.h>
+
+#include <stdexcept>
+
+DEFINE_int32(
+    micro_bfd_interval_ms,
+    0,
+    "Interval to send micro-BFD packets at over the members of aggregate "
+    "ports, and to expect them from the peer at.  0 turns micro-BFD off");
+DEFINE_int32(
+    micro_bfd_multiplier,
+    3,
+    "Number of micro-BFD intervals without a packet from the peer after "
+    "which a member is taken out of its aggregate port");
+DEFINE_int32(
+    micro_bfd_rt_priority,
+    50,
+    "SCHED_FIFO priority of the micro-BFD thread, or 0 to leave it at the "
+    "priority of the other threads");
+
+using folly::IPAddressV4;
+using std::chrono::milliseconds;
+
+namespace facebook {
+namespace fboss {
+
+namespace {
+// RFC 5881 4: the source port is in the range 49152 through 65535
+constexpr uint16_t kMinSrcPort = 49152;
+// RFC 5881 5: packets are sent with, and only accepted with, a TTL of 255,
+// so they can't have come from further than the peer
+constexpr uint8_t kTtl = 255;
+// A 802.1Q tagged Ethernet header
+constexpr uint32_t kEthHdrSize = 18;
+} // namespace
+
+MicroBfdManager::MicroBfdManager(
+    SwSwitch* sw,
+    LinkAggregationManager* lagManager)
+    : AutoRegisterStateObserver(sw, "MicroBfdManager"),
+      sw_(sw),
+      lagManager_(lagManager) {
+  thread_ = std::thread([this]() {
+    folly::setThreadName("fbossMicroBfdThread");
+    if (FLAGS_micro_bfd_rt_priority > 0) {
+      setRealtimePriority(FLAGS_micro_bfd_rt_priority);
+    }
+    evb_.loopForever();
+  });
+}
+
+MicroBfdManager::~MicroBfdManager() {
+  // Stop hearing about the members before the sessions go away
+  stopObserving();
+
+  evb_.runInEventBaseThreadAndWait([this]() {
+    for (auto& portAndSession : sessions_) {
+      portAndSession.second->stop();
+    }
+    sessions_.clear();
+  });
+  evb_.runInEventBaseThread([this]() { evb_.terminateLoopSoon(); });
+  thread_.join();
+}
+
+bool MicroBfdManager::isEnabled() {
+  return FLAGS_micro_bfd_interval_ms > 0;
+}
+
+void MicroBfdManager::stateUpdated(const StateDelta& delta) {
+  const auto& oldState = delta.oldState();
+  const auto& newState = delta.newState();
+  if (oldState->getAggregatePorts() == newState->getAggregatePorts() &&
+      oldState->getPorts() == newState->getPorts() &&
+      oldState->getInterfaces() == newState->getInterfaces()) {
+    return;
+  }
+
+  PortIDToMember members;
+  for (const auto& aggPort : *newState->getAggregatePorts()) {
+    for (const auto& subport : aggPort->sortedSubports()) {
+      auto port = newState->getPorts()->getPortIf(subport.portID);
+      if (!port) {
+        continue;
+      }
+
+      Member member;
+      member.aggPortID = aggPort->getID();
+      member.vlan = port->getIngressVlan();
+      auto intf =
+          newState->getInterfaces()->getInterfaceInVlanIf(member.vlan);
+      if (intf) {
+        for (const auto& address : intf->getAddresses()) {
+          if (address.first.isV4()) {
+            member.srcIp = address.first.asV4();
+            break;
+          }
+        }
+      }
+      members.emplace(subport.portID, member);
+    }
+  }
+
+  evb_.runInEventBaseThread([this, members = std::move(members)]() mutable {
+    updateMembers(std::move(members));
+  });
+}
+
+void MicroBfdManager::updateMembers(PortIDToMember members) {
+  for (auto it = sessions_.begin(); it != sessions_.end();) {
+    if (members.find(it->first) == members.end()) {
+      XLOG(DBG2) << "Stopping micro-BFD session of port " << it->first;
+      it->second->stop();
+      peers_.erase(it->first);
+      it = sessions_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+
+  members_ = std::move(members);
+
+  for (const auto& portAndMember : members_) {
+    auto portID = portAndMember.first;
+    if (sessions_.find(portID) != sessions_.end()) {
+      continue;
+    }
+    XLOG(DBG2) << "Starting micro-BFD session of port " << portID;
+    auto session = std::make_unique<MicroBfdSession>(
+        portID,
+        &evb_,
+        this,
+        allocateDiscriminator(),
+        milliseconds(FLAGS_micro_bfd_interval_ms),
+        FLAGS_micro_bfd_multiplier);
+    auto* sessionPtr = session.get();
+    sessions_.emplace(portID, std::move(session));
+    sessionPtr->start();
+  }
+}
+
+uint32_t MicroBfdManager::allocateDiscriminator() const {
+  while (true) {
+    auto discriminator = folly::Random::rand32();
+    if (discriminator == 0) {
+      continue;
+    }
+    bool used = false;
+    for (const auto& portAndSession : sessions_) {
+      if (portAndSession.second->localDiscriminator() == discriminator) {
+        used = true;
+        break;
+      }
+    }
+    if (!used) {
+      return discriminator;
+    }
+  }
+}
+
+void MicroBfdManager::handlePacket(
+    std::unique_ptr<RxPacket> pkt,
+    const ParsedPacket& parsed) {
+  auto portID = pkt->getSrcPort();
+  if (parsed.ipProtocol != IP_PROTO_UDP || !parsed.hasL4()) {
+    sw_->stats()->port(portID)->pktDropped();
+    return;
+  }
+
+  folly::io::Cursor cursor(pkt->buf());
+  cursor += parsed.l3Offset;
+  IPv4Hdr ipHdr(cursor);
+
+  folly::io::Cursor udpCursor(pkt->buf());
+  udpCursor += parsed.l4Offset;
+  UDPHeader udpHdr;
+  udpHdr.parse(&udpCursor);
+
+  if (udpHdr.dstPort != BfdControlPacket::kMicroBfdPort ||
+      ipHdr.ttl != kTtl) {
+    XLOG(DBG4) << "Dropping packet to the micro-BFD MAC from port " << portID
+               << ": UDP port " << udpHdr.dstPort << ", TTL "
+               << static_cast<int>(ipHdr.ttl);
+    sw_->stats()->port(portID)->pktDropped();
+    return;
+  }
+
+  BfdControlPacket bfdPkt;
+  try {
+    bfdPkt = BfdControlPacket::from(&udpCursor);
+  } catch (const std::out_of_range&) {
+    XLOG(DBG4) << "Truncated micro-BFD packet from port " << portID;
+    sw_->stats()->port(portID)->pktError();
+    return;
+  }
+
+  evb_.runInEventBaseThread([this, portID, srcIp = ipHdr.srcAddr, bfdPkt]() {
+    received(portID, srcIp, bfdPkt);
+  });
+}
+
+void MicroBfdManager::received(
+    PortID portID,
+    IPAddressV4 srcIp,
+    BfdControlPacket pkt) {
+  auto it = sessions_.find(portID);
+  if (it == sessions_.end()) {
+    XLOG(DBG4) << "No micro-BFD session on port " << portID;
+    return;
+  }
+
+  peers_[portID] = srcIp;
+  it->second->received(pkt);
+}
+
+void MicroBfdManager::transmit(PortID portID, const BfdControlPacket& pkt) {
+  auto memberIt = members_.find(portID);
+  if (memberIt == members_.end()) {
+    return;
+  }
+  const auto& member = memberIt->second;
+  if (!member.srcIp) {
+    XLOG(DBG4) << "Not sending micro-BFD packet on port " << portID
+               << ": no IPv4 address on VLAN " << member.vlan;
+    return;
+  }
+
+  auto peerIt = peers_.find(portID);
+  auto dstIp = peerIt == peers_.end() ? IPAddressV4("255.255.255.255")
+                                      : peerIt->second;
+
+  uint16_t udpLength = UDPHeader::size() + BfdControlPacket::LENGTH;
+  IPv4Hdr ipHdr(
+      4, // version
+      IPv4Hdr::minSize() / 4, // ihl in 32 bit chunks
+      0, // dscp
+      0, // ecn
+      IPv4Hdr::minSize() + udpLength, // length
+      0, // id
+      false, // Don't fragment
+      false, // More fragments
+      0, // Fragment offset
+      kTtl, // TTL
+      IP_PROTO::IP_PROTO_UDP, // Protocol
+      0, // Checksum
+      *member.srcIp, // Source
+      dstIp // Destination IP
+      );
+  ipHdr.computeChecksum();
+  UDPHeader udpHdr(
+      kMinSrcPort + static_cast<uint16_t>(portID) % 16384,
+      BfdControlPacket::kMicroBfdPort,
+      udpLength);
+
+  auto txPacket = sw_->allocatePacket(kEthHdrSize + ipHdr.size() + udpLength);
+  if (!txPacket) {
+    XLOG(DBG4) << "Failed to allocate tx packet for micro-BFD on port "
+               << portID;
+    return;
+  }
+
+  folly::io::RWPrivateCursor rwCursor(txPacket->buf());
+  TxPacket::writeEthHeader(
+      &rwCursor,
+      BfdControlPacket::kMicroBfdDstMac(),
+      sw_->getPlatform()->getLocalMac(),
+      member.vlan,
+      IPv4Handler::ETHERTYPE_IPV4);
+  ipHdr.write(&rwCursor);
+  rwCursor.writeBE<uint16_t>(udpHdr.srcPort);
+  rwCursor.writeBE<uint16_t>(udpHdr.dstPort);
+  rwCursor.writeBE<uint16_t>(udpHdr.length);
+  folly::io::RWPrivateCursor csumCursor(rwCursor);
+  rwCursor.skip(2);
+  folly::io::Cursor payloadStart(rwCursor);
+
+  pkt.to(&rwCursor);
+  csumCursor.writeBE<uint16_t>(udpHdr.computeChecksum(ipHdr, payloadStart));
+
+  sw_->sendPacketOutOfPort(std::move(txPacket), portID);
+}
+
+void MicroBfdManager::sessionUp(PortID portID) {
+  XLOG(INFO) << "Micro-BFD session of port " << portID << " is up";
+  lagManager_->memberLivenessChanged(portID, true);
+}
+
+void MicroBfdManager::sessionDown(
+    PortID portID,
+    BfdControlPacket::Diag diag,
+    milliseconds silence) {
+  XLOG(WARNING) << "Micro-BFD session of port " << portID
+                << " is down, diag " << static_cast<int>(diag);
+  lagManager_->memberLivenessChanged(portID, false);
+
+  sw_->stats()->microBfdSessionDown();
+  if (diag == BfdControlPacket::Diag::DETECTION_TIME_EXPIRED) {
+    sw_->stats()->microBfdDetection(silence);
+  }
+}
+
+} // namespace fboss
+} // namespace facebook
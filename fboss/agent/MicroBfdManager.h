@@ -0,0 +1,104 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#pragma once
+
+#include "fboss/agent/MicroBfdSession.h"
+#include "fboss/agent/StateObserver.h"
+#include "fboss/agent/types.h"
+
+#include <boost/container/flat_map.hpp>
+
+#include <folly/IPAddressV4.h>
+#include <folly/Optional.h>
+#include <folly/io/async/EventBase.h>
+
+#include <memory>
+#include <thread>
+
+namespace facebook {
+namespace fboss {
+
+class LinkAggregationManager;
+class RxPacket;
+class StateDelta;
+class SwSwitch;
+struct ParsedPacket;
+
+/*
+ * MicroBfdManager runs a micro-BFD (RFC 7130) session over every member port
+ * of the aggregate ports, to detect a member that stopped forwarding well
+ * within the 3s of LACP's short timeout.  A member whose session goes down
+ * is taken out of its aggregate port right away, and put back by LACP once
+ * the session is up again.
+ *
+ * The sessions run on their own thread, at a real-time priority, so that
+ * neither they nor the detection of a failure wait behind anything else.
+ *
+ * The packets are sent from the first IPv4 address of the interface of the
+ * member's VLAN, to the limited broadcast address until the peer's address
+ * is known from the packets it sends, as the peer's address isn't
+ * configured.  Those received are picked out by their destination MAC
+ * address, which is only used by micro-BFD.
+ */
+class MicroBfdManager : public AutoRegisterStateObserver,
+                        public MicroBfdServicerIf {
+ public:
+  MicroBfdManager(SwSwitch* sw, LinkAggregationManager* lagManager);
+  ~MicroBfdManager() override;
+
+  // Whether micro-BFD has been turned on with --micro_bfd_interval_ms
+  static bool isEnabled();
+
+  void stateUpdated(const StateDelta& delta) override;
+
+  // On the RX thread, for an IPv4 packet to kMicroBfdDstMac()
+  void handlePacket(std::unique_ptr<RxPacket> pkt, const ParsedPacket& parsed);
+
+  // The following methods implement the MicroBfdServicerIf interface
+  void transmit(PortID portID, const BfdControlPacket& pkt) override;
+  void sessionUp(PortID portID) override;
+  void sessionDown(
+      PortID portID,
+      BfdControlPacket::Diag diag,
+      std::chrono::milliseconds silence) override;
+
+ private:
+  struct Member {
+    AggregatePortID aggPortID{0};
+    VlanID vlan{0};
+    folly::Optional<folly::IPAddressV4> srcIp;
+  };
+  using PortIDToMember = boost::container::flat_map<PortID, Member>;
+  using PortIDToSession =
+      boost::container::flat_map<PortID, std::unique_ptr<MicroBfdSession>>;
+
+  // Start and stop sessions to match the members.  On the micro-BFD thread.
+  void updateMembers(PortIDToMember members);
+  void received(PortID portID, folly::IPAddressV4 srcIp, BfdControlPacket pkt);
+  uint32_t allocateDiscriminator() const;
+
+  // Forbidden copy constructor and assignment operator
+  MicroBfdManager(MicroBfdManager const&) = delete;
+  MicroBfdManager& operator=(MicroBfdManager const&) = delete;
+
+  SwSwitch* sw_{nullptr};
+  LinkAggregationManager* lagManager_{nullptr};
+
+  folly::EventBase evb_;
+  std::thread thread_;
+
+  // Only accessed on the micro-BFD thread
+  PortIDToMember members_;
+  PortIDToSession sessions_;
+  boost::container::flat_map<PortID, folly::IPAddressV4> peers_;
+};
+
+} // namespace fboss
+} // namespace facebook
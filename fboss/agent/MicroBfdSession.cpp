@@ -0,0 +1,207 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "fboss/agent/MicroBfdSession.h"
+
+#include <folly/Random.h>
+#include <folly/io/async/EventBase.h>
+#include <folly/logging/xlog.h>
+
+#include <algorithm>
+
+using std::chrono::duration_cast;
+using std::chrono::microseconds;
+using std::chrono::milliseconds;
+using std::chrono::steady_clock;
+
+namespace facebook {
+namespace fboss {
+
+MicroBfdSession::MicroBfdSession(
+    PortID portID,
+    folly::EventBase* evb,
+    MicroBfdServicerIf* servicer,
+    uint32_t localDiscriminator,
+    milliseconds interval,
+    uint8_t detectMult)
+    : portID_(portID),
+      evb_(evb),
+      servicer_(servicer),
+      localDiscriminator_(localDiscriminator),
+      interval_(interval),
+      detectMult_(detectMult) {
+  txTimeout_ = folly::AsyncTimeout::make(*evb_, [this]() noexcept {
+    transmit();
+    scheduleTransmit();
+  });
+  detectionTimeout_ = folly::AsyncTimeout::make(
+      *evb_, [this]() noexcept { detectionTimeExpired(); });
+}
+
+MicroBfdSession::~MicroBfdSession() {}
+
+void MicroBfdSession::start() {
+  CHECK(evb_->inRunningEventBaseThread());
+
+  transmit();
+  scheduleTransmit();
+}
+
+void MicroBfdSession::stop() {
+  CHECK(evb_->inRunningEventBaseThread());
+
+  txTimeout_->cancelTimeout();
+  detectionTimeout_->cancelTimeout();
+
+  state_ = State::ADMIN_DOWN;
+  diag_ = Diag::ADMIN_DOWN;
+  transmit();
+}
+
+void MicroBfdSession::received(const BfdControlPacket& pkt) {
+  CHECK(evb_->inRunningEventBaseThread());
+
+  XLOG(DBG5) << "MicroBfdSession[" << portID_ << "]: RX" << pkt.describe();
+
+  if (!pkt.isValid() ||
+      (pkt.yourDiscriminator != 0 &&
+       pkt.yourDiscriminator != localDiscriminator_)) {
+    XLOG(DBG4) << "MicroBfdSession[" << portID_ << "]: discarding "
+               << pkt.describe();
+    return;
+  }
+  if (state_ == State::ADMIN_DOWN) {
+    return;
+  }
+
+  lastReceived_ = steady_clock::now();
+  remoteDiscriminator_ = pkt.myDiscriminator;
+  remoteMinRxInterval_ = pkt.requiredMinRxInterval;
+  remoteDesiredMinTxInterval_ = pkt.desiredMinTxInterval;
+  remoteDetectMult_ = pkt.detectMult;
+
+  if (pkt.state == State::ADMIN_DOWN) {
+    if (state_ != State::DOWN) {
+      updateState(State::DOWN, Diag::NEIGHBOR_DOWN);
+    }
+  } else {
+    switch (state_) {
+      case State::DOWN:
+        if (pkt.state == State::DOWN) {
+          updateState(State::INIT, Diag::NONE);
+        } else if (pkt.state == State::INIT) {
+          updateState(State::UP, Diag::NONE);
+        }
+        break;
+      case State::INIT:
+        if (pkt.state == State::INIT || pkt.state == State::UP) {
+          updateState(State::UP, Diag::NONE);
+        }
+        break;
+      case State::UP:
+        if (pkt.state == State::DOWN) {
+          updateState(State::DOWN, Diag::NEIGHBOR_DOWN);
+        }
+        break;
+      case State::ADMIN_DOWN:
+        break;
+    }
+  }
+
+  if (pkt.hasFlag(BfdControlPacket::POLL)) {
+    transmit(BfdControlPacket::FINAL);
+  }
+
+  armDetectionTimer();
+}
+
+void MicroBfdSession::transmit(uint8_t flags) {
+  // The peer doesn't want any packets, for now (RFC 5880 6.8.7)
+  if (remoteMinRxInterval_.count() == 0 && state_ != State::ADMIN_DOWN) {
+    return;
+  }
+
+  BfdControlPacket pkt;
+  pkt.diag = diag_;
+  pkt.state = state_;
+  pkt.flags = flags;
+  pkt.detectMult = detectMult_;
+  pkt.myDiscriminator = localDiscriminator_;
+  pkt.yourDiscriminator = remoteDiscriminator_;
+  pkt.desiredMinTxInterval = interval_;
+  pkt.requiredMinRxInterval = interval_;
+
+  servicer_->transmit(portID_, pkt);
+}
+
+void MicroBfdSession::scheduleTransmit() {
+  auto interval = std::max<microseconds>(interval_, remoteMinRxInterval_);
+
+  // Between 75% and 100% of the interval, or 90% with a DetectMult of 1, so
+  // that the sessions don't all send together (RFC 5880 6.8.7)
+  auto us = interval.count();
+  auto longest = detectMult_ == 1 ? us * 9 / 10 : us;
+  auto jittered = longest - folly::Random::rand64(longest - us * 3 / 4 + 1);
+  auto timeout = duration_cast<milliseconds>(microseconds(jittered));
+
+  txTimeout_->scheduleTimeout(std::max(milliseconds(1), timeout));
+}
+
+void MicroBfdSession::armDetectionTimer() {
+  if (state_ == State::DOWN) {
+    detectionTimeout_->cancelTimeout();
+    return;
+  }
+
+  // The peer's DetectMult times the interval it sends at (RFC 5880 6.8.4)
+  auto interval =
+      std::max<microseconds>(interval_, remoteDesiredMinTxInterval_);
+  auto timeout = duration_cast<milliseconds>(remoteDetectMult_ * interval);
+
+  detectionTimeout_->scheduleTimeout(std::max(milliseconds(1), timeout));
+}
+
+void MicroBfdSession::detectionTimeExpired() {
+  if (state_ != State::INIT && state_ != State::UP) {
+    return;
+  }
+
+  XLOG(INFO) << "MicroBfdSession[" << portID_ << "]: nothing heard for "
+             << duration_cast<milliseconds>(
+                    steady_clock::now() - lastReceived_)
+                    .count()
+             << "ms";
+
+  remoteDiscriminator_ = 0;
+  updateState(State::DOWN, Diag::DETECTION_TIME_EXPIRED);
+}
+
+void MicroBfdSession::updateState(State nextState, Diag diag) {
+  auto prevState = state_;
+  state_ = nextState;
+  diag_ = diag;
+
+  XLOG(DBG2) << "MicroBfdSession[" << portID_ << "]: " << prevState << "-->"
+             << state_;
+
+  if (state_ == State::UP) {
+    servicer_->sessionUp(portID_);
+  } else if (prevState == State::UP) {
+    servicer_->sessionDown(
+        portID_,
+        diag_,
+        duration_cast<milliseconds>(steady_clock::now() - lastReceived_));
+  }
+
+  // Let the peer know straight away, rather than at the next interval
+  transmit();
+}
+
+} // namespace fboss
+} // namespace facebook
@@ -0,0 +1,113 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#pragma once
+
+#include <folly/io/async/AsyncTimeout.h>
+
+#include "fboss/agent/BfdTypes.h"
+#include "fboss/agent/types.h"
+
+#include <chrono>
+#include <memory>
+
+namespace folly {
+class EventBase;
+}
+
+namespace facebook {
+namespace fboss {
+
+struct MicroBfdServicerIf {
+  MicroBfdServicerIf() {}
+  virtual ~MicroBfdServicerIf() {}
+
+  virtual void transmit(PortID portID, const BfdControlPacket& pkt) = 0;
+  virtual void sessionUp(PortID portID) = 0;
+  // silence is the time since the last packet was received from the peer
+  virtual void sessionDown(
+      PortID portID,
+      BfdControlPacket::Diag diag,
+      std::chrono::milliseconds silence) = 0;
+};
+
+/*
+ * The micro-BFD (RFC 7130) session of one member port of an aggregate port,
+ * following the state machine of RFC 5880 6.8.6 in asynchronous mode.
+ *
+ * Both ends send and ask for packets every interval, which never changes,
+ * so there are no Poll Sequences of our own; a Poll from the peer gets a
+ * Final straight away.  Neither Demand mode nor the Echo function are
+ * supported.
+ *
+ * All of the methods must be called on the EventBase the session is on.
+ */
+class MicroBfdSession {
+ public:
+  MicroBfdSession(
+      PortID portID,
+      folly::EventBase* evb,
+      MicroBfdServicerIf* servicer,
+      uint32_t localDiscriminator,
+      std::chrono::milliseconds interval,
+      uint8_t detectMult);
+  ~MicroBfdSession();
+
+  void start();
+  // Tells the peer the session is going away, so it doesn't take it for a
+  // failure
+  void stop();
+
+  void received(const BfdControlPacket& pkt);
+
+  PortID portID() const {
+    return portID_;
+  }
+  uint32_t localDiscriminator() const {
+    return localDiscriminator_;
+  }
+  BfdControlPacket::State state() const {
+    return state_;
+  }
+
+ private:
+  using State = BfdControlPacket::State;
+  using Diag = BfdControlPacket::Diag;
+
+  void transmit(uint8_t flags = 0);
+  void scheduleTransmit();
+  void armDetectionTimer();
+  void detectionTimeExpired();
+  void updateState(State nextState, Diag diag);
+
+  // Forbidden copy constructor and assignment operator
+  MicroBfdSession(MicroBfdSession const&) = delete;
+  MicroBfdSession& operator=(MicroBfdSession const&) = delete;
+
+  const PortID portID_;
+  folly::EventBase* evb_{nullptr};
+  MicroBfdServicerIf* servicer_{nullptr};
+  const uint32_t localDiscriminator_{0};
+  const std::chrono::milliseconds interval_;
+  const uint8_t detectMult_{0};
+
+  State state_{State::DOWN};
+  Diag diag_{Diag::NONE};
+  uint32_t remoteDiscriminator_{0};
+  std::chrono::microseconds remoteMinRxInterval_{1};
+  std::chrono::microseconds remoteDesiredMinTxInterval_{0};
+  uint8_t remoteDetectMult_{0};
+  std::chrono::steady_clock::time_point lastReceived_;
+
+  std::unique_ptr<folly::AsyncTimeout> txTimeout_;
+  std::unique_ptr<folly::AsyncTimeout> detectionTimeout_;
+};
+
+} // namespace fboss
+} // namespace facebook
@@ -20,9 +20,10 @@
 
 namespace facebook { namespace fboss {
 
-NdpCache::NdpCache(SwSwitch* sw, const SwitchState* state,
-                   VlanID vlanID, std::string vlanName, InterfaceID intfID)
-    : NeighborCache<NdpTable>(sw, vlanID, vlanName, intfID,
+NdpCache::NdpCache(SwSwitch* sw, NeighborTimer* timer,
+                   const SwitchState* state, VlanID vlanID,
+                   std::string vlanName, InterfaceID intfID)
+    : NeighborCache<NdpTable>(sw, timer, vlanID, vlanName, intfID,
                               state->getNdpTimeout(),
                               state->getMaxNeighborProbes(),
                               state->getStaleEntryInterval()) {}
@@ -25,7 +25,7 @@ enum ICMPv6Type : uint8_t;
 
 class NdpCache : public NeighborCache<NdpTable> {
  public:
-  NdpCache(SwSwitch* sw, const SwitchState* state,
+  NdpCache(SwSwitch* sw, NeighborTimer* timer, const SwitchState* state,
            VlanID vlanID, std::string vlanName, InterfaceID intfID);
 
   void sentNeighborSolicitation(folly::IPAddressV6 ip);
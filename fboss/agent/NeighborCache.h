@@ -17,11 +17,13 @@
 #include <folly/IPAddress.h>
 #include <folly/MacAddress.h>
 #include <folly/Memory.h>
+#include <folly/futures/Future.h>
 #include <folly/io/async/EventBase.h>
 #include <folly/logging/xlog.h>
 #include <chrono>
 #include <list>
 #include <string>
+#include <vector>
 
 namespace facebook { namespace fboss {
 
@@ -86,11 +88,43 @@ class NeighborCache {
   }
 
   void clearEntries() {
-    impl_->clearEntries();
+    std::vector<folly::Future<folly::Unit>> stopTasks;
+    {
+      std::lock_guard<std::mutex> g(cacheLock_);
+      stopTasks = impl_->removeAllEntries();
+    }
+    // Wait without the lock, which the entries may be waiting for on the
+    // background thread
+    folly::collectAllSemiFuture(stopTasks).get();
+  }
+
+  /*
+   * Clear the entries and stop adding new ones, for a cache that is being
+   * retired.  As it holds no entries from then on, it can be destroyed on
+   * whichever thread drops the last reference to it.
+   */
+  void close() {
+    {
+      std::lock_guard<std::mutex> g(cacheLock_);
+      impl_->close();
+    }
+    clearEntries();
+  }
+
+  /*
+   * Mark the entries for the addresses the last hardware hit bit scan found
+   * hit.  From then on the entries rely on the scans instead of checking
+   * their own hit bits.
+   */
+  void entriesHit(const std::vector<AddressType>& ips) {
+    std::lock_guard<std::mutex> g(cacheLock_);
+    hitsScanned_ = true;
+    impl_->entriesHit(ips);
   }
  protected:
   // protected constructor since this is only meant to be inherited from
   NeighborCache(SwSwitch* sw,
+                NeighborTimer* timer,
                 VlanID vlanID,
                 std::string vlanName,
                 InterfaceID intfID,
@@ -98,6 +132,7 @@ class NeighborCache {
                 uint32_t maxNeighborProbes,
                 std::chrono::seconds staleEntryInterval)
       : sw_(sw),
+        timer_(timer),
         timeout_(timeout),
         maxNeighborProbes_(maxNeighborProbes),
         staleEntryInterval_(staleEntryInterval),
@@ -145,6 +180,10 @@ class NeighborCache {
     return sw_;
   }
 
+  NeighborTimer* getTimer() const {
+    return timer_;
+  }
+
   InterfaceID getIntfID() const {
     return impl_->getIntfID();
   }
@@ -169,6 +208,10 @@ class NeighborCache {
     return maxNeighborProbes_;
   }
 
+  bool hitsScanned() const {
+    return hitsScanned_;
+  }
+
 
  private:
   // This should only be called by a NeighborCacheEntry
@@ -196,11 +239,14 @@ class NeighborCache {
   NeighborCache& operator=(NeighborCache const &) = delete;
 
   SwSwitch* sw_;
+  NeighborTimer* timer_;
   std::chrono::seconds timeout_;
   uint32_t maxNeighborProbes_{0};
   std::chrono::seconds staleEntryInterval_;
   std::unique_ptr<NeighborCacheImpl<NTable>> impl_;
   std::mutex cacheLock_;
+  // Set, under cacheLock_, once the hardware reports hit bits in bulk
+  bool hitsScanned_{false};
 };
 
 }} // facebook::fboss
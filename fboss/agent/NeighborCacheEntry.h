@@ -10,16 +10,21 @@
 #pragma once
 
 #include "fboss/agent/AddressUtil.h"
+#include "fboss/agent/EventTrace.h"
 #include "fboss/agent/SwSwitch.h"
 #include "fboss/agent/FbossError.h"
+#include "fboss/agent/NeighborHitScanner.h"
+#include "fboss/agent/NeighborTimer.h"
 #include "fboss/agent/types.h"
 #include "fboss/agent/state/NeighborEntry.h"
 #include "fboss/agent/state/PortDescriptor.h"
 
+#include <algorithm>
 #include <chrono>
 #include <folly/MacAddress.h>
 #include <folly/IPAddress.h>
 #include <folly/Random.h>
+#include <folly/io/async/HHWheelTimer.h>
 
 /**
  * This class implements much of the neighbor resolution and unreachable
@@ -34,6 +39,9 @@
  *
  * STALE - neighbor entry was known to be valid, but has exceeded its lifetime.
  *         If the entry is being used, we will transition the entry to PROBE.
+ *         When the NeighborHitScanner reports the entry was used during its
+ *         lifetime, it is instead kept REACHABLE for another lifetime, up to
+ *         max_neighbor_hit_refreshes times before it is probed again.
  *
  * PROBE - The entry was once valid and became STALE. The entry is being used,
  *         so we are actively sending solicitations for this entry to confirm
@@ -52,9 +60,10 @@
  * UNINITIALIZED - Placeholder on startup.
  *
  * Once an entry is created, it is responsible for scheduling the timeout for
- * its next update. When that timeout expires, the state machine is run and the
- * next update is scheduled. If the entry ever transitions to the EXPIRED state,
- * we do not schedule another update and the cache will flush the entry.
+ * its next update on the NeighborTimer shared by all of the caches. When that
+ * timeout expires, the state machine is run and the next update is scheduled.
+ * If the entry ever transitions to the EXPIRED state, we do not schedule
+ * another update and the cache will flush the entry.
  *
  * There is no locking in this class. Instead, the class relies on the
  * synchronization provided by NeighborCache, which should lock around all calls
@@ -78,7 +87,7 @@ enum class NeighborEntryState : uint8_t {
 template <typename NTable> class NeighborCache;
 
 template <typename NTable>
-class NeighborCacheEntry : private folly::AsyncTimeout {
+class NeighborCacheEntry : private folly::HHWheelTimer::Callback {
  public:
   typedef typename NTable::Entry::AddressType AddressType;
   typedef NeighborCache<NTable> Cache;
@@ -88,8 +97,7 @@ class NeighborCacheEntry : private folly::AsyncTimeout {
                      folly::EventBase* evb,
                      Cache* cache,
                      NeighborEntryState state)
-      : AsyncTimeout(evb),
-        fields_(fields),
+      : fields_(fields),
         cache_(cache),
         evb_(evb),
         probesLeft_(cache_->getMaxNeighborProbes()) {
@@ -199,6 +207,11 @@ class NeighborCacheEntry : private folly::AsyncTimeout {
     enter(NeighborEntryState::STALE);
   }
 
+  // The hardware saw traffic to the entry in its last hit bit scan
+  void setHit() {
+    hit_ = true;
+  }
+
   bool isProbing() const {
     return state_ == NeighborEntryState::PROBE ||
       state_ == NeighborEntryState::INCOMPLETE;
@@ -222,29 +235,39 @@ class NeighborCacheEntry : private folly::AsyncTimeout {
    * races.
    */
   void timeoutExpired() noexcept override {
+    cache_->getTimer()->expiring();
     cache_->processEntry(getIP());
   }
 
+  // The entries are only cancelled when they are destroyed
+  void callbackCanceled() noexcept override {}
+
   /*
    * Schedules an update on the evb_. This is done synchronously so that we
    * can have a destructor guard around both running the state machine and
    * scheduling the next update in timeoutExpired.
+   *
+   * The stale and probe intervals are jittered, so that entries that went
+   * stale or started probing together don't all probe in the same tick.
    */
   void scheduleNextUpdate() {
     CHECK(evb_->inRunningEventBaseThread());
+    auto* timer = cache_->getTimer();
     std::chrono::milliseconds lifetime;
     switch (state_) {
       case NeighborEntryState::REACHABLE:
         lifetime = calculateLifetime();
         expireTime_ = std::chrono::steady_clock::now() + lifetime;
-        scheduleTimeout(lifetime);
+        timer->scheduleTimeout(this, lifetime);
         break;
       case NeighborEntryState::STALE:
-        scheduleTimeout(std::chrono::seconds(cache_->getStaleEntryInterval()));
+        timer->scheduleTimeout(this, NeighborTimer::jitter(
+            std::chrono::seconds(cache_->getStaleEntryInterval())));
         break;
       case NeighborEntryState::PROBE:
       case NeighborEntryState::INCOMPLETE:
-        scheduleTimeout(std::chrono::seconds(1));
+        timer->scheduleTimeout(
+            this, NeighborTimer::jitter(std::chrono::seconds(1)));
         break;
       case NeighborEntryState::EXPIRED:
         // This entry is expired and is already flushed. Don't schedule a
@@ -276,13 +299,22 @@ class NeighborCacheEntry : private folly::AsyncTimeout {
     return probesLeft_ > 0;
   }
 
+  void setState(NeighborEntryState state) {
+    state_ = state;
+    EventTrace::record(
+        EventTrace::Event::NEIGHBOR_STATE,
+        static_cast<uint32_t>(cache_->getVlanID()) << 8 |
+            static_cast<uint32_t>(state),
+        EventTrace::addressArg(getIP()));
+  }
+
   /*
    * Entry function for the state machine. Should only be called when we
    * first create an entry. Handles a few special cases and makes sure
    * we don't create entries in unexpected states.
    */
   void enter(NeighborEntryState state) {
-    state_ = state;
+    setState(state);
     switch (state) {
       case NeighborEntryState::INCOMPLETE:
         // We have already sent out a solictation for this so decrement
@@ -291,6 +323,7 @@ class NeighborCacheEntry : private folly::AsyncTimeout {
         break;
       case NeighborEntryState::REACHABLE:
         probesLeft_ = cache_->getMaxNeighborProbes();
+        hitRefreshesLeft_ = std::max(FLAGS_max_neighbor_hit_refreshes, 0);
         break;
       case NeighborEntryState::STALE:
         // For STALE entries, we might as well run the state machine right away.
@@ -315,14 +348,39 @@ class NeighborCacheEntry : private folly::AsyncTimeout {
       cache_->probeFor(getIP());
       --probesLeft_;
     } else {
-      state_ = NeighborEntryState::EXPIRED;
+      setState(NeighborEntryState::EXPIRED);
+    }
+  }
+
+  /*
+   * Whether the entry was hit since this was last called.  Once the cache
+   * gets bulk hit bit scans, those are used instead of asking the hardware
+   * about this entry alone.
+   */
+  bool getAndClearHit() {
+    if (!cache_->hitsScanned()) {
+      return cache_->isHit(getIP());
+    }
+    auto hit = hit_;
+    hit_ = false;
+    return hit;
+  }
+
+  bool refreshIfHit() {
+    DCHECK(state_ == NeighborEntryState::REACHABLE);
+    if (!cache_->hitsScanned() || hitRefreshesLeft_ == 0 ||
+        !getAndClearHit()) {
+      return false;
     }
+    --hitRefreshesLeft_;
+    cache_->getSw()->stats()->neighborHitRefresh();
+    return true;
   }
 
   void probeStaleEntryIfHit() {
     DCHECK(state_ == NeighborEntryState::STALE);
-    if (cache_->isHit(getIP())) {
-      state_ = NeighborEntryState::PROBE;
+    if (getAndClearHit()) {
+      setState(NeighborEntryState::PROBE);
       probeIfProbesLeft();
     }
   }
@@ -341,8 +399,13 @@ class NeighborCacheEntry : private folly::AsyncTimeout {
         probeStaleEntryIfHit();
         break;
       case NeighborEntryState::REACHABLE:
-        // If we are processing a REACHABLE entry, it must have become stale,
-        state_ = NeighborEntryState::STALE;
+        // If we are processing a REACHABLE entry, its lifetime is over.  It
+        // stays REACHABLE if it is still being forwarded to, otherwise it
+        // becomes stale.
+        if (refreshIfHit()) {
+          break;
+        }
+        setState(NeighborEntryState::STALE);
         probeStaleEntryIfHit();
         break;
       case NeighborEntryState::EXPIRED:
@@ -396,6 +459,9 @@ class NeighborCacheEntry : private folly::AsyncTimeout {
   folly::EventBase* evb_;
   NeighborEntryState state_{NeighborEntryState::UNINITIALIZED};
   uint8_t probesLeft_{0};
+  // Lifetimes the entry may still be refreshed for by hits, without a reply
+  uint32_t hitRefreshesLeft_{0};
+  bool hit_{false};
   std::chrono::time_point<std::chrono::steady_clock> expireTime_;
 };
 
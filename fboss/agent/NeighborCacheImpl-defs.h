@@ -15,6 +15,7 @@
 #include <folly/io/async/EventBase.h>
 #include <folly/logging/xlog.h>
 #include <list>
+#include <mutex>
 #include "fboss/agent/ArpHandler.h"
 #include "fboss/agent/IPv6Handler.h"
 #include "fboss/agent/NeighborCacheImpl.h"
@@ -61,87 +62,159 @@ bool checkVlanAndIntf(
 }
 
 template <typename NTable>
-void NeighborCacheImpl<NTable>::programEntry(Entry* entry) {
-  CHECK(!entry->isPending());
+bool NeighborCacheImpl<NTable>::applyEntry(
+    std::shared_ptr<SwitchState>* state,
+    const EntryFields& fields,
+    VlanID vlanID) {
+  if (!ncachehelpers::checkVlanAndIntf<NTable>(*state, fields, vlanID)) {
+    // Either the vlan or intf is no longer valid.
+    return false;
+  }
 
-  auto fields = entry->getFields();
-  auto vlanID = vlanID_;
-  auto updateFn = [fields, vlanID](const std::shared_ptr<SwitchState>& state)
-      -> std::shared_ptr<SwitchState> {
-    if (!ncachehelpers::checkVlanAndIntf<NTable>(state, fields, vlanID)) {
-      // Either the vlan or intf is no longer valid.
-      return nullptr;
+  auto vlan = (*state)->getVlans()->getVlanIf(vlanID).get();
+  auto* table = vlan->template getNeighborTable<NTable>().get();
+  auto node = table->getNodeIf(fields.ip);
+
+  if (!node) {
+    table = table->modify(&vlan, state);
+    table->addEntry(fields);
+    XLOG(DBG2) << "Adding entry for " << fields.ip << " --> " << fields.mac;
+  } else {
+    if (node->getMac() == fields.mac &&
+        node->getPort() == fields.port &&
+        node->getIntfID() == fields.interfaceID &&
+        node->getState() == fields.state &&
+        !node->isPending()) {
+      // This entry was already updated while we were waiting on the lock.
+      return false;
     }
+    table = table->modify(&vlan, state);
+    table->updateEntry(fields);
+    XLOG(DBG2) << "Converting pending entry for " << fields.ip << " --> "
+               << fields.mac;
+  }
+  return true;
+}
 
-    auto vlan = state->getVlans()->getVlanIf(vlanID).get();
-    std::shared_ptr<SwitchState> newState{state};
-    auto* table = vlan->template getNeighborTable<NTable>().get();
-    auto node = table->getNodeIf(fields.ip);
-
-    if (!node) {
-      table = table->modify(&vlan, &newState);
-      table->addEntry(fields);
-      XLOG(DBG2) << "Adding entry for " << fields.ip << " --> " << fields.mac;
-    } else {
-      if (node->getMac() == fields.mac &&
-          node->getPort() == fields.port &&
-          node->getIntfID() == fields.interfaceID &&
-          node->getState() == fields.state &&
-          !node->isPending()) {
-        // This entry was already updated while we were waiting on the lock.
-        return nullptr;
-      }
-      table = table->modify(&vlan, &newState);
-      table->updateEntry(fields);
-      XLOG(DBG2) << "Converting pending entry for " << fields.ip << " --> "
-                 << fields.mac;
+template <typename NTable>
+bool NeighborCacheImpl<NTable>::applyPendingEntry(
+    std::shared_ptr<SwitchState>* state,
+    const EntryFields& fields,
+    VlanID vlanID,
+    bool force) {
+  if (!ncachehelpers::checkVlanAndIntf<NTable>(*state, fields, vlanID)) {
+    // Either the vlan or intf is no longer valid.
+    return false;
+  }
+
+  auto vlan = (*state)->getVlans()->getVlanIf(vlanID).get();
+  auto* table = vlan->template getNeighborTable<NTable>().get();
+  auto node = table->getNodeIf(fields.ip);
+
+  if (node) {
+    if (!force) {
+      // don't replace an existing entry with a pending one unless
+      // explicitly allowed
+      return false;
     }
-    return newState;
-  };
+    table = table->modify(&vlan, state);
+    table->removeEntry(fields.ip);
+  } else {
+    table = table->modify(&vlan, state);
+  }
+  table->addPendingEntry(fields.ip, fields.interfaceID);
 
-  sw_->updateState(folly::to<std::string>("add neighbor ", fields.ip),
-                   std::move(updateFn));
+  XLOG(DBG4) << "Adding pending entry for " << fields.ip << " on interface "
+             << fields.interfaceID;
+  return true;
 }
 
-
 template <typename NTable>
-void NeighborCacheImpl<NTable>::programPendingEntry(Entry* entry, bool force) {
-  CHECK(entry->isPending());
+void NeighborCacheImpl<NTable>::queueChange(
+    const EntryFields& fields, bool pending, bool force) {
+  auto changes = pendingChanges_;
+  if (changes) {
+    std::lock_guard<std::mutex> guard(changes->lock);
+    if (!changes->sealed && changes->pending == pending) {
+      auto it = changes->index.find(fields.ip);
+      if (it == changes->index.end()) {
+        changes->index.emplace(fields.ip, changes->changes.size());
+        changes->changes.push_back(Change{fields, force});
+      } else {
+        // Only the latest change to an entry needs to be applied
+        auto& change = changes->changes[it->second];
+        change.fields = fields;
+        change.force = change.force || force;
+      }
+      return;
+    }
+  }
+
+  changes = std::make_shared<PendingChanges>(pending);
+  changes->index.emplace(fields.ip, 0);
+  changes->changes.push_back(Change{fields, force});
+  pendingChanges_ = changes;
 
-  auto fields = entry->getFields();
   auto vlanID = vlanID_;
-  auto updateFn = [fields, vlanID, force](
-    const std::shared_ptr<SwitchState>& state)
+  auto updateFn = [changes, vlanID](const std::shared_ptr<SwitchState>& state)
       -> std::shared_ptr<SwitchState> {
-    if (!ncachehelpers::checkVlanAndIntf<NTable>(state, fields, vlanID)) {
-      // Either the vlan or intf is no longer valid.
-      return nullptr;
+    std::vector<Change> toApply;
+    {
+      std::lock_guard<std::mutex> guard(changes->lock);
+      changes->sealed = true;
+      toApply.swap(changes->changes);
     }
 
-    auto vlan = state->getVlans()->getVlanIf(vlanID).get();
     std::shared_ptr<SwitchState> newState{state};
-    auto* table = vlan->template getNeighborTable<NTable>().get();
-    auto node = table->getNodeIf(fields.ip);
-    table = table->modify(&vlan, &newState);
-
-    if (node) {
-      if (!force) {
-        // don't replace an existing entry with a pending one unless
-        // explicitly allowed
-        return nullptr;
+    bool changed = false;
+    for (const auto& change : toApply) {
+      if (changes->pending) {
+        changed |= applyPendingEntry(
+            &newState, change.fields, vlanID, change.force);
+      } else {
+        changed |= applyEntry(&newState, change.fields, vlanID);
       }
-      table->removeEntry(fields.ip);
     }
-    table->addPendingEntry(fields.ip, fields.interfaceID);
-
-    XLOG(DBG4) << "Adding pending entry for " << fields.ip << " on interface "
-               << fields.interfaceID;
-    return newState;
+    return changed ? newState : nullptr;
   };
 
-  sw_->updateStateNoCoalescing(
-    folly::to<std::string>("add pending entry ", fields.ip),
-    std::move(updateFn));
+  if (pending) {
+    // Each pending entry must reach the hardware, so that traffic to it is
+    // trapped to the CPU, even if its resolution is applied right after.
+    sw_->updateStateNoCoalescing(
+        folly::to<std::string>("add pending entries from ", fields.ip),
+        std::move(updateFn),
+        StateUpdateClass::NEIGHBOR);
+  } else {
+    sw_->updateState(
+        folly::to<std::string>("add neighbors from ", fields.ip),
+        std::move(updateFn),
+        StateUpdateClass::NEIGHBOR);
+  }
+}
+
+template <typename NTable>
+void NeighborCacheImpl<NTable>::sealPendingChanges() {
+  if (!pendingChanges_) {
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> guard(pendingChanges_->lock);
+    pendingChanges_->sealed = true;
+  }
+  pendingChanges_.reset();
+}
+
+template <typename NTable>
+void NeighborCacheImpl<NTable>::programEntry(Entry* entry) {
+  CHECK(!entry->isPending());
+  queueChange(entry->getFields(), false, false);
+}
+
+template <typename NTable>
+void NeighborCacheImpl<NTable>::programPendingEntry(Entry* entry, bool force) {
+  CHECK(entry->isPending());
+  queueChange(entry->getFields(), true, force);
 }
 
 template <typename NTable>
@@ -157,6 +230,12 @@ void NeighborCacheImpl<NTable>::clearEntries() {
    * executing, we use folly futures to wait for all entries
    * to destroy themselves.
    */
+  folly::collectAllSemiFuture(removeAllEntries()).get();
+}
+
+template <typename NTable>
+std::vector<folly::Future<folly::Unit>>
+NeighborCacheImpl<NTable>::removeAllEntries() {
   std::vector<folly::Future<folly::Unit>> stopTasks;
   for (const auto& item : entries_) {
     auto addr = item.first;
@@ -168,8 +247,21 @@ void NeighborCacheImpl<NTable>::clearEntries() {
                           << addr;
             }));
   }
-  folly::collectAllSemiFuture(stopTasks).get();
   entries_.clear();
+  portEntries_.clear();
+  updateMemoryAccount();
+  return stopTasks;
+}
+
+template <typename NTable>
+void NeighborCacheImpl<NTable>::entriesHit(
+    const std::vector<AddressType>& ips) {
+  for (const auto& ip : ips) {
+    auto entry = getCacheEntry(ip);
+    if (entry) {
+      entry->setHit();
+    }
+  }
 }
 
 template <typename NTable>
@@ -225,11 +317,15 @@ NeighborCacheEntry<NTable>* NeighborCacheImpl<NTable>::setEntryInternal(
   if (entry) {
     auto changed = !entry->fieldsMatch(fields);
     if (changed) {
+      if (entry->getPort() != fields.port) {
+        unindexEntry(fields.ip, entry->getPort());
+        indexEntry(fields.ip, fields.port);
+      }
       entry->updateFields(fields);
     }
     entry->updateState(state);
     return changed ? entry : nullptr;
-  } else if (add) {
+  } else if (add && !closed_) {
     auto evb = sw_->getBackgroundEvb();
     auto to_store = std::make_shared<Entry>(fields, evb, cache_, state);
     entry = to_store.get();
@@ -279,7 +375,32 @@ NeighborCacheEntry<NTable>* NeighborCacheImpl<NTable>::getCacheEntry(
 template <typename NTable>
 void NeighborCacheImpl<NTable>::setCacheEntry(std::shared_ptr<Entry> entry) {
   const auto& ip = entry->getIP();
-  entries_[ip] = std::move(entry);
+  auto& stored = entries_[ip];
+  if (stored) {
+    unindexEntry(ip, stored->getPort());
+  }
+  indexEntry(ip, entry->getPort());
+  stored = std::move(entry);
+  updateMemoryAccount();
+}
+
+template <typename NTable>
+void NeighborCacheImpl<NTable>::indexEntry(AddressType ip,
+                                           PortDescriptor port) {
+  portEntries_[port].insert(ip);
+}
+
+template <typename NTable>
+void NeighborCacheImpl<NTable>::unindexEntry(AddressType ip,
+                                             PortDescriptor port) {
+  auto it = portEntries_.find(port);
+  if (it == portEntries_.end()) {
+    return;
+  }
+  it->second.erase(ip);
+  if (it->second.empty()) {
+    portEntries_.erase(it);
+  }
 }
 
 template <typename NTable>
@@ -294,13 +415,25 @@ bool NeighborCacheImpl<NTable>::removeEntry(AddressType ip) {
   // likely have the cache level lock here and the background thread could be
   // waiting for the lock. To avoid this deadlock scenario, we keep the entry
   // around in a shared_ptr for a bit longer and then destroy it later.
+  unindexEntry(ip, it->second->getPort());
   Entry::destroy(std::move(it->second), sw_->getBackgroundEvb());
 
   entries_.erase(it);
+  updateMemoryAccount();
 
   return true;
 }
 
+template <typename NTable>
+void NeighborCacheImpl<NTable>::updateMemoryAccount() {
+  // Each address is also in the set of its port
+  auto bytes = containerMemoryBytes(entries_) +
+      entries_.bucket_count() * sizeof(void*) +
+      entries_.size() * sizeof(Entry) + containerMemoryBytes(portEntries_) +
+      entries_.size() * (sizeof(AddressType) + 2 * sizeof(void*));
+  memoryAccount_.set(bytes);
+}
+
 template <typename NTable>
 bool NeighborCacheImpl<NTable>::flushEntryFromSwitchState(
     std::shared_ptr<SwitchState>* state, AddressType ip) {
@@ -329,6 +462,8 @@ void NeighborCacheImpl<NTable>::flushEntry(AddressType ip, bool* flushed) {
   if (!removeEntry(ip)) {
     return;
   }
+  // Changes made after this must be applied after the flush
+  sealPendingChanges();
 
   // flush from SwitchState
   auto updateFn =
@@ -347,9 +482,15 @@ void NeighborCacheImpl<NTable>::flushEntry(AddressType ip, bool* flushed) {
   if (flushed) {
     // need a blocking state update if the caller wants to know if an entry
     // was actually flushed
-    sw_->updateStateBlocking("flush neighbor entry", std::move(updateFn));
+    sw_->updateStateBlocking(
+        "flush neighbor entry",
+        std::move(updateFn),
+        StateUpdateClass::NEIGHBOR);
   } else {
-    sw_->updateState("remove neighbor entry", std::move(updateFn));
+    sw_->updateState(
+        "remove neighbor entry",
+        std::move(updateFn),
+        StateUpdateClass::NEIGHBOR);
   }
 }
 
@@ -365,11 +506,13 @@ NeighborCacheImpl<NTable>::cloneEntryFields(AddressType ip) {
 
 template <typename NTable>
 void NeighborCacheImpl<NTable>::portDown(PortDescriptor port) {
-  for (auto item : entries_) {
-    if (item.second->getPort() != port) {
-      continue;
-    }
-
+  auto it = portEntries_.find(port);
+  if (it == portEntries_.end()) {
+    return;
+  }
+  // Copied, as making the entries pending moves them off of the port
+  auto ips = it->second;
+  for (const auto& ip : ips) {
     // TODO(aeckert): It would be nicer if we could just mark this
     // entry stale on port down so we don't need to unprogram the
     // entry (for fast port flaps).  However, we have seen packet
@@ -378,7 +521,7 @@ void NeighborCacheImpl<NTable>::portDown(PortDescriptor port) {
     // programmed. Also we need to notify the HwSwitch for ECMP expand
     // when the port comes back up and changing an entry from pending
     // to reachable is how we currently do this.
-    setPendingEntry(item.second->getIP(), true);
+    setPendingEntry(ip, true);
   }
 }
 
@@ -11,6 +11,7 @@
 
 #include "fboss/agent/SwSwitch.h"
 #include "fboss/agent/FbossError.h"
+#include "fboss/agent/MemoryAccount.h"
 #include "fboss/agent/types.h"
 #include "fboss/agent/NeighborCacheEntry.h"
 #include "fboss/agent/state/NeighborEntry.h"
@@ -20,8 +21,15 @@
 #include <folly/MacAddress.h>
 #include <folly/IPAddress.h>
 #include <folly/Random.h>
+#include <folly/futures/Future.h>
 #include <list>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
 
 namespace facebook { namespace fboss {
 
@@ -115,11 +123,60 @@ class NeighborCacheImpl {
   std::list<NeighborEntryThrift> getCacheData() const;
 
   void clearEntries();
+
+  /*
+   * Removes all of the entries, and returns the futures of them stopping
+   * on the background thread, so that the caller can wait for those
+   * without holding the cache lock.
+   */
+  std::vector<folly::Future<folly::Unit>> removeAllEntries();
+
+  // From now on, don't add any entries
+  void close() {
+    closed_ = true;
+  }
+
+  void entriesHit(const std::vector<AddressType>& ips);
  private:
   // These are used to program entries into the SwitchState
   void programEntry(Entry* entry);
   void programPendingEntry(Entry* entry, bool force = false);
 
+  /*
+   * The entries programmed are not each applied by a state update of their
+   * own, which would clone the neighbor table every time.  They are added to
+   * pendingChanges_ instead, and all applied by the one state update queued
+   * with the first of them, which SwSwitch may also hold for its coalescing
+   * window during a neighbor storm.
+   *
+   * Changes are kept in order, and a new batch is started whenever the kind
+   * of change switches between pending and resolved, or an entry is flushed,
+   * so they are applied in the same order as before.
+   */
+  struct Change {
+    EntryFields fields;
+    bool force;
+  };
+  struct PendingChanges {
+    explicit PendingChanges(bool pending) : pending(pending) {}
+
+    std::mutex lock;
+    // Set once the state update took the changes, or a later one is needed
+    bool sealed{false};
+    const bool pending;
+    std::vector<Change> changes;
+    std::unordered_map<AddressType, size_t> index;
+  };
+  void queueChange(const EntryFields& fields, bool pending, bool force);
+  void sealPendingChanges();
+  static bool applyEntry(std::shared_ptr<SwitchState>* state,
+                         const EntryFields& fields,
+                         VlanID vlanID);
+  static bool applyPendingEntry(std::shared_ptr<SwitchState>* state,
+                                const EntryFields& fields,
+                                VlanID vlanID,
+                                bool force);
+
   void processEntry(AddressType ip);
 
   // Pass in a non-null flushed if you care whether an entry
@@ -132,6 +189,10 @@ class NeighborCacheImpl {
   Entry* getCacheEntry(AddressType ip) const;
   void setCacheEntry(std::shared_ptr<Entry> entry);
   bool removeEntry(AddressType ip);
+  void indexEntry(AddressType ip, PortDescriptor port);
+  void unindexEntry(AddressType ip, PortDescriptor port);
+  // Set memoryAccount_ from the number of entries
+  void updateMemoryAccount();
 
   Entry* setEntryInternal(const EntryFields& fields,
                           NeighborEntryState state,
@@ -146,9 +207,21 @@ class NeighborCacheImpl {
   VlanID vlanID_;
   std::string vlanName_;
   InterfaceID intfID_;
+  // Set once the cache is retired, after which no entry is added to it
+  bool closed_{false};
 
   // Map of all entries
   std::unordered_map<AddressType, std::shared_ptr<Entry>> entries_;
+  // The addresses of the entries on each port, so that portDown() only
+  // visits the entries it changes
+  std::unordered_map<PortDescriptor, std::unordered_set<AddressType>>
+      portEntries_;
+  // The batch the entries programmed are added to, if it is still open
+  std::shared_ptr<PendingChanges> pendingChanges_;
+  MemoryAccount memoryAccount_{
+      std::is_same<AddressType, folly::IPAddressV4>::value
+          ? "neighbor_cache.arp"
+          : "neighbor_cache.ndp"};
 };
 
 }} // facebook::fboss
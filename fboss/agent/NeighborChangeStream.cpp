@@ -0,0 +1,153 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "fboss/agent/NeighborChangeStream.h"
+
+#include "fboss/agent/AddressUtil.h"
+
+#include <folly/io/async/EventBase.h>
+
+#include <algorithm>
+
+DEFINE_int32(neighbor_change_coalesce_ms, 100,
+             "How long to coalesce neighbor changes for before publishing "
+             "them to the change stream listeners");
+DEFINE_int32(max_neighbor_change_batches_in_flight, 2,
+             "How many neighbor change batches a change stream listener can "
+             "have outstanding before the rest are merged into its backlog");
+DEFINE_int32(max_neighbor_change_backlog, 50000,
+             "How many neighbor changes a change stream listener can fall "
+             "behind by before they are dropped and it is told to resync");
+
+using facebook::network::toBinaryAddress;
+using facebook::network::toIPAddress;
+
+namespace facebook { namespace fboss {
+
+NeighborChangeStream::NeighborChangeStream(
+    folly::EventBase* evb, std::function<void(Batch)> publish)
+    : AsyncTimeout(evb),
+      evb_(evb),
+      publish_(std::move(publish)) {}
+
+NeighborChangeStream::~NeighborChangeStream() {
+  evb_->runImmediatelyOrRunInEventBaseThreadAndWait([this]() {
+    cancelTimeout();
+  });
+}
+
+void NeighborChangeStream::neighborsChanged(
+    const std::vector<folly::IPAddress>& added,
+    const std::vector<folly::IPAddress>& removed) {
+  bool schedule;
+  {
+    std::lock_guard<std::mutex> g(lock_);
+    for (const auto& ip : added) {
+      pending_[ip] = true;
+    }
+    for (const auto& ip : removed) {
+      pending_[ip] = false;
+    }
+    schedule = !scheduled_;
+    scheduled_ = true;
+  }
+  if (schedule) {
+    evb_->runInEventBaseThread([this]() {
+      scheduleTimeout(FLAGS_neighbor_change_coalesce_ms);
+    });
+  }
+}
+
+void NeighborChangeStream::timeoutExpired() noexcept {
+  Changes changes;
+  {
+    std::lock_guard<std::mutex> g(lock_);
+    changes.swap(pending_);
+    scheduled_ = false;
+  }
+  if (changes.empty()) {
+    return;
+  }
+  // Batches are only published from this thread
+  auto sequence = sequence_.load(std::memory_order_relaxed) + 1;
+  auto batch = makeBatch(sequence, changes);
+  sequence_.store(sequence, std::memory_order_release);
+  publish_(std::move(batch));
+}
+
+void NeighborChangeStream::merge(
+    const NeighborChangesThrift& batch, Changes* changes) {
+  for (const auto& addr : batch.added) {
+    (*changes)[toIPAddress(addr)] = true;
+  }
+  for (const auto& addr : batch.removed) {
+    (*changes)[toIPAddress(addr)] = false;
+  }
+}
+
+NeighborChangeStream::Batch NeighborChangeStream::makeBatch(
+    int64_t sequence, const Changes& changes, bool resync) {
+  auto batch = std::make_shared<NeighborChangesThrift>();
+  batch->sequence = sequence;
+  batch->resync = resync;
+  for (const auto& change : changes) {
+    if (change.second) {
+      batch->added.push_back(toBinaryAddress(change.first));
+    } else {
+      batch->removed.push_back(toBinaryAddress(change.first));
+    }
+  }
+  return batch;
+}
+
+NeighborChangeBacklog::Batch NeighborChangeBacklog::published(Batch batch) {
+  publishedSequence_ = batch->sequence;
+  if (backlog_.empty() && !resync_ && hasRoom()) {
+    ++inFlight_;
+    return batch;
+  }
+  if (!resync_) {
+    NeighborChangeStream::merge(*batch, &backlog_);
+  } else {
+    // The listener is going to refetch everything anyway
+    dropped_ += batch->added.size() + batch->removed.size();
+  }
+  if (backlog_.size() > size_t(FLAGS_max_neighbor_change_backlog)) {
+    dropped_ += backlog_.size();
+    backlog_.clear();
+    resync_ = true;
+  }
+  return hasRoom() ? takeBacklog() : nullptr;
+}
+
+NeighborChangeBacklog::Batch NeighborChangeBacklog::acked(int64_t sequence) {
+  if (inFlight_ > 0) {
+    --inFlight_;
+  }
+  ackedSequence_ = std::max(ackedSequence_, sequence);
+  if ((backlog_.empty() && !resync_) || !hasRoom()) {
+    return nullptr;
+  }
+  return takeBacklog();
+}
+
+bool NeighborChangeBacklog::hasRoom() const {
+  return inFlight_ < size_t(FLAGS_max_neighbor_change_batches_in_flight);
+}
+
+NeighborChangeBacklog::Batch NeighborChangeBacklog::takeBacklog() {
+  ++inFlight_;
+  auto batch = NeighborChangeStream::makeBatch(
+      publishedSequence_, backlog_, resync_);
+  backlog_.clear();
+  resync_ = false;
+  return batch;
+}
+
+}} // facebook::fboss
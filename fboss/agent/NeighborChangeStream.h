@@ -0,0 +1,144 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#pragma once
+
+#include "fboss/agent/if/gen-cpp2/ctrl_types.h"
+
+#include <folly/IPAddress.h>
+#include <folly/io/async/AsyncTimeout.h>
+#include <gflags/gflags.h>
+
+#include <atomic>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+DECLARE_int32(neighbor_change_coalesce_ms);
+DECLARE_int32(max_neighbor_change_batches_in_flight);
+DECLARE_int32(max_neighbor_change_backlog);
+
+namespace facebook { namespace fboss {
+
+/*
+ * NeighborChangeStream coalesces the neighbors coming and going into
+ * numbered batches for the change stream listeners.
+ *
+ * During a neighbor storm the changes arrive from the update thread far
+ * faster than it is worth sending them individually, so they are merged for
+ * neighbor_change_coalesce_ms, keeping only the latest state of each
+ * address, and then published on the background thread as a single batch.
+ * Each batch is built once, with binary addresses, and shared by all of the
+ * listeners.
+ */
+class NeighborChangeStream : private folly::AsyncTimeout {
+ public:
+  using Batch = std::shared_ptr<const NeighborChangesThrift>;
+  // The latest state of each address changed, true if it became reachable
+  using Changes = std::map<folly::IPAddress, bool>;
+
+  NeighborChangeStream(
+      folly::EventBase* evb, std::function<void(Batch)> publish);
+  ~NeighborChangeStream() override;
+
+  /*
+   * Queue changes to be published with the next batch.  Can be called from
+   * any thread.
+   */
+  void neighborsChanged(const std::vector<folly::IPAddress>& added,
+                        const std::vector<folly::IPAddress>& removed);
+
+  /*
+   * The sequence number of the last batch published.  Can be called from
+   * any thread.
+   */
+  int64_t getSequence() const {
+    return sequence_.load(std::memory_order_acquire);
+  }
+
+  static void merge(const NeighborChangesThrift& batch, Changes* changes);
+  static Batch makeBatch(int64_t sequence, const Changes& changes,
+                         bool resync = false);
+
+ private:
+  void timeoutExpired() noexcept override;
+
+  // Forbidden copy constructor and assignment operator
+  NeighborChangeStream(NeighborChangeStream const &) = delete;
+  NeighborChangeStream& operator=(NeighborChangeStream const &) = delete;
+
+  folly::EventBase* evb_{nullptr};
+  std::function<void(Batch)> publish_;
+  std::mutex lock_;
+  Changes pending_;
+  bool scheduled_{false};
+  std::atomic<int64_t> sequence_{0};
+};
+
+/*
+ * The flow control for a single change stream listener.
+ *
+ * No more than max_neighbor_change_batches_in_flight batches are sent to a
+ * listener before it acknowledges them.  The batches published meanwhile are
+ * merged into its backlog, which goes out as one batch as soon as there is
+ * room.  A listener that falls so far behind that its backlog grows past
+ * max_neighbor_change_backlog addresses has the backlog dropped, and is sent
+ * an empty batch asking it to resync instead.
+ *
+ * Not thread safe, it is only used on the thread of its listener.
+ */
+class NeighborChangeBacklog {
+ public:
+  using Batch = NeighborChangeStream::Batch;
+
+  /*
+   * Called with each batch published.  Return the batch to send to the
+   * listener now, or null if it is to wait in the backlog.
+   */
+  Batch published(Batch batch);
+
+  /*
+   * Called when the listener acknowledges a batch.  Return the backlog to
+   * send to it now, or null.
+   */
+  Batch acked(int64_t sequence);
+
+  /*
+   * The number of batches published that the listener hasn't acknowledged.
+   */
+  int64_t getLag() const {
+    return publishedSequence_ - ackedSequence_;
+  }
+
+  /*
+   * The number of changes dropped from the backlog so far.
+   */
+  uint64_t getDropped() const {
+    return dropped_;
+  }
+
+  size_t getInFlight() const {
+    return inFlight_;
+  }
+
+ private:
+  bool hasRoom() const;
+  Batch takeBacklog();
+
+  size_t inFlight_{0};
+  int64_t publishedSequence_{0};
+  int64_t ackedSequence_{0};
+  NeighborChangeStream::Changes backlog_;
+  bool resync_{false};
+  uint64_t dropped_{0};
+};
+
+}} // facebook::fboss
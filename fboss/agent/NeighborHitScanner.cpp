@@ -0,0 +1,79 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "fboss/agent/NeighborHitScanner.h"
+
+#include "fboss/agent/NeighborUpdater.h"
+#include "fboss/agent/SwSwitch.h"
+#include "fboss/agent/SwitchStats.h"
+
+#include <folly/logging/xlog.h>
+
+DEFINE_int32(neighbor_hit_scan_interval_ms, 5000,
+             "How often to scan the hardware for the neighbor entries that "
+             "were hit, or 0 to have each entry check its own hit bit");
+DEFINE_int32(max_neighbor_hit_refreshes, 4,
+             "How many lifetimes in a row a neighbor entry that is being hit "
+             "is kept reachable without probing the neighbor");
+
+using std::chrono::duration_cast;
+using std::chrono::milliseconds;
+using std::chrono::steady_clock;
+
+namespace facebook { namespace fboss {
+
+NeighborHitScanner::NeighborHitScanner(SwSwitch* sw, NeighborUpdater* updater)
+    : AsyncTimeout(sw->getBackgroundEvb()),
+      sw_(sw),
+      updater_(updater),
+      interval_(FLAGS_neighbor_hit_scan_interval_ms) {
+  if (interval_.count() <= 0) {
+    return;
+  }
+  sw_->getBackgroundEvb()->runInEventBaseThread([this]() {
+    scheduleTimeout(interval_);
+  });
+}
+
+NeighborHitScanner::~NeighborHitScanner() {
+  sw_->getBackgroundEvb()->runImmediatelyOrRunInEventBaseThreadAndWait(
+      [this]() {
+        cancelTimeout();
+      });
+}
+
+void NeighborHitScanner::timeoutExpired() noexcept {
+  if (!sw_->isFullyInitialized()) {
+    scheduleTimeout(interval_);
+    return;
+  }
+
+  auto start = steady_clock::now();
+  folly::Optional<std::vector<std::pair<RouterID, folly::IPAddress>>> hits;
+  try {
+    hits = sw_->getAndClearNeighborHits();
+  } catch (const std::exception& ex) {
+    XLOG(ERR) << "failed to scan for neighbor hits: "
+              << folly::exceptionStr(ex);
+    scheduleTimeout(interval_);
+    return;
+  }
+  if (!hits) {
+    XLOG(DBG2) << "hardware can't scan for neighbor hits, entries will "
+               << "check their own";
+    return;
+  }
+
+  updater_->entriesHit(*hits);
+  sw_->stats()->neighborHitScan(
+      duration_cast<milliseconds>(steady_clock::now() - start));
+  scheduleTimeout(interval_);
+}
+
+}} // facebook::fboss
@@ -0,0 +1,53 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#pragma once
+
+#include <folly/io/async/AsyncTimeout.h>
+#include <gflags/gflags.h>
+
+#include <chrono>
+
+DECLARE_int32(neighbor_hit_scan_interval_ms);
+DECLARE_int32(max_neighbor_hit_refreshes);
+
+namespace facebook { namespace fboss {
+
+class NeighborUpdater;
+class SwSwitch;
+
+/*
+ * NeighborHitScanner periodically asks the hardware for all of the neighbor
+ * entries hit since its last scan, in one pass over the host table, and
+ * marks them in the neighbor caches on the background thread.
+ *
+ * Entries that were hit during their lifetime are kept reachable without
+ * probing the neighbor, so that on large L2 domains only the neighbors that
+ * stopped being used are probed.  If the hardware can't scan its hit bits
+ * in bulk the scanner stops after its first attempt, and the entries keep
+ * checking their own hit bits.
+ */
+class NeighborHitScanner : private folly::AsyncTimeout {
+ public:
+  NeighborHitScanner(SwSwitch* sw, NeighborUpdater* updater);
+  ~NeighborHitScanner() override;
+
+ private:
+  void timeoutExpired() noexcept override;
+
+  // Forbidden copy constructor and assignment operator
+  NeighborHitScanner(NeighborHitScanner const &) = delete;
+  NeighborHitScanner& operator=(NeighborHitScanner const &) = delete;
+
+  SwSwitch* sw_{nullptr};
+  NeighborUpdater* updater_{nullptr};
+  std::chrono::milliseconds interval_{0};
+};
+
+}} // facebook::fboss
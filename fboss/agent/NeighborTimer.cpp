@@ -0,0 +1,78 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "fboss/agent/NeighborTimer.h"
+
+#include "common/stats/ServiceData.h"
+#include "fboss/agent/SwSwitch.h"
+#include "fboss/agent/SwitchStats.h"
+
+#include <folly/Random.h>
+
+using std::chrono::duration_cast;
+using std::chrono::microseconds;
+using std::chrono::milliseconds;
+using std::chrono::steady_clock;
+
+namespace facebook { namespace fboss {
+
+constexpr milliseconds NeighborTimer::kTickInterval;
+
+NeighborTimer::NeighborTimer(SwSwitch* sw)
+    : sw_(sw),
+      evb_(sw->getBackgroundEvb()),
+      timer_(folly::HHWheelTimer::newTimer(evb_, kTickInterval)) {}
+
+NeighborTimer::~NeighborTimer() {
+  // The entries have all been cancelled by now, but the wheel and the loop
+  // callback still belong to the background thread.
+  evb_->runImmediatelyOrRunInEventBaseThreadAndWait([this]() {
+    cancelLoopCallback();
+    timer_.reset();
+  });
+}
+
+void NeighborTimer::scheduleTimeout(Callback* cb, milliseconds timeout) {
+  DCHECK(evb_->isInEventBaseThread());
+  timer_->scheduleTimeout(cb, timeout);
+  occupancy_.store(timer_->count(), std::memory_order_relaxed);
+}
+
+void NeighborTimer::expiring() {
+  DCHECK(evb_->isInEventBaseThread());
+  if (inTick_) {
+    return;
+  }
+  inTick_ = true;
+  tickStart_ = steady_clock::now();
+  evb_->runInLoop(this);
+}
+
+milliseconds NeighborTimer::jitter(milliseconds interval) {
+  auto spread = interval.count() / 10;
+  if (spread == 0) {
+    return interval;
+  }
+  return milliseconds(interval.count() - folly::Random::rand32(spread));
+}
+
+void NeighborTimer::runLoopCallback() noexcept {
+  inTick_ = false;
+  sw_->stats()->neighborTimerTick(
+      duration_cast<microseconds>(steady_clock::now() - tickStart_));
+  occupancy_.store(timer_->count(), std::memory_order_relaxed);
+}
+
+void NeighborTimer::publishStats() {
+  fbData->setCounter(
+      SwitchStats::kCounterPrefix + "neighbor.timer.scheduled",
+      getOccupancy());
+}
+
+}} // facebook::fboss
@@ -0,0 +1,91 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#pragma once
+
+#include <folly/io/async/EventBase.h>
+#include <folly/io/async/HHWheelTimer.h>
+
+#include <atomic>
+#include <chrono>
+
+namespace facebook { namespace fboss {
+
+class SwSwitch;
+
+/*
+ * NeighborTimer is the timer wheel the expiry and probe timeouts of all of
+ * the neighbor cache entries are scheduled on, on the background thread.
+ *
+ * Tens of thousands of entries each scheduling their own AsyncTimeout keep
+ * the EventBase timeout heap churning, while the wheel is a single timeout
+ * there and schedules or cancels an entry in constant time, at the cost of
+ * rounding the timeouts up to kTickInterval.
+ *
+ * Each tick, the time spent processing the entries that expired is added
+ * to the SwitchStats, and the number of entries scheduled is kept to be
+ * published.
+ */
+class NeighborTimer : private folly::EventBase::LoopCallback {
+ public:
+  using Callback = folly::HHWheelTimer::Callback;
+
+  static constexpr std::chrono::milliseconds kTickInterval{10};
+
+  explicit NeighborTimer(SwSwitch* sw);
+  ~NeighborTimer() override;
+
+  /*
+   * Schedule cb to expire after timeout.  Must be called on the background
+   * thread.
+   */
+  void scheduleTimeout(Callback* cb, std::chrono::milliseconds timeout);
+
+  /*
+   * Called by each callback as it expires, to time the tick it expires in.
+   */
+  void expiring();
+
+  /*
+   * A timeout between 0.9 and 1 times interval, so that entries that were
+   * scheduled together, such as all of the probes after a port flap, spread
+   * out instead of all expiring in the same tick.  It is never longer than
+   * interval, so entries don't stay stale or go unprobed for any longer than
+   * configured.
+   */
+  static std::chrono::milliseconds jitter(std::chrono::milliseconds interval);
+
+  /*
+   * The number of callbacks scheduled as of the last tick.  Can be called
+   * from any thread.
+   */
+  size_t getOccupancy() const {
+    return occupancy_.load(std::memory_order_relaxed);
+  }
+
+  void publishStats();
+
+ private:
+  // Runs at the end of the event loop iteration that ran a tick
+  void runLoopCallback() noexcept override;
+
+  // Forbidden copy constructor and assignment operator
+  NeighborTimer(NeighborTimer const &) = delete;
+  NeighborTimer& operator=(NeighborTimer const &) = delete;
+
+  SwSwitch* sw_{nullptr};
+  folly::EventBase* evb_{nullptr};
+  folly::HHWheelTimer::UniquePtr timer_;
+  // When the callbacks of the current tick started expiring, if they have
+  bool inTick_{false};
+  std::chrono::steady_clock::time_point tickStart_;
+  std::atomic<size_t> occupancy_{0};
+};
+
+}} // facebook::fboss
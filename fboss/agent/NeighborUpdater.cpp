@@ -10,10 +10,13 @@
 #include "NeighborUpdater.h"
 #include "fboss/agent/FbossError.h"
 #include "fboss/agent/SwSwitch.h"
+#include "fboss/agent/SwitchStats.h"
 #include "fboss/agent/ArpHandler.h"
 #include "fboss/agent/IPv6Handler.h"
 #include "fboss/agent/state/AggregatePort.h"
 #include "fboss/agent/state/DeltaFunctions.h"
+#include "fboss/agent/state/Interface.h"
+#include "fboss/agent/state/InterfaceMap.h"
 #include "fboss/agent/state/SwitchState.h"
 #include "fboss/agent/state/Port.h"
 #include "fboss/agent/state/VlanMap.h"
@@ -25,6 +28,7 @@
 #include "fboss/agent/NdpCache.h"
 
 #include <boost/container/flat_map.hpp>
+#include <chrono>
 #include <folly/logging/xlog.h>
 #include <list>
 #include <mutex>
@@ -38,16 +42,26 @@ using folly::MacAddress;
 using folly::IPAddressV4;
 using folly::IPAddressV6;
 
+DEFINE_bool(link_down_fast_path, true,
+            "Make the neighbors on a port pending as soon as its link goes "
+            "down, rather than once the port's state update is applied");
+
 namespace facebook { namespace fboss {
 
 using facebook::fboss::DeltaFunctions::forEachChanged;
 
 NeighborUpdater::NeighborUpdater(SwSwitch* sw)
     : AutoRegisterStateObserver(sw, "NeighborUpdater"),
-      sw_(sw) {}
+      timer_(std::make_unique<NeighborTimer>(sw)),
+      caches_(std::make_shared<CacheMap>()),
+      sw_(sw) {
+  hitScanner_ = std::make_unique<NeighborHitScanner>(sw, this);
+}
 
 NeighborUpdater::~NeighborUpdater() {
-  for (auto& vlanAndCache: caches_) {
+  // Stop marking hits before the entries are cleared
+  hitScanner_.reset();
+  for (auto& vlanAndCache: *caches_) {
     // We want cache to clear entries
     // before we destroy the caches. Entries
     // hold a pointer to cache thus can call
@@ -62,27 +76,64 @@ NeighborUpdater::~NeighborUpdater() {
     vlanAndCache.second->clearEntries();
   }
   // reset the map of caches. This should call the destructors of
-  // each NeighborCache and block until everything is stopped.
-  caches_.clear();
+  // each NeighborCache and block until everything is stopped.  The
+  // snapshots of the other threads only keep caches with no entries left.
+  caches_.reset();
+}
+
+const NeighborUpdater::CacheMap& NeighborUpdater::getCaches() {
+  auto& snapshot = *cacheSnapshots_;
+  if (snapshot.version != cachesVersion_.load(std::memory_order_acquire)) {
+    std::lock_guard<std::mutex> g(cachesMutex_);
+    snapshot.caches = caches_;
+    snapshot.version = cachesVersion_.load(std::memory_order_relaxed);
+  }
+  return *snapshot.caches;
 }
 
-shared_ptr<ArpCache> NeighborUpdater::getArpCacheFor(VlanID vlan) {
+std::shared_ptr<const NeighborUpdater::CacheMap>
+NeighborUpdater::copyCaches() {
   std::lock_guard<std::mutex> g(cachesMutex_);
-  return getArpCacheInternal(vlan);
+  return caches_;
 }
 
-shared_ptr<NdpCache> NeighborUpdater::getNdpCacheFor(VlanID vlan) {
+void NeighborUpdater::setCaches(std::shared_ptr<const CacheMap> caches) {
+  CHECK(sw_->getUpdateEvb()->inRunningEventBaseThread());
   std::lock_guard<std::mutex> g(cachesMutex_);
-  return getNdpCacheInternal(vlan);
+  caches_ = std::move(caches);
+  cachesVersion_.fetch_add(1, std::memory_order_release);
+}
+
+NeighborUpdater::NeighborCaches* NeighborUpdater::getCachesFor(VlanID vlan) {
+  const auto& caches = getCaches();
+  auto res = caches.find(vlan);
+  if (res == caches.end()) {
+    return nullptr;
+  }
+  return res->second.get();
+}
+
+ArpCache* NeighborUpdater::getArpCacheFor(VlanID vlan) {
+  auto caches = getCachesFor(vlan);
+  if (!caches) {
+    throw FbossError("Tried to get Arp cache non-existent vlan ", vlan);
+  }
+  return caches->arpCache.get();
+}
+
+NdpCache* NeighborUpdater::getNdpCacheFor(VlanID vlan) {
+  auto caches = getCachesFor(vlan);
+  if (!caches) {
+    throw FbossError("Tried to get Ndp cache non-existent vlan ", vlan);
+  }
+  return caches->ndpCache.get();
 }
 
 void NeighborUpdater::getArpCacheData(std::vector<ArpEntryThrift>& arpTable) {
   std::list<ArpEntryThrift> entries;
-  {
-    std::lock_guard<std::mutex> g(cachesMutex_);
-    for (auto it = caches_.begin(); it != caches_.end(); ++it) {
-      entries.splice(entries.end(), it->second->arpCache->getArpCacheData());
-    }
+  auto caches = copyCaches();
+  for (auto it = caches->begin(); it != caches->end(); ++it) {
+    entries.splice(entries.end(), it->second->arpCache->getArpCacheData());
   }
   arpTable.reserve(entries.size());
   arpTable.insert(arpTable.begin(),
@@ -92,11 +143,9 @@ void NeighborUpdater::getArpCacheData(std::vector<ArpEntryThrift>& arpTable) {
 
 void NeighborUpdater::getNdpCacheData(std::vector<NdpEntryThrift>& ndpTable) {
   std::list<NdpEntryThrift> entries;
-  {
-    std::lock_guard<std::mutex> g(cachesMutex_);
-    for (auto it = caches_.begin(); it != caches_.end(); ++it) {
-      entries.splice(entries.end(), it->second->ndpCache->getNdpCacheData());
-    }
+  auto caches = copyCaches();
+  for (auto it = caches->begin(); it != caches->end(); ++it) {
+    entries.splice(entries.end(), it->second->ndpCache->getNdpCacheData());
   }
   ndpTable.reserve(entries.size());
   ndpTable.insert(ndpTable.begin(),
@@ -104,19 +153,41 @@ void NeighborUpdater::getNdpCacheData(std::vector<NdpEntryThrift>& ndpTable) {
                   std::make_move_iterator(std::end(entries)));
 }
 
-shared_ptr<ArpCache> NeighborUpdater::getArpCacheInternal(VlanID vlan) {
-  auto res = caches_.find(vlan);
-  if (res == caches_.end()) {
-    throw FbossError("Tried to get Arp cache non-existent vlan ", vlan);
-  }
-  return res->second->arpCache;
+void NeighborUpdater::publishStats() {
+  timer_->publishStats();
 }
-shared_ptr<NdpCache> NeighborUpdater::getNdpCacheInternal(VlanID vlan) {
-  auto res = caches_.find(vlan);
-  if (res == caches_.end()) {
-    throw FbossError("Tried to get Ndp cache non-existent vlan ", vlan);
+
+void NeighborUpdater::entriesHit(
+    const std::vector<std::pair<RouterID, IPAddress>>& hits) {
+  CHECK(sw_->getBackgroundEvb()->inRunningEventBaseThread());
+  using VrfHits = std::pair<std::vector<IPAddressV4>, std::vector<IPAddressV6>>;
+  boost::container::flat_map<RouterID, VrfHits> vrfHits;
+  for (const auto& vrfAndIP : hits) {
+    auto& ips = vrfHits[vrfAndIP.first];
+    if (vrfAndIP.second.isV4()) {
+      ips.first.push_back(vrfAndIP.second.asV4());
+    } else {
+      ips.second.push_back(vrfAndIP.second.asV6());
+    }
+  }
+  // Each VLAN only takes the hits in the VRF of its interface
+  auto state = sw_->getState();
+  for (const auto& vlanAndCaches : getCaches()) {
+    auto vlan = state->getVlans()->getVlanIf(vlanAndCaches.first);
+    if (!vlan) {
+      continue;
+    }
+    auto intf = state->getInterfaces()->getInterfaceIf(vlan->getInterfaceID());
+    if (!intf) {
+      continue;
+    }
+    auto itr = vrfHits.find(intf->getRouterID());
+    if (itr == vrfHits.end()) {
+      continue;
+    }
+    vlanAndCaches.second->arpCache->entriesHit(itr->second.first);
+    vlanAndCaches.second->ndpCache->entriesHit(itr->second.second);
   }
-  return res->second->ndpCache;
 }
 
 void NeighborUpdater::sentNeighborSolicitation(VlanID vlan,
@@ -170,7 +241,7 @@ void NeighborUpdater::receivedArpNotMine(VlanID vlan,
 }
 
 void NeighborUpdater::portDown(PortDescriptor port) {
-  for (auto vlanCaches : caches_) {
+  for (const auto& vlanCaches : getCaches()) {
     auto arpCache = vlanCaches.second->arpCache;
     arpCache->portDown(port);
 
@@ -179,33 +250,40 @@ void NeighborUpdater::portDown(PortDescriptor port) {
   }
 }
 
-// expects the cachesMutex_ to be held
-bool NeighborUpdater::flushEntryImpl(VlanID vlan, IPAddress ip) {
+void NeighborUpdater::recordPortDown(
+    std::chrono::steady_clock::time_point downAt) {
+  sw_->stats()->neighborPortDown(
+      std::chrono::duration_cast<std::chrono::microseconds>(
+          std::chrono::steady_clock::now() - downAt));
+}
+
+bool NeighborUpdater::flushEntryImpl(const CacheMap& caches, VlanID vlan,
+                                     IPAddress ip) {
+  auto res = caches.find(vlan);
+  if (res == caches.end()) {
+    throw FbossError("Tried to get ", ip.isV4() ? "Arp" : "Ndp",
+                     " cache non-existent vlan ", vlan);
+  }
   if (ip.isV4()) {
-    auto cache = getArpCacheInternal(vlan);
-    return cache->flushEntryBlocking(ip.asV4());
+    return res->second->arpCache->flushEntryBlocking(ip.asV4());
   }
-  auto cache = getNdpCacheInternal(vlan);
-  return cache->flushEntryBlocking(ip.asV6());
+  return res->second->ndpCache->flushEntryBlocking(ip.asV6());
 }
 
 uint32_t NeighborUpdater::flushEntry(VlanID vlan, IPAddress ip) {
-  // clone caches_ so we don't need to hold the lock while flushing entries
-  boost::container::flat_map<VlanID, std::shared_ptr<NeighborCaches>> caches;
-  {
-    std::lock_guard<std::mutex> g(cachesMutex_);
-    caches = caches_;
-  }
+  // copy caches_ so the caches outlive the blocking flushes even if another
+  // lookup on this thread refreshes its snapshot
+  auto caches = copyCaches();
 
   uint32_t count{0};
   if (vlan == VlanID(0)) {
-    for (auto it = caches.begin(); it != caches.end(); ++it) {
-      if (flushEntryImpl(it->first, ip)) {
+    for (auto it = caches->begin(); it != caches->end(); ++it) {
+      if (flushEntryImpl(*caches, it->first, ip)) {
         ++count;
       }
     }
   } else {
-    if (flushEntryImpl(vlan, ip)) {
+    if (flushEntryImpl(*caches, vlan, ip)) {
       ++count;
     }
   }
@@ -234,8 +312,7 @@ void NeighborUpdater::stateUpdated(const StateDelta& delta) {
       oldState->getNdpTimeout() != newState->getNdpTimeout() ||
       oldState->getMaxNeighborProbes() != newState->getMaxNeighborProbes() ||
       oldState->getStaleEntryInterval() != newState->getStaleEntryInterval()) {
-    std::lock_guard<std::mutex> g(cachesMutex_);
-    for (auto& vlanAndCaches : caches_) {
+    for (auto& vlanAndCaches : getCaches()) {
       auto& arpCache = vlanAndCaches.second->arpCache;
       auto& ndpCache = vlanAndCaches.second->ndpCache;
       arpCache->setTimeout(newState->getArpTimeout());
@@ -252,34 +329,34 @@ void NeighborUpdater::stateUpdated(const StateDelta& delta) {
 
 template<typename T>
 void collectPresenceChange(const T& delta,
-                          std::vector<std::string>* added,
-                          std::vector<std::string>* deleted) {
+                          std::vector<folly::IPAddress>* added,
+                          std::vector<folly::IPAddress>* deleted) {
   for (const auto& entry : delta) {
     auto oldEntry = entry.getOld();
     auto newEntry = entry.getNew();
     if (oldEntry && !newEntry) {
       if (oldEntry->nonZeroPort()) {
-        deleted->push_back(folly::to<std::string>(oldEntry->getIP()));
+        deleted->push_back(folly::IPAddress(oldEntry->getIP()));
       }
     } else if (newEntry && !oldEntry) {
       if (newEntry->nonZeroPort()) {
-        added->push_back(folly::to<std::string>(newEntry->getIP()));
+        added->push_back(folly::IPAddress(newEntry->getIP()));
       }
     } else {
       if (oldEntry->zeroPort() && newEntry->nonZeroPort()) {
         // Entry was resolved, add it
-        added->push_back(folly::to<std::string>(newEntry->getIP()));
+        added->push_back(folly::IPAddress(newEntry->getIP()));
       } else if (oldEntry->nonZeroPort() && newEntry->zeroPort()) {
         // Entry became unresolved, prune it
-        deleted->push_back(folly::to<std::string>(oldEntry->getIP()));
+        deleted->push_back(folly::IPAddress(oldEntry->getIP()));
       }
     }
   }
 }
 
 void NeighborUpdater::sendNeighborUpdates(const VlanDelta& delta) {
-  std::vector<std::string> added;
-  std::vector<std::string> deleted;
+  std::vector<folly::IPAddress> added;
+  std::vector<folly::IPAddress> deleted;
   collectPresenceChange(delta.getArpDelta(), &added, &deleted);
   collectPresenceChange(delta.getNdpDelta(), &added, &deleted);
   if (!(added.empty() && deleted.empty())) {
@@ -294,38 +371,41 @@ void NeighborUpdater::vlanAdded(const SwitchState* state, const Vlan* vlan) {
   auto vlanName = vlan->getName();
 
   auto intfID = vlan->getInterfaceID();
-  auto caches
-      = std::make_shared<NeighborCaches>(sw_, state, vlanID, vlanName, intfID);
+  auto caches = std::make_shared<NeighborCaches>(
+      sw_, timer_.get(), state, vlanID, vlanName, intfID);
 
   // We need to populate the caches from the SwitchState when a vlan is added
   // After this, we no longer process Arp or Ndp deltas for this vlan.
   caches->arpCache->repopulate(vlan->getArpTable());
   caches->ndpCache->repopulate(vlan->getNdpTable());
 
-  {
-    std::lock_guard<std::mutex> g(cachesMutex_);
-    caches_.emplace(vlan->getID(), std::move(caches));
-  }
+  auto newCaches = std::make_shared<CacheMap>(*copyCaches());
+  newCaches->emplace(vlan->getID(), std::move(caches));
+  setCaches(std::move(newCaches));
 }
 
 void NeighborUpdater::vlanDeleted(const Vlan* vlan) {
   CHECK(sw_->getUpdateEvb()->inRunningEventBaseThread());
-  std::shared_ptr<NeighborCaches> removedEntry;
-  {
-    std::lock_guard<std::mutex> g(cachesMutex_);
-    auto iter = caches_.find(vlan->getID());
-    if (iter != caches_.end()) {
-      // we copy the entry over so we don't destroy the
-      // caches while holding the lock.
-      removedEntry = std::move(iter->second);
-      caches_.erase(iter);
-    } else {
-      // TODO(aeckert): May want to fatal here when a cache doesn't exist for a
-      // specific vlan. Need to make sure that caches are correctly created for
-      // the initial SwitchState to avoid false positives
-      XLOG(DBG0) << "Deleted Vlan with no corresponding NeighborCaches";
-    }
+  auto oldCaches = copyCaches();
+  auto iter = oldCaches->find(vlan->getID());
+  if (iter == oldCaches->end()) {
+    // TODO(aeckert): May want to fatal here when a cache doesn't exist for a
+    // specific vlan. Need to make sure that caches are correctly created for
+    // the initial SwitchState to avoid false positives
+    XLOG(DBG0) << "Deleted Vlan with no corresponding NeighborCaches";
+    return;
   }
+
+  auto removedEntry = iter->second;
+  auto newCaches = std::make_shared<CacheMap>(*oldCaches);
+  newCaches->erase(vlan->getID());
+  setCaches(std::move(newCaches));
+  // Other threads may still have the caches in their snapshots, for as
+  // long as they don't look them up again.  Closing them keeps those
+  // threads from adding entries, so that the last snapshot to let go of
+  // them can destroy them without waiting on the background thread, even
+  // when it is the background thread's own.
+  removedEntry->close();
 }
 
 void NeighborUpdater::vlanChanged(const Vlan* oldVlan, const Vlan* newVlan) {
@@ -336,22 +416,19 @@ void NeighborUpdater::vlanChanged(const Vlan* oldVlan, const Vlan* newVlan) {
   }
 
   CHECK(sw_->getUpdateEvb()->inRunningEventBaseThread());
-  {
-    std::lock_guard<std::mutex> g(cachesMutex_);
-    auto iter = caches_.find(newVlan->getID());
-    if (iter != caches_.end()) {
-      auto intfID = newVlan->getInterfaceID();
-      iter->second->arpCache->setIntfID(intfID);
-      iter->second->ndpCache->setIntfID(intfID);
-      auto vlanName = newVlan->getName();
-      iter->second->arpCache->setVlanName(vlanName);
-      iter->second->ndpCache->setVlanName(vlanName);
-    } else {
-      // TODO(aeckert): May want to fatal here when a cache doesn't exist for a
-      // specific vlan. Need to make sure that caches are correctly created for
-      // the initial SwitchState to avoid false positives
-      XLOG(DBG0) << "Changed Vlan with no corresponding NeighborCaches";
-    }
+  auto caches = getCachesFor(newVlan->getID());
+  if (caches) {
+    auto intfID = newVlan->getInterfaceID();
+    caches->arpCache->setIntfID(intfID);
+    caches->ndpCache->setIntfID(intfID);
+    auto vlanName = newVlan->getName();
+    caches->arpCache->setVlanName(vlanName);
+    caches->ndpCache->setVlanName(vlanName);
+  } else {
+    // TODO(aeckert): May want to fatal here when a cache doesn't exist for a
+    // specific vlan. Need to make sure that caches are correctly created for
+    // the initial SwitchState to avoid false positives
+    XLOG(DBG0) << "Changed Vlan with no corresponding NeighborCaches";
   }
 }
 
@@ -363,23 +440,57 @@ void NeighborUpdater::portChanged(
     // Fire explicit callback for purging neighbor entries.
     CHECK_EQ(oldPort->getID(), newPort->getID());
     auto portId = newPort->getID();
+    folly::Optional<std::chrono::steady_clock::time_point> downAt;
+    if (!FLAGS_link_down_fast_path) {
+      downAt = std::chrono::steady_clock::now();
+    }
+    // With the fast path the entries were already made pending straight
+    // from the link event, so this only catches any learned since, and
+    // isn't timed again.
+    sw_->getBackgroundEvb()->runInEventBaseThread([this, portId, downAt]() {
+      purgeDownPort(portId, downAt);
+    });
+  }
+}
 
-    sw_->getBackgroundEvb()->runInEventBaseThread([this, portId]() {
-      auto aggPort =
-          sw_->getState()->getAggregatePorts()->getAggregatePortIf(portId);
-      if (aggPort) {
-        if (aggPort->forwardingSubportCount() <
-            aggPort->getMinimumLinkCount()) {
-          auto aggPortID = aggPort->getID();
-          XLOG(INFO) << "Purging neighbor entry for aggregate port "
-                     << aggPortID;
-          portDown(PortDescriptor(aggPortID));
-        }
-      } else {
-        XLOG(INFO) << "Purging neighbor entry for physical port " << portId;
-        portDown(PortDescriptor(portId));
+void NeighborUpdater::linkDown(
+    PortID port,
+    std::chrono::steady_clock::time_point downAt) {
+  sw_->getBackgroundEvb()->runInEventBaseThread([this, port, downAt]() {
+    purgeDownPort(port, downAt);
+  });
+}
+
+void NeighborUpdater::purgeDownPort(
+    PortID portId,
+    folly::Optional<std::chrono::steady_clock::time_point> downAt) {
+  auto aggPort =
+      sw_->getState()->getAggregatePorts()->getAggregatePortIf(portId);
+  if (aggPort) {
+    // Ahead of the port's state update, LACP may not have stopped
+    // forwarding over it yet
+    uint32_t forwarding = 0;
+    for (const auto& subport : aggPort->subportAndFwdState()) {
+      if (subport.first != portId &&
+          subport.second == AggregatePort::Forwarding::ENABLED) {
+        ++forwarding;
       }
-    });
+    }
+    if (forwarding < aggPort->getMinimumLinkCount()) {
+      auto aggPortID = aggPort->getID();
+      XLOG(INFO) << "Purging neighbor entry for aggregate port "
+                 << aggPortID;
+      portDown(PortDescriptor(aggPortID));
+      if (downAt) {
+        recordPortDown(*downAt);
+      }
+    }
+  } else {
+    XLOG(INFO) << "Purging neighbor entry for physical port " << portId;
+    portDown(PortDescriptor(portId));
+    if (downAt) {
+      recordPortDown(*downAt);
+    }
   }
 }
 }} // facebook::fboss
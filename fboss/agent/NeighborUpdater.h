@@ -14,10 +14,20 @@
 #include "fboss/agent/types.h"
 #include "fboss/agent/ArpCache.h"
 #include "fboss/agent/NdpCache.h"
+#include "fboss/agent/NeighborHitScanner.h"
+#include "fboss/agent/NeighborTimer.h"
 #include "fboss/agent/state/PortDescriptor.h"
+#include <folly/Optional.h>
+#include <folly/ThreadLocal.h>
+#include <gflags/gflags.h>
+#include <atomic>
+#include <chrono>
 #include <list>
 #include <mutex>
 #include <string>
+#include <vector>
+
+DECLARE_bool(link_down_fast_path);
 
 namespace facebook { namespace fboss {
 
@@ -84,10 +94,25 @@ class NeighborUpdater : public AutoRegisterStateObserver {
 
   void portDown(PortDescriptor port);
 
+  /*
+   * Make the entries on a port whose link just went down pending, or those
+   * on its aggregate port if that is left with too few members, in the
+   * background thread.  This is the fast path straight from the link event,
+   * ahead of the port's state update.
+   */
+  void linkDown(PortID port, std::chrono::steady_clock::time_point downAt);
+
   void getArpCacheData(std::vector<ArpEntryThrift>& arpTable);
 
   void getNdpCacheData(std::vector<NdpEntryThrift>& ndpTable);
 
+  void publishStats();
+
+  // Mark the entries the hardware saw hit, by VRF and address, on the
+  // background thread
+  void entriesHit(
+      const std::vector<std::pair<RouterID, folly::IPAddress>>& hits);
+
  private:
   void vlanAdded(const SwitchState* state, const Vlan* vlan);
   void vlanDeleted(const Vlan* vlan);
@@ -99,12 +124,14 @@ class NeighborUpdater : public AutoRegisterStateObserver {
 
   void sendNeighborUpdates(const VlanDelta& delta);
 
-  std::shared_ptr<ArpCache> getArpCacheFor(VlanID vlan);
-  std::shared_ptr<ArpCache> getArpCacheInternal(VlanID vlan);
-  std::shared_ptr<NdpCache> getNdpCacheFor(VlanID vlan);
-  std::shared_ptr<NdpCache> getNdpCacheInternal(VlanID vlan);
+  // Runs in the background thread, and records how long it took since
+  // downAt if given
+  void purgeDownPort(
+      PortID port,
+      folly::Optional<std::chrono::steady_clock::time_point> downAt);
 
-  bool flushEntryImpl (VlanID vlan, folly::IPAddress ip);
+  // Time from a port going down to its neighbors being made pending
+  void recordPortDown(std::chrono::steady_clock::time_point downAt);
 
   // Forbidden copy constructor and assignment operator
   NeighborUpdater(NeighborUpdater const &) = delete;
@@ -112,31 +139,79 @@ class NeighborUpdater : public AutoRegisterStateObserver {
 
   struct NeighborCaches {
     /* These are shared_ptrs for safety reasons as it lets callers
-     * safely use the results of getArpCacheFor or getNdpCacheFor
-     * even if the vlan is deleted in another thread. */
+     * safely keep using a cache they looked up even if the vlan is deleted
+     * in another thread. */
     std::shared_ptr<ArpCache> arpCache;
     std::shared_ptr<NdpCache> ndpCache;
 
-    NeighborCaches(SwSwitch* sw, const SwitchState* state,
-                   VlanID vlanID, std::string vlanName, InterfaceID intfID) :
-        arpCache(
-            std::make_shared<ArpCache>(sw, state, vlanID, vlanName, intfID)),
-        ndpCache(
-            std::make_shared<NdpCache>(sw, state, vlanID, vlanName, intfID)) {}
+    NeighborCaches(SwSwitch* sw, NeighborTimer* timer,
+                   const SwitchState* state, VlanID vlanID,
+                   std::string vlanName, InterfaceID intfID) :
+        arpCache(std::make_shared<ArpCache>(
+            sw, timer, state, vlanID, vlanName, intfID)),
+        ndpCache(std::make_shared<NdpCache>(
+            sw, timer, state, vlanID, vlanName, intfID)) {}
     void clearEntries() {
       arpCache->clearEntries();
       ndpCache->clearEntries();
     }
+    void close() {
+      arpCache->close();
+      ndpCache->close();
+    }
+  };
+
+  using CacheMap =
+      boost::container::flat_map<VlanID, std::shared_ptr<NeighborCaches>>;
+
+  /*
+   * The caches of the vlan, or an FbossError if there are none.  The cache
+   * returned is only kept alive by the calling thread's snapshot of the
+   * caches, so the pointer must not be kept past the calling thread's next
+   * lookup.
+   */
+  ArpCache* getArpCacheFor(VlanID vlan);
+  NdpCache* getNdpCacheFor(VlanID vlan);
+  NeighborCaches* getCachesFor(VlanID vlan);
+
+  /*
+   * The calling thread's snapshot of the caches, refreshed whenever a vlan
+   * was added or deleted since it was taken.  Looking up the caches of a
+   * packet's vlan takes no lock unless the vlans changed.
+   */
+  const CacheMap& getCaches();
+
+  // A copy of the caches, for the slow paths that block while using them
+  std::shared_ptr<const CacheMap> copyCaches();
+
+  // Publish a new map of the caches, on the update thread
+  void setCaches(std::shared_ptr<const CacheMap> caches);
+
+  bool flushEntryImpl(const CacheMap& caches, VlanID vlan,
+                      folly::IPAddress ip);
+
+  struct CacheSnapshot {
+    uint64_t version{0};
+    std::shared_ptr<const CacheMap> caches;
   };
 
+  // The timer wheel the entries of all of the caches are scheduled on,
+  // which must outlive them
+  std::unique_ptr<NeighborTimer> timer_;
+
   /**
-   * caches_ can be accessed from multiple threads, so we need to lock accesses
-   * with cachesMutex_. Note that this means that the cache implmentation cade
-   * should NOT ever call back into NeighborUpdater because of this, as it would
-   * likely be a lock ordering issue.
+   * caches_ is only replaced on the update thread, while holding
+   * cachesMutex_ and incrementing cachesVersion_.  The other threads read
+   * it through their CacheSnapshot, only taking cachesMutex_ to refresh it.
+   * Note that the cache implementation code should NOT ever call back into
+   * NeighborUpdater, as it could release the snapshot the calling cache is
+   * kept alive by.
    */
-  boost::container::flat_map<VlanID, std::shared_ptr<NeighborCaches>> caches_;
+  std::shared_ptr<const CacheMap> caches_;
   std::mutex cachesMutex_;
+  std::atomic<uint64_t> cachesVersion_{1};
+  folly::ThreadLocal<CacheSnapshot> cacheSnapshots_;
+  std::unique_ptr<NeighborHitScanner> hitScanner_;
   SwSwitch* sw_{nullptr};
 };
 
@@ -14,6 +14,8 @@
 #include "fboss/agent/state/StateDelta.h"
 #include "fboss/agent/state/Route.h"
 
+#include <folly/ScopeGuard.h>
+
 using std::shared_ptr;
 using facebook::fboss::DeltaFunctions::forEachChanged;
 using facebook::fboss::DeltaFunctions::forEachAdded;
@@ -21,10 +23,16 @@ using facebook::fboss::DeltaFunctions::forEachRemoved;
 
 namespace facebook { namespace fboss {
 
-void NexthopToRouteCount::stateChanged(const StateDelta& delta) {
+void NexthopToRouteCount::stateChanged(
+    const StateDelta& delta,
+    std::vector<RouterNexthop>* changed) {
+  changed_ = changed;
+  SCOPE_EXIT {
+    changed_ = nullptr;
+  };
    for (auto const& rtDelta : delta.getRouteTablesDelta()) {
-      // Do add/changed first so we don't remove next hops due to decrements
-      // in ref count via removed routes, only to add them back again if these
+      // Do add/changed first so we don't remove next hops when their last
+      // route is removed, only to add them back again if these
       // next hops show up in added/changed routes
      if (rtDelta.getNew()) {
        RouterID id = rtDelta.getNew()->getID();
@@ -60,67 +68,110 @@ void NexthopToRouteCount::stateChanged(const StateDelta& delta) {
   }
 }
 
+namespace {
+
+std::set<RoutePrefixV4>& getPrefixes(
+    NexthopToRouteCount::NexthopRoutes* routes,
+    const RoutePrefixV4& /*prefix*/) {
+  return routes->v4;
+}
+
+std::set<RoutePrefixV6>& getPrefixes(
+    NexthopToRouteCount::NexthopRoutes* routes,
+    const RoutePrefixV6& /*prefix*/) {
+  return routes->v6;
+}
+
+template<typename RouteT>
+const RouteNextHopSet& getResolvedNextHops(const shared_ptr<RouteT>& route) {
+  const auto &fwd = route->getForwardInfo();
+  if (route->isResolved() && fwd.getAction() == RouteForwardAction::NEXTHOPS) {
+    return fwd.getNextHopSet();
+  }
+  static const RouteNextHopSet kEmptyNextHops;
+  return kEmptyNextHops;
+}
+
+} // unnamed namespace
+
+const NexthopToRouteCount::NexthopRoutes* NexthopToRouteCount::getRoutesIf(
+    RouterID rid, const NextHop& nhop) const {
+  auto ridItr = rid2nhopRoutes_.find(rid);
+  if (ridItr == rid2nhopRoutes_.end()) {
+    return nullptr;
+  }
+  auto itr = ridItr->second.find(nhop);
+  return itr == ridItr->second.end() ? nullptr : &itr->second;
+}
+
 template<typename RouteT>
 void NexthopToRouteCount::processChangedRoute(const RouterID rid,
    const shared_ptr<RouteT>& oldRoute, const shared_ptr<RouteT>& newRoute) {
-  // We could compute set differences of nexthops from old and new routes,
-  // but since we would need to compute 2 set differences (new - old and
-  // old - new), it is similar complexity wise to just decrement reference
-  // for old next hops and increment reference for new next hops.
-  //  Do increment first so we don't need to delete and add nexthops
-  //  with ref count 1, which remained unchanged.
-  processAddedRoute(rid, newRoute);
-  processRemovedRoute(rid, oldRoute);
+  // Both next hop sets are sorted, so walk them together: next hops only
+  // in the old route lose this prefix and next hops only in the new route
+  // gain it. Next hops in both are left alone.
+  const auto& oldNhops = getResolvedNextHops(oldRoute);
+  const auto& newNhops = getResolvedNextHops(newRoute);
+  const auto& prefix = newRoute->prefix();
+  auto oldItr = oldNhops.begin();
+  auto newItr = newNhops.begin();
+  while (oldItr != oldNhops.end() || newItr != newNhops.end()) {
+    if (newItr == newNhops.end() ||
+        (oldItr != oldNhops.end() && *oldItr < *newItr)) {
+      removeNexthopRoute(rid, *oldItr++, prefix);
+    } else if (oldItr == oldNhops.end() || *newItr < *oldItr) {
+      addNexthopRoute(rid, *newItr++, prefix);
+    } else {
+      ++oldItr;
+      ++newItr;
+    }
+  }
 }
 
 template<typename RouteT>
 void NexthopToRouteCount::processAddedRoute(const RouterID rid,
     const shared_ptr<RouteT>& newRoute) {
-  const auto &fwd = newRoute->getForwardInfo();
-  if (newRoute->isResolved()
-      && fwd.getAction() == RouteForwardAction::NEXTHOPS) {
-    for (const auto& nhop : fwd.getNextHopSet()) {
-      incNexthopReference(rid, nhop);
-    }
+  for (const auto& nhop : getResolvedNextHops(newRoute)) {
+    addNexthopRoute(rid, nhop, newRoute->prefix());
   }
 }
 
 template<typename RouteT>
 void NexthopToRouteCount::processRemovedRoute(const RouterID rid,
    const shared_ptr<RouteT>& oldRoute) {
-  const auto &fwd = oldRoute->getForwardInfo();
-  if (oldRoute->isResolved()
-      && fwd.getAction() == RouteForwardAction::NEXTHOPS) {
-    for (const auto& nhop : fwd.getNextHopSet()) {
-      decNexthopReference(rid, nhop);
-    }
+  for (const auto& nhop : getResolvedNextHops(oldRoute)) {
+    removeNexthopRoute(rid, nhop, oldRoute->prefix());
   }
 }
 
-void NexthopToRouteCount::incNexthopReference(RouterID rid,
-    const NextHop& nhop) {
-  auto& nhop2RefCount = rid2nhopRefCounts_[rid];
-  auto itr = nhop2RefCount.find(nhop);
-  if (itr == nhop2RefCount.end()) {
-    nhop2RefCount.emplace(nhop, 1);
-  } else {
-    DCHECK(itr->second >= 1);
-    itr->second++;
+template <typename PrefixT>
+void NexthopToRouteCount::addNexthopRoute(RouterID rid,
+    const NextHop& nhop, const PrefixT& prefix) {
+  auto& nhop2Routes = rid2nhopRoutes_[rid];
+  auto& routes = nhop2Routes[nhop];
+  if (changed_ && routes.size() == 0) {
+    changed_->emplace_back(rid, nhop);
   }
+  auto inserted = getPrefixes(&routes, prefix).insert(prefix);
+  DCHECK(inserted.second);
 }
 
-void NexthopToRouteCount::decNexthopReference(RouterID rid,
-    const NextHop& nhop) {
-  auto& nhop2RefCount = rid2nhopRefCounts_[rid];
-  auto itr = nhop2RefCount.find(nhop);
-  CHECK(itr != nhop2RefCount.end());
-  itr->second--;
-  DCHECK(itr->second >= 0);
-  if (itr->second == 0) {
-    nhop2RefCount.erase(itr);
+template <typename PrefixT>
+void NexthopToRouteCount::removeNexthopRoute(RouterID rid,
+    const NextHop& nhop, const PrefixT& prefix) {
+  auto& nhop2Routes = rid2nhopRoutes_[rid];
+  auto itr = nhop2Routes.find(nhop);
+  CHECK(itr != nhop2Routes.end());
+  auto erased = getPrefixes(&itr->second, prefix).erase(prefix);
+  DCHECK_EQ(erased, 1);
+  if (itr->second.size() == 0) {
+    if (changed_) {
+      changed_->emplace_back(rid, nhop);
+    }
+    nhop2Routes.erase(itr);
   }
-  if (nhop2RefCount.empty()) {
-    rid2nhopRefCounts_.erase(rid);
+  if (nhop2Routes.empty()) {
+    rid2nhopRoutes_.erase(rid);
   }
 }
 }}
@@ -9,11 +9,17 @@
  */
 #pragma once
 
+#include <set>
+#include <utility>
+#include <vector>
+
 #include <boost/container/flat_map.hpp>
+#include <folly/IPAddress.h>
 #include <folly/IPAddressV4.h>
 #include <folly/IPAddressV6.h>
 
 #include "fboss/agent/state/RouteNextHop.h"
+#include "fboss/agent/state/RouteTypes.h"
 #include "fboss/agent/types.h"
 
 
@@ -22,25 +28,82 @@ namespace facebook { namespace fboss {
 class StateDelta;
 /*
  * Simple class that maintains a map of route next hops to the
- * number of routes pointing to that next hop. The next hops
+ * routes pointing to that next hop. The next hops
  * mapped here are post route resolution, so the next hops
  * are in directly attached subnets.
  * This map is then used in NeighborUpdater to pro actively
  * ARP/NDP for any next hops which don't have ARP/NDP resolved
- * for them.
+ * for them, and to find the routes affected when a neighbor
+ * changes without walking the whole route table.
  */
 class NexthopToRouteCount {
  public:
    explicit NexthopToRouteCount() {}
-   void stateChanged(const StateDelta& delta);
-   // Using int rather than uint to check against bugs where we
-   // get -ve reference counts
-   using RouterID2NhopRefCounts = boost::container::flat_map<RouterID,
-         boost::container::flat_map<NextHop, int64_t>>;
 
-  using const_iterator = RouterID2NhopRefCounts::const_iterator;
-  const_iterator begin() const { return rid2nhopRefCounts_.begin(); }
-  const_iterator end() const { return rid2nhopRefCounts_.end(); }
+  // A next hop that routes in rid started or stopped resolving to
+  using RouterNexthop = std::pair<RouterID, NextHop>;
+
+  /*
+   * Apply the route changes in delta.  If changed is non-null, the next
+   * hops that gained their first route or lost their last one are added to
+   * it, so callers can follow the next hops without walking the map.
+   */
+  void stateChanged(const StateDelta& delta,
+                    std::vector<RouterNexthop>* changed = nullptr);
+
+  // Prefixes of the routes resolved to a next hop
+  struct NexthopRoutes {
+    std::set<RoutePrefixV4> v4;
+    std::set<RoutePrefixV6> v6;
+
+    size_t size() const {
+      return v4.size() + v6.size();
+    }
+  };
+  using Nhop2Routes = boost::container::flat_map<NextHop, NexthopRoutes>;
+  using RouterID2NhopRoutes = boost::container::flat_map<RouterID, Nhop2Routes>;
+
+  using const_iterator = RouterID2NhopRoutes::const_iterator;
+  const_iterator begin() const { return rid2nhopRoutes_.begin(); }
+  const_iterator end() const { return rid2nhopRoutes_.end(); }
+
+  /*
+   * Return the routes in rid resolved to nhop, or nullptr if no route
+   * uses that next hop.
+   */
+  const NexthopRoutes* getRoutesIf(RouterID rid, const NextHop& nhop) const;
+
+  /*
+   * Number of routes in rid resolved to nhop
+   */
+  size_t getRouteCount(RouterID rid, const NextHop& nhop) const {
+    auto routes = getRoutesIf(rid, nhop);
+    return routes ? routes->size() : 0;
+  }
+
+  /*
+   * Call fn(nhop, routes) for every next hop in rid through the neighbor
+   * addr on interface intf, whatever its weight. Next hops are ordered by
+   * interface and then by address, so these are adjacent in the map.
+   */
+  template <typename Fn>
+  void forEachNexthopVia(
+      RouterID rid,
+      InterfaceID intf,
+      const folly::IPAddress& addr,
+      Fn fn) const {
+    auto ridItr = rid2nhopRoutes_.find(rid);
+    if (ridItr == rid2nhopRoutes_.end()) {
+      return;
+    }
+    const auto& nhop2Routes = ridItr->second;
+    for (auto itr = nhop2Routes.lower_bound(ResolvedNextHop(addr, intf, 0));
+         itr != nhop2Routes.end() && itr->first.intfID() == intf &&
+         itr->first.addr() == addr;
+         ++itr) {
+      fn(itr->first, itr->second);
+    }
+  }
 
  private:
     // Forbidden copy constructor and assignment operator
@@ -58,9 +121,15 @@ class NexthopToRouteCount {
     void processRemovedRoute(const RouterID id,
         const std::shared_ptr<RouteT>& newRoute);
 
-    void incNexthopReference(RouterID rid, const NextHop& nhop);
-    void decNexthopReference(RouterID rid, const NextHop& nhop);
+    template <typename PrefixT>
+    void addNexthopRoute(RouterID rid, const NextHop& nhop,
+        const PrefixT& prefix);
+    template <typename PrefixT>
+    void removeNexthopRoute(RouterID rid, const NextHop& nhop,
+        const PrefixT& prefix);
 
-    RouterID2NhopRefCounts rid2nhopRefCounts_;
+    RouterID2NhopRoutes rid2nhopRoutes_;
+    // Where the next hops changed are recorded, during stateChanged()
+    std::vector<RouterNexthop>* changed_{nullptr};
 };
 }}
@@ -0,0 +1,175 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "fboss/agent/PacketPolicer.h"
+
+#include "common/stats/ServiceData.h"
+#include "fboss/agent/RxPacket.h"
+#include "fboss/agent/state/StateDelta.h"
+#include "fboss/agent/state/SwitchState.h"
+
+#include <folly/Conv.h>
+#include <folly/ScopeGuard.h>
+#include <folly/io/IOBuf.h>
+#include <folly/logging/xlog.h>
+
+namespace {
+constexpr uint16_t kEtherTypeVlan = 0x8100;
+constexpr uint16_t kEtherTypeIPv4 = 0x0800;
+constexpr uint16_t kEtherTypeIPv6 = 0x86DD;
+constexpr size_t kEthHdrLen = 14;
+constexpr size_t kVlanTagLen = 4;
+constexpr size_t kIPv4ProtocolOffset = 9;
+constexpr size_t kIPv6NextHeaderOffset = 6;
+
+uint16_t readBE16(const uint8_t* data) {
+  return (static_cast<uint16_t>(data[0]) << 8) | data[1];
+}
+}
+
+namespace facebook { namespace fboss {
+
+PacketPolicer::Policer::Policer(const CPUSoftwarePolicer& config)
+    : config(config),
+      bucket(config.currentPacketsPerSec(), config.burstSize) {}
+
+PacketPolicer::PacketPolicer() {}
+
+PacketPolicer::~PacketPolicer() {}
+
+void PacketPolicer::stateUpdated(const StateDelta& delta) {
+  const auto& oldPolicers =
+      delta.oldState()->getControlPlane()->getSoftwarePolicers();
+  const auto& newPolicers =
+      delta.newState()->getControlPlane()->getSoftwarePolicers();
+  if (oldPolicers != newPolicers) {
+    setPolicers(newPolicers);
+  }
+}
+
+void PacketPolicer::setPolicers(
+    const ControlPlane::SoftwarePolicers& policers) {
+  std::lock_guard<std::mutex> guard(lock_);
+  auto old = owned_.get();
+  auto newPolicers = std::make_unique<Policers>();
+  for (const auto& config : policers) {
+    auto policer = std::make_unique<Policer>(config);
+    if (old) {
+      for (const auto& oldPolicer : *old) {
+        if (oldPolicer->config.name == config.name) {
+          policer->dropped.store(
+              oldPolicer->dropped.load(std::memory_order_relaxed),
+              std::memory_order_relaxed);
+        }
+      }
+    }
+    newPolicers->push_back(std::move(policer));
+  }
+  XLOG(DBG2) << "Using " << newPolicers->size() << " CPU software policers";
+  current_.store(newPolicers.get(), std::memory_order_seq_cst);
+  if (owned_) {
+    retired_.push_back(std::move(owned_));
+  }
+  owned_ = std::move(newPolicers);
+  // Any reader that starts from here on only sees the new policers
+  if (readers_.load(std::memory_order_seq_cst) == 0) {
+    retired_.clear();
+  }
+}
+
+size_t PacketPolicer::numPolicerSets() const {
+  std::lock_guard<std::mutex> guard(lock_);
+  return retired_.size() + (owned_ ? 1 : 0);
+}
+
+bool PacketPolicer::admit(const RxPacket* pkt) {
+  readers_.fetch_add(1, std::memory_order_seq_cst);
+  SCOPE_EXIT {
+    readers_.fetch_sub(1, std::memory_order_release);
+  };
+  auto policers = current_.load(std::memory_order_seq_cst);
+  if (!policers || policers->empty()) {
+    return true;
+  }
+
+  // Only read as much of the headers as the policers need
+  const auto* buf = pkt->buf();
+  const auto* data = buf->data();
+  auto len = buf->length();
+  if (len < kEthHdrLen) {
+    return true;
+  }
+  size_t l3Offset = kEthHdrLen;
+  auto etherType = readBE16(data + 12);
+  if (etherType == kEtherTypeVlan && len >= kEthHdrLen + kVlanTagLen) {
+    etherType = readBE16(data + 16);
+    l3Offset += kVlanTagLen;
+  }
+  int ipProtocol = -1;
+  if (etherType == kEtherTypeIPv4 && len > l3Offset + kIPv4ProtocolOffset) {
+    ipProtocol = data[l3Offset + kIPv4ProtocolOffset];
+  } else if (etherType == kEtherTypeIPv6 &&
+             len > l3Offset + kIPv6NextHeaderOffset) {
+    ipProtocol = data[l3Offset + kIPv6NextHeaderOffset];
+  }
+
+  for (const auto& policer : *policers) {
+    const auto& config = policer->config;
+    if (config.etherType != etherType ||
+        (config.ipProtocol && *config.ipProtocol != ipProtocol) ||
+        (config.port && *config.port != pkt->getSrcPort())) {
+      continue;
+    }
+    if (policer->bucket.consume(1)) {
+      return true;
+    }
+    policer->dropped.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+  return true;
+}
+
+uint64_t PacketPolicer::getDropped(const std::string& name) const {
+  readers_.fetch_add(1, std::memory_order_seq_cst);
+  SCOPE_EXIT {
+    readers_.fetch_sub(1, std::memory_order_release);
+  };
+  auto policers = current_.load(std::memory_order_seq_cst);
+  if (policers) {
+    for (const auto& policer : *policers) {
+      if (policer->config.name == name) {
+        return policer->dropped.load(std::memory_order_relaxed);
+      }
+    }
+  }
+  return 0;
+}
+
+void PacketPolicer::publishStats() const {
+  readers_.fetch_add(1, std::memory_order_seq_cst);
+  SCOPE_EXIT {
+    readers_.fetch_sub(1, std::memory_order_release);
+  };
+  auto policers = current_.load(std::memory_order_seq_cst);
+  if (!policers) {
+    return;
+  }
+  for (const auto& policer : *policers) {
+    fbData->setCounter(
+        folly::to<std::string>(
+            "cpu_policer.", policer->config.name, ".dropped"),
+        policer->dropped.load(std::memory_order_relaxed));
+    fbData->setCounter(
+        folly::to<std::string>(
+            "cpu_policer.", policer->config.name, ".packets_per_sec"),
+        policer->config.currentPacketsPerSec());
+  }
+}
+
+}} // facebook::fboss
@@ -0,0 +1,95 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#pragma once
+
+#include "fboss/agent/StateObserver.h"
+#include "fboss/agent/state/ControlPlane.h"
+
+#include <folly/TokenBucket.h>
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace facebook { namespace fboss {
+
+class RxPacket;
+
+/*
+ * PacketPolicer applies the CPU software policers configured in the
+ * ControlPlane to trapped packets, so that excess packets of a protocol that
+ * is flooding the CPU are dropped before they are parsed and handled.
+ *
+ * admit() is called from the packet receive threads and never blocks.  The
+ * policers are replaced from the update thread when the ControlPlane
+ * changes.
+ */
+class PacketPolicer : public StateObserver {
+ public:
+  PacketPolicer();
+  ~PacketPolicer() override;
+
+  void stateUpdated(const StateDelta& delta) override;
+
+  /*
+   * Replace the policers.  Drop counts carry over to policers of the same
+   * name.
+   */
+  void setPolicers(const ControlPlane::SoftwarePolicers& policers);
+
+  /*
+   * Returns false if the packet should be dropped.
+   */
+  bool admit(const RxPacket* pkt);
+
+  /*
+   * Get the number of packets dropped by the named policer.
+   */
+  uint64_t getDropped(const std::string& name) const;
+
+  /*
+   * Export the number of packets dropped by each policer, and the rate it
+   * admits packets at.
+   */
+  void publishStats() const;
+
+  // The number of sets of policers still allocated, including the one in use
+  size_t numPolicerSets() const;
+
+ private:
+  struct Policer {
+    explicit Policer(const CPUSoftwarePolicer& config);
+
+    const CPUSoftwarePolicer config;
+    folly::TokenBucket bucket;
+    std::atomic<uint64_t> dropped{0};
+  };
+  using Policers = std::vector<std::unique_ptr<Policer>>;
+
+  // Forbidden copy constructor and assignment operator
+  PacketPolicer(PacketPolicer const &) = delete;
+  PacketPolicer& operator=(PacketPolicer const &) = delete;
+
+  /*
+   * The policers in use.  Packets may still be using the previous policers
+   * after they are replaced, so those are retired, and only freed by a later
+   * setPolicers() once no reader is in progress.  Readers count themselves
+   * in readers_ before loading current_, so a reader that isn't counted can
+   * only see the newest policers.
+   */
+  std::atomic<const Policers*> current_{nullptr};
+  mutable std::atomic<uint32_t> readers_{0};
+  mutable std::mutex lock_;
+  std::unique_ptr<Policers> owned_;
+  std::vector<std::unique_ptr<Policers>> retired_;
+};
+
+}} // facebook::fboss
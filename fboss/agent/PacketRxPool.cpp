@@ -0,0 +1,338 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "fboss/agent/PacketRxPool.h"
+
+#include "common/stats/ServiceData.h"
+#include "fboss/agent/RxPacket.h"
+
+#include <folly/Conv.h>
+#include <folly/hash/Hash.h>
+#include <folly/io/IOBuf.h>
+#include <folly/system/ThreadName.h>
+#include <glog/logging.h>
+
+#include <algorithm>
+
+namespace facebook { namespace fboss {
+
+constexpr size_t PacketRxPool::kNumCosQueues;
+constexpr size_t PacketRxPool::kMaxBurst;
+constexpr size_t PacketRxPool::kNoWorker;
+
+using std::chrono::duration_cast;
+using std::chrono::microseconds;
+using std::chrono::steady_clock;
+
+namespace {
+thread_local size_t currentWorkerIdx = PacketRxPool::kNoWorker;
+
+void updateMax(std::atomic<uint64_t>* max, uint64_t value) {
+  auto cur = max->load(std::memory_order_relaxed);
+  while (value > cur &&
+         !max->compare_exchange_weak(cur, value, std::memory_order_relaxed)) {
+  }
+}
+}
+
+PacketRxPool::Worker::Worker(size_t queueSize, size_t strictPriorityCos) {
+  for (auto& queue : queues) {
+    queue = std::make_unique<PacketQueue>(queueSize);
+  }
+  for (size_t cos = 0; cos < kNumCosQueues; ++cos) {
+    turns[cos].store(cos < strictPriorityCos ? cosWeight(cos) : 0);
+  }
+}
+
+PacketRxPool::PacketRxPool(
+    PacketHandler handler,
+    size_t numWorkers,
+    size_t queueSize,
+    size_t stealThreshold,
+    BurstWrapper burstWrapper,
+    size_t strictPriorityCos)
+    : handler_(std::move(handler)),
+      burstWrapper_(std::move(burstWrapper)),
+      stealThreshold_(stealThreshold),
+      strictPriorityCos_(std::min(strictPriorityCos, kNumCosQueues)) {
+  CHECK_GT(numWorkers, 0);
+  CHECK_GT(queueSize, 0);
+  for (size_t idx = 0; idx < numWorkers; ++idx) {
+    workers_.push_back(
+        std::make_unique<Worker>(queueSize, strictPriorityCos_));
+  }
+  for (size_t idx = 0; idx < numWorkers; ++idx) {
+    workers_[idx]->thread = std::thread([this, idx] { workerLoop(idx); });
+  }
+}
+
+PacketRxPool::~PacketRxPool() {
+  stop();
+}
+
+size_t PacketRxPool::cosIndex(const RxPacket* pkt) {
+  auto cos = pkt->cosQueue();
+  if (cos < 0) {
+    return 0;
+  }
+  return std::min(static_cast<size_t>(cos), kNumCosQueues - 1);
+}
+
+size_t PacketRxPool::workerIndex(const RxPacket* pkt) const {
+  if (workers_.size() == 1) {
+    return 0;
+  }
+  // Hash the source MAC, which follows the 6 byte destination MAC, along
+  // with the VLAN the packet was received on.
+  uint64_t key = static_cast<uint16_t>(pkt->getSrcVlan());
+  const auto* buf = pkt->buf();
+  if (buf->length() >= 12) {
+    const auto* data = buf->data();
+    for (size_t idx = 6; idx < 12; ++idx) {
+      key = (key << 8) | data[idx];
+    }
+  }
+  return folly::hash::twang_mix64(key) % workers_.size();
+}
+
+bool PacketRxPool::enqueue(std::unique_ptr<RxPacket> pkt) {
+  if (stopping_.load(std::memory_order_acquire)) {
+    return false;
+  }
+  auto* worker = workers_[workerIndex(pkt.get())].get();
+  auto cos = cosIndex(pkt.get());
+  auto& queue = *worker->queues[cos];
+  // Count the packet before it becomes visible to the workers, so depth
+  // never drops below the number of packets that can be read.
+  auto depth = worker->depth.fetch_add(1) + 1;
+  if (!queue.write(QueuedPacket{std::move(pkt), steady_clock::now()})) {
+    worker->depth.fetch_sub(1);
+    worker->dropped.fetch_add(1, std::memory_order_relaxed);
+    worker->cos[cos].dropped.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+  if (worker->sleeping.load()) {
+    wake(worker, false);
+  }
+  if (stealThreshold_ > 0 && depth >= stealThreshold_) {
+    // Get an idle worker to help out
+    for (const auto& other : workers_) {
+      if (other.get() != worker && other->sleeping.load()) {
+        wake(other.get(), true);
+        break;
+      }
+    }
+  }
+  return true;
+}
+
+void PacketRxPool::wake(Worker* worker, bool steal) {
+  {
+    std::lock_guard<std::mutex> guard(worker->lock);
+    if (steal) {
+      worker->stealRequested = true;
+    }
+  }
+  worker->wakeup.notify_one();
+}
+
+bool PacketRxPool::processOne(Worker* from) {
+  for (size_t cos = kNumCosQueues; cos-- > strictPriorityCos_;) {
+    if (processFrom(from, cos)) {
+      return true;
+    }
+  }
+  // The weighted queues with packets and some of their turn left go
+  // highest first.  Once none has, a new round starts.
+  for (int round = 0; round < 2; ++round) {
+    for (size_t cos = strictPriorityCos_; cos-- > 0;) {
+      auto& turn = from->turns[cos];
+      auto left = turn.load(std::memory_order_relaxed);
+      if (left > 0 && processFrom(from, cos)) {
+        turn.store(left - 1, std::memory_order_relaxed);
+        return true;
+      }
+    }
+    for (size_t cos = 0; cos < strictPriorityCos_; ++cos) {
+      from->turns[cos].store(cosWeight(cos), std::memory_order_relaxed);
+    }
+  }
+  return false;
+}
+
+bool PacketRxPool::processFrom(Worker* from, size_t cos) {
+  QueuedPacket queued;
+  if (!from->queues[cos]->read(queued)) {
+    return false;
+  }
+  from->depth.fetch_sub(1);
+  auto& counters = from->cos[cos];
+  uint64_t waitUs = duration_cast<microseconds>(
+      steady_clock::now() - queued.enqueued).count();
+  counters.waitSumUs.fetch_add(waitUs, std::memory_order_relaxed);
+  counters.numWaits.fetch_add(1, std::memory_order_relaxed);
+  updateMax(&counters.waitMaxUs, waitUs);
+
+  handler_(std::move(queued.pkt));
+  from->processed.fetch_add(1, std::memory_order_relaxed);
+  counters.processed.fetch_add(1, std::memory_order_relaxed);
+  return true;
+}
+
+bool PacketRxPool::canSteal(const Worker* thief) const {
+  if (stealThreshold_ == 0) {
+    return false;
+  }
+  for (const auto& victim : workers_) {
+    if (victim.get() != thief && victim->depth.load() >= stealThreshold_) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool PacketRxPool::steal(Worker* thief) {
+  if (stealThreshold_ == 0) {
+    return false;
+  }
+  for (const auto& victim : workers_) {
+    if (victim.get() == thief ||
+        victim->depth.load(std::memory_order_relaxed) < stealThreshold_) {
+      continue;
+    }
+    if (processOne(victim.get())) {
+      thief->stolen.fetch_add(1, std::memory_order_relaxed);
+      return true;
+    }
+  }
+  return false;
+}
+
+void PacketRxPool::workerLoop(size_t idx) {
+  folly::setThreadName(folly::to<std::string>("fbossRxWorker", idx));
+  currentWorkerIdx = idx;
+  auto* self = workers_[idx].get();
+  while (!stopping_.load(std::memory_order_acquire)) {
+    size_t processed = 0;
+    auto burst = [&] {
+      while (processed < kMaxBurst && (processOne(self) || steal(self))) {
+        ++processed;
+      }
+    };
+    if (burstWrapper_) {
+      burstWrapper_(burst);
+    } else {
+      burst();
+    }
+    if (processed > 0) {
+      continue;
+    }
+    std::unique_lock<std::mutex> guard(self->lock);
+    // Producers check sleeping after updating depth, and we check the depths
+    // after setting sleeping, so at least one of us sees the other.
+    self->sleeping.store(true);
+    self->wakeup.wait(guard, [&] {
+      return stopping_.load(std::memory_order_acquire) ||
+          self->depth.load() > 0 || self->stealRequested || canSteal(self);
+    });
+    self->sleeping.store(false);
+    self->stealRequested = false;
+  }
+}
+
+void PacketRxPool::stop() {
+  if (stopping_.exchange(true)) {
+    return;
+  }
+  for (const auto& worker : workers_) {
+    {
+      std::lock_guard<std::mutex> guard(worker->lock);
+    }
+    worker->wakeup.notify_all();
+  }
+  for (const auto& worker : workers_) {
+    if (worker->thread.joinable()) {
+      worker->thread.join();
+    }
+  }
+  for (const auto& worker : workers_) {
+    for (size_t cos = 0; cos < kNumCosQueues; ++cos) {
+      QueuedPacket queued;
+      while (worker->queues[cos]->read(queued)) {
+        queued.pkt.reset();
+        worker->depth.fetch_sub(1);
+        worker->dropped.fetch_add(1, std::memory_order_relaxed);
+        worker->cos[cos].dropped.fetch_add(1, std::memory_order_relaxed);
+      }
+    }
+  }
+}
+
+size_t PacketRxPool::currentWorker() {
+  return currentWorkerIdx;
+}
+
+PacketRxPool::WorkerStats PacketRxPool::getWorkerStats(size_t worker) const {
+  const auto& w = *workers_.at(worker);
+  WorkerStats stats;
+  stats.queueDepth = w.depth.load(std::memory_order_relaxed);
+  stats.processed = w.processed.load(std::memory_order_relaxed);
+  stats.dropped = w.dropped.load(std::memory_order_relaxed);
+  stats.stolen = w.stolen.load(std::memory_order_relaxed);
+  return stats;
+}
+
+PacketRxPool::CosStats PacketRxPool::getCosStats(size_t cos) const {
+  CosStats stats;
+  for (const auto& worker : workers_) {
+    // The queue size is only approximate while packets are being moved
+    auto size = worker->queues.at(cos)->size();
+    stats.queueDepth += std::max<ssize_t>(size, 0);
+    const auto& counters = worker->cos.at(cos);
+    stats.processed += counters.processed.load(std::memory_order_relaxed);
+    stats.dropped += counters.dropped.load(std::memory_order_relaxed);
+  }
+  stats.lastWaitMaxUs = lastWaitMaxUs_[cos].load(std::memory_order_relaxed);
+  return stats;
+}
+
+void PacketRxPool::publishStats() {
+  for (size_t idx = 0; idx < workers_.size(); ++idx) {
+    auto stats = getWorkerStats(idx);
+    auto prefix = folly::to<std::string>("rx_worker.", idx, ".");
+    fbData->setCounter(prefix + "queue_depth", stats.queueDepth);
+    fbData->setCounter(prefix + "processed", stats.processed);
+    fbData->setCounter(prefix + "dropped", stats.dropped);
+    fbData->setCounter(prefix + "stolen", stats.stolen);
+  }
+  for (size_t cos = 0; cos < kNumCosQueues; ++cos) {
+    auto stats = getCosStats(cos);
+    uint64_t waitSumUs = 0;
+    uint64_t waitMaxUs = 0;
+    uint64_t numWaits = 0;
+    for (const auto& worker : workers_) {
+      auto& counters = worker->cos[cos];
+      waitSumUs += counters.waitSumUs.exchange(0, std::memory_order_relaxed);
+      waitMaxUs = std::max(
+          waitMaxUs,
+          counters.waitMaxUs.exchange(0, std::memory_order_relaxed));
+      numWaits += counters.numWaits.exchange(0, std::memory_order_relaxed);
+    }
+    lastWaitMaxUs_[cos].store(waitMaxUs, std::memory_order_relaxed);
+    auto prefix = folly::to<std::string>("rx_cos.", cos, ".");
+    fbData->setCounter(prefix + "queue_depth", stats.queueDepth);
+    fbData->setCounter(prefix + "processed", stats.processed);
+    fbData->setCounter(prefix + "dropped", stats.dropped);
+    fbData->setCounter(
+        prefix + "wait_avg_us", numWaits ? waitSumUs / numWaits : 0);
+    fbData->setCounter(prefix + "wait_max_us", waitMaxUs);
+  }
+}
+
+}} // facebook::fboss
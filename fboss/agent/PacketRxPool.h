@@ -0,0 +1,185 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#pragma once
+
+#include <folly/Function.h>
+#include <folly/MPMCQueue.h>
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace facebook { namespace fboss {
+
+class RxPacket;
+
+/*
+ * PacketRxPool hands trapped packets off from the threads the HwSwitch
+ * delivers them on to a pool of packet processing workers.
+ *
+ * Each worker has a bounded lock-free queue per CPU CoS queue, so that the
+ * CoS the hardware trapped a packet to is kept in software.  The queues
+ * from strictPriorityCos up are processed in strict priority, highest
+ * first.  The ones below only get a turn when those are empty, and take
+ * turns among themselves, each processing its CoS plus one packets per
+ * round, so that a flood in the lowest queue still leaves room for the
+ * others.  Packets are assigned to
+ * a worker by a hash of their source MAC and VLAN, so packets from any one
+ * neighbor are processed in order.  A worker that has nothing to do takes
+ * packets from any worker whose backlog has reached the steal threshold;
+ * ordering is only relaxed for the packets of a worker that is that far
+ * behind.  Packets that arrive while their queue is full are dropped.
+ *
+ * Workers process up to kMaxBurst packets back to back between looking
+ * for more work, and can run each burst through a wrapper, such as one
+ * that batches the packets sent in response.
+ */
+class PacketRxPool {
+ public:
+  using PacketHandler = std::function<void(std::unique_ptr<RxPacket>)>;
+  using BurstWrapper = std::function<void(folly::FunctionRef<void()> burst)>;
+
+  // The number of CoS queues packets are prioritized by.  Packets with no
+  // CoS information are treated as CoS 0, the lowest priority.
+  static constexpr size_t kNumCosQueues = 8;
+  static constexpr size_t kMaxBurst = 32;
+
+  PacketRxPool(
+      PacketHandler handler,
+      size_t numWorkers,
+      size_t queueSize,
+      size_t stealThreshold,
+      BurstWrapper burstWrapper = nullptr,
+      size_t strictPriorityCos = 0);
+  ~PacketRxPool();
+
+  /*
+   * Queue a packet for processing.  Returns false if the packet was dropped
+   * because its queue was full.
+   */
+  bool enqueue(std::unique_ptr<RxPacket> pkt);
+
+  /*
+   * Stop the workers, dropping any packets still queued.
+   */
+  void stop();
+
+  size_t numWorkers() const {
+    return workers_.size();
+  }
+
+  /*
+   * The index of the worker running on this thread, or kNoWorker if this
+   * isn't a worker thread.  Per worker resources, such as the queues of the
+   * tun interfaces, are picked with this.
+   */
+  static constexpr size_t kNoWorker = static_cast<size_t>(-1);
+  static size_t currentWorker();
+
+  struct WorkerStats {
+    uint64_t queueDepth{0};
+    uint64_t processed{0};
+    uint64_t dropped{0};
+    uint64_t stolen{0};
+  };
+  WorkerStats getWorkerStats(size_t worker) const;
+
+  // The packets of a CoS queue, over all the workers
+  struct CosStats {
+    uint64_t queueDepth{0};
+    uint64_t processed{0};
+    uint64_t dropped{0};
+    // The longest wait of a packet in the interval before the last
+    // publishStats()
+    uint64_t lastWaitMaxUs{0};
+  };
+  CosStats getCosStats(size_t cos) const;
+
+  /*
+   * Export the per worker and per CoS queue depth and packet counters, and
+   * how long the packets of each CoS waited in their queues since the last
+   * call.
+   */
+  void publishStats();
+
+ private:
+  struct QueuedPacket {
+    std::unique_ptr<RxPacket> pkt;
+    std::chrono::steady_clock::time_point enqueued;
+  };
+  using PacketQueue = folly::MPMCQueue<QueuedPacket>;
+
+  struct CosCounters {
+    std::atomic<uint64_t> processed{0};
+    std::atomic<uint64_t> dropped{0};
+    // Since the last publishStats()
+    std::atomic<uint64_t> waitSumUs{0};
+    std::atomic<uint64_t> waitMaxUs{0};
+    std::atomic<uint64_t> numWaits{0};
+  };
+
+  struct Worker {
+    Worker(size_t queueSize, size_t strictPriorityCos);
+
+    std::array<std::unique_ptr<PacketQueue>, kNumCosQueues> queues;
+    std::array<CosCounters, kNumCosQueues> cos;
+    // What is left of the turn of each weighted queue in this round.  The
+    // thieves of a worker's packets update these too, so turns are only
+    // roughly kept to.
+    std::array<std::atomic<uint32_t>, kNumCosQueues> turns;
+    std::atomic<size_t> depth{0};
+    std::atomic<uint64_t> processed{0};
+    std::atomic<uint64_t> dropped{0};
+    std::atomic<uint64_t> stolen{0};
+
+    // Sleeping is set while the worker waits on wakeup for packets to
+    // arrive.  Producers only take lock to wake a sleeping worker.
+    std::atomic<bool> sleeping{false};
+    bool stealRequested{false};
+    std::mutex lock;
+    std::condition_variable wakeup;
+    std::thread thread;
+  };
+
+  // Forbidden copy constructor and assignment operator
+  PacketRxPool(PacketRxPool const &) = delete;
+  PacketRxPool& operator=(PacketRxPool const &) = delete;
+
+  static size_t cosIndex(const RxPacket* pkt);
+  // The packets per round of a queue below strictPriorityCos
+  static uint32_t cosWeight(size_t cos) {
+    return cos + 1;
+  }
+  size_t workerIndex(const RxPacket* pkt) const;
+
+  void workerLoop(size_t idx);
+  // Process the next packet queued on from, if any, as scheduled
+  bool processOne(Worker* from);
+  bool processFrom(Worker* from, size_t cos);
+  bool canSteal(const Worker* thief) const;
+  bool steal(Worker* thief);
+  void wake(Worker* worker, bool steal);
+
+  PacketHandler handler_;
+  BurstWrapper burstWrapper_;
+  const size_t stealThreshold_;
+  const size_t strictPriorityCos_;
+  std::vector<std::unique_ptr<Worker>> workers_;
+  std::array<std::atomic<uint64_t>, kNumCosQueues> lastWaitMaxUs_{};
+  std::atomic<bool> stopping_{false};
+};
+
+}} // facebook::fboss
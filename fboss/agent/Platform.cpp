@@ -19,6 +19,12 @@ DEFINE_string(crash_switch_state_file, "crash_switch_state",
 DEFINE_string(crash_hw_state_file, "crash_hw_state",
               "File for dumping HW state on crash");
 
+DEFINE_string(crash_event_trace_file, "crash_event_trace",
+              "File for dumping the event trace on crash");
+
+DEFINE_string(startup_trace_file, "startup_trace.json",
+              "File for dumping the startup phase timeline, as a Chrome trace");
+
 namespace facebook { namespace fboss {
 
 std::string Platform::getCrashHwStateFile() const {
@@ -29,4 +35,12 @@ std::string Platform::getCrashSwitchStateFile() const {
   return getCrashInfoDir() + "/" + FLAGS_crash_switch_state_file;
 }
 
+std::string Platform::getCrashEventTraceFile() const {
+  return getCrashInfoDir() + "/" + FLAGS_crash_event_trace_file;
+}
+
+std::string Platform::getStartupTraceFile() const {
+  return getVolatileStateDir() + "/" + FLAGS_startup_trace_file;
+}
+
 }} //facebook::fboss
@@ -119,6 +119,13 @@ class Platform {
   std::string getWarmBootDir() const {
     return getVolatileStateDir() + "/warm_boot";
   }
+  /*
+   * Get filename for where the times of the warm boot exit are stored for
+   * the next boot
+   */
+  std::string getWarmBootTimelineFile() const {
+    return getWarmBootDir() + "/warm_boot_timeline.json";
+  }
   /*
    * Get filename for where we dump hw state on crash
    */
@@ -127,6 +134,15 @@ class Platform {
    * Get filename for where we dump switch state on crash
    */
   std::string getCrashSwitchStateFile() const;
+  /*
+   * Get filename for where we dump the event trace on crash
+   */
+  std::string getCrashEventTraceFile() const;
+  /*
+   * Get filename for where we dump the startup timeline once the FIB is
+   * first synced
+   */
+  std::string getStartupTraceFile() const;
   /*
    * For a specific logical port, return the transceiver and channel
    * it represents if available
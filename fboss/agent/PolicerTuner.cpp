@@ -0,0 +1,121 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "fboss/agent/PolicerTuner.h"
+
+#include <algorithm>
+
+DEFINE_int32(policer_tuning_interval_s, 5,
+             "How often to tune the rates of the CPU software policers that "
+             "have bounds configured, or 0 to not tune them");
+DEFINE_int64(policer_tuning_max_wait_us, 2000,
+             "The longest the CPU receive queues may make a packet wait "
+             "before the CPU is considered backlogged for policer tuning");
+
+namespace facebook { namespace fboss {
+
+namespace {
+
+// The change in a counter, which starts over if it went backwards
+uint64_t counterDelta(uint64_t now, uint64_t last) {
+  return now >= last ? now - last : now;
+}
+
+} // unnamed namespace
+
+std::vector<PolicerTuner::Adjustment> PolicerTuner::update(
+    const ControlPlane::SoftwarePolicers& policers,
+    const Telemetry& telemetry,
+    Clock::time_point now) {
+  std::vector<Adjustment> adjustments;
+  queueWaitMaxUs_ = std::max(queueWaitMaxUs_, telemetry.queueWaitMaxUs);
+  if (FLAGS_policer_tuning_interval_s <= 0) {
+    return adjustments;
+  }
+  if (started_ &&
+      now - lastUpdate_ <
+          std::chrono::seconds(FLAGS_policer_tuning_interval_s)) {
+    return adjustments;
+  }
+
+  // The first update only takes the counters to measure the next from
+  if (started_) {
+    bool backlogged =
+        counterDelta(telemetry.queueDrops, lastQueueDrops_) > 0 ||
+        queueWaitMaxUs_ > FLAGS_policer_tuning_max_wait_us;
+    for (const auto& policer : policers) {
+      if (!policer.isTuned()) {
+        continue;
+      }
+      uint64_t drops = 0;
+      auto it = telemetry.policerDrops.find(policer.name);
+      if (it != telemetry.policerDrops.end()) {
+        auto last = lastPolicerDrops_.find(policer.name);
+        drops = counterDelta(
+            it->second, last == lastPolicerDrops_.end() ? 0 : last->second);
+      }
+
+      auto rate = policer.currentPacketsPerSec();
+      auto target = rate;
+      const char* reason = nullptr;
+      if (backlogged && drops > 0) {
+        target = std::max(policer.minPacketsPerSec, rate / 2);
+        reason = "CPU backlogged while dropping packets";
+      } else if (backlogged) {
+        target = std::min(policer.packetsPerSec, rate);
+        reason = "CPU backlogged, giving up headroom";
+      } else if (drops > 0) {
+        target = std::min<uint64_t>(
+            policer.maxPacketsPerSec, rate + std::max<uint32_t>(rate / 2, 1));
+        reason = "dropping packets while CPU keeps up";
+      } else if (rate > policer.packetsPerSec) {
+        target = rate - (rate - policer.packetsPerSec + 1) / 2;
+        reason = "idle, returning to configured rate";
+      } else if (rate < policer.packetsPerSec) {
+        target = rate + (policer.packetsPerSec - rate + 1) / 2;
+        reason = "idle, returning to configured rate";
+      }
+      if (target != rate) {
+        adjustments.push_back(Adjustment{policer.name, rate, target, reason});
+      }
+    }
+  }
+
+  started_ = true;
+  lastUpdate_ = now;
+  lastQueueDrops_ = telemetry.queueDrops;
+  queueWaitMaxUs_ = 0;
+  lastPolicerDrops_ = telemetry.policerDrops;
+  return adjustments;
+}
+
+ControlPlane::SoftwarePolicers PolicerTuner::applyAdjustments(
+    const ControlPlane::SoftwarePolicers& policers,
+    const std::vector<Adjustment>& adjustments) {
+  auto newPolicers = policers;
+  for (auto& policer : newPolicers) {
+    for (const auto& adjustment : adjustments) {
+      if (adjustment.name != policer.name || !policer.isTuned() ||
+          adjustment.oldPacketsPerSec != policer.currentPacketsPerSec() ||
+          adjustment.newPacketsPerSec < policer.minPacketsPerSec ||
+          adjustment.newPacketsPerSec > policer.maxPacketsPerSec) {
+        continue;
+      }
+      if (adjustment.newPacketsPerSec == policer.packetsPerSec) {
+        policer.tunedPacketsPerSec = folly::none;
+      } else {
+        policer.tunedPacketsPerSec = adjustment.newPacketsPerSec;
+      }
+      break;
+    }
+  }
+  return newPolicers;
+}
+
+}} // facebook::fboss
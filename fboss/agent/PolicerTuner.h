@@ -0,0 +1,102 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#pragma once
+
+#include "fboss/agent/state/ControlPlane.h"
+
+#include <gflags/gflags.h>
+
+#include <chrono>
+#include <map>
+#include <string>
+#include <vector>
+
+DECLARE_int32(policer_tuning_interval_s);
+DECLARE_int64(policer_tuning_max_wait_us);
+
+namespace facebook { namespace fboss {
+
+/*
+ * PolicerTuner is the control loop that tunes the rates of the CPU software
+ * policers within their configured bounds, as the load on the CPU allows.
+ *
+ * Every policer_tuning_interval_s it looks at how many packets each tuned
+ * policer dropped over the interval, and whether the CPU was backlogged:
+ * whether the receive queues dropped packets, or a packet waited in them
+ * for longer than policer_tuning_max_wait_us.
+ *
+ *  - While the CPU keeps up, a policer that drops packets is given more
+ *    headroom, such as for ARP while a rack boots.
+ *  - While it is backlogged, a policer that drops packets, and so is
+ *    admitting all it may, is tightened, such as for a traceroute storm.
+ *    Other policers give up the headroom they were given.
+ *  - A policer that doesn't drop packets while the CPU keeps up drifts back
+ *    to its configured rate.
+ *
+ * Rates go up by half and down by half, so that a policer backs off quickly
+ * and recovers more slowly.  It only works out the rates: the caller applies
+ * them to the ControlPlane, and logs them.
+ */
+class PolicerTuner {
+ public:
+  typedef std::chrono::steady_clock Clock;
+
+  struct Telemetry {
+    // The packets each policer dropped, by name, since it was configured
+    std::map<std::string, uint64_t> policerDrops;
+    // The packets the receive queues dropped
+    uint64_t queueDrops{0};
+    // The longest wait of a packet in the receive queues since the last
+    // update
+    uint64_t queueWaitMaxUs{0};
+  };
+
+  struct Adjustment {
+    std::string name;
+    uint32_t oldPacketsPerSec{0};
+    uint32_t newPacketsPerSec{0};
+    std::string reason;
+  };
+
+  PolicerTuner() {}
+
+  /*
+   * Called from the stats thread after each stats update.  Does nothing
+   * until an interval has passed since the last tuning, and otherwise
+   * returns the policers whose rates are to change.
+   */
+  std::vector<Adjustment> update(
+      const ControlPlane::SoftwarePolicers& policers,
+      const Telemetry& telemetry,
+      Clock::time_point now);
+
+  /*
+   * The policers with the adjusted rates.  Adjustments to policers that
+   * have since been removed or reconfigured are left out.
+   */
+  static ControlPlane::SoftwarePolicers applyAdjustments(
+      const ControlPlane::SoftwarePolicers& policers,
+      const std::vector<Adjustment>& adjustments);
+
+ private:
+  // Forbidden copy constructor and assignment operator
+  PolicerTuner(PolicerTuner const &) = delete;
+  PolicerTuner& operator=(PolicerTuner const &) = delete;
+
+  // Only used from the stats thread
+  bool started_{false};
+  Clock::time_point lastUpdate_;
+  // The telemetry as of the last tuning, with the longest queue wait since
+  uint64_t lastQueueDrops_{0};
+  uint64_t queueWaitMaxUs_{0};
+  std::map<std::string, uint64_t> lastPolicerDrops_;
+};
+
+}} // facebook::fboss
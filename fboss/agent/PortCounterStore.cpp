@@ -0,0 +1,143 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "fboss/agent/PortCounterStore.h"
+
+#include <folly/Conv.h>
+#include <glog/logging.h>
+
+using facebook::stats::SUM;
+
+namespace facebook { namespace fboss {
+
+namespace {
+
+constexpr const char* kPortCounterNames[] = {
+  "trapped.pkts",
+  "trapped.drops",
+  "trapped.bogus",
+  "trapped.error",
+  "trapped.unhandled",
+  "host.rx",
+  "host.rx.bytes",
+  "trapped.arp",
+  "arp.unsupported",
+  "arp.not_mine",
+  "arp.request.rx",
+  "arp.request.tx",
+  "arp.reply.rx",
+  "arp.reply.tx",
+  "arp.bad_op",
+  "trapped.ndp",
+  "ipv6.ndp.bad",
+  "trapped.ipv4",
+  "ipv4.too_small",
+  "ipv4.wrong_version",
+  "ipv4.nexthop",
+  "ipv4.mine",
+  "ipv4.no_arp",
+  "ipv4.ttl_exceeded",
+  "udp.too_small",
+  "ipv6.hop_exceeded",
+  "icmp_error.rate_limited",
+  "dhcpV4.pkt",
+  "dhcpV4.bad_pkt",
+  "dhcpV4.drop_pkt",
+  "dhcpV6.pkt",
+  "dhcpV6.bad_pkt",
+  "dhcpV6.drop_pkt",
+  "link_state.flap",
+  "ipv4.dst_lookup_failure",
+  "ipv6.dst_lookup_failure",
+  "trapped.ptb",
+};
+static_assert(sizeof(kPortCounterNames) / sizeof(kPortCounterNames[0]) ==
+                  kNumPortCounters,
+              "every PortCounter needs a name");
+
+} // unnamed namespace
+
+const char* portCounterName(PortCounter counter) {
+  auto idx = static_cast<size_t>(counter);
+  CHECK_LT(idx, kNumPortCounters);
+  return kPortCounterNames[idx];
+}
+
+PortCounterStore::Row::Row() {
+  for (auto& value : values) {
+    value.store(0, std::memory_order_relaxed);
+  }
+}
+
+PortCounterStore::PortCounterStore(
+    stats::ThreadCachedServiceData::ThreadLocalStatsMap* map)
+    : TLStat(map, "port_counters") {
+  link();
+}
+
+PortCounterStore::~PortCounterStore() {
+  unlink();
+}
+
+PortCounterStore::Row* PortCounterStore::getRow(PortID port,
+                                                const std::string& portName) {
+  std::lock_guard<folly::SpinLock> g(lock_);
+  auto& entry = entries_[port];
+  if (!entry.row) {
+    entry.row = std::make_unique<Row>();
+  }
+  entry.name = portName;
+  return entry.row.get();
+}
+
+void PortCounterStore::setPortName(PortID port, const std::string& portName) {
+  std::lock_guard<folly::SpinLock> g(lock_);
+  auto it = entries_.find(port);
+  if (it != entries_.end()) {
+    it->second.name = portName;
+  }
+}
+
+void PortCounterStore::aggregate(stats::StatsTimePoint now) {
+  // Rows are only added under lock_, and the owning thread only takes it
+  // for that, so holding it here doesn't slow down the packet path
+  std::lock_guard<folly::SpinLock> g(lock_);
+  auto statMap = fbData->getStatMap();
+  for (auto& it : entries_) {
+    auto& entry = it.second;
+    if (entry.exportedName != entry.name) {
+      // Anything not aggregated yet goes to the new name
+      entry.exportedName = entry.name;
+      entry.hasStat.fill(false);
+      entry.stats.fill(stats::ExportedStatMap::LockableStat());
+    }
+    for (size_t idx = 0; idx < kNumPortCounters; ++idx) {
+      auto value = entry.row->values[idx].load(std::memory_order_relaxed);
+      auto delta = value - entry.aggregated[idx];
+      if (!delta) {
+        continue;
+      }
+      entry.aggregated[idx] = value;
+      if (entry.exportedName.empty()) {
+        continue;
+      }
+      if (!entry.hasStat[idx]) {
+        const auto type = SUM;
+        entry.stats[idx] = statMap->getLockableStat(
+            folly::to<std::string>(entry.exportedName, ".",
+                                   kPortCounterNames[idx]),
+            &type);
+        entry.hasStat[idx] = true;
+      }
+      entry.stats[idx].addValue(now, delta);
+    }
+  }
+}
+
+}} // facebook::fboss
@@ -0,0 +1,144 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <map>
+#include <memory>
+#include <string>
+
+#include "common/stats/ThreadCachedServiceData.h"
+#include "fboss/agent/types.h"
+
+namespace facebook { namespace fboss {
+
+/*
+ * The counters kept for each port, exported as "<portName>.<name>.sum".
+ */
+enum class PortCounter : uint8_t {
+  TRAPPED_PKTS,
+  TRAPPED_DROPS,
+  TRAPPED_BOGUS,
+  TRAPPED_ERROR,
+  TRAPPED_UNHANDLED,
+  HOST_RX,
+  HOST_RX_BYTES,
+  ARP,
+  ARP_UNSUPPORTED,
+  ARP_NOT_MINE,
+  ARP_REQUEST_RX,
+  ARP_REQUEST_TX,
+  ARP_REPLY_RX,
+  ARP_REPLY_TX,
+  ARP_BAD_OP,
+  NDP,
+  NDP_BAD,
+  IPV4_RX,
+  IPV4_TOO_SMALL,
+  IPV4_WRONG_VER,
+  IPV4_NEXTHOP,
+  IPV4_MINE,
+  IPV4_NO_ARP,
+  IPV4_TTL_EXCEEDED,
+  UDP_TOO_SMALL,
+  IPV6_HOP_EXCEEDED,
+  ICMP_RATE_LIMITED,
+  DHCPV4,
+  DHCPV4_BAD,
+  DHCPV4_DROP,
+  DHCPV6,
+  DHCPV6_BAD,
+  DHCPV6_DROP,
+  LINK_STATE_FLAP,
+  IPV4_DST_LOOKUP_FAILURE,
+  IPV6_DST_LOOKUP_FAILURE,
+  TRAPPED_PTB,
+  NUM_COUNTERS
+};
+
+constexpr size_t kNumPortCounters =
+    static_cast<size_t>(PortCounter::NUM_COUNTERS);
+
+const char* portCounterName(PortCounter counter);
+
+/*
+ * The per port counters of one SwitchStats, i.e. of one thread.
+ *
+ * Each port gets a row with a slot for every PortCounter, so the counters a
+ * packet bumps on its way through the handlers sit next to each other,
+ * rather than in a stat object of their own each.  The row is only written
+ * by the thread that owns the store, so an update is a relaxed load and
+ * store, without a lock or a locked instruction.
+ *
+ * aggregate() runs with the other thread local stats, and adds what changed
+ * since the last time to the ServiceData stats of the port.  Those are only
+ * created once a counter is first bumped, so ports don't export counters
+ * that never moved.
+ */
+class PortCounterStore
+    : public stats::ThreadCachedServiceData::ThreadLocalStatsMap::TLStat {
+ public:
+  struct Row {
+    Row();
+
+    std::array<std::atomic<uint64_t>, kNumPortCounters> values;
+  };
+
+  explicit PortCounterStore(
+      stats::ThreadCachedServiceData::ThreadLocalStatsMap* map);
+  ~PortCounterStore() override;
+
+  /*
+   * The row of a port, created the first time it is asked for.  Rows live
+   * as long as the store, so a port that comes back gets its old row.  Only
+   * the thread that owns the store may call this, or setPortName().
+   */
+  Row* getRow(PortID port, const std::string& portName);
+  void setPortName(PortID port, const std::string& portName);
+
+  template <PortCounter counter>
+  static void add(Row* row, uint64_t value = 1) {
+    static_assert(counter < PortCounter::NUM_COUNTERS, "invalid counter");
+    auto& slot = row->values[static_cast<size_t>(counter)];
+    slot.store(slot.load(std::memory_order_relaxed) + value,
+               std::memory_order_relaxed);
+  }
+
+  /*
+   * The value of a counter that hasn't been aggregated yet.
+   */
+  static uint64_t get(const Row* row, PortCounter counter) {
+    return row->values[static_cast<size_t>(counter)].load(
+        std::memory_order_relaxed);
+  }
+
+ private:
+  struct Entry {
+    std::unique_ptr<Row> row;
+    // Under lock_
+    std::string name;
+    // Only used by aggregate()
+    std::string exportedName;
+    std::array<uint64_t, kNumPortCounters> aggregated{};
+    std::array<stats::ExportedStatMap::LockableStat, kNumPortCounters> stats;
+    std::array<bool, kNumPortCounters> hasStat{};
+  };
+
+  // Forbidden copy constructor and assignment operator
+  PortCounterStore(PortCounterStore const &) = delete;
+  PortCounterStore& operator=(PortCounterStore const &) = delete;
+
+  void aggregate(stats::StatsTimePoint now) override;
+
+  std::map<PortID, Entry> entries_;
+};
+
+}} // facebook::fboss
@@ -16,9 +16,29 @@
 #include "fboss/agent/state/SwitchState.h"
 
 #include <folly/futures/Future.h>
+#include <folly/logging/xlog.h>
+#include <gflags/gflags.h>
+
+#include <algorithm>
+
+DEFINE_int32(port_remediation_delay_ms, 10000,
+             "How long a port must stay down before it is first "
+             "remediated");
+DEFINE_int32(port_remediation_max_backoff_ms, 600000,
+             "The longest to wait between remediations of a port, as the "
+             "wait doubles after each");
+DEFINE_int32(port_remediation_max_concurrent, 4,
+             "The most ports to remediate at once. The others due wait "
+             "for the next round");
+DEFINE_bool(port_remediation_flap, false,
+            "Remediate a port by disabling and enabling it again. If not "
+            "set, remediation only tracks the ports due and does nothing "
+            "to them");
 
 namespace {
-constexpr int kPortRemedyIntervalSec = 25;
+// Between the rounds of remediation when more ports are due than are
+// remediated at once
+constexpr std::chrono::seconds kRemedySpacing(1);
 }
 
 using facebook::fboss::SwSwitch;
@@ -39,24 +59,146 @@ PortRemediator::getUnexpectedDownPorts() const {
   return unexpectedDownPorts;
 }
 
-void PortRemediator::remediatePorts() {
-  // fill in if we need to operate on unexpectedly down ports
-  // sample would be something like:
-  //
-  // auto downPorts = getUnexpectedDownPorts();
-  // for (auto down : downPorts) doSomething
+void PortRemediator::addCandidate(PortID port, Clock::time_point now) {
+  if (candidates_.find(port) == candidates_.end()) {
+    resetCandidate(port, now);
+  }
+}
+
+void PortRemediator::resetCandidate(PortID port, Clock::time_point now) {
+  auto delay = std::chrono::milliseconds(
+      std::max(FLAGS_port_remediation_delay_ms, 1));
+  candidates_[port] = Candidate{now + delay, delay, 0};
+}
+
+void PortRemediator::remediatePorts(Clock::time_point now) {
+  const auto maxBackoff = std::chrono::milliseconds(
+      std::max(FLAGS_port_remediation_max_backoff_ms, 1));
+  const auto portMap = sw_->getState()->getPorts();
+  int remediated = 0;
+  for (auto itr = candidates_.begin(); itr != candidates_.end();) {
+    auto port = portMap->getPortIf(itr->first);
+    // The port came up or was disabled before we heard of it
+    if (!port || !port->isEnabled() || port->isUp()) {
+      itr = candidates_.erase(itr);
+      continue;
+    }
+    auto& candidate = itr->second;
+    if (candidate.due <= now &&
+        remediated < FLAGS_port_remediation_max_concurrent) {
+      ++candidate.attempts;
+      XLOG(DBG1) << "Remediating port " << itr->first << ", attempt "
+                 << candidate.attempts;
+      remedy_(itr->first);
+      ++remediated;
+      candidate.due = now + candidate.backoff;
+      candidate.backoff = std::min(candidate.backoff * 2, maxBackoff);
+    }
+    ++itr;
+  }
+  if (remediated > 0) {
+    XLOG(INFO) << "Remediated " << remediated << " ports, "
+               << candidates_.size() << " still down";
+  }
+}
+
+void PortRemediator::scheduleNext() {
+  if (candidates_.empty()) {
+    cancelTimeout();
+    return;
+  }
+  auto due = std::min_element(
+      candidates_.begin(),
+      candidates_.end(),
+      [](const auto& a, const auto& b) {
+        return a.second.due < b.second.due;
+      })->second.due;
+  auto delay = std::chrono::duration_cast<std::chrono::milliseconds>(
+      due - Clock::now());
+  scheduleTimeout(std::max<std::chrono::milliseconds>(delay, kRemedySpacing));
+}
+
+void PortRemediator::flapPort(PortID portId) {
+  if (!FLAGS_port_remediation_flap) {
+    return;
+  }
+  // Two updates back to back, so that the hardware sees the port go down
+  // and come back up.  Only a port we disabled is enabled again, in case
+  // it was reconfigured in the meantime.
+  auto disabled = std::make_shared<bool>(false);
+  auto disable = [portId, disabled](const std::shared_ptr<SwitchState>& state) {
+    std::shared_ptr<SwitchState> newState(state);
+    auto* port = newState->getPorts()->getPortIf(portId).get();
+    if (!port || !port->isEnabled()) {
+      return std::shared_ptr<SwitchState>();
+    }
+    port = port->modify(&newState);
+    port->setAdminState(cfg::PortState::DISABLED);
+    *disabled = true;
+    return newState;
+  };
+  auto enable = [portId, disabled](const std::shared_ptr<SwitchState>& state) {
+    std::shared_ptr<SwitchState> newState(state);
+    auto* port = newState->getPorts()->getPortIf(portId).get();
+    if (!*disabled || !port) {
+      return std::shared_ptr<SwitchState>();
+    }
+    port = port->modify(&newState);
+    port->setAdminState(cfg::PortState::ENABLED);
+    return newState;
+  };
+  sw_->updateState("Port remediation: disable", std::move(disable));
+  sw_->updateState("Port remediation: enable", std::move(enable));
+}
+
+void PortRemediator::portLinkChanged(PortID port, bool up) {
+  sw_->getBackgroundEvb()->runInEventBaseThread([this, port, up]() {
+    if (up) {
+      candidates_.erase(port);
+    } else {
+      addCandidate(port, Clock::now());
+    }
+    scheduleNext();
+  });
+}
+
+void PortRemediator::transceiversChanged(
+    const std::vector<TransceiverID>& tcvrs) {
+  sw_->getBackgroundEvb()->runInEventBaseThread([this, tcvrs]() {
+    auto now = Clock::now();
+    bool changed = false;
+    for (const auto& entry : candidates_) {
+      auto platformPort = sw_->getPlatform()->getPlatformPort(entry.first);
+      auto tcvr = platformPort ? platformPort->getTransceiverID()
+                               : folly::none;
+      if (tcvr &&
+          std::find(tcvrs.begin(), tcvrs.end(), *tcvr) != tcvrs.end()) {
+        resetCandidate(entry.first, now);
+        changed = true;
+      }
+    }
+    if (changed) {
+      scheduleNext();
+    }
+  });
 }
 
 void PortRemediator::timeoutExpired() noexcept {
-  remediatePorts();
-  scheduleTimeout(interval_);
+  remediatePorts(Clock::now());
+  scheduleNext();
 }
 
 PortRemediator::PortRemediator(SwSwitch* swSwitch)
+    : PortRemediator(swSwitch, nullptr) {}
+
+PortRemediator::PortRemediator(SwSwitch* swSwitch, RemedyFn remedy)
     : AsyncTimeout(swSwitch->getBackgroundEvb()),
       sw_(swSwitch),
-      interval_(kPortRemedyIntervalSec) {
-};
+      remedy_(std::move(remedy)) {
+  if (!remedy_) {
+    remedy_ = [this](PortID port) { flapPort(port); };
+  }
+}
 
 void PortRemediator::init() {
   // Schedule the port remedy handler to run
@@ -14,6 +14,9 @@
 #include <gtest/gtest_prod.h>
 
 #include <chrono>
+#include <functional>
+#include <map>
+#include <vector>
 #include <folly/io/async/AsyncTimeout.h>
 
 #include "fboss/agent/SwSwitch.h"
@@ -22,14 +25,36 @@
 
 namespace facebook { namespace fboss {
 
+/*
+ * PortRemediator flaps the ports that are enabled but stay down, in the
+ * hope of bringing them back up.
+ *
+ * Rather than scan all ports periodically, it keeps the ports that went
+ * down as candidates, told of them by link state changes.  Only when a
+ * candidate is due does the timer run, so nothing is done while all ports
+ * are up.  Each candidate is remediated with exponential backoff between
+ * attempts, and at most --port_remediation_max_concurrent ports at a time.
+ * A change of the transceiver of a candidate, e.g. a new module, resets
+ * its backoff and makes it due soon again.
+ *
+ * All the candidate state is on the background thread.
+ */
 class PortRemediator : private folly::AsyncTimeout {
  public:
+  using RemedyFn = std::function<void(PortID)>;
+
   explicit PortRemediator(SwSwitch* swSwitch);
+  // For tests, to see what is remediated rather than flap the ports
+  PortRemediator(SwSwitch* swSwitch, RemedyFn remedy);
   ~PortRemediator() override;
 
   static void start(void *arg) {
     auto me = static_cast<PortRemediator*>(arg);
-    me->scheduleTimeout(me->interval_);
+    // Ports that were down from the start never changed state
+    for (auto port : me->getUnexpectedDownPorts()) {
+      me->addCandidate(port, std::chrono::steady_clock::now());
+    }
+    me->scheduleNext();
   }
 
   static void stop(void* arg) {
@@ -40,17 +65,42 @@ class PortRemediator : private folly::AsyncTimeout {
   void timeoutExpired() noexcept override;
   void init();
 
+  // May be called from any thread
+  void portLinkChanged(PortID port, bool up);
+  void transceiversChanged(const std::vector<TransceiverID>& tcvrs);
+
   // testing
   FRIEND_TEST(PortRemediatorTest, AllEnabledAndUp);
   FRIEND_TEST(PortRemediatorTest, OneEnabledAndDown);
   FRIEND_TEST(PortRemediatorTest, OneDisabledAndDown);
+  FRIEND_TEST(PortRemediatorTest, Backoff);
+  FRIEND_TEST(PortRemediatorTest, ConcurrencyLimit);
+  FRIEND_TEST(PortRemediatorTest, UpOrDisabledDropped);
+  FRIEND_TEST(PortRemediatorTest, TransceiverResetsBackoff);
 
  private:
+  using Clock = std::chrono::steady_clock;
+
+  struct Candidate {
+    // When to remediate the port next
+    Clock::time_point due;
+    // How long to wait after the next attempt
+    std::chrono::milliseconds backoff;
+    uint32_t attempts{0};
+  };
+
   boost::container::flat_set<PortID> getUnexpectedDownPorts() const;
-  void remediatePorts();
+  // Keeps the backoff of a port that is already a candidate
+  void addCandidate(PortID port, Clock::time_point now);
+  void resetCandidate(PortID port, Clock::time_point now);
+  void remediatePorts(Clock::time_point now);
+  // Schedules the timer for the earliest candidate, if any
+  void scheduleNext();
+  void flapPort(PortID port);
 
   SwSwitch* sw_;
-  std::chrono::seconds interval_;
+  RemedyFn remedy_;
+  std::map<PortID, Candidate> candidates_;
 };
 
 } // fboss
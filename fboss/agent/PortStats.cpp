@@ -12,19 +12,19 @@
 #include "common/stats/ThreadCachedServiceData.h"
 #include <folly/String.h>
 
-using facebook::stats::SUM;
-
 namespace facebook { namespace fboss {
 
 const std::string kNameKeySeperator = ".";
 const std::string kUp = "up";
-const std::string kLinkStateFlap = "link_state.flap";
+const std::string kLinkFlapPenalty = "link_flap_penalty";
+const std::string kLinkFlapSuppressed = "link_flap_suppressed";
 
 PortStats::PortStats(PortID portID, std::string portName,
                      SwitchStats *switchStats)
   : portID_(portID),
     portName_(portName),
-    switchStats_(switchStats) {
+    switchStats_(switchStats),
+    counters_(switchStats->getPortCounters()->getRow(portID, portName_)) {
 }
 
 PortStats::~PortStats() {
@@ -36,131 +36,159 @@ void PortStats::setPortName(const std::string &portName) {
   // clear counter
   clearPortStatusCounter();
   portName_ = portName;
+  switchStats_->getPortCounters()->setPortName(portID_, portName_);
 }
 
 void PortStats::trappedPkt() {
+  PortCounterStore::add<PortCounter::TRAPPED_PKTS>(counters_);
   switchStats_->trappedPkt();
 }
 void PortStats::pktDropped() {
+  PortCounterStore::add<PortCounter::TRAPPED_DROPS>(counters_);
   switchStats_->pktDropped();
 }
 void PortStats::pktBogus() {
+  PortCounterStore::add<PortCounter::TRAPPED_BOGUS>(counters_);
   switchStats_->pktBogus();
 }
 void PortStats::pktError() {
+  PortCounterStore::add<PortCounter::TRAPPED_ERROR>(counters_);
   switchStats_->pktError();
 }
 void PortStats::pktUnhandled() {
+  PortCounterStore::add<PortCounter::TRAPPED_UNHANDLED>(counters_);
   switchStats_->pktUnhandled();
 }
 void PortStats::pktToHost(uint32_t bytes) {
+  PortCounterStore::add<PortCounter::HOST_RX>(counters_);
+  PortCounterStore::add<PortCounter::HOST_RX_BYTES>(counters_, bytes);
   switchStats_->pktToHost(bytes);
 }
 
 void PortStats::arpPkt() {
+  PortCounterStore::add<PortCounter::ARP>(counters_);
   switchStats_->arpPkt();
 }
 void PortStats::arpUnsupported() {
+  PortCounterStore::add<PortCounter::ARP_UNSUPPORTED>(counters_);
   switchStats_->arpUnsupported();
 }
 void PortStats::arpNotMine() {
+  PortCounterStore::add<PortCounter::ARP_NOT_MINE>(counters_);
   switchStats_->arpNotMine();
 }
 void PortStats::arpRequestRx() {
+  PortCounterStore::add<PortCounter::ARP_REQUEST_RX>(counters_);
   switchStats_->arpRequestRx();
 }
 void PortStats::arpRequestTx() {
+  PortCounterStore::add<PortCounter::ARP_REQUEST_TX>(counters_);
   switchStats_->arpRequestTx();
 }
 void PortStats::arpReplyRx() {
+  PortCounterStore::add<PortCounter::ARP_REPLY_RX>(counters_);
   switchStats_->arpReplyRx();
 }
 void PortStats::arpReplyTx() {
+  PortCounterStore::add<PortCounter::ARP_REPLY_TX>(counters_);
   switchStats_->arpReplyTx();
 }
 void PortStats::arpBadOp() {
+  PortCounterStore::add<PortCounter::ARP_BAD_OP>(counters_);
   switchStats_->arpBadOp();
 }
 
 void PortStats::ipv6NdpPkt() {
+  PortCounterStore::add<PortCounter::NDP>(counters_);
   switchStats_->ipv6NdpPkt();
 }
 void PortStats::ipv6NdpBad() {
+  PortCounterStore::add<PortCounter::NDP_BAD>(counters_);
   switchStats_->ipv6NdpBad();
 }
 
 void PortStats::ipv4Rx() {
+  PortCounterStore::add<PortCounter::IPV4_RX>(counters_);
   switchStats_->ipv4Rx();
 }
 void PortStats::ipv4TooSmall() {
+  PortCounterStore::add<PortCounter::IPV4_TOO_SMALL>(counters_);
   switchStats_->ipv4TooSmall();
 }
 void PortStats::ipv4WrongVer() {
+  PortCounterStore::add<PortCounter::IPV4_WRONG_VER>(counters_);
   switchStats_->ipv4WrongVer();
 }
 void PortStats::ipv4Nexthop() {
+  PortCounterStore::add<PortCounter::IPV4_NEXTHOP>(counters_);
   switchStats_->ipv4Nexthop();
 }
 void PortStats::ipv4Mine() {
+  PortCounterStore::add<PortCounter::IPV4_MINE>(counters_);
   switchStats_->ipv4Mine();
 }
 void PortStats::ipv4NoArp() {
+  PortCounterStore::add<PortCounter::IPV4_NO_ARP>(counters_);
   switchStats_->ipv4NoArp();
 }
 void PortStats::ipv4TtlExceeded() {
+  PortCounterStore::add<PortCounter::IPV4_TTL_EXCEEDED>(counters_);
   switchStats_->ipv4TtlExceeded();
 }
 
 void PortStats::ipv6HopExceeded() {
+  PortCounterStore::add<PortCounter::IPV6_HOP_EXCEEDED>(counters_);
   switchStats_->ipv6HopExceeded();
 }
 
+void PortStats::icmpErrorRateLimited() {
+  PortCounterStore::add<PortCounter::ICMP_RATE_LIMITED>(counters_);
+  switchStats_->icmpErrorRateLimited();
+}
+
 void PortStats::udpTooSmall() {
+  PortCounterStore::add<PortCounter::UDP_TOO_SMALL>(counters_);
   switchStats_->udpTooSmall();
 }
 
 void PortStats::dhcpV4Pkt() {
+  PortCounterStore::add<PortCounter::DHCPV4>(counters_);
   switchStats_->dhcpV4Pkt();
 }
 void PortStats::dhcpV4BadPkt() {
+  PortCounterStore::add<PortCounter::DHCPV4_BAD>(counters_);
   switchStats_->dhcpV4BadPkt();
 }
 void PortStats::dhcpV4DropPkt() {
+  PortCounterStore::add<PortCounter::DHCPV4_DROP>(counters_);
   switchStats_->dhcpV4DropPkt();
 }
 
 void PortStats::dhcpV6Pkt() {
+  PortCounterStore::add<PortCounter::DHCPV6>(counters_);
   switchStats_->dhcpV6Pkt();
 }
 void PortStats::dhcpV6BadPkt() {
+  PortCounterStore::add<PortCounter::DHCPV6_BAD>(counters_);
   switchStats_->dhcpV6BadPkt();
 }
 void PortStats::dhcpV6DropPkt() {
+  PortCounterStore::add<PortCounter::DHCPV6_DROP>(counters_);
   switchStats_->dhcpV6DropPkt();
 }
 
 void PortStats::linkStateChange() {
-  // We decided not to maintain the TLTimeseries in PortStats and use tcData()
-  // to addStatValue based on the key name, because:
-  // 1) each thread has its own SwitchStats and PortStats
-  // 2) update PortName need to delete old TLTimeseries in the thread which
-  // can recognize the name changed.
-  // 3) w/o a global lock like the one in ThreadLocalStats, we might have
-  // race condition issue when two threads want to delete the same TLTimeseries
-  // from the same thread.
-  // Using tcData() can make sure we don't have to maintain the lifecycle of
-  // TLTimeseries and leave ThreadLocalStats do it for us.
-  if (!portName_.empty()) {
-    tcData().addStatValue(getCounterKey(kLinkStateFlap), 1, SUM);
-  }
+  PortCounterStore::add<PortCounter::LINK_STATE_FLAP>(counters_);
   switchStats_->linkStateChange();
 }
 
 void PortStats::ipv4DstLookupFailure() {
+  PortCounterStore::add<PortCounter::IPV4_DST_LOOKUP_FAILURE>(counters_);
   switchStats_->ipv4DstLookupFailure();
 }
 
 void PortStats::ipv6DstLookupFailure() {
+  PortCounterStore::add<PortCounter::IPV6_DST_LOOKUP_FAILURE>(counters_);
   switchStats_->ipv6DstLookupFailure();
 }
 
@@ -173,10 +201,20 @@ void PortStats::setPortStatus(bool isUp) {
 void PortStats::clearPortStatusCounter() {
   if (!portName_.empty()) {
     tcData().clearCounter(getCounterKey(kUp));
+    tcData().clearCounter(getCounterKey(kLinkFlapPenalty));
+    tcData().clearCounter(getCounterKey(kLinkFlapSuppressed));
+  }
+}
+
+void PortStats::setLinkFlapDampening(int64_t penalty, bool suppressed) {
+  if (!portName_.empty()) {
+    tcData().setCounter(getCounterKey(kLinkFlapPenalty), penalty);
+    tcData().setCounter(getCounterKey(kLinkFlapSuppressed), suppressed);
   }
 }
 
 void PortStats::pktTooBig() {
+  PortCounterStore::add<PortCounter::TRAPPED_PTB>(counters_);
   switchStats_->pktTooBig();
 }
 
@@ -9,6 +9,7 @@
  */
 #pragma once
 
+#include "fboss/agent/PortCounterStore.h"
 #include "fboss/agent/types.h"
 
 namespace facebook { namespace fboss {
@@ -49,6 +50,7 @@ class PortStats {
   void udpTooSmall();
 
   void ipv6HopExceeded();
+  void icmpErrorRateLimited();
 
   void dhcpV4Pkt();
   void dhcpV4BadPkt();
@@ -64,6 +66,8 @@ class PortStats {
 
   void setPortStatus(bool isUp);
   void clearPortStatusCounter();
+  // The port's link flap penalty, and whether its link is kept down for it
+  void setLinkFlapDampening(int64_t penalty, bool suppressed);
 
   void pktTooBig();
 
@@ -92,6 +96,9 @@ class PortStats {
   // Pointer to main SwitchStats object so that we can forward method calls
   // that we do not want to track ourselves.
   SwitchStats *switchStats_;
+
+  // Our row in the per port counters of switchStats_
+  PortCounterStore::Row* counters_;
 };
 
 }} // facebook::fboss
@@ -0,0 +1,107 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "fboss/agent/PortStatsSnapshot.h"
+
+#include "common/stats/ServiceData.h"
+#include "fboss/agent/state/Port.h"
+#include "fboss/agent/state/PortMap.h"
+
+#include <folly/Conv.h>
+
+namespace facebook { namespace fboss {
+
+std::string PortStatsSnapshot::getStatPrefix(
+    PortID port, const std::string& name) {
+  return name.empty() ? folly::to<std::string>("port", port) : name;
+}
+
+void PortStatsSnapshot::update(const PortMap& ports) {
+  auto snapshot = std::make_shared<Snapshot>();
+  snapshot->reserve(ports.size());
+  std::map<PortID, PortHandles> handles;
+  for (const auto& port : ports) {
+    auto portId = port->getID();
+    auto statPrefix = getStatPrefix(portId, port->getName());
+    auto numQueues = port->getPortQueues().size();
+
+    auto it = handles_.find(portId);
+    auto& portHandles = handles[portId];
+    if (it != handles_.end() && it->second.statPrefix == statPrefix &&
+        it->second.queues.size() == numQueues) {
+      portHandles = std::move(it->second);
+    } else {
+      initHandles(statPrefix, numQueues, &portHandles);
+    }
+
+    auto& counters = (*snapshot)[portId];
+    readCounters(portHandles.input, &counters.input);
+    readCounters(portHandles.output, &counters.output);
+    counters.output.unicast.reserve(numQueues);
+    for (const auto& queue : portHandles.queues) {
+      QueueStats stats;
+      stats.congestionDiscards = readStat(queue.congestionDiscards);
+      stats.outBytes = readStat(queue.outBytes);
+      counters.output.unicast.push_back(stats);
+    }
+  }
+  // Ports that are gone are dropped along with their handles
+  handles_.swap(handles);
+  *snapshot_.wlock() = std::move(snapshot);
+}
+
+void PortStatsSnapshot::initHandles(
+    const std::string& statPrefix,
+    size_t numQueues,
+    PortHandles* handles) {
+  auto statMap = fbData->getStatMap();
+  auto getHandle = [&](folly::StringPiece prefix, folly::StringPiece name) {
+    return statMap->getLockAndStatItem(
+        folly::to<std::string>(statPrefix, ".", prefix, name));
+  };
+  auto initCounters = [&](CounterHandles& ctr, folly::StringPiece prefix) {
+    ctr.bytes = getHandle(prefix, "bytes");
+    ctr.ucastPkts = getHandle(prefix, "unicast_pkts");
+    ctr.multicastPkts = getHandle(prefix, "multicast_pkts");
+    ctr.broadcastPkts = getHandle(prefix, "broadcast_pkts");
+    ctr.errors = getHandle(prefix, "errors");
+    ctr.discards = getHandle(prefix, "discards");
+  };
+
+  handles->statPrefix = statPrefix;
+  initCounters(handles->input, "in_");
+  initCounters(handles->output, "out_");
+  handles->queues.clear();
+  for (size_t i = 0; i < numQueues; ++i) {
+    auto queue = folly::to<std::string>("queue", i, ".");
+    QueueHandles queueHandles;
+    queueHandles.congestionDiscards =
+        getHandle(queue, "out_congestion_discards");
+    queueHandles.outBytes = getHandle(queue, "out_bytes");
+    handles->queues.push_back(std::move(queueHandles));
+  }
+}
+
+void PortStatsSnapshot::readCounters(
+    const CounterHandles& handles, PortCounters* ctr) {
+  ctr->bytes = readStat(handles.bytes);
+  ctr->ucastPkts = readStat(handles.ucastPkts);
+  ctr->multicastPkts = readStat(handles.multicastPkts);
+  ctr->broadcastPkts = readStat(handles.broadcastPkts);
+  ctr->errors.errors = readStat(handles.errors);
+  ctr->errors.discards = readStat(handles.discards);
+}
+
+int64_t PortStatsSnapshot::readStat(const StatHandle& handle) {
+  stats::ExportedStatMap::LockedStatPtr stat(handle);
+  // Cumulative (ALLTIME) counters are at (numLevels - 1)
+  return stat->sum(stat->numLevels() - 1);
+}
+
+}} // facebook::fboss
@@ -0,0 +1,104 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#pragma once
+
+#include "common/stats/ExportedStatMap.h"
+#include "fboss/agent/if/gen-cpp2/ctrl_types.h"
+#include "fboss/agent/types.h"
+
+#include <boost/container/flat_map.hpp>
+#include <folly/Synchronized.h>
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace facebook { namespace fboss {
+
+class PortMap;
+
+/*
+ * PortStatsSnapshot keeps the cumulative counters of every port, as of the
+ * last stats update, for getPortInfo() and getAllPortInfo().
+ *
+ * Those used to look up a dozen or more stats by name for each port on
+ * every call.  Instead the stats thread reads them once after each stats
+ * update, through handles on the stats that are only looked up again when
+ * a port is renamed or its queues change, and swaps in a new snapshot.  The
+ * thrift calls then only copy the counters out of the latest snapshot.
+ */
+class PortStatsSnapshot {
+ public:
+  struct Counters {
+    PortCounters input;
+    // Along with the queue stats, in output.unicast
+    PortCounters output;
+  };
+  using Snapshot = boost::container::flat_map<PortID, Counters>;
+
+  PortStatsSnapshot() : snapshot_(std::make_shared<Snapshot>()) {}
+
+  /*
+   * Read the counters of the ports, and publish them as the new snapshot.
+   * Only called from the stats thread.
+   */
+  void update(const PortMap& ports);
+
+  /*
+   * The latest snapshot.  Can be called from any thread.
+   */
+  std::shared_ptr<const Snapshot> get() const {
+    return *snapshot_.rlock();
+  }
+
+  /*
+   * The name the stats of the port are kept under.
+   */
+  static std::string getStatPrefix(PortID port, const std::string& name);
+
+ private:
+  // Forbidden copy constructor and assignment operator
+  PortStatsSnapshot(PortStatsSnapshot const &) = delete;
+  PortStatsSnapshot& operator=(PortStatsSnapshot const &) = delete;
+
+  using StatHandle = stats::ExportedStatMap::LockAndStatItem;
+  struct CounterHandles {
+    StatHandle bytes;
+    StatHandle ucastPkts;
+    StatHandle multicastPkts;
+    StatHandle broadcastPkts;
+    StatHandle errors;
+    StatHandle discards;
+  };
+  struct QueueHandles {
+    StatHandle congestionDiscards;
+    StatHandle outBytes;
+  };
+  struct PortHandles {
+    std::string statPrefix;
+    CounterHandles input;
+    CounterHandles output;
+    std::vector<QueueHandles> queues;
+  };
+
+  static void initHandles(
+      const std::string& statPrefix,
+      size_t numQueues,
+      PortHandles* handles);
+  static void readCounters(const CounterHandles& handles, PortCounters* ctr);
+  static int64_t readStat(const StatHandle& handle);
+
+  // Only used from the stats thread
+  std::map<PortID, PortHandles> handles_;
+  folly::Synchronized<std::shared_ptr<const Snapshot>> snapshot_;
+};
+
+}} // facebook::fboss
@@ -0,0 +1,207 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "fboss/agent/PuntStats.h"
+
+#include "fboss/agent/LacpTypes.h"
+#include "fboss/agent/RxPacket.h"
+#include "fboss/agent/packet/Ethertype.h"
+#include "fboss/agent/packet/IPProto.h"
+#include "fboss/agent/packet/ParsedPacket.h"
+
+#include <algorithm>
+
+namespace facebook { namespace fboss {
+
+constexpr size_t PuntStats::kNumProtocols;
+constexpr size_t PuntStats::kNumCosQueues;
+constexpr size_t PuntStats::kMaxPorts;
+constexpr size_t PuntStats::kCountersPerPort;
+
+PuntStats::PuntStats()
+    : retiredPackets_(kMaxPorts * kCountersPerPort, 0),
+      retiredBytes_(kMaxPorts * kCountersPerPort, 0),
+      lastPackets_(kMaxPorts * kCountersPerPort, 0),
+      lastBytes_(kMaxPorts * kCountersPerPort, 0) {}
+
+PuntStats::~PuntStats() {
+  // The counters of every thread are retired as threadCounters_ is
+  // destroyed, which is before the lock and the retired counts are.
+}
+
+PuntStats::Protocol PuntStats::getProtocol(const ParsedPacket& parsed) {
+  switch (parsed.etherType) {
+    case ETHERTYPE_ARP:
+      return Protocol::ARP;
+    case ETHERTYPE_LLDP:
+      return Protocol::LLDP;
+    case LACPDU::EtherType::SLOW_PROTOCOLS:
+      return Protocol::LACP;
+    case ETHERTYPE_IPV4:
+      return parsed.ipProtocol == IP_PROTO_ICMP ?
+          Protocol::ICMPV4 : Protocol::IPV4;
+    case ETHERTYPE_IPV6:
+      return parsed.ipProtocol == IP_PROTO_IPV6_ICMP ?
+          Protocol::ICMPV6 : Protocol::IPV6;
+    default:
+      return Protocol::OTHER;
+  }
+}
+
+const char* PuntStats::getProtocolName(Protocol protocol) {
+  switch (protocol) {
+    case Protocol::ARP:
+      return "arp";
+    case Protocol::LLDP:
+      return "lldp";
+    case Protocol::LACP:
+      return "lacp";
+    case Protocol::IPV4:
+      return "ipv4";
+    case Protocol::ICMPV4:
+      return "icmpv4";
+    case Protocol::IPV6:
+      return "ipv6";
+    case Protocol::ICMPV6:
+      return "icmpv6";
+    case Protocol::OTHER:
+      break;
+  }
+  return "other";
+}
+
+PuntStats::ThreadCounters::~ThreadCounters() {
+  stats_->retire(this);
+}
+
+void PuntStats::ThreadCounters::record(
+    size_t port, size_t index, uint64_t bytes) {
+  auto* counters = ports_[port].load(std::memory_order_relaxed);
+  if (!counters) {
+    allocated_.push_back(std::make_unique<PortCounters>());
+    counters = allocated_.back().get();
+    ports_[port].store(counters, std::memory_order_release);
+  }
+  // Only this thread writes the counters, so they don't need to be
+  // incremented atomically.
+  auto& counter = (*counters)[index];
+  counter.packets.store(
+      counter.packets.load(std::memory_order_relaxed) + 1,
+      std::memory_order_relaxed);
+  counter.bytes.store(
+      counter.bytes.load(std::memory_order_relaxed) + bytes,
+      std::memory_order_relaxed);
+}
+
+void PuntStats::ThreadCounters::addTo(
+    std::vector<uint64_t>* packets, std::vector<uint64_t>* bytes) const {
+  for (size_t port = 0; port < kMaxPorts; ++port) {
+    const auto* counters = ports_[port].load(std::memory_order_acquire);
+    if (!counters) {
+      continue;
+    }
+    auto base = port * kCountersPerPort;
+    for (size_t idx = 0; idx < kCountersPerPort; ++idx) {
+      (*packets)[base + idx] +=
+          (*counters)[idx].packets.load(std::memory_order_relaxed);
+      (*bytes)[base + idx] +=
+          (*counters)[idx].bytes.load(std::memory_order_relaxed);
+    }
+  }
+}
+
+PuntStats::ThreadCounters* PuntStats::getThreadCounters() {
+  auto* counters = threadCounters_.get();
+  if (counters) {
+    return counters;
+  }
+  counters = new ThreadCounters(this);
+  {
+    std::lock_guard<std::mutex> guard(lock_);
+    threads_.push_back(counters);
+  }
+  threadCounters_.reset(counters);
+  return counters;
+}
+
+void PuntStats::retire(const ThreadCounters* counters) {
+  std::lock_guard<std::mutex> guard(lock_);
+  counters->addTo(&retiredPackets_, &retiredBytes_);
+  threads_.erase(
+      std::remove(threads_.begin(), threads_.end(), counters), threads_.end());
+}
+
+void PuntStats::record(const RxPacket* pkt, Protocol protocol) {
+  size_t port = std::min<size_t>(
+      static_cast<uint16_t>(pkt->getSrcPort()), kMaxPorts - 1);
+  // Packets with no CoS information are counted as CoS 0, as PacketRxPool
+  // prioritizes them.
+  auto cos = pkt->cosQueue();
+  size_t cosQueue = cos < 0 ?
+      0 : std::min<size_t>(cos, kNumCosQueues - 1);
+  getThreadCounters()->record(
+      port,
+      cosQueue * kNumProtocols + static_cast<size_t>(protocol),
+      pkt->getLength());
+}
+
+void PuntStats::update() {
+  update(std::chrono::steady_clock::now());
+}
+
+void PuntStats::update(std::chrono::steady_clock::time_point now) {
+  std::lock_guard<std::mutex> guard(lock_);
+  auto packets = retiredPackets_;
+  auto bytes = retiredBytes_;
+  for (const auto* counters : threads_) {
+    counters->addTo(&packets, &bytes);
+  }
+
+  std::vector<Talker> talkers;
+  double seconds = updated_ ?
+      std::chrono::duration<double>(now - lastUpdate_).count() : 0;
+  for (size_t idx = 0; idx < packets.size(); ++idx) {
+    if (packets[idx] == 0) {
+      continue;
+    }
+    Talker talker;
+    talker.port = PortID(idx / kCountersPerPort);
+    talker.cosQueue = (idx % kCountersPerPort) / kNumProtocols;
+    talker.protocol = static_cast<Protocol>(idx % kNumProtocols);
+    talker.packets = packets[idx];
+    talker.bytes = bytes[idx];
+    if (seconds > 0) {
+      talker.packetsPerSec = (packets[idx] - lastPackets_[idx]) / seconds;
+      talker.bytesPerSec = (bytes[idx] - lastBytes_[idx]) / seconds;
+    }
+    talkers.push_back(talker);
+  }
+  std::sort(talkers.begin(), talkers.end(),
+            [](const Talker& a, const Talker& b) {
+              if (a.packetsPerSec != b.packetsPerSec) {
+                return a.packetsPerSec > b.packetsPerSec;
+              }
+              return a.packets > b.packets;
+            });
+
+  talkers_ = std::move(talkers);
+  lastPackets_ = std::move(packets);
+  lastBytes_ = std::move(bytes);
+  lastUpdate_ = now;
+  updated_ = true;
+}
+
+std::vector<PuntStats::Talker> PuntStats::getTopTalkers(size_t count) const {
+  std::lock_guard<std::mutex> guard(lock_);
+  return std::vector<Talker>(
+      talkers_.begin(),
+      talkers_.begin() + std::min(count, talkers_.size()));
+}
+
+}} // facebook::fboss
@@ -0,0 +1,145 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#pragma once
+
+#include "fboss/agent/types.h"
+
+#include <folly/ThreadLocal.h>
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace facebook { namespace fboss {
+
+struct ParsedPacket;
+class RxPacket;
+
+/*
+ * PuntStats counts the packets trapped to the CPU by ingress port, CPU CoS
+ * queue and protocol, to find which port is flooding the CPU.
+ *
+ * Each thread counts the packets it handles in its own flat arrays, so
+ * recording a packet is a few relaxed atomic adds with no sharing.  The
+ * counts of all threads are aggregated by update(), which is called
+ * periodically, and the top talkers are found from the rates between the
+ * two latest updates.
+ */
+class PuntStats {
+ public:
+  enum class Protocol : uint8_t {
+    ARP,
+    LLDP,
+    LACP,
+    IPV4,
+    ICMPV4,
+    IPV6,
+    ICMPV6,
+    OTHER,
+  };
+  static constexpr size_t kNumProtocols = 8;
+  static constexpr size_t kNumCosQueues = 8;
+  // Ports from kMaxPorts up are all counted as kMaxPorts - 1
+  static constexpr size_t kMaxPorts = 1024;
+
+  struct Talker {
+    PortID port{0};
+    uint8_t cosQueue{0};
+    Protocol protocol{Protocol::OTHER};
+    uint64_t packets{0};
+    uint64_t bytes{0};
+    double packetsPerSec{0};
+    double bytesPerSec{0};
+  };
+
+  PuntStats();
+  ~PuntStats();
+
+  static Protocol getProtocol(const ParsedPacket& parsed);
+  static const char* getProtocolName(Protocol protocol);
+
+  /*
+   * Count a trapped packet.  Called from the packet handling threads.
+   */
+  void record(const RxPacket* pkt, Protocol protocol);
+
+  /*
+   * Aggregate the counts of all threads and compute the rates since the
+   * last update.
+   */
+  void update();
+  void update(std::chrono::steady_clock::time_point now);
+
+  /*
+   * The count keys with the highest packet rates as of the last update, up
+   * to count of them.
+   */
+  std::vector<Talker> getTopTalkers(size_t count) const;
+
+ private:
+  static constexpr size_t kCountersPerPort = kNumCosQueues * kNumProtocols;
+
+  struct Counter {
+    std::atomic<uint64_t> packets{0};
+    std::atomic<uint64_t> bytes{0};
+  };
+  using PortCounters = std::array<Counter, kCountersPerPort>;
+
+  /*
+   * The counts of one thread.  The counters of a port are allocated the
+   * first time the thread sees a packet from it, and only ever written by
+   * that thread.
+   */
+  class ThreadCounters {
+   public:
+    explicit ThreadCounters(PuntStats* stats) : stats_(stats) {}
+    ~ThreadCounters();
+
+    void record(size_t port, size_t index, uint64_t bytes);
+    void addTo(std::vector<uint64_t>* packets,
+               std::vector<uint64_t>* bytes) const;
+
+   private:
+    PuntStats* stats_{nullptr};
+    std::array<std::atomic<PortCounters*>, kMaxPorts> ports_{};
+    std::vector<std::unique_ptr<PortCounters>> allocated_;
+  };
+
+  // Forbidden copy constructor and assignment operator
+  PuntStats(PuntStats const &) = delete;
+  PuntStats& operator=(PuntStats const &) = delete;
+
+  ThreadCounters* getThreadCounters();
+  // Keep the counts of a thread that is exiting
+  void retire(const ThreadCounters* counters);
+
+  /*
+   * The threads that are counting, and the counts of the ones that have
+   * exited.  The counts of all keys are indexed by port * kCountersPerPort +
+   * cosQueue * kNumProtocols + protocol.
+   */
+  mutable std::mutex lock_;
+  std::vector<const ThreadCounters*> threads_;
+  std::vector<uint64_t> retiredPackets_;
+  std::vector<uint64_t> retiredBytes_;
+  std::vector<uint64_t> lastPackets_;
+  std::vector<uint64_t> lastBytes_;
+  std::chrono::steady_clock::time_point lastUpdate_;
+  bool updated_{false};
+  std::vector<Talker> talkers_;
+
+  struct ThreadCountersTag {};
+  folly::ThreadLocalPtr<ThreadCounters, ThreadCountersTag> threadCounters_;
+};
+
+}} // facebook::fboss
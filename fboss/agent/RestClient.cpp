@@ -9,11 +9,12 @@
  */
 #include "RestClient.h"
 
+#include <algorithm>
 #include <sstream>
 
 #include "fboss/agent/FbossError.h"
 
-#include <curl/curl.h>
+#include <folly/system/ThreadName.h>
 
 namespace facebook { namespace fboss {
 
@@ -36,6 +37,16 @@ RestClient::RestClient(folly::IPAddress ipAddress, int port,
   createEndpoint();
 }
 
+RestClient::~RestClient() {
+  if (thread_.joinable()) {
+    eventBase_.runInEventBaseThread([this] { eventBase_.terminateLoopSoon(); });
+    thread_.join();
+  }
+  if (curl_) {
+    curl_easy_cleanup(curl_);
+  }
+}
+
 void RestClient::createEndpoint() {
   if (!hostname_.empty()) {
     endpoint_ = hostname_;
@@ -54,48 +65,104 @@ void RestClient::setTimeout(std::chrono::milliseconds timeout) {
 }
 
 std::string RestClient::requestWithOutput(std::string path) {
-  CURL* curl;
-  CURLcode resp;
   std::stringbuf write_buffer;
-  endpoint_ = endpoint_ + path;
+  auto url = endpoint_ + path;
   /* for curl errors */
   char error[CURL_ERROR_SIZE];
+  error[0] = '\0';
 
-  curl = curl_easy_init();
-  if (curl) {
-    /* Set the curl options */
-    curl_easy_setopt(curl, CURLOPT_URL, endpoint_.c_str());
-    curl_easy_setopt(curl, CURLOPT_PROTOCOLS,CURLPROTO_HTTP);
-    curl_easy_setopt(curl, CURLOPT_PORT, port_);
-    curl_easy_setopt(curl, CURLOPT_TIMEOUT_MS, timeout_.count());
-    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, RestClient::writer);
-    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &write_buffer);
-    curl_easy_setopt(curl, CURLOPT_ERRORBUFFER, error);
-    curl_easy_setopt(curl, CURLOPT_FAILONERROR, 1L);
-
-    /* if an interface is specified use that */
-    if (!interface_.empty()) {
-      curl_easy_setopt(curl, CURLOPT_INTERFACE, interface_.c_str());
+  std::lock_guard<std::mutex> g(lock_);
+  if (!curl_) {
+    // Kept for the later requests, to reuse the connection
+    curl_ = curl_easy_init();
+    if (!curl_) {
+      throw FbossError("Error initializing curl interface");
     }
+  }
+  /* Set the curl options */
+  curl_easy_setopt(curl_, CURLOPT_URL, url.c_str());
+  curl_easy_setopt(curl_, CURLOPT_PROTOCOLS,CURLPROTO_HTTP);
+  curl_easy_setopt(curl_, CURLOPT_PORT, port_);
+  curl_easy_setopt(curl_, CURLOPT_TIMEOUT_MS, timeout_.count());
+  curl_easy_setopt(curl_, CURLOPT_WRITEFUNCTION, RestClient::writer);
+  curl_easy_setopt(curl_, CURLOPT_WRITEDATA, &write_buffer);
+  curl_easy_setopt(curl_, CURLOPT_ERRORBUFFER, error);
+  curl_easy_setopt(curl_, CURLOPT_FAILONERROR, 1L);
 
-    resp = curl_easy_perform(curl);
-    curl_easy_cleanup(curl);
-    if (resp == CURLE_OK) {
-      return write_buffer.str();
-    } else {
-      throw FbossError("Error querying api: ", endpoint_, " error: ", error);
-    }
+  /* if an interface is specified use that */
+  if (!interface_.empty()) {
+    curl_easy_setopt(curl_, CURLOPT_INTERFACE, interface_.c_str());
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  auto resp = curl_easy_perform(curl_);
+  auto latency = std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::steady_clock::now() - start);
+  ++stats_.requests;
+  stats_.totalLatency += latency;
+  stats_.maxLatency = std::max(stats_.maxLatency, latency);
+  if (resp == CURLE_OK) {
+    return write_buffer.str();
   }
-  throw FbossError("Error initializing curl interface");
+  ++stats_.failures;
+  if (resp == CURLE_OPERATION_TIMEDOUT) {
+    ++stats_.timeouts;
+  }
+  throw FbossError("Error querying api: ", url, " error: ", error);
 }
 
 bool RestClient::request(std::string path) {
-  auto ret = requestWithOutput(path);
-  std::size_t status = ret.find("done");
-  if (status != std::string::npos) {
-    return true;
+  return isDone(requestWithOutput(path));
+}
+
+folly::Future<std::string> RestClient::requestWithOutputAsync(
+    std::string path) {
+  return folly::via(getEventBase(), [this, path = std::move(path)] {
+    return requestWithOutput(path);
+  });
+}
+
+folly::Future<bool> RestClient::requestAsync(std::string path) {
+  return requestWithOutputAsync(std::move(path))
+      .then([](const std::string& output) { return isDone(output); });
+}
+
+folly::Future<std::string> RestClient::requestWithOutputCached(
+    std::string path, std::chrono::milliseconds ttl) {
+  {
+    std::lock_guard<std::mutex> g(lock_);
+    auto iter = cache_.find(path);
+    if (iter != cache_.end() &&
+        std::chrono::steady_clock::now() - iter->second.time <= ttl) {
+      ++stats_.cacheHits;
+      return folly::makeFuture(iter->second.output);
+    }
   }
-  return false;
+  return requestWithOutputAsync(path).then(
+      [this, path](std::string output) {
+        std::lock_guard<std::mutex> g(lock_);
+        cache_[path] = CachedOutput{output, std::chrono::steady_clock::now()};
+        return output;
+      });
+}
+
+RestClient::Stats RestClient::getStats() const {
+  std::lock_guard<std::mutex> g(lock_);
+  return stats_;
+}
+
+bool RestClient::isDone(const std::string& output) {
+  return output.find("done") != std::string::npos;
+}
+
+folly::EventBase* RestClient::getEventBase() {
+  std::call_once(threadStarted_, [this] {
+    thread_ = std::thread([this] {
+      folly::setThreadName("RestClient");
+      eventBase_.loopForever();
+    });
+  });
+  return &eventBase_;
 }
 
 size_t RestClient::writer(char *buffer, size_t size,
@@ -11,36 +11,89 @@
 
 #include <string>
 #include <chrono>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
 #include <folly/IPAddress.h>
+#include <folly/futures/Future.h>
+#include <folly/io/async/EventBase.h>
+
+#include <curl/curl.h>
 
 namespace facebook { namespace fboss {
 
+/*
+ * The requests of a RestClient go over one curl handle, so that they reuse
+ * its connection to the server, and are made one at a time.
+ */
 class RestClient {
  public:
+  struct Stats {
+    uint64_t requests{0};
+    uint64_t failures{0};
+    uint64_t timeouts{0};
+    // Cached requests answered without asking the server
+    uint64_t cacheHits{0};
+    std::chrono::microseconds totalLatency{0};
+    std::chrono::microseconds maxLatency{0};
+  };
+
   RestClient(std::string hostname, int port);
   RestClient(folly::IPAddress ipAddress, int port);
   RestClient(folly::IPAddress ipAddress, int port, std::string interface);
+  ~RestClient();
   /*
    * Calls the particular Rest api
    */
   bool request(std::string path);
   std::string requestWithOutput(std::string path);
+  /*
+   * The same calls, made on the thread of the client, so that a slow server
+   * doesn't stall the thread that made them.
+   */
+  folly::Future<bool> requestAsync(std::string path);
+  folly::Future<std::string> requestWithOutputAsync(std::string path);
+  /*
+   * For read only apis: the output of the last call of path, if it was at
+   * most ttl ago, or else of a new call.
+   */
+  folly::Future<std::string> requestWithOutputCached(
+      std::string path, std::chrono::milliseconds ttl);
   void setTimeout(std::chrono::milliseconds timeout);
+  Stats getStats() const;
 
  private:
+  struct CachedOutput {
+    std::string output;
+    std::chrono::steady_clock::time_point time;
+  };
+
   // Forbidden copy contructor and assignment operator
   RestClient(RestClient const &) = delete;
   RestClient& operator=(RestClient const &) = delete;
 
   static size_t writer(char *buffer, size_t size,
                         size_t entries, std::stringbuf *writer_buffer);
+  static bool isDone(const std::string& output);
   void createEndpoint();
+  folly::EventBase* getEventBase();
   std::string hostname_;
   folly::IPAddress ipAddress_;
   std::string interface_;
   int port_;
   std::chrono::milliseconds timeout_{1000};
   std::string endpoint_;
+
+  // Protects everything below
+  mutable std::mutex lock_;
+  CURL* curl_{nullptr};
+  std::unordered_map<std::string, CachedOutput> cache_;
+  Stats stats_;
+
+  // The thread for the asynchronous calls, started by the first of them
+  std::once_flag threadStarted_;
+  folly::EventBase eventBase_;
+  std::thread thread_;
 };
 
 }} // namespace facebook::fboss
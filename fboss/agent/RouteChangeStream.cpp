@@ -0,0 +1,255 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "fboss/agent/RouteChangeStream.h"
+
+#include "fboss/agent/AddressUtil.h"
+#include "fboss/agent/state/Route.h"
+#include "fboss/agent/state/RouteTable.h"
+#include "fboss/agent/state/RouteTableMap.h"
+#include "fboss/agent/state/RouteTableRib.h"
+#include "fboss/agent/state/StateDelta.h"
+#include "fboss/agent/state/SwitchState.h"
+
+#include <folly/io/async/EventBase.h>
+
+#include <algorithm>
+
+DEFINE_int32(route_change_coalesce_ms, 100,
+             "How long to coalesce route changes for before publishing "
+             "them to the route change stream listeners");
+DEFINE_int32(max_route_change_batches_in_flight, 2,
+             "How many route change batches a route change stream listener "
+             "can have outstanding before the rest are merged into its "
+             "backlog");
+DEFINE_int32(max_route_change_backlog, 100000,
+             "How many route changes a route change stream listener can fall "
+             "behind by before they are dropped and it is sent a snapshot");
+
+using facebook::network::toBinaryAddress;
+using facebook::network::toIPAddress;
+
+namespace facebook { namespace fboss {
+
+namespace {
+
+template <typename RouteT>
+RouteChangeThrift makeChange(RouterID vrf, const RouteT& route, bool removed) {
+  RouteChangeThrift change;
+  change.vrfId = vrf;
+  change.prefix.ip = toBinaryAddress(route.prefix().network);
+  change.prefix.prefixLength = route.prefix().mask;
+  if (!removed) {
+    change.route = route.toRouteDetails();
+    change.__isset.route = true;
+  }
+  return change;
+}
+
+template <typename DeltaT>
+void addChanges(
+    RouterID vrf, const DeltaT& delta, RouteChangeStream::Changes* changes) {
+  for (const auto& routeDelta : delta) {
+    bool removed = !routeDelta.getNew();
+    const auto& route = removed ? routeDelta.getOld() : routeDelta.getNew();
+    RouteChangeStream::RouteKey key(
+        vrf, folly::CIDRNetwork(route->prefix().network, route->prefix().mask));
+    (*changes)[key] = makeChange(vrf, *route, removed);
+  }
+}
+
+template <typename RibT>
+void addRoutes(RouterID vrf, const RibT& rib, RouteChangesThrift* changes) {
+  for (const auto& route : *rib.routes()) {
+    changes->changes.push_back(makeChange(vrf, *route, false));
+  }
+}
+
+} // unnamed namespace
+
+RouteChangeStream::RouteChangeStream(
+    folly::EventBase* evb, std::function<void(Batch)> publish)
+    : AsyncTimeout(evb),
+      evb_(evb),
+      publish_(std::move(publish)),
+      published_(std::make_shared<SwitchState>()) {}
+
+RouteChangeStream::~RouteChangeStream() {
+  evb_->runImmediatelyOrRunInEventBaseThreadAndWait([this]() {
+    cancelTimeout();
+  });
+}
+
+void RouteChangeStream::stateChanged(std::shared_ptr<SwitchState> state) {
+  bool schedule;
+  {
+    std::lock_guard<std::mutex> g(lock_);
+    pending_ = std::move(state);
+    schedule = !scheduled_;
+    scheduled_ = true;
+  }
+  if (schedule) {
+    evb_->runInEventBaseThread([this]() {
+      scheduleTimeout(FLAGS_route_change_coalesce_ms);
+    });
+  }
+}
+
+RouteChangeStream::Batch RouteChangeStream::getSnapshot() const {
+  std::shared_ptr<SwitchState> state;
+  int64_t generation;
+  {
+    std::lock_guard<std::mutex> g(lock_);
+    state = published_;
+    generation = generation_.load(std::memory_order_relaxed);
+  }
+  return makeSnapshot(generation, std::move(state));
+}
+
+void RouteChangeStream::timeoutExpired() noexcept {
+  std::shared_ptr<SwitchState> state;
+  {
+    std::lock_guard<std::mutex> g(lock_);
+    state.swap(pending_);
+    scheduled_ = false;
+  }
+  if (!state) {
+    return;
+  }
+  // published_ is only changed on this thread, so it is safe to read here
+  Changes changes;
+  if (state->getRouteTables() != published_->getRouteTables()) {
+    changes = diff(published_, state);
+  }
+  if (changes.empty()) {
+    // Nothing to publish, but there is no need to hold on to the old state
+    std::lock_guard<std::mutex> g(lock_);
+    published_ = std::move(state);
+    return;
+  }
+  auto generation = generation_.load(std::memory_order_relaxed) + 1;
+  auto batch = makeBatch(generation, changes, state);
+  {
+    std::lock_guard<std::mutex> g(lock_);
+    published_ = std::move(state);
+    generation_.store(generation, std::memory_order_release);
+  }
+  publish_(std::move(batch));
+}
+
+RouteChangeStream::Changes RouteChangeStream::diff(
+    const std::shared_ptr<SwitchState>& oldState,
+    const std::shared_ptr<SwitchState>& newState) {
+  Changes changes;
+  StateDelta delta(oldState, newState);
+  for (const auto& rtDelta : delta.getRouteTablesDelta()) {
+    auto vrf = rtDelta.getNew() ? rtDelta.getNew()->getID()
+                                : rtDelta.getOld()->getID();
+    addChanges(vrf, rtDelta.getRoutesV4Delta(), &changes);
+    addChanges(vrf, rtDelta.getRoutesV6Delta(), &changes);
+  }
+  return changes;
+}
+
+void RouteChangeStream::merge(
+    const RouteChangesThrift& changes, Changes* merged) {
+  for (const auto& change : changes.changes) {
+    RouteKey key(
+        RouterID(change.vrfId),
+        folly::CIDRNetwork(
+            toIPAddress(change.prefix.ip), change.prefix.prefixLength));
+    (*merged)[key] = change;
+  }
+}
+
+RouteChangeStream::Batch RouteChangeStream::makeBatch(
+    int64_t generation,
+    const Changes& changes,
+    std::shared_ptr<SwitchState> state) {
+  auto batch = std::make_shared<RouteChangeBatch>();
+  batch->changes.generation = generation;
+  batch->changes.changes.reserve(changes.size());
+  for (const auto& change : changes) {
+    batch->changes.changes.push_back(change.second);
+  }
+  batch->state = std::move(state);
+  return batch;
+}
+
+RouteChangeStream::Batch RouteChangeStream::makeSnapshot(
+    int64_t generation, std::shared_ptr<SwitchState> state) {
+  auto batch = std::make_shared<RouteChangeBatch>();
+  batch->changes.generation = generation;
+  batch->changes.snapshot = true;
+  for (const auto& routeTable : *state->getRouteTables()) {
+    addRoutes(routeTable->getID(), *routeTable->getRibV4(), &batch->changes);
+    addRoutes(routeTable->getID(), *routeTable->getRibV6(), &batch->changes);
+  }
+  batch->state = std::move(state);
+  return batch;
+}
+
+void RouteChangeBacklog::subscribed(const Batch& snapshot) {
+  ++inFlight_;
+  publishedGeneration_ = snapshot->changes.generation;
+  ackedGeneration_ = publishedGeneration_;
+}
+
+RouteChangeBacklog::Batch RouteChangeBacklog::published(Batch batch) {
+  if (batch->changes.generation <= publishedGeneration_) {
+    // Already in the snapshot the listener was sent
+    return nullptr;
+  }
+  publishedGeneration_ = batch->changes.generation;
+  backlogState_ = batch->state;
+  if (backlog_.empty() && !resync_ && hasRoom()) {
+    ++inFlight_;
+    return batch;
+  }
+  if (!resync_) {
+    RouteChangeStream::merge(batch->changes, &backlog_);
+  } else {
+    // The listener is going to be sent everything anyway
+    dropped_ += batch->changes.changes.size();
+  }
+  if (backlog_.size() > size_t(FLAGS_max_route_change_backlog)) {
+    dropped_ += backlog_.size();
+    backlog_.clear();
+    resync_ = true;
+  }
+  return hasRoom() ? takeBacklog() : nullptr;
+}
+
+RouteChangeBacklog::Batch RouteChangeBacklog::acked(int64_t generation) {
+  if (inFlight_ > 0) {
+    --inFlight_;
+  }
+  ackedGeneration_ = std::max(ackedGeneration_, generation);
+  if ((backlog_.empty() && !resync_) || !hasRoom()) {
+    return nullptr;
+  }
+  return takeBacklog();
+}
+
+bool RouteChangeBacklog::hasRoom() const {
+  return inFlight_ < size_t(FLAGS_max_route_change_batches_in_flight);
+}
+
+RouteChangeBacklog::Batch RouteChangeBacklog::takeBacklog() {
+  ++inFlight_;
+  auto batch = resync_
+      ? RouteChangeStream::makeSnapshot(publishedGeneration_, backlogState_)
+      : RouteChangeStream::makeBatch(
+            publishedGeneration_, backlog_, backlogState_);
+  backlog_.clear();
+  resync_ = false;
+  return batch;
+}
+
+}} // facebook::fboss
@@ -0,0 +1,181 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#pragma once
+
+#include "fboss/agent/if/gen-cpp2/ctrl_types.h"
+#include "fboss/agent/types.h"
+
+#include <folly/IPAddress.h>
+#include <folly/io/async/AsyncTimeout.h>
+#include <gflags/gflags.h>
+
+#include <atomic>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <utility>
+
+DECLARE_int32(route_change_coalesce_ms);
+DECLARE_int32(max_route_change_batches_in_flight);
+DECLARE_int32(max_route_change_backlog);
+
+namespace facebook { namespace fboss {
+
+class SwitchState;
+
+/*
+ * A batch of route changes, along with the state they bring the listener
+ * to, so that a listener that falls too far behind can be sent a snapshot
+ * of it instead.
+ */
+struct RouteChangeBatch {
+  RouteChangesThrift changes;
+  std::shared_ptr<SwitchState> state;
+};
+
+/*
+ * RouteChangeStream turns the switch states applied to the hardware into
+ * generation numbered batches of route changes for the route change stream
+ * listeners.
+ *
+ * Applying a state only records it.  route_change_coalesce_ms later the
+ * route tables of the latest state are diffed, on the background thread,
+ * against those of the last state published, so however many updates came
+ * in between the listeners get a single batch listing each route once.
+ * Each batch is built once and shared by all of the listeners.
+ */
+class RouteChangeStream : private folly::AsyncTimeout {
+ public:
+  using Batch = std::shared_ptr<const RouteChangeBatch>;
+  using RouteKey = std::pair<RouterID, folly::CIDRNetwork>;
+  // The latest of each route changed, without a route if it was removed
+  using Changes = std::map<RouteKey, RouteChangeThrift>;
+
+  RouteChangeStream(
+      folly::EventBase* evb, std::function<void(Batch)> publish);
+  ~RouteChangeStream() override;
+
+  /*
+   * Record a new applied state, to be published with the next batch.  Can
+   * be called from any thread.
+   */
+  void stateChanged(std::shared_ptr<SwitchState> state);
+
+  /*
+   * A snapshot of the last state published, for a new listener.  The
+   * batches already published are in it, and those with a later generation
+   * are the changes from it.  Can be called from any thread.
+   */
+  Batch getSnapshot() const;
+
+  /*
+   * The generation of the last batch published.  Can be called from any
+   * thread.
+   */
+  int64_t getGeneration() const {
+    return generation_.load(std::memory_order_acquire);
+  }
+
+  static Changes diff(
+      const std::shared_ptr<SwitchState>& oldState,
+      const std::shared_ptr<SwitchState>& newState);
+  static void merge(const RouteChangesThrift& changes, Changes* merged);
+  static Batch makeBatch(
+      int64_t generation,
+      const Changes& changes,
+      std::shared_ptr<SwitchState> state);
+  static Batch makeSnapshot(
+      int64_t generation, std::shared_ptr<SwitchState> state);
+
+ private:
+  void timeoutExpired() noexcept override;
+
+  // Forbidden copy constructor and assignment operator
+  RouteChangeStream(RouteChangeStream const &) = delete;
+  RouteChangeStream& operator=(RouteChangeStream const &) = delete;
+
+  folly::EventBase* evb_{nullptr};
+  std::function<void(Batch)> publish_;
+  mutable std::mutex lock_;
+  std::shared_ptr<SwitchState> pending_;
+  bool scheduled_{false};
+  // Only changed on the background thread, under lock_ so that it can be
+  // read elsewhere
+  std::shared_ptr<SwitchState> published_;
+  std::atomic<int64_t> generation_{0};
+};
+
+/*
+ * The flow control for a single route change stream listener.
+ *
+ * This is NeighborChangeBacklog for routes: no more than
+ * max_route_change_batches_in_flight batches are sent before the listener
+ * acknowledges them, the batches published meanwhile are merged into its
+ * backlog, and a listener whose backlog grows past max_route_change_backlog
+ * routes has it dropped and is sent a fresh snapshot instead.
+ *
+ * Not thread safe, it is only used on the thread of its listener.
+ */
+class RouteChangeBacklog {
+ public:
+  using Batch = RouteChangeStream::Batch;
+
+  /*
+   * Called with the snapshot sent to the listener when it subscribes.
+   */
+  void subscribed(const Batch& snapshot);
+
+  /*
+   * Called with each batch published.  Return the batch to send to the
+   * listener now, or null if it is to wait in the backlog or is already in
+   * the listener's snapshot.
+   */
+  Batch published(Batch batch);
+
+  /*
+   * Called when the listener acknowledges a batch.  Return the backlog to
+   * send to it now, or null.
+   */
+  Batch acked(int64_t generation);
+
+  /*
+   * The number of generations published that the listener hasn't
+   * acknowledged.
+   */
+  int64_t getLag() const {
+    return publishedGeneration_ - ackedGeneration_;
+  }
+
+  /*
+   * The number of route changes dropped from the backlog so far.
+   */
+  uint64_t getDropped() const {
+    return dropped_;
+  }
+
+  size_t getInFlight() const {
+    return inFlight_;
+  }
+
+ private:
+  bool hasRoom() const;
+  Batch takeBacklog();
+
+  size_t inFlight_{0};
+  int64_t publishedGeneration_{0};
+  int64_t ackedGeneration_{0};
+  RouteChangeStream::Changes backlog_;
+  std::shared_ptr<SwitchState> backlogState_;
+  bool resync_{false};
+  uint64_t dropped_{0};
+};
+
+}} // facebook::fboss
@@ -0,0 +1,416 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "fboss/agent/RouteUpdateBinaryLog.h"
+
+#include "fboss/agent/FbossError.h"
+
+#include <folly/Bits.h>
+#include <folly/Conv.h>
+#include <folly/FileUtil.h>
+#include <folly/Format.h>
+#include <folly/ThreadName.h>
+#include <folly/io/Cursor.h>
+#include <folly/io/IOBuf.h>
+#include <folly/logging/xlog.h>
+#include <gflags/gflags.h>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <limits>
+
+DEFINE_int32(route_update_log_queue_size, 4096,
+             "The most route updates to queue for the route update log "
+             "before dropping them");
+DEFINE_int32(route_update_log_batch_size, 256,
+             "The most route updates to write to the route update log with "
+             "one system call");
+
+namespace {
+
+constexpr char kMagic[8] = {'F', 'B', 'R', 'T', 'L', 'O', 'G', '\0'};
+constexpr uint32_t kUnresolvedIntf = std::numeric_limits<uint32_t>::max();
+
+uint64_t nowUs() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+template <typename T>
+void appendLE(std::string& out, T value) {
+  value = folly::Endian::little(value);
+  out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+void appendAddr(std::string& out, const folly::IPAddress& addr) {
+  appendLE<uint8_t>(out, addr.isV4() ? 4 : 6);
+  auto bytes = addr.bytes();
+  out.append(reinterpret_cast<const char*>(bytes), addr.byteCount());
+}
+
+folly::IPAddress readAddr(folly::io::Cursor& cursor) {
+  auto family = cursor.read<uint8_t>();
+  if (family != 4 && family != 6) {
+    throw facebook::fboss::FbossError(
+        "bad address family in route update log: ",
+        static_cast<int>(family));
+  }
+  uint8_t bytes[16];
+  size_t len = family == 4 ? 4 : 16;
+  cursor.pull(bytes, len);
+  return folly::IPAddress::fromBinary(folly::ByteRange(bytes, len));
+}
+
+std::string forwardingStr(
+    const facebook::fboss::RouteLogForwarding& fwd) {
+  if (!fwd.resolved) {
+    return "unresolved";
+  }
+  if (fwd.action != facebook::fboss::RouteForwardAction::NEXTHOPS) {
+    return facebook::fboss::forwardActionStr(fwd.action);
+  }
+  std::string str;
+  for (const auto& nhop : fwd.nexthops) {
+    if (!str.empty()) {
+      str += ",";
+    }
+    str += nhop.addr.str();
+    if (nhop.intf) {
+      str += folly::to<std::string>("@I", *nhop.intf);
+    }
+    str += folly::to<std::string>("x", nhop.weight);
+  }
+  if (fwd.numNextHops > fwd.nexthops.size()) {
+    str += folly::to<std::string>(
+        ",...(", fwd.numNextHops - fwd.nexthops.size(), " more)");
+  }
+  return str;
+}
+
+} // unnamed namespace
+
+namespace facebook { namespace fboss {
+
+std::string RouteLogRecord::str() const {
+  auto prefix = folly::sformat(
+      "{} [{}] {}/{}",
+      timestampUs,
+      identifier,
+      network.first.str(),
+      network.second);
+  switch (type) {
+    case RouteLogRecordType::ADDED:
+      return folly::sformat("{} added: {}", prefix, forwardingStr(*newRoute));
+    case RouteLogRecordType::CHANGED:
+      return folly::sformat(
+          "{} changed: {} -> {}",
+          prefix,
+          forwardingStr(*oldRoute),
+          forwardingStr(*newRoute));
+    case RouteLogRecordType::REMOVED:
+      return folly::sformat(
+          "{} removed: {}", prefix, forwardingStr(*oldRoute));
+    case RouteLogRecordType::DROPPED:
+      return folly::sformat("{} dropped {} updates", timestampUs, dropped);
+    case RouteLogRecordType::IDENTIFIER:
+      break;
+  }
+  return folly::sformat("{} identifier {}", timestampUs, identifier);
+}
+
+std::vector<RouteLogRecord> decodeRouteUpdateLog(
+    folly::ByteRange data,
+    bool* truncated) {
+  if (truncated) {
+    *truncated = false;
+  }
+  if (data.size() < sizeof(kMagic) + sizeof(uint32_t) ||
+      memcmp(data.data(), kMagic, sizeof(kMagic)) != 0) {
+    throw FbossError("not a route update log");
+  }
+  auto buf = folly::IOBuf::wrapBuffer(data);
+  folly::io::Cursor cursor(buf.get());
+  cursor.skip(sizeof(kMagic));
+  auto version = cursor.readLE<uint32_t>();
+  if (version != kRouteLogVersion) {
+    throw FbossError("unsupported route update log version ", version);
+  }
+
+  auto readForwarding = [&cursor]() {
+    RouteLogForwarding fwd;
+    fwd.resolved = cursor.read<uint8_t>() != 0;
+    fwd.action = static_cast<RouteForwardAction>(cursor.read<uint8_t>());
+    fwd.numNextHops = cursor.readLE<uint16_t>();
+    auto stored = cursor.read<uint8_t>();
+    for (uint8_t i = 0; i < stored; ++i) {
+      RouteLogNextHop nhop;
+      nhop.addr = readAddr(cursor);
+      auto intf = cursor.readLE<uint32_t>();
+      if (intf != kUnresolvedIntf) {
+        nhop.intf = intf;
+      }
+      nhop.weight = cursor.readLE<uint32_t>();
+      fwd.nexthops.push_back(std::move(nhop));
+    }
+    return fwd;
+  };
+
+  std::unordered_map<uint16_t, std::string> identifiers;
+  std::vector<RouteLogRecord> records;
+  while (!cursor.isAtEnd()) {
+    RouteLogRecord record;
+    try {
+      record.type = static_cast<RouteLogRecordType>(cursor.read<uint8_t>());
+      record.timestampUs = cursor.readLE<uint64_t>();
+      switch (record.type) {
+        case RouteLogRecordType::IDENTIFIER: {
+          auto id = cursor.readLE<uint16_t>();
+          auto len = cursor.readLE<uint16_t>();
+          record.identifier = cursor.readFixedString(len);
+          identifiers[id] = record.identifier;
+          break;
+        }
+        case RouteLogRecordType::ADDED:
+        case RouteLogRecordType::CHANGED:
+        case RouteLogRecordType::REMOVED: {
+          auto id = cursor.readLE<uint16_t>();
+          auto name = identifiers.find(id);
+          record.identifier = name != identifiers.end()
+              ? name->second
+              : folly::to<std::string>("#", id);
+          record.network.first = readAddr(cursor);
+          record.network.second = cursor.read<uint8_t>();
+          if (record.type != RouteLogRecordType::ADDED) {
+            record.oldRoute = readForwarding();
+          }
+          if (record.type != RouteLogRecordType::REMOVED) {
+            record.newRoute = readForwarding();
+          }
+          break;
+        }
+        case RouteLogRecordType::DROPPED:
+          record.dropped = cursor.readLE<uint64_t>();
+          break;
+        default:
+          throw FbossError(
+              "bad record type in route update log: ",
+              static_cast<int>(record.type));
+      }
+    } catch (const std::out_of_range&) {
+      if (truncated) {
+        *truncated = true;
+      }
+      break;
+    }
+    records.push_back(std::move(record));
+  }
+  return records;
+}
+
+RouteUpdateBinaryLog::RouteUpdateBinaryLog(const std::string& path)
+    : entries_(std::max(FLAGS_route_update_log_queue_size, 1)) {
+  fd_ = folly::openNoInt(
+      path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+  if (fd_ < 0) {
+    throw FbossError("failed to open route update log ", path, ": ",
+                     folly::errnoStr(errno));
+  }
+  struct stat st;
+  if (fstat(fd_, &st) == 0 && st.st_size == 0) {
+    std::string header(kMagic, sizeof(kMagic));
+    appendLE<uint32_t>(header, kRouteLogVersion);
+    write(header);
+  }
+  XLOG(INFO) << "Logging route updates to " << path;
+  writerThread_ = std::thread([this] { writeEntries(); });
+}
+
+RouteUpdateBinaryLog::~RouteUpdateBinaryLog() {
+  Entry stop;
+  stop.stop = true;
+  entries_.blockingWrite(std::move(stop));
+  writerThread_.join();
+  folly::closeNoInt(fd_);
+}
+
+template <typename AddrT>
+void RouteUpdateBinaryLog::copyForwarding(
+    const std::shared_ptr<Route<AddrT>>& route,
+    QueuedForwarding& fwd) {
+  if (!route) {
+    return;
+  }
+  fwd.present = true;
+  fwd.resolved = route->isResolved();
+  const auto& info = route->getForwardInfo();
+  fwd.action = info.getAction();
+  const auto& nhops = info.getNextHopSet();
+  fwd.numNextHops = std::min<size_t>(
+      nhops.size(), std::numeric_limits<uint16_t>::max());
+  size_t idx = 0;
+  for (const auto& nhop : nhops) {
+    if (idx == kMaxLoggedNextHops) {
+      break;
+    }
+    auto& queued = fwd.nexthops[idx++];
+    queued.addr = nhop.addr();
+    queued.intf = nhop.isResolved() ? static_cast<uint32_t>(nhop.intf())
+                                    : kUnresolvedIntf;
+    queued.weight = nhop.weight();
+  }
+}
+
+template <typename AddrT>
+void RouteUpdateBinaryLog::logRoute(
+    RouteLogRecordType type,
+    const std::shared_ptr<Route<AddrT>>& oldRoute,
+    const std::shared_ptr<Route<AddrT>>& newRoute,
+    const std::vector<std::string>& identifiers) {
+  const auto& route = newRoute ? newRoute : oldRoute;
+  Entry entry;
+  entry.type = type;
+  entry.timestampUs = nowUs();
+  entry.network = route->prefix().network;
+  entry.mask = route->prefix().mask;
+  copyForwarding(oldRoute, entry.oldRoute);
+  copyForwarding(newRoute, entry.newRoute);
+  for (const auto& identifier : identifiers) {
+    auto id = getIdentifierId(identifier, entry.timestampUs);
+    if (!id) {
+      ++dropped_;
+      continue;
+    }
+    entry.identifier = *id;
+    enqueue(Entry(entry));
+  }
+}
+
+folly::Optional<uint16_t> RouteUpdateBinaryLog::getIdentifierId(
+    const std::string& identifier,
+    uint64_t timestampUs) {
+  std::lock_guard<std::mutex> g(identifierLock_);
+  auto itr = identifierIds_.find(identifier);
+  if (itr != identifierIds_.end()) {
+    return itr->second;
+  }
+  if (identifierIds_.size() > std::numeric_limits<uint16_t>::max()) {
+    return folly::none;
+  }
+  uint16_t id = identifierIds_.size();
+  Entry entry;
+  entry.type = RouteLogRecordType::IDENTIFIER;
+  entry.timestampUs = timestampUs;
+  entry.identifier = id;
+  entry.name = identifier.substr(0, std::numeric_limits<uint16_t>::max());
+  // Only take the id once its record is queued, so that the records using
+  // it can be decoded.  Otherwise we try again with the next update.
+  if (!entries_.write(std::move(entry))) {
+    return folly::none;
+  }
+  identifierIds_.emplace(identifier, id);
+  return id;
+}
+
+void RouteUpdateBinaryLog::enqueue(Entry&& entry) {
+  if (!entries_.write(std::move(entry))) {
+    ++dropped_;
+  }
+}
+
+void RouteUpdateBinaryLog::writeEntries() {
+  folly::setThreadName("routeUpdateLog");
+  const size_t batchSize = std::max(FLAGS_route_update_log_batch_size, 1);
+  std::string out;
+  while (true) {
+    Entry entry;
+    entries_.blockingRead(entry);
+    bool stop = entry.stop;
+    size_t count = 0;
+    while (!stop) {
+      encode(entry, out);
+      if (++count == batchSize || !entries_.read(entry)) {
+        break;
+      }
+      stop = entry.stop;
+    }
+    auto dropped = dropped_.exchange(0);
+    if (dropped > 0) {
+      totalDropped_ += dropped;
+      appendLE<uint8_t>(
+          out, static_cast<uint8_t>(RouteLogRecordType::DROPPED));
+      appendLE<uint64_t>(out, nowUs());
+      appendLE<uint64_t>(out, dropped);
+    }
+    if (!out.empty()) {
+      write(out);
+      out.clear();
+    }
+    if (stop) {
+      return;
+    }
+  }
+}
+
+void RouteUpdateBinaryLog::encode(const Entry& entry, std::string& out)
+    const {
+  appendLE<uint8_t>(out, static_cast<uint8_t>(entry.type));
+  appendLE<uint64_t>(out, entry.timestampUs);
+  appendLE<uint16_t>(out, entry.identifier);
+  if (entry.type == RouteLogRecordType::IDENTIFIER) {
+    appendLE<uint16_t>(out, entry.name.size());
+    out.append(entry.name);
+    return;
+  }
+  appendAddr(out, entry.network);
+  appendLE<uint8_t>(out, entry.mask);
+  for (const auto* fwd : {&entry.oldRoute, &entry.newRoute}) {
+    if (!fwd->present) {
+      continue;
+    }
+    appendLE<uint8_t>(out, fwd->resolved);
+    appendLE<uint8_t>(out, fwd->action);
+    appendLE<uint16_t>(out, fwd->numNextHops);
+    auto stored = std::min<size_t>(fwd->numNextHops, kMaxLoggedNextHops);
+    appendLE<uint8_t>(out, stored);
+    for (size_t i = 0; i < stored; ++i) {
+      const auto& nhop = fwd->nexthops[i];
+      appendAddr(out, nhop.addr);
+      appendLE<uint32_t>(out, nhop.intf);
+      appendLE<uint32_t>(out, nhop.weight);
+    }
+  }
+}
+
+void RouteUpdateBinaryLog::write(const std::string& data) {
+  if (folly::writeFull(fd_, data.data(), data.size()) < 0) {
+    // Once is enough, the disk is not likely to recover on its own
+    if (!writeFailed_) {
+      XLOG(ERR) << "Writing the route update log failed: "
+                << folly::errnoStr(errno);
+      writeFailed_ = true;
+    }
+  }
+}
+
+template void RouteUpdateBinaryLog::logRoute<folly::IPAddressV4>(
+    RouteLogRecordType type,
+    const std::shared_ptr<Route<folly::IPAddressV4>>& oldRoute,
+    const std::shared_ptr<Route<folly::IPAddressV4>>& newRoute,
+    const std::vector<std::string>& identifiers);
+template void RouteUpdateBinaryLog::logRoute<folly::IPAddressV6>(
+    RouteLogRecordType type,
+    const std::shared_ptr<Route<folly::IPAddressV6>>& oldRoute,
+    const std::shared_ptr<Route<folly::IPAddressV6>>& newRoute,
+    const std::vector<std::string>& identifiers);
+
+}} // facebook::fboss
@@ -0,0 +1,201 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#pragma once
+
+#include "fboss/agent/RouteUpdateLogger.h"
+
+#include <folly/IPAddress.h>
+#include <folly/MPMCQueue.h>
+#include <folly/Optional.h>
+#include <folly/Range.h>
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace facebook { namespace fboss {
+
+/*
+ * The route update log file is the header "FBRTLOG\0" and a version, then
+ * one record after another, all integers little endian.  Each record
+ * starts with its type and a timestamp in microseconds since the epoch.
+ * Identifiers are written once, as an IDENTIFIER record giving their id,
+ * and route records refer to them by id.  A route record holds the prefix
+ * and the forwarding of the old and/or new route, with at most
+ * kMaxLoggedNextHops next hops, along with how many there were.
+ */
+enum class RouteLogRecordType : uint8_t {
+  IDENTIFIER = 1,
+  ADDED = 2,
+  CHANGED = 3,
+  REMOVED = 4,
+  // Records that found the queue full, and were not written
+  DROPPED = 5,
+};
+
+constexpr uint32_t kRouteLogVersion = 1;
+constexpr size_t kMaxLoggedNextHops = 8;
+
+struct RouteLogNextHop {
+  folly::IPAddress addr;
+  // Unset if the next hop is not resolved
+  folly::Optional<uint32_t> intf;
+  uint32_t weight{0};
+};
+
+struct RouteLogForwarding {
+  bool resolved{false};
+  RouteForwardAction action{RouteForwardAction::DROP};
+  // All the next hops, of which at most kMaxLoggedNextHops are in nexthops
+  uint16_t numNextHops{0};
+  std::vector<RouteLogNextHop> nexthops;
+};
+
+struct RouteLogRecord {
+  RouteLogRecordType type;
+  uint64_t timestampUs{0};
+  std::string identifier;
+  folly::CIDRNetwork network;
+  folly::Optional<RouteLogForwarding> oldRoute;
+  folly::Optional<RouteLogForwarding> newRoute;
+  uint64_t dropped{0};
+
+  std::string str() const;
+};
+
+/*
+ * Decode a route update log.  Throws FbossError if data is not a route
+ * update log.  A record cut short at the end, as when the agent stopped in
+ * the middle of writing it, is left out and sets truncated.
+ */
+std::vector<RouteLogRecord> decodeRouteUpdateLog(
+    folly::ByteRange data,
+    bool* truncated = nullptr);
+
+/*
+ * RouteUpdateBinaryLog appends route updates to a file in the format
+ * above.  Logging a route only copies the fields we write into a fixed
+ * size entry on a lock free queue.  A thread of our own encodes the
+ * entries and writes them out in batches, so the state observers never
+ * wait on formatting or the disk.  An entry that finds the queue full is
+ * dropped and counted, and the count written out as a DROPPED record.
+ */
+class RouteUpdateBinaryLog {
+ public:
+  explicit RouteUpdateBinaryLog(const std::string& path);
+  ~RouteUpdateBinaryLog();
+
+  template <typename AddrT>
+  void logRoute(
+      RouteLogRecordType type,
+      const std::shared_ptr<Route<AddrT>>& oldRoute,
+      const std::shared_ptr<Route<AddrT>>& newRoute,
+      const std::vector<std::string>& identifiers);
+
+  uint64_t getDropped() const {
+    return totalDropped_.load(std::memory_order_relaxed);
+  }
+
+ private:
+  // Forbidden copy constructor and assignment operator
+  RouteUpdateBinaryLog(RouteUpdateBinaryLog const &) = delete;
+  RouteUpdateBinaryLog& operator=(RouteUpdateBinaryLog const &) = delete;
+
+  struct QueuedNextHop {
+    folly::IPAddress addr;
+    // kUnresolvedIntf if the next hop is not resolved
+    uint32_t intf{0};
+    uint32_t weight{0};
+  };
+  struct QueuedForwarding {
+    bool present{false};
+    bool resolved{false};
+    uint8_t action{0};
+    uint16_t numNextHops{0};
+    std::array<QueuedNextHop, kMaxLoggedNextHops> nexthops;
+  };
+  // What a record needs, copied out of the route.  Only identifier records
+  // carry a name, so route entries do not allocate.
+  struct Entry {
+    RouteLogRecordType type;
+    uint64_t timestampUs{0};
+    uint16_t identifier{0};
+    folly::IPAddress network;
+    uint8_t mask{0};
+    QueuedForwarding oldRoute;
+    QueuedForwarding newRoute;
+    std::string name;
+    // Stops the writer thread, and is not written
+    bool stop{false};
+  };
+
+  template <typename AddrT>
+  static void copyForwarding(
+      const std::shared_ptr<Route<AddrT>>& route,
+      QueuedForwarding& fwd);
+  // The id of the identifier, queueing its record if it has none yet
+  folly::Optional<uint16_t> getIdentifierId(
+      const std::string& identifier,
+      uint64_t timestampUs);
+  void enqueue(Entry&& entry);
+  void writeEntries();
+  void encode(const Entry& entry, std::string& out) const;
+  void write(const std::string& data);
+
+  int fd_{-1};
+  bool writeFailed_{false};
+  folly::MPMCQueue<Entry> entries_;
+  // Guards identifierIds_, since the v4 and v6 loggers share the log
+  std::mutex identifierLock_;
+  std::unordered_map<std::string, uint16_t> identifierIds_;
+  std::atomic<uint64_t> dropped_{0};
+  std::atomic<uint64_t> totalDropped_{0};
+  std::thread writerThread_;
+};
+
+template <typename AddrT>
+class BinaryRouteLogger : public RouteLogger<AddrT> {
+ public:
+  explicit BinaryRouteLogger(std::shared_ptr<RouteUpdateBinaryLog> log)
+      : log_(std::move(log)) {}
+
+  void logAddedRoute(
+      const std::shared_ptr<Route<AddrT>>& newRoute,
+      const std::vector<std::string>& identifiers) override {
+    log_->logRoute<AddrT>(
+        RouteLogRecordType::ADDED, nullptr, newRoute, identifiers);
+  }
+
+  void logChangedRoute(
+      const std::shared_ptr<Route<AddrT>>& oldRoute,
+      const std::shared_ptr<Route<AddrT>>& newRoute,
+      const std::vector<std::string>& identifiers) override {
+    log_->logRoute<AddrT>(
+        RouteLogRecordType::CHANGED, oldRoute, newRoute, identifiers);
+  }
+
+  void logRemovedRoute(
+      const std::shared_ptr<Route<AddrT>>& oldRoute,
+      const std::vector<std::string>& identifiers) override {
+    log_->logRoute<AddrT>(
+        RouteLogRecordType::REMOVED, oldRoute, nullptr, identifiers);
+  }
+
+ private:
+  std::shared_ptr<RouteUpdateBinaryLog> log_;
+};
+
+}} // facebook::fboss
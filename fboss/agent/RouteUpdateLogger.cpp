@@ -61,11 +61,20 @@ RouteUpdateLogger::RouteUpdateLogger(
     SwSwitch* sw,
     std::unique_ptr<RouteLogger<folly::IPAddressV4>> routeLoggerV4,
     std::unique_ptr<RouteLogger<folly::IPAddressV6>> routeLoggerV6)
-    : AutoRegisterStateObserver(sw, "RouteUpdateLogger"),
+    : AutoRegisterStateObserver(
+          sw, "RouteUpdateLogger", StateObserverDispatch::ASYNC),
       routeLoggerV4_(std::move(routeLoggerV4)),
       routeLoggerV6_(std::move(routeLoggerV6)) {}
 
+RouteUpdateLogger::~RouteUpdateLogger() {
+  stopObserving();
+}
+
 void RouteUpdateLogger::stateUpdated(const StateDelta& delta) {
+  // Nothing to match the changed routes against
+  if (prefixTracker_.empty()) {
+    return;
+  }
   for (const auto& rtDelta : delta.getRouteTablesDelta()) {
     DeltaFunctions::forEachChanged(
         rtDelta.getRoutesV4Delta(),
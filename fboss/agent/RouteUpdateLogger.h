@@ -77,7 +77,8 @@ class GlogRouteLogger : public RouteLogger<AddrT> {
  * Allow subscription to a prefix. When a route to a subscribed prefix
  * (or more specific location with that prefix) is added, removed, or
  * changes, log that information. The logger is pluggable, but by default
- * we use GLOG.
+ * we use GLOG, or the binary route update log if --route_update_log_file
+ * is given.
  */
 class RouteUpdateLogger : public AutoRegisterStateObserver {
  public:
@@ -87,7 +88,7 @@ class RouteUpdateLogger : public AutoRegisterStateObserver {
       std::unique_ptr<RouteLogger<folly::IPAddressV4>> routeLoggerV4,
       std::unique_ptr<RouteLogger<folly::IPAddressV6>> routeLoggerV6);
 
-  ~RouteUpdateLogger() override = default;
+  ~RouteUpdateLogger() override;
 
   void stateUpdated(const StateDelta& delta) override;
   void startLoggingForPrefix(const RouteUpdateLoggingInstance& req);
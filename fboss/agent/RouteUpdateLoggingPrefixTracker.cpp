@@ -11,6 +11,8 @@
 #include "RouteUpdateLoggingPrefixTracker.h"
 #include <folly/logging/xlog.h>
 
+#include <algorithm>
+
 namespace facebook { namespace fboss {
 
 RouteUpdateLoggingInstance::RouteUpdateLoggingInstance(
@@ -24,16 +26,43 @@ std::string RouteUpdateLoggingInstance::str() const {
       "{} {} {}", prefix.str(), identifier, exact ? "exact" : "longest-match");
 }
 
+template <typename AddrT>
+void RouteUpdateLoggingPrefixTracker::track(
+    Trie<AddrT>& trie,
+    const AddrT& network,
+    const RouteUpdateLoggingInstance& req) {
+  auto found = trie.insert(network, req.prefix.mask, Identifiers());
+  // Use the most recently set configuration
+  found.first->value()[req.identifier] = req.exact;
+}
+
 void RouteUpdateLoggingPrefixTracker::track(
     const RouteUpdateLoggingInstance& req) {
   XLOG(INFO) << "Tracking " << req.str();
   SYNCHRONIZED(trackedPrefixes_) {
-    auto found = trackedPrefixes_[req.identifier].insert(
-        req.prefix.network, req.prefix.mask, req);
-    // Use the most recently set configuration
-    if (!found.second) {
-      found.first.value() = req;
+    const auto& network = req.prefix.network;
+    if (network.isV4()) {
+      track(trackedPrefixes_.v4, network.asV4(), req);
+    } else {
+      track(trackedPrefixes_.v6, network.asV6(), req);
     }
+    updateCount(trackedPrefixes_);
+  }
+}
+
+template <typename AddrT>
+void RouteUpdateLoggingPrefixTracker::stopTracking(
+    Trie<AddrT>& trie,
+    const AddrT& network,
+    uint8_t mask,
+    const std::string& identifier) {
+  auto itr = trie.exactMatch(network, mask);
+  if (itr == trie.end()) {
+    return;
+  }
+  itr->value().erase(identifier);
+  if (itr->value().empty()) {
+    trie.erase(itr);
   }
 }
 
@@ -43,11 +72,30 @@ void RouteUpdateLoggingPrefixTracker::stopTracking(
     const std::string& identifier) {
   XLOG(INFO) << "Stop tracking " << prefix.str() << " " << identifier;
   SYNCHRONIZED(trackedPrefixes_) {
-    auto itr = trackedPrefixes_.find(identifier);
-    if (itr == trackedPrefixes_.end()) {
-      return;
+    if (prefix.network.isV4()) {
+      stopTracking(trackedPrefixes_.v4, prefix.network.asV4(), prefix.mask,
+                   identifier);
+    } else {
+      stopTracking(trackedPrefixes_.v6, prefix.network.asV6(), prefix.mask,
+                   identifier);
+    }
+    updateCount(trackedPrefixes_);
+  }
+}
+
+template <typename AddrT>
+void RouteUpdateLoggingPrefixTracker::stopTracking(
+    Trie<AddrT>& trie,
+    const std::string& identifier) {
+  std::vector<RoutePrefix<AddrT>> unused;
+  for (auto& itr : trie) {
+    itr->value().erase(identifier);
+    if (itr->value().empty()) {
+      unused.push_back(RoutePrefix<AddrT>{itr->ipAddress(), itr->masklen()});
     }
-    itr->second.erase(prefix.network, prefix.mask);
+  }
+  for (const auto& prefix : unused) {
+    trie.erase(prefix.network, prefix.mask);
   }
 }
 
@@ -55,40 +103,104 @@ void RouteUpdateLoggingPrefixTracker::stopTracking(
 void RouteUpdateLoggingPrefixTracker::stopTracking(
     const std::string& identifier) {
   XLOG(INFO) << "Stop tracking all prefixes for " << identifier;
-  trackedPrefixes_->erase(identifier);
+  SYNCHRONIZED(trackedPrefixes_) {
+    stopTracking(trackedPrefixes_.v4, identifier);
+    stopTracking(trackedPrefixes_.v6, identifier);
+    updateCount(trackedPrefixes_);
+  }
 }
 
-bool RouteUpdateLoggingPrefixTracker::trackingImpl(
-    const RoutePrefix<folly::IPAddress>& prefix,
+void RouteUpdateLoggingPrefixTracker::updateCount(const Tries& tries) {
+  numTracked_.store(tries.v4.size() + tries.v6.size(),
+                    std::memory_order_relaxed);
+}
+
+template <typename AddrT>
+bool RouteUpdateLoggingPrefixTracker::matchIdentifiers(
+    const Trie<AddrT>& trie,
+    const RoutePrefix<AddrT>& prefix,
+    std::vector<std::string>& identifiers) {
+  typename Trie<AddrT>::VecConstIterators trail;
+  auto match = trie.longestMatchWithTrail(prefix.network, prefix.mask, trail);
+  if (match == trie.end()) {
+    return false;
+  }
+  // Each identifier goes by the longest of its prefixes covering this one,
+  // so walk from the longest match up towards the root
+  std::vector<std::string> seen;
+  auto matchNode = [&](const typename Trie<AddrT>::ConstIterator& node) {
+    for (const auto& entry : node.value()) {
+      if (std::find(seen.begin(), seen.end(), entry.first) != seen.end()) {
+        continue;
+      }
+      seen.push_back(entry.first);
+      if (!entry.second || node.masklen() == prefix.mask) {
+        identifiers.push_back(entry.first);
+      }
+    }
+  };
+  matchNode(match);
+  for (auto itr = trail.rbegin(); itr != trail.rend(); ++itr) {
+    if (itr->masklen() < match.masklen()) {
+      matchNode(*itr);
+    }
+  }
+  return !identifiers.empty();
+}
+
+bool RouteUpdateLoggingPrefixTracker::tracking(
+    const RoutePrefix<folly::IPAddressV4>& prefix,
     std::vector<std::string>& identifiers) const {
   identifiers.clear();
-  SYNCHRONIZED_CONST(trackedPrefixes_) {
-    for (const auto& prefixes : trackedPrefixes_) {
-      const auto match =
-          prefixes.second.longestMatch(prefix.network, prefix.mask);
-      if (match != prefixes.second.end()) {
-        if (!match.value().exact) {
-          identifiers.push_back(prefixes.first);
-          continue;
-        }
-        if (match.value().prefix == prefix) {
-          identifiers.push_back(prefixes.first);
-        }
-      }
+  if (empty()) {
+    return false;
+  }
+  return matchIdentifiers(trackedPrefixes_.rlock()->v4, prefix, identifiers);
+}
+
+bool RouteUpdateLoggingPrefixTracker::tracking(
+    const RoutePrefix<folly::IPAddressV6>& prefix,
+    std::vector<std::string>& identifiers) const {
+  identifiers.clear();
+  if (empty()) {
+    return false;
+  }
+  return matchIdentifiers(trackedPrefixes_.rlock()->v6, prefix, identifiers);
+}
+
+bool RouteUpdateLoggingPrefixTracker::tracking(
+    const RoutePrefix<folly::IPAddress>& prefix,
+    std::vector<std::string>& identifiers) const {
+  if (prefix.network.isV4()) {
+    return tracking(
+        RoutePrefix<folly::IPAddressV4>{prefix.network.asV4(), prefix.mask},
+        identifiers);
+  }
+  return tracking(
+      RoutePrefix<folly::IPAddressV6>{prefix.network.asV6(), prefix.mask},
+      identifiers);
+}
+
+template <typename AddrT>
+void RouteUpdateLoggingPrefixTracker::addInstances(
+    const Trie<AddrT>& trie,
+    std::vector<RouteUpdateLoggingInstance>& instances) {
+  for (const auto& itr : trie) {
+    RoutePrefix<folly::IPAddress> prefix{
+        folly::IPAddress(itr->ipAddress()),
+        static_cast<uint8_t>(itr->masklen())};
+    for (const auto& entry : itr->value()) {
+      instances.emplace_back(prefix, entry.first, entry.second);
     }
   }
-  return (identifiers.size() > 0);
 }
 
 std::vector<RouteUpdateLoggingInstance>
 RouteUpdateLoggingPrefixTracker::getTrackedPrefixes() const {
   std::vector<RouteUpdateLoggingInstance> allPrefixes;
   SYNCHRONIZED_CONST(trackedPrefixes_) {
-    for (const auto& prefixes : trackedPrefixes_) {
-      for (const auto& itr : prefixes.second) {
-        allPrefixes.push_back(itr->value());
-      }
-    }
+    addInstances(trackedPrefixes_.v4, allPrefixes);
+    addInstances(trackedPrefixes_.v6, allPrefixes);
   }
   return allPrefixes;
 }
@@ -13,9 +13,11 @@
 #include "fboss/agent/state/RouteTypes.h"
 #include <folly/Synchronized.h>
 
+#include <atomic>
+#include <map>
 #include <memory>
+#include <string>
 #include <vector>
-#include <unordered_map>
 
 namespace facebook { namespace fboss {
 
@@ -42,6 +44,10 @@ struct RouteUpdateLoggingInstance {
  * Keep track of network prefixes that the agent will
  * log route updates for.
  *
+ * The tracked prefixes of all identifiers are kept in one trie per address
+ * family, so checking a route walks the trie once, however many
+ * identifiers there are.  Checking is cheap when nothing is tracked.
+ *
  * All the methods in this class are thread safe.
  */
 class RouteUpdateLoggingPrefixTracker {
@@ -61,27 +67,56 @@ class RouteUpdateLoggingPrefixTracker {
   void stopTracking(const std::string& identifier);
   std::vector<RouteUpdateLoggingInstance> getTrackedPrefixes() const;
 
+  bool empty() const {
+    return numTracked_.load(std::memory_order_relaxed) == 0;
+  }
+
   /* Returns whether or not the prefix is tracked for logging.
    * Will also populate identifiers with all of the identifiers that
    * tracking for this prefix was turned on with.
    */
-  template <typename AddrT>
   bool tracking(
-      const RoutePrefix<AddrT>& prefix,
-      std::vector<std::string>& identifiers) const {
-    folly::IPAddress addr{prefix.network};
-    RoutePrefix<folly::IPAddress> p{addr, prefix.mask};
-    return trackingImpl(p, identifiers);
-  }
-
- private:
-  bool trackingImpl(
+      const RoutePrefix<folly::IPAddressV4>& prefix,
+      std::vector<std::string>& identifiers) const;
+  bool tracking(
+      const RoutePrefix<folly::IPAddressV6>& prefix,
+      std::vector<std::string>& identifiers) const;
+  bool tracking(
       const RoutePrefix<folly::IPAddress>& prefix,
       std::vector<std::string>& identifiers) const;
-  folly::Synchronized<std::unordered_map<
-      std::string,
-      network::RadixTree<folly::IPAddress, RouteUpdateLoggingInstance>>>
-      trackedPrefixes_;
+
+ private:
+  // The identifiers tracking a prefix, and whether each wants exact matches
+  using Identifiers = std::map<std::string, bool>;
+  template <typename AddrT>
+  using Trie = network::RadixTree<AddrT, Identifiers>;
+  struct Tries {
+    Trie<folly::IPAddressV4> v4;
+    Trie<folly::IPAddressV6> v6;
+  };
+
+  template <typename AddrT>
+  static bool matchIdentifiers(
+      const Trie<AddrT>& trie,
+      const RoutePrefix<AddrT>& prefix,
+      std::vector<std::string>& identifiers);
+  template <typename AddrT>
+  static void track(Trie<AddrT>& trie, const AddrT& network,
+                    const RouteUpdateLoggingInstance& req);
+  template <typename AddrT>
+  static void stopTracking(Trie<AddrT>& trie, const AddrT& network,
+                           uint8_t mask, const std::string& identifier);
+  template <typename AddrT>
+  static void stopTracking(Trie<AddrT>& trie, const std::string& identifier);
+  template <typename AddrT>
+  static void addInstances(
+      const Trie<AddrT>& trie,
+      std::vector<RouteUpdateLoggingInstance>& instances);
+  void updateCount(const Tries& tries);
+
+  folly::Synchronized<Tries> trackedPrefixes_;
+  // The number of tracked prefixes, to skip the lock when there are none
+  std::atomic<size_t> numTracked_{0};
 };
 
 }} // facebook::fboss
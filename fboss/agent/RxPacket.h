@@ -12,6 +12,7 @@
 #include "fboss/agent/Packet.h"
 #include "fboss/agent/types.h"
 
+#include <chrono>
 #include <string>
 #include <tuple>
 #include <vector>
@@ -61,6 +62,17 @@ class RxPacket : public Packet {
     return RouterID(0);
   }
 
+  /*
+   * When the packet was received from the hardware, to measure how long it
+   * takes to handle.  The steady clock's epoch if it wasn't recorded.
+   */
+  std::chrono::steady_clock::time_point getRxTime() const {
+    return rxTime_;
+  }
+  void setRxTime(std::chrono::steady_clock::time_point rxTime) {
+    rxTime_ = rxTime;
+  }
+
   /*
    * Return a human-readable string describing additional detailed information
    * about the packet.
@@ -98,6 +110,7 @@ class RxPacket : public Packet {
   AggregatePortID srcAggregatePort_{0};
   VlanID srcVlan_{0};
   uint32_t len_{0};
+  std::chrono::steady_clock::time_point rxTime_;
 };
 
 }} // facebook::fboss
@@ -0,0 +1,77 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "fboss/agent/StartupProfiler.h"
+
+#include <folly/logging/xlog.h>
+#include <folly/system/ThreadId.h>
+
+#include <unistd.h>
+
+using std::chrono::duration_cast;
+using std::chrono::microseconds;
+
+namespace facebook { namespace fboss {
+
+StartupProfiler::Scope::Scope(folly::StringPiece name)
+    : profiler_(StartupProfiler::get()),
+      name_(name.str()),
+      begin_(Clock::now()) {}
+
+StartupProfiler::Scope::~Scope() {
+  profiler_->record(name_, begin_, Clock::now());
+}
+
+StartupProfiler* StartupProfiler::get() {
+  // Intentionally leaked, so phases can be recorded during shutdown
+  static auto* profiler = new StartupProfiler();
+  return profiler;
+}
+
+StartupProfiler::StartupProfiler() : start_(Clock::now()) {}
+
+void StartupProfiler::record(
+    folly::StringPiece name,
+    Clock::time_point begin,
+    Clock::time_point end) {
+  Phase phase;
+  phase.name = name.str();
+  phase.start = duration_cast<microseconds>(begin - start_);
+  phase.duration = duration_cast<microseconds>(end - begin);
+  phase.threadId = folly::getOSThreadID();
+  XLOG(DBG1) << "startup phase " << phase.name << " took "
+             << phase.duration.count() << "us";
+
+  std::lock_guard<std::mutex> guard(lock_);
+  phases_.push_back(std::move(phase));
+}
+
+std::vector<StartupProfiler::Phase> StartupProfiler::getPhases() const {
+  std::lock_guard<std::mutex> guard(lock_);
+  return phases_;
+}
+
+folly::dynamic StartupProfiler::toChromeTrace() const {
+  folly::dynamic events = folly::dynamic::array;
+  for (const auto& phase : getPhases()) {
+    // Complete events, with times in microseconds
+    events.push_back(folly::dynamic::object
+        ("name", phase.name)
+        ("ph", "X")
+        ("ts", phase.start.count())
+        ("dur", phase.duration.count())
+        ("pid", getpid())
+        ("tid", static_cast<int64_t>(phase.threadId)));
+  }
+  return folly::dynamic::object
+      ("traceEvents", std::move(events))
+      ("displayTimeUnit", "ms");
+}
+
+}} // facebook::fboss
@@ -0,0 +1,96 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#pragma once
+
+#include <folly/Range.h>
+#include <folly/dynamic.h>
+
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace facebook { namespace fboss {
+
+/*
+ * StartupProfiler records how long each phase of agent startup takes, and on
+ * which thread, so we can see where a restart spends its time and what
+ * could be done in parallel.
+ *
+ * There is a single profiler for the process, since startup spans the
+ * platform, the HwSwitch and the SwSwitch.  Phases may nest and may be
+ * recorded from any thread.
+ */
+class StartupProfiler {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  struct Phase {
+    std::string name;
+    // Relative to when the profiler was created
+    std::chrono::microseconds start{0};
+    std::chrono::microseconds duration{0};
+    uint64_t threadId{0};
+  };
+
+  /*
+   * Records the phase from construction to destruction.
+   */
+  class Scope {
+   public:
+    explicit Scope(folly::StringPiece name);
+    ~Scope();
+
+   private:
+    // Forbidden copy constructor and assignment operator
+    Scope(Scope const &) = delete;
+    Scope& operator=(Scope const &) = delete;
+
+    // Created before begin_, so the phase never starts before the profiler
+    StartupProfiler* const profiler_;
+    std::string name_;
+    Clock::time_point begin_;
+  };
+
+  /*
+   * The profiler for this process, created on first use.
+   */
+  static StartupProfiler* get();
+
+  StartupProfiler();
+
+  void record(
+      folly::StringPiece name,
+      Clock::time_point begin,
+      Clock::time_point end);
+
+  /*
+   * The phases recorded so far, in the order they finished.
+   */
+  std::vector<Phase> getPhases() const;
+
+  /*
+   * The phases as a Chrome trace ("Trace Event Format") document, which can
+   * be loaded in chrome://tracing to view the startup timeline.
+   */
+  folly::dynamic toChromeTrace() const;
+
+ private:
+  // Forbidden copy constructor and assignment operator
+  StartupProfiler(StartupProfiler const &) = delete;
+  StartupProfiler& operator=(StartupProfiler const &) = delete;
+
+  const Clock::time_point start_;
+  mutable std::mutex lock_;
+  std::vector<Phase> phases_;
+};
+
+}} // facebook::fboss
@@ -22,10 +22,14 @@ class StateObserver : public boost::noncopyable {
 
 class AutoRegisterStateObserver : public StateObserver {
  public:
-  AutoRegisterStateObserver(SwSwitch* sw, const std::string& name) : sw_(sw) {
-    sw_->registerStateObserver(this, name);
+  AutoRegisterStateObserver(
+      SwSwitch* sw,
+      const std::string& name,
+      StateObserverDispatch dispatch = StateObserverDispatch::SYNC)
+      : sw_(sw) {
+    sw_->registerStateObserver(this, name, dispatch);
   }
-  ~AutoRegisterStateObserver() override { sw_->unregisterStateObserver(this); }
+  ~AutoRegisterStateObserver() override { stopObserving(); }
 
   // This empty implementation should be overridden by subclasses, but it is
   // needed during destruction in the case that the derived class has been
@@ -34,8 +38,22 @@ class AutoRegisterStateObserver : public StateObserver {
   // during that time if this didn't exist.
   void stateUpdated(const StateDelta& /*delta*/) override {}
 
+ protected:
+  /*
+   * Unregister the observer ahead of the base class destructor.  ASYNC
+   * observers must call this from their own destructor, since they may be
+   * notified on the observer thread while the derived class is destroyed.
+   */
+  void stopObserving() {
+    if (registered_) {
+      registered_ = false;
+      sw_->unregisterStateObserver(this);
+    }
+  }
+
  private:
   SwSwitch* sw_{nullptr};
+  bool registered_{true};
 };
 
 }} // facebook::fboss
@@ -0,0 +1,445 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "fboss/agent/StateUpdateRecorder.h"
+
+#include "fboss/agent/FbossError.h"
+#include "fboss/agent/RxPacket.h"
+
+#include <folly/Bits.h>
+#include <folly/Conv.h>
+#include <folly/FileUtil.h>
+#include <folly/Format.h>
+#include <folly/ThreadName.h>
+#include <folly/io/Cursor.h>
+#include <folly/io/IOBuf.h>
+#include <folly/logging/xlog.h>
+#include <thrift/lib/cpp2/protocol/Serializer.h>
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <limits>
+
+DEFINE_string(state_update_record_file, "",
+              "Record the state updates and the inputs they are made from "
+              "to this file, rotated through "
+              "--state_update_record_files files, for "
+              "state_update_replay.  Not recorded if empty.");
+DEFINE_int64(state_update_record_file_bytes, 64 * 1024 * 1024,
+             "The size to rotate the state update record file at");
+DEFINE_int32(state_update_record_files, 4,
+             "The number of state update record files to keep, counting "
+             "the one being written");
+DEFINE_bool(state_update_record_packets, true,
+            "Record the packets trapped to the CPU with the state updates");
+DEFINE_int32(state_update_record_queue_size, 4096,
+             "The most records to queue for the state update record file "
+             "before dropping them");
+
+namespace {
+
+using facebook::fboss::FbossError;
+using facebook::fboss::StateUpdateRecordType;
+
+constexpr char kMagic[8] = {'F', 'B', 'S', 'U', 'L', 'O', 'G', '\0'};
+// Type, timestamp and payload length
+constexpr size_t kRecordHeaderBytes = 1 + 8 + 4;
+
+uint64_t nowUs() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+template <typename T>
+void appendLE(std::string& out, T value) {
+  value = folly::Endian::little(value);
+  out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+std::string encodeRecord(
+    StateUpdateRecordType type,
+    uint64_t timestampUs,
+    const std::string& payload) {
+  std::string out;
+  out.reserve(kRecordHeaderBytes + payload.size());
+  appendLE<uint8_t>(out, static_cast<uint8_t>(type));
+  appendLE<uint64_t>(out, timestampUs);
+  appendLE<uint32_t>(out, payload.size());
+  out.append(payload);
+  return out;
+}
+
+template <typename ThriftT>
+void appendThrift(std::string& out, const ThriftT& obj) {
+  auto data = apache::thrift::CompactSerializer::serialize<std::string>(obj);
+  appendLE<uint32_t>(out, data.size());
+  out.append(data);
+}
+
+template <typename ThriftT>
+ThriftT readThrift(folly::io::Cursor& cursor) {
+  auto len = cursor.readLE<uint32_t>();
+  auto data = cursor.readFixedString(len);
+  ThriftT obj;
+  apache::thrift::CompactSerializer::deserialize(data, obj);
+  return obj;
+}
+
+void decodePayload(
+    folly::io::Cursor& cursor,
+    facebook::fboss::StateUpdateRecord& record) {
+  using namespace facebook::fboss;
+  switch (record.type) {
+    case StateUpdateRecordType::STATE_UPDATE: {
+      record.updateClass =
+          static_cast<StateUpdateClass>(cursor.read<uint8_t>());
+      auto len = cursor.readLE<uint16_t>();
+      record.name = cursor.readFixedString(len);
+      return;
+    }
+    case StateUpdateRecordType::CONFIG:
+      record.name = cursor.readFixedString(cursor.totalLength());
+      return;
+    case StateUpdateRecordType::ADD_ROUTES:
+    case StateUpdateRecordType::SYNC_FIB:
+    case StateUpdateRecordType::DELETE_ROUTES: {
+      record.client = cursor.readLE<int16_t>();
+      record.vrf = RouterID(cursor.readLE<uint32_t>());
+      auto count = cursor.readLE<uint32_t>();
+      for (uint32_t i = 0; i < count; ++i) {
+        if (record.type == StateUpdateRecordType::DELETE_ROUTES) {
+          record.prefixes.push_back(readThrift<IpPrefix>(cursor));
+        } else {
+          record.routes.push_back(readThrift<UnicastRoute>(cursor));
+        }
+      }
+      return;
+    }
+    case StateUpdateRecordType::PACKET:
+      record.port = PortID(cursor.readLE<uint32_t>());
+      record.vlan = VlanID(cursor.readLE<uint16_t>());
+      record.packet = cursor.readFixedString(cursor.totalLength());
+      return;
+    case StateUpdateRecordType::LINK_STATE:
+      record.port = PortID(cursor.readLE<uint32_t>());
+      record.up = cursor.read<uint8_t>() != 0;
+      return;
+    case StateUpdateRecordType::DROPPED:
+      record.dropped = cursor.readLE<uint64_t>();
+      return;
+  }
+  throw FbossError(
+      "bad record type in state update record file: ",
+      static_cast<int>(record.type));
+}
+
+} // unnamed namespace
+
+namespace facebook { namespace fboss {
+
+const char* stateUpdateRecordTypeName(StateUpdateRecordType type) {
+  switch (type) {
+    case StateUpdateRecordType::STATE_UPDATE:
+      return "update";
+    case StateUpdateRecordType::CONFIG:
+      return "config";
+    case StateUpdateRecordType::ADD_ROUTES:
+      return "add routes";
+    case StateUpdateRecordType::SYNC_FIB:
+      return "sync fib";
+    case StateUpdateRecordType::DELETE_ROUTES:
+      return "delete routes";
+    case StateUpdateRecordType::PACKET:
+      return "packet";
+    case StateUpdateRecordType::LINK_STATE:
+      return "link state";
+    case StateUpdateRecordType::DROPPED:
+      return "dropped";
+  }
+  return "unknown";
+}
+
+std::string StateUpdateRecord::str() const {
+  auto prefix =
+      folly::sformat("{} {}", timestampUs, stateUpdateRecordTypeName(type));
+  switch (type) {
+    case StateUpdateRecordType::STATE_UPDATE:
+      return folly::sformat(
+          "{} \"{}\" ({})", prefix, name, stateUpdateClassName(updateClass));
+    case StateUpdateRecordType::CONFIG:
+      return folly::sformat("{}: {} bytes", prefix, name.size());
+    case StateUpdateRecordType::ADD_ROUTES:
+    case StateUpdateRecordType::SYNC_FIB:
+      return folly::sformat(
+          "{}: client {} vrf {}: {} routes",
+          prefix, client, vrf, routes.size());
+    case StateUpdateRecordType::DELETE_ROUTES:
+      return folly::sformat(
+          "{}: client {} vrf {}: {} prefixes",
+          prefix, client, vrf, prefixes.size());
+    case StateUpdateRecordType::PACKET:
+      return folly::sformat(
+          "{}: port {} vlan {}: {} bytes",
+          prefix, port, vlan, packet.size());
+    case StateUpdateRecordType::LINK_STATE:
+      return folly::sformat(
+          "{}: port {} {}", prefix, port, up ? "up" : "down");
+    case StateUpdateRecordType::DROPPED:
+      return folly::sformat("{} {} records", prefix, dropped);
+  }
+  return prefix;
+}
+
+std::vector<StateUpdateRecord> decodeStateUpdateRecords(
+    folly::ByteRange data,
+    bool* truncated) {
+  if (truncated) {
+    *truncated = false;
+  }
+  if (data.size() < sizeof(kMagic) + sizeof(uint32_t) ||
+      memcmp(data.data(), kMagic, sizeof(kMagic)) != 0) {
+    throw FbossError("not a state update record file");
+  }
+  auto buf = folly::IOBuf::wrapBuffer(data);
+  folly::io::Cursor cursor(buf.get());
+  cursor.skip(sizeof(kMagic));
+  auto version = cursor.readLE<uint32_t>();
+  if (version != kStateUpdateRecordVersion) {
+    throw FbossError(
+        "unsupported state update record file version ", version);
+  }
+
+  std::vector<StateUpdateRecord> records;
+  while (!cursor.isAtEnd()) {
+    StateUpdateRecord record;
+    std::unique_ptr<folly::IOBuf> payload;
+    try {
+      record.type =
+          static_cast<StateUpdateRecordType>(cursor.read<uint8_t>());
+      record.timestampUs = cursor.readLE<uint64_t>();
+      auto len = cursor.readLE<uint32_t>();
+      cursor.clone(payload, len);
+    } catch (const std::out_of_range&) {
+      if (truncated) {
+        *truncated = true;
+      }
+      break;
+    }
+    // The payload is all there, so running off its end is corruption
+    folly::io::Cursor payloadCursor(payload.get());
+    try {
+      decodePayload(payloadCursor, record);
+    } catch (const std::out_of_range&) {
+      throw FbossError(
+          "short ", stateUpdateRecordTypeName(record.type),
+          " record in state update record file");
+    }
+    records.push_back(std::move(record));
+  }
+  return records;
+}
+
+StateUpdateRecorder::StateUpdateRecorder(
+    const std::string& path,
+    int64_t fileBytes,
+    int32_t numFiles)
+    : path_(path),
+      fileBytes_(fileBytes),
+      numFiles_(std::max(numFiles, 1)),
+      entries_(std::max(FLAGS_state_update_record_queue_size, 1)) {
+  // The file left by the last run is rotated like any other, so that the
+  // run that was slow is not overwritten by the one reproducing it
+  openFile();
+  if (fd_ < 0) {
+    throw FbossError("failed to open state update record file ", path, ": ",
+                     folly::errnoStr(errno));
+  }
+  XLOG(INFO) << "Recording state updates to " << path;
+  writerThread_ = std::thread([this] { writeEntries(); });
+}
+
+StateUpdateRecorder::~StateUpdateRecorder() {
+  Entry stop;
+  stop.stop = true;
+  entries_.blockingWrite(std::move(stop));
+  writerThread_.join();
+  if (fd_ >= 0) {
+    folly::closeNoInt(fd_);
+  }
+}
+
+void StateUpdateRecorder::recordStateUpdate(
+    folly::StringPiece name,
+    StateUpdateClass cls) {
+  std::string payload;
+  auto len = std::min<size_t>(
+      name.size(), std::numeric_limits<uint16_t>::max());
+  appendLE<uint8_t>(payload, static_cast<uint8_t>(cls));
+  appendLE<uint16_t>(payload, len);
+  payload.append(name.data(), len);
+  Entry entry;
+  entry.data = encodeRecord(
+      StateUpdateRecordType::STATE_UPDATE, nowUs(), payload);
+  enqueue(std::move(entry));
+}
+
+void StateUpdateRecorder::recordConfig(const std::string& config) {
+  Entry entry;
+  entry.data = encodeRecord(StateUpdateRecordType::CONFIG, nowUs(), config);
+  entry.config = config;
+  enqueue(std::move(entry));
+}
+
+void StateUpdateRecorder::recordRoutes(
+    StateUpdateRecordType type,
+    int16_t client,
+    RouterID vrf,
+    const std::vector<UnicastRoute>& routes) {
+  std::string payload;
+  appendLE<int16_t>(payload, client);
+  appendLE<uint32_t>(payload, static_cast<uint32_t>(vrf));
+  appendLE<uint32_t>(payload, routes.size());
+  for (const auto& route : routes) {
+    appendThrift(payload, route);
+  }
+  Entry entry;
+  entry.data = encodeRecord(type, nowUs(), payload);
+  enqueue(std::move(entry));
+}
+
+void StateUpdateRecorder::recordDeletedRoutes(
+    int16_t client,
+    RouterID vrf,
+    const std::vector<IpPrefix>& prefixes) {
+  std::string payload;
+  appendLE<int16_t>(payload, client);
+  appendLE<uint32_t>(payload, static_cast<uint32_t>(vrf));
+  appendLE<uint32_t>(payload, prefixes.size());
+  for (const auto& prefix : prefixes) {
+    appendThrift(payload, prefix);
+  }
+  Entry entry;
+  entry.data = encodeRecord(
+      StateUpdateRecordType::DELETE_ROUTES, nowUs(), payload);
+  enqueue(std::move(entry));
+}
+
+void StateUpdateRecorder::recordPacket(const RxPacket* pkt) {
+  if (!FLAGS_state_update_record_packets) {
+    return;
+  }
+  std::string payload;
+  appendLE<uint32_t>(payload, static_cast<uint32_t>(pkt->getSrcPort()));
+  appendLE<uint16_t>(payload, static_cast<uint16_t>(pkt->getSrcVlan()));
+  folly::io::Cursor cursor(pkt->buf());
+  payload.append(cursor.readFixedString(pkt->buf()->computeChainDataLength()));
+  Entry entry;
+  entry.data = encodeRecord(StateUpdateRecordType::PACKET, nowUs(), payload);
+  enqueue(std::move(entry));
+}
+
+void StateUpdateRecorder::recordLinkState(PortID port, bool up) {
+  std::string payload;
+  appendLE<uint32_t>(payload, static_cast<uint32_t>(port));
+  appendLE<uint8_t>(payload, up);
+  Entry entry;
+  entry.data = encodeRecord(
+      StateUpdateRecordType::LINK_STATE, nowUs(), payload);
+  enqueue(std::move(entry));
+}
+
+void StateUpdateRecorder::enqueue(Entry&& entry) {
+  if (!entries_.write(std::move(entry))) {
+    ++dropped_;
+  }
+}
+
+void StateUpdateRecorder::writeEntries() {
+  folly::setThreadName("stateUpdateRec");
+  while (true) {
+    Entry entry;
+    entries_.blockingRead(entry);
+    if (entry.stop) {
+      return;
+    }
+    auto dropped = dropped_.exchange(0);
+    if (dropped > 0) {
+      totalDropped_ += dropped;
+      std::string payload;
+      appendLE<uint64_t>(payload, dropped);
+      write(encodeRecord(StateUpdateRecordType::DROPPED, nowUs(), payload));
+    }
+    if (fileSize_ >= fileBytes_) {
+      openFile();
+    }
+    if (!entry.config.empty()) {
+      lastConfig_ = std::move(entry.config);
+    }
+    write(entry.data);
+  }
+}
+
+void StateUpdateRecorder::openFile() {
+  if (fd_ >= 0) {
+    folly::closeNoInt(fd_);
+    fd_ = -1;
+  }
+  if (numFiles_ > 1) {
+    auto rotated = [this](int32_t idx) {
+      return folly::to<std::string>(path_, ".", idx);
+    };
+    unlink(rotated(numFiles_ - 1).c_str());
+    for (int32_t idx = numFiles_ - 2; idx > 0; --idx) {
+      rename(rotated(idx).c_str(), rotated(idx + 1).c_str());
+    }
+    rename(path_.c_str(), rotated(1).c_str());
+  }
+  fd_ = folly::openNoInt(
+      path_.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  fileSize_ = 0;
+  if (fd_ < 0) {
+    if (!writeFailed_) {
+      XLOG(ERR) << "Opening the state update record file failed: "
+                << folly::errnoStr(errno);
+      writeFailed_ = true;
+    }
+    return;
+  }
+  std::string header(kMagic, sizeof(kMagic));
+  appendLE<uint32_t>(header, kStateUpdateRecordVersion);
+  write(header);
+  // Stamped now rather than when it was applied, so that a replay at the
+  // original speed doesn't wait out the time since
+  if (!lastConfig_.empty()) {
+    write(encodeRecord(StateUpdateRecordType::CONFIG, nowUs(), lastConfig_));
+  }
+}
+
+void StateUpdateRecorder::write(const std::string& data) {
+  if (fd_ < 0) {
+    return;
+  }
+  if (folly::writeFull(fd_, data.data(), data.size()) < 0) {
+    // Once is enough, the disk is not likely to recover on its own
+    if (!writeFailed_) {
+      XLOG(ERR) << "Writing the state update record file failed: "
+                << folly::errnoStr(errno);
+      writeFailed_ = true;
+    }
+    return;
+  }
+  fileSize_ += data.size();
+}
+
+}} // facebook::fboss
@@ -0,0 +1,167 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#pragma once
+
+#include "fboss/agent/if/gen-cpp2/ctrl_types.h"
+#include "fboss/agent/state/StateUpdate.h"
+#include "fboss/agent/types.h"
+
+#include <folly/MPMCQueue.h>
+#include <folly/Range.h>
+#include <gflags/gflags.h>
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+DECLARE_string(state_update_record_file);
+DECLARE_int64(state_update_record_file_bytes);
+DECLARE_int32(state_update_record_files);
+DECLARE_bool(state_update_record_packets);
+DECLARE_int32(state_update_record_queue_size);
+
+namespace facebook { namespace fboss {
+
+class RxPacket;
+
+/*
+ * A state update record file is the header "FBSULOG\0" and a version, then
+ * one record after another, all integers little endian.  Each record is its
+ * type, a timestamp in microseconds since the epoch, and the length of the
+ * rest of the record.
+ *
+ * STATE_UPDATE records name every update SwSwitch schedules, for the
+ * timeline.  The other records are the inputs the updates are made from,
+ * and are what is replayed: configs applied, route updates from thrift
+ * clients (serialized with the compact protocol), trapped packets and link
+ * state changes.
+ */
+enum class StateUpdateRecordType : uint8_t {
+  STATE_UPDATE = 1,
+  CONFIG = 2,
+  ADD_ROUTES = 3,
+  SYNC_FIB = 4,
+  DELETE_ROUTES = 5,
+  PACKET = 6,
+  LINK_STATE = 7,
+  // Records that found the queue full, and were not written
+  DROPPED = 8,
+};
+
+constexpr uint32_t kStateUpdateRecordVersion = 1;
+
+const char* stateUpdateRecordTypeName(StateUpdateRecordType type);
+
+struct StateUpdateRecord {
+  StateUpdateRecordType type;
+  uint64_t timestampUs{0};
+  // The name of a STATE_UPDATE, or the config of a CONFIG
+  std::string name;
+  StateUpdateClass updateClass{StateUpdateClass::DEFAULT};
+  // Routes
+  int16_t client{0};
+  RouterID vrf{0};
+  std::vector<UnicastRoute> routes;
+  std::vector<IpPrefix> prefixes;
+  // Packets and link state changes
+  PortID port{0};
+  VlanID vlan{0};
+  std::string packet;
+  bool up{false};
+  uint64_t dropped{0};
+
+  std::string str() const;
+};
+
+/*
+ * Decode a state update record file.  Throws FbossError if data is not one.
+ * A record cut short at the end, as when the agent stopped in the middle of
+ * writing it, is left out and sets truncated.
+ */
+std::vector<StateUpdateRecord> decodeStateUpdateRecords(
+    folly::ByteRange data,
+    bool* truncated = nullptr);
+
+/*
+ * StateUpdateRecorder writes the state updates and their inputs to a ring
+ * of files, for state_update_replay to feed to a SimSwitch offline.
+ *
+ * The records are encoded by the callers and queued, and a thread of our
+ * own writes them out, so recording never waits on the disk.  A record that
+ * finds the queue full is dropped and counted.  The file being written is
+ * path; once it is over the size given it is rotated to path.1, path.1 to
+ * path.2 and so on, and the oldest is deleted.  Each file starts with the
+ * last config recorded, so that any of them can be replayed from its start.
+ */
+class StateUpdateRecorder {
+ public:
+  StateUpdateRecorder(
+      const std::string& path,
+      int64_t fileBytes,
+      int32_t numFiles);
+  ~StateUpdateRecorder();
+
+  void recordStateUpdate(folly::StringPiece name, StateUpdateClass cls);
+  void recordConfig(const std::string& config);
+  // ADD_ROUTES or SYNC_FIB
+  void recordRoutes(
+      StateUpdateRecordType type,
+      int16_t client,
+      RouterID vrf,
+      const std::vector<UnicastRoute>& routes);
+  void recordDeletedRoutes(
+      int16_t client,
+      RouterID vrf,
+      const std::vector<IpPrefix>& prefixes);
+  void recordPacket(const RxPacket* pkt);
+  void recordLinkState(PortID port, bool up);
+
+  uint64_t getDropped() const {
+    return totalDropped_.load(std::memory_order_relaxed);
+  }
+
+ private:
+  // Forbidden copy constructor and assignment operator
+  StateUpdateRecorder(StateUpdateRecorder const &) = delete;
+  StateUpdateRecorder& operator=(StateUpdateRecorder const &) = delete;
+
+  struct Entry {
+    // The encoded record
+    std::string data;
+    // The config of a CONFIG record, to start the next file with
+    std::string config;
+    // Stops the writer thread, and is not written
+    bool stop{false};
+  };
+
+  void enqueue(Entry&& entry);
+  void writeEntries();
+  // Start a new file, rotating the existing ones
+  void openFile();
+  void write(const std::string& data);
+
+  const std::string path_;
+  const int64_t fileBytes_;
+  const int32_t numFiles_;
+  folly::MPMCQueue<Entry> entries_;
+  std::atomic<uint64_t> dropped_{0};
+  std::atomic<uint64_t> totalDropped_{0};
+
+  // Only used from the writer thread
+  int fd_{-1};
+  int64_t fileSize_{0};
+  bool writeFailed_{false};
+  std::string lastConfig_;
+  std::thread writerThread_;
+};
+
+}} // facebook::fboss
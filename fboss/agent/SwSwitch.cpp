@@ -14,23 +14,36 @@
 #include <thrift/lib/cpp2/async/RequestChannel.h>
 
 #include <folly/Demangle.h>
+#include <folly/Exception.h>
+#include <folly/ExceptionString.h>
+#include <folly/File.h>
 #include <folly/FileUtil.h>
 #include <folly/GLog.h>
 #include <folly/MacAddress.h>
 #include <folly/MapUtil.h>
+#include <folly/ScopeGuard.h>
 #include <folly/SocketAddress.h>
 #include <folly/String.h>
 #include <folly/logging/xlog.h>
 #include <folly/system/ThreadName.h>
 #include <glog/logging.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <algorithm>
 #include <chrono>
 #include <condition_variable>
+#include <cstring>
 #include <exception>
 #include <tuple>
 #include "common/stats/ServiceData.h"
 #include "fboss/agent/ApplyThriftConfig.h"
 #include "fboss/agent/ArpHandler.h"
+#include "fboss/agent/ConfigStager.h"
 #include "fboss/agent/Constants.h"
+#include "fboss/agent/DHCPv4Handler.h"
+#include "fboss/agent/DHCPv6Handler.h"
+#include "fboss/agent/EventTrace.h"
 #include "fboss/agent/FbossError.h"
 #include "fboss/agent/HwSwitch.h"
 #include "fboss/agent/IPv4Handler.h"
@@ -38,30 +51,57 @@
 #include "fboss/agent/LacpTypes.h"
 #include "fboss/agent/LinkAggregationManager.h"
 #include "fboss/agent/LldpManager.h"
+#include "fboss/agent/LoadImbalanceMonitor.h"
+#include "fboss/agent/MacLearner.h"
+#include "fboss/agent/MemoryAccount.h"
+#include "fboss/agent/MicroBfdManager.h"
+#include "fboss/agent/NeighborChangeStream.h"
+#include "fboss/agent/RouteChangeStream.h"
 #include "fboss/agent/NeighborUpdater.h"
+#include "fboss/agent/IcmpErrorLimiter.h"
+#include "fboss/agent/PacketPolicer.h"
+#include "fboss/agent/PacketRxPool.h"
+#include "fboss/agent/PolicerTuner.h"
 #include "fboss/agent/Platform.h"
 #include "fboss/agent/PortRemediator.h"
 #include "fboss/agent/PortStats.h"
+#include "fboss/agent/PortStatsSnapshot.h"
+#include "fboss/agent/PuntStats.h"
 #include "fboss/agent/PortUpdateHandler.h"
 #include "fboss/agent/RouteUpdateLogger.h"
 #include "fboss/agent/RxPacket.h"
+#include "fboss/agent/StartupProfiler.h"
+#include "fboss/agent/StateUpdateRecorder.h"
+#include "fboss/agent/WarmBootTimeline.h"
 #include "fboss/agent/SwitchStats.h"
+#include "fboss/agent/ThreadLayout.h"
 #include "fboss/agent/ThriftHandler.h"
 #include "fboss/agent/TunManager.h"
 #include "fboss/agent/TxPacket.h"
+#include "fboss/agent/UDPHeader.h"
 #include "fboss/agent/UnresolvedNhopsProber.h"
 #include "fboss/agent/Utils.h"
 #include "fboss/agent/capture/PktCaptureManager.h"
 #include "fboss/agent/gen-cpp2/switch_config_types_custom_protocol.h"
 #include "fboss/agent/packet/EthHdr.h"
+#include "fboss/agent/packet/ICMPHdr.h"
+#include "fboss/agent/packet/IPProto.h"
 #include "fboss/agent/packet/IPv4Hdr.h"
 #include "fboss/agent/packet/IPv6Hdr.h"
+#include "fboss/agent/packet/ParsedPacket.h"
 #include "fboss/agent/packet/PktUtil.h"
 #include "fboss/agent/state/AggregatePort.h"
+#include "fboss/agent/state/ArpTable.h"
+#include "fboss/agent/state/NdpTable.h"
+#include "fboss/agent/state/NodeAllocator.h"
 #include "fboss/agent/state/RouteUpdater.h"
 #include "fboss/agent/state/StateDelta.h"
+#include "fboss/agent/state/StateMemoryAccounting.h"
 #include "fboss/agent/state/StateUpdateHelpers.h"
 #include "fboss/agent/state/SwitchState.h"
+#include "fboss/agent/state/VlanMap.h"
+#include "fboss/pcap_distribution_service/PacketBatcher.h"
+#include "fboss/pcap_distribution_service/ShmPacketRing.h"
 #include "fboss/pcap_distribution_service/if/gen-cpp2/PcapPushSubscriber.h"
 #include "fboss/pcap_distribution_service/if/gen-cpp2/pcap_pubsub_constants.h"
 
@@ -87,8 +127,67 @@ using namespace apache::thrift::protocol;
 using namespace apache::thrift::async;
 
 
-DEFINE_string(config, "", "The path to the local JSON configuration file");
+DEFINE_string(config, "", "The path to the local JSON configuration file, "
+              "or its thrift compact encoding if it ends in .compact");
 DEFINE_int32(thread_heartbeat_ms, 1000, "Thread heartbeat interval (ms)");
+DEFINE_int32(thread_stall_threshold_ms, 5000,
+             "Log the stack, activity and latest events of a thread whose "
+             "heartbeat is this late (ms), 0 to not watch for stalls");
+DEFINE_bool(cache_state_serialization, false,
+            "Cache the serialized form of unchanged SwitchState nodes between "
+            "state dumps, trading memory for faster repeated dumps");
+DEFINE_bool(enable_node_id_index, false,
+            "Maintain an index from NodeID to the nodes of the current "
+            "SwitchState for HwSwitch implementations and observers");
+DEFINE_int32(max_pending_state_reclaims, 16,
+             "Maximum number of retired SwitchState references queued for "
+             "destruction on the reclaim thread.  Once this many are pending, "
+             "retired states are destroyed inline on the update thread.");
+DEFINE_int32(max_pending_observer_updates, 32,
+             "Maximum number of state deltas queued for asynchronous state "
+             "observers.  Once this many are pending, the update thread waits "
+             "for the observer thread to catch up before applying more "
+             "updates.");
+DEFINE_int32(slow_state_update_ms, 1000,
+             "Log where the time went for any state update, or asynchronous "
+             "state observer notification, that takes longer than this.  0 "
+             "disables the logging.");
+DEFINE_int32(rx_worker_threads, 0,
+             "Number of threads processing trapped packets.  0 processes "
+             "each packet on the thread the hardware delivers it on.");
+DEFINE_int32(rx_worker_queue_size, 1024,
+             "Maximum number of packets queued per CoS queue for each packet "
+             "processing thread, beyond which packets are dropped");
+DEFINE_int32(rx_worker_steal_threshold, 256,
+             "Once this many packets are queued for a packet processing "
+             "thread, idle threads help process them, at the cost of "
+             "ordering.  0 disables work stealing.");
+DEFINE_int32(rx_strict_priority_cos, 6,
+             "CPU CoS queues from this one up are processed in strict "
+             "priority by the packet processing threads.  The ones below "
+             "take turns, weighted by their CoS, so that a flood in one "
+             "doesn't hold up the others.");
+DEFINE_int32(max_deferred_state_update_batches, 8,
+             "Maximum number of state update batches in a row that may leave "
+             "route, config and other non-urgent updates pending while link "
+             "and neighbor updates are applied first");
+DEFINE_int32(state_update_coalesce_window_ms, 0,
+             "Hold coalescable state updates for up to this long after the "
+             "oldest of them was queued, so that more of them are applied in "
+             "one batch.  0 applies pending updates as soon as possible.");
+DEFINE_int32(state_update_coalesce_max_updates, 0,
+             "Stop holding state updates for the coalescing window once this "
+             "many are pending.  0 means no limit.");
+DEFINE_int32(config_acl_stage_size, 0,
+             "Apply the ACL changes of a config in stages of at most this "
+             "many entries, after the rest of the config, so other state "
+             "updates can go in between.  0 applies them all at once.");
+DEFINE_int32(state_memory_generations, 4,
+             "How many of the last applied states the memory accounting "
+             "tells apart from the current one, if they are still alive");
+DEFINE_int32(memory_accounting_interval_s, 60,
+             "How often to export the memory accounting counters, which "
+             "walks the whole state.  0 disables them.");
 DEFINE_int32(
     distribution_timeout_ms,
     1000,
@@ -138,10 +237,72 @@ facebook::fboss::PortStatus fillInPortStatus(
   }
   return status;
 }
+
+int64_t nowUsec() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::system_clock::now().time_since_epoch()).count();
+}
 } // anonymous namespace
 
 namespace facebook { namespace fboss {
 
+namespace {
+
+/*
+ * The protocol to record the handling latency of a valid trapped packet
+ * under.
+ */
+SwitchStats::PacketProtocol getPacketProtocol(
+    const RxPacket* pkt,
+    const ParsedPacket& parsed) {
+  using Protocol = SwitchStats::PacketProtocol;
+  switch (parsed.etherType) {
+    case ArpHandler::ETHERTYPE_ARP:
+      return Protocol::ARP;
+    case LldpManager::ETHERTYPE_LLDP:
+      return Protocol::LLDP;
+    case LACPDU::EtherType::SLOW_PROTOCOLS:
+      return Protocol::LACP;
+    case IPv4Handler::ETHERTYPE_IPV4:
+    case IPv6Handler::ETHERTYPE_IPV6:
+      break;
+    default:
+      return Protocol::OTHER;
+  }
+  if (!parsed.hasL4()) {
+    return Protocol::TO_HOST;
+  }
+  Cursor cursor(pkt->buf());
+  cursor += parsed.l4Offset;
+  if (parsed.ipProtocol == IP_PROTO_ICMP) {
+    return Protocol::ICMP;
+  }
+  if (parsed.ipProtocol == IP_PROTO_IPV6_ICMP) {
+    if (!cursor.canAdvance(1)) {
+      return Protocol::ICMP;
+    }
+    auto type = cursor.read<uint8_t>();
+    return type >= ICMPV6_TYPE_NDP_ROUTER_SOLICITATION &&
+            type <= ICMPV6_TYPE_NDP_REDIRECT_MESSAGE
+        ? Protocol::NDP
+        : Protocol::ICMP;
+  }
+  if (parsed.ipProtocol == IP_PROTO_UDP) {
+    // The UDP header was checked to be there when the packet was parsed
+    UDPHeader udpHdr;
+    udpHdr.parse(&cursor);
+    bool dhcp = parsed.etherType == IPv4Handler::ETHERTYPE_IPV4
+        ? DHCPv4Handler::isDHCPv4Packet(udpHdr)
+        : DHCPv6Handler::isForDHCPv6RelayOrServer(udpHdr);
+    if (dhcp) {
+      return Protocol::DHCP;
+    }
+  }
+  return Protocol::TO_HOST;
+}
+
+} // unnamed namespace
+
 class ChannelCloser : public CloseCallback {
  public:
   explicit ChannelCloser(SwSwitch* s) : s_(s) {}
@@ -158,12 +319,34 @@ class ChannelCloser : public CloseCallback {
 SwSwitch::SwSwitch(std::unique_ptr<Platform> platform)
   : hw_(platform->getHwSwitch()),
     platform_(std::move(platform)),
+    icmpErrorLimiter_(new IcmpErrorLimiter()),
+    puntStats_(new PuntStats()),
     portRemediator_(new PortRemediator(this)),
     closer_(new ChannelCloser(this)),
     arp_(new ArpHandler(this)),
     ipv4_(new IPv4Handler(this)),
     ipv6_(new IPv6Handler(this)),
     nUpdater_(new NeighborUpdater(this)),
+    neighborChanges_(new NeighborChangeStream(
+        &backgroundEventBase_,
+        [this](std::shared_ptr<const NeighborChangesThrift> batch) {
+          lock_guard<mutex> g(neighborListenerMutex_);
+          stats()->neighborChangeBatch();
+          if (neighborChangeListener_) {
+            neighborChangeListener_(std::move(batch));
+          }
+        })),
+    routeChanges_(new RouteChangeStream(
+        &backgroundEventBase_,
+        [this](std::shared_ptr<const RouteChangeBatch> batch) {
+          lock_guard<mutex> g(neighborListenerMutex_);
+          stats()->routeChangeBatch();
+          if (routeChangeListener_) {
+            routeChangeListener_(std::move(batch));
+          }
+        })),
+    portStatsSnapshot_(new PortStatsSnapshot()),
+    loadImbalanceMonitor_(new LoadImbalanceMonitor()),
     pcapMgr_(new PktCaptureManager(this)),
     routeUpdateLogger_(new RouteUpdateLogger(this)),
     portUpdateHandler_(new PortUpdateHandler(this)) {
@@ -174,11 +357,35 @@ SwSwitch::SwSwitch(std::unique_ptr<Platform> platform)
 
   // doesnt need to be guarded, only accessed by 1 event base
   pcapPusher_ = nullptr;
+  pcapBatcher_ = std::make_shared<PacketBatcher>(
+      &pcapDistributionEventBase_, [this](const PacketBatch& batch) {
+        if (!pcapPusher_) {
+          return folly::makeFuture<folly::Unit>(
+              std::runtime_error("no distribution service client"));
+        }
+        return pcapPusher_->future_receivePacketBatch(batch).then(
+            [this](folly::Try<folly::Unit>&& result) {
+              if (result.hasException()) {
+                stats()->pcapDistFailure();
+                FB_LOG_EVERY_MS(ERROR, 1000)
+                    << "Unable to push packets to distribution service\n";
+              }
+              result.throwIfFailed();
+            });
+      });
+
+  if (FLAGS_cache_state_serialization) {
+    stateSerializationCache_ = std::make_unique<NodeSerializationCache>();
+  }
+  if (FLAGS_enable_node_id_index) {
+    nodeIdIndex_ = std::make_unique<NodeIdIndex>();
+  }
 }
 
 
 void SwSwitch::destroyPushClient(){
   distributionServiceReady_.store(false);
+  std::atomic_store(&pcapRing_, std::shared_ptr<ShmPacketRing>());
 }
 
 void SwSwitch::constructPushClient(uint16_t port) {
@@ -191,11 +398,48 @@ void SwSwitch::constructPushClient(uint16_t port) {
     chan->setCloseCallback(closer_.get());
     pcapPusher_ =
         std::make_unique<PcapPushSubscriberAsyncClient>(std::move(chan));
+    connectPacketRing();
     distributionServiceReady_.store(true);
   };
   pcapDistributionEventBase_.runInEventBaseThread(creation);
 }
 
+void SwSwitch::connectPacketRing() {
+  if (FLAGS_pcap_shm_socket.empty()) {
+    return;
+  }
+  std::unique_ptr<ShmPacketRing> ring;
+  try {
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (FLAGS_pcap_shm_socket.size() >= sizeof(addr.sun_path)) {
+      throw FbossError("socket path ", FLAGS_pcap_shm_socket, " too long");
+    }
+    memcpy(addr.sun_path, FLAGS_pcap_shm_socket.data(),
+           FLAGS_pcap_shm_socket.size());
+
+    folly::File socket(::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0), true);
+    folly::checkUnixError(socket.fd(), "failed to create packet ring socket");
+    // The service sends the ring as soon as it accepts, so this only waits
+    // if it is wedged
+    struct timeval timeout = {2, 0};
+    setsockopt(socket.fd(), SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    folly::checkUnixError(
+        connect(socket.fd(), reinterpret_cast<struct sockaddr*>(&addr),
+                sizeof(addr)),
+        "failed to connect to ", FLAGS_pcap_shm_socket);
+    ring = ShmPacketRing::receiveFrom(socket.fd());
+    XLOG(INFO) << "Sending packets to the distribution service through a "
+               << ring->capacity() / 1024 << "KB shared memory ring";
+  } catch (const std::exception& ex) {
+    XLOG(INFO) << "No packet ring from the distribution service, sending "
+               << "packets with thrift: " << folly::exceptionStr(ex);
+  }
+  std::atomic_store(
+      &pcapRing_, std::shared_ptr<ShmPacketRing>(std::move(ring)));
+}
+
 void SwSwitch::killDistributionProcess(){
   pcapPusher_->future_kill();
   XLOG(INFO) << "KILLING DISTRIBUTION PROCESS FROM AGENT";
@@ -215,6 +459,20 @@ void SwSwitch::stop() {
   // while we are destroying ourselves
   hw_->unregisterCallbacks();
 
+  // Stop processing the packets that were already received, dropping any
+  // still queued
+  if (rxPool_) {
+    rxPool_->stop();
+  }
+  if (macLearner_) {
+    macLearner_->stop();
+  }
+  if (packetPolicer_) {
+    unregisterStateObserver(packetPolicer_.get());
+    packetPolicer_.reset();
+    unregisterStateObserver(icmpErrorLimiter_.get());
+  }
+
   // Stop tunMgr so we don't get any packets to process
   // in software that were sent to the switch ip or were
   // routed from kernel to the front panel tunnel interface.
@@ -233,11 +491,32 @@ void SwSwitch::stop() {
   portRemediator_.reset();
 
   nUpdater_.reset();
+  neighborChanges_.reset();
+  routeChanges_.reset();
+
+  // Packets may still be published from the threads that send them, which
+  // keep the batcher they got alive until they're done with it
+  distributionServiceReady_.store(false);
+  auto pcapBatcher =
+      std::atomic_exchange(&pcapBatcher_, std::shared_ptr<PacketBatcher>());
+  std::atomic_store(&pcapRing_, std::shared_ptr<ShmPacketRing>());
+  pcapBatcher.reset();
 
   if (lldpManager_) {
     lldpManager_->stop();
   }
 
+  // No more dampened links are released once we stop getting link events
+  if (linkReuseTimeout_) {
+    backgroundEventBase_.runInEventBaseThreadAndWait(
+        [this] { linkReuseTimeout_.reset(); });
+  }
+
+  // Stop the micro-BFD sessions before the LAG manager they report to
+  if (microBfd_) {
+    microBfd_.reset();
+  }
+
   if (lagManager_) {
     lagManager_.reset();
   }
@@ -254,10 +533,12 @@ void SwSwitch::stop() {
 
   routeUpdateLogger_.reset();
 
+  heartbeatWatchdog_.reset();
   bgThreadHeartbeat_.reset();
   updThreadHeartbeat_.reset();
   packetTxThreadHeartbeat_.reset();
   lacpThreadHeartbeat_.reset();
+  eventLoopHeartbeats_.clear();
 
   // stops the background and update threads.
   stopThreads();
@@ -304,6 +585,8 @@ SwSwitch::SwitchRunState SwSwitch::getSwitchRunState() const {
 void SwSwitch::gracefulExit() {
   if (isFullyInitialized()) {
     steady_clock::time_point begin = steady_clock::now();
+    WarmBootTimeline::get()->mark(
+        WarmBootTimeline::Event::GRACEFUL_EXIT_START);
     XLOG(INFO) << "[Exit] Starting SwSwitch graceful exit";
     ipv6_->floodNeighborAdvertisements();
     arp_->floodGratuituousArp();
@@ -324,7 +607,10 @@ void SwSwitch::gracefulExit() {
     // file. Right now we just serialize applied state and
     // then rely on a route/FIB sync on warm boot to recover
     // desired state.
-    switchState[kSwSwitch] = getAppliedState()->toFollyDynamic();
+    {
+      auto cacheScope = serializationCacheScope();
+      switchState[kSwSwitch] = getAppliedState()->toFollyDynamic();
+    }
     steady_clock::time_point switchStateToFollyDone = steady_clock::now();
     XLOG(INFO) << "[Exit] Switch state to folly dynamic "
                << duration_cast<duration<float>>(
@@ -332,6 +618,12 @@ void SwSwitch::gracefulExit() {
                       .count();
     // Cleanup if we ever initialized
     hw_->gracefulExit(switchState);
+    auto timeline = WarmBootTimeline::get();
+    timeline->mark(WarmBootTimeline::Event::STATE_FILE_WRITTEN);
+    if (!timeline->saveExit(platform_->getWarmBootTimelineFile())) {
+      XLOG(ERR) << "Unable to write warm boot timeline to "
+                << platform_->getWarmBootTimelineFile();
+    }
     XLOG(INFO)
         << "[Exit] SwSwitch Graceful Exit time "
         << duration_cast<duration<float>>(steady_clock::now() - begin).count();
@@ -348,29 +640,252 @@ void SwSwitch::updateStats(){
     stats()->updateStatsException();
     XLOG(ERR) << "Error running updateStats: " << folly::exceptionStr(ex);
   }
+  portStatsSnapshot_->update(*getState()->getPorts());
+  loadImbalanceMonitor_->update(
+      getState(),
+      *portStatsSnapshot_->get(),
+      std::chrono::steady_clock::now());
+  publishNodeAllocationStats();
+  publishMemoryStats();
+  publishStateObserverStats();
+  publishNeighborTableStats();
+  if (rxPool_) {
+    rxPool_->publishStats();
+  }
+  if (tunMgr_) {
+    tunMgr_->publishStats();
+  }
+  pcapMgr_->publishStats();
+  publishPcapDistributionStats();
+  if (packetPolicer_) {
+    packetPolicer_->publishStats();
+    tunePolicers();
+  }
+  puntStats_->update();
+  if (nUpdater_) {
+    nUpdater_->publishStats();
+  }
+  if (threadLayout_) {
+    threadLayout_->update(steady_clock::now());
+    threadLayout_->publishStats();
+  }
+}
+
+void SwSwitch::tunePolicers() {
+  const auto& policers = getState()->getControlPlane()->getSoftwarePolicers();
+  PolicerTuner::Telemetry telemetry;
+  for (const auto& policer : policers) {
+    telemetry.policerDrops[policer.name] =
+        packetPolicer_->getDropped(policer.name);
+  }
+  if (rxPool_) {
+    for (size_t cos = 0; cos < PacketRxPool::kNumCosQueues; ++cos) {
+      auto stats = rxPool_->getCosStats(cos);
+      telemetry.queueDrops += stats.dropped;
+      telemetry.queueWaitMaxUs =
+          std::max(telemetry.queueWaitMaxUs, stats.lastWaitMaxUs);
+    }
+  }
+  auto adjustments =
+      policerTuner_->update(policers, telemetry, steady_clock::now());
+  if (adjustments.empty()) {
+    return;
+  }
+  for (const auto& adjustment : adjustments) {
+    XLOG(INFO) << "Tuning CPU software policer " << adjustment.name
+               << " from " << adjustment.oldPacketsPerSec << " to "
+               << adjustment.newPacketsPerSec
+               << " packets/sec: " << adjustment.reason;
+  }
+  updateState(
+      "tune CPU software policers",
+      [adjustments = std::move(adjustments)](
+          const shared_ptr<SwitchState>& state) {
+        const auto& controlPlane = state->getControlPlane();
+        auto policers = PolicerTuner::applyAdjustments(
+            controlPlane->getSoftwarePolicers(), adjustments);
+        if (policers == controlPlane->getSoftwarePolicers()) {
+          return shared_ptr<SwitchState>();
+        }
+        auto newState = state;
+        controlPlane->modify(&newState)->resetSoftwarePolicers(
+            std::move(policers));
+        return newState;
+      });
+}
+
+void SwSwitch::publishNodeAllocationStats() {
+  NodeAllocationStats::forEach(
+      [](const std::string& name, const NodeAllocationCounters& counters) {
+        auto allocated = counters.allocated.load(std::memory_order_relaxed);
+        auto freed = counters.freed.load(std::memory_order_relaxed);
+        fbData->setCounter(
+            folly::to<std::string>("state.node_alloc.", name, ".allocated"),
+            allocated);
+        fbData->setCounter(
+            folly::to<std::string>("state.node_alloc.", name, ".live"),
+            allocated - freed);
+      });
+  fbData->setCounter("state.node_pool.cached_bytes", NodePool::cachedBytes());
+  fbData->setCounter(
+      "state.reclaim.pending",
+      pendingStateReclaims_.load(std::memory_order_relaxed));
+}
+
+StateMemoryUsage SwSwitch::getStateMemoryUsage() const {
+  std::vector<std::shared_ptr<SwitchState>> older;
+  {
+    lock_guard<mutex> g(stateGenerationsLock_);
+    for (const auto& generation : stateGenerations_) {
+      if (auto state = generation.lock()) {
+        older.push_back(std::move(state));
+      }
+    }
+  }
+  return accountStateMemory(getAppliedState(), older);
+}
+
+void SwSwitch::publishMemoryStats() {
+  if (FLAGS_memory_accounting_interval_s <= 0) {
+    return;
+  }
+  auto now = steady_clock::now();
+  if (now - lastMemoryStats_ <
+      std::chrono::seconds(FLAGS_memory_accounting_interval_s)) {
+    return;
+  }
+  lastMemoryStats_ = now;
+
+  auto usage = getStateMemoryUsage();
+  for (const auto& entry : usage.byNodeType) {
+    fbData->setCounter(
+        folly::to<std::string>("state.memory.", entry.first, ".bytes"),
+        entry.second.bytes);
+    fbData->setCounter(
+        folly::to<std::string>("state.memory.", entry.first, ".shared_bytes"),
+        entry.second.sharedBytes);
+  }
+  for (const auto& entry : usage.byVrf) {
+    fbData->setCounter(
+        folly::to<std::string>("state.memory.vrf.", entry.first, ".bytes"),
+        entry.second.bytes);
+  }
+  fbData->setCounter("state.memory.total.bytes", usage.total.bytes);
+  fbData->setCounter(
+      "state.memory.total.shared_bytes", usage.total.sharedBytes);
+  fbData->setCounter("state.memory.retained_bytes", usage.retainedBytes);
+
+  for (const auto& entry : MemoryAccount::totals()) {
+    fbData->setCounter(
+        folly::to<std::string>("memory.", entry.first, ".bytes"),
+        entry.second);
+  }
+}
+
+void SwSwitch::publishStateObserverStats() {
+  fbData->setCounter(
+      "state_observer.async.pending",
+      pendingObserverUpdates_.load(std::memory_order_relaxed));
+  lock_guard<mutex> g(asyncStateObserversLock_);
+  for (const auto& entry : asyncStateObservers_) {
+    const auto& asyncObserver = entry.second;
+    auto queued =
+        asyncObserver->queuedGeneration.load(std::memory_order_relaxed);
+    auto notified =
+        asyncObserver->notifiedGeneration.load(std::memory_order_relaxed);
+    fbData->setCounter(
+        folly::to<std::string>(
+            "state_observer.", asyncObserver->name, ".lag.generations"),
+        queued > notified ? queued - notified : 0);
+    fbData->setCounter(
+        folly::to<std::string>(
+            "state_observer.", asyncObserver->name, ".lag.us"),
+        asyncObserver->lastLagUs.load(std::memory_order_relaxed));
+  }
+}
+
+void SwSwitch::publishNeighborTableStats() {
+  size_t arpEntries = 0;
+  size_t ndpEntries = 0;
+  for (const auto& vlan : *getState()->getVlans()) {
+    arpEntries += vlan->getArpTable()->size();
+    ndpEntries += vlan->getNdpTable()->size();
+  }
+  auto publish = [](const char* name, size_t entries, size_t bytesPerEntry) {
+    fbData->setCounter(
+        folly::to<std::string>("state.", name, ".entries"), entries);
+    fbData->setCounter(
+        folly::to<std::string>("state.", name, ".bytes"),
+        entries * bytesPerEntry);
+    fbData->setCounter(
+        folly::to<std::string>("state.", name, ".bytes_per_entry"),
+        bytesPerEntry);
+  };
+  publish("arp_table", arpEntries, ArpTable::bytesPerEntry());
+  publish("ndp_table", ndpEntries, NdpTable::bytesPerEntry());
 }
 
 void SwSwitch::registerNeighborListener(
-    std::function<void(const std::vector<std::string>& added,
-                       const std::vector<std::string>& deleted)> callback) {
+    std::function<void(const std::vector<folly::IPAddress>& added,
+                       const std::vector<folly::IPAddress>& deleted)>
+        callback) {
   XLOG(DBG2) << "Registering neighbor listener";
   lock_guard<mutex> g(neighborListenerMutex_);
   neighborListener_ = std::move(callback);
 }
 
 void SwSwitch::invokeNeighborListener(
-    const std::vector<std::string>& added,
-    const std::vector<std::string>& removed) {
+    const std::vector<folly::IPAddress>& added,
+    const std::vector<folly::IPAddress>& removed) {
+  if (neighborChanges_) {
+    neighborChanges_->neighborsChanged(added, removed);
+  }
   lock_guard<mutex> g(neighborListenerMutex_);
   if (neighborListener_) {
     neighborListener_(added, removed);
   }
 }
 
+void SwSwitch::registerNeighborChangeListener(
+    std::function<void(std::shared_ptr<const NeighborChangesThrift>)>
+        callback) {
+  XLOG(DBG2) << "Registering neighbor change listener";
+  lock_guard<mutex> g(neighborListenerMutex_);
+  neighborChangeListener_ = std::move(callback);
+}
+
+int64_t SwSwitch::getNeighborChangeSequence() const {
+  return neighborChanges_ ? neighborChanges_->getSequence() : 0;
+}
+
+void SwSwitch::registerRouteChangeListener(
+    std::function<void(std::shared_ptr<const RouteChangeBatch>)> callback) {
+  XLOG(DBG2) << "Registering route change listener";
+  lock_guard<mutex> g(neighborListenerMutex_);
+  routeChangeListener_ = std::move(callback);
+}
+
+std::shared_ptr<const RouteChangeBatch> SwSwitch::getRouteChangeSnapshot()
+    const {
+  if (!routeChanges_) {
+    throw FbossError("route change stream is stopped");
+  }
+  return routeChanges_->getSnapshot();
+}
+
+int64_t SwSwitch::getRouteChangeGeneration() const {
+  return routeChanges_ ? routeChanges_->getGeneration() : 0;
+}
+
 bool SwSwitch::getAndClearNeighborHit(RouterID vrf, folly::IPAddress ip) {
   return hw_->getAndClearNeighborHit(vrf, ip);
 }
 
+folly::Optional<std::vector<std::pair<RouterID, folly::IPAddress>>>
+SwSwitch::getAndClearNeighborHits() {
+  return hw_->getAndClearNeighborHits();
+}
+
 void SwSwitch::exitFatal() const noexcept {
   folly::dynamic switchState = folly::dynamic::object;
   switchState[kSwSwitch] =  getAppliedState()->toFollyDynamic();
@@ -378,6 +893,9 @@ void SwSwitch::exitFatal() const noexcept {
   if (!dumpStateToFile(platform_->getCrashSwitchStateFile(), switchState)) {
     XLOG(ERR) << "Unable to write switch state JSON to file";
   }
+  if (!EventTrace::dumpToFile(platform_->getCrashEventTraceFile())) {
+    XLOG(ERR) << "Unable to write event trace to file";
+  }
 }
 
 void SwSwitch::clearWarmBootCache() {
@@ -385,6 +903,15 @@ void SwSwitch::clearWarmBootCache() {
 }
 
 void SwSwitch::publishRxPacket(RxPacket* pkt, uint16_t ethertype){
+  auto ring = std::atomic_load(&pcapRing_);
+  if (ring) {
+    // Straight from the RX buffer into shared memory.  If the ring is full
+    // the packet is dropped, the same as when the batcher is backed up.
+    ring->write(true, pkt->buf(), ethertype, pkt->getSrcPort(),
+                pkt->getSrcVlan(), pkt->getReasons(), nowUsec());
+    return;
+  }
+
   RxPacketData pubPkt;
   pubPkt.srcPort = pkt->getSrcPort();
   pubPkt.srcVlan = pkt->getSrcVlan();
@@ -396,41 +923,126 @@ void SwSwitch::publishRxPacket(RxPacket* pkt, uint16_t ethertype){
     pubPkt.reasons.push_back(reason);
   }
 
-  folly::IOBuf buf_copy;
-  pkt->buf()->cloneInto(buf_copy);
-  pubPkt.packetData = buf_copy.moveToFbString();
-  auto onError = [&](std::runtime_error& /* unused */) {
-    stats()->pcapDistFailure();
-    FB_LOG_EVERY_MS(ERROR, 1000)
-        << "Unable to push packet to distribution service\n";
-  };
-  pcapPusher_->future_receiveRxPacket(pubPkt, ethertype)
-      .onError(std::move(onError));
+  // The thrift packet data has to own its bytes, so this is the one place
+  // the RX buffer is copied.  Copy it straight out rather than cloning it
+  // first, as moveToFbString() would have to copy the shared clone anyway.
+  pubPkt.packetData.assign(
+      reinterpret_cast<const char*>(pkt->buf()->data()),
+      pkt->buf()->length());
+  stats()->pktBufCopied();
+
+  CapturedPacket captured;
+  captured.rx = true;
+  captured.pkt.set_rxpkt(std::move(pubPkt));
+  publishPacket(std::move(captured), ethertype);
 }
 
 void SwSwitch::publishTxPacket(TxPacket* pkt, uint16_t ethertype){
+  auto ring = std::atomic_load(&pcapRing_);
+  if (ring) {
+    ring->write(false, pkt->buf(), ethertype, 0, 0, {}, nowUsec());
+    return;
+  }
+
   TxPacketData pubPkt;
   folly::IOBuf copy_buf;
   pkt->buf()->cloneInto(copy_buf);
   pubPkt.packetData = copy_buf.moveToFbString();
-  auto onError = [&](std::runtime_error& /* unused */) {
-    stats()->pcapDistFailure();
-    FB_LOG_EVERY_MS(ERROR, 1000)
-        << "Unable to push packet to distribution service\n";
-  };
-  pcapPusher_->future_receiveTxPacket(pubPkt, ethertype)
-      .onError(std::move(onError));
+
+  CapturedPacket captured;
+  captured.rx = false;
+  captured.pkt.set_txpkt(std::move(pubPkt));
+  publishPacket(std::move(captured), ethertype);
+}
+
+void SwSwitch::publishPacket(CapturedPacket pkt, uint16_t ethertype) {
+  pkt.timestampUsec = nowUsec();
+  pkt.ethertype = ethertype;
+  auto pcapBatcher = std::atomic_load(&pcapBatcher_);
+  // Gone once we're stopping
+  if (pcapBatcher) {
+    pcapBatcher->addPacket(std::move(pkt));
+  }
+}
+
+void SwSwitch::publishPcapDistributionStats() {
+  auto pcapBatcher = std::atomic_load(&pcapBatcher_);
+  if (!pcapBatcher) {
+    return;
+  }
+  fbData->setCounter("pcap_distribution.sent", pcapBatcher->getSent());
+  fbData->setCounter("pcap_distribution.dropped", pcapBatcher->getDropped());
+  fbData->setCounter("pcap_distribution.failed", pcapBatcher->getFailed());
+  auto ring = std::atomic_load(&pcapRing_);
+  if (ring) {
+    fbData->setCounter("pcap_distribution.shm_written", ring->getWritten());
+    fbData->setCounter("pcap_distribution.shm_dropped", ring->getDropped());
+  } else {
+    fbData->clearCounter("pcap_distribution.shm_written");
+    fbData->clearCounter("pcap_distribution.shm_dropped");
+  }
 }
 
 void SwSwitch::init(std::unique_ptr<TunManager> tunMgr, SwitchFlags flags) {
   auto begin = steady_clock::now();
   flags_ = flags;
-  auto hwInitRet = hw_->init(this);
+  EventTrace::setEnabled(FLAGS_event_tracing);
+  threadLayout_ = std::make_unique<ThreadLayout>(
+      FLAGS_thread_layout, FLAGS_thread_layout_default_cpus);
+  // The policer and the pool must exist before the HwSwitch can start
+  // delivering packets
+  packetPolicer_ = std::make_unique<PacketPolicer>();
+  policerTuner_ = std::make_unique<PolicerTuner>();
+  if (!FLAGS_state_update_record_file.empty()) {
+    stateUpdateRecorder_ = std::make_unique<StateUpdateRecorder>(
+        FLAGS_state_update_record_file,
+        FLAGS_state_update_record_file_bytes,
+        FLAGS_state_update_record_files);
+  }
+  registerStateObserver(packetPolicer_.get(), "PacketPolicer");
+  registerStateObserver(icmpErrorLimiter_.get(), "IcmpErrorLimiter");
+  if (FLAGS_rx_worker_threads > 0) {
+    rxPool_ = std::make_unique<PacketRxPool>(
+        [this](std::unique_ptr<RxPacket> pkt) {
+          processPacket(std::move(pkt));
+        },
+        FLAGS_rx_worker_threads,
+        FLAGS_rx_worker_queue_size,
+        FLAGS_rx_worker_steal_threshold,
+        [this](folly::FunctionRef<void()> burst) {
+          // Send the replies to a burst of packets, such as an ARP scan,
+          // all at once
+          TxPacketBatch batch(this);
+          burst();
+        },
+        std::max(FLAGS_rx_strict_priority_cos, 0));
+  }
+  if (FLAGS_enable_sw_mac_learning) {
+    macLearner_ = std::make_unique<MacLearner>([this](MacLearner::Batch batch) {
+      updateState(
+          "MAC learning",
+          [batch = std::move(batch)](const shared_ptr<SwitchState>& state) {
+            return MacLearner::applyBatch(state, batch);
+          },
+          StateUpdateClass::NEIGHBOR);
+    });
+  }
+  auto hwInitRet = [&] {
+    StartupProfiler::Scope phase("hw_init");
+    return hw_->init(this);
+  }();
   auto initialState = hwInitRet.switchState;
   // for now, warmboot is not keeping failed routes, so keep the same state as
   // applied and desired.
   auto initialStateDesired = hwInitRet.switchState;
   bootType_ = hwInitRet.bootType;
+  if (bootType_ == BootType::WARM_BOOT) {
+    WarmBootTimeline::get()->loadPreviousExit(
+        platform_->getWarmBootTimelineFile());
+  } else {
+    // Exit times left behind by an agent we did not warm boot from
+    unlink(platform_->getWarmBootTimelineFile().c_str());
+  }
 
   XLOG(DBG0) << "hardware initialized in " << hwInitRet.bootTime
              << " seconds; applying initial config";
@@ -482,7 +1094,12 @@ void SwSwitch::init(std::unique_ptr<TunManager> tunMgr, SwitchFlags flags) {
     }
   }
 
-  startThreads();
+  {
+    StartupProfiler::Scope phase("start_threads");
+    startThreads();
+  }
+  // Lay out the threads the HwSwitch started, without waiting for the stats
+  threadLayout_->update(steady_clock::now());
   XLOG(INFO)
       << "Time to init switch and start all threads "
       << duration_cast<duration<float>>(steady_clock::now() - begin).count();
@@ -501,6 +1118,9 @@ void SwSwitch::init(std::unique_ptr<TunManager> tunMgr, SwitchFlags flags) {
     lldpManager_ = std::make_unique<LldpManager>(this);
   }
 
+  linkReuseTimeout_ = folly::AsyncTimeout::make(
+      backgroundEventBase_, [this]() noexcept { reuseDampenedLinks(); });
+
   if (flags & SwitchFlags::ENABLE_NHOPS_PROBER) {
     unresolvedNhopsProber_ = std::make_unique<UnresolvedNhopsProber>(this);
     // Feed initial state.
@@ -510,27 +1130,36 @@ void SwSwitch::init(std::unique_ptr<TunManager> tunMgr, SwitchFlags flags) {
 
   if (flags & SwitchFlags::ENABLE_LACP) {
     lagManager_ = std::make_unique<LinkAggregationManager>(this);
+    if (MicroBfdManager::isEnabled()) {
+      microBfd_ = std::make_unique<MicroBfdManager>(this, lagManager_.get());
+      // Feed initial state.
+      microBfd_->stateUpdated(
+          StateDelta(std::make_shared<SwitchState>(), getState()));
+    }
   }
 
-  auto bgHeartbeatStatsFunc = [this] (int delay, int backLog) {
-    stats()->bgHeartbeatDelay(delay);
-    stats()->bgEventBacklog(backLog);
+  auto bgHeartbeatStatsFunc = [this](const EventLoopStats& loop) {
+    stats()->bgHeartbeatDelay(loop.delayMsecs);
+    stats()->bgEventBacklog(loop.queueSize);
+    stats()->eventLoopStats("fbossBgThread", loop);
   };
   bgThreadHeartbeat_ = std::make_unique<ThreadHeartbeat>(
     &backgroundEventBase_, "fbossBgThread", FLAGS_thread_heartbeat_ms,
     bgHeartbeatStatsFunc);
 
-  auto updHeartbeatStatsFunc = [this] (int delay, int backLog) {
-    stats()->updHeartbeatDelay(delay);
-    stats()->updEventBacklog(backLog);
+  auto updHeartbeatStatsFunc = [this](const EventLoopStats& loop) {
+    stats()->updHeartbeatDelay(loop.delayMsecs);
+    stats()->updEventBacklog(loop.queueSize);
+    stats()->eventLoopStats("fbossUpdateThread", loop);
   };
   updThreadHeartbeat_ = std::make_unique<ThreadHeartbeat>(
     &updateEventBase_, "fbossUpdateThread", FLAGS_thread_heartbeat_ms,
     updHeartbeatStatsFunc);
 
-  auto packetTxHeartbeatStatsFunc = [this](int delay, int backLog) {
-    stats()->packetTxHeartbeatDelay(delay);
-    stats()->packetTxEventBacklog(backLog);
+  auto packetTxHeartbeatStatsFunc = [this](const EventLoopStats& loop) {
+    stats()->packetTxHeartbeatDelay(loop.delayMsecs);
+    stats()->packetTxEventBacklog(loop.queueSize);
+    stats()->eventLoopStats("fbossPktTxThread", loop);
   };
   packetTxThreadHeartbeat_ = std::make_unique<ThreadHeartbeat>(
       &packetTxEventBase_,
@@ -538,16 +1167,56 @@ void SwSwitch::init(std::unique_ptr<TunManager> tunMgr, SwitchFlags flags) {
       FLAGS_thread_heartbeat_ms,
       packetTxHeartbeatStatsFunc);
 
-  auto updateLacpThreadHeartbeatStats = [this](int delay, int backLog) {
-        stats()->lacpHeartbeatDelay(delay);
-        stats()->lacpEventBacklog(backLog);
+  auto lacpThreadName = *folly::getThreadName(lacpThread_->get_id());
+  auto updateLacpThreadHeartbeatStats =
+      [this, lacpThreadName](const EventLoopStats& loop) {
+        stats()->lacpHeartbeatDelay(loop.delayMsecs);
+        stats()->lacpEventBacklog(loop.queueSize);
+        stats()->eventLoopStats(lacpThreadName, loop);
   };
   lacpThreadHeartbeat_ = std::make_unique<ThreadHeartbeat>(
       &lacpEventBase_,
-      *folly::getThreadName(lacpThread_->get_id()),
+      lacpThreadName,
       FLAGS_thread_heartbeat_ms,
       updateLacpThreadHeartbeatStats);
 
+  // The remaining threads only report the per thread event loop stats
+  auto addEventLoopHeartbeat = [this](
+      folly::EventBase* evb, const std::string& threadName) {
+    eventLoopHeartbeats_.push_back(std::make_unique<ThreadHeartbeat>(
+        evb,
+        threadName,
+        FLAGS_thread_heartbeat_ms,
+        [this, threadName](const EventLoopStats& loop) {
+          stats()->eventLoopStats(threadName, loop);
+        }));
+  };
+  addEventLoopHeartbeat(
+      &pcapDistributionEventBase_, "fbossPcapDistributionThread");
+  addEventLoopHeartbeat(&qsfpCacheEventBase_, "fbossQsfpCacheThread");
+  addEventLoopHeartbeat(&observerEventBase_, "fbossObserverThread");
+  addEventLoopHeartbeat(&reclaimEventBase_, "fbossReclaimThread");
+
+  if (FLAGS_thread_stall_threshold_ms > 0) {
+    heartbeatWatchdog_ = std::make_unique<ThreadHeartbeatWatchdog>(
+        FLAGS_thread_stall_threshold_ms, [](const ThreadStall& stall) {
+          fbData->setCounter(
+              folly::to<std::string>(
+                  SwitchStats::kCounterPrefix, "event_loop.",
+                  stall.threadName, ".stalls"),
+              stall.count);
+        });
+    for (auto* heartbeat : {bgThreadHeartbeat_.get(),
+                            updThreadHeartbeat_.get(),
+                            packetTxThreadHeartbeat_.get(),
+                            lacpThreadHeartbeat_.get()}) {
+      heartbeatWatchdog_->watch(heartbeat);
+    }
+    for (const auto& heartbeat : eventLoopHeartbeats_) {
+      heartbeatWatchdog_->watch(heartbeat.get());
+    }
+  }
+
   portRemediator_->init();
 
   setSwitchRunState(SwitchRunState::INITIALIZED);
@@ -557,7 +1226,13 @@ void SwSwitch::init(std::unique_ptr<TunManager> tunMgr, SwitchFlags flags) {
 
 void SwSwitch::initialConfigApplied(const steady_clock::time_point& startTime) {
   // notify the hw
-  hw_->initialConfigApplied();
+  {
+    StartupProfiler::Scope phase("hw_initial_config_applied");
+    hw_->initialConfigApplied();
+  }
+  configuredTime_ = steady_clock::now();
+  WarmBootTimeline::get()->mark(
+      WarmBootTimeline::Event::INITIAL_CONFIG_APPLIED);
   setSwitchRunState(SwitchRunState::CONFIGURED);
 
   if (tunMgr_) {
@@ -577,6 +1252,7 @@ void SwSwitch::initialConfigApplied(const steady_clock::time_point& startTime) {
     tunMgr_->startObservingUpdates();
 
     // Perform initial sync of interfaces
+    StartupProfiler::Scope phase("tun_initial_sync");
     tunMgr_->forceInitialSync();
 
   }
@@ -607,14 +1283,33 @@ void SwSwitch::fibSynced() {
     clearWarmBootCache();
     routeUpdateLogger_->stopLoggingForIdentifier("fboss-agent-warmboot");
   }
+  auto firstSync = !isFibSynced();
   setSwitchRunState(SwitchRunState::FIB_SYNCED);
+  if (firstSync) {
+    // This is the end of startup, so save the startup timeline.  We may be
+    // on the update thread, so write it out from the background thread.
+    StartupProfiler::get()->record(
+        "wait_for_fib_sync", configuredTime_, steady_clock::now());
+    auto timeline = WarmBootTimeline::get();
+    timeline->mark(WarmBootTimeline::Event::FIB_SYNCED);
+    if (getBootType() == BootType::WARM_BOOT) {
+      timeline->publish();
+    }
+    backgroundEventBase_.runInEventBaseThread([this] {
+      auto file = platform_->getStartupTraceFile();
+      if (!dumpStateToFile(file, StartupProfiler::get()->toChromeTrace())) {
+        XLOG(ERR) << "Unable to write startup trace to " << file;
+      }
+    });
+  }
 }
 
 void SwSwitch::registerStateObserver(StateObserver* observer,
-                                     const string name) {
+                                     const string name,
+                                     StateObserverDispatch dispatch) {
   XLOG(DBG2) << "Registering state observer: " << name;
   updateEventBase_.runImmediatelyOrRunInEventBaseThreadAndWait([=]() {
-      addStateObserver(observer, name);
+      addStateObserver(observer, name, dispatch);
   });
 }
 
@@ -622,36 +1317,64 @@ void SwSwitch::unregisterStateObserver(StateObserver* observer) {
   updateEventBase_.runImmediatelyOrRunInEventBaseThreadAndWait([=]() {
     removeStateObserver(observer);
   });
+  // Deltas already queued for an ASYNC observer skip it once it has been
+  // removed, but one may be delivering to it right now.  Wait for that to
+  // finish, unless we are being called from the observer itself.
+  observerEventBase_.runImmediatelyOrRunInEventBaseThreadAndWait([] {});
 }
 
 bool SwSwitch::stateObserverRegistered(StateObserver* observer) {
   DCHECK(updateEventBase_.isInEventBaseThread());
-  return stateObservers_.find(observer) != stateObservers_.end();
+  return stateObservers_.find(observer) != stateObservers_.end() ||
+      asyncStateObservers_.find(observer) != asyncStateObservers_.end();
 }
 
 void SwSwitch::removeStateObserver(StateObserver* observer) {
   DCHECK(updateEventBase_.isInEventBaseThread());
   auto nErased = stateObservers_.erase(observer);
+  auto asyncIter = asyncStateObservers_.find(observer);
+  if (asyncIter != asyncStateObservers_.end()) {
+    asyncIter->second->registered.store(false, std::memory_order_release);
+    lock_guard<mutex> g(asyncStateObserversLock_);
+    asyncStateObservers_.erase(asyncIter);
+    ++nErased;
+  }
   if (!nErased) {
     throw FbossError("State observer remove failed: observer does not exist");
   }
 }
 
-void SwSwitch::addStateObserver(StateObserver* observer, const string& name) {
+void SwSwitch::addStateObserver(
+    StateObserver* observer,
+    const string& name,
+    StateObserverDispatch dispatch) {
   DCHECK(updateEventBase_.isInEventBaseThread());
   if (stateObserverRegistered(observer)) {
     throw FbossError("State observer add failed: ", name, " already exists");
   }
-  stateObservers_.emplace(observer, name);
+  if (dispatch == StateObserverDispatch::SYNC) {
+    stateObservers_.emplace(observer, name);
+    return;
+  }
+  auto asyncObserver = std::make_shared<AsyncStateObserver>(observer, name);
+  lock_guard<mutex> g(asyncStateObserversLock_);
+  asyncStateObservers_.emplace(observer, std::move(asyncObserver));
 }
 
-void SwSwitch::notifyStateObservers(const StateDelta& delta) {
+SwSwitch::StateObserverTimes SwSwitch::notifyStateObservers(
+    const StateDelta& delta) {
   CHECK(updateEventBase_.inRunningEventBaseThread());
+  StateObserverTimes observerTimes;
   if (isExiting()) {
     // Make sure the SwSwitch is not already being destroyed
-    return;
+    return observerTimes;
   }
+  // Queue the delta for the ASYNC observers first, so that they can work on
+  // it while the SYNC observers run.
+  notifyAsyncStateObservers(delta);
+  observerTimes.reserve(stateObservers_.size());
   for (auto observerName : stateObservers_) {
+    auto start = std::chrono::steady_clock::now();
     try {
       auto observer = observerName.first;
       observer->stateUpdated(delta);
@@ -660,15 +1383,134 @@ void SwSwitch::notifyStateObservers(const StateDelta& delta) {
     XLOG(FATAL) << "error notifying " << observerName.second
                 << " of update: " << folly::exceptionStr(ex);
     }
+    auto duration = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - start);
+    stats()->stateObserverUpdated(observerName.second, duration);
+    observerTimes.emplace_back(duration, observerName.second);
+  }
+  return observerTimes;
+}
+
+void SwSwitch::logSlowStateUpdate(
+    const StateDelta& delta,
+    std::chrono::microseconds duration,
+    std::chrono::microseconds hwDuration,
+    StateObserverTimes observerTimes) const {
+  // Only name the few observers that took the longest
+  constexpr size_t kMaxObserversLogged = 3;
+  auto numLogged = std::min(kMaxObserversLogged, observerTimes.size());
+  std::partial_sort(
+      observerTimes.begin(),
+      observerTimes.begin() + numLogged,
+      observerTimes.end(),
+      [](const StateObserverTimes::value_type& a,
+         const StateObserverTimes::value_type& b) {
+        return a.first > b.first;
+      });
+  std::string slowest;
+  for (size_t idx = 0; idx < numLogged; ++idx) {
+    folly::toAppend(
+        idx == 0 ? "" : ", ",
+        observerTimes[idx].second,
+        "=",
+        observerTimes[idx].first.count(),
+        "us",
+        &slowest);
+  }
+  XLOG(WARNING) << "Slow state update to generation "
+                << delta.newState()->getGeneration() << " took "
+                << duration.count() << "us: hw=" << hwDuration.count()
+                << "us, slowest observers: "
+                << (slowest.empty() ? "none" : slowest);
+}
+
+void SwSwitch::notifyAsyncStateObservers(const StateDelta& delta) {
+  if (asyncStateObservers_.empty()) {
+    return;
   }
+  // Apply back-pressure if the observer thread has fallen too far behind,
+  // rather than letting the states it still has to deliver pile up.
+  if (observerThread_ &&
+      pendingObserverUpdates_.load(std::memory_order_relaxed) >=
+          FLAGS_max_pending_observer_updates) {
+    auto start = std::chrono::steady_clock::now();
+    observerEventBase_.runInEventBaseThreadAndWait([] {});
+    stats()->stateObserverBlocked(
+        std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - start));
+  }
+
+  auto generation = delta.newState()->getGeneration();
+  std::vector<std::shared_ptr<AsyncStateObserver>> observers;
+  observers.reserve(asyncStateObservers_.size());
+  for (const auto& entry : asyncStateObservers_) {
+    entry.second->queuedGeneration.store(
+        generation, std::memory_order_relaxed);
+    observers.push_back(entry.second);
+  }
+
+  pendingObserverUpdates_.fetch_add(1, std::memory_order_relaxed);
+  auto notify = [this,
+                 oldState = delta.oldState(),
+                 newState = delta.newState(),
+                 observers = std::move(observers),
+                 queued = std::chrono::steady_clock::now()]() {
+    StateDelta asyncDelta(oldState, newState);
+    for (const auto& asyncObserver : observers) {
+      if (isExiting()) {
+        break;
+      }
+      if (!asyncObserver->registered.load(std::memory_order_acquire)) {
+        continue;
+      }
+      auto start = std::chrono::steady_clock::now();
+      try {
+        asyncObserver->observer->stateUpdated(asyncDelta);
+      } catch (const std::exception& ex) {
+        XLOG(FATAL) << "error notifying " << asyncObserver->name
+                    << " of update: " << folly::exceptionStr(ex);
+      }
+      auto duration = std::chrono::duration_cast<std::chrono::microseconds>(
+          std::chrono::steady_clock::now() - start);
+      stats()->stateObserverUpdated(asyncObserver->name, duration);
+      if (FLAGS_slow_state_update_ms > 0 &&
+          duration >= std::chrono::milliseconds(FLAGS_slow_state_update_ms)) {
+        XLOG(WARNING) << "Slow asynchronous state observer "
+                      << asyncObserver->name << " took " << duration.count()
+                      << "us for generation " << newState->getGeneration();
+      }
+      auto lag = std::chrono::duration_cast<std::chrono::microseconds>(
+          std::chrono::steady_clock::now() - queued);
+      asyncObserver->notifiedGeneration.store(
+          newState->getGeneration(), std::memory_order_relaxed);
+      asyncObserver->lastLagUs.store(lag.count(), std::memory_order_relaxed);
+      stats()->stateObserverLag(lag);
+    }
+    pendingObserverUpdates_.fetch_sub(1, std::memory_order_relaxed);
+  };
+  // Deltas are delivered in the order they are queued, which is the order
+  // of their generations.
+  observerEventBase_.runInEventBaseThread(std::move(notify));
 }
 
 void SwSwitch::updateState(
     unique_ptr<StateUpdate> update) {
+  auto updateClass = update->getUpdateClass();
+  auto classIdx = static_cast<size_t>(updateClass);
+  if (stateUpdateRecorder_) {
+    stateUpdateRecorder_->recordStateUpdate(update->getName(), updateClass);
+  }
+  update->queuedTime_ = steady_clock::now();
+  size_t numPending;
   {
     folly::SpinLockGuard guard(pendingUpdatesLock_);
-    pendingUpdates_.push_back(*update.release());
+    if (!update->allowsCoalescing()) {
+      ++numPendingNoCoalesce_;
+    }
+    pendingUpdates_[classIdx].push_back(*update.release());
+    numPending = ++numPendingUpdates_[classIdx];
   }
+  stats()->stateUpdateQueued(updateClass, numPending);
 
   // Signal the update thread that updates are pending.
   // We call runInEventBaseThread() with a static function pointer since this
@@ -681,12 +1523,13 @@ void SwSwitch::queueStateUpdateForGettingHwInSync(
     StateUpdateFn fn) {
   auto update = make_unique<FunctionStateUpdate>(name, std::move(fn));
   {
-    // Push the state update in front to preserver ordering.
+    // Keep the state update apart from the other pending updates, so it is
+    // applied first with whichever updates are handled next.
     // This is not particularly necessary, since this state
     // update is freely coalesced with other state updates when
     // we come to processing pending updates
     folly::SpinLockGuard guard(pendingUpdatesLock_);
-    pendingUpdates_.push_front(*update.release());
+    hwSyncUpdates_.push_front(*update.release());
   }
   // Don't inform updateEventBase about this update being queued.
   // Rather let this update be processed with the next incoming update.
@@ -703,27 +1546,97 @@ void SwSwitch::queueStateUpdateForGettingHwInSync(
 
 void SwSwitch::updateState(
     StringPiece name,
-    StateUpdateFn fn) {
-  auto update = make_unique<FunctionStateUpdate>(name, std::move(fn));
+    StateUpdateFn fn,
+    StateUpdateClass updateClass) {
+  auto update = make_unique<FunctionStateUpdate>(
+      name, std::move(fn), true, updateClass);
   updateState(std::move(update));
 }
 
-void SwSwitch::updateStateNoCoalescing(StringPiece name, StateUpdateFn fn) {
-  auto update = make_unique<FunctionStateUpdate>(name, std::move(fn), false);
+void SwSwitch::updateStateNoCoalescing(
+    StringPiece name,
+    StateUpdateFn fn,
+    StateUpdateClass updateClass) {
+  auto update = make_unique<FunctionStateUpdate>(
+      name, std::move(fn), false, updateClass);
   updateState(std::move(update));
 }
 
-void SwSwitch::updateStateBlocking(folly::StringPiece name, StateUpdateFn fn) {
+void SwSwitch::updateStateBlocking(
+    folly::StringPiece name,
+    StateUpdateFn fn,
+    StateUpdateClass updateClass) {
   auto result = std::make_shared<BlockingUpdateResult>();
-  auto update = make_unique<BlockingStateUpdate>(name, std::move(fn), result);
+  auto update = make_unique<BlockingStateUpdate>(
+      name, std::move(fn), result, true, updateClass);
   updateState(std::move(update));
   result->wait();
 }
 
+folly::Future<folly::Unit> SwSwitch::updateStateAsync(
+    folly::StringPiece name,
+    StateUpdateFn fn,
+    StateUpdateClass updateClass) {
+  folly::Promise<folly::Unit> promise;
+  auto future = promise.getFuture();
+  auto update = make_unique<FutureStateUpdate>(
+      name, std::move(fn), std::move(promise), true, updateClass);
+  updateState(std::move(update));
+  return future;
+}
+
 void SwSwitch::handlePendingUpdatesHelper(SwSwitch* sw) {
   sw->handlePendingUpdates();
 }
 
+std::chrono::milliseconds SwSwitch::coalesceDelayLocked() const {
+  if (FLAGS_state_update_coalesce_window_ms <= 0 ||
+      numPendingNoCoalesce_ > 0) {
+    return milliseconds(0);
+  }
+  size_t numPending = 0;
+  auto oldest = steady_clock::time_point::max();
+  for (size_t idx = 0; idx < kNumStateUpdateClasses; ++idx) {
+    if (numPendingUpdates_[idx] == 0) {
+      continue;
+    }
+    if (isUrgentStateUpdateClass(static_cast<StateUpdateClass>(idx))) {
+      // Never hold back link and neighbor updates
+      return milliseconds(0);
+    }
+    numPending += numPendingUpdates_[idx];
+    oldest = std::min(oldest, pendingUpdates_[idx].front().queuedTime_);
+  }
+  if (numPending == 0 ||
+      (FLAGS_state_update_coalesce_max_updates > 0 &&
+       numPending >=
+           static_cast<size_t>(FLAGS_state_update_coalesce_max_updates))) {
+    return milliseconds(0);
+  }
+  auto deadline = oldest + milliseconds(FLAGS_state_update_coalesce_window_ms);
+  auto now = steady_clock::now();
+  if (deadline <= now) {
+    return milliseconds(0);
+  }
+  // Round up, so the timer doesn't fire before the window has passed
+  return duration_cast<milliseconds>(deadline - now) + milliseconds(1);
+}
+
+void SwSwitch::scheduleCoalescedUpdates(std::chrono::milliseconds delay) {
+  // Each queued update triggers a call to handlePendingUpdates(), so only
+  // one timer is needed to flush the updates held for the window.
+  if (coalesceTimerScheduled_) {
+    return;
+  }
+  coalesceTimerScheduled_ = true;
+  updateEventBase_.runAfterDelay(
+      [this]() {
+        coalesceTimerScheduled_ = false;
+        handlePendingUpdates();
+      },
+      delay.count());
+}
+
 void SwSwitch::handlePendingUpdates() {
   // Get the list of updates to run.
   //
@@ -731,24 +1644,91 @@ void SwSwitch::handlePendingUpdates() {
   // were scheduled before we had a chance to process them.  In some cases we
   // might also end up finding 0 updates to process if a previous
   // handlePendingUpdates() call processed multiple updates.
+  //
+  // While link or neighbor updates are pending only those are pulled, so
+  // they don't wait behind bulk route or config work.  To keep the other
+  // classes from starving, a class that has been left behind
+  // FLAGS_max_deferred_state_update_batches times in a row is pulled with
+  // the urgent updates, as long as the classes before it aren't deferred.
+  //
+  // So updates are not applied in the order they were queued: urgent ones
+  // overtake the others.  But an update is only applied once every update
+  // queued before it of the same class, or of an earlier class, has been.
+  //
+  // Coalescable updates may also be held for a while to let more updates
+  // join them, see FLAGS_state_update_coalesce_window_ms.
+  std::chrono::milliseconds holdFor;
+  {
+    folly::SpinLockGuard guard(pendingUpdatesLock_);
+    holdFor = coalesceDelayLocked();
+  }
+  if (holdFor.count() > 0) {
+    scheduleCoalescedUpdates(holdFor);
+    return;
+  }
+
   StateUpdateList updates;
   {
     folly::SpinLockGuard guard(pendingUpdatesLock_);
+    updates.splice(updates.end(), hwSyncUpdates_);
 
-    // When deciding how many elements to pull off the pendingUpdates_
-    // list, we pull as many as we can, while making sure we don't
-    // include any updates after an update that does not allow
-    // coalescing.
-    auto iter = pendingUpdates_.begin();
-    while (iter != pendingUpdates_.end()) {
-      StateUpdate* update = &(*iter);
-      ++iter;
-      if (!update->allowsCoalescing()) {
+    bool urgentPending = false;
+    for (size_t idx = 0; idx < kNumStateUpdateClasses; ++idx) {
+      if (numPendingUpdates_[idx] > 0 &&
+          isUrgentStateUpdateClass(static_cast<StateUpdateClass>(idx))) {
+        urgentPending = true;
+      }
+    }
+    // Once a class is deferred, so are the classes after it, so that an
+    // update is never applied ahead of one of an earlier class that was
+    // queued before it
+    bool deferRest = false;
+    for (size_t idx = 0; idx < kNumStateUpdateClasses; ++idx) {
+      if (numPendingUpdates_[idx] == 0) {
+        continue;
+      }
+      auto updateClass = static_cast<StateUpdateClass>(idx);
+      if (!isUrgentStateUpdateClass(updateClass) &&
+          (deferRest ||
+           (urgentPending &&
+            deferredBatches_[idx] <
+                static_cast<uint32_t>(
+                    FLAGS_max_deferred_state_update_batches)))) {
+        ++deferredBatches_[idx];
+        deferRest = true;
+        continue;
+      }
+      deferredBatches_[idx] = 0;
+
+      // When deciding how many elements to pull off a pending list, we
+      // pull as many as we can, while making sure we don't include any
+      // updates after an update that does not allow coalescing.
+      auto& pending = pendingUpdates_[idx];
+      bool stop = false;
+      auto iter = pending.begin();
+      while (iter != pending.end()) {
+        StateUpdate* update = &(*iter);
+        ++iter;
+        --numPendingUpdates_[idx];
+        if (!update->allowsCoalescing()) {
+          --numPendingNoCoalesce_;
+          stop = true;
+          break;
+        }
+      }
+      updates.splice(updates.end(), pending, pending.begin(), iter);
+      if (stop) {
         break;
       }
     }
-    updates.splice(updates.begin(), pendingUpdates_,
-                   pendingUpdates_.begin(), iter);
+  }
+  auto now = steady_clock::now();
+  for (const auto& update : updates) {
+    if (update.getName() != kOutOfSyncStateUpdate) {
+      stats()->stateUpdateWait(
+          update.getUpdateClass(),
+          duration_cast<microseconds>(now - update.queuedTime_));
+    }
   }
 
   // handlePendingUpdates() is invoked once for each update, but a previous
@@ -757,6 +1737,7 @@ void SwSwitch::handlePendingUpdates() {
   if (updates.empty()) {
     return;
   }
+  stats()->stateUpdateBatch(updates.size());
 
   if (updates.size() == 1 &&
       updates.begin()->getName() == kOutOfSyncStateUpdate) {
@@ -785,6 +1766,7 @@ void SwSwitch::handlePendingUpdates() {
 
     shared_ptr<SwitchState> intermediateState;
     XLOG(INFO) << "preparing state update " << update->getName();
+    ThreadHeartbeat::Activity activity(update->getName());
     try {
       intermediateState = update->applyUpdate(newDesiredState);
     } catch (const std::exception& ex) {
@@ -810,6 +1792,11 @@ void SwSwitch::handlePendingUpdates() {
   // Now apply the update and notify subscribers
   if (newDesiredState != oldAppliedState) {
     // There was some change during these state updates
+    std::string applying = "applying";
+    for (const auto& update : updates) {
+      folly::toAppend(" ", update.getName(), &applying);
+    }
+    ThreadHeartbeat::Activity activity(applying);
     auto newAppliedState = applyUpdate(oldAppliedState, newDesiredState);
     // Stick the initial applied->desired in the beginning
     bool newOutOfSync = (newAppliedState != newDesiredState);
@@ -845,6 +1832,11 @@ void SwSwitch::handlePendingUpdates() {
     updates.pop_front();
     update->onSuccess();
   }
+
+  // We may be holding the last references to the old states; hand them off
+  // rather than destroying them here and delaying the next update.
+  retireState(std::move(oldAppliedState));
+  retireState(std::move(oldDesiredState));
 }
 
 int SwSwitch::getHighresSamplers(HighresSamplerList* samplers,
@@ -899,16 +1891,63 @@ void SwSwitch::setStateInternal(
   CHECK(bool(newDesiredState));
   CHECK(newAppliedState->isPublished());
   CHECK(newDesiredState->isPublished());
-  folly::SpinLockGuard guard(stateLock_);
-  appliedStateDontUseDirectly_.swap(newAppliedState);
-  desiredStateDontUseDirectly_.swap(newDesiredState);
+  if (routeChanges_) {
+    routeChanges_->stateChanged(newAppliedState);
+  }
+  {
+    folly::SpinLockGuard guard(stateLock_);
+    appliedStateDontUseDirectly_.swap(newAppliedState);
+    desiredStateDontUseDirectly_.swap(newDesiredState);
+  }
+  // newAppliedState and newDesiredState now hold the previous states
+  if (FLAGS_state_memory_generations > 0 && newAppliedState) {
+    lock_guard<mutex> g(stateGenerationsLock_);
+    stateGenerations_.push_front(newAppliedState);
+    while (stateGenerations_.size() >
+           static_cast<size_t>(FLAGS_state_memory_generations)) {
+      stateGenerations_.pop_back();
+    }
+  }
+  retireState(std::move(newAppliedState));
+  retireState(std::move(newDesiredState));
+}
+
+void SwSwitch::retireState(std::shared_ptr<SwitchState> state) {
+  if (!state) {
+    return;
+  }
+  // Before the reclaim thread has started, or once we are shutting down,
+  // just drop the reference here.  Likewise if the reclaim thread has fallen
+  // too far behind: bounding the backlog bounds the amount of memory held by
+  // states that are no longer in use.
+  if (!reclaimThread_ || isExiting()) {
+    return;
+  }
+  if (pendingStateReclaims_.load(std::memory_order_relaxed) >=
+      FLAGS_max_pending_state_reclaims) {
+    stats()->stateReclaimedInline();
+    return;
+  }
+  pendingStateReclaims_.fetch_add(1, std::memory_order_relaxed);
+  auto reclaim = [this, state = std::move(state)]() mutable {
+    auto start = std::chrono::steady_clock::now();
+    state.reset();
+    auto duration = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - start);
+    stats()->stateReclaimed(duration);
+    pendingStateReclaims_.fetch_sub(1, std::memory_order_relaxed);
+  };
+  reclaimEventBase_.runInEventBaseThread(std::move(reclaim));
 }
 
 void SwSwitch::setDesiredState(std::shared_ptr<SwitchState> newDesiredState) {
   CHECK(bool(newDesiredState));
   CHECK(newDesiredState->isPublished());
-  folly::SpinLockGuard guard(stateLock_);
-  desiredStateDontUseDirectly_.swap(newDesiredState);
+  {
+    folly::SpinLockGuard guard(stateLock_);
+    desiredStateDontUseDirectly_.swap(newDesiredState);
+  }
+  retireState(std::move(newDesiredState));
 }
 
 std::shared_ptr<SwitchState> SwSwitch::applyUpdate(
@@ -918,7 +1957,10 @@ std::shared_ptr<SwitchState> SwSwitch::applyUpdate(
   DCHECK_EQ(oldState, getAppliedState());
 
   auto start = std::chrono::steady_clock::now();
-  XLOG(INFO) << "Updating state: old_gen=" << oldState->getGeneration()
+  // Traced rather than logged, since there may be many updates a second
+  EventTrace::record(
+      EventTrace::Event::STATE_UPDATE_START, newState->getGeneration());
+  XLOG(DBG2) << "Updating state: old_gen=" << oldState->getGeneration()
              << " new_gen=" << newState->getGeneration();
   DCHECK_GT(newState->getGeneration(), oldState->getGeneration());
 
@@ -931,6 +1973,10 @@ std::shared_ptr<SwitchState> SwSwitch::applyUpdate(
 
   std::shared_ptr<SwitchState> newAppliedState;
 
+  if (nodeIdIndex_) {
+    nodeIdIndex_->stateChanged(delta);
+  }
+
   // Inform the HwSwitch of the change.
   //
   // Note that at this point we have already updated the state pointer and
@@ -943,8 +1989,16 @@ std::shared_ptr<SwitchState> SwSwitch::applyUpdate(
   // take a non-trivial amount of time, and blocking other users seems
   // undesirable.  So far I don't think this brief discrepancy should cause
   // major issues.
+  std::chrono::microseconds hwDuration{0};
   try {
+    auto hwStart = std::chrono::steady_clock::now();
+    EventTrace::record(EventTrace::Event::HW_UPDATE_START);
     newAppliedState = hw_->stateChanged(delta);
+    hwDuration = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - hwStart);
+    EventTrace::record(
+        EventTrace::Event::HW_UPDATE_END, 0, hwDuration.count());
+    stats()->hwStateChanged(hwDuration);
   } catch (const std::exception& ex) {
     // Notify the hw_ of the crash so it can execute any device specific
     // tasks before we fatal. An example would be to dump the current hw state.
@@ -961,13 +2015,21 @@ std::shared_ptr<SwitchState> SwSwitch::applyUpdate(
   // the state changed to "desired state", even if the whole state might not
   // have been applied yet. If an observer wants to know the applied state,
   // they can query the SwSwitch about it.
-  notifyStateObservers(delta);
+  auto observerTimes = notifyStateObservers(delta);
 
   auto end = std::chrono::steady_clock::now();
   auto duration =
     std::chrono::duration_cast<std::chrono::microseconds>(end - start);
   stats()->stateUpdate(duration);
-  XLOG(DBG0) << "Update state took " << duration.count() << "us";
+  if (FLAGS_slow_state_update_ms > 0 &&
+      duration >= std::chrono::milliseconds(FLAGS_slow_state_update_ms)) {
+    logSlowStateUpdate(delta, duration, hwDuration, std::move(observerTimes));
+  }
+  EventTrace::record(
+      EventTrace::Event::STATE_UPDATE_END,
+      newState->getGeneration(),
+      duration.count());
+  XLOG(DBG2) << "Update state took " << duration.count() << "us";
   return newAppliedState;
 }
 
@@ -1023,6 +2085,24 @@ void SwSwitch::setPortStatusCounter(PortID port, bool up) {
 }
 
 void SwSwitch::packetReceived(std::unique_ptr<RxPacket> pkt) noexcept {
+  if (stateUpdateRecorder_) {
+    stateUpdateRecorder_->recordPacket(pkt.get());
+  }
+  if (packetPolicer_ && !packetPolicer_->admit(pkt.get())) {
+    stats()->pktPoliced();
+    return;
+  }
+  if (!rxPool_) {
+    processPacket(std::move(pkt));
+    return;
+  }
+  PortID port = pkt->getSrcPort();
+  if (!rxPool_->enqueue(std::move(pkt))) {
+    portStats(port)->pktDropped();
+  }
+}
+
+void SwSwitch::processPacket(std::unique_ptr<RxPacket> pkt) noexcept {
   PortID port = pkt->getSrcPort();
   try {
     handlePacket(std::move(pkt));
@@ -1046,8 +2126,12 @@ void SwSwitch::handlePacket(std::unique_ptr<RxPacket> pkt) {
   if (!isFullyInitialized()) {
     return;
   }
+  // Handle the whole packet against one snapshot of the state
+  StateSnapshotPin pin(this);
   PortID port = pkt->getSrcPort();
   portStats(port)->trappedPkt();
+  EventTrace::record(
+      EventTrace::Event::PACKET_RX, port, pkt->getLength());
 
   pcapMgr_->packetReceived(pkt.get());
 
@@ -1059,16 +2143,13 @@ void SwSwitch::handlePacket(std::unique_ptr<RxPacket> pkt) {
     return;
   }
 
-  // Parse the source and destination MAC, as well as the ethertype.
-  Cursor c(pkt->buf());
-  auto dstMac = PktUtil::readMac(&c);
-  auto srcMac = PktUtil::readMac(&c);
-  auto ethertype = c.readBE<uint16_t>();
-  if (ethertype == 0x8100) {
-    // 802.1Q
-    c += 2; // Advance over the VLAN tag.  We ignore it for now
-    ethertype = c.readBE<uint16_t>();
-  }
+  // Find the headers of the packet, and check the ones we read in software,
+  // all in one go.
+  auto parsed = ParsedPacket::parse(pkt->buf());
+  const auto& dstMac = parsed.dstMac;
+  const auto& srcMac = parsed.srcMac;
+  auto ethertype = parsed.etherType;
+  puntStats_->record(pkt.get(), PuntStats::getProtocol(parsed));
 
   if (distributionServiceReady_.load()) {
     publishRxPacket(pkt.get(), ethertype);
@@ -1083,6 +2164,37 @@ void SwSwitch::handlePacket(std::unique_ptr<RxPacket> pkt) {
              << " src=" << srcMac << " dst=" << dstMac << " ethertype=0x"
              << std::hex << ethertype << " :: " << pkt->describeDetails();
 
+  if (!parsed.isValid()) {
+    // Count the packet as the handler would have when it failed to read the
+    // headers, without having it throw.
+    XLOG(DBG3) << "dropping malformed packet: error="
+               << static_cast<int>(parsed.error);
+    if (ethertype == IPv4Handler::ETHERTYPE_IPV4) {
+      portStats(port)->ipv4Rx();
+    }
+    if (parsed.error == ParsedPacket::Error::TRUNCATED_L4 &&
+        parsed.ipProtocol == IP_PROTO_UDP) {
+      portStats(port)->udpTooSmall();
+    }
+    portStats(port)->pktError();
+    return;
+  }
+
+  // The handlers all finish with the packet before they return
+  auto protocol = getPacketProtocol(pkt.get(), parsed);
+  auto dispatched = steady_clock::now();
+  if (pkt->getRxTime() != steady_clock::time_point()) {
+    stats()->pktDispatched(
+        protocol, duration_cast<microseconds>(dispatched - pkt->getRxTime()));
+  }
+  SCOPE_EXIT {
+    stats()->pktHandled(
+        protocol,
+        duration_cast<microseconds>(steady_clock::now() - dispatched));
+  };
+
+  Cursor c(pkt->buf());
+  c += parsed.l3Offset;
   switch (ethertype) {
   case ArpHandler::ETHERTYPE_ARP:
     arp_->handlePacket(std::move(pkt), dstMac, srcMac, c);
@@ -1094,10 +2206,14 @@ void SwSwitch::handlePacket(std::unique_ptr<RxPacket> pkt) {
     }
     break;
   case IPv4Handler::ETHERTYPE_IPV4:
-    ipv4_->handlePacket(std::move(pkt), dstMac, srcMac, c);
+    if (microBfd_ && dstMac == BfdControlPacket::kMicroBfdDstMac()) {
+      microBfd_->handlePacket(std::move(pkt), parsed);
+      return;
+    }
+    ipv4_->handlePacket(std::move(pkt), parsed);
     return;
   case IPv6Handler::ETHERTYPE_IPV6:
-    ipv6_->handlePacket(std::move(pkt), dstMac, srcMac, c);
+    ipv6_->handlePacket(std::move(pkt), parsed);
     return;
   case LACPDU::EtherType::SLOW_PROTOCOLS:
   {
@@ -1125,12 +2241,72 @@ void SwSwitch::handlePacket(std::unique_ptr<RxPacket> pkt) {
   portStats(port)->pktUnhandled();
 }
 
+void SwSwitch::l2LearningUpdateReceived(
+    const L2LearningUpdate& update) noexcept {
+  if (!macLearner_) {
+    return;
+  }
+  switch (macLearner_->enqueue(update)) {
+    case MacLearner::EnqueueResult::QUEUED:
+      if (update.type == L2LearningUpdate::Type::LEARN) {
+        stats()->macLearned();
+      } else {
+        stats()->macAged();
+      }
+      break;
+    case MacLearner::EnqueueResult::QUEUE_FULL:
+      stats()->macLearningQueueDrop();
+      break;
+    case MacLearner::EnqueueResult::RATE_LIMITED:
+      stats()->macLearningRateLimited();
+      break;
+  }
+}
+
 void SwSwitch::linkStateChanged(PortID portId, bool up) {
   XLOG(INFO) << "Link state changed: " << portId << "->"
              << (up ? "UP" : "DOWN");
+  if (stateUpdateRecorder_) {
+    stateUpdateRecorder_->recordLinkState(portId, up);
+  }
   if (not isFullyInitialized()) {
     return;
   }
+  auto changedAt = steady_clock::now();
+
+  std::vector<PortID> released;
+  bool propagate;
+  {
+    auto dampener = linkFlapDampener_.wlock();
+    released = dampener->setConfig(getState()->getLinkFlapDampening());
+    propagate = dampener->linkChanged(portId, up, changedAt);
+  }
+  linksReleased(released);
+  if (propagate) {
+    propagateLinkState(portId, up, changedAt);
+  } else if (up) {
+    XLOG(INFO) << "Keeping flapping port " << portId << " down";
+    stats()->linkUpSuppressed();
+  }
+
+  // Log event and update counters
+  logLinkStateEvent(portId, up);
+  setPortStatusCounter(portId, up);
+  portStats(portId)->linkStateChange();
+  publishLinkFlapDampening(portId);
+
+  portRemediator_->portLinkChanged(portId, up);
+  scheduleLinkReuse();
+}
+
+void SwSwitch::propagateLinkState(
+    PortID portId, bool up, steady_clock::time_point changedAt) {
+  // The HwSwitch has already stopped forwarding over the port.  Rather than
+  // wait for the state update below to reach the NeighborUpdater, make the
+  // neighbors on it pending straight away; the state update then reconciles.
+  if (!up && FLAGS_link_down_fast_path) {
+    nUpdater_->linkDown(portId, changedAt);
+  }
 
   // Schedule an update for port's operational status
   auto updateOperStateFn = [=](const std::shared_ptr<SwitchState>& state) {
@@ -1145,13 +2321,86 @@ void SwSwitch::linkStateChanged(PortID portId, bool up) {
 
     return newState;
   };
-  updateStateNoCoalescing(
-      "Port OperState Update", std::move(updateOperStateFn));
+  folly::Promise<folly::Unit> applied;
+  auto appliedFuture = applied.getFuture();
+  updateState(make_unique<FutureStateUpdate>(
+      "Port OperState Update",
+      std::move(updateOperStateFn),
+      std::move(applied),
+      false,
+      StateUpdateClass::LINK));
+  appliedFuture.then(
+      [this, up, changedAt](folly::Try<folly::Unit>&& result) {
+        if (result.hasException()) {
+          XLOG(FATAL) << "unexpected error applying state update "
+                      << "<Port OperState Update>: "
+                      << result.exception().what();
+        }
+        if (!up) {
+          stats()->linkDownReroute(
+              duration_cast<microseconds>(steady_clock::now() - changedAt));
+        }
+      });
+}
 
-  // Log event and update counters
-  logLinkStateEvent(portId, up);
-  setPortStatusCounter(portId, up);
-  portStats(portId)->linkStateChange();
+void SwSwitch::linksReleased(const std::vector<PortID>& ports) {
+  auto now = steady_clock::now();
+  for (auto port : ports) {
+    XLOG(INFO) << "Flapping port " << port << " is no longer kept down";
+    propagateLinkState(port, true, now);
+    publishLinkFlapDampening(port);
+  }
+}
+
+void SwSwitch::scheduleLinkReuse() {
+  backgroundEventBase_.runInEventBaseThread([this] {
+    if (!linkReuseTimeout_) {
+      return;
+    }
+    auto next = linkFlapDampener_.rlock()->getNextReuse();
+    if (!next) {
+      linkReuseTimeout_->cancelTimeout();
+      return;
+    }
+    // Rounded up, so that the ports are due when it fires
+    auto delay = std::max(
+        duration_cast<milliseconds>(*next - steady_clock::now()) +
+            milliseconds(1),
+        milliseconds(0));
+    linkReuseTimeout_->scheduleTimeout(delay);
+  });
+}
+
+void SwSwitch::reuseDampenedLinks() noexcept {
+  std::vector<PortID> released;
+  {
+    auto dampener = linkFlapDampener_.wlock();
+    // Also applies a change of config with no ports flapping since
+    released = dampener->setConfig(getState()->getLinkFlapDampening());
+    auto reused = dampener->reuse(steady_clock::now());
+    released.insert(released.end(), reused.begin(), reused.end());
+  }
+  linksReleased(released);
+  scheduleLinkReuse();
+}
+
+void SwSwitch::publishLinkFlapDampening(PortID port) {
+  int64_t penalty;
+  bool suppressed;
+  {
+    auto dampener = linkFlapDampener_.rlock();
+    penalty =
+        static_cast<int64_t>(dampener->getPenalty(port, steady_clock::now()));
+    suppressed = dampener->isSuppressed(port);
+  }
+  portStats(port)->setLinkFlapDampening(penalty, suppressed);
+}
+
+void SwSwitch::transceiversChanged(const std::vector<TransceiverID>& tcvrs) {
+  if (not isFullyInitialized()) {
+    return;
+  }
+  portRemediator_->transceiversChanged(tcvrs);
 }
 
 void SwSwitch::startThreads() {
@@ -1169,6 +2418,14 @@ void SwSwitch::startThreads() {
       [=] { this->threadLoop("fbossQsfpCacheThread", &qsfpCacheEventBase_); }));
   lacpThread_.reset(new std::thread(
       [=] { this->threadLoop("fbossLacpThread", &lacpEventBase_); }));
+  observerThread_.reset(new std::thread(
+      [=] { this->threadLoop("fbossObserverThread", &observerEventBase_); }));
+  reclaimThread_.reset(new std::thread([=] {
+    // Tearing down old states is never urgent, so keep out of the way of
+    // the threads that are.
+    incNiceValue(10);
+    this->threadLoop("fbossReclaimThread", &reclaimEventBase_);
+  }));
 }
 
 void SwSwitch::stopThreads() {
@@ -1202,6 +2459,14 @@ void SwSwitch::stopThreads() {
     lacpEventBase_.runInEventBaseThread(
         [this] { lacpEventBase_.terminateLoopSoon(); });
   }
+  if (observerThread_) {
+    observerEventBase_.runInEventBaseThread(
+        [this] { observerEventBase_.terminateLoopSoon(); });
+  }
+  if (reclaimThread_) {
+    reclaimEventBase_.runInEventBaseThread(
+        [this] { reclaimEventBase_.terminateLoopSoon(); });
+  }
   if (backgroundThread_) {
     backgroundThread_->join();
   }
@@ -1220,10 +2485,17 @@ void SwSwitch::stopThreads() {
   if (lacpThread_) {
     lacpThread_->join();
   }
+  if (observerThread_) {
+    observerThread_->join();
+  }
+  if (reclaimThread_) {
+    reclaimThread_->join();
+  }
 }
 
 void SwSwitch::threadLoop(StringPiece name, EventBase* eventBase) {
   initThread(name);
+  threadLayout_->applyToCurrentThread(name);
   eventBase->loopForever();
 }
 
@@ -1263,6 +2535,10 @@ void SwSwitch::sendPacketOutOfPort(std::unique_ptr<TxPacket> pkt,
     publishTxPacket(pkt.get(), ethertype);
   }
 
+  if (auto* batch = *txPacketBatch_) {
+    batch->pkts_.push_back({std::move(pkt), portID});
+    return;
+  }
   if (!hw_->sendPacketOutOfPort(std::move(pkt), portID)) {
     // Just log an error for now.  There's not much the caller can do about
     // send failures--even on successful return from sendPacket*() the
@@ -1315,6 +2591,10 @@ void SwSwitch::sendPacketOutOfPort(
 
 void SwSwitch::sendPacketSwitched(std::unique_ptr<TxPacket> pkt) noexcept {
   pcapMgr_->packetSent(pkt.get());
+  if (auto* batch = *txPacketBatch_) {
+    batch->pkts_.push_back({std::move(pkt), folly::none});
+    return;
+  }
   if (!hw_->sendPacketSwitched(std::move(pkt))) {
     // Just log an error for now.  There's not much the caller can do about
     // send failures--even on successful return from sendPacketSwitched() the
@@ -1324,6 +2604,25 @@ void SwSwitch::sendPacketSwitched(std::unique_ptr<TxPacket> pkt) noexcept {
   }
 }
 
+SwSwitch::TxPacketBatch::TxPacketBatch(SwSwitch* sw)
+    : sw_(sw), outer_(*sw->txPacketBatch_) {
+  *sw_->txPacketBatch_ = this;
+}
+
+SwSwitch::TxPacketBatch::~TxPacketBatch() {
+  *sw_->txPacketBatch_ = outer_;
+  if (pkts_.empty()) {
+    return;
+  }
+  auto num = pkts_.size();
+  auto sent = sw_->hw_->sendPacketsBatch(std::move(pkts_));
+  if (sent < num) {
+    // As with single packets, there is not much the sender can do about it
+    XLOG(ERR) << "failed to send " << num - sent << " of " << num
+              << " batched packets";
+  }
+}
+
 void SwSwitch::sendL3Packet(
     std::unique_ptr<TxPacket> pkt,
     folly::Optional<InterfaceID> maybeIfID) noexcept {
@@ -1472,45 +2771,144 @@ bool SwSwitch::sendPacketToHost(
     InterfaceID dstIfID,
     std::unique_ptr<RxPacket> pkt) {
   if (tunMgr_) {
-    return tunMgr_->sendPacketToHost(dstIfID, std::move(pkt));
+    // The packet is written to the tun interface from its RX buffer
+    if (!tunMgr_->sendPacketToHost(dstIfID, std::move(pkt))) {
+      return false;
+    }
+    stats()->pktBufShared();
+    return true;
   } else {
     return false;
   }
 }
 
+SwSwitch::LoadedConfig SwSwitch::loadConfig(
+    const shared_ptr<SwitchState>& state) const {
+  LoadedConfig loaded;
+  std::string configFilename = FLAGS_config;
+  // Until a config has been applied, the state didn't come from curConfig_,
+  // so no section of it can be taken as already applied
+  auto prevConfig = curConfigStr_.empty() ? nullptr : &curConfig_;
+  if (!configFilename.empty()) {
+    XLOG(INFO) << "Loading config from local config file " << configFilename;
+    std::string contents;
+    if (!folly::readFile(configFilename.c_str(), contents)) {
+      throw FbossError("unable to read ", configFilename);
+    }
+    loaded.hash = hashThriftConfig(contents);
+    if (prevConfig && loaded.hash == curConfigHash_) {
+      XLOG(INFO) << "Config file unchanged since it was applied";
+      loaded.unchanged = true;
+      return loaded;
+    }
+    loaded.configStr = parseThriftConfig(
+        configFilename, std::move(contents), &loaded.config);
+    loaded.newState = applyThriftConfig(
+        state, &loaded.config, platform_.get(), prevConfig);
+  } else {
+    // Loading config from default location. The message will be printed
+    // there.
+    auto rval = applyThriftConfigDefault(state, platform_.get(), prevConfig);
+    loaded.newState = std::move(rval.first);
+    loaded.configStr = std::move(rval.second);
+    apache::thrift::SimpleJSONSerializer::deserialize<cfg::SwitchConfig>(
+        loaded.configStr, loaded.config);
+  }
+  return loaded;
+}
+
 void SwSwitch::applyConfig(const std::string& reason) {
+  // Config applies are serialized, so the ACL stages of one finish before
+  // the next config is compared against curConfig_
+  std::lock_guard<std::mutex> g(configLock_);
+  LoadedConfig loaded;
+  std::unique_ptr<ConfigStager> stager;
   // We don't need to hold a lock here. updateStateBlocking() does that for us.
   updateStateBlocking(
       reason,
       [&](const shared_ptr<SwitchState>& state) -> shared_ptr<SwitchState> {
-        std::string configFilename = FLAGS_config;
-        std::pair<shared_ptr<SwitchState>, std::string> rval;
-        if (!configFilename.empty()) {
-          XLOG(INFO) << "Loading config from local config file "
-                     << configFilename;
-          rval = applyThriftConfigFile(state, configFilename, platform_.get(),
-              &curConfig_);
-        } else {
-          // Loading config from default location. The message will be printed
-          // there.
-          rval = applyThriftConfigDefault(state, platform_.get(),
-              &curConfig_);
+        loaded = loadConfig(state);
+        if (loaded.unchanged) {
+          return nullptr;
         }
-        if (!isValidStateUpdate(StateDelta(state, rval.first))) {
+        // The whole change is validated here, before any stage is applied
+        if (loaded.newState &&
+            !isValidStateUpdate(StateDelta(state, loaded.newState))) {
           throw FbossError("Invalid config passed in, skipping");
         }
-        curConfigStr_ = rval.second;
-        apache::thrift::SimpleJSONSerializer::deserialize<cfg::SwitchConfig>(
-            curConfigStr_.c_str(), curConfig_);
-
-        // Set oper status of interfaces in SwitchState
-        auto& newState = rval.first;
-        for (auto const& port : *newState->getPorts()) {
-          port->setOperState(hw_->isPortUp(port->getID()));
+        if (stateUpdateRecorder_) {
+          stateUpdateRecorder_->recordConfig(loaded.configStr);
+        }
+        auto newState = std::move(loaded.newState);
+        if (!newState) {
+          return nullptr;
         }
 
+        // Set oper status of interfaces in SwitchState.  Ports kept down by
+        // the link flap dampener stay down.
+        {
+          auto dampener = linkFlapDampener_.rlock();
+          for (auto const& port : *newState->getPorts()) {
+            port->setOperState(
+                hw_->isPortUp(port->getID()) &&
+                !dampener->isSuppressed(port->getID()));
+          }
+        }
+
+        if (FLAGS_config_acl_stage_size > 0) {
+          stager = std::make_unique<ConfigStager>(
+              state, newState, FLAGS_config_acl_stage_size);
+          return stager->getFirstStage();
+        }
         return newState;
-      });
+      },
+      StateUpdateClass::CONFIG);
+  // Release the links the old link flap dampening config kept down
+  reuseDampenedLinks();
+  if (loaded.unchanged) {
+    return;
+  }
+
+  if (stager) {
+    // Each stage is an update of its own, so that the updates queued behind
+    // the config get to go in between
+    auto numStages = stager->numAclStages();
+    for (size_t stage = 0; stage < numStages; ++stage) {
+      auto name = folly::to<std::string>(
+          reason, ": ACL stage ", stage + 1, " of ", numStages);
+      updateStateBlocking(
+          name,
+          [&](const shared_ptr<SwitchState>& state) {
+            return stager->applyAclStage(stage, state);
+          },
+          StateUpdateClass::CONFIG);
+    }
+  }
+  // Only now is the config fully applied. Had a stage thrown, the next
+  // apply would be compared against the previous config, so the sections
+  // this one left half done, the ACLs among them, are applied again.
+  curConfigStr_ = std::move(loaded.configStr);
+  curConfig_ = std::move(loaded.config);
+  curConfigHash_ = loaded.hash;
+}
+
+ConfigDryRunThrift SwSwitch::dryRunConfig() {
+  std::lock_guard<std::mutex> g(configLock_);
+  auto state = getState();
+  ConfigDryRunThrift result;
+  result.valid = true;
+  auto newState = loadConfig(state).newState;
+  if (!newState) {
+    return result;
+  }
+  StateDelta delta(state, newState);
+  result.valid = isValidStateUpdate(delta);
+  result.changes = countStateChanges(delta);
+  auto aclStages = FLAGS_config_acl_stage_size > 0 ?
+    ConfigStager(state, newState, FLAGS_config_acl_stage_size)
+        .numAclStages() : 0;
+  result.stages = 1 + aclStages;
+  return result;
 }
 
 bool SwSwitch::isValidStateUpdate(
@@ -11,7 +11,10 @@
 
 #include "fboss/agent/HighresCounterUtil.h"
 #include "fboss/agent/HwSwitch.h"
+#include "fboss/agent/LinkFlapDampener.h"
 #include "fboss/agent/if/gen-cpp2/ctrl_types.h"
+#include "fboss/agent/state/NodeIdIndex.h"
+#include "fboss/agent/state/NodeSerializationCache.h"
 #include "fboss/agent/state/StateUpdate.h"
 #include "fboss/agent/types.h"
 #include "fboss/agent/ThreadHeartbeat.h"
@@ -20,40 +23,81 @@
 
 #include <folly/SpinLock.h>
 #include <folly/IntrusiveList.h>
+#include <folly/Optional.h>
 #include <folly/Range.h>
+#include <folly/Synchronized.h>
 #include <folly/ThreadLocal.h>
+#include <folly/futures/Future.h>
+#include <folly/io/async/AsyncTimeout.h>
 #include <folly/io/async/EventBase.h>
 
+#include <array>
 #include <atomic>
+#include <chrono>
+#include <deque>
 #include <memory>
 #include <mutex>
+#include <string>
 #include <thread>
+#include <utility>
+#include <vector>
 
 namespace facebook { namespace fboss {
 
 class ArpHandler;
+class CapturedPacket;
 class ChannelCloser;
 class IPv4Handler;
 class IPv6Handler;
+class IcmpErrorLimiter;
 class LinkAggregationManager;
 class LldpManager;
+class MicroBfdManager;
+class PacketBatcher;
 class PcapPushSubscriberAsyncClient;
 class PktCaptureManager;
+class PuntStats;
 class Platform;
 class Port;
 class PortStats;
 class PortUpdateHandler;
 class RxPacket;
+class ShmPacketRing;
 class SwitchState;
 class SwitchStats;
+class ThreadLayout;
 class StateDelta;
+struct StateMemoryUsage;
+class NeighborChangeStream;
+class RouteChangeStream;
+struct RouteChangeBatch;
+class PortStatsSnapshot;
+class LoadImbalanceMonitor;
 class NeighborUpdater;
+class PacketPolicer;
+class PacketRxPool;
+class PolicerTuner;
+class MacLearner;
 class RouteUpdateLogger;
 class StateObserver;
+class StateUpdateRecorder;
 class TunManager;
 class PortRemediator;
 class UnresolvedNhopsProber;
 
+/*
+ * How a StateObserver is notified of state updates.
+ *
+ * SYNC observers are called on the update thread as part of applying each
+ * update, after the hardware has been programmed and before the next update
+ * is applied.  ASYNC observers are called in generation order on the
+ * observer thread, so a slow observer does not delay hardware programming.
+ */
+enum class StateObserverDispatch {
+  SYNC,
+  ASYNC,
+};
+
 enum SwitchFlags : int {
   DEFAULT = 0,
   ENABLE_TUN = 1,
@@ -187,6 +231,32 @@ class SwSwitch : public HwSwitch::Callback {
   std::shared_ptr<SwitchState> getState() const {
     return getDesiredState();
   }
+
+  /*
+   * Get the index from NodeID to the nodes of the state being applied, or
+   * null if --enable_node_id_index is not set.
+   *
+   * This must only be used from the update thread.  During
+   * HwSwitch::stateChanged() and StateObserver::stateUpdated() of SYNC
+   * observers the index reflects the new state of the delta being applied.
+   */
+  const NodeIdIndex* getNodeIdIndex() const {
+    return nodeIdIndex_.get();
+  }
+
+  /*
+   * Return a scope under which serializing the SwitchState reuses the
+   * serialized form of nodes that were unchanged since the last time the
+   * state was serialized under such a scope.  Returns null if the
+   * serialization cache is disabled.
+   */
+  std::unique_ptr<NodeSerializationCache::Scope> serializationCacheScope() {
+    if (!stateSerializationCache_) {
+      return nullptr;
+    }
+    return std::make_unique<NodeSerializationCache::Scope>(
+        stateSerializationCache_.get());
+  }
   /**
    * Schedule an update to the switch state.
    *
@@ -223,10 +293,14 @@ class SwSwitch : public HwSwitch::Callback {
    * send a single update notification to the HwSwitch and other update
    * subscribers.  Therefore the StateUpdateFn may be called with an
    * unpublished SwitchState in some cases.
+   *
+   * updateClass determines the order in which pending updates are applied,
+   * see StateUpdateClass.
    */
   void updateState(
       folly::StringPiece name,
-      StateUpdateFn fn);
+      StateUpdateFn fn,
+      StateUpdateClass updateClass = StateUpdateClass::DEFAULT);
 
   /**
    * Schedule an update to the switch state.
@@ -240,7 +314,10 @@ class SwSwitch : public HwSwitch::Callback {
    * but can be used when there is an update that MUST be seen by the hw
    * implementation, even if the inverse update is immediately applied.
    */
-  void updateStateNoCoalescing(folly::StringPiece name, StateUpdateFn fn);
+  void updateStateNoCoalescing(
+      folly::StringPiece name,
+      StateUpdateFn fn,
+      StateUpdateClass updateClass = StateUpdateClass::DEFAULT);
 
   /*
    * A version of updateState() that doesn't return until the update has been
@@ -256,7 +333,25 @@ class SwSwitch : public HwSwitch::Callback {
    * thread, and would simply block the calling thread until the operation
    * completes.
    */
-  void updateStateBlocking(folly::StringPiece name, StateUpdateFn fn);
+  void updateStateBlocking(
+      folly::StringPiece name,
+      StateUpdateFn fn,
+      StateUpdateClass updateClass = StateUpdateClass::DEFAULT);
+
+  /*
+   * A version of updateState() that returns a future, which completes once
+   * the update has been applied, in the same sense as updateStateBlocking()
+   * returning, or fails with the error applying it.
+   *
+   * Unlike updateStateBlocking() the calling thread is free to do other work
+   * while the update is pending.  The future is completed from the update
+   * thread, so continuations attached to it run there unless they are given
+   * an executor, and must not block.
+   */
+  folly::Future<folly::Unit> updateStateAsync(
+      folly::StringPiece name,
+      StateUpdateFn fn,
+      StateUpdateClass updateClass = StateUpdateClass::DEFAULT);
 
   /**
    * Apply config from the config file (specified in 'config' flag).
@@ -267,6 +362,12 @@ class SwSwitch : public HwSwitch::Callback {
    */
   void applyConfig(const std::string& reason);
 
+  /*
+   * Build the state the config file would make, and check it against the
+   * hardware, without applying it.
+   */
+  ConfigDryRunThrift dryRunConfig();
+
   /**
    * Get a set of high resolution samplers that we can query quickly.
    *
@@ -292,10 +393,19 @@ class SwSwitch : public HwSwitch::Callback {
    * all state updates that occur and all classes that care about state updates
    * should register using this api.
    *
-   * The only required method for observers is stateUpdated and observers can
-   * count on this always being called from the update thread.
+   * The only required method for observers is stateUpdated.  SYNC observers
+   * can count on this always being called from the update thread.  ASYNC
+   * observers are called from the observer thread instead, and may be several
+   * generations behind the current state.  They must not use
+   * getNodeIdIndex() or block waiting for the update thread, and must
+   * unregister before any state used by stateUpdated() is destroyed.
+   * unregisterStateObserver() waits for any notification of the observer in
+   * progress to finish.
    */
-  void registerStateObserver(StateObserver* observer, const std::string name);
+  void registerStateObserver(
+      StateObserver* observer,
+      const std::string name,
+      StateObserverDispatch dispatch = StateObserverDispatch::SYNC);
   void unregisterStateObserver(StateObserver* observer);
 
   /*
@@ -434,8 +544,16 @@ class SwSwitch : public HwSwitch::Callback {
   // HwSwitch::Callback methods
   void packetReceived(std::unique_ptr<RxPacket> pkt) noexcept override;
   void linkStateChanged(PortID port, bool up) override;
+  void l2LearningUpdateReceived(
+      const L2LearningUpdate& update) noexcept override;
   void exitFatal() const noexcept override;
 
+  /*
+   * The platform tells us of the transceivers that changed, e.g. a module
+   * was plugged in, so that the ports on them are looked at again.
+   */
+  void transceiversChanged(const std::vector<TransceiverID>& tcvrs);
+
   /*
    * Allocate a new TxPacket.
    */
@@ -469,6 +587,29 @@ class SwSwitch : public HwSwitch::Callback {
    */
   void sendPacketSwitched(std::unique_ptr<TxPacket> pkt) noexcept;
 
+  /*
+   * While a TxPacketBatch is in scope, the packets this thread sends out of
+   * a port or switched are held back, and handed to the HwSwitch all at
+   * once when it goes out of scope.  This is for the senders of periodic
+   * bursts of packets, for one SDK call per burst rather than per packet.
+   */
+  class TxPacketBatch {
+   public:
+    explicit TxPacketBatch(SwSwitch* sw);
+    ~TxPacketBatch();
+
+   private:
+    friend class SwSwitch;
+    // Forbidden copy constructor and assignment operator
+    TxPacketBatch(TxPacketBatch const &) = delete;
+    TxPacketBatch& operator=(TxPacketBatch const &) = delete;
+
+    SwSwitch* sw_{nullptr};
+    // The batch this one is nested in, which is sent separately
+    TxPacketBatch* outer_{nullptr};
+    std::vector<BatchTxPacket> pkts_;
+  };
+
   /**
    * Send out L3 packet through HW
    *
@@ -521,6 +662,28 @@ class SwSwitch : public HwSwitch::Callback {
     return ipv6_.get();
   }
 
+  /**
+   * Get the IcmpErrorLimiter object, which the handlers check before sending
+   * ICMP errors.
+   *
+   * The IcmpErrorLimiter returned is owned by the SwSwitch, and is only valid
+   * as long as the SwSwitch object.
+   */
+  IcmpErrorLimiter* getIcmpErrorLimiter() {
+    return icmpErrorLimiter_.get();
+  }
+
+  /**
+   * Get the PuntStats object, which counts the trapped packets by ingress
+   * port, CPU CoS queue and protocol.
+   *
+   * The PuntStats returned is owned by the SwSwitch, and is only valid as
+   * long as the SwSwitch object.
+   */
+  PuntStats* getPuntStats() {
+    return puntStats_.get();
+  }
+
   /**
    * Get the NeighborUpdater object.
    *
@@ -552,6 +715,14 @@ class SwSwitch : public HwSwitch::Callback {
     return routeUpdateLogger_.get();
   }
 
+  /*
+   * Get the StateUpdateRecorder, or null unless
+   * --state_update_record_file is set
+   */
+  StateUpdateRecorder* getStateUpdateRecorder() {
+    return stateUpdateRecorder_.get();
+  }
+
   LinkAggregationManager* getLagManager() {
     return lagManager_.get();
   }
@@ -593,17 +764,69 @@ class SwSwitch : public HwSwitch::Callback {
    * times will overwrite the current listener.
    */
   void registerNeighborListener(
-      std::function<void(const std::vector<std::string>& added,
-                         const std::vector<std::string>& deleted)> callback);
+      std::function<void(const std::vector<folly::IPAddress>& added,
+                         const std::vector<folly::IPAddress>& deleted)>
+          callback);
+
+  void invokeNeighborListener(const std::vector<folly::IPAddress>& added,
+                              const std::vector<folly::IPAddress>& deleted);
+
+  /*
+   * Register a function that will be sent the neighbor changes, coalesced
+   * into numbered batches.  As with the neighbor listener, only one is
+   * supported, and calling this again overwrites it.
+   */
+  void registerNeighborChangeListener(
+      std::function<void(std::shared_ptr<const NeighborChangesThrift>)>
+          callback);
+
+  /*
+   * The sequence number of the last batch of neighbor changes published.
+   */
+  int64_t getNeighborChangeSequence() const;
+
+  /*
+   * Register a function that will be sent the changes to the route tables
+   * of the applied state, coalesced into numbered batches.  Only one is
+   * supported, and calling this again overwrites it.
+   */
+  void registerRouteChangeListener(
+      std::function<void(std::shared_ptr<const RouteChangeBatch>)> callback);
 
-  void invokeNeighborListener(const std::vector<std::string>& added,
-                               const std::vector<std::string>& deleted);
+  /*
+   * Every route of the last batch of route changes published, for a new
+   * route change listener.
+   */
+  std::shared_ptr<const RouteChangeBatch> getRouteChangeSnapshot() const;
+  int64_t getRouteChangeGeneration() const;
+
+  /*
+   * The counters of every port as of the last stats update.
+   */
+  const PortStatsSnapshot* getPortStatsSnapshot() const {
+    return portStatsSnapshot_.get();
+  }
+
+  /*
+   * How evenly ECMP groups and aggregate ports spread traffic over their
+   * members, as of the last measurement.
+   */
+  const LoadImbalanceMonitor* getLoadImbalanceMonitor() const {
+    return loadImbalanceMonitor_.get();
+  }
 
   /*
    * Returns true if the arp/ndp entry for the passed in ip has been hit.
    */
   bool getAndClearNeighborHit(RouterID vrf, folly::IPAddress ip);
 
+  /*
+   * Returns the VRFs and addresses of all of the arp/ndp entries hit since
+   * the last call, or folly::none if the hardware can't scan for them.
+   */
+  folly::Optional<std::vector<std::pair<RouterID, folly::IPAddress>>>
+  getAndClearNeighborHits();
+
   const std::string& getConfigStr() const { return curConfigStr_; }
   const cfg::SwitchConfig& getConfig() const { return curConfig_; }
   AdminDistance clientIdToAdminDistance(int clientId) const;
@@ -612,10 +835,16 @@ class SwSwitch : public HwSwitch::Callback {
    * to h/w
    */
   std::shared_ptr<SwitchState> getAppliedState() const {
-    folly::SpinLockGuard guard(stateLock_);
-    return appliedStateDontUseDirectly_;
+    return getStateSnapshots().applied;
   }
 
+  /*
+   * Account for the memory of the current state, and of the last
+   * --state_memory_generations applied states that are still alive.  This
+   * walks the whole state, so is slow with a large FIB.
+   */
+  StateMemoryUsage getStateMemoryUsage() const;
+
   /*
    * Desired state corresponds to what we desire the switch
    * state to be. This is allowed to differ from desired switch
@@ -635,14 +864,31 @@ class SwSwitch : public HwSwitch::Callback {
    *
    */
   std::shared_ptr<SwitchState> getDesiredState() const {
-    folly::SpinLockGuard guard(stateLock_);
-    return desiredStateDontUseDirectly_;
+    return getStateSnapshots().desired;
+  }
+
+  /*
+   * Return the calling thread's snapshot of the desired state.
+   *
+   * While a packet is being handled the snapshot is pinned, so every call
+   * made while handling it sees the same state, without taking stateLock_.
+   * Outside of packet handling this is the same as getDesiredState().
+   */
+  std::shared_ptr<SwitchState> getStateSnapshot() const {
+    return getStateSnapshots().desired;
   }
 
   void publishRxPacket(RxPacket* packet, uint16_t ethertype);
   void publishTxPacket(TxPacket* packet, uint16_t ethertype);
+  void publishPacket(CapturedPacket pkt, uint16_t ethertype);
+  void publishPcapDistributionStats();
 
  private:
+  /*
+   * Ask the distribution service for a shared memory ring to send packets
+   * on.  Packets go over thrift instead if it doesn't hand one out.
+   */
+  void connectPacketRing();
   void queueStateUpdateForGettingHwInSync(
       folly::StringPiece name,
       StateUpdateFn fn);
@@ -656,11 +902,59 @@ class SwSwitch : public HwSwitch::Callback {
 
   std::pair<std::shared_ptr<SwitchState>, std::shared_ptr<SwitchState>>
   getStates() const {
-    folly::SpinLockGuard guard(stateLock_);
+    auto snapshots = getStateSnapshots();
     return std::make_pair(
-        appliedStateDontUseDirectly_, desiredStateDontUseDirectly_);
+        std::move(snapshots.applied), std::move(snapshots.desired));
+  }
+
+  /*
+   * The applied and desired states, as of the calling thread pinning them.
+   *
+   * A thread only keeps its snapshot while it is pinned, e.g. while
+   * handling a packet, so every read made meanwhile sees the same states
+   * without taking stateLock_.  The snapshot is dropped as soon as the pin
+   * ends, so idle threads don't keep old states alive past their reclaim.
+   */
+  struct StateSnapshots {
+    std::shared_ptr<SwitchState> applied;
+    std::shared_ptr<SwitchState> desired;
+    uint32_t pinDepth{0};
+  };
+
+  StateSnapshots getStateSnapshots() const {
+    const auto& snapshots = *stateSnapshots_;
+    if (snapshots.pinDepth > 0) {
+      return snapshots;
+    }
+    folly::SpinLockGuard guard(stateLock_);
+    return StateSnapshots{
+        appliedStateDontUseDirectly_, desiredStateDontUseDirectly_, 0};
   }
 
+  /*
+   * Pins the calling thread's state snapshot during its lifetime.
+   */
+  class StateSnapshotPin {
+   public:
+    explicit StateSnapshotPin(const SwSwitch* sw)
+        : snapshots_(*sw->stateSnapshots_) {
+      if (snapshots_.pinDepth++ == 0) {
+        folly::SpinLockGuard guard(sw->stateLock_);
+        snapshots_.applied = sw->appliedStateDontUseDirectly_;
+        snapshots_.desired = sw->desiredStateDontUseDirectly_;
+      }
+    }
+    ~StateSnapshotPin() {
+      if (--snapshots_.pinDepth == 0) {
+        snapshots_.applied.reset();
+        snapshots_.desired.reset();
+      }
+    }
+
+   private:
+    StateSnapshots& snapshots_;
+  };
+
   /*
    * Update the current states.
    */
@@ -670,6 +964,36 @@ class SwSwitch : public HwSwitch::Callback {
 
   void setDesiredState(std::shared_ptr<SwitchState> newDesiredState);
 
+  /*
+   * Drop a reference to a SwitchState that is no longer current.
+   *
+   * The reference is released on the reclaim thread, so that if it is the
+   * last one, the cost of destroying the state is not paid by the update
+   * thread.
+   */
+  void retireState(std::shared_ptr<SwitchState> state);
+
+  /*
+   * Export the SwitchState node allocation counters.
+   */
+  void publishNodeAllocationStats();
+  /*
+   * Export the state memory accounting and the MemoryAccounts of the other
+   * subsystems, every --memory_accounting_interval_s.
+   */
+  void publishMemoryStats();
+  void publishStateObserverStats();
+  /*
+   * Export the size of the ARP and NDP tables, and the approximate memory
+   * their entries take up.
+   */
+  void publishNeighborTableStats();
+  /*
+   * Tune the rates of the CPU software policers from how they and the
+   * receive queues kept up, and apply the changes.  Called from the stats
+   * thread.
+   */
+  void tunePolicers();
   void publishInitTimes(std::string name, const float& time);
   void publishPortInfo();
   void publishRouteStats();
@@ -678,9 +1002,22 @@ class SwSwitch : public HwSwitch::Callback {
   void setSwitchRunState(SwitchRunState desiredState);
   SwitchStats* createSwitchStats();
   void handlePacket(std::unique_ptr<RxPacket> pkt);
+  /*
+   * Handle a trapped packet, counting rather than propagating any error.
+   * Called from the thread that received the packet, or from the packet
+   * processing threads if --rx_worker_threads is set.
+   */
+  void processPacket(std::unique_ptr<RxPacket> pkt) noexcept;
 
   static void handlePendingUpdatesHelper(SwSwitch* sw);
   void handlePendingUpdates();
+  /*
+   * How much longer the pending updates should be held to coalesce more
+   * updates with them, per FLAGS_state_update_coalesce_window_ms.  Must be
+   * called with pendingUpdatesLock_ held.
+   */
+  std::chrono::milliseconds coalesceDelayLocked() const;
+  void scheduleCoalescedUpdates(std::chrono::milliseconds delay);
   std::shared_ptr<SwitchState> applyUpdate(
       const std::shared_ptr<SwitchState>& oldState,
       const std::shared_ptr<SwitchState>& newState);
@@ -696,7 +1033,10 @@ class SwSwitch : public HwSwitch::Callback {
    * called from the update thread, if the update thread is running.
    */
   bool stateObserverRegistered(StateObserver* observer);
-  void addStateObserver(StateObserver* observer, const std::string& name);
+  void addStateObserver(
+      StateObserver* observer,
+      const std::string& name,
+      StateObserverDispatch dispatch);
   void removeStateObserver(StateObserver* observer);
 
   /*
@@ -705,12 +1045,46 @@ class SwSwitch : public HwSwitch::Callback {
   std::string getSwitchStateFile() const;
 
   /*
-   * Notifies all the observers that a state update occured.
+   * Notifies all the observers that a state update occured.  SYNC observers
+   * are called before this returns, ASYNC observers are queued on the
+   * observer thread.  Returns the time each SYNC observer took.
+   */
+  using StateObserverTimes =
+      std::vector<std::pair<std::chrono::microseconds, std::string>>;
+  StateObserverTimes notifyStateObservers(const StateDelta& delta);
+  void notifyAsyncStateObservers(const StateDelta& delta);
+
+  /*
+   * Log the time the HwSwitch and the slowest SYNC observers took for a
+   * state update that exceeded --slow_state_update_ms.
    */
-  void notifyStateObservers(const StateDelta& delta);
+  void logSlowStateUpdate(
+      const StateDelta& delta,
+      std::chrono::microseconds duration,
+      std::chrono::microseconds hwDuration,
+      StateObserverTimes observerTimes) const;
 
   void logLinkStateEvent(PortID port, bool up);
 
+  /*
+   * Update the port's operational state for a link state change that made
+   * it through the link flap dampener.
+   */
+  void propagateLinkState(
+      PortID port,
+      bool up,
+      std::chrono::steady_clock::time_point changedAt);
+
+  /*
+   * Bring up the links released from dampening, whether for a change of
+   * config or as their penalty decayed, and (re)schedule the next release.
+   * The release timer only runs in the background thread.
+   */
+  void reuseDampenedLinks() noexcept;
+  void linksReleased(const std::vector<PortID>& ports);
+  void scheduleLinkReuse();
+  void publishLinkFlapDampening(PortID port);
+
   void logSwitchRunStateChange(
       const SwitchRunState& oldState,
       const SwitchRunState& newState);
@@ -720,8 +1094,26 @@ class SwSwitch : public HwSwitch::Callback {
 
   std::string switchRunStateStr(SwitchRunState runState) const;
 
+  struct LoadedConfig {
+    // null if the config makes no change to the state
+    std::shared_ptr<SwitchState> newState;
+    std::string configStr;
+    cfg::SwitchConfig config;
+    folly::Optional<uint64_t> hash;
+    // Set when the file is the one applied last, so it wasn't parsed
+    bool unchanged{false};
+  };
+
+  // Read the config file, and build the state it makes from state
+  LoadedConfig loadConfig(const std::shared_ptr<SwitchState>& state) const;
+
+  // Held while a config is applied, including all of its stages
+  std::mutex configLock_;
   std::string curConfigStr_;
   cfg::SwitchConfig curConfig_;
+  // Hash of the config file curConfig_ was read from, so reloading an
+  // unchanged file skips parsing and applying it
+  folly::Optional<uint64_t> curConfigHash_;
 
   // The HwSwitch object.  This object is owned by the Platform.
   HwSwitch* hw_;
@@ -735,10 +1127,57 @@ class SwSwitch : public HwSwitch::Callback {
   std::unique_ptr<TunManager> tunMgr_;
 
   /*
-   * A list of pending state updates to be applied.
+   * The threads processing trapped packets, or null if packets are
+   * processed on the threads they are received on.
+   */
+  std::unique_ptr<PacketRxPool> rxPool_;
+
+  /*
+   * Turns the MACs the hardware learns and ages out into updates of the
+   * VLANs' MAC tables, or null without software MAC learning.
+   */
+  std::unique_ptr<MacLearner> macLearner_;
+
+  /*
+   * Drops excess trapped packets per the configured CPU software policers,
+   * before they are queued or parsed.
+   */
+  std::unique_ptr<PacketPolicer> packetPolicer_;
+  std::unique_ptr<PolicerTuner> policerTuner_;
+
+  // Records the state updates and their inputs, for state_update_replay
+  std::unique_ptr<StateUpdateRecorder> stateUpdateRecorder_;
+
+  // Limits the ICMP errors sent in reply to trapped packets
+  std::unique_ptr<IcmpErrorLimiter> icmpErrorLimiter_;
+
+  // Counts the trapped packets, to find the top talkers to the CPU
+  std::unique_ptr<PuntStats> puntStats_;
+
+  // Pins the threads to CPUs per --thread_layout, and exports their CPU use
+  std::unique_ptr<ThreadLayout> threadLayout_;
+
+  /*
+   * The pending state updates to be applied, one list per StateUpdateClass,
+   * and the number of updates in each list.  hwSyncUpdates_ holds the
+   * update that brings the hardware back in sync with the desired state,
+   * which is always applied first.
    */
   folly::SpinLock pendingUpdatesLock_;
-  StateUpdateList pendingUpdates_;
+  std::array<StateUpdateList, kNumStateUpdateClasses> pendingUpdates_;
+  std::array<size_t, kNumStateUpdateClasses> numPendingUpdates_{};
+  // Number of pending updates that don't allow coalescing
+  size_t numPendingNoCoalesce_{0};
+  StateUpdateList hwSyncUpdates_;
+  /*
+   * Number of batches in a row that left each class of updates pending
+   * because more urgent updates were applied first.  Only accessed from the
+   * update thread.
+   */
+  std::array<uint32_t, kNumStateUpdateClasses> deferredBatches_{};
+  // Whether a timer is set to apply updates held for the coalescing window.
+  // Only accessed from the update thread.
+  bool coalesceTimerScheduled_{false};
 
   /*
    * The current switch state: modelled as two states:
@@ -765,6 +1204,21 @@ class SwSwitch : public HwSwitch::Callback {
   std::shared_ptr<SwitchState> appliedStateDontUseDirectly_;
   std::shared_ptr<SwitchState> desiredStateDontUseDirectly_;
   mutable folly::SpinLock stateLock_;
+  mutable folly::ThreadLocal<StateSnapshots> stateSnapshots_;
+  // The TxPacketBatch in scope on each thread, if any
+  folly::ThreadLocal<TxPacketBatch*> txPacketBatch_;
+
+  /*
+   * Cache of serialized SwitchState nodes, used for state dumps.  Null
+   * unless --cache_state_serialization is set.
+   */
+  std::unique_ptr<NodeSerializationCache> stateSerializationCache_;
+
+  /*
+   * Index of the nodes in the most recently applied state by NodeID.  Only
+   * accessed from the update thread.
+   */
+  std::unique_ptr<NodeIdIndex> nodeIdIndex_;
 
   /*
    * A thread for performing various background tasks.
@@ -808,13 +1262,53 @@ class SwSwitch : public HwSwitch::Callback {
   folly::EventBase lacpEventBase_;
   std::unique_ptr<ThreadHeartbeat> lacpThreadHeartbeat_;
 
+  /*
+   * A low priority thread that destroys retired SwitchStates.
+   */
+  std::unique_ptr<std::thread> reclaimThread_;
+  folly::EventBase reclaimEventBase_;
+  std::atomic<int32_t> pendingStateReclaims_{0};
+
+  /*
+   * The last applied states, newest first, for getStateMemoryUsage() to
+   * tell the memory they still hold.  They are not kept alive for it.
+   */
+  mutable std::mutex stateGenerationsLock_;
+  std::deque<std::weak_ptr<SwitchState>> stateGenerations_;
+  // Only used from the stats thread
+  std::chrono::steady_clock::time_point lastMemoryStats_;
+
+  /*
+   * A thread that notifies ASYNC state observers, and the number of state
+   * deltas queued for it that have not been delivered yet.
+   */
+  std::unique_ptr<std::thread> observerThread_;
+  folly::EventBase observerEventBase_;
+  std::atomic<int32_t> pendingObserverUpdates_{0};
+
+  /*
+   * Heartbeats for the threads above that have no heartbeat of their own,
+   * which only export the per thread event loop stats.
+   */
+  std::vector<std::unique_ptr<ThreadHeartbeat>> eventLoopHeartbeats_;
+
+  /*
+   * Reports the threads above that stall, with what they were running.
+   * Destroyed before the heartbeats it watches.
+   */
+  std::unique_ptr<ThreadHeartbeatWatchdog> heartbeatWatchdog_;
+
   /*
    * A callback for listening to neighbors coming and going.
    */
   std::mutex neighborListenerMutex_;
-  std::function<void(const std::vector<std::string>& added,
-                       const std::vector<std::string>& deleted)>
+  std::function<void(const std::vector<folly::IPAddress>& added,
+                     const std::vector<folly::IPAddress>& deleted)>
     neighborListener_{nullptr};
+  std::function<void(std::shared_ptr<const NeighborChangesThrift>)>
+    neighborChangeListener_{nullptr};
+  std::function<void(std::shared_ptr<const RouteChangeBatch>)>
+    routeChangeListener_{nullptr};
 
   /*
    * The list of classes to notify on a state update. This container should only
@@ -823,26 +1317,74 @@ class SwSwitch : public HwSwitch::Callback {
    */
   std::map<StateObserver*, std::string> stateObservers_;
 
+  /*
+   * An observer notified on the observer thread.  The generation counters
+   * are written by the update and observer threads and read when publishing
+   * stats.
+   */
+  struct AsyncStateObserver {
+    AsyncStateObserver(StateObserver* observer, const std::string& name)
+        : observer(observer), name(name) {}
+
+    StateObserver* const observer;
+    const std::string name;
+    std::atomic<bool> registered{true};
+    // The generation of the last state queued for and delivered to observer
+    std::atomic<uint32_t> queuedGeneration{0};
+    std::atomic<uint32_t> notifiedGeneration{0};
+    // How long the last delivered delta waited before observer was done
+    std::atomic<int64_t> lastLagUs{0};
+  };
+
+  /*
+   * The ASYNC state observers.  Like stateObservers_ this is only modified
+   * from the update thread, under asyncStateObserversLock_ so that the stats
+   * can be published from another thread.
+   */
+  std::mutex asyncStateObserversLock_;
+  std::map<StateObserver*, std::shared_ptr<AsyncStateObserver>>
+      asyncStateObservers_;
+
   std::unique_ptr<PortRemediator> portRemediator_;
 
   std::unique_ptr<ChannelCloser> closer_; // must be before pcapPusher_
   std::unique_ptr<PcapPushSubscriberAsyncClient> pcapPusher_;
   std::atomic<bool> distributionServiceReady_{false};
+  // Batches the packets for the distribution service, and sends them from
+  // its thread.  stop() resets it while packets may still be published, so
+  // once running it is only loaded and stored with std::atomic_load() and
+  // std::atomic_store(), and publishers keep the copy they load alive.
+  std::shared_ptr<PacketBatcher> pcapBatcher_;
+  // The shared memory ring to the distribution service, used instead of the
+  // batcher when there is one.  Accessed the same way as pcapBatcher_.
+  std::shared_ptr<ShmPacketRing> pcapRing_;
 
 
   std::unique_ptr<ArpHandler> arp_;
   std::unique_ptr<IPv4Handler> ipv4_;
   std::unique_ptr<IPv6Handler> ipv6_;
   std::unique_ptr<NeighborUpdater> nUpdater_;
+  std::unique_ptr<NeighborChangeStream> neighborChanges_;
+  std::unique_ptr<RouteChangeStream> routeChanges_;
+  std::unique_ptr<PortStatsSnapshot> portStatsSnapshot_;
+  std::unique_ptr<LoadImbalanceMonitor> loadImbalanceMonitor_;
   std::unique_ptr<PktCaptureManager> pcapMgr_;
   std::unique_ptr<RouteUpdateLogger> routeUpdateLogger_;
   std::unique_ptr<UnresolvedNhopsProber> unresolvedNhopsProber_;
   std::unique_ptr<LinkAggregationManager> lagManager_;
+  std::unique_ptr<MicroBfdManager> microBfd_;
 
   BootType bootType_{BootType::UNINITIALIZED};
   std::unique_ptr<LldpManager> lldpManager_;
   std::unique_ptr<PortUpdateHandler> portUpdateHandler_;
+  // Picks which link state changes of flapping ports are passed on.  The
+  // HwSwitch's link state callback and the background thread use it.
+  folly::Synchronized<LinkFlapDampener> linkFlapDampener_;
+  std::unique_ptr<folly::AsyncTimeout> linkReuseTimeout_;
   SwitchFlags flags_{SwitchFlags::DEFAULT};
+  // When the initial config was applied, the start of the wait for the
+  // first FIB sync
+  std::chrono::steady_clock::time_point configuredTime_;
 };
 
 }} // facebook::fboss
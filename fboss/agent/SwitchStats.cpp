@@ -10,7 +10,9 @@
 #include "fboss/agent/SwitchStats.h"
 
 #include "fboss/agent/PortStats.h"
+#include "fboss/agent/ThreadHeartbeat.h"
 #include "common/stats/ExportedStatMapImpl.h"
+#include <folly/Conv.h>
 #include <folly/Memory.h>
 
 using facebook::stats::SUM;
@@ -21,6 +23,7 @@ namespace facebook { namespace fboss {
 
 // set to empty string, we'll prepend prefix when fbagent collects counters
 std::string SwitchStats::kCounterPrefix = "";
+constexpr size_t SwitchStats::kNumPacketProtocols;
 
 SwitchStats::SwitchStats()
     : SwitchStats(stats::ThreadCachedServiceData::get()->getThreadStats()) {
@@ -34,6 +37,8 @@ SwitchStats::SwitchStats(ThreadLocalStatsMap *map)
       trapPktUnhandled_(map, kCounterPrefix + "trapped.unhandled", SUM, RATE),
       trapPktToHost_(map, kCounterPrefix + "host.rx", SUM, RATE),
       trapPktToHostBytes_(map, kCounterPrefix + "host.rx.bytes", SUM, RATE),
+      trapPktBufShared_(map, kCounterPrefix + "trapped.buf.shared", SUM, RATE),
+      trapPktBufCopied_(map, kCounterPrefix + "trapped.buf.copied", SUM, RATE),
       pktFromHost_(map, kCounterPrefix + "host.tx", SUM, RATE),
       pktFromHostBytes_(map, kCounterPrefix + "host.tx.bytes", SUM, RATE),
       trapPktArp_(map, kCounterPrefix + "trapped.arp", SUM, RATE),
@@ -54,6 +59,8 @@ SwitchStats::SwitchStats(ThreadLocalStatsMap *map)
       ipv4NoArp_(map, kCounterPrefix + "ipv4.no_arp", SUM, RATE),
       ipv4TtlExceeded_(map, kCounterPrefix + "ipv4.ttl_exceeded", SUM, RATE),
       ipv6HopExceeded_(map, kCounterPrefix + "ipv6.hop_exceeded", SUM, RATE),
+      icmpErrorRateLimited_(
+          map, kCounterPrefix + "icmp_error.rate_limited", SUM, RATE),
       udpTooSmall_(map, kCounterPrefix + "udp.too_small", SUM, RATE),
       dhcpV4Pkt_(map, kCounterPrefix + "dhcpV4.pkt", SUM, RATE),
       dhcpV4BadPkt_(map, kCounterPrefix + "dhcpV4.bad_pkt", SUM, RATE),
@@ -72,7 +79,66 @@ SwitchStats::SwitchStats(ThreadLocalStatsMap *map)
       dstLookupFailure_(map, kCounterPrefix + "ip.dst_lookup_failure",
           SUM, RATE),
       updateState_(map, kCounterPrefix + "state_update.us", 50000, 0, 1000000),
+      updateBatchSize_(map, kCounterPrefix + "state_update.batch_size",
+                       1, 0, 200, AVG, 50, 99),
+      hwStateChanged_(map, kCounterPrefix + "state_update.hw.us",
+                      50000, 0, 1000000, AVG, 50, 99),
+      stateObserverLag_(map, kCounterPrefix + "state_observer.async.lag.us",
+                        50000, 0, 1000000, AVG, 50, 99),
+      stateObserverBlocked_(map,
+                            kCounterPrefix + "state_observer.async.blocked.us",
+                            50000, 0, 1000000, AVG, 50, 99),
+      lagForwardingChange_(map, kCounterPrefix + "lacp.forwarding_change.us",
+                           100, 0, 10000, AVG, 50, 99),
+      lagForwardingChangeDeferred_(map,
+                                   kCounterPrefix +
+                                   "lacp.forwarding_change.deferred",
+                                   SUM, RATE),
+      lacpTimerTick_(map, kCounterPrefix + "lacp.timer.tick.us",
+                     100, 0, 100000, AVG, 50, 100),
+      lacpTxJitter_(map, kCounterPrefix + "lacp.tx_jitter.ms",
+                    10, 0, 1000, AVG, 50, 100),
+      microBfdSessionDown_(map, kCounterPrefix + "micro_bfd.session_down",
+                           SUM, RATE),
+      microBfdDetection_(map, kCounterPrefix + "micro_bfd.detection.ms",
+                         10, 0, 1000, AVG, 50, 100),
       routeUpdate_(map,  kCounterPrefix + "route_update.us", 50, 0, 500),
+      routeResolve_(map, kCounterPrefix + "route_resolve.us",
+                    10000, 0, 1000000),
+      reclaimState_(map, kCounterPrefix + "state_reclaim.us",
+                    50000, 0, 1000000),
+      reclaimStateInline_(map, kCounterPrefix + "state_reclaim.inline",
+                          SUM, RATE),
+      tunManagerSync_(map, kCounterPrefix + "tun_manager.sync.ms",
+                      100, 0, 10000, AVG, 50, 100),
+      neighborTimerTick_(map, kCounterPrefix + "neighbor.timer.tick.us",
+                         100, 0, 100000, AVG, 50, 100),
+      neighborPortDown_(map, kCounterPrefix + "neighbor.port_down.us",
+                        1000, 0, 1000000, AVG, 50, 100),
+      linkDownReroute_(map, kCounterPrefix + "link_down.reroute.us",
+                       1000, 0, 1000000, AVG, 50, 100),
+      neighborHitScan_(map, kCounterPrefix + "neighbor.hit_scan.ms",
+                       100, 0, 10000, AVG, 50, 100),
+      neighborHitRefresh_(map, kCounterPrefix + "neighbor.hit_refresh",
+                          SUM, RATE),
+      unresolvedNhopProbes_(map, kCounterPrefix + "unresolved_nhop.probes",
+                            SUM, RATE),
+      neighborChangeBatches_(map, kCounterPrefix + "neighbor_changes.batches",
+                             SUM, RATE),
+      neighborChangesDropped_(map,
+                              kCounterPrefix + "neighbor_changes.dropped",
+                              SUM, RATE),
+      routeChangeBatches_(map, kCounterPrefix + "route_changes.batches",
+                          SUM, RATE),
+      routeChangesDropped_(map, kCounterPrefix + "route_changes.dropped",
+                           SUM, RATE),
+      macLearned_(map, kCounterPrefix + "mac_learning.learned", SUM, RATE),
+      macAged_(map, kCounterPrefix + "mac_learning.aged", SUM, RATE),
+      macLearningQueueDrops_(map, kCounterPrefix + "mac_learning.queue_drops",
+                             SUM, RATE),
+      macLearningRateLimited_(map,
+                              kCounterPrefix + "mac_learning.rate_limited",
+                              SUM, RATE),
       bgHeartbeatDelay_(map, kCounterPrefix + "bg_heartbeat_delay.ms",
                         100, 0, 20000, AVG, 50, 100),
       updHeartbeatDelay_(map, kCounterPrefix + "upd_heartbeat_delay.ms",
@@ -91,12 +157,134 @@ SwitchStats::SwitchStats(ThreadLocalStatsMap *map)
       lacpEventBacklog_(map, kCounterPrefix + "lacp_event_backlog",
                         1, 0, 200, AVG, 50, 100),
       linkStateChange_(map, kCounterPrefix + "link_state.flap", SUM),
+      linkUpSuppressed_(
+          map, kCounterPrefix + "link_state.up_suppressed", SUM),
       hwOutOfSync_(
         map, kCounterPrefix + "hw_out_of_sync"),
+      portCounters_(map),
       pcapDistFailure_(map, kCounterPrefix + "pcap_dist_failure.error"),
       updateStatsExceptions_(map, kCounterPrefix + "update_stats_exceptions",
         SUM),
-      trapPktTooBig_(map, kCounterPrefix + "trapped.ptb", SUM, RATE){
+      trapPktTooBig_(map, kCounterPrefix + "trapped.ptb", SUM, RATE),
+      trapPktPoliced_(map, kCounterPrefix + "trapped.policed", SUM, RATE),
+      statsMap_(map) {
+  for (size_t idx = 0; idx < kNumStateUpdateClasses; ++idx) {
+    auto name = stateUpdateClassName(static_cast<StateUpdateClass>(idx));
+    updateQueueDepth_[idx] = std::make_unique<TLHistogram>(
+        map,
+        folly::to<std::string>(
+            kCounterPrefix, "state_update.", name, ".queue_depth"),
+        1, 0, 200, AVG, 50, 100);
+    updateQueueWait_[idx] = std::make_unique<TLHistogram>(
+        map,
+        folly::to<std::string>(
+            kCounterPrefix, "state_update.", name, ".queue_wait.us"),
+        10000, 0, 1000000, AVG, 50, 99);
+  }
+}
+
+void SwitchStats::stateObserverUpdated(
+    const std::string& name,
+    std::chrono::microseconds us) {
+  auto& histogram = observerUpdate_[name];
+  if (!histogram) {
+    histogram = std::make_unique<TLHistogram>(
+        statsMap_,
+        folly::to<std::string>(kCounterPrefix, "state_observer.", name, ".us"),
+        10000, 0, 1000000, AVG, 50, 99);
+  }
+  histogram->addValue(us.count());
+}
+
+void SwitchStats::pktDispatched(
+    PacketProtocol protocol,
+    std::chrono::microseconds us) {
+  pktLatency(protocol)->dispatch.addValue(us.count());
+}
+
+void SwitchStats::pktHandled(
+    PacketProtocol protocol,
+    std::chrono::microseconds us) {
+  pktLatency(protocol)->handle.addValue(us.count());
+}
+
+SwitchStats::PacketLatencyHistograms* SwitchStats::pktLatency(
+    PacketProtocol protocol) {
+  auto& histograms = pktLatency_[static_cast<size_t>(protocol)];
+  if (!histograms) {
+    histograms = std::make_unique<PacketLatencyHistograms>(statsMap_, protocol);
+  }
+  return histograms.get();
+}
+
+const char* SwitchStats::getPacketProtocolName(PacketProtocol protocol) {
+  switch (protocol) {
+    case PacketProtocol::ARP:
+      return "arp";
+    case PacketProtocol::NDP:
+      return "ndp";
+    case PacketProtocol::DHCP:
+      return "dhcp";
+    case PacketProtocol::LLDP:
+      return "lldp";
+    case PacketProtocol::LACP:
+      return "lacp";
+    case PacketProtocol::ICMP:
+      return "icmp";
+    case PacketProtocol::TO_HOST:
+      return "to_host";
+    case PacketProtocol::OTHER:
+      return "other";
+  }
+  return "unknown";
+}
+
+SwitchStats::PacketLatencyHistograms::PacketLatencyHistograms(
+    ThreadLocalStatsMap* map,
+    PacketProtocol protocol)
+    : dispatch(map,
+               folly::to<std::string>(
+                   kCounterPrefix, "trapped.", getPacketProtocolName(protocol),
+                   ".dispatch.us"),
+               100, 0, 10000, AVG, 50, 99),
+      handle(map,
+             folly::to<std::string>(
+                 kCounterPrefix, "trapped.", getPacketProtocolName(protocol),
+                 ".handle.us"),
+             100, 0, 10000, AVG, 50, 99) {}
+
+SwitchStats::EventLoopHistograms::EventLoopHistograms(
+    ThreadLocalStatsMap* map,
+    const std::string& thread)
+    : lag(map,
+          folly::to<std::string>(
+              kCounterPrefix, "event_loop.", thread, ".lag.ms"),
+          100, 0, 20000, AVG, 50, 100),
+      queueDepth(map,
+                 folly::to<std::string>(
+                     kCounterPrefix, "event_loop.", thread, ".queue_depth"),
+                 1, 0, 200, AVG, 50, 100),
+      busyPct(map,
+              folly::to<std::string>(
+                  kCounterPrefix, "event_loop.", thread, ".busy_pct"),
+              1, 0, 100, AVG, 50, 100),
+      longestLoop(map,
+                  folly::to<std::string>(
+                      kCounterPrefix, "event_loop.", thread,
+                      ".longest_loop.us"),
+                  10000, 0, 1000000, AVG, 50, 100) {}
+
+void SwitchStats::eventLoopStats(
+    const std::string& thread,
+    const EventLoopStats& stats) {
+  auto& histograms = eventLoops_[thread];
+  if (!histograms) {
+    histograms = std::make_unique<EventLoopHistograms>(statsMap_, thread);
+  }
+  histograms->lag.addValue(stats.delayMsecs);
+  histograms->queueDepth.addValue(stats.queueSize);
+  histograms->busyPct.addValue(stats.busyPct);
+  histograms->longestLoop.addValue(stats.longestLoopUsecs);
 }
 
 PortStats* FOLLY_NULLABLE SwitchStats::port(PortID portID) {
@@ -9,16 +9,23 @@
  */
 #pragma once
 
+#include <array>
 #include <chrono>
+#include <memory>
+#include <string>
+#include <unordered_map>
 #include <boost/container/flat_map.hpp>
 #include <boost/noncopyable.hpp>
 #include "common/stats/ThreadCachedServiceData.h"
+#include "fboss/agent/PortCounterStore.h"
 #include "fboss/agent/PortStats.h"
+#include "fboss/agent/state/StateUpdate.h"
 #include "fboss/agent/types.h"
 
 namespace facebook { namespace fboss {
 
 class PortStats;
+struct EventLoopStats;
 
 typedef boost::container::flat_map<PortID,
           std::unique_ptr<PortStats>> PortStatsMap;
@@ -30,6 +37,24 @@ class SwitchStats : public boost::noncopyable {
    */
   static std::string kCounterPrefix;
 
+  /*
+   * The protocols that the latency of handling trapped packets is recorded
+   * for.  TO_HOST is IP traffic for the host, which is not handled by any
+   * of the protocols before it.
+   */
+  enum class PacketProtocol : uint8_t {
+    ARP,
+    NDP,
+    DHCP,
+    LLDP,
+    LACP,
+    ICMP,
+    TO_HOST,
+    OTHER,
+  };
+  static constexpr size_t kNumPacketProtocols = 8;
+  static const char* getPacketProtocolName(PacketProtocol protocol);
+
   SwitchStats();
 
   /*
@@ -50,6 +75,10 @@ class SwitchStats : public boost::noncopyable {
   // Create a PortStats object for the given PortID
   PortStats* createPortStats(PortID portID, std::string portName);
 
+  PortCounterStore* getPortCounters() {
+    return &portCounters_;
+  }
+
   void deletePortStats(PortID portID) {
     ports_.erase(portID);
   }
@@ -76,6 +105,14 @@ class SwitchStats : public boost::noncopyable {
     trapPktToHost_.addValue(1);
     trapPktToHostBytes_.addValue(bytes);
   }
+  // A trapped packet was handed on in the RX buffer it arrived in, rather
+  // than copied out of it
+  void pktBufShared() {
+    trapPktBufShared_.addValue(1);
+  }
+  void pktBufCopied() {
+    trapPktBufCopied_.addValue(1);
+  }
   void pktFromHost(uint32_t bytes) {
     pktFromHost_.addValue(1);
     pktFromHostBytes_.addValue(bytes);
@@ -151,6 +188,10 @@ class SwitchStats : public boost::noncopyable {
     ipv6HopExceeded_.addValue(1);
   }
 
+  void icmpErrorRateLimited() {
+    icmpErrorRateLimited_.addValue(1);
+  }
+
   void udpTooSmall() {
     udpTooSmall_.addValue(1);
   }
@@ -204,6 +245,85 @@ class SwitchStats : public boost::noncopyable {
     updateState_.addValue(us.count());
   }
 
+  void stateUpdateQueued(StateUpdateClass updateClass, size_t numPending) {
+    updateQueueDepth_[static_cast<size_t>(updateClass)]->addValue(numPending);
+  }
+
+  void stateUpdateWait(
+      StateUpdateClass updateClass,
+      std::chrono::microseconds us) {
+    updateQueueWait_[static_cast<size_t>(updateClass)]->addValue(us.count());
+  }
+
+  void stateUpdateBatch(size_t numUpdates) {
+    updateBatchSize_.addValue(numUpdates);
+  }
+
+  void hwStateChanged(std::chrono::microseconds us) {
+    hwStateChanged_.addValue(us.count());
+  }
+
+  void stateObserverLag(std::chrono::microseconds us) {
+    stateObserverLag_.addValue(us.count());
+  }
+
+  void stateObserverBlocked(std::chrono::microseconds us) {
+    stateObserverBlocked_.addValue(us.count());
+  }
+
+  /*
+   * Record the time from LACP deciding to enable or disable forwarding over
+   * a LAG member to the hardware having changed, when the hardware could be
+   * changed ahead of the state update; count the changes left to the state
+   * update otherwise.
+   */
+  void lagForwardingChanged(std::chrono::microseconds us) {
+    lagForwardingChange_.addValue(us.count());
+  }
+  void lagForwardingChangeDeferred() {
+    lagForwardingChangeDeferred_.addValue(1);
+  }
+
+  /*
+   * Record the time the LACP machines took to process the timeouts that
+   * expired in one tick of the LacpTimer, and how late each periodic LACPDU
+   * was sent.
+   */
+  void lacpTimerTick(std::chrono::microseconds us) {
+    lacpTimerTick_.addValue(us.count());
+  }
+  void lacpTxJitter(std::chrono::milliseconds ms) {
+    lacpTxJitter_.addValue(ms.count());
+  }
+
+  /*
+   * Record a micro-BFD session going down, and for those that went down as
+   * nothing was heard from the peer, the time since it was last heard from.
+   */
+  void microBfdSessionDown() {
+    microBfdSessionDown_.addValue(1);
+  }
+  void microBfdDetection(std::chrono::milliseconds ms) {
+    microBfdDetection_.addValue(ms.count());
+  }
+
+  /*
+   * Record the time a StateObserver took to handle a state update.  Each
+   * observer name gets its own histogram, created on first use.
+   */
+  void stateObserverUpdated(
+      const std::string& name,
+      std::chrono::microseconds us);
+
+  /*
+   * Record the time a trapped packet took from when it was received from
+   * the hardware to being dispatched to its handler, and the time the
+   * handler then took.  Each protocol gets its own histograms, created on
+   * first use.
+   */
+  void pktDispatched(PacketProtocol protocol, std::chrono::microseconds us);
+  void pktHandled(PacketProtocol protocol, std::chrono::microseconds us);
+
   void routeUpdate(std::chrono::microseconds us, uint64_t routes) {
     // As syncFib() could include no routes.
     if (routes == 0) {
@@ -212,6 +332,75 @@ class SwitchStats : public boost::noncopyable {
     routeUpdate_.addRepeatedValue(us.count() / routes, routes);
   }
 
+  void routeResolve(std::chrono::microseconds us) {
+    routeResolve_.addValue(us.count());
+  }
+
+  void stateReclaimed(std::chrono::microseconds us) {
+    reclaimState_.addValue(us.count());
+  }
+
+  void stateReclaimedInline() {
+    reclaimStateInline_.addValue(1);
+  }
+
+  void tunManagerSync(std::chrono::milliseconds ms) {
+    tunManagerSync_.addValue(ms.count());
+  }
+
+  void neighborTimerTick(std::chrono::microseconds us) {
+    neighborTimerTick_.addValue(us.count());
+  }
+
+  void neighborPortDown(std::chrono::microseconds us) {
+    neighborPortDown_.addValue(us.count());
+  }
+
+  void linkDownReroute(std::chrono::microseconds us) {
+    linkDownReroute_.addValue(us.count());
+  }
+
+  void neighborHitScan(std::chrono::milliseconds ms) {
+    neighborHitScan_.addValue(ms.count());
+  }
+
+  void neighborHitRefresh() {
+    neighborHitRefresh_.addValue(1);
+  }
+
+  void unresolvedNhopProbe() {
+    unresolvedNhopProbes_.addValue(1);
+  }
+
+  void neighborChangeBatch() {
+    neighborChangeBatches_.addValue(1);
+  }
+
+  void neighborChangesDropped(size_t count) {
+    neighborChangesDropped_.addValue(count);
+  }
+
+  void routeChangeBatch() {
+    routeChangeBatches_.addValue(1);
+  }
+
+  void routeChangesDropped(size_t count) {
+    routeChangesDropped_.addValue(count);
+  }
+
+  void macLearned() {
+    macLearned_.addValue(1);
+  }
+  void macAged() {
+    macAged_.addValue(1);
+  }
+  void macLearningQueueDrop() {
+    macLearningQueueDrops_.addValue(1);
+  }
+  void macLearningRateLimited() {
+    macLearningRateLimited_.addValue(1);
+  }
+
   void bgHeartbeatDelay(int delay) {
     bgHeartbeatDelay_.addValue(delay);
   }
@@ -244,10 +433,20 @@ class SwitchStats : public boost::noncopyable {
     packetTxEventBacklog_.addValue(value);
   }
 
+  /*
+   * Record what a thread's event loop did over a heartbeat interval.  Each
+   * thread gets its own histograms, created on first use.
+   */
+  void eventLoopStats(const std::string& thread, const EventLoopStats& stats);
+
   void linkStateChange() {
     linkStateChange_.addValue(1);
   }
 
+  void linkUpSuppressed() {
+    linkUpSuppressed_.addValue(1);
+  }
+
   void setHwOutOfSync() {
     hwOutOfSync_.incrementValue(1);
   }
@@ -268,6 +467,11 @@ class SwitchStats : public boost::noncopyable {
     trapPktTooBig_.addValue(1);
   }
 
+  void pktPoliced() {
+    trapPktPoliced_.addValue(1);
+    trapPktDrops_.addValue(1);
+  }
+
  private:
   // Forbidden copy constructor and assignment operator
   SwitchStats(SwitchStats const &) = delete;
@@ -296,6 +500,10 @@ class SwitchStats : public boost::noncopyable {
   TLTimeseries trapPktToHost_;
   // Trapped packets forwarded to host in bytes
   TLTimeseries trapPktToHostBytes_;
+  // Trapped packets shared with captures and the host without a copy, and
+  // those copied out for the pcap distribution service
+  TLTimeseries trapPktBufShared_;
+  TLTimeseries trapPktBufCopied_;
   // Packets sent by host
   TLTimeseries pktFromHost_;
   // Packets sent by host in bytes
@@ -340,6 +548,9 @@ class SwitchStats : public boost::noncopyable {
   // IPv6 hop count exceeded
   TLTimeseries ipv6HopExceeded_;
 
+  // ICMP errors not sent because of the ICMP error rate limit
+  TLTimeseries icmpErrorRateLimited_;
+
   // UDP packets dropped due to smaller packet size
   TLTimeseries udpTooSmall_;
 
@@ -379,11 +590,158 @@ class SwitchStats : public boost::noncopyable {
    */
   TLHistogram updateState_;
 
+  /**
+   * Histogram of the number of StateUpdates applied in each batch
+   */
+  TLHistogram updateBatchSize_;
+
+  /**
+   * Histogram for time used by HwSwitch::stateChanged() for each batch of
+   * state updates (in microseconds)
+   */
+  TLHistogram hwStateChanged_;
+
+  /**
+   * Histogram of the time from a state delta being queued for an ASYNC state
+   * observer to that observer having handled it, and of the time the update
+   * thread waited for the observer thread to catch up (in microseconds)
+   */
+  TLHistogram stateObserverLag_;
+  TLHistogram stateObserverBlocked_;
+
+  /**
+   * Histogram of the time taken to change forwarding over a LAG member in
+   * hardware (in microseconds), and the changes left to the state update
+   */
+  TLHistogram lagForwardingChange_;
+  TLTimeseries lagForwardingChangeDeferred_;
+
+  /**
+   * Histograms of the time to process one tick of the LacpTimer (in us), and
+   * of the delay of periodic LACPDUs past when they were due (in ms)
+   */
+  TLHistogram lacpTimerTick_;
+  TLHistogram lacpTxJitter_;
+
+  /**
+   * Micro-BFD sessions that went down, and a histogram of the time from the
+   * last packet of the peer until it was declared down (in ms)
+   */
+  TLTimeseries microBfdSessionDown_;
+  TLHistogram microBfdDetection_;
+
+  /**
+   * Per StateUpdateClass histograms of the number of pending updates of that
+   * class, sampled as each update is queued, and of the time updates wait in
+   * the queue before being applied (in microseconds)
+   */
+  std::array<std::unique_ptr<TLHistogram>, kNumStateUpdateClasses>
+      updateQueueDepth_;
+  std::array<std::unique_ptr<TLHistogram>, kNumStateUpdateClasses>
+      updateQueueWait_;
+
   /**
    * Histogram for time used for route update (in microsecond)
    */
   TLHistogram routeUpdate_;
 
+  /**
+   * Histogram for time used to resolve routes in a route update (in
+   * microseconds)
+   */
+  TLHistogram routeResolve_;
+
+  /**
+   * Histogram for time used to destroy retired SwitchStates on the reclaim
+   * thread (in microseconds)
+   */
+  TLHistogram reclaimState_;
+
+  /**
+   * Retired SwitchStates released on the update thread because the reclaim
+   * backlog was full
+   */
+  TLTimeseries reclaimStateInline_;
+
+  /**
+   * Histogram for time used by TunManager::sync() to apply a state to the
+   * tun interfaces on the host (in ms)
+   */
+  TLHistogram tunManagerSync_;
+
+  /**
+   * Histogram for time used to process the neighbor cache entries that
+   * expired in one tick of the NeighborTimer (in us)
+   */
+  TLHistogram neighborTimerTick_;
+
+  /**
+   * Histogram for time from a port down being observed, or its link event
+   * with link_down_fast_path, to the neighbors on the port being queued to
+   * be made pending (in us)
+   */
+  TLHistogram neighborPortDown_;
+
+  /**
+   * Histogram for time from a link down event to the port's state update,
+   * and everything else batched with it, being applied to the hardware (in
+   * us).  The hardware has already stopped using the port by then, and the
+   * neighbors on it are made pending right away with link_down_fast_path.
+   */
+  TLHistogram linkDownReroute_;
+
+  /**
+   * Histogram for time used to scan the hardware for the neighbor entries
+   * hit and mark them in the caches (in ms)
+   */
+  TLHistogram neighborHitScan_;
+
+  /**
+   * Neighbor entries kept reachable for another lifetime, without probing,
+   * because the hardware saw them hit
+   */
+  TLTimeseries neighborHitRefresh_;
+
+  /**
+   * ARP/NDP probes sent for next hops without a resolved neighbor
+   */
+  TLTimeseries unresolvedNhopProbes_;
+
+  /**
+   * Coalesced batches of neighbor changes published to the change stream
+   */
+  TLTimeseries neighborChangeBatches_;
+
+  /**
+   * Neighbor changes discarded from the backlog of a change stream listener
+   * that fell too far behind, and was told to resync instead
+   */
+  TLTimeseries neighborChangesDropped_;
+
+  /**
+   * Coalesced batches of route changes published to the route change stream
+   */
+  TLTimeseries routeChangeBatches_;
+
+  /**
+   * Route changes discarded from the backlog of a route change stream
+   * listener that fell too far behind, and was sent a snapshot instead
+   */
+  TLTimeseries routeChangesDropped_;
+
+  /**
+   * MACs learned and aged out by the hardware, with software MAC learning
+   */
+  TLTimeseries macLearned_;
+  TLTimeseries macAged_;
+
+  /**
+   * MAC learning updates dropped because the MAC learning queue was full,
+   * or because more MACs were learned than max_mac_learns_per_sec
+   */
+  TLTimeseries macLearningQueueDrops_;
+  TLTimeseries macLearningRateLimited_;
+
   /**
    * Background thread heartbeat delay (ms)
    */
@@ -422,6 +780,10 @@ class SwitchStats : public boost::noncopyable {
    * Link state up/down change count
    */
   TLTimeseries linkStateChange_;
+  /**
+   * Links that came up while they were dampened, and were kept down
+   */
+  TLTimeseries linkUpSuppressed_;
 
   /**
    * The counter is >0 if hardware state is out of sync from software state.
@@ -429,6 +791,9 @@ class SwitchStats : public boost::noncopyable {
    */
   TLCounter hwOutOfSync_;
 
+  // The counters of ports_, which must outlive them
+  PortCounterStore portCounters_;
+
   // Individual port stats objects, indexed by PortID
   PortStatsMap ports_;
 
@@ -440,6 +805,47 @@ class SwitchStats : public boost::noncopyable {
 
   // Number of packet too big ICMPv6 triggered
   TLTimeseries trapPktTooBig_;
+
+  // Trapped packets dropped by the CPU software policers
+  TLTimeseries trapPktPoliced_;
+
+  /**
+   * Per StateObserver histograms of the time taken by stateUpdated() (in
+   * microseconds), indexed by observer name
+   */
+  std::unordered_map<std::string, std::unique_ptr<TLHistogram>>
+      observerUpdate_;
+
+  /**
+   * Per thread histograms of event loop lag (ms), notification queue depth,
+   * busy percentage and longest loop iteration (us), indexed by thread name
+   */
+  struct EventLoopHistograms {
+    EventLoopHistograms(ThreadLocalStatsMap* map, const std::string& thread);
+
+    TLHistogram lag;
+    TLHistogram queueDepth;
+    TLHistogram busyPct;
+    TLHistogram longestLoop;
+  };
+  std::unordered_map<std::string, std::unique_ptr<EventLoopHistograms>>
+      eventLoops_;
+
+  /**
+   * Per protocol histograms of the latency (in microseconds) from receiving
+   * a trapped packet to dispatching it, and of handling it
+   */
+  struct PacketLatencyHistograms {
+    PacketLatencyHistograms(ThreadLocalStatsMap* map, PacketProtocol protocol);
+
+    TLHistogram dispatch;
+    TLHistogram handle;
+  };
+  PacketLatencyHistograms* pktLatency(PacketProtocol protocol);
+  std::array<std::unique_ptr<PacketLatencyHistograms>, kNumPacketProtocols>
+      pktLatency_;
+
+  ThreadLocalStatsMap* statsMap_;
 };
 
 }} // facebook::fboss
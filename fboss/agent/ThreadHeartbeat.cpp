@@ -10,26 +10,272 @@
 // Copyright 2014-present Facebook. All Rights Reserved.
 #include "fboss/agent/ThreadHeartbeat.h"
 #include <folly/logging/xlog.h>
+#include <folly/system/ThreadId.h>
+
+#include <execinfo.h>
+#include <signal.h>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
 
 using namespace std::chrono;
 
+namespace {
+
+// The heartbeat of the current thread, if any
+thread_local facebook::fboss::ThreadHeartbeat* currentHeartbeat = nullptr;
+
+/*
+ * The signal a stalled thread is sent to walk its own stack in.  The agent
+ * doesn't use it otherwise.
+ */
+constexpr int kStackSignal = SIGUSR2;
+constexpr int kMaxStackFrames = 64;
+constexpr auto kStackTimeout = milliseconds(100);
+
+/*
+ * Written by the signal handler of the thread being sampled, so it is
+ * preallocated.  Only one thread is sampled at a time.
+ */
+struct StackSample {
+  std::atomic<uint64_t> threadId{0};
+  std::atomic<bool> done{false};
+  void* frames[kMaxStackFrames];
+  int depth{0};
+};
+StackSample stackSample;
+
+void sampleStack(int /*signum*/) {
+  int savedErrno = errno;
+  if (folly::getOSThreadID() ==
+      stackSample.threadId.load(std::memory_order_acquire)) {
+    stackSample.depth = backtrace(stackSample.frames, kMaxStackFrames);
+    stackSample.done.store(true, std::memory_order_release);
+  }
+  errno = savedErrno;
+}
+
+void installStackHandler() {
+  static std::once_flag once;
+  std::call_once(once, [] {
+    // backtrace() loads the unwinder the first time it is called, which
+    // can't be done from a signal handler
+    void* frame;
+    backtrace(&frame, 1);
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = sampleStack;
+    action.sa_flags = SA_RESTART;
+    sigemptyset(&action.sa_mask);
+    if (sigaction(kStackSignal, &action, nullptr) != 0) {
+      XLOG(ERR) << "failed to install the stall stack handler: "
+                << strerror(errno);
+    }
+  });
+}
+
+std::vector<std::string> captureStack(pthread_t thread, uint64_t threadId) {
+  std::vector<std::string> stack;
+  stackSample.done.store(false, std::memory_order_relaxed);
+  stackSample.threadId.store(threadId, std::memory_order_release);
+  if (pthread_kill(thread, kStackSignal) == 0) {
+    auto deadline = steady_clock::now() + kStackTimeout;
+    while (!stackSample.done.load(std::memory_order_acquire) &&
+           steady_clock::now() < deadline) {
+      std::this_thread::sleep_for(milliseconds(1));
+    }
+  }
+  stackSample.threadId.store(0, std::memory_order_release);
+  if (!stackSample.done.load(std::memory_order_acquire)) {
+    return stack;
+  }
+  auto* symbols =
+      backtrace_symbols(stackSample.frames, stackSample.depth);
+  if (!symbols) {
+    return stack;
+  }
+  // Leaving out the frame of the signal handler itself
+  for (int i = 1; i < stackSample.depth; ++i) {
+    stack.emplace_back(symbols[i]);
+  }
+  free(symbols);
+  return stack;
+}
+
+} // unnamed namespace
+
 namespace facebook { namespace fboss {
 
+constexpr size_t ThreadHeartbeatWatchdog::kMaxStallEvents;
+
+ThreadHeartbeat::~ThreadHeartbeat() {
+  evb_->runImmediatelyOrRunInEventBaseThreadAndWait(
+    [this]() {
+      cancelTimeout();
+      evb_->setObserver(nullptr);
+      if (currentHeartbeat == this) {
+        currentHeartbeat = nullptr;
+      }
+    });
+}
+
+void ThreadHeartbeat::scheduleFirstHeartbeat() {
+  CHECK(evb_->inRunningEventBaseThread());
+  evb_->setObserver(loopObserver_);
+  lastTime_ = steady_clock::now();
+  thread_ = pthread_self();
+  threadId_ = folly::getOSThreadID();
+  currentHeartbeat = this;
+  lastBeatNsecs_.store(
+      duration_cast<nanoseconds>(lastTime_.time_since_epoch()).count(),
+      std::memory_order_relaxed);
+  started_.store(true, std::memory_order_release);
+  scheduleTimeout(intervalMsecs_);
+}
+
+std::string ThreadHeartbeat::getActivity() const {
+  std::lock_guard<std::mutex> guard(activityLock_);
+  return activity_;
+}
+
+ThreadHeartbeat::Activity::Activity(const std::string& name)
+    : heartbeat_(currentHeartbeat) {
+  if (heartbeat_) {
+    std::lock_guard<std::mutex> guard(heartbeat_->activityLock_);
+    previous_ = std::move(heartbeat_->activity_);
+    heartbeat_->activity_ = name;
+  }
+}
+
+ThreadHeartbeat::Activity::~Activity() {
+  if (heartbeat_) {
+    std::lock_guard<std::mutex> guard(heartbeat_->activityLock_);
+    heartbeat_->activity_ = std::move(previous_);
+  }
+}
+
 void ThreadHeartbeat::timeoutExpired() noexcept {
   CHECK(evb_->inRunningEventBaseThread());
   auto now = steady_clock::now();
   auto elapsed = duration_cast<milliseconds>(now - lastTime_);
   auto delay = elapsed - intervalMsecs_;
   auto evbQueueSize = evb_->getNotificationQueueSize();
-  heartbeatStatsFunc_(delay.count(), evbQueueSize);
+
+  EventLoopStats stats;
+  stats.delayMsecs = delay.count();
+  stats.queueSize = evbQueueSize;
+  auto total = loopObserver_->busyUsecs + loopObserver_->idleUsecs;
+  if (total > 0) {
+    stats.busyPct = loopObserver_->busyUsecs * 100 / total;
+  }
+  stats.longestLoopUsecs = loopObserver_->longestLoopUsecs;
+  loopObserver_->reset();
+  heartbeatStatsFunc_(stats);
+
   if (delay.count() > delayThresholdMsecs_ ||
       evbQueueSize > backlogThreshold_) {
     XLOG(DBG3) << threadName_ << ": heartbeat elapsed ms:" << elapsed.count()
                << " delay ms:" << delay.count()
-               << " event queue size:" << evbQueueSize;
+               << " event queue size:" << evbQueueSize
+               << " busy:" << stats.busyPct << "%"
+               << " longest loop us:" << stats.longestLoopUsecs;
   }
   lastTime_ = now;
+  lastBeatNsecs_.store(
+      duration_cast<nanoseconds>(now.time_since_epoch()).count(),
+      std::memory_order_relaxed);
+  beats_.fetch_add(1, std::memory_order_release);
   scheduleTimeout(intervalMsecs_);
 }
 
+ThreadHeartbeatWatchdog::ThreadHeartbeatWatchdog(
+    int thresholdMsecs,
+    std::function<void(const ThreadStall&)> stallFunc)
+    : threshold_(thresholdMsecs),
+      stallFunc_(stallFunc) {
+  installStackHandler();
+  thread_ = std::thread([this] { run(); });
+}
+
+ThreadHeartbeatWatchdog::~ThreadHeartbeatWatchdog() {
+  {
+    std::lock_guard<std::mutex> guard(lock_);
+    stop_ = true;
+  }
+  stopped_.notify_one();
+  thread_.join();
+}
+
+void ThreadHeartbeatWatchdog::watch(ThreadHeartbeat* heartbeat) {
+  std::lock_guard<std::mutex> guard(lock_);
+  watched_.push_back(
+      Watched{heartbeat, std::numeric_limits<uint64_t>::max()});
+}
+
+void ThreadHeartbeatWatchdog::run() {
+  // Often enough for a stall to be caught soon after the threshold
+  auto period = std::max(milliseconds(1), threshold_ / 4);
+  std::unique_lock<std::mutex> guard(lock_);
+  while (!stopped_.wait_for(guard, period, [this] { return stop_; })) {
+    check();
+  }
+}
+
+void ThreadHeartbeatWatchdog::check() {
+  auto now = steady_clock::now().time_since_epoch();
+  for (auto& watched : watched_) {
+    auto* heartbeat = watched.heartbeat;
+    if (!heartbeat->started_.load(std::memory_order_acquire)) {
+      continue;
+    }
+    auto beats = heartbeat->beats_.load(std::memory_order_acquire);
+    auto lastBeat = nanoseconds(
+        heartbeat->lastBeatNsecs_.load(std::memory_order_relaxed));
+    auto sinceBeat = duration_cast<milliseconds>(now - lastBeat);
+    if (sinceBeat <= heartbeat->getInterval() + threshold_ ||
+        beats == watched.reportedBeats) {
+      continue;
+    }
+    watched.reportedBeats = beats;
+    reportStall(heartbeat, sinceBeat);
+  }
+}
+
+void ThreadHeartbeatWatchdog::reportStall(
+    ThreadHeartbeat* heartbeat,
+    milliseconds duration) {
+  ThreadStall stall;
+  stall.threadName = heartbeat->getThreadName();
+  stall.duration = duration;
+  stall.count = heartbeat->stalls_.fetch_add(1) + 1;
+  stall.activity = heartbeat->getActivity();
+  stall.stack = captureStack(heartbeat->thread_, heartbeat->threadId_);
+  for (auto& entry : EventTrace::dump()) {
+    if (entry.threadId == heartbeat->threadId_) {
+      stall.events.push_back(std::move(entry));
+    }
+  }
+  if (stall.events.size() > kMaxStallEvents) {
+    stall.events.erase(
+        stall.events.begin(), stall.events.end() - kMaxStallEvents);
+  }
+
+  XLOG(ERR) << stall.threadName << ": stalled, no heartbeat for "
+            << duration.count() << "ms running '" << stall.activity << "'"
+            << ", stalls:" << stall.count;
+  if (stall.stack.empty()) {
+    XLOG(ERR) << stall.threadName << ": stack not sampled";
+  }
+  for (const auto& frame : stall.stack) {
+    XLOG(ERR) << stall.threadName << ":   " << frame;
+  }
+  for (const auto& entry : stall.events) {
+    XLOG(ERR) << stall.threadName << ": event " << entry.timestampUs << " "
+              << EventTrace::eventName(entry.event) << " " << entry.arg0
+              << " " << entry.arg1;
+  }
+  stallFunc_(stall);
+}
+
 }} // facebook::fboss
@@ -12,55 +12,220 @@
 #include <folly/io/async/AsyncTimeout.h>
 #include <folly/io/async/EventBase.h>
 #include <folly/logging/xlog.h>
+#include <pthread.h>
+#include <algorithm>
+#include <atomic>
 #include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "fboss/agent/EventTrace.h"
 
 namespace facebook { namespace fboss {
 
+/*
+ * What an event loop did over one heartbeat interval.
+ */
+struct EventLoopStats {
+  // How late the heartbeat ran
+  int delayMsecs{0};
+  // Callbacks waiting in the event base notification queue
+  int queueSize{0};
+  // Percentage of the interval spent running callbacks rather than waiting
+  int busyPct{0};
+  // The longest single loop iteration, which bounds the longest callback
+  int64_t longestLoopUsecs{0};
+};
+
 class ThreadHeartbeat : private folly::AsyncTimeout {
   /*
    * Send heartbeat at regular interval to thread.  Measure delay between
    * time we expect heartbeat to be processed vs. time actually processed,
-   * and record it to ods.
+   * and record it to ods.  Also sample every iteration of the event loop, to
+   * report how busy the thread was over the interval.
    */
  public:
   ThreadHeartbeat(folly::EventBase* evb, std::string threadName,
                   int intervalMsecs,
-                  std::function<void(int, int)> heartbeatStatsFunc) :
+                  std::function<void(const EventLoopStats&)>
+                      heartbeatStatsFunc) :
       AsyncTimeout(evb),
       evb_(evb),
       threadName_(threadName),
       intervalMsecs_(intervalMsecs),
-      heartbeatStatsFunc_(heartbeatStatsFunc) {
+      heartbeatStatsFunc_(heartbeatStatsFunc),
+      loopObserver_(std::make_shared<LoopObserver>()) {
     XLOG(DBG2) << "ThreadHeartbeat intervalMsecs:" << intervalMsecs_.count();
     evb_->runInEventBaseThread([this]() {
         scheduleFirstHeartbeat();
       });
   }
 
-  ~ThreadHeartbeat() override {
-    evb_->runImmediatelyOrRunInEventBaseThreadAndWait(
-      [this]() {
-        cancelTimeout();
-      });
+  ~ThreadHeartbeat() override;
+
+  const std::string& getThreadName() const {
+    return threadName_;
+  }
+
+  std::chrono::milliseconds getInterval() const {
+    return intervalMsecs_;
+  }
+
+  // The number of stalls a ThreadHeartbeatWatchdog found on the thread
+  uint64_t getStalls() const {
+    return stalls_.load(std::memory_order_relaxed);
   }
 
+  // What the thread is running, as named by the innermost Activity
+  std::string getActivity() const;
+
+  /*
+   * Names what the current thread runs from construction to destruction,
+   * for a stall to be reported with.  Only has an effect on a thread with a
+   * heartbeat.
+   */
+  class Activity {
+   public:
+    explicit Activity(const std::string& name);
+    ~Activity();
+
+   private:
+    // Forbidden copy constructor and assignment operator
+    Activity(Activity const &) = delete;
+    Activity& operator=(Activity const &) = delete;
+
+    ThreadHeartbeat* heartbeat_;
+    std::string previous_;
+  };
+
  private:
+  /*
+   * Accumulates the busy and idle time of each loop iteration.  Only used
+   * from the event base thread.
+   */
+  class LoopObserver : public folly::EventBaseObserver {
+   public:
+    uint32_t getSampleRate() const override {
+      return 1;
+    }
+
+    void loopSample(int64_t busyTime, int64_t idleTime) override {
+      busyUsecs += busyTime;
+      idleUsecs += idleTime;
+      longestLoopUsecs = std::max(longestLoopUsecs, busyTime);
+    }
+
+    void reset() {
+      busyUsecs = 0;
+      idleUsecs = 0;
+      longestLoopUsecs = 0;
+    }
+
+    int64_t busyUsecs{0};
+    int64_t idleUsecs{0};
+    int64_t longestLoopUsecs{0};
+  };
+
   void timeoutExpired() noexcept override;
 
-  void scheduleFirstHeartbeat() {
-    CHECK(evb_->inRunningEventBaseThread());
-    lastTime_ = std::chrono::steady_clock::now();
-    scheduleTimeout(intervalMsecs_);
-  }
+  void scheduleFirstHeartbeat();
+
+  friend class ThreadHeartbeatWatchdog;
 
   folly::EventBase* evb_;
   std::string threadName_;
   std::chrono::milliseconds intervalMsecs_;
-  std::function<void(int, int)> heartbeatStatsFunc_;
+  std::function<void(const EventLoopStats&)> heartbeatStatsFunc_;
+  std::shared_ptr<LoopObserver> loopObserver_;
   std::chrono::time_point<std::chrono::steady_clock> lastTime_;
   //XXX: these thresholds could be made configurable if needed
   int delayThresholdMsecs_ = 1000;
   int backlogThreshold_ = 10;
+
+  /*
+   * Read by a ThreadHeartbeatWatchdog from its own thread.  The thread and
+   * the last heartbeat are only set once the first heartbeat is scheduled.
+   */
+  std::atomic<bool> started_{false};
+  pthread_t thread_;
+  uint64_t threadId_{0};
+  // The heartbeats run so far, and the steady clock time of the last one
+  std::atomic<uint64_t> beats_{0};
+  std::atomic<int64_t> lastBeatNsecs_{0};
+  std::atomic<uint64_t> stalls_{0};
+  mutable std::mutex activityLock_;
+  std::string activity_;
+};
+
+/*
+ * What a ThreadHeartbeatWatchdog captured of a stalled thread.
+ */
+struct ThreadStall {
+  std::string threadName;
+  // How long the thread has gone without a heartbeat
+  std::chrono::milliseconds duration{0};
+  // The stalls found on the thread so far, this one included
+  uint64_t count{0};
+  std::string activity;
+  // The symbolized frames of the thread's stack, innermost first.  Empty if
+  // the thread didn't handle the sampling signal in time.
+  std::vector<std::string> stack;
+  // The latest trace events of the thread, oldest first
+  std::vector<EventTrace::Entry> events;
+};
+
+class ThreadHeartbeatWatchdog {
+  /*
+   * A ThreadHeartbeat can only run on its thread, so it can't tell a
+   * thread that is stuck in one callback: the heartbeat just never runs.
+   * The watchdog checks the heartbeats from a thread of its own, and once a
+   * thread goes thresholdMsecs past its heartbeat interval it samples the
+   * thread's stack, by signalling the thread to walk its own stack into a
+   * preallocated buffer, and logs it with the thread's activity and latest
+   * trace events.  Each stall is reported once, when it passes the
+   * threshold.
+   */
+ public:
+  ThreadHeartbeatWatchdog(int thresholdMsecs,
+                          std::function<void(const ThreadStall&)>
+                              stallFunc);
+  ~ThreadHeartbeatWatchdog();
+
+  // The heartbeat must outlive the watchdog
+  void watch(ThreadHeartbeat* heartbeat);
+
+  static constexpr size_t kMaxStallEvents = 32;
+
+ private:
+  // Forbidden copy constructor and assignment operator
+  ThreadHeartbeatWatchdog(ThreadHeartbeatWatchdog const &) = delete;
+  ThreadHeartbeatWatchdog& operator=(ThreadHeartbeatWatchdog const &) =
+      delete;
+
+  struct Watched {
+    ThreadHeartbeat* heartbeat;
+    // The beats when the last stall was reported, so that it is only
+    // reported once
+    uint64_t reportedBeats;
+  };
+
+  void run();
+  void check();
+  void reportStall(ThreadHeartbeat* heartbeat,
+                   std::chrono::milliseconds duration);
+
+  std::chrono::milliseconds threshold_;
+  std::function<void(const ThreadStall&)> stallFunc_;
+  std::mutex lock_;
+  std::condition_variable stopped_;
+  bool stop_{false};
+  std::vector<Watched> watched_;
+  std::thread thread_;
 };
 
 }} // facebook::fboss
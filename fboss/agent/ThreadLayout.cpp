@@ -0,0 +1,297 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "fboss/agent/ThreadLayout.h"
+
+#include "common/stats/ServiceData.h"
+#include "fboss/agent/FbossError.h"
+
+#include <folly/Conv.h>
+#include <folly/FileUtil.h>
+#include <folly/String.h>
+#include <folly/logging/xlog.h>
+
+#include <dirent.h>
+#include <sched.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <unordered_set>
+
+DEFINE_string(thread_layout, "",
+              "CPU pinning and scheduling policy of the agent's threads by "
+              "name, as \"name=cpus:2-3,fifo:40,nice:5;...\".  See "
+              "ThreadLayout.h");
+DEFINE_string(thread_layout_default_cpus, "",
+              "The CPUs of the threads thread_layout has no entry for, so "
+              "that the CPUs it pins threads to can be kept for them");
+
+namespace facebook { namespace fboss {
+
+namespace {
+
+// The kernel keeps thread names to 15 characters and a terminating null
+constexpr size_t kMaxThreadName = 15;
+
+folly::StringPiece kernelName(folly::StringPiece name) {
+  return name.subpiece(0, kMaxThreadName);
+}
+
+bool matches(const std::string& pattern, folly::StringPiece name) {
+  if (!pattern.empty() && pattern.back() == '*') {
+    return name.startsWith(
+        folly::StringPiece(pattern.data(), pattern.size() - 1));
+  }
+  return name == pattern;
+}
+
+ThreadPolicy parsePolicy(folly::StringPiece options) {
+  ThreadPolicy policy;
+  // The CPU lists have commas of their own, so an option starts at a comma
+  // followed by a known option name
+  std::vector<folly::StringPiece> parts;
+  folly::split(',', options, parts);
+  std::string current;
+  auto finish = [&policy](const std::string& option) {
+    folly::StringPiece key, value;
+    if (!folly::split(':', option, key, value)) {
+      throw FbossError("Bad thread layout option \"", option, "\"");
+    }
+    key = folly::trimWhitespace(key);
+    value = folly::trimWhitespace(value);
+    if (key == "cpus") {
+      policy.cpus = ThreadLayout::parseCpuList(value);
+    } else if (key == "fifo") {
+      policy.fifoPriority = folly::to<int>(value);
+      if (policy.fifoPriority < 1 || policy.fifoPriority > 99) {
+        throw FbossError("SCHED_FIFO priority ", value, " not in 1-99");
+      }
+    } else if (key == "nice") {
+      policy.nice = folly::to<int>(value);
+    } else {
+      throw FbossError("Unknown thread layout option \"", key, "\"");
+    }
+  };
+  for (auto part : parts) {
+    auto trimmed = folly::trimWhitespace(part);
+    bool startsOption = trimmed.startsWith("cpus:") ||
+        trimmed.startsWith("fifo:") || trimmed.startsWith("nice:");
+    if (startsOption && !current.empty()) {
+      finish(current);
+      current.clear();
+    }
+    if (!current.empty()) {
+      current.push_back(',');
+    }
+    current.append(trimmed.begin(), trimmed.end());
+  }
+  if (!current.empty()) {
+    finish(current);
+  }
+  return policy;
+}
+
+pid_t currentTid() {
+  return static_cast<pid_t>(syscall(SYS_gettid));
+}
+
+} // unnamed namespace
+
+ThreadLayout::ThreadLayout(
+    const std::string& layout,
+    const std::string& defaultCpus) {
+  std::vector<folly::StringPiece> entries;
+  folly::split(';', layout, entries);
+  for (auto entry : entries) {
+    entry = folly::trimWhitespace(entry);
+    if (entry.empty()) {
+      continue;
+    }
+    folly::StringPiece name, options;
+    if (!folly::split('=', entry, name, options)) {
+      throw FbossError("Bad thread layout entry \"", entry, "\"");
+    }
+    name = folly::trimWhitespace(name);
+    if (name.empty()) {
+      throw FbossError("Thread layout entry \"", entry, "\" has no name");
+    }
+    // A prefix keeps its '*', and is cut short of it if need be
+    std::string pattern;
+    if (name.back() == '*') {
+      pattern = kernelName(name.subpiece(0, name.size() - 1)).str() + "*";
+    } else {
+      pattern = kernelName(name).str();
+    }
+    policies_.emplace_back(std::move(pattern), parsePolicy(options));
+  }
+  defaultPolicy_.cpus = parseCpuList(defaultCpus);
+}
+
+std::vector<int> ThreadLayout::parseCpuList(folly::StringPiece list) {
+  std::vector<int> cpus;
+  std::vector<folly::StringPiece> parts;
+  folly::split(',', list, parts);
+  for (auto part : parts) {
+    part = folly::trimWhitespace(part);
+    if (part.empty()) {
+      continue;
+    }
+    if (part.startsWith("node")) {
+      auto path = folly::to<std::string>(
+          "/sys/devices/system/node/", part, "/cpulist");
+      std::string nodeCpus;
+      if (!folly::readFile(path.c_str(), nodeCpus)) {
+        throw FbossError("No CPUs found for NUMA ", part);
+      }
+      auto expanded = parseCpuList(nodeCpus);
+      cpus.insert(cpus.end(), expanded.begin(), expanded.end());
+      continue;
+    }
+    folly::StringPiece first, last;
+    int begin, end;
+    if (folly::split('-', part, first, last)) {
+      begin = folly::to<int>(folly::trimWhitespace(first));
+      end = folly::to<int>(folly::trimWhitespace(last));
+    } else {
+      begin = end = folly::to<int>(part);
+    }
+    if (begin < 0 || end < begin || end >= CPU_SETSIZE) {
+      throw FbossError("Bad CPU range \"", part, "\"");
+    }
+    for (int cpu = begin; cpu <= end; ++cpu) {
+      cpus.push_back(cpu);
+    }
+  }
+  return cpus;
+}
+
+const ThreadPolicy& ThreadLayout::policyFor(folly::StringPiece name) const {
+  name = kernelName(name);
+  for (const auto& entry : policies_) {
+    if (matches(entry.first, name)) {
+      return entry.second;
+    }
+  }
+  return defaultPolicy_;
+}
+
+void ThreadLayout::applyToCurrentThread(folly::StringPiece name) const {
+  apply(currentTid(), name);
+}
+
+void ThreadLayout::apply(pid_t tid, folly::StringPiece name) const {
+  const auto& policy = policyFor(name);
+  if (policy.empty()) {
+    return;
+  }
+  if (!policy.cpus.empty()) {
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    for (auto cpu : policy.cpus) {
+      CPU_SET(cpu, &cpus);
+    }
+    if (sched_setaffinity(tid, sizeof(cpus), &cpus) != 0) {
+      XLOG(ERR) << "Error while pinning thread " << name << " to CPUs "
+                << folly::join(",", policy.cpus) << ": " << strerror(errno);
+    }
+  }
+  if (policy.fifoPriority > 0) {
+    sched_param param;
+    param.sched_priority = policy.fifoPriority;
+    if (sched_setscheduler(tid, SCHED_FIFO, &param) != 0) {
+      XLOG(ERR) << "Error while setting thread " << name
+                << " to real-time priority " << policy.fifoPriority << ": "
+                << strerror(errno);
+    }
+  }
+  if (policy.nice &&
+      setpriority(PRIO_PROCESS, tid, *policy.nice) != 0) {
+    XLOG(ERR) << "Error while setting the nice value of thread " << name
+              << " to " << *policy.nice << ": " << strerror(errno);
+  }
+  XLOG(DBG1) << "Applied the thread layout to " << name << " (" << tid
+             << ")";
+}
+
+void ThreadLayout::update(std::chrono::steady_clock::time_point now) {
+  static const auto kTicksPerSec = sysconf(_SC_CLK_TCK);
+  auto elapsed = std::chrono::duration<double>(now - lastUpdate_).count();
+  bool first = lastUpdate_ == std::chrono::steady_clock::time_point();
+  lastUpdate_ = now;
+
+  auto dir = opendir("/proc/self/task");
+  if (!dir) {
+    XLOG(ERR) << "Cannot list our threads: " << strerror(errno);
+    return;
+  }
+  std::unordered_set<pid_t> alive;
+  std::map<std::string, double> cpuPercent;
+  while (auto entry = readdir(dir)) {
+    if (entry->d_name[0] == '.') {
+      continue;
+    }
+    auto tid = folly::to<pid_t>(entry->d_name);
+    std::string stat;
+    auto path = folly::to<std::string>("/proc/self/task/", tid, "/stat");
+    // The thread may have exited since we listed it
+    if (!folly::readFile(path.c_str(), stat)) {
+      continue;
+    }
+    // "tid (name) state ..." where the name may hold spaces and parens
+    auto open = stat.find('(');
+    auto close = stat.rfind(')');
+    if (open == std::string::npos || close == std::string::npos ||
+        close < open) {
+      continue;
+    }
+    auto name = stat.substr(open + 1, close - open - 1);
+    std::vector<folly::StringPiece> fields;
+    folly::split(' ', folly::StringPiece(stat).subpiece(close + 2), fields);
+    // utime and stime, fields 14 and 15 of the whole line
+    if (fields.size() < 13) {
+      continue;
+    }
+    auto ticks = folly::to<uint64_t>(fields[11]) +
+        folly::to<uint64_t>(fields[12]);
+
+    alive.insert(tid);
+    auto& info = threads_[tid];
+    if (info.name != name) {
+      // A new thread, or one that has been renamed since it started
+      apply(tid, name);
+      info.name = name;
+    } else if (!first && elapsed > 0) {
+      cpuPercent[name] +=
+          100.0 * (ticks - info.cpuTicks) / kTicksPerSec / elapsed;
+    }
+    info.cpuTicks = ticks;
+  }
+  closedir(dir);
+
+  for (auto it = threads_.begin(); it != threads_.end();) {
+    if (alive.count(it->first)) {
+      ++it;
+    } else {
+      it = threads_.erase(it);
+    }
+  }
+  cpuPercent_ = std::move(cpuPercent);
+}
+
+void ThreadLayout::publishStats() const {
+  for (const auto& entry : cpuPercent_) {
+    fbData->setCounter(
+        folly::to<std::string>("thread.", entry.first, ".cpu_pct"),
+        static_cast<int64_t>(entry.second));
+  }
+}
+
+}} // facebook::fboss
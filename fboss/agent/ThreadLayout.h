@@ -0,0 +1,118 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#pragma once
+
+#include <folly/Optional.h>
+#include <folly/Range.h>
+#include <gflags/gflags.h>
+
+#include <sys/types.h>
+
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+DECLARE_string(thread_layout);
+DECLARE_string(thread_layout_default_cpus);
+
+namespace facebook { namespace fboss {
+
+/*
+ * Where and how a thread is scheduled.  Unset fields leave the thread as
+ * it was.
+ */
+struct ThreadPolicy {
+  // The CPUs the thread may run on
+  std::vector<int> cpus;
+  // Run at this SCHED_FIFO priority, from 1 to 99
+  int fifoPriority{0};
+  folly::Optional<int> nice;
+
+  bool empty() const {
+    return cpus.empty() && fifoPriority == 0 && !nice;
+  }
+};
+
+/*
+ * ThreadLayout pins the agent's threads to CPUs and sets their scheduling
+ * policy by thread name, and exports the CPU each thread uses.
+ *
+ * The layout is a list of "name=option,option" entries separated by ';'.
+ * The options are "cpus:<list>", "fifo:<priority>" and "nice:<value>".  A
+ * CPU list is made of CPUs and ranges such as "2-3,6", or "node<N>" for the
+ * CPUs of a NUMA node.  A name ending in '*' matches all names it is a
+ * prefix of, and names are compared as the kernel keeps them, cut to 15
+ * characters.  For example:
+ *
+ *   fbossUpdateThread=cpus:2;fbossRxWorker*=cpus:3-5;
+ *   fbossLacpThread=fifo:40;bcmLINK*=fifo:50
+ *
+ * Threads that match no entry are confined to the default CPUs, if any, so
+ * that the CPUs the layout gives to the busy threads can stay isolated.
+ *
+ * The threads of the process are found in /proc, so the layout also applies
+ * to threads the SDK starts, such as its RX and linkscan threads.  Our own
+ * threads apply their policy as they start, and update() applies it to the
+ * threads it has not seen under their current name before.
+ */
+class ThreadLayout {
+ public:
+  // Throws FbossError if the layout or the CPU list do not parse
+  ThreadLayout(const std::string& layout, const std::string& defaultCpus);
+
+  /*
+   * The policy of the thread named name, which is the default policy if no
+   * entry matches.
+   */
+  const ThreadPolicy& policyFor(folly::StringPiece name) const;
+
+  void applyToCurrentThread(folly::StringPiece name) const;
+
+  /*
+   * Apply the layout to new threads, and work out how much CPU each thread
+   * used since the last update.  Called from the stats thread.
+   */
+  void update(std::chrono::steady_clock::time_point now);
+
+  /*
+   * The percentage of a CPU the threads of each name used between the last
+   * two updates.
+   */
+  const std::map<std::string, double>& getCpuPercent() const {
+    return cpuPercent_;
+  }
+
+  void publishStats() const;
+
+  static std::vector<int> parseCpuList(folly::StringPiece list);
+
+ private:
+  struct ThreadInfo {
+    std::string name;
+    uint64_t cpuTicks{0};
+  };
+
+  void apply(pid_t tid, folly::StringPiece name) const;
+
+  // In the order given, with the names cut to the kernel's length
+  std::vector<std::pair<std::string, ThreadPolicy>> policies_;
+  ThreadPolicy defaultPolicy_;
+
+  // Only used from the stats thread
+  std::unordered_map<pid_t, ThreadInfo> threads_;
+  std::chrono::steady_clock::time_point lastUpdate_;
+  std::map<std::string, double> cpuPercent_;
+};
+
+}} // facebook::fboss
@@ -15,16 +15,24 @@
 #include "common/stats/ServiceData.h"
 #include "fboss/agent/AddressUtil.h"
 #include "fboss/agent/ArpHandler.h"
+#include "fboss/agent/EventTrace.h"
+#include "fboss/agent/HashSimulator.h"
 #include "fboss/agent/HighresCounterSubscriptionHandler.h"
 #include "fboss/agent/IPv6Handler.h"
 #include "fboss/agent/LinkAggregationManager.h"
 #include "fboss/agent/LldpManager.h"
+#include "fboss/agent/LoadImbalanceMonitor.h"
+#include "fboss/agent/MemoryAccount.h"
+#include "fboss/agent/PuntStats.h"
 #include "fboss/agent/SwitchStats.h"
 #include "fboss/agent/SwSwitch.h"
 #include "fboss/agent/TxPacket.h"
 #include "fboss/agent/Utils.h"
 #include "fboss/agent/NeighborUpdater.h"
 #include "fboss/agent/RouteUpdateLogger.h"
+#include "fboss/agent/StartupProfiler.h"
+#include "fboss/agent/StateUpdateRecorder.h"
+#include "fboss/agent/WarmBootTimeline.h"
 #include "fboss/agent/capture/PktCapture.h"
 #include "fboss/agent/capture/PktCaptureManager.h"
 #include "fboss/agent/hw/mock/MockRxPacket.h"
@@ -34,29 +42,39 @@
 #include "fboss/agent/state/ArpTable.h"
 #include "fboss/agent/state/Interface.h"
 #include "fboss/agent/state/InterfaceMap.h"
+#include "fboss/agent/state/LoadBalancerMap.h"
 #include "fboss/agent/state/NdpTable.h"
 #include "fboss/agent/state/NdpEntry.h"
 #include "fboss/agent/state/Port.h"
+#include "fboss/agent/state/PortMap.h"
 #include "fboss/agent/state/PortQueue.h"
 #include "fboss/agent/state/Route.h"
 #include "fboss/agent/state/RouteTable.h"
+#include "fboss/agent/state/RouteTableMap.h"
 #include "fboss/agent/state/RouteTableRib.h"
 #include "fboss/agent/state/RouteUpdater.h"
+#include "fboss/agent/state/StateMemoryAccounting.h"
 #include "fboss/agent/state/StateUtils.h"
 #include "fboss/agent/state/SwitchState.h"
 #include "fboss/agent/state/Vlan.h"
 #include "fboss/agent/state/VlanMap.h"
 #include "fboss/agent/if/gen-cpp2/NeighborListenerClient.h"
 
+#include <folly/Conv.h>
 #include <folly/MoveWrapper.h>
+#include <folly/Optional.h>
+#include <folly/futures/Future.h>
 #include <folly/Range.h>
 #include <folly/io/Cursor.h>
 #include <folly/io/IOBuf.h>
+#include <folly/json.h>
 #include <folly/json_pointer.h>
 #include <folly/logging/xlog.h>
 #include <thrift/lib/cpp2/async/DuplexChannel.h>
 
+#include <algorithm>
 #include <limits>
+#include <mutex>
 
 using apache::thrift::ClientReceiveState;
 using facebook::fb303::cpp2::fb_status;
@@ -87,6 +105,23 @@ DEFINE_bool(
     enable_running_config_mutations,
     false,
     "Allow external mutations of running config");
+DEFINE_int32(
+    max_route_transactions,
+    16,
+    "Maximum number of route transactions that may be open at once");
+DEFINE_int32(
+    route_transaction_idle_timeout_ms,
+    300000,
+    "Abort route transactions that were not used for this long, or never "
+    "if 0");
+DEFINE_int32(
+    max_route_table_page_size,
+    10000,
+    "Maximum number of routes returned by one getRouteTablePage() call");
+DEFINE_int32(
+    max_l2_table_page_size,
+    10000,
+    "Maximum number of L2 entries returned by one getL2TablePage() call");
 
 namespace facebook { namespace fboss {
 
@@ -107,16 +142,6 @@ fromFwdNextHops(RouteNextHopSet const& nexthops) {
   }
   return nhs;
 }
-
-std::vector<NextHopThrift> thriftNextHopsFromAddresses(
-    const std::vector<network::thrift::BinaryAddress>& addrs) {
-  std::vector<NextHopThrift> nhs;
-  nhs.reserve(addrs.size());
-  for (const auto& addr : addrs) {
-    nhs.emplace_back(apache::thrift::FRAGILE, addr, 0);
-  }
-  return nhs;
-}
 }
 
 class RouteUpdateStats {
@@ -142,10 +167,311 @@ class RouteUpdateStats {
   std::chrono::time_point<std::chrono::steady_clock> start_;
 };
 
-ThriftHandler::ThriftHandler(SwSwitch* sw) : FacebookBase2("FBOSS"), sw_(sw) {
+/*
+ * Routes staged by addUnicastRoutesInTransaction(), to be applied by
+ * commitRouteTransaction().
+ */
+struct RouteTransaction {
+  RouteTransaction(
+      int16_t client,
+      const TConnectionContext* connection,
+      std::shared_ptr<RouteTableMap> base)
+      : client(client),
+        connection(connection),
+        base(std::move(base)),
+        updater(std::make_unique<RouteUpdater>(this->base)),
+        lastUsed(std::chrono::steady_clock::now()) {}
+
+  // Serializes the calls for this transaction
+  std::mutex lock;
+  const int16_t client;
+  // The connection that began the transaction, which aborts it on closing
+  const TConnectionContext* const connection;
+  // The route tables the staged routes were added to
+  const std::shared_ptr<RouteTableMap> base;
+  std::unique_ptr<RouteUpdater> updater;
+  // The staged routes, in case they need to be added to newer route tables
+  std::vector<UnicastRoute> routes;
+  // Only accessed while holding the lock of the open transactions
+  std::chrono::steady_clock::time_point lastUsed;
+};
+
+namespace {
+/*
+ * Add route to updater and return its network.  nexthops is scratch space
+ * for the route's next hops, reused across the routes of a batch so that
+ * converting a route doesn't allocate a set each time.
+ */
+folly::IPAddress addUnicastRoute(
+    RouteUpdater* updater,
+    RouterID routerId,
+    int16_t client,
+    AdminDistance clientIdToAdmin,
+    const UnicastRoute& route,
+    RouteNextHopSet* nexthops) {
+  folly::IPAddress network = toIPAddress(route.dest.ip);
+  uint8_t mask = static_cast<uint8_t>(route.dest.prefixLength);
+  auto adminDistance = route.__isset.adminDistance ? route.adminDistance :
+    clientIdToAdmin;
+  RouteClassID classID(route.__isset.classID ? route.classID : 0);
+  util::toRouteNextHopSet(route, nexthops);
+  if (nexthops->size()) {
+    // The set is only copied if no other route has the same next hops
+    updater->addRoute(routerId, network, mask, ClientID(client),
+                      RouteNextHopEntry(*nexthops, adminDistance), classID);
+  } else {
+    XLOG(DBG3) << "Blackhole route:" << network << "/"
+               << static_cast<int>(mask);
+    updater->addRoute(routerId, network, mask, ClientID(client),
+                      RouteNextHopEntry(RouteForwardAction::DROP,
+                        adminDistance), classID);
+  }
+  return network;
+}
+
+/*
+ * Append the routes that client has next hops for in rib, found through the
+ * rib's client index rather than by walking all of its routes.
+ */
+template <typename RibT>
+void addClientRoutes(const RibT& rib, ClientID client,
+                     std::vector<UnicastRoute>* routes) {
+  auto prefixes = rib.getClientPrefixesIf(client);
+  if (!prefixes) {
+    return;
+  }
+  for (const auto& prefix : *prefixes) {
+    auto route = rib.exactMatch(prefix.first);
+    auto entry = route->getEntryForClient(client);
+    CHECK(entry);
+
+    UnicastRoute tempRoute;
+    tempRoute.dest.ip = toBinaryAddress(route->prefix().network);
+    tempRoute.dest.prefixLength = route->prefix().mask;
+    tempRoute.nextHops = util::fromRouteNextHopSet(entry->getNextHopSet());
+    for (const auto& nh : tempRoute.nextHops) {
+      tempRoute.nextHopAddrs.emplace_back(nh.address);
+    }
+    if (route->getClassID() != RouteClassID(0)) {
+      tempRoute.classID = static_cast<uint32_t>(route->getClassID());
+      tempRoute.__isset.classID = true;
+    }
+    routes->emplace_back(std::move(tempRoute));
+  }
+}
+
+/*
+ * Complete a thrift callback once future does.
+ */
+void completeWhenDone(
+    ThriftHandler::ThriftCallback<void> callback,
+    folly::Future<folly::Unit> future) {
+  future.then([callback = std::move(callback)](
+                  folly::Try<folly::Unit>&& result) {
+    if (result.hasException()) {
+      callback->exception(std::move(result.exception()));
+    } else {
+      callback->done();
+    }
+  });
+}
+
+template <typename AddrT>
+AddrT addrAs(const IPAddress& addr);
+template <>
+IPAddressV4 addrAs<IPAddressV4>(const IPAddress& addr) {
+  return addr.asV4();
+}
+template <>
+IPAddressV6 addrAs<IPAddressV6>(const IPAddress& addr) {
+  return addr.asV6();
+}
+
+/*
+ * A route table cursor is "<vrf>:<prefix>" of the last route of a page.
+ */
+struct RouteCursor {
+  RouterID vrf;
+  folly::CIDRNetwork prefix;
+};
+
+std::string encodeRouteCursor(RouterID vrf, const folly::CIDRNetwork& prefix) {
+  return folly::to<std::string>(
+      static_cast<int32_t>(vrf),
+      ":",
+      prefix.first.str(),
+      "/",
+      static_cast<int>(prefix.second));
+}
+
+folly::Optional<RouteCursor> parseRouteCursor(const std::string& cursor) {
+  if (cursor.empty()) {
+    return folly::none;
+  }
+  auto sep = cursor.find(':');
+  if (sep != std::string::npos) {
+    try {
+      return RouteCursor{
+          RouterID(folly::to<int32_t>(cursor.substr(0, sep))),
+          IPAddress::createNetwork(cursor.substr(sep + 1), -1, false)};
+    } catch (const std::exception&) {
+    }
+  }
+  throw FbossError("invalid route table cursor: ", cursor);
+}
+
+/*
+ * Call fn on the entries of nodes, a container ordered by RoutePrefix<AddrT>,
+ * whose prefix is within within and comes after after, in order, until fn
+ * returns false.  Returns false if fn did.
+ *
+ * Prefixes are ordered by mask and then by network, so for each mask the
+ * prefixes within a network are a contiguous run that lower_bound() finds,
+ * and we never walk the routes outside of it.
+ */
+template <typename AddrT, typename NodesT, typename Fn>
+bool walkPrefixes(
+    const NodesT& nodes,
+    const folly::Optional<folly::CIDRNetwork>& within,
+    const folly::Optional<folly::CIDRNetwork>& after,
+    Fn&& fn) {
+  using Prefix = RoutePrefix<AddrT>;
+  folly::Optional<Prefix> afterPrefix;
+  if (after) {
+    afterPrefix = Prefix{addrAs<AddrT>(after->first), after->second};
+  }
+  // The first entry at or after start that is also after afterPrefix
+  auto seek = [&](const Prefix& start) {
+    if (!afterPrefix || *afterPrefix < start) {
+      return nodes.lower_bound(start);
+    }
+    auto iter = nodes.lower_bound(*afterPrefix);
+    if (iter != nodes.end() && iter->first == *afterPrefix) {
+      ++iter;
+    }
+    return iter;
+  };
+
+  if (!within) {
+    for (auto iter = seek(Prefix{AddrT(), 0}); iter != nodes.end(); ++iter) {
+      if (!fn(*iter)) {
+        return false;
+      }
+    }
+    return true;
+  }
+  auto network = addrAs<AddrT>(within->first);
+  for (int mask = within->second; mask <= AddrT::bitCount(); ++mask) {
+    for (auto iter = seek(Prefix{network, static_cast<uint8_t>(mask)});
+         iter != nodes.end() && iter->first.mask == mask &&
+         iter->first.network.mask(within->second) == network;
+         ++iter) {
+      if (!fn(*iter)) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+/*
+ * Call fn on the routes of rib that match filter, going through the rib's
+ * client index when filtering by client.
+ */
+template <typename AddrT, typename Fn>
+bool walkRibRoutes(
+    const RouteTableRib<AddrT>& rib,
+    const RouteFilter& filter,
+    const folly::Optional<folly::CIDRNetwork>& within,
+    const folly::Optional<folly::CIDRNetwork>& after,
+    Fn&& fn) {
+  if (filter.__isset.clientId) {
+    auto prefixes = rib.getClientPrefixesIf(ClientID(filter.clientId));
+    if (!prefixes) {
+      return true;
+    }
+    return walkPrefixes<AddrT>(*prefixes, within, after,
+                               [&](const auto& entry) {
+      return fn(*rib.exactMatch(entry.first));
+    });
+  }
+  return walkPrefixes<AddrT>(rib.routes()->getAllNodes(), within, after,
+                             [&](const auto& entry) {
+    return fn(*entry.second);
+  });
+}
+
+/*
+ * Call fn(vrf, route) on each route in tables that matches filter and comes
+ * after the cursor, VRF by VRF and v4 before v6, until fn returns false.
+ * The routes are visited in place, without copying any of them.
+ */
+template <typename Fn>
+void walkFilteredRoutes(
+    const RouteTableMap& tables,
+    const RouteFilter& filter,
+    const folly::Optional<RouteCursor>& after,
+    Fn&& fn) {
+  folly::Optional<folly::CIDRNetwork> within;
+  if (filter.__isset.within) {
+    auto addr = toIPAddress(filter.within.ip);
+    auto length = filter.within.prefixLength;
+    if (length < 0 || length > addr.bitCount()) {
+      throw FbossError("invalid prefix length ", length, " for ", addr);
+    }
+    within = folly::CIDRNetwork(addr.mask(length), length);
+  }
+  for (const auto& table : tables) {
+    auto vrf = table->getID();
+    if (filter.__isset.vrfId && vrf != RouterID(filter.vrfId)) {
+      continue;
+    }
+    folly::Optional<folly::CIDRNetwork> start;
+    if (after) {
+      if (vrf < after->vrf) {
+        continue;
+      }
+      if (vrf == after->vrf) {
+        start = after->prefix;
+      }
+    }
+    bool startInV6 = start && start->first.isV6();
+    auto visit = [&](const auto& route) { return fn(vrf, route); };
+    if (!startInV6 && (!within || within->first.isV4()) &&
+        !walkRibRoutes(*table->getRibV4(), filter, within, start, visit)) {
+      return;
+    }
+    if ((!within || within->first.isV6()) &&
+        !walkRibRoutes(
+            *table->getRibV6(),
+            filter,
+            within,
+            startInV6 ? start : folly::none,
+            visit)) {
+      return;
+    }
+  }
+}
+} // anonymous namespace
+
+ThriftHandler::ThriftHandler(SwSwitch* sw)
+    : FacebookBase2("FBOSS"),
+      sw_(sw),
+      highresScheduler_([sw](HighresSamplerList* samplers,
+                             const std::set<CounterRequest>& counters) {
+        return sw->getHighresSamplers(samplers, counters);
+      }) {
   sw->registerNeighborListener(
-    [=](const std::vector<std::string>& added,
-        const std::vector<std::string>& deleted) {
+    [=](const std::vector<folly::IPAddress>& addedIPs,
+        const std::vector<folly::IPAddress>& deletedIPs) {
+      std::vector<std::string> added;
+      std::vector<std::string> deleted;
+      for (const auto& ip : addedIPs) {
+        added.push_back(ip.str());
+      }
+      for (const auto& ip : deletedIPs) {
+        deleted.push_back(ip.str());
+      }
       for (auto& listener : listeners_.accessAllThreads()) {
         XLOG(INFO) << "Sending notification to bgpD";
         auto listenerPtr = &listener;
@@ -155,6 +481,24 @@ ThriftHandler::ThriftHandler(SwSwitch* sw) : FacebookBase2("FBOSS"), sw_(sw) {
         });
       }
   });
+  sw->registerNeighborChangeListener(
+    [=](NeighborChangeStream::Batch batch) {
+      for (auto& listener : listeners_.accessAllThreads()) {
+        auto listenerPtr = &listener;
+        listener.eventBase->runInEventBaseThread([=] {
+          publishNeighborChanges(listenerPtr, batch);
+        });
+      }
+  });
+  sw->registerRouteChangeListener(
+    [=](RouteChangeStream::Batch batch) {
+      for (auto& listener : listeners_.accessAllThreads()) {
+        auto listenerPtr = &listener;
+        listener.eventBase->runInEventBaseThread([=] {
+          publishRouteChanges(listenerPtr, batch);
+        });
+      }
+  });
 }
 
 fb_status ThriftHandler::getStatus() {
@@ -196,9 +540,44 @@ void ThriftHandler::deleteUnicastRoute(
 
 void ThriftHandler::addUnicastRoutes(
     int16_t client, std::unique_ptr<std::vector<UnicastRoute>> routes) {
-  ensureConfigured("addUnicastRoutes");
-  ensureFibSynced("addUnicastRoutes");
-  updateUnicastRoutesImpl(client, routes, "addUnicastRoutes", false);
+  addUnicastRoutesAsync(client, RouterID(0), std::move(routes)).get();
+}
+
+void ThriftHandler::async_tm_addUnicastRoutes(
+    ThriftCallback<void> callback,
+    int16_t client,
+    std::unique_ptr<std::vector<UnicastRoute>> routes) {
+  completeWhenDone(
+      std::move(callback),
+      addUnicastRoutesAsync(client, RouterID(0), std::move(routes)));
+}
+
+void ThriftHandler::addUnicastRoutesInVrf(
+    int16_t client,
+    int32_t vrf,
+    std::unique_ptr<std::vector<UnicastRoute>> routes) {
+  addUnicastRoutesAsync(client, RouterID(vrf), std::move(routes)).get();
+}
+
+void ThriftHandler::async_tm_addUnicastRoutesInVrf(
+    ThriftCallback<void> callback,
+    int16_t client,
+    int32_t vrf,
+    std::unique_ptr<std::vector<UnicastRoute>> routes) {
+  completeWhenDone(
+      std::move(callback),
+      addUnicastRoutesAsync(client, RouterID(vrf), std::move(routes)));
+}
+
+folly::Future<folly::Unit> ThriftHandler::addUnicastRoutesAsync(
+    int16_t client, RouterID vrf,
+    std::unique_ptr<std::vector<UnicastRoute>> routes) {
+  return folly::makeFutureWith([&] {
+    ensureConfigured("addUnicastRoutes");
+    ensureFibSynced("addUnicastRoutes");
+    return updateUnicastRoutesImpl(
+        client, vrf, std::move(routes), "addUnicastRoutes", false);
+  });
 }
 
 void ThriftHandler::getProductInfo(ProductInfo& productInfo) {
@@ -207,24 +586,238 @@ void ThriftHandler::getProductInfo(ProductInfo& productInfo) {
 
 void ThriftHandler::deleteUnicastRoutes(
     int16_t client, std::unique_ptr<std::vector<IpPrefix>> prefixes) {
-  ensureConfigured("deleteUnicastRoutes");
-  ensureFibSynced("deleteUnicastRoutes");
-  RouteUpdateStats stats(sw_, "Delete", prefixes->size());
-  // Perform the update
+  deleteUnicastRoutesAsync(client, RouterID(0), std::move(prefixes)).get();
+}
+
+void ThriftHandler::async_tm_deleteUnicastRoutes(
+    ThriftCallback<void> callback,
+    int16_t client,
+    std::unique_ptr<std::vector<IpPrefix>> prefixes) {
+  completeWhenDone(
+      std::move(callback),
+      deleteUnicastRoutesAsync(client, RouterID(0), std::move(prefixes)));
+}
+
+void ThriftHandler::deleteUnicastRoutesInVrf(
+    int16_t client,
+    int32_t vrf,
+    std::unique_ptr<std::vector<IpPrefix>> prefixes) {
+  deleteUnicastRoutesAsync(client, RouterID(vrf), std::move(prefixes)).get();
+}
+
+void ThriftHandler::async_tm_deleteUnicastRoutesInVrf(
+    ThriftCallback<void> callback,
+    int16_t client,
+    int32_t vrf,
+    std::unique_ptr<std::vector<IpPrefix>> prefixes) {
+  completeWhenDone(
+      std::move(callback),
+      deleteUnicastRoutesAsync(client, RouterID(vrf), std::move(prefixes)));
+}
+
+folly::Future<folly::Unit> ThriftHandler::deleteUnicastRoutesAsync(
+    int16_t client, RouterID vrf,
+    std::unique_ptr<std::vector<IpPrefix>> prefixes) {
+  return folly::makeFutureWith([&] {
+    ensureConfigured("deleteUnicastRoutes");
+    ensureFibSynced("deleteUnicastRoutes");
+    auto stats =
+        std::make_shared<RouteUpdateStats>(sw_, "Delete", prefixes->size());
+    if (auto recorder = sw_->getStateUpdateRecorder()) {
+      recorder->recordDeletedRoutes(client, vrf, *prefixes);
+    }
+    // The update runs after we return, so it owns the prefixes.
+    std::shared_ptr<const std::vector<IpPrefix>> toDelete(std::move(prefixes));
+    auto updateFn = [this, client, vrf, toDelete](
+                        const shared_ptr<SwitchState>& state) {
+      RouteUpdater updater(state->getRouteTables());
+      for (const auto& prefix : *toDelete) {
+        auto network = toIPAddress(prefix.ip);
+        auto mask = static_cast<uint8_t>(prefix.prefixLength);
+        if (network.isV4()) {
+          sw_->stats()->delRouteV4();
+        } else {
+          sw_->stats()->delRouteV6();
+        }
+        updater.delRoute(vrf, network, mask, ClientID(client));
+      }
+      auto newRt = updater.updateDone();
+      sw_->stats()->routeResolve(updater.getResolveDuration());
+      if (!newRt) {
+        return shared_ptr<SwitchState>();
+      }
+      auto newState = state->clone();
+      newState->resetRouteTables(std::move(newRt));
+      return newState;
+    };
+    return sw_
+        ->updateStateAsync(
+            "delete unicast route", updateFn, StateUpdateClass::ROUTE)
+        .ensure([stats] {});
+  });
+}
+
+void ThriftHandler::syncFib(
+    int16_t client, std::unique_ptr<std::vector<UnicastRoute>> routes) {
+  syncFibAsync(client, RouterID(0), std::move(routes)).get();
+}
+
+void ThriftHandler::async_tm_syncFib(
+    ThriftCallback<void> callback,
+    int16_t client,
+    std::unique_ptr<std::vector<UnicastRoute>> routes) {
+  completeWhenDone(
+      std::move(callback),
+      syncFibAsync(client, RouterID(0), std::move(routes)));
+}
+
+void ThriftHandler::syncFibInVrf(
+    int16_t client,
+    int32_t vrf,
+    std::unique_ptr<std::vector<UnicastRoute>> routes) {
+  syncFibAsync(client, RouterID(vrf), std::move(routes)).get();
+}
+
+void ThriftHandler::async_tm_syncFibInVrf(
+    ThriftCallback<void> callback,
+    int16_t client,
+    int32_t vrf,
+    std::unique_ptr<std::vector<UnicastRoute>> routes) {
+  completeWhenDone(
+      std::move(callback),
+      syncFibAsync(client, RouterID(vrf), std::move(routes)));
+}
+
+folly::Future<folly::Unit> ThriftHandler::syncFibAsync(
+    int16_t client, RouterID vrf,
+    std::unique_ptr<std::vector<UnicastRoute>> routes) {
+  return folly::makeFutureWith([&] {
+    ensureConfigured("syncFib");
+    return updateUnicastRoutesImpl(
+        client, vrf, std::move(routes), "syncFib", true);
+  }).then([this] {
+    if (!sw_->isFibSynced()) {
+      sw_->fibSynced();
+    }
+  });
+}
+
+int64_t ThriftHandler::beginRouteTransaction(int16_t client) {
+  ensureConfigured("beginRouteTransaction");
+  ensureFibSynced("beginRouteTransaction");
+  auto reqCtx = getConnectionContext();
+  auto txn = std::make_shared<RouteTransaction>(
+      client,
+      reqCtx ? reqCtx->getConnectionContext() : nullptr,
+      sw_->getState()->getRouteTables());
+  auto id = nextRouteTransactionId_++;
+  {
+    auto transactions = routeTransactions_.wlock();
+    expireRouteTransactions(&*transactions);
+    if (transactions->size() >=
+        static_cast<size_t>(FLAGS_max_route_transactions)) {
+      throw FbossError("too many open route transactions");
+    }
+    transactions->emplace(id, std::move(txn));
+  }
+  XLOG(DBG2) << "Began route transaction " << id << " for client " << client;
+  return id;
+}
+
+std::shared_ptr<RouteTransaction> ThriftHandler::getRouteTransaction(
+    int64_t id, bool remove) {
+  auto transactions = routeTransactions_.wlock();
+  expireRouteTransactions(&*transactions);
+  auto it = transactions->find(id);
+  if (it == transactions->end()) {
+    throw FbossError("no open route transaction ", id);
+  }
+  auto txn = it->second;
+  if (remove) {
+    transactions->erase(it);
+  } else {
+    txn->lastUsed = std::chrono::steady_clock::now();
+  }
+  return txn;
+}
+
+void ThriftHandler::expireRouteTransactions(RouteTransactions* transactions) {
+  if (FLAGS_route_transaction_idle_timeout_ms <= 0) {
+    return;
+  }
+  auto expired = std::chrono::steady_clock::now() -
+      std::chrono::milliseconds(FLAGS_route_transaction_idle_timeout_ms);
+  for (auto it = transactions->begin(); it != transactions->end();) {
+    if (it->second->lastUsed < expired) {
+      XLOG(WARNING) << "Aborting route transaction " << it->first
+                    << " of client " << it->second->client
+                    << ", which was idle for too long";
+      it = transactions->erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
+void ThriftHandler::addUnicastRoutesInTransaction(
+    int64_t id, std::unique_ptr<std::vector<UnicastRoute>> routes) {
+  ensureConfigured("addUnicastRoutesInTransaction");
+  auto txn = getRouteTransaction(id, false);
+  std::lock_guard<std::mutex> guard(txn->lock);
+  // Staging only touches the transaction's own copy of the route tables, so
+  // the chunk doesn't hold up the update thread.
+  RouterID routerId = RouterID(0); // TODO, default vrf for now
+  auto clientIdToAdmin = sw_->clientIdToAdminDistance(txn->client);
+  RouteNextHopSet nexthops;
+  for (const auto& route : *routes) {
+    auto network = addUnicastRoute(
+        txn->updater.get(), routerId, txn->client, clientIdToAdmin, route,
+        &nexthops);
+    if (network.isV4()) {
+      sw_->stats()->addRouteV4();
+    } else {
+      sw_->stats()->addRouteV6();
+    }
+  }
+  txn->routes.insert(txn->routes.end(),
+                     std::make_move_iterator(routes->begin()),
+                     std::make_move_iterator(routes->end()));
+}
+
+void ThriftHandler::commitRouteTransaction(int64_t id) {
+  ensureConfigured("commitRouteTransaction");
+  auto txn = getRouteTransaction(id, true);
+  std::lock_guard<std::mutex> guard(txn->lock);
+  RouteUpdateStats stats(sw_, "commitRouteTransaction", txn->routes.size());
+  // Replayed as the one batch the transaction adds
+  if (auto recorder = sw_->getStateUpdateRecorder()) {
+    recorder->recordRoutes(
+        StateUpdateRecordType::ADD_ROUTES, txn->client, RouterID(0),
+        txn->routes);
+  }
+
+  // Resolve the staged routes here rather than on the update thread.
+  auto staged = txn->updater->updateDone();
+  sw_->stats()->routeResolve(txn->updater->getResolveDuration());
   auto updateFn = [&](const shared_ptr<SwitchState>& state) {
-    RouteUpdater updater(state->getRouteTables());
-    RouterID routerId = RouterID(0); // TODO, default vrf for now
-    for (const auto& prefix : *prefixes) {
-      auto network = toIPAddress(prefix.ip);
-      auto mask = static_cast<uint8_t>(prefix.prefixLength);
-      if (network.isV4()) {
-        sw_->stats()->delRouteV4();
-      } else {
-        sw_->stats()->delRouteV6();
+    auto newRt = staged;
+    if (state->getRouteTables() != txn->base) {
+      // The route tables changed since the transaction began; add the staged
+      // routes to the current ones instead.
+      XLOG(DBG2) << "Route tables changed during route transaction " << id
+                 << ", re-adding " << txn->routes.size() << " routes";
+      RouteUpdater updater(state->getRouteTables());
+      RouterID routerId = RouterID(0); // TODO, default vrf for now
+      auto clientIdToAdmin = sw_->clientIdToAdminDistance(txn->client);
+      RouteNextHopSet nexthops;
+      for (const auto& route : txn->routes) {
+        addUnicastRoute(
+            &updater, routerId, txn->client, clientIdToAdmin, route,
+            &nexthops);
       }
-      updater.delRoute(routerId, network, mask, ClientID(client));
+      newRt = updater.updateDone();
+      sw_->stats()->routeResolve(updater.getResolveDuration());
     }
-    auto newRt = updater.updateDone();
     if (!newRt) {
       return shared_ptr<SwitchState>();
     }
@@ -232,56 +825,49 @@ void ThriftHandler::deleteUnicastRoutes(
     newState->resetRouteTables(std::move(newRt));
     return newState;
   };
-  sw_->updateStateBlocking("delete unicast route", updateFn);
+  sw_->updateStateBlocking(
+      "commit route transaction", updateFn, StateUpdateClass::ROUTE);
 }
 
-void ThriftHandler::syncFib(
-    int16_t client, std::unique_ptr<std::vector<UnicastRoute>> routes) {
-  ensureConfigured("syncFib");
-  updateUnicastRoutesImpl(client, routes, "syncFib", true);
-  if (!sw_->isFibSynced()) {
-    sw_->fibSynced();
-  }
+void ThriftHandler::abortRouteTransaction(int64_t id) {
+  auto txn = getRouteTransaction(id, true);
+  XLOG(DBG2) << "Aborted route transaction " << id << " with "
+             << txn->routes.size() << " staged routes";
 }
 
-void ThriftHandler::updateUnicastRoutesImpl(
-  int16_t client, const std::unique_ptr<std::vector<UnicastRoute>>& routes,
+folly::Future<folly::Unit> ThriftHandler::updateUnicastRoutesImpl(
+  int16_t client, RouterID vrf,
+  std::unique_ptr<std::vector<UnicastRoute>> routes,
   const std::string& updType, bool sync) {
-  RouteUpdateStats stats(sw_, updType, routes->size());
+  auto stats = std::make_shared<RouteUpdateStats>(
+      sw_, updType, routes->size());
+  if (auto recorder = sw_->getStateUpdateRecorder()) {
+    recorder->recordRoutes(
+        sync ? StateUpdateRecordType::SYNC_FIB
+             : StateUpdateRecordType::ADD_ROUTES,
+        client, vrf, *routes);
+  }
 
-  // Note that we capture routes by reference here, since it is a unique_ptr.
-  // This is safe since we use updateStateBlocking(), so routes will still
-  // be valid in our scope when updateFn() is called.
-  // We could use folly::MoveWrapper if we did need to capture routes by value.
-  auto updateFn = [&](const shared_ptr<SwitchState>& state) {
+  // The update runs after we return, so it owns the routes.
+  std::shared_ptr<const std::vector<UnicastRoute>> toAdd(std::move(routes));
+  auto updateFn = [this, client, vrf, toAdd, sync](
+                      const shared_ptr<SwitchState>& state) {
     // create an update object starting from empty
     RouteUpdater updater(state->getRouteTables());
-    RouterID routerId = RouterID(0); // TODO, default vrf for now
     auto clientIdToAdmin = sw_->clientIdToAdminDistance(client);
+    // When syncing, only the client's routes that are not in the new list
+    // are deleted, so routes that did not change are left untouched.
+    std::vector<folly::CIDRNetwork> syncedPrefixes;
     if (sync) {
-      updater.removeAllRoutesForClient(routerId, ClientID(client));
+      syncedPrefixes.reserve(toAdd->size());
     }
-    for (const auto& route : *routes) {
-      folly::IPAddress network = toIPAddress(route.dest.ip);
-      uint8_t mask = static_cast<uint8_t>(route.dest.prefixLength);
-      auto adminDistance = route.__isset.adminDistance ? route.adminDistance :
-        clientIdToAdmin;
-      std::vector<NextHopThrift> nhts;
-      if (route.nextHops.empty() && !route.nextHopAddrs.empty()) {
-        nhts = util::thriftNextHopsFromAddresses(route.nextHopAddrs);
-      } else {
-        nhts = route.nextHops;
-      }
-      RouteNextHopSet nexthops = util::toRouteNextHopSet(nhts);
-      if (nexthops.size()) {
-        updater.addRoute(routerId, network, mask, ClientID(client),
-                         RouteNextHopEntry(std::move(nexthops), adminDistance));
-      } else {
-        XLOG(DBG3) << "Blackhole route:" << network << "/"
-                   << static_cast<int>(mask);
-        updater.addRoute(routerId, network, mask, ClientID(client),
-                         RouteNextHopEntry(RouteForwardAction::DROP,
-                           adminDistance));
+    RouteNextHopSet nexthops;
+    for (const auto& route : *toAdd) {
+      auto network = addUnicastRoute(
+          &updater, vrf, client, clientIdToAdmin, route, &nexthops);
+      if (sync) {
+        syncedPrefixes.emplace_back(
+            network, static_cast<uint8_t>(route.dest.prefixLength));
       }
       if (network.isV4()) {
         sw_->stats()->addRouteV4();
@@ -289,7 +875,12 @@ void ThriftHandler::updateUnicastRoutesImpl(
         sw_->stats()->addRouteV6();
       }
     }
+    if (sync) {
+      updater.removeStaleRoutesForClient(
+          vrf, ClientID(client), syncedPrefixes);
+    }
     auto newRt = updater.updateDone();
+    sw_->stats()->routeResolve(updater.getResolveDuration());
     if (!newRt) {
       return shared_ptr<SwitchState>();
     }
@@ -297,7 +888,8 @@ void ThriftHandler::updateUnicastRoutesImpl(
     newState->resetRouteTables(std::move(newRt));
     return newState;
   };
-  sw_->updateStateBlocking(updType, updateFn);
+  return sw_->updateStateAsync(updType, updateFn, StateUpdateClass::ROUTE)
+      .ensure([stats] {});
 }
 
 static void populateInterfaceDetail(InterfaceDetail& interfaceDetail,
@@ -362,6 +954,18 @@ void ThriftHandler::getL2Table(std::vector<L2EntryThrift>& l2Table) {
   XLOG(DBG6) << "L2 Table size:" << l2Table.size();
 }
 
+void ThriftHandler::getL2TablePage(
+    L2TablePage& page,
+    std::unique_ptr<L2TableQuery> query,
+    std::unique_ptr<std::string> cursor,
+    int32_t maxEntries) {
+  ensureConfigured();
+  if (maxEntries <= 0 || maxEntries > FLAGS_max_l2_table_page_size) {
+    maxEntries = FLAGS_max_l2_table_page_size;
+  }
+  sw_->getHw()->fetchL2TablePage(*query, *cursor, maxEntries, &page);
+}
+
 LacpPortRateThrift ThriftHandler::fromLacpPortRate(cfg::LacpPortRate rate) {
   switch (rate) {
     case cfg::LacpPortRate::SLOW:
@@ -487,9 +1091,23 @@ void ThriftHandler::fillPortStats(PortInfoThrift& portInfo, int numPortQs) {
   }
 }
 
+bool ThriftHandler::copyPortStats(
+    PortInfoThrift& portInfo,
+    const PortStatsSnapshot::Snapshot& portStats) {
+  auto it = portStats.find(PortID(portInfo.portId));
+  if (it == portStats.end() ||
+      it->second.output.unicast.size() != portInfo.portQueues.size()) {
+    return false;
+  }
+  portInfo.input = it->second.input;
+  portInfo.output = it->second.output;
+  return true;
+}
+
 void ThriftHandler::getPortInfoHelper(
     PortInfoThrift& portInfo,
-    const std::shared_ptr<Port> port) {
+    const std::shared_ptr<Port> port,
+    const PortStatsSnapshot::Snapshot& portStats) {
   portInfo.portId = port->getID();
   portInfo.name = port->getName();
   portInfo.description = port->getDescription();
@@ -511,6 +1129,10 @@ void ThriftHandler::getPortInfoHelper(
       pq.reservedBytes = queue->getReservedBytes().value();
       pq.__isset.reservedBytes = true;
     }
+    if (queue->getSharedBytes()) {
+      pq.sharedBytes = queue->getSharedBytes().value();
+      pq.__isset.sharedBytes = true;
+    }
     if (queue->getScalingFactor()) {
       pq.scalingFactor = cfg::_MMUScalingFactor_VALUES_TO_NAMES.find(
           queue->getScalingFactor().value())->second;
@@ -548,7 +1170,9 @@ void ThriftHandler::getPortInfoHelper(
   portInfo.txPause = pause.tx;
   portInfo.rxPause = pause.rx;
 
-  fillPortStats(portInfo, portInfo.portQueues.size());
+  if (!copyPortStats(portInfo, portStats)) {
+    fillPortStats(portInfo, portInfo.portQueues.size());
+  }
 }
 
 void ThriftHandler::getPortInfo(PortInfoThrift &portInfo, int32_t portId) {
@@ -560,7 +1184,8 @@ void ThriftHandler::getPortInfo(PortInfoThrift &portInfo, int32_t portId) {
     throw FbossError("no such port ", portId);
   }
 
-  getPortInfoHelper(portInfo, port);
+  auto portStats = sw_->getPortStatsSnapshot()->get();
+  getPortInfoHelper(portInfo, port, *portStats);
 }
 
 void ThriftHandler::getAllPortInfo(map<int32_t, PortInfoThrift>& portInfoMap) {
@@ -569,10 +1194,13 @@ void ThriftHandler::getAllPortInfo(map<int32_t, PortInfoThrift>& portInfoMap) {
   // NOTE: important to take pointer to switch state before iterating over
   // list of ports
   std::shared_ptr<SwitchState> swState = sw_->getState();
+  // The counters of every port as of the last stats update, so that this
+  // doesn't look up each of their stats by name
+  auto portStats = sw_->getPortStatsSnapshot()->get();
   for (const auto& port : *(swState->getPorts())) {
     auto portId = port->getID();
     auto& portInfo = portInfoMap[portId];
-    getPortInfoHelper(portInfo, port);
+    getPortInfoHelper(portInfo, port, *portStats);
   }
 }
 
@@ -600,9 +1228,30 @@ void ThriftHandler::getCurrentStateJSON(
   if (!jsonPtr) {
     throw FbossError("Malformed JSON Pointer");
   }
-  auto swState = sw_->getState()->toFollyDynamic();
-  auto dyn = swState.get_ptr(jsonPtr.value());
-  ret = folly::json::serialize(*dyn, folly::json::serialization_opts{});
+  // Only serialize the part of the state that the pointer selects
+  auto cacheScope = sw_->serializationCacheScope();
+  auto dyn = sw_->getState()->toFollyDynamicAt(
+      jsonPtr->tokens(), 0, NodeBase::kAllEntries);
+  ret = folly::json::serialize(dyn, folly::json::serialization_opts{});
+}
+
+void ThriftHandler::getCurrentStateJSONPage(
+    std::string& ret,
+    std::unique_ptr<std::string> jsonPointerStr,
+    int64_t offset,
+    int32_t limit) {
+  ensureConfigured();
+  if (offset < 0 || limit < 0) {
+    throw FbossError("offset and limit must not be negative");
+  }
+  auto const jsonPtr = folly::json_pointer::try_parse(*jsonPointerStr);
+  if (!jsonPtr) {
+    throw FbossError("Malformed JSON Pointer");
+  }
+  auto cacheScope = sw_->serializationCacheScope();
+  auto dyn = sw_->getState()->toFollyDynamicAt(
+      jsonPtr->tokens(), offset, limit);
+  ret = folly::json::serialize(dyn, folly::json::serialization_opts{});
 }
 
 void ThriftHandler::patchCurrentStateJSON(
@@ -616,16 +1265,12 @@ void ThriftHandler::patchCurrentStateJSON(
   if (!jsonPtr) {
     throw FbossError("Malformed JSON Pointer");
   }
+  auto patch = folly::parseJson(*jsonPatchStr);
   // OK to capture by reference because the update call below is blocking
   auto updateFn = [&](const shared_ptr<SwitchState>& oldState) {
-    auto fullDynamic = oldState->toFollyDynamic();
-    auto* partialDynamic = fullDynamic.get_ptr(jsonPtr.value());
-    if (!partialDynamic) {
-      throw FbossError("JSON Pointer does not address proper object");
-    }
-    // mutates in place, i.e. modifies fullDynamic too
-    partialDynamic->merge_patch(folly::parseJson(*jsonPatchStr));
-    return SwitchState::fromFollyDynamic(fullDynamic);
+    // Only the node the pointer leads into is rebuilt, so the state delta
+    // (and the hardware update) is limited to what the patch touches
+    return oldState->applyJsonPatch(jsonPtr->tokens(), patch);
   };
   sw_->updateStateBlocking("JSON patch", std::move(updateFn));
 }
@@ -702,37 +1347,19 @@ void ThriftHandler::getRouteTableByClient(
     std::vector<UnicastRoute>& routes, int16_t client) {
   ensureConfigured();
   for (const auto& routeTable : (*sw_->getState()->getRouteTables())) {
-    for (const auto& ipv4 : *(routeTable->getRibV4()->routes())) {
-      auto entry = ipv4->getEntryForClient(ClientID(client));
-      if (not entry) {
-        continue;
-      }
-
-      UnicastRoute tempRoute;
-      tempRoute.dest.ip = toBinaryAddress(ipv4->prefix().network);
-      tempRoute.dest.prefixLength = ipv4->prefix().mask;
-      tempRoute.nextHops = util::fromRouteNextHopSet(entry->getNextHopSet());
-      for (const auto& nh : tempRoute.nextHops) {
-        tempRoute.nextHopAddrs.emplace_back(nh.address);
-      }
-      routes.emplace_back(std::move(tempRoute));
-    }
-
-    for (const auto& ipv6 : *(routeTable->getRibV6()->routes())) {
-      auto entry = ipv6->getEntryForClient(ClientID(client));
-      if (not entry) {
-        continue;
-      }
+    addClientRoutes(*routeTable->getRibV4(), ClientID(client), &routes);
+    addClientRoutes(*routeTable->getRibV6(), ClientID(client), &routes);
+  }
+}
 
-      UnicastRoute tempRoute;
-      tempRoute.dest.ip = toBinaryAddress(ipv6->prefix().network);
-      tempRoute.dest.prefixLength = ipv6->prefix().mask;
-      tempRoute.nextHops = util::fromRouteNextHopSet(entry->getNextHopSet());
-      for (const auto& nh : tempRoute.nextHops) {
-        tempRoute.nextHopAddrs.emplace_back(nh.address);
-      }
-      routes.emplace_back(std::move(tempRoute));
-    }
+void ThriftHandler::getRouteTableByClientInVrf(
+    std::vector<UnicastRoute>& routes, int16_t client, int32_t vrf) {
+  ensureConfigured();
+  auto routeTable =
+      sw_->getState()->getRouteTables()->getRouteTableIf(RouterID(vrf));
+  if (routeTable) {
+    addClientRoutes(*routeTable->getRibV4(), ClientID(client), &routes);
+    addClientRoutes(*routeTable->getRibV6(), ClientID(client), &routes);
   }
 }
 
@@ -750,6 +1377,70 @@ void ThriftHandler::getRouteTableDetails(std::vector<RouteDetails>& routes) {
   }
 }
 
+void ThriftHandler::getRouteTablePage(
+    RouteTablePage& page,
+    std::unique_ptr<RouteFilter> filter,
+    std::unique_ptr<std::string> cursor,
+    int32_t maxRoutes) {
+  ensureConfigured();
+  if (maxRoutes <= 0 || maxRoutes > FLAGS_max_route_table_page_size) {
+    maxRoutes = FLAGS_max_route_table_page_size;
+  }
+  auto after = parseRouteCursor(*cursor);
+  RouterID lastVrf{0};
+  folly::CIDRNetwork lastPrefix;
+  walkFilteredRoutes(
+      *sw_->getState()->getRouteTables(),
+      *filter,
+      after,
+      [&](RouterID vrf, const auto& route) {
+        if (page.routes.size() == static_cast<size_t>(maxRoutes)) {
+          // There is more, continue after the last route of this page
+          page.nextCursor = encodeRouteCursor(lastVrf, lastPrefix);
+          return false;
+        }
+        page.routes.emplace_back(route.toRouteDetails());
+        lastVrf = vrf;
+        lastPrefix = folly::CIDRNetwork(
+            route.prefix().network, route.prefix().mask);
+        return true;
+      });
+}
+
+int64_t ThriftHandler::getRouteCount(std::unique_ptr<RouteFilter> filter) {
+  ensureConfigured();
+  int64_t count = 0;
+  walkFilteredRoutes(
+      *sw_->getState()->getRouteTables(),
+      *filter,
+      folly::none,
+      [&](RouterID /*vrf*/, const auto& /*route*/) {
+        ++count;
+        return true;
+      });
+  return count;
+}
+
+void ThriftHandler::getRouteTableSummary(
+    std::vector<RouteTableSummary>& summaries) {
+  ensureConfigured();
+  for (const auto& routeTable : (*sw_->getState()->getRouteTables())) {
+    RouteTableSummary summary;
+    summary.vrfId = routeTable->getID();
+    summary.numV4Routes = routeTable->getRibV4()->size();
+    summary.numV6Routes = routeTable->getRibV6()->size();
+    for (const auto& client : routeTable->getRibV4()->getAllClientPrefixes()) {
+      summary.numRoutesByClient[static_cast<int16_t>(client.first)] +=
+          client.second.size();
+    }
+    for (const auto& client : routeTable->getRibV6()->getAllClientPrefixes()) {
+      summary.numRoutesByClient[static_cast<int16_t>(client.first)] +=
+          client.second.size();
+    }
+    summaries.emplace_back(std::move(summary));
+  }
+}
+
 void ThriftHandler::getIpRoute(UnicastRoute& route,
                                 std::unique_ptr<Address> addr, int32_t vrfId) {
   ensureConfigured();
@@ -855,11 +1546,60 @@ void ThriftHandler::getLldpNeighbors(vector<LinkNeighborThrift>& results) {
   auto neighbors = db->getNeighbors();
   results.reserve(neighbors.size());
   auto now = steady_clock::now();
-  for (const auto& entry : db->getNeighbors()) {
+  for (const auto& entry : neighbors) {
     results.push_back(thriftLinkNeighbor(entry, now));
   }
 }
 
+folly::Future<std::unique_ptr<LldpNeighborUpdates>>
+ThriftHandler::future_getLldpNeighborUpdates(
+    int64_t sinceSequence, int32_t maxWaitMs) {
+  ensureConfigured();
+  auto lldpMgr = sw_->getLldpMgr();
+  if (lldpMgr == nullptr) {
+    throw std::runtime_error("lldpMgr is not configured");
+  }
+
+  return lldpMgr->getDB()
+      ->getUpdates(
+          sinceSequence, std::chrono::milliseconds(std::max(maxWaitMs, 0)))
+      .then([](LinkNeighborDB::Updates&& updates) {
+        auto results = std::make_unique<LldpNeighborUpdates>();
+        results->sequence = updates.sequence;
+        results->resync = updates.resync;
+        auto now = steady_clock::now();
+        results->changed.reserve(updates.changed.size());
+        for (const auto& entry : updates.changed) {
+          results->changed.push_back(thriftLinkNeighbor(entry, now));
+        }
+        results->removed.reserve(updates.removed.size());
+        for (const auto& entry : updates.removed) {
+          results->removed.push_back(thriftLinkNeighbor(entry, now));
+        }
+        return results;
+      });
+}
+
+void ThriftHandler::getPuntTopTalkers(
+    vector<PuntTalkerThrift>& talkers,
+    int32_t count) {
+  ensureConfigured();
+  if (count < 0) {
+    throw FbossError("invalid top talker count: ", count);
+  }
+  for (const auto& talker : sw_->getPuntStats()->getTopTalkers(count)) {
+    PuntTalkerThrift entry;
+    entry.port = static_cast<uint16_t>(talker.port);
+    entry.cosQueue = talker.cosQueue;
+    entry.protocol = PuntStats::getProtocolName(talker.protocol);
+    entry.packets = talker.packets;
+    entry.bytes = talker.bytes;
+    entry.packetsPerSec = talker.packetsPerSec;
+    entry.bytesPerSec = talker.bytesPerSec;
+    talkers.push_back(std::move(entry));
+  }
+}
+
 void ThriftHandler::invokeNeighborListeners(ThreadLocalListener* listener,
                                              std::vector<std::string> added,
                                              std::vector<std::string> removed) {
@@ -882,29 +1622,218 @@ void ThriftHandler::invokeNeighborListeners(ThreadLocalListener* listener,
   }
 }
 
-void ThriftHandler::async_eb_registerForNeighborChanged(
-    ThriftCallback<void> cb) {
-  auto ctx = cb->getConnectionContext()->getConnectionContext();
-  auto client = ctx->getDuplexClient<NeighborListenerClientAsyncClient>();
+ThriftHandler::ThreadLocalListener* ThriftHandler::getThreadListener(
+    EventBase* eventBase) {
   auto info = listeners_.get();
-  CHECK(cb->getEventBase()->isInEventBaseThread());
+  CHECK(eventBase->isInEventBaseThread());
   if (!info) {
-    info = new ThreadLocalListener(cb->getEventBase());
+    info = new ThreadLocalListener(eventBase);
     listeners_.reset(info);
   }
-  DCHECK_EQ(info->eventBase, cb->getEventBase());
+  DCHECK_EQ(info->eventBase, eventBase);
   if (!info->eventBase) {
-    info->eventBase = cb->getEventBase();
+    info->eventBase = eventBase;
   }
+  return info;
+}
+
+void ThriftHandler::async_eb_registerForNeighborChanged(
+    ThriftCallback<void> cb) {
+  auto ctx = cb->getConnectionContext()->getConnectionContext();
+  auto client = ctx->getDuplexClient<NeighborListenerClientAsyncClient>();
+  auto info = getThreadListener(cb->getEventBase());
   info->clients.emplace(ctx, client);
   cb->done();
 }
 
+void ThriftHandler::async_eb_registerForNeighborChangeStream(
+    ThriftCallback<void> cb) {
+  auto ctx = cb->getConnectionContext()->getConnectionContext();
+  auto info = getThreadListener(cb->getEventBase());
+  StreamListener stream;
+  stream.client = ctx->getDuplexClient<NeighborListenerClientAsyncClient>();
+  auto peer = ctx->getPeerAddress();
+  stream.name = peer ? peer->describe() : "unknown";
+  info->streamClients[ctx] = std::move(stream);
+  cb->done();
+}
+
+int64_t ThriftHandler::getNeighborChangeSequence() {
+  return sw_->getNeighborChangeSequence();
+}
+
+void ThriftHandler::async_eb_registerForRouteChangeStream(
+    ThriftCallback<void> cb) {
+  auto ctx = cb->getConnectionContext()->getConnectionContext();
+  auto info = getThreadListener(cb->getEventBase());
+  // Batches published from here on reach this thread after the snapshot,
+  // and those already in it are skipped by the backlog
+  auto snapshot = sw_->getRouteChangeSnapshot();
+  RouteStreamListener stream;
+  stream.client = ctx->getDuplexClient<NeighborListenerClientAsyncClient>();
+  auto peer = ctx->getPeerAddress();
+  stream.name = peer ? peer->describe() : "unknown";
+  stream.backlog.subscribed(snapshot);
+  info->routeStreamClients[ctx] = std::move(stream);
+  cb->done();
+  sendRouteChanges(info, ctx, std::move(snapshot));
+}
+
+int64_t ThriftHandler::getRouteChangeGeneration() {
+  return sw_->getRouteChangeGeneration();
+}
+
+void ThriftHandler::publishNeighborChanges(
+    ThreadLocalListener* listener, NeighborChangeStream::Batch batch) {
+  for (auto it = listener->streamClients.begin();
+       it != listener->streamClients.end();) {
+    auto& stream = it->second;
+    if (stream.broken) {
+      clearStreamListenerStats(stream);
+      it = listener->streamClients.erase(it);
+      continue;
+    }
+    auto dropped = stream.backlog.getDropped();
+    auto toSend = stream.backlog.published(batch);
+    if (stream.backlog.getDropped() != dropped) {
+      sw_->stats()->neighborChangesDropped(
+          stream.backlog.getDropped() - dropped);
+    }
+    publishStreamListenerStats(stream);
+    if (toSend) {
+      sendNeighborChanges(listener, it->first, std::move(toSend));
+    }
+    ++it;
+  }
+}
+
+void ThriftHandler::sendNeighborChanges(
+    ThreadLocalListener* listener,
+    const TConnectionContext* ctx,
+    NeighborChangeStream::Batch batch) {
+  auto sequence = batch->sequence;
+  auto clientDone = [=](ClientReceiveState&& state) {
+    // The listener may have been removed while the batch was outstanding
+    auto it = listener->streamClients.find(ctx);
+    if (it == listener->streamClients.end()) {
+      return;
+    }
+    auto& stream = it->second;
+    try {
+      NeighborListenerClientAsyncClient::recv_neighborChangesBatched(state);
+    } catch (const std::exception& ex) {
+      XLOG(ERR) << "Exception in neighbor change listener " << stream.name
+                << ": " << ex.what();
+      stream.broken = true;
+      return;
+    }
+    auto next = stream.backlog.acked(sequence);
+    publishStreamListenerStats(stream);
+    if (next) {
+      sendNeighborChanges(listener, ctx, std::move(next));
+    }
+  };
+  listener->streamClients.at(ctx).client->neighborChangesBatched(
+      clientDone, *batch);
+}
+
+void ThriftHandler::publishStreamListenerStats(const StreamListener& stream) {
+  auto prefix = folly::to<std::string>("neighbor_changes.", stream.name);
+  fbData->setCounter(prefix + ".lag", stream.backlog.getLag());
+  fbData->setCounter(prefix + ".dropped", stream.backlog.getDropped());
+  fbData->setCounter(prefix + ".in_flight", stream.backlog.getInFlight());
+}
+
+void ThriftHandler::clearStreamListenerStats(const StreamListener& stream) {
+  auto prefix = folly::to<std::string>("neighbor_changes.", stream.name);
+  fbData->clearCounter(prefix + ".lag");
+  fbData->clearCounter(prefix + ".dropped");
+  fbData->clearCounter(prefix + ".in_flight");
+}
+
+void ThriftHandler::publishRouteChanges(
+    ThreadLocalListener* listener, RouteChangeStream::Batch batch) {
+  for (auto it = listener->routeStreamClients.begin();
+       it != listener->routeStreamClients.end();) {
+    auto& stream = it->second;
+    if (stream.broken) {
+      clearStreamListenerStats(stream);
+      it = listener->routeStreamClients.erase(it);
+      continue;
+    }
+    auto dropped = stream.backlog.getDropped();
+    auto toSend = stream.backlog.published(batch);
+    if (stream.backlog.getDropped() != dropped) {
+      sw_->stats()->routeChangesDropped(stream.backlog.getDropped() - dropped);
+    }
+    publishStreamListenerStats(stream);
+    if (toSend) {
+      sendRouteChanges(listener, it->first, std::move(toSend));
+    }
+    ++it;
+  }
+}
+
+void ThriftHandler::sendRouteChanges(
+    ThreadLocalListener* listener,
+    const TConnectionContext* ctx,
+    RouteChangeStream::Batch batch) {
+  auto generation = batch->changes.generation;
+  auto clientDone = [=](ClientReceiveState&& state) {
+    // The listener may have been removed while the batch was outstanding
+    auto it = listener->routeStreamClients.find(ctx);
+    if (it == listener->routeStreamClients.end()) {
+      return;
+    }
+    auto& stream = it->second;
+    try {
+      NeighborListenerClientAsyncClient::recv_routeChangesBatched(state);
+    } catch (const std::exception& ex) {
+      XLOG(ERR) << "Exception in route change listener " << stream.name
+                << ": " << ex.what();
+      stream.broken = true;
+      return;
+    }
+    auto next = stream.backlog.acked(generation);
+    publishStreamListenerStats(stream);
+    if (next) {
+      sendRouteChanges(listener, ctx, std::move(next));
+    }
+  };
+  listener->routeStreamClients.at(ctx).client->routeChangesBatched(
+      clientDone, batch->changes);
+}
+
+void ThriftHandler::publishStreamListenerStats(
+    const RouteStreamListener& stream) {
+  auto prefix = folly::to<std::string>("route_changes.", stream.name);
+  fbData->setCounter(prefix + ".lag", stream.backlog.getLag());
+  fbData->setCounter(prefix + ".dropped", stream.backlog.getDropped());
+  fbData->setCounter(prefix + ".in_flight", stream.backlog.getInFlight());
+}
+
+void ThriftHandler::clearStreamListenerStats(
+    const RouteStreamListener& stream) {
+  auto prefix = folly::to<std::string>("route_changes.", stream.name);
+  fbData->clearCounter(prefix + ".lag");
+  fbData->clearCounter(prefix + ".dropped");
+  fbData->clearCounter(prefix + ".in_flight");
+}
+
 void ThriftHandler::startPktCapture(unique_ptr<CaptureInfo> info) {
   ensureConfigured();
   auto* mgr = sw_->getCaptureMgr();
+  if (info->rotateBytes < 0 || info->rotateSeconds < 0 ||
+      info->maxFiles < 1) {
+    throw FbossError("invalid packet capture rotation");
+  }
+  PcapWriter::Options options;
+  options.format = info->pcapng ? PcapFormat::PCAPNG : PcapFormat::PCAP;
+  options.rotateBytes = info->rotateBytes;
+  options.rotateInterval = std::chrono::seconds(info->rotateSeconds);
+  options.maxFiles = info->maxFiles;
   auto capture = make_unique<PktCapture>(
-       info->name, info->maxPackets, info->direction, info->filter);
+       info->name, info->maxPackets, info->direction, info->filter, options);
   mgr->startCapture(std::move(capture));
 }
 
@@ -920,6 +1849,51 @@ void ThriftHandler::stopAllPktCaptures() {
   mgr->forgetAllCaptures();
 }
 
+void ThriftHandler::startPacketTraceSampling(
+    unique_ptr<PacketTraceSamplingConfig> config) {
+  ensureConfigured();
+  if (config->destinations.empty() || config->intervalMs <= 0 ||
+      config->flowsPerDestination <= 0 || config->maxSamples <= 0) {
+    throw FbossError("Invalid packet trace sampling config");
+  }
+  for (const auto& destination : config->destinations) {
+    try {
+      folly::IPAddress addr(destination);
+    } catch (const folly::IPAddressFormatException&) {
+      throw FbossError("Invalid packet trace destination ", destination);
+    }
+  }
+  if (!sw_->getState()->getPorts()->getPortIf(PortID(config->ingressPort))) {
+    throw FbossError("No such port ", config->ingressPort);
+  }
+  if (!sw_->getHw()->startPacketTraceSampling(*config)) {
+    throw FbossError("Packet trace sampling not supported");
+  }
+}
+
+void ThriftHandler::stopPacketTraceSampling() {
+  ensureConfigured();
+  sw_->getHw()->stopPacketTraceSampling();
+}
+
+void ThriftHandler::getPacketTraceSamples(
+    std::vector<PacketTraceSample>& samples) {
+  ensureConfigured();
+  samples = sw_->getHw()->getPacketTraceSamples();
+}
+
+void ThriftHandler::setSdkCallProfiling(bool enable) {
+  ensureConfigured();
+  if (!sw_->getHw()->setSdkCallProfiling(enable)) {
+    throw FbossError("SDK call profiling not supported");
+  }
+}
+
+void ThriftHandler::getSdkCallProfile(std::vector<SdkCallProfile>& profile) {
+  ensureConfigured();
+  profile = sw_->getHw()->getSdkCallProfile();
+}
+
 void ThriftHandler::startLoggingRouteUpdates(
     std::unique_ptr<RouteUpdateLoggingInfo> info) {
   auto* routeUpdateLogger = sw_->getRouteUpdateLogger();
@@ -960,6 +1934,73 @@ void ThriftHandler::getRouteUpdateLoggingTrackedPrefixes(
   }
 }
 
+void ThriftHandler::getStartupPhases(
+    std::vector<StartupPhaseThrift>& phases) {
+  for (const auto& phase : StartupProfiler::get()->getPhases()) {
+    StartupPhaseThrift info;
+    info.name = phase.name;
+    info.startUs = phase.start.count();
+    info.durationUs = phase.duration.count();
+    info.threadId = phase.threadId;
+    phases.push_back(std::move(info));
+  }
+}
+
+void ThriftHandler::getStartupTrace(std::string& trace) {
+  trace = folly::toJson(StartupProfiler::get()->toChromeTrace());
+}
+
+void ThriftHandler::getEventTrace(std::vector<EventTraceEntry>& trace) {
+  for (const auto& entry : EventTrace::dump()) {
+    EventTraceEntry info;
+    info.timestampUs = entry.timestampUs;
+    info.threadId = entry.threadId;
+    info.threadName = entry.threadName;
+    info.event = EventTrace::eventName(entry.event).str();
+    info.arg0 = entry.arg0;
+    info.arg1 = entry.arg1;
+    trace.push_back(std::move(info));
+  }
+}
+
+void ThriftHandler::setEventTracing(bool enable) {
+  EventTrace::setEnabled(enable);
+}
+
+void ThriftHandler::getWarmBootTimeline(
+    std::vector<WarmBootEventThrift>& timeline) {
+  for (const auto& event : WarmBootTimeline::get()->getEvents()) {
+    WarmBootEventThrift info;
+    info.name = WarmBootTimeline::eventName(event.first).str();
+    info.timestampUs = event.second;
+    timeline.push_back(std::move(info));
+  }
+}
+
+void ThriftHandler::getMemoryUsage(MemoryUsageThrift& usage) {
+  auto toThrift = [](const StateMemoryUsage::Usage& in) {
+    StateMemoryUsageThrift out;
+    out.nodes = in.nodes;
+    out.bytes = in.bytes;
+    out.sharedBytes = in.sharedBytes;
+    return out;
+  };
+  auto stateUsage = sw_->getStateMemoryUsage();
+  for (const auto& entry : stateUsage.byNodeType) {
+    usage.stateByNodeType[entry.first] = toThrift(entry.second);
+  }
+  for (const auto& entry : stateUsage.byVrf) {
+    usage.stateByVrf[static_cast<int32_t>(entry.first)] =
+        toThrift(entry.second);
+  }
+  usage.state = toThrift(stateUsage.total);
+  usage.stateRetainedBytes = stateUsage.retainedBytes;
+  usage.stateOlderGenerations = stateUsage.olderGenerations;
+  for (const auto& entry : MemoryAccount::totals()) {
+    usage.subsystems[entry.first] = entry.second;
+  }
+}
+
 void ThriftHandler::beginPacketDump(int32_t port) {
   // Client construction is serialized via SwSwitch event base
   sw_->constructPushClient(port);
@@ -1105,6 +2146,30 @@ void ThriftHandler::connectionDestroyed(TConnectionContext* ctx) {
   // Port status notifications
   if (listeners_) {
     listeners_->clients.erase(ctx);
+    auto stream = listeners_->streamClients.find(ctx);
+    if (stream != listeners_->streamClients.end()) {
+      clearStreamListenerStats(stream->second);
+      listeners_->streamClients.erase(stream);
+    }
+    auto routeStream = listeners_->routeStreamClients.find(ctx);
+    if (routeStream != listeners_->routeStreamClients.end()) {
+      clearStreamListenerStats(routeStream->second);
+      listeners_->routeStreamClients.erase(routeStream);
+    }
+  }
+
+  // Abort the route transactions the connection left open
+  SYNCHRONIZED(routeTransactions_) {
+    for (auto it = routeTransactions_.begin();
+         it != routeTransactions_.end();) {
+      if (it->second->connection == ctx) {
+        XLOG(DBG2) << "Aborted route transaction " << it->first
+                   << " of a closed connection";
+        it = routeTransactions_.erase(it);
+      } else {
+        ++it;
+      }
+    }
   }
 
   // If there is an ongoing high-resolution counter subscription, kill it. Don't
@@ -1142,19 +2207,17 @@ void ThriftHandler::async_tm_subscribeToCounters(
     auto sender = std::make_shared<SampleSender>(std::move(client), killSwitch,
                                                  eventBase, numCounters);
 
-    // Create the sample producer and send it on its way
+    // Create the sample producer and send it on its way.  The samplers were
+    // only needed to find the valid counters, the scheduler samples all
+    // subscriptions together.
+    std::vector<CounterRequest> counters;
+    for (const auto& sampler : *samplers) {
+      sampler->getCounters(&counters);
+    }
     auto producer = make_unique<SampleProducer>(
-        std::move(samplers), std::move(sender), std::move(killSwitch),
-        eventBase, *req.get(), numCounters);
-    auto wrappedProducer = folly::makeMoveWrapper(std::move(producer));
-    auto veryNice = req->veryNice;
-    std::thread producerThread([wrappedProducer, veryNice]() mutable {
-      if (veryNice) {
-        incNiceValue(20);
-      }
-      (*wrappedProducer)->produce();
-    });
-    producerThread.detach();
+        std::move(counters), std::move(sender), std::move(killSwitch),
+        eventBase, *req.get());
+    highresScheduler_.subscribe(std::move(producer), *req.get());
 
     callback->result(true);
   } else {
@@ -1174,6 +2237,44 @@ void ThriftHandler::reloadConfig() {
   return sw_->applyConfig("reload config initiated by thrift call");
 }
 
+void ThriftHandler::dryRunConfig(ConfigDryRunThrift& result) {
+  ensureConfigured("dryRunConfig");
+  result = sw_->dryRunConfig();
+}
+
+void ThriftHandler::simulateLoadBalancer(
+    HashDistribution& distribution,
+    int32_t loadBalancerID,
+    int32_t numMembers,
+    std::unique_ptr<std::vector<std::string>> packets) {
+  ensureConfigured("simulateLoadBalancer");
+  // The hash is 16 bits, so there is no use for bigger groups
+  if (numMembers <= 0 || numMembers > (1 << 16)) {
+    throw FbossError("invalid number of members ", numMembers);
+  }
+  auto loadBalancer = sw_->getState()->getLoadBalancers()->getLoadBalancerIf(
+      static_cast<LoadBalancerID>(loadBalancerID));
+  if (!loadBalancer) {
+    throw FbossError("LoadBalancer ", loadBalancerID, " not found");
+  }
+  HashSimulator simulator(*loadBalancer, numMembers);
+  for (const auto& packet : *packets) {
+    auto buf = IOBuf::wrapBufferAsValue(packet.data(), packet.size());
+    simulator.addPacket(&buf);
+  }
+  distribution = simulator.toThrift();
+}
+
+void ThriftHandler::getTopImbalancedGroups(
+    std::vector<GroupImbalanceThrift>& groups,
+    int32_t count) {
+  ensureConfigured("getTopImbalancedGroups");
+  if (count <= 0) {
+    return;
+  }
+  groups = sw_->getLoadImbalanceMonitor()->getTopImbalanced(count);
+}
+
 void ThriftHandler::getLacpPartnerPair(
     LacpPartnerPair& lacpPartnerPair,
     int32_t portID) {
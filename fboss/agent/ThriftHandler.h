@@ -9,6 +9,7 @@
  */
 #pragma once
 
+#include <atomic>
 #include <memory>
 #include <string>
 #include <vector>
@@ -18,12 +19,16 @@
 #include "fboss/agent/FbossError.h"
 #include "fboss/agent/types.h"
 #include "fboss/agent/HighresCounterSubscriptionHandler.h"
+#include "fboss/agent/NeighborChangeStream.h"
+#include "fboss/agent/PortStatsSnapshot.h"
+#include "fboss/agent/RouteChangeStream.h"
 #include "fboss/agent/if/gen-cpp2/FbossCtrl.h"
 #include "fboss/agent/if/gen-cpp2/NeighborListenerClient.h"
 #include "fboss/agent/gen-cpp2/switch_config_types.h"
 
 #include <folly/Synchronized.h>
 #include <folly/String.h>
+#include <folly/futures/Future.h>
 #include <thrift/lib/cpp/server/TServerEventHandler.h>
 #include <thrift/lib/cpp2/async/DuplexChannel.h>
 
@@ -31,6 +36,7 @@ namespace facebook { namespace fboss {
 
 class AggregatePort;
 class Port;
+struct RouteTransaction;
 class SwSwitch;
 class Vlan;
 
@@ -56,6 +62,12 @@ class ThriftHandler : virtual public FbossCtrlSvIf,
 
   void async_eb_registerForNeighborChanged(
       ThriftCallback<void> callback) override;
+  void async_eb_registerForNeighborChangeStream(
+      ThriftCallback<void> callback) override;
+  int64_t getNeighborChangeSequence() override;
+  void async_eb_registerForRouteChangeStream(
+      ThriftCallback<void> callback) override;
+  int64_t getRouteChangeGeneration() override;
 
   void flushCountersNow() override;
 
@@ -71,6 +83,57 @@ class ThriftHandler : virtual public FbossCtrlSvIf,
   void syncFib(
       int16_t client,
       std::unique_ptr<std::vector<UnicastRoute>> routes) override;
+  void addUnicastRoutesInVrf(
+      int16_t client,
+      int32_t vrf,
+      std::unique_ptr<std::vector<UnicastRoute>> routes) override;
+  void deleteUnicastRoutesInVrf(
+      int16_t client,
+      int32_t vrf,
+      std::unique_ptr<std::vector<IpPrefix>> prefixes) override;
+  void syncFibInVrf(
+      int16_t client,
+      int32_t vrf,
+      std::unique_ptr<std::vector<UnicastRoute>> routes) override;
+
+  /*
+   * Asynchronous versions of the route updates above.  These queue the
+   * state update and complete the callback once it has been applied, rather
+   * than holding on to a thrift worker thread while it is pending.
+   */
+  void async_tm_addUnicastRoutes(
+      ThriftCallback<void> callback,
+      int16_t client,
+      std::unique_ptr<std::vector<UnicastRoute>> routes) override;
+  void async_tm_deleteUnicastRoutes(
+      ThriftCallback<void> callback,
+      int16_t client,
+      std::unique_ptr<std::vector<IpPrefix>> prefixes) override;
+  void async_tm_syncFib(
+      ThriftCallback<void> callback,
+      int16_t client,
+      std::unique_ptr<std::vector<UnicastRoute>> routes) override;
+  void async_tm_addUnicastRoutesInVrf(
+      ThriftCallback<void> callback,
+      int16_t client,
+      int32_t vrf,
+      std::unique_ptr<std::vector<UnicastRoute>> routes) override;
+  void async_tm_deleteUnicastRoutesInVrf(
+      ThriftCallback<void> callback,
+      int16_t client,
+      int32_t vrf,
+      std::unique_ptr<std::vector<IpPrefix>> prefixes) override;
+  void async_tm_syncFibInVrf(
+      ThriftCallback<void> callback,
+      int16_t client,
+      int32_t vrf,
+      std::unique_ptr<std::vector<UnicastRoute>> routes) override;
+  int64_t beginRouteTransaction(int16_t client) override;
+  void addUnicastRoutesInTransaction(
+      int64_t id,
+      std::unique_ptr<std::vector<UnicastRoute>> routes) override;
+  void commitRouteTransaction(int64_t id) override;
+  void abortRouteTransaction(int64_t id) override;
 
   SwSwitch* getSw() const {
     return sw_;
@@ -109,7 +172,19 @@ class ThriftHandler : virtual public FbossCtrlSvIf,
   void getRouteTable(std::vector<UnicastRoute>& routeTable) override;
   void getRouteTableByClient(
       std::vector<UnicastRoute>& routeTable, int16_t clientId) override;
+  void getRouteTableByClientInVrf(
+      std::vector<UnicastRoute>& routeTable,
+      int16_t clientId,
+      int32_t vrf) override;
   void getRouteTableDetails(std::vector<RouteDetails>& routeTable) override;
+  void getRouteTablePage(
+      RouteTablePage& page,
+      std::unique_ptr<RouteFilter> filter,
+      std::unique_ptr<std::string> cursor,
+      int32_t maxRoutes) override;
+  int64_t getRouteCount(std::unique_ptr<RouteFilter> filter) override;
+  void getRouteTableSummary(
+      std::vector<RouteTableSummary>& summaries) override;
 
   void getPortStatus(std::map<int32_t, PortStatus>& status,
                      std::unique_ptr<std::vector<int32_t>> ports)
@@ -124,6 +199,11 @@ class ThriftHandler : virtual public FbossCtrlSvIf,
   void getRunningConfig(std::string& configStr) override;
   void getArpTable(std::vector<ArpEntryThrift>& arpTable) override;
   void getL2Table(std::vector<L2EntryThrift>& l2Table) override;
+  void getL2TablePage(
+      L2TablePage& page,
+      std::unique_ptr<L2TableQuery> query,
+      std::unique_ptr<std::string> cursor,
+      int32_t maxEntries) override;
   void getAggregatePort(
       AggregatePortThrift& aggregatePortThrift,
       int32_t aggregatePortIDThrift) override;
@@ -141,11 +221,25 @@ class ThriftHandler : virtual public FbossCtrlSvIf,
   BootType getBootType() override;
 
   void getLldpNeighbors(std::vector<LinkNeighborThrift>& results) override;
+  folly::Future<std::unique_ptr<LldpNeighborUpdates>>
+  future_getLldpNeighborUpdates(int64_t sinceSequence, int32_t maxWaitMs)
+      override;
+
+  void getPuntTopTalkers(
+      std::vector<PuntTalkerThrift>& talkers,
+      int32_t count) override;
 
   void startPktCapture(std::unique_ptr<CaptureInfo> info) override;
   void stopPktCapture(std::unique_ptr<std::string> name) override;
   void stopAllPktCaptures() override;
 
+  void startPacketTraceSampling(
+      std::unique_ptr<PacketTraceSamplingConfig> config) override;
+  void stopPacketTraceSampling() override;
+  void getPacketTraceSamples(std::vector<PacketTraceSample>& samples) override;
+  void setSdkCallProfiling(bool enable) override;
+  void getSdkCallProfile(std::vector<SdkCallProfile>& profile) override;
+
   void startLoggingRouteUpdates(
       std::unique_ptr<RouteUpdateLoggingInfo> info) override;
   void stopLoggingRouteUpdates(
@@ -155,6 +249,13 @@ class ThriftHandler : virtual public FbossCtrlSvIf,
       std::unique_ptr<std::string> identifier) override;
   void getRouteUpdateLoggingTrackedPrefixes(
       std::vector<RouteUpdateLoggingInfo>& infos) override;
+  void getStartupPhases(std::vector<StartupPhaseThrift>& phases) override;
+  void getStartupTrace(std::string& trace) override;
+  void getEventTrace(std::vector<EventTraceEntry>& trace) override;
+  void setEventTracing(bool enable) override;
+  void getWarmBootTimeline(
+      std::vector<WarmBootEventThrift>& timeline) override;
+  void getMemoryUsage(MemoryUsageThrift& usage) override;
   /*
    * Event handler for when a connection is destroyed.  When there is an ongoing
    * duplex connection, there may be other threads that depend on the connection
@@ -218,12 +319,46 @@ class ThriftHandler : virtual public FbossCtrlSvIf,
    */
   void reloadConfig() override;
 
+  /**
+   * Thrift call to check what reloading the config would do, without
+   * applying it.
+   */
+  void dryRunConfig(ConfigDryRunThrift& result) override;
+
+  /**
+   * Thrift call to predict how a LoadBalancer would spread the packets
+   * given over a group, using a software model of the hardware hash.
+   */
+  void simulateLoadBalancer(
+      HashDistribution& distribution,
+      int32_t loadBalancerID,
+      int32_t numMembers,
+      std::unique_ptr<std::vector<std::string>> packets) override;
+
+  /**
+   * Thrift call to get the ECMP groups and aggregate ports that spread
+   * their traffic least evenly in the last measurement interval.
+   */
+  void getTopImbalancedGroups(
+      std::vector<GroupImbalanceThrift>& groups,
+      int32_t count) override;
+
   /**
    * Serialize live running switch state at the path pointer by JSON Pointer
    */
   void getCurrentStateJSON(std::string& ret, std::unique_ptr<std::string>)
       override;
 
+  /**
+   * Serialize a page of the live running switch state at the path pointed by
+   * JSON Pointer
+   */
+  void getCurrentStateJSONPage(
+      std::string& ret,
+      std::unique_ptr<std::string> jsonPointerStr,
+      int64_t offset,
+      int32_t limit) override;
+
   /**
    * Patch live running switch state at path pointed by jsonPointer using the
    * JSON merge patch supplied in jsonPatch
@@ -254,11 +389,32 @@ class ThriftHandler : virtual public FbossCtrlSvIf,
     ensureFibSynced(folly::StringPiece(nullptr, nullptr));
   }
  private:
+  // A change stream subscriber, and the batches it is behind by
+  struct StreamListener {
+    std::shared_ptr<NeighborListenerClientAsyncClient> client;
+    std::string name;
+    NeighborChangeBacklog backlog;
+    bool broken{false};
+  };
+  // A route change stream subscriber
+  struct RouteStreamListener {
+    std::shared_ptr<NeighborListenerClientAsyncClient> client;
+    std::string name;
+    RouteChangeBacklog backlog;
+    bool broken{false};
+  };
+
   struct ThreadLocalListener {
     EventBase* eventBase;
     std::unordered_map<const apache::thrift::server::TConnectionContext*,
                        std::shared_ptr<NeighborListenerClientAsyncClient>>
         clients;
+    std::unordered_map<const apache::thrift::server::TConnectionContext*,
+                       StreamListener>
+        streamClients;
+    std::unordered_map<const apache::thrift::server::TConnectionContext*,
+                       RouteStreamListener>
+        routeStreamClients;
 
     explicit ThreadLocalListener(EventBase* eb) : eventBase(eb){};
   };
@@ -270,14 +426,58 @@ class ThriftHandler : virtual public FbossCtrlSvIf,
                                 std::vector<std::string> added,
                                 std::vector<std::string> deleted);
 
-  void updateUnicastRoutesImpl(
-    int16_t client, const std::unique_ptr<std::vector<UnicastRoute>>& routes,
+  ThreadLocalListener* getThreadListener(EventBase* eventBase);
+  void publishNeighborChanges(
+      ThreadLocalListener* listener, NeighborChangeStream::Batch batch);
+  void sendNeighborChanges(
+      ThreadLocalListener* listener,
+      const TConnectionContext* ctx,
+      NeighborChangeStream::Batch batch);
+  static void publishStreamListenerStats(const StreamListener& stream);
+  static void clearStreamListenerStats(const StreamListener& stream);
+  void publishRouteChanges(
+      ThreadLocalListener* listener, RouteChangeStream::Batch batch);
+  void sendRouteChanges(
+      ThreadLocalListener* listener,
+      const TConnectionContext* ctx,
+      RouteChangeStream::Batch batch);
+  static void publishStreamListenerStats(const RouteStreamListener& stream);
+  static void clearStreamListenerStats(const RouteStreamListener& stream);
+
+  folly::Future<folly::Unit> addUnicastRoutesAsync(
+      int16_t client, RouterID vrf,
+      std::unique_ptr<std::vector<UnicastRoute>> routes);
+  folly::Future<folly::Unit> deleteUnicastRoutesAsync(
+      int16_t client, RouterID vrf,
+      std::unique_ptr<std::vector<IpPrefix>> prefixes);
+  folly::Future<folly::Unit> syncFibAsync(
+      int16_t client, RouterID vrf,
+      std::unique_ptr<std::vector<UnicastRoute>> routes);
+  folly::Future<folly::Unit> updateUnicastRoutesImpl(
+    int16_t client, RouterID vrf,
+    std::unique_ptr<std::vector<UnicastRoute>> routes,
     const std::string& updType, bool sync);
+  using RouteTransactions =
+      std::map<int64_t, std::shared_ptr<RouteTransaction>>;
+  // Throws if there is no such open transaction
+  std::shared_ptr<RouteTransaction> getRouteTransaction(
+      int64_t id, bool remove);
+  // Abort the transactions idle for --route_transaction_idle_timeout_ms
+  static void expireRouteTransactions(RouteTransactions* transactions);
 
   void getPortInfoHelper(
       PortInfoThrift& portInfo,
-      const std::shared_ptr<Port> port);
+      const std::shared_ptr<Port> port,
+      const PortStatsSnapshot::Snapshot& portStats);
   void fillPortStats(PortInfoThrift& portInfo, int numPortQs = 0);
+  /*
+   * Copy the port's counters from the stats snapshot.  Returns false if they
+   * aren't in it yet, e.g. before the first stats update after the port or
+   * its queues were configured.
+   */
+  bool copyPortStats(
+      PortInfoThrift& portInfo,
+      const PortStatsSnapshot::Snapshot& portStats);
 
   Vlan* getVlan(int32_t vlanId);
   Vlan* getVlan(const std::string& vlanName);
@@ -318,5 +518,12 @@ class ThriftHandler : virtual public FbossCtrlSvIf,
   folly::Synchronized<
       std::unordered_map<const apache::thrift::server::TConnectionContext*,
                          std::shared_ptr<Signal>>> highresKillSwitches_;
+
+  // Samples the counters of every highres subscription
+  HighresSamplingScheduler highresScheduler_;
+
+  // Route transactions that have begun but not been committed or aborted
+  folly::Synchronized<RouteTransactions> routeTransactions_;
+  std::atomic<int64_t> nextRouteTransactionId_{1};
 };
 }} // facebook::fboss
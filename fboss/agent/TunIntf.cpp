@@ -22,16 +22,28 @@ extern "C" {
 #include <netlink/route/link.h>
 }
 
+#include <gflags/gflags.h>
+#include <folly/Conv.h>
 #include <folly/io/async/EventBase.h>
 #include <folly/io/async/EventHandler.h>
 #include <folly/logging/xlog.h>
+#include "common/stats/ServiceData.h"
 #include "fboss/agent/NlError.h"
+#include "fboss/agent/PacketRxPool.h"
 #include "fboss/agent/RxPacket.h"
 #include "fboss/agent/SwSwitch.h"
 #include "fboss/agent/SysError.h"
 #include "fboss/agent/TxPacket.h"
 #include "fboss/agent/packet/EthHdr.h"
 
+#include <algorithm>
+#include <atomic>
+
+DEFINE_int32(tun_queues, 0,
+             "The number of queues to open on each tun interface. 0 opens "
+             "one per packet RX worker thread");
+DECLARE_int32(rx_worker_threads);
+
 namespace facebook { namespace fboss {
 
 namespace {
@@ -59,17 +71,61 @@ struct iplink_req {
 #ifndef IN6_ADDR_GEN_MODE_NONE
 #define IN6_ADDR_GEN_MODE_NONE 1
 #endif
+// Available since kernel-3.8
+#ifndef IFF_MULTI_QUEUE
+#define IFF_MULTI_QUEUE 0x0100
+#endif
+
+size_t numQueuesWanted() {
+  if (FLAGS_tun_queues > 0) {
+    return FLAGS_tun_queues;
+  }
+  return std::max(FLAGS_rx_worker_threads, 1);
+}
 
 } // anonymous namespace
 
+/*
+ * A queue of a tun interface, with its fd and counters.  The counters are
+ * updated by the threads reading and writing the queue, and read when the
+ * stats are published.
+ */
+class TunIntf::Queue : public folly::EventHandler {
+ public:
+  Queue(TunIntf* intf, folly::EventBase* evb, int fd)
+      : folly::EventHandler(evb), intf_(intf), fd_(fd) {}
+
+  int fd() const {
+    return fd_;
+  }
+  void resetFD() {
+    fd_ = -1;
+  }
+
+  std::atomic<uint64_t> rxPackets{0};
+  std::atomic<uint64_t> rxSyscalls{0};
+  std::atomic<uint64_t> rxDropped{0};
+  std::atomic<uint64_t> txPackets{0};
+  std::atomic<uint64_t> txSyscalls{0};
+  std::atomic<uint64_t> txDropped{0};
+
+ private:
+  void handlerReady(uint16_t /*events*/) noexcept override {
+    intf_->readPackets(this);
+  }
+
+  TunIntf* intf_{nullptr};
+  int fd_{-1};
+};
+
 TunIntf::TunIntf(
     SwSwitch *sw,
     folly::EventBase *evb,
     InterfaceID ifID,
     int ifIndex,
     int mtu)
-    : folly::EventHandler(evb),
-      sw_(sw),
+    : sw_(sw),
+      evb_(evb),
       name_(util::createTunIntfName(ifID)),
       ifID_(ifID),
       ifIndex_(ifIndex),
@@ -77,9 +133,9 @@ TunIntf::TunIntf(
   DCHECK(sw) << "NULL pointer to SwSwitch.";
   DCHECK(evb) << "NULL pointer to EventBase";
 
-  openFD();
+  openFDs();
   SCOPE_FAIL {
-    closeFD();
+    closeFDs();
   };
 
   // XXX: Disabling mode on existing interface so that we end up removing
@@ -87,8 +143,8 @@ TunIntf::TunIntf(
   // next release onwards we will not need it
   disableIPv6AddrGenMode(ifIndex_);
 
-  XLOG(INFO) << "Added interface " << name_ << " with fd " << fd_ << " @ index "
-             << ifIndex_ << ", "
+  XLOG(INFO) << "Added interface " << name_ << " with " << queues_.size()
+             << " queues @ index " << ifIndex_ << ", "
              << "DOWN";
 }
 
@@ -99,8 +155,8 @@ TunIntf::TunIntf(
     bool status,
     const Interface::Addresses& addr,
     int mtu)
-    : folly::EventHandler(evb),
-      sw_(sw),
+    : sw_(sw),
+      evb_(evb),
       name_(util::createTunIntfName(ifID)),
       ifID_(ifID),
       status_(status),
@@ -109,15 +165,15 @@ TunIntf::TunIntf(
   DCHECK(sw) << "NULL pointer to SwSwitch.";
   DCHECK(evb) << "NULL pointer to EventBase";
 
-  // Open Tun interface FD for socket-IO
-  openFD();
+  // Open Tun interface FDs for socket-IO
+  openFDs();
   SCOPE_FAIL {
-    closeFD();
+    closeFDs();
   };
 
   // Make the Tun interface persistent, so that the network sessions from the
   // application (i.e. BGP)  will not be reset if controller restarts
-  auto ret = ioctl(fd_, TUNSETPERSIST, 1);
+  auto ret = ioctl(fd(), TUNSETPERSIST, 1);
   sysCheckError(ret, "Failed to set persist interface ", name_);
 
   // TODO: if needed, we can adjust send buffer size, TUNSETSNDBUF
@@ -147,82 +203,130 @@ TunIntf::TunIntf(
   // Disable v6 link-local address assignment on Tun interface
   disableIPv6AddrGenMode(ifIndex_);
 
-  XLOG(INFO) << "Created interface " << name_ << " with fd " << fd_
-             << " @ index " << ifIndex_ << ", " << (status ? "UP" : "DOWN");
+  XLOG(INFO) << "Created interface " << name_ << " with " << queues_.size()
+             << " queues @ index " << ifIndex_ << ", "
+             << (status ? "UP" : "DOWN");
 }
 
 TunIntf::~TunIntf() {
   stop();
 
   // We must have a valid fd to TunIntf
-  CHECK_NE(fd_, -1);
+  CHECK_NE(fd(), -1);
 
   // Delete interface if need be
   if (toDelete_) {
-    auto ret = ioctl(fd_, TUNSETPERSIST, 0);
+    auto ret = ioctl(fd(), TUNSETPERSIST, 0);
     sysLogError(ret, "Failed to unset persist interface ", name_);
   }
 
-  // Close FD. This will delete the interface if TUNSETPERSIST is not on
-  closeFD();
+  // Close FDs. This will delete the interface if TUNSETPERSIST is not on
+  closeFDs();
   XLOG(INFO) << (toDelete_ ? "Delete" : "Detach") << " interface " << name_;
 }
 
 void TunIntf::stop() {
-  unregisterHandler();
+  for (auto& queue : queues_) {
+    queue->unregisterHandler();
+  }
 }
 
 void TunIntf::start() {
-  if (fd_ != -1 && !isHandlerRegistered()) {
-    changeHandlerFD(fd_);
-    registerHandler(folly::EventHandler::READ | folly::EventHandler::PERSIST);
+  for (auto& queue : queues_) {
+    if (queue->fd() != -1 && !queue->isHandlerRegistered()) {
+      queue->changeHandlerFD(queue->fd());
+      queue->registerHandler(
+          folly::EventHandler::READ | folly::EventHandler::PERSIST);
+    }
   }
 }
 
-void TunIntf::openFD() {
-  fd_ = open(kTunDev.c_str(), O_RDWR);
-  sysCheckError(fd_, "Cannot open ", kTunDev.c_str());
+int TunIntf::fd() const {
+  return queues_.empty() ? -1 : queues_.front()->fd();
+}
+
+void TunIntf::openFDs() {
+  auto numQueues = numQueuesWanted();
   SCOPE_FAIL {
-    closeFD();
+    closeFDs();
   };
 
-  struct ifreq ifr;
-  memset(&ifr, 0, sizeof(ifr));
   // Flags: IFF_TUN   - TUN device (no Ethernet headers)
   //        IFF_NO_PI - Do not provide packet information
-  ifr.ifr_flags = IFF_TUN | IFF_NO_PI;
+  int flags = IFF_TUN | IFF_NO_PI;
+  if (numQueues > 1) {
+    if (!openQueue(flags | IFF_MULTI_QUEUE)) {
+      // An interface created with a single queue, such as by an older
+      // version of the agent, can only be attached to as it was created.
+      XLOG(WARN) << "Interface " << name_ << " does not support multiple "
+                 << "queues, using a single queue";
+      numQueues = 1;
+      openQueue(flags);
+    } else {
+      flags |= IFF_MULTI_QUEUE;
+    }
+  }
+  while (queues_.size() < numQueues) {
+    openQueue(flags);
+  }
+
+  // Set configured MTU
+  setMtu(mtu_);
+}
+
+bool TunIntf::openQueue(int ifFlags) {
+  int fd = open(kTunDev.c_str(), O_RDWR);
+  sysCheckError(fd, "Cannot open ", kTunDev.c_str());
+  SCOPE_FAIL {
+    close(fd);
+  };
+
+  struct ifreq ifr;
+  memset(&ifr, 0, sizeof(ifr));
+  ifr.ifr_flags = ifFlags;
   bzero(ifr.ifr_name, sizeof(ifr.ifr_name));
   size_t len = std::min(name_.size(), sizeof(ifr.ifr_name));
   memmove(ifr.ifr_name, name_.c_str(), len);
-  auto ret = ioctl(fd_, TUNSETIFF, (void *) &ifr);
+  auto ret = ioctl(fd, TUNSETIFF, (void *) &ifr);
+  if (ret < 0 && errno == EINVAL && (ifFlags & IFF_MULTI_QUEUE) &&
+      queues_.empty()) {
+    close(fd);
+    return false;
+  }
   sysCheckError(ret, "Failed to create/attach interface ", name_);
 
-  // Set configured MTU
-  setMtu(mtu_);
-
   // make fd non-blocking
-  auto flags = fcntl(fd_, F_GETFL);
-  sysCheckError(flags, "Failed to get flags from fd ", fd_);
+  auto flags = fcntl(fd, F_GETFL);
+  sysCheckError(flags, "Failed to get flags from fd ", fd);
   flags |= O_NONBLOCK;
-  ret = fcntl(fd_, F_SETFL, flags);
+  ret = fcntl(fd, F_SETFL, flags);
   sysCheckError(ret, "Failed to set non-blocking flags ", flags,
-                " to fd ", fd_);
-  flags = fcntl(fd_, F_GETFD);
-  sysCheckError(flags, "Failed to get flags from fd ", fd_);
+                " to fd ", fd);
+  flags = fcntl(fd, F_GETFD);
+  sysCheckError(flags, "Failed to get flags from fd ", fd);
   flags |= FD_CLOEXEC;
-  ret = fcntl(fd_, F_SETFD, flags);
+  ret = fcntl(fd, F_SETFD, flags);
   sysCheckError(ret, "Failed to set close-on-exec flags ", flags,
-                " to fd ", fd_);
+                " to fd ", fd);
 
-  XLOG(INFO) << "Create/attach to tun interface " << name_ << " @ fd " << fd_;
+  queues_.push_back(std::make_unique<Queue>(this, evb_, fd));
+  XLOG(INFO) << "Create/attach to tun interface " << name_ << " queue "
+             << queues_.size() - 1 << " @ fd " << fd;
+  return true;
 }
 
-void TunIntf::closeFD() noexcept {
-  auto ret = close(fd_);
-  sysLogError(ret, "Failed to close fd ", fd_, " for interface ", name_);
-  if (ret == 0) {
-    XLOG(INFO) << "Closed fd " << fd_ << " for interface " << name_;
-    fd_ = -1;
+void TunIntf::closeFDs() noexcept {
+  for (auto& queue : queues_) {
+    if (queue->fd() == -1) {
+      continue;
+    }
+    auto ret = close(queue->fd());
+    sysLogError(ret, "Failed to close fd ", queue->fd(), " for interface ",
+                name_);
+    if (ret == 0) {
+      XLOG(INFO) << "Closed fd " << queue->fd() << " for interface " << name_;
+      queue->resetFD();
+    }
   }
 }
 
@@ -252,7 +356,7 @@ void TunIntf::setMtu(int mtu) {
   ifr.ifr_mtu = mtu_;
   auto ret = ioctl(sock, SIOCSIFMTU, (void*)&ifr);
   sysCheckError(ret, "Failed to set MTU ", ifr.ifr_mtu,
-                " to fd ", fd_, " errno = ", errno);
+                " to fd ", fd(), " errno = ", errno);
   XLOG(DBG3) << "Set tun " << name_ << " MTU to " << mtu;
 }
 
@@ -293,13 +397,14 @@ void TunIntf::disableIPv6AddrGenMode(int ifIndex) {
   return;
 }
 
-void TunIntf::handlerReady(uint16_t /*events*/) noexcept {
-  CHECK(fd_ != -1);
+void TunIntf::readPackets(Queue* queue) noexcept {
+  CHECK(queue->fd() != -1);
 
   // Since this is L3 packet size, we should also reserve some space for L2
   // header, which is 18 bytes (including one vlan tag)
   int sent = 0;
   int dropped = 0;
+  uint64_t syscalls = 0;
   uint64_t bytes = 0;
   bool fdFail = false;
   try {
@@ -309,11 +414,12 @@ void TunIntf::handlerReady(uint16_t /*events*/) noexcept {
       auto buf = pkt->buf();
       int ret = 0;
       do {
-        ret = read(fd_, buf->writableTail(), buf->tailroom());
+        ret = read(queue->fd(), buf->writableTail(), buf->tailroom());
+        ++syscalls;
       } while (ret == -1 && errno == EINTR);
       if (ret < 0) {
         if (errno != EAGAIN) {
-          sysLogError(ret, "Failed to read on ", fd_);
+          sysLogError(ret, "Failed to read on ", queue->fd());
           // Cannot continue read on this fd
           fdFail = true;
         }
@@ -342,22 +448,34 @@ void TunIntf::handlerReady(uint16_t /*events*/) noexcept {
               << folly::exceptionStr(ex);
   }
 
+  queue->rxPackets.fetch_add(sent, std::memory_order_relaxed);
+  queue->rxSyscalls.fetch_add(syscalls, std::memory_order_relaxed);
+  queue->rxDropped.fetch_add(dropped, std::memory_order_relaxed);
+
   if (fdFail) {
-    unregisterHandler();
+    queue->unregisterHandler();
   }
 
   XLOG(DBG4) << "Forwarded " << sent << " packets (" << bytes
-             << " bytes) from host @ fd " << fd_ << " for interface " << name_
-             << " dropped:" << dropped;
+             << " bytes) from host @ fd " << queue->fd() << " for interface "
+             << name_ << " dropped:" << dropped;
 }
 
 bool TunIntf::sendPacketToHost(std::unique_ptr<RxPacket> pkt) {
-  CHECK(fd_ != -1);
+  CHECK(!queues_.empty());
   const int l2Len = EthHdr::SIZE;
 
+  // Packet RX workers each write to their own queue, anything else shares
+  // the first one.
+  auto worker = PacketRxPool::currentWorker();
+  auto& queue = worker == PacketRxPool::kNoWorker ?
+      *queues_.front() : *queues_[worker % queues_.size()];
+  CHECK(queue.fd() != -1);
+
   auto buf = pkt->buf();
   if (buf->length() <= l2Len) {
     XLOG(ERR) << "Received a too small packet with length " << buf->length();
+    queue.txDropped.fetch_add(1, std::memory_order_relaxed);
     return false;
   }
 
@@ -366,20 +484,37 @@ bool TunIntf::sendPacketToHost(std::unique_ptr<RxPacket> pkt) {
 
   int ret = 0;
   do {
-    ret = write(fd_, buf->data(), buf->length());
+    ret = write(queue.fd(), buf->data(), buf->length());
+    queue.txSyscalls.fetch_add(1, std::memory_order_relaxed);
   } while (ret == -1 && errno == EINTR);
   if (ret < 0) {
     sysLogError(ret, "Failed to send packet to host from Interface ", ifID_);
+    queue.txDropped.fetch_add(1, std::memory_order_relaxed);
     return false;
   } else if (ret < buf->length()) {
     XLOG(ERR) << "Failed to send full packet to host from Interface " << ifID_
               << ". " << ret << " bytes sent instead of " << buf->length();
+    queue.txDropped.fetch_add(1, std::memory_order_relaxed);
     return false;
   }
+  queue.txPackets.fetch_add(1, std::memory_order_relaxed);
 
   XLOG(DBG4) << "Send packet (" << ret << " bytes) to host from Interface "
              << ifID_;
   return true;
 }
 
+void TunIntf::publishStats() const {
+  for (size_t idx = 0; idx < queues_.size(); ++idx) {
+    const auto& queue = *queues_[idx];
+    auto prefix = folly::to<std::string>("tun.", name_, ".", idx, ".");
+    fbData->setCounter(prefix + "rx_packets", queue.rxPackets.load());
+    fbData->setCounter(prefix + "rx_syscalls", queue.rxSyscalls.load());
+    fbData->setCounter(prefix + "rx_dropped", queue.rxDropped.load());
+    fbData->setCounter(prefix + "tx_packets", queue.txPackets.load());
+    fbData->setCounter(prefix + "tx_syscalls", queue.txSyscalls.load());
+    fbData->setCounter(prefix + "tx_dropped", queue.txDropped.load());
+  }
+}
+
 }}  // namespace facebook::fboss
@@ -13,14 +13,24 @@
 #include "fboss/agent/state/Interface.h"
 #include "fboss/agent/state/StateUtils.h"
 #include <folly/io/async/EventBase.h>
-#include <folly/io/async/EventHandler.h>
+
+#include <memory>
+#include <vector>
 
 namespace facebook { namespace fboss {
 
 class SwSwitch;
 class RxPacket;
 
-class TunIntf : private folly::EventHandler {
+/*
+ * A tun interface on the host for a switch interface.
+ *
+ * The interface is opened with one queue per packet RX worker (see
+ * --tun_queues), so the workers send packets to the host without sharing
+ * a file descriptor.  Packets from the host are read from every queue on
+ * the thread that serves the evb.
+ */
+class TunIntf {
  public:
   /**
    * Creates a TunIntf object of already existing linux interface. Initial
@@ -87,7 +97,8 @@ class TunIntf : private folly::EventHandler {
   /**
    * Send a packet to the interface on host.
    * Unlike other methods, which are called on thread that serves the evb,
-   * this function can be called from any thread.
+   * this function can be called from any thread.  It writes to the queue of
+   * the packet RX worker it is called on.
    *
    * @return true The packet is sent to host
    *         false The packet is dropped due to errors
@@ -123,19 +134,36 @@ class TunIntf : private folly::EventHandler {
     return status_;
   }
 
+  size_t getNumQueues() const {
+    return queues_.size();
+  }
+
+  /**
+   * Export the per queue packet, syscall and drop counters.
+   */
+  void publishStats() const;
+
  private:
+  class Queue;
+
+  /**
+   * Read the packets from the host on a queue, up to kMaxSentOneTime of
+   * them per call.
+   */
+  void readPackets(Queue* queue) noexcept;
+
   /**
-   * Callback for event on Tun interface's read socket-fd
-   * Override's folly::EventHandler handlerReady callback.
+   * Open/Close the socket-fds to read/write data from Tun interface, one per
+   * queue.  queues_ is mutated.
    */
-  void handlerReady(uint16_t events) noexcept override;
+  void openFDs();
+  void closeFDs() noexcept;
+  bool openQueue(int flags);
 
   /**
-   * Open/Close a new socket-fd to read/write data from Tun interface.
-   * fd_ is mutated.
+   * The fd of the first queue, for the ioctls on the interface itself
    */
-  void openFD();
-  void closeFD() noexcept;
+  int fd() const;
 
   /**
    * In newer kernel an interface is automatically gets link-local IPv6 address
@@ -147,6 +175,7 @@ class TunIntf : private folly::EventHandler {
   static void disableIPv6AddrGenMode(int ifIndex);
 
   SwSwitch *sw_{nullptr};
+  folly::EventBase *evb_{nullptr};
 
   const std::string name_{""};  // The name in the host
   const InterfaceID ifID_{0};   // Switch interface ID
@@ -158,10 +187,10 @@ class TunIntf : private folly::EventHandler {
   Interface::Addresses addrs_;  // The IP addresses assigned to this intf
 
   /**
-   * File descriptor for this interface through which packets can
-   * be received from or sent to.
+   * The queues of this interface, each with a file descriptor through which
+   * packets can be received from or sent to.
    */
-  int fd_{-1};
+  std::vector<std::unique_ptr<Queue>> queues_;
   int mtu_{-1};
 };
 
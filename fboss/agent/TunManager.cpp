@@ -18,12 +18,15 @@ extern "C" {
 #include <sys/ioctl.h>
 }
 
+#include <folly/Conv.h>
 #include <folly/Demangle.h>
 #include <folly/MapUtil.h>
 #include <folly/io/async/EventBase.h>
 #include <folly/logging/xlog.h>
 #include "fboss/agent/NlError.h"
 #include "fboss/agent/RxPacket.h"
+#include "fboss/agent/SwSwitch.h"
+#include "fboss/agent/SwitchStats.h"
 #include "fboss/agent/SysError.h"
 #include "fboss/agent/TunIntf.h"
 #include "fboss/agent/state/Interface.h"
@@ -33,6 +36,9 @@ extern "C" {
 
 #include <boost/container/flat_set.hpp>
 
+#include <algorithm>
+#include <chrono>
+
 namespace {
   const int kDefaultMtu = 1500;
 }
@@ -42,6 +48,8 @@ namespace facebook { namespace fboss {
 using folly::IPAddress;
 using folly::EventBase;
 
+constexpr size_t TunManager::kMaxRequestsPerSend;
+
 TunManager::TunManager(SwSwitch *sw, EventBase *evb) : sw_(sw), evb_(evb) {
   DCHECK(sw) << "NULL pointer to SwSwitch.";
   DCHECK(evb) << "NULL pointer to EventBase";
@@ -90,7 +98,7 @@ void TunManager::stateUpdated(const StateDelta& delta) {
 bool TunManager::sendPacketToHost(
     InterfaceID dstIfID,
     std::unique_ptr<RxPacket> pkt) {
-  std::lock_guard<std::mutex> lock(mutex_);
+  folly::SharedMutex::ReadHolder lock(mutex_);
   auto iter = intfs_.find(dstIfID);
   if (iter == intfs_.end()) {
     // the Interface ID has been deleted, make a log, and skip the pkt
@@ -100,6 +108,13 @@ bool TunManager::sendPacketToHost(
   return iter->second->sendPacketToHost(std::move(pkt));
 }
 
+void TunManager::publishStats() {
+  folly::SharedMutex::ReadHolder lock(mutex_);
+  for (const auto& intf : intfs_) {
+    intf.second->publishStats();
+  }
+}
+
 void TunManager::addExistingIntf(
     const std::string& ifName,
     int ifIndex) {
@@ -128,6 +143,8 @@ void TunManager::addNewIntf(
   SCOPE_FAIL {
     intfs_.erase(ret.first);
   };
+  // Requests queued for other interfaces must not fail as this one's
+  flushRequests();
   auto intf = std::make_unique<TunIntf>(
       sw_, evb_, ifID, isUp, addrs, getInterfaceMtu(ifID));
 
@@ -147,6 +164,7 @@ void TunManager::addNewIntf(
   for (const auto& addr : addrs) {
     addTunAddress(ifID, ifName, ifIndex, addr.first, addr.second);
   }
+  flushRequests();
 
   // Store it in local map on success
   ret.first->second = std::move(intf);
@@ -167,6 +185,8 @@ void TunManager::removeIntf(InterfaceID ifID) {
 
   // Remove the route table and associated rule
   removeRouteTable(ifID, intf->getIfIndex());
+  // Send the requests before the interface they refer to goes away
+  flushRequests();
   intf->setDelete();
   intfs_.erase(iter);
 }
@@ -301,28 +321,25 @@ void TunManager::addRemoveRouteTable(InterfaceID ifID, int ifIndex, bool add) {
     rtnl_route_nh_set_ifindex(nexthop, ifIndex);
     rtnl_route_add_nexthop(route, nexthop);
 
+    struct nl_msg* msg = nullptr;
     if (add) {
-      error = rtnl_route_add(sock_, route, NLM_F_REPLACE);
+      error = rtnl_route_build_add_request(route, NLM_F_REPLACE, &msg);
     } else {
-      error = rtnl_route_delete(sock_, route, 0);
+      error = rtnl_route_build_del_request(route, 0, &msg);
     }
+    nlCheckError(error, "Failed to build request for default route ", addr);
     /**
-     * Disable: Because of some weird reason this CHECK fails while deleting
-     * v4 default route. However route actually gets wiped off from Linux
-     * routing table.
-    nlCheckError(error, "Failed to ", add ? "add" : "remove",
-                  " default route ", addr, " @ index ", ifIndex,
-                  " in table ", getTableId(ifID), " for interface ", ifID,
-                  ". ErrorCode: ", error);
-      */
-    if (error < 0) {
-      XLOG(WARNING) << "Failed to " << (add ? "add" : "remove")
-                    << " default route " << addr << " @index " << ifIndex
-                    << ". ErrorCode: " << error;
-    }
-    XLOG(INFO) << (add ? "Added" : "Removed") << " default route " << addr
-               << " @ index " << ifIndex << " in table " << getTableId(ifID)
-               << " for interface " << ifID;
+     * Not required to succeed: Because of some weird reason this fails while
+     * deleting v4 default route. However route actually gets wiped off from
+     * Linux routing table.
+     */
+    queueRequest(
+        msg,
+        folly::to<std::string>(
+            add ? "add" : "remove", " default route ", addr.str(),
+            " @ index ", ifIndex, " in table ", getTableId(ifID),
+            " for interface ", ifID),
+        false);
   }
 }
 
@@ -354,18 +371,19 @@ void TunManager::addRemoveSourceRouteRule(
   auto error = rtnl_rule_set_src(rule, sourceaddr);
   nlCheckError(error, "Failed to set destination route to ", addr);
 
+  struct nl_msg* msg = nullptr;
   if (add) {
-    error = rtnl_rule_add(sock_, rule, NLM_F_REPLACE);
+    error = rtnl_rule_build_add_request(rule, NLM_F_REPLACE, &msg);
   } else {
-    error = rtnl_rule_delete(sock_, rule, 0);
-  }
-  nlCheckError(error, "Failed to ", add ? "add" : "remove",
-                " rule for address ", addr,
-                " to lookup table ", getTableId(ifID),
-                " for interface ", ifID);
-  XLOG(INFO) << (add ? "Added" : "Removed") << " rule for address " << addr
-             << " to lookup table " << getTableId(ifID) << " for interface "
-             << ifID;
+    error = rtnl_rule_build_delete_request(rule, 0, &msg);
+  }
+  nlCheckError(error, "Failed to build request for rule for address ", addr);
+  queueRequest(
+      msg,
+      folly::to<std::string>(
+          add ? "add" : "remove", " rule for address ", addr.str(),
+          " to lookup table ", getTableId(ifID), " for interface ", ifID),
+      true);
 }
 
 void TunManager::addRemoveTunAddress(
@@ -394,6 +412,7 @@ void TunManager::addRemoveTunAddress(
   rtnl_addr_set_prefixlen(tunaddr, mask);
   rtnl_addr_set_ifindex(tunaddr, ifIndex);
 
+  struct nl_msg* msg = nullptr;
   if (add) {
     /**
      * When you bring down interface some routes are purged but some still stay
@@ -402,16 +421,31 @@ void TunManager::addRemoveTunAddress(
      * addresses and routes for that interface with REPLACE flag overriding
      * existing ones if any.
      */
-    error = rtnl_addr_add(sock_, tunaddr, NLM_F_REPLACE);
+    error = rtnl_addr_build_add_request(tunaddr, NLM_F_REPLACE, &msg);
   } else {
-    error = rtnl_addr_delete(sock_, tunaddr, 0);
+    error = rtnl_addr_build_delete_request(tunaddr, 0, &msg);
+  }
+  nlCheckError(error, "Failed to build request for address ", addr);
+  queueRequest(
+      msg,
+      folly::to<std::string>(
+          add ? "add" : "remove", " address ", addr.str(), "/",
+          static_cast<int>(mask), " on interface ", ifName, " @ index ",
+          ifIndex),
+      true);
+}
+
+template <typename QueueFn>
+void TunManager::undoIfLastRequestFails(QueueFn&& queueFn) {
+  CHECK(!pendingRequests_.empty());
+  auto target = pendingRequests_.size() - 1;
+  queueFn();
+  CHECK_LE(pendingRequests_.size(), target + 2);
+  if (pendingRequests_.size() == target + 2) {
+    pendingRequests_[target].undo =
+        std::make_unique<Request>(std::move(pendingRequests_.back()));
+    pendingRequests_.pop_back();
   }
-  nlCheckError(error, "Failed to ", add ? "add" : "remove",
-                " address ", addr, "/", static_cast<int>(mask),
-                " to interface ", ifName, " @ index ", ifIndex);
-  XLOG(INFO) << (add ? "Added" : "Removed") << " address " << addr.str() << "/"
-             << static_cast<int>(mask) << " on interface " << ifName
-             << " @ index " << ifIndex;
 }
 
 void TunManager::addTunAddress(
@@ -421,15 +455,10 @@ void TunManager::addTunAddress(
     folly::IPAddress addr,
     uint8_t mask) {
   addRemoveSourceRouteRule(ifID, addr, true);
-  SCOPE_FAIL {
-    try {
-      addRemoveSourceRouteRule(ifID, addr, false);
-    } catch (const std::exception& ex) {
-      XLOG(ERR) << "Failed to removed partially added source rule on "
-                << "interface " << ifName;
-    }
-  };
   addRemoveTunAddress(ifName, ifIndex, addr, mask, true);
+  // The address fails at the flush, after the rule is sent: take the rule
+  // back out if it does
+  undoIfLastRequestFails([&] { addRemoveSourceRouteRule(ifID, addr, false); });
 }
 
 void TunManager::removeTunAddress(
@@ -439,15 +468,9 @@ void TunManager::removeTunAddress(
     folly::IPAddress addr,
     uint8_t mask) {
   addRemoveSourceRouteRule(ifID, addr, false);
-  SCOPE_FAIL {
-    try {
-      addRemoveSourceRouteRule(ifID, addr, true);
-    } catch (const std::exception& ex) {
-      XLOG(ERR) << "Failed to add partially added source rule on "
-                << "interface " << ifName;
-    }
-  };
   addRemoveTunAddress(ifName, ifIndex, addr, mask, false);
+  // The address stays if its removal fails, so put its rule back then
+  undoIfLastRequestFails([&] { addRemoveSourceRouteRule(ifID, addr, true); });
 }
 
 void TunManager::start() const {
@@ -521,7 +544,7 @@ void TunManager::addressProcessor(struct nl_object *obj, void *data) {
   );
 }
 
-void TunManager::doProbe(std::lock_guard<std::mutex>& /* lock */) {
+void TunManager::doProbe(std::lock_guard<folly::SharedMutex>& /* lock */) {
   const auto startTs = std::chrono::steady_clock::now();
   SCOPE_EXIT {
     const auto endTs = std::chrono::steady_clock::now();
@@ -598,6 +621,7 @@ void TunManager::forceInitialSync() {
 
 void TunManager::sync(std::shared_ptr<SwitchState> state) {
   CHECK(evb_->isInEventBaseThread());
+  const auto startTs = std::chrono::steady_clock::now();
   using Addresses = Interface::Addresses;
   using ConstAddressesIter = Addresses::const_iterator;
   using IntfInfo = std::pair<bool /* status */, Addresses>;
@@ -623,10 +647,14 @@ void TunManager::sync(std::shared_ptr<SwitchState> state) {
   }
 
   // Hold mutex while changing interfaces
-  std::lock_guard<std::mutex> lock(mutex_);
+  std::lock_guard<folly::SharedMutex> lock(mutex_);
   if (!probeDone_) {
     doProbe(lock);
   }
+  // Don't leave the requests of a failed sync to be sent by the next one
+  SCOPE_FAIL {
+    pendingRequests_.clear();
+  };
 
   // prepare old addresses
   IntfToAddrsMap oldIntfToInfo;
@@ -716,11 +744,165 @@ void TunManager::sync(std::shared_ptr<SwitchState> state) {
       [&](ConstIntfToAddrsMapIter& oldIter) {
         removeIntf(oldIter->first);
       });
+  flushRequests();
 
   start();
 
   // track number of times sync is called
   ++numSyncs_;
+  sw_->stats()->tunManagerSync(
+      std::chrono::duration_cast<std::chrono::milliseconds>(
+          std::chrono::steady_clock::now() - startTs));
+}
+
+void TunManager::NlMsgDeleter::operator()(struct nl_msg* msg) const {
+  nlmsg_free(msg);
+}
+
+void TunManager::queueRequest(
+    struct nl_msg* msg, std::string description, bool mustSucceed) {
+  Request request;
+  request.msg.reset(msg);
+  request.description = std::move(description);
+  request.mustSucceed = mustSucceed;
+  pendingRequests_.push_back(std::move(request));
+}
+
+namespace {
+
+// The requests of one send whose acks are still expected, by sequence number
+struct AckState {
+  uint32_t firstSeq{0};
+  std::vector<int>* errors{nullptr};
+  std::vector<bool>* acked{nullptr};
+  size_t pending{0};
+
+  void ack(uint32_t seq, int error) {
+    auto idx = seq - firstSeq;
+    if (idx >= acked->size() || (*acked)[idx]) {
+      return;
+    }
+    (*errors)[idx] = error;
+    (*acked)[idx] = true;
+    --pending;
+  }
+};
+
+int ackHandler(struct nl_msg* msg, void* arg) {
+  static_cast<AckState*>(arg)->ack(nlmsg_hdr(msg)->nlmsg_seq, 0);
+  return NL_OK;
+}
+
+int errorHandler(struct sockaddr_nl* /* nla */, struct nlmsgerr* err,
+                 void* arg) {
+  static_cast<AckState*>(arg)->ack(
+      err->msg.nlmsg_seq, -nl_syserr2nlerr(err->error));
+  return NL_SKIP;
+}
+
+} // anonymous namespace
+
+std::vector<int> TunManager::sendRequests(
+    const std::vector<Request>& requests) {
+  std::vector<int> errors(requests.size(), 0);
+  for (size_t first = 0; first < requests.size();
+       first += kMaxRequestsPerSend) {
+    auto last = std::min(requests.size(), first + kMaxRequestsPerSend);
+
+    // The kernel handles the messages of one send in order, and acks each
+    // of them.
+    std::vector<uint8_t> buf;
+    uint32_t firstSeq = 0;
+    for (auto idx = first; idx < last; ++idx) {
+      auto msg = requests[idx].msg.get();
+      nl_complete_msg(sock_, msg);
+      auto hdr = nlmsg_hdr(msg);
+      if (idx == first) {
+        firstSeq = hdr->nlmsg_seq;
+      }
+      auto bytes = reinterpret_cast<const uint8_t*>(hdr);
+      buf.insert(buf.end(), bytes, bytes + NLMSG_ALIGN(hdr->nlmsg_len));
+    }
+    auto error = nl_sendto(sock_, buf.data(), buf.size());
+    nlCheckError(error, "Failed to send ", last - first, " netlink requests");
+
+    std::vector<int> sendErrors(last - first, 0);
+    std::vector<bool> acked(last - first, false);
+    AckState state;
+    state.firstSeq = firstSeq;
+    state.errors = &sendErrors;
+    state.acked = &acked;
+    state.pending = last - first;
+
+    auto cb = nl_cb_alloc(NL_CB_DEFAULT);
+    if (!cb) {
+      throw FbossError("Failed to allocate netlink callbacks");
+    }
+    SCOPE_EXIT { nl_cb_put(cb); };
+    nl_cb_set(cb, NL_CB_ACK, NL_CB_CUSTOM, &ackHandler, &state);
+    nl_cb_err(cb, NL_CB_CUSTOM, &errorHandler, &state);
+    while (state.pending > 0) {
+      error = nl_recvmsgs(sock_, cb);
+      nlCheckError(error, "Failed to receive acks for ", state.pending,
+                   " netlink requests");
+    }
+    std::copy(sendErrors.begin(), sendErrors.end(), errors.begin() + first);
+  }
+  return errors;
+}
+
+void TunManager::flushRequests() {
+  std::vector<Request> requests;
+  requests.swap(pendingRequests_);
+  auto errors = sendRequests(requests);
+
+  const Request* failed = nullptr;
+  int failedError = 0;
+  for (size_t idx = 0; idx < requests.size(); ++idx) {
+    const auto& request = requests[idx];
+    if (errors[idx] == 0) {
+      XLOG(INFO) << "Request to " << request.description << " succeeded";
+    } else if (request.mustSucceed) {
+      XLOG(ERR) << "Failed to " << request.description << ": "
+                << nl_geterror(errors[idx]);
+      if (!failed) {
+        failed = &request;
+        failedError = errors[idx];
+      }
+    } else {
+      XLOG(WARNING) << "Failed to " << request.description
+                    << ". ErrorCode: " << errors[idx];
+    }
+  }
+
+  // Undo what the failed requests depended on.  Only the original failure
+  // is thrown, failing to undo is just logged.
+  std::vector<Request> undos;
+  for (size_t idx = 0; idx < requests.size(); ++idx) {
+    if (errors[idx] != 0 && requests[idx].undo) {
+      undos.push_back(std::move(*requests[idx].undo));
+    }
+  }
+  if (!undos.empty()) {
+    try {
+      auto undoErrors = sendRequests(undos);
+      for (size_t idx = 0; idx < undos.size(); ++idx) {
+        if (undoErrors[idx] == 0) {
+          XLOG(INFO) << "Request to " << undos[idx].description
+                     << " succeeded";
+        } else {
+          XLOG(ERR) << "Failed to " << undos[idx].description << ": "
+                    << nl_geterror(undoErrors[idx]);
+        }
+      }
+    } catch (const std::exception& ex) {
+      XLOG(ERR) << "Failed to send " << undos.size()
+                << " netlink requests to undo failed ones: " << ex.what();
+    }
+  }
+  if (failed) {
+    throw NlError(failedError, "Failed to ", failed->description);
+  }
 }
 
 // TODO(aeckert): Find a way to reuse the iterator from NodeMapDelta here as
@@ -12,15 +12,21 @@
 #include "fboss/agent/types.h"
 #include "fboss/agent/StateObserver.h"
 #include "fboss/agent/state/Interface.h"
+#include <folly/SharedMutex.h>
 #include <folly/io/async/EventBase.h>
 
 #include <boost/container/flat_map.hpp>
 
 extern "C" {
+#include <netlink/msg.h>
 #include <netlink/socket.h>
 #include <netlink/object.h>
 }
 
+#include <memory>
+#include <string>
+#include <vector>
+
 namespace facebook { namespace fboss {
 
 class InterfaceMap;
@@ -73,6 +79,12 @@ class TunManager : public StateObserver {
    */
   virtual void startObservingUpdates();
 
+  /**
+   * Export the per queue counters of the interfaces.
+   * This function can be called from any thread.
+   */
+  void publishStats();
+
  private:
   // no copy to assign
   TunManager(const TunManager &) = delete;
@@ -177,7 +189,7 @@ class TunManager : public StateObserver {
   /**
    * Lookup host for existing Tun interfaces and their addresses.
    */
-  void doProbe(std::lock_guard<std::mutex>& mutex);
+  void doProbe(std::lock_guard<folly::SharedMutex>& mutex);
 
   /**
    * Add an address to a TUN interface during probe process.
@@ -202,19 +214,52 @@ class TunManager : public StateObserver {
   void applyChanges(const MAPNAME& oldMap, const MAPNAME& newMap,
                     CHANGEFN changeFn, ADDFN addFn, REMOVEFN removeFn);
 
+  /**
+   * The netlink requests for routes, rules and addresses are queued, and
+   * sent to the kernel kMaxRequestsPerSend at a time by flushRequests().
+   * The flush throws if a request that must succeed fails; the failures of
+   * the others are only logged.
+   */
+  void queueRequest(
+      struct nl_msg* msg, std::string description, bool mustSucceed);
+  /**
+   * The request queueFn queues, if any, is sent only if the last request
+   * queued before it fails, to undo what that one depended on.
+   */
+  template <typename QueueFn>
+  void undoIfLastRequestFails(QueueFn&& queueFn);
+  void flushRequests();
+
   SwSwitch *sw_{nullptr};
   folly::EventBase *evb_{nullptr};
 
   // Netlink socket for managing interface/addresses in Host/Linux
   nl_sock *sock_{nullptr};
 
+  struct NlMsgDeleter {
+    void operator()(struct nl_msg* msg) const;
+  };
+  struct Request {
+    std::unique_ptr<struct nl_msg, NlMsgDeleter> msg;
+    std::string description;
+    bool mustSucceed{false};
+    // Sent if this request fails
+    std::unique_ptr<Request> undo;
+  };
+  // The errors of the requests, 0 for those that succeeded
+  std::vector<int> sendRequests(const std::vector<Request>& requests);
+  static constexpr size_t kMaxRequestsPerSend = 64;
+  std::vector<Request> pendingRequests_;
+
   /**
    * The mutex used to protect `intfs_` which can be used by
    * sync() could manipulate intfs_. Called on the thread that serves evb_.
-   * sendPacketToHost() uses intfs_, it can be called from any thread.
+   * sendPacketToHost() uses intfs_, it can be called from any thread, and
+   * only takes the mutex shared so that the packet RX workers can send to
+   * their own queues of the interfaces at the same time.
    */
   boost::container::flat_map<InterfaceID, std::unique_ptr<TunIntf>> intfs_;
-  std::mutex mutex_;
+  folly::SharedMutex mutex_;
 
   // Whether the manager has registered itself to listen for state updates
   // from sw_
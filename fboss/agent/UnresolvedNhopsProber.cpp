@@ -9,61 +9,183 @@
  */
 #include "UnresolvedNhopsProber.h"
 #include <folly/logging/xlog.h>
+#include "common/stats/ServiceData.h"
 #include "fboss/agent/ArpHandler.h"
 #include "fboss/agent/IPv6Handler.h"
 #include "fboss/agent/NexthopToRouteCount.h"
+#include "fboss/agent/SwSwitch.h"
+#include "fboss/agent/SwitchStats.h"
 #include "fboss/agent/state/ArpTable.h"
 #include "fboss/agent/state/Interface.h"
+#include "fboss/agent/state/InterfaceMap.h"
 #include "fboss/agent/state/NdpTable.h"
+#include "fboss/agent/state/NodeMapDelta-defs.h"
+#include "fboss/agent/state/StateDelta.h"
 #include "fboss/agent/state/SwitchState.h"
 #include "fboss/agent/state/Vlan.h"
 #include "fboss/agent/state/VlanMap.h"
 
+#include <algorithm>
+
+DEFINE_int32(max_unresolved_nhop_backoff_s, 60,
+             "Longest interval between the probes of a next hop that stays "
+             "unresolved");
+DEFINE_int32(max_unresolved_nhop_probes_per_sec, 500,
+             "Most probes sent for unresolved next hops per second");
+
+using std::chrono::seconds;
+using std::chrono::steady_clock;
+
 namespace facebook { namespace fboss {
 
+constexpr seconds UnresolvedNhopsProber::kTickInterval;
+
+namespace {
+
+template <typename DeltaT, typename Fn>
+void forEachNeighborChanged(const DeltaT& delta, Fn fn) {
+  for (const auto& entryDelta : delta) {
+    const auto& entry =
+        entryDelta.getNew() ? entryDelta.getNew() : entryDelta.getOld();
+    fn(entry->getIntfID(), folly::IPAddress(entry->getIP()));
+  }
+}
+
+} // unnamed namespace
+
+bool UnresolvedNhopsProber::isUsed(
+    const SwitchState* state, const NhopKey& key) const {
+  auto intf = state->getInterfaces()->getInterfaceIf(key.first);
+  if (!intf) {
+    return false; // interface got unconfigured
+  }
+  bool used = false;
+  nhops2RouteCount_.forEachNexthopVia(
+      intf->getRouterID(), key.first, key.second,
+      [&](const NextHop& /*nhop*/,
+          const NexthopToRouteCount::NexthopRoutes& /*routes*/) {
+        used = true;
+      });
+  return used;
+}
+
+bool UnresolvedNhopsProber::isResolved(
+    const SwitchState* state, const NhopKey& key) const {
+  // Note that we do not exclude pending entries here since in case of
+  // recursive routes we might get packets with destination set to prefix
+  // that needs to be resolved recursively. In ARP and NDP code we do not do
+  // route lookup when deciding to send ARP/NDP requests.  So we would only
+  // try to ARP/NDP for the destination if it is in one of the interface
+  // subnets (which it won't be else we won't have needed recursive
+  // resolution). So ARP/NDP for all unresolved next hops.
+  auto intf = state->getInterfaces()->getInterfaceIf(key.first);
+  auto vlan = state->getVlans()->getVlanIf(intf->getVlanID());
+  CHECK(vlan); // must have vlan for configrued inteface
+  if (key.second.isV4()) {
+    auto arpEntry = vlan->getArpTable()->getEntryIf(key.second.asV4());
+    return arpEntry && arpEntry->getPort() != PortID(0);
+  }
+  auto ndpEntry = vlan->getNdpTable()->getEntryIf(key.second.asV6());
+  return ndpEntry && ndpEntry->getPort() != PortID(0);
+}
+
+void UnresolvedNhopsProber::refresh(
+    const SwitchState* state, const NhopKey& key, TimePoint now) {
+  auto itr = unresolved_.find(key);
+  if (isUsed(state, key) && !isResolved(state, key)) {
+    if (itr == unresolved_.end()) {
+      // Probe a next hop that just became unresolved right away
+      unresolved_.emplace(key, ProbeState{now, interval_});
+      schedule_.emplace(now, key);
+    }
+  } else if (itr != unresolved_.end()) {
+    schedule_.erase(std::make_pair(itr->second.nextProbe, key));
+    unresolved_.erase(itr);
+  }
+}
+
+void UnresolvedNhopsProber::stateUpdated(const StateDelta& delta) {
+  std::lock_guard<std::mutex> g(lock_);
+  std::vector<NexthopToRouteCount::RouterNexthop> changedNhops;
+  nhops2RouteCount_.stateChanged(delta, &changedNhops);
+
+  // The next hops that gained or lost their routes or neighbor entries
+  std::set<NhopKey> changed;
+  for (const auto& ridAndNhop : changedNhops) {
+    const auto& nhop = ridAndNhop.second;
+    changed.emplace(nhop.intf(), nhop.addr());
+  }
+  for (const auto& vlanDelta : delta.getVlansDelta()) {
+    auto addChanged = [&](InterfaceID intf, const folly::IPAddress& addr) {
+      changed.emplace(intf, addr);
+    };
+    forEachNeighborChanged(vlanDelta.getArpDelta(), addChanged);
+    forEachNeighborChanged(vlanDelta.getNdpDelta(), addChanged);
+  }
+  // Interfaces changing vlans or going away is rare, so just check all of
+  // the next hops again.
+  auto intfsDelta = delta.getIntfsDelta();
+  if (intfsDelta.begin() != intfsDelta.end()) {
+    for (const auto& ridAndNhopsRoutes : nhops2RouteCount_) {
+      for (const auto& nhopAndRoutes : ridAndNhopsRoutes.second) {
+        const auto& nhop = nhopAndRoutes.first;
+        changed.emplace(nhop.intf(), nhop.addr());
+      }
+    }
+    for (const auto& keyAndState : unresolved_) {
+      changed.insert(keyAndState.first);
+    }
+  }
+
+  auto state = delta.newState().get();
+  auto now = steady_clock::now();
+  for (const auto& key : changed) {
+    refresh(state, key, now);
+  }
+}
+
 void UnresolvedNhopsProber::timeoutExpired() noexcept {
   std::lock_guard<std::mutex> g(lock_);
   auto state = sw_->getState();
-  for (const auto& ridAndNhopsRefCounts : nhops2RouteCount_) {
-    for (const auto& nhopAndRefCount : ridAndNhopsRefCounts.second) {
-      const auto& nhop = nhopAndRefCount.first;
-      auto intf = state->getInterfaces()->getInterfaceIf(nhop.intf());
-      if (!intf) {
-        continue; // interface got unconfigured
-      }
-      // Probe all nexthops for which either don't have a L2 entry
-      // or the entry is not resolved (port == 0). Note that we do
-      // not exclude pending entries here since in case of recursive
-      // routes we might get packets with destination set to prefix
-      // that needs to be resolved recursively. In ARP and NDP code
-      // we do not do route lookup when deciding to send ARP/NDP requests.
-      // So we would only try to ARP/NDP for the destination if it
-      // is in one of the interface subnets (which it won't be else
-      // we won't have needed recursive resolution). So ARP/NDP for
-      // all unresolved next hops. We could also consider doing route
-      // lookups in ARP/NDP code, but by probing all unresolved next
-      // hops we effectively do the same thing, since the next hops
-      // probed come from after the route was (recursively) resolved.
-      auto vlan = state->getVlans()->getVlanIf(intf->getVlanID());
-      CHECK(vlan); // must have vlan for configrued inteface
-      if (nhop.addr().isV4()) {
-        auto nhop4 = nhop.addr().asV4();
-        auto arpEntry = vlan->getArpTable()->getEntryIf(nhop4);
-        if (!arpEntry || arpEntry->getPort() == PortID(0)) {
-          XLOG(DBG4) << " Sending probe for unresolved next hop: " << nhop4;
-          ArpHandler::sendArpRequest(sw_, vlan, nhop4);
-        }
+  auto now = steady_clock::now();
+  auto maxBackoff = std::max(seconds(FLAGS_max_unresolved_nhop_backoff_s),
+                             interval_);
+  auto budget = std::max<int64_t>(
+      FLAGS_max_unresolved_nhop_probes_per_sec * kTickInterval.count(), 1);
+
+  SwSwitch::TxPacketBatch batch(sw_);
+  // Probes that don't fit in this tick stay first in line for the next one
+  while (!schedule_.empty() && schedule_.begin()->first <= now &&
+         budget > 0) {
+    auto key = schedule_.begin()->second;
+    schedule_.erase(schedule_.begin());
+    auto& probe = unresolved_.at(key);
+
+    auto intf = state->getInterfaces()->getInterfaceIf(key.first);
+    auto vlan = intf ?
+        state->getVlans()->getVlanIf(intf->getVlanID()) : nullptr;
+    if (vlan) {
+      if (key.second.isV4()) {
+        auto nhop4 = key.second.asV4();
+        XLOG(DBG4) << " Sending probe for unresolved next hop: " << nhop4;
+        ArpHandler::sendArpRequest(sw_, vlan, nhop4);
       } else {
-        auto nhop6 = nhop.addr().asV6();
-        auto ndpEntry = vlan->getNdpTable()->getEntryIf(nhop6);
-        if (!ndpEntry || ndpEntry->getPort() == PortID(0)) {
-          XLOG(DBG4) << " Sending probe for unresolved next hop: " << nhop6;
-          IPv6Handler::sendNeighborSolicitation(sw_, nhop6, vlan);
-        }
+        auto nhop6 = key.second.asV6();
+        XLOG(DBG4) << " Sending probe for unresolved next hop: " << nhop6;
+        IPv6Handler::sendNeighborSolicitation(sw_, nhop6, vlan);
       }
+      sw_->stats()->unresolvedNhopProbe();
+      --budget;
     }
+
+    probe.nextProbe = now + probe.backoff;
+    probe.backoff = std::min(probe.backoff * 2, maxBackoff);
+    schedule_.emplace(probe.nextProbe, key);
   }
-  scheduleTimeout(interval_);
+
+  fbData->setCounter(SwitchStats::kCounterPrefix + "unresolved_nhops",
+                     unresolved_.size());
+  scheduleTimeout(kTickInterval);
 }
 
 }} // facebook::fboss
@@ -12,11 +12,29 @@
 #include "fboss/agent/NexthopToRouteCount.h"
 #include "fboss/agent/StateObserver.h"
 
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <set>
+#include <utility>
+
 namespace facebook { namespace fboss {
 
 class SwSwitch;
+class SwitchState;
 class StateDelta;
 
+/*
+ * Probes the next hops that routes resolve to, but that have no resolved
+ * ARP/NDP entry.
+ *
+ * The unresolved next hops are tracked incrementally from the route and
+ * neighbor changes in each StateDelta, rather than by walking the route
+ * tables.  Each one is probed as soon as it becomes unresolved, and then
+ * with an exponential backoff for as long as it stays unresolved, while the
+ * probes sent by all of them are capped per second, so a drained rack
+ * doesn't turn into a periodic burst of thousands of probes.
+ */
 class UnresolvedNhopsProber : private folly::AsyncTimeout,
                               public AutoRegisterStateObserver {
  public:
@@ -24,7 +42,7 @@ class UnresolvedNhopsProber : private folly::AsyncTimeout,
       AsyncTimeout(sw->getBackgroundEvb()),
       AutoRegisterStateObserver(sw, "UnresolvedNhopsProber"),
       sw_(sw),
-      // Probe every 5 secs (make it faster ?)
+      // First probe again after 5 secs, backing off from there
       interval_(5) {
     start();
   }
@@ -38,24 +56,46 @@ class UnresolvedNhopsProber : private folly::AsyncTimeout,
 
   void start() {
     sw_->getBackgroundEvb()->runInEventBaseThread([this]() {
-      scheduleTimeout(interval_);
+      scheduleTimeout(kTickInterval);
     });
   }
 
-  void stateUpdated(const StateDelta& delta) override {
-    std::lock_guard<std::mutex> g(lock_);
-    nhops2RouteCount_.stateChanged(delta);
-  }
+  void stateUpdated(const StateDelta& delta) override;
 
   void timeoutExpired() noexcept override;
 
+  // The number of unresolved next hops being probed
+  size_t getUnresolvedCount() const {
+    std::lock_guard<std::mutex> g(lock_);
+    return unresolved_.size();
+  }
+
  private:
+  // How often the probes that are due are sent
+  static constexpr std::chrono::seconds kTickInterval{1};
+
+  // Next hops through the same neighbor are probed once for all weights
+  using NhopKey = std::pair<InterfaceID, folly::IPAddress>;
+  using TimePoint = std::chrono::steady_clock::time_point;
+  struct ProbeState {
+    TimePoint nextProbe;
+    std::chrono::seconds backoff;
+  };
+
+  bool isUsed(const SwitchState* state, const NhopKey& key) const;
+  bool isResolved(const SwitchState* state, const NhopKey& key) const;
+  // Start or stop probing key, after a change to its routes or neighbor
+  void refresh(const SwitchState* state, const NhopKey& key, TimePoint now);
+
   // Need lock since we may get called from both the update
   // thread (stateChanged) and background thread (timeoutExpired)
-  std::mutex lock_;
+  mutable std::mutex lock_;
   SwSwitch* sw_{nullptr};
   NexthopToRouteCount nhops2RouteCount_;
   std::chrono::seconds interval_{0};
+  std::map<NhopKey, ProbeState> unresolved_;
+  // The unresolved next hops, in the order they are due to be probed
+  std::set<std::pair<TimePoint, NhopKey>> schedule_;
 };
 
 }} // facebook::fboss
@@ -9,6 +9,9 @@
  */
 #include "fboss/agent/Utils.h"
 
+#include <pthread.h>
+#include <sched.h>
+#include <string.h>
 #include <sys/resource.h>
 #include <sys/syscall.h>
 
@@ -88,6 +91,31 @@ void incNiceValue(const uint32_t increment) {
   errno = oldErrno;
 }
 
+void pinThreadToCpu(const int cpu) {
+  if (cpu < 0 || cpu >= CPU_SETSIZE) {
+    XLOG(ERR) << "Cannot pin thread to invalid CPU " << cpu;
+    return;
+  }
+  cpu_set_t cpus;
+  CPU_ZERO(&cpus);
+  CPU_SET(cpu, &cpus);
+  auto rv = pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+  if (rv != 0) {
+    XLOG(ERR) << "Error while pinning thread to CPU " << cpu << ": "
+              << strerror(rv);
+  }
+}
+
+void setRealtimePriority(const int priority) {
+  sched_param param;
+  param.sched_priority = priority;
+  auto rv = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+  if (rv != 0) {
+    XLOG(ERR) << "Error while setting thread to real-time priority "
+              << priority << ": " << strerror(rv);
+  }
+}
+
 bool dumpStateToFile(const std::string& filename,
     const folly::dynamic& json) {
   return folly::writeFile(folly::toPrettyJson(json), filename.c_str());
@@ -70,6 +70,24 @@ folly::IPAddressV6 getSwitchVlanIPv6(const std::shared_ptr<SwitchState>& state,
  */
 void incNiceValue(const uint32_t increment);
 
+/*
+ * Pins the calling thread to a CPU, so it isn't moved between CPUs, which
+ * costs it its caches.  Errors are logged, and leave the thread as it was.
+ *
+ * @param[in]    cpu             The CPU to run on.
+ */
+void pinThreadToCpu(const int cpu);
+
+/*
+ * Runs the calling thread at a SCHED_FIFO real-time priority, so that it
+ * gets to run as soon as it is woken up, ahead of the other threads.  It
+ * takes privileges we may not have, so errors are logged, and leave the
+ * thread as it was.
+ *
+ * @param[in]    priority        The SCHED_FIFO priority, from 1 to 99.
+ */
+void setRealtimePriority(const int priority);
+
 /*
  * Serialize folly dynamic to JSON and write to file
  */
@@ -0,0 +1,140 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "fboss/agent/WarmBootTimeline.h"
+
+#include "common/stats/ServiceData.h"
+#include "fboss/agent/Utils.h"
+
+#include <folly/Conv.h>
+#include <folly/FileUtil.h>
+#include <folly/json.h>
+#include <folly/logging/xlog.h>
+
+#include <unistd.h>
+
+#include <chrono>
+
+namespace facebook { namespace fboss {
+
+namespace {
+bool isExitEvent(WarmBootTimeline::Event event) {
+  return event == WarmBootTimeline::Event::GRACEFUL_EXIT_START ||
+    event == WarmBootTimeline::Event::STATE_FILE_WRITTEN;
+}
+}
+
+WarmBootTimeline* WarmBootTimeline::get() {
+  // Intentionally leaked, so events can be marked during shutdown
+  static auto* timeline = new WarmBootTimeline();
+  return timeline;
+}
+
+folly::StringPiece WarmBootTimeline::eventName(Event event) {
+  switch (event) {
+    case Event::GRACEFUL_EXIT_START:
+      return "graceful_exit_start";
+    case Event::STATE_FILE_WRITTEN:
+      return "state_file_written";
+    case Event::PROCESS_START:
+      return "process_start";
+    case Event::WARM_BOOT_CACHE_POPULATED:
+      return "warm_boot_cache_populated";
+    case Event::HOST_ENTRIES_SYNCED:
+      return "host_entries_synced";
+    case Event::INITIAL_CONFIG_APPLIED:
+      return "initial_config_applied";
+    case Event::FIB_SYNCED:
+      return "fib_synced";
+  }
+  return "unknown";
+}
+
+void WarmBootTimeline::mark(Event event) {
+  auto now = std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::system_clock::now().time_since_epoch()).count();
+  std::lock_guard<std::mutex> guard(lock_);
+  auto& time = events_[static_cast<size_t>(event)];
+  if (!time) {
+    time = now;
+  }
+}
+
+std::vector<std::pair<WarmBootTimeline::Event, int64_t>>
+WarmBootTimeline::getEvents() const {
+  std::vector<std::pair<Event, int64_t>> events;
+  std::lock_guard<std::mutex> guard(lock_);
+  for (size_t idx = 0; idx < kNumEvents; ++idx) {
+    if (events_[idx]) {
+      events.emplace_back(static_cast<Event>(idx), *events_[idx]);
+    }
+  }
+  return events;
+}
+
+folly::dynamic WarmBootTimeline::toFollyDynamic(bool exitOnly) const {
+  folly::dynamic events = folly::dynamic::object;
+  for (const auto& event : getEvents()) {
+    if (!exitOnly || isExitEvent(event.first)) {
+      events[eventName(event.first).str()] = event.second;
+    }
+  }
+  return events;
+}
+
+bool WarmBootTimeline::saveExit(const std::string& filename) const {
+  return dumpStateToFile(filename, toFollyDynamic(true));
+}
+
+void WarmBootTimeline::loadPreviousExit(const std::string& filename) {
+  std::string contents;
+  if (!folly::readFile(filename.c_str(), contents)) {
+    XLOG(INFO) << "No warm boot timeline of the previous exit in "
+               << filename;
+    return;
+  }
+  unlink(filename.c_str());
+  folly::dynamic events;
+  try {
+    events = folly::parseJson(contents);
+  } catch (const std::exception& ex) {
+    XLOG(ERR) << "Bad warm boot timeline in " << filename << ": "
+              << ex.what();
+    return;
+  }
+  std::lock_guard<std::mutex> guard(lock_);
+  for (size_t idx = 0; idx < kNumEvents; ++idx) {
+    auto event = static_cast<Event>(idx);
+    auto time = events.get_ptr(eventName(event).str());
+    if (isExitEvent(event) && time && time->isInt()) {
+      events_[idx] = time->asInt();
+    }
+  }
+}
+
+void WarmBootTimeline::publish() const {
+  auto events = getEvents();
+  if (events.empty() || events.front().first != Event::GRACEFUL_EXIT_START) {
+    return;
+  }
+  auto exitStart = events.front().second;
+  for (const auto& event : events) {
+    auto ms = (event.second - exitStart) / 1000;
+    XLOG(INFO) << "[Warm boot] " << eventName(event.first) << " at " << ms
+               << "ms";
+    fbData->setCounter(
+        folly::to<std::string>("warm_boot.", eventName(event.first), ".ms"),
+        ms);
+    if (event.first == Event::FIB_SYNCED) {
+      fbData->setCounter("warm_boot.control_plane_downtime.ms", ms);
+    }
+  }
+}
+
+}} // facebook::fboss
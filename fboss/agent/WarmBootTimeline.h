@@ -0,0 +1,99 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#pragma once
+
+#include <folly/Optional.h>
+#include <folly/Range.h>
+#include <folly/dynamic.h>
+
+#include <array>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace facebook { namespace fboss {
+
+/*
+ * WarmBootTimeline records when each step of a warm boot happens, from the
+ * old agent starting its graceful exit to the new one having synced its
+ * FIB, so we can tell how long the control plane was out.
+ *
+ * The times are wall clock times, since they span two processes.  The old
+ * agent saves its exit events next to the warm boot state, and the new one
+ * loads them on warm boot, so the timeline of a warm boot lives in the
+ * stats of the boot that follows it.
+ */
+class WarmBootTimeline {
+ public:
+  enum class Event {
+    GRACEFUL_EXIT_START,
+    STATE_FILE_WRITTEN,
+    PROCESS_START,
+    WARM_BOOT_CACHE_POPULATED,
+    HOST_ENTRIES_SYNCED,
+    INITIAL_CONFIG_APPLIED,
+    FIB_SYNCED,
+  };
+  static constexpr size_t kNumEvents =
+      static_cast<size_t>(Event::FIB_SYNCED) + 1;
+
+  /*
+   * The timeline of this process, created on first use.
+   */
+  static WarmBootTimeline* get();
+
+  WarmBootTimeline() {}
+
+  static folly::StringPiece eventName(Event event);
+
+  /*
+   * Records the time of the event.  Only the first time counts, so an
+   * event that may happen again, like a FIB sync, marks the first one.
+   */
+  void mark(Event event);
+
+  /*
+   * The events recorded so far, as microseconds since the epoch, in the
+   * order of the Event enum.
+   */
+  std::vector<std::pair<Event, int64_t>> getEvents() const;
+
+  /*
+   * Saves the exit events, for the next boot to load.
+   */
+  bool saveExit(const std::string& filename) const;
+
+  /*
+   * Loads the exit events the previous agent saved, and removes the file
+   * so a later boot does not take them for its own.
+   */
+  void loadPreviousExit(const std::string& filename);
+
+  /*
+   * Sets a warm_boot.<event>.ms counter for each event, relative to the
+   * start of the graceful exit, and warm_boot.control_plane_downtime.ms
+   * from there to the FIB sync.  Nothing is set without the exit events.
+   */
+  void publish() const;
+
+ private:
+  // Forbidden copy constructor and assignment operator
+  WarmBootTimeline(WarmBootTimeline const &) = delete;
+  WarmBootTimeline& operator=(WarmBootTimeline const &) = delete;
+
+  folly::dynamic toFollyDynamic(bool exitOnly) const;
+
+  mutable std::mutex lock_;
+  std::array<folly::Optional<int64_t>, kNumEvents> events_;
+};
+
+}} // facebook::fboss
@@ -0,0 +1,382 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "fboss/agent/capture/BpfProgram.h"
+
+#include "fboss/agent/FbossError.h"
+
+namespace {
+
+// Instruction classes
+constexpr uint16_t kLd = 0x00;
+constexpr uint16_t kLdx = 0x01;
+constexpr uint16_t kSt = 0x02;
+constexpr uint16_t kStx = 0x03;
+constexpr uint16_t kAlu = 0x04;
+constexpr uint16_t kJmp = 0x05;
+constexpr uint16_t kRet = 0x06;
+constexpr uint16_t kMisc = 0x07;
+
+// Load sizes
+constexpr uint16_t kW = 0x00;
+constexpr uint16_t kH = 0x08;
+constexpr uint16_t kB = 0x10;
+
+// Load modes
+constexpr uint16_t kImm = 0x00;
+constexpr uint16_t kAbs = 0x20;
+constexpr uint16_t kInd = 0x40;
+constexpr uint16_t kMem = 0x60;
+constexpr uint16_t kLen = 0x80;
+constexpr uint16_t kMsh = 0xa0;
+
+// ALU operations
+constexpr uint16_t kAdd = 0x00;
+constexpr uint16_t kSub = 0x10;
+constexpr uint16_t kMul = 0x20;
+constexpr uint16_t kDiv = 0x30;
+constexpr uint16_t kOr = 0x40;
+constexpr uint16_t kAnd = 0x50;
+constexpr uint16_t kLsh = 0x60;
+constexpr uint16_t kRsh = 0x70;
+constexpr uint16_t kNeg = 0x80;
+constexpr uint16_t kMod = 0x90;
+constexpr uint16_t kXor = 0xa0;
+
+// Jump conditions
+constexpr uint16_t kJa = 0x00;
+constexpr uint16_t kJeq = 0x10;
+constexpr uint16_t kJgt = 0x20;
+constexpr uint16_t kJge = 0x30;
+constexpr uint16_t kJset = 0x40;
+
+// Operand sources
+constexpr uint16_t kK = 0x00;
+constexpr uint16_t kX = 0x08;
+constexpr uint16_t kA = 0x10;
+
+// Register transfers
+constexpr uint16_t kTax = 0x00;
+constexpr uint16_t kTxa = 0x80;
+
+uint16_t opClass(uint16_t code) {
+  return code & 0x07;
+}
+uint16_t opSize(uint16_t code) {
+  return code & 0x18;
+}
+uint16_t opMode(uint16_t code) {
+  return code & 0xe0;
+}
+uint16_t opAlu(uint16_t code) {
+  return code & 0xf0;
+}
+uint16_t opSource(uint16_t code) {
+  return code & 0x08;
+}
+uint16_t opRetValue(uint16_t code) {
+  return code & 0x18;
+}
+uint16_t opMisc(uint16_t code) {
+  return code & 0xf8;
+}
+
+// Load size bytes big-endian from offset, if the packet holds them
+bool load(folly::ByteRange data, uint64_t offset, uint16_t size,
+          uint32_t* value) {
+  size_t width = size == kW ? 4 : (size == kH ? 2 : 1);
+  if (offset + width > data.size()) {
+    return false;
+  }
+  uint32_t result = 0;
+  for (size_t idx = 0; idx < width; ++idx) {
+    result = (result << 8) | data[offset + idx];
+  }
+  *value = result;
+  return true;
+}
+
+}
+
+namespace facebook { namespace fboss {
+
+constexpr size_t BpfProgram::kMaxInstructions;
+constexpr size_t BpfProgram::kMemWords;
+constexpr size_t BpfMatchCache::kMaxResults;
+
+BpfProgram::BpfProgram(std::vector<Instruction> instructions)
+    : instructions_(std::move(instructions)) {
+  validate();
+}
+
+std::shared_ptr<const BpfProgram> BpfProgram::fromThrift(
+    const std::vector<BpfInstruction>& instructions) {
+  std::vector<Instruction> program;
+  program.reserve(instructions.size());
+  for (const auto& thriftInsn : instructions) {
+    if (thriftInsn.code < 0 || thriftInsn.code > 0xffff ||
+        thriftInsn.jt < 0 || thriftInsn.jt > 0xff ||
+        thriftInsn.jf < 0 || thriftInsn.jf > 0xff ||
+        thriftInsn.k < 0 || thriftInsn.k > 0xffffffff) {
+      throw FbossError("BPF instruction ", program.size(), " out of range");
+    }
+    Instruction insn;
+    insn.code = thriftInsn.code;
+    insn.jt = thriftInsn.jt;
+    insn.jf = thriftInsn.jf;
+    insn.k = thriftInsn.k;
+    program.push_back(insn);
+  }
+  return std::make_shared<BpfProgram>(std::move(program));
+}
+
+void BpfProgram::validate() const {
+  auto len = instructions_.size();
+  if (len == 0 || len > kMaxInstructions) {
+    throw FbossError("BPF program of ", len, " instructions, must have 1-",
+                     kMaxInstructions);
+  }
+  for (size_t pc = 0; pc < len; ++pc) {
+    const auto& insn = instructions_[pc];
+    auto code = insn.code;
+    bool valid = code <= 0xff;
+    switch (valid ? opClass(code) : kMisc) {
+      case kLd:
+      case kLdx:
+        if (opClass(code) == kLdx) {
+          valid = code == (kLdx | kW | kImm) || code == (kLdx | kW | kMem) ||
+              code == (kLdx | kW | kLen) || code == (kLdx | kB | kMsh);
+        } else {
+          auto mode = opMode(code);
+          valid = (mode == kAbs || mode == kInd) ?
+              opSize(code) != 0x18 :
+              (code == (kLd | kW | kImm) || code == (kLd | kW | kMem) ||
+               code == (kLd | kW | kLen));
+        }
+        if (valid && opMode(code) == kMem && insn.k >= kMemWords) {
+          valid = false;
+        }
+        break;
+      case kSt:
+      case kStx:
+        valid = (code & ~0x07) == 0 && insn.k < kMemWords;
+        break;
+      case kAlu: {
+        auto op = opAlu(code);
+        valid = (code & 0x07) == kAlu && op <= kXor &&
+            (op != kNeg || opSource(code) == kK);
+        if (valid && opSource(code) == kK && (op == kDiv || op == kMod) &&
+            insn.k == 0) {
+          throw FbossError("BPF instruction ", pc, " divides by zero");
+        }
+        break;
+      }
+      case kJmp: {
+        auto op = opAlu(code);
+        if (op == kJa) {
+          valid = opSource(code) == kK &&
+              uint64_t(pc) + 1 + insn.k < len;
+        } else {
+          valid = op <= kJset &&
+              pc + 1 + insn.jt < len && pc + 1 + insn.jf < len;
+        }
+        break;
+      }
+      case kRet:
+        valid = (code & ~0x07) == kK || (code & ~0x07) == kX ||
+            (code & ~0x07) == kA;
+        break;
+      case kMisc:
+        valid = valid && (opMisc(code) == kTax || opMisc(code) == kTxa);
+        break;
+    }
+    if (!valid) {
+      throw FbossError("invalid BPF instruction ", pc, ": code ", code,
+                       " k ", insn.k);
+    }
+  }
+  if (opClass(instructions_.back().code) != kRet) {
+    throw FbossError("BPF program does not end in a return");
+  }
+}
+
+uint32_t BpfProgram::run(folly::ByteRange data, uint32_t wireLength) const {
+  uint32_t a = 0;
+  uint32_t x = 0;
+  std::array<uint32_t, kMemWords> mem{};
+  size_t pc = 0;
+  // validate() makes sure the jumps stay in the program, and that it ends in
+  // a return, so this never runs off the end.
+  while (true) {
+    const auto& insn = instructions_[pc++];
+    auto code = insn.code;
+    switch (opClass(code)) {
+      case kLd:
+        switch (opMode(code)) {
+          case kAbs:
+            if (!load(data, insn.k, opSize(code), &a)) {
+              return 0;
+            }
+            break;
+          case kInd:
+            if (!load(data, uint64_t(insn.k) + x, opSize(code), &a)) {
+              return 0;
+            }
+            break;
+          case kImm:
+            a = insn.k;
+            break;
+          case kMem:
+            a = mem[insn.k];
+            break;
+          case kLen:
+            a = wireLength;
+            break;
+        }
+        break;
+      case kLdx:
+        switch (opMode(code)) {
+          case kImm:
+            x = insn.k;
+            break;
+          case kMem:
+            x = mem[insn.k];
+            break;
+          case kLen:
+            x = wireLength;
+            break;
+          case kMsh:
+            if (insn.k >= data.size()) {
+              return 0;
+            }
+            x = (data[insn.k] & 0xf) << 2;
+            break;
+        }
+        break;
+      case kSt:
+        mem[insn.k] = a;
+        break;
+      case kStx:
+        mem[insn.k] = x;
+        break;
+      case kAlu: {
+        auto operand = opSource(code) == kX ? x : insn.k;
+        switch (opAlu(code)) {
+          case kAdd:
+            a += operand;
+            break;
+          case kSub:
+            a -= operand;
+            break;
+          case kMul:
+            a *= operand;
+            break;
+          case kDiv:
+            if (operand == 0) {
+              return 0;
+            }
+            a /= operand;
+            break;
+          case kMod:
+            if (operand == 0) {
+              return 0;
+            }
+            a %= operand;
+            break;
+          case kOr:
+            a |= operand;
+            break;
+          case kAnd:
+            a &= operand;
+            break;
+          case kXor:
+            a ^= operand;
+            break;
+          case kLsh:
+            a = operand < 32 ? a << operand : 0;
+            break;
+          case kRsh:
+            a = operand < 32 ? a >> operand : 0;
+            break;
+          case kNeg:
+            a = -a;
+            break;
+        }
+        break;
+      }
+      case kJmp: {
+        auto operand = opSource(code) == kX ? x : insn.k;
+        bool taken = false;
+        switch (opAlu(code)) {
+          case kJa:
+            pc += insn.k;
+            continue;
+          case kJeq:
+            taken = a == operand;
+            break;
+          case kJgt:
+            taken = a > operand;
+            break;
+          case kJge:
+            taken = a >= operand;
+            break;
+          case kJset:
+            taken = (a & operand) != 0;
+            break;
+        }
+        pc += taken ? insn.jt : insn.jf;
+        break;
+      }
+      case kRet:
+        if (opRetValue(code) == kA) {
+          return a;
+        }
+        return opRetValue(code) == kX ? x : insn.k;
+      case kMisc:
+        if (opMisc(code) == kTax) {
+          x = a;
+        } else {
+          a = x;
+        }
+        break;
+    }
+  }
+}
+
+bool BpfMatchCache::matches(const BpfProgram* program) {
+  if (!program) {
+    return true;
+  }
+  for (size_t idx = 0; idx < numResults_; ++idx) {
+    if (results_[idx].program == program) {
+      return results_[idx].matched;
+    }
+  }
+  auto data = getData();
+  bool matched = program->run(data, data.size()) != 0;
+  if (numResults_ < kMaxResults) {
+    results_[numResults_].program = program;
+    results_[numResults_].matched = matched;
+    ++numResults_;
+  }
+  return matched;
+}
+
+folly::ByteRange BpfMatchCache::getData() {
+  if (!buf_->isChained()) {
+    return folly::ByteRange(buf_->data(), buf_->length());
+  }
+  if (!coalesced_) {
+    coalesced_ = buf_->clone();
+    coalesced_->coalesce();
+  }
+  return folly::ByteRange(coalesced_->data(), coalesced_->length());
+}
+
+}} // facebook::fboss
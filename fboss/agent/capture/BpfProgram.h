@@ -0,0 +1,115 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#pragma once
+
+#include "fboss/agent/if/gen-cpp2/ctrl_types.h"
+
+#include <folly/Range.h>
+#include <folly/io/IOBuf.h>
+
+#include <array>
+#include <memory>
+#include <vector>
+
+namespace facebook { namespace fboss {
+
+/*
+ * A classic BPF program, for filtering the packets captured.
+ *
+ * The agent doesn't link libpcap, so capture filters are compiled by the
+ * client, e.g. with tcpdump -dd 'expression', and only interpreted here.  The
+ * program is checked when it is created the same way the kernel checks one
+ * that is attached to a socket: the jumps only go forwards and stay within
+ * the program, and it ends in a return, so it always terminates.
+ *
+ * Programs see each packet starting from its ethernet header, including any
+ * 802.1q tag, as it is written to the capture file.
+ */
+class BpfProgram {
+ public:
+  struct Instruction {
+    uint16_t code{0};
+    uint8_t jt{0};
+    uint8_t jf{0};
+    uint32_t k{0};
+
+    bool operator==(const Instruction& other) const {
+      return code == other.code && jt == other.jt && jf == other.jf &&
+          k == other.k;
+    }
+  };
+
+  // The same limits as the kernel's
+  static constexpr size_t kMaxInstructions = 4096;
+  static constexpr size_t kMemWords = 16;
+
+  /*
+   * Throws an FbossError if the program is not valid.
+   */
+  explicit BpfProgram(std::vector<Instruction> instructions);
+
+  static std::shared_ptr<const BpfProgram> fromThrift(
+      const std::vector<BpfInstruction>& instructions);
+
+  /*
+   * Run the program against the data captured from a packet of wireLength
+   * bytes.  Return the number of bytes of the packet the program accepts,
+   * which is 0 if it rejects the packet.
+   */
+  uint32_t run(folly::ByteRange data, uint32_t wireLength) const;
+
+  const std::vector<Instruction>& instructions() const {
+    return instructions_;
+  }
+
+  bool operator==(const BpfProgram& other) const {
+    return instructions_ == other.instructions_;
+  }
+
+ private:
+  void validate() const;
+
+  std::vector<Instruction> instructions_;
+};
+
+/*
+ * The results of running the capture filters against one packet.
+ *
+ * Captures with the same filter share one BpfProgram, so each distinct
+ * program is run just once per packet however many captures use it, and the
+ * packet is only made contiguous if a program needs to look at it.
+ */
+class BpfMatchCache {
+ public:
+  explicit BpfMatchCache(const folly::IOBuf* buf) : buf_(buf) {}
+
+  /*
+   * Whether the program accepts the packet.  A null program accepts
+   * everything.
+   */
+  bool matches(const BpfProgram* program);
+
+ private:
+  static constexpr size_t kMaxResults = 8;
+
+  struct Result {
+    const BpfProgram* program{nullptr};
+    bool matched{false};
+  };
+
+  folly::ByteRange getData();
+
+  const folly::IOBuf* buf_{nullptr};
+  std::unique_ptr<folly::IOBuf> coalesced_;
+  std::array<Result, kMaxResults> results_;
+  size_t numResults_{0};
+};
+
+}} // facebook::fboss
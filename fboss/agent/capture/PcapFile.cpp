@@ -11,19 +11,106 @@
 
 #include "fboss/agent/capture/PcapPkt.h"
 
+#include <folly/Conv.h>
 #include <folly/Exception.h>
 #include <folly/FileUtil.h>
+#include <folly/io/Cursor.h>
+#include <folly/logging/xlog.h>
 
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
 #include <chrono>
 
-using folly::IOBuf;
 using folly::writeFull;
-using folly::writevFull;
 using std::chrono::microseconds;
+using std::chrono::nanoseconds;
 using std::chrono::seconds;
 
+namespace {
+
+// pcapng block types and options
+constexpr uint32_t kSectionHeaderBlock = 0x0a0d0d0a;
+constexpr uint32_t kInterfaceDescriptionBlock = 1;
+constexpr uint32_t kEnhancedPacketBlock = 6;
+constexpr uint32_t kByteOrderMagic = 0x1a2b3c4d;
+constexpr uint16_t kOptEndOfOpt = 0;
+constexpr uint16_t kOptIfName = 2;
+constexpr uint16_t kOptIfTsResol = 9;
+constexpr uint16_t kOptEpbFlags = 2;
+constexpr uint32_t kEpbFlagsInbound = 1;
+constexpr uint32_t kEpbFlagsOutbound = 2;
+// Timestamps are in nanoseconds
+constexpr uint8_t kTsResolNsec = 9;
+
+// Link type 1 is ethernet.  Other possible types we might want to use
+// include 113 for linux "cooked" capture format.
+constexpr uint16_t kLinkTypeEthernet = 1;
+
+size_t roundUp(size_t length, size_t alignment) {
+  return (length + alignment - 1) / alignment * alignment;
+}
+
+template<typename T>
+uint8_t* put(uint8_t* dest, T value) {
+  memcpy(dest, &value, sizeof(value));
+  return dest + sizeof(value);
+}
+
+uint8_t* putOption(uint8_t* dest, uint16_t code, folly::ByteRange value) {
+  dest = put<uint16_t>(dest, code);
+  dest = put<uint16_t>(dest, value.size());
+  memcpy(dest, value.data(), value.size());
+  auto padded = roundUp(value.size(), 4);
+  memset(dest + value.size(), 0, padded - value.size());
+  return dest + padded;
+}
+
+size_t optionLength(size_t valueLength) {
+  return 4 + roundUp(valueLength, 4);
+}
+
+std::string interfaceName(facebook::fboss::PortID port) {
+  return folly::to<std::string>("port", static_cast<uint32_t>(port));
+}
+
+uint32_t interfaceLength(const std::string& name) {
+  return 16 + optionLength(name.size()) + optionLength(1) +
+    optionLength(0) + 4;
+}
+
+}
+
 namespace facebook { namespace fboss {
 
+constexpr size_t PcapFile::kAlignment;
+
+PcapBlock::PcapBlock(size_t capacity)
+  : capacity_(roundUp(std::max<size_t>(capacity, 1), PcapFile::kAlignment)) {
+  void* data;
+  int ret = posix_memalign(&data, PcapFile::kAlignment, capacity_);
+  if (ret != 0) {
+    folly::throwSystemErrorExplicit(ret, "failed to allocate pcap block");
+  }
+  data_ = static_cast<uint8_t*>(data);
+}
+
+PcapBlock::~PcapBlock() {
+  free(data_);
+}
+
+uint8_t* PcapBlock::append(size_t n) {
+  if (n > capacity_ - length_) {
+    return nullptr;
+  }
+  auto start = data_ + length_;
+  length_ += n;
+  return start;
+}
+
 PcapFile::PktHeader::PktHeader(const PcapPkt& pkt) {
   auto ts = pkt.timestamp().time_since_epoch();
   seconds tsSec = std::chrono::duration_cast<seconds>(ts);
@@ -33,15 +120,32 @@ PcapFile::PktHeader::PktHeader(const PcapPkt& pkt) {
   timeSec = tsSec.count();
   timeUsec = (tsUsec - tsSec).count();
   includedLen = len;
-  origLen = len;
+  origLen = std::max<uint32_t>(len, pkt.origLength());
 }
 
 PcapFile::PcapFile() {
 }
 
 PcapFile::PcapFile(folly::StringPiece path,
-                   bool overwriteExisting)
-  : file_(path.str().c_str(), openFlags(overwriteExisting), 0644) {
+                   bool overwriteExisting,
+                   PcapFormat format,
+                   bool directIo)
+  : file_(path.str().c_str(), openFlags(overwriteExisting), 0644),
+    format_(format),
+    directIo_(directIo) {
+  if (!directIo_) {
+    return;
+  }
+  int flags = fcntl(file_.fd(), F_GETFL);
+  folly::checkUnixError(flags, "error getting pcap file flags");
+  if (fcntl(file_.fd(), F_SETFL, flags | O_DIRECT) != 0) {
+    if (errno != EINVAL) {
+      folly::throwSystemError("error enabling direct I/O for ", path);
+    }
+    // tmpfs, for instance, can only be written through the page cache
+    XLOG(WARN) << "direct I/O is not supported for " << path;
+    directIo_ = false;
+  }
 }
 
 PcapFile::~PcapFile() {
@@ -51,7 +155,25 @@ void PcapFile::close() {
   file_.close();
 }
 
-void PcapFile::writeGlobalHeader() {
+bool PcapFile::writeGlobalHeader(PcapBlock* block) {
+  if (format_ == PcapFormat::PCAPNG) {
+    // A section header block, with the section length unknown
+    constexpr uint32_t kLength = 28;
+    auto dest = block->append(kLength);
+    if (!dest) {
+      return false;
+    }
+    dest = put<uint32_t>(dest, kSectionHeaderBlock);
+    dest = put<uint32_t>(dest, kLength);
+    dest = put<uint32_t>(dest, kByteOrderMagic);
+    dest = put<uint16_t>(dest, 1);
+    dest = put<uint16_t>(dest, 0);
+    dest = put<int64_t>(dest, -1);
+    put<uint32_t>(dest, kLength);
+    interfaces_.clear();
+    return true;
+  }
+
   struct GlobalHeader {
     uint32_t magic;
     uint16_t versionMajor;
@@ -67,38 +189,124 @@ void PcapFile::writeGlobalHeader() {
   hdr.tzOffset = 0;
   hdr.sigfigs = 0;
   hdr.snaplen = 0xffff;
-  // Link type 1 is ethernet.  Other possible types we might want to use
-  // include 113 for linux "cooked" capture format.
-  hdr.linkType = 1;
-
-  int ret = writeFull(file_.fd(), &hdr, sizeof(hdr));
-  folly::checkUnixError(ret, "error writing pcap global header");
-}
-
-void PcapFile::writePackets(const std::vector<PcapPkt>& pkts) {
-  folly::fbvector<PktHeader> hdrs;
-  hdrs.reserve(pkts.size());
-  folly::fbvector<struct iovec> iov;
-  // Reserve enough space, assuming each packet is in a single IOBuf.
-  // If some packets are split across IOBuf chains then we will end up
-  // allocating more space as needed in the loop below.
-  iov.reserve(pkts.size() * 2);
-
-  // Build iovecs for all of the packet headers and data
-  for (const auto& pkt : pkts) {
-    hdrs.emplace_back(pkt);
-    PktHeader* curHdr = &hdrs.back();
-    iov.push_back({(void*)curHdr, sizeof(PktHeader)});
-    pkt.buf()->appendToIov(&iov);
+  hdr.linkType = kLinkTypeEthernet;
+
+  auto dest = block->append(sizeof(hdr));
+  if (!dest) {
+    return false;
+  }
+  memcpy(dest, &hdr, sizeof(hdr));
+  return true;
+}
+
+bool PcapFile::writePacket(const PcapPkt& pkt, PcapBlock* block) {
+  if (format_ == PcapFormat::PCAPNG) {
+    return writePcapngPacket(pkt, block);
+  }
+  return writePcapPacket(pkt, block);
+}
+
+bool PcapFile::writePcapPacket(const PcapPkt& pkt, PcapBlock* block) {
+  PktHeader hdr(pkt);
+  auto dest = block->append(sizeof(hdr) + hdr.includedLen);
+  if (!dest) {
+    return false;
+  }
+  dest = put(dest, hdr);
+  folly::io::Cursor(pkt.buf()).pull(dest, hdr.includedLen);
+  return true;
+}
+
+bool PcapFile::writePcapngPacket(const PcapPkt& pkt, PcapBlock* block) {
+  // Each port becomes an interface the first time it has a packet, and the
+  // interface has to come before the packet in the file
+  auto it = interfaces_.find(pkt.port());
+  bool newInterface = it == interfaces_.end();
+  auto name = newInterface ? interfaceName(pkt.port()) : std::string();
+
+  uint32_t capLen = pkt.buf()->computeChainDataLength();
+  uint32_t origLen = std::max(capLen, pkt.origLength());
+  uint32_t length = 28 + roundUp(capLen, 4) + optionLength(4) +
+    optionLength(0) + 4;
+  auto needed = length + (newInterface ? interfaceLength(name) : 0);
+  if (needed > block->capacity() - block->length()) {
+    return false;
   }
 
-  int ret = writevFull(file_.fd(), iov.data(), iov.size());
-  folly::checkUnixError(ret, "error writing pcap data");
+  uint32_t interfaceID;
+  if (newInterface) {
+    interfaceID = interfaces_.size();
+    writeInterface(name, block);
+    interfaces_.emplace(pkt.port(), interfaceID);
+  } else {
+    interfaceID = it->second;
+  }
+
+  uint64_t ts = std::chrono::duration_cast<nanoseconds>(
+      pkt.timestamp().time_since_epoch()).count();
+  auto dest = block->append(length);
+  dest = put<uint32_t>(dest, kEnhancedPacketBlock);
+  dest = put<uint32_t>(dest, length);
+  dest = put<uint32_t>(dest, interfaceID);
+  dest = put<uint32_t>(dest, ts >> 32);
+  dest = put<uint32_t>(dest, ts & 0xffffffff);
+  dest = put<uint32_t>(dest, capLen);
+  dest = put<uint32_t>(dest, origLen);
+  folly::io::Cursor(pkt.buf()).pull(dest, capLen);
+  memset(dest + capLen, 0, roundUp(capLen, 4) - capLen);
+  dest += roundUp(capLen, 4);
+  uint32_t flags = pkt.isRx() ? kEpbFlagsInbound : kEpbFlagsOutbound;
+  dest = putOption(dest, kOptEpbFlags,
+                   folly::ByteRange(reinterpret_cast<uint8_t*>(&flags),
+                                    sizeof(flags)));
+  dest = putOption(dest, kOptEndOfOpt, folly::ByteRange());
+  put<uint32_t>(dest, length);
+  return true;
+}
+
+void PcapFile::writeInterface(const std::string& name, PcapBlock* block) {
+  auto length = interfaceLength(name);
+  auto dest = block->append(length);
+  DCHECK(dest);
+  dest = put<uint32_t>(dest, kInterfaceDescriptionBlock);
+  dest = put<uint32_t>(dest, length);
+  dest = put<uint16_t>(dest, kLinkTypeEthernet);
+  dest = put<uint16_t>(dest, 0);
+  // No snap length limit
+  dest = put<uint32_t>(dest, 0);
+  dest = putOption(dest, kOptIfName,
+                   folly::ByteRange(folly::StringPiece(name)));
+  dest = putOption(dest, kOptIfTsResol, folly::ByteRange(&kTsResolNsec, 1));
+  dest = putOption(dest, kOptEndOfOpt, folly::ByteRange());
+  put<uint32_t>(dest, length);
+}
+
+void PcapFile::write(PcapBlock* block, size_t length, bool last) {
+  DCHECK_LE(length, block->length());
+  auto writeLength = length;
+  if (directIo_ && last) {
+    // The block's capacity is aligned, so there is always room to pad it
+    writeLength = roundUp(length, kAlignment);
+    memset(block->data() + length, 0, writeLength - length);
+  }
+  DCHECK(!directIo_ || writeLength % kAlignment == 0);
+
+  if (writeLength > 0) {
+    int ret = writeFull(file_.fd(), block->data(), writeLength);
+    folly::checkUnixError(ret, "error writing pcap data");
+  }
+  length_ += length;
+  if (writeLength != length) {
+    int ret = ftruncate(file_.fd(), length_);
+    folly::checkUnixError(ret, "error truncating pcap file");
+  }
 }
 
 int PcapFile::openFlags(bool overwriteExisting) {
   int flags = O_CREAT | O_WRONLY;
-  if (!overwriteExisting) {
+  if (overwriteExisting) {
+    flags |= O_TRUNC;
+  } else {
     flags |= O_EXCL;
   }
   return flags;
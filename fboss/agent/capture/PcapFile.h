@@ -9,16 +9,70 @@
  */
 #pragma once
 
+#include "fboss/agent/types.h"
+
 #include <folly/File.h>
 #include <folly/Range.h>
+#include <map>
+#include <string>
 #include <vector>
 
 namespace facebook { namespace fboss {
 
 class PcapPkt;
 
+enum class PcapFormat : uint8_t {
+  PCAP,
+  // pcapng, with an interface for each port and the direction of each packet
+  PCAPNG,
+};
+
 /*
- * PcapFile supports writing packets to a file in pcap format.
+ * A buffer of data waiting to be written to a pcap file.
+ *
+ * The buffer is aligned in memory, and its capacity rounded up to
+ * PcapFile::kAlignment, so that it can be written with O_DIRECT.
+ */
+class PcapBlock {
+ public:
+  explicit PcapBlock(size_t capacity);
+  ~PcapBlock();
+
+  uint8_t* data() {
+    return data_;
+  }
+  size_t length() const {
+    return length_;
+  }
+  size_t capacity() const {
+    return capacity_;
+  }
+
+  /*
+   * Reserve n more bytes at the end of the block, and return where they
+   * start, or nullptr if the block doesn't have room for them.
+   */
+  uint8_t* append(size_t n);
+  void clear() {
+    length_ = 0;
+  }
+
+ private:
+  // Forbidden copy constructor and assignment operator
+  PcapBlock(PcapBlock const &) = delete;
+  PcapBlock& operator=(PcapBlock const &) = delete;
+
+  uint8_t* data_{nullptr};
+  size_t capacity_{0};
+  size_t length_{0};
+};
+
+/*
+ * PcapFile supports writing packets to a file in pcap or pcapng format.
+ *
+ * Packets are first encoded into a PcapBlock, and blocks are then written
+ * out whole, so that the file sees a few large writes rather than one per
+ * packet, and those can bypass the page cache with O_DIRECT.
  *
  * PcapFile uses blocking I/O.  If you are recording packets from a
  * non-blocking thread, you should use PcapWriter instead of using PcapFile
@@ -26,14 +80,44 @@ class PcapPkt;
  */
 class PcapFile {
  public:
+  // The alignment O_DIRECT needs for the offset, length and memory of each
+  // write.  This is the largest logical block size of the devices we capture
+  // to, so covers all of them.
+  static constexpr size_t kAlignment = 4096;
+
   PcapFile();
-  explicit PcapFile(folly::StringPiece path, bool overwriteExisting = false);
+  /*
+   * If directIo is true the file is written with O_DIRECT, unless the
+   * filesystem doesn't support it.
+   */
+  explicit PcapFile(folly::StringPiece path, bool overwriteExisting = false,
+                    PcapFormat format = PcapFormat::PCAP,
+                    bool directIo = false);
   ~PcapFile();
 
-  void close();
+  PcapFormat format() const {
+    return format_;
+  }
+  bool isDirectIo() const {
+    return directIo_;
+  }
 
-  void writeGlobalHeader();
-  void writePackets(const std::vector<PcapPkt>& pkt);
+  /*
+   * Encode the file header, or a packet, at the end of the block.  Return
+   * false, leaving the block as it was, if it doesn't have room.
+   */
+  bool writeGlobalHeader(PcapBlock* block);
+  bool writePacket(const PcapPkt& pkt, PcapBlock* block);
+
+  /*
+   * Write the first length bytes of the block to the file.
+   *
+   * With direct I/O the length must be a multiple of kAlignment, other than
+   * for the last block of the file.  That one is padded out for the write,
+   * and the file truncated back to its real length afterwards.
+   */
+  void write(PcapBlock* block, size_t length, bool last = false);
+  void close();
 
   // Move constructor and assignment operator
   PcapFile(PcapFile&&) = default;
@@ -55,7 +139,16 @@ class PcapFile {
 
   static int openFlags(bool overwriteExisting);
 
+  bool writePcapPacket(const PcapPkt& pkt, PcapBlock* block);
+  bool writePcapngPacket(const PcapPkt& pkt, PcapBlock* block);
+  void writeInterface(const std::string& name, PcapBlock* block);
+
   folly::File file_;
+  PcapFormat format_{PcapFormat::PCAP};
+  bool directIo_{false};
+  uint64_t length_{0};
+  // The pcapng interface ID of each port seen so far
+  std::map<PortID, uint32_t> interfaces_;
 };
 
 }} // facebook::fboss
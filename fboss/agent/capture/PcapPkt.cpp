@@ -82,4 +82,16 @@ PcapPkt::PcapPkt(const TxPacketData* pkt, TimePoint timestamp)
                                              pkt->packetData.size()));
 }
 
+PcapPkt::PcapPkt(bool rx, PortID port, VlanID vlan, TimePoint timestamp,
+                 folly::ByteRange data, uint32_t origLength)
+  : initialized_(true),
+    rx_(rx),
+    port_(port),
+    vlan_(vlan),
+    timestamp_(timestamp),
+    buf_(folly::IOBuf::COPY_BUFFER, data.data(), data.size()),
+    origLength_(origLength > data.size() ? origLength : 0),
+    reasons_() {
+}
+
 }} // facebook::fboss
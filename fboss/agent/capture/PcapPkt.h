@@ -11,6 +11,7 @@
 
 #include <chrono>
 #include <vector>
+#include <folly/Range.h>
 #include <folly/io/IOBuf.h>
 #include "fboss/agent/types.h"
 #include "fboss/pcap_distribution_service/if/gen-cpp2/pcap_pubsub_types.h"
@@ -58,6 +59,13 @@ class PcapPkt {
   explicit PcapPkt(const TxPacketData* pkt);
   PcapPkt(const TxPacketData* pkt, TimePoint timestamp);
 
+  /*
+   * Create a PcapPkt from a copy of the bytes captured, which may have been
+   * truncated from a packet of origLength bytes
+   */
+  PcapPkt(bool rx, PortID port, VlanID vlan, TimePoint timestamp,
+          folly::ByteRange data, uint32_t origLength);
+
   bool initialized() const {
     return initialized_;
   }
@@ -79,7 +87,14 @@ class PcapPkt {
   const folly::IOBuf* buf() const {
     return &buf_;
   }
-  std::vector<RxReason> getReasons(){
+  /*
+   * The length of the packet on the wire, if buf() was truncated from it,
+   * or 0 otherwise
+   */
+  uint32_t origLength() const {
+    return origLength_;
+  }
+  const std::vector<RxReason>& getReasons() const {
     return reasons_;
   }
 
@@ -96,6 +111,7 @@ class PcapPkt {
     vlan_ = other.vlan_;
     timestamp_ = other.timestamp_;
     buf_ = std::move(other.buf_);
+    origLength_ = other.origLength_;
     reasons_ = std::move(other.reasons_);
     return *this;
   }
@@ -120,6 +136,8 @@ class PcapPkt {
   TimePoint timestamp_;
   // The packet contents, starting from the ethernet header.
   folly::IOBuf buf_;
+  // The length of the packet before it was truncated, if it was
+  uint32_t origLength_{0};
   // Reasons for sending packet to CPU
   std::vector<RxReason> reasons_;
 };
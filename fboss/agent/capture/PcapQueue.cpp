@@ -13,106 +13,124 @@
 #include "fboss/agent/TxPacket.h"
 #include "fboss/agent/capture/PcapPkt.h"
 
+#include <folly/io/Cursor.h>
+
+#include <algorithm>
+
 DEFINE_int32(fboss_pcap_queue_depth, 10240,
              "When taking packet captures, the maximum number of packets "
              "to buffer in memory while waiting them to be written to the "
              "capture file");
+DEFINE_int32(fboss_pcap_snaplen, 1600,
+             "When taking packet captures, the maximum number of bytes of "
+             "each packet to capture");
+
+namespace {
+
+uint32_t numSlots(uint32_t pktCapacity, uint64_t bytesCapacity,
+                  uint32_t snapLen) {
+  if (pktCapacity == 0) {
+    pktCapacity = FLAGS_fboss_pcap_queue_depth;
+  }
+  if (bytesCapacity > 0) {
+    pktCapacity = std::min<uint64_t>(
+        pktCapacity, std::max<uint64_t>(bytesCapacity / snapLen, 1));
+  }
+  return std::max<uint32_t>(pktCapacity, 1);
+}
+
+}
 
 namespace facebook { namespace fboss {
 
 PcapQueue::PcapQueue(uint32_t pktCapacity, uint64_t bytesCapacity)
-  : pktCapacity_(pktCapacity == 0 ?
-                 FLAGS_fboss_pcap_queue_depth : pktCapacity),
-    bytesCapacity_(bytesCapacity) {
-  queue_.reserve(pktCapacity_);
+  : pktCapacity_(numSlots(pktCapacity, bytesCapacity,
+                          std::max(FLAGS_fboss_pcap_snaplen, 1))),
+    snapLen_(std::max(FLAGS_fboss_pcap_snaplen, 1)),
+    buffer_(new uint8_t[uint64_t(pktCapacity_) * snapLen_]),
+    slots_(pktCapacity_),
+    free_(pktCapacity_),
+    filled_(pktCapacity_ + 1) {
+  for (uint32_t idx = 0; idx < pktCapacity_; ++idx) {
+    slots_[idx].data = buffer_.get() + uint64_t(idx) * snapLen_;
+    free_.write(&slots_[idx]);
+  }
+  // Each element of the rings is a slot pointer and its turn sequencer
+  constexpr auto kRingElementBytes = sizeof(Slot*) + sizeof(uint64_t);
+  memoryAccount_.set(
+      uint64_t(pktCapacity_) * snapLen_ +
+      containerMemoryBytes(slots_) +
+      (2 * uint64_t(pktCapacity_) + 1) * kRingElementBytes);
 }
 
 PcapQueue::~PcapQueue() {
 }
 
 template<typename PktType>
-void PcapQueue::addPktInternal(const PktType* pkt) {
-  // Check to see if this would exceed the queue capacity.
-  if (queue_.size() >= pktCapacity_) {
-    pktsDropped_ += 1;
-    return;
-  }
-  auto newBytes = bytesInQueue_ + pkt->buf()->computeChainDataLength();
-  if (bytesCapacity_ > 0 && newBytes >= bytesCapacity_) {
-    pktsDropped_ += 1;
+void PcapQueue::addPktInternal(
+    const PktType* pkt, bool rx, PortID port, VlanID vlan) {
+  Slot* slot;
+  if (!free_.read(slot)) {
+    pktsDropped_.fetch_add(1, std::memory_order_relaxed);
     return;
   }
 
-  queue_.emplace_back(pkt);
+  auto length = pkt->buf()->computeChainDataLength();
+  slot->rx = rx;
+  slot->port = port;
+  slot->vlan = vlan;
+  slot->timestamp = std::chrono::system_clock::now();
+  slot->origLength = length;
+  slot->length = std::min<uint64_t>(length, snapLen_);
+  folly::io::Cursor(pkt->buf()).pull(slot->data, slot->length);
+  filled_.write(slot);
 }
 
 void PcapQueue::addPkt(const RxPacket* pkt) {
-  {
-    std::lock_guard<std::mutex> guard(mutex_);
-    addPktInternal(pkt);
-  }
-  cv_.notify_one();
-}
-
-void PcapQueue::addPktLocked(const RxPacket* pkt) {
-  addPktInternal(pkt);
-  // It is preferred not to be holding the lock when we signal cv_,
-  // but it is okay to call it with the lock held anyway.  (Having the lock
-  // held will just prevent the reader thread from being able to acquire it
-  // immediately when the reader wakes.)
-  cv_.notify_one();
+  addPktInternal(pkt, true, pkt->getSrcPort(), pkt->getSrcVlan());
 }
 
 void PcapQueue::addPkt(const TxPacket* pkt) {
-  {
-    std::lock_guard<std::mutex> guard(mutex_);
-    addPktInternal(pkt);
-  }
-  cv_.notify_one();
-}
-
-void PcapQueue::addPktLocked(const TxPacket* pkt) {
-  addPktInternal(pkt);
-  // It is preferred not to be holding the lock when we signal cv_,
-  // but it is okay to call it with the lock held anyway.  (Having the lock
-  // held will just prevent the reader thread from being able to acquire it
-  // immediately when the reader wakes.)
-  cv_.notify_one();
+  addPktInternal(pkt, false, PortID(0), VlanID(0));
 }
 
 void PcapQueue::finish() {
-  std::lock_guard<std::mutex> guard(mutex_);
-  finished_ = true;
-  cv_.notify_all();
+  if (finished_.exchange(true)) {
+    return;
+  }
+  // Wake up the reader once it has read everything before this.  There is
+  // always room, as the ring has one more place than there are slots.
+  filled_.blockingWrite(nullptr);
 }
 
 bool PcapQueue::isFinished() const {
-  std::lock_guard<std::mutex> guard(mutex_);
-  return finished_;
+  return finished_.load();
 }
 
 uint64_t PcapQueue::numDropped() const {
-  std::lock_guard<std::mutex> guard(mutex_);
-  return pktsDropped_;
+  return pktsDropped_.load(std::memory_order_relaxed);
 }
 
 bool PcapQueue::wait(std::vector<PcapPkt>* swapQueue) {
   swapQueue->clear();
   swapQueue->reserve(pktCapacity_);
 
-  std::unique_lock<std::mutex> guard(mutex_);
-  while (queue_.empty() && !finished_) {
-    cv_.wait(guard);
+  Slot* slot;
+  filled_.blockingRead(slot);
+  while (true) {
+    if (!slot) {
+      // Leave the end marker for any later calls
+      filled_.blockingWrite(nullptr);
+      return !swapQueue->empty();
+    }
+    swapQueue->emplace_back(
+        slot->rx, slot->port, slot->vlan, slot->timestamp,
+        folly::ByteRange(slot->data, slot->length), slot->origLength);
+    free_.write(slot);
+    if (swapQueue->size() >= pktCapacity_ || !filled_.read(slot)) {
+      return true;
+    }
   }
-  if (queue_.empty()) {
-    DCHECK(finished_);
-    queue_.shrink_to_fit();
-    return false;
-  }
-
-  swapQueue->swap(queue_);
-  bytesInQueue_ = 0;
-  return true;
 }
 
 }} // facebook::fboss
@@ -9,10 +9,20 @@
  */
 #pragma once
 
-#include <condition_variable>
-#include <mutex>
+#include "fboss/agent/MemoryAccount.h"
+#include "fboss/agent/types.h"
+
+#include <folly/MPMCQueue.h>
+#include <gflags/gflags.h>
+
+#include <atomic>
+#include <chrono>
+#include <memory>
 #include <vector>
 
+DECLARE_int32(fboss_pcap_queue_depth);
+DECLARE_int32(fboss_pcap_snaplen);
+
 namespace facebook { namespace fboss {
 
 class RxPacket;
@@ -20,37 +30,43 @@ class TxPacket;
 class PcapPkt;
 
 /*
- * PcapQueue stores a queue of PcapPkt objects, for transferring packets
- * from an asynchronous capture thread to a blocking thread that will process
- * the packets.  (For instance, writing them to disk using blocking I/O.)
+ * PcapQueue stores a queue of captured packets, for transferring them
+ * from the threads sending and receiving them to a blocking thread that will
+ * process the packets.  (For instance, writing them to disk using blocking
+ * I/O.)
+ *
+ * Packets are added from every RX thread and from the TX path, so adding one
+ * never takes a lock or allocates memory.  The queue preallocates a slot of
+ * snapLen bytes for each packet it can hold, and a packet is copied into a
+ * free slot, truncated to snapLen, and handed to the reader through a
+ * lock-free ring.  If no slot is free the packet is dropped and counted,
+ * rather than blocking the caller.
  *
  * There can only be a single reader.
  */
 class PcapQueue {
  public:
+  /*
+   * Create a queue holding up to pktCapacity packets, or
+   * fboss_pcap_queue_depth of them if it is 0.  If bytesCapacity is
+   * non-zero, the packets are also limited to as many snaplen slots as fit
+   * in bytesCapacity.
+   */
   explicit PcapQueue(uint32_t pktCapacity, uint64_t bytesCapacity = 0);
   virtual ~PcapQueue();
 
   uint32_t getPktCapacity() const {
-    // pktCapacity_ is const, so no need for locking
     return pktCapacity_;
   }
+  uint32_t getSnapLen() const {
+    return snapLen_;
+  }
 
   /*
-   * Get the mutex protecting this PcapQueue.
-   *
-   * This is exposed to allow callers to also protect their own data
-   * with the same mutex if desired.  Callers should call addPktLocked()
-   * instead of addPkt() when they are already holding the PcapQueue mutex.
+   * Add a packet to the queue.  Can be called from any thread.
    */
-  std::mutex& mutex() const {
-    return mutex_;
-  }
-
   void addPkt(const RxPacket* pkt);
-  void addPktLocked(const RxPacket* pkt);
   void addPkt(const TxPacket* pkt);
-  void addPktLocked(const TxPacket* pkt);
 
   /*
    * finish() signals that no more packets will be added to the queue.
@@ -80,22 +96,35 @@ class PcapQueue {
   bool wait(std::vector<PcapPkt>* swapQueue);
 
  private:
+  struct Slot {
+    bool rx{false};
+    PortID port{0};
+    VlanID vlan{0};
+    std::chrono::system_clock::time_point timestamp;
+    uint32_t length{0};
+    uint32_t origLength{0};
+    uint8_t* data{nullptr};
+  };
+
   // Forbidden copy constructor and assignment operator
   PcapQueue(PcapQueue const &) = delete;
   PcapQueue& operator=(PcapQueue const &) = delete;
 
   template<typename PktType>
-  void addPktInternal(const PktType* pkt);
-
-  mutable std::mutex mutex_;
-  std::condition_variable cv_;
+  void addPktInternal(const PktType* pkt, bool rx, PortID port, VlanID vlan);
 
-  bool finished_{false};
   const uint32_t pktCapacity_{0};
-  uint64_t bytesCapacity_{0};
-  uint64_t bytesInQueue_{0};
-  uint64_t pktsDropped_{0};
-  std::vector<PcapPkt> queue_;
+  const uint32_t snapLen_{0};
+  std::unique_ptr<uint8_t[]> buffer_;
+  std::vector<Slot> slots_;
+  // The slots no packet is using
+  folly::MPMCQueue<Slot*> free_;
+  // The slots holding packets, in the order they were added, and then a null
+  // slot once the queue is finished
+  folly::MPMCQueue<Slot*> filled_;
+  std::atomic<bool> finished_{false};
+  std::atomic<uint64_t> pktsDropped_{0};
+  MemoryAccount memoryAccount_{"capture.buffers"};
 };
 
 }} // facebook::fboss
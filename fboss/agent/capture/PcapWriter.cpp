@@ -9,25 +9,60 @@
  */
 #include "fboss/agent/capture/PcapWriter.h"
 
+#include "fboss/agent/FbossError.h"
 #include "fboss/agent/capture/PcapPkt.h"
 
+#include <folly/Conv.h>
 #include <folly/String.h>
 #include <folly/logging/xlog.h>
 
+#include <string.h>
+
+#include <algorithm>
+
+DEFINE_int32(pcap_write_buffer_kb, 1024,
+             "When taking packet captures, how much data to write to the "
+             "capture file at once.  Each capture has two buffers this big.");
+DEFINE_bool(pcap_direct_io, true,
+            "When taking packet captures, write the capture files with "
+            "O_DIRECT, bypassing the page cache, if the filesystem allows it");
+
 using folly::StringPiece;
+using std::chrono::microseconds;
+using std::chrono::steady_clock;
+
+namespace {
+
+// One block being filled, and one being written
+constexpr size_t kNumBlocks = 2;
+
+// Room for the pcapng blocks around a packet of snapLen bytes, and for the
+// unaligned end of the previous block that is carried over
+size_t blockCapacity(uint32_t snapLen) {
+  return std::max<size_t>(
+      size_t(std::max(FLAGS_pcap_write_buffer_kb, 0)) * 1024,
+      snapLen + facebook::fboss::PcapFile::kAlignment + 1024);
+}
+
+}
 
 namespace facebook { namespace fboss {
 
 PcapWriter::PcapWriter(uint32_t maxBufferedPkts)
-  : queue_(maxBufferedPkts) {
+  : queue_(maxBufferedPkts),
+    freeBlocks_(kNumBlocks),
+    writes_(kNumBlocks) {
+  for (size_t idx = 0; idx < kNumBlocks; ++idx) {
+    blocks_.emplace_back(new PcapBlock(blockCapacity(queue_.getSnapLen())));
+  }
 }
 
 PcapWriter::PcapWriter(StringPiece path,
                        bool overwriteExisting,
-                       uint32_t maxBufferedPkts)
-  : file_(path, overwriteExisting),
-    queue_(maxBufferedPkts),
-    thread_(&PcapWriter::threadMain, this) {
+                       uint32_t maxBufferedPkts,
+                       const Options& options)
+  : PcapWriter(maxBufferedPkts) {
+  start(path, overwriteExisting, options);
 }
 
 PcapWriter::~PcapWriter() {
@@ -42,8 +77,25 @@ PcapWriter::~PcapWriter() {
   }
 }
 
-void PcapWriter::start(folly::StringPiece path, bool overwriteExisting) {
-  file_ = PcapFile(path, overwriteExisting);
+void PcapWriter::start(folly::StringPiece path, bool overwriteExisting,
+                       const Options& options) {
+  if (options.rotates() && options.maxFiles < 2) {
+    throw FbossError("a rotating packet capture needs at least two files");
+  }
+  path_ = path.str();
+  overwriteExisting_ = overwriteExisting;
+  options_ = options;
+
+  block_ = blocks_[0].get();
+  block_->clear();
+  // Open the first file here, so that the caller hears if it can't be
+  // created
+  openFile();
+  for (size_t idx = 1; idx < blocks_.size(); ++idx) {
+    freeBlocks_.write(blocks_[idx].get());
+  }
+
+  ioThread_ = std::thread(&PcapWriter::ioThreadMain, this);
   thread_ = std::thread(&PcapWriter::threadMain, this);
 }
 
@@ -55,25 +107,57 @@ void PcapWriter::finish() {
 
   queue_.finish();
   thread_.join();
+  ioThread_.join();
   if (ex_) {
     std::rethrow_exception(ex_);
   }
+  if (ioEx_) {
+    std::rethrow_exception(ioEx_);
+  }
+}
+
+std::string PcapWriter::getFilePath(uint32_t index) const {
+  if (!options_.rotates()) {
+    return path_;
+  }
+  auto slash = path_.rfind('/');
+  auto dot = path_.rfind('.');
+  if (dot == std::string::npos ||
+      (slash != std::string::npos && dot < slash)) {
+    return folly::to<std::string>(path_, ".", index);
+  }
+  return folly::to<std::string>(
+      StringPiece(path_).subpiece(0, dot), ".", index,
+      StringPiece(path_).subpiece(dot));
+}
+
+PcapWriter::Stats PcapWriter::getStats() const {
+  Stats stats;
+  stats.bytesWritten = bytesWritten_.load(std::memory_order_relaxed);
+  stats.writes = numWrites_.load(std::memory_order_relaxed);
+  stats.writeUsec = writeUsec_.load(std::memory_order_relaxed);
+  stats.maxWriteUsec = maxWriteUsec_.load(std::memory_order_relaxed);
+  stats.filesWritten = filesWritten_.load(std::memory_order_relaxed);
+  stats.dropped = numDropped();
+  return stats;
 }
 
 void PcapWriter::threadMain() {
   try {
-    file_.writeGlobalHeader();
     writeLoop();
-    file_.close();
+    submit(true);
   } catch (const std::exception& ex) {
     XLOG(ERR) << "error writing to pcap file: " << folly::exceptionStr(ex);
     ex_ = std::current_exception();
   }
+  file_.reset();
+  writes_.blockingWrite(Write());
 }
 
 void PcapWriter::writeLoop() {
   std::vector<PcapPkt> pkts;
-  while (true) {
+  // The I/O thread gives up on the capture if a write fails
+  while (!ioFailed_.load(std::memory_order_acquire)) {
     pkts.clear();
     if (!queue_.wait(&pkts)) {
       DCHECK(pkts.empty());
@@ -81,7 +165,116 @@ void PcapWriter::writeLoop() {
     }
 
     DCHECK(!pkts.empty());
-    file_.writePackets(pkts);
+    for (const auto& pkt : pkts) {
+      writePacket(pkt);
+    }
+  }
+}
+
+void PcapWriter::writePacket(const PcapPkt& pkt) {
+  if (needRotate(pkt.timestamp())) {
+    submit(true);
+    fileIndex_ = (fileIndex_ + 1) % options_.maxFiles;
+    openFile();
+  }
+  if (file_->writePacket(pkt, block_)) {
+    return;
+  }
+  submit(false);
+  if (!file_->writePacket(pkt, block_)) {
+    throw FbossError("captured packet of ", pkt.buf()->computeChainDataLength(),
+                     " bytes is too large for the pcap write buffer");
+  }
+}
+
+bool PcapWriter::needRotate(std::chrono::system_clock::time_point now) const {
+  if (options_.rotateBytes > 0 &&
+      fileOffset_ + block_->length() >= options_.rotateBytes) {
+    return true;
+  }
+  return options_.rotateInterval.count() > 0 &&
+    now - fileStart_ >= options_.rotateInterval;
+}
+
+void PcapWriter::openFile() {
+  // Files are reused once the ring wraps around.  The I/O thread is done
+  // with the old one by then, since the blocks written to the file in between
+  // each waited for it to hand back a block.
+  bool overwrite = overwriteExisting_ || filesOpened_ >= options_.maxFiles;
+  file_ = std::make_shared<PcapFile>(
+      getFilePath(fileIndex_), overwrite, options_.format,
+      FLAGS_pcap_direct_io);
+  ++filesOpened_;
+  fileOffset_ = 0;
+  fileStart_ = std::chrono::system_clock::now();
+  // The last block of the previous file left nothing behind
+  DCHECK_EQ(0, block_->length());
+  file_->writeGlobalHeader(block_);
+}
+
+void PcapWriter::submit(bool last) {
+  // Only whole aligned blocks can be written until the end of the file, so
+  // the remainder is carried over to the start of the next block
+  auto length = block_->length();
+  if (!last) {
+    length -= length % PcapFile::kAlignment;
+  }
+
+  PcapBlock* next;
+  freeBlocks_.blockingRead(next);
+  next->clear();
+  auto remainder = block_->length() - length;
+  if (remainder > 0) {
+    memcpy(next->append(remainder), block_->data() + length, remainder);
+  }
+
+  Write write;
+  write.block = block_;
+  write.length = length;
+  write.last = last;
+  write.file = file_;
+  writes_.blockingWrite(std::move(write));
+  block_ = next;
+  fileOffset_ += length;
+}
+
+void PcapWriter::ioThreadMain() {
+  while (true) {
+    Write write;
+    writes_.blockingRead(write);
+    if (!write.file) {
+      return;
+    }
+
+    if (!ioFailed_.load(std::memory_order_relaxed)) {
+      try {
+        auto start = steady_clock::now();
+        write.file->write(write.block, write.length, write.last);
+        if (write.last) {
+          write.file->close();
+          filesWritten_.fetch_add(1, std::memory_order_relaxed);
+        }
+        recordWrite(write.length, std::chrono::duration_cast<microseconds>(
+            steady_clock::now() - start));
+      } catch (const std::exception& ex) {
+        XLOG(ERR) << "error writing to pcap file: "
+                  << folly::exceptionStr(ex);
+        ioEx_ = std::current_exception();
+        ioFailed_.store(true, std::memory_order_release);
+      }
+    }
+    freeBlocks_.blockingWrite(write.block);
+  }
+}
+
+void PcapWriter::recordWrite(size_t length, microseconds latency) {
+  uint64_t usec = latency.count();
+  bytesWritten_.fetch_add(length, std::memory_order_relaxed);
+  numWrites_.fetch_add(1, std::memory_order_relaxed);
+  writeUsec_.fetch_add(usec, std::memory_order_relaxed);
+  // Only this thread updates the maximum
+  if (usec > maxWriteUsec_.load(std::memory_order_relaxed)) {
+    maxWriteUsec_.store(usec, std::memory_order_relaxed);
   }
 }
 
@@ -12,7 +12,18 @@
 #include "fboss/agent/capture/PcapFile.h"
 #include "fboss/agent/capture/PcapQueue.h"
 
+#include <folly/MPMCQueue.h>
+#include <gflags/gflags.h>
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
 #include <thread>
+#include <vector>
+
+DECLARE_int32(pcap_write_buffer_kb);
+DECLARE_bool(pcap_direct_io);
 
 namespace facebook { namespace fboss {
 
@@ -20,41 +31,67 @@ namespace facebook { namespace fboss {
  * PcapWriter listes to a PcapQueue and writes the packets it receives
  * to a pcap file.
  *
- * It performs blocking disk I/O, so it performs the writes in its own thread.
+ * It performs blocking disk I/O, so it performs the writes in its own
+ * threads.  One thread encodes the packets into a large aligned block while
+ * the other writes the previous block out, so the queue keeps draining while
+ * a write is in progress.
+ *
+ * A long capture can be rotated through a ring of files, so that it only
+ * ever keeps its most recent packets on disk.
  */
 class PcapWriter {
  public:
+  struct Options {
+    PcapFormat format{PcapFormat::PCAP};
+    /*
+     * Move on to the next file once the current one holds rotateBytes, or
+     * has been written to for rotateInterval.  Neither is limited if 0.
+     * This is checked as each packet is written, so an idle capture stays
+     * on its current file.
+     */
+    uint64_t rotateBytes{0};
+    std::chrono::seconds rotateInterval{0};
+    /*
+     * How many files to rotate through before overwriting the oldest, at
+     * least two if the capture rotates.  The files are named after the path,
+     * with the index of each inserted before its extension.
+     */
+    uint32_t maxFiles{1};
+
+    bool rotates() const {
+      return rotateBytes > 0 || rotateInterval.count() > 0;
+    }
+  };
+
+  struct Stats {
+    uint64_t bytesWritten{0};
+    uint64_t writes{0};
+    uint64_t writeUsec{0};
+    uint64_t maxWriteUsec{0};
+    uint64_t filesWritten{0};
+    uint64_t dropped{0};
+  };
+
   explicit PcapWriter(uint32_t maxBufferedPkts = 0);
   explicit PcapWriter(folly::StringPiece path,
                       bool overwriteExisting = false,
-                      uint32_t maxBufferedPkts = 0);
+                      uint32_t maxBufferedPkts = 0,
+                      const Options& options = Options());
   virtual ~PcapWriter();
 
-  void start(folly::StringPiece path, bool overwriteExisting = false);
+  void start(folly::StringPiece path, bool overwriteExisting = false,
+             const Options& options = Options());
 
   /*
-   * Get the mutex protecting this PcapWriter.
-   *
-   * This is exposed to allow callers to also protect their own data
-   * with the same mutex if desired.  Callers should call addPktLocked()
-   * instead of addPkt() when they are already holding the PcapWriter mutex.
+   * Add a packet to be written.  Can be called from any thread, and never
+   * blocks.
    */
-  std::mutex& mutex() const {
-    return queue_.mutex();
-  }
-
   void addPkt(const RxPacket* pkt) {
     queue_.addPkt(pkt);
   }
-  void addPktLocked(const RxPacket* pkt) {
-    queue_.addPktLocked(pkt);
-  }
   void addPkt(const TxPacket* pkt) {
     queue_.addPkt(pkt);
   }
-  void addPktLocked(const TxPacket* pkt) {
-    queue_.addPktLocked(pkt);
-  }
   void finish();
 
   /*
@@ -67,19 +104,68 @@ class PcapWriter {
     return queue_.numDropped();
   }
 
+  /*
+   * The path of the file with the given index in the ring of files.
+   */
+  std::string getFilePath(uint32_t index) const;
+
+  /*
+   * Can be called from any thread while the capture is running.
+   */
+  Stats getStats() const;
+
  private:
+  // A block for the I/O thread to write, or the end of the writes if it
+  // has no file
+  struct Write {
+    PcapBlock* block{nullptr};
+    size_t length{0};
+    bool last{false};
+    std::shared_ptr<PcapFile> file;
+  };
+
   // Forbidden copy constructor and assignment operator
   PcapWriter(PcapWriter const &) = delete;
   PcapWriter& operator=(PcapWriter const &) = delete;
 
   void threadMain();
-  void writeHeader();
+  void ioThreadMain();
   void writeLoop();
+  void writePacket(const PcapPkt& pkt);
+  bool needRotate(std::chrono::system_clock::time_point now) const;
+  void openFile();
+  void submit(bool last);
+  void recordWrite(size_t length, std::chrono::microseconds latency);
 
-  PcapFile file_;
+  std::string path_;
+  bool overwriteExisting_{false};
+  Options options_;
   PcapQueue queue_;
+
+  // Only used by the writer thread
+  std::shared_ptr<PcapFile> file_;
+  PcapBlock* block_{nullptr};
+  uint32_t fileIndex_{0};
+  uint64_t filesOpened_{0};
+  uint64_t fileOffset_{0};
+  std::chrono::system_clock::time_point fileStart_;
+
+  // Double buffering between the writer and I/O threads
+  std::vector<std::unique_ptr<PcapBlock>> blocks_;
+  folly::MPMCQueue<PcapBlock*> freeBlocks_;
+  folly::MPMCQueue<Write> writes_;
+  std::atomic<bool> ioFailed_{false};
+
+  std::atomic<uint64_t> bytesWritten_{0};
+  std::atomic<uint64_t> numWrites_{0};
+  std::atomic<uint64_t> writeUsec_{0};
+  std::atomic<uint64_t> maxWriteUsec_{0};
+  std::atomic<uint64_t> filesWritten_{0};
+
   std::exception_ptr ex_;
+  std::exception_ptr ioEx_;
   std::thread thread_;
+  std::thread ioThread_;
 };
 
 }} // facebook::fboss
@@ -24,8 +24,10 @@ PktCapture::PktCapture(folly::StringPiece name, uint64_t maxPackets,
 
 PktCapture::PktCapture(folly::StringPiece name, uint64_t maxPackets,
                        CaptureDirection direction,
-                       const CaptureFilter& captureFilter)
+                       const CaptureFilter& captureFilter,
+                       const PcapWriter::Options& writerOptions)
   : name_(name.str()),
+    writerOptions_(writerOptions),
     maxPackets_(maxPackets),
     direction_(direction),
     packetFilter_(captureFilter) {
@@ -34,7 +36,7 @@ PktCapture::PktCapture(folly::StringPiece name, uint64_t maxPackets,
 
 void PktCapture::start(StringPiece path) {
   XLOG(INFO) << "starting packet capture " << toString();
-  writer_.start(path, true);
+  writer_.start(path, true, writerOptions_);
 }
 
 void PktCapture::stop() {
@@ -42,23 +44,23 @@ void PktCapture::stop() {
   XLOG(INFO) << "Stopped packet capture " << toString(true);
 }
 
-bool PktCapture::packetReceived(const RxPacket* pkt) {
-  std::lock_guard<std::mutex> guard(writer_.mutex());
+bool PktCapture::packetReceived(
+    const RxPacket* pkt, BpfMatchCache* matches) {
   if (direction_ != CaptureDirection::CAPTURE_ONLY_TX &&
-      true == packetFilter_.passes(pkt)) {
-    ++numPacketsReceived_;
-    writer_.addPktLocked(pkt);
+      true == packetFilter_.passes(pkt, matches)) {
+    numPacketsReceived_.fetch_add(1, std::memory_order_relaxed);
+    writer_.addPkt(pkt);
   }
-  return (numPacketsSent_ + numPacketsReceived_) < maxPackets_;
+  return numPackets() < maxPackets_;
 }
 
-bool PktCapture::packetSent(const TxPacket* pkt) {
-  std::lock_guard<std::mutex> guard(writer_.mutex());
-  if (direction_ != CaptureDirection::CAPTURE_ONLY_RX) {
-    ++numPacketsSent_;
-    writer_.addPktLocked(pkt);
+bool PktCapture::packetSent(const TxPacket* pkt, BpfMatchCache* matches) {
+  if (direction_ != CaptureDirection::CAPTURE_ONLY_RX &&
+      packetFilter_.passes(pkt, matches)) {
+    numPacketsSent_.fetch_add(1, std::memory_order_relaxed);
+    writer_.addPkt(pkt);
   }
-  return (numPacketsSent_ + numPacketsReceived_) < maxPackets_;
+  return numPackets() < maxPackets_;
 }
 
 std::string PktCapture::toString(bool withStats) const {
@@ -71,8 +73,10 @@ std::string PktCapture::toString(bool withStats) const {
             ? "RX only"
             : "TX only"));
   if (withStats) {
-    ss << ", Packet received:" << numPacketsReceived_
-       << ", Packet sent:" << numPacketsSent_;
+    ss << ", Packet received:" << numPacketsReceived_.load()
+       << ", Packet sent:" << numPacketsSent_.load()
+       << ", Packet dropped:" << writer_.numDropped()
+       << ", Bytes written:" << writer_.getStats().bytesWritten;
   }
   return ss.str();
 }
@@ -9,10 +9,12 @@
  */
 #pragma once
 
+#include "fboss/agent/capture/BpfProgram.h"
 #include "fboss/agent/capture/PcapWriter.h"
 #include "fboss/agent/if/gen-cpp2/ctrl_types.h"
 
 #include <folly/Range.h>
+#include <atomic>
 #include <string>
 #include "fboss/agent/RxPacket.h"
 #include "fboss/agent/TxPacket.h"
@@ -38,13 +40,27 @@ class RxPacketFilter {
 class PacketFilter {
  public:
    explicit PacketFilter(const CaptureFilter & captureFilter) :
-   rxPacketFilter_(captureFilter.get_rxCaptureFilter()) {}
+   rxPacketFilter_(captureFilter.get_rxCaptureFilter()),
+   bpfProgram_(captureFilter.bpfProgram.empty() ?
+               nullptr : BpfProgram::fromThrift(captureFilter.bpfProgram)) {}
 
-   bool passes(const RxPacket* pkt) {
-     return rxPacketFilter_.passes(pkt);
+   bool passes(const RxPacket* pkt, BpfMatchCache* matches) const {
+     return rxPacketFilter_.passes(pkt) &&
+         matches->matches(bpfProgram_.get());
+   }
+   bool passes(const TxPacket* /*pkt*/, BpfMatchCache* matches) const {
+     return matches->matches(bpfProgram_.get());
+   }
+
+   const std::shared_ptr<const BpfProgram>& getBpfProgram() const {
+     return bpfProgram_;
+   }
+   void setBpfProgram(std::shared_ptr<const BpfProgram> program) {
+     bpfProgram_ = std::move(program);
    }
  private:
    RxPacketFilter rxPacketFilter_;
+   std::shared_ptr<const BpfProgram> bpfProgram_;
 };
 
 /*
@@ -55,17 +71,42 @@ class PktCapture {
   PktCapture(folly::StringPiece name, uint64_t maxPackets,
              CaptureDirection direction);
   PktCapture(folly::StringPiece name, uint64_t maxPackets,
-             CaptureDirection direction, const CaptureFilter& captureFilter);
+             CaptureDirection direction, const CaptureFilter& captureFilter,
+             const PcapWriter::Options& writerOptions = PcapWriter::Options());
 
   const std::string& name() const {
     return name_;
   }
 
+  const PcapWriter::Options& getWriterOptions() const {
+    return writerOptions_;
+  }
+  PcapWriter::Stats getWriterStats() const {
+    return writer_.getStats();
+  }
+
   void start(folly::StringPiece path);
   void stop();
 
-  bool packetReceived(const RxPacket* pkt);
-  bool packetSent(const TxPacket* pkt);
+  /*
+   * Capture the packet if it passes the filter, with the results of the
+   * BPF programs already run against it in matches.  Return false once the
+   * capture has all of the packets it wants.
+   */
+  bool packetReceived(const RxPacket* pkt, BpfMatchCache* matches);
+  bool packetSent(const TxPacket* pkt, BpfMatchCache* matches);
+
+  const std::shared_ptr<const BpfProgram>& getBpfProgram() const {
+    return packetFilter_.getBpfProgram();
+  }
+  /*
+   * Use an identical program another capture already has, so that it is
+   * only run once for both.  Must be called before the capture is started.
+   */
+  void shareBpfProgram(std::shared_ptr<const BpfProgram> program) {
+    DCHECK(program && *program == *getBpfProgram());
+    packetFilter_.setBpfProgram(std::move(program));
+  }
 
   std::string toString(bool withStats = false) const;
 
@@ -74,14 +115,20 @@ class PktCapture {
   PktCapture(PktCapture const &) = delete;
   PktCapture& operator=(PktCapture const &) = delete;
 
+  uint64_t numPackets() const {
+    return numPacketsReceived_.load(std::memory_order_relaxed) +
+        numPacketsSent_.load(std::memory_order_relaxed);
+  }
+
   const std::string name_;
 
-  // Note: the rest of the state in this class is protcted by
-  // the PcapWriter's mutex.
+  // Packets are captured from every RX thread and the TX path at once, so
+  // the counters are atomic rather than each packet taking a lock.
   PcapWriter writer_;
+  PcapWriter::Options writerOptions_;
   uint64_t maxPackets_{0};
-  uint64_t numPacketsReceived_{0};
-  uint64_t numPacketsSent_{0};
+  std::atomic<uint64_t> numPacketsReceived_{0};
+  std::atomic<uint64_t> numPacketsSent_{0};
   CaptureDirection direction_{CaptureDirection::CAPTURE_TX_RX};
   PacketFilter packetFilter_;
 };
@@ -15,6 +15,8 @@
 #include "fboss/agent/Utils.h"
 #include "fboss/agent/capture/PktCapture.h"
 
+#include "common/stats/ServiceData.h"
+
 #include <folly/String.h>
 #include <folly/logging/xlog.h>
 
@@ -24,7 +26,7 @@ using std::unique_ptr;
 
 namespace facebook { namespace fboss {
 
-PktCaptureManager::PktCaptureManager(SwSwitch* sw) {
+PktCaptureManager::PktCaptureManager(SwSwitch* sw) : sw_(sw) {
   auto persistDir = sw->getPlatform()->getPersistentStateDir();
   captureDir_ = folly::to<string>(persistDir, "/captures");
   utilCreateDir(captureDir_);
@@ -36,8 +38,10 @@ PktCaptureManager::~PktCaptureManager() {
 void PktCaptureManager::startCapture(unique_ptr<PktCapture> capture) {
   checkCaptureName(capture->name());
 
-  auto path = folly::to<std::string>(captureDir_, "/",
-                                     capture->name(), ".pcap");
+  auto format = capture->getWriterOptions().format;
+  auto path = folly::to<std::string>(
+      captureDir_, "/", capture->name(),
+      format == PcapFormat::PCAPNG ? ".pcapng" : ".pcap");
 
   std::lock_guard<std::mutex> g(mutex_);
 
@@ -46,6 +50,19 @@ void PktCaptureManager::startCapture(unique_ptr<PktCapture> capture) {
     throw FbossError("an active capture named \"", name, "\" already exists");
   }
 
+  // Captures with the same filter share its program, so that it is only run
+  // once per packet for all of them
+  const auto& program = capture->getBpfProgram();
+  if (program) {
+    for (const auto& active : activeCaptures_) {
+      const auto& activeProgram = active.second->getBpfProgram();
+      if (activeProgram && *activeProgram == *program) {
+        capture->shareBpfProgram(activeProgram);
+        break;
+      }
+    }
+  }
+
   capture->start(path);
   capturesRunning_.store(true, std::memory_order_release);
   activeCaptures_[name] = std::move(capture);
@@ -140,17 +157,48 @@ void PktCaptureManager::invokeCaptures(const Fn& fn) {
 }
 
 void PktCaptureManager::packetReceivedImpl(const RxPacket* pkt) {
+  BpfMatchCache matches(pkt->buf());
   invokeCaptures([&] (PktCapture* capture) {
-    return capture->packetReceived(pkt);
+    return capture->packetReceived(pkt, &matches);
   });
 }
 
 void PktCaptureManager::packetSentImpl(const TxPacket* pkt) {
+  BpfMatchCache matches(pkt->buf());
   invokeCaptures([&] (PktCapture* capture) {
-    return capture->packetSent(pkt);
+    return capture->packetSent(pkt, &matches);
   });
 }
 
+void PktCaptureManager::publishStats() {
+  std::lock_guard<std::mutex> g(mutex_);
+
+  std::set<std::string> published;
+  for (const auto& active : activeCaptures_) {
+    auto stats = active.second->getWriterStats();
+    auto prefix = folly::to<string>("capture.", active.first);
+    fbData->setCounter(prefix + ".bytes_written", stats.bytesWritten);
+    fbData->setCounter(prefix + ".files_written", stats.filesWritten);
+    fbData->setCounter(prefix + ".dropped", stats.dropped);
+    fbData->setCounter(prefix + ".write_us.avg",
+                       stats.writes ? stats.writeUsec / stats.writes : 0);
+    fbData->setCounter(prefix + ".write_us.max", stats.maxWriteUsec);
+    published.insert(active.first);
+  }
+  for (const auto& name : publishedCaptures_) {
+    if (published.find(name) != published.end()) {
+      continue;
+    }
+    auto prefix = folly::to<string>("capture.", name);
+    fbData->clearCounter(prefix + ".bytes_written");
+    fbData->clearCounter(prefix + ".files_written");
+    fbData->clearCounter(prefix + ".dropped");
+    fbData->clearCounter(prefix + ".write_us.avg");
+    fbData->clearCounter(prefix + ".write_us.max");
+  }
+  publishedCaptures_.swap(published);
+}
+
 void PktCaptureManager::checkCaptureName(folly::StringPiece name) {
   // We use the capture name for the on-disk filename, so don't allow
   // directory separator characters or nul bytes.
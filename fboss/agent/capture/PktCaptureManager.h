@@ -15,6 +15,7 @@
 #include <map>
 #include <memory>
 #include <mutex>
+#include <set>
 #include <string>
 
 namespace facebook { namespace fboss {
@@ -77,6 +78,12 @@ class PktCaptureManager {
 
   static void checkCaptureName(folly::StringPiece name);
 
+  /*
+   * Export the write counters of the running captures, and clear those of
+   * captures that have stopped since.
+   */
+  void publishStats();
+
  private:
   // Forbidden copy constructor and assignment operator
   PktCaptureManager(PktCaptureManager const &) = delete;
@@ -87,12 +94,14 @@ class PktCaptureManager {
   void packetReceivedImpl(const RxPacket* pkt);
   void packetSentImpl(const TxPacket* pkt);
 
+  SwSwitch* sw_{nullptr};
   std::atomic<bool> capturesRunning_{false};
 
   std::mutex mutex_;
   std::string captureDir_;
   std::map<std::string, std::unique_ptr<PktCapture>> activeCaptures_;
   std::map<std::string, std::unique_ptr<PktCapture>> inactiveCaptures_;
+  std::set<std::string> publishedCaptures_;
 };
 
 }} // facebook::fboss
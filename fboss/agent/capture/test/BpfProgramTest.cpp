@@ -0,0 +1,132 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "fboss/agent/capture/BpfProgram.h"
+
+#include "fboss/agent/FbossError.h"
+#include "fboss/agent/hw/mock/MockRxPacket.h"
+
+#include <folly/io/IOBuf.h>
+#include <gtest/gtest.h>
+
+using namespace facebook::fboss;
+
+namespace {
+
+using Program = std::vector<BpfProgram::Instruction>;
+
+// tcpdump -dd arp
+const Program kArp = {
+  {0x28, 0, 0, 0x0000000c},
+  {0x15, 0, 1, 0x00000806},
+  {0x06, 0, 0, 0x00040000},
+  {0x06, 0, 0, 0x00000000},
+};
+
+// An IPv4 packet tagged with an 802.1q header
+const Program kTaggedIp = {
+  {0x28, 0, 0, 0x0000000c},
+  {0x15, 0, 3, 0x00008100},
+  {0x28, 0, 0, 0x00000010},
+  {0x15, 0, 1, 0x00000800},
+  {0x06, 0, 0, 0x00040000},
+  {0x06, 0, 0, 0x00000000},
+};
+
+// Untagged IPv4 to TCP port 179, past the IP header whatever its length
+const Program kBgp = {
+  {0xb1, 0, 0, 0x0000000e},
+  {0x48, 0, 0, 0x00000010},
+  {0x15, 0, 1, 0x000000b3},
+  {0x06, 0, 0, 0x00040000},
+  {0x06, 0, 0, 0x00000000},
+};
+
+bool matches(const Program& program, const std::string& hex) {
+  auto pkt = MockRxPacket::fromHex(hex);
+  BpfProgram bpf(program);
+  BpfMatchCache matches(pkt->buf());
+  return matches.matches(&bpf);
+}
+
+const std::string kArpPkt =
+  // dst mac, src mac
+  "ff ff ff ff ff ff  02 00 02 01 02 03"
+  // ARP
+  "08 06"
+  "00 01 08 00 06 04 00 01";
+
+const std::string kTaggedIpPkt =
+  // dst mac, src mac
+  "02 00 01 00 00 01  02 00 02 01 02 03"
+  // 802.1q, VLAN 1
+  "81 00 00 01"
+  // IPv4
+  "08 00"
+  "45 00 00 14 00 00 00 00 1f 06 00 00 01 02 03 04 0a 00 00 0a";
+
+const std::string kBgpPkt =
+  // dst mac, src mac
+  "02 00 01 00 00 01  02 00 02 01 02 03"
+  // IPv4, with 4 bytes of options
+  "08 00"
+  "46 00 00 2c 00 00 00 00 1f 06 00 00 01 02 03 04 0a 00 00 0a"
+  "01 01 01 01"
+  // TCP, source port 1234, destination port 179
+  "04 d2 00 b3 00 00 00 00 00 00 00 00 50 02 00 00 00 00 00 00";
+
+} // unnamed namespace
+
+TEST(BpfProgramTest, Match) {
+  EXPECT_TRUE(matches(kArp, kArpPkt));
+  EXPECT_FALSE(matches(kArp, kTaggedIpPkt));
+  EXPECT_TRUE(matches(kTaggedIp, kTaggedIpPkt));
+  EXPECT_FALSE(matches(kTaggedIp, kArpPkt));
+  EXPECT_TRUE(matches(kBgp, kBgpPkt));
+  EXPECT_FALSE(matches(kBgp, kTaggedIpPkt));
+  // Loads past the end of the packet reject it
+  EXPECT_FALSE(matches(kArp, "ff ff ff ff ff ff  02 00 02 01 02 03"));
+}
+
+TEST(BpfProgramTest, Invalid) {
+  auto create = [](Program program) { BpfProgram bpf(std::move(program)); };
+  EXPECT_THROW(create({}), FbossError);
+  // Doesn't return
+  EXPECT_THROW(create({{0x28, 0, 0, 12}}), FbossError);
+  // Jumps past the end
+  EXPECT_THROW(create({{0x15, 0, 1, 0}, {0x06, 0, 0, 0}}), FbossError);
+  EXPECT_THROW(create({{0x05, 0, 0, 1}, {0x06, 0, 0, 0}}), FbossError);
+  // Divides by zero
+  EXPECT_THROW(create({{0x34, 0, 0, 0}, {0x06, 0, 0, 0}}), FbossError);
+  // Scratch memory out of range
+  EXPECT_THROW(create({{0x60, 0, 0, 16}, {0x06, 0, 0, 0}}), FbossError);
+  // Unknown opcode
+  EXPECT_THROW(create({{0xff, 0, 0, 0}, {0x06, 0, 0, 0}}), FbossError);
+  EXPECT_NO_THROW(create(kArp));
+}
+
+TEST(BpfProgramTest, MatchCache) {
+  auto pkt = MockRxPacket::fromHex(kArpPkt);
+  // Split the packet in the middle of the ethertype
+  auto data = pkt->buf()->clone();
+  data->coalesce();
+  auto chain = folly::IOBuf::copyBuffer(data->data(), 13);
+  chain->prependChain(
+      folly::IOBuf::copyBuffer(data->data() + 13, data->length() - 13));
+  BpfProgram arp(kArp);
+  BpfProgram taggedIp(kTaggedIp);
+
+  BpfMatchCache matches(chain.get());
+  EXPECT_TRUE(matches.matches(nullptr));
+  EXPECT_TRUE(matches.matches(&arp));
+  EXPECT_FALSE(matches.matches(&taggedIp));
+  EXPECT_TRUE(matches.matches(&arp));
+  // The packet itself is left alone
+  EXPECT_TRUE(chain->isChained());
+}
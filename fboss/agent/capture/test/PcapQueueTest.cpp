@@ -11,6 +11,7 @@
 #include "fboss/agent/capture/PcapQueue.h"
 #include "fboss/agent/hw/mock/MockRxPacket.h"
 
+#include <gflags/gflags.h>
 #include <thread>
 #include <gtest/gtest.h>
 
@@ -72,3 +73,49 @@ TEST(PcapQueueTest, SimpleAdd) {
   ByteRange waitedPktData = waitedPktBufClone->coalesce();
   EXPECT_EQ(expectedPktData, waitedPktData);
 }
+
+TEST(PcapQueueTest, TruncateAndDrop) {
+  gflags::FlagSaver saver;
+  FLAGS_fboss_pcap_snaplen = 16;
+  PcapQueue queue(2);
+  EXPECT_EQ(2, queue.getPktCapacity());
+  EXPECT_EQ(16, queue.getSnapLen());
+
+  auto pkt = MockRxPacket::fromHex(
+    // dst mac, src mac
+    "02 00 01 00 00 01  02 00 02 01 02 03"
+    // 802.1q, VLAN 1
+    "81 00 00 01"
+    // IPv4
+    "08 00"
+  );
+  pkt->padToLength(68);
+  pkt->setSrcPort(PortID(3));
+  pkt->setSrcVlan(VlanID(1));
+
+  // There are only slots for two packets until the reader catches up
+  queue.addPkt(pkt.get());
+  queue.addPkt(pkt.get());
+  queue.addPkt(pkt.get());
+  EXPECT_EQ(1, queue.numDropped());
+
+  std::vector<PcapPkt> pkts;
+  ASSERT_TRUE(queue.wait(&pkts));
+  ASSERT_EQ(2, pkts.size());
+  EXPECT_EQ(PortID(3), pkts[0].port());
+  EXPECT_EQ(16, pkts[0].buf()->computeChainDataLength());
+  EXPECT_EQ(68, pkts[0].origLength());
+  auto expected = pkt->buf()->clone();
+  expected->coalesce();
+  auto truncated = pkts[1].buf()->clone();
+  EXPECT_EQ(ByteRange(expected->data(), 16), truncated->coalesce());
+
+  // The slots are free again
+  queue.addPkt(pkt.get());
+  EXPECT_EQ(1, queue.numDropped());
+  queue.finish();
+  ASSERT_TRUE(queue.wait(&pkts));
+  EXPECT_EQ(1, pkts.size());
+  EXPECT_FALSE(queue.wait(&pkts));
+  EXPECT_FALSE(queue.wait(&pkts));
+}
@@ -12,6 +12,7 @@
 #include "fboss/agent/hw/mock/MockRxPacket.h"
 
 #include <folly/Exception.h>
+#include <folly/FileUtil.h>
 #include <folly/ScopeGuard.h>
 #include <gtest/gtest.h>
 
@@ -102,3 +103,70 @@ TEST(PcapWriterTest, Drop) {
     EXPECT_EQ(68, pktInfo.hdr.caplen);
   }
 }
+
+TEST(PcapWriterTest, Rotate) {
+  char tmpDir[] = "fbossPcapTest.XXXXXX";
+  ASSERT_NE(nullptr, mkdtemp(tmpDir));
+  PcapWriter::Options options;
+  // About 120 packets to each file
+  options.rotateBytes = 10000;
+  options.maxFiles = 3;
+  PcapWriter writer(0);
+  SCOPE_EXIT {
+    for (uint32_t idx = 0; idx < options.maxFiles; ++idx) {
+      unlink(writer.getFilePath(idx).c_str());
+    }
+    rmdir(tmpDir);
+  };
+
+  writer.start(std::string(tmpDir) + "/capture.pcap", false, options);
+  EXPECT_EQ(std::string(tmpDir) + "/capture.1.pcap", writer.getFilePath(1));
+  addPackets(&writer, 1000);
+  writer.finish();
+  EXPECT_EQ(0, writer.numDropped());
+
+  // Only the files from the last time around the ring are kept
+  auto stats = writer.getStats();
+  EXPECT_GT(stats.filesWritten, options.maxFiles);
+  EXPECT_GT(stats.bytesWritten, 1000 * 68);
+  EXPECT_GT(stats.writes, 0);
+  size_t numPkts = 0;
+  for (uint32_t idx = 0; idx < options.maxFiles; ++idx) {
+    auto pcapPkts = readPcapFile(writer.getFilePath(idx).c_str());
+    EXPECT_GT(pcapPkts.size(), 0);
+    EXPECT_LE(pcapPkts.size(), 120);
+    numPkts += pcapPkts.size();
+  }
+  EXPECT_LT(numPkts, 1000);
+}
+
+TEST(PcapWriterTest, Pcapng) {
+  char tmpPath[] = "fbossPcapTest.XXXXXX";
+  int tmpFD = mkstemp(tmpPath);
+  folly::checkUnixError(tmpFD, "failed to create temporary file");
+  SCOPE_EXIT {
+    close(tmpFD);
+    unlink(tmpPath);
+  };
+
+  PcapWriter::Options options;
+  options.format = PcapFormat::PCAPNG;
+  PcapWriter writer(tmpPath, true, 0, options);
+  addPackets(&writer, 100);
+  writer.finish();
+
+  std::string contents;
+  ASSERT_TRUE(folly::readFile(tmpPath, contents));
+  // Starts with a section header block
+  ASSERT_GE(contents.size(), 4);
+  uint32_t blockType;
+  memcpy(&blockType, contents.data(), sizeof(blockType));
+  EXPECT_EQ(0x0a0d0d0a, blockType);
+
+  auto pcapPkts = readPcapFile(tmpPath);
+  EXPECT_EQ(100, pcapPkts.size());
+  for (const auto& pktInfo : pcapPkts) {
+    EXPECT_EQ(68, pktInfo.hdr.len);
+    EXPECT_EQ(68, pktInfo.hdr.caplen);
+  }
+}
@@ -0,0 +1,259 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "fboss/agent/hw/AclTcamPlanner.h"
+
+#include "fboss/agent/FbossError.h"
+
+#include <algorithm>
+#include <functional>
+
+namespace facebook { namespace fboss {
+
+namespace {
+
+/*
+ * Pick count of the sorted candidates, spread evenly over them.
+ */
+void spread(
+    const std::vector<int>& candidates,
+    size_t count,
+    std::vector<int>* picked) {
+  auto num = candidates.size();
+  for (size_t i = 0; i < count; ++i) {
+    picked->push_back(candidates[(2 * i + 1) * num / (2 * count)]);
+  }
+}
+
+/*
+ * The longest run of values that increase in the order given, returned as
+ * indices into values.
+ */
+std::vector<int> longestIncreasing(const std::vector<int>& values) {
+  // tails[len] is the index of the smallest value ending a run of len + 1
+  std::vector<int> tails;
+  std::vector<int> prev(values.size(), -1);
+  for (int i = 0; i < values.size(); ++i) {
+    auto pos = std::lower_bound(
+        tails.begin(), tails.end(), values[i], [&](int idx, int value) {
+          return values[idx] < value;
+        });
+    if (pos != tails.begin()) {
+      prev[i] = *(pos - 1);
+    }
+    if (pos == tails.end()) {
+      tails.push_back(i);
+    } else {
+      *pos = i;
+    }
+  }
+  std::vector<int> run;
+  for (int i = tails.empty() ? -1 : tails.back(); i >= 0; i = prev[i]) {
+    run.push_back(i);
+  }
+  std::reverse(run.begin(), run.end());
+  return run;
+}
+
+} // unnamed namespace
+
+AclTcamPlanner::AclTcamPlanner(int numSlices, int sliceSize)
+    : numSlices_(numSlices),
+      sliceSize_(sliceSize),
+      occupants_(numSlices * sliceSize) {
+  if (numSlices <= 0 || sliceSize <= 0) {
+    throw FbossError(
+        "Invalid ACL TCAM of ", numSlices, " slices of ", sliceSize);
+  }
+}
+
+folly::Optional<int> AclTcamPlanner::getSlot(const std::string& name) const {
+  auto iter = slots_.find(name);
+  if (iter == slots_.end()) {
+    return folly::none;
+  }
+  return iter->second;
+}
+
+bool AclTcamPlanner::place(
+    const std::vector<int>& pending,
+    int lo,
+    int hi,
+    std::vector<int>* slots) const {
+  if (pending.empty()) {
+    return true;
+  }
+  // Prefer free slots, so the entries can be programmed before any other
+  // leaves.  Slots of entries that are leaving are only used if we must.
+  std::vector<int> free;
+  std::vector<int> leaving;
+  for (int slot = lo + 1; slot < hi; ++slot) {
+    if (occupants_[slot].empty()) {
+      free.push_back(slot);
+    } else {
+      leaving.push_back(slot);
+    }
+  }
+  if (free.size() + leaving.size() < pending.size()) {
+    return false;
+  }
+
+  std::vector<int> picked;
+  if (free.size() >= pending.size()) {
+    spread(free, pending.size(), &picked);
+  } else {
+    picked = free;
+    spread(leaving, pending.size() - free.size(), &picked);
+    std::sort(picked.begin(), picked.end());
+  }
+  for (int i = 0; i < pending.size(); ++i) {
+    (*slots)[pending[i]] = picked[i];
+  }
+  return true;
+}
+
+AclTcamPlanner::Plan AclTcamPlanner::plan(
+    const std::vector<Entry>& entries) const {
+  int num = entries.size();
+  if (num > getNumSlots()) {
+    throw FbossError(
+        "Cannot fit ", num, " ACL entries in ", getNumSlots(), " slots");
+  }
+
+  std::vector<int> oldSlots(num, -1);
+  // The entries that might stay where they are, and their slots
+  std::vector<int> kept;
+  std::vector<int> keptSlots;
+  for (int i = 0; i < num; ++i) {
+    auto iter = slots_.find(entries[i].name);
+    if (iter == slots_.end()) {
+      continue;
+    }
+    oldSlots[i] = iter->second;
+    if (!entries[i].changed) {
+      kept.push_back(i);
+      keptSlots.push_back(iter->second);
+    }
+  }
+
+  // The most entries that can stay where they are are those whose slots
+  // are in the order they are now to be matched in.  The others are placed
+  // in between them.
+  std::vector<bool> anchored(num, false);
+  for (auto idx : longestIncreasing(keptSlots)) {
+    anchored[kept[idx]] = true;
+  }
+  Plan plan;
+  std::vector<int> newSlots(num, -1);
+  std::vector<int> pending;
+  int lo = -1;
+  bool fits = true;
+  for (int i = 0; i < num && fits; ++i) {
+    if (!anchored[i]) {
+      pending.push_back(i);
+      continue;
+    }
+    newSlots[i] = oldSlots[i];
+    fits = place(pending, lo, oldSlots[i], &newSlots);
+    lo = oldSlots[i];
+    pending.clear();
+  }
+  if (fits) {
+    fits = place(pending, lo, getNumSlots(), &newSlots);
+  }
+  if (!fits) {
+    plan.relaidOut = true;
+    for (int i = 0; i < num; ++i) {
+      newSlots[i] = (2 * i + 1) * getNumSlots() / (2 * num);
+    }
+  }
+
+  // Steps into free slots go first, then the removals, and then the steps
+  // that have to wait for another entry to leave their slot.
+  std::vector<Step> ready;
+  std::vector<Step> removes;
+  std::vector<Step> waiting;
+  std::map<std::string, int> newEntries;
+  for (int i = 0; i < num; ++i) {
+    const auto& entry = entries[i];
+    newEntries.emplace(entry.name, i);
+    if (!entry.changed && oldSlots[i] == newSlots[i]) {
+      ++plan.unmoved;
+      continue;
+    }
+    Step step;
+    step.name = entry.name;
+    step.slot = newSlots[i];
+    if (oldSlots[i] < 0) {
+      step.action = Action::ADD;
+    } else {
+      step.action = entry.changed ? Action::REPLACE : Action::MOVE;
+      if (getSlice(oldSlots[i]) != getSlice(newSlots[i])) {
+        ++plan.crossSliceMoves;
+      }
+    }
+    if (occupants_[step.slot].empty()) {
+      ready.push_back(std::move(step));
+    } else {
+      waiting.push_back(std::move(step));
+    }
+  }
+  for (const auto& entry : slots_) {
+    if (newEntries.find(entry.first) == newEntries.end()) {
+      removes.push_back(Step{Action::REMOVE, entry.first, entry.second});
+    }
+  }
+  plan.breakBeforeMake = waiting.size();
+
+  plan.steps = std::move(ready);
+  plan.steps.insert(plan.steps.end(), removes.begin(), removes.end());
+  // A waiting step goes after the step that moves the entry in its slot
+  // out of the way, if that is waiting too.  Where entries wait on each
+  // other in a cycle, one of them has to go first regardless.
+  std::map<std::string, int> waitingByName;
+  for (int i = 0; i < waiting.size(); ++i) {
+    waitingByName.emplace(waiting[i].name, i);
+  }
+  std::vector<int> state(waiting.size(), 0);
+  std::function<void(int)> visit = [&](int i) {
+    if (state[i] != 0) {
+      return;
+    }
+    state[i] = 1;
+    auto iter = waitingByName.find(occupants_[waiting[i].slot]);
+    if (iter != waitingByName.end() && iter->second != i) {
+      visit(iter->second);
+    }
+    state[i] = 2;
+    plan.steps.push_back(waiting[i]);
+  };
+  for (int i = 0; i < waiting.size(); ++i) {
+    visit(i);
+  }
+  return plan;
+}
+
+void AclTcamPlanner::apply(const Plan& plan) {
+  for (const auto& step : plan.steps) {
+    auto iter = slots_.find(step.name);
+    if (iter != slots_.end() && occupants_[iter->second] == step.name) {
+      occupants_[iter->second].clear();
+    }
+    if (step.action == Action::REMOVE) {
+      if (iter != slots_.end()) {
+        slots_.erase(iter);
+      }
+      continue;
+    }
+    occupants_[step.slot] = step.name;
+    slots_[step.name] = step.slot;
+  }
+}
+
+}} // facebook::fboss
@@ -0,0 +1,118 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#pragma once
+
+#include <folly/Optional.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+namespace facebook { namespace fboss {
+
+/*
+ * AclTcamPlanner works out where to put ACL entries in a TCAM made of
+ * numSlices slices of sliceSize entries each, and how to get there from
+ * where they are now with as few entries moved as possible.
+ *
+ * The TCAM is modelled as numSlices * sliceSize slots: an entry in a lower
+ * slot is matched before one in a higher slot, and slot / sliceSize is the
+ * slice it is in.  Only the order of the entries matters, so when entries
+ * are added or their priorities shift, the entries whose order relative to
+ * each other is unchanged stay where they are and only the others are moved
+ * or added, into the free slots between them.  Entries are spread evenly
+ * over the slots and slices, so that there is room left between them for
+ * the entries added later.
+ *
+ * Changed entries are replaced make-before-break: the new copy goes into a
+ * free slot before the old one is removed, so the entry is never missing.
+ * Only when there are no free slots left where it must go are other entries
+ * removed to make room first.
+ */
+class AclTcamPlanner {
+ public:
+  struct Entry {
+    std::string name;
+    // Whether the entry matches or does something else than the copy in
+    // the TCAM, and so must be replaced
+    bool changed{false};
+  };
+
+  enum class Action {
+    // A new entry
+    ADD,
+    // Add the new copy of a changed entry, and remove the old one
+    REPLACE,
+    // An unchanged entry that has to go to another slot
+    MOVE,
+    REMOVE,
+  };
+
+  struct Step {
+    Action action;
+    std::string name;
+    // The slot the entry goes to, or is removed from
+    int slot;
+  };
+
+  struct Plan {
+    // The steps in the order they are to be carried out
+    std::vector<Step> steps;
+    // Entries that stay where they are
+    int unmoved{0};
+    // MOVE and REPLACE steps that go to another slice
+    int crossSliceMoves{0};
+    // Steps that had to wait for another entry to leave their slot
+    int breakBeforeMake{0};
+    // Whether the entries did not fit where they had to go, so all had to
+    // be laid out again
+    bool relaidOut{false};
+  };
+
+  AclTcamPlanner(int numSlices, int sliceSize);
+
+  int getNumSlots() const {
+    return numSlices_ * sliceSize_;
+  }
+  int getSlice(int slot) const {
+    return slot / sliceSize_;
+  }
+  folly::Optional<int> getSlot(const std::string& name) const;
+
+  /*
+   * Plan how to program entries, in the order they are to be matched.
+   * Entries not in entries that are in the TCAM are removed.  Throws
+   * FbossError if there are more entries than slots.
+   */
+  Plan plan(const std::vector<Entry>& entries) const;
+
+  /*
+   * Record that the steps of plan were carried out.
+   */
+  void apply(const Plan& plan);
+
+ private:
+  // Pick slots for the pending entries, strictly between the slots lo and
+  // hi, in order.  Returns false if they do not fit.
+  bool place(
+      const std::vector<int>& pending,
+      int lo,
+      int hi,
+      std::vector<int>* slots) const;
+
+  const int numSlices_;
+  const int sliceSize_;
+  // Where each entry in the TCAM is
+  std::map<std::string, int> slots_;
+  // Which entry is in each slot, or an empty string
+  std::vector<std::string> occupants_;
+};
+
+}} // facebook::fboss
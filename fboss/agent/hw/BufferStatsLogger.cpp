@@ -37,5 +37,56 @@ void GlogBufferStatsLogger::logPortBufferStat(
              << " Packets dropped: " << pktsDropeed
              << " XPEs: " << xpeStr(xpes);
 }
+
+constexpr int64_t RecordingBufferStatsLogger::kUnknown;
+
+void RecordingBufferStatsLogger::logDeviceBufferStat(
+    uint64_t bytesUsed,
+    uint64_t bytesMax) {
+  deviceStats_.bytesUsed = bytesUsed;
+  deviceStats_.bytesMax = bytesMax;
+  if (next_) {
+    next_->logDeviceBufferStat(bytesUsed, bytesMax);
+  }
+}
+
+void RecordingBufferStatsLogger::logPortBufferStat(
+    const std::string& portName,
+    Direction dir, unsigned int cosQ,
+    uint64_t bytesUsed, uint64_t pktsDropped,
+    const XPEs& xpes) {
+  auto& stats = getStats(Key(portName, dir, cosQ));
+  stats.bytesUsed = bytesUsed;
+  stats.pktsDropped = pktsDropped;
+  if (next_) {
+    next_->logPortBufferStat(
+        portName, dir, cosQ, bytesUsed, pktsDropped, xpes);
+  }
+}
+
+const RecordingBufferStatsLogger::Stats&
+RecordingBufferStatsLogger::getPortStats(
+    const std::string& portName,
+    Direction dir,
+    unsigned int cosQ) {
+  return getStats(Key(portName, dir, cosQ));
+}
+
+RecordingBufferStatsLogger::Stats& RecordingBufferStatsLogger::getStats(
+    const Key& key) {
+  {
+    auto portStats = portStats_.rlock();
+    auto it = portStats->find(key);
+    if (it != portStats->end()) {
+      return *it->second;
+    }
+  }
+  auto portStats = portStats_.wlock();
+  auto& stats = (*portStats)[key];
+  if (!stats) {
+    stats = std::make_unique<Stats>();
+  }
+  return *stats;
+}
 }
 }
@@ -10,7 +10,13 @@
 #pragma once
 
 #include <folly/String.h>
+#include <folly/Synchronized.h>
+
+#include <atomic>
+#include <map>
+#include <memory>
 #include <string>
+#include <tuple>
 #include <vector>
 
 
@@ -56,5 +62,67 @@ class GlogBufferStatsLogger : public BufferStatsLogger {
       uint64_t pktsDropped,
       const XPEs& xpes) override;
 };
+
+/*
+ * RecordingBufferStatsLogger keeps the latest buffer stats logged for the
+ * device and for each port queue, so that counter subscriptions can report
+ * them, and passes them on to another logger.  The stats only change as
+ * often as the buffer stats collection logs them.
+ *
+ * The stats of a queue are kept in atomics that stay where they are once
+ * created, so readers look them up once and then read them without a lock.
+ */
+class RecordingBufferStatsLogger : public BufferStatsLogger {
+ public:
+  // The value of a stat that has not been logged yet
+  static constexpr int64_t kUnknown = -1;
+
+  struct Stats {
+    std::atomic<int64_t> bytesUsed{kUnknown};
+    std::atomic<int64_t> pktsDropped{kUnknown};
+    // Only logged for the device
+    std::atomic<int64_t> bytesMax{kUnknown};
+  };
+
+  explicit RecordingBufferStatsLogger(std::unique_ptr<BufferStatsLogger> next)
+      : next_(std::move(next)) {}
+
+  void logDeviceBufferStat(uint64_t bytesUsed, uint64_t bytesMax) override;
+  void logPortBufferStat(
+      const std::string& portName,
+      Direction dir,
+      unsigned int cosQ,
+      uint64_t bytesUsed,
+      uint64_t pktsDropped,
+      const XPEs& xpes) override;
+
+  const Stats& getDeviceStats() const {
+    return deviceStats_;
+  }
+  // Created, with unknown values, if nothing was logged for the queue yet
+  const Stats& getPortStats(
+      const std::string& portName,
+      Direction dir,
+      unsigned int cosQ);
+
+  using Key = std::tuple<std::string, Direction, unsigned int>;
+  // Calls fn(key, stats) for every queue, in (port, direction, queue) order.
+  // The queues are locked meanwhile, so fn must not look any up.
+  template <typename Fn>
+  void forEachPortStats(Fn fn) const {
+    auto portStats = portStats_.rlock();
+    for (const auto& entry : *portStats) {
+      fn(entry.first, *entry.second);
+    }
+  }
+
+ private:
+
+  Stats& getStats(const Key& key);
+
+  std::unique_ptr<BufferStatsLogger> next_;
+  Stats deviceStats_;
+  folly::Synchronized<std::map<Key, std::unique_ptr<Stats>>> portStats_;
+};
 }
 }
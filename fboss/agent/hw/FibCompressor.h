@@ -0,0 +1,199 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#pragma once
+
+#include "fboss/lib/RadixTree.h"
+
+#include <vector>
+
+namespace facebook { namespace fboss {
+
+/*
+ * FibCompressor works out which routes of a RIB need to be in the hardware
+ * LPM table for it to forward the same as the whole RIB, as the routes
+ * change.
+ *
+ * A route is redundant when its closest covering route in the RIB forwards
+ * the same (Forward is compared with ==): the covering route, or whatever
+ * covers it in turn, forwards the more specific route's traffic just the
+ * same.  Only the routes that are not redundant are installed.  Unlike a
+ * full ORTC aggregation no new prefixes are made up, so the hardware never
+ * holds a route the RIB doesn't, and a route change only touches the route
+ * and the routes it is the closest covering route of.
+ *
+ * The changes to make in hardware are returned in the order to make them:
+ * routes that are now needed are installed before the change to the route
+ * that stopped covering them, and routes are removed only after the route
+ * that now covers them, so no traffic is forwarded wrongly in between.
+ */
+template <typename AddrT, typename Forward>
+class FibCompressor {
+ public:
+  struct Change {
+    enum class Type {
+      // Add the route to hardware, or change its forwarding there
+      INSTALL,
+      REMOVE,
+    };
+    Type type;
+    AddrT network;
+    uint8_t mask;
+  };
+  using Changes = std::vector<Change>;
+
+  /*
+   * Add a route to the RIB, or change its forwarding, appending the
+   * hardware changes to make for it to changes.
+   */
+  void update(
+      const AddrT& network,
+      uint8_t mask,
+      const Forward& forward,
+      Changes* changes) {
+    auto ret = tree_.insert(network, mask, Entry{forward, false});
+    auto* node = ret.first.node();
+    auto& entry = node->value();
+    bool wasInstalled = entry.installed;
+    bool forwardChanged = !ret.second && !(entry.forward == forward);
+    if (forwardChanged) {
+      entry.forward = forward;
+    }
+    auto* parent = getParent(node);
+    entry.installed = !parent || !(parent->value().forward == forward);
+    if (ret.second) {
+      ++numRoutes_;
+    }
+    if (entry.installed && !wasInstalled) {
+      ++numInstalled_;
+    } else if (!entry.installed && wasInstalled) {
+      --numInstalled_;
+    }
+
+    Changes removed;
+    if (ret.second || forwardChanged) {
+      updateChildren(node, &forward, changes, &removed);
+    }
+    if (entry.installed && (!wasInstalled || forwardChanged)) {
+      changes->push_back(makeChange(Change::Type::INSTALL, node));
+    } else if (!entry.installed && wasInstalled) {
+      changes->push_back(makeChange(Change::Type::REMOVE, node));
+    }
+    changes->insert(changes->end(), removed.begin(), removed.end());
+  }
+
+  /*
+   * Remove a route from the RIB, if it is there, appending the hardware
+   * changes to make for it to changes.
+   */
+  void remove(const AddrT& network, uint8_t mask, Changes* changes) {
+    auto iter = tree_.exactMatch(network, mask);
+    if (iter == tree_.end()) {
+      return;
+    }
+    auto* node = iter.node();
+    // Its children are now covered by its parent, if any
+    auto* parent = getParent(node);
+    Changes removed;
+    updateChildren(
+        node,
+        parent ? &parent->value().forward : nullptr,
+        changes,
+        &removed);
+    if (node->value().installed) {
+      changes->push_back(makeChange(Change::Type::REMOVE, node));
+      --numInstalled_;
+    }
+    changes->insert(changes->end(), removed.begin(), removed.end());
+    tree_.erase(iter);
+    --numRoutes_;
+  }
+
+  // The routes in the RIB, and those of them installed in hardware
+  size_t numRoutes() const {
+    return numRoutes_;
+  }
+  size_t numInstalled() const {
+    return numInstalled_;
+  }
+  bool isInstalled(const AddrT& network, uint8_t mask) const {
+    auto iter = tree_.exactMatch(network, mask);
+    return iter != tree_.end() && iter.node()->value().installed;
+  }
+
+ private:
+  struct Entry {
+    Forward forward;
+    bool installed;
+  };
+  using Tree = network::RadixTree<AddrT, Entry>;
+  using Node = typename Tree::TreeNode;
+
+  static Change makeChange(typename Change::Type type, const Node* node) {
+    return Change{type, node->ipAddress(), uint8_t(node->masklen())};
+  }
+
+  // The closest route covering the node's
+  static Node* getParent(Node* node) {
+    for (auto* parent = node->parent(); parent; parent = parent->parent()) {
+      if (parent->isValueNode()) {
+        return parent;
+      }
+    }
+    return nullptr;
+  }
+
+  template <typename F>
+  static void forEachChild(Node* node, const F& f) {
+    for (auto* child : {node->left(), node->right()}) {
+      if (!child) {
+        continue;
+      }
+      if (child->isValueNode()) {
+        f(child);
+      } else {
+        forEachChild(child, f);
+      }
+    }
+  }
+
+  /*
+   * Work out again which of the routes the node's route is the closest
+   * covering route of are redundant, now that what covers them forwards
+   * as covering does, or nothing does if it is null.  Routes to install
+   * are appended to installed, routes to remove to removed.
+   */
+  void updateChildren(
+      Node* node,
+      const Forward* covering,
+      Changes* installed,
+      Changes* removed) {
+    forEachChild(node, [&](Node* child) {
+      auto& entry = child->value();
+      bool install = !covering || !(entry.forward == *covering);
+      if (install == entry.installed) {
+        return;
+      }
+      entry.installed = install;
+      if (install) {
+        installed->push_back(makeChange(Change::Type::INSTALL, child));
+        ++numInstalled_;
+      } else {
+        removed->push_back(makeChange(Change::Type::REMOVE, child));
+        --numInstalled_;
+      }
+    });
+  }
+
+  Tree tree_;
+  size_t numRoutes_{0};
+  size_t numInstalled_{0};
+};
+
+}} // facebook::fboss
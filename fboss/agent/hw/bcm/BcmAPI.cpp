@@ -35,6 +35,11 @@ std::unique_ptr<BcmAPI> BcmAPI::singleton_;
 std::unique_ptr<BcmUnit> BcmAPI::initUnit(
     int deviceIndex,
     BcmPlatform* platform) {
+  if (deviceIndex < 0 ||
+      static_cast<size_t>(deviceIndex) >= BcmAPI::getNumSwitches()) {
+    throw FbossError("no Broadcom switching ASIC at index ", deviceIndex,
+                     ", found ", BcmAPI::getNumSwitches());
+  }
   auto unitObj = make_unique<BcmUnit>(deviceIndex, platform);
   int unit = unitObj->getNumber();
   BcmUnit* expectedUnit{nullptr};
@@ -75,6 +80,12 @@ void BcmAPI::unitDestroyed(BcmUnit* unit) {
                 << ": expected " << (void*)unit << " but found "
                 << (void*)expectedUnit;
   }
+  // The SDK stays initialized for the other units of a multi-unit system
+  for (size_t i = 0; i < BcmAPI::getMaxSwitches(); ++i) {
+    if (bcmUnits[i].load(std::memory_order_acquire)) {
+      return;
+    }
+  }
   bcmInitialized.store(false, std::memory_order_release);
 }
 
@@ -59,6 +59,22 @@ class BcmAPI {
    */
   static std::unique_ptr<BcmUnit> initOnlyUnit(BcmPlatform* platform);
 
+  /*
+   * Create a BcmUnit for one of several BCM switches in the system, by its
+   * index from 0 to getNumSwitches() - 1.
+   *
+   * The unit will not have been initialized yet, and must still
+   * be initialized with BcmUnit::attach().
+   *
+   * All devices should be initialized from the main thread, before
+   * performing BCM SDK calls from other threads.  The Broadcom SDK does
+   * not appear to perform locking around device ID allocation and
+   * initialization.
+   */
+  static std::unique_ptr<BcmUnit> initUnit(
+      int deviceIndex,
+      BcmPlatform* platform);
+
   /*
    * Indicate that a BcmUnit object is being destroyed.
    *
@@ -90,20 +106,6 @@ class BcmAPI {
   static HwConfigMap getHwConfig();
 
  private:
-  /*
-   * Create a BcmUnit.
-   *
-   * The unit will not have been initialized yet, and must still
-   * be initialized with BcmUnit::attach().
-   *
-   * All devices should be initialized from the main thread, before
-   * performing BCM SDK calls from other threads.  The Broadcom SDK does
-   * not appear to perform locking around device ID allocation and
-   * initialization.
-   */
-  static std::unique_ptr<BcmUnit> initUnit(
-      int deviceIndex,
-      BcmPlatform* platform);
 
   // Forbidden copy constructor and assignment operator
   BcmAPI(BcmAPI const &) = delete;
@@ -9,6 +9,7 @@
  */
 #pragma once
 
+#include "fboss/agent/hw/bcm/BcmAclRange.h"
 #include "fboss/agent/hw/bcm/BcmAclStat.h"
 #include "fboss/agent/FbossError.h"
 #include "fboss/agent/types.h"
@@ -21,7 +22,6 @@ using BcmAclEntryHandle = int;
 
 class BcmSwitch;
 class AclEntry;
-class BcmAclRange;
 
 
 /**
@@ -31,10 +31,16 @@ class BcmAclEntry {
 public:
 
   using BcmAclRanges = std::vector<BcmAclRange *>;
+  using BcmAclRangeMasks = std::vector<AclRangeMask>;
 
+  /*
+   * ranges are matched by range checkers, and rangeMasks by value and mask.
+   * A range with more than one mask is matched by one TCAM entry per mask.
+   */
   BcmAclEntry(BcmSwitch* hw, int gid,
     const std::shared_ptr<AclEntry>& acl,
-    const BcmAclRanges& ranges);
+    const BcmAclRanges& ranges,
+    const BcmAclRangeMasks& rangeMasks = BcmAclRangeMasks());
   ~BcmAclEntry();
   BcmAclEntryHandle getHandle() const {
     return handle_;
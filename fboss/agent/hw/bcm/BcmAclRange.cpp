@@ -11,9 +11,29 @@
 
 #include <folly/Conv.h>
 
+#include <algorithm>
+
 namespace facebook {
 namespace fboss {
 
+std::vector<std::pair<uint32_t, uint32_t>> AclRange::getPrefixes() const {
+  constexpr uint64_t kFieldSize = 1ULL << kFieldWidth;
+  std::vector<std::pair<uint32_t, uint32_t>> prefixes;
+  uint64_t lo = min_;
+  uint64_t hi = std::min<uint64_t>(max_, kFieldSize - 1);
+  while (lo <= hi) {
+    // The largest block aligned at lo that does not go past hi
+    uint64_t size = lo == 0 ? kFieldSize : (lo & -lo);
+    while (lo + size - 1 > hi) {
+      size >>= 1;
+    }
+    uint32_t mask = (kFieldSize - 1) & ~(size - 1);
+    prefixes.emplace_back(lo, mask);
+    lo += size;
+  }
+  return prefixes;
+}
+
 std::string AclRange::str() const {
   std::string ret;
   ret = "flags=";
@@ -12,6 +12,7 @@
 #include <cstdint>
 #include <string>
 #include <tuple>
+#include <vector>
 
 namespace facebook {
 namespace fboss {
@@ -75,6 +76,16 @@ public:
     return max_ == min_;
   }
 
+  // The width in bits of the field the range is on
+  static constexpr int kFieldWidth = 16;
+
+  /*
+   * The fewest value and mask pairs that together match the range, that
+   * is the range split into aligned blocks of powers of two.  A range of
+   * the whole field is a single pair with a mask of 0.
+   */
+  std::vector<std::pair<uint32_t, uint32_t>> getPrefixes() const;
+
   std::string str() const;
 
 private:
@@ -83,6 +94,16 @@ private:
   uint32_t max_;
 };
 
+/**
+ * A range that is matched by TCAM value and mask, rather than by a range
+ * checker
+ */
+struct AclRangeMask {
+  uint32_t flags;
+  uint32_t value;
+  uint32_t mask;
+};
+
 /**
  *  BcmAclRange is the class to abstract an range's resources and functions
  */
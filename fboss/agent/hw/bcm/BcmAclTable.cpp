@@ -14,11 +14,41 @@
 #include "fboss/agent/hw/bcm/BcmSwitch.h"
 #include "fboss/agent/hw/bcm/BcmWarmBootCache.h"
 #include "fboss/agent/FbossError.h"
+#include "fboss/agent/state/AclMap.h"
+#include "fboss/agent/state/StateDelta.h"
+#include "fboss/agent/state/SwitchState.h"
 
 #include <folly/CppAttributes.h>
+#include <gflags/gflags.h>
+
+#include <algorithm>
+
+DEFINE_int32(acl_tcam_slices, 4,
+             "The number of TCAM slices ACL entries are placed across");
+DEFINE_int32(acl_tcam_slice_size, 256,
+             "The number of ACL entries in each TCAM slice");
+DEFINE_int32(acl_range_max_tcam_entries, 1,
+             "Match ACL port and packet length ranges by value and mask "
+             "rather than by range checker when an ACL then takes at most "
+             "this many TCAM entries; 0 always uses range checkers");
 
 namespace facebook { namespace fboss {
 
+namespace {
+
+bool isSameIgnoringPriority(
+    const std::shared_ptr<AclEntry>& oldAcl,
+    const std::shared_ptr<AclEntry>& newAcl) {
+  auto acl = newAcl->clone();
+  acl->setPriority(oldAcl->getPriority());
+  return *acl == *oldAcl;
+}
+
+} // unnamed namespace
+
+BcmAclTable::BcmAclTable(BcmSwitch* hw)
+    : hw_(hw), planner_(FLAGS_acl_tcam_slices, FLAGS_acl_tcam_slice_size) {}
+
 /*
  * Release all acl, stat and range entries.
  * Should only be called when we are about to reset/destroy the acl table
@@ -35,28 +65,18 @@ void BcmAclTable::processAddedAcl(
   const std::shared_ptr<AclEntry>& acl) {
   // check if range exists
   BcmAclEntry::BcmAclRanges bcmRanges;
-  if (acl->getSrcL4PortRange() &&
-      !acl->getSrcL4PortRange().value().isExactMatch()) {
-    AclL4PortRange r = acl->getSrcL4PortRange().value();
-    AclRange range(AclRange::SRC_L4_PORT, r.getMin(), r.getMax());
-    BcmAclRange* bcmRange = incRefOrCreateBcmAclRange(range);
-    bcmRanges.push_back(bcmRange);
+  BcmAclEntry::BcmAclRangeMasks rangeMasks;
+  auto encoding = getRangeEncoding(acl);
+  for (const auto& range : encoding.checkerRanges) {
+    bcmRanges.push_back(incRefOrCreateBcmAclRange(range));
   }
-
-  if (acl->getDstL4PortRange() &&
-      !acl->getDstL4PortRange().value().isExactMatch()) {
-    AclL4PortRange r = acl->getDstL4PortRange().value();
-    AclRange range(AclRange::DST_L4_PORT, r.getMin(), r.getMax());
-    BcmAclRange* bcmRange = incRefOrCreateBcmAclRange(range);
-    bcmRanges.push_back(bcmRange);
-  }
-
-  if (acl->getPktLenRange()) {
-    AclPktLenRange r = acl->getPktLenRange().value();
-    AclRange range(AclRange::PKT_LEN, r.getMin(), r.getMax());
-    BcmAclRange* bcmRange = incRefOrCreateBcmAclRange(range);
-    bcmRanges.push_back(bcmRange);
+  for (const auto& range : encoding.maskedRanges) {
+    for (const auto& prefix : range.getPrefixes()) {
+      rangeMasks.push_back(
+          AclRangeMask{range.getFlags(), prefix.first, prefix.second});
+    }
   }
+  numMaskedRanges_ += encoding.maskedRanges.size();
 
   // check if stat exists
   auto action = acl->getAclAction();
@@ -67,7 +87,7 @@ void BcmAclTable::processAddedAcl(
 
   // create the new bcm acl entry and add it to the table
   std::unique_ptr<BcmAclEntry> bcmAcl = std::make_unique<BcmAclEntry>(
-    hw_, groupId, acl, bcmRanges);
+    hw_, groupId, acl, bcmRanges, rangeMasks);
   const auto& entry = aclEntryMap_.emplace(acl->getPriority(),
       std::move(bcmAcl));
   if (!entry.second) {
@@ -92,23 +112,65 @@ void BcmAclTable::processRemovedAcl(
   }
 
   // remove unused ranges
+  auto encoding = getRangeEncoding(acl);
+  for (const auto& range : encoding.checkerRanges) {
+    derefBcmAclRange(range);
+  }
+  numMaskedRanges_ -= encoding.maskedRanges.size();
+}
+
+BcmAclTable::RangeEncoding BcmAclTable::getRangeEncoding(
+    const std::shared_ptr<AclEntry>& acl) {
+  std::vector<AclRange> ranges;
+  // Exact L4 ports are matched as ports, without a range
   if (acl->getSrcL4PortRange() &&
       !acl->getSrcL4PortRange().value().isExactMatch()) {
     AclL4PortRange r = acl->getSrcL4PortRange().value();
-    AclRange range(AclRange::SRC_L4_PORT, r.getMin(), r.getMax());
-    derefBcmAclRange(range);
+    ranges.emplace_back(AclRange::SRC_L4_PORT, r.getMin(), r.getMax());
   }
   if (acl->getDstL4PortRange() &&
       !acl->getDstL4PortRange().value().isExactMatch()) {
     AclL4PortRange r = acl->getDstL4PortRange().value();
-    AclRange range(AclRange::DST_L4_PORT, r.getMin(), r.getMax());
-    derefBcmAclRange(range);
+    ranges.emplace_back(AclRange::DST_L4_PORT, r.getMin(), r.getMax());
   }
   if (acl->getPktLenRange()) {
     AclPktLenRange r = acl->getPktLenRange().value();
-    AclRange range(AclRange::PKT_LEN, r.getMin(), r.getMax());
-    derefBcmAclRange(range);
+    ranges.emplace_back(AclRange::PKT_LEN, r.getMin(), r.getMax());
+  }
+
+  // Range checkers are few, so match a range by value and mask instead
+  // when that takes no more than --acl_range_max_tcam_entries TCAM entries
+  // for the ACL.  Each range matched this way multiplies the entries the
+  // ACL takes by its number of masks, so pick the ranges with the fewest
+  // first.
+  std::vector<std::pair<int64_t, size_t>> byPrefixes;
+  for (size_t i = 0; i < ranges.size(); ++i) {
+    byPrefixes.emplace_back(ranges[i].getPrefixes().size(), i);
+  }
+  std::sort(byPrefixes.begin(), byPrefixes.end());
+  std::vector<bool> masked(ranges.size(), false);
+  int64_t tcamEntries = 1;
+  for (const auto& entry : byPrefixes) {
+    if (tcamEntries * entry.first <= FLAGS_acl_range_max_tcam_entries) {
+      tcamEntries *= entry.first;
+      masked[entry.second] = true;
+    }
   }
+
+  RangeEncoding encoding;
+  for (size_t i = 0; i < ranges.size(); ++i) {
+    auto prefixes = ranges[i].getPrefixes();
+    if (prefixes.size() == 1 && prefixes[0].second == 0) {
+      // The range matches anything, so needs no match at all
+      continue;
+    }
+    if (masked[i]) {
+      encoding.maskedRanges.push_back(ranges[i]);
+    } else {
+      encoding.checkerRanges.push_back(ranges[i]);
+    }
+  }
+  return encoding;
 }
 
 BcmAclEntry* FOLLY_NULLABLE BcmAclTable::getAclIf(int priority) const {
@@ -150,6 +212,10 @@ folly::Optional<uint32_t> BcmAclTable::getAclRangeRefCountIf(
   return refCount;
 }
 
+uint32_t BcmAclTable::getAclEntryCount() const {
+  return aclEntryMap_.size();
+}
+
 uint32_t BcmAclTable::getAclRangeCount() const {
   return aclRangeMap_.size();
 }
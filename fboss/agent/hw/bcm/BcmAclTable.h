@@ -9,6 +9,7 @@
  */
 #pragma once
 
+#include "fboss/agent/hw/AclTcamPlanner.h"
 #include "fboss/agent/state/AclEntry.h"
 #include "fboss/agent/hw/bcm/BcmAclEntry.h"
 #include "fboss/agent/hw/bcm/BcmAclRange.h"
@@ -21,19 +22,21 @@ namespace facebook { namespace fboss {
 class AclRange;
 class BcmSwitch;
 class BcmAclRange;
+class StateDelta;
 
 /**
  * A class to keep state related to acl entries in BcmSwitch
  */
 class BcmAclTable {
  public:
-  explicit BcmAclTable(BcmSwitch* hw) : hw_(hw) {}
+  explicit BcmAclTable(BcmSwitch* hw);
   ~BcmAclTable() {}
   void processAddedAcl(const int groupId, const std::shared_ptr<AclEntry>& acl);
   void processRemovedAcl(const std::shared_ptr<AclEntry>& acl);
   void releaseAcls();
 
   BcmAclEntry* getAclIf(int priority) const;
+  uint32_t getAclEntryCount() const;
   // return nullptr if not found
   BcmAclRange*  getAclRangeIf(const AclRange& range) const;
   // return 0 if range does not exist
@@ -42,13 +45,40 @@ class BcmAclTable {
   folly::Optional<uint32_t> getAclRangeRefCountIf(
     BcmAclRangeHandle handle) const;
   uint32_t getAclRangeCount() const;
+  // The number of ranges matched by value and mask instead of by a range
+  // checker, counting each ACL using one
+  uint32_t getAclMaskedRangeCount() const {
+    return numMaskedRanges_;
+  }
   // return nullptr if not found
   BcmAclStat* getAclStatIf(const std::string& name) const;
   // return 0 if stat does not exist
   uint32_t getAclStatRefCount(const std::string& name) const;
   uint32_t getAclStatCount() const;
 
+  /*
+   * Plan the fewest ACL entry changes that program the ACLs of delta, with
+   * the entries placed across the TCAM slices by slot.  Entries whose
+   * priorities shift without changing their order are left alone.
+   */
+  AclTcamPlanner::Plan planAclChanges(const StateDelta& delta) const;
+  void aclChangesPlanned(const AclTcamPlanner::Plan& plan);
+  // The TCAM slot an entry is placed in by the plans, if any
+  folly::Optional<int> getAclSlot(const std::string& name) const {
+    return planner_.getSlot(name);
+  }
+
  private:
+  /*
+   * How the ranges of an ACL are matched: with range checkers, or by value
+   * and mask when that takes fewer hardware resources.
+   */
+  struct RangeEncoding {
+    std::vector<AclRange> checkerRanges;
+    std::vector<AclRange> maskedRanges;
+  };
+  static RangeEncoding getRangeEncoding(const std::shared_ptr<AclEntry>& acl);
+
   BcmAclRange* incRefOrCreateBcmAclRange(const AclRange& range);
   BcmAclRange* derefBcmAclRange(const AclRange& range);
   BcmAclStat* incRefOrCreateBcmAclStat(int groupId, const std::string& name);
@@ -66,6 +96,8 @@ class BcmAclTable {
   BcmAclRangeMap aclRangeMap_;
   BcmAclEntryMap aclEntryMap_;
   BcmAclStatMap aclStatMap_;
+  AclTcamPlanner planner_;
+  uint32_t numMaskedRanges_{0};
 };
 
 }} // facebook::fboss
@@ -0,0 +1,90 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "fboss/agent/hw/bcm/BcmBufferStatsSampler.h"
+
+#include "fboss/agent/hw/bcm/gen-cpp2/hardware_stats_constants.h"
+
+#include <folly/Conv.h>
+#include <folly/String.h>
+#include <folly/logging/xlog.h>
+
+namespace facebook { namespace fboss {
+
+namespace {
+
+constexpr auto kDevice = "device";
+constexpr auto kIngress = "ingress";
+constexpr auto kEgress = "egress";
+constexpr auto kBytesUsed = "bytes_used";
+constexpr auto kPktsDropped = "pkts_dropped";
+
+const std::atomic<int64_t>* getStat(
+    const RecordingBufferStatsLogger::Stats& stats,
+    folly::StringPiece statName) {
+  if (statName == kBytesUsed) {
+    return &stats.bytesUsed;
+  } else if (statName == kPktsDropped) {
+    return &stats.pktsDropped;
+  }
+  return nullptr;
+}
+
+} // unnamed namespace
+
+BcmBufferStatsSampler::BcmBufferStatsSampler(
+    RecordingBufferStatsLogger* recorder,
+    const std::set<CounterRequest>& counters) {
+  for (const auto& c : counters) {
+    std::vector<folly::StringPiece> parts;
+    folly::split('.', c.counterName, parts);
+    const std::atomic<int64_t>* value = nullptr;
+    if (parts.size() == 2 && parts[0] == kDevice &&
+        parts[1] == kBytesUsed) {
+      value = &recorder->getDeviceStats().bytesUsed;
+    } else if (parts.size() == 4 &&
+               (parts[1] == kIngress || parts[1] == kEgress)) {
+      auto cosQ = folly::tryTo<unsigned int>(parts[2]);
+      if (cosQ.hasValue()) {
+        auto dir = parts[1] == kIngress
+            ? BufferStatsLogger::Direction::Ingress
+            : BufferStatsLogger::Direction::Egress;
+        value = getStat(
+            recorder->getPortStats(parts[0].str(), dir, *cosQ), parts[3]);
+      }
+    }
+    if (!value) {
+      XLOG(WARNING) << "Requested counter " << c.counterName
+                    << " is not a buffer stat";
+      continue;
+    }
+    counters_.push_back(Counter{c, value});
+  }
+}
+
+void BcmBufferStatsSampler::sample(int64_t* values) {
+  for (const auto& counter : counters_) {
+    // Every counter needs a value for each sample, so report the ones that
+    // were not collected yet as uninitialized
+    int64_t value = counter.value->load(std::memory_order_relaxed);
+    if (value == RecordingBufferStatsLogger::kUnknown) {
+      value = hardware_stats_constants::STAT_UNINITIALIZED();
+    }
+    *values++ = value;
+  }
+}
+
+void BcmBufferStatsSampler::getCounters(
+    std::vector<CounterRequest>* counters) const {
+  for (const auto& counter : counters_) {
+    counters->push_back(counter.req);
+  }
+}
+
+}} // facebook::fboss
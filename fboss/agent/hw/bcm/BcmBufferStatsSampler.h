@@ -0,0 +1,50 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#pragma once
+
+#include "fboss/agent/HighresCounterUtil.h"
+#include "fboss/agent/hw/BufferStatsLogger.h"
+
+#include <set>
+#include <vector>
+
+namespace facebook { namespace fboss {
+
+/*
+ * A sampler for MMU buffer usage.  This doesn't read the hardware: each
+ * sample reports the stats the fine grained buffer stats collection last
+ * logged, so the values only change as often as they are collected, however
+ * often the subscription samples them.  Counters are named
+ * "device.bytes_used" for the device, and
+ * "<port name>.<ingress|egress>.<cos queue>.<bytes_used|pkts_dropped>"
+ * for a port queue, for example "eth1/1/1.egress.2.bytes_used".
+ */
+class BcmBufferStatsSampler : public HighresSampler {
+ public:
+  BcmBufferStatsSampler(
+      RecordingBufferStatsLogger* recorder,
+      const std::set<CounterRequest>& counters);
+  ~BcmBufferStatsSampler() override {}
+  void sample(int64_t* values) override;
+  int numCounters() const override { return counters_.size(); }
+  void getCounters(std::vector<CounterRequest>* counters) const override;
+
+  static constexpr const char* const kIdentifier = "bcm_buffer";
+
+ private:
+  struct Counter {
+    CounterRequest req;
+    const std::atomic<int64_t>* value;
+  };
+
+  std::vector<Counter> counters_;
+};
+
+}} // facebook::fboss
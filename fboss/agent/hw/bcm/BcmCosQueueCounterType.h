@@ -19,7 +19,11 @@ enum class BcmCosQueueStatType {
   DROPPED_PACKETS,
   DROPPED_BYTES,
   OUT_PACKETS,
-  OUT_BYTES
+  OUT_BYTES,
+  // Dropped early by the queue's active queue management
+  WRED_DROPPED_PACKETS,
+  // Marked with Congestion Experienced instead of being dropped
+  ECN_MARKED_PACKETS
 };
 
 enum class BcmCosQueueCounterScope {
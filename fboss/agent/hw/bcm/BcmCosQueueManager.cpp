@@ -9,8 +9,129 @@
  */
 #include "fboss/agent/hw/bcm/BcmCosQueueManager.h"
 
+#include "fboss/agent/FbossError.h"
+
+#include <folly/logging/xlog.h>
+
 namespace facebook { namespace fboss {
 
+BcmCosQueueManager::QueueChanges BcmCosQueueManager::getQueueChanges(
+    opennsl_gport_t gport,
+    const PortQueue& queue) const {
+  QueueChanges changes;
+  auto it = queueSettings_.find(gport);
+  if (it == queueSettings_.end()) {
+    changes.schedulingAndWeight = true;
+    changes.reservedBytes = true;
+    changes.sharedBytes = true;
+    changes.scalingFactor = true;
+    changes.aqm = true;
+    return changes;
+  }
+  const auto& current = *it->second;
+  changes.schedulingAndWeight =
+      current.getScheduling() != queue.getScheduling() ||
+      current.getWeight() != queue.getWeight();
+  changes.reservedBytes =
+      current.getReservedBytes() != queue.getReservedBytes();
+  changes.sharedBytes = current.getSharedBytes() != queue.getSharedBytes();
+  changes.scalingFactor =
+      current.getScalingFactor() != queue.getScalingFactor();
+  changes.aqm = current.getAqm() != queue.getAqm();
+  XLOG_IF(DBG2, !changes.any())
+      << "Settings of queue " << static_cast<int>(queue.getID()) << " on "
+      << portName_ << " are already programmed";
+  return changes;
+}
+
+void BcmCosQueueManager::setQueueSettings(
+    opennsl_gport_t gport,
+    const std::shared_ptr<const PortQueue>& queue) const {
+  queueSettings_[gport] = queue;
+}
+
+void BcmCosQueueManager::getSharedBytes(
+    opennsl_gport_t gport,
+    int queueIdx,
+    std::shared_ptr<PortQueue> queue) const {
+  queue->setSharedBytes(getControlValue(
+      queue->getStreamType(),
+      gport,
+      queueIdx,
+      BcmCosQueueControlType::SHARED_BYTES));
+}
+
+void BcmCosQueueManager::programSharedBytes(
+    opennsl_gport_t gport,
+    int queueIdx,
+    const std::shared_ptr<PortQueue>& queue) {
+  // Without a limit in the config the queue keeps the one it has
+  if (!queue->getSharedBytes()) {
+    return;
+  }
+  programControlValue(
+      queue->getStreamType(),
+      gport,
+      queueIdx,
+      BcmCosQueueControlType::SHARED_BYTES,
+      *queue->getSharedBytes());
+}
+
+BcmCosQueueManager::AqmProfiles BcmCosQueueManager::getAqmProfiles(
+    const folly::Optional<cfg::ActiveQueueManagement>& aqm) {
+  AqmProfiles profiles;
+  if (!aqm) {
+    return profiles;
+  }
+  const auto& linear = aqm->detection.get_linear();
+  if (linear.minimumLength < 0 ||
+      linear.maximumLength < linear.minimumLength) {
+    throw FbossError(
+        "Bad AQM thresholds: minimum length ", linear.minimumLength,
+        ", maximum length ", linear.maximumLength);
+  }
+  // The probability reaches 100% at the maximum length, and the queue is
+  // always congested past it
+  AqmProfile congested;
+  congested.minThresholdBytes = linear.minimumLength;
+  congested.maxThresholdBytes = linear.maximumLength;
+  congested.dropProbability = 100;
+
+  profiles.ecnCapable = congested;
+  profiles.notEcnCapable = congested;
+  const auto& behavior = aqm->behavior;
+  if (behavior.ecn) {
+    profiles.ecnCapable.enabled = true;
+    profiles.ecnCapable.markCongestion = true;
+  } else {
+    profiles.ecnCapable.enabled = behavior.earlyDrop;
+  }
+  profiles.notEcnCapable.enabled = behavior.earlyDrop;
+  return profiles;
+}
+
+folly::Optional<cfg::ActiveQueueManagement> BcmCosQueueManager::getAqm(
+    const AqmProfiles& profiles) {
+  const auto& ecnCapable = profiles.ecnCapable;
+  const auto& notEcnCapable = profiles.notEcnCapable;
+  // Both profiles have the thresholds of the config
+  const auto& thresholds = ecnCapable.enabled || !notEcnCapable.enabled
+      ? ecnCapable
+      : notEcnCapable;
+  if (!ecnCapable.enabled && !notEcnCapable.enabled &&
+      thresholds.minThresholdBytes == 0 && thresholds.maxThresholdBytes == 0) {
+    return folly::none;
+  }
+  cfg::LinearQueueCongestionDetection linear;
+  linear.minimumLength = thresholds.minThresholdBytes;
+  linear.maximumLength = thresholds.maxThresholdBytes;
+  cfg::ActiveQueueManagement aqm;
+  aqm.detection.set_linear(linear);
+  aqm.behavior.ecn = ecnCapable.enabled && ecnCapable.markCongestion;
+  aqm.behavior.earlyDrop = notEcnCapable.enabled;
+  return aqm;
+}
+
 void BcmCosQueueManager::fillOrReplaceCounter(
     const BcmCosQueueCounterType& type,
     QueueStatCounters& counters) {
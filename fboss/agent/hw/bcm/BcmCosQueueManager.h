@@ -99,7 +99,80 @@ public:
   void updateQueueStats(std::chrono::seconds now,
                         HwPortStats* portStats = nullptr);
 
+  /*
+   * Active queue management is programmed as a discard profile per type of
+   * packet: ECN capable packets may be marked with Congestion Experienced
+   * while the others are dropped early, or left to tail drops.
+   */
+  enum class AqmPacketType {
+    ECN_CAPABLE,
+    NOT_ECN_CAPABLE
+  };
+  struct AqmProfile {
+    // Tail drops only if not enabled
+    bool enabled{false};
+    // Mark packets instead of dropping them
+    bool markCongestion{false};
+    // The drop or marking probability rises linearly from 0 at the minimum
+    // queue length, in bytes, to dropProbability percent at the maximum
+    int32_t minThresholdBytes{0};
+    int32_t maxThresholdBytes{0};
+    int dropProbability{0};
+
+    bool operator==(const AqmProfile& other) const {
+      return enabled == other.enabled &&
+          markCongestion == other.markCongestion &&
+          minThresholdBytes == other.minThresholdBytes &&
+          maxThresholdBytes == other.maxThresholdBytes &&
+          dropProbability == other.dropProbability;
+    }
+  };
+  struct AqmProfiles {
+    AqmProfile ecnCapable;
+    AqmProfile notEcnCapable;
+  };
+
+  /*
+   * The discard profiles for the AQM config of a queue.  Throws FbossError
+   * if its thresholds are out of order.
+   */
+  static AqmProfiles getAqmProfiles(
+      const folly::Optional<cfg::ActiveQueueManagement>& aqm);
+  /*
+   * The AQM config of the profiles read back from a queue, which is none if
+   * they have never been programmed.
+   */
+  static folly::Optional<cfg::ActiveQueueManagement> getAqm(
+      const AqmProfiles& profiles);
+
 protected:
+  // The settings of a queue that differ from those its gport has
+  struct QueueChanges {
+    bool schedulingAndWeight{false};
+    bool reservedBytes{false};
+    bool sharedBytes{false};
+    bool scalingFactor{false};
+    bool aqm{false};
+
+    bool any() const {
+      return schedulingAndWeight || reservedBytes || sharedBytes ||
+          scalingFactor || aqm;
+    }
+  };
+
+  /*
+   * Work out which settings of the queue need to be written to its gport,
+   * from what was last programmed to, or read back from, it.  Everything
+   * does if we know nothing of the gport yet.
+   */
+  QueueChanges getQueueChanges(
+      opennsl_gport_t gport,
+      const PortQueue& queue) const;
+  // Remember what the gport has, once it is programmed or read back
+  void setQueueSettings(
+      opennsl_gport_t gport,
+      const std::shared_ptr<const PortQueue>& queue) const;
+
   int getControlValue(cfg::StreamType streamType,
                       opennsl_gport_t gport,
                       int queueIdx,
@@ -125,6 +198,14 @@ protected:
                             int queueIdx,
                             const std::shared_ptr<PortQueue>& queue);
 
+  // The static limit of the queue in the shared pool
+  void getSharedBytes(opennsl_gport_t gport,
+                      int queueIdx,
+                      std::shared_ptr<PortQueue> queue) const;
+  void programSharedBytes(opennsl_gport_t gport,
+                          int queueIdx,
+                          const std::shared_ptr<PortQueue>& queue);
+
   const BcmSwitch* hw_;
   // owner port name of this cosq manager
   std::string portName_;
@@ -157,5 +238,11 @@ private:
                                HwPortStats* portStats = nullptr) = 0;
 
   std::map<BcmCosQueueCounterType, QueueStatCounters> queueCounters_;
+  // The settings each queue gport was last programmed with, or read back
+  // with.  Reading settings back records them too, hence mutable.
+  mutable boost::container::flat_map<
+      opennsl_gport_t,
+      std::shared_ptr<const PortQueue>>
+      queueSettings_;
 };
 }} //facebook::fboss
@@ -16,8 +16,18 @@
 #include "fboss/agent/hw/bcm/BcmWarmBootCache.h"
 
 #include <folly/logging/xlog.h>
+#include <gflags/gflags.h>
+#include <algorithm>
+#include <numeric>
 #include <string>
 
+DEFINE_int32(ecmp_max_weighted_paths, 64,
+             "The most members to program a weighted ECMP group with; "
+             "weights are scaled down to fit");
+DEFINE_int32(ecmp_resilient_hash_size, 0,
+             "Program ECMP groups with resilient hashing over this many "
+             "buckets, 0 for regular hashing");
+
 namespace facebook { namespace fboss {
 
 using folly::IPAddress;
@@ -111,14 +121,16 @@ void BcmEgress::program(opennsl_if_t intfId, opennsl_vrf_t vrf,
     const auto& existingEgressId = egressId2EgressCitr->first;
     // Cache existing egress id
     id_ = existingEgressId;
-    auto existingEgressObject = egressId2EgressCitr->second;
-    if (!equivalent(eObj, existingEgressObject)) {
+    const auto& existingEgressObject = egressId2EgressCitr->second;
+    if (equivalent(eObj, existingEgressObject)) {
+      XLOG(DBG1) << "Egress object for: " << ip << " @ brcmif " << intfId
+                 << " already exists";
+      warmBootCache->entryUnchanged(BcmWarmBootCache::EGRESS);
+    } else {
       XLOG(DBG1) << "Updating egress object for next hop : " << ip
                  << " @ brcmif " << intfId;
       addOrUpdateEgress = true;
-    } else {
-      XLOG(DBG1) << "Egress object for: " << ip << " @ brcmif " << intfId
-                 << " already exists";
+      warmBootCache->entryRewritten(BcmWarmBootCache::EGRESS);
     }
   } else {
     addOrUpdateEgress = true;
@@ -128,7 +140,12 @@ void BcmEgress::program(opennsl_if_t intfId, opennsl_vrf_t vrf,
     if (id_ != INVALID) {
       flags |= OPENNSL_L3_REPLACE|OPENNSL_L3_WITH_ID;
     }
-    if (!alreadyExists(eObj)) {
+    // The warm boot cache holds what is in h/w, and was compared with
+    // above, so there is no need to read the entry back.
+    bool exists =
+        egressId2EgressCitr == warmBootCache->egressId2Egress_end() &&
+        alreadyExists(eObj);
+    if (!exists) {
       /*
        *  Only program the HW if a identical egress object does not
        *  exist. Per BCM documentation updating entries like so should not
@@ -200,14 +217,80 @@ BcmEgress::~BcmEgress() {
              << hw_->getUnit();
 }
 
+std::vector<uint32_t> BcmEcmpEgress::getPathCopies() const {
+  if (!isWeighted()) {
+    return std::vector<uint32_t>(paths_.size(), 1);
+  }
+  std::vector<uint64_t> weights;
+  weights.reserve(paths_.size());
+  for (auto path : paths_) {
+    auto itr = weights_.find(path);
+    weights.push_back(
+        itr == weights_.end() ? 1 : std::max<uint64_t>(itr->second, 1));
+  }
+  // Use the smallest number of copies that keeps the ratios
+  auto divisor = std::accumulate(
+      weights.begin(), weights.end(), uint64_t(0),
+      [](uint64_t a, uint64_t b) {
+        while (b) {
+          auto r = a % b;
+          a = b;
+          b = r;
+        }
+        return a;
+      });
+  uint64_t total = 0;
+  for (auto& weight : weights) {
+    weight /= divisor;
+    total += weight;
+  }
+  // Scale weights down, keeping every path in the group, if there are too
+  // many members
+  uint64_t maxPaths = std::max<uint64_t>(
+      FLAGS_ecmp_max_weighted_paths, paths_.size());
+  std::vector<uint32_t> copies;
+  copies.reserve(weights.size());
+  uint64_t members = 0;
+  for (auto weight : weights) {
+    copies.push_back(
+        total <= maxPaths
+            ? weight
+            : std::max<uint64_t>(1, weight * maxPaths / total));
+    members += copies.back();
+  }
+  // Keeping a copy of the lightest paths can still take the group over,
+  // so take the excess off the heaviest ones
+  while (members > maxPaths) {
+    auto heaviest = std::max_element(copies.begin(), copies.end());
+    CHECK_GT(*heaviest, 1);
+    --*heaviest;
+    --members;
+  }
+  return copies;
+}
+
 void BcmEcmpEgress::program() {
   opennsl_l3_egress_ecmp_t obj;
   opennsl_l3_egress_ecmp_t_init(&obj);
   auto n_path = paths_.size();
-  obj.max_paths = ((n_path + 3) >> 2) << 2; // multiple of 4
+  auto copies = getPathCopies();
+  auto n_members = std::accumulate(copies.begin(), copies.end(), size_t(0));
+  obj.max_paths = ((n_members + 3) >> 2) << 2; // multiple of 4
+  if (FLAGS_ecmp_resilient_hash_size > 0) {
+#ifdef OPENNSL_L3_ECMP_DYNAMIC_MODE_RESILIENT
+    obj.dynamic_mode = OPENNSL_L3_ECMP_DYNAMIC_MODE_RESILIENT;
+    obj.dynamic_size = FLAGS_ecmp_resilient_hash_size;
+#else
+    static bool warned = false;
+    if (!warned) {
+      XLOG(WARN) << "Resilient ECMP hashing is not supported by this SDK";
+      warned = true;
+    }
+#endif
+  }
 
   const auto warmBootCache = hw_->getWarmBootCache();
-  auto egressIds2EcmpCItr = warmBootCache->findEcmp(paths_);
+  auto egressIds2EcmpCItr = warmBootCache->findEcmp(paths_, weights_);
   if (egressIds2EcmpCItr != warmBootCache->egressIds2Ecmp_end()) {
     const auto& existing = egressIds2EcmpCItr->second;
     // TODO figure out why the following check fails
@@ -221,6 +304,7 @@ void BcmEcmpEgress::program() {
     XLOG(DBG1) << "Ecmp egress object for egress : "
                << BcmWarmBootCache::toEgressIdsStr(paths_)
                << " already exists ";
+    warmBootCache->entryUnchanged(BcmWarmBootCache::ECMP);
     warmBootCache->programmed(egressIds2EcmpCItr);
   } else {
     XLOG(DBG1) << "Adding ecmp egress with egress : "
@@ -229,11 +313,15 @@ void BcmEcmpEgress::program() {
       obj.flags |= OPENNSL_L3_REPLACE|OPENNSL_L3_WITH_ID;
       obj.ecmp_intf = id_;
     }
-    opennsl_if_t pathsArray[paths_.size()];
+    opennsl_if_t pathsArray[n_members];
     auto index = 0;
+    auto pathCopies = copies.begin();
     for (auto path: paths_) {
+      auto numCopies = *pathCopies++;
       if (hw_->getHostTable()->isResolved(path)) {
-        pathsArray[index++] = path;
+        for (uint32_t i = 0; i < numCopies; ++i) {
+          pathsArray[index++] = path;
+        }
       } else {
         XLOG(DBG1) << "Skipping unresolved egress : " << path << " while "
                    << "programming ECMP group ";
@@ -242,7 +330,7 @@ void BcmEcmpEgress::program() {
     auto ret = opennsl_l3_egress_ecmp_create(hw_->getUnit(), &obj, index,
                                              pathsArray);
     bcmCheckError(ret, "failed to program L3 ECMP egress object ", id_,
-                " with ", n_path, " paths");
+                " with ", n_path, " paths and ", n_members, " members");
     id_ = obj.ecmp_intf;
     XLOG(DBG2) << "Programmed L3 ECMP egress object " << id_ << " for "
                << n_path << " paths";
@@ -280,14 +368,33 @@ folly::dynamic BcmEcmpEgress::toFollyDynamic() const {
     paths.push_back(path);
   }
   ecmpEgress[kPaths] = std::move(paths);
+  if (isWeighted()) {
+    // In the order of the paths, for warm boot to match the group by
+    folly::dynamic weights = folly::dynamic::array;
+    for (auto path: paths_) {
+      auto itr = weights_.find(path);
+      weights.push_back(itr == weights_.end() ? 0 : itr->second);
+    }
+    ecmpEgress[kWeights] = std::move(weights);
+  }
   return ecmpEgress;
 }
 
 bool BcmEcmpEgress::pathUnreachableHwLocked(EgressId path) {
+  if (isWeighted()) {
+    // Reprogram the whole group to keep the weights of the other paths
+    program();
+    return true;
+  }
   return removeEgressIdHwLocked(hw_->getUnit(), getID(), path);
 }
 
 bool BcmEcmpEgress::pathReachableHwLocked(EgressId path) {
+  if (isWeighted()) {
+    // Add every copy of the path back
+    program();
+    return true;
+  }
   return addEgressIdHwLocked(hw_->getUnit(), getID(), paths_, path);
 }
 
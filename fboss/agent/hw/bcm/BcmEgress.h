@@ -21,6 +21,8 @@ extern "C" {
 #include "fboss/agent/state/RouteTypes.h"
 
 #include <boost/noncopyable.hpp>
+#include <vector>
+#include <boost/container/flat_map.hpp>
 #include <boost/container/flat_set.hpp>
 
 namespace facebook { namespace fboss {
@@ -121,10 +123,24 @@ class BcmEcmpEgress : public BcmEgressBase {
  public:
   using EgressId = opennsl_if_t;
   using Paths = boost::container::flat_set<opennsl_if_t>;
+  // Path -> UCMP weight, for weighted groups
+  using PathWeights = boost::container::flat_map<opennsl_if_t, uint64_t>;
   enum class Action { SHRINK, EXPAND, SKIP };
 
-  explicit BcmEcmpEgress(const BcmSwitchIf* hw,
-      Paths paths) : BcmEgressBase(hw), paths_(paths) {
+  /*
+   * A group is weighted if weights are given.  Weighted groups are
+   * programmed with each path repeated in proportion to its weight, up to
+   * --ecmp_max_weighted_paths members in all.
+   *
+   * With --ecmp_resilient_hash_size, groups use resilient hashing, so that
+   * removing or adding a path only moves the flows of the hash buckets
+   * that path is in.
+   */
+  BcmEcmpEgress(
+      const BcmSwitchIf* hw,
+      Paths paths,
+      PathWeights weights = PathWeights())
+      : BcmEgressBase(hw), paths_(paths), weights_(std::move(weights)) {
     program();
   }
   ~BcmEcmpEgress() override;
@@ -133,6 +149,12 @@ class BcmEcmpEgress : public BcmEgressBase {
   const Paths& paths() const {
     return paths_;
   }
+  bool isWeighted() const {
+    return !weights_.empty();
+  }
+  const PathWeights& weights() const {
+    return weights_;
+  }
   bool isEcmp() const override {
     return true;
   }
@@ -148,6 +170,7 @@ class BcmEcmpEgress : public BcmEgressBase {
       EgressId ecmpId,
       const Paths& egressIdInSw,
       EgressId toAdd);
+  // These remove every copy of the path from a weighted group
   static bool
   removeEgressIdHwNotLocked(int unit, EgressId ecmpId, EgressId toRemove);
   static bool
@@ -155,7 +178,13 @@ class BcmEcmpEgress : public BcmEgressBase {
 
  private:
   void program();
+  /*
+   * The number of times to repeat each path in the group, in the order of
+   * paths_.
+   */
+  std::vector<uint32_t> getPathCopies() const;
   const Paths paths_;
+  const PathWeights weights_;
 };
 
 }}
@@ -8,6 +8,8 @@
  *
  */
 #include "BcmHost.h"
+#include <algorithm>
+#include <chrono>
 #include <string>
 #include <iostream>
 
@@ -17,6 +19,7 @@
 #include "fboss/agent/hw/bcm/BcmError.h"
 #include "fboss/agent/hw/bcm/BcmIntf.h"
 #include "fboss/agent/hw/bcm/BcmPort.h"
+#include "fboss/agent/hw/bcm/BcmStats.h"
 #include "fboss/agent/hw/bcm/BcmSwitch.h"
 #include "fboss/agent/hw/bcm/BcmWarmBootCache.h"
 #include "fboss/agent/state/Interface.h"
@@ -126,6 +129,7 @@ void BcmHost::addToBcmHostTable(bool isMultipath, bool replace) {
     } else {
       XLOG(DBG1) << "Host entry for " << addr << " already exists";
     }
+    warmBootCache->entryUnchanged(BcmWarmBootCache::HOST);
     warmBootCache->programmed(vrfIp2HostCitr);
   } else {
     XLOG(DBG3) << "Adding host entry for : " << addr;
@@ -319,37 +323,46 @@ BcmEcmpHost::BcmEcmpHost(const BcmSwitchIf *hw,
   CHECK_GT(fwd.size(), 0);
   BcmHostTable *table = hw_->writableHostTable();
   BcmEcmpEgress::Paths paths;
-  std::vector<const NextHop *> prog;
+  BcmEcmpEgress::PathWeights weights;
+  bool weighted = false;
   SCOPE_FAIL {
-    for (auto nhopPtr : prog) {
-      table->derefBcmHost(BcmHostKey(vrf_, *nhopPtr));
+    for (const auto& pathHost : pathHosts_) {
+      table->derefBcmHost(pathHost);
     }
   };
   // allocate a BcmHost object for each path in this ECMP
   int total = 0;
   for (const auto& nhop : fwd) {
-    auto host = table->incRefOrCreateBcmHost(BcmHostKey(vrf_, nhop));
-    prog.push_back(&nhop);
+    // Each path is the host of the next hop in the VRF of its interface,
+    // the one that neighbor resolution programs.  So the paths of a next
+    // hop set are the same in every VRF, and the ECMP egress objects for
+    // them are shared across VRFs.
+    const auto intf = hw->getIntfTable()->getBcmIntf(nhop.intf());
+    BcmHostKey pathHost(
+        BcmSwitch::getBcmVrfId(intf->getInterface()->getRouterID()), nhop);
+    auto host = table->incRefOrCreateBcmHost(pathHost);
+    pathHosts_.push_back(std::move(pathHost));
     // TODO:
     // Ideally, we should have the nexthop resolved already and programmed in
     // HW. If not, SW can preemptively trigger neighbor discovery and then
     // do the HW programming. For now, we program the egress object to punt
     // to CPU. Any traffic going to CPU will trigger the neighbor discovery.
     if (!host->isProgrammed()) {
-      const auto intf = hw->getIntfTable()->getBcmIntf(nhop.intf());
       host->programToCPU(intf->getBcmIfId());
     }
     paths.insert(host->getEgressId());
+    weights[host->getEgressId()] += nhop.weight();
+    weighted |= nhop.weight() != UCMP_DEFAULT_WEIGHT;
   }
   if (paths.size() == 1) {
     // just one path. No BcmEcmpEgress object this case.
     egressId_ = *paths.begin();
   } else {
-    auto ecmp = std::make_unique<BcmEcmpEgress>(hw, std::move(paths));
-    //ecmp->program(paths, fwd.size());
-    egressId_ = ecmp->getID();
+    if (!weighted) {
+      weights.clear();
+    }
+    egressId_ = table->incRefOrCreateBcmEcmpEgress(paths, weights);
     ecmpEgressId_ = egressId_;
-    hw_->writableHostTable()->insertBcmEgress(std::move(ecmp));
   }
   fwd_ = std::move(fwd);
 }
@@ -360,12 +373,18 @@ BcmEcmpHost::~BcmEcmpHost() {
   XLOG(DBG3) << "Decremented reference for egress object for " << fwd_;
   hw_->writableHostTable()->derefEgress(ecmpEgressId_);
   BcmHostTable *table = hw_->writableHostTable();
-  for (const auto& nhop : fwd_) {
-    table->derefBcmHost(BcmHostKey(vrf_, nhop));
+  for (const auto& pathHost : pathHosts_) {
+    table->derefBcmHost(pathHost);
   }
 }
 
-BcmHostTable::BcmHostTable(const BcmSwitchIf *hw) : hw_(hw) {
+BcmHostTable::BcmHostTable(
+    const BcmSwitchIf* hw,
+    HugePageResource* tableMemory)
+    : hw_(hw),
+      egressMap_(tableMemory),
+      hosts_(tableMemory),
+      ecmpHosts_(tableMemory) {
   auto port2EgressIds = std::make_shared<PortAndEgressIdsMap>();
   port2EgressIds->publish();
   setPort2EgressIdsInternal(port2EgressIds);
@@ -521,6 +540,19 @@ BcmEgressBase* BcmHostTable::derefEgress(opennsl_if_t egressId) {
     if (it->second.first->isEcmp()) {
       CHECK(numEcmpEgressProgrammed_ > 0);
       numEcmpEgressProgrammed_--;
+      auto ecmp = static_cast<const BcmEcmpEgress*>(it->second.first.get());
+      CHECK_GE(numEcmpMembersProgrammed_, ecmp->paths().size());
+      numEcmpMembersProgrammed_ -= ecmp->paths().size();
+      ecmpShrinkIndexStale_ = true;
+      ecmpEgressCache_.erase(std::make_pair(ecmp->paths(), ecmp->weights()));
+      for (auto path : ecmp->paths()) {
+        auto pathItr = egress2EcmpEgressIds_.find(path);
+        CHECK(pathItr != egress2EcmpEgressIds_.end());
+        pathItr->second.erase(egressId);
+        if (pathItr->second.empty()) {
+          egress2EcmpEgressIds_.erase(pathItr);
+        }
+      }
     }
     XLOG(DBG3) << "erase egress " << egressId << " from egress map";
     egressMap_.erase(egressId);
@@ -588,12 +620,36 @@ BcmEgressBase* BcmHostTable::getEgressObjectIf(opennsl_if_t egress) {
       const_cast<const BcmHostTable*>(this)->getEgressObjectIf(egress));
 }
 
+opennsl_if_t BcmHostTable::incRefOrCreateBcmEcmpEgress(
+    const BcmEcmpEgress::Paths& paths,
+    const BcmEcmpEgress::PathWeights& weights) {
+  auto key = std::make_pair(paths, weights);
+  auto itr = ecmpEgressCache_.find(key);
+  if (itr != ecmpEgressCache_.end()) {
+    BcmStats::get()->ecmpEgressCacheHit();
+    incEgressReference(itr->second);
+    return itr->second;
+  }
+  BcmStats::get()->ecmpEgressCacheMiss();
+  auto ecmp = std::make_unique<BcmEcmpEgress>(hw_, paths, weights);
+  auto id = ecmp->getID();
+  insertBcmEgress(std::move(ecmp));
+  ecmpEgressCache_.emplace(std::move(key), id);
+  return id;
+}
+
 void BcmHostTable::insertBcmEgress(
     std::unique_ptr<BcmEgressBase> egress) {
   auto id = egress->getID();
   XLOG(DBG3) << "insert egress " << id << " into egress map";
   if (egress->isEcmp()) {
     numEcmpEgressProgrammed_++;
+    auto ecmp = static_cast<const BcmEcmpEgress*>(egress.get());
+    numEcmpMembersProgrammed_ += ecmp->paths().size();
+    ecmpShrinkIndexStale_ = true;
+    for (auto path : ecmp->paths()) {
+      egress2EcmpEgressIds_[path].insert(id);
+    }
   }
   auto ret = egressMap_.emplace(id, std::make_pair(std::move(egress), 1));
   CHECK(ret.second);
@@ -712,9 +768,72 @@ void BcmHostTable::egressResolutionChangedHwNotLocked(
     const Paths& affectedPaths,
     bool up) {
   CHECK(!up);
-  Paths tmpPaths(affectedPaths);
-  opennsl_l3_egress_ecmp_traverse(
-      unit, removeAllEgressesFromEcmpCallback, &tmpPaths);
+  auto begin = std::chrono::steady_clock::now();
+  auto index = getEcmpShrinkIndex();
+  if (!index) {
+    // Nothing has been published yet, so look at every ECMP egress in HW
+    Paths tmpPaths(affectedPaths);
+    opennsl_l3_egress_ecmp_traverse(
+        unit, removeAllEgressesFromEcmpCallback, &tmpPaths);
+    return;
+  }
+  // OpenNSL removes ECMP members by egress id, so the index does not need
+  // the position of each path in its ECMP egress.
+  uint64_t shrunk = 0;
+  for (auto path : affectedPaths) {
+    auto pathItr = index->find(path);
+    if (pathItr == index->end()) {
+      continue;
+    }
+    for (auto ecmpId : pathItr->second) {
+      BcmEcmpEgress::removeEgressIdHwNotLocked(unit, ecmpId, path);
+      ++shrunk;
+    }
+  }
+  BcmStats::get()->ecmpShrunkOnLinkDown(
+      shrunk,
+      std::chrono::duration_cast<std::chrono::microseconds>(
+          std::chrono::steady_clock::now() - begin));
+}
+
+void BcmHostTable::publishEcmpShrinkIndexHwLocked() {
+  const auto* warmBootCache = hw_->getWarmBootCache();
+  bool hasWarmBootEntries =
+      warmBootCache && !warmBootCache->ecmp2EgressIds().empty();
+  if (!ecmpShrinkIndexStale_ && !hasWarmBootEntries &&
+      !ecmpShrinkIndexHasWarmBootEntries_) {
+    return;
+  }
+  auto index = std::make_shared<EcmpShrinkIndex>(egress2EcmpEgressIds_);
+  if (hasWarmBootEntries) {
+    for (const auto& ecmpAndEgressIds : warmBootCache->ecmp2EgressIds()) {
+      for (auto path : ecmpAndEgressIds.second) {
+        (*index)[path].insert(ecmpAndEgressIds.first);
+      }
+    }
+  }
+  {
+    folly::SpinLockGuard guard(ecmpShrinkIndexLock_);
+    ecmpShrinkIndexDontUseDirectly_.swap(index);
+  }
+  ecmpShrinkIndexStale_ = false;
+  ecmpShrinkIndexHasWarmBootEntries_ = hasWarmBootEntries;
+}
+
+void BcmHostTable::updateMemoryAccountHwLocked() {
+  constexpr auto kEgressBytes =
+      std::max(sizeof(BcmEgress), sizeof(BcmEcmpEgress));
+  uint64_t bytes = containerMemoryBytes(hosts_) +
+      hosts_.size() * sizeof(BcmHost) + containerMemoryBytes(ecmpHosts_) +
+      ecmpHosts_.size() * sizeof(BcmEcmpHost) +
+      containerMemoryBytes(egressMap_) + egressMap_.size() * kEgressBytes +
+      containerMemoryBytes(egress2EcmpEgressIds_) +
+      containerMemoryBytes(ecmpEgressCache_) +
+      containerMemoryBytes(resolvedEgresses_);
+  // Each ECMP member is a path of its egress object, of the egress object's
+  // cache key and of the reverse index
+  bytes += 3 * numEcmpMembersProgrammed_ * sizeof(opennsl_if_t);
+  memoryAccount_.set(bytes);
 }
 
 void BcmHostTable::egressResolutionChangedHwLocked(
@@ -724,18 +843,20 @@ void BcmHostTable::egressResolutionChangedHwLocked(
     return;
   }
 
-  for (const auto& nextHopsAndEcmpHostInfo : ecmpHosts_) {
-    auto ecmpId = nextHopsAndEcmpHostInfo.second.first->getEcmpEgressId();
-    if (ecmpId == BcmEgressBase::INVALID) {
+  // Only visit the ECMP egress objects which have one of the affected
+  // paths, rather than every ECMP host.
+  for (auto path : affectedPaths) {
+    auto pathItr = egress2EcmpEgressIds_.find(path);
+    if (pathItr == egress2EcmpEgressIds_.end()) {
       continue;
     }
-    auto ecmpEgress = static_cast<BcmEcmpEgress*>(getEgressObjectIf(ecmpId));
-    // Must find the egress object, we could have done a slower
-    // dynamic cast check to ensure that this is the right type
-    // our map should be pointing to valid Ecmp egress object for
-    // a ecmp egress Id anyways
-    CHECK(ecmpEgress);
-    for (auto path : affectedPaths) {
+    for (auto ecmpId : pathItr->second) {
+      auto ecmpEgress = static_cast<BcmEcmpEgress*>(getEgressObjectIf(ecmpId));
+      // Must find the egress object, we could have done a slower
+      // dynamic cast check to ensure that this is the right type
+      // our map should be pointing to valid Ecmp egress object for
+      // a ecmp egress Id anyways
+      CHECK(ecmpEgress);
       switch (action) {
         case BcmEcmpEgress::Action::EXPAND:
           ecmpEgress->pathReachableHwLocked(path);
@@ -18,6 +18,8 @@ extern "C" {
 #include <folly/MacAddress.h>
 #include <folly/SpinLock.h>
 #include <folly/dynamic.h>
+#include "fboss/agent/HugePageAllocator.h"
+#include "fboss/agent/MemoryAccount.h"
 #include "fboss/agent/hw/bcm/BcmEgress.h"
 #include "fboss/agent/hw/bcm/BcmHostKey.h"
 #include "fboss/agent/hw/bcm/BcmPort.h"
@@ -30,6 +32,8 @@ extern "C" {
 #include <boost/container/flat_map.hpp>
 #include <boost/container/flat_set.hpp>
 
+#include <vector>
+
 namespace facebook { namespace fboss {
 
 class BcmEcmpEgress;
@@ -155,11 +159,19 @@ class BcmEcmpHost {
   opennsl_if_t egressId_{BcmEgressBase::INVALID};
   opennsl_if_t ecmpEgressId_{BcmEgressBase::INVALID};
   RouteNextHopSet fwd_;
+  // The hosts of the paths, in the VRFs of their interfaces
+  std::vector<BcmHostKey> pathHosts_;
 };
 
 class BcmHostTable {
  public:
-  explicit BcmHostTable(const BcmSwitchIf *hw);
+  /*
+   * The host, ECMP host and egress maps draw their memory from tableMemory,
+   * so that they may be backed by huge pages.
+   */
+  explicit BcmHostTable(
+      const BcmSwitchIf* hw,
+      HugePageResource* tableMemory = HugePageResource::forTables());
   virtual ~BcmHostTable();
 
   // throw an exception if not found
@@ -217,6 +229,17 @@ class BcmHostTable {
   BcmEgressBase* derefEgress(opennsl_if_t egressId);
   const BcmEgressBase*  getEgressObjectIf(opennsl_if_t egress) const;
   BcmEgressBase* getEgressObjectIf(opennsl_if_t egress);
+  /*
+   * Find the ECMP egress object for the paths and weights, or create it,
+   * and take a reference to it.  ECMP egress objects are shared by every
+   * BcmEcmpHost with the same paths.  The paths of a next hop are the
+   * egress of its host in the VRF of its interface, so identical next hop
+   * sets in different VRFs take only one ECMP group in HW.  The reference is
+   * released with derefEgress().
+   */
+  opennsl_if_t incRefOrCreateBcmEcmpEgress(
+      const BcmEcmpEgress::Paths& paths,
+      const BcmEcmpEgress::PathWeights& weights);
 
   /*
    * Port down handling
@@ -296,6 +319,17 @@ class BcmHostTable {
   uint32_t numEcmpEgress() const {
     return numEcmpEgressProgrammed_;
   }
+  // Paths of all the ECMP egress objects
+  uint32_t numEcmpMembers() const {
+    return numEcmpMembersProgrammed_;
+  }
+  // Egress objects other than ECMP ones
+  uint32_t numEgress() const {
+    return egressMap_.size() - numEcmpEgressProgrammed_;
+  }
+  uint32_t numHosts() const {
+    return hosts_.size();
+  }
 
   void egressResolutionChangedHwLocked(
       const Paths& affectedPaths,
@@ -308,12 +342,35 @@ class BcmHostTable {
     egressResolutionChangedHwLocked(affectedPaths, action);
   }
 
+  /*
+   * Egress id -> ids of the ECMP egress objects in HW that have it as a
+   * path, both ours and those still in the warm boot cache.
+   */
+  using EcmpShrinkIndex = boost::container::
+      flat_map<opennsl_if_t, boost::container::flat_set<opennsl_if_t>>;
+  /*
+   * Publish a new snapshot of the ECMP egress objects for the linkscan
+   * thread to shrink on link down, if they have changed.  Called by
+   * BcmSwitch after each state update, while holding the hw lock.
+   */
+  void publishEcmpShrinkIndexHwLocked();
+
+  /*
+   * Set the memory account of the table ("bcm.host_table") from the size of
+   * its containers.  Called by BcmSwitch after each state update.
+   */
+  void updateMemoryAccountHwLocked();
+  std::shared_ptr<const EcmpShrinkIndex> getEcmpShrinkIndex() const {
+    folly::SpinLockGuard guard(ecmpShrinkIndexLock_);
+    return ecmpShrinkIndexDontUseDirectly_;
+  }
+
  private:
   /*
    * Called both while holding and not holding the hw lock.
    */
   void linkStateChangedMaybeLocked(opennsl_port_t port, bool up, bool locked);
-  static void egressResolutionChangedHwNotLocked(
+  void egressResolutionChangedHwNotLocked(
       int unit,
       const Paths& affectedPaths,
       bool up);
@@ -342,17 +399,44 @@ class BcmHostTable {
    */
   std::shared_ptr<PortAndEgressIdsMap> portAndEgressIdsDontUseDirectly_;
   mutable folly::SpinLock portAndEgressIdsLock_;
+
+  /*
+   * The snapshot of ECMP egress objects used to shrink them on link down,
+   * so that the linkscan thread touches only the groups with a path over
+   * the port, without waiting for the hw lock.  Like the port -> egressIds
+   * map, only access this through getEcmpShrinkIndex() and
+   * publishEcmpShrinkIndexHwLocked().
+   */
+  std::shared_ptr<const EcmpShrinkIndex> ecmpShrinkIndexDontUseDirectly_;
+  mutable folly::SpinLock ecmpShrinkIndexLock_;
+  // Whether the ECMP egress objects changed since we last published
+  bool ecmpShrinkIndexStale_{true};
+  // Whether the last published snapshot had warm boot cache entries
+  bool ecmpShrinkIndexHasWarmBootEntries_{false};
   boost::container::flat_set<opennsl_if_t> resolvedEgresses_;
   uint32_t numEcmpEgressProgrammed_{0};
+  uint32_t numEcmpMembersProgrammed_{0};
 
-  boost::container::flat_map<
+  HugePageFlatMap<
       opennsl_if_t,
       std::pair<std::unique_ptr<BcmEgressBase>, uint32_t>>
       egressMap_;
+  /*
+   * Egress id -> ids of the ECMP egress objects that use it as a path, so
+   * that a change in the resolution of an egress only visits the ECMP
+   * egress objects it is part of.
+   */
+  boost::container::
+      flat_map<opennsl_if_t, boost::container::flat_set<opennsl_if_t>>
+          egress2EcmpEgressIds_;
+  // (paths, weights) -> the ECMP egress object for them
+  using EcmpEgressKey =
+      std::pair<BcmEcmpEgress::Paths, BcmEcmpEgress::PathWeights>;
+  boost::container::flat_map<EcmpEgressKey, opennsl_if_t> ecmpEgressCache_;
 
   template <typename KeyT, typename HostT>
-  using HostMap = boost::container::
-    flat_map<KeyT, std::pair<std::unique_ptr<HostT>, uint32_t>>;
+  using HostMap =
+      HugePageFlatMap<KeyT, std::pair<std::unique_ptr<HostT>, uint32_t>>;
   template <typename KeyT, typename HostT>
   HostT* incRefOrCreateBcmHostImpl(
       HostMap<KeyT, HostT>* map,
@@ -372,6 +456,7 @@ class BcmHostTable {
 
   HostMap<BcmHostKey, BcmHost> hosts_;
   HostMap<BcmEcmpHostKey, BcmEcmpHost> ecmpHosts_;
+  MemoryAccount memoryAccount_{"bcm.host_table"};
 };
 
 }}
@@ -0,0 +1,194 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "fboss/agent/hw/bcm/BcmPacketTraceSampler.h"
+
+#include "fboss/agent/TxPacket.h"
+#include "fboss/agent/UDPHeader.h"
+#include "fboss/agent/hw/bcm/BcmPlatform.h"
+#include "fboss/agent/hw/bcm/BcmSwitch.h"
+#include "fboss/agent/hw/bcm/gen-cpp2/packettrace_types.h"
+#include "fboss/agent/hw/mock/MockRxPacket.h"
+#include "fboss/agent/packet/Ethertype.h"
+#include "fboss/agent/packet/IPProto.h"
+#include "fboss/agent/packet/IPv4Hdr.h"
+#include "fboss/agent/packet/IPv6Hdr.h"
+
+#include <folly/ThreadName.h>
+#include <folly/io/Cursor.h>
+#include <folly/io/IOBuf.h>
+#include <folly/logging/xlog.h>
+
+#include <chrono>
+
+namespace {
+// The source of the traced packets, from the documentation ranges
+const folly::MacAddress kSrcMac("02:00:00:00:00:01");
+const folly::IPAddressV4 kSrcV4("192.0.2.1");
+const folly::IPAddressV6 kSrcV6("2001:db8::1");
+// The UDP source port of the first flow to each destination
+constexpr uint16_t kL4SrcPortBase = 32768;
+constexpr uint16_t kL4DstPort = 33434;
+// The smallest ethernet frame, less its FCS
+constexpr uint32_t kMinFrameSize = 60;
+constexpr uint32_t kEthHdrSize = 14;
+}
+
+namespace facebook { namespace fboss {
+
+BcmPacketTraceSampler::~BcmPacketTraceSampler() {
+  stop();
+}
+
+bool BcmPacketTraceSampler::start(const PacketTraceSamplingConfig& config) {
+  std::vector<Destination> destinations;
+  for (const auto& destination : config.destinations) {
+    destinations.push_back({destination, folly::IPAddress(destination)});
+  }
+  if (destinations.empty()) {
+    return false;
+  }
+
+  std::lock_guard<std::mutex> g(controlLock_);
+  // Make sure the hardware can trace packets before we start
+  if (!trace(destinations.front(), config, kL4SrcPortBase)) {
+    return false;
+  }
+  stopLocked();
+  {
+    std::lock_guard<std::mutex> g2(lock_);
+    samples_ =
+        boost::circular_buffer<PacketTraceSample>(config.maxSamples);
+    stopping_ = false;
+  }
+  thread_ = std::thread(
+      &BcmPacketTraceSampler::run, this, std::move(destinations), config);
+  XLOG(INFO) << "Started tracing packets to " << config.destinations.size()
+             << " destinations every " << config.intervalMs << "ms";
+  return true;
+}
+
+void BcmPacketTraceSampler::stop() {
+  std::lock_guard<std::mutex> g(controlLock_);
+  stopLocked();
+}
+
+void BcmPacketTraceSampler::stopLocked() {
+  if (!thread_.joinable()) {
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> g(lock_);
+    stopping_ = true;
+  }
+  stopped_.notify_all();
+  thread_.join();
+  XLOG(INFO) << "Stopped tracing packets";
+}
+
+std::vector<PacketTraceSample> BcmPacketTraceSampler::getSamples() const {
+  std::lock_guard<std::mutex> g(lock_);
+  return std::vector<PacketTraceSample>(samples_.begin(), samples_.end());
+}
+
+void BcmPacketTraceSampler::run(
+    std::vector<Destination> destinations,
+    PacketTraceSamplingConfig config) {
+  folly::setThreadName("PktTraceSample");
+  std::unique_lock<std::mutex> lk(lock_);
+  while (!stopping_) {
+    // Trace without the lock, so that reading the samples does not wait
+    lk.unlock();
+    std::vector<PacketTraceSample> samples;
+    for (const auto& destination : destinations) {
+      for (int flow = 0; flow < config.flowsPerDestination; ++flow) {
+        auto sample = trace(destination, config, kL4SrcPortBase + flow);
+        if (sample) {
+          samples.push_back(std::move(*sample));
+        }
+      }
+    }
+    lk.lock();
+    for (auto& sample : samples) {
+      samples_.push_back(std::move(sample));
+    }
+    stopped_.wait_for(
+        lk, std::chrono::milliseconds(config.intervalMs), [this] {
+          return stopping_;
+        });
+  }
+}
+
+std::unique_ptr<PacketTraceSample> BcmPacketTraceSampler::trace(
+    const Destination& destination,
+    const PacketTraceSamplingConfig& config,
+    uint16_t l4SrcPort) const {
+  std::unique_ptr<PacketTraceInfo> info;
+  try {
+    info = hw_->getPacketTrace(
+        makePacket(destination.addr, config.ingressPort, l4SrcPort));
+  } catch (const std::exception& ex) {
+    XLOG(DBG2) << "Failed to trace packet to " << destination.name << ": "
+               << folly::exceptionStr(ex);
+  }
+  if (!info) {
+    return nullptr;
+  }
+
+  auto sample = std::make_unique<PacketTraceSample>();
+  sample->timestampMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+      std::chrono::system_clock::now().time_since_epoch()).count();
+  sample->destination = destination.name;
+  sample->ingressPort = config.ingressPort;
+  sample->l4SrcPort = l4SrcPort;
+  sample->lookupResult = std::move(info->lookupResult);
+  sample->resolution = info->resolution;
+  sample->ecmpMemberPorts = std::move(info->hashInfo.potentialEgressPorts);
+  sample->egressPort = info->hashInfo.actualEgressPort;
+  sample->destPipeNum = info->destPipeNum;
+  return sample;
+}
+
+std::unique_ptr<MockRxPacket> BcmPacketTraceSampler::makePacket(
+    const folly::IPAddress& dst,
+    int ingressPort,
+    uint16_t l4SrcPort) const {
+  uint32_t ipHdrSize = dst.isV4() ? IPv4Hdr::minSize() : IPv6Hdr::SIZE;
+  uint32_t size = kEthHdrSize + ipHdrSize + UDPHeader::size();
+  auto buf = folly::IOBuf::create(size);
+  buf->append(size);
+  folly::io::RWPrivateCursor cursor(buf.get());
+
+  auto localMac = hw_->getPlatform()->getLocalMac();
+  if (dst.isV4()) {
+    TxPacket::writeEthHeader(
+        &cursor, localMac, kSrcMac, ETHERTYPE::ETHERTYPE_IPV4);
+    IPv4Hdr ipHdr(kSrcV4, dst.asV4(), IP_PROTO::IP_PROTO_UDP,
+                  UDPHeader::size());
+    ipHdr.computeChecksum();
+    ipHdr.write(&cursor);
+  } else {
+    TxPacket::writeEthHeader(
+        &cursor, localMac, kSrcMac, ETHERTYPE::ETHERTYPE_IPV6);
+    IPv6Hdr ipHdr(kSrcV6, dst.asV6());
+    ipHdr.payloadLength = UDPHeader::size();
+    ipHdr.nextHeader = IP_PROTO::IP_PROTO_UDP;
+    ipHdr.serialize(&cursor);
+  }
+  // The packet is never sent, so it needs no UDP checksum
+  UDPHeader udpHdr(l4SrcPort, kL4DstPort, UDPHeader::size(), 0);
+  udpHdr.write(&cursor);
+
+  auto pkt = std::make_unique<MockRxPacket>(std::move(buf));
+  pkt->padToLength(kMinFrameSize);
+  pkt->setSrcPort(PortID(ingressPort));
+  return pkt;
+}
+
+}} // facebook::fboss
@@ -0,0 +1,88 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#pragma once
+
+#include "fboss/agent/if/gen-cpp2/ctrl_types.h"
+
+#include <boost/circular_buffer.hpp>
+#include <folly/IPAddress.h>
+
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace facebook { namespace fboss {
+
+class BcmSwitchIf;
+class MockRxPacket;
+
+/*
+ * BcmPacketTraceSampler periodically traces synthetic UDP packets to a set
+ * of destinations through the hardware pipeline with
+ * BcmSwitchIf::getPacketTrace(), on a thread of its own, and keeps the
+ * latest lookup results in a ring buffer.  The packets are only traced,
+ * never forwarded, so production traffic is not touched.
+ *
+ * Each destination is traced with a number of flows that differ only in
+ * their UDP source port, to show how the flows to it hash over the members
+ * of its ECMP group.
+ */
+class BcmPacketTraceSampler {
+ public:
+  explicit BcmPacketTraceSampler(BcmSwitchIf* hw) : hw_(hw) {}
+  ~BcmPacketTraceSampler();
+
+  /*
+   * Start sampling, or replace what is sampled, clearing the samples.
+   *
+   * @return false if the hardware can not trace packets.
+   */
+  bool start(const PacketTraceSamplingConfig& config);
+  void stop();
+  std::vector<PacketTraceSample> getSamples() const;
+
+ private:
+  struct Destination {
+    std::string name;
+    folly::IPAddress addr;
+  };
+
+  // Forbidden copy constructor and assignment operator
+  BcmPacketTraceSampler(BcmPacketTraceSampler const &) = delete;
+  BcmPacketTraceSampler& operator=(BcmPacketTraceSampler const &) = delete;
+
+  void stopLocked();
+  void run(
+      std::vector<Destination> destinations,
+      PacketTraceSamplingConfig config);
+  std::unique_ptr<PacketTraceSample> trace(
+      const Destination& destination,
+      const PacketTraceSamplingConfig& config,
+      uint16_t l4SrcPort) const;
+  std::unique_ptr<MockRxPacket> makePacket(
+      const folly::IPAddress& dst,
+      int ingressPort,
+      uint16_t l4SrcPort) const;
+
+  BcmSwitchIf* hw_{nullptr};
+
+  // Serializes start() and stop()
+  std::mutex controlLock_;
+  // Protects everything below
+  mutable std::mutex lock_;
+  std::condition_variable stopped_;
+  bool stopping_{false};
+  boost::circular_buffer<PacketTraceSample> samples_;
+  std::thread thread_;
+};
+
+}} // facebook::fboss
@@ -10,6 +10,7 @@
 #include "fboss/agent/hw/bcm/BcmPort.h"
 
 #include <chrono>
+#include <limits>
 #include <map>
 
 #include <folly/Conv.h>
@@ -71,6 +72,57 @@ static const std::vector<opennsl_stat_val_t> kOutPktLengthStats = {
   snmpOpenNSLTransmittedPkts9217to16383Octets,
 };
 
+struct PortStat {
+  folly::StringPiece key;
+  opennsl_stat_val_t type;
+  int64_t HwPortStats::*field;
+};
+// The counters exported for every port
+static const std::vector<PortStat> kPortStats = {
+  {kInBytes(), opennsl_spl_snmpIfHCInOctets, &HwPortStats::inBytes_},
+  {kInUnicastPkts(), opennsl_spl_snmpIfHCInUcastPkts,
+   &HwPortStats::inUnicastPkts_},
+  {kInMulticastPkts(), opennsl_spl_snmpIfHCInMulticastPkts,
+   &HwPortStats::inMulticastPkts_},
+  {kInBroadcastPkts(), opennsl_spl_snmpIfHCInBroadcastPkts,
+   &HwPortStats::inBroadcastPkts_},
+  {kInDiscards(), opennsl_spl_snmpIfInDiscards, &HwPortStats::inDiscards_},
+  {kInErrors(), opennsl_spl_snmpIfInErrors, &HwPortStats::inErrors_},
+  {kInIpv4HdrErrors(), opennsl_spl_snmpIpInHdrErrors,
+   &HwPortStats::inIpv4HdrErrors_},
+  {kInIpv6HdrErrors(), opennsl_spl_snmpIpv6IfStatsInHdrErrors,
+   &HwPortStats::inIpv6HdrErrors_},
+  {kInPause(), opennsl_spl_snmpDot3InPauseFrames, &HwPortStats::inPause_},
+  // Egress Stats
+  {kOutBytes(), opennsl_spl_snmpIfHCOutOctets, &HwPortStats::outBytes_},
+  {kOutUnicastPkts(), opennsl_spl_snmpIfHCOutUcastPkts,
+   &HwPortStats::outUnicastPkts_},
+  {kOutMulticastPkts(), opennsl_spl_snmpIfHCOutMulticastPkts,
+   &HwPortStats::outMulticastPkts_},
+  {kOutBroadcastPkts(), opennsl_spl_snmpIfHCOutBroadcastPckts,
+   &HwPortStats::outBroadcastPkts_},
+  {kOutDiscards(), opennsl_spl_snmpIfOutDiscards, &HwPortStats::outDiscards_},
+  {kOutErrors(), opennsl_spl_snmpIfOutErrors, &HwPortStats::outErrors_},
+  {kOutPause(), opennsl_spl_snmpDot3OutPauseFrames, &HwPortStats::outPause_},
+};
+
+// The counters read in one call by bulk stats collection: the port stats
+// followed by the ingress and egress packet length stats.
+static const std::vector<opennsl_stat_val_t> kBulkStatTypes = [] {
+  std::vector<opennsl_stat_val_t> types;
+  for (const auto& stat : kPortStats) {
+    types.push_back(stat.type);
+  }
+  types.insert(
+      types.end(), kInPktLengthStats.begin(), kInPktLengthStats.end());
+  types.insert(
+      types.end(), kOutPktLengthStats.begin(), kOutPktLengthStats.end());
+  return types;
+}();
+// Stands in for the queue length when it could not be read
+static constexpr uint64_t kNoQueueLength =
+    std::numeric_limits<uint64_t>::max();
+
 // This allows mapping from a speed and port transmission technology
 // to a broadcom supported interface
 static const std::map<cfg::PortSpeed,
@@ -370,6 +422,7 @@ void BcmPort::program(const shared_ptr<Port>& port) {
     setFEC(port);
   }
   setPause(port);
+  setIngressBuffer(port);
   // Update Tx Setting if needed.
   setTxSetting(port);
   setSflowRates(port);
@@ -575,80 +628,96 @@ void BcmPort::updateStats() {
   }
   auto now = duration_cast<seconds>(system_clock::now().time_since_epoch());
   HwPortStats curPortStats;
-  updateStat(
-      now, kInBytes(), opennsl_spl_snmpIfHCInOctets, &curPortStats.inBytes_);
-  updateStat(
-      now,
-      kInUnicastPkts(),
-      opennsl_spl_snmpIfHCInUcastPkts,
-      &curPortStats.inUnicastPkts_);
-  updateStat(
-      now,
-      kInMulticastPkts(),
-      opennsl_spl_snmpIfHCInMulticastPkts,
-      &curPortStats.inMulticastPkts_);
-  updateStat(
-      now,
-      kInBroadcastPkts(),
-      opennsl_spl_snmpIfHCInBroadcastPkts,
-      &curPortStats.inBroadcastPkts_);
-  updateStat(
-      now,
-      kInDiscards(),
-      opennsl_spl_snmpIfInDiscards,
-      &curPortStats.inDiscards_);
-  updateStat(
-      now, kInErrors(), opennsl_spl_snmpIfInErrors, &curPortStats.inErrors_);
-  updateStat(
-      now,
-      kInIpv4HdrErrors(),
-      opennsl_spl_snmpIpInHdrErrors,
-      &curPortStats.inIpv4HdrErrors_);
-  updateStat(
-      now,
-      kInIpv6HdrErrors(),
-      opennsl_spl_snmpIpv6IfStatsInHdrErrors,
-      &curPortStats.inIpv6HdrErrors_);
-  updateStat(
-      now,
-      kInPause(),
-      opennsl_spl_snmpDot3InPauseFrames,
-      &curPortStats.inPause_);
-  // Egress Stats
-  updateStat(
-      now,
-      kOutBytes(),
-      opennsl_spl_snmpIfHCOutOctets,
-      &curPortStats.outBytes_);
-  updateStat(
-      now,
-      kOutUnicastPkts(),
-      opennsl_spl_snmpIfHCOutUcastPkts,
-      &curPortStats.outUnicastPkts_);
-  updateStat(
-      now,
-      kOutMulticastPkts(),
-      opennsl_spl_snmpIfHCOutMulticastPkts,
-      &curPortStats.outMulticastPkts_);
-  updateStat(
-      now,
-      kOutBroadcastPkts(),
-      opennsl_spl_snmpIfHCOutBroadcastPckts,
-      &curPortStats.outBroadcastPkts_);
-  updateStat(
-      now,
-      kOutDiscards(),
-      opennsl_spl_snmpIfOutDiscards,
-      &curPortStats.outDiscards_);
-  updateStat(
-      now, kOutErrors(), opennsl_spl_snmpIfOutErrors, &curPortStats.outErrors_);
-  updateStat(
-      now,
-      kOutPause(),
-      opennsl_spl_snmpDot3OutPauseFrames,
-      &curPortStats.outPause_);
-
-  setAdditionalStats(now, &curPortStats);
+  for (const auto& stat : kPortStats) {
+    updateStat(now, stat.key, stat.type, &(curPortStats.*stat.field));
+  }
+  updatePortStats(now, &curPortStats);
+
+  // Update the queue length stat
+  uint32_t qlength;
+  auto ret = opennsl_port_queued_count_get(unit_, port_, &qlength);
+  if (OPENNSL_FAILURE(ret)) {
+    XLOG(ERR) << "Failed to get queue length for port " << port_ << " :"
+              << opennsl_errmsg(ret);
+  } else {
+    outQueueLen_.addValue(now.count(), qlength);
+    // TODO: outQueueLen_ only exports the average queue length over the last
+    // 60 seconds, 10 minutes, etc.
+    // We should also export the current value.  We could use a simple counter
+    // or a dynamic counter for this.
+  }
+
+  // Update the packet length histograms
+  updatePktLenHist(now, &inPktLengths_, kInPktLengthStats);
+  updatePktLenHist(now, &outPktLengths_, kOutPktLengthStats);
+};
+
+size_t BcmPort::numBulkStats() {
+  // The queue length is read separately, into the last slot
+  return kBulkStatTypes.size() + 1;
+}
+
+folly::Optional<size_t> BcmPort::getBulkStatIndex(folly::StringPiece key) {
+  for (size_t i = 0; i < kPortStats.size(); ++i) {
+    if (kPortStats[i].key == key) {
+      return i;
+    }
+  }
+  return folly::none;
+}
+
+bool BcmPort::readStats(uint64_t* values) const {
+  if (!shouldReportStats()) {
+    return false;
+  }
+  // opennsl_stat_multi_get() unfortunately doesn't correctly const qualify
+  // it's stats arguments right now.
+  opennsl_stat_val_t* statsArg =
+      const_cast<opennsl_stat_val_t*>(&kBulkStatTypes.front());
+  auto ret = opennsl_stat_multi_get(
+      unit_, port_, kBulkStatTypes.size(), statsArg, values);
+  if (OPENNSL_FAILURE(ret)) {
+    XLOG(ERR) << "Failed to get stats for port " << port_ << " :"
+              << opennsl_errmsg(ret);
+    return false;
+  }
+
+  uint32_t qlength;
+  ret = opennsl_port_queued_count_get(unit_, port_, &qlength);
+  if (OPENNSL_FAILURE(ret)) {
+    XLOG(ERR) << "Failed to get queue length for port " << port_ << " :"
+              << opennsl_errmsg(ret);
+    values[kBulkStatTypes.size()] = kNoQueueLength;
+  } else {
+    values[kBulkStatTypes.size()] = qlength;
+  }
+  return true;
+}
+
+void BcmPort::updateStats(std::chrono::seconds now, const uint64_t* values) {
+  HwPortStats curPortStats;
+  auto value = values;
+  for (const auto& stat : kPortStats) {
+    getPortCounterIf(stat.key)->updateValue(now, *value);
+    curPortStats.*stat.field = *value;
+    ++value;
+  }
+  updatePortStats(now, &curPortStats);
+
+  addPktLenHist(now, &inPktLengths_, value, kInPktLengthStats.size());
+  value += kInPktLengthStats.size();
+  addPktLenHist(now, &outPktLengths_, value, kOutPktLengthStats.size());
+  value += kOutPktLengthStats.size();
+
+  if (*value != kNoQueueLength) {
+    outQueueLen_.addValue(now.count(), *value);
+  }
+}
+
+void BcmPort::updatePortStats(
+    std::chrono::seconds now,
+    HwPortStats* curPortStats) {
+  setAdditionalStats(now, curPortStats);
 
   auto lastPortStats = lastPortStats_.rlock()->portStats();
 
@@ -663,48 +732,30 @@ void BcmPort::updateStats() {
     // std::max(..) is used, since stats from  h/w are synced non atomically,
     // So depending on what get synced later # of pause maybe be slightly
     // higher than # of discards.
-    auto inPauseSincePrev = curPortStats.inPause_ - lastPortStats.inPause_;
+    auto inPauseSincePrev = curPortStats->inPause_ - lastPortStats.inPause_;
     auto inDiscardsSincePrev =
-        curPortStats.inDiscards_ - lastPortStats.inDiscards_;
+        curPortStats->inDiscards_ - lastPortStats.inDiscards_;
     if (inPauseSincePrev >= 0 && inDiscardsSincePrev >= 0) {
       // Account for counter rollover.
       auto inNonPauseDiscardsSincePrev =
           std::max(0L, (inDiscardsSincePrev - inPauseSincePrev));
       // Init current port stats from prev value or 0
-      curPortStats.inNonPauseDiscards_ =
+      curPortStats->inNonPauseDiscards_ =
           (lastPortStats.inNonPauseDiscards_ == kUninit
                ? 0
                : lastPortStats.inNonPauseDiscards_);
       // Counters are cumalative
-      curPortStats.inNonPauseDiscards_ += inNonPauseDiscardsSincePrev;
+      curPortStats->inNonPauseDiscards_ += inNonPauseDiscardsSincePrev;
       auto inNonPauseDiscards = getPortCounterIf(kInNonPauseDiscards());
-      inNonPauseDiscards->updateValue(now, curPortStats.inNonPauseDiscards_);
+      inNonPauseDiscards->updateValue(now, curPortStats->inNonPauseDiscards_);
     }
   }
 
   {
     auto lockedLastPortStatsPtr = lastPortStats_.wlock();
-    *lockedLastPortStatsPtr = BcmPortStats(curPortStats, now);
+    *lockedLastPortStatsPtr = BcmPortStats(*curPortStats, now);
   }
-
-  // Update the queue length stat
-  uint32_t qlength;
-  auto ret = opennsl_port_queued_count_get(unit_, port_, &qlength);
-  if (OPENNSL_FAILURE(ret)) {
-    XLOG(ERR) << "Failed to get queue length for port " << port_ << " :"
-              << opennsl_errmsg(ret);
-  } else {
-    outQueueLen_.addValue(now.count(), qlength);
-    // TODO: outQueueLen_ only exports the average queue length over the last
-    // 60 seconds, 10 minutes, etc.
-    // We should also export the current value.  We could use a simple counter
-    // or a dynamic counter for this.
-  }
-
-  // Update the packet length histograms
-  updatePktLenHist(now, &inPktLengths_, kInPktLengthStats);
-  updatePktLenHist(now, &outPktLengths_, kOutPktLengthStats);
-};
+}
 
 void BcmPort::updateStat(
     std::chrono::seconds now,
@@ -748,9 +799,16 @@ void BcmPort::updatePktLenHist(
     return;
   }
 
-  // Update the histogram
+  addPktLenHist(now, hist, counters, stats.size());
+}
+
+void BcmPort::addPktLenHist(
+    std::chrono::seconds now,
+    stats::ExportedHistogramMapImpl::LockableHistogram* hist,
+    const uint64_t* counters,
+    size_t numCounters) {
   auto guard = hist->makeLockGuard();
-  for (int idx = 0; idx < stats.size(); ++idx) {
+  for (size_t idx = 0; idx < numCounters; ++idx) {
     hist->addValueLocked(guard, now.count(), idx, counters[idx]);
   }
 }
@@ -759,6 +817,10 @@ BcmPort::BcmPortStats::BcmPortStats(int numUnicastQueues) {
   portStats_.set_queueOutDiscardBytes_(
       std::vector<int64_t>(numUnicastQueues, 0));
   portStats_.set_queueOutBytes_(std::vector<int64_t>(numUnicastQueues, 0));
+  portStats_.set_queueWredDroppedPackets_(
+      std::vector<int64_t>(numUnicastQueues, 0));
+  portStats_.set_queueEcnMarkedPackets_(
+      std::vector<int64_t>(numUnicastQueues, 0));
 }
 
 BcmPort::BcmPortStats::BcmPortStats(
@@ -26,6 +26,7 @@ extern "C" {
 #include "fboss/agent/hw/bcm/gen-cpp2/hardware_stats_types.h"
 #include "fboss/agent/state/Port.h"
 
+#include <folly/Optional.h>
 #include <folly/Range.h>
 #include <folly/Synchronized.h>
 #include <mutex>
@@ -128,6 +129,18 @@ class BcmPort {
    * Update this port's statistics.
    */
   void updateStats();
+  /*
+   * Bulk stats collection reads the counters of every port first, with
+   * readStats(), and only then updates the exported stats from what was
+   * read, with updateStats(now, values).  values holds numBulkStats()
+   * counters.  readStats() returns false if the port's stats are not
+   * reported or could not be read.
+   */
+  static size_t numBulkStats();
+  // The index of the named port counter, such as kInBytes(), in values
+  static folly::Optional<size_t> getBulkStatIndex(folly::StringPiece key);
+  bool readStats(uint64_t* values) const;
+  void updateStats(std::chrono::seconds now, const uint64_t* values);
   HwPortStats getPortStats() const;
   std::chrono::seconds getTimeRetrieved() const;
 
@@ -189,6 +202,12 @@ class BcmPort {
   void updatePktLenHist(std::chrono::seconds now,
                         stats::ExportedHistogramMapImpl::LockableHistogram* hist,
                         const std::vector<opennsl_stat_val_t>& stats);
+  void addPktLenHist(std::chrono::seconds now,
+                     stats::ExportedHistogramMapImpl::LockableHistogram* hist,
+                     const uint64_t* counters,
+                     size_t numCounters);
+  // Finish updating from the counters in curPortStats, and save them
+  void updatePortStats(std::chrono::seconds now, HwPortStats* curPortStats);
   // Set stats that are either FB specific, not available in
   // open source opennsl release.
   void setAdditionalStats(std::chrono::seconds now, HwPortStats* curPortStats);
@@ -206,6 +225,8 @@ class BcmPort {
   void setInterfaceMode(const std::shared_ptr<Port>& swPort);
   void setFEC(const std::shared_ptr<Port>& swPort);
   void setPause(const std::shared_ptr<Port>& swPort);
+  // Program the reserved, headroom and shared pool limits of the port
+  void setIngressBuffer(const std::shared_ptr<Port>& swPort);
   void setTxSetting(const std::shared_ptr<Port>& swPort);
   bool isMmuLossy() const;
   uint8_t determinePipe() const;
@@ -0,0 +1,71 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "fboss/agent/hw/bcm/BcmPortCounterSampler.h"
+
+#include "fboss/agent/hw/bcm/BcmPort.h"
+#include "fboss/agent/hw/bcm/BcmPortTable.h"
+#include "fboss/agent/hw/bcm/gen-cpp2/hardware_stats_constants.h"
+
+#include <folly/Conv.h>
+#include <folly/String.h>
+#include <folly/logging/xlog.h>
+
+namespace facebook { namespace fboss {
+
+BcmPortCounterSampler::BcmPortCounterSampler(
+    const BcmPortTable* portTable,
+    const std::set<CounterRequest>& counters)
+    : portTable_(portTable) {
+  for (const auto& c : counters) {
+    folly::StringPiece portName;
+    folly::StringPiece statName;
+    if (!folly::split('.', c.counterName, portName, statName)) {
+      XLOG(WARNING) << "Requested counter " << c.counterName
+                    << " is not a port counter";
+      continue;
+    }
+    auto port = folly::tryTo<uint16_t>(portName);
+    if (!port.hasValue() || !portTable_->portExists(PortID(*port))) {
+      XLOG(WARNING) << "Requested counter " << c.counterName
+                    << " is not on a known port";
+      continue;
+    }
+    auto index = BcmPort::getBulkStatIndex(statName);
+    if (!index) {
+      XLOG(WARNING) << "Requested counter " << c.counterName
+                    << " does not exist";
+      continue;
+    }
+    counters_.push_back(Counter{
+        c, portTable_->getCounterSnapshotSlot(PortID(*port)), *index});
+  }
+}
+
+void BcmPortCounterSampler::sample(int64_t* values) {
+  auto snapshot = portTable_->getCounterSnapshot();
+  for (const auto& counter : counters_) {
+    // Every counter needs a value for each sample, so report the ones that
+    // could not be read as uninitialized
+    int64_t value = hardware_stats_constants::STAT_UNINITIALIZED();
+    if (snapshot->valid[counter.slot]) {
+      value = snapshot->getValues(counter.slot)[counter.index];
+    }
+    *values++ = value;
+  }
+}
+
+void BcmPortCounterSampler::getCounters(
+    std::vector<CounterRequest>* counters) const {
+  for (const auto& counter : counters_) {
+    counters->push_back(counter.req);
+  }
+}
+
+}} // facebook::fboss
@@ -0,0 +1,50 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#pragma once
+
+#include "fboss/agent/HighresCounterUtil.h"
+
+#include <set>
+#include <vector>
+
+namespace facebook { namespace fboss {
+
+class BcmPortTable;
+
+/*
+ * A sampler for port counters, read from the port table's counter snapshot
+ * so that sampling shares its SDK reads with the stats thread.  Counters are
+ * named "<port id>.<stat>", for example "5.in_bytes".
+ */
+class BcmPortCounterSampler : public HighresSampler {
+ public:
+  BcmPortCounterSampler(
+      const BcmPortTable* portTable,
+      const std::set<CounterRequest>& counters);
+  ~BcmPortCounterSampler() override {}
+  void sample(int64_t* values) override;
+  int numCounters() const override { return counters_.size(); }
+  void getCounters(std::vector<CounterRequest>* counters) const override;
+
+  static constexpr const char* const kIdentifier = "bcm_port";
+
+ private:
+  struct Counter {
+    CounterRequest req;
+    // Where the counter is in the snapshot
+    size_t slot;
+    size_t index;
+  };
+
+  const BcmPortTable* portTable_;
+  std::vector<Counter> counters_;
+};
+
+}} // facebook::fboss
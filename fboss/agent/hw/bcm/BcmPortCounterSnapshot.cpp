@@ -0,0 +1,73 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "fboss/agent/hw/bcm/BcmPortCounterSnapshot.h"
+
+#include "fboss/agent/hw/bcm/BcmPort.h"
+#include "fboss/agent/hw/bcm/BcmStats.h"
+
+using std::chrono::duration_cast;
+using std::chrono::microseconds;
+using std::chrono::seconds;
+using std::chrono::steady_clock;
+using std::chrono::system_clock;
+
+namespace facebook { namespace fboss {
+
+BcmPortCounterSnapshot::BcmPortCounterSnapshot(std::vector<BcmPort*> ports)
+    : ports_(std::move(ports)) {}
+
+std::shared_ptr<const BcmPortCounterSnapshot::Snapshot>
+BcmPortCounterSnapshot::get(microseconds maxAge) {
+  auto isFresh = [maxAge](const std::shared_ptr<Snapshot>& snapshot) {
+    return snapshot && steady_clock::now() - snapshot->readTime <= maxAge;
+  };
+  auto latest = getLatest();
+  if (isFresh(latest)) {
+    return latest;
+  }
+
+  std::lock_guard<std::mutex> guard(readLock_);
+  // Another reader may have read the counters while we waited
+  latest = getLatest();
+  if (isFresh(latest)) {
+    return latest;
+  }
+  auto next = std::move(spare_);
+  if (!next || next.use_count() > 1) {
+    // A reader still holds it
+    next = std::make_shared<Snapshot>();
+  }
+  read(next.get());
+  {
+    folly::SpinLockGuard g(latestLock_);
+    std::swap(latest_, next);
+  }
+  spare_ = std::move(next);
+  return getLatest();
+}
+
+void BcmPortCounterSnapshot::read(Snapshot* snapshot) const {
+  auto numStats = BcmPort::numBulkStats();
+  snapshot->numStats = numStats;
+  snapshot->values.resize(ports_.size() * numStats);
+  snapshot->valid.assign(ports_.size(), false);
+
+  auto start = steady_clock::now();
+  for (size_t i = 0; i < ports_.size(); ++i) {
+    snapshot->valid[i] = ports_[i]->readStats(&snapshot->values[i * numStats]);
+  }
+  snapshot->readTime = steady_clock::now();
+  snapshot->now =
+      duration_cast<seconds>(system_clock::now().time_since_epoch());
+  BcmStats::get()->portStatsRead(
+      duration_cast<microseconds>(snapshot->readTime - start));
+}
+
+}} // facebook::fboss
@@ -0,0 +1,90 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#pragma once
+
+#include <folly/SpinLock.h>
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace facebook { namespace fboss {
+
+class BcmPort;
+
+/*
+ * BcmPortCounterSnapshot keeps the counters of all ports, as read in bulk by
+ * BcmPort::readStats(), so that the stats thread and the high resolution
+ * samplers can share one set of SDK reads rather than each reading the
+ * counters themselves.
+ *
+ * Readers ask for a snapshot no older than some age.  The counters are only
+ * read again when the latest snapshot is older than that, by whichever
+ * reader gets there first; the others wait for it and share the result.
+ * A snapshot is never modified once published, so readers hold no lock
+ * while using it.  The snapshot being replaced is reused for the next read
+ * once no reader holds it any more, so the two are swapped back and forth
+ * rather than allocated each time.
+ */
+class BcmPortCounterSnapshot {
+ public:
+  struct Snapshot {
+    // When the counters were read
+    std::chrono::steady_clock::time_point readTime;
+    std::chrono::seconds now{0};
+    // Whether the counters of each port could be read
+    std::vector<bool> valid;
+    // The BcmPort::numBulkStats() counters of each port, one after another
+    size_t numStats{0};
+    std::vector<uint64_t> values;
+
+    const uint64_t* getValues(size_t slot) const {
+      return &values[slot * numStats];
+    }
+  };
+
+  /*
+   * ports must outlive the snapshot.  The slot of each port is its index in
+   * ports.
+   */
+  explicit BcmPortCounterSnapshot(std::vector<BcmPort*> ports);
+
+  const std::vector<BcmPort*>& getPorts() const {
+    return ports_;
+  }
+
+  /*
+   * Returns a snapshot read no longer than maxAge ago.
+   */
+  std::shared_ptr<const Snapshot> get(std::chrono::microseconds maxAge);
+
+ private:
+  // Forbidden copy constructor and assignment operator
+  BcmPortCounterSnapshot(BcmPortCounterSnapshot const &) = delete;
+  BcmPortCounterSnapshot& operator=(BcmPortCounterSnapshot const &) = delete;
+
+  std::shared_ptr<Snapshot> getLatest() const {
+    folly::SpinLockGuard guard(latestLock_);
+    return latest_;
+  }
+  void read(Snapshot* snapshot) const;
+
+  const std::vector<BcmPort*> ports_;
+  // Serializes reading the counters
+  std::mutex readLock_;
+  // The snapshot to read into next, only accessed with readLock_ held
+  std::shared_ptr<Snapshot> spare_;
+  mutable folly::SpinLock latestLock_;
+  std::shared_ptr<Snapshot> latest_;
+};
+
+}} // facebook::fboss
@@ -19,21 +19,33 @@ BcmPortQueueManager::getQueueCounterTypes() const {
     {cfg::StreamType::UNICAST, BcmCosQueueStatType::OUT_BYTES,
      BcmCosQueueCounterScope::QUEUES, kOutBytes()},
     {cfg::StreamType::UNICAST, BcmCosQueueStatType::DROPPED_PACKETS,
-     BcmCosQueueCounterScope::AGGREGATED, kOutCongestionDiscards()}
+     BcmCosQueueCounterScope::AGGREGATED, kOutCongestionDiscards()},
+    {cfg::StreamType::UNICAST, BcmCosQueueStatType::WRED_DROPPED_PACKETS,
+     BcmCosQueueCounterScope::QUEUES, kWredDroppedPackets()},
+    {cfg::StreamType::UNICAST, BcmCosQueueStatType::ECN_MARKED_PACKETS,
+     BcmCosQueueCounterScope::QUEUES, kEcnMarkedPackets()}
   };
   return types;
 }
 
 BcmPortQueueConfig BcmPortQueueManager::getCurrentQueueSettings() const {
+  // What we read back is what the queues are programmed with, so later
+  // config changes only need to write what differs from it
   QueueConfig unicastQueues;
   for (int i = 0; i < cosQueueGports_.unicast.size(); i++) {
-    unicastQueues.push_back(getCurrentQueueSettings(
-      cfg::StreamType::UNICAST, i));
+    auto queue = getCurrentQueueSettings(cfg::StreamType::UNICAST, i);
+    if (queue) {
+      setQueueSettings(cosQueueGports_.unicast[i], queue);
+    }
+    unicastQueues.push_back(std::move(queue));
   }
   QueueConfig multicastQueues;
   for (int i = 0; i < cosQueueGports_.multicast.size(); i++) {
-    multicastQueues.push_back(getCurrentQueueSettings(
-      cfg::StreamType::MULTICAST, i));
+    auto queue = getCurrentQueueSettings(cfg::StreamType::MULTICAST, i);
+    if (queue) {
+      setQueueSettings(cosQueueGports_.multicast[i], queue);
+    }
+    multicastQueues.push_back(std::move(queue));
   }
   return BcmPortQueueConfig(std::move(unicastQueues),
                             std::move(multicastQueues));
@@ -54,6 +66,32 @@ int BcmPortQueueManager::getNumQueues(cfg::StreamType streamType) const {
     cfg::_StreamType_VALUES_TO_NAMES.find(streamType)->second);
 }
 
+void BcmPortQueueManager::getAqms(
+    opennsl_gport_t gport,
+    int queueIdx,
+    std::shared_ptr<PortQueue> queue) const {
+  AqmProfiles profiles;
+  profiles.ecnCapable =
+      getAqmProfile(gport, queueIdx, AqmPacketType::ECN_CAPABLE);
+  profiles.notEcnCapable =
+      getAqmProfile(gport, queueIdx, AqmPacketType::NOT_ECN_CAPABLE);
+  auto aqm = getAqm(profiles);
+  if (aqm) {
+    queue->setAqm(*aqm);
+  }
+}
+
+void BcmPortQueueManager::programAqms(
+    opennsl_gport_t gport,
+    int queueIdx,
+    const std::shared_ptr<PortQueue>& queue) {
+  auto profiles = getAqmProfiles(queue->getAqm());
+  programAqmProfile(
+      gport, queueIdx, AqmPacketType::ECN_CAPABLE, profiles.ecnCapable);
+  programAqmProfile(
+      gport, queueIdx, AqmPacketType::NOT_ECN_CAPABLE, profiles.notEcnCapable);
+}
+
 opennsl_gport_t BcmPortQueueManager::getQueueGPort(
     cfg::StreamType streamType, int queueIdx) const {
   if (streamType == cfg::StreamType::UNICAST) {
@@ -65,5 +65,14 @@ private:
    void programAqms(opennsl_gport_t gport,
                     int queueIdx,
                     const std::shared_ptr<PortQueue>& queue);
+
+   // The discard profile of one type of packet on the queue gport
+   AqmProfile getAqmProfile(opennsl_gport_t gport,
+                            int queueIdx,
+                            AqmPacketType packetType) const;
+   void programAqmProfile(opennsl_gport_t gport,
+                          int queueIdx,
+                          AqmPacketType packetType,
+                          const AqmProfile& profile);
 };
 }} // facebook::fboss
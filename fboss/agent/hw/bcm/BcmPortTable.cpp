@@ -11,6 +11,7 @@
 
 
 #include "common/stats/MonotonicCounter.h"
+#include "common/stats/ServiceData.h"
 #include "fboss/agent/hw/bcm/BcmError.h"
 #include "fboss/agent/hw/bcm/BcmPlatform.h"
 #include "fboss/agent/hw/bcm/BcmPlatformPort.h"
@@ -19,13 +20,32 @@
 #include "fboss/agent/hw/bcm/BcmSwitch.h"
 
 #include <folly/Memory.h>
+#include <folly/ScopeGuard.h>
+#include <folly/logging/xlog.h>
+#include <gflags/gflags.h>
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <thread>
 
 extern "C" {
 #include <opennsl/port.h>
 }
 
+DEFINE_int32(port_counter_snapshot_interval_ms, 10,
+             "The port counters shared by the stats thread and the high "
+             "resolution samplers are read again when older than this");
+DEFINE_int32(port_init_threads, 1,
+             "Number of threads to initialize the ports on at boot. 1 "
+             "initializes them one after another");
+
 namespace facebook { namespace fboss {
 
+using std::chrono::duration_cast;
+using std::chrono::microseconds;
+using std::chrono::milliseconds;
+using std::chrono::steady_clock;
 using std::make_unique;
 using std::unique_ptr;
 using std::make_pair;
@@ -47,6 +67,7 @@ void BcmPortTable::initPorts(const opennsl_port_config_t* portConfig,
   // 128 ports, if the platform only defines 32 ports we will only create 32
   // BcmPort objects.
   auto platformPorts = hw_->getPlatform()->initPorts();
+  std::vector<BcmPort*> toInit;
   for (const auto& entry : platformPorts) {
     opennsl_port_t bcmPortNum = entry.first;
     BcmPlatformPort* platPort = entry.second;
@@ -61,13 +82,83 @@ void BcmPortTable::initPorts(const opennsl_port_config_t* portConfig,
     PortID fbossPortID = platPort->getPortID();
     auto bcmPort = make_unique<BcmPort>(hw_, bcmPortNum, platPort);
     platPort->setBcmPort(bcmPort.get());
-    bcmPort->init(warmBoot);
+    toInit.push_back(bcmPort.get());
 
     fbossPhysicalPorts_.emplace(fbossPortID, bcmPort.get());
     bcmPhysicalPorts_.emplace(bcmPortNum, std::move(bcmPort));
   }
+  initPortsInParallel(toInit, warmBoot);
 
   initPortGroups();
+
+  std::vector<BcmPort*> ports;
+  for (const auto& entry : bcmPhysicalPorts_) {
+    ports.push_back(entry.second.get());
+  }
+  counterSnapshot_ = make_unique<BcmPortCounterSnapshot>(std::move(ports));
+}
+
+void BcmPortTable::initPortsInParallel(
+    const std::vector<BcmPort*>& ports,
+    bool warmBoot) {
+  // BcmPort::init() only programs its own port and tells its own platform
+  // port, so the ports can be initialized in any order, on any thread.
+  std::vector<microseconds> durations(ports.size());
+  std::vector<std::exception_ptr> errors(ports.size());
+  std::atomic<size_t> next{0};
+  auto initNext = [&] {
+    for (size_t idx; (idx = next++) < ports.size();) {
+      auto begin = steady_clock::now();
+      try {
+        ports[idx]->init(warmBoot);
+      } catch (...) {
+        errors[idx] = std::current_exception();
+      }
+      durations[idx] =
+          duration_cast<microseconds>(steady_clock::now() - begin);
+    }
+  };
+
+  auto numThreads = std::min(
+      static_cast<size_t>(std::max(FLAGS_port_init_threads, 1)),
+      std::max(ports.size(), size_t(1)));
+  auto begin = steady_clock::now();
+  {
+    std::vector<std::thread> threads;
+    SCOPE_EXIT {
+      for (auto& thread : threads) {
+        thread.join();
+      }
+    };
+    // This thread takes ports too
+    for (size_t i = 1; i < numThreads; ++i) {
+      threads.emplace_back(initNext);
+    }
+    initNext();
+  }
+  auto elapsed = duration_cast<microseconds>(steady_clock::now() - begin);
+
+  microseconds busy{0};
+  microseconds slowest{0};
+  for (size_t idx = 0; idx < ports.size(); ++idx) {
+    XLOG(DBG1) << "Initialized BCM port " << ports[idx]->getBcmPortId()
+               << " in " << durations[idx].count() << "us";
+    busy += durations[idx];
+    slowest = std::max(slowest, durations[idx]);
+  }
+  XLOG(INFO) << "Initialized " << ports.size() << " ports on " << numThreads
+             << " threads in " << elapsed.count() << "us, "
+             << busy.count() << "us in all, " << slowest.count()
+             << "us for the slowest port";
+  fbData->setCounter("bcm.port_init.us", elapsed.count());
+  fbData->setCounter("bcm.port_init.busy.us", busy.count());
+  fbData->setCounter("bcm.port_init.max.us", slowest.count());
+
+  for (const auto& error : errors) {
+    if (error) {
+      std::rethrow_exception(error);
+    }
+  }
 }
 
 BcmPort* BcmPortTable::getBcmPort(opennsl_port_t id) const {
@@ -109,4 +200,30 @@ void BcmPortTable::updatePortStats() {
  }
 }
 
+void BcmPortTable::updatePortStatsInBulk() {
+  auto snapshot = getCounterSnapshot();
+  const auto& ports = counterSnapshot_->getPorts();
+  for (size_t i = 0; i < ports.size(); ++i) {
+    if (snapshot->valid[i]) {
+      ports[i]->updateStats(snapshot->now, snapshot->getValues(i));
+    }
+  }
+}
+
+std::shared_ptr<const BcmPortCounterSnapshot::Snapshot>
+BcmPortTable::getCounterSnapshot() const {
+  return counterSnapshot_->get(
+      milliseconds(FLAGS_port_counter_snapshot_interval_ms));
+}
+
+size_t BcmPortTable::getCounterSnapshotSlot(PortID id) const {
+  auto bcmPort = getBcmPort(id);
+  const auto& ports = counterSnapshot_->getPorts();
+  auto iter = std::find(ports.begin(), ports.end(), bcmPort);
+  if (iter == ports.end()) {
+    throw FbossError("No counter snapshot slot for port ", id);
+  }
+  return iter - ports.begin();
+}
+
 }} // namespace facebook::fboss
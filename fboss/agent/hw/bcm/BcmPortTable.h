@@ -16,8 +16,11 @@ extern "C" {
 
 #include "fboss/agent/types.h"
 #include "fboss/agent/hw/bcm/BcmPort.h"
+#include "fboss/agent/hw/bcm/BcmPortCounterSnapshot.h"
 
+#include <memory>
 #include <mutex>
+#include <vector>
 #include <boost/container/flat_map.hpp>
 
 namespace facebook { namespace fboss {
@@ -70,6 +73,21 @@ class BcmPortTable {
    * Update all ports' statistics.
    */
   void updatePortStats();
+  /*
+   * Update all ports' statistics from the counter snapshot, which reads the
+   * counters of every port in one pass before any of the exported stats are
+   * updated.
+   */
+  void updatePortStatsInBulk();
+
+  /*
+   * The counters of all ports, read no longer than
+   * --port_counter_snapshot_interval_ms ago.
+   */
+  std::shared_ptr<const BcmPortCounterSnapshot::Snapshot>
+  getCounterSnapshot() const;
+  // The slot of a port's counters in the snapshot; throws if not found
+  size_t getCounterSnapshotSlot(PortID id) const;
 
   bool portExists(PortID port) const {
     return getBcmPortIf(port) != nullptr;
@@ -88,6 +106,11 @@ class BcmPortTable {
    */
   void initPortGroups();
 
+  /* Run BcmPort::init() for each port, on up to --port_init_threads threads,
+   * and report how long each port took.
+   */
+  void initPortsInParallel(const std::vector<BcmPort*>& ports, bool warmBoot);
+
   typedef boost::container::flat_map<opennsl_port_t, std::unique_ptr<BcmPort>>
     BcmPortMap;
 
@@ -112,6 +135,9 @@ class BcmPortTable {
   // outside of the BcmPort objects. This is mainly here to keep a simple
   // ownership model for the port group objects
   BcmPortGroupList bcmPortGroups_;
+
+  // Created once the ports are, in initPorts()
+  std::unique_ptr<BcmPortCounterSnapshot> counterSnapshot_;
 };
 
 }} // namespace facebook::fboss
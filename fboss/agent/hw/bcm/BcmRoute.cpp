@@ -13,21 +13,32 @@ extern "C" {
 #include <opennsl/l3.h>
 }
 
+#include <folly/ExceptionString.h>
 #include <folly/IPAddress.h>
 #include <folly/IPAddressV4.h>
 #include <folly/IPAddressV6.h>
+#include <folly/ScopeGuard.h>
 #include <folly/logging/xlog.h>
 #include "fboss/agent/Constants.h"
 #include "fboss/agent/hw/bcm/BcmError.h"
 #include "fboss/agent/hw/bcm/BcmHost.h"
 #include "fboss/agent/hw/bcm/BcmIntf.h"
 #include "fboss/agent/hw/bcm/BcmPlatform.h"
+#include "fboss/agent/hw/bcm/BcmRouteCounter.h"
 #include "fboss/agent/hw/bcm/BcmSwitch.h"
 #include "fboss/agent/hw/bcm/BcmWarmBootCache.h"
 #include "fboss/agent/if/gen-cpp2/ctrl_types.h"
 
 #include "fboss/agent/state/RouteTypes.h"
 
+#include <algorithm>
+#include <iterator>
+#include <numeric>
+
+DEFINE_bool(route_class_counters, false,
+            "Count the traffic of the LPM routes given a class ID in hardware, "
+            "one counter per class");
+
 namespace facebook { namespace fboss {
 
 namespace {
@@ -81,10 +92,21 @@ bool BcmRoute::canUseHostTable() const {
   return isHostRoute() && hw_->getPlatform()->canUseHostTableForHostRoutes();
 }
 
-void BcmRoute::program(const RouteNextHopEntry& fwd) {
+void BcmRoute::program(
+    const RouteNextHopEntry& fwd,
+    RouteClassID classID,
+    std::mutex* sharedLock) {
   // if the route has been programmed to the HW, check if the forward info is
-  // changed or not. If not, nothing to do.
+  // changed or not. If not, nothing to do but maybe change its counter.
+  if (added_ && fwd == fwd_ && classID == classID_) {
+    return;
+  }
+  std::unique_lock<std::mutex> guard;
+  if (sharedLock) {
+    guard = std::unique_lock<std::mutex>(*sharedLock);
+  }
   if (added_ && fwd == fwd_) {
+    updateCounter(classID);
     return;
   }
 
@@ -109,7 +131,7 @@ void BcmRoute::program(const RouteNextHopEntry& fwd) {
     CHECK_GT(nhops.size(), 0);
     // need to get an entry from the host table for the forward info
     auto host = hw_->writableHostTable()->incRefOrCreateBcmEcmpHost(
-        std::make_pair(vrf_, nhops));
+        BcmRouteTable::getNextHopGroupKey(vrf_, nhops));
     egressId = host->getEgressId();
   }
 
@@ -142,10 +164,11 @@ void BcmRoute::program(const RouteNextHopEntry& fwd) {
       // If the entry already exists in the route table, programHostRoute()
       // removes it as well.
       DCHECK(!BcmRoute::deleteLpmRoute(hw_->getUnit(), vrf_, prefix_, len_));
+      warmBootCache->entryRewritten(BcmWarmBootCache::ROUTE);
       warmBootCache->programmed(vrfAndIP2RouteCitr);
     }
   } else {
-    programLpmRoute(egressId, fwd);
+    programLpmRoute(egressId, fwd, &guard);
   }
   if (added_) {
     // the route was added before, need to free the old nexthop(s)
@@ -157,6 +180,74 @@ void BcmRoute::program(const RouteNextHopEntry& fwd) {
   // new nexthop has been stored in fwd_. From now on, it is up to
   // ~BcmRoute() to clean up such nexthop.
   added_ = true;
+  updateCounter(classID);
+}
+
+void BcmRoute::updateCounter(RouteClassID classID) {
+  if (!staleCounterDetached_) {
+    detachStaleCounter();
+  }
+  if (classID == classID_) {
+    return;
+  }
+  releaseCounter();
+  classID_ = classID;
+  if (classID == RouteClassID(0) || canUseHostTable()) {
+    return;
+  }
+  // Accounting is best effort, so the route stays programmed without it
+  try {
+    counter_ = hw_->writableRouteCounterTable()->incRefOrCreateCounter(
+        classID);
+  } catch (const std::exception& ex) {
+    XLOG(ERR) << "Failed to create the counter of route class " << classID
+              << " for " << prefix_ << "/" << static_cast<int>(len_) << ": "
+              << folly::exceptionStr(ex);
+    return;
+  }
+  opennsl_l3_route_t rt;
+  initL3RouteT(&rt);
+  auto rc = counter_->attach(&rt);
+  if (OPENNSL_FAILURE(rc)) {
+    XLOG(ERR) << "Failed to attach the counter of route class " << classID
+              << " to " << prefix_ << "/" << static_cast<int>(len_) << ": "
+              << opennsl_errmsg(rc);
+    hw_->writableRouteCounterTable()->derefCounter(classID);
+    counter_ = nullptr;
+  }
+}
+
+void BcmRoute::detachStaleCounter() noexcept {
+  staleCounterDetached_ = true;
+  // The routes of a warm boot are taken over with whatever counter they
+  // were attached to, which we don't know of any more.  Without detaching
+  // it, attaching ours would fail, and the old counter would never be freed.
+  if (hw_->getBootType() != BootType::WARM_BOOT || canUseHostTable()) {
+    return;
+  }
+  opennsl_l3_route_t rt;
+  initL3RouteT(&rt);
+  auto rc = BcmRouteCounter::detachStale(hw_, &rt);
+  if (OPENNSL_FAILURE(rc) && rc != OPENNSL_E_NOT_FOUND) {
+    XLOG(ERR) << "Failed to detach the stale counter of " << prefix_ << "/"
+              << static_cast<int>(len_) << ": " << opennsl_errmsg(rc);
+  }
+}
+
+void BcmRoute::releaseCounter() noexcept {
+  if (!counter_) {
+    return;
+  }
+  opennsl_l3_route_t rt;
+  initL3RouteT(&rt);
+  auto rc = counter_->detach(&rt);
+  if (OPENNSL_FAILURE(rc)) {
+    XLOG(ERR) << "Failed to detach the counter of route class " << classID_
+              << " from " << prefix_ << "/" << static_cast<int>(len_) << ": "
+              << opennsl_errmsg(rc);
+  }
+  hw_->writableRouteCounterTable()->derefCounter(classID_);
+  counter_ = nullptr;
 }
 
 void BcmRoute::programHostRoute(opennsl_if_t egressId,
@@ -175,8 +266,10 @@ void BcmRoute::programHostRoute(opennsl_if_t egressId,
   hostRouteHost->addToBcmHostTable(fwd.getNextHopSet().size() > 1, replace);
 }
 
-void BcmRoute::programLpmRoute(opennsl_if_t egressId,
-    const RouteNextHopEntry& fwd) {
+void BcmRoute::programLpmRoute(
+    opennsl_if_t egressId,
+    const RouteNextHopEntry& fwd,
+    std::unique_lock<std::mutex>* sharedLock) {
   opennsl_l3_route_t rt;
   initL3RouteT(&rt);
   rt.l3a_intf = egressId;
@@ -204,9 +297,11 @@ void BcmRoute::programLpmRoute(opennsl_if_t egressId,
       // This is a change
       rt.l3a_flags |= OPENNSL_L3_REPLACE;
       addRoute = true;
+      warmBootCache->entryRewritten(BcmWarmBootCache::ROUTE);
     } else {
       XLOG(DBG3) << " Route for : " << prefix_ << "/" << static_cast<int>(len_)
                  << " in vrf : " << vrf_ << " already exists";
+      warmBootCache->entryUnchanged(BcmWarmBootCache::ROUTE);
     }
   } else {
     addRoute = true;
@@ -219,7 +314,15 @@ void BcmRoute::programLpmRoute(opennsl_if_t egressId,
     if (added_) {
       rt.l3a_flags |= OPENNSL_L3_REPLACE;
     }
+    // Let other routes be programmed while we wait for the SDK
+    bool unlocked = sharedLock->owns_lock();
+    if (unlocked) {
+      sharedLock->unlock();
+    }
     auto rc = opennsl_l3_route_add(hw_->getUnit(), &rt);
+    if (unlocked) {
+      sharedLock->lock();
+    }
     bcmCheckError(rc, "failed to create a route entry for ", prefix_, "/",
         static_cast<int>(len_), " @ ", fwd, " @egress ", egressId);
     XLOG(DBG3) << "created a route entry for " << prefix_.str() << "/"
@@ -227,7 +330,12 @@ void BcmRoute::programLpmRoute(opennsl_if_t egressId,
                << fwd;
   }
   if (vrfAndPfx2RouteCitr != warmBootCache->vrfAndPrefix2Route_end()) {
-    warmBootCache->programmed(vrfAndPfx2RouteCitr);
+    // Found again, as other routes may have changed the cache while it was
+    // unlocked
+    vrfAndPfx2RouteCitr = warmBootCache->findRoute(vrf_, prefix_, len_);
+    if (vrfAndPfx2RouteCitr != warmBootCache->vrfAndPrefix2Route_end()) {
+      warmBootCache->programmed(vrfAndPfx2RouteCitr);
+    }
   }
 }
 
@@ -279,6 +387,7 @@ BcmRoute::~BcmRoute() {
                << prefix_ << "/" << static_cast<int>(len_) << " host: " << host;
     hw_->writableHostTable()->derefBcmHost(hostKey);
   } else {
+    releaseCounter();
     deleteLpmRoute(hw_->getUnit(), vrf_, prefix_, len_);
   }
   // decrease reference counter of the host entry for next hops
@@ -303,7 +412,12 @@ bool BcmRouteTable::Key::operator<(const Key& k2) const {
   return network < k2.network;
 }
 
-BcmRouteTable::BcmRouteTable(const BcmSwitch* hw) : hw_(hw) {
+BcmRouteTable::BcmRouteTable(
+    const BcmSwitch* hw,
+    HugePageResource* tableMemory)
+    : hw_(hw),
+      fibBlocks_(tableMemory, Fib::kBlockBytes),
+      fib_(&fibBlocks_) {
 }
 
 BcmRouteTable::~BcmRouteTable() {
@@ -331,39 +445,139 @@ BcmRoute* BcmRouteTable::getBcmRoute(
 }
 
 template<typename RouteT>
-void BcmRouteTable::addRoute(opennsl_vrf_t vrf, const RouteT *route) {
+BcmRouteTable::Key BcmRouteTable::getKey(
+    opennsl_vrf_t vrf, const RouteT* route) {
   const auto& prefix = route->prefix();
+  return Key{folly::IPAddress(prefix.network), prefix.mask, vrf};
+}
 
-  Key key{folly::IPAddress(prefix.network), prefix.mask, vrf};
+namespace {
+template<typename RouteT>
+RouteNextHopEntry getBcmForwardInfo(const RouteT* route) {
+  CHECK(route->isResolved());
+  RouteNextHopEntry fwd(route->getForwardInfo());
+  if (fwd.getAction() == RouteForwardAction::NEXTHOPS) {
+    fwd = RouteNextHopEntry(
+        BcmRouteTable::normalizeNextHops(fwd.getNextHopSet()),
+        fwd.getAdminDistance());
+  }
+  return fwd;
+}
+
+// The class a route is counted under, if we count them
+template<typename RouteT>
+RouteClassID getBcmClassID(const RouteT* route) {
+  return FLAGS_route_class_counters ? route->getClassID() : RouteClassID(0);
+}
+} // anonymous namespace
+
+RouteNextHopSet BcmRouteTable::normalizeNextHops(
+    const RouteNextHopSet& nhops) {
+  // NOTE:
+  // Due to details of how ECMP vs UCMP recursive route resolution works in
+  // SwSwitch, for an ECMP route we can receive a route whose next hops all
+  // have weight 0. To make the egress programming logic simpler, normalize
+  // those to weight 1 here at the entry point to route programming, rather
+  // than trying to handle it everywhere.  UCMP weights are kept, and make
+  // BcmEcmpEgress program a weighted group.
+  RouteNextHopSet normalized;
+  for (const auto& nhop : nhops) {
+    normalized.insert(ResolvedNextHop(
+        nhop.addr(),
+        nhop.intf(),
+        std::max(nhop.weight(), UCMP_DEFAULT_WEIGHT)));
+  }
+  return normalized;
+}
+
+std::pair<opennsl_vrf_t, RouteNextHopSet> BcmRouteTable::getNextHopGroupKey(
+    opennsl_vrf_t vrf,
+    const RouteNextHopSet& nhops) {
+  return std::make_pair(vrf, normalizeNextHops(nhops));
+}
+
+template<typename RouteT>
+void BcmRouteTable::addRoute(opennsl_vrf_t vrf, const RouteT *route) {
+  auto key = getKey(vrf, route);
   auto ret = fib_.emplace(key, nullptr);
   if (ret.second) {
     SCOPE_FAIL {
       fib_.erase(ret.first);
     };
-    ret.first->second.reset(new BcmRoute(hw_, vrf,
-                                        folly::IPAddress(prefix.network),
-                                        prefix.mask));
+    ret.first->second.reset(
+        new BcmRoute(hw_, vrf, key.network, key.mask));
   }
-  CHECK(route->isResolved());
-  RouteNextHopEntry fwd(route->getForwardInfo());
-  if (fwd.getAction() == RouteForwardAction::NEXTHOPS) {
-    // NOTE:
-    // Due to details of how ECMP vs UCMP recursive route resolution works in
-    // SwSwitch, for an ECMP route we can receive a route whose next hops all
-    // have weight 0. To make the egress programming logic simpler, normalize
-    // those to weight 1 here at the entry point to route programming, rather
-    // than trying to handle it everywhere.
-    RouteNextHopSet nhops;
-    for (const auto& nhop : fwd.getNextHopSet()) {
-      if (nhop.weight() > 1) {
-        throw FbossError("UCMP weights not yet supported in BcmSwitch ", fwd);
-      }
-      nhops.insert(
-          ResolvedNextHop(nhop.addr(), nhop.intf(), UCMP_DEFAULT_WEIGHT));
+  ret.first->second->program(
+      getBcmForwardInfo(route), getBcmClassID(route));
+  if (ret.second) {
+    updateRouteCounts(key, 1);
+  }
+}
+
+template<typename RouteT>
+void BcmRouteTable::addRoutes(
+    opennsl_vrf_t vrf,
+    const std::vector<const RouteT*>& routes,
+    const std::function<void(size_t, const BcmError&)>& onError) {
+  // New routes are collected here, in key order, and merged into fib_ once
+  // we are done, even if a route error aborts the batch.
+  ProgrammedRoutes added;
+  SCOPE_EXIT {
+    addProgrammedRoutes(std::move(added));
+  };
+  programRoutes(vrf, routes, onError, nullptr, &added);
+}
+
+template<typename RouteT>
+void BcmRouteTable::programRoutes(
+    opennsl_vrf_t vrf,
+    const std::vector<const RouteT*>& routes,
+    const std::function<void(size_t, const BcmError&)>& onError,
+    std::mutex* sharedLock,
+    ProgrammedRoutes* added) const {
+  std::vector<Key> keys;
+  keys.reserve(routes.size());
+  for (const auto* route : routes) {
+    keys.push_back(getKey(vrf, route));
+  }
+  // Program shorter prefixes first.  This is the order of our keys, and is
+  // the order LPM tables (ALPM in particular, which also needs the default
+  // route first) are cheapest to build in.
+  std::vector<size_t> order(routes.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+    return keys[a] < keys[b];
+  });
+
+  for (auto idx : order) {
+    const auto& key = keys[idx];
+    std::unique_ptr<BcmRoute> newRoute;
+    auto iter = fib_.find(key);
+    auto* bcmRoute = iter != fib_.end() ? iter->second.get() : nullptr;
+    if (!bcmRoute) {
+      newRoute = std::make_unique<BcmRoute>(hw_, vrf, key.network, key.mask);
+      bcmRoute = newRoute.get();
+    }
+    try {
+      bcmRoute->program(
+          getBcmForwardInfo(routes[idx]), getBcmClassID(routes[idx]),
+          sharedLock);
+    } catch (const BcmError& error) {
+      // A route that failed to program has nothing in hardware to clean up
+      onError(idx, error);
+      continue;
+    }
+    if (newRoute) {
+      added->emplace_back(key, std::move(newRoute));
     }
-    fwd = RouteNextHopEntry(nhops, fwd.getAdminDistance());
   }
-  ret.first->second->program(fwd);
+}
+
+void BcmRouteTable::addProgrammedRoutes(ProgrammedRoutes added) {
+  for (const auto& route : added) {
+    updateRouteCounts(route.first, 1);
+  }
+  fib_.insertSorted(added.begin(), added.end());
 }
 
 template<typename RouteT>
@@ -374,9 +588,50 @@ void BcmRouteTable::deleteRoute(opennsl_vrf_t vrf, const RouteT *route) {
   if (iter == fib_.end()) {
     throw FbossError("Failed to delete a non-existing route ", route->str());
   }
+  updateRouteCounts(key, -1);
   fib_.erase(iter);
 }
 
+template<typename RouteT>
+void BcmRouteTable::deleteRoutes(
+    opennsl_vrf_t vrf, const std::vector<const RouteT*>& routes) {
+  std::vector<Key> keys;
+  keys.reserve(routes.size());
+  for (const auto* route : routes) {
+    keys.push_back(getKey(vrf, route));
+    if (fib_.find(keys.back()) == fib_.end()) {
+      throw FbossError(
+          "Failed to delete a non-existing route ", route->str());
+    }
+  }
+  std::sort(keys.begin(), keys.end());
+  for (const auto& key : keys) {
+    updateRouteCounts(key, -1);
+  }
+  // A large batch is merged with the table in a single pass
+  auto deleted = fib_.eraseSorted(keys.begin(), keys.end());
+  DCHECK_EQ(keys.size(), deleted);
+}
+
+void BcmRouteTable::updateRouteCounts(const Key& key, int change) {
+  auto isHostRoute = key.mask == key.network.bitCount();
+  if (isHostRoute && hw_->getPlatform()->canUseHostTableForHostRoutes()) {
+    return;
+  }
+  if (key.network.isV4()) {
+    numLpmRoutesV4_ += change;
+  } else if (key.mask <= 64) {
+    numLpmRoutesV6Mask0To64_ += change;
+  } else {
+    numLpmRoutesV6Mask65To127_ += change;
+  }
+}
+
+void BcmRouteTable::updateMemoryAccount() {
+  memoryAccount_.set(
+      containerMemoryBytes(fib_) + fib_.size() * sizeof(BcmRoute));
+}
+
 folly::dynamic BcmRouteTable::toFollyDynamic() const {
   folly::dynamic routesJson = folly::dynamic::array;
   for (const auto& route : fib_) {
@@ -391,5 +646,29 @@ template void BcmRouteTable::addRoute(opennsl_vrf_t, const RouteV4 *);
 template void BcmRouteTable::addRoute(opennsl_vrf_t, const RouteV6 *);
 template void BcmRouteTable::deleteRoute(opennsl_vrf_t, const RouteV4 *);
 template void BcmRouteTable::deleteRoute(opennsl_vrf_t, const RouteV6 *);
+template void BcmRouteTable::addRoutes(
+    opennsl_vrf_t,
+    const std::vector<const RouteV4*>&,
+    const std::function<void(size_t, const BcmError&)>&);
+template void BcmRouteTable::addRoutes(
+    opennsl_vrf_t,
+    const std::vector<const RouteV6*>&,
+    const std::function<void(size_t, const BcmError&)>&);
+template void BcmRouteTable::deleteRoutes(
+    opennsl_vrf_t, const std::vector<const RouteV4*>&);
+template void BcmRouteTable::deleteRoutes(
+    opennsl_vrf_t, const std::vector<const RouteV6*>&);
+template void BcmRouteTable::programRoutes(
+    opennsl_vrf_t,
+    const std::vector<const RouteV4*>&,
+    const std::function<void(size_t, const BcmError&)>&,
+    std::mutex*,
+    ProgrammedRoutes*) const;
+template void BcmRouteTable::programRoutes(
+    opennsl_vrf_t,
+    const std::vector<const RouteV6*>&,
+    const std::function<void(size_t, const BcmError&)>&,
+    std::mutex*,
+    ProgrammedRoutes*) const;
 
 }}
@@ -16,16 +16,27 @@ extern "C" {
 
 #include <folly/dynamic.h>
 #include <folly/IPAddress.h>
+#include <gflags/gflags.h>
+#include "fboss/agent/HugePageAllocator.h"
+#include "fboss/agent/MemoryAccount.h"
 #include "fboss/agent/types.h"
 #include "fboss/agent/state/Route.h"
 #include "fboss/agent/state/RouteNextHopEntry.h"
+#include "fboss/lib/SortedBlockMap.h"
 
-#include <boost/container/flat_map.hpp>
+#include <functional>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+DECLARE_bool(route_class_counters);
 
 namespace facebook { namespace fboss {
 
+class BcmError;
 class BcmSwitch;
 class BcmHost;
+class BcmRouteCounter;
 
 /**
  * BcmRoute represents a L3 route object.
@@ -35,7 +46,19 @@ class BcmRoute {
   BcmRoute(const BcmSwitch* hw, opennsl_vrf_t vrf,
            const folly::IPAddress& addr, uint8_t len);
   ~BcmRoute();
-  void program(const RouteNextHopEntry& fwd);
+  /*
+   * If sharedLock is given, routes may be programmed on several threads at
+   * once.  The lock is then held for everything but the SDK route call,
+   * since the host table and warm boot cache are not thread safe.
+   *
+   * A route of a non-zero classID counts its traffic under the counter of
+   * the class (see BcmRouteCounterTable).  Only LPM routes can be counted,
+   * and failing to attach the counter leaves the route programmed.
+   */
+  void program(
+      const RouteNextHopEntry& fwd,
+      RouteClassID classID = RouteClassID(0),
+      std::mutex* sharedLock = nullptr);
   static bool deleteLpmRoute(int unit,
                              opennsl_vrf_t vrf,
                              const folly::IPAddress& prefix,
@@ -50,13 +73,21 @@ class BcmRoute {
   void programHostRoute(opennsl_if_t egressId,
                         const RouteNextHopEntry& fwd,
                         bool replace);
-  void programLpmRoute(opennsl_if_t egressId, const RouteNextHopEntry& fwd);
+  void programLpmRoute(
+      opennsl_if_t egressId,
+      const RouteNextHopEntry& fwd,
+      std::unique_lock<std::mutex>* sharedLock);
   /*
    * Check whether we can use the host route table. BCM platforms
    * support this from TD2 onwards
    */
   bool isHostRoute() const;
   bool canUseHostTable() const;
+  // Move the programmed route to the counter of classID
+  void updateCounter(RouteClassID classID);
+  void releaseCounter() noexcept;
+  // Detach the counter a previous agent left on the route across a warm boot
+  void detachStaleCounter() noexcept;
   // no copy or assign
   BcmRoute(const BcmRoute &) = delete;
   BcmRoute& operator=(const BcmRoute &) = delete;
@@ -68,13 +99,44 @@ class BcmRoute {
                          AdminDistance::MAX_ADMIN_DISTANCE};
   bool added_{false}; // if the route added to HW or not
   opennsl_if_t egressId_{-1};
+  RouteClassID classID_{0};
+  // The counter of classID_, if the route is attached to it
+  BcmRouteCounter* counter_{nullptr};
+  bool staleCounterDetached_{false};
   void initL3RouteT(opennsl_l3_route_t* rt) const;
 };
 
 class BcmRouteTable {
  public:
-  explicit BcmRouteTable(const BcmSwitch* hw);
+  struct Key {
+    folly::IPAddress network;
+    uint8_t mask;
+    opennsl_vrf_t vrf;
+    bool operator<(const Key& k2) const;
+  };
+  // New routes programmed by programRoutes(), in key order
+  using ProgrammedRoutes =
+      std::vector<std::pair<Key, std::unique_ptr<BcmRoute>>>;
+
+  // fib_ draws its memory from tableMemory, which may use huge pages
+  explicit BcmRouteTable(
+      const BcmSwitch* hw,
+      HugePageResource* tableMemory = HugePageResource::forTables());
   ~BcmRouteTable();
+
+  /*
+   * The next hops of a route as we program them, with ECMP next hops given
+   * the default UCMP weight.
+   */
+  static RouteNextHopSet normalizeNextHops(const RouteNextHopSet& nhops);
+  /*
+   * The key of the BcmEcmpHost that routes to the next hops are programmed
+   * with, so that groups created ahead of their routes are the ones the
+   * routes then use.
+   */
+  static std::pair<opennsl_vrf_t, RouteNextHopSet> getNextHopGroupKey(
+      opennsl_vrf_t vrf,
+      const RouteNextHopSet& nhops);
   // throw an error if not found
   BcmRoute* getBcmRoute(
       opennsl_vrf_t vrf, const folly::IPAddress& prefix, uint8_t len) const;
@@ -90,18 +152,94 @@ class BcmRouteTable {
   void addRoute(opennsl_vrf_t vrf, const RouteT *route);
   template<typename RouteT>
   void deleteRoute(opennsl_vrf_t vrf, const RouteT *route);
+
+  /*
+   * Batched versions of addRoute() and deleteRoute(), for programming many
+   * routes at once such as when the FIB is loaded.
+   *
+   * addRoutes() programs the routes in LPM friendly order, less specific
+   * prefixes first, and adds the new ones to our table in a single merge
+   * rather than one insertion each.  If a route fails to program, onError
+   * is called with its index in routes and the error; it may rethrow to
+   * abandon the rest of the batch.
+   *
+   * deleteRoutes() removes all of the routes from our table in a single
+   * pass.  It throws, without deleting anything, if any of them do not
+   * exist.
+   */
+  template<typename RouteT>
+  void addRoutes(
+      opennsl_vrf_t vrf,
+      const std::vector<const RouteT*>& routes,
+      const std::function<void(size_t, const BcmError&)>& onError);
+  template<typename RouteT>
+  void deleteRoutes(
+      opennsl_vrf_t vrf, const std::vector<const RouteT*>& routes);
+
+  /*
+   * addRoutes() in two steps, so that batches in different VRFs or address
+   * families can be programmed concurrently.
+   *
+   * programRoutes() programs a batch in hardware without changing our
+   * table, appending the routes that are new to added.  It may run on
+   * several threads at once for different batches, with the same
+   * sharedLock (see BcmRoute::program()), as long as nothing else changes
+   * the table meanwhile.  The new routes must then be added to the table
+   * with addProgrammedRoutes(), one batch at a time.
+   */
+  template<typename RouteT>
+  void programRoutes(
+      opennsl_vrf_t vrf,
+      const std::vector<const RouteT*>& routes,
+      const std::function<void(size_t, const BcmError&)>& onError,
+      std::mutex* sharedLock,
+      ProgrammedRoutes* added) const;
+  void addProgrammedRoutes(ProgrammedRoutes added);
+
+  /*
+   * The number of routes we have in the LPM table.  Host routes programmed
+   * in the host table are counted by BcmHostTable instead.
+   */
+  uint32_t numLpmRoutesV4() const {
+    return numLpmRoutesV4_;
+  }
+  uint32_t numLpmRoutesV6Mask0To64() const {
+    return numLpmRoutesV6Mask0To64_;
+  }
+  uint32_t numLpmRoutesV6Mask65To127() const {
+    return numLpmRoutesV6Mask65To127_;
+  }
+
+  // Set the memory account of fib_ ("bcm.route_table")
+  void updateMemoryAccount();
+
   folly::dynamic toFollyDynamic() const;
  private:
-  struct Key {
-    folly::IPAddress network;
-    uint8_t mask;
-    opennsl_vrf_t vrf;
-    bool operator<(const Key& k2) const;
-  };
+  template<typename RouteT>
+  static Key getKey(opennsl_vrf_t vrf, const RouteT* route);
+  // Update the LPM route counts for a route added to or removed from fib_
+  void updateRouteCounts(const Key& key, int change);
+
+  using Fib = SortedBlockMap<
+      Key,
+      std::unique_ptr<BcmRoute>,
+      std::less<Key>,
+      256,
+      HugePageBlockAllocator<std::pair<Key, std::unique_ptr<BcmRoute>>>>;
 
   const BcmSwitch *hw_;
 
-  boost::container::flat_map<Key, std::unique_ptr<BcmRoute>> fib_;
+  // The blocks of fib_, which are each too small to be mapped on their own
+  HugePageBlockPool fibBlocks_;
+  /*
+   * Sorted by key, in blocks so that routes can be added and deleted one at
+   * a time without moving the whole table
+   */
+  Fib fib_;
+  uint32_t numLpmRoutesV4_{0};
+  uint32_t numLpmRoutesV6Mask0To64_{0};
+  uint32_t numLpmRoutesV6Mask65To127_{0};
+  MemoryAccount memoryAccount_{"bcm.route_table"};
 };
 
 }}
@@ -0,0 +1,60 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "fboss/agent/hw/bcm/BcmRouteCounter.h"
+
+#include <folly/logging/xlog.h>
+#include "fboss/agent/hw/bcm/BcmStatUpdater.h"
+#include "fboss/agent/hw/bcm/BcmSwitch.h"
+
+namespace facebook { namespace fboss {
+
+BcmRouteCounterTable::BcmRouteCounterTable(const BcmSwitch* hw) : hw_(hw) {}
+
+BcmRouteCounterTable::~BcmRouteCounterTable() {
+  // Routes hold references to the counters, so they must be gone by now
+  if (!counters_.empty()) {
+    XLOG(ERR) << "Destroying the route counter table with "
+              << counters_.size() << " counters still in use";
+  }
+}
+
+BcmRouteCounter* BcmRouteCounterTable::incRefOrCreateCounter(
+    RouteClassID classID) {
+  auto iter = counters_.find(classID);
+  if (iter != counters_.end()) {
+    ++iter->second.second;
+    return iter->second.first.get();
+  }
+  auto counter = std::make_unique<BcmRouteCounter>(hw_, classID);
+  auto* ptr = counter.get();
+  hw_->getStatUpdater()->toBeAddedRouteCounter(ptr->getHandle(), classID);
+  counters_.emplace(classID, std::make_pair(std::move(counter), 1));
+  XLOG(DBG2) << "Created the counter of route class " << classID;
+  return ptr;
+}
+
+void BcmRouteCounterTable::derefCounter(RouteClassID classID) noexcept {
+  auto iter = counters_.find(classID);
+  if (iter == counters_.end()) {
+    XLOG(ERR) << "Dereferencing the missing counter of route class "
+              << classID;
+    return;
+  }
+  if (--iter->second.second > 0) {
+    return;
+  }
+  if (auto* statUpdater = hw_->getStatUpdater()) {
+    statUpdater->toBeRemovedRouteCounter(iter->second.first->getHandle());
+  }
+  counters_.erase(iter);
+  XLOG(DBG2) << "Destroyed the counter of route class " << classID;
+}
+
+}} // facebook::fboss
@@ -0,0 +1,99 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#pragma once
+
+extern "C" {
+#include <opennsl/l3.h>
+}
+
+#include "fboss/agent/types.h"
+
+#include <boost/container/flat_map.hpp>
+
+#include <memory>
+#include <utility>
+
+namespace facebook { namespace fboss {
+
+class BcmSwitch;
+
+/**
+ * BcmRouteCounter is a hardware counter of the packets and bytes forwarded
+ * by the LPM routes of one route class, shared by all of them.
+ */
+class BcmRouteCounter {
+ public:
+  using BcmRouteCounterHandle = int;
+  BcmRouteCounter(const BcmSwitch* hw, RouteClassID classID);
+  ~BcmRouteCounter();
+
+  BcmRouteCounterHandle getHandle() const {
+    return handle_;
+  }
+  RouteClassID getClassID() const {
+    return classID_;
+  }
+
+  /*
+   * Start or stop counting the traffic of a route in hardware under this
+   * counter.  Returns the SDK error code.
+   */
+  int attach(opennsl_l3_route_t* route) const;
+  int detach(opennsl_l3_route_t* route) const;
+
+  /*
+   * Detach whichever counter the route is attached to in hardware, and free
+   * it once no other route is, for the counters a previous agent left behind
+   * across a warm boot.  Returns the SDK error code, OPENNSL_E_NOT_FOUND if
+   * the route has no counter.
+   */
+  static int detachStale(const BcmSwitch* hw, opennsl_l3_route_t* route);
+
+ private:
+  // no copy or assign
+  BcmRouteCounter(const BcmRouteCounter&) = delete;
+  BcmRouteCounter& operator=(const BcmRouteCounter&) = delete;
+
+  const BcmSwitch* hw_;
+  RouteClassID classID_;
+  BcmRouteCounterHandle handle_{-1};
+};
+
+/**
+ * The route counters in use, one per route class, created with the first
+ * route attached to them and destroyed with the last.  They are registered
+ * with the BcmStatUpdater to be collected with the other hardware stats.
+ */
+class BcmRouteCounterTable {
+ public:
+  explicit BcmRouteCounterTable(const BcmSwitch* hw);
+  ~BcmRouteCounterTable();
+
+  BcmRouteCounter* incRefOrCreateCounter(RouteClassID classID);
+  void derefCounter(RouteClassID classID) noexcept;
+
+  size_t numCounters() const {
+    return counters_.size();
+  }
+
+ private:
+  // no copy or assign
+  BcmRouteCounterTable(const BcmRouteCounterTable&) = delete;
+  BcmRouteCounterTable& operator=(const BcmRouteCounterTable&) = delete;
+
+  const BcmSwitch* hw_;
+  // The counter of each class, and the number of routes attached to it
+  boost::container::flat_map<
+      RouteClassID,
+      std::pair<std::unique_ptr<BcmRouteCounter>, uint32_t>>
+      counters_;
+};
+
+}} // facebook::fboss
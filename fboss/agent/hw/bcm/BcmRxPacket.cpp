@@ -9,6 +9,8 @@
  */
 #include "fboss/agent/hw/bcm/BcmRxPacket.h"
 
+#include <atomic>
+
 extern "C" {
 #include <opennsl/rx.h>
 }
@@ -17,9 +19,12 @@ using folly::IOBuf;
 
 namespace {
 
+std::atomic<uint64_t> numBuffersHeld{0};
+
 void freeRxBuf(void *ptr, void* arg) {
   intptr_t unit = reinterpret_cast<intptr_t>(arg);
   opennsl_rx_free(unit, ptr);
+  --numBuffersHeld;
 }
 
 }
@@ -27,7 +32,8 @@ void freeRxBuf(void *ptr, void* arg) {
 namespace facebook { namespace fboss {
 
 BcmRxPacket::BcmRxPacket(const opennsl_pkt_t* pkt)
-  : unit_(pkt->unit) {
+  : unit_(pkt->unit),
+    cos_(pkt->cos) {
   // The BCM RX code always uses a single buffer.
   // As long as there is just a single buffer, we don't need to allocate
   // a separate array of opennsl_pkt_blk_t objects.
@@ -42,6 +48,7 @@ BcmRxPacket::BcmRxPacket(const opennsl_pkt_t* pkt)
       length,
       freeRxBuf,                       // FreeFunction freeFn
       reinterpret_cast<void*>(unit_)); // void* userData
+  ++numBuffersHeld;
 
   srcPort_ = PortID(pkt->src_port);
   srcVlan_ = VlanID(pkt->vlan);
@@ -53,4 +60,8 @@ BcmRxPacket::~BcmRxPacket() {
   // to free the packet data
 }
 
+uint64_t BcmRxPacket::getNumBuffersHeld() {
+  return numBuffersHeld;
+}
+
 }} // facebook::fboss
@@ -29,8 +29,22 @@ class BcmRxPacket : public RxPacket {
 
   ~BcmRxPacket() override;
 
+  // The CPU CoS queue the packet was trapped to
+  int cosQueue() const override {
+    return cos_;
+  }
+
+  /*
+   * The packet data stays in the SDK's DMA buffer.  Clones of buf() share
+   * it, so that packet captures and the tun interfaces see the packet
+   * without a copy, and it is only given back to the SDK once the last of
+   * them is destroyed.  This is the number of buffers held so far.
+   */
+  static uint64_t getNumBuffersHeld();
+
  private:
   int unit_{-1};
+  int cos_{-1};
 };
 
 }} // facebook::fboss
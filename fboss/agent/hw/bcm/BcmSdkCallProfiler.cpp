@@ -0,0 +1,147 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "fboss/agent/hw/bcm/BcmSdkCallProfiler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+
+namespace facebook { namespace fboss {
+
+namespace {
+
+/*
+ * The cycle counter and clock at the start and end of the profiling
+ * window, to convert cycles to time with.
+ */
+struct Window {
+  std::mutex lock;
+  uint64_t startCycles{0};
+  std::chrono::steady_clock::time_point startTime;
+  uint64_t endCycles{0};
+  std::chrono::steady_clock::time_point endTime;
+};
+
+Window& getWindow() {
+  static Window window;
+  return window;
+}
+
+size_t bucketOf(uint64_t cycles) {
+  if (cycles == 0) {
+    return 0;
+  }
+  size_t bucket = 63 - __builtin_clzll(cycles);
+  return std::min(bucket, BcmSdkCallStats::kNumBuckets - 1);
+}
+
+} // unnamed namespace
+
+constexpr size_t BcmSdkCallStats::kNumBuckets;
+
+BcmSdkCallStats* BcmSdkCallProfiler::head_{nullptr};
+std::atomic<bool> BcmSdkCallProfiler::enabled_{false};
+
+BcmSdkCallStats::BcmSdkCallStats(const char* function)
+    : function_(function), next_(BcmSdkCallProfiler::head_) {
+  // Only during static initialization, before any thread could profile
+  BcmSdkCallProfiler::head_ = this;
+}
+
+void BcmSdkCallStats::record(uint64_t cycles) {
+  calls_.fetch_add(1, std::memory_order_relaxed);
+  totalCycles_.fetch_add(cycles, std::memory_order_relaxed);
+  buckets_[bucketOf(cycles)].fetch_add(1, std::memory_order_relaxed);
+  auto max = maxCycles_.load(std::memory_order_relaxed);
+  while (cycles > max &&
+         !maxCycles_.compare_exchange_weak(
+             max, cycles, std::memory_order_relaxed)) {
+  }
+}
+
+SdkCallProfile BcmSdkCallStats::getProfile() const {
+  SdkCallProfile profile;
+  profile.function = function_;
+  profile.calls = calls_.load(std::memory_order_relaxed);
+  profile.totalCycles = totalCycles_.load(std::memory_order_relaxed);
+  profile.maxCycles = maxCycles_.load(std::memory_order_relaxed);
+  // Leave out the empty buckets of the slowest calls
+  size_t numBuckets = kNumBuckets;
+  while (numBuckets > 0 &&
+         buckets_[numBuckets - 1].load(std::memory_order_relaxed) == 0) {
+    --numBuckets;
+  }
+  profile.cycleHistogram.reserve(numBuckets);
+  for (size_t i = 0; i < numBuckets; ++i) {
+    profile.cycleHistogram.push_back(
+        buckets_[i].load(std::memory_order_relaxed));
+  }
+  return profile;
+}
+
+void BcmSdkCallStats::clear() {
+  calls_.store(0, std::memory_order_relaxed);
+  totalCycles_.store(0, std::memory_order_relaxed);
+  maxCycles_.store(0, std::memory_order_relaxed);
+  for (auto& bucket : buckets_) {
+    bucket.store(0, std::memory_order_relaxed);
+  }
+}
+
+void BcmSdkCallProfiler::setEnabled(bool enabled) {
+  auto& window = getWindow();
+  std::lock_guard<std::mutex> g(window.lock);
+  if (enabled == isEnabled()) {
+    return;
+  }
+  if (enabled) {
+    for (auto* stats = head_; stats; stats = stats->getNext()) {
+      stats->clear();
+    }
+    window.startTime = std::chrono::steady_clock::now();
+    window.startCycles = readCycles();
+  } else {
+    window.endTime = std::chrono::steady_clock::now();
+    window.endCycles = readCycles();
+  }
+  enabled_.store(enabled, std::memory_order_relaxed);
+}
+
+std::vector<SdkCallProfile> BcmSdkCallProfiler::getProfile() {
+  double cyclesPerUsec = 0;
+  {
+    auto& window = getWindow();
+    std::lock_guard<std::mutex> g(window.lock);
+    auto endTime = window.endTime;
+    auto endCycles = window.endCycles;
+    if (isEnabled()) {
+      endTime = std::chrono::steady_clock::now();
+      endCycles = readCycles();
+    }
+    auto usecs = std::chrono::duration_cast<std::chrono::microseconds>(
+        endTime - window.startTime).count();
+    if (usecs > 0) {
+      cyclesPerUsec = double(endCycles - window.startCycles) / usecs;
+    }
+  }
+
+  std::vector<SdkCallProfile> profiles;
+  for (auto* stats = head_; stats; stats = stats->getNext()) {
+    auto profile = stats->getProfile();
+    if (profile.calls == 0) {
+      continue;
+    }
+    profile.cyclesPerUsec = cyclesPerUsec;
+    profiles.push_back(std::move(profile));
+  }
+  return profiles;
+}
+
+}} // facebook::fboss
@@ -0,0 +1,128 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#pragma once
+
+#include "fboss/agent/if/gen-cpp2/ctrl_types.h"
+
+#if defined(__x86_64__)
+#include <x86intrin.h>
+#endif
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <vector>
+
+namespace facebook { namespace fboss {
+
+/*
+ * The call count and latency histogram of one SDK function.
+ *
+ * The tracing shim generated by the bcm_wrapper code generator (see
+ * HeaderToThrift --tracing-shim) has one of these per function it wraps, at
+ * namespace scope, and they register themselves with BcmSdkCallProfiler
+ * during static initialization.
+ */
+class BcmSdkCallStats {
+ public:
+  // Calls of [2^i, 2^(i+1)) cycles are counted in bucket i
+  static constexpr size_t kNumBuckets = 40;
+
+  explicit BcmSdkCallStats(const char* function);
+
+  void record(uint64_t cycles);
+  SdkCallProfile getProfile() const;
+  void clear();
+
+  const char* getFunction() const {
+    return function_;
+  }
+  BcmSdkCallStats* getNext() const {
+    return next_;
+  }
+
+ private:
+  // Forbidden copy constructor and assignment operator
+  BcmSdkCallStats(BcmSdkCallStats const &) = delete;
+  BcmSdkCallStats& operator=(BcmSdkCallStats const &) = delete;
+
+  const char* function_{nullptr};
+  BcmSdkCallStats* next_{nullptr};
+  std::atomic<uint64_t> calls_{0};
+  std::atomic<uint64_t> totalCycles_{0};
+  std::atomic<uint64_t> maxCycles_{0};
+  std::array<std::atomic<uint64_t>, kNumBuckets> buckets_{};
+};
+
+/*
+ * BcmSdkCallProfiler collects the BcmSdkCallStats of every wrapped SDK
+ * function, and turns their timing on and off at run time.  While off, a
+ * wrapped call costs a relaxed load of the enabled flag.
+ */
+class BcmSdkCallProfiler {
+ public:
+  // If any SDK function is wrapped, so that there is something to profile
+  static bool isAvailable() {
+    return head_ != nullptr;
+  }
+  static bool isEnabled() {
+    return enabled_.load(std::memory_order_relaxed);
+  }
+  /*
+   * Enabling profiling clears the stats, and starts the window that
+   * cycles are converted to time over.
+   */
+  static void setEnabled(bool enabled);
+  // The functions that were called while profiling was on
+  static std::vector<SdkCallProfile> getProfile();
+
+  // The TSC where there is one, and otherwise the steady clock in ns
+  static uint64_t readCycles() {
+#if defined(__x86_64__)
+    return __rdtsc();
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+  }
+
+ private:
+  friend class BcmSdkCallStats;
+
+  // All the stats, linked through BcmSdkCallStats::next_
+  static BcmSdkCallStats* head_;
+  static std::atomic<bool> enabled_;
+};
+
+/*
+ * Times the scope it is in, the body of a wrapped SDK function, if
+ * profiling is on when it starts.
+ */
+class BcmSdkCallTimer {
+ public:
+  explicit BcmSdkCallTimer(BcmSdkCallStats* stats)
+      : stats_(BcmSdkCallProfiler::isEnabled() ? stats : nullptr),
+        start_(stats_ ? BcmSdkCallProfiler::readCycles() : 0) {}
+  ~BcmSdkCallTimer() {
+    if (stats_) {
+      stats_->record(BcmSdkCallProfiler::readCycles() - start_);
+    }
+  }
+
+ private:
+  // Forbidden copy constructor and assignment operator
+  BcmSdkCallTimer(BcmSdkCallTimer const &) = delete;
+  BcmSdkCallTimer& operator=(BcmSdkCallTimer const &) = delete;
+
+  BcmSdkCallStats* stats_{nullptr};
+  uint64_t start_{0};
+};
+
+}} // facebook::fboss
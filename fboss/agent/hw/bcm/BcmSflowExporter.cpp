@@ -9,22 +9,34 @@
  */
 #include "BcmSflowExporter.h"
 
+#include <algorithm>
 #include <fstream>
 #include <iostream>
 #include <vector>
 
 #include <fcntl.h>
 #include <ifaddrs.h>
+#include <sys/socket.h>
 
 #include <folly/Optional.h>
 #include <folly/Range.h>
+#include <folly/ScopeGuard.h>
+#include <folly/ThreadName.h>
 #include <folly/logging/xlog.h>
+#include <gflags/gflags.h>
 #include <glog/logging.h>
 
 #include <thrift/lib/cpp2/protocol/Serializer.h>
 
 #include "fboss/agent/FbossError.h"
+#include "fboss/agent/hw/bcm/BcmStats.h"
 
+DEFINE_int32(sflow_export_queue_size, 4096,
+             "The most sFlow samples to queue for export before dropping "
+             "them");
+DEFINE_int32(sflow_export_batch_size, 32,
+             "The most sFlow samples to send to a collector with one "
+             "system call");
 
 using namespace std;
 
@@ -106,8 +118,12 @@ folly::IPAddress getLocalIPv6() {
 namespace facebook {
 namespace fboss {
 
-BcmSflowExporter::BcmSflowExporter(const folly::SocketAddress& address)
+BcmSflowExporter::BcmSflowExporter(
+    const folly::SocketAddress& address,
+    uint32_t maxSamplesPerSec)
     : address_(address) {
+  setMaxSamplesPerSec(maxSamplesPerSec);
+
   SCOPE_FAIL {
     close(socket_);
   };
@@ -188,26 +204,93 @@ ssize_t BcmSflowExporter::sendUDPDatagram(iovec* vec, const size_t iovec_len) {
   return ret;
 }
 
+size_t BcmSflowExporter::sendUDPDatagrams(std::vector<iovec>& datagrams) {
+  size_t allowed = datagrams.size();
+  if (rateLimit_) {
+    allowed = 0;
+    while (allowed < datagrams.size() && rateLimit_->consume(1)) {
+      ++allowed;
+    }
+    if (allowed < datagrams.size()) {
+      BcmStats::get()->sflowSamplesRateLimited(datagrams.size() - allowed);
+    }
+  }
+
+  sockaddr_storage addrStorage;
+  address_.getAddress(&addrStorage);
+
+  std::vector<mmsghdr> msgs(allowed);
+  for (size_t i = 0; i < allowed; ++i) {
+    auto& msg = msgs[i].msg_hdr;
+    msg.msg_name = reinterpret_cast<void*>(&addrStorage);
+    msg.msg_namelen = address_.getActualSize();
+    msg.msg_iov = &datagrams[i];
+    msg.msg_iovlen = 1;
+  }
+
+  size_t sent = 0;
+  while (sent < allowed) {
+    auto ret = ::sendmmsg(socket_, &msgs[sent], allowed - sent, 0);
+    if (ret < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      XLOG(DBG1) << "Failed sending " << allowed - sent
+                 << " sFlow packets to " << address_.describe()
+                 << " reason: " << folly::errnoStr(errno);
+      break;
+    }
+    sent += ret;
+  }
+  XLOG(DBG4) << "Sent " << sent << " sFlow packets to "
+             << address_.describe();
+  return sent;
+}
+
+void BcmSflowExporter::setMaxSamplesPerSec(uint32_t maxSamplesPerSec) {
+  if (maxSamplesPerSec == 0) {
+    rateLimit_.reset();
+  } else {
+    // Allow up to a second's worth of samples in a burst
+    rateLimit_ = std::make_unique<folly::TokenBucket>(
+        maxSamplesPerSec, maxSamplesPerSec);
+  }
+}
+
 BcmSflowExporter::~BcmSflowExporter() {
   if (socket_ != -1) {
     close(socket_);
   }
 }
 
+BcmSflowExporterTable::BcmSflowExporterTable()
+    : samples_(FLAGS_sflow_export_queue_size),
+      exportThread_([this] { exportSamples(); }) {}
+
+BcmSflowExporterTable::~BcmSflowExporterTable() {
+  samples_.blockingWrite(nullptr);
+  exportThread_.join();
+}
+
 bool BcmSflowExporterTable::contains(
     const shared_ptr<SflowCollector>& c) const {
+  std::lock_guard<std::mutex> g(lock_);
   auto iter = map_.find(c->getID());
   return iter != map_.end();
 }
 
 size_t BcmSflowExporterTable::size() const {
+  std::lock_guard<std::mutex> g(lock_);
   return map_.size();
 }
 
 void BcmSflowExporterTable::addExporter(const shared_ptr<SflowCollector>& c) {
   try {
-    auto exporter = make_unique<BcmSflowExporter>(c->getAddress());
+    auto exporter = make_unique<BcmSflowExporter>(
+        c->getAddress(), c->getMaxSamplesPerSec());
+    std::lock_guard<std::mutex> g(lock_);
     map_.emplace(c->getID(), move(exporter));
+    numExporters_ = map_.size();
   } catch (const fboss::thrift::FbossBaseError& ex) {
     XLOG(ERR) << "Could not add exporter: "
               << c->getAddress().getFullyQualified()
@@ -219,9 +302,30 @@ void BcmSflowExporterTable::addExporter(const shared_ptr<SflowCollector>& c) {
              << c->getAddress().getFullyQualified();
 }
 
+void BcmSflowExporterTable::updateExporter(
+    const shared_ptr<SflowCollector>& c) {
+  {
+    std::lock_guard<std::mutex> g(lock_);
+    auto iter = map_.find(c->getID());
+    if (iter != map_.end()) {
+      iter->second->setMaxSamplesPerSec(c->getMaxSamplesPerSec());
+      XLOG(INFO) << "Updated sFlow exporter " << c->getID() << " to at most "
+                 << c->getMaxSamplesPerSec() << " samples per second";
+      return;
+    }
+  }
+  // The exporter fails to be added if its socket can't be opened, so try
+  // again rather than failing the state update
+  XLOG(WARNING) << "No sFlow exporter " << c->getID() << " to update, "
+                << "adding it";
+  addExporter(c);
+}
+
 void BcmSflowExporterTable::removeExporter(const std::string& id) {
   XLOG(INFO) << "Removed sFlow exporter " << id;
+  std::lock_guard<std::mutex> g(lock_);
   map_.erase(id);
+  numExporters_ = map_.size();
 }
 
 void BcmSflowExporterTable::updateSamplingRates(
@@ -241,29 +345,60 @@ void BcmSflowExporterTable::updateSamplingRates(
 }
 
 void BcmSflowExporterTable::sendToAll(const SflowPacketInfo& info) {
-  if (map_.empty()) {
+  if (numExporters_ == 0) {
     XLOG(DBG1)
         << "zero sFlow collectors with sflow enabled, skipping sample export";
     return;
   }
-  // Serialize info to a string and wrap it in an IOBuf for sending
-  string output;
-  apache::thrift::BinarySerializer::serialize(info, &output);
-  auto buf = folly::IOBuf::wrapBuffer(output.data(), output.length());
-
-  // Map the IOBuf to a Linux iovec like a champ
-  iovec vec[16] = {};
-  size_t iovec_len = buf->fillIov(vec, sizeof(vec) / sizeof(vec[0]));
-  if (UNLIKELY(iovec_len == 0)) {
-    buf->coalesce();
-    vec[0].iov_base = const_cast<uint8_t*>(buf->data());
-    vec[0].iov_len = buf->length();
-    iovec_len = 1;
+  auto output = std::make_shared<string>();
+  apache::thrift::BinarySerializer::serialize(info, output.get());
+  if (!samples_.write(std::move(output))) {
+    BcmStats::get()->sflowSampleDropped();
+  }
+}
+
+void BcmSflowExporterTable::exportSamples() {
+  folly::setThreadName("sFlowExport");
+  const size_t batchSize = std::max(FLAGS_sflow_export_batch_size, 1);
+  std::vector<Sample> batch;
+  batch.reserve(batchSize);
+  while (true) {
+    Sample sample;
+    samples_.blockingRead(sample);
+    if (!sample) {
+      return;
+    }
+    batch.push_back(std::move(sample));
+    bool stop = false;
+    while (batch.size() < batchSize &&
+           samples_.read(sample)) {
+      if (!sample) {
+        stop = true;
+        break;
+      }
+      batch.push_back(std::move(sample));
+    }
+    BcmStats::get()->sflowBatchExported(
+        batch.size(), std::max<ssize_t>(samples_.size(), 0));
+    sendBatch(batch);
+    batch.clear();
+    if (stop) {
+      return;
+    }
+  }
+}
+
+void BcmSflowExporterTable::sendBatch(const std::vector<Sample>& batch) {
+  std::vector<iovec> datagrams;
+  datagrams.reserve(batch.size());
+  for (const auto& sample : batch) {
+    datagrams.push_back(
+        {const_cast<char*>(sample->data()), sample->length()});
   }
 
-  for (const auto& c: map_) {
-    // TODO: prob need to handle ret code?
-    c.second->sendUDPDatagram(vec, iovec_len);
+  std::lock_guard<std::mutex> g(lock_);
+  for (const auto& c : map_) {
+    c.second->sendUDPDatagrams(datagrams);
   }
 }
 
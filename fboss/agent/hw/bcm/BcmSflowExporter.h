@@ -9,10 +9,17 @@
  */
 #pragma once
 
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <thread>
 #include <unordered_map>
+#include <vector>
 
 #include <folly/IPAddress.h>
+#include <folly/MPMCQueue.h>
 #include <folly/SocketAddress.h>
+#include <folly/TokenBucket.h>
 
 #include "fboss/agent/if/gen-cpp2/sflow_types.h"
 #include "fboss/agent/state/SflowCollector.h"
@@ -26,16 +33,28 @@ class BcmSflowExporter {
   /*
    * Constructor for an sFlow collector.
    *
-   * @param[in] address    IP:port of the collector.
+   * @param[in] address           IP:port of the collector.
+   * @param[in] maxSamplesPerSec  The most samples a second to send, 0 for
+   *                              no limit.
    */
-  explicit BcmSflowExporter(const folly::SocketAddress& address);
+  explicit BcmSflowExporter(
+      const folly::SocketAddress& address,
+      uint32_t maxSamplesPerSec = 0);
   ~BcmSflowExporter();
 
+  void setMaxSamplesPerSec(uint32_t maxSamplesPerSec);
+
   /*
    * Send out the data in vec using UDP.  Called after init().
    */
   ssize_t sendUDPDatagram(iovec* vec, const size_t iovec_len);
 
+  /*
+   * Send each of the datagrams, as far as the rate limit allows, with as few
+   * system calls as possible.  Returns how many were sent.
+   */
+  size_t sendUDPDatagrams(std::vector<iovec>& datagrams);
+
  private:
   // no copy or assignment
   BcmSflowExporter(BcmSflowExporter const &) = delete;
@@ -43,32 +62,58 @@ class BcmSflowExporter {
 
   const folly::SocketAddress address_;
   int socket_{-1};
+  // Null if there is no rate limit
+  std::unique_ptr<folly::TokenBucket> rateLimit_;
 };
 
+/*
+ * BcmSflowExporterTable exports the sFlow samples to every collector.
+ *
+ * Samples are serialized as they are received, and queued to a thread of
+ * our own that sends them, so that the RX thread never waits on a socket.
+ * The export thread takes as many samples as are queued, up to a batch,
+ * and sends the batch to each collector with one system call.  A sample
+ * that finds the queue full is dropped.
+ */
 class BcmSflowExporterTable {
   public:
-    BcmSflowExporterTable() = default;
-    ~BcmSflowExporterTable() = default;
+    BcmSflowExporterTable();
+    ~BcmSflowExporterTable();
 
     bool contains(const std::shared_ptr<SflowCollector>& collector) const;
     size_t size() const;
     void addExporter(const std::shared_ptr<SflowCollector>& collector);
+    void updateExporter(const std::shared_ptr<SflowCollector>& collector);
     void removeExporter(const std::string& ID);
 
     void updateSamplingRates(PortID id, int64_t inRate, int64_t outRate);
 
     void sendToAll(const SflowPacketInfo& info);
   private:
+    // A serialized sample, or null to stop the export thread
+    using Sample = std::shared_ptr<const std::string>;
+
     // no copy or assignment
     BcmSflowExporterTable(BcmSflowExporterTable const &) = delete;
     BcmSflowExporterTable& operator=(BcmSflowExporterTable const &) = delete;
 
+    void exportSamples();
+    void sendBatch(const std::vector<Sample>& batch);
+
+    // Protects map_, which the export thread reads while the update thread
+    // adds and removes exporters
+    mutable std::mutex lock_;
     std::unordered_map<std::string, std::unique_ptr<BcmSflowExporter>> map_;
+    // The size of map_, to check for no exporters without the lock
+    std::atomic<size_t> numExporters_{0};
     std::unordered_map<
         PortID,
         std::pair<int64_t /* ingress rate */, int64_t /* egress rate */>>
         port2samplingRates_;
     folly::IPAddress localIP_;
+
+    folly::MPMCQueue<Sample> samples_;
+    std::thread exportThread_;
 };
 
 } // namespace fboss
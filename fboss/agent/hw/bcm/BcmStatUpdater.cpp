@@ -11,8 +11,10 @@
 #include "fboss/agent/hw/bcm/BcmSwitch.h"
 #include "fboss/agent/hw/bcm/BcmAclStat.h"
 #include "fboss/agent/hw/bcm/Utils.h"
+#include "fboss/agent/SwitchStats.h"
 
 #include <boost/container/flat_map.hpp>
+#include <folly/Conv.h>
 
 namespace facebook { namespace fboss {
 
@@ -20,9 +22,22 @@ using std::chrono::duration_cast;
 using std::chrono::seconds;
 using std::chrono::system_clock;
 
+namespace {
+
+std::string routeCounterName(RouteClassID classID, folly::StringPiece kind) {
+  return folly::to<std::string>(
+      SwitchStats::kCounterPrefix, "bcm.route_class.", classID, ".", kind);
+}
+
+} // unnamed namespace
+
 BcmStatUpdater::BcmStatUpdater(int unit)
   : unit_(unit) {}
 
+BcmStatUpdater::RouteCounterStats::RouteCounterStats(RouteClassID classID)
+  : packets(routeCounterName(classID, "packets"), stats::SUM, stats::RATE),
+    bytes(routeCounterName(classID, "bytes"), stats::SUM, stats::RATE) {}
+
 void BcmStatUpdater::toBeAddedAclStat(BcmAclStatHandle handle,
   const std::string& name) {
   toBeAddedAclStats_.emplace(handle, name);
@@ -32,7 +47,21 @@ void BcmStatUpdater::toBeRemovedAclStat(BcmAclStatHandle handle) {
   toBeRemovedAclStats_.emplace(handle);
 }
 
+void BcmStatUpdater::toBeAddedRouteCounter(BcmRouteCounterHandle handle,
+  RouteClassID classID) {
+  toBeAddedRouteCounters_.emplace(handle, classID);
+}
+
+void BcmStatUpdater::toBeRemovedRouteCounter(BcmRouteCounterHandle handle) {
+  toBeRemovedRouteCounters_.emplace(handle);
+}
+
 void BcmStatUpdater::refresh() {
+  refreshAclStats();
+  refreshRouteCounters();
+}
+
+void BcmStatUpdater::refreshAclStats() {
   if (toBeRemovedAclStats_.empty() && toBeAddedAclStats_.empty()) {
     return;
   }
@@ -61,18 +90,56 @@ void BcmStatUpdater::refresh() {
   }
 }
 
+void BcmStatUpdater::refreshRouteCounters() {
+  if (toBeRemovedRouteCounters_.empty() && toBeAddedRouteCounters_.empty()) {
+    return;
+  }
+
+  auto lockedRouteCounters = routeCounters_.wlock();
+
+  while (!toBeRemovedRouteCounters_.empty()) {
+    BcmRouteCounterHandle handle = toBeRemovedRouteCounters_.front();
+    auto erased = lockedRouteCounters->erase(handle);
+    if (!erased) {
+      throw FbossError("Trying to remove non-existent route counter, handle=",
+                       handle);
+    }
+    toBeRemovedRouteCounters_.pop();
+  }
+
+  while (!toBeAddedRouteCounters_.empty()) {
+    BcmRouteCounterHandle handle = toBeAddedRouteCounters_.front().first;
+    auto classID = toBeAddedRouteCounters_.front().second;
+    auto inserted = lockedRouteCounters->emplace(handle,
+      std::make_unique<RouteCounterStats>(classID));
+    if (!inserted.second) {
+      throw FbossError("Duplicate route counter handle, handle=", handle,
+                       ", class=", classID);
+    }
+    toBeAddedRouteCounters_.pop();
+  }
+}
+
 void BcmStatUpdater::updateStats() {
   auto now = duration_cast<seconds>(system_clock::now().time_since_epoch());
   auto lockedAclStats = aclStats_.wlock();
   for (auto& entry : *lockedAclStats) {
     updateAclStat(unit_, entry.first, now, entry.second.get());
   }
+  auto lockedRouteCounters = routeCounters_.wlock();
+  for (auto& entry : *lockedRouteCounters) {
+    updateRouteCounter(unit_, entry.first, now, entry.second.get());
+  }
 }
 
 size_t BcmStatUpdater::getCounterCount() const {
   return aclStats_.rlock()->size();
 }
 
+size_t BcmStatUpdater::getRouteCounterCount() const {
+  return routeCounters_.rlock()->size();
+}
+
 MonotonicCounter* FOLLY_NULLABLE BcmStatUpdater::getCounterIf(
   BcmAclStatHandle handle) {
   auto lockedAclStats = aclStats_.rlock();
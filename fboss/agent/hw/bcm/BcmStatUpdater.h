@@ -25,6 +25,7 @@ class BcmSwitch;
 class BcmStatUpdater {
  public:
   using BcmAclStatHandle = int;
+  using BcmRouteCounterHandle = int;
 
   explicit BcmStatUpdater(int unit);
   ~BcmStatUpdater() {}
@@ -48,18 +49,33 @@ class BcmStatUpdater {
 
   MonotonicCounter* getCounterIf(BcmAclStatHandle handle);
   size_t getCounterCount() const;
+  size_t getRouteCounterCount() const;
 
   /* Functions to be called during state update */
   void toBeAddedAclStat(BcmAclStatHandle handle, const std::string& name);
   void toBeRemovedAclStat(BcmAclStatHandle handle);
+  void toBeAddedRouteCounter(BcmRouteCounterHandle handle,
+                             RouteClassID classID);
+  void toBeRemovedRouteCounter(BcmRouteCounterHandle handle);
   void refresh();
 
   /* Functions to be called during stats collection (UpdateStatsThread) */
   void updateStats();
 
  private:
+  // The traffic forwarded by the routes of one class
+  struct RouteCounterStats {
+    explicit RouteCounterStats(RouteClassID classID);
+    MonotonicCounter packets;
+    MonotonicCounter bytes;
+  };
+
   void updateAclStat(int unit, BcmAclStatHandle handle,
     std::chrono::seconds now, MonotonicCounter* counter);
+  void updateRouteCounter(int unit, BcmRouteCounterHandle handle,
+    std::chrono::seconds now, RouteCounterStats* stats);
+  void refreshAclStats();
+  void refreshRouteCounters();
 
   int unit_;
 
@@ -68,6 +84,13 @@ class BcmStatUpdater {
   std::queue<std::pair<BcmAclStatHandle, std::string>> toBeAddedAclStats_;
   folly::Synchronized<boost::container::flat_map<BcmAclStatHandle,
     std::unique_ptr<MonotonicCounter>>> aclStats_;
+
+  /* Route class counters */
+  std::queue<BcmRouteCounterHandle> toBeRemovedRouteCounters_;
+  std::queue<std::pair<BcmRouteCounterHandle, RouteClassID>>
+    toBeAddedRouteCounters_;
+  folly::Synchronized<boost::container::flat_map<BcmRouteCounterHandle,
+    std::unique_ptr<RouteCounterStats>>> routeCounters_;
 };
 
 }} // facebook::fboss
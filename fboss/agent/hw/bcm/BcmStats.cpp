@@ -12,7 +12,10 @@
 #include "fboss/agent/SwitchStats.h"
 #include "common/stats/ExportedStatMapImpl.h"
 
+#include <folly/Conv.h>
+
 using facebook::stats::SUM;
+using facebook::stats::AVG;
 using facebook::stats::RATE;
 
 namespace facebook { namespace fboss {
@@ -30,16 +33,74 @@ BcmStats::BcmStats(ThreadLocalStatsMap *map)
                  SUM, RATE),
       txSent_(map, SwitchStats::kCounterPrefix + "bcm.tx.pkt.sent",
               SUM, RATE),
+      txBatches_(map, SwitchStats::kCounterPrefix + "bcm.tx.pkt.batches",
+                 SUM, RATE),
       txSentDone_(map, SwitchStats::kCounterPrefix + "bcm.tx.pkt.sent.done",
                   SUM, RATE),
       txErrors_(map, SwitchStats::kCounterPrefix + "bcm.tx.errors",
                   SUM, RATE),
       txPktAllocErrors_(map, SwitchStats::kCounterPrefix +
           "bcm.tx.pkt.allocation.errors", SUM, RATE),
+      txPktPoolHits_(map, SwitchStats::kCounterPrefix +
+          "bcm.tx.pkt.pool.hits", SUM, RATE),
+      txPktPoolMisses_(map, SwitchStats::kCounterPrefix +
+          "bcm.tx.pkt.pool.misses", SUM, RATE),
+      txPktPoolExhausted_(map, SwitchStats::kCounterPrefix +
+          "bcm.tx.pkt.pool.exhausted", SUM, RATE),
       txQueued_(map, SwitchStats::kCounterPrefix + "bcm.tx.pkt.queued_us",
-                100, 0, 1000),
+                100, 0, 10000),
       parityErrors_(map, SwitchStats::kCounterPrefix + "bcm.parity.errors",
-                    SUM, RATE) {
+                    SUM, RATE),
+      routesProgrammed_(map,
+                        SwitchStats::kCounterPrefix + "bcm.route.programmed",
+                        SUM, RATE),
+      routesDeleted_(map, SwitchStats::kCounterPrefix + "bcm.route.deleted",
+                     SUM, RATE),
+      nextHopGroupsPreprogrammed_(map, SwitchStats::kCounterPrefix +
+                                  "bcm.route.nexthop_groups_preprogrammed",
+                                  SUM, RATE),
+      nextHopGroupPreprogramLatency_(map, SwitchStats::kCounterPrefix +
+          "bcm.route.nexthop_group_preprogram.us", 1000, 0, 100000),
+      ecmpShrunk_(map, SwitchStats::kCounterPrefix +
+                  "bcm.link_down.ecmp_shrunk", SUM, RATE),
+      ecmpShrinkLatency_(map, SwitchStats::kCounterPrefix +
+          "bcm.link_down.ecmp_shrink.us", 100, 0, 10000),
+      ecmpEgressCacheHits_(map, SwitchStats::kCounterPrefix +
+                           "bcm.ecmp_egress_cache.hits", SUM, RATE),
+      ecmpEgressCacheMisses_(map, SwitchStats::kCounterPrefix +
+                             "bcm.ecmp_egress_cache.misses", SUM, RATE),
+      tableOverflowRejected_(map, SwitchStats::kCounterPrefix +
+                             "bcm.table_overflow.rejected", SUM, RATE),
+      routeProgramRate_(map, SwitchStats::kCounterPrefix +
+          "bcm.route.programmed_per_sec", 10000, 0, 1000000),
+      routePartitionSpeedup_(map, SwitchStats::kCounterPrefix +
+          "bcm.route.partition_speedup_pct", 10, 0, 1000),
+      statsCollection_(map, SwitchStats::kCounterPrefix +
+          "bcm.stats.collection.us", 1000, 0, 100000),
+      portStatsRead_(map, SwitchStats::kCounterPrefix +
+          "bcm.stats.port_read.us", 1000, 0, 100000),
+      sflowSamplesDropped_(map, SwitchStats::kCounterPrefix +
+                           "bcm.sflow.samples.dropped", SUM, RATE),
+      sflowSamplesRateLimited_(map, SwitchStats::kCounterPrefix +
+                               "bcm.sflow.samples.rate_limited", SUM, RATE),
+      sflowBatchSize_(map, SwitchStats::kCounterPrefix +
+          "bcm.sflow.batch_size", 4, 0, 256),
+      sflowQueueDepth_(map, SwitchStats::kCounterPrefix +
+          "bcm.sflow.queue_depth", 64, 0, 16384),
+      statsMap_(map) {
+}
+
+void BcmStats::unitStateUpdated(int unit, std::chrono::microseconds us) {
+  auto& histogram = unitStateUpdate_[unit];
+  if (!histogram) {
+    histogram = std::make_unique<TLHistogram>(
+        statsMap_,
+        folly::to<std::string>(
+            SwitchStats::kCounterPrefix, "bcm.unit.", unit,
+            ".state_update.us"),
+        10000, 0, 1000000, AVG, 50, 99);
+  }
+  histogram->addValue(us.count());
 }
 
 BcmStats* BcmStats::createThreadStats() {
@@ -12,6 +12,10 @@
 #include "common/stats/ThreadCachedServiceData.h"
 #include <folly/ThreadLocal.h>
 
+#include <chrono>
+#include <map>
+#include <memory>
+
 namespace facebook { namespace fboss {
 
 class BcmStats {
@@ -41,6 +45,10 @@ class BcmStats {
   void txSent() {
     txSent_.addValue(1);
   }
+  void txBatchSent(uint64_t pkts) {
+    txSent_.addValue(pkts);
+    txBatches_.addValue(1);
+  }
   void txSentDone(uint64_t q) {
     txSentDone_.addValue(1);
     txQueued_.addValue(q);
@@ -52,11 +60,107 @@ class BcmStats {
     txErrors_.addValue(1);
     txPktAllocErrors_.addValue(1);
   }
+  // A packet to send was taken from the TX packet pool, was bigger than
+  // any of its buffers, or found none of its size left.
+  void txPktPoolHit() {
+    txPktPoolHits_.addValue(1);
+  }
+  void txPktPoolMiss() {
+    txPktPoolMisses_.addValue(1);
+  }
+  void txPktPoolExhausted() {
+    txPktPoolMisses_.addValue(1);
+    txPktPoolExhausted_.addValue(1);
+  }
 
   void parityError() {
     parityErrors_.addValue(1);
   }
 
+  /*
+   * Record routes added or changed by one state update, and how long
+   * programming them took.
+   */
+  void routesProgrammed(uint64_t routes, std::chrono::microseconds us) {
+    routesProgrammed_.addValue(routes);
+    if (us.count() > 0) {
+      routeProgramRate_.addValue(routes * 1000000 / us.count());
+    }
+  }
+  void routesDeleted(uint64_t routes) {
+    routesDeleted_.addValue(routes);
+  }
+  /*
+   * Record the next hop groups created by one state update ahead of
+   * programming its routes, and how long it took.
+   */
+  void nextHopGroupsPreprogrammed(
+      uint64_t groups,
+      std::chrono::microseconds us) {
+    nextHopGroupsPreprogrammed_.addValue(groups);
+    nextHopGroupPreprogramLatency_.addValue(us.count());
+  }
+  /*
+   * Record the ECMP egress objects shrunk by the linkscan thread for a
+   * link down, and how long it took.
+   */
+  void ecmpShrunkOnLinkDown(uint64_t groups, std::chrono::microseconds us) {
+    ecmpShrunk_.addValue(groups);
+    ecmpShrinkLatency_.addValue(us.count());
+  }
+  // ECMP egress objects found in, or added to, the shared ECMP egress cache
+  void ecmpEgressCacheHit() {
+    ecmpEgressCacheHits_.addValue(1);
+  }
+  void ecmpEgressCacheMiss() {
+    ecmpEgressCacheMisses_.addValue(1);
+  }
+  void tableOverflowRejected() {
+    tableOverflowRejected_.addValue(1);
+  }
+  /*
+   * Record how long the route partitions of a state update took to program
+   * in all, against how long we waited for them, as a percentage: 100 when
+   * they are programmed one after another, more when in parallel.
+   */
+  void routePartitionsProgrammed(
+      std::chrono::microseconds busy,
+      std::chrono::microseconds elapsed) {
+    if (elapsed.count() > 0) {
+      routePartitionSpeedup_.addValue(busy.count() * 100 / elapsed.count());
+    }
+  }
+  /*
+   * Record how long one stats collection cycle took, and how long of it was
+   * spent reading the port counters when they are read in bulk.
+   */
+  void statsCollected(std::chrono::microseconds us) {
+    statsCollection_.addValue(us.count());
+  }
+  void portStatsRead(std::chrono::microseconds us) {
+    portStatsRead_.addValue(us.count());
+  }
+  /*
+   * sFlow samples dropped for a full export queue, or for a collector's
+   * rate limit, and the size of each batch sent along with how many samples
+   * were left queued behind it.
+   */
+  void sflowSampleDropped() {
+    sflowSamplesDropped_.addValue(1);
+  }
+  void sflowSamplesRateLimited(uint64_t n) {
+    sflowSamplesRateLimited_.addValue(n);
+  }
+  void sflowBatchExported(uint64_t batchSize, uint64_t queueDepth) {
+    sflowBatchSize_.addValue(batchSize);
+    sflowQueueDepth_.addValue(queueDepth);
+  }
+  /*
+   * Record how long one unit of a multi-unit system took to program a state
+   * update, from the thread that programs it.
+   */
+  void unitStateUpdated(int unit, std::chrono::microseconds us);
+
  private:
   // Forbidden copy constructor and assignment operator
   BcmStats(BcmStats const &) = delete;
@@ -76,17 +180,54 @@ class BcmStats {
   TLTimeseries txPktAlloc_;
   TLTimeseries txPktFree_;
   TLTimeseries txSent_;
+  TLTimeseries txBatches_;
   TLTimeseries txSentDone_;
   // Errors in sending packets
   TLTimeseries txErrors_;
   TLTimeseries txPktAllocErrors_;
+  TLTimeseries txPktPoolHits_;
+  TLTimeseries txPktPoolMisses_;
+  TLTimeseries txPktPoolExhausted_;
 
-  // Time spent for each Tx packet queued in HW
+  // Time from submitting each Tx packet to the SDK to its completion (us)
   TLHistogram txQueued_;
 
   // parity errors
   TLTimeseries parityErrors_;
 
+  // Routes added or changed, and deleted, in hardware
+  TLTimeseries routesProgrammed_;
+  TLTimeseries routesDeleted_;
+  // Next hop groups created ahead of their routes, and the time to do so
+  TLTimeseries nextHopGroupsPreprogrammed_;
+  TLHistogram nextHopGroupPreprogramLatency_;
+  // ECMP egress objects shrunk on link down, and the time to do so
+  TLTimeseries ecmpShrunk_;
+  TLHistogram ecmpShrinkLatency_;
+  // Lookups of the shared ECMP egress cache
+  TLTimeseries ecmpEgressCacheHits_;
+  TLTimeseries ecmpEgressCacheMisses_;
+  // State updates rejected for overflowing a hardware table
+  TLTimeseries tableOverflowRejected_;
+  // Routes per second programmed by each state update
+  TLHistogram routeProgramRate_;
+  // Speed-up of programming route partitions in parallel, in percent
+  TLHistogram routePartitionSpeedup_;
+  // Time taken by each stats collection cycle, and by the bulk port
+  // counter reads in it
+  TLHistogram statsCollection_;
+  TLHistogram portStatsRead_;
+  // sFlow samples dropped before export, and the export batches
+  TLTimeseries sflowSamplesDropped_;
+  TLTimeseries sflowSamplesRateLimited_;
+  TLHistogram sflowBatchSize_;
+  TLHistogram sflowQueueDepth_;
+  // Per unit histograms of the time taken to program a state update (us),
+  // created as units are first programmed
+  std::map<int, std::unique_ptr<TLHistogram>> unitStateUpdate_;
+
+  ThreadLocalStatsMap* statsMap_;
+
   static folly::ThreadLocalPtr<BcmStats> stats_;
 };
 
@@ -90,5 +90,13 @@ inline folly::StringPiece constexpr kOutCongestionDiscards() {
   return "out_congestion_discards";
 }
 
+inline folly::StringPiece constexpr kWredDroppedPackets() {
+  return "wred_dropped_packets";
+}
+
+inline folly::StringPiece constexpr kEcnMarkedPackets() {
+  return "ecn_marked_packets";
+}
+
 } // namespace fboss
 } // namespace facebook
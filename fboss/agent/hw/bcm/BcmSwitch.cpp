@@ -15,10 +15,16 @@
 #include <folly/FileUtil.h>
 #include <folly/Memory.h>
 #include <folly/Optional.h>
+#include <folly/ScopeGuard.h>
 #include <folly/hash/Hash.h>
 #include <folly/logging/xlog.h>
+#include "common/stats/ServiceData.h"
 #include "fboss/agent/Constants.h"
+#include "fboss/agent/EventTrace.h"
 #include "fboss/agent/FbossError.h"
+#include "fboss/agent/L2TableMirror.h"
+#include "fboss/agent/StartupProfiler.h"
+#include "fboss/agent/WarmBootTimeline.h"
 #include "fboss/agent/SwSwitch.h"
 #include "fboss/agent/SwitchStats.h"
 #include "fboss/agent/Utils.h"
@@ -32,22 +38,29 @@
 #include "fboss/agent/hw/bcm/BcmHost.h"
 #include "fboss/agent/hw/bcm/BcmHostKey.h"
 #include "fboss/agent/hw/bcm/BcmIntf.h"
+#include "fboss/agent/hw/bcm/BcmPacketTraceSampler.h"
 #include "fboss/agent/hw/bcm/BcmPlatform.h"
 #include "fboss/agent/hw/bcm/BcmPort.h"
 #include "fboss/agent/hw/bcm/BcmPortGroup.h"
 #include "fboss/agent/hw/bcm/BcmPortTable.h"
 #include "fboss/agent/hw/bcm/BcmRoute.h"
+#include "fboss/agent/hw/bcm/BcmRouteCounter.h"
 #include "fboss/agent/hw/bcm/BcmRxPacket.h"
+#include "fboss/agent/hw/bcm/BcmSdkCallProfiler.h"
+#include "fboss/agent/hw/bcm/BcmStats.h"
 #include "fboss/agent/hw/bcm/BcmSflowExporter.h"
 #include "fboss/agent/hw/bcm/BcmStatUpdater.h"
 #include "fboss/agent/hw/bcm/BcmSwitchEventCallback.h"
 #include "fboss/agent/hw/bcm/BcmSwitchEventUtils.h"
+#include "fboss/agent/hw/bcm/BcmTableCapacity.h"
 #include "fboss/agent/hw/bcm/BcmTableStats.h"
 #include "fboss/agent/hw/bcm/BcmTrunkTable.h"
 #include "fboss/agent/hw/bcm/BcmTxPacket.h"
+#include "fboss/agent/hw/bcm/BcmTxPacketPool.h"
 #include "fboss/agent/hw/bcm/BcmUnit.h"
 #include "fboss/agent/hw/bcm/BcmWarmBootCache.h"
 #include "fboss/agent/hw/bcm/BcmWarmBootHelper.h"
+#include "fboss/agent/hw/bcm/BcmWarmBootReconciler.h"
 #include "fboss/agent/state/AclEntry.h"
 #include "fboss/agent/state/AggregatePort.h"
 #include "fboss/agent/state/ArpEntry.h"
@@ -77,6 +90,7 @@
 #include "fboss/agent/types.h"
 
 extern "C" {
+#include <opennsl/l3.h>
 #include <opennsl/link.h>
 #include <opennsl/port.h>
 #include <opennsl/stg.h>
@@ -84,6 +98,8 @@ extern "C" {
 #include <opennsl/vlan.h>
 }
 
+#include <thread>
+
 using std::make_unique;
 using std::chrono::seconds;
 using std::chrono::duration_cast;
@@ -107,6 +123,37 @@ DEFINE_bool(flexports, false,
             "Load the agent with flexport support enabled");
 DEFINE_bool(enable_fine_grained_buffer_stats, false,
             "Enable fine grained buffer stats collection by default");
+DEFINE_int32(route_batch_min_size, 64,
+             "Program route changes in a batch when a state update has at "
+             "least this many of them in a VRF; 0 programs them one by one");
+DEFINE_bool(reject_table_overflow, true,
+            "Reject state updates that would overflow a hardware table, "
+            "rather than programming them until the table is full.  The "
+            "estimate errs on the side of more entries, so this may reject "
+            "updates that would just fit");
+DEFINE_bool(parallel_route_programming, false,
+            "Program batches of route changes in different VRFs and address "
+            "families on separate threads at once");
+DEFINE_bool(preprogram_nexthop_groups, true,
+            "Create the next hop groups of new and changed routes in a "
+            "state update before programming any of its routes");
+DEFINE_bool(fib_compression, false,
+            "Leave out of hardware the routes that forward the same as the "
+            "route covering them, and program route changes one at a time");
+DEFINE_bool(incremental_acl_programming, false,
+            "Only program the ACL entries that have to change to keep the "
+            "entries in order, rather than every entry whose priority "
+            "changed");
+DEFINE_bool(bulk_stats_collection, false,
+            "Read the counters of all ports in one pass, with one call per "
+            "port, before updating any of the exported port stats");
+DEFINE_int32(tx_pkt_pool_buffers, 32,
+             "Number of TX packets of each size to keep allocated for "
+             "sending packets, or 0 to allocate each packet from the SDK");
+DEFINE_bool(parallel_warm_boot_init, false,
+            "On warm boot, read back the warm boot cache, initialize the "
+            "ports and set up COS and linkscan in parallel, where they do "
+            "not depend on each other");
 enum : uint8_t {
   kRxCallbackPriority = 1,
 };
@@ -114,6 +161,9 @@ enum : uint8_t {
 namespace {
 constexpr auto kHostTable = "hostTable";
 constexpr int kLogBcmErrorFreqMs = 3000;
+// Sizes of the TX packet pool buffers: ARP, NDP, LACP and LLDP packets fit
+// in the smaller ones, ICMP errors with the packet they quote in 1536.
+const std::vector<uint32_t> kTxPktPoolSizes = {128, 512, 1536, 9216};
 /*
  * Dump map containing switch h/w config as a key, value pair
  * to a file. Create parent directories of file if needed.
@@ -141,6 +191,9 @@ void rethrowIfHwNotFull(const facebook::fboss::BcmError& error) {
 }
 
 namespace facebook { namespace fboss {
+
+constexpr int BcmSwitch::kOnlyDevice;
+
 /*
  * Get current port speed from BCM SDK and convert to
  * cfg::PortSpeed
@@ -154,8 +207,10 @@ bool BcmSwitch::getPortFECConfig(PortID port) const {
 BcmSwitch::BcmSwitch(
     BcmPlatform* platform,
     HashMode hashMode,
-    uint32_t featuresDesired)
+    uint32_t featuresDesired,
+    int deviceIndex)
     : platform_(platform),
+      deviceIndex_(deviceIndex),
       featuresDesired_(featuresDesired),
       hashMode_(hashMode),
       fineGrainedBufferStatsEnabled_(FLAGS_enable_fine_grained_buffer_stats),
@@ -164,13 +219,18 @@ BcmSwitch::BcmSwitch(
       warmBootCache_(new BcmWarmBootCache(this)),
       portTable_(new BcmPortTable(this)),
       intfTable_(new BcmIntfTable(this)),
+      routeCounterTable_(new BcmRouteCounterTable(this)),
       hostTable_(new BcmHostTable(this)),
       routeTable_(new BcmRouteTable(this)),
       aclTable_(new BcmAclTable(this)),
       bcmTableStats_(new BcmTableStats(this, isAlpmEnabled())),
-      bufferStatsLogger_(createBufferStatsLogger()),
+      tableCapacity_(new BcmTableCapacity(this)),
+      bufferStatsLogger_(std::make_unique<RecordingBufferStatsLogger>(
+          createBufferStatsLogger())),
       trunkTable_(new BcmTrunkTable(this)),
-      sFlowExporterTable_(new BcmSflowExporterTable()) {
+      sFlowExporterTable_(new BcmSflowExporterTable()),
+      packetTraceSampler_(new BcmPacketTraceSampler(this)),
+      l2Table_(new L2TableMirror()) {
   dumpConfigMap(BcmAPI::getHwConfig(), platform->getHwConfigDumpFile());
   exportSdkVersion();
 }
@@ -181,7 +241,11 @@ BcmSwitch::~BcmSwitch() {
 
 void BcmSwitch::resetTablesImpl(std::unique_lock<std::mutex>& /*lock*/) {
   unregisterCallbacks();
+  l2Table_->clear();
+  packetTraceSampler_->stop();
   routeTable_.reset();
+  routeCounterTable_.reset();
+  fibCompressors_.clear();
   // Release host entries before reseting switch's host table
   // entries so that if host try to refer to look up host table
   // via the BCM switch during their destruction the pointer
@@ -197,6 +261,7 @@ void BcmSwitch::resetTablesImpl(std::unique_lock<std::mutex>& /*lock*/) {
   bcmTableStats_.reset();
   trunkTable_.reset();
   controlPlane_.reset();
+  txPacketPool_.reset();
   coppAclEntries_.clear();
   // Reset warmboot cache last in case Bcm object destructors
   // access it during object deletion.
@@ -225,6 +290,7 @@ void BcmSwitch::initTables(const folly::dynamic& warmBootState) {
   std::lock_guard<std::mutex> g(lock_);
   portTable_ = std::make_unique<BcmPortTable>(this);
   intfTable_ = std::make_unique<BcmIntfTable>(this);
+  routeCounterTable_ = std::make_unique<BcmRouteCounterTable>(this);
   hostTable_ = std::make_unique<BcmHostTable>(this);
   routeTable_ = std::make_unique<BcmRouteTable>(this);
   aclTable_ = std::make_unique<BcmAclTable>(this);
@@ -248,6 +314,7 @@ void BcmSwitch::initTables(const folly::dynamic& warmBootState) {
   stateChangedImpl(
       StateDelta(make_shared<SwitchState>(), getWarmBootSwitchState()));
   setupLinkscan();
+  setupL2Learning();
   setupPacketRx();
 }
 
@@ -272,6 +339,10 @@ void BcmSwitch::unregisterCallbacks() {
     stopLinkscanThread();
     flags_ &= ~LINKSCAN_REGISTERED;
   }
+  if (flags_ & L2_REGISTERED) {
+    unregisterL2Callback();
+    flags_ &= ~L2_REGISTERED;
+  }
 }
 
 void BcmSwitch::ecmpHashSetup() {
@@ -505,7 +576,9 @@ HwInitResult BcmSwitch::init(Callback* callback) {
   std::lock_guard<std::mutex> g(lock_);
 
   CHECK(!unitObject_);
-  unitObject_ = BcmAPI::initOnlyUnit(platform_);
+  unitObject_ = deviceIndex_ == kOnlyDevice
+      ? BcmAPI::initOnlyUnit(platform_)
+      : BcmAPI::initUnit(deviceIndex_, platform_);
   unit_ = unitObject_->getNumber();
   platform_->onUnitCreate(unit_);
   unitObject_->setCookie(this);
@@ -517,10 +590,13 @@ HwInitResult BcmSwitch::init(Callback* callback) {
       ? BootType::WARM_BOOT
       : BootType::COLD_BOOT;
   auto warmBoot = bootType_ == BootType::WARM_BOOT;
-  if (warmBoot) {
-    unitObject_->warmBootAttach();
-  } else {
-    unitObject_->coldBootAttach();
+  {
+    StartupProfiler::Scope phase("bcm.attach");
+    if (warmBoot) {
+      unitObject_->warmBootAttach();
+    } else {
+      unitObject_->coldBootAttach();
+    }
   }
 
   platform_->onUnitAttach(unit_);
@@ -551,6 +627,11 @@ HwInitResult BcmSwitch::init(Callback* callback) {
   // Create bcmStatUpdater to cache the stat ids
   bcmStatUpdater_ = std::make_unique<BcmStatUpdater>(unit_);
 
+  if (FLAGS_tx_pkt_pool_buffers > 0) {
+    txPacketPool_ = std::make_unique<BcmTxPacketPool>(
+        unit_, kTxPktPoolSizes, FLAGS_tx_pkt_pool_buffers);
+  }
+
   // Additional switch configuration
   auto state = make_shared<SwitchState>();
   opennsl_port_config_t pcfg;
@@ -600,6 +681,7 @@ HwInitResult BcmSwitch::init(Callback* callback) {
   ecmpHashSetup();
 
   if (!warmBoot || haveMissingOrQSetChangedFPGroups()) {
+    StartupProfiler::Scope phase("bcm.field_processor");
     initFieldProcessor();
     setupFPGroups();
   }
@@ -621,31 +703,50 @@ HwInitResult BcmSwitch::init(Callback* callback) {
   // verify the drop egress ID is really dropping
   BcmEgress::verifyDropEgress(unit_);
 
+  // Reading back the warm boot cache and initializing the ports touch
+  // different tables, so on warm boot they can run side by side.
+  BcmWarmBootReconciler phases(warmBoot && FLAGS_parallel_warm_boot_init);
+  std::vector<std::string> cpuEgressDeps;
   if (warmBoot) {
     // This needs to be done after we have set
     // opennslSwitchL3EgressMode else the egress ids
     // in the host table don't show up correctly.
-    warmBootCache_->populate();
+    phases.addPhase("bcm.warm_boot_cache", {}, [this] {
+      warmBootCache_->populate();
+    });
+    cpuEgressDeps.push_back("bcm.warm_boot_cache");
   }
-  setupToCpuEgress();
-  portTable_->initPorts(&pcfg, warmBoot);
-
-  setupCos();
-  configureRxRateLimiting();
+  // Reuses the CPU egress found in the warm boot cache
+  phases.addPhase("bcm.cpu_egress", cpuEgressDeps, [this] {
+    setupToCpuEgress();
+  });
+  phases.addPhase("bcm.ports", {}, [&] {
+    portTable_->initPorts(&pcfg, warmBoot);
+  });
+  phases.addPhase("bcm.cos", {"bcm.ports"}, [this] {
+    setupCos();
+    configureRxRateLimiting();
+  });
+  phases.addPhase("bcm.linkscan", {"bcm.ports"}, [&] {
+    setupLinkscan();
+    // If warm booting, force a scan of all ports. Unfortunately
+    // opennsl_enable_set will enable all of the ports and return before
+    // the first loop on the link thread has updated the link status of
+    // ports. This will guarantee we have performed at least one scan of
+    // all ports before proceeding.
+    if (warmBoot) {
+      forceLinkscanOn(pcfg.port);
+    }
+  });
+  // After linkscan, which also sets flags_
+  phases.addPhase("bcm.l2", {"bcm.linkscan"}, [this] {
+    setupL2Learning();
+  });
+  phases.run();
   if (fineGrainedBufferStatsEnabled_) {
     startFineGrainedBufferStatLogging();
   }
 
-  setupLinkscan();
-  // If warm booting, force a scan of all ports. Unfortunately
-  // opennsl_enable_set will enable all of the ports and return before
-  // the first loop on the link thread has updated the link status of
-  // ports. This will guarantee we have performed at least one scan of
-  // all ports before proceeding.
-  if (warmBoot) {
-    forceLinkscanOn(pcfg.port);
-  }
-
   // Set the spanning tree state of all ports to forwarding.
   // TODO: Eventually the spanning tree state should be part of the Port
   // state, and this should be handled in applyConfig().
@@ -661,11 +762,15 @@ HwInitResult BcmSwitch::init(Callback* callback) {
   ret.bootType = bootType_;
 
   if (warmBoot) {
+    StartupProfiler::Scope phase("bcm.warm_boot_state");
     auto warmBootState = getWarmBootSwitchState();
     stateChangedImpl(StateDelta(make_shared<SwitchState>(), warmBootState));
     hostTable_->warmBootHostEntriesSynced();
+    WarmBootTimeline::get()->mark(
+        WarmBootTimeline::Event::HOST_ENTRIES_SYNCED);
     ret.switchState = warmBootState;
   } else {
+    StartupProfiler::Scope phase("bcm.cold_boot_state");
     ret.switchState = getColdBootSwitchState();
   }
 
@@ -714,6 +819,11 @@ void BcmSwitch::initialConfigApplied() {
 std::shared_ptr<SwitchState> BcmSwitch::stateChanged(const StateDelta& delta) {
   // Take the lock before modifying any objects
   std::lock_guard<std::mutex> g(lock_);
+  if (FLAGS_reject_table_overflow && !isValidTableUpdate(delta)) {
+    // Nothing has been programmed, so we are still at the old state
+    BcmStats::get()->tableOverflowRejected();
+    return delta.oldState();
+  }
   auto appliedState = stateChangedImpl(delta);
   appliedState->publish();
   bcmTableStats_->refresh();
@@ -777,6 +887,14 @@ std::shared_ptr<SwitchState> BcmSwitch::stateChangedImpl(
   // Any neighbor changes, and modify appliedState if some changes fail to apply
   processNeighborChanges(delta, &appliedState);
 
+  // Now that the interfaces and neighbors of the next hops are programmed,
+  // create the next hop groups routes are moving to, so that programming
+  // the routes later only repoints them
+  auto nextHopGroups = preprogramNextHopGroups(delta);
+  SCOPE_FAIL {
+    releaseNextHopGroups(&nextHopGroups);
+  };
+
   // Any ACL changes
   processAclChanges(delta);
 
@@ -788,6 +906,8 @@ std::shared_ptr<SwitchState> BcmSwitch::stateChangedImpl(
 
   // Process any new routes or route changes
   processAddedChangedRoutes(delta, &appliedState);
+  // The routes now reference their groups, groups no route took are freed
+  releaseNextHopGroups(&nextHopGroups);
 
   processAggregatePortChanges(delta);
 
@@ -806,6 +926,15 @@ std::shared_ptr<SwitchState> BcmSwitch::stateChangedImpl(
   // ingressVlan and speed correctly before enabling.
   processEnabledPorts(delta);
 
+  // Let the linkscan thread see the ECMP egress objects we changed
+  hostTable_->publishEcmpShrinkIndexHwLocked();
+
+  hostTable_->updateMemoryAccountHwLocked();
+  routeTable_->updateMemoryAccount();
+  if (warmBootCache_) {
+    warmBootCache_->updateMemoryAccount();
+  }
+
   return appliedState;
 }
 
@@ -820,6 +949,11 @@ unique_ptr<TxPacket> BcmSwitch::allocatePacket(uint32_t size) {
   // that supports multiple units.  Fortunately, the linux userspace
   // implemetation uses the same DMA pool for all local units, so it wouldn't
   // really matter which unit we specified when allocating the buffer.
+  if (txPacketPool_) {
+    if (auto* buffer = txPacketPool_->get(size)) {
+      return make_unique<BcmTxPacket>(buffer, size);
+    }
+  }
   return make_unique<BcmTxPacket>(unit_, size);
 }
 
@@ -845,6 +979,7 @@ void BcmSwitch::processEnabledPorts(const StateDelta& delta) {
 }
 
 void BcmSwitch::processChangedPorts(const StateDelta& delta) {
+  EventTrace::Scope trace(EventTrace::HwPhase::PORTS);
   forEachChanged(delta.getPortsDelta(),
     [&] (const shared_ptr<Port>& oldPort, const shared_ptr<Port>& newPort) {
       auto id = newPort->getID();
@@ -876,8 +1011,11 @@ void BcmSwitch::processChangedPorts(const StateDelta& delta) {
       auto fecChanged = oldPort->getFEC() != newPort->getFEC();
       XLOG_IF(DBG1, fecChanged) << "New FEC settings on port " << id;
 
+      auto bufferChanged = oldPort->getBuffer() != newPort->getBuffer();
+      XLOG_IF(DBG1, bufferChanged) << "New buffer settings on port " << id;
+
       if (speedChanged || vlanChanged || pauseChanged || sFlowChanged ||
-          fecChanged) {
+          fecChanged || bufferChanged) {
         bcmPort->program(newPort);
       }
 
@@ -996,57 +1134,87 @@ bool BcmSwitch::isValidStateUpdate(const StateDelta& delta) const {
           isValid = false;
       }
   });
+  if (isValid) {
+    std::lock_guard<std::mutex> g(lock_);
+    isValid = isValidTableUpdate(delta);
+  }
   return isValid;
 }
 
+bool BcmSwitch::isValidTableUpdate(const StateDelta& delta) const {
+  auto overflow = tableCapacity_->getOverflow(
+      delta, bcmTableStats_->getHwTableStats());
+  if (overflow) {
+    XLOG(ERR) << "State update would overflow the "
+              << BcmTableCapacity::getName(*overflow) << " table";
+    return false;
+  }
+  return true;
+}
+
 void BcmSwitch::changeDefaultVlan(VlanID id) {
   auto rv = opennsl_vlan_default_set(unit_, id);
   bcmCheckError(rv, "failed to set default VLAN to ", id);
 }
 
+void BcmSwitch::getVlanPortBitmaps(const Vlan& vlan,
+                                   opennsl_pbmp_t* allPorts,
+                                   opennsl_pbmp_t* untagged) const {
+  OPENNSL_PBMP_CLEAR(*allPorts);
+  OPENNSL_PBMP_CLEAR(*untagged);
+  for (const auto& entry : vlan.getPorts()) {
+    opennsl_port_t bcmPort = portTable_->getBcmPortId(entry.first);
+    OPENNSL_PBMP_PORT_ADD(*allPorts, bcmPort);
+    if (!entry.second.tagged) {
+      OPENNSL_PBMP_PORT_ADD(*untagged, bcmPort);
+    }
+  }
+}
+
 void BcmSwitch::processChangedVlan(const shared_ptr<Vlan>& oldVlan,
                                    const shared_ptr<Vlan>& newVlan) {
-  // Update port membership
-  opennsl_pbmp_t addedPorts;
-  OPENNSL_PBMP_CLEAR(addedPorts);
-  opennsl_pbmp_t addedUntaggedPorts;
-  OPENNSL_PBMP_CLEAR(addedUntaggedPorts);
-  opennsl_pbmp_t removedPorts;
-  OPENNSL_PBMP_CLEAR(removedPorts);
-  const auto& oldPorts = oldVlan->getPorts();
-  const auto& newPorts = newVlan->getPorts();
-
-  auto oldIter = oldPorts.begin();
-  auto newIter = newPorts.begin();
-  uint32_t numAdded{0};
-  uint32_t numRemoved{0};
-  while (oldIter != oldPorts.end() || newIter != newPorts.end()) {
-    LoopAction action = LoopAction::CONTINUE;
-    if (oldIter == oldPorts.end() ||
-        (newIter != newPorts.end() && newIter->first < oldIter->first)) {
-      // This port was added
-      ++numAdded;
-      opennsl_port_t bcmPort = portTable_->getBcmPortId(newIter->first);
-      OPENNSL_PBMP_PORT_ADD(addedPorts, bcmPort);
-      if (!newIter->second.tagged) {
-        OPENNSL_PBMP_PORT_ADD(addedUntaggedPorts, bcmPort);
-      }
-      ++newIter;
-    } else if (newIter == newPorts.end() ||
-        (oldIter != oldPorts.end() && oldIter->first < newIter->first)) {
-      // This port was removed
-      ++numRemoved;
-      opennsl_port_t bcmPort = portTable_->getBcmPortId(oldIter->first);
-      OPENNSL_PBMP_PORT_ADD(removedPorts, bcmPort);
-      ++oldIter;
-    } else {
-      ++oldIter;
-      ++newIter;
-    }
+  // Most VLAN changes are to its neighbor tables rather than its members
+  if (oldVlan->getPorts() == newVlan->getPorts()) {
+    return;
   }
+  // Diff the memberships a word of ports at a time
+  opennsl_pbmp_t oldPorts;
+  opennsl_pbmp_t oldUntagged;
+  getVlanPortBitmaps(*oldVlan, &oldPorts, &oldUntagged);
+  opennsl_pbmp_t newPorts;
+  opennsl_pbmp_t newUntagged;
+  getVlanPortBitmaps(*newVlan, &newPorts, &newUntagged);
+
+  // Ports that stay members but start or stop emitting tags are added
+  // again with their new tagging.  Adding a member updates its tagging in
+  // place, so it keeps forwarding throughout, which matters on warm boot.
+  opennsl_pbmp_t retaggedPorts;
+  OPENNSL_PBMP_ASSIGN(retaggedPorts, oldUntagged);
+  OPENNSL_PBMP_XOR(retaggedPorts, newUntagged);
+  OPENNSL_PBMP_AND(retaggedPorts, oldPorts);
+  OPENNSL_PBMP_AND(retaggedPorts, newPorts);
 
-  XLOG(DBG2) << "updating VLAN " << newVlan->getID() << ": " << numAdded
-             << " ports added, " << numRemoved << " ports removed";
+  opennsl_pbmp_t removedPorts;
+  OPENNSL_PBMP_ASSIGN(removedPorts, oldPorts);
+  OPENNSL_PBMP_REMOVE(removedPorts, newPorts);
+  opennsl_pbmp_t addedPorts;
+  OPENNSL_PBMP_ASSIGN(addedPorts, newPorts);
+  OPENNSL_PBMP_REMOVE(addedPorts, oldPorts);
+  OPENNSL_PBMP_OR(addedPorts, retaggedPorts);
+  opennsl_pbmp_t addedUntaggedPorts;
+  OPENNSL_PBMP_ASSIGN(addedUntaggedPorts, newUntagged);
+  OPENNSL_PBMP_AND(addedUntaggedPorts, addedPorts);
+
+  int numAdded{0};
+  int numRemoved{0};
+  int numRetagged{0};
+  OPENNSL_PBMP_COUNT(addedPorts, numAdded);
+  OPENNSL_PBMP_COUNT(removedPorts, numRemoved);
+  OPENNSL_PBMP_COUNT(retaggedPorts, numRetagged);
+  XLOG(DBG2) << "updating VLAN " << newVlan->getID() << ": "
+             << numAdded - numRetagged << " ports added, "
+             << numRemoved << " ports removed, "
+             << numRetagged << " ports retagged";
   if (numRemoved) {
     auto rv = opennsl_vlan_port_remove(unit_, newVlan->getID(), removedPorts);
     bcmCheckError(rv, "failed to remove ports from VLAN ", newVlan->getID());
@@ -1064,16 +1232,7 @@ void BcmSwitch::processAddedVlan(const shared_ptr<Vlan>& vlan) {
 
   opennsl_pbmp_t pbmp;
   opennsl_pbmp_t ubmp;
-  OPENNSL_PBMP_CLEAR(pbmp);
-  OPENNSL_PBMP_CLEAR(ubmp);
-
-  for (const auto& entry : vlan->getPorts()) {
-    opennsl_port_t bcmPort = portTable_->getBcmPortId(entry.first);
-    OPENNSL_PBMP_PORT_ADD(pbmp, bcmPort);
-    if (!entry.second.tagged) {
-      OPENNSL_PBMP_PORT_ADD(ubmp, bcmPort);
-    }
-  }
+  getVlanPortBitmaps(*vlan, &pbmp, &ubmp);
   typedef BcmWarmBootCache::VlanInfo VlanInfo;
   // Since during warm boot all VLAN in the config will show
   // up as added VLANs we only need to consult the warm boot
@@ -1138,11 +1297,17 @@ void BcmSwitch::processRemovedIntf(const shared_ptr<Interface>& intf) {
 }
 
 void BcmSwitch::processAclChanges(const StateDelta& delta) {
+  EventTrace::Scope trace(EventTrace::HwPhase::ACLS);
   if (!platform_->areAclsSupported()) {
     // certain platforms may not support acls fully.
     return;
   }
 
+  if (FLAGS_incremental_acl_programming) {
+    processAclChangesIncrementally(delta);
+    return;
+  }
+
   forEachChanged(
     delta.getAclsDelta(),
     &BcmSwitch::processChangedAcl,
@@ -1151,6 +1316,43 @@ void BcmSwitch::processAclChanges(const StateDelta& delta) {
     this);
 }
 
+void BcmSwitch::processAclChangesIncrementally(const StateDelta& delta) {
+  auto plan = aclTable_->planAclChanges(delta);
+  // Record the plan first, so the ACL entries can be programmed in the
+  // slots it gives them
+  aclTable_->aclChangesPlanned(plan);
+
+  const auto& oldAcls = delta.oldState()->getAcls();
+  const auto& newAcls = delta.newState()->getAcls();
+  for (const auto& step : plan.steps) {
+    auto oldAcl = oldAcls->getEntryIf(step.name);
+    switch (step.action) {
+      case AclTcamPlanner::Action::ADD: {
+        const auto& newAcl = newAcls->getEntry(step.name);
+        if (!oldAcl) {
+          processAddedAcl(newAcl);
+        } else if (!(*oldAcl == *newAcl)) {
+          // Programmed before the ACL table planned its slot
+          processChangedAcl(oldAcl, newAcl);
+        }
+        break;
+      }
+      case AclTcamPlanner::Action::REPLACE:
+      case AclTcamPlanner::Action::MOVE:
+        processChangedAcl(oldAcl, newAcls->getEntry(step.name));
+        break;
+      case AclTcamPlanner::Action::REMOVE:
+        processRemovedAcl(oldAcl);
+        break;
+    }
+  }
+  XLOG(DBG2) << "Programmed ACL changes in " << plan.steps.size()
+             << " steps, leaving " << plan.unmoved << " entries in place, "
+             << plan.crossSliceMoves << " moved across slices, "
+             << plan.breakBeforeMake << " break before make"
+             << (plan.relaidOut ? ", after laying out all entries again" : "");
+}
+
 void BcmSwitch::processAggregatePortChanges(const StateDelta& delta) {
   forEachChanged(
       delta.getAggregatePortsDelta(),
@@ -1162,8 +1364,9 @@ void BcmSwitch::processAggregatePortChanges(const StateDelta& delta) {
 
 void BcmSwitch::processChangedSflowCollector(
     const std::shared_ptr<SflowCollector>& /* oldCollector */,
-    const std::shared_ptr<SflowCollector>& /* newCollector */) {
-  XLOG(ERR) << "sFlow collector should should only change on restarts";
+    const std::shared_ptr<SflowCollector>& newCollector) {
+  // Collectors are keyed by their address, so only the rate limit changes
+  sFlowExporterTable_->updateExporter(newCollector);
 }
 
 void BcmSwitch::processRemovedSflowCollector(
@@ -1308,6 +1511,7 @@ void BcmSwitch::processNeighborEntryDelta(
 void BcmSwitch::processNeighborChanges(
     const StateDelta& delta,
     std::shared_ptr<SwitchState>* appliedState) {
+  EventTrace::Scope trace(EventTrace::HwPhase::NEIGHBORS);
   for (const auto& vlanDelta : delta.getVlansDelta()) {
     for (const auto& arpDelta : vlanDelta.getArpDelta()) {
       using DeltaT = DeltaValue<ArpEntry>;
@@ -1384,60 +1588,506 @@ void BcmSwitch::processRemovedRoute(const RouterID id,
   routeTable_->deleteRoute(getBcmVrfId(id), route.get());
 }
 
+bool BcmSwitch::batchRouteChanges(size_t numChanges) const {
+  return FLAGS_route_batch_min_size > 0 &&
+      numChanges >= static_cast<size_t>(FLAGS_route_batch_min_size);
+}
+
+template <typename RouteT, typename DeltaT>
+void BcmSwitch::processRemovedRoutes(
+    const RouterID& id,
+    const DeltaT& routesDelta,
+    const std::shared_ptr<RouteTable>& oldTable) {
+  std::vector<shared_ptr<RouteT>> removed;
+  forEachRemoved(routesDelta, [&](const shared_ptr<RouteT>& route) {
+    removed.push_back(route);
+  });
+  if (removed.empty()) {
+    return;
+  }
+  if (FLAGS_fib_compression) {
+    processRemovedRoutesCompressed(id, removed, oldTable);
+  } else if (!batchRouteChanges(removed.size())) {
+    for (const auto& route : removed) {
+      processRemovedRoute(id, route);
+    }
+  } else {
+    std::vector<const RouteT*> toDelete;
+    toDelete.reserve(removed.size());
+    for (const auto& route : removed) {
+      if (route->isResolved()) {
+        toDelete.push_back(route.get());
+      }
+    }
+    XLOG(DBG2) << "removing " << toDelete.size() << " routes @ vrf " << id
+               << " in a batch";
+    routeTable_->deleteRoutes(getBcmVrfId(id), toDelete);
+  }
+  BcmStats::get()->routesDeleted(removed.size());
+}
+
 void BcmSwitch::processRemovedRoutes(const StateDelta& delta) {
+  EventTrace::Scope trace(EventTrace::HwPhase::REMOVED_ROUTES);
   for (auto const& rtDelta : delta.getRouteTablesDelta()) {
     if (!rtDelta.getOld()) {
       // no old route table, must not removed route, skip
       continue;
     }
     RouterID id = rtDelta.getOld()->getID();
-    forEachRemoved(
-        rtDelta.getRoutesV4Delta(),
-        &BcmSwitch::processRemovedRoute<RouteV4>,
-        this,
-        id);
-    forEachRemoved(
-        rtDelta.getRoutesV6Delta(),
-        &BcmSwitch::processRemovedRoute<RouteV6>,
-        this,
-        id);
+    processRemovedRoutes<RouteV4>(
+        id, rtDelta.getRoutesV4Delta(), rtDelta.getOld());
+    processRemovedRoutes<RouteV6>(
+        id, rtDelta.getRoutesV6Delta(), rtDelta.getOld());
+  }
+}
+
+template <typename RouteT>
+size_t BcmSwitch::applyFibChanges(
+    const RouterID& id,
+    const typename RouteCompressor<typename RouteT::Addr>::Changes& changes,
+    size_t begin,
+    const RouteLookup<RouteT>& lookup) {
+  using Change = typename RouteCompressor<typename RouteT::Addr>::Change;
+  auto vrf = getBcmVrfId(id);
+  for (auto idx = begin; idx < changes.size(); ++idx) {
+    const auto& change = changes[idx];
+    // Routes to remove may be missing after a failed change was reverted
+    if (change.type == Change::Type::REMOVE &&
+        !routeTable_->getBcmRouteIf(
+            vrf, IPAddress(change.network), change.mask)) {
+      continue;
+    }
+    typename RouteT::Prefix prefix{change.network, change.mask};
+    auto route = lookup(prefix);
+    if (!route) {
+      throw FbossError(
+          "route ", prefix.str(), " @ vrf ", id,
+          " to program is not in the route table");
+    }
+    if (change.type == Change::Type::REMOVE) {
+      XLOG(DBG3) << "removing route entry @ vrf " << id << " "
+                 << route->str() << " from hardware";
+      routeTable_->deleteRoute(vrf, route.get());
+      continue;
+    }
+    XLOG(DBG3) << "programming route entry @ vrf " << id << " "
+               << route->str();
+    try {
+      routeTable_->addRoute(vrf, route.get());
+    } catch (const BcmError& error) {
+      rethrowIfHwNotFull(error);
+      return idx;
+    }
+  }
+  return changes.size();
+}
+
+template <typename RouteT>
+BcmSwitch::CompressedForward BcmSwitch::getCompressedForward(
+    const RouteT& route) {
+  auto classID =
+      FLAGS_route_class_counters ? route.getClassID() : RouteClassID(0);
+  return std::make_pair(route.getForwardInfo(), classID);
+}
+
+template <typename RouteT>
+void BcmSwitch::processRemovedRoutesCompressed(
+    const RouterID& id,
+    const std::vector<shared_ptr<RouteT>>& removed,
+    const std::shared_ptr<RouteTable>& oldTable) {
+  using AddrT = typename RouteT::Addr;
+  auto& compressor = fibCompressors_[id].get(AddrT());
+  typename RouteCompressor<AddrT>::Changes changes;
+  for (const auto& route : removed) {
+    const auto& prefix = route->prefix();
+    compressor.remove(prefix.network, prefix.mask, &changes);
+  }
+  // The routes the removed ones covered are still in the old route table
+  const auto& rib = oldTable->template getRib<AddrT>();
+  RouteLookup<RouteT> lookup = [&](const typename RouteT::Prefix& prefix) {
+    return rib->exactMatch(prefix);
+  };
+  // A removal can't be reverted, so a route that no longer has a covering
+  // route to forward the same and can't be installed stays out
+  size_t idx = 0;
+  while ((idx = applyFibChanges<RouteT>(id, changes, idx, lookup)) <
+         changes.size()) {
+    typename RouteT::Prefix prefix{changes[idx].network, changes[idx].mask};
+    XLOG(ERR) << "failed to install route " << prefix.str() << " @ vrf "
+              << id << " no longer covered by a removed route";
+    ++idx;
+  }
+}
+
+template <typename RouteT>
+void BcmSwitch::programCompressedRoutes(
+    const RouterID& id,
+    const RouteChanges<RouteT>& routeChanges,
+    std::shared_ptr<SwitchState>* appliedState) {
+  using AddrT = typename RouteT::Addr;
+  auto& compressor = fibCompressors_[id].get(AddrT());
+  // The routes as applied so far: a reverted route is looked up as it was
+  RouteLookup<RouteT> lookup = [&](const typename RouteT::Prefix& prefix) {
+    return (*appliedState)
+        ->getRouteTables()
+        ->getRouteTable(id)
+        ->template getRib<AddrT>()
+        ->exactMatch(prefix);
+  };
+  typename RouteCompressor<AddrT>::Changes changes;
+  for (const auto& routeChange : routeChanges) {
+    const auto& oldRoute = routeChange.first;
+    const auto& newRoute = routeChange.second;
+    const auto& prefix = newRoute->prefix();
+    bool wasResolved = oldRoute && oldRoute->isResolved();
+    changes.clear();
+    if (newRoute->isResolved()) {
+      compressor.update(
+          prefix.network, prefix.mask, getCompressedForward(*newRoute),
+          &changes);
+    } else if (wasResolved) {
+      XLOG(DBG1) << "Non-resolved route HW programming is skipped";
+      compressor.remove(prefix.network, prefix.mask, &changes);
+    } else {
+      XLOG(DBG1) << "Non-resolved route HW programming is skipped";
+      continue;
+    }
+    if (applyFibChanges<RouteT>(id, changes, 0, lookup) == changes.size()) {
+      continue;
+    }
+
+    // Revert the route, and make the changes back to the hardware as it
+    // was before it.  Changes that were never made are skipped or made
+    // again harmlessly.
+    SwitchState::revertNewRouteEntry<AddrT>(
+        id, newRoute, oldRoute, appliedState);
+    changes.clear();
+    if (wasResolved) {
+      compressor.update(
+          prefix.network, prefix.mask, getCompressedForward(*oldRoute),
+          &changes);
+    } else {
+      compressor.remove(prefix.network, prefix.mask, &changes);
+    }
+    size_t idx = 0;
+    while ((idx = applyFibChanges<RouteT>(id, changes, idx, lookup)) <
+           changes.size()) {
+      typename RouteT::Prefix failed{changes[idx].network, changes[idx].mask};
+      XLOG(ERR) << "failed to restore route " << failed.str() << " @ vrf "
+                << id << " after reverting " << newRoute->str();
+      ++idx;
+    }
+  }
+}
+
+void BcmSwitch::publishFibCompression() {
+  int64_t routes = 0;
+  int64_t installed = 0;
+  for (auto iter = fibCompressors_.begin(); iter != fibCompressors_.end();) {
+    const auto& compressors = iter->second;
+    if (compressors.v4.numRoutes() + compressors.v6.numRoutes() == 0) {
+      iter = fibCompressors_.erase(iter);
+      continue;
+    }
+    routes += compressors.v4.numRoutes() + compressors.v6.numRoutes();
+    installed += compressors.v4.numInstalled() + compressors.v6.numInstalled();
+    ++iter;
+  }
+  fbData->setCounter("bcm.route.fib_compression.routes", routes);
+  fbData->setCounter("bcm.route.fib_compression.installed", installed);
+  fbData->setCounter(
+      "bcm.route.fib_compression.installed_pct",
+      routes ? installed * 100 / routes : 100);
+}
+
+template <typename RouteT, typename DeltaT>
+BcmSwitch::RoutePartition BcmSwitch::getRoutePartition(
+    const RouterID& id,
+    const DeltaT& routesDelta,
+    std::shared_ptr<SwitchState>* appliedState) {
+  // Shared by the partition's functions
+  struct Batch {
+    // The old route of each change, or null for added routes, and the new
+    // one
+    std::vector<std::pair<shared_ptr<RouteT>, shared_ptr<RouteT>>> changes;
+    // The routes to program, and the change each of them is from
+    std::vector<const RouteT*> toProgram;
+    std::vector<size_t> toProgramChange;
+    BcmRouteTable::ProgrammedRoutes added;
+    // Indices in toProgram of the routes that failed to program
+    std::vector<size_t> failed;
+    std::exception_ptr error;
+  };
+  auto batch = std::make_shared<Batch>();
+  auto& changes = batch->changes;
+  forEachChanged(
+      routesDelta,
+      [&](const shared_ptr<RouteT>& oldRoute,
+          const shared_ptr<RouteT>& newRoute) {
+        changes.emplace_back(oldRoute, newRoute);
+      },
+      [&](const shared_ptr<RouteT>& newRoute) {
+        changes.emplace_back(nullptr, newRoute);
+      },
+      [&](const shared_ptr<RouteT>& /*oldRoute*/) {});
+
+  RoutePartition partition;
+  partition.numChanges = changes.size();
+  if (FLAGS_fib_compression) {
+    partition.program = [this, id, appliedState, batch](std::mutex*) {
+      programCompressedRoutes(id, batch->changes, appliedState);
+    };
+    partition.finish = [] { return std::exception_ptr(); };
+    return partition;
+  }
+  if (!batchRouteChanges(changes.size())) {
+    partition.program = [this, id, appliedState, batch](std::mutex*) {
+      for (const auto& change : batch->changes) {
+        if (change.first) {
+          processChangedRoute(id, appliedState, change.first, change.second);
+        } else {
+          processAddedRoute(id, appliedState, change.second);
+        }
+      }
+    };
+    partition.finish = [] { return std::exception_ptr(); };
+    return partition;
+  }
+
+  batch->toProgram.reserve(changes.size());
+  batch->toProgramChange.reserve(changes.size());
+  std::vector<const RouteT*> unresolved;
+  for (size_t idx = 0; idx < changes.size(); ++idx) {
+    const auto& change = changes[idx];
+    if (!change.second->isResolved()) {
+      // As in processChangedRoute(), a route that is no longer resolved is
+      // deleted instead.  This changes the route table, so it is done now
+      // rather than in program().
+      XLOG(DBG1) << "Non-resolved route HW programming is skipped";
+      if (change.first && change.first->isResolved()) {
+        unresolved.push_back(change.first.get());
+      }
+      continue;
+    }
+    batch->toProgram.push_back(change.second.get());
+    batch->toProgramChange.push_back(idx);
+  }
+  if (!unresolved.empty()) {
+    XLOG(DBG2) << "removing " << unresolved.size() << " unresolved routes @ "
+               << "vrf " << id << " in a batch";
+    routeTable_->deleteRoutes(getBcmVrfId(id), unresolved);
+  }
+  partition.concurrent = true;
+  partition.program = [this, id, batch](std::mutex* sharedLock) {
+    XLOG(DBG2) << "programming " << batch->toProgram.size()
+               << " routes @ vrf " << id << " in a batch";
+    try {
+      routeTable_->programRoutes(
+          getBcmVrfId(id),
+          batch->toProgram,
+          [&](size_t idx, const BcmError& error) {
+            rethrowIfHwNotFull(error);
+            batch->failed.push_back(idx);
+          },
+          sharedLock,
+          &batch->added);
+    } catch (...) {
+      batch->error = std::current_exception();
+    }
+  };
+  partition.finish = [this, id, appliedState, batch] {
+    routeTable_->addProgrammedRoutes(std::move(batch->added));
+    for (auto idx : batch->failed) {
+      const auto& change = batch->changes[batch->toProgramChange[idx]];
+      using AddrT = typename RouteT::Addr;
+      SwitchState::revertNewRouteEntry<AddrT>(
+          id, change.second, change.first, appliedState);
+    }
+    return batch->error;
+  };
+  return partition;
+}
+
+void BcmSwitch::programRoutePartitions(
+    std::vector<RoutePartition>* partitions) {
+  auto program = [](RoutePartition* partition, std::mutex* sharedLock) {
+    auto begin = steady_clock::now();
+    partition->program(sharedLock);
+    partition->duration =
+        duration_cast<microseconds>(steady_clock::now() - begin);
+  };
+
+  // Partitions programmed one route at a time change the route table as
+  // they go, so they are all done before any concurrent partition starts.
+  std::vector<RoutePartition*> concurrent;
+  for (auto& partition : *partitions) {
+    if (partition.numChanges == 0) {
+      continue;
+    }
+    if (partition.concurrent) {
+      concurrent.push_back(&partition);
+      continue;
+    }
+    program(&partition, nullptr);
+    BcmStats::get()->routesProgrammed(
+        partition.numChanges, partition.duration);
+  }
+  if (concurrent.empty()) {
+    return;
+  }
+
+  auto begin = steady_clock::now();
+  if (FLAGS_parallel_route_programming && concurrent.size() > 1) {
+    XLOG(DBG2) << "programming " << concurrent.size()
+               << " route partitions in parallel";
+    std::mutex sharedLock;
+    std::vector<std::thread> threads;
+    SCOPE_EXIT {
+      for (auto& thread : threads) {
+        thread.join();
+      }
+    };
+    // The first partition is programmed on this thread
+    for (size_t i = 1; i < concurrent.size(); ++i) {
+      threads.emplace_back(program, concurrent[i], &sharedLock);
+    }
+    program(concurrent.front(), &sharedLock);
+  } else {
+    for (auto* partition : concurrent) {
+      program(partition, nullptr);
+    }
+  }
+  auto elapsed = duration_cast<microseconds>(steady_clock::now() - begin);
+
+  // Finish every partition, so that our route table matches the hardware,
+  // before reporting the first error.
+  std::exception_ptr error;
+  microseconds busy{0};
+  for (auto* partition : concurrent) {
+    auto partitionError = partition->finish();
+    if (partitionError && !error) {
+      error = partitionError;
+    }
+    busy += partition->duration;
+    BcmStats::get()->routesProgrammed(
+        partition->numChanges, partition->duration);
+  }
+  if (concurrent.size() > 1) {
+    // Recorded with --parallel_route_programming off as well, as a baseline
+    BcmStats::get()->routePartitionsProgrammed(busy, elapsed);
+  }
+  if (error) {
+    std::rethrow_exception(error);
   }
 }
 
 void BcmSwitch::processAddedChangedRoutes(
     const StateDelta& delta,
     std::shared_ptr<SwitchState>* appliedState) {
+  EventTrace::Scope trace(EventTrace::HwPhase::ADDED_CHANGED_ROUTES);
+  std::vector<RoutePartition> partitions;
   for (auto const& rtDelta : delta.getRouteTablesDelta()) {
     if (!rtDelta.getNew()) {
       // no new route table, must not have added or changed route, skip
       continue;
     }
     RouterID id = rtDelta.getNew()->getID();
-    forEachChanged(
-        rtDelta.getRoutesV4Delta(),
-        &BcmSwitch::processChangedRoute<RouteV4>,
-        &BcmSwitch::processAddedRoute<RouteV4>,
-        [&](BcmSwitch*,
-            const RouterID&,
-            std::shared_ptr<SwitchState>*,
-            const shared_ptr<RouteV4>&) {},
-        this,
-        id,
-        appliedState);
-    forEachChanged(
-        rtDelta.getRoutesV6Delta(),
-        &BcmSwitch::processChangedRoute<RouteV6>,
-        &BcmSwitch::processAddedRoute<RouteV6>,
-        [&](BcmSwitch*,
-            const RouterID&,
-            std::shared_ptr<SwitchState>*,
-            const shared_ptr<RouteV6>&) {},
-        this,
-        id,
-        appliedState);
+    partitions.push_back(getRoutePartition<RouteV4>(
+        id, rtDelta.getRoutesV4Delta(), appliedState));
+    partitions.push_back(getRoutePartition<RouteV6>(
+        id, rtDelta.getRoutesV6Delta(), appliedState));
+  }
+  programRoutePartitions(&partitions);
+  if (FLAGS_fib_compression) {
+    publishFibCompression();
   }
 }
 
+template <typename RouteT, typename DeltaT>
+void BcmSwitch::getNewNextHopGroups(
+    opennsl_vrf_t vrf,
+    const DeltaT& routesDelta,
+    std::set<NextHopGroupKey>* keys) const {
+  auto addGroup = [&](
+      const shared_ptr<RouteT>& oldRoute,
+      const shared_ptr<RouteT>& newRoute) {
+    if (!newRoute->isResolved()) {
+      return;
+    }
+    const auto& fwd = newRoute->getForwardInfo();
+    if (fwd.getAction() != RouteForwardAction::NEXTHOPS) {
+      return;
+    }
+    if (oldRoute && oldRoute->isResolved() &&
+        oldRoute->getForwardInfo() == fwd) {
+      return;
+    }
+    // As the routes will be programmed, so that they find these groups
+    keys->insert(
+        BcmRouteTable::getNextHopGroupKey(vrf, fwd.getNextHopSet()));
+  };
+  forEachChanged(
+      routesDelta,
+      addGroup,
+      [&](const shared_ptr<RouteT>& newRoute) { addGroup(nullptr, newRoute); },
+      [](const shared_ptr<RouteT>& /*oldRoute*/) {});
+}
+
+std::vector<BcmSwitch::NextHopGroupKey> BcmSwitch::preprogramNextHopGroups(
+    const StateDelta& delta) {
+  std::vector<NextHopGroupKey> held;
+  if (!FLAGS_preprogram_nexthop_groups) {
+    return held;
+  }
+  auto begin = steady_clock::now();
+  std::set<NextHopGroupKey> keys;
+  for (auto const& rtDelta : delta.getRouteTablesDelta()) {
+    if (!rtDelta.getNew()) {
+      continue;
+    }
+    auto vrf = getBcmVrfId(rtDelta.getNew()->getID());
+    getNewNextHopGroups<RouteV4>(vrf, rtDelta.getRoutesV4Delta(), &keys);
+    getNewNextHopGroups<RouteV6>(vrf, rtDelta.getRoutesV6Delta(), &keys);
+  }
+  if (keys.empty()) {
+    return held;
+  }
+
+  uint64_t created = 0;
+  held.reserve(keys.size());
+  SCOPE_FAIL {
+    releaseNextHopGroups(&held);
+  };
+  for (const auto& key : keys) {
+    bool exists = hostTable_->getBcmEcmpHostIf(key) != nullptr;
+    try {
+      hostTable_->incRefOrCreateBcmEcmpHost(key);
+    } catch (const BcmError& error) {
+      // Left to the routes to create, and to fail and be reverted on
+      rethrowIfHwNotFull(error);
+      XLOG(DBG2) << "hardware full, not creating next hop group "
+                 << key.second << " @ vrf " << key.first << " ahead";
+      continue;
+    }
+    held.push_back(key);
+    if (!exists) {
+      ++created;
+    }
+  }
+  XLOG(DBG2) << "created " << created << " of " << keys.size()
+             << " next hop groups ahead of their routes";
+  BcmStats::get()->nextHopGroupsPreprogrammed(
+      created, duration_cast<microseconds>(steady_clock::now() - begin));
+  return held;
+}
+
+void BcmSwitch::releaseNextHopGroups(std::vector<NextHopGroupKey>* keys) {
+  for (const auto& key : *keys) {
+    hostTable_->derefBcmEcmpHost(key);
+  }
+  keys->clear();
+}
+
 void BcmSwitch::linkscanCallback(int unit,
                                  opennsl_port_t bcmPort,
                                  opennsl_port_info_t* info) {
@@ -1494,6 +2144,7 @@ opennsl_rx_t BcmSwitch::packetReceived(opennsl_pkt_t* pkt) noexcept {
   unique_ptr<BcmRxPacket> bcmPkt;
   try {
     bcmPkt = createRxPacket(pkt);
+    bcmPkt->setRxTime(steady_clock::now());
   } catch (const std::exception& ex) {
     XLOG(ERR) << "failed to allocated BcmRxPacket for receive handling: "
               << folly::exceptionStr(ex);
@@ -1523,6 +2174,22 @@ bool BcmSwitch::sendPacketOutOfPort(unique_ptr<TxPacket> pkt,
   return OPENNSL_SUCCESS(rv);
 }
 
+size_t BcmSwitch::sendPacketsBatch(std::vector<BatchTxPacket> pkts) noexcept {
+  std::vector<unique_ptr<BcmTxPacket>> bcmPkts;
+  bcmPkts.reserve(pkts.size());
+  for (auto& pkt : pkts) {
+    bcmPkts.emplace_back(
+        boost::polymorphic_downcast<BcmTxPacket*>(pkt.pkt.release()));
+    if (pkt.port) {
+      bcmPkts.back()->setDestModPort(getPortTable()->getBcmPortId(*pkt.port));
+    }
+  }
+  auto num = bcmPkts.size();
+  XLOG(DBG4) << "sendPacketsBatch of " << num << " packets";
+  auto rv = BcmTxPacket::sendAsyncBatch(std::move(bcmPkts));
+  return OPENNSL_SUCCESS(rv) ? num : 0;
+}
+
 void BcmSwitch::updateStats(SwitchStats *switchStats) {
   // Update thread-local switch statistics.
   updateThreadLocalSwitchStats(switchStats);
@@ -1560,13 +2227,59 @@ void BcmSwitch::updateThreadLocalPortStats(
 }
 
 void BcmSwitch::updateGlobalStats() {
-  portTable_->updatePortStats();
+  auto start = steady_clock::now();
+  if (FLAGS_bulk_stats_collection) {
+    portTable_->updatePortStatsInBulk();
+  } else {
+    portTable_->updatePortStats();
+  }
   trunkTable_->updateStats();
   bcmTableStats_->publish();
+  {
+    std::lock_guard<std::mutex> g(lock_);
+    tableCapacity_->publish(bcmTableStats_->getHwTableStats());
+  }
   bcmStatUpdater_->updateStats();
   if (isBufferStatCollectionEnabled()) {
     exportDeviceBufferUsage();
+    publishBufferUsage();
   }
+  fbData->setCounter("bcm.rx.buffers_held", BcmRxPacket::getNumBuffersHeld());
+  BcmStats::get()->statsCollected(
+      duration_cast<microseconds>(steady_clock::now() - start));
+}
+
+void BcmSwitch::publishBufferUsage() const {
+  constexpr auto kUnknown = RecordingBufferStatsLogger::kUnknown;
+  const auto& device = bufferStatsLogger_->getDeviceStats();
+  int64_t bytesUsed = device.bytesUsed;
+  int64_t bytesMax = device.bytesMax;
+  if (bytesUsed != kUnknown) {
+    fbData->setCounter("buffer.device.bytes_used", bytesUsed);
+    if (bytesMax > 0) {
+      fbData->setCounter(
+          "buffer.device.pct_used", bytesUsed * 100 / bytesMax);
+    }
+  }
+  bufferStatsLogger_->forEachPortStats(
+      [](const RecordingBufferStatsLogger::Key& key,
+         const RecordingBufferStatsLogger::Stats& stats) {
+        auto prefix = folly::to<std::string>(
+            "buffer.",
+            std::get<0>(key),
+            std::get<1>(key) == BufferStatsLogger::Direction::Ingress
+                ? ".ingress."
+                : ".egress.",
+            std::get<2>(key));
+        int64_t queueBytesUsed = stats.bytesUsed;
+        int64_t pktsDropped = stats.pktsDropped;
+        if (queueBytesUsed != kUnknown) {
+          fbData->setCounter(prefix + ".bytes_used", queueBytesUsed);
+        }
+        if (pktsDropped != kUnknown) {
+          fbData->setCounter(prefix + ".pkts_dropped", pktsDropped);
+        }
+      });
 }
 
 opennsl_if_t BcmSwitch::getDropEgressId() const {
@@ -1593,6 +2306,43 @@ bool BcmSwitch::getAndClearNeighborHit(
   return true;
 }
 
+folly::Optional<std::vector<std::pair<RouterID, IPAddress>>>
+BcmSwitch::getAndClearNeighborHits() {
+  // The traversal only reads the SDK's host table, so unlike looking up a
+  // BcmHost it doesn't need lock_ and can't get stuck behind updates.
+  using Hits = std::vector<std::pair<RouterID, IPAddress>>;
+  auto collect = [](int /*unit*/, int /*index*/, opennsl_l3_host_t* host,
+                    void* userData) {
+    if (!(host->l3a_flags & OPENNSL_L3_HIT)) {
+      return 0;
+    }
+    auto* hits = static_cast<Hits*>(userData);
+    hits->emplace_back(
+        RouterID(host->l3a_vrf),
+        host->l3a_flags & OPENNSL_L3_IP6 ?
+            IPAddress::fromBinary(folly::ByteRange(
+                host->l3a_ip6_addr, sizeof(host->l3a_ip6_addr))) :
+            IPAddress::fromLongHBO(host->l3a_ip_addr));
+    return 0;
+  };
+
+  opennsl_l3_info_t l3Info;
+  opennsl_l3_info_t_init(&l3Info);
+  auto rv = opennsl_l3_info(unit_, &l3Info);
+  bcmCheckError(rv, "failed to get L3 table info");
+
+  // Every VRF is collected, so the traversals can clear the hit bits as
+  // they read them
+  Hits hits;
+  rv = opennsl_l3_host_traverse(unit_, OPENNSL_L3_HIT_CLEAR, 0,
+      l3Info.l3info_max_host, collect, &hits);
+  bcmCheckError(rv, "failed to traverse v4 host table for hit bits");
+  rv = opennsl_l3_host_traverse(unit_, OPENNSL_L3_IP6 | OPENNSL_L3_HIT_CLEAR,
+      0, l3Info.l3info_max_host / 2, collect, &hits);
+  bcmCheckError(rv, "failed to traverse v6 host table for hit bits");
+  return std::move(hits);
+}
+
 void BcmSwitch::exitFatal() const {
   dumpState();
   callback_->exitFatal();
@@ -1611,6 +2361,46 @@ bool BcmSwitch::stopFineGrainedBufferStatLogging() {
   return !fineGrainedBufferStatsEnabled_;
 }
 
+bool BcmSwitch::startPacketTraceSampling(
+    const PacketTraceSamplingConfig& config) {
+  return packetTraceSampler_->start(config);
+}
+
+void BcmSwitch::stopPacketTraceSampling() {
+  packetTraceSampler_->stop();
+}
+
+std::vector<PacketTraceSample> BcmSwitch::getPacketTraceSamples() const {
+  return packetTraceSampler_->getSamples();
+}
+
+bool BcmSwitch::setSdkCallProfiling(bool enable) {
+  // The SDK calls are only timed in agents linked with the tracing shim
+  if (!BcmSdkCallProfiler::isAvailable()) {
+    return false;
+  }
+  BcmSdkCallProfiler::setEnabled(enable);
+  return true;
+}
+
+std::vector<SdkCallProfile> BcmSwitch::getSdkCallProfile() const {
+  return BcmSdkCallProfiler::getProfile();
+}
+
+bool BcmSwitch::setAggregatePortMemberForwarding(
+    AggregatePortID aggPort,
+    PortID port,
+    bool enable) {
+  // This runs on the LACP thread, which mustn't wait for a state update in
+  // progress, so leave the change to the state update that follows it if
+  // one is
+  std::unique_lock<std::mutex> g(lock_, std::try_to_lock);
+  if (!g.owns_lock()) {
+    return false;
+  }
+  return trunkTable_->setMemberForwarding(aggPort, port, enable);
+}
+
 void BcmSwitch::processChangedAggregatePort(
     const std::shared_ptr<AggregatePort>& oldAggPort,
     const std::shared_ptr<AggregatePort>& newAggPort) {
@@ -1636,25 +2426,73 @@ void BcmSwitch::processRemovedAggregatePort(
 #ifndef OPENNSL_6_4_6_6_ODP
 static int _addL2Entry(int /*unit*/, opennsl_l2_addr_t* l2addr,
                        void* user_data) {
-  L2EntryThrift entry;
-  std::vector<L2EntryThrift> *l2Table =
-    (std::vector<L2EntryThrift> *) user_data;
-  entry.mac = folly::sformat("{0:02x}:{1:02x}:{2:02x}:{3:02x}:{4:02x}:{5:02x}",
-                             l2addr->mac[0], l2addr->mac[1], l2addr->mac[2],
-                             l2addr->mac[3], l2addr->mac[4], l2addr->mac[5]);
-  entry.port = l2addr->port;
-  entry.vlanID = l2addr->vid;
-  XLOG(DBG6) << "L2 entry: Mac:" << entry.mac << " Vid:" << entry.vlanID
-             << " Port:" << entry.port;
-  l2Table->push_back(entry);
+  auto l2Table = static_cast<L2TableMirror*>(user_data);
+  auto mac = folly::MacAddress::fromBinary(
+      folly::ByteRange(l2addr->mac, folly::MacAddress::SIZE));
+  XLOG(DBG6) << "L2 entry: Mac:" << mac << " Vid:" << l2addr->vid
+             << " Port:" << l2addr->port;
+  l2Table->learned(VlanID(l2addr->vid), mac, l2addr->port);
   return 0;
 }
 
-void BcmSwitch::fetchL2Table(std::vector<L2EntryThrift> *l2Table) {
-  int rv = opennsl_l2_traverse(unit_, _addL2Entry, l2Table);
-  if (rv < 0) {
-    XLOG(ERR) << "oepnnsl_l2_traverse failed";
+void BcmSwitch::setupL2Learning() {
+  // Register before traversing the table, so that nothing learned or aged
+  // in between is missed
+  auto rv = opennsl_l2_addr_register(unit_, l2AddrCallback, this);
+  bcmCheckError(rv, "failed to register for L2 learn and age callbacks");
+  flags_ |= L2_REGISTERED;
+  rv = opennsl_l2_traverse(unit_, _addL2Entry, l2Table_.get());
+  bcmCheckError(rv, "failed to traverse the L2 table");
+}
+
+void BcmSwitch::unregisterL2Callback() {
+  auto rv = opennsl_l2_addr_unregister(unit_, l2AddrCallback, this);
+  CHECK(OPENNSL_SUCCESS(rv)) << "failed to unregister BcmSwitch L2 "
+    "callback: " << opennsl_errmsg(rv);
+}
+
+void BcmSwitch::l2AddrCallback(
+    int /*unit*/,
+    opennsl_l2_addr_t* l2addr,
+    int operation,
+    void* userdata) {
+  auto sw = static_cast<BcmSwitch*>(userdata);
+  auto mac = folly::MacAddress::fromBinary(
+      folly::ByteRange(l2addr->mac, folly::MacAddress::SIZE));
+  VlanID vlan(l2addr->vid);
+  L2LearningUpdate::Type type;
+  switch (operation) {
+    case OPENNSL_L2_CALLBACK_ADD:
+      sw->l2Table_->learned(vlan, mac, l2addr->port);
+      type = L2LearningUpdate::Type::LEARN;
+      break;
+    case OPENNSL_L2_CALLBACK_DELETE:
+      sw->l2Table_->aged(vlan, mac);
+      type = L2LearningUpdate::Type::AGE;
+      break;
+    default:
+      return;
   }
+  if (!sw->callback_) {
+    return;
+  }
+  auto port = (l2addr->flags & OPENNSL_L2_TRUNK_MEMBER)
+      ? PortDescriptor(sw->trunkTable_->getAggregatePortId(l2addr->tgid))
+      : PortDescriptor(sw->portTable_->getPortId(l2addr->port));
+  sw->callback_->l2LearningUpdateReceived(
+      L2LearningUpdate(type, vlan, mac, port));
+}
+
+void BcmSwitch::fetchL2Table(std::vector<L2EntryThrift> *l2Table) {
+  l2Table_->getAll(l2Table);
+}
+
+void BcmSwitch::fetchL2TablePage(
+    const L2TableQuery& query,
+    const std::string& cursor,
+    size_t maxEntries,
+    L2TablePage* page) {
+  l2Table_->getPage(query, cursor, maxEntries, page);
 }
 #endif
 
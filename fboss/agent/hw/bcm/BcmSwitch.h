@@ -11,17 +11,26 @@
 
 #include "fboss/agent/HwSwitch.h"
 #include "fboss/agent/types.h"
+#include "fboss/agent/hw/BufferStatsLogger.h"
+#include "fboss/agent/hw/FibCompressor.h"
 #include "fboss/agent/gen-cpp2/switch_config_types.h"
+#include "fboss/agent/state/RouteNextHopEntry.h"
 #include <folly/dynamic.h>
 
 #include <gtest/gtest_prod.h>
 
+#include <chrono>
+#include <exception>
+#include <functional>
+#include <map>
 #include <memory>
 #include <mutex>
+#include <set>
 #include <boost/container/flat_map.hpp>
 
 extern "C" {
 #include <opennsl/error.h>
+#include <opennsl/l2.h>
 #include <opennsl/port.h>
 #include <opennsl/rx.h>
 #include <opennsl/types.h>
@@ -40,13 +49,17 @@ class BcmHostTable;
 class BcmIntfTable;
 class BcmPlatform;
 class BcmPortTable;
+class BcmRouteCounterTable;
 class BcmRouteTable;
 class BcmRxPacket;
 class BcmStatUpdater;
 class BcmSwitchEventCallback;
+class BcmTableCapacity;
 class BcmTableStats;
 class BcmTrunkTable;
+class BcmTxPacketPool;
 class BcmUnit;
+class L2TableMirror;
 class BcmWarmBootCache;
 class BcmWarmBootHelper;
 class BcmSflowExporterTable;
@@ -54,12 +67,13 @@ class LoadBalancer;
 class PacketTraceInfo;
 class SflowCollector;
 class MockRxPacket;
+class BcmPacketTraceSampler;
 class Interface;
 class Port;
 class PortStats;
+class RouteTable;
 class Vlan;
 class VlanMap;
-class BufferStatsLogger;
 
 /*
  * Virtual interface to BcmSwitch, primarily for mocking/testing
@@ -135,17 +149,22 @@ class BcmSwitch : public BcmSwitchIf {
      PACKET_RX_DESIRED = 0x01,
      LINKSCAN_DESIRED = 0x02
    };
+   // The deviceIndex of a BcmSwitch on a system with a single ASIC
+   static constexpr int kOnlyDevice = -1;
   /*
    * Construct a new BcmSwitch.
    *
    * With this constructor, BcmSwitch will fully own the BCM SDK.
    * When init() is called, it will initialize the SDK, then find and
-   * initialize the first switching ASIC.
+   * initialize the only switching ASIC.  On a system with several, each
+   * BcmSwitch is given the deviceIndex of the ASIC it drives instead (see
+   * BcmUnitProgrammer to program them in parallel).
    */
    explicit BcmSwitch(
        BcmPlatform* platform,
        HashMode hashMode = FULL_HASH,
-       uint32_t featuresDesired = (PACKET_RX_DESIRED | LINKSCAN_DESIRED));
+       uint32_t featuresDesired = (PACKET_RX_DESIRED | LINKSCAN_DESIRED),
+       int deviceIndex = kOnlyDevice);
 
    ~BcmSwitch() override;
 
@@ -190,9 +209,22 @@ class BcmSwitch : public BcmSwitchIf {
   bool sendPacketSwitched(std::unique_ptr<TxPacket> pkt) noexcept override;
   bool sendPacketOutOfPort(std::unique_ptr<TxPacket> pkt,
                            PortID portID) noexcept override;
+  size_t sendPacketsBatch(std::vector<BatchTxPacket> pkts) noexcept override;
+
+  bool setAggregatePortMemberForwarding(
+      AggregatePortID aggPort,
+      PortID port,
+      bool enable) override;
   std::unique_ptr<PacketTraceInfo> getPacketTrace(
       std::unique_ptr<MockRxPacket> pkt) override;
 
+  bool startPacketTraceSampling(
+      const PacketTraceSamplingConfig& config) override;
+  void stopPacketTraceSampling() override;
+  std::vector<PacketTraceSample> getPacketTraceSamples() const override;
+  bool setSdkCallProfiling(bool enable) override;
+  std::vector<SdkCallProfile> getSdkCallProfile() const override;
+
   bool isRxThreadRunning() override;
 
   int getUnit() const override {
@@ -321,6 +353,11 @@ class BcmSwitch : public BcmSwitchIf {
   };
 
   void fetchL2Table(std::vector<L2EntryThrift> *l2Table) override;
+  void fetchL2TablePage(
+      const L2TableQuery& query,
+      const std::string& cursor,
+      size_t maxEntries,
+      L2TablePage* page) override;
 
   BcmHostTable* writableHostTable() const override { return hostTable_.get(); }
   BcmWarmBootCache* getWarmBootCache() const override {
@@ -328,6 +365,10 @@ class BcmSwitch : public BcmSwitchIf {
   }
 
   BcmRouteTable* writableRouteTable() const { return routeTable_.get(); }
+  const BcmRouteTable* getRouteTable() const { return routeTable_.get(); }
+  BcmRouteCounterTable* writableRouteCounterTable() const {
+    return routeCounterTable_.get();
+  }
 
   /**
    * Log the hardware state for the switch
@@ -346,6 +387,13 @@ class BcmSwitch : public BcmSwitchIf {
   bool getAndClearNeighborHit(RouterID vrf,
                               folly::IPAddress& ip) override;
 
+  /*
+   * Traverses the v4 and v6 host tables once each, clearing the hit bits
+   * of the entries of every VRF as they are read.
+   */
+  folly::Optional<std::vector<std::pair<RouterID, folly::IPAddress>>>
+  getAndClearNeighborHits() override;
+
   bool getPortFECConfig(PortID port) const override;
 
   bool isValidStateUpdate(const StateDelta& delta) const override;
@@ -384,7 +432,8 @@ class BcmSwitch : public BcmSwitchIf {
 
   enum Flags : uint32_t {
     RX_REGISTERED = 0x01,
-    LINKSCAN_REGISTERED = 0x02
+    LINKSCAN_REGISTERED = 0x02,
+    L2_REGISTERED = 0x04
   };
   // Forbidden copy constructor and assignment operator
   BcmSwitch(BcmSwitch const &) = delete;
@@ -406,6 +455,12 @@ class BcmSwitch : public BcmSwitchIf {
   std::unique_ptr<BcmRxPacket> createRxPacket(opennsl_pkt_t* pkt);
   void changeDefaultVlan(VlanID id);
 
+  /*
+   * Fill allPorts with the member ports of vlan, and untagged with the
+   * members that don't emit tags.
+   */
+  void getVlanPortBitmaps(const Vlan& vlan, opennsl_pbmp_t* allPorts,
+                          opennsl_pbmp_t* untagged) const;
   void processChangedVlan(const std::shared_ptr<Vlan>& oldVlan,
                           const std::shared_ptr<Vlan>& newVlan);
   void processAddedVlan(const std::shared_ptr<Vlan>& vlan);
@@ -445,12 +500,127 @@ class BcmSwitch : public BcmSwitchIf {
   template <typename RouteT>
   void processRemovedRoute(
       const RouterID id, const std::shared_ptr<RouteT>& route);
+
+  /*
+   * Whether the hardware tables have room for the delta.  Must be called
+   * with lock_ held.
+   */
+  bool isValidTableUpdate(const StateDelta& delta) const;
   void processRemovedRoutes(const StateDelta& delta);
   void processAddedChangedRoutes(
       const StateDelta& delta,
       std::shared_ptr<SwitchState>* appliedState);
+  /*
+   * Create the next hop groups (BcmEcmpHost) that the added and changed
+   * routes of delta move to, ahead of programming the routes, so that
+   * repointing a route is then only a route update.  The groups are
+   * referenced until releaseNextHopGroups(), which must be called once the
+   * routes are programmed, and which clears keys.  If it throws, the
+   * groups it already referenced are released.
+   */
+  using NextHopGroupKey = std::pair<opennsl_vrf_t, RouteNextHopSet>;
+  std::vector<NextHopGroupKey> preprogramNextHopGroups(
+      const StateDelta& delta);
+  template <typename RouteT, typename DeltaT>
+  void getNewNextHopGroups(
+      opennsl_vrf_t vrf,
+      const DeltaT& routesDelta,
+      std::set<NextHopGroupKey>* keys) const;
+  void releaseNextHopGroups(std::vector<NextHopGroupKey>* keys);
+  /*
+   * Process the route changes of one address family in a VRF.  When there
+   * are enough of them (--route_batch_min_size) they are programmed through
+   * the BcmRouteTable batch functions rather than one at a time.
+   */
+  template <typename RouteT, typename DeltaT>
+  void processRemovedRoutes(
+      const RouterID& id,
+      const DeltaT& routesDelta,
+      const std::shared_ptr<RouteTable>& oldTable);
+  bool batchRouteChanges(size_t numChanges) const;
+
+  /*
+   * With --fib_compression, the routes of a VRF that forward the same as
+   * the route covering them are left out of hardware, as worked out by a
+   * FibCompressor per address family, and route changes are programmed one
+   * at a time in the order it gives, rather than in batches.  Routes
+   * counted under different classes never forward the same.
+   */
+  using CompressedForward = std::pair<RouteNextHopEntry, RouteClassID>;
+  template <typename AddrT>
+  using RouteCompressor = FibCompressor<AddrT, CompressedForward>;
+  struct FibCompressors {
+    RouteCompressor<folly::IPAddressV4>& get(const folly::IPAddressV4&) {
+      return v4;
+    }
+    RouteCompressor<folly::IPAddressV6>& get(const folly::IPAddressV6&) {
+      return v6;
+    }
+    RouteCompressor<folly::IPAddressV4> v4;
+    RouteCompressor<folly::IPAddressV6> v6;
+  };
+  template <typename RouteT>
+  static CompressedForward getCompressedForward(const RouteT& route);
+  template <typename RouteT>
+  using RouteLookup = std::function<std::shared_ptr<RouteT>(
+      const typename RouteT::Prefix& prefix)>;
+  template <typename RouteT>
+  using RouteChanges = std::vector<
+      std::pair<std::shared_ptr<RouteT>, std::shared_ptr<RouteT>>>;
+  /*
+   * Make the hardware changes from begin on, looking up the routes to
+   * install with lookup, until one fails for a full table.  Returns the
+   * index of the one that failed, or the number of changes.
+   */
+  template <typename RouteT>
+  size_t applyFibChanges(
+      const RouterID& id,
+      const typename RouteCompressor<typename RouteT::Addr>::Changes& changes,
+      size_t begin,
+      const RouteLookup<RouteT>& lookup);
+  template <typename RouteT>
+  void processRemovedRoutesCompressed(
+      const RouterID& id,
+      const std::vector<std::shared_ptr<RouteT>>& removed,
+      const std::shared_ptr<RouteTable>& oldTable);
+  template <typename RouteT>
+  void programCompressedRoutes(
+      const RouterID& id,
+      const RouteChanges<RouteT>& changes,
+      std::shared_ptr<SwitchState>* appliedState);
+  void publishFibCompression();
+
+  /*
+   * The added and changed routes of one address family in a VRF.  Routes in
+   * different partitions do not interact in hardware, so batched partitions
+   * may be programmed concurrently (--parallel_route_programming).
+   */
+  struct RoutePartition {
+    size_t numChanges{0};
+    // Whether program() may run on another thread, alongside other
+    // concurrent partitions
+    bool concurrent{false};
+    // Program the routes in hardware
+    std::function<void(std::mutex* sharedLock)> program;
+    // Add the new routes to the route table and revert those that failed,
+    // on the update thread once program() is done.  Returns the error that
+    // aborted program(), if any.
+    std::function<std::exception_ptr()> finish;
+    std::chrono::microseconds duration{0};
+  };
+  template <typename RouteT, typename DeltaT>
+  RoutePartition getRoutePartition(
+      const RouterID& id,
+      const DeltaT& routesDelta,
+      std::shared_ptr<SwitchState>* appliedState);
+  void programRoutePartitions(std::vector<RoutePartition>* partitions);
 
   void processAclChanges(const StateDelta& delta);
+  /*
+   * Program the ACL changes of delta as planned by the ACL table, touching
+   * only the entries that have to be added, moved, replaced or removed.
+   */
+  void processAclChangesIncrementally(const StateDelta& delta);
   void processChangedAcl(const std::shared_ptr<AclEntry>& oldAcl,
                          const std::shared_ptr<AclEntry>& newAcl);
   void processAddedAcl(const std::shared_ptr<AclEntry>& acl);
@@ -649,6 +819,17 @@ class BcmSwitch : public BcmSwitchIf {
    * Setup packet RX unless its explicitly disabled via featuresDesired_ flag
    */
   void setupPacketRx();
+  /*
+   * Register for L2 learn and age callbacks, and fill l2Table_ with the
+   * entries already learned.
+   */
+  void setupL2Learning();
+  void unregisterL2Callback();
+  static void l2AddrCallback(
+      int unit,
+      opennsl_l2_addr_t* l2addr,
+      int operation,
+      void* userdata);
 
  /*
   * Check if state, speed update for this port port would
@@ -666,6 +847,8 @@ class BcmSwitch : public BcmSwitchIf {
 
   MmuState queryMmuState() const;
   void exportDeviceBufferUsage();
+  // Publish the buffer usage last logged for the device and its queues
+  void publishBufferUsage() const;
 
   /*
    * Member variables
@@ -673,6 +856,7 @@ class BcmSwitch : public BcmSwitchIf {
   BcmPlatform* platform_{nullptr};
   Callback* callback_{nullptr};
   int unit_{-1};
+  int deviceIndex_{kOnlyDevice};
   uint32_t flags_{0};
   uint32_t featuresDesired_{PACKET_RX_DESIRED | LINKSCAN_DESIRED};
   HashMode hashMode_;
@@ -685,16 +869,26 @@ class BcmSwitch : public BcmSwitchIf {
   std::unique_ptr<BcmPortTable> portTable_;
   std::unique_ptr<BcmEgress> toCPUEgress_;
   std::unique_ptr<BcmIntfTable> intfTable_;
+  // Before the route table, so routes release their counters first
+  std::unique_ptr<BcmRouteCounterTable> routeCounterTable_;
   std::unique_ptr<BcmHostTable> hostTable_;
   std::unique_ptr<BcmRouteTable> routeTable_;
+  // The routes of each VRF, with --fib_compression
+  std::map<RouterID, FibCompressors> fibCompressors_;
   std::unique_ptr<BcmAclTable> aclTable_;
   std::unique_ptr<BcmStatUpdater> bcmStatUpdater_;
   std::unique_ptr<BcmCosManager> cosManager_;
   std::unique_ptr<BcmTableStats> bcmTableStats_;
-  std::unique_ptr<BufferStatsLogger> bufferStatsLogger_;
+  std::unique_ptr<BcmTableCapacity> tableCapacity_;
+  // Keeps the latest buffer stats logged, for counter subscriptions
+  std::unique_ptr<RecordingBufferStatsLogger> bufferStatsLogger_;
   std::unique_ptr<BcmTrunkTable> trunkTable_;
   std::unique_ptr<BcmSflowExporterTable> sFlowExporterTable_;
+  std::unique_ptr<BcmPacketTraceSampler> packetTraceSampler_;
+  // The L2 table, as of the last L2 learn and age callbacks
+  std::unique_ptr<L2TableMirror> l2Table_;
   std::unique_ptr<BcmControlPlane> controlPlane_;
+  std::unique_ptr<BcmTxPacketPool> txPacketPool_;
 
   /*
    * TODO - Right now we setup copp using logic embedded in code.
@@ -710,6 +904,6 @@ class BcmSwitch : public BcmSwitchIf {
   /*
    * Lock to synchronize access to all BCM* data structures
    */
-  std::mutex lock_;
+  mutable std::mutex lock_;
 };
 }} // facebook::fboss
@@ -0,0 +1,342 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "fboss/agent/hw/bcm/BcmTableCapacity.h"
+
+#include "common/stats/ServiceData.h"
+#include "fboss/agent/hw/bcm/BcmAclTable.h"
+#include "fboss/agent/hw/bcm/BcmHost.h"
+#include "fboss/agent/hw/bcm/BcmPlatform.h"
+#include "fboss/agent/hw/bcm/BcmRoute.h"
+#include "fboss/agent/hw/bcm/BcmSwitch.h"
+#include "fboss/agent/hw/bcm/gen-cpp2/bcmswitch_types.h"
+#include "fboss/agent/state/AclEntry.h"
+#include "fboss/agent/state/ArpEntry.h"
+#include "fboss/agent/state/DeltaFunctions.h"
+#include "fboss/agent/state/Interface.h"
+#include "fboss/agent/state/InterfaceMap.h"
+#include "fboss/agent/state/NdpEntry.h"
+#include "fboss/agent/state/Route.h"
+#include "fboss/agent/state/RouteTable.h"
+#include "fboss/agent/state/StateDelta.h"
+#include "fboss/agent/state/SwitchState.h"
+
+#include <folly/Conv.h>
+
+#include <map>
+#include <set>
+
+using facebook::fboss::DeltaFunctions::forEachAdded;
+using facebook::fboss::DeltaFunctions::forEachChanged;
+using facebook::fboss::DeltaFunctions::forEachRemoved;
+using std::shared_ptr;
+
+namespace facebook { namespace fboss {
+
+namespace {
+
+/*
+ * Works out how the host, route and ACL tables will change to program a
+ * StateDelta.
+ */
+class DemandEstimator {
+ public:
+  using Table = BcmTableCapacity::Table;
+
+  explicit DemandEstimator(const BcmSwitch* hw)
+      : hw_(hw), hostTable_(hw->getHostTable()) {
+    demand_.fill(0);
+  }
+
+  template <typename RouteT>
+  void routeChanged(
+      RouterID id,
+      const shared_ptr<RouteT>& oldRoute,
+      const shared_ptr<RouteT>& newRoute) {
+    // Only resolved routes are programmed
+    if (oldRoute && oldRoute->isResolved()) {
+      routeEntry(id, oldRoute.get(), -1);
+    }
+    if (newRoute && newRoute->isResolved()) {
+      routeEntry(id, newRoute.get(), 1);
+    }
+  }
+
+  template <typename EntryT>
+  void neighborChanged(
+      const StateDelta& delta,
+      const EntryT* oldEntry,
+      const EntryT* newEntry) {
+    if (oldEntry && !newEntry) {
+      auto key = getNeighborKey(delta.oldState(), oldEntry);
+      if (hostTable_->getReferenceCount(key) == 1) {
+        add(BcmTableCapacity::HOST, -1);
+        add(BcmTableCapacity::EGRESS, -1);
+      }
+    } else if (!oldEntry && newEntry) {
+      hostNeeded(getNeighborKey(delta.newState(), newEntry));
+    }
+  }
+
+  void aclChanged(int64_t count) {
+    add(BcmTableCapacity::ACL_ENTRIES, count);
+  }
+
+  BcmTableCapacity::Demand finish() {
+    // ECMP entries are shared by all routes with the same next hops, so they
+    // are only created or destroyed when the first route starts using them
+    // or the last stops.  The hardware group is also shared by the VRFs
+    // with the same next hops, so each set of them is only counted once.
+    std::set<RouteNextHopSet> createdGroups;
+    std::set<RouteNextHopSet> destroyedGroups;
+    for (const auto& entry : ecmpRefs_) {
+      const auto& key = entry.first;
+      int64_t refs = hostTable_->getReferenceCount(key);
+      auto newRefs = refs + entry.second;
+      int64_t created = 0;
+      if (refs == 0 && newRefs > 0) {
+        created = 1;
+        for (const auto& nhop : key.second) {
+          hostNeeded(BcmHostKey(key.first, nhop));
+        }
+      } else if (refs > 0 && newRefs <= 0) {
+        created = -1;
+      }
+      if (key.second.size() <= 1) {
+        continue;
+      }
+      if (created > 0) {
+        createdGroups.insert(key.second);
+      } else if (created < 0) {
+        destroyedGroups.insert(key.second);
+      }
+    }
+    for (const auto& nhops : createdGroups) {
+      if (!destroyedGroups.erase(nhops)) {
+        ecmpGroup(nhops, 1);
+      }
+    }
+    for (const auto& nhops : destroyedGroups) {
+      ecmpGroup(nhops, -1);
+    }
+    return demand_;
+  }
+
+ private:
+  template <typename RouteT>
+  void routeEntry(RouterID id, const RouteT* route, int64_t count) {
+    auto vrf = BcmSwitch::getBcmVrfId(id);
+    const auto& prefix = route->prefix();
+    auto isHostRoute = prefix.mask == prefix.network.bitCount();
+    if (isHostRoute &&
+        hw_->getPlatform()->canUseHostTableForHostRoutes()) {
+      add(BcmTableCapacity::HOST, count);
+    } else if (prefix.network.isV4()) {
+      add(BcmTableCapacity::LPM_V4, count);
+    } else if (prefix.mask <= 64) {
+      add(BcmTableCapacity::LPM_V6_MASK_0_64, count);
+    } else {
+      add(BcmTableCapacity::LPM_V6_MASK_65_127, count);
+    }
+
+    const auto& fwd = route->getForwardInfo();
+    if (fwd.getAction() != RouteForwardAction::NEXTHOPS) {
+      return;
+    }
+    auto nhops = BcmRouteTable::normalizeNextHops(fwd.getNextHopSet());
+    ecmpRefs_[BcmEcmpHostKey(vrf, std::move(nhops))] += count;
+  }
+
+  template <typename EntryT>
+  BcmHostKey getNeighborKey(
+      const shared_ptr<SwitchState>& state,
+      const EntryT* entry) const {
+    auto intf = state->getInterfaces()->getInterface(entry->getIntfID());
+    return BcmHostKey(
+        BcmSwitch::getBcmVrfId(intf->getRouterID()),
+        folly::IPAddress(entry->getIP()),
+        entry->getIntfID());
+  }
+
+  void hostNeeded(const BcmHostKey& key) {
+    if (!hostTable_->getBcmHostIf(key) && newHosts_.insert(key).second) {
+      add(BcmTableCapacity::HOST, 1);
+      add(BcmTableCapacity::EGRESS, 1);
+    }
+  }
+
+  void ecmpGroup(const RouteNextHopSet& nhops, int64_t count) {
+    add(BcmTableCapacity::ECMP_GROUPS, count);
+    add(
+        BcmTableCapacity::ECMP_MEMBERS,
+        count * static_cast<int64_t>(nhops.size()));
+  }
+
+  void add(Table table, int64_t count) {
+    demand_[table] += count;
+  }
+
+  const BcmSwitch* hw_;
+  const BcmHostTable* hostTable_;
+  BcmTableCapacity::Demand demand_;
+  // The change in references to each ECMP entry
+  std::map<BcmEcmpHostKey, int64_t> ecmpRefs_;
+  // Host entries the delta creates
+  std::set<BcmHostKey> newHosts_;
+};
+
+int64_t getMax(int32_t max) {
+  return max == STAT_UNINITIALIZED ? -1 : max;
+}
+
+} // unnamed namespace
+
+const char* BcmTableCapacity::getName(Table table) {
+  switch (table) {
+    case LPM_V4:
+      return "lpm_ipv4";
+    case LPM_V6_MASK_0_64:
+      return "lpm_ipv6_mask_0_64";
+    case LPM_V6_MASK_65_127:
+      return "lpm_ipv6_mask_65_127";
+    case HOST:
+      return "l3_host";
+    case EGRESS:
+      return "l3_nexthops";
+    case ECMP_GROUPS:
+      return "l3_ecmp_groups";
+    case ECMP_MEMBERS:
+      return "l3_ecmp_members";
+    case ACL_ENTRIES:
+      return "acl_entries";
+    case ACL_RANGE_CHECKERS:
+      return "acl_range_checkers";
+    case NUM_TABLES:
+      break;
+  }
+  return "unknown";
+}
+
+BcmTableCapacity::Usages BcmTableCapacity::getUsages(
+    const BcmHwTableStats& stats) const {
+  const auto* hostTable = hw_->getHostTable();
+  const auto* routeTable = hw_->getRouteTable();
+  Usages usages;
+  usages[LPM_V4].used = routeTable->numLpmRoutesV4();
+  usages[LPM_V4].max = getMax(stats.lpm_ipv4_max);
+  usages[LPM_V6_MASK_0_64].used = routeTable->numLpmRoutesV6Mask0To64();
+  usages[LPM_V6_MASK_0_64].max = getMax(stats.lpm_ipv6_mask_0_64_max);
+  usages[LPM_V6_MASK_65_127].used = routeTable->numLpmRoutesV6Mask65To127();
+  usages[LPM_V6_MASK_65_127].max = getMax(stats.lpm_ipv6_mask_65_127_max);
+  usages[HOST].used = hostTable->numHosts();
+  usages[HOST].max = getMax(stats.l3_host_max);
+  usages[EGRESS].used = hostTable->numEgress();
+  usages[EGRESS].max = getMax(stats.l3_nexthops_max);
+  usages[ECMP_GROUPS].used = hostTable->numEcmpEgress();
+  usages[ECMP_GROUPS].max = getMax(stats.l3_ecmp_groups_max);
+  // The size of the ECMP member table is not in the table stats
+  usages[ECMP_MEMBERS].used = hostTable->numEcmpMembers();
+  usages[ACL_ENTRIES].used = hw_->getAclTable()->getAclEntryCount();
+  usages[ACL_ENTRIES].max = getMax(stats.acl_entries_max);
+  // Nor is the number of range checkers
+  usages[ACL_RANGE_CHECKERS].used = hw_->getAclTable()->getAclRangeCount();
+  return usages;
+}
+
+BcmTableCapacity::Demand BcmTableCapacity::getDemand(
+    const StateDelta& delta) const {
+  DemandEstimator estimator(hw_);
+  for (const auto& rtDelta : delta.getRouteTablesDelta()) {
+    auto id = rtDelta.getOld() ? rtDelta.getOld()->getID()
+                               : rtDelta.getNew()->getID();
+    forEachChanged(
+        rtDelta.getRoutesV4Delta(),
+        [&](const shared_ptr<RouteV4>& oldRoute,
+            const shared_ptr<RouteV4>& newRoute) {
+          estimator.routeChanged(id, oldRoute, newRoute);
+        },
+        [&](const shared_ptr<RouteV4>& newRoute) {
+          estimator.routeChanged<RouteV4>(id, nullptr, newRoute);
+        },
+        [&](const shared_ptr<RouteV4>& oldRoute) {
+          estimator.routeChanged<RouteV4>(id, oldRoute, nullptr);
+        });
+    forEachChanged(
+        rtDelta.getRoutesV6Delta(),
+        [&](const shared_ptr<RouteV6>& oldRoute,
+            const shared_ptr<RouteV6>& newRoute) {
+          estimator.routeChanged(id, oldRoute, newRoute);
+        },
+        [&](const shared_ptr<RouteV6>& newRoute) {
+          estimator.routeChanged<RouteV6>(id, nullptr, newRoute);
+        },
+        [&](const shared_ptr<RouteV6>& oldRoute) {
+          estimator.routeChanged<RouteV6>(id, oldRoute, nullptr);
+        });
+  }
+
+  for (const auto& vlanDelta : delta.getVlansDelta()) {
+    for (const auto& arpDelta : vlanDelta.getArpDelta()) {
+      estimator.neighborChanged(
+          delta, arpDelta.getOld().get(), arpDelta.getNew().get());
+    }
+    for (const auto& ndpDelta : vlanDelta.getNdpDelta()) {
+      estimator.neighborChanged(
+          delta, ndpDelta.getOld().get(), ndpDelta.getNew().get());
+    }
+  }
+
+  forEachAdded(delta.getAclsDelta(), [&](const shared_ptr<AclEntry>&) {
+    estimator.aclChanged(1);
+  });
+  forEachRemoved(delta.getAclsDelta(), [&](const shared_ptr<AclEntry>&) {
+    estimator.aclChanged(-1);
+  });
+  return estimator.finish();
+}
+
+folly::Optional<BcmTableCapacity::Table> BcmTableCapacity::getOverflow(
+    const StateDelta& delta,
+    const BcmHwTableStats& stats) const {
+  return getOverflow(getUsages(stats), getDemand(delta));
+}
+
+folly::Optional<BcmTableCapacity::Table> BcmTableCapacity::getOverflow(
+    const Usages& usages,
+    const Demand& demand) {
+  for (int i = 0; i < NUM_TABLES; ++i) {
+    const auto& usage = usages[i];
+    // Only reject updates that make a table fuller, so that a table that is
+    // already over its size (for example from entries we do not count) can
+    // still be drained.
+    if (usage.max >= 0 && demand[i] > 0 &&
+        usage.used + demand[i] > usage.max) {
+      return static_cast<Table>(i);
+    }
+  }
+  return folly::none;
+}
+
+void BcmTableCapacity::publish(const BcmHwTableStats& stats) const {
+  auto usages = getUsages(stats);
+  for (int i = 0; i < NUM_TABLES; ++i) {
+    auto prefix = folly::to<std::string>(
+        "hw_table.", getName(static_cast<Table>(i)));
+    fbData->setCounter(prefix + ".used", usages[i].used);
+    if (usages[i].max >= 0) {
+      fbData->setCounter(prefix + ".free", usages[i].free());
+    }
+  }
+  // The ranges that did not need a range checker
+  fbData->setCounter(
+      "hw_table.acl_ranges.masked",
+      hw_->getAclTable()->getAclMaskedRangeCount());
+}
+
+}} // facebook::fboss
@@ -0,0 +1,93 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#pragma once
+
+#include <folly/Optional.h>
+
+#include <array>
+#include <cstdint>
+
+namespace facebook { namespace fboss {
+
+class BcmHwTableStats;
+class BcmSwitch;
+class StateDelta;
+
+/*
+ * BcmTableCapacity models how full the hardware tables are, from the
+ * entries the host, route and ACL tables keep count of as they program
+ * them.  It is used to reject a state update that would overflow a table
+ * before any of it is programmed, rather than failing part of the way
+ * through.
+ *
+ * The size of each table comes from the hardware table stats.  A table of
+ * unknown size is never considered full.
+ */
+class BcmTableCapacity {
+ public:
+  enum Table {
+    LPM_V4,
+    LPM_V6_MASK_0_64,
+    LPM_V6_MASK_65_127,
+    HOST,
+    EGRESS,
+    ECMP_GROUPS,
+    ECMP_MEMBERS,
+    ACL_ENTRIES,
+    ACL_RANGE_CHECKERS,
+    NUM_TABLES,
+  };
+
+  struct Usage {
+    int64_t used{0};
+    // Negative if not known
+    int64_t max{-1};
+    int64_t free() const {
+      return max < 0 ? -1 : max - used;
+    }
+  };
+  using Usages = std::array<Usage, NUM_TABLES>;
+  // The change in the number of entries of each table
+  using Demand = std::array<int64_t, NUM_TABLES>;
+
+  explicit BcmTableCapacity(const BcmSwitch* hw) : hw_(hw) {}
+
+  static const char* getName(Table table);
+
+  Usages getUsages(const BcmHwTableStats& stats) const;
+
+  /*
+   * Estimate how many entries the delta adds to, or removes from, each
+   * table.  This errs on the side of more entries where sharing of host
+   * and ECMP entries can not be worked out from the delta alone.
+   */
+  Demand getDemand(const StateDelta& delta) const;
+
+  /*
+   * Returns the first table the delta would overflow, if any.
+   */
+  folly::Optional<Table> getOverflow(
+      const StateDelta& delta,
+      const BcmHwTableStats& stats) const;
+  static folly::Optional<Table> getOverflow(
+      const Usages& usages,
+      const Demand& demand);
+
+  void publish(const BcmHwTableStats& stats) const;
+
+ private:
+  // Forbidden copy constructor and assignment operator
+  BcmTableCapacity(BcmTableCapacity const &) = delete;
+  BcmTableCapacity& operator=(BcmTableCapacity const &) = delete;
+
+  const BcmSwitch* hw_{nullptr};
+};
+
+}} // facebook::fboss
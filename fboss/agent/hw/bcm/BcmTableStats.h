@@ -27,6 +27,9 @@ class BcmTableStats {
     }
   }
   void publish() const;
+  const BcmHwTableStats& getHwTableStats() const {
+    return stats_;
+  }
 
  private:
   bool refreshHwStatusStats();
@@ -40,6 +40,10 @@ class BcmTrunk {
   void program(
       const std::shared_ptr<AggregatePort>& oldAggPort,
       const std::shared_ptr<AggregatePort>& newAggPort);
+  // Enable or disable forwarding over one member port only
+  void programMemberForwarding(PortID memberPort, bool enable) {
+    modifyMemberPort(enable, memberPort);
+  }
 
   static void shrinkTrunkGroupHwNotLocked(
       int unit,
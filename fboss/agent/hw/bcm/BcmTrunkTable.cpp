@@ -16,11 +16,14 @@ extern "C" {
 #include "BcmSwitch.h"
 #include "BcmTrunk.h"
 
+#include <folly/Optional.h>
 #include <folly/logging/xlog.h>
 #include "fboss/agent/FbossError.h"
 #include "fboss/agent/hw/bcm/BcmError.h"
 #include "fboss/agent/state/AggregatePort.h"
 
+#include <algorithm>
+
 namespace facebook {
 namespace fboss {
 
@@ -70,7 +73,10 @@ void BcmTrunkTable::programTrunk(
         ": no corresponding trunk");
   }
 
-  it->second->program(oldAggPort, newAggPort);
+  auto oldPort = oldAggPort;
+  auto newPort = newAggPort;
+  applyMemberFwdOverrides(&oldPort, &newPort);
+  it->second->program(oldPort, newPort);
   trunkToMinLinkCount_.addOrUpdate(
       it->second->id(), newAggPort->getMinimumLinkCount());
 }
@@ -87,6 +93,84 @@ void BcmTrunkTable::deleteTrunk(const std::shared_ptr<AggregatePort>& aggPort) {
   auto trunkID = it->second->id();
   trunks_.erase(it);
   trunkToMinLinkCount_.del(trunkID);
+
+  auto begin = memberFwdOverrides_.lower_bound({aggPort->getID(), PortID(0)});
+  auto end = std::find_if(begin, memberFwdOverrides_.end(), [&](auto& o) {
+    return o.first.first != aggPort->getID();
+  });
+  memberFwdOverrides_.erase(begin, end);
+}
+
+bool BcmTrunkTable::setMemberForwarding(
+    AggregatePortID aggPort,
+    PortID memberPort,
+    bool enable) {
+  auto it = trunks_.find(aggPort);
+  if (it == trunks_.end()) {
+    return false;
+  }
+  try {
+    it->second->programMemberForwarding(memberPort, enable);
+  } catch (const std::exception& ex) {
+    XLOG(ERR) << "Failed to " << (enable ? "enable" : "disable")
+              << " forwarding over member " << memberPort
+              << " of aggregate port " << aggPort << ": "
+              << folly::exceptionStr(ex);
+    return false;
+  }
+  memberFwdOverrides_[std::make_pair(aggPort, memberPort)] = enable
+      ? AggregatePort::Forwarding::ENABLED
+      : AggregatePort::Forwarding::DISABLED;
+  return true;
+}
+
+void BcmTrunkTable::applyMemberFwdOverrides(
+    std::shared_ptr<AggregatePort>* oldAggPort,
+    std::shared_ptr<AggregatePort>* newAggPort) {
+  auto getFwdState = [](const std::shared_ptr<AggregatePort>& aggPort,
+                        PortID member) {
+    folly::Optional<AggregatePort::Forwarding> fwd;
+    for (const auto& memberAndFwd : aggPort->subportAndFwdState()) {
+      if (memberAndFwd.first == member) {
+        fwd = memberAndFwd.second;
+      }
+    }
+    return fwd;
+  };
+
+  auto id = (*oldAggPort)->getID();
+  std::shared_ptr<AggregatePort> patchedOld;
+  std::shared_ptr<AggregatePort> patchedNew;
+  auto it = memberFwdOverrides_.lower_bound({id, PortID(0)});
+  while (it != memberFwdOverrides_.end() && it->first.first == id) {
+    auto member = it->first.second;
+    auto fwd = it->second;
+    // The hardware already has the member in this forwarding state
+    if (getFwdState(*oldAggPort, member)) {
+      if (!patchedOld) {
+        patchedOld = (*oldAggPort)->clone();
+      }
+      patchedOld->setForwardingState(member, fwd);
+    }
+    auto newFwd = getFwdState(*newAggPort, member);
+    if (newFwd && *newFwd != fwd) {
+      // The state update recording the change is still to come, so keep
+      // the member as it is
+      if (!patchedNew) {
+        patchedNew = (*newAggPort)->clone();
+      }
+      patchedNew->setForwardingState(member, fwd);
+      ++it;
+    } else {
+      it = memberFwdOverrides_.erase(it);
+    }
+  }
+  if (patchedOld) {
+    *oldAggPort = patchedOld;
+  }
+  if (patchedNew) {
+    *newAggPort = patchedNew;
+  }
 }
 
 /* 1. If opennsl_trunk_t == INVALID, then
@@ -19,12 +19,12 @@ extern "C" {
 #include <folly/dynamic.h>
 
 #include "fboss/agent/hw/bcm/MinimumLinkCountMap.h"
+#include "fboss/agent/state/AggregatePort.h"
 #include "fboss/agent/types.h"
 
 namespace facebook {
 namespace fboss {
 
-class AggregatePort;
 class BcmSwitch;
 class BcmTrunk;
 
@@ -41,6 +41,19 @@ class BcmTrunkTable {
       const std::shared_ptr<AggregatePort>& newAggPort);
   void deleteTrunk(const std::shared_ptr<AggregatePort>& aggPort);
 
+  /*
+   * Enable or disable forwarding over a member port ahead of the state
+   * update that records it.  Until a state update has the member in that
+   * forwarding state, programTrunk() keeps it as it is.  Also requires the
+   * HW update lock.
+   *
+   * @return false if there is no such trunk, or it could not be programmed.
+   */
+  bool setMemberForwarding(
+      AggregatePortID aggPort,
+      PortID memberPort,
+      bool enable);
+
   opennsl_trunk_t getBcmTrunkId(AggregatePortID id) const {
     return static_cast<opennsl_trunk_t>(id);
   }
@@ -68,10 +81,21 @@ class BcmTrunkTable {
   // Setup trunking machinery
   void setupTrunking();
 
+  void applyMemberFwdOverrides(
+      std::shared_ptr<AggregatePort>* oldAggPort,
+      std::shared_ptr<AggregatePort>* newAggPort);
+
   // State that stores if the BCM trunk has been initialized.
   bool isBcmHWTrunkInitialized_ = false;
 
   TrunkToMinimumLinkCountMap trunkToMinLinkCount_;
+
+  // Forwarding states programmed by setMemberForwarding() that no state
+  // update has caught up with yet
+  boost::container::flat_map<
+      std::pair<AggregatePortID, PortID>,
+      AggregatePort::Forwarding>
+      memberFwdOverrides_;
 };
 }
 } // namespace facebook::fboss
@@ -23,13 +23,32 @@ namespace {
 
 using namespace facebook::fboss;
 
-void freeTxBuf(void* /*ptr*/, void* arg) {
+void freeTxBuf(void* ptr, void* arg) {
   opennsl_pkt_t* pkt = reinterpret_cast<opennsl_pkt_t*>(arg);
+  // The data may start in the headroom if the packet was never sent
+  pkt->pkt_data->data = static_cast<uint8_t*>(ptr);
   int rv = opennsl_pkt_free(pkt->unit, pkt);
   bcmLogError(rv, "Failed to free packet");
   BcmStats::get()->txPktFree();
 }
 
+void recycleTxBuf(void* /*ptr*/, void* arg) {
+  BcmTxPacketPool::put(reinterpret_cast<BcmTxPacketPool::Buffer*>(arg));
+}
+
+void txBatchCallback(int /*unit*/, opennsl_pkt_t* /*pkt*/, void* cookie) {
+  // Delete the packets of the batch when we return
+  unique_ptr<std::vector<unique_ptr<BcmTxPacket>>> batch(
+      static_cast<std::vector<unique_ptr<BcmTxPacket>>*>(cookie));
+  auto end = std::chrono::steady_clock::now();
+  for (auto& bcmTxPkt : *batch) {
+    bcmTxPkt->getPkt()->pkt_data->data = bcmTxPkt->buf()->writableBuffer();
+    auto duration = std::chrono::duration_cast<std::chrono::microseconds>(
+        end - bcmTxPkt->getQueueTime());
+    BcmStats::get()->txSentDone(duration.count());
+  }
+}
+
 void txCallback(int /*unit*/, opennsl_pkt_t* pkt, void* cookie) {
   // Put the BcmTxPacket back into a unique_ptr.
   // This will delete it when we return.
@@ -60,6 +79,14 @@ BcmTxPacket::BcmTxPacket(int unit, uint32_t size)
   BcmStats::get()->txPktAlloc();
 }
 
+BcmTxPacket::BcmTxPacket(BcmTxPacketPool::Buffer* buffer, uint32_t size)
+    : pkt_(buffer->pkt),
+      queued_(std::chrono::time_point<std::chrono::steady_clock>::min()) {
+  buf_ = IOBuf::takeOwnership(pkt_->pkt_data->data, buffer->sizeClass->size,
+                              size, recycleTxBuf,
+                              reinterpret_cast<void*>(buffer));
+}
+
 void BcmTxPacket::enableHiGigHeader() {
   // this is a hack, as ideally, we just want to reset TX_ETHER flag, but
   // opennsl does not have api to read flags and set or reset bits
@@ -71,31 +98,66 @@ int BcmTxPacket::sendAsync(unique_ptr<BcmTxPacket> pkt) noexcept {
   opennsl_pkt_t* bcmPkt = pkt->pkt_;
   DCHECK(bcmPkt->call_back == nullptr);
   bcmPkt->call_back = txCallback;
-  const auto buf = pkt->buf();
+  pkt->prepareToSend();
+  auto rv = opennsl_tx(bcmPkt->unit, bcmPkt, pkt.get());
+  if (OPENNSL_SUCCESS(rv)) {
+    pkt.release();
+    BcmStats::get()->txSent();
+  } else {
+    sendFailed(rv);
+  }
+  return rv;
+}
+
+int BcmTxPacket::sendAsyncBatch(
+    std::vector<unique_ptr<BcmTxPacket>> pkts) noexcept {
+  if (pkts.empty()) {
+    return OPENNSL_E_NONE;
+  }
+  std::vector<opennsl_pkt_t*> bcmPkts;
+  bcmPkts.reserve(pkts.size());
+  for (auto& pkt : pkts) {
+    DCHECK(pkt->pkt_->call_back == nullptr);
+    pkt->prepareToSend();
+    bcmPkts.push_back(pkt->pkt_);
+  }
+  auto unit = bcmPkts.front()->unit;
+  auto batch =
+      std::make_unique<std::vector<unique_ptr<BcmTxPacket>>>(std::move(pkts));
+  auto rv = opennsl_tx_array(
+      unit, bcmPkts.data(), bcmPkts.size(), txBatchCallback, batch.get());
+  if (OPENNSL_SUCCESS(rv)) {
+    // txBatchCallback() deletes the batch once it is sent
+    batch.release();
+    BcmStats::get()->txBatchSent(bcmPkts.size());
+  } else {
+    sendFailed(rv);
+  }
+  return rv;
+}
+
+void BcmTxPacket::prepareToSend() {
+  const auto buf = this->buf();
 
   // TODO(aeckert): Setting the pkt len manually should be replaced in future
   // releases of opennsl with OPENNSL_PKT_TX_LEN_SET or opennsl_flags_len_setup
-  DCHECK(bcmPkt->pkt_data);
-  bcmPkt->pkt_data->len = buf->length();
+  DCHECK(pkt_->pkt_data);
+  pkt_->pkt_data->len = buf->length();
 
   // Now we also set the buffer that will be sent out to point at
   // buf->writableBuffer in case there is unused header space in the IOBuf
-  bcmPkt->pkt_data->data = buf->writableData();
+  pkt_->pkt_data->data = buf->writableData();
 
-  pkt->queued_ = std::chrono::steady_clock::now();
-  auto rv = opennsl_tx(bcmPkt->unit, bcmPkt, pkt.get());
-  if (OPENNSL_SUCCESS(rv)) {
-    pkt.release();
-    BcmStats::get()->txSent();
-  } else {
-    bcmLogError(rv, "failed to send packet");
-    if (rv == OPENNSL_E_MEMORY) {
-      BcmStats::get()->txPktAllocErrors();
-    } else if (rv) {
-      BcmStats::get()->txError();
-    }
+  queued_ = std::chrono::steady_clock::now();
+}
+
+void BcmTxPacket::sendFailed(int rv) noexcept {
+  bcmLogError(rv, "failed to send packet");
+  if (rv == OPENNSL_E_MEMORY) {
+    BcmStats::get()->txPktAllocErrors();
+  } else if (rv) {
+    BcmStats::get()->txError();
   }
-  return rv;
 }
 
 }} // facebook::fboss
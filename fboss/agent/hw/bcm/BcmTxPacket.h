@@ -10,8 +10,11 @@
 #pragma once
 
 #include <chrono>
+#include <memory>
+#include <vector>
 
 #include "fboss/agent/TxPacket.h"
+#include "fboss/agent/hw/bcm/BcmTxPacketPool.h"
 
 extern "C" {
 #include <opennsl/pkt.h>
@@ -23,6 +26,11 @@ namespace facebook { namespace fboss {
 class BcmTxPacket : public TxPacket {
  public:
   BcmTxPacket(int unit, uint32_t size);
+  /*
+   * Use a packet from the BcmTxPacketPool, which the packet data gives back
+   * to the pool once it is freed.
+   */
+  BcmTxPacket(BcmTxPacketPool::Buffer* buffer, uint32_t size);
 
   opennsl_pkt_t* getPkt() {
     return pkt_;
@@ -58,12 +66,25 @@ class BcmTxPacket : public TxPacket {
    */
   static int sendAsync(std::unique_ptr<BcmTxPacket> pkt) noexcept;
 
+  /*
+   * Send a burst of packets asynchronously with one call to the SDK, which
+   * calls back once when all of them are sent.  Takes ownership of the
+   * packets as sendAsync() does.
+   *
+   * Returns an OpenNSL error code.
+   */
+  static int sendAsyncBatch(
+      std::vector<std::unique_ptr<BcmTxPacket>> pkts) noexcept;
+
 
  private:
   // Forbidden copy constructor and assignment operator
   BcmTxPacket(BcmTxPacket const &) = delete;
   BcmTxPacket& operator=(BcmTxPacket const &) = delete;
   void enableHiGigHeader();
+  // Point the SDK packet at the data to send, and note the time
+  void prepareToSend();
+  static void sendFailed(int rv) noexcept;
 
   opennsl_pkt_t* pkt_{nullptr};
 
@@ -0,0 +1,116 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "fboss/agent/hw/bcm/BcmTxPacketPool.h"
+
+#include "fboss/agent/hw/bcm/BcmError.h"
+#include "fboss/agent/hw/bcm/BcmStats.h"
+
+#include <folly/logging/xlog.h>
+
+#include <algorithm>
+
+extern "C" {
+#include <opennsl/tx.h>
+}
+
+namespace facebook { namespace fboss {
+
+BcmTxPacketPool::BcmTxPacketPool(
+    int unit,
+    const std::vector<uint32_t>& sizes,
+    uint32_t numBuffers) {
+  auto sorted = sizes;
+  std::sort(sorted.begin(), sorted.end());
+  for (auto size : sorted) {
+    auto sizeClass = std::make_shared<SizeClass>(size, numBuffers);
+    for (uint32_t i = 0; i < numBuffers; ++i) {
+      auto buffer = std::make_unique<Buffer>();
+      int rv = opennsl_pkt_alloc(unit, size,
+          OPENNSL_TX_CRC_APPEND | OPENNSL_TX_ETHER, &buffer->pkt);
+      if (OPENNSL_FAILURE(rv)) {
+        // The DMA pool may be too small for all of them.  Make do with the
+        // buffers we have.
+        bcmLogError(rv, "Failed to allocate packet of ", size,
+            " bytes for the TX packet pool");
+        break;
+      }
+      BcmStats::get()->txPktAlloc();
+      buffer->initial = *buffer->pkt;
+      buffer->data = buffer->pkt->pkt_data->data;
+      buffer->len = buffer->pkt->pkt_data->len;
+      buffer->sizeClass = sizeClass;
+      sizeClass->free.write(buffer.release());
+    }
+    XLOG(DBG1) << "TX packet pool has " << sizeClass->free.size()
+               << " packets of " << size << " bytes";
+    sizeClasses_.push_back(std::move(sizeClass));
+  }
+}
+
+BcmTxPacketPool::~BcmTxPacketPool() {
+  for (auto& sizeClass : sizeClasses_) {
+    sizeClass->closed = true;
+    Buffer* buffer;
+    while (sizeClass->free.read(buffer)) {
+      freeBuffer(buffer);
+    }
+  }
+}
+
+BcmTxPacketPool::Buffer* BcmTxPacketPool::get(uint32_t size) {
+  auto sizeClass = std::find_if(
+      sizeClasses_.begin(), sizeClasses_.end(), [=](const auto& sc) {
+        return sc->size >= size;
+      });
+  if (sizeClass == sizeClasses_.end()) {
+    BcmStats::get()->txPktPoolMiss();
+    return nullptr;
+  }
+  Buffer* buffer;
+  if (!(*sizeClass)->free.read(buffer)) {
+    BcmStats::get()->txPktPoolExhausted();
+    return nullptr;
+  }
+  BcmStats::get()->txPktPoolHit();
+  return buffer;
+}
+
+void BcmTxPacketPool::put(Buffer* buffer) {
+  reset(buffer);
+  // Keep the size class alive while we are putting the buffer back
+  auto sizeClass = buffer->sizeClass;
+  if (sizeClass->closed || !sizeClass->free.write(buffer)) {
+    freeBuffer(buffer);
+    return;
+  }
+  // The pool may have been destroyed while we put the buffer back, after
+  // it freed the others.  Free whatever it left behind.
+  if (sizeClass->closed) {
+    while (sizeClass->free.read(buffer)) {
+      freeBuffer(buffer);
+    }
+  }
+}
+
+void BcmTxPacketPool::reset(Buffer* buffer) {
+  *buffer->pkt = buffer->initial;
+  buffer->pkt->pkt_data->data = buffer->data;
+  buffer->pkt->pkt_data->len = buffer->len;
+}
+
+void BcmTxPacketPool::freeBuffer(Buffer* buffer) {
+  reset(buffer);
+  int rv = opennsl_pkt_free(buffer->pkt->unit, buffer->pkt);
+  bcmLogError(rv, "Failed to free packet");
+  BcmStats::get()->txPktFree();
+  delete buffer;
+}
+
+}} // facebook::fboss
@@ -0,0 +1,90 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#pragma once
+
+#include <folly/MPMCQueue.h>
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+extern "C" {
+#include <opennsl/pkt.h>
+}
+
+namespace facebook { namespace fboss {
+
+/*
+ * BcmTxPacketPool keeps SDK packets, with their DMA buffers, allocated up
+ * front in a few size classes, so that sending a packet does not have to
+ * allocate one from the SDK and free it again once it is sent.
+ *
+ * A packet is taken from the smallest class it fits in, and is put back
+ * when the last IOBuf referring to its buffer goes away, which may be on
+ * the TX completion thread.  Both are lock free.  A packet that fits no
+ * class, or whose class has none left, is allocated from the SDK as before.
+ */
+class BcmTxPacketPool {
+ public:
+  struct SizeClass;
+
+  struct Buffer {
+    opennsl_pkt_t* pkt{nullptr};
+    // The packet as it was allocated, to reset it to when it is reused
+    opennsl_pkt_t initial;
+    // The DMA buffer as it was allocated.  Sending a packet with headroom
+    // moves the start of its data, which would otherwise stay moved.
+    uint8_t* data{nullptr};
+    int len{0};
+    std::shared_ptr<SizeClass> sizeClass;
+  };
+
+  /*
+   * Allocates numBuffers packets of each of the sizes.
+   */
+  BcmTxPacketPool(
+      int unit,
+      const std::vector<uint32_t>& sizes,
+      uint32_t numBuffers);
+  ~BcmTxPacketPool();
+
+  /*
+   * Returns a reset packet of at least size bytes, or nullptr if there is
+   * none.  The buffer must be given back with put().
+   */
+  Buffer* get(uint32_t size);
+  static void put(Buffer* buffer);
+
+ private:
+  // Forbidden copy constructor and assignment operator
+  BcmTxPacketPool(BcmTxPacketPool const &) = delete;
+  BcmTxPacketPool& operator=(BcmTxPacketPool const &) = delete;
+
+  static void reset(Buffer* buffer);
+  static void freeBuffer(Buffer* buffer);
+
+  // Sorted by size
+  std::vector<std::shared_ptr<SizeClass>> sizeClasses_;
+};
+
+/*
+ * The free buffers of one size.  Buffers that are out when the pool is
+ * destroyed keep this alive, and are freed rather than put back.
+ */
+struct BcmTxPacketPool::SizeClass {
+  SizeClass(uint32_t size, uint32_t numBuffers)
+      : size(size), free(numBuffers) {}
+
+  const uint32_t size;
+  folly::MPMCQueue<Buffer*> free;
+  std::atomic<bool> closed{false};
+};
+
+}} // facebook::fboss
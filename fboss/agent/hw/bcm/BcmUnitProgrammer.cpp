@@ -0,0 +1,179 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "fboss/agent/hw/bcm/BcmUnitProgrammer.h"
+
+#include "fboss/agent/hw/bcm/BcmStats.h"
+#include "fboss/agent/state/StateDelta.h"
+#include "fboss/agent/state/SwitchState.h"
+
+#include <folly/Conv.h>
+#include <folly/logging/xlog.h>
+#include <folly/system/ThreadName.h>
+
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <thread>
+
+using std::chrono::duration_cast;
+using std::chrono::microseconds;
+using std::chrono::steady_clock;
+
+namespace facebook { namespace fboss {
+
+struct BcmUnitProgrammer::UnitThread {
+  UnitThread(int unit, ProgramFn program)
+      : unit(unit), program(std::move(program)) {}
+
+  const int unit;
+  const ProgramFn program;
+
+  std::mutex lock;
+  std::condition_variable cv;
+  // The delta to program next, and whether the last one is done
+  const StateDelta* delta{nullptr};
+  bool done{false};
+  bool stop{false};
+  // The outcome of the last delta
+  std::shared_ptr<SwitchState> applied;
+  std::exception_ptr error;
+  microseconds duration{0};
+
+  std::thread thread;
+};
+
+BcmUnitProgrammer::BcmUnitProgrammer(std::vector<Unit> units) {
+  for (auto& unit : units) {
+    units_.push_back(
+        std::make_unique<UnitThread>(unit.unit, std::move(unit.program)));
+    auto* unitThread = units_.back().get();
+    unitThread->thread = std::thread([unitThread] { runUnit(unitThread); });
+  }
+}
+
+BcmUnitProgrammer::~BcmUnitProgrammer() {
+  for (auto& unit : units_) {
+    {
+      std::lock_guard<std::mutex> guard(unit->lock);
+      unit->stop = true;
+    }
+    unit->cv.notify_all();
+    unit->thread.join();
+  }
+}
+
+void BcmUnitProgrammer::runUnit(UnitThread* unit) {
+  folly::setThreadName(folly::to<std::string>("bcmUnit", unit->unit));
+  std::unique_lock<std::mutex> guard(unit->lock);
+  while (true) {
+    unit->cv.wait(guard, [unit] { return unit->stop || unit->delta; });
+    if (unit->stop) {
+      return;
+    }
+    const auto* delta = unit->delta;
+    guard.unlock();
+
+    std::shared_ptr<SwitchState> applied;
+    std::exception_ptr error;
+    auto begin = steady_clock::now();
+    try {
+      applied = unit->program(*delta);
+    } catch (...) {
+      error = std::current_exception();
+    }
+    auto duration = duration_cast<microseconds>(steady_clock::now() - begin);
+    BcmStats::get()->unitStateUpdated(unit->unit, duration);
+
+    guard.lock();
+    unit->applied = std::move(applied);
+    unit->error = error;
+    unit->duration = duration;
+    unit->delta = nullptr;
+    unit->done = true;
+    unit->cv.notify_all();
+  }
+}
+
+void BcmUnitProgrammer::programUnits(const Work& work) {
+  for (const auto& unitAndDelta : work) {
+    auto* unit = unitAndDelta.first;
+    {
+      std::lock_guard<std::mutex> guard(unit->lock);
+      unit->delta = unitAndDelta.second;
+      unit->done = false;
+    }
+    unit->cv.notify_all();
+  }
+  for (const auto& unitAndDelta : work) {
+    auto* unit = unitAndDelta.first;
+    std::unique_lock<std::mutex> guard(unit->lock);
+    unit->cv.wait(guard, [unit] { return unit->done; });
+  }
+}
+
+std::shared_ptr<SwitchState> BcmUnitProgrammer::stateChanged(
+    const StateDelta& delta) {
+  Work work;
+  for (auto& unit : units_) {
+    work.emplace_back(unit.get(), &delta);
+  }
+  programUnits(work);
+  for (auto& unit : units_) {
+    if (unit->error) {
+      std::rethrow_exception(unit->error);
+    }
+  }
+
+  auto applied = delta.newState();
+  for (auto& unit : units_) {
+    if (unit->applied != delta.newState()) {
+      applied = unit->applied;
+      break;
+    }
+  }
+  if (applied == delta.newState()) {
+    return applied;
+  }
+
+  // Bring the units that applied something else back to the state we return
+  std::vector<std::unique_ptr<StateDelta>> reverts;
+  work.clear();
+  for (auto& unit : units_) {
+    if (unit->applied != applied) {
+      XLOG(WARNING) << "reverting unit " << unit->unit
+                    << " to the state applied by the other units";
+      reverts.push_back(std::make_unique<StateDelta>(unit->applied, applied));
+      work.emplace_back(unit.get(), reverts.back().get());
+    }
+  }
+  programUnits(work);
+  for (const auto& unitAndDelta : work) {
+    auto* unit = unitAndDelta.first;
+    if (unit->error) {
+      std::rethrow_exception(unit->error);
+    }
+    if (unit->applied != applied) {
+      XLOG(ERR) << "unit " << unit->unit
+                << " failed to revert to the state applied by the other units";
+    }
+  }
+  return applied;
+}
+
+std::vector<microseconds> BcmUnitProgrammer::getLastDurations() const {
+  std::vector<microseconds> durations;
+  for (const auto& unit : units_) {
+    std::lock_guard<std::mutex> guard(unit->lock);
+    durations.push_back(unit->duration);
+  }
+  return durations;
+}
+
+}} // facebook::fboss
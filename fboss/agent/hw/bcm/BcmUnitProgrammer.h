@@ -0,0 +1,80 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#pragma once
+
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace facebook { namespace fboss {
+
+class StateDelta;
+class SwitchState;
+
+/*
+ * BcmUnitProgrammer programs the state updates of a system with several
+ * switching ASICs, driven by a BcmSwitch each, on a long-lived thread per
+ * unit, so that the units are programmed at the same time rather than one
+ * after another.
+ *
+ * How long each unit takes to program an update is recorded per unit in
+ * BcmStats, as bcm.unit.<unit>.state_update.us.
+ */
+class BcmUnitProgrammer {
+ public:
+  // Programs a state delta on one unit, returning the state it applied
+  using ProgramFn =
+      std::function<std::shared_ptr<SwitchState>(const StateDelta&)>;
+
+  struct Unit {
+    int unit;
+    ProgramFn program;
+  };
+
+  explicit BcmUnitProgrammer(std::vector<Unit> units);
+  ~BcmUnitProgrammer();
+
+  /*
+   * Programs delta on all units at once, and returns once they are all
+   * done.
+   *
+   * Returns the new state if every unit applied all of it.  Otherwise the
+   * state applied by the first unit, in the order given, that did not is
+   * returned, and the units that applied something else are programmed
+   * back to it, so that the units keep matching the state we report.
+   * If a unit throws, the first error is rethrown once all units are done.
+   */
+  std::shared_ptr<SwitchState> stateChanged(const StateDelta& delta);
+
+  size_t numUnits() const {
+    return units_.size();
+  }
+
+  // How long each unit took to program the last update
+  std::vector<std::chrono::microseconds> getLastDurations() const;
+
+ private:
+  // Forbidden copy constructor and assignment operator
+  BcmUnitProgrammer(BcmUnitProgrammer const &) = delete;
+  BcmUnitProgrammer& operator=(BcmUnitProgrammer const &) = delete;
+
+  struct UnitThread;
+  using Work = std::vector<std::pair<UnitThread*, const StateDelta*>>;
+
+  static void runUnit(UnitThread* unit);
+  // Programs each unit with its delta, and waits for all of them
+  static void programUnits(const Work& work);
+
+  std::vector<std::unique_ptr<UnitThread>> units_;
+};
+
+}} // facebook::fboss
@@ -8,16 +8,22 @@
  *
  */
 #include "BcmWarmBootCache.h"
+#include <chrono>
+#include <functional>
 #include <string>
+#include <thread>
 #include <utility>
 
 #include <folly/Conv.h>
 #include <folly/dynamic.h>
 #include <folly/json.h>
 #include <folly/logging/xlog.h>
+#include <gflags/gflags.h>
 
+#include "common/stats/ServiceData.h"
 #include "fboss/agent/Constants.h"
 #include "fboss/agent/SysError.h"
+#include "fboss/agent/WarmBootTimeline.h"
 #include "fboss/agent/hw/bcm/BcmAclTable.h"
 #include "fboss/agent/hw/bcm/BcmEgress.h"
 #include "fboss/agent/hw/bcm/BcmError.h"
@@ -25,6 +31,8 @@
 #include "fboss/agent/hw/bcm/BcmSwitch.h"
 #include "fboss/agent/hw/bcm/BcmWarmBootHelper.h"
 #include "fboss/agent/hw/bcm/Utils.h"
+#include "fboss/agent/hw/bcm/WarmBootStateFile.h"
+#include "fboss/agent/state/AclMap.h"
 #include "fboss/agent/state/ArpTable.h"
 #include "fboss/agent/state/Interface.h"
 #include "fboss/agent/state/InterfaceMap.h"
@@ -32,6 +40,7 @@
 #include "fboss/agent/state/NeighborEntry.h"
 #include "fboss/agent/state/Port.h"
 #include "fboss/agent/state/PortDescriptor.h"
+#include "fboss/agent/state/RouteTableMap.h"
 #include "fboss/agent/state/SwitchState.h"
 #include "fboss/agent/state/Vlan.h"
 #include "fboss/agent/state/VlanMap.h"
@@ -50,9 +59,21 @@ using folly::MacAddress;
 using boost::container::flat_map;
 using boost::container::flat_set;
 using namespace facebook::fboss;
+using std::chrono::duration_cast;
+using std::chrono::microseconds;
+using std::chrono::steady_clock;
+
+DEFINE_bool(parallel_warm_boot_traversal, false,
+            "Traverse the host, route and egress tables concurrently on "
+            "warm boot");
 
 namespace {
 auto constexpr kEcmpObjects = "ecmpObjects";
+// Sections of the dumped SwSwitch state
+auto constexpr kDumpedInterfaces = "interfaces";
+auto constexpr kDumpedVlans = "vlans";
+auto constexpr kDumpedRouteTables = "routeTables";
+auto constexpr kDumpedAcls = "acls";
 auto constexpr kVlanForCPUEgressEntries = 0;
 auto constexpr kACLFieldGroupID = 128;
 
@@ -63,6 +84,30 @@ struct AddrTables {
   shared_ptr<facebook::fboss::NdpTable> ndpTable;
 };
 
+/*
+ * Sort entries into map, which must be empty.  Where a key is repeated the
+ * last entry for it wins, as it would with map[key] = value.
+ */
+template <typename Map>
+void fillSorted(
+    std::vector<std::pair<typename Map::key_type, typename Map::mapped_type>>*
+        entries,
+    Map* map) {
+  std::reverse(entries->begin(), entries->end());
+  auto keyLess = [](const auto& lhs, const auto& rhs) {
+    return lhs.first < rhs.first;
+  };
+  std::stable_sort(entries->begin(), entries->end(), keyLess);
+  auto end = std::unique(
+      entries->begin(), entries->end(), [&](const auto& lhs, const auto& rhs) {
+        return !keyLess(lhs, rhs) && !keyLess(rhs, lhs);
+      });
+  map->reserve(end - entries->begin());
+  map->insert(boost::container::ordered_unique_range, entries->begin(), end);
+  // Free the memory, the entries are not needed any more
+  std::remove_reference_t<decltype(*entries)>().swap(*entries);
+}
+
 folly::IPAddress getFullMaskIPv4Address() {
   return folly::IPAddress(folly::IPAddressV4(
       folly::IPAddressV4::fetchMask(folly::IPAddressV4::bitCount())));
@@ -83,7 +128,8 @@ BcmWarmBootCache::BcmWarmBootCache(const BcmSwitchIf* hw)
 
 shared_ptr<InterfaceMap> BcmWarmBootCache::reconstructInterfaceMap() const {
   std::shared_ptr<InterfaceMap> dumpedInterfaceMap =
-      dumpedSwSwitchState_->getInterfaces();
+      InterfaceMap::fromFollyDynamic(
+          dumpedState_->getSection(kSwSwitch, kDumpedInterfaces));
   auto intfMap = make_shared<InterfaceMap>();
   for (const auto& vlanMacAndIntf: vlanAndMac2Intf_) {
     const auto& bcmIntf = vlanMacAndIntf.second;
@@ -100,7 +146,8 @@ shared_ptr<InterfaceMap> BcmWarmBootCache::reconstructInterfaceMap() const {
 }
 
 shared_ptr<VlanMap> BcmWarmBootCache::reconstructVlanMap() const {
-  std::shared_ptr<VlanMap> dumpedVlans = dumpedSwSwitchState_->getVlans();
+  std::shared_ptr<VlanMap> dumpedVlans = VlanMap::fromFollyDynamic(
+      dumpedState_->getSection(kSwSwitch, kDumpedVlans));
   auto vlans = make_shared<VlanMap>();
   flat_map<VlanID, VlanFields> vlan2VlanFields;
   // Get vlan and port mapping
@@ -200,12 +247,17 @@ BcmWarmBootCache::reconstructRouteTables() const {
   // is no way to distinguish a host entry from a host
   // route. Since we want to get all routes here (host
   // and LPM) we just get it from the dumped switch state.
-  return dumpedSwSwitchState_->getRouteTables();
+  //
+  // The route tables are by far the largest part of the dumped state, so they
+  // are only decoded here, once ports and interfaces have been handled.
+  return RouteTableMap::fromFollyDynamic(
+      dumpedState_->getSection(kSwSwitch, kDumpedRouteTables));
 }
 
 std::shared_ptr<AclMap>
 BcmWarmBootCache::reconstructAclMap() const {
-  return dumpedSwSwitchState_->getAcls();
+  return AclMap::fromFollyDynamic(
+      dumpedState_->getSection(kSwSwitch, kDumpedAcls));
 }
 
 void BcmWarmBootCache::programmed(Range2BcmHandlerItr itr) {
@@ -236,6 +288,32 @@ BcmWarmBootCache::getPathsForEcmp(EgressId ecmp) const {
   return itr->second;
 }
 
+BcmWarmBootCache::EcmpWeights
+BcmWarmBootCache::getWeightsForEcmp(EgressId ecmp) const {
+  auto itr = hwSwitchEcmp2Weights_.find(ecmp);
+  return itr == hwSwitchEcmp2Weights_.end() ? EcmpWeights() : itr->second;
+}
+
+void BcmWarmBootCache::addEcmpFromWarmBootState(
+    EgressId ecmp,
+    const folly::dynamic& paths,
+    const folly::dynamic* weights) {
+  auto& egressIds = hwSwitchEcmp2EgressIds_[ecmp];
+  for (auto path : paths) {
+    egressIds.insert(path.asInt());
+  }
+  // Weights are in the order of the paths; states dumped before weighted
+  // ECMP have none
+  if (weights && !weights->empty()) {
+    CHECK_EQ(paths.size(), weights->size())
+        << "Weights don't match the paths of ecmp egress id: " << ecmp;
+    auto& ecmpWeights = hwSwitchEcmp2Weights_[ecmp];
+    for (size_t i = 0; i < paths.size(); ++i) {
+      ecmpWeights[paths[i].asInt()] += (*weights)[i].asInt();
+    }
+  }
+}
+
 folly::dynamic BcmWarmBootCache::toFollyDynamic() const {
   folly::dynamic warmBootCache = folly::dynamic::object;
   // For now we serialize only the hwSwitchEcmp2EgressIds_ table.
@@ -250,45 +328,54 @@ folly::dynamic BcmWarmBootCache::toFollyDynamic() const {
       paths.push_back(path);
     }
     ecmp[kPaths] = std::move(paths);
+    auto weightsItr = hwSwitchEcmp2Weights_.find(ecmpAndEgressIds.first);
+    if (weightsItr != hwSwitchEcmp2Weights_.end()) {
+      folly::dynamic weights = folly::dynamic::array;
+      for (auto path : ecmpAndEgressIds.second) {
+        auto itr = weightsItr->second.find(path);
+        weights.push_back(itr == weightsItr->second.end() ? 0 : itr->second);
+      }
+      ecmp[kWeights] = std::move(weights);
+    }
     ecmps.push_back(std::move(ecmp));
   }
   warmBootCache[kEcmpObjects] = std::move(ecmps);
   return warmBootCache;
 }
 
-folly::dynamic BcmWarmBootCache::getWarmBootState() const {
-  return hw_->getPlatform()->getWarmBootHelper()->getWarmBootState();
+std::unique_ptr<WarmBootStateFile> BcmWarmBootCache::openWarmBootState() const {
+  return hw_->getPlatform()->getWarmBootHelper()->openWarmBootState();
 }
 
-void BcmWarmBootCache::populateFromWarmBootState(const folly::dynamic&
-    warmBootState) {
-
-  dumpedSwSwitchState_ =
-    SwitchState::uniquePtrFromFollyDynamic(warmBootState[kSwSwitch]);
-  CHECK(dumpedSwSwitchState_)
+void BcmWarmBootCache::populateFromWarmBootState(
+    std::unique_ptr<WarmBootStateFile> warmBootState) {
+  // The dumped SwSwitch state is decoded section by section as the
+  // reconstruct*() functions need it.
+  dumpedState_ = std::move(warmBootState);
+  CHECK(dumpedState_->hasSection(kSwSwitch, kDumpedRouteTables))
       << "Was not able to recover software state after warmboot";
 
   // Extract ecmps for dumped host table
-  auto hostTable = warmBootState[kHwSwitch][kHostTable];
+  auto hostTable = dumpedState_->getSection(kHwSwitch, kHostTable);
   for (const auto& ecmpEntry : hostTable[kEcmpHosts]) {
     auto ecmpEgressId = ecmpEntry[kEcmpEgressId].asInt();
     if (ecmpEgressId == BcmEgressBase::INVALID) {
       continue;
     }
     // If the entry is valid, then there must be paths associated with it.
-    for (auto path : ecmpEntry[kEcmpEgress][kPaths]) {
-      hwSwitchEcmp2EgressIds_[ecmpEgressId].insert(path.asInt());
-    }
+    const auto& ecmpEgress = ecmpEntry[kEcmpEgress];
+    addEcmpFromWarmBootState(
+        ecmpEgressId, ecmpEgress[kPaths], ecmpEgress.get_ptr(kWeights));
   }
   // Extract ecmps from dumped warm boot cache. We
   // may have shut down before a FIB sync
-  auto ecmpObjects = warmBootState[kHwSwitch][kWarmBootCache][kEcmpObjects];
+  auto ecmpObjects =
+      dumpedState_->getSection(kHwSwitch, kWarmBootCache)[kEcmpObjects];
   for (const auto& ecmpEntry : ecmpObjects) {
     auto ecmpEgressId = ecmpEntry[kEcmpEgressId].asInt();
     CHECK(ecmpEgressId != BcmEgressBase::INVALID);
-    for (auto path : ecmpEntry[kPaths]) {
-      hwSwitchEcmp2EgressIds_[ecmpEgressId].emplace(path.asInt());
-    }
+    addEcmpFromWarmBootState(
+        ecmpEgressId, ecmpEntry[kPaths], ecmpEntry.get_ptr(kWeights));
   }
   XLOG(DBG1) << "Reconstructed following ecmp path map ";
   for (auto& ecmpIdAndEgress : hwSwitchEcmp2EgressIds_) {
@@ -354,9 +441,10 @@ BcmWarmBootCache::findEgressFromHost(
 
 void BcmWarmBootCache::populate(folly::Optional<folly::dynamic> warmBootState) {
   if (warmBootState) {
-    populateFromWarmBootState(*warmBootState);
+    populateFromWarmBootState(
+        std::make_unique<WarmBootStateFile>(std::move(*warmBootState)));
   } else {
-    populateFromWarmBootState(getWarmBootState());
+    populateFromWarmBootState(openWarmBootState());
   }
   opennsl_vlan_data_t* vlanList = nullptr;
   int vlanCount = 0;
@@ -408,34 +496,121 @@ void BcmWarmBootCache::populate(folly::Optional<folly::dynamic> warmBootState) {
       }
     }
   }
-  opennsl_l3_info_t l3Info;
-  opennsl_l3_info_t_init(&l3Info);
-  opennsl_l3_info(hw_->getUnit(), &l3Info);
-  // Traverse V4 hosts
-  opennsl_l3_host_traverse(hw_->getUnit(), 0, 0, l3Info.l3info_max_host,
-      hostTraversalCallback, this);
-  // Traverse V6 hosts
-  opennsl_l3_host_traverse(hw_->getUnit(), OPENNSL_L3_IP6, 0,
-      // Diag shell uses this for getting # of v6 host entries
-      l3Info.l3info_max_host / 2,
-      hostTraversalCallback, this);
-  // Traverse V4 routes
-  opennsl_l3_route_traverse(hw_->getUnit(), 0, 0, l3Info.l3info_max_route,
-      routeTraversalCallback, this);
-  // Traverse V6 routes
-  opennsl_l3_route_traverse(hw_->getUnit(), OPENNSL_L3_IP6, 0,
-      // Diag shell uses this for getting # of v6 route entries
-      l3Info.l3info_max_route / 2,
-      routeTraversalCallback, this);
-  // Get egress entries.
-  opennsl_l3_egress_traverse(hw_->getUnit(), egressTraversalCallback, this);
-  // Traverse ecmp egress entries
-  opennsl_l3_egress_ecmp_traverse(hw_->getUnit(), ecmpEgressTraversalCallback,
-      this);
+  traverseL3Tables();
 
   // populate acls and acl ranges
   populateAcls(kACLFieldGroupID, this->aclRange2BcmAclRangeHandle_,
     this->priority2BcmAclEntryHandle_);
+  updateMemoryAccount();
+  WarmBootTimeline::get()->mark(
+      WarmBootTimeline::Event::WARM_BOOT_CACHE_POPULATED);
+}
+
+void BcmWarmBootCache::traverseL3Tables() {
+  opennsl_l3_info_t l3Info;
+  opennsl_l3_info_t_init(&l3Info);
+  opennsl_l3_info(hw_->getUnit(), &l3Info);
+
+  struct TableTraversal {
+    const char* name;
+    // Traverses the table, and returns the number of entries found
+    std::function<size_t()> traverse;
+    size_t entries{0};
+    microseconds duration{0};
+    std::exception_ptr error;
+  };
+  std::vector<TableTraversal> tables;
+  tables.push_back({"host", [&] {
+    hostEntries_.reserve(std::max(l3Info.l3info_used_host, 0));
+    // Traverse V4 hosts
+    opennsl_l3_host_traverse(hw_->getUnit(), 0, 0, l3Info.l3info_max_host,
+        hostTraversalCallback, this);
+    // Traverse V6 hosts
+    opennsl_l3_host_traverse(hw_->getUnit(), OPENNSL_L3_IP6, 0,
+        // Diag shell uses this for getting # of v6 host entries
+        l3Info.l3info_max_host / 2,
+        hostTraversalCallback, this);
+    auto entries = hostEntries_.size();
+    fillSorted(&hostEntries_, &vrfIp2Host_);
+    return entries;
+  }});
+  tables.push_back({"route", [&] {
+    prefixRouteEntries_.reserve(std::max(l3Info.l3info_used_route, 0));
+    // Traverse V4 routes
+    opennsl_l3_route_traverse(hw_->getUnit(), 0, 0, l3Info.l3info_max_route,
+        routeTraversalCallback, this);
+    // Traverse V6 routes
+    opennsl_l3_route_traverse(hw_->getUnit(), OPENNSL_L3_IP6, 0,
+        // Diag shell uses this for getting # of v6 route entries
+        l3Info.l3info_max_route / 2,
+        routeTraversalCallback, this);
+    auto entries = prefixRouteEntries_.size() + hostRouteEntries_.size();
+    fillSorted(&prefixRouteEntries_, &vrfPrefix2Route_);
+    fillSorted(&hostRouteEntries_, &vrfAndIP2Route_);
+    return entries;
+  }});
+  tables.push_back({"egress", [&] {
+    opennsl_l3_egress_traverse(hw_->getUnit(), egressTraversalCallback, this);
+    return egressId2Egress_.size() +
+        (dropEgressId_ != BcmEgressBase::INVALID) +
+        (toCPUEgressId_ != BcmEgressBase::INVALID);
+  }});
+  tables.push_back({"ecmp", [&] {
+    opennsl_l3_egress_ecmp_traverse(hw_->getUnit(),
+        ecmpEgressTraversalCallback, this);
+    return egressIds2Ecmp_.size();
+  }});
+
+  auto run = [](TableTraversal* table) {
+    auto begin = steady_clock::now();
+    try {
+      table->entries = table->traverse();
+    } catch (...) {
+      table->error = std::current_exception();
+    }
+    table->duration =
+        duration_cast<microseconds>(steady_clock::now() - begin);
+  };
+  auto begin = steady_clock::now();
+  if (FLAGS_parallel_warm_boot_traversal) {
+    // Each table fills its own containers, and only reads the state from
+    // the warm boot file, so they can be traversed at the same time.
+    std::vector<std::thread> threads;
+    SCOPE_EXIT {
+      for (auto& thread : threads) {
+        thread.join();
+      }
+    };
+    // The first table is traversed on this thread
+    for (size_t i = 1; i < tables.size(); ++i) {
+      threads.emplace_back(run, &tables[i]);
+    }
+    run(&tables.front());
+  } else {
+    for (auto& table : tables) {
+      run(&table);
+    }
+  }
+  auto elapsed = duration_cast<microseconds>(steady_clock::now() - begin);
+
+  for (const auto& table : tables) {
+    XLOG(INFO) << "Warm boot found " << table.entries << " " << table.name
+               << " entries in " << table.duration.count() << "us";
+    fbData->setCounter(
+        folly::to<string>("bcm.warm_boot.", table.name, ".entries"),
+        table.entries);
+    fbData->setCounter(
+        folly::to<string>("bcm.warm_boot.", table.name, ".traverse.us"),
+        table.duration.count());
+  }
+  XLOG(INFO) << "Warm boot traversed the l3 tables in " << elapsed.count()
+             << "us";
+  fbData->setCounter("bcm.warm_boot.traverse.us", elapsed.count());
+  for (const auto& table : tables) {
+    if (table.error) {
+      std::rethrow_exception(table.error);
+    }
+  }
 }
 
 bool BcmWarmBootCache::fillVlanPortInfo(Vlan* vlan) {
@@ -467,7 +642,7 @@ int BcmWarmBootCache::hostTraversalCallback(
     IPAddress::fromBinary(ByteRange(host->l3a_ip6_addr,
           sizeof(host->l3a_ip6_addr))) :
     IPAddress::fromLongHBO(host->l3a_ip_addr);
-  cache->vrfIp2Host_[make_pair(host->l3a_vrf, ip)] = *host;
+  cache->hostEntries_.emplace_back(make_pair(host->l3a_vrf, ip), *host);
   XLOG(DBG1) << "Adding egress id: " << host->l3a_intf << " to " << ip
              << " mapping";
   return 0;
@@ -535,12 +710,14 @@ int BcmWarmBootCache::routeTraversalCallback(
       ((isIPv6 && mask == getFullMaskIPv6Address()) ||
        (!isIPv6 && mask == getFullMaskIPv4Address()))) {
     // This is a host route.
-    cache->vrfAndIP2Route_[make_pair(route->l3a_vrf, ip)] = *route;
+    cache->hostRouteEntries_.emplace_back(
+        make_pair(route->l3a_vrf, ip), *route);
     XLOG(DBG3) << "Adding host route found in route table. vrf: "
                << route->l3a_vrf << " ip: " << ip << " mask: " << mask;
   } else {
     // Other routes that cannot be put into host table / CAM.
-    cache->vrfPrefix2Route_[make_tuple(route->l3a_vrf, ip, mask)] = *route;
+    cache->prefixRouteEntries_.emplace_back(
+        make_tuple(route->l3a_vrf, ip, mask), *route);
     XLOG(DBG3) << "In vrf : " << route->l3a_vrf << " adding route for : " << ip
                << " mask: " << mask;
   }
@@ -586,10 +763,13 @@ int BcmWarmBootCache::ecmpEgressTraversalCallback(
   CHECK(egressIds.size() > 0)
       << "There must be at least one egress pointed to by the ecmp egress id: "
       << ecmp->ecmp_intf;
-  CHECK(cache->egressIds2Ecmp_.find(egressIds) == cache->egressIds2Ecmp_.end())
+  // Groups over the same paths with different weights are distinct
+  auto key = std::make_pair(egressIds, cache->getWeightsForEcmp(
+      ecmp->ecmp_intf));
+  CHECK(cache->egressIds2Ecmp_.find(key) == cache->egressIds2Ecmp_.end())
       << "Got a duplicated call for ecmp id: " << ecmp->ecmp_intf
       << " referencing: " << toEgressIdsStr(egressIds);
-  cache->egressIds2Ecmp_[egressIds] = *ecmp;
+  cache->egressIds2Ecmp_[std::move(key)] = *ecmp;
   XLOG(DBG1) << "Added ecmp egress id : " << ecmp->ecmp_intf
              << " pointing to : " << toEgressIdsStr(egressIds) << " egress ids";
   return 0;
@@ -605,13 +785,42 @@ std::string BcmWarmBootCache::toEgressIdsStr(const EgressIds& egressIds) {
   return egressStr;
 }
 
+const char* BcmWarmBootCache::getL3TableName(L3Table table) {
+  switch (table) {
+    case HOST:
+      return "host";
+    case ROUTE:
+      return "route";
+    case EGRESS:
+      return "egress";
+    case ECMP:
+      return "ecmp";
+    case NUM_L3_TABLES:
+      break;
+  }
+  return "unknown";
+}
+
 void BcmWarmBootCache::clear() {
+  for (int i = 0; i < NUM_L3_TABLES; ++i) {
+    auto table = static_cast<L3Table>(i);
+    auto name = getL3TableName(table);
+    XLOG(INFO) << "Warm boot left " << unchanged_[i] << " " << name
+               << " entries unchanged and rewrote " << rewritten_[i];
+    fbData->setCounter(
+        folly::to<string>("bcm.warm_boot.", name, ".unchanged"),
+        unchanged_[i]);
+    fbData->setCounter(
+        folly::to<string>("bcm.warm_boot.", name, ".rewritten"),
+        rewritten_[i]);
+  }
   // Get rid of all unclaimed entries. The order is important here
   // since we want to delete entries only after there are no more
   // references to them.
   XLOG(DBG1) << "Warm boot: removing unreferenced entries";
-  dumpedSwSwitchState_.reset();
+  dumpedState_.reset();
   hwSwitchEcmp2EgressIds_.clear();
+  hwSwitchEcmp2Weights_.clear();
   // First delete routes (fully qualified and others).
   //
   // Nothing references routes, but routes reference ecmp egress and egress
@@ -659,11 +868,11 @@ void BcmWarmBootCache::clear() {
   for (auto idsAndEcmp : egressIds2Ecmp_) {
     auto& ecmp = idsAndEcmp.second;
     XLOG(DBG1) << "Deleting ecmp egress object  " << ecmp.ecmp_intf
-               << " pointing to : " << toEgressIdsStr(idsAndEcmp.first);
+               << " pointing to : " << toEgressIdsStr(idsAndEcmp.first.first);
     auto rv = opennsl_l3_egress_ecmp_destroy(hw_->getUnit(), &ecmp);
     bcmLogFatal(rv, hw_, "failed to destroy ecmp egress object :",
         ecmp.ecmp_intf, " referring to ",
-        toEgressIdsStr(idsAndEcmp.first));
+        toEgressIdsStr(idsAndEcmp.first.first));
   }
   egressIds2Ecmp_.clear();
 
@@ -736,6 +945,31 @@ void BcmWarmBootCache::clear() {
     removeBcmAclRange(aclRangeItr.second.first);
   }
   aclRange2BcmAclRangeHandle_.clear();
+  updateMemoryAccount();
+}
+
+void BcmWarmBootCache::updateMemoryAccount() {
+  uint64_t bytes = containerMemoryBytes(vlan2VlanInfo_) +
+      containerMemoryBytes(vlan2Station_) +
+      containerMemoryBytes(vlanAndMac2Intf_) +
+      containerMemoryBytes(egressIdsFromBcmHostInWarmBootFile_) +
+      containerMemoryBytes(vrfIp2EgressFromBcmHostInWarmBootFile_) +
+      containerMemoryBytes(hostEntries_) +
+      containerMemoryBytes(prefixRouteEntries_) +
+      containerMemoryBytes(hostRouteEntries_) +
+      containerMemoryBytes(vrfIp2Host_) +
+      containerMemoryBytes(vrfPrefix2Route_) +
+      containerMemoryBytes(vrfAndIP2Route_) +
+      containerMemoryBytes(egressId2Egress_) +
+      containerMemoryBytes(egressIds2Ecmp_) +
+      containerMemoryBytes(hwSwitchEcmp2EgressIds_) +
+      containerMemoryBytes(hwSwitchEcmp2Weights_) +
+      containerMemoryBytes(aclRange2BcmAclRangeHandle_) +
+      containerMemoryBytes(priority2BcmAclEntryHandle_);
+  if (dumpedState_) {
+    bytes += dumpedState_->size();
+  }
+  memoryAccount_.set(bytes);
 }
 
 }}
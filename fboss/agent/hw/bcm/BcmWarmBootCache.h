@@ -23,14 +23,18 @@ extern "C" {
 #include <folly/dynamic.h>
 #include <folly/logging/xlog.h>
 #include <algorithm>
+#include <array>
+#include <atomic>
 #include <list>
 #include <memory>
 #include <string>
 #include <vector>
+#include "fboss/agent/MemoryAccount.h"
 #include "fboss/agent/state/RouteTypes.h"
 #include "fboss/agent/types.h"
 
 #include "fboss/agent/hw/bcm/BcmAclRange.h"
+#include "fboss/agent/hw/bcm/WarmBootStateFile.h"
 
 namespace facebook { namespace fboss {
 class AclMap;
@@ -71,6 +75,11 @@ class BcmWarmBootCache {
   typedef opennsl_if_t EgressId;
   typedef boost::container::flat_set<EgressId> EgressIds;
   typedef boost::container::flat_map<EgressId, EgressIds> Ecmp2EgressIds;
+  // Path -> UCMP weight of a weighted ECMP group, as in BcmEcmpEgress
+  using EcmpWeights = boost::container::flat_map<EgressId, uint64_t>;
+  using Ecmp2Weights = boost::container::flat_map<EgressId, EcmpWeights>;
+  // The paths and weights of an ECMP group, which tell groups apart
+  using EcmpKey = std::pair<EgressIds, EcmpWeights>;
   static EgressIds toEgressIds(EgressId* egress, int count) {
     EgressIds egressIds;
     std::for_each(egress, egress + count,
@@ -101,6 +110,33 @@ class BcmWarmBootCache {
   const Ecmp2EgressIds&  ecmp2EgressIds() const {
     return hwSwitchEcmp2EgressIds_;
   }
+
+  /*
+   * The l3 tables whose cached entries are counted as they are claimed:
+   * left alone where the entry in h/w is what would be programmed, or
+   * rewritten where it is not.  The counts are reported by clear(), and
+   * on a hitless warm boot nothing is rewritten.
+   */
+  enum L3Table {
+    HOST,
+    ROUTE,
+    EGRESS,
+    ECMP,
+    NUM_L3_TABLES,
+  };
+  static const char* getL3TableName(L3Table table);
+  void entryUnchanged(L3Table table) {
+    ++unchanged_[table];
+  }
+  void entryRewritten(L3Table table) {
+    ++rewritten_[table];
+  }
+  uint64_t getUnchangedCount(L3Table table) const {
+    return unchanged_[table];
+  }
+  uint64_t getRewrittenCount(L3Table table) const {
+    return rewritten_[table];
+  }
  private:
   using Egress = opennsl_l3_egress_t;
   using EcmpEgress = opennsl_l3_egress_ecmp_t;
@@ -128,7 +164,7 @@ class BcmWarmBootCache {
           opennsl_l3_host_t> VrfAndIP2Host;
   typedef boost::container::flat_map<VrfAndPrefix, opennsl_l3_route_t>
     VrfAndPrefix2Route;
-  typedef boost::container::flat_map<EgressIds, EcmpEgress> EgressIds2Ecmp;
+  typedef boost::container::flat_map<EcmpKey, EcmpEgress> EgressIds2Ecmp;
   using VrfAndIP2Route =
       boost::container::flat_map<VrfAndIP, opennsl_l3_route_t>;
   using EgressId2Egress = boost::container::flat_map<EgressId, Egress>;
@@ -143,6 +179,23 @@ class BcmWarmBootCache {
   using Priority2BcmAclEntryHandle = boost::container::flat_map<
         int, BcmAclEntryHandle>;
 
+  /*
+   * Host and route entries as they are traversed, before they are sorted
+   * into their flat maps in one go.  Inserting them into the maps one at a
+   * time, in the order the h/w returns them, is quadratic.
+   */
+  using HostEntries = std::vector<std::pair<VrfAndIP, opennsl_l3_host_t>>;
+  using PrefixRouteEntries =
+      std::vector<std::pair<VrfAndPrefix, opennsl_l3_route_t>>;
+  using HostRouteEntries =
+      std::vector<std::pair<VrfAndIP, opennsl_l3_route_t>>;
+
+  /*
+   * Traverse the host, route, egress and ecmp tables, concurrently with
+   * --parallel_warm_boot_traversal, since each fills its own containers.
+   */
+  void traverseL3Tables();
+
   /*
    * Callbacks for traversing entries in BCM h/w tables
    */
@@ -330,8 +383,10 @@ class BcmWarmBootCache {
   EgressIds2EcmpCItr egressIds2Ecmp_end() {
     return egressIds2Ecmp_.end();
   }
-  EgressIds2EcmpCItr findEcmp(const EgressIds& egressIds) {
-    return egressIds2Ecmp_.find(egressIds);
+  EgressIds2EcmpCItr findEcmp(
+      const EgressIds& egressIds,
+      const EcmpWeights& weights) {
+    return egressIds2Ecmp_.find(std::make_pair(egressIds, weights));
   }
   void programmed(EgressIds2EcmpCItr eeitr) {
     XLOG(DBG1) << "Programmed ecmp egress: " << eeitr->second.ecmp_intf
@@ -341,6 +396,7 @@ class BcmWarmBootCache {
     //
     // Note: This should be done before erasing the iterator.
     hwSwitchEcmp2EgressIds_.erase(eeitr->second.ecmp_intf);
+    hwSwitchEcmp2Weights_.erase(eeitr->second.ecmp_intf);
     egressIds2Ecmp_.erase(eeitr);
   }
 
@@ -381,6 +437,11 @@ class BcmWarmBootCache {
    */
   void clear();
   bool fillVlanPortInfo(Vlan* vlan);
+  /*
+   * Set the memory account of the cache ("bcm.warm_boot_cache"), which holds
+   * the entries found in hardware until clear() is called.
+   */
+  void updateMemoryAccount();
   /*
    * Serialize to folly::dynamic
    */
@@ -397,8 +458,15 @@ class BcmWarmBootCache {
    * map
    */
   const EgressIds& getPathsForEcmp(EgressId ecmp) const;
-  folly::dynamic getWarmBootState() const;
-  void populateFromWarmBootState(const folly::dynamic& warmBootState);
+  // The weights of a weighted ECMP group, empty for any other
+  EcmpWeights getWeightsForEcmp(EgressId ecmp) const;
+  void addEcmpFromWarmBootState(
+      EgressId ecmp,
+      const folly::dynamic& paths,
+      const folly::dynamic* weights);
+  std::unique_ptr<WarmBootStateFile> openWarmBootState() const;
+  void populateFromWarmBootState(
+      std::unique_ptr<WarmBootStateFile> warmBootState);
   // No copy or assignment.
   BcmWarmBootCache(const BcmWarmBootCache&) = delete;
   BcmWarmBootCache& operator=(const BcmWarmBootCache&) = delete;
@@ -413,6 +481,11 @@ class BcmWarmBootCache {
   // based on the BcmHost in warm boot file.
   HostTableInWarmBootFile vrfIp2EgressFromBcmHostInWarmBootFile_;
 
+  // Only used while the host and route tables are traversed
+  HostEntries hostEntries_;
+  PrefixRouteEntries prefixRouteEntries_;
+  HostRouteEntries hostRouteEntries_;
+
   // The host table in HW
   VrfAndIP2Host vrfIp2Host_;
   // These are routes from defip table that are not fully qualified (not /32 or
@@ -448,11 +521,19 @@ class BcmWarmBootCache {
   // second port would be queued behind the updates for the downed port.
   // The delay can be multiple seconds.
   Ecmp2EgressIds hwSwitchEcmp2EgressIds_;
+  // The weights of the weighted groups in hwSwitchEcmp2EgressIds_
+  Ecmp2Weights hwSwitchEcmp2Weights_;
 
   // acls and acl ranges
   AclRange2BcmAclRangeHandle aclRange2BcmAclRangeHandle_;
   Priority2BcmAclEntryHandle priority2BcmAclEntryHandle_;
 
-  std::unique_ptr<SwitchState> dumpedSwSwitchState_;
+  std::unique_ptr<WarmBootStateFile> dumpedState_;
+
+  // Routes may be programmed on several threads at once
+  std::array<std::atomic<uint64_t>, NUM_L3_TABLES> unchanged_{};
+  std::array<std::atomic<uint64_t>, NUM_L3_TABLES> rewritten_{};
+
+  MemoryAccount memoryAccount_{"bcm.warm_boot_cache"};
 };
 }} // facebook::fboss
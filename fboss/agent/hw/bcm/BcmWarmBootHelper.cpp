@@ -3,21 +3,33 @@
 
 #include "fboss/agent/SysError.h"
 #include "fboss/agent/Utils.h"
+#include "fboss/agent/hw/bcm/WarmBootStateFile.h"
 
 #include <sys/stat.h>
 #include <fcntl.h>
 
+#include <chrono>
+
 #include <folly/FileUtil.h>
+#include <folly/String.h>
 #include <folly/json.h>
 #include <folly/logging/xlog.h>
 #include <glog/logging.h>
 
 using std::string;
+using std::chrono::duration;
+using std::chrono::duration_cast;
+using std::chrono::steady_clock;
 
 DEFINE_bool(can_warm_boot, true,
             "Enable/disable warm boot functionality");
 DEFINE_string(switch_state_file, "switch_state",
     "File for dumping switch state JSON in on exit");
+DEFINE_bool(binary_switch_state_file, false,
+    "Dump the warm boot switch state as separately decodable binary BSER "
+    "sections rather than as JSON.  Either format is accepted when reading "
+    "the state back, but older agents only read JSON, so this must stay "
+    "off until they can no longer be rolled back to.");
 
 namespace {
 constexpr auto wbFlagPrefix = "can_warm_boot_";
@@ -120,15 +132,39 @@ bool DiscBackedBcmWarmBootHelper::checkAndClearWarmBootFlags() {
 
 bool DiscBackedBcmWarmBootHelper::storeWarmBootState(
     const folly::dynamic& switchState) {
-  return dumpStateToFile(warmBootSwitchStateFile(), switchState);
+  if (!FLAGS_binary_switch_state_file) {
+    return dumpStateToFile(warmBootSwitchStateFile(), switchState);
+  }
+  steady_clock::time_point begin = steady_clock::now();
+  try {
+    auto bytes =
+        WarmBootStateFile::write(switchState, warmBootSwitchStateFile());
+    XLOG(INFO) << "[Exit] Wrote " << bytes
+               << " bytes of warm boot switch state in "
+               << duration_cast<duration<float>>(steady_clock::now() - begin)
+                      .count();
+  } catch (const std::exception& ex) {
+    XLOG(ERR) << "Error writing warm boot switch state: "
+              << folly::exceptionStr(ex);
+    return false;
+  }
+  return true;
 }
 
 folly::dynamic DiscBackedBcmWarmBootHelper::getWarmBootState() const {
-  std::string warmBootJson;
-  auto ret = folly::readFile(warmBootSwitchStateFile().c_str(), warmBootJson);
-  sysCheckError(
-      ret, "Unable to read switch state from : ", warmBootSwitchStateFile());
-  return folly::parseJson(warmBootJson);
+  return openWarmBootState()->getAll();
+}
+
+std::unique_ptr<WarmBootStateFile>
+DiscBackedBcmWarmBootHelper::openWarmBootState() const {
+  steady_clock::time_point begin = steady_clock::now();
+  auto stateFile =
+      std::make_unique<WarmBootStateFile>(warmBootSwitchStateFile());
+  XLOG(INFO) << "Opened " << stateFile->size()
+             << " byte warm boot switch state file in "
+             << duration_cast<duration<float>>(steady_clock::now() - begin)
+                    .count();
+  return stateFile;
 }
 } // namespace fboss
 } // namespace facebook
@@ -4,8 +4,11 @@
 #include <folly/dynamic.h>
 #include <folly/Range.h>
 
+#include <memory>
+
 namespace facebook { namespace fboss {
 
+class WarmBootStateFile;
 
 /*
  * This class encapsulates much of the warm boot functionality for an individual
@@ -36,6 +39,10 @@ class BcmWarmBootHelper {
 
   virtual bool storeWarmBootState(const folly::dynamic& switchState) = 0;
   virtual folly::dynamic getWarmBootState() const = 0;
+  /*
+   * Open the dumped switch state for decoding a section at a time.
+   */
+  virtual std::unique_ptr<WarmBootStateFile> openWarmBootState() const = 0;
 
  private:
   // Forbidden copy constructor and assignment operator
@@ -57,6 +64,7 @@ class DiscBackedBcmWarmBootHelper: public BcmWarmBootHelper {
   void warmBootWrite(const uint8_t* buf, int offset, int nbytes) override;
   bool storeWarmBootState(const folly::dynamic& switchState) override;
   folly::dynamic getWarmBootState() const override;
+  std::unique_ptr<WarmBootStateFile> openWarmBootState() const override;
 
  private:
   // Forbidden copy constructor and assignment operator
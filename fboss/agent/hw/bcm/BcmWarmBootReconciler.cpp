@@ -0,0 +1,153 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "fboss/agent/hw/bcm/BcmWarmBootReconciler.h"
+
+#include "fboss/agent/FbossError.h"
+#include "fboss/agent/StartupProfiler.h"
+
+#include <folly/ScopeGuard.h>
+#include <folly/logging/xlog.h>
+
+#include <algorithm>
+#include <exception>
+#include <future>
+#include <thread>
+
+using std::chrono::duration_cast;
+using std::chrono::microseconds;
+
+namespace facebook { namespace fboss {
+
+void BcmWarmBootReconciler::addPhase(
+    std::string name,
+    std::vector<std::string> deps,
+    PhaseFn fn) {
+  Phase phase{std::move(name), {}, std::move(fn)};
+  for (const auto& dep : deps) {
+    auto it = std::find_if(phases_.begin(), phases_.end(),
+        [&](const Phase& earlier) { return earlier.name == dep; });
+    if (it == phases_.end()) {
+      throw FbossError("warm boot phase ", phase.name,
+                       " depends on unknown phase ", dep);
+    }
+    phase.deps.push_back(it - phases_.begin());
+  }
+  phases_.push_back(std::move(phase));
+}
+
+void BcmWarmBootReconciler::run() {
+  using Clock = StartupProfiler::Clock;
+  auto begin = Clock::now();
+  std::vector<PhaseTiming> timings(phases_.size());
+  // Not vector<bool>, as phases on different threads set their own entry
+  std::vector<char> ran(phases_.size(), false);
+  auto runPhase = [&](size_t idx) {
+    const auto& phase = phases_[idx];
+    auto phaseBegin = Clock::now();
+    SCOPE_EXIT {
+      auto phaseEnd = Clock::now();
+      StartupProfiler::get()->record(phase.name, phaseBegin, phaseEnd);
+      timings[idx].name = phase.name;
+      timings[idx].wait = duration_cast<microseconds>(phaseBegin - begin);
+      timings[idx].duration =
+          duration_cast<microseconds>(phaseEnd - phaseBegin);
+      ran[idx] = true;
+    };
+    phase.fn();
+  };
+
+  std::exception_ptr error;
+  if (parallel_) {
+    // Each phase waits on the futures of its dependencies, which carry the
+    // error of a failed phase on to everything depending on it
+    std::vector<std::promise<void>> done(phases_.size());
+    std::vector<std::shared_future<void>> doneFutures;
+    for (auto& promise : done) {
+      doneFutures.push_back(promise.get_future().share());
+    }
+    std::vector<std::thread> threads;
+    SCOPE_EXIT {
+      for (auto& thread : threads) {
+        thread.join();
+      }
+    };
+    for (size_t idx = 0; idx < phases_.size(); ++idx) {
+      try {
+        threads.emplace_back([&, idx] {
+          try {
+            for (auto dep : phases_[idx].deps) {
+              doneFutures[dep].get();
+            }
+            runPhase(idx);
+            done[idx].set_value();
+          } catch (...) {
+            done[idx].set_exception(std::current_exception());
+          }
+        });
+      } catch (...) {
+        // Fail the phases left, so no thread waits on them forever
+        for (; idx < phases_.size(); ++idx) {
+          done[idx].set_exception(std::current_exception());
+        }
+      }
+    }
+    for (auto& thread : threads) {
+      thread.join();
+    }
+    threads.clear();
+    // The first phase added to fail is the cause of any later failures
+    for (auto& future : doneFutures) {
+      try {
+        future.get();
+      } catch (...) {
+        error = std::current_exception();
+        break;
+      }
+    }
+  } else {
+    std::vector<char> failed(phases_.size(), false);
+    for (size_t idx = 0; idx < phases_.size(); ++idx) {
+      const auto& deps = phases_[idx].deps;
+      if (std::any_of(deps.begin(), deps.end(),
+                      [&](size_t dep) { return failed[dep]; })) {
+        failed[idx] = true;
+        continue;
+      }
+      try {
+        runPhase(idx);
+      } catch (...) {
+        failed[idx] = true;
+        if (!error) {
+          error = std::current_exception();
+        }
+      }
+    }
+  }
+
+  auto elapsed = duration_cast<microseconds>(Clock::now() - begin);
+  timings_.clear();
+  for (size_t idx = 0; idx < phases_.size(); ++idx) {
+    if (!ran[idx]) {
+      continue;
+    }
+    XLOG(INFO) << "Phase " << timings[idx].name << " took "
+               << timings[idx].duration.count() << "us, starting "
+               << timings[idx].wait.count() << "us in";
+    timings_.push_back(std::move(timings[idx]));
+  }
+  XLOG(INFO) << "Ran " << phases_.size() << " phases "
+             << (parallel_ ? "in parallel" : "serially") << " in "
+             << elapsed.count() << "us";
+  if (error) {
+    std::rethrow_exception(error);
+  }
+}
+
+}} // facebook::fboss
@@ -0,0 +1,78 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#pragma once
+
+#include <chrono>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace facebook { namespace fboss {
+
+/*
+ * BcmWarmBootReconciler runs the phases of bringing up the hardware tables,
+ * each once the phases it depends on are done.  When parallel, phases that
+ * do not depend on each other run at the same time on their own threads,
+ * e.g. reading back the warm boot cache while the ports are initialized.
+ *
+ * Each phase is recorded with the StartupProfiler, and logged with how long
+ * it waited for its dependencies and how long it ran.
+ */
+class BcmWarmBootReconciler {
+ public:
+  using PhaseFn = std::function<void()>;
+
+  struct PhaseTiming {
+    std::string name;
+    // From run() being called to the phase starting
+    std::chrono::microseconds wait{0};
+    std::chrono::microseconds duration{0};
+  };
+
+  explicit BcmWarmBootReconciler(bool parallel) : parallel_(parallel) {}
+
+  /*
+   * Adds a phase that runs after the phases named in deps.  Those must have
+   * been added already, which also rules out cycles.
+   */
+  void addPhase(std::string name, std::vector<std::string> deps, PhaseFn fn);
+
+  /*
+   * Runs all phases.  Unless parallel, they run one at a time in the order
+   * they were added.  If a phase throws, the phases depending on it are
+   * skipped, and the error is rethrown once the others are done.
+   */
+  void run();
+
+  /*
+   * The timings of the phases that ran, in the order they were added.
+   */
+  const std::vector<PhaseTiming>& getTimings() const {
+    return timings_;
+  }
+
+ private:
+  // Forbidden copy constructor and assignment operator
+  BcmWarmBootReconciler(BcmWarmBootReconciler const &) = delete;
+  BcmWarmBootReconciler& operator=(BcmWarmBootReconciler const &) = delete;
+
+  struct Phase {
+    std::string name;
+    // Indices of earlier phases
+    std::vector<size_t> deps;
+    PhaseFn fn;
+  };
+
+  const bool parallel_;
+  std::vector<Phase> phases_;
+  std::vector<PhaseTiming> timings_;
+};
+
+}} // facebook::fboss
@@ -0,0 +1,190 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "fboss/agent/hw/bcm/WarmBootStateFile.h"
+
+#include "fboss/agent/FbossError.h"
+#include "fboss/agent/SysError.h"
+
+#include <fcntl.h>
+
+#include <folly/Bits.h>
+#include <folly/File.h>
+#include <folly/FileUtil.h>
+#include <folly/MemoryMapping.h>
+#include <folly/experimental/bser/Bser.h>
+#include <folly/json.h>
+
+#include <cstring>
+#include <vector>
+
+namespace {
+/*
+ * File layout:
+ *
+ *   kSectionedMagic
+ *   uint32_t (little endian) length of the index
+ *   index: BSER encoded list of [top, key, offset, length]
+ *   sections: each BSER encoded, at offset bytes past the end of the index
+ */
+constexpr folly::StringPiece kSectionedMagic{"FBWBST01"};
+// Every BSER PDU starts with these two bytes, which can never start a JSON
+// document.
+constexpr folly::StringPiece kBserMagic{"\x00\x01", 2};
+
+constexpr size_t kHeaderSize = kSectionedMagic.size() + sizeof(uint32_t);
+
+folly::dynamic parseBser(folly::ByteRange range) {
+  return folly::bser::parseBser(range);
+}
+}
+
+namespace facebook { namespace fboss {
+
+WarmBootStateFile::WarmBootStateFile(const std::string& filename) {
+  try {
+    mapping_ = std::make_unique<folly::MemoryMapping>(filename.c_str());
+  } catch (const std::system_error& ex) {
+    throw SysError(
+        ex.code().value(), "Unable to map switch state from : ", filename);
+  }
+  auto contents = mapping_->range();
+  fileSize_ = contents.size();
+  if (folly::StringPiece(contents).startsWith(kSectionedMagic)) {
+    parseIndex(contents);
+  } else if (folly::StringPiece(contents).startsWith(kBserMagic)) {
+    decoded_ = parseBser(contents);
+    mapping_.reset();
+  } else {
+    decoded_ = folly::parseJson(folly::StringPiece(contents));
+    mapping_.reset();
+  }
+}
+
+WarmBootStateFile::WarmBootStateFile(folly::dynamic switchState)
+    : decoded_(std::move(switchState)) {}
+
+WarmBootStateFile::~WarmBootStateFile() {}
+
+void WarmBootStateFile::parseIndex(folly::ByteRange contents) {
+  if (contents.size() < kHeaderSize) {
+    throw FbossError("truncated warm boot state file header");
+  }
+  uint32_t indexLength;
+  memcpy(&indexLength, contents.data() + kSectionedMagic.size(),
+         sizeof(indexLength));
+  indexLength = folly::Endian::little(indexLength);
+  if (contents.size() < kHeaderSize + indexLength) {
+    throw FbossError("truncated warm boot state file index");
+  }
+  auto index = parseBser(contents.subpiece(kHeaderSize, indexLength));
+  data_ = contents.subpiece(kHeaderSize + indexLength);
+  for (const auto& entry : index) {
+    Section section{static_cast<size_t>(entry[2].asInt()),
+                    static_cast<size_t>(entry[3].asInt())};
+    if (section.offset + section.length > data_.size()) {
+      throw FbossError("warm boot state section ", entry[0].asString(), ".",
+                       entry[1].asString(), " lies outside of the file");
+    }
+    sections_[entry[0].asString()][entry[1].asString()] = section;
+  }
+}
+
+size_t WarmBootStateFile::write(
+    const folly::dynamic& switchState,
+    const std::string& filename) {
+  folly::bser::serialization_opts opts;
+  std::vector<folly::fbstring> sections;
+  folly::dynamic index = folly::dynamic::array;
+  size_t offset = 0;
+  for (const auto& top : switchState.items()) {
+    for (const auto& section : top.second.items()) {
+      sections.push_back(folly::bser::toBser(section.second, opts));
+      index.push_back(folly::dynamic::array(
+          top.first,
+          section.first,
+          static_cast<int64_t>(offset),
+          static_cast<int64_t>(sections.back().size())));
+      offset += sections.back().size();
+    }
+  }
+  auto serializedIndex = folly::bser::toBser(index, opts);
+  auto indexLength =
+      folly::Endian::little(static_cast<uint32_t>(serializedIndex.size()));
+
+  folly::File file(filename, O_WRONLY | O_CREAT | O_TRUNC);
+  auto writeOrThrow = [&](const void* buf, size_t count) {
+    if (folly::writeFull(file.fd(), buf, count) < 0) {
+      throw SysError(errno, "error writing warm boot state to ", filename);
+    }
+  };
+  writeOrThrow(kSectionedMagic.data(), kSectionedMagic.size());
+  writeOrThrow(&indexLength, sizeof(indexLength));
+  writeOrThrow(serializedIndex.data(), serializedIndex.size());
+  for (const auto& section : sections) {
+    writeOrThrow(section.data(), section.size());
+  }
+  return kHeaderSize + serializedIndex.size() + offset;
+}
+
+const WarmBootStateFile::Section* WarmBootStateFile::findSection(
+    folly::StringPiece top,
+    folly::StringPiece key) const {
+  auto topIt = sections_.find(top.str());
+  if (topIt == sections_.end()) {
+    return nullptr;
+  }
+  auto it = topIt->second.find(key.str());
+  return it == topIt->second.end() ? nullptr : &it->second;
+}
+
+bool WarmBootStateFile::hasSection(
+    folly::StringPiece top,
+    folly::StringPiece key) const {
+  if (!mapping_) {
+    auto topIt = decoded_.find(top);
+    return topIt != decoded_.items().end() && topIt->second.count(key) > 0;
+  }
+  return findSection(top, key) != nullptr;
+}
+
+folly::dynamic WarmBootStateFile::getSection(
+    folly::StringPiece top,
+    folly::StringPiece key) const {
+  if (!hasSection(top, key)) {
+    throw FbossError("no ", top, ".", key, " section in warm boot state");
+  }
+  if (!mapping_) {
+    return decoded_[top][key];
+  }
+  auto section = findSection(top, key);
+  return parseBser(data_.subpiece(section->offset, section->length));
+}
+
+folly::dynamic WarmBootStateFile::getAll() const {
+  if (!mapping_) {
+    return decoded_;
+  }
+  folly::dynamic switchState = folly::dynamic::object;
+  for (const auto& top : sections_) {
+    folly::dynamic& topState = switchState[top.first];
+    topState = folly::dynamic::object;
+    for (const auto& section : top.second) {
+      topState[section.first] = parseBser(
+          data_.subpiece(section.second.offset, section.second.length));
+    }
+  }
+  return switchState;
+}
+
+size_t WarmBootStateFile::size() const {
+  return fileSize_;
+}
+
+}} // facebook::fboss
@@ -0,0 +1,103 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#pragma once
+
+#include <folly/Range.h>
+#include <folly/dynamic.h>
+
+#include <map>
+#include <memory>
+#include <string>
+
+namespace folly {
+class MemoryMapping;
+}
+
+namespace facebook { namespace fboss {
+
+/*
+ * WarmBootStateFile provides access to the switch state dumped on graceful
+ * exit, one section at a time.
+ *
+ * The dumped state is an object of objects, e.g. {swSwitch: {ports: ...,
+ * routeTables: ...}, hwSwitch: {hostTable: ...}}.  write() stores every one
+ * of the inner values as a separately encoded BSER section, preceded by an
+ * index of where each section lives in the file.  When reading, the file is
+ * mmap'd and only the index is decoded up front; each section is decoded
+ * only when getSection() is called for it.  This lets warm boot start
+ * programming ports and interfaces without first paying to decode the
+ * route tables.
+ *
+ * Older warm boot files (JSON or a single BSER document) are decoded in full
+ * when opened, and served through the same interface.
+ */
+class WarmBootStateFile {
+ public:
+  /*
+   * Open the specified warm boot state file.
+   */
+  explicit WarmBootStateFile(const std::string& filename);
+  /*
+   * Serve the sections of an already decoded switch state.
+   */
+  explicit WarmBootStateFile(folly::dynamic switchState);
+  ~WarmBootStateFile();
+
+  /*
+   * Write switchState, which must be an object of objects, to filename in the
+   * sectioned layout.  Returns the number of bytes written.
+   */
+  static size_t write(
+      const folly::dynamic& switchState,
+      const std::string& filename);
+
+  bool hasSection(folly::StringPiece top, folly::StringPiece key) const;
+
+  /*
+   * Decode and return a single section.  Throws FbossError if the section
+   * doesn't exist.
+   */
+  folly::dynamic getSection(folly::StringPiece top, folly::StringPiece key)
+      const;
+
+  /*
+   * Decode and return the whole switch state.
+   */
+  folly::dynamic getAll() const;
+
+  /*
+   * The size of the file in bytes (0 if not backed by a file).
+   */
+  size_t size() const;
+
+ private:
+  struct Section {
+    size_t offset;
+    size_t length;
+  };
+  using SectionMap = std::map<std::string, std::map<std::string, Section>>;
+
+  // Forbidden copy constructor and assignment operator
+  WarmBootStateFile(WarmBootStateFile const&) = delete;
+  WarmBootStateFile& operator=(WarmBootStateFile const&) = delete;
+
+  void parseIndex(folly::ByteRange contents);
+  const Section* findSection(folly::StringPiece top, folly::StringPiece key)
+      const;
+
+  std::unique_ptr<folly::MemoryMapping> mapping_;
+  folly::ByteRange data_;
+  SectionMap sections_;
+  // Used for files that aren't in the sectioned layout
+  folly::dynamic decoded_{nullptr};
+  size_t fileSize_{0};
+};
+
+}} // facebook::fboss
@@ -28,6 +28,8 @@ struct HwPortStats {
   18: i64 outCongestionDiscardPkts_ = STAT_UNINITIALIZED;
   19: list<i64> queueOutDiscardBytes_ = []
   20: list<i64> queueOutBytes_ = []
+  21: list<i64> queueWredDroppedPackets_ = []
+  22: list<i64> queueEcnMarkedPackets_ = []
 }
 
 struct HwTrunkStats {
@@ -16,7 +16,8 @@ BcmAclEntry::BcmAclEntry(
     BcmSwitch* /*hw*/,
     int /*gid*/,
     const std::shared_ptr<AclEntry>& /*acl*/,
-    const BcmAclRanges& /*ranges*/) {}
+    const BcmAclRanges& /*ranges*/,
+    const BcmAclRangeMasks& /*rangeMasks*/) {}
 BcmAclEntry::~BcmAclEntry() {}
 
 }} // facebook::fboss
@@ -23,7 +23,21 @@ std::shared_ptr<PortQueue> BcmControlPlaneQueueManager::getCurrentQueueSettings(
 }
 
 void BcmControlPlaneQueueManager::program(
-    const std::shared_ptr<PortQueue>& /*queue*/) {}
+    const std::shared_ptr<PortQueue>& queue) {
+  auto queueIdx = queue->getID();
+  auto gport = getQueueGPort(queue->getStreamType(), queueIdx);
+  auto changes = getQueueChanges(gport, *queue);
+  if (changes.schedulingAndWeight) {
+    programSchedulingAndWeight(gport, queueIdx, queue);
+  }
+  if (changes.reservedBytes) {
+    programReservedBytes(gport, queueIdx, queue);
+  }
+  if (changes.sharedBytes) {
+    programSharedBytes(gport, queueIdx, queue);
+  }
+  setQueueSettings(gport, queue);
+}
 
 void BcmControlPlaneQueueManager::updateQueueStat(
     int /*queueIdx*/,
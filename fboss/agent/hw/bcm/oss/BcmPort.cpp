@@ -21,6 +21,8 @@ namespace facebook { namespace fboss {
 void BcmPort::prepareForGracefulExit() {}
 void BcmPort::setFEC(const std::shared_ptr<Port>& /*swPort*/) {}
 void BcmPort::setPause(const std::shared_ptr<Port>& /*swPort*/) {}
+// Ingress buffer limits are not available in this version of opennsl
+void BcmPort::setIngressBuffer(const std::shared_ptr<Port>& /*swPort*/) {}
 void BcmPort::setTxSetting(const std::shared_ptr<Port>& /*swPort*/) {}
 
 bool BcmPort::isFECEnabled() {
@@ -17,8 +17,27 @@ std::shared_ptr<PortQueue> BcmPortQueueManager::getCurrentQueueSettings(
   return std::shared_ptr<PortQueue>{};
 }
 
-void BcmPortQueueManager::program(
-  const std::shared_ptr<PortQueue>& /*queue*/) {}
+void BcmPortQueueManager::program(const std::shared_ptr<PortQueue>& queue) {
+  auto queueIdx = queue->getID();
+  auto gport = getQueueGPort(queue->getStreamType(), queueIdx);
+  auto changes = getQueueChanges(gport, *queue);
+  if (changes.schedulingAndWeight) {
+    programSchedulingAndWeight(gport, queueIdx, queue);
+  }
+  if (changes.reservedBytes) {
+    programReservedBytes(gport, queueIdx, queue);
+  }
+  if (changes.sharedBytes) {
+    programSharedBytes(gport, queueIdx, queue);
+  }
+  if (changes.scalingFactor) {
+    programAlpha(gport, queueIdx, queue);
+  }
+  if (changes.aqm) {
+    programAqms(gport, queueIdx, queue);
+  }
+  setQueueSettings(gport, queue);
+}
 
 void BcmPortQueueManager::updateQueueStat(
     int /*queueIdx*/,
@@ -37,13 +56,17 @@ void BcmPortQueueManager::programAlpha(
     int /*queueIdx*/,
     const std::shared_ptr<PortQueue>& /*queue*/) {}
 
-void BcmPortQueueManager::getAqms(
+BcmCosQueueManager::AqmProfile BcmPortQueueManager::getAqmProfile(
     opennsl_gport_t /*gport*/,
     int /*queueIdx*/,
-    std::shared_ptr<PortQueue> /*queue*/) const {}
+    AqmPacketType /*packetType*/) const {
+  // Discard profiles are not available in this version of opennsl
+  return AqmProfile();
+}
 
-void BcmPortQueueManager::programAqms(
+void BcmPortQueueManager::programAqmProfile(
     opennsl_gport_t /*gport*/,
     int /*queueIdx*/,
-    const std::shared_ptr<PortQueue>& /*queue*/) {}
+    AqmPacketType /*packetType*/,
+    const AqmProfile& /*profile*/) {}
 }} // facebook::fboss
@@ -0,0 +1,36 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "fboss/agent/hw/bcm/BcmRouteCounter.h"
+
+extern "C" {
+#include <opennsl/error.h>
+}
+
+namespace facebook { namespace fboss {
+
+BcmRouteCounter::BcmRouteCounter(const BcmSwitch* hw, RouteClassID classID)
+    : hw_(hw), classID_(classID), handle_(static_cast<int>(classID)) {}
+BcmRouteCounter::~BcmRouteCounter() {}
+
+int BcmRouteCounter::attach(opennsl_l3_route_t* /*route*/) const {
+  return OPENNSL_E_NONE;
+}
+
+int BcmRouteCounter::detach(opennsl_l3_route_t* /*route*/) const {
+  return OPENNSL_E_NONE;
+}
+
+int BcmRouteCounter::detachStale(
+    const BcmSwitch* /*hw*/,
+    opennsl_l3_route_t* /*route*/) {
+  return OPENNSL_E_NOT_FOUND;
+}
+
+}} // facebook::fboss
@@ -19,4 +19,10 @@ void BcmStatUpdater::updateAclStat(
   std::chrono::seconds /*now*/,
   MonotonicCounter* /*counter*/) {}
 
+void BcmStatUpdater::updateRouteCounter(
+  int /*unit*/,
+  BcmRouteCounterHandle /*handle*/,
+  std::chrono::seconds /*now*/,
+  RouteCounterStats* /*stats*/) {}
+
 }} // facebook::fboss
@@ -10,6 +10,8 @@
 #include "fboss/agent/hw/bcm/BcmSwitch.h"
 
 #include "fboss/agent/hw/BufferStatsLogger.h"
+#include "fboss/agent/hw/bcm/BcmBufferStatsSampler.h"
+#include "fboss/agent/hw/bcm/BcmPortCounterSampler.h"
 #include "fboss/agent/hw/bcm/BcmRxPacket.h"
 #include "fboss/agent/hw/bcm/gen-cpp2/packettrace_types.h"
 
@@ -84,10 +86,30 @@ std::unique_ptr<PacketTraceInfo> BcmSwitch::getPacketTrace(
 }
 
 int BcmSwitch::getHighresSamplers(
-    HighresSamplerList* /*samplers*/,
-    const std::string& /*namespaceString*/,
-    const std::set<CounterRequest>& /*counterSet*/) {
-  return 0;
+    HighresSamplerList* samplers,
+    const std::string& namespaceString,
+    const std::set<CounterRequest>& counterSet) {
+  std::unique_ptr<HighresSampler> sampler;
+  if (namespaceString == BcmPortCounterSampler::kIdentifier) {
+    sampler =
+        std::make_unique<BcmPortCounterSampler>(getPortTable(), counterSet);
+  } else if (namespaceString == BcmBufferStatsSampler::kIdentifier) {
+    // The sampler only reports what the collection logs
+    if (!isFineGrainedBufferStatLoggingEnabled()) {
+      XLOG(WARNING) << "Fine grained buffer stats are not being collected, "
+                    << "not sampling them";
+      return 0;
+    }
+    sampler = std::make_unique<BcmBufferStatsSampler>(
+        bufferStatsLogger_.get(), counterSet);
+  } else {
+    return 0;
+  }
+  auto numCounters = sampler->numCounters();
+  if (numCounters > 0) {
+    samplers->push_back(std::move(sampler));
+  }
+  return numCounters;
 }
 
 void BcmSwitch::exportSdkVersion() const {}
@@ -96,6 +118,20 @@ void BcmSwitch::exportSdkVersion() const {}
 void BcmSwitch::fetchL2Table(std::vector<L2EntryThrift>* /*l2Table*/) {
   return;
 }
+
+void BcmSwitch::fetchL2TablePage(
+    const L2TableQuery& /*query*/,
+    const std::string& /*cursor*/,
+    size_t /*maxEntries*/,
+    L2TablePage* /*page*/) {
+  return;
+}
+
+void BcmSwitch::setupL2Learning() {
+  // L2 callbacks not available in this version of opennsl
+}
+
+void BcmSwitch::unregisterL2Callback() {}
 #endif
 
 void BcmSwitch::initFieldProcessor() const {
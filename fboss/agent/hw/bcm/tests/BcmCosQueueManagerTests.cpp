@@ -0,0 +1,78 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+
+#include "fboss/agent/hw/bcm/BcmCosQueueManager.h"
+
+#include "fboss/agent/FbossError.h"
+
+#include <gtest/gtest.h>
+
+extern "C" {
+  struct ibde_t;
+  ibde_t* bde;
+}
+
+using namespace facebook::fboss;
+using AqmProfile = BcmCosQueueManager::AqmProfile;
+
+namespace {
+cfg::ActiveQueueManagement makeAqm(
+    bool earlyDrop, bool ecn, int32_t minLength, int32_t maxLength) {
+  cfg::LinearQueueCongestionDetection linear;
+  linear.minimumLength = minLength;
+  linear.maximumLength = maxLength;
+  cfg::ActiveQueueManagement aqm;
+  aqm.detection.set_linear(linear);
+  aqm.behavior.earlyDrop = earlyDrop;
+  aqm.behavior.ecn = ecn;
+  return aqm;
+}
+}
+
+TEST(BcmCosQueueManager, noAqm) {
+  auto profiles = BcmCosQueueManager::getAqmProfiles(folly::none);
+  EXPECT_EQ(AqmProfile(), profiles.ecnCapable);
+  EXPECT_EQ(AqmProfile(), profiles.notEcnCapable);
+  EXPECT_FALSE(BcmCosQueueManager::getAqm(profiles).hasValue());
+}
+
+TEST(BcmCosQueueManager, aqmBehaviors) {
+  for (bool earlyDrop : {false, true}) {
+    for (bool ecn : {false, true}) {
+      auto aqm = makeAqm(earlyDrop, ecn, 1000, 20000);
+      auto profiles = BcmCosQueueManager::getAqmProfiles(aqm);
+      const auto& ecnCapable = profiles.ecnCapable;
+      const auto& notEcnCapable = profiles.notEcnCapable;
+      EXPECT_EQ(earlyDrop || ecn, ecnCapable.enabled);
+      EXPECT_EQ(ecn, ecnCapable.markCongestion);
+      EXPECT_EQ(earlyDrop, notEcnCapable.enabled);
+      EXPECT_FALSE(notEcnCapable.markCongestion);
+      for (const auto& profile : {ecnCapable, notEcnCapable}) {
+        EXPECT_EQ(1000, profile.minThresholdBytes);
+        EXPECT_EQ(20000, profile.maxThresholdBytes);
+        EXPECT_EQ(100, profile.dropProbability);
+      }
+
+      // What we program reads back as the same config
+      auto readBack = BcmCosQueueManager::getAqm(profiles);
+      ASSERT_TRUE(readBack.hasValue());
+      EXPECT_EQ(aqm, *readBack);
+    }
+  }
+}
+
+TEST(BcmCosQueueManager, badAqmThresholds) {
+  EXPECT_THROW(
+      BcmCosQueueManager::getAqmProfiles(makeAqm(true, false, 2000, 1000)),
+      FbossError);
+  EXPECT_THROW(
+      BcmCosQueueManager::getAqmProfiles(makeAqm(true, false, -1, 1000)),
+      FbossError);
+}
@@ -0,0 +1,43 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "fboss/agent/hw/bcm/BcmRoute.h"
+
+#include <gtest/gtest.h>
+
+using namespace facebook::fboss;
+
+namespace {
+RouteNextHopSet makeNextHops(NextHopWeight weight1, NextHopWeight weight2) {
+  RouteNextHopSet nhops;
+  nhops.insert(ResolvedNextHop(
+      folly::IPAddress("10.0.0.1"), InterfaceID(1), weight1));
+  nhops.insert(ResolvedNextHop(
+      folly::IPAddress("10.0.0.2"), InterfaceID(2), weight2));
+  return nhops;
+}
+}
+
+TEST(BcmRouteTable, nextHopGroupKeyOfEcmp) {
+  // As the RIB gives ECMP next hops, with no weight
+  auto key = BcmRouteTable::getNextHopGroupKey(0, makeNextHops(0, 0));
+  EXPECT_EQ(0, key.first);
+  EXPECT_EQ(makeNextHops(UCMP_DEFAULT_WEIGHT, UCMP_DEFAULT_WEIGHT),
+            key.second);
+  // Routes are programmed with normalized next hops, and find the same group
+  auto programmed = BcmRouteTable::normalizeNextHops(makeNextHops(0, 0));
+  EXPECT_EQ(key, BcmRouteTable::getNextHopGroupKey(0, programmed));
+}
+
+TEST(BcmRouteTable, nextHopGroupKeyOfUcmp) {
+  auto key = BcmRouteTable::getNextHopGroupKey(3, makeNextHops(1, 4));
+  EXPECT_EQ(3, key.first);
+  EXPECT_EQ(makeNextHops(1, 4), key.second);
+  EXPECT_NE(key, BcmRouteTable::getNextHopGroupKey(3, makeNextHops(1, 2)));
+}
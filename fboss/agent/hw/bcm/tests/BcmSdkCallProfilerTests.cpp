@@ -0,0 +1,64 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+
+#include "fboss/agent/hw/bcm/BcmSdkCallProfiler.h"
+
+#include <gtest/gtest.h>
+
+using namespace facebook::fboss;
+
+namespace {
+// Stands in for the stats of the tracing shim
+BcmSdkCallStats sdkCallStats("opennsl_test_call");
+
+void testCall(uint64_t cycles) {
+  BcmSdkCallTimer timer(&sdkCallStats);
+  sdkCallStats.record(cycles);
+}
+}
+
+TEST(BcmSdkCallProfiler, profile) {
+  ASSERT_TRUE(BcmSdkCallProfiler::isAvailable());
+
+  // Nothing is timed while profiling is off
+  { BcmSdkCallTimer timer(&sdkCallStats); }
+  EXPECT_TRUE(BcmSdkCallProfiler::getProfile().empty());
+
+  BcmSdkCallProfiler::setEnabled(true);
+  for (uint64_t cycles : {1, 5, 6, 7, 1000}) {
+    // Each call records its cycles, then is timed itself
+    testCall(cycles);
+  }
+  auto profiles = BcmSdkCallProfiler::getProfile();
+  BcmSdkCallProfiler::setEnabled(false);
+
+  ASSERT_EQ(1, profiles.size());
+  const auto& profile = profiles[0];
+  EXPECT_EQ("opennsl_test_call", profile.function);
+  EXPECT_EQ(10, profile.calls);
+  EXPECT_LE(1019, profile.totalCycles);
+  EXPECT_LE(1000, profile.maxCycles);
+  ASSERT_LE(10, profile.cycleHistogram.size());
+  EXPECT_LE(1, profile.cycleHistogram[0]);
+  EXPECT_LE(3, profile.cycleHistogram[2]);
+  EXPECT_LE(1, profile.cycleHistogram[9]);
+  int64_t calls = 0;
+  for (auto count : profile.cycleHistogram) {
+    calls += count;
+  }
+  EXPECT_EQ(10, calls);
+  EXPECT_NE(0, profile.cycleHistogram.back());
+
+  // Turning profiling off keeps the profile, and turning it on clears it
+  EXPECT_EQ(10, BcmSdkCallProfiler::getProfile()[0].calls);
+  BcmSdkCallProfiler::setEnabled(true);
+  EXPECT_TRUE(BcmSdkCallProfiler::getProfile().empty());
+  BcmSdkCallProfiler::setEnabled(false);
+}
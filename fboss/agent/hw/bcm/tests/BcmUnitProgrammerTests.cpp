@@ -0,0 +1,112 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "fboss/agent/hw/bcm/BcmUnitProgrammer.h"
+
+#include "fboss/agent/state/StateDelta.h"
+#include "fboss/agent/state/SwitchState.h"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+
+using namespace facebook::fboss;
+using std::make_shared;
+using std::shared_ptr;
+
+namespace {
+// A unit applying all of every delta
+shared_ptr<SwitchState> applyAll(const StateDelta& delta) {
+  return delta.newState();
+}
+}
+
+TEST(BcmUnitProgrammer, programsUnitsInParallel) {
+  constexpr int kUnits = 3;
+  // Each unit waits for all of them to have started, which only happens if
+  // they are programmed at the same time
+  std::mutex lock;
+  std::condition_variable cv;
+  int started = 0;
+  auto program = [&](const StateDelta& delta) {
+    std::unique_lock<std::mutex> guard(lock);
+    ++started;
+    cv.notify_all();
+    if (!cv.wait_for(guard, std::chrono::seconds(5),
+                     [&] { return started == kUnits; })) {
+      throw std::runtime_error("units programmed one at a time");
+    }
+    return delta.newState();
+  };
+  std::vector<BcmUnitProgrammer::Unit> units;
+  for (int unit = 0; unit < kUnits; ++unit) {
+    units.push_back({unit, program});
+  }
+  BcmUnitProgrammer programmer(std::move(units));
+  EXPECT_EQ(kUnits, programmer.numUnits());
+
+  auto oldState = make_shared<SwitchState>();
+  auto newState = make_shared<SwitchState>();
+  StateDelta delta(oldState, newState);
+  EXPECT_EQ(newState, programmer.stateChanged(delta));
+  EXPECT_EQ(kUnits, programmer.getLastDurations().size());
+
+  // The unit threads are reused for the next update
+  started = 0;
+  StateDelta delta2(newState, make_shared<SwitchState>());
+  EXPECT_EQ(delta2.newState(), programmer.stateChanged(delta2));
+}
+
+TEST(BcmUnitProgrammer, revertsUnitsToPartialState) {
+  auto oldState = make_shared<SwitchState>();
+  auto newState = make_shared<SwitchState>();
+  std::atomic<int> reverted{0};
+  BcmUnitProgrammer programmer({
+      {0, [&](const StateDelta& delta) {
+         if (delta.oldState() == newState) {
+           // Programmed back to what unit 1 applied
+           EXPECT_EQ(oldState, delta.newState());
+           ++reverted;
+         }
+         return delta.newState();
+       }},
+      // Fails to apply the update
+      {1, [&](const StateDelta& delta) { return delta.oldState(); }},
+      {2, applyAll},
+  });
+  StateDelta delta(oldState, newState);
+  EXPECT_EQ(oldState, programmer.stateChanged(delta));
+  EXPECT_EQ(1, reverted);
+}
+
+TEST(BcmUnitProgrammer, rethrowsAfterAllUnits) {
+  std::atomic<int> ran{0};
+  BcmUnitProgrammer programmer({
+      {0, [&](const StateDelta& delta) {
+         ++ran;
+         return delta.newState();
+       }},
+      {1, [](const StateDelta&) -> shared_ptr<SwitchState> {
+         throw std::runtime_error("unit 1");
+       }},
+      {2, [&](const StateDelta& delta) {
+         std::this_thread::sleep_for(std::chrono::milliseconds(50));
+         ++ran;
+         return delta.newState();
+       }},
+  });
+  StateDelta delta(make_shared<SwitchState>(), make_shared<SwitchState>());
+  EXPECT_THROW(programmer.stateChanged(delta), std::runtime_error);
+  EXPECT_EQ(2, ran);
+}
@@ -0,0 +1,81 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "fboss/agent/hw/bcm/BcmWarmBootReconciler.h"
+
+#include "fboss/agent/FbossError.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <stdexcept>
+
+using namespace facebook::fboss;
+
+namespace {
+// Runs the same phases, recording the order they finish in
+std::vector<std::string> runPhases(bool parallel) {
+  std::mutex lock;
+  std::vector<std::string> finished;
+  auto phase = [&](std::string name) {
+    return [&, name] {
+      std::lock_guard<std::mutex> g(lock);
+      finished.push_back(name);
+    };
+  };
+  BcmWarmBootReconciler phases(parallel);
+  phases.addPhase("cache", {}, phase("cache"));
+  phases.addPhase("egress", {"cache"}, phase("egress"));
+  phases.addPhase("ports", {}, phase("ports"));
+  phases.addPhase("linkscan", {"ports", "egress"}, phase("linkscan"));
+  phases.run();
+  EXPECT_EQ(4, phases.getTimings().size());
+  return finished;
+}
+
+size_t position(const std::vector<std::string>& names, const char* name) {
+  return std::find(names.begin(), names.end(), name) - names.begin();
+}
+}
+
+TEST(BcmWarmBootReconciler, serialKeepsOrder) {
+  EXPECT_EQ(
+      (std::vector<std::string>{"cache", "egress", "ports", "linkscan"}),
+      runPhases(false));
+}
+
+TEST(BcmWarmBootReconciler, parallelKeepsDependencies) {
+  for (int i = 0; i < 20; ++i) {
+    auto finished = runPhases(true);
+    ASSERT_EQ(4, finished.size());
+    EXPECT_LT(position(finished, "cache"), position(finished, "egress"));
+    EXPECT_LT(position(finished, "egress"), position(finished, "linkscan"));
+    EXPECT_LT(position(finished, "ports"), position(finished, "linkscan"));
+  }
+}
+
+TEST(BcmWarmBootReconciler, unknownDependency) {
+  BcmWarmBootReconciler phases(true);
+  EXPECT_THROW(phases.addPhase("ports", {"cache"}, [] {}), FbossError);
+}
+
+TEST(BcmWarmBootReconciler, failureSkipsDependents) {
+  for (bool parallel : {false, true}) {
+    std::atomic<int> ran{0};
+    BcmWarmBootReconciler phases(parallel);
+    phases.addPhase("cache", {}, [] { throw std::runtime_error("cache"); });
+    phases.addPhase("egress", {"cache"}, [&] { ++ran; });
+    phases.addPhase("ports", {}, [&] { ++ran; });
+    EXPECT_THROW(phases.run(), std::runtime_error);
+    // Only the phase not depending on the failed one ran
+    EXPECT_EQ(1, ran);
+  }
+}
@@ -0,0 +1,70 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "fboss/agent/hw/bcm/WarmBootStateFile.h"
+
+#include "fboss/agent/FbossError.h"
+
+#include <folly/FileUtil.h>
+#include <folly/experimental/TestUtil.h>
+#include <folly/json.h>
+
+#include <gtest/gtest.h>
+
+using namespace facebook::fboss;
+using folly::dynamic;
+
+namespace {
+dynamic makeState() {
+  dynamic routes = dynamic::array;
+  for (int i = 0; i < 100; ++i) {
+    routes.push_back(dynamic::object("prefix", folly::to<std::string>(
+        "10.0.", i, ".0/24"))("nexthops", dynamic::array(i, i + 1)));
+  }
+  return dynamic::object
+    ("swSwitch", dynamic::object
+      ("ports", dynamic::object("1", dynamic::object("name", "eth1/1/1")))
+      ("routeTables", routes)
+      ("defaultVlan", 1))
+    ("hwSwitch", dynamic::object
+      ("hostTable", dynamic::object("hosts", dynamic::array())));
+}
+}
+
+TEST(WarmBootStateFile, sectionedRoundTrip) {
+  folly::test::TemporaryFile tmp;
+  auto state = makeState();
+  auto bytes = WarmBootStateFile::write(state, tmp.path().string());
+
+  WarmBootStateFile stateFile(tmp.path().string());
+  EXPECT_EQ(bytes, stateFile.size());
+  EXPECT_TRUE(stateFile.hasSection("swSwitch", "routeTables"));
+  EXPECT_FALSE(stateFile.hasSection("swSwitch", "acls"));
+  EXPECT_FALSE(stateFile.hasSection("noSuchSwitch", "ports"));
+  EXPECT_EQ(state["swSwitch"]["ports"],
+            stateFile.getSection("swSwitch", "ports"));
+  EXPECT_EQ(state["swSwitch"]["routeTables"],
+            stateFile.getSection("swSwitch", "routeTables"));
+  EXPECT_EQ(1, stateFile.getSection("swSwitch", "defaultVlan").asInt());
+  EXPECT_THROW(stateFile.getSection("swSwitch", "acls"), FbossError);
+  EXPECT_EQ(state, stateFile.getAll());
+}
+
+TEST(WarmBootStateFile, readJson) {
+  // Warm boot files written by older versions are JSON
+  folly::test::TemporaryFile tmp;
+  auto state = makeState();
+  ASSERT_TRUE(folly::writeFile(folly::toJson(state), tmp.path().c_str()));
+
+  WarmBootStateFile stateFile(tmp.path().string());
+  EXPECT_TRUE(stateFile.hasSection("hwSwitch", "hostTable"));
+  EXPECT_EQ(state["swSwitch"]["routeTables"],
+            stateFile.getSection("swSwitch", "routeTables"));
+  EXPECT_EQ(state, stateFile.getAll());
+}
@@ -26,7 +26,7 @@ namespace facebook { namespace fboss {
 
 SimPlatform::SimPlatform(folly::MacAddress mac, uint32_t numPorts)
   : mac_(mac),
-    hw_(new SimSwitch(this, numPorts)) {
+    hw_(new SimSwitch(this, numPorts, SimSwitch::HwModel::fromFlags())) {
 }
 
 SimPlatform::~SimPlatform() {
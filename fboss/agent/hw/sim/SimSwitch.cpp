@@ -9,24 +9,146 @@
  */
 #include "fboss/agent/hw/sim/SimSwitch.h"
 
+#include "common/stats/ServiceData.h"
+#include "fboss/agent/FbossError.h"
+#include "fboss/agent/PortStatsSnapshot.h"
+#include "fboss/agent/state/AclEntry.h"
+#include "fboss/agent/state/ArpEntry.h"
+#include "fboss/agent/state/DeltaFunctions.h"
+#include "fboss/agent/state/NdpEntry.h"
+#include "fboss/agent/state/NodeMapDelta-defs.h"
+#include "fboss/agent/state/Port.h"
+#include "fboss/agent/state/PortMap.h"
+#include "fboss/agent/state/Route.h"
+#include "fboss/agent/state/RouteDelta.h"
 #include "fboss/agent/state/StateDelta.h"
+#include "fboss/agent/state/SwitchState-defs.h"
 #include "fboss/agent/state/SwitchState.h"
+#include "fboss/agent/state/VlanMapDelta.h"
 #include "fboss/agent/hw/mock/MockRxPacket.h"
 #include "fboss/agent/hw/mock/MockTxPacket.h"
 
 #include <folly/Conv.h>
 #include <folly/dynamic.h>
 #include <folly/Memory.h>
+#include <folly/String.h>
+#include <folly/logging/xlog.h>
+
+#include <cmath>
+#include <thread>
+#include <type_traits>
+
+DEFINE_bool(sim_high_fidelity, false,
+            "Model the table sizes and programming times of the hardware, "
+            "and count synthetic traffic, rather than taking every update "
+            "instantly");
+DEFINE_string(sim_table_capacity, "",
+              "Table sizes to model instead of the defaults, as "
+              "table=entries pairs separated by commas, with -1 for a table "
+              "that is never full");
+DEFINE_string(sim_table_latency_us, "",
+              "Median times to program an entry of each table to model "
+              "instead of the defaults, as table=microseconds pairs "
+              "separated by commas");
 
 using std::make_unique;
 using std::make_shared;
 using std::shared_ptr;
 using std::string;
+using std::chrono::microseconds;
+
+namespace {
+
+// The speed of ports that are left at the default
+constexpr int64_t kDefaultSpeedMbps = 100000;
+// The size of the synthetic packets
+constexpr int64_t kSyntheticPacketBytes = 500;
+// The synthetic counters of each port, in PortCounters::counters order
+const std::vector<std::pair<const char*, bool>> kSyntheticCounters = {
+  {"in_bytes", true},
+  {"in_unicast_pkts", false},
+  {"out_bytes", true},
+  {"out_unicast_pkts", false},
+};
+
+}
 
 namespace facebook { namespace fboss {
 
-SimSwitch::SimSwitch(SimPlatform* /*platform*/, uint32_t numPorts)
-    : numPorts_(numPorts) {}
+SimSwitch::HwModel SimSwitch::HwModel::tomahawk() {
+  HwModel model;
+  model.tables[LPM_V4] = {16384, microseconds(20), 0.5};
+  model.tables[LPM_V6_MASK_0_64] = {8192, microseconds(25), 0.5};
+  model.tables[LPM_V6_MASK_65_127] = {256, microseconds(30), 0.5};
+  model.tables[HOST] = {8192, microseconds(15), 0.5};
+  model.tables[ECMP_GROUPS] = {1024, microseconds(60), 0.7};
+  model.tables[ACL_ENTRIES] = {2048, microseconds(100), 0.7};
+  return model;
+}
+
+folly::Optional<SimSwitch::HwModel> SimSwitch::HwModel::fromFlags() {
+  if (!FLAGS_sim_high_fidelity) {
+    return folly::none;
+  }
+  auto model = tomahawk();
+  auto applyOverrides = [&](const string& spec, auto apply) {
+    std::vector<folly::StringPiece> pairs;
+    folly::split(',', spec, pairs, true);
+    for (auto pair : pairs) {
+      folly::StringPiece name;
+      int64_t value;
+      if (!folly::split('=', pair, name, value)) {
+        throw FbossError("Invalid sim table override ", pair);
+      }
+      bool found = false;
+      for (int i = 0; i < NUM_TABLES; ++i) {
+        if (name == getTableName(static_cast<Table>(i))) {
+          apply(&model.tables[i], value);
+          found = true;
+        }
+      }
+      if (!found) {
+        throw FbossError("Unknown sim table ", name);
+      }
+    }
+  };
+  applyOverrides(FLAGS_sim_table_capacity, [](TableModel* table, int64_t v) {
+    table->capacity = v;
+  });
+  applyOverrides(FLAGS_sim_table_latency_us, [](TableModel* table, int64_t v) {
+    table->latency = microseconds(v);
+  });
+  return model;
+}
+
+SimSwitch::SimSwitch(
+    SimPlatform* /*platform*/,
+    uint32_t numPorts,
+    folly::Optional<HwModel> model)
+    : numPorts_(numPorts),
+      model_(std::move(model)),
+      ports_(make_shared<PortMap>()) {}
+
+const char* SimSwitch::getTableName(Table table) {
+  // The names BcmTableCapacity exports the same tables under
+  switch (table) {
+    case LPM_V4:
+      return "lpm_ipv4";
+    case LPM_V6_MASK_0_64:
+      return "lpm_ipv6_mask_0_64";
+    case LPM_V6_MASK_65_127:
+      return "lpm_ipv6_mask_65_127";
+    case HOST:
+      return "l3_host";
+    case ECMP_GROUPS:
+      return "l3_ecmp_groups";
+    case ACL_ENTRIES:
+      return "acl_entries";
+    case NUM_TABLES:
+      break;
+  }
+  return "unknown";
+}
 
 HwInitResult SimSwitch::init(HwSwitch::Callback* callback) {
   HwInitResult ret;
@@ -43,8 +165,260 @@ HwInitResult SimSwitch::init(HwSwitch::Callback* callback) {
 }
 
 std::shared_ptr<SwitchState> SimSwitch::stateChanged(const StateDelta& delta) {
-  // TODO
-  return delta.newState();
+  if (!model_) {
+    return delta.newState();
+  }
+
+  auto appliedState = delta.newState();
+  pendingLatency_ = microseconds(0);
+  for (const auto& rtDelta : delta.getRouteTablesDelta()) {
+    auto id = rtDelta.getOld() ? rtDelta.getOld()->getID()
+                               : rtDelta.getNew()->getID();
+    forEachChanged(
+        rtDelta.getRoutesV4Delta(),
+        [&](const shared_ptr<RouteV4>& oldRoute,
+            const shared_ptr<RouteV4>& newRoute) {
+          processRouteDelta(id, oldRoute, newRoute, &appliedState);
+        },
+        [&](const shared_ptr<RouteV4>& newRoute) {
+          processRouteDelta<RouteV4>(id, nullptr, newRoute, &appliedState);
+        },
+        [&](const shared_ptr<RouteV4>& oldRoute) {
+          processRouteDelta<RouteV4>(id, oldRoute, nullptr, &appliedState);
+        });
+    forEachChanged(
+        rtDelta.getRoutesV6Delta(),
+        [&](const shared_ptr<RouteV6>& oldRoute,
+            const shared_ptr<RouteV6>& newRoute) {
+          processRouteDelta(id, oldRoute, newRoute, &appliedState);
+        },
+        [&](const shared_ptr<RouteV6>& newRoute) {
+          processRouteDelta<RouteV6>(id, nullptr, newRoute, &appliedState);
+        },
+        [&](const shared_ptr<RouteV6>& oldRoute) {
+          processRouteDelta<RouteV6>(id, oldRoute, nullptr, &appliedState);
+        });
+  }
+
+  for (const auto& vlanDelta : delta.getVlansDelta()) {
+    for (const auto& arpDelta : vlanDelta.getArpDelta()) {
+      processNeighborDelta<DeltaValue<ArpEntry>, ArpTable>(
+          arpDelta, &appliedState);
+    }
+    for (const auto& ndpDelta : vlanDelta.getNdpDelta()) {
+      processNeighborDelta<DeltaValue<NdpEntry>, NdpTable>(
+          ndpDelta, &appliedState);
+    }
+  }
+
+  forEachChanged(
+      delta.getAclsDelta(),
+      [&](const shared_ptr<AclEntry>&, const shared_ptr<AclEntry>&) {
+        program(ACL_ENTRIES);
+      },
+      [&](const shared_ptr<AclEntry>&) {
+        changeUsage(ACL_ENTRIES, 1);
+        program(ACL_ENTRIES);
+      },
+      [&](const shared_ptr<AclEntry>&) {
+        changeUsage(ACL_ENTRIES, -1);
+        program(ACL_ENTRIES);
+      });
+
+  *ports_.wlock() = appliedState->getPorts();
+  if (pendingLatency_.count() > 0) {
+    std::this_thread::sleep_for(pendingLatency_);
+    programmingUs_.fetch_add(
+        pendingLatency_.count(), std::memory_order_relaxed);
+  }
+  return appliedState;
+}
+
+template <typename RouteT>
+void SimSwitch::processRouteDelta(
+    RouterID id,
+    const std::shared_ptr<RouteT>& oldRoute,
+    const std::shared_ptr<RouteT>& newRoute,
+    std::shared_ptr<SwitchState>* appliedState) {
+  auto route = newRoute ? newRoute : oldRoute;
+  auto table = LPM_V4;
+  if (std::is_same<RouteT, RouteV6>::value) {
+    table = route->prefix().mask <= 64 ? LPM_V6_MASK_0_64 : LPM_V6_MASK_65_127;
+  }
+  // Unresolved routes aren't programmed, and so take no entries
+  bool oldProgrammed = oldRoute && oldRoute->isResolved();
+  bool newProgrammed = newRoute && newRoute->isResolved();
+  auto getGroup = [](const std::shared_ptr<RouteT>& programmed)
+      -> const RouteNextHopEntry::NextHopSet* {
+    const auto& nhops = programmed->getForwardInfo().getNextHopSet();
+    return nhops.size() > 1 ? &nhops : nullptr;
+  };
+  auto oldGroup = oldProgrammed ? getGroup(oldRoute) : nullptr;
+  auto newGroup = newProgrammed ? getGroup(newRoute) : nullptr;
+
+  if (newProgrammed) {
+    bool needsEntry = !oldProgrammed;
+    bool needsGroup = newGroup && !ecmpGroups_.count(*newGroup);
+    if ((needsEntry && !hasRoom(table)) ||
+        (needsGroup && !hasRoom(ECMP_GROUPS))) {
+      XLOG(WARNING) << "Simulated " << getTableName(table) << " or "
+                    << getTableName(ECMP_GROUPS) << " table is full, "
+                    << "not programming route " << newRoute->str();
+      SwitchState::revertNewRouteEntry(id, newRoute, oldRoute, appliedState);
+      return;
+    }
+  }
+
+  // Take the new group before releasing the old, in case they are the same
+  if (newGroup && ecmpGroups_[*newGroup]++ == 0) {
+    changeUsage(ECMP_GROUPS, 1);
+    program(ECMP_GROUPS);
+  }
+  if (oldGroup) {
+    auto it = ecmpGroups_.find(*oldGroup);
+    if (it != ecmpGroups_.end() && --it->second == 0) {
+      ecmpGroups_.erase(it);
+      changeUsage(ECMP_GROUPS, -1);
+      program(ECMP_GROUPS);
+    }
+  }
+  changeUsage(table, int64_t(newProgrammed) - int64_t(oldProgrammed));
+  if (oldProgrammed || newProgrammed) {
+    program(table);
+  }
+}
+
+template <typename DELTA, typename ParentClassT>
+void SimSwitch::processNeighborDelta(
+    const DELTA& delta,
+    std::shared_ptr<SwitchState>* appliedState) {
+  using EntryT = typename DELTA::Node;
+  const auto& oldEntry = delta.getOld();
+  const auto& newEntry = delta.getNew();
+  // Pending entries are programmed too, to send their packets to the CPU
+  if (!oldEntry) {
+    if (!hasRoom(HOST)) {
+      XLOG(WARNING) << "Simulated " << getTableName(HOST) << " table is "
+                    << "full, not programming neighbor "
+                    << newEntry->getIP().str();
+      SwitchState::revertNewNeighborEntry<EntryT, ParentClassT>(
+          newEntry, nullptr, appliedState);
+      return;
+    }
+    changeUsage(HOST, 1);
+  } else if (!newEntry) {
+    changeUsage(HOST, -1);
+  }
+  program(HOST);
+}
+
+bool SimSwitch::isValidStateUpdate(const StateDelta& delta) const {
+  if (!model_) {
+    return true;
+  }
+  // ACLs can't be left out of the applied state, so like BcmSwitch, reject
+  // updates that would overflow the table before applying any of them
+  int64_t added = 0;
+  forEachAdded(delta.getAclsDelta(), [&](const shared_ptr<AclEntry>&) {
+    ++added;
+  });
+  forEachRemoved(delta.getAclsDelta(), [&](const shared_ptr<AclEntry>&) {
+    --added;
+  });
+  auto capacity = model_->tables[ACL_ENTRIES].capacity;
+  if (capacity >= 0 && added > 0 &&
+      getTableUsage(ACL_ENTRIES) + added > capacity) {
+    XLOG(ERR) << "State update would overflow the simulated "
+              << getTableName(ACL_ENTRIES) << " table";
+    return false;
+  }
+  return true;
+}
+
+bool SimSwitch::hasRoom(Table table) const {
+  auto capacity = model_->tables[table].capacity;
+  return capacity < 0 || getTableUsage(table) < capacity;
+}
+
+void SimSwitch::changeUsage(Table table, int64_t change) {
+  usage_[table].fetch_add(change, std::memory_order_relaxed);
+}
+
+void SimSwitch::program(Table table) {
+  const auto& config = model_->tables[table];
+  if (config.latency.count() <= 0) {
+    return;
+  }
+  if (config.latencySigma <= 0) {
+    pendingLatency_ += config.latency;
+    return;
+  }
+  std::lognormal_distribution<double> latency(
+      std::log(config.latency.count()), config.latencySigma);
+  pendingLatency_ += microseconds(std::llround(latency(rng_)));
+}
+
+void SimSwitch::updateStats(SwitchStats* /*switchStats*/) {
+  if (!model_) {
+    return;
+  }
+  for (int i = 0; i < NUM_TABLES; ++i) {
+    auto table = static_cast<Table>(i);
+    auto prefix = folly::to<string>("hw_table.", getTableName(table));
+    fbData->setCounter(prefix + ".used", getTableUsage(table));
+    if (model_->tables[i].capacity >= 0) {
+      fbData->setCounter(prefix + ".max", model_->tables[i].capacity);
+    }
+  }
+
+  auto now = std::chrono::steady_clock::now();
+  double elapsed = lastStatsUpdate_.time_since_epoch().count() == 0
+      ? 0
+      : std::chrono::duration<double>(now - lastStatsUpdate_).count();
+  lastStatsUpdate_ = now;
+  auto nowSecs = std::chrono::duration_cast<std::chrono::seconds>(
+      std::chrono::system_clock::now().time_since_epoch());
+
+  auto ports = ports_.copy();
+  std::map<PortID, PortCounters> portCounters;
+  for (const auto& port : *ports) {
+    auto statPrefix = PortStatsSnapshot::getStatPrefix(
+        port->getID(), port->getName());
+    auto& counters = portCounters[port->getID()];
+    auto it = portCounters_.find(port->getID());
+    if (it != portCounters_.end() && it->second.statPrefix == statPrefix) {
+      counters = std::move(it->second);
+    } else {
+      counters.statPrefix = statPrefix;
+      for (const auto& counter : kSyntheticCounters) {
+        counters.counters.emplace_back(
+            stats::MonotonicCounter(
+                folly::to<string>(statPrefix, ".", counter.first),
+                stats::SUM,
+                stats::RATE));
+        counters.values.push_back(0);
+      }
+    }
+
+    if (port->isEnabled()) {
+      auto speedMbps = static_cast<int64_t>(port->getSpeed());
+      if (speedMbps == 0) {
+        speedMbps = kDefaultSpeedMbps;
+      }
+      auto bytes = static_cast<int64_t>(
+          speedMbps * 1000 * 1000 / 8 * model_->portUtilization * elapsed);
+      for (size_t i = 0; i < kSyntheticCounters.size(); ++i) {
+        counters.values[i] += kSyntheticCounters[i].second
+            ? bytes
+            : bytes / kSyntheticPacketBytes;
+      }
+    }
+    for (size_t i = 0; i < kSyntheticCounters.size(); ++i) {
+      counters.counters[i].updateValue(nowSecs, counters.values[i]);
+    }
+  }
+  // Ports that are gone are dropped along with their counters
+  portCounters_.swap(portCounters);
 }
 
 std::unique_ptr<TxPacket> SimSwitch::allocatePacket(uint32_t size) {
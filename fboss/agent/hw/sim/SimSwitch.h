@@ -10,15 +10,88 @@
 #pragma once
 
 #include "fboss/agent/HwSwitch.h"
+#include "fboss/agent/state/RouteNextHopEntry.h"
+
+#include "common/stats/MonotonicCounter.h"
+
+#include <folly/Optional.h>
+#include <folly/Synchronized.h>
+#include <gflags/gflags.h>
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <random>
+
+DECLARE_bool(sim_high_fidelity);
+DECLARE_string(sim_table_capacity);
+DECLARE_string(sim_table_latency_us);
 
 namespace facebook { namespace fboss {
 
+class PortMap;
 class SimPlatform;
 class SwitchState;
 
+/*
+ * SimSwitch stands in for the hardware, for benchmarks and tests that run
+ * the agent off box.
+ *
+ * By default it takes every state update as is, instantly.  Given a
+ * HwModel, it instead models the hardware as a performance test needs:
+ *  - Each table has a capacity.  Routes and neighbors that don't fit are
+ *    left out of the applied state, as BcmSwitch does when the hardware
+ *    returns table full, and updates that would overflow the ACL table are
+ *    rejected up front.
+ *  - Programming each entry takes time, drawn from a log-normal
+ *    distribution per table, which stateChanged() sleeps for.
+ *  - updateStats() counts synthetic traffic on the enabled ports, and
+ *    exports how full each table is.
+ */
 class SimSwitch : public HwSwitch {
  public:
-  SimSwitch(SimPlatform* platform, uint32_t numPorts);
+  enum Table {
+    LPM_V4,
+    LPM_V6_MASK_0_64,
+    LPM_V6_MASK_65_127,
+    HOST,
+    ECMP_GROUPS,
+    ACL_ENTRIES,
+    NUM_TABLES,
+  };
+
+  struct TableModel {
+    // Negative for a table that is never full
+    int64_t capacity{-1};
+    // How long programming, changing or removing an entry takes: the median,
+    // and the standard deviation of its logarithm
+    std::chrono::microseconds latency{0};
+    double latencySigma{0.5};
+  };
+
+  struct HwModel {
+    std::array<TableModel, NUM_TABLES> tables;
+    // The share of line rate counted in each direction on enabled ports
+    double portUtilization{0.1};
+
+    /*
+     * Roughly the table sizes and programming times of a Tomahawk.
+     */
+    static HwModel tomahawk();
+
+    /*
+     * The Tomahawk model with the sim_table_capacity and
+     * sim_table_latency_us overrides if sim_high_fidelity is set, otherwise
+     * none.
+     */
+    static folly::Optional<HwModel> fromFlags();
+  };
+
+  SimSwitch(
+      SimPlatform* platform,
+      uint32_t numPorts,
+      folly::Optional<HwModel> model = folly::none);
 
   HwInitResult init(Callback* callback) override;
   std::shared_ptr<SwitchState> stateChanged(const StateDelta& delta) override;
@@ -36,8 +109,7 @@ class SimSwitch : public HwSwitch {
   void injectPacket(std::unique_ptr<RxPacket> pkt);
   void initialConfigApplied() override {}
 
-  // TODO
-  void updateStats(SwitchStats* /*switchStats*/) override {}
+  void updateStats(SwitchStats* switchStats) override;
 
   int getHighresSamplers(
       HighresSamplerList* /*samplers*/,
@@ -72,8 +144,23 @@ class SimSwitch : public HwSwitch {
     return true;
   }
 
-  bool isValidStateUpdate(const StateDelta& /*delta*/) const override {
-    return true;
+  bool isValidStateUpdate(const StateDelta& delta) const override;
+
+  static const char* getTableName(Table table);
+
+  /*
+   * The entries in use in a table, with a HwModel.
+   */
+  int64_t getTableUsage(Table table) const {
+    return usage_[table].load(std::memory_order_relaxed);
+  }
+
+  /*
+   * The programming time simulated so far, with a HwModel.
+   */
+  std::chrono::microseconds getProgrammingTime() const {
+    return std::chrono::microseconds(
+        programmingUs_.load(std::memory_order_relaxed));
   }
 
  private:
@@ -81,9 +168,48 @@ class SimSwitch : public HwSwitch {
   SimSwitch(SimSwitch const &) = delete;
   SimSwitch& operator=(SimSwitch const &) = delete;
 
+  struct PortCounters {
+    std::string statPrefix;
+    std::vector<stats::MonotonicCounter> counters;
+    // The totals counted so far, for each of counters
+    std::vector<int64_t> values;
+  };
+
+  template <typename RouteT>
+  void processRouteDelta(
+      RouterID id,
+      const std::shared_ptr<RouteT>& oldRoute,
+      const std::shared_ptr<RouteT>& newRoute,
+      std::shared_ptr<SwitchState>* appliedState);
+  template <typename DELTA, typename ParentClassT>
+  void processNeighborDelta(
+      const DELTA& delta,
+      std::shared_ptr<SwitchState>* appliedState);
+  bool hasRoom(Table table) const;
+  void changeUsage(Table table, int64_t change);
+  // Record programming an entry of the table
+  void program(Table table);
+
   HwSwitch::Callback* callback_{nullptr};
   uint32_t numPorts_{0};
   uint64_t txCount_{0};
+
+  const folly::Optional<HwModel> model_;
+  std::array<std::atomic<int64_t>, NUM_TABLES> usage_{};
+  std::atomic<int64_t> programmingUs_{0};
+
+  // Only used from the update thread
+  std::map<RouteNextHopEntry::NextHopSet, int64_t> ecmpGroups_;
+  std::mt19937 rng_;
+  // The programming time of the update being applied
+  std::chrono::microseconds pendingLatency_{0};
+
+  // The ports the synthetic counters are counted on
+  folly::Synchronized<std::shared_ptr<PortMap>> ports_;
+
+  // Only used from the stats thread
+  std::map<PortID, PortCounters> portCounters_;
+  std::chrono::steady_clock::time_point lastStatsUpdate_;
 };
 
 }} // facebook::fboss
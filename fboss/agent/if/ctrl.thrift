@@ -55,6 +55,10 @@ struct UnicastRoute {
   2: list<Address.BinaryAddress> nextHopAddrs,
   3: optional AdminDistance adminDistance,
   4: list<NextHopThrift> nextHops,
+  // Count the route's traffic under this class, with the hardware counter
+  // shared by all the routes of the class.  Only with
+  // --route_class_counters.
+  5: optional i32 classID,
 }
 
 struct ClientAndNextHops {
@@ -74,6 +78,32 @@ struct RouteDetails {
   4: required list<ClientAndNextHops> nextHopMulti,
   5: required bool isConnected,
   6: optional AdminDistance adminDistance,
+  7: optional i32 classID,
+}
+
+/*
+ * Which routes a route table query returns.  Unset fields match everything.
+ */
+struct RouteFilter {
+  1: optional i32 vrfId,
+  // Only routes with next hops from this client
+  2: optional i16 clientId,
+  // Only routes within this prefix, e.g. every route in 10.0.0.0/8
+  3: optional IpPrefix within,
+}
+
+struct RouteTablePage {
+  1: list<RouteDetails> routes,
+  // Pass to getRouteTablePage() for the next page, empty after the last one
+  2: string nextCursor,
+}
+
+struct RouteTableSummary {
+  1: i32 vrfId,
+  2: i64 numV4Routes,
+  3: i64 numV6Routes,
+  // Routes each client has next hops for
+  4: map<i16, i64> numRoutesByClient,
 }
 
 struct ArpEntryThrift {
@@ -92,6 +122,19 @@ struct L2EntryThrift {
   3: i32 vlanID,
 }
 
+struct L2TableQuery {
+  1: optional i32 vlanID,
+  2: optional i32 port,
+  // Only entries with MACs starting with this, e.g. "02:00:0"
+  3: optional string macPrefix,
+}
+
+struct L2TablePage {
+  1: list<L2EntryThrift> entries,
+  // Pass to getL2TablePage() for the next page, empty after the last one
+  2: string nextCursor,
+}
+
 enum LacpPortRateThrift {
   SLOW = 0,
   FAST = 1,
@@ -245,6 +288,7 @@ struct PortQueueThrift {
   5: optional i32 reservedBytes,
   6: optional string scalingFactor,
   7: optional ActiveQueueManagement aqm,
+  8: optional i32 sharedBytes,
 }
 
 struct PortInfoThrift {
@@ -313,8 +357,25 @@ struct RxCaptureFilter {
   # can put additional Rx filters here if need be
 }
 
+/*
+ * One instruction of a classic BPF program, as printed by tcpdump -dd
+ */
+struct BpfInstruction {
+  1: i32 code
+  2: i16 jt
+  3: i16 jf
+  4: i64 k
+}
+
 struct CaptureFilter {
   1: RxCaptureFilter rxCaptureFilter;
+  /*
+   * A classic BPF program packets must be accepted by to be captured, for
+   * instance as compiled by tcpdump -dd 'expression'.  It sees packets from
+   * their ethernet header, including any 802.1q tag, and applies to both
+   * directions.  Empty to capture every packet.
+   */
+  2: list<BpfInstruction> bpfProgram;
 }
 
 struct CaptureInfo {
@@ -334,6 +395,67 @@ struct CaptureInfo {
    * set of criteria that packet must meet to be captured
    */
   4: CaptureFilter  filter
+  /*
+   * Write the capture in pcapng format, with an interface for each port and
+   * the direction of each packet, rather than pcap.
+   */
+  5: bool pcapng = false
+  /*
+   * Rotate a long capture through a ring of maxFiles files, moving on to the
+   * next once the current one holds rotateBytes or is rotateSeconds old,
+   * and overwriting the oldest.  The capture doesn't rotate if both are 0.
+   */
+  6: i64 rotateBytes = 0
+  7: i32 rotateSeconds = 0
+  8: i32 maxFiles = 8
+}
+
+struct PacketTraceSamplingConfig {
+  // The addresses to trace packets to, one in each prefix of interest
+  1: list<string> destinations
+  // The port the packets are traced as if received on
+  2: i32 ingressPort
+  // How often to trace each destination
+  3: i32 intervalMs = 1000
+  /*
+   * How many flows, differing in UDP source port, to trace to each
+   * destination, to see how they are spread over ECMP members
+   */
+  4: i32 flowsPerDestination = 1
+  // How many of the latest samples to keep
+  5: i32 maxSamples = 1024
+}
+
+/*
+ * The lookups the hardware pipeline made for a traced packet.  The packets
+ * are only traced, never forwarded.
+ */
+struct PacketTraceSample {
+  1: i64 timestampMs
+  2: string destination
+  3: i32 ingressPort
+  4: i32 l4SrcPort
+  // The hardware specific results of each lookup, such as an LPM hit
+  5: list<i32> lookupResult
+  6: i32 resolution = -1
+  // The ports of the ECMP group the packet hashed over, and the one chosen
+  7: list<i32> ecmpMemberPorts
+  8: i32 egressPort = -1
+  9: i32 destPipeNum = -1
+}
+
+/*
+ * The calls of one SDK function made while SDK call profiling was on
+ */
+struct SdkCallProfile {
+  1: string function
+  2: i64 calls
+  3: i64 totalCycles
+  4: i64 maxCycles
+  // Bucket i counts the calls that took [2^i, 2^(i+1)) cycles
+  5: list<i64> cycleHistogram
+  // The rate of the cycle counter, measured over the profiling window
+  6: double cyclesPerUsec
 }
 
 struct RouteUpdateLoggingInfo {
@@ -369,6 +491,178 @@ struct LinkNeighborThrift {
   14: optional string portDescription
 }
 
+struct LldpNeighborUpdates {
+  // The sequence number of the latest change, to ask for the updates after
+  // it next
+  1: i64 sequence
+  // The neighbors added or changed, each as of its latest change
+  2: list<LinkNeighborThrift> changed
+  // The neighbors removed.  A neighbor that was removed and then came back
+  // is in both, so these are to be applied first.
+  3: list<LinkNeighborThrift> removed
+  // Set when the changes asked for aren't all known any more.  changed then
+  // holds every neighbor, and those not in it are to be forgotten.
+  4: bool resync
+}
+
+/*
+ * How long a phase of agent startup took, with times in microseconds since
+ * the agent started
+ */
+struct StartupPhaseThrift {
+  1: string name
+  2: i64 startUs
+  3: i64 durationUs
+  4: i64 threadId
+}
+
+/*
+ * A hot path event of the event trace, in microseconds since the epoch.
+ * What the arguments are depends on the event.
+ */
+struct EventTraceEntry {
+  1: i64 timestampUs
+  2: i64 threadId
+  3: string threadName
+  4: string event
+  5: i64 arg0
+  6: i64 arg1
+}
+
+/*
+ * When a step of the last warm boot happened, in microseconds since the
+ * epoch.  The graceful exit steps are those of the agent before this one.
+ */
+struct WarmBootEventThrift {
+  1: string name
+  2: i64 timestampUs
+}
+
+/*
+ * Estimates of the memory held by the agent.  The SwitchState memory is by
+ * node type and by VRF, with sharedBytes the part that the older generations
+ * of the state still alive also hold, and stateRetainedBytes what only they
+ * hold.  The subsystems are those outside the state, such as the hardware
+ * tables and the neighbor caches.
+ */
+struct StateMemoryUsageThrift {
+  1: i64 nodes
+  2: i64 bytes
+  3: i64 sharedBytes
+}
+
+struct MemoryUsageThrift {
+  1: map<string, StateMemoryUsageThrift> stateByNodeType
+  2: map<i32, StateMemoryUsageThrift> stateByVrf
+  3: StateMemoryUsageThrift state
+  4: i64 stateRetainedBytes
+  5: i32 stateOlderGenerations
+  6: map<string, i64> subsystems
+}
+
+/*
+ * The packets trapped to the CPU from one ingress port, CPU CoS queue and
+ * protocol, with the rates over the last stats interval
+ */
+struct PuntTalkerThrift {
+  1: i32 port
+  2: i32 cosQueue
+  3: string protocol
+  4: i64 packets
+  5: i64 bytes
+  6: double packetsPerSec
+  7: double bytesPerSec
+}
+
+/*
+ * The neighbors that became reachable or unreachable, coalesced over one or
+ * more change intervals.  Each address is listed once, in its latest state
+ * as of sequence.
+ *
+ * If resync is set, changes were dropped because the listener fell too far
+ * behind, and it should refetch the ARP and NDP tables.
+ */
+struct NeighborChangesThrift {
+  1: i64 sequence
+  2: list<Address.BinaryAddress> added
+  3: list<Address.BinaryAddress> removed
+  4: bool resync = false
+}
+
+/*
+ * A route that was added, changed or removed.  route is unset if the route
+ * was removed.
+ */
+struct RouteChangeThrift {
+  1: i32 vrfId
+  2: IpPrefix prefix
+  3: optional RouteDetails route
+}
+
+/*
+ * The routes that changed up to generation of the switch state, coalesced
+ * over one or more state updates.  Each route is listed once, in its latest
+ * state as of generation.
+ *
+ * If snapshot is set, changes instead holds every route as of generation,
+ * and replaces whatever the listener had.  The first batch a listener gets
+ * is a snapshot, as is the first one after it fell too far behind.
+ */
+struct RouteChangesThrift {
+  1: i64 generation
+  2: list<RouteChangeThrift> changes
+  3: bool snapshot = false
+}
+
+/*
+ * What applying the config file would do, without applying it
+ */
+struct ConfigDryRunThrift {
+  // Whether the hardware accepts the change, tables included
+  1: bool valid
+  // The nodes added, removed or changed in each section of the state, as a
+  // measure of the work to program them
+  2: map<string, i32> changes
+  // The state updates the change would be applied in
+  3: i32 stages
+}
+
+/*
+ * How a LoadBalancer's hash would spread a set of packets over the members
+ * of a group
+ */
+struct HashDistribution {
+  // The packets, or bytes, hashed to each member
+  1: list<i64> memberLoads
+  2: i64 numFlows
+  // Packets that weren't IP, so weren't hashed
+  3: i64 numUnhashed
+  // The busiest member's load over the mean, 1 for an even spread
+  4: double maxImbalance
+}
+
+enum LoadBalancedGroupType {
+  ECMP = 1,
+  LAG = 2,
+}
+
+/*
+ * How evenly the egress traffic of an ECMP group or aggregate port spread
+ * over its members in the last interval
+ */
+struct GroupImbalanceThrift {
+  1: LoadBalancedGroupType type
+  // The aggregate port's name, or the members of an ECMP group
+  2: string name
+  3: list<string> members
+  // The egress bytes of each member in the interval, from its port counters
+  4: list<i64> memberBytes
+  // The busiest member's bytes over the mean, 1 for an even spread
+  5: double imbalance
+  // The routes using an ECMP group
+  6: i32 numRoutes
+}
+
 enum StdClientIds {
   BGPD = 0,
   STATIC_ROUTE = 1,
@@ -408,6 +702,37 @@ service FbossCtrl extends fb303.FacebookService {
   void syncFib(1: i16 clientId, 2: list<UnicastRoute> routes)
     throws (1: fboss.FbossBaseError error)
 
+  /*
+   * The same as addUnicastRoutes(), deleteUnicastRoutes() and syncFib(), for
+   * the routes of one VRF.  The calls without a VRF update VRF 0.  Syncing
+   * any VRF lets route updates in, as syncFib() does.
+   */
+  void addUnicastRoutesInVrf(
+      1: i16 clientId, 2: i32 vrfId, 3: list<UnicastRoute> r)
+    throws (1: fboss.FbossBaseError error)
+  void deleteUnicastRoutesInVrf(
+      1: i16 clientId, 2: i32 vrfId, 3: list<IpPrefix> r)
+    throws (1: fboss.FbossBaseError error)
+  void syncFibInVrf(1: i16 clientId, 2: i32 vrfId, 3: list<UnicastRoute> r)
+    throws (1: fboss.FbossBaseError error)
+
+  /*
+   * Add a large batch of routes in chunks.  beginRouteTransaction() returns
+   * a transaction id.  addUnicastRoutesInTransaction() stages a chunk of
+   * routes without changing the switch state.  commitRouteTransaction() makes
+   * all of the staged routes visible in a single state update, and
+   * abortRouteTransaction() discards them.
+   */
+  i64 beginRouteTransaction(1: i16 clientId)
+    throws (1: fboss.FbossBaseError error)
+  void addUnicastRoutesInTransaction(
+      1: i64 transactionId, 2: list<UnicastRoute> routes)
+    throws (1: fboss.FbossBaseError error)
+  void commitRouteTransaction(1: i64 transactionId)
+    throws (1: fboss.FbossBaseError error)
+  void abortRouteTransaction(1: i64 transactionId)
+    throws (1: fboss.FbossBaseError error)
+
   /*
    * Begins a packet stream from the switch to a distribution service
    */
@@ -500,6 +825,26 @@ service FbossCtrl extends fb303.FacebookService {
     throws (1: fboss.FbossBaseError error)
   void registerForNeighborChanged()
     throws (1: fboss.FbossBaseError error) (thread='eb')
+  /*
+   * Register for coalesced batches of neighbor changes, sent through
+   * neighborChangesBatched() on the duplex channel.
+   *
+   * To resync, fetch the sequence, then the ARP and NDP tables, and ignore
+   * any batch with a sequence no later than the one fetched.
+   */
+  void registerForNeighborChangeStream()
+    throws (1: fboss.FbossBaseError error) (thread='eb')
+  i64 getNeighborChangeSequence()
+    throws (1: fboss.FbossBaseError error)
+  /*
+   * Register for the changes to the route tables the hardware is programmed
+   * with, sent through routeChangesBatched() on the duplex channel: first a
+   * snapshot of every route, then batches of changes in generation order.
+   */
+  void registerForRouteChangeStream()
+    throws (1: fboss.FbossBaseError error) (thread='eb')
+  i64 getRouteChangeGeneration()
+    throws (1: fboss.FbossBaseError error)
   list<string> getInterfaceList()
     throws (1: fboss.FbossBaseError error)
   /*
@@ -510,8 +855,24 @@ service FbossCtrl extends fb303.FacebookService {
     throws (1: fboss.FbossBaseError error)
   list<UnicastRoute> getRouteTableByClient(1: i16 clientId)
     throws (1: fboss.FbossBaseError error)
+  list<UnicastRoute> getRouteTableByClientInVrf(1: i16 clientId, 2: i32 vrfId)
+    throws (1: fboss.FbossBaseError error)
   list<RouteDetails> getRouteTableDetails()
     throws (1: fboss.FbossBaseError error)
+  /*
+   * The routes matching filter, at most maxRoutes of them at a time.  Routes
+   * are returned by VRF, v4 before v6, in the order of the RIB.  Start with
+   * an empty cursor and pass the nextCursor of each page to get the next.
+   * Routes added or removed between pages may be missed, but no route is
+   * returned twice.
+   */
+  RouteTablePage getRouteTablePage(
+      1: RouteFilter filter, 2: string cursor, 3: i32 maxRoutes)
+    throws (1: fboss.FbossBaseError error)
+  i64 getRouteCount(1: RouteFilter filter)
+    throws (1: fboss.FbossBaseError error)
+  list<RouteTableSummary> getRouteTableSummary()
+    throws (1: fboss.FbossBaseError error)
   InterfaceDetail getInterfaceDetail(1: i32 interfaceId)
     throws (1: fboss.FbossBaseError error)
 
@@ -556,6 +917,9 @@ service FbossCtrl extends fb303.FacebookService {
     throws (1: fboss.FbossBaseError error)
   list<L2EntryThrift> getL2Table()
     throws (1: fboss.FbossBaseError error)
+  L2TablePage getL2TablePage(
+      1: L2TableQuery query, 2: string cursor, 3: i32 maxEntries)
+    throws (1: fboss.FbossBaseError error)
 
   AggregatePortThrift getAggregatePort(1: i32 aggregatePortID)
     throws (1: fboss.FbossBaseError error)
@@ -578,6 +942,25 @@ service FbossCtrl extends fb303.FacebookService {
   list<LinkNeighborThrift> getLldpNeighbors()
     throws (1: fboss.FbossBaseError error)
 
+  /*
+   * Return the LLDP neighbors that were added, changed or removed after
+   * sinceSequence, waiting up to maxWaitMs for one to if none did yet.
+   * Asking again with the sequence returned gets the next changes, so a
+   * client can follow the neighbors without fetching all of them over and
+   * over.  A sinceSequence of 0, or one ahead of the agent (e.g. from before
+   * it restarted), gets them all.
+   */
+  LldpNeighborUpdates getLldpNeighborUpdates(
+      1: i64 sinceSequence, 2: i32 maxWaitMs)
+    throws (1: fboss.FbossBaseError error)
+
+  /*
+   * Get the sources of trapped packets with the highest packet rates, up to
+   * count of them
+   */
+  list<PuntTalkerThrift> getPuntTopTalkers(1: i32 count)
+    throws (1: fboss.FbossBaseError error)
+
   /*
    * Start a packet capture
    */
@@ -588,6 +971,27 @@ service FbossCtrl extends fb303.FacebookService {
   void stopAllPktCaptures()
     throws (1: fboss.FbossBaseError error)
 
+  /*
+   * Periodically trace synthetic packets through the hardware pipeline, and
+   * keep the latest lookup results.  Starting again replaces the config and
+   * clears the samples.
+   */
+  void startPacketTraceSampling(1: PacketTraceSamplingConfig config)
+    throws (1: fboss.FbossBaseError error)
+  void stopPacketTraceSampling()
+    throws (1: fboss.FbossBaseError error)
+  list<PacketTraceSample> getPacketTraceSamples()
+    throws (1: fboss.FbossBaseError error)
+
+  /*
+   * Count and time the SDK calls the agent makes, in agents linked with the
+   * SDK call tracing shim.  Enabling profiling clears the previous profile.
+   */
+  void setSdkCallProfiling(1: bool enable)
+    throws (1: fboss.FbossBaseError error)
+  list<SdkCallProfile> getSdkCallProfile()
+    throws (1: fboss.FbossBaseError error)
+
   /*
    * Subscribe to a set of high-resolution counters
    */
@@ -603,6 +1007,32 @@ service FbossCtrl extends fb303.FacebookService {
   void stopLoggingAnyRouteUpdates(1: string identifier)
   list<RouteUpdateLoggingInfo> getRouteUpdateLoggingTrackedPrefixes()
 
+  /*
+   * Get the timing of each phase of startup recorded so far, either as a
+   * list or as a Chrome trace JSON document for chrome://tracing
+   */
+  list<StartupPhaseThrift> getStartupPhases()
+  string getStartupTrace()
+
+  /*
+   * Get the latest hot path events of each thread, oldest first, or turn
+   * recording them on or off
+   */
+  list<EventTraceEntry> getEventTrace()
+  void setEventTracing(1: bool enable)
+
+  /*
+   * Get the steps of the warm boot into this agent that happened so far,
+   * from the graceful exit of the previous agent to the FIB sync
+   */
+  list<WarmBootEventThrift> getWarmBootTimeline()
+
+  /*
+   * Account for the memory of the SwitchState and the subsystems that track
+   * theirs.  The state is walked in full, so this is slow with a large FIB.
+   */
+  MemoryUsageThrift getMemoryUsage()
+
   void keepalive()
 
   i32 getIdleTimeout()
@@ -620,11 +1050,45 @@ service FbossCtrl extends fb303.FacebookService {
    */
   void reloadConfig()
 
+  /*
+   * Build and validate the state the config file would make, without
+   * applying it.
+   */
+  ConfigDryRunThrift dryRunConfig()
+    throws (1: fboss.FbossBaseError error)
+
+  /*
+   * Replay packets, such as the packetData of sFlow samples, through a
+   * software model of the hash of the LoadBalancer with this ID in the
+   * current state, for a group of numMembers.  Each packet counts as a load
+   * of one.
+   */
+  HashDistribution simulateLoadBalancer(
+      1: i32 loadBalancerID, 2: i32 numMembers, 3: list<binary> packets)
+    throws (1: fboss.FbossBaseError error)
+
+  /*
+   * The count ECMP groups and aggregate ports whose traffic spread least
+   * evenly over their members in the last interval, most imbalanced first
+   */
+  list<GroupImbalanceThrift> getTopImbalancedGroups(1: i32 count)
+    throws (1: fboss.FbossBaseError error)
+
   /*
    * Serialize switch state at path pointed by JSON pointer
    */
   string getCurrentStateJSON(1: string jsonPointer)
 
+  /*
+   * Serialize switch state at path pointed by JSON pointer, a page at a time.
+   * If the path points to a map of nodes (e.g. "/ports", or
+   * "/routeTables/entries/0/ribV4"), only the limit entries starting at
+   * offset are returned.  Other parts of the state are not serialized.
+   */
+  string getCurrentStateJSONPage(
+      1: string jsonPointer, 2: i64 offset, 3: i32 limit)
+    throws (1: fboss.FbossBaseError error)
+
   /*
    * Apply patch at given path within the state tree. jsonPatch must  be
    * a valid JSON object string
@@ -642,4 +1106,19 @@ service NeighborListenerClient extends fb303.FacebookService {
    */
   void neighborsChanged(1: list<string> added, 2: list<string> removed)
     throws (1: fboss.FbossBaseError error)
+
+  /*
+   * Sends a batch of neighbor changes to a change stream subscriber.  No
+   * more than a few batches are outstanding at once, and the changes in
+   * between are merged into the next batch.
+   */
+  void neighborChangesBatched(1: NeighborChangesThrift changes)
+    throws (1: fboss.FbossBaseError error)
+
+  /*
+   * Sends a batch of route changes to a route change stream subscriber,
+   * with the same flow control as neighborChangesBatched().
+   */
+  void routeChangesBatched(1: RouteChangesThrift changes)
+    throws (1: fboss.FbossBaseError error)
 }
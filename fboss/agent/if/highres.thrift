@@ -39,6 +39,14 @@ struct CounterSubscribeRequest {
   7 : bool veryNice,
 
   8 : set<CounterRequest> counterSet
+
+  // Publish with publishCompactCounters() rather than publishCounters()
+  9 : bool compact = false,
+  // How large batchSize may grow while publications are backing up, for
+  // fewer and larger publications.  0 always publishes batchSize samples
+  10 : i32 maxBatchSize = 0,
+  // The CPU to run the sampling thread on, or -1 for any
+  11 : i32 samplerCpu = -1,
 }
 
 struct HighresTime {
@@ -58,6 +66,29 @@ struct CounterPublication {
   4: map<CounterRequest,list<i64>> counterValues,
 }
 
+/*
+ * The samples of a batch, a column per counter.  A column is the values of
+ * the counter in sample order, as the first value and then the difference
+ * of each value from the one before, zigzag encoded and written as base 128
+ * varints, low bits first.  Counters mostly change by small amounts, if at
+ * all, between samples, so most values take a byte.
+ */
+struct CompactCounterPublication {
+  // Full hostname of the publishing server
+  1: string hostname,
+  // Counts the publications of a subscription, from 0
+  2: i64 sequence,
+  // The counters the columns are for, in column order.  Only sent with the
+  // first publication of a subscription, as they never change
+  3: list<CounterRequest> counters,
+  4: i32 numSamples,
+  // The sample times in nanoseconds since the epoch, encoded like a column
+  5: binary times,
+  6: list<binary> columns,
+}
+
 service FbossHighresClient {
   oneway void publishCounters(1: CounterPublication pub) (thread='eb')
+  oneway void publishCompactCounters(1: CompactCounterPublication pub)
+    (thread='eb')
 }
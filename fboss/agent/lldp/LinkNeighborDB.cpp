@@ -53,23 +53,59 @@ bool LinkNeighborDB::NeighborKey::operator==(const NeighborKey& other) const {
 LinkNeighborDB::LinkNeighborDB() {
 }
 
+namespace {
+// The removals kept for clients that didn't catch up yet
+constexpr size_t kMaxRemovedKept = 4096;
+
+// Whether an update tells anything new about the neighbor, other than when
+// it expires
+bool sameNeighbor(const LinkNeighbor& a, const LinkNeighbor& b) {
+  return a.getLocalVlan() == b.getLocalVlan() && a.getMac() == b.getMac() &&
+      a.getCapabilities() == b.getCapabilities() &&
+      a.getEnabledCapabilities() == b.getEnabledCapabilities() &&
+      a.getSystemName() == b.getSystemName() &&
+      a.getPortDescription() == b.getPortDescription() &&
+      a.getSystemDescription() == b.getSystemDescription() &&
+      a.getTTL() == b.getTTL();
+}
+} // namespace
+
 void LinkNeighborDB::update(const LinkNeighbor& neighbor) {
-  lock_guard<mutex> guard(mutex_);
+  folly::SharedPromise<folly::Unit> changed;
+  {
+    lock_guard<mutex> guard(mutex_);
+    auto sequence = sequence_;
 
-  // Go ahead and prune expired neighbors each time we get updated.
-  pruneLocked(steady_clock::now());
+    // Go ahead and prune expired neighbors each time we get updated.
+    pruneLocked(steady_clock::now());
 
-  auto it = byLocalPort_.find(neighbor.getLocalPort());
-  if (it == byLocalPort_.end()) {
-    // This is the first time we have seen data for this port.
-    auto ret = byLocalPort_.emplace(neighbor.getLocalPort(),
-                                    NeighborMap());
-    it = ret.first;
-  }
+    auto& map = byLocalPort_[neighbor.getLocalPort()];
+    NeighborKey key(neighbor);
+    auto it = map.find(key);
+    if (it == map.end()) {
+      NeighborID id(neighbor.getLocalPort(), key);
+      Entry entry;
+      entry.neighbor = neighbor;
+      entry.sequence = ++sequence_;
+      entry.expiration =
+          byExpiration_.emplace(neighbor.getExpirationTime(), id);
+      entry.chassis = byChassisId_.emplace(neighbor.getChassisId(), id);
+      map.emplace(key, std::move(entry));
+    } else {
+      auto& entry = it->second;
+      if (!sameNeighbor(entry.neighbor, neighbor)) {
+        entry.sequence = ++sequence_;
+      }
+      auto id = entry.expiration->second;
+      byExpiration_.erase(entry.expiration);
+      entry.expiration =
+          byExpiration_.emplace(neighbor.getExpirationTime(), id);
+      entry.neighbor = neighbor;
+    }
 
-  NeighborKey key(neighbor);
-  // It would be nicer to use insert_or_assign() once we move to C++17
-  it->second[key] = neighbor;
+    changed = takeChangedLocked(sequence);
+  }
+  changed.setValue();
 }
 
 vector<LinkNeighbor> LinkNeighborDB::getNeighbors() {
@@ -78,7 +114,7 @@ vector<LinkNeighbor> LinkNeighborDB::getNeighbors() {
 
   for (const auto& portEntry : byLocalPort_) {
     for (const auto& entry : portEntry.second) {
-      results.push_back(entry.second);
+      results.push_back(entry.second.neighbor);
     }
   }
 
@@ -92,50 +128,141 @@ vector<LinkNeighbor> LinkNeighborDB::getNeighbors(PortID port) {
   auto it = byLocalPort_.find(port);
   if (it != byLocalPort_.end()) {
     for (const auto& entry : it->second) {
-      results.push_back(entry.second);
+      results.push_back(entry.second.neighbor);
     }
   }
 
   return results;
 }
 
-void LinkNeighborDB::pruneExpiredNeighbors() {
+vector<LinkNeighbor> LinkNeighborDB::getNeighborsByChassisId(
+    const std::string& chassisId) {
+  vector<LinkNeighbor> results;
   lock_guard<mutex> guard(mutex_);
-  pruneLocked(steady_clock::now());
+
+  auto range = byChassisId_.equal_range(chassisId);
+  for (auto it = range.first; it != range.second; ++it) {
+    const auto& id = it->second;
+    results.push_back(byLocalPort_.at(id.first).at(id.second).neighbor);
+  }
+
+  return results;
+}
+
+folly::Future<LinkNeighborDB::Updates> LinkNeighborDB::getUpdates(
+    int64_t sinceSequence, std::chrono::milliseconds maxWait) {
+  folly::Future<folly::Unit> changed = folly::makeFuture();
+  {
+    lock_guard<mutex> guard(mutex_);
+    if (sinceSequence > sequence_) {
+      // The client saw a sequence from before we restarted
+      sinceSequence = 0;
+    }
+    if (sequence_ > sinceSequence) {
+      return collectLocked(sinceSequence);
+    }
+    changed = changed_.getFuture();
+  }
+
+  return changed.within(maxWait)
+      .onError([](const folly::TimedOut&) {})
+      .then([this, sinceSequence]() {
+        lock_guard<mutex> guard(mutex_);
+        return collectLocked(sinceSequence);
+      });
+}
+
+void LinkNeighborDB::pruneExpiredNeighbors() {
+  pruneExpiredNeighbors(steady_clock::now());
 }
 
 void LinkNeighborDB::pruneExpiredNeighbors(steady_clock::time_point now) {
-  lock_guard<mutex> guard(mutex_);
-  pruneLocked(now);
+  folly::SharedPromise<folly::Unit> changed;
+  {
+    lock_guard<mutex> guard(mutex_);
+    auto sequence = sequence_;
+    pruneLocked(now);
+    changed = takeChangedLocked(sequence);
+  }
+  changed.setValue();
 }
 
 void LinkNeighborDB::portDown(PortID port) {
-  lock_guard<mutex> guard(mutex_);
-  // Port went down, prune lldp entries for that port
-  byLocalPort_.erase(port);
+  folly::SharedPromise<folly::Unit> changed;
+  {
+    lock_guard<mutex> guard(mutex_);
+    auto sequence = sequence_;
+    // Port went down, prune lldp entries for that port
+    auto portIt = byLocalPort_.find(port);
+    if (portIt != byLocalPort_.end()) {
+      auto& map = portIt->second;
+      while (!map.empty()) {
+        removeLocked(&map, map.begin());
+      }
+      byLocalPort_.erase(portIt);
+    }
+    changed = takeChangedLocked(sequence);
+  }
+  changed.setValue();
 }
 
 void LinkNeighborDB::pruneLocked(steady_clock::time_point now) {
-  // We just do a linear scan for now.
-  //
-  // We could maintain a priority queue of entries by expiration time,
-  // to make this scanning faster.  However, we don't expect the number of
-  // neighbors to be very large, so the extra complexity isn't worth
-  // implementing right now.
-
-  for (auto& portEntry : byLocalPort_) {
-    // Advance the iterator manually to avoid make sure we don't
-    // have invalid iterators to erased elements.
-    auto& map = portEntry.second;
-    auto it = map.begin();
-    while (it != map.end()) {
-      auto current = it;
-      ++it;
-      if (current->second.isExpired(now)) {
-        map.erase(current);
+  // The neighbors that expire first are at the front of byExpiration_, so
+  // this only looks at those that expired.
+  while (!byExpiration_.empty() && byExpiration_.begin()->first < now) {
+    auto id = byExpiration_.begin()->second;
+    auto& map = byLocalPort_.at(id.first);
+    removeLocked(&map, map.find(id.second));
+  }
+}
+
+void LinkNeighborDB::removeLocked(NeighborMap* map, NeighborMap::iterator it) {
+  auto& entry = it->second;
+  byExpiration_.erase(entry.expiration);
+  byChassisId_.erase(entry.chassis);
+
+  removed_.emplace(++sequence_, std::move(entry.neighbor));
+  if (removed_.size() > kMaxRemovedKept) {
+    forgottenSequence_ = removed_.begin()->first;
+    removed_.erase(removed_.begin());
+  }
+
+  map->erase(it);
+}
+
+LinkNeighborDB::Updates LinkNeighborDB::collectLocked(
+    int64_t sinceSequence) const {
+  Updates updates;
+  updates.sequence = sequence_;
+  updates.resync = sinceSequence == 0 || sinceSequence < forgottenSequence_;
+  if (updates.resync) {
+    sinceSequence = 0;
+  } else {
+    for (auto it = removed_.upper_bound(sinceSequence); it != removed_.end();
+         ++it) {
+      updates.removed.push_back(it->second);
+    }
+  }
+
+  for (const auto& portEntry : byLocalPort_) {
+    for (const auto& entry : portEntry.second) {
+      if (entry.second.sequence > sinceSequence) {
+        updates.changed.push_back(entry.second.neighbor);
       }
     }
   }
+
+  return updates;
+}
+
+folly::SharedPromise<folly::Unit> LinkNeighborDB::takeChangedLocked(
+    int64_t sequence) {
+  folly::SharedPromise<folly::Unit> changed;
+  if (sequence_ != sequence) {
+    changed = std::move(changed_);
+    changed_ = folly::SharedPromise<folly::Unit>();
+  }
+  return changed;
 }
 
 }} // facebook::fboss
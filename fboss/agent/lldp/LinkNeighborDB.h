@@ -4,9 +4,14 @@
 #include "fboss/agent/types.h"
 #include "fboss/agent/lldp/LinkNeighbor.h"
 
+#include <folly/futures/Future.h>
+#include <folly/futures/SharedPromise.h>
+
 #include <chrono>
 #include <map>
 #include <mutex>
+#include <string>
+#include <utility>
 #include <vector>
 
 namespace facebook { namespace fboss {
@@ -16,10 +21,30 @@ class LinkNeighbor;
 /*
  * LinkNeighborDB maintains information about known neighbors.
  *
+ * The neighbors are indexed by local port, by chassis ID and by when they
+ * expire, so that pruning only looks at the neighbors that expired.  Every
+ * neighbor added, changed or removed gets the next sequence number, for
+ * clients to follow the changes with getUpdates() instead of fetching
+ * every neighbor over and over.
+ *
  * This class is thread-safe, and performs synchronization internally.
  */
 class LinkNeighborDB {
  public:
+  struct Updates {
+    // The sequence number of the latest change, to ask for the updates
+    // after it next
+    int64_t sequence{0};
+    // The neighbors added or changed, each as of its latest change
+    std::vector<LinkNeighbor> changed;
+    // The neighbors removed.  A neighbor that was removed and then came back
+    // is in both, so these are to be applied first.
+    std::vector<LinkNeighbor> removed;
+    // Set when the changes asked for aren't all known any more.  changed then
+    // holds every neighbor, and those not in it are to be forgotten.
+    bool resync{false};
+  };
+
   LinkNeighborDB();
 
   /*
@@ -41,6 +66,22 @@ class LinkNeighborDB {
    */
   std::vector<LinkNeighbor> getNeighbors(PortID port);
 
+  /*
+   * Get all known neighbors with a given chassis ID, on any port.
+   *
+   * This returns a new copy of the neighbor information.
+   */
+  std::vector<LinkNeighbor> getNeighborsByChassisId(
+      const std::string& chassisId);
+
+  /*
+   * The neighbors that changed after sinceSequence, as soon as there is one,
+   * or none once maxWait is over.  A sinceSequence of 0, or one ahead of the
+   * DB (e.g. from before the agent restarted), gets every neighbor.
+   */
+  folly::Future<Updates> getUpdates(
+      int64_t sinceSequence, std::chrono::milliseconds maxWait);
+
   /*
    * Remove expired neighbor entries from the database.
    */
@@ -61,16 +102,46 @@ class LinkNeighborDB {
     std::string chassisId_;
     std::string portId_;
   };
-  typedef std::map<NeighborKey, LinkNeighbor> NeighborMap;
+  using NeighborID = std::pair<PortID, NeighborKey>;
+  using ExpirationIndex =
+      std::multimap<std::chrono::steady_clock::time_point, NeighborID>;
+  using ChassisIndex = std::multimap<std::string, NeighborID>;
+
+  struct Entry {
+    LinkNeighbor neighbor;
+    // The sequence number of the last change to the neighbor
+    int64_t sequence{0};
+    ExpirationIndex::iterator expiration;
+    ChassisIndex::iterator chassis;
+  };
+  typedef std::map<NeighborKey, Entry> NeighborMap;
+  typedef std::map<PortID, NeighborMap> PortMap;
 
   // Forbidden copy constructor and assignment operator
   LinkNeighborDB(LinkNeighborDB const &) = delete;
   LinkNeighborDB& operator=(LinkNeighborDB const &) = delete;
 
+  // The following must be called with mutex_ held
   void pruneLocked(std::chrono::steady_clock::time_point now);
+  void removeLocked(NeighborMap* map, NeighborMap::iterator it);
+  Updates collectLocked(int64_t sinceSequence) const;
+  // Returns the promise of the waiters to fulfill, once mutex_ is released,
+  // if anything changed since sequence
+  folly::SharedPromise<folly::Unit> takeChangedLocked(int64_t sequence);
 
   std::mutex mutex_;
-  std::map<PortID, NeighborMap> byLocalPort_;
+  PortMap byLocalPort_;
+  ChassisIndex byChassisId_;
+  ExpirationIndex byExpiration_;
+
+  int64_t sequence_{0};
+  // The neighbors removed, by the sequence number of their removal
+  std::map<int64_t, LinkNeighbor> removed_;
+  // The sequence number of the last removal forgotten, past which clients
+  // have to resync
+  int64_t forgottenSequence_{0};
+  // Fulfilled, and replaced, on every change
+  folly::SharedPromise<folly::Unit> changed_;
 };
 
 }} // facebook::fboss
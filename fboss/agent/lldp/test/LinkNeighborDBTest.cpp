@@ -104,3 +104,85 @@ TEST(LinkNeighborDB, test) {
   ASSERT_EQ(1, neighbors.size());
   EXPECT_EQ("neighbor3 name", neighbors[0].getSystemName());
 }
+
+namespace {
+LinkNeighbor makeNeighbor(PortID port, const std::string& chassis) {
+  LinkNeighbor n;
+  n.setProtocol(LinkProtocol::LLDP);
+  n.setLocalPort(port);
+  n.setLocalVlan(VlanID(1));
+  n.setMac(MacAddress("00:11:22:33:44:55"));
+  n.setChassisId(chassis, LldpChassisIdType::LOCALLY_ASSIGNED);
+  n.setPortId("1/1", LldpPortIdType::LOCALLY_ASSIGNED);
+  n.setSystemName(chassis + " name");
+  n.setTTL(seconds(120));
+  return n;
+}
+} // unnamed namespace
+
+TEST(LinkNeighborDB, byChassisId) {
+  LinkNeighborDB db;
+  db.update(makeNeighbor(PortID(1), "neighbor1"));
+  db.update(makeNeighbor(PortID(2), "neighbor1"));
+  db.update(makeNeighbor(PortID(3), "neighbor2"));
+
+  EXPECT_EQ(2, db.getNeighborsByChassisId("neighbor1").size());
+  EXPECT_EQ(1, db.getNeighborsByChassisId("neighbor2").size());
+  EXPECT_EQ(0, db.getNeighborsByChassisId("neighbor3").size());
+
+  db.portDown(PortID(1));
+  auto neighbors = db.getNeighborsByChassisId("neighbor1");
+  ASSERT_EQ(1, neighbors.size());
+  EXPECT_EQ(PortID(2), neighbors[0].getLocalPort());
+}
+
+TEST(LinkNeighborDB, updates) {
+  LinkNeighborDB db;
+  std::chrono::milliseconds noWait(0);
+
+  // Nothing to get yet
+  auto updates = db.getUpdates(0, noWait).get();
+  EXPECT_EQ(0, updates.sequence);
+  EXPECT_EQ(0, updates.changed.size());
+
+  auto n1 = makeNeighbor(PortID(1), "neighbor1");
+  db.update(n1);
+  db.update(makeNeighbor(PortID(2), "neighbor2"));
+  updates = db.getUpdates(0, noWait).get();
+  EXPECT_TRUE(updates.resync);
+  EXPECT_EQ(2, updates.changed.size());
+  auto sequence = updates.sequence;
+
+  // Hearing from a neighbor again isn't a change, unless it says something
+  // new
+  db.update(n1);
+  updates = db.getUpdates(sequence, noWait).get();
+  EXPECT_EQ(sequence, updates.sequence);
+  EXPECT_EQ(0, updates.changed.size());
+
+  n1.setSystemName("neighbor1 renamed");
+  db.update(n1);
+  updates = db.getUpdates(sequence, noWait).get();
+  EXPECT_FALSE(updates.resync);
+  ASSERT_EQ(1, updates.changed.size());
+  EXPECT_EQ("neighbor1 renamed", updates.changed[0].getSystemName());
+  EXPECT_EQ(0, updates.removed.size());
+  sequence = updates.sequence;
+
+  // A client that is waiting hears of the removal right away
+  auto waiting = db.getUpdates(sequence, std::chrono::seconds(10));
+  EXPECT_FALSE(waiting.isReady());
+  db.portDown(PortID(2));
+  updates = std::move(waiting).get();
+  EXPECT_EQ(0, updates.changed.size());
+  ASSERT_EQ(1, updates.removed.size());
+  EXPECT_EQ("neighbor2", updates.removed[0].getChassisId());
+  sequence = updates.sequence;
+
+  // Expiry is a removal too
+  db.pruneExpiredNeighbors(steady_clock::now() + seconds(121));
+  updates = db.getUpdates(sequence, noWait).get();
+  ASSERT_EQ(1, updates.removed.size());
+  EXPECT_EQ("neighbor1", updates.removed[0].getChassisId());
+  EXPECT_EQ(0, db.getNeighbors().size());
+}
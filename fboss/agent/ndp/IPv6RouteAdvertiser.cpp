@@ -11,18 +11,26 @@
 
 #include <folly/IPAddressV6.h>
 #include <folly/MacAddress.h>
+#include <folly/Random.h>
+#include <folly/io/async/AsyncTimeout.h>
 #include <folly/logging/xlog.h>
 #include <netinet/icmp6.h>
 #include "fboss/agent/FbossError.h"
 #include "fboss/agent/SwSwitch.h"
 #include "fboss/agent/TxPacket.h"
+#include "fboss/agent/packet/EthHdr.h"
 #include "fboss/agent/packet/ICMPHdr.h"
 #include "fboss/agent/packet/IPv6Hdr.h"
 #include "fboss/agent/packet/PktUtil.h"
 #include "fboss/agent/state/Interface.h"
-#include "fboss/agent/state/SwitchState.h"
-#include "fboss/agent/state/Vlan.h"
-#include "fboss/agent/state/VlanMap.h"
+
+#include <algorithm>
+#include <chrono>
+#include <set>
+
+DEFINE_int32(ra_interval_jitter_pct, 10,
+             "Shorten each IPv6 router advertisement interval by a random "
+             "amount of up to this percent of it, at most 50");
 
 using folly::IPAddressV6;
 using folly::MacAddress;
@@ -32,6 +40,17 @@ using folly::io::RWPrivateCursor;
 
 namespace {
 
+const MacAddress kAllNodesMac("33:33:00:00:00:01");
+const IPAddressV6 kAllNodes("ff02::1");
+
+// Advertisements due this soon after the timer fires are sent along with it
+constexpr std::chrono::milliseconds kBatchWindow(20);
+
+// Where the fields addressing an advertisement to a solicitor are
+constexpr uint32_t kDstIPOffset = facebook::fboss::EthHdr::SIZE + 24;
+constexpr uint32_t kChecksumOffset =
+    facebook::fboss::EthHdr::SIZE + facebook::fboss::IPv6Hdr::SIZE + 2;
+
 uint32_t getAdvertisementPacketBodySize(uint32_t items_count)  {
   uint32_t bodyLength =
     4 + // hop limit, flags, lifetime
@@ -68,53 +87,82 @@ namespace facebook { namespace fboss {
 /*
  * IPv6RAImpl is the class that actually handles sending out the RA packets.
  *
- * This uses AsyncTimeout to receive timeout notifications in the SwSwitch's
- * background event thread, and send out RA packets every time the timer fires.
+ * This uses one AsyncTimeout to receive timeout notifications in the
+ * SwSwitch's background event thread, for whichever interface is due next,
+ * and sends out every advertisement that is due each time the timer fires.
+ * It is only used from the background thread.
  */
 class IPv6RAImpl : private folly::AsyncTimeout {
  public:
-  IPv6RAImpl(SwSwitch* sw,
-             const SwitchState* state,
-             const Interface* intf);
+  explicit IPv6RAImpl(SwSwitch* sw)
+      : AsyncTimeout(sw->getBackgroundEvb()), sw_(sw) {}
 
-  SwSwitch* getSw() const {
-    return sw_;
-  }
+  /*
+   * Start advertising on an interface, or replace its advertisement.  It is
+   * still next sent when it was due unless the interval changed.
+   */
+  void setInterface(InterfaceID id,
+                    std::shared_ptr<const IOBuf> buf,
+                    std::chrono::milliseconds interval);
+  void removeInterface(InterfaceID id);
 
-  static void start(IPv6RAImpl* ra);
   static void stop(IPv6RAImpl* ra);
 
  private:
+  typedef std::chrono::steady_clock Clock;
+  struct Advertisement {
+    std::shared_ptr<const IOBuf> buf;
+    std::chrono::milliseconds interval;
+    Clock::time_point nextSend;
+  };
+
   // Forbidden copy constructor and assignment operator
   IPv6RAImpl(IPv6RAImpl const &) = delete;
   IPv6RAImpl& operator=(IPv6RAImpl const &) = delete;
 
-  void timeoutExpired() noexcept override {
-    sendRouteAdvertisement();
-    scheduleTimeout(interval_);
-  }
+  void timeoutExpired() noexcept override;
 
-  void initPacket(const Interface* intf);
-  void sendRouteAdvertisement();
+  void schedule(InterfaceID id, Advertisement* adv, Clock::time_point now);
+  void scheduleTimeout();
+  void sendRouteAdvertisement(const IOBuf& buf);
 
-  std::chrono::milliseconds interval_;
-  folly::IOBuf buf_;
   SwSwitch* const sw_{nullptr};
+  std::map<InterfaceID, Advertisement> advertisements_;
+  // When each interface is next due, soonest first
+  std::set<std::pair<Clock::time_point, InterfaceID>> schedule_;
 };
 
-IPv6RAImpl::IPv6RAImpl(
-    SwSwitch* sw,
-    const SwitchState* /*state*/,
-    const Interface* intf)
-    : AsyncTimeout(sw->getBackgroundEvb()), sw_(sw) {
-  std::chrono::seconds raInterval(
-      intf->getNdpConfig().routerAdvertisementSeconds);
-  interval_ = raInterval;
-  initPacket(intf);
+void IPv6RAImpl::setInterface(InterfaceID id,
+                              std::shared_ptr<const IOBuf> buf,
+                              std::chrono::milliseconds interval) {
+  auto now = Clock::now();
+  auto it = advertisements_.find(id);
+  if (it == advertisements_.end()) {
+    it = advertisements_.emplace(
+        id, Advertisement{std::move(buf), interval, now}).first;
+  } else {
+    it->second.buf = std::move(buf);
+    if (it->second.interval == interval) {
+      return;
+    }
+    schedule_.erase(std::make_pair(it->second.nextSend, id));
+    it->second.interval = interval;
+  }
+  schedule(id, &it->second, now);
+  scheduleTimeout();
 }
 
-void IPv6RAImpl::start(IPv6RAImpl* ra) {
-  ra->scheduleTimeout(ra->interval_);
+void IPv6RAImpl::removeInterface(InterfaceID id) {
+  auto it = advertisements_.find(id);
+  if (it == advertisements_.end()) {
+    return;
+  }
+  // Let hosts know of the last prefixes we had before we stop, as when
+  // going down
+  sendRouteAdvertisement(*it->second.buf);
+  schedule_.erase(std::make_pair(it->second.nextSend, id));
+  advertisements_.erase(it);
+  scheduleTimeout();
 }
 
 void IPv6RAImpl::stop(IPv6RAImpl* ra) {
@@ -123,22 +171,55 @@ void IPv6RAImpl::stop(IPv6RAImpl* ra) {
    * advertisement to avoid RA's timing out while
    * controller is restarted
    */
-  ra->sendRouteAdvertisement();
+  {
+    SwSwitch::TxPacketBatch batch(ra->sw_);
+    for (const auto& entry : ra->advertisements_) {
+      ra->sendRouteAdvertisement(*entry.second.buf);
+    }
+  }
   delete ra;
 }
 
-void IPv6RAImpl::initPacket(const Interface* intf) {
-  auto totalLength = IPv6RouteAdvertiser::getPacketSize(intf);
-  buf_ = IOBuf(IOBuf::CREATE, totalLength);
-  buf_.append(totalLength);
-  RWPrivateCursor cursor(&buf_);
-  IPv6RouteAdvertiser::createAdvertisementPacket(
-    intf, &cursor, MacAddress("33:33:00:00:00:01"), IPAddressV6("ff02::1"));
+void IPv6RAImpl::timeoutExpired() noexcept {
+  auto now = Clock::now();
+  {
+    SwSwitch::TxPacketBatch batch(sw_);
+    while (!schedule_.empty() &&
+           schedule_.begin()->first <= now + kBatchWindow) {
+      auto id = schedule_.begin()->second;
+      schedule_.erase(schedule_.begin());
+      auto& adv = advertisements_.at(id);
+      sendRouteAdvertisement(*adv.buf);
+      schedule(id, &adv, now);
+    }
+  }
+  scheduleTimeout();
 }
 
-void IPv6RAImpl::sendRouteAdvertisement() {
+void IPv6RAImpl::schedule(InterfaceID id,
+                          Advertisement* adv,
+                          Clock::time_point now) {
+  auto jitterPct = std::min(std::max(FLAGS_ra_interval_jitter_pct, 0), 50);
+  uint64_t maxJitter = adv->interval.count() * jitterPct / 100;
+  std::chrono::milliseconds jitter(folly::Random::rand64(maxJitter + 1));
+  adv->nextSend = now + adv->interval - jitter;
+  schedule_.emplace(adv->nextSend, id);
+}
+
+void IPv6RAImpl::scheduleTimeout() {
+  if (schedule_.empty()) {
+    cancelTimeout();
+    return;
+  }
+  auto delay = std::chrono::duration_cast<std::chrono::milliseconds>(
+      schedule_.begin()->first - Clock::now());
+  AsyncTimeout::scheduleTimeout(
+      std::max(delay, std::chrono::milliseconds(0)));
+}
+
+void IPv6RAImpl::sendRouteAdvertisement(const IOBuf& buf) {
   XLOG(DBG5) << "sending route advertisement:\n"
-             << PktUtil::hexDump(Cursor(&buf_));
+             << PktUtil::hexDump(Cursor(&buf));
 
   // Allocate a new packet, and copy our data into it.
   //
@@ -146,53 +227,114 @@ void IPv6RAImpl::sendRouteAdvertisement() {
   // The TxPacket is required to use DMA memory for its buffer, so we can't do
   // a simple clone.
   //
-  // TODO: In the future it would be nice to support allocating buf_ in a DMA
+  // TODO: In the future it would be nice to support allocating buf in a DMA
   // buffer so that we really can just clone a reference to it here, rather
   // than doing a copy.
-  uint32_t pktLen = buf_.length();
+  uint32_t pktLen = buf.length();
   auto pkt = sw_->allocatePacket(pktLen);
   RWPrivateCursor cursor(pkt->buf());
-  cursor.push(buf_.data(), buf_.length());
+  cursor.push(buf.data(), buf.length());
 
   sw_->sendPacketSwitched(std::move(pkt));
 }
 
-IPv6RouteAdvertiser::IPv6RouteAdvertiser(SwSwitch* sw,
-                                         const SwitchState* state,
-                                         const Interface* intf) {
-  adv_ = new IPv6RAImpl(sw, state, intf);
-  bool ret = sw->getBackgroundEvb()->runInEventBaseThread(
-      IPv6RAImpl::start, adv_);
-  if (!ret) {
-    delete adv_;
-    adv_ = nullptr;
-    throw FbossError("failed to start IPv6 route advertiser for interface ",
-                     intf->getID());
+IPv6RouteAdvertiser::IPv6RouteAdvertiser(SwSwitch* sw)
+    : sw_(sw), adv_(new IPv6RAImpl(sw)) {}
 
+IPv6RouteAdvertiser::~IPv6RouteAdvertiser() {
+  bool ret = sw_->getBackgroundEvb()->runInEventBaseThread(
+      IPv6RAImpl::stop, adv_);
+  if (!ret) {
+    XLOG(ERR) << "failed to stop IPv6 route advertiser";
   }
 }
 
-IPv6RouteAdvertiser::IPv6RouteAdvertiser(IPv6RouteAdvertiser&& other) noexcept
-  : adv_(other.adv_) {
-    other.adv_ = nullptr;
+void IPv6RouteAdvertiser::addInterface(const Interface* intf) {
+  auto id = intf->getID();
+  auto buf = createMulticastAdvertisement(intf);
+  std::chrono::milliseconds interval = std::chrono::seconds(
+      intf->getNdpConfig().routerAdvertisementSeconds);
+  (*packets_.wlock())[id] = buf;
+
+  auto* adv = adv_;
+  bool ret = sw_->getBackgroundEvb()->runInEventBaseThread(
+      [adv, id, buf, interval]() { adv->setInterface(id, buf, interval); });
+  if (!ret) {
+    throw FbossError("failed to start IPv6 route advertiser for interface ",
+                     id);
+  }
 }
 
-IPv6RouteAdvertiser::~IPv6RouteAdvertiser() {
-  if (!adv_) {
-    return;
+void IPv6RouteAdvertiser::changeInterface(const Interface* oldIntf,
+                                          const Interface* newIntf) {
+  // Replacing the advertisement keeps when it is next due
+  if (advertisementChanged(oldIntf, newIntf)) {
+    addInterface(newIntf);
   }
-  bool ret = adv_->getSw()->getBackgroundEvb()->runInEventBaseThread(
-      IPv6RAImpl::stop, adv_);
+}
+
+void IPv6RouteAdvertiser::removeInterface(const Interface* intf) {
+  auto id = intf->getID();
+  packets_.wlock()->erase(id);
+
+  auto* adv = adv_;
+  bool ret = sw_->getBackgroundEvb()->runInEventBaseThread(
+      [adv, id]() { adv->removeInterface(id); });
   if (!ret) {
-    XLOG(ERR) << "failed to stop IPv6 route advertiser";
+    XLOG(ERR) << "failed to stop IPv6 route advertiser for interface " << id;
   }
 }
 
-IPv6RouteAdvertiser& IPv6RouteAdvertiser::operator=(
-    IPv6RouteAdvertiser&& other) noexcept {
-  adv_ = other.adv_;
-  other.adv_ = nullptr;
-  return *this;
+std::unique_ptr<TxPacket> IPv6RouteAdvertiser::createSolicitedAdvertisement(
+    InterfaceID intf,
+    folly::MacAddress dstMac,
+    const folly::IPAddressV6& dstIP) const {
+  std::shared_ptr<const IOBuf> buf;
+  {
+    auto packets = packets_.rlock();
+    auto it = packets->find(intf);
+    if (it == packets->end()) {
+      return nullptr;
+    }
+    buf = it->second;
+  }
+
+  auto pkt = sw_->allocatePacket(buf->length());
+  RWPrivateCursor cursor(pkt->buf());
+  cursor.push(buf->data(), buf->length());
+
+  // Address it to the solicitor instead of all nodes.  The destination
+  // address is part of the pseudo header the ICMPv6 checksum covers, so the
+  // checksum is updated for it.
+  RWPrivateCursor dstCursor(pkt->buf());
+  dstCursor.push(dstMac.bytes(), MacAddress::SIZE);
+  dstCursor.skip(kDstIPOffset - MacAddress::SIZE);
+  dstCursor.push(dstIP.bytes(), IPAddressV6::byteCount());
+  dstCursor.skip(kChecksumOffset - kDstIPOffset - IPAddressV6::byteCount());
+  auto csum = Cursor(dstCursor).readBE<uint16_t>();
+  dstCursor.writeBE<uint16_t>(
+      PktUtil::updateChecksum(csum, kAllNodes, dstIP));
+  return pkt;
+}
+
+/* static */ bool IPv6RouteAdvertiser::advertisementChanged(
+    const Interface* oldIntf,
+    const Interface* newIntf) {
+  return oldIntf->getAddresses() != newIntf->getAddresses() ||
+      oldIntf->getMac() != newIntf->getMac() ||
+      oldIntf->getMtu() != newIntf->getMtu() ||
+      oldIntf->getVlanID() != newIntf->getVlanID() ||
+      !(oldIntf->getNdpConfig() == newIntf->getNdpConfig());
+}
+
+/* static */ std::shared_ptr<const IOBuf>
+IPv6RouteAdvertiser::createMulticastAdvertisement(const Interface* intf) {
+  auto totalLength = getPacketSize(intf);
+  auto buf = std::make_shared<IOBuf>(IOBuf::CREATE, totalLength);
+  buf->append(totalLength);
+  RWPrivateCursor cursor(buf.get());
+  createAdvertisementPacket(intf, &cursor, kAllNodesMac, kAllNodes);
+  return buf;
 }
 
 /* static */ uint32_t IPv6RouteAdvertiser::getPacketSize(
@@ -9,9 +9,17 @@
  */
 #pragma once
 
+#include "fboss/agent/types.h"
+
+#include <folly/Synchronized.h>
 #include <folly/io/IOBuf.h>
 #include <folly/io/Cursor.h>
-#include <folly/io/async/AsyncTimeout.h>
+#include <gflags/gflags.h>
+
+#include <map>
+#include <memory>
+
+DECLARE_int32(ra_interval_jitter_pct);
 
 namespace folly {
 
@@ -24,26 +32,53 @@ namespace facebook { namespace fboss {
 
 class Interface;
 class IPv6RAImpl;
-class SwitchState;
 class SwSwitch;
+class TxPacket;
 
 /**
  * IPv6RouteAdvertiser takes care of periodically sending out IPv6 route
- * advertisement packets on an interface.
+ * advertisement packets on the interfaces that have them enabled.
+ *
+ * Each interface's advertisement is built once, when it is added, and only
+ * built again when something it advertises changes.  All of the interfaces
+ * share one timer in the background thread, which sends out every
+ * advertisement that is due at the same time in one batch.  Each interval is
+ * shortened by a random amount of up to ra_interval_jitter_pct percent of
+ * the interface's NdpConfig interval, so that interfaces added together
+ * spread out rather than all sending at once.
  *
- * When you create an IPv6RouteAdvertiser object, it will begin sending out RA
- * packets at the interval specified in the interface's NdpConfig.  When you
- * destroy the IPv6RouteAdvertiser it will stop sending out RA packets.
+ * When an interface is removed, or the IPv6RouteAdvertiser is destroyed, one
+ * last advertisement is sent out so routes don't time out on hosts while
+ * the controller restarts.
  */
 class IPv6RouteAdvertiser {
  public:
-  IPv6RouteAdvertiser(SwSwitch* sw, const SwitchState* state,
-                      const Interface* intf);
+  explicit IPv6RouteAdvertiser(SwSwitch* sw);
   ~IPv6RouteAdvertiser();
 
-  // IPv6RouteAdvertiser objects are movable
-  IPv6RouteAdvertiser(IPv6RouteAdvertiser&& other) noexcept;
-  IPv6RouteAdvertiser& operator=(IPv6RouteAdvertiser&& other) noexcept;
+  /*
+   * Start, update or stop advertising on an interface.  Called from the
+   * update thread.
+   */
+  void addInterface(const Interface* intf);
+  void changeInterface(const Interface* oldIntf, const Interface* newIntf);
+  void removeInterface(const Interface* intf);
+
+  /*
+   * An advertisement for a router solicitation on intf, copied from the
+   * interface's cached advertisement, or nullptr if it isn't advertising.
+   * Can be called from any thread.
+   */
+  std::unique_ptr<TxPacket> createSolicitedAdvertisement(
+      InterfaceID intf,
+      folly::MacAddress dstMac,
+      const folly::IPAddressV6& dstIP) const;
+
+  /*
+   * If an interface change changes its advertisement.
+   */
+  static bool advertisementChanged(const Interface* oldIntf,
+                                   const Interface* newIntf);
 
   static uint32_t getPacketSize(const Interface* intf);
   static void createAdvertisementPacket(const Interface* intf,
@@ -52,16 +87,27 @@ class IPv6RouteAdvertiser {
                                         const folly::IPAddressV6& dstIP);
 
  private:
+  // Forbidden copy constructor and assignment operator
+  IPv6RouteAdvertiser(IPv6RouteAdvertiser const &) = delete;
+  IPv6RouteAdvertiser& operator=(IPv6RouteAdvertiser const &) = delete;
+
+  static std::shared_ptr<const folly::IOBuf> createMulticastAdvertisement(
+      const Interface* intf);
+
+  SwSwitch* sw_{nullptr};
   /*
-   * All of the work is actually done by an IPv6RAImpl object.
+   * The timer and the sending is done by an IPv6RAImpl object.
    *
    * The separation between IPv6RouteAdvertiser and IPv6RAImpl is primarily to
    * handle proper synchronization with the background thread when the
-   * IPv6RAImpl object is destroyed.  When the IPv6RAImpl is destroyed, the
-   * IPv6RAImpl still needs to remain around briefly until the timeout can be
-   * cancelled in the background thread.
+   * IPv6RouteAdvertiser object is destroyed.  When the IPv6RouteAdvertiser is
+   * destroyed, the IPv6RAImpl still needs to remain around briefly until the
+   * timeout can be cancelled in the background thread.
    */
   IPv6RAImpl* adv_{nullptr};
+  // The multicast advertisement of each interface, shared with adv_
+  folly::Synchronized<
+      std::map<InterfaceID, std::shared_ptr<const folly::IOBuf>>> packets_;
 };
 
 }} // facebook::fboss
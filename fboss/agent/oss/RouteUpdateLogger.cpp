@@ -9,16 +9,42 @@
  */
 
 #include "fboss/agent/RouteUpdateLogger.h"
+#include "fboss/agent/RouteUpdateBinaryLog.h"
 
 #include <folly/IPAddressV4.h>
 #include <folly/IPAddressV6.h>
+#include <gflags/gflags.h>
 
 
 #include <memory>
+#include <mutex>
+
+DEFINE_string(route_update_log_file, "",
+              "Log the updates to tracked routes to this file in the binary "
+              "route update log format, rather than to glog. Decode it with "
+              "route_update_log_decoder");
 
 namespace {
+// The v4 and v6 loggers write to the same file
+std::shared_ptr<facebook::fboss::RouteUpdateBinaryLog> getBinaryLog() {
+  static std::mutex lock;
+  static std::weak_ptr<facebook::fboss::RouteUpdateBinaryLog> binaryLog;
+  std::lock_guard<std::mutex> g(lock);
+  auto log = binaryLog.lock();
+  if (!log) {
+    log = std::make_shared<facebook::fboss::RouteUpdateBinaryLog>(
+        FLAGS_route_update_log_file);
+    binaryLog = log;
+  }
+  return log;
+}
+
 template<typename AddrT>
 std::unique_ptr<facebook::fboss::RouteLogger<AddrT>> getRouteLogger() {
+  if (!FLAGS_route_update_log_file.empty()) {
+    return std::make_unique<facebook::fboss::BinaryRouteLogger<AddrT>>(
+        getBinaryLog());
+  }
   return std::make_unique<facebook::fboss::GlogRouteLogger<AddrT>>();
 }
 }
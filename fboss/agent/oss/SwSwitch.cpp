@@ -9,6 +9,8 @@
  */
 #include "fboss/agent/SwSwitch.h"
 
+#include "common/stats/ThreadCachedServiceData.h"
+
 #include <folly/Format.h>
 #include <folly/Range.h>
 #include <folly/logging/xlog.h>
@@ -29,7 +31,11 @@ void SwSwitch::initThread(folly::StringPiece name) {
 
 void SwSwitch::publishInitTimes(std::string /*name*/, const float& /*time*/) {}
 
-void SwSwitch::publishStats() {}
+void SwSwitch::publishStats() {
+  // There is no fb303 publisher thread in the open source build, so fold
+  // every thread's stats into the exported counters here.
+  stats::ThreadCachedServiceData::get()->publishStats();
+}
 
 void SwSwitch::publishSwitchInfo(struct HwInitResult /*hwInitRet*/) {}
 
@@ -102,6 +102,14 @@ void IPv4Hdr::computeChecksum() {
   csum = PktUtil::internetChecksum(buf->data(), size());
 }
 
+void IPv4Hdr::setTtl(uint8_t newTtl) {
+  // The TTL shares a 16-bit word of the header with the protocol
+  csum = PktUtil::updateChecksum(csum,
+                                 (uint16_t(ttl) << 8) | protocol,
+                                 (uint16_t(newTtl) << 8) | protocol);
+  ttl = newTtl;
+}
+
 uint32_t IPv4Hdr::pseudoHdrPartialCsum() const {
   return pseudoHdrPartialCsum(length - (ihl * 4));
 }
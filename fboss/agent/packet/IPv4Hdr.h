@@ -124,6 +124,11 @@ class IPv4Hdr {
   }
 
   void computeChecksum();
+  /*
+   * Change the TTL, updating the checksum to match rather than computing it
+   * over the whole header again.
+   */
+  void setTtl(uint8_t newTtl);
   template<typename CursorType>
   void write(CursorType* cursor) const;
 
@@ -0,0 +1,142 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "fboss/agent/packet/ParsedPacket.h"
+
+#include <folly/io/Cursor.h>
+#include <folly/io/IOBuf.h>
+#include "fboss/agent/packet/Ethertype.h"
+#include "fboss/agent/packet/IPProto.h"
+#include "fboss/agent/packet/IPv4Hdr.h"
+#include "fboss/agent/packet/IPv6Hdr.h"
+#include "fboss/agent/packet/PktUtil.h"
+
+using folly::IOBuf;
+using folly::io::Cursor;
+
+namespace facebook { namespace fboss {
+
+namespace {
+
+constexpr uint32_t kEthHdrLen = 14;
+constexpr uint32_t kVlanTagLen = 4;
+constexpr uint32_t kIPv4MinHdrLen = 20;
+constexpr uint32_t kIPv6HdrLen = 40;
+constexpr uint32_t kUDPHdrLen = 8;
+
+// Each of these is given the number of bytes left in the packet from the
+// start of its header, and a cursor pointing there.
+
+void parseL4(uint32_t length, ParsedPacket* parsed) {
+  // Only UDP is read in software past the IP header, other than as the
+  // payload of ICMP errors
+  if (parsed->ipProtocol == IP_PROTO_UDP && length < kUDPHdrLen) {
+    parsed->error = ParsedPacket::Error::TRUNCATED_L4;
+  }
+}
+
+void parseIPv4(Cursor cursor, uint32_t length, ParsedPacket* parsed) {
+  // Only the fields IPv4Hdr checks are read
+  if (length < kIPv4MinHdrLen) {
+    parsed->error = ParsedPacket::Error::TRUNCATED_L3;
+    return;
+  }
+  uint8_t buf[10];
+  cursor.pull(buf, sizeof(buf));
+  uint8_t version = buf[0] >> 4;
+  uint32_t hdrLen = (buf[0] & 0x0F) * 4;
+  uint16_t totalLen = (static_cast<uint16_t>(buf[2]) << 8) | buf[3];
+  uint16_t fragmentOffset = (static_cast<uint16_t>(buf[6] & 0x1F) << 8) |
+      buf[7];
+  bool moreFragments = buf[6] & 0x20;
+  uint8_t ttl = buf[8];
+  if (version != IPV4_VERSION || hdrLen < kIPv4MinHdrLen ||
+      totalLen < hdrLen || ttl == 0) {
+    parsed->error = ParsedPacket::Error::BAD_L3;
+    return;
+  }
+  if (length < hdrLen) {
+    parsed->error = ParsedPacket::Error::TRUNCATED_L3;
+    return;
+  }
+  parsed->ipProtocol = buf[9];
+  if (hdrLen > kIPv4MinHdrLen) {
+    parsed->flags |= ParsedPacket::IP_OPTIONS;
+  }
+  if (moreFragments || fragmentOffset) {
+    parsed->flags |= ParsedPacket::IP_FRAGMENT;
+  }
+  if (fragmentOffset) {
+    // Only the first fragment has the L4 header
+    return;
+  }
+  parsed->l4Offset = parsed->l3Offset + hdrLen;
+  parseL4(length - hdrLen, parsed);
+}
+
+void parseIPv6(Cursor cursor, uint32_t length, ParsedPacket* parsed) {
+  if (length < kIPv6HdrLen) {
+    parsed->error = ParsedPacket::Error::TRUNCATED_L3;
+    return;
+  }
+  uint8_t buf[8];
+  cursor.pull(buf, sizeof(buf));
+  uint8_t version = buf[0] >> 4;
+  uint8_t hopLimit = buf[7];
+  if (version != IPV6_VERSION || hopLimit == 0) {
+    parsed->error = ParsedPacket::Error::BAD_L3;
+    return;
+  }
+  // Extension headers are left to the handlers
+  parsed->ipProtocol = buf[6];
+  parsed->l4Offset = parsed->l3Offset + kIPv6HdrLen;
+  parseL4(length - kIPv6HdrLen, parsed);
+}
+
+} // unnamed namespace
+
+ParsedPacket ParsedPacket::parse(const IOBuf* buf) noexcept {
+  ParsedPacket parsed;
+  // All of the reads are checked against the length up front, so none of
+  // them can throw.
+  auto length = buf->computeChainDataLength();
+  if (length < kEthHdrLen) {
+    parsed.error = Error::TRUNCATED_L2;
+    return parsed;
+  }
+  Cursor cursor(buf);
+  parsed.dstMac = PktUtil::readMac(&cursor);
+  parsed.srcMac = PktUtil::readMac(&cursor);
+  parsed.etherType = cursor.readBE<uint16_t>();
+  parsed.l3Offset = kEthHdrLen;
+  if (parsed.etherType == ETHERTYPE_VLAN) {
+    if (length < kEthHdrLen + kVlanTagLen) {
+      parsed.error = Error::TRUNCATED_L2;
+      return parsed;
+    }
+    parsed.flags |= VLAN_TAGGED;
+    parsed.vlanTag = cursor.readBE<uint16_t>();
+    parsed.etherType = cursor.readBE<uint16_t>();
+    parsed.l3Offset += kVlanTagLen;
+  }
+
+  switch (parsed.etherType) {
+    case ETHERTYPE_IPV4:
+      parseIPv4(cursor, length - parsed.l3Offset, &parsed);
+      break;
+    case ETHERTYPE_IPV6:
+      parseIPv6(cursor, length - parsed.l3Offset, &parsed);
+      break;
+    default:
+      break;
+  }
+  return parsed;
+}
+
+}} // facebook::fboss
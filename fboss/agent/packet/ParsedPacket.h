@@ -0,0 +1,80 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#pragma once
+
+#include <folly/MacAddress.h>
+
+#include <cstdint>
+
+namespace folly {
+class IOBuf;
+}
+
+namespace facebook { namespace fboss {
+
+/*
+ * Where the headers of a received packet are, and the fields it is
+ * dispatched on.
+ *
+ * parse() goes over the headers once as the packet is received, without
+ * allocating or throwing, and checks them the way IPv4Hdr, IPv6Hdr and
+ * UDPHeader do when they are read.  A malformed packet can then be dropped
+ * before it gets to a handler, without unwinding out of one, and a handler
+ * can read the headers the descriptor says are there without checking them
+ * again.
+ */
+struct ParsedPacket {
+  enum class Error : uint8_t {
+    NONE,
+    // The packet ends before the end of a header
+    TRUNCATED_L2,
+    TRUNCATED_L3,
+    TRUNCATED_L4,
+    // The IP header has a bad version, length or TTL
+    BAD_L3,
+  };
+
+  enum Flags : uint8_t {
+    VLAN_TAGGED = 0x01,
+    IP_OPTIONS = 0x02,
+    IP_FRAGMENT = 0x04,
+  };
+
+  static ParsedPacket parse(const folly::IOBuf* buf) noexcept;
+
+  bool isValid() const {
+    return error == Error::NONE;
+  }
+  bool hasFlag(Flags flag) const {
+    return flags & flag;
+  }
+  /*
+   * Whether l4Offset points at the L4 header.  It doesn't for non-IP
+   * packets, or for IP fragments other than the first.
+   */
+  bool hasL4() const {
+    return l4Offset != 0;
+  }
+
+  folly::MacAddress dstMac;
+  folly::MacAddress srcMac;
+  // The tag control information of the 802.1Q tag, if VLAN_TAGGED
+  uint16_t vlanTag{0};
+  uint16_t etherType{0};
+  // The IPv4 protocol or IPv6 next header
+  uint8_t ipProtocol{0};
+  uint8_t flags{0};
+  Error error{Error::NONE};
+  // Offsets from the start of the packet
+  uint32_t l3Offset{0};
+  uint32_t l4Offset{0};
+};
+
+}} // facebook::fboss
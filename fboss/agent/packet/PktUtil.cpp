@@ -13,9 +13,18 @@
 #include <folly/IPAddressV4.h>
 #include <folly/IPAddressV6.h>
 #include <folly/MacAddress.h>
+#include <folly/Portability.h>
 #include <folly/io/Cursor.h>
+#include <folly/lang/Bits.h>
 #include "fboss/agent/FbossError.h"
 
+#include <algorithm>
+
+#if FOLLY_X64 && defined(__GNUC__)
+#include <immintrin.h>
+#define FBOSS_CHECKSUM_X86 1
+#endif
+
 using folly::IPAddressV4;
 using folly::IPAddressV6;
 using folly::MacAddress;
@@ -26,6 +35,83 @@ using folly::IOBuf;
 using folly::StringPiece;
 using std::string;
 
+namespace {
+
+// The kernels sum whole blocks of the data as 16-bit words in host byte
+// order, into a 64-bit sum that is folded once at the end.
+uint64_t sumScalar(const uint8_t* data, size_t length) {
+  uint64_t sum = 0;
+  for (size_t i = 0; i < length; i += 8) {
+    uint64_t words;
+    memcpy(&words, data + i, sizeof(words));
+    sum += (words & 0xffffffff) + (words >> 32);
+  }
+  return sum;
+}
+
+#ifdef FBOSS_CHECKSUM_X86
+// Each block adds less than 2^17 to a 32-bit lane of the vector sums, so
+// they are added to the 64-bit sum before 2^15 blocks can overflow them.
+constexpr size_t kMaxBlocksPerLaneSum = 1 << 14;
+
+uint64_t sumSse2(const uint8_t* data, size_t length) {
+  const auto zero = _mm_setzero_si128();
+  uint64_t sum = 0;
+  while (length) {
+    auto blocks = std::min(length / 16, kMaxBlocksPerLaneSum);
+    auto lanes = zero;
+    for (size_t i = 0; i < blocks; ++i) {
+      auto words = _mm_loadu_si128(
+          reinterpret_cast<const __m128i*>(data + i * 16));
+      lanes = _mm_add_epi32(lanes, _mm_add_epi32(
+          _mm_unpacklo_epi16(words, zero), _mm_unpackhi_epi16(words, zero)));
+    }
+    uint32_t laneSums[4];
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(laneSums), lanes);
+    for (auto laneSum : laneSums) {
+      sum += laneSum;
+    }
+    data += blocks * 16;
+    length -= blocks * 16;
+  }
+  return sum;
+}
+
+__attribute__((__target__("avx2")))
+uint64_t sumAvx2(const uint8_t* data, size_t length) {
+  const auto zero = _mm256_setzero_si256();
+  uint64_t sum = 0;
+  while (length) {
+    auto blocks = std::min(length / 32, kMaxBlocksPerLaneSum);
+    auto lanes = zero;
+    for (size_t i = 0; i < blocks; ++i) {
+      auto words = _mm256_loadu_si256(
+          reinterpret_cast<const __m256i*>(data + i * 32));
+      lanes = _mm256_add_epi32(lanes, _mm256_add_epi32(
+          _mm256_unpacklo_epi16(words, zero),
+          _mm256_unpackhi_epi16(words, zero)));
+    }
+    uint32_t laneSums[8];
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(laneSums), lanes);
+    for (auto laneSum : laneSums) {
+      sum += laneSum;
+    }
+    data += blocks * 32;
+    length -= blocks * 32;
+  }
+  return sum;
+}
+#endif
+
+uint32_t foldSum(uint64_t sum) {
+  while (sum >> 16) {
+    sum = (sum & 0xffff) + (sum >> 16);
+  }
+  return static_cast<uint32_t>(sum);
+}
+
+} // unnamed namespace
+
 namespace facebook { namespace fboss {
 
 MacAddress PktUtil::readMac(Cursor* cursor) {
@@ -79,20 +165,95 @@ uint16_t PktUtil::internetChecksum(const IOBuf* buf) {
 uint32_t PktUtil::partialChecksumImpl(folly::io::Cursor cursor,
                                       uint64_t length,
                                       uint32_t value) {
-  // Checksum all the pairs of bytes first
-  while  (length > 1) {
-    value += cursor.readBE<uint16_t>();
-    length -= 2;
+  // Sum each contiguous piece of the data in one go
+  bool oddOffset = false;
+  while (length > 0) {
+    auto bytes = cursor.peekBytes();
+    if (bytes.empty()) {
+      throw std::out_of_range("underflow");
+    }
+    auto size = std::min<uint64_t>(bytes.size(), length);
+    uint16_t sum = sumWords(bytes.data(), size);
+    // A piece that starts at an odd offset starts with the 8 LSbits of a
+    // word, so its sum is off by a byte swap (RFC 1071 section 2(B)).
+    value += oddOffset ? folly::Endian::swap(sum) : sum;
+    oddOffset ^= (size & 1);
+    cursor.skip(size);
+    length -= size;
   }
-  if (length) {
+  return value;
+}
+
+bool PktUtil::isSupported(ChecksumKernel kernel) {
+  switch (kernel) {
+    case ChecksumKernel::SCALAR:
+      return true;
+#ifdef FBOSS_CHECKSUM_X86
+    case ChecksumKernel::SSE2:
+      // Part of x86-64
+      return true;
+    case ChecksumKernel::AVX2:
+      __builtin_cpu_init();
+      return __builtin_cpu_supports("avx2");
+#endif
+    default:
+      return false;
+  }
+}
+
+PktUtil::ChecksumKernel PktUtil::getChecksumKernel() {
+  static const auto kernel = [] {
+    for (auto kernel : {ChecksumKernel::AVX2, ChecksumKernel::SSE2}) {
+      if (isSupported(kernel)) {
+        return kernel;
+      }
+    }
+    return ChecksumKernel::SCALAR;
+  }();
+  return kernel;
+}
+
+uint16_t PktUtil::sumWords(const uint8_t* data, size_t length) {
+  return sumWords(data, length, getChecksumKernel());
+}
+
+uint16_t PktUtil::sumWords(const uint8_t* data,
+                           size_t length,
+                           ChecksumKernel kernel) {
+  DCHECK(isSupported(kernel));
+  size_t blockBytes = 0;
+  uint64_t sum = 0;
+  switch (kernel) {
+#ifdef FBOSS_CHECKSUM_X86
+    case ChecksumKernel::AVX2:
+      blockBytes = length & ~size_t(31);
+      sum = sumAvx2(data, blockBytes);
+      break;
+    case ChecksumKernel::SSE2:
+      blockBytes = length & ~size_t(15);
+      sum = sumSse2(data, blockBytes);
+      break;
+#endif
+    default:
+      blockBytes = length & ~size_t(7);
+      sum = sumScalar(data, blockBytes);
+      break;
+  }
+  // Byte swapping the folded sum of host byte order words gives the sum of
+  // the n/w byte order words.
+  sum = folly::Endian::big(static_cast<uint16_t>(foldSum(sum)));
+
+  size_t i = blockBytes;
+  for (; i + 1 < length; i += 2) {
+    sum += (data[i] << 8) | data[i + 1];
+  }
+  if (i < length) {
     // Bytes are interpreted in n/w byte order
     // so this last octet represents the 8 MSbits
     // of the last 16 bit number in this buffer.
-    uint16_t last = cursor.read<uint8_t>();
-    value += (last << 8);
-    --length;
+    sum += data[i] << 8;
   }
-  return value;
+  return static_cast<uint16_t>(foldSum(sum));
 }
 
 uint32_t PktUtil::partialChecksum(folly::io::Cursor cursor,
@@ -118,6 +279,39 @@ uint16_t PktUtil::finalizeChecksum(uint32_t sum) {
   return static_cast<uint16_t>(sum);
 }
 
+uint16_t PktUtil::updateChecksum(uint16_t csum,
+                                 uint16_t oldValue,
+                                 uint16_t newValue) {
+  // HC' = ~(~HC + ~m + m')
+  uint32_t sum = static_cast<uint16_t>(~csum);
+  sum += static_cast<uint16_t>(~oldValue);
+  sum += newValue;
+  return finalizeChecksum(sum);
+}
+
+uint16_t PktUtil::updateChecksum(uint16_t csum,
+                                 const IPAddressV4& oldValue,
+                                 const IPAddressV4& newValue) {
+  auto oldLong = oldValue.toLongHBO();
+  auto newLong = newValue.toLongHBO();
+  csum = updateChecksum(csum, oldLong >> 16, newLong >> 16);
+  return updateChecksum(csum, oldLong & 0xffff, newLong & 0xffff);
+}
+
+uint16_t PktUtil::updateChecksum(uint16_t csum,
+                                 const IPAddressV6& oldValue,
+                                 const IPAddressV6& newValue) {
+  auto oldBytes = oldValue.bytes();
+  auto newBytes = newValue.bytes();
+  for (size_t i = 0; i < IPAddressV6::byteCount(); i += 2) {
+    csum = updateChecksum(
+        csum,
+        (oldBytes[i] << 8) | oldBytes[i + 1],
+        (newBytes[i] << 8) | newBytes[i + 1]);
+  }
+  return csum;
+}
+
 string PktUtil::hexDump(Cursor cursor) {
   return hexDump(cursor, cursor.totalLength());
 }
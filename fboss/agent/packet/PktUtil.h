@@ -85,6 +85,44 @@ class PktUtil {
                                    uint32_t value);
   static uint16_t finalizeChecksum(uint32_t value);
 
+  /*
+   * Update a checksum for a 16-bit field of the data it covers changing from
+   * oldValue to newValue, without summing the rest of the data again
+   * (RFC 1624 eqn 3).  Everything is in host byte order.
+   */
+  static uint16_t updateChecksum(uint16_t csum,
+                                 uint16_t oldValue,
+                                 uint16_t newValue);
+  static uint16_t updateChecksum(uint16_t csum,
+                                 const folly::IPAddressV4& oldValue,
+                                 const folly::IPAddressV4& newValue);
+  static uint16_t updateChecksum(uint16_t csum,
+                                 const folly::IPAddressV6& oldValue,
+                                 const folly::IPAddressV6& newValue);
+
+  /*
+   * The ways of summing contiguous data for the checksum.  The fastest one
+   * the CPU supports is picked when it is first needed; the others are only
+   * of interest to tests and benchmarks.
+   */
+  enum class ChecksumKernel {
+    SCALAR,
+    SSE2,
+    AVX2,
+  };
+  static bool isSupported(ChecksumKernel kernel);
+  static ChecksumKernel getChecksumKernel();
+
+  /*
+   * Return the ones' complement sum of the data as 16-bit words in n/w
+   * byte order, folded to 16 bits.  An odd last byte is treated as the
+   * 8 MSbits of a word.
+   */
+  static uint16_t sumWords(const uint8_t* data, size_t length);
+  static uint16_t sumWords(const uint8_t* data,
+                           size_t length,
+                           ChecksumKernel kernel);
+
   /**
    * Return a string containing a human readable hex dump of the binary data.
    */
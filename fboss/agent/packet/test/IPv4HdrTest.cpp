@@ -334,3 +334,16 @@ TEST(IPv4HdrTest, inequality_operator) {
       fragmentOffset, ttl2, protocol, csum, srcAddr, dstAddr);
   EXPECT_NE(lhs, rhs);
 }
+
+TEST(IPv4HdrTest, set_ttl) {
+  IPv4Hdr ipv4Hdr(IPAddressV4("10.0.0.15"), IPAddressV4("10.0.0.1"),
+                  IP_PROTO_UDP, 100);
+  ipv4Hdr.computeChecksum();
+  for (auto ttl : {254, 64, 1, 0, 255}) {
+    ipv4Hdr.setTtl(ttl);
+    EXPECT_EQ(ttl, ipv4Hdr.ttl);
+    auto csum = ipv4Hdr.csum;
+    ipv4Hdr.computeChecksum();
+    EXPECT_EQ(ipv4Hdr.csum, csum);
+  }
+}
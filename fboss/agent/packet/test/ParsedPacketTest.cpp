@@ -0,0 +1,154 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "fboss/agent/packet/ParsedPacket.h"
+
+#include <gtest/gtest.h>
+
+#include <folly/MacAddress.h>
+#include <folly/io/IOBuf.h>
+
+#include "fboss/agent/packet/Ethertype.h"
+#include "fboss/agent/packet/IPProto.h"
+#include "fboss/agent/packet/PktUtil.h"
+
+using namespace facebook::fboss;
+using folly::IOBuf;
+using folly::MacAddress;
+using Error = ParsedPacket::Error;
+
+namespace {
+
+const std::string kL2 =
+    // dst mac, src mac
+    "02 00 01 00 00 01  02 00 02 01 02 03"
+    // 802.1q, VLAN 1
+    "81 00 00 01";
+
+const std::string kIPv4 =
+    // Version(4), IHL(5), DSCP(0), ECN(0), Total Length(28)
+    "45 00 00 1c"
+    // Identification(0), Flags(0), Fragment offset(0)
+    "00 00 00 00"
+    // TTL(64), Protocol(17), Checksum (fake)
+    "40 11 12 34"
+    // Source IP (10.0.0.2), Destination IP (10.0.0.1)
+    "0a 00 00 02  0a 00 00 01";
+
+const std::string kIPv6 =
+    // Version(6), Traffic class, Flow label
+    "60 00 00 00"
+    // Payload length (8), next header (17), hop limit (255)
+    "00 08 11 ff"
+    // Src IPv6 address
+    "fe 80 00 00 00 00 00 00 02 02 c9 ff fe bb 5e 0e"
+    // Dst IPv6 address
+    "24 01 db 00 21 10 30 01 00 00 00 00 00 00 00 01";
+
+const std::string kUDP =
+    // Source port (68), destination port (67), length (8), checksum
+    "00 44 00 43 00 08 00 00";
+
+ParsedPacket parse(const std::string& hex) {
+  auto buf = PktUtil::parseHexData(hex);
+  return ParsedPacket::parse(&buf);
+}
+
+} // unnamed namespace
+
+TEST(ParsedPacketTest, IPv4) {
+  auto parsed = parse(kL2 + "08 00" + kIPv4 + kUDP);
+  EXPECT_TRUE(parsed.isValid());
+  EXPECT_EQ(MacAddress("02:00:01:00:00:01"), parsed.dstMac);
+  EXPECT_EQ(MacAddress("02:00:02:01:02:03"), parsed.srcMac);
+  EXPECT_TRUE(parsed.hasFlag(ParsedPacket::VLAN_TAGGED));
+  EXPECT_EQ(1, parsed.vlanTag);
+  EXPECT_EQ(ETHERTYPE_IPV4, parsed.etherType);
+  EXPECT_EQ(IP_PROTO_UDP, parsed.ipProtocol);
+  EXPECT_EQ(18, parsed.l3Offset);
+  EXPECT_TRUE(parsed.hasL4());
+  EXPECT_EQ(38, parsed.l4Offset);
+  EXPECT_FALSE(parsed.hasFlag(ParsedPacket::IP_OPTIONS));
+  EXPECT_FALSE(parsed.hasFlag(ParsedPacket::IP_FRAGMENT));
+}
+
+TEST(ParsedPacketTest, IPv4Options) {
+  // IHL(6), with one word of options
+  auto parsed = parse(
+      kL2 + "08 00" + "46" + kIPv4.substr(2) + "01 01 01 00" + kUDP);
+  EXPECT_TRUE(parsed.isValid());
+  EXPECT_TRUE(parsed.hasFlag(ParsedPacket::IP_OPTIONS));
+  EXPECT_EQ(42, parsed.l4Offset);
+}
+
+TEST(ParsedPacketTest, IPv4Fragments) {
+  auto ipv4 = kIPv4;
+  // More fragments, offset 0
+  ipv4.replace(ipv4.find("00 00 00 00"), 11, "00 00 20 00");
+  auto parsed = parse(kL2 + "08 00" + ipv4 + kUDP);
+  EXPECT_TRUE(parsed.isValid());
+  EXPECT_TRUE(parsed.hasFlag(ParsedPacket::IP_FRAGMENT));
+  EXPECT_TRUE(parsed.hasL4());
+
+  // Offset 8, which has no UDP header, however short it is
+  ipv4.replace(ipv4.find("00 00 20 00"), 11, "00 00 00 01");
+  parsed = parse(kL2 + "08 00" + ipv4 + "00 44");
+  EXPECT_TRUE(parsed.isValid());
+  EXPECT_TRUE(parsed.hasFlag(ParsedPacket::IP_FRAGMENT));
+  EXPECT_FALSE(parsed.hasL4());
+}
+
+TEST(ParsedPacketTest, IPv6) {
+  // No VLAN tag
+  auto parsed = parse(kL2.substr(0, kL2.find("81")) + "86 dd" + kIPv6 + kUDP);
+  EXPECT_TRUE(parsed.isValid());
+  EXPECT_FALSE(parsed.hasFlag(ParsedPacket::VLAN_TAGGED));
+  EXPECT_EQ(ETHERTYPE_IPV6, parsed.etherType);
+  EXPECT_EQ(IP_PROTO_UDP, parsed.ipProtocol);
+  EXPECT_EQ(14, parsed.l3Offset);
+  EXPECT_EQ(54, parsed.l4Offset);
+}
+
+TEST(ParsedPacketTest, OtherEtherTypes) {
+  // ARP, which is left to its handler
+  auto parsed = parse(kL2 + "08 06" + "00 01");
+  EXPECT_TRUE(parsed.isValid());
+  EXPECT_EQ(ETHERTYPE_ARP, parsed.etherType);
+  EXPECT_EQ(18, parsed.l3Offset);
+  EXPECT_FALSE(parsed.hasL4());
+}
+
+TEST(ParsedPacketTest, Malformed) {
+  EXPECT_EQ(Error::TRUNCATED_L2, parse("02 00 01 00 00 01").error);
+  EXPECT_EQ(Error::TRUNCATED_L2, parse(kL2.substr(0, 42)).error);
+  EXPECT_EQ(
+      Error::TRUNCATED_L3,
+      parse(kL2 + "08 00" + "45 00 00 1c 00 00 00 00").error);
+  EXPECT_EQ(Error::TRUNCATED_L3, parse(kL2 + "86 dd" + kIPv4).error);
+  EXPECT_EQ(
+      Error::TRUNCATED_L3,
+      parse(kL2 + "08 00" + "46" + kIPv4.substr(2)).error);
+
+  // Version 5
+  EXPECT_EQ(Error::BAD_L3, parse(kL2 + "08 00" + "55" + kIPv4.substr(2)).error);
+  // IHL 4
+  EXPECT_EQ(Error::BAD_L3, parse(kL2 + "08 00" + "44" + kIPv4.substr(2)).error);
+  // TTL 0
+  auto ipv4 = kIPv4;
+  ipv4.replace(ipv4.find("40 11"), 2, "00");
+  EXPECT_EQ(Error::BAD_L3, parse(kL2 + "08 00" + ipv4 + kUDP).error);
+  // Hop limit 0
+  auto ipv6 = kIPv6;
+  ipv6.replace(ipv6.find("11 ff"), 5, "11 00");
+  EXPECT_EQ(Error::BAD_L3, parse(kL2 + "86 dd" + ipv6 + kUDP).error);
+
+  auto parsed = parse(kL2 + "08 00" + kIPv4 + kUDP.substr(0, 11));
+  EXPECT_EQ(Error::TRUNCATED_L4, parsed.error);
+  EXPECT_EQ(IP_PROTO_UDP, parsed.ipProtocol);
+}
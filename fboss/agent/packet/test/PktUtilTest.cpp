@@ -18,6 +18,8 @@
 #include <folly/logging/xlog.h>
 #include <gtest/gtest.h>
 
+#include <vector>
+
 using namespace facebook::fboss;
 using folly::MacAddress;
 using folly::IPAddressV4;
@@ -213,3 +215,96 @@ TEST(Checksum, TestKnownOdd) {
   expected = ~expected;
   EXPECT_EQ(expected, PktUtil::internetChecksum(bytes, 9));
 }
+
+namespace {
+uint16_t referenceSum(const uint8_t* bytes, size_t size) {
+  uint32_t sum = 0;
+  for (size_t i = 0; i < size; ++i) {
+    sum += (i % 2) ? bytes[i] : (bytes[i] << 8);
+  }
+  while (sum >> 16) {
+    sum = (sum & 0xffff) + (sum >> 16);
+  }
+  return sum;
+}
+}
+
+TEST(Checksum, Kernels) {
+  std::vector<uint8_t> bytes(20000);
+  for (auto& byte : bytes) {
+    byte = Random::rand32(std::numeric_limits<uint8_t>::max() + 1);
+  }
+  for (auto kernel : {PktUtil::ChecksumKernel::SCALAR,
+                      PktUtil::ChecksumKernel::SSE2,
+                      PktUtil::ChecksumKernel::AVX2}) {
+    if (!PktUtil::isSupported(kernel)) {
+      continue;
+    }
+    // Every alignment and length of the tail the kernels leave behind
+    for (size_t offset = 0; offset < 64; ++offset) {
+      for (size_t size = 0; size < 200; ++size) {
+        EXPECT_EQ(referenceSum(&bytes[offset], size) % 0xffff,
+                  PktUtil::sumWords(&bytes[offset], size, kernel) % 0xffff);
+      }
+    }
+    EXPECT_EQ(referenceSum(bytes.data(), bytes.size()) % 0xffff,
+              PktUtil::sumWords(bytes.data(), bytes.size(), kernel) % 0xffff);
+  }
+}
+
+TEST(Checksum, Chained) {
+  // Pieces of odd and even lengths, so that some start half way through a
+  // 16-bit word
+  std::vector<uint8_t> bytes(1000);
+  for (auto& byte : bytes) {
+    byte = Random::rand32(std::numeric_limits<uint8_t>::max() + 1);
+  }
+  auto buf = IOBuf::wrapBuffer(bytes.data(), 1);
+  size_t offset = 1;
+  for (size_t size = 2; offset + size <= bytes.size(); ++size) {
+    buf->prependChain(IOBuf::wrapBuffer(&bytes[offset], size));
+    offset += size;
+  }
+  EXPECT_EQ(PktUtil::internetChecksum(bytes.data(), offset),
+            PktUtil::internetChecksum(buf.get()));
+  EXPECT_EQ(PktUtil::internetChecksum(&bytes[5], offset - 10),
+            PktUtil::internetChecksum(Cursor(buf.get()) + 5, offset - 10));
+  EXPECT_THROW(
+      PktUtil::internetChecksum(Cursor(buf.get()), offset + 1),
+      std::out_of_range);
+}
+
+TEST(Checksum, Update) {
+  uint8_t bytes[20];
+  for (auto& byte : bytes) {
+    byte = Random::rand32(std::numeric_limits<uint8_t>::max() + 1);
+  }
+  auto csum = PktUtil::internetChecksum(bytes, sizeof(bytes));
+
+  uint16_t oldValue = (bytes[6] << 8) | bytes[7];
+  uint16_t newValue = oldValue + 0x1234;
+  bytes[6] = newValue >> 8;
+  bytes[7] = newValue & 0xff;
+  csum = PktUtil::updateChecksum(csum, oldValue, newValue);
+  EXPECT_EQ(PktUtil::internetChecksum(bytes, sizeof(bytes)), csum);
+
+
+  IPAddressV4 oldAddr("10.1.2.3");
+  IPAddressV4 newAddr("192.168.255.254");
+  memcpy(bytes + 12, oldAddr.bytes(), 4);
+  csum = PktUtil::internetChecksum(bytes, sizeof(bytes));
+  memcpy(bytes + 12, newAddr.bytes(), 4);
+  csum = PktUtil::updateChecksum(csum, oldAddr, newAddr);
+  EXPECT_EQ(PktUtil::internetChecksum(bytes, sizeof(bytes)), csum);
+
+  uint8_t v6Bytes[40];
+  memcpy(v6Bytes, bytes, sizeof(bytes));
+  memcpy(v6Bytes + 20, bytes, sizeof(bytes));
+  IPAddressV6 oldAddrV6("2401:db00:2110:1234::1:0");
+  IPAddressV6 newAddrV6("ff02::1");
+  memcpy(v6Bytes + 8, oldAddrV6.bytes(), 16);
+  csum = PktUtil::internetChecksum(v6Bytes, sizeof(v6Bytes));
+  memcpy(v6Bytes + 8, newAddrV6.bytes(), 16);
+  csum = PktUtil::updateChecksum(csum, oldAddrV6, newAddrV6);
+  EXPECT_EQ(PktUtil::internetChecksum(v6Bytes, sizeof(v6Bytes)), csum);
+}
@@ -14,6 +14,7 @@
 #include <glog/logging.h>
 #include "fboss/lib/usb/UsbError.h"
 #include "fboss/lib/usb/WedgeI2CBus.h"
+#include "fboss/agent/StartupProfiler.h"
 #include "fboss/agent/SwSwitch.h"
 #include "fboss/agent/SysError.h"
 #include "fboss/agent/hw/bcm/BcmAPI.h"
@@ -50,9 +51,25 @@ WedgePlatform::WedgePlatform(std::unique_ptr<WedgeProductInfo> productInfo)
       qsfpCache_(std::make_unique<QsfpCache>()) {}
 
 void WedgePlatform::init() {
-  auto config = loadConfig();
-  BcmAPI::init(config);
-  initLocalMac();
+  // These don't need the SDK, so they run while it initializes
+  auto localMac = std::async(std::launch::async, [this] {
+    StartupProfiler::Scope phase("wedge_init_local_mac");
+    initLocalMac();
+  });
+  pendingPortMapping_ = std::async(std::launch::async, [this] {
+    StartupProfiler::Scope phase("wedge_create_port_mapping");
+    return createPortMapping();
+  });
+
+  auto config = [&] {
+    StartupProfiler::Scope phase("wedge_load_sdk_config");
+    return loadConfig();
+  }();
+  {
+    StartupProfiler::Scope phase("bcm_api_init");
+    BcmAPI::init(config);
+  }
+  localMac.get();
   auto mode = getMode();
   bool isLc = (mode == WedgePlatformMode::GALAXY_LC);
   bool isMinipackFsw = (mode == WedgePlatformMode::MINIPACK);
@@ -66,7 +83,11 @@ void WedgePlatform::init() {
 WedgePlatform::~WedgePlatform() {}
 
 WedgePlatform::InitPortMap WedgePlatform::initPorts() {
-  portMapping_ = createPortMapping();
+  if (pendingPortMapping_.valid()) {
+    portMapping_ = pendingPortMapping_.get();
+  } else {
+    portMapping_ = createPortMapping();
+  }
 
   InitPortMap mapping;
   for (const auto& kv: *portMapping_) {
@@ -80,6 +101,10 @@ void WedgePlatform::onHwInitialized(SwSwitch* sw) {
   // could populate with initial ports here, but should get taken care
   // of through state changes sent to the stateUpdated method.
   initLEDs();
+  qsfpCache_->setTransceiversChangedCallback(
+      [sw](const std::vector<TransceiverID>& tcvrs) {
+        sw->transceiversChanged(tcvrs);
+      });
   qsfpCache_->init(sw->getQsfpCacheEvb());
   sw->registerStateObserver(this, "WedgePlatform");
 }
@@ -20,6 +20,7 @@
 #include <folly/MacAddress.h>
 #include <folly/Range.h>
 #include <boost/container/flat_map.hpp>
+#include <future>
 #include <memory>
 #include <unordered_map>
 
@@ -109,6 +110,8 @@ class WedgePlatform : public BcmPlatform, public StateObserver {
 
   folly::MacAddress localMac_;
   std::unique_ptr<BcmSwitch> hw_;
+  // Created by init() while the SDK initializes, until initPorts() takes it
+  std::future<std::unique_ptr<WedgePortMapping>> pendingPortMapping_;
 
   const std::unique_ptr<WedgeProductInfo> productInfo_;
   const std::unique_ptr<QsfpCache> qsfpCache_;
@@ -12,6 +12,7 @@
 #include <memory>
 
 #include "fboss/agent/Platform.h"
+#include "fboss/agent/StartupProfiler.h"
 #include "fboss/agent/platforms/wedge/GalaxyLCPlatform.h"
 #include "fboss/agent/platforms/wedge/GalaxyFCPlatform.h"
 #include "fboss/agent/platforms/wedge/WedgePlatform.h"
@@ -26,7 +27,11 @@ namespace facebook { namespace fboss {
 
 std::unique_ptr<WedgePlatform> chooseWedgePlatform() {
   auto productInfo = std::make_unique<WedgeProductInfo>(FLAGS_fruid_filepath);
-  productInfo->initialize();
+  {
+    // Not in parallel with the rest, which depends on the product
+    StartupProfiler::Scope phase("wedge_product_info");
+    productInfo->initialize();
+  }
 
   auto mode = productInfo->getMode();
   if (mode == WedgePlatformMode::WEDGE100) {
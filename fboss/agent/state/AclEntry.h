@@ -274,6 +274,10 @@ class AclEntry :
     return getFields()->priority;
   }
 
+  void setPriority(int priority) {
+    writableFields()->priority = priority;
+  }
+
   const std::string& getID() const {
     return getFields()->name;
   }
@@ -16,7 +16,7 @@
 
 namespace facebook { namespace fboss {
 
-using AclMapTraits = NodeMapTraits<std::string, AclEntry>;
+using AclMapTraits = PersistentNodeMapTraits<std::string, AclEntry>;
 /*
  * A container for the set of entries.
  */
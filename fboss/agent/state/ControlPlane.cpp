@@ -16,10 +16,43 @@
 namespace {
 constexpr auto kQueues = "queues";
 constexpr auto kRxReasonToQueue = "rxReasonToQueue";
+constexpr auto kSoftwarePolicers = "softwarePolicers";
+constexpr auto kName = "name";
+constexpr auto kEtherType = "etherType";
+constexpr auto kIpProtocol = "ipProtocol";
+constexpr auto kPort = "port";
+constexpr auto kPacketsPerSec = "packetsPerSec";
+constexpr auto kBurstSize = "burstSize";
+constexpr auto kMinPacketsPerSec = "minPacketsPerSec";
+constexpr auto kMaxPacketsPerSec = "maxPacketsPerSec";
+constexpr auto kTunedPacketsPerSec = "tunedPacketsPerSec";
+constexpr auto kIcmpErrorRateLimit = "icmpErrorRateLimit";
+constexpr auto kPerSourcePacketsPerSec = "perSourcePacketsPerSec";
+constexpr auto kPerSourceBurstSize = "perSourceBurstSize";
+constexpr auto kV4SourcePrefixLength = "v4SourcePrefixLength";
+constexpr auto kV6SourcePrefixLength = "v6SourcePrefixLength";
 }
 
 namespace facebook { namespace fboss {
 
+bool CPUSoftwarePolicer::operator==(const CPUSoftwarePolicer& other) const {
+  return name == other.name && etherType == other.etherType &&
+      ipProtocol == other.ipProtocol && port == other.port &&
+      packetsPerSec == other.packetsPerSec && burstSize == other.burstSize &&
+      minPacketsPerSec == other.minPacketsPerSec &&
+      maxPacketsPerSec == other.maxPacketsPerSec &&
+      tunedPacketsPerSec == other.tunedPacketsPerSec;
+}
+
+bool IcmpErrorRateLimit::operator==(const IcmpErrorRateLimit& other) const {
+  return packetsPerSec == other.packetsPerSec &&
+      burstSize == other.burstSize &&
+      perSourcePacketsPerSec == other.perSourcePacketsPerSec &&
+      perSourceBurstSize == other.perSourceBurstSize &&
+      v4SourcePrefixLength == other.v4SourcePrefixLength &&
+      v6SourcePrefixLength == other.v6SourcePrefixLength;
+}
+
 folly::dynamic ControlPlaneFields::toFollyDynamic() const {
   folly::dynamic controlPlane = folly::dynamic::object;
   controlPlane[kQueues] = folly::dynamic::array;
@@ -34,6 +67,39 @@ folly::dynamic ControlPlaneFields::toFollyDynamic() const {
     CHECK(reason != cfg::_PacketRxReason_VALUES_TO_NAMES.end());
     controlPlane[kRxReasonToQueue][reason->second] = reasonToQueue.second;
   }
+  controlPlane[kSoftwarePolicers] = folly::dynamic::array;
+  for (const auto& policer : softwarePolicers) {
+    folly::dynamic policerJson = folly::dynamic::object;
+    policerJson[kName] = policer.name;
+    policerJson[kEtherType] = policer.etherType;
+    if (policer.ipProtocol) {
+      policerJson[kIpProtocol] = *policer.ipProtocol;
+    }
+    if (policer.port) {
+      policerJson[kPort] = static_cast<uint16_t>(*policer.port);
+    }
+    policerJson[kPacketsPerSec] = policer.packetsPerSec;
+    policerJson[kBurstSize] = policer.burstSize;
+    policerJson[kMinPacketsPerSec] = policer.minPacketsPerSec;
+    policerJson[kMaxPacketsPerSec] = policer.maxPacketsPerSec;
+    if (policer.tunedPacketsPerSec) {
+      policerJson[kTunedPacketsPerSec] = *policer.tunedPacketsPerSec;
+    }
+    controlPlane[kSoftwarePolicers].push_back(std::move(policerJson));
+  }
+  if (icmpErrorRateLimit) {
+    folly::dynamic limitJson = folly::dynamic::object;
+    limitJson[kPacketsPerSec] = icmpErrorRateLimit->packetsPerSec;
+    limitJson[kBurstSize] = icmpErrorRateLimit->burstSize;
+    limitJson[kPerSourcePacketsPerSec] =
+        icmpErrorRateLimit->perSourcePacketsPerSec;
+    limitJson[kPerSourceBurstSize] = icmpErrorRateLimit->perSourceBurstSize;
+    limitJson[kV4SourcePrefixLength] =
+        icmpErrorRateLimit->v4SourcePrefixLength;
+    limitJson[kV6SourcePrefixLength] =
+        icmpErrorRateLimit->v6SourcePrefixLength;
+    controlPlane[kIcmpErrorRateLimit] = std::move(limitJson);
+  }
   return controlPlane;
 }
 
@@ -55,6 +121,42 @@ ControlPlaneFields ControlPlaneFields::fromFollyDynamic(
                                   reasonToQueueJson.second.asInt());
     }
   }
+  if (json.find(kSoftwarePolicers) != json.items().end()) {
+    for (const auto& policerJson : json[kSoftwarePolicers]) {
+      CPUSoftwarePolicer policer;
+      policer.name = policerJson[kName].asString();
+      policer.etherType = policerJson[kEtherType].asInt();
+      if (policerJson.find(kIpProtocol) != policerJson.items().end()) {
+        policer.ipProtocol = policerJson[kIpProtocol].asInt();
+      }
+      if (policerJson.find(kPort) != policerJson.items().end()) {
+        policer.port = PortID(policerJson[kPort].asInt());
+      }
+      policer.packetsPerSec = policerJson[kPacketsPerSec].asInt();
+      policer.burstSize = policerJson[kBurstSize].asInt();
+      // Policers from before tuning was added are never tuned
+      policer.minPacketsPerSec = policerJson.getDefault(
+          kMinPacketsPerSec, policer.packetsPerSec).asInt();
+      policer.maxPacketsPerSec = policerJson.getDefault(
+          kMaxPacketsPerSec, policer.packetsPerSec).asInt();
+      if (policerJson.find(kTunedPacketsPerSec) !=
+          policerJson.items().end()) {
+        policer.tunedPacketsPerSec = policerJson[kTunedPacketsPerSec].asInt();
+      }
+      controlPlane.softwarePolicers.push_back(std::move(policer));
+    }
+  }
+  if (json.find(kIcmpErrorRateLimit) != json.items().end()) {
+    const auto& limitJson = json[kIcmpErrorRateLimit];
+    IcmpErrorRateLimit limit;
+    limit.packetsPerSec = limitJson[kPacketsPerSec].asInt();
+    limit.burstSize = limitJson[kBurstSize].asInt();
+    limit.perSourcePacketsPerSec = limitJson[kPerSourcePacketsPerSec].asInt();
+    limit.perSourceBurstSize = limitJson[kPerSourceBurstSize].asInt();
+    limit.v4SourcePrefixLength = limitJson[kV4SourcePrefixLength].asInt();
+    limit.v6SourcePrefixLength = limitJson[kV6SourcePrefixLength].asInt();
+    controlPlane.icmpErrorRateLimit = limit;
+  }
   return controlPlane;
 }
 
@@ -88,7 +190,10 @@ bool ControlPlane::operator==(const ControlPlane& controlPlane) const {
   };
 
   return compareQueues(getFields()->queues, controlPlane.getQueues()) &&
-         getFields()->rxReasonToQueue == controlPlane.getRxReasonToQueue();
+         getFields()->rxReasonToQueue == controlPlane.getRxReasonToQueue() &&
+         getFields()->softwarePolicers == controlPlane.getSoftwarePolicers() &&
+         getFields()->icmpErrorRateLimit ==
+             controlPlane.getIcmpErrorRateLimit();
 }
 
 template class NodeBaseT<ControlPlane, ControlPlaneFields>;
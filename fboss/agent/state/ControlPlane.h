@@ -14,6 +14,8 @@
 #include "fboss/agent/state/NodeBase.h"
 
 #include <boost/container/flat_map.hpp>
+#include <folly/Optional.h>
+#include <string>
 #include <vector>
 
 namespace facebook { namespace fboss {
@@ -21,10 +23,59 @@ namespace facebook { namespace fboss {
 class PortQueue;
 class SwitchState;
 
+/*
+ * A software rate limit for trapped packets, see cfg::CPUSoftwarePolicer.
+ */
+struct CPUSoftwarePolicer {
+  std::string name;
+  uint16_t etherType{0};
+  folly::Optional<uint8_t> ipProtocol;
+  folly::Optional<PortID> port;
+  uint32_t packetsPerSec{0};
+  uint32_t burstSize{1};
+  // The bounds the rate may be tuned within, both packetsPerSec if it isn't
+  // tuned
+  uint32_t minPacketsPerSec{0};
+  uint32_t maxPacketsPerSec{0};
+  // The rate tuned to from the CPU load, if it differs from packetsPerSec
+  folly::Optional<uint32_t> tunedPacketsPerSec;
+
+  bool isTuned() const {
+    return minPacketsPerSec < maxPacketsPerSec;
+  }
+  // The rate the policer admits packets at
+  uint32_t currentPacketsPerSec() const {
+    return tunedPacketsPerSec.value_or(packetsPerSec);
+  }
+
+  bool operator==(const CPUSoftwarePolicer& other) const;
+  bool operator!=(const CPUSoftwarePolicer& other) const {
+    return !(*this == other);
+  }
+};
+
+/*
+ * A limit on the ICMP errors sent in software, see cfg::IcmpErrorRateLimit.
+ */
+struct IcmpErrorRateLimit {
+  uint32_t packetsPerSec{0};
+  uint32_t burstSize{1};
+  uint32_t perSourcePacketsPerSec{0};
+  uint32_t perSourceBurstSize{1};
+  uint8_t v4SourcePrefixLength{24};
+  uint8_t v6SourcePrefixLength{64};
+
+  bool operator==(const IcmpErrorRateLimit& other) const;
+  bool operator!=(const IcmpErrorRateLimit& other) const {
+    return !(*this == other);
+  }
+};
+
 struct ControlPlaneFields {
   using CPUQueueConfig = std::vector<std::shared_ptr<PortQueue>>;
   using RxReasonToQueue =
     boost::container::flat_map<cfg::PacketRxReason, uint8_t>;
+  using SoftwarePolicers = std::vector<CPUSoftwarePolicer>;
 
   ControlPlaneFields() {}
 
@@ -36,6 +87,8 @@ struct ControlPlaneFields {
 
   CPUQueueConfig queues;
   RxReasonToQueue rxReasonToQueue;
+  SoftwarePolicers softwarePolicers;
+  folly::Optional<IcmpErrorRateLimit> icmpErrorRateLimit;
 };
 
 /*
@@ -46,6 +99,7 @@ class ControlPlane : public NodeBaseT<ControlPlane, ControlPlaneFields> {
 public:
   using CPUQueueConfig = ControlPlaneFields::CPUQueueConfig;
   using RxReasonToQueue = ControlPlaneFields::RxReasonToQueue;
+  using SoftwarePolicers = ControlPlaneFields::SoftwarePolicers;
 
   ControlPlane() {}
 
@@ -73,6 +127,20 @@ public:
     writableFields()->rxReasonToQueue.swap(rxReasonToQueue);
   }
 
+  const SoftwarePolicers& getSoftwarePolicers() const {
+    return getFields()->softwarePolicers;
+  }
+  void resetSoftwarePolicers(SoftwarePolicers policers) {
+    writableFields()->softwarePolicers.swap(policers);
+  }
+
+  const folly::Optional<IcmpErrorRateLimit>& getIcmpErrorRateLimit() const {
+    return getFields()->icmpErrorRateLimit;
+  }
+  void setIcmpErrorRateLimit(folly::Optional<IcmpErrorRateLimit> limit) {
+    writableFields()->icmpErrorRateLimit = std::move(limit);
+  }
+
   ControlPlane* modify(std::shared_ptr<SwitchState>* state);
 
   bool operator==(const ControlPlane& controlPlane) const;
@@ -26,6 +26,10 @@ InterfaceMap::~InterfaceMap() {
 
 std::shared_ptr<Interface>
 InterfaceMap::getInterfaceIf(RouterID router, const IPAddress& ip) const {
+  if (addressIndex_) {
+    auto intf = lookupAddress(router, ip);
+    return intf ? *intf : nullptr;
+  }
   for (auto itr = begin(); itr != end(); ++itr) {
     if ((*itr)->getRouterID() == router && (*itr)->hasAddress(ip)) {
       return *itr;
@@ -36,9 +40,16 @@ InterfaceMap::getInterfaceIf(RouterID router, const IPAddress& ip) const {
 
 const std::shared_ptr<Interface>&
 InterfaceMap::getInterface(RouterID router, const IPAddress& ip) const {
-  for (auto itr = begin(); itr != end(); ++itr) {
-    if ((*itr)->getRouterID() == router && (*itr)->hasAddress(ip)) {
-      return *itr;
+  if (addressIndex_) {
+    auto intf = lookupAddress(router, ip);
+    if (intf) {
+      return *intf;
+    }
+  } else {
+    for (auto itr = begin(); itr != end(); ++itr) {
+      if ((*itr)->getRouterID() == router && (*itr)->hasAddress(ip)) {
+        return *itr;
+      }
     }
   }
   throw FbossError("No interface with ip : ", ip);
@@ -65,16 +76,78 @@ InterfaceMap::getInterfaceInVlan(VlanID vlan) const {
 
 InterfaceMap::IntfAddrToReach InterfaceMap::getIntfAddrToReach(
     RouterID router, const folly::IPAddress& dest) const {
-  for (auto iter = begin(); iter != end(); iter++) {
-    const auto& intf = *iter;
-    if (intf->getRouterID() == router) {
-      auto addrIter = intf->getAddressToReach(dest);
-      if (addrIter != intf->getAddresses().end()) {
-        return IntfAddrToReach(intf.get(), &addrIter->first, addrIter->second);
+  if (addressIndex_) {
+    auto it = addressIndex_->find(router);
+    if (it != addressIndex_->end()) {
+      const auto& routerAddrs = it->second;
+      if (dest.isV4()) {
+        auto match = routerAddrs.subnetsV4.longestMatch(
+            dest.asV4(), folly::IPAddressV4::bitCount());
+        if (match != routerAddrs.subnetsV4.end()) {
+          return match.value();
+        }
+      } else {
+        auto match = routerAddrs.subnetsV6.longestMatch(
+            dest.asV6(), folly::IPAddressV6::bitCount());
+        if (match != routerAddrs.subnetsV6.end()) {
+          return match.value();
+        }
       }
     }
+    return IntfAddrToReach(nullptr, nullptr, 0);
+  }
+  // Without the index every subnet is gone over, for the longest
+  IntfAddrToReach best(nullptr, nullptr, 0);
+  for (const auto& intf : *this) {
+    if (intf->getRouterID() != router) {
+      continue;
+    }
+    for (const auto& addr : intf->getAddresses()) {
+      if ((!best.intf || addr.second > best.mask) &&
+          dest.inSubnet(addr.first, addr.second)) {
+        best = IntfAddrToReach(intf.get(), &addr.first, addr.second);
+      }
+    }
+  }
+  return best;
+}
+
+void InterfaceMap::publish() {
+  if (isPublished()) {
+    return;
+  }
+  addressIndex_ = buildAddressIndex();
+  NodeMapT::publish();
+}
+
+std::unique_ptr<InterfaceMap::AddressIndex>
+InterfaceMap::buildAddressIndex() const {
+  auto index = std::make_unique<AddressIndex>();
+  // The interfaces are gone over in order, and only the first one with an
+  // address or subnet is kept, as the scan over the interfaces would find
+  for (const auto& intf : *this) {
+    auto& routerAddrs = (*index)[intf->getRouterID()];
+    for (const auto& addr : intf->getAddresses()) {
+      routerAddrs.addresses.emplace(addr.first, intf);
+      IntfAddrToReach reach(intf.get(), &addr.first, addr.second);
+      if (addr.first.isV4()) {
+        routerAddrs.subnetsV4.insert(addr.first.asV4(), addr.second, reach);
+      } else {
+        routerAddrs.subnetsV6.insert(addr.first.asV6(), addr.second, reach);
+      }
+    }
+  }
+  return index;
+}
+
+const std::shared_ptr<Interface>* InterfaceMap::lookupAddress(
+    RouterID router, const IPAddress& ip) const {
+  auto it = addressIndex_->find(router);
+  if (it == addressIndex_->end()) {
+    return nullptr;
   }
-  return IntfAddrToReach(nullptr, nullptr, 0);
+  auto addr = it->second.addresses.find(ip);
+  return addr == it->second.addresses.end() ? nullptr : &addr->second;
 }
 
 void InterfaceMap::addInterface(const std::shared_ptr<Interface>& interface) {
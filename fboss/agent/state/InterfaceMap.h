@@ -8,10 +8,14 @@
  *
  */
 #pragma once
+#include <map>
+#include <memory>
+#include <unordered_map>
 #include <vector>
 #include <folly/IPAddress.h>
 #include "fboss/agent/types.h"
 #include "fboss/agent/state/NodeMap.h"
+#include "fboss/lib/RadixTree.h"
 namespace facebook { namespace fboss {
 
 class Interface;
@@ -47,6 +51,10 @@ class InterfaceMap : public NodeMapT<InterfaceMap, InterfaceMapTraits> {
    *  interfaces have the same address (unlikely) we return the
    *  first one. If no interface is found that has the given IP,
    *  we return null.
+   *
+   *  Once the map is published this, getInterface() and
+   *  getIntfAddrToReach() look the address up in an index of the
+   *  addresses of each router, rather than going over every interface.
    */
   std::shared_ptr<Interface> getInterfaceIf(
       RouterID router, const folly::IPAddress& ip) const;
@@ -83,7 +91,9 @@ class InterfaceMap : public NodeMapT<InterfaceMap, InterfaceMapTraits> {
   };
 
   /*
-   * Find an interface with its address to reach the given destination
+   * Find an interface with its address to reach the given destination.  If
+   * several connected subnets have it, the longest one is used; if several
+   * interfaces have that subnet, the first one.
    */
   IntfAddrToReach getIntfAddrToReach(
       RouterID router, const folly::IPAddress& dest) const;
@@ -97,6 +107,11 @@ class InterfaceMap : public NodeMapT<InterfaceMap, InterfaceMapTraits> {
 
   void addInterface(const std::shared_ptr<Interface>& interface);
 
+  /*
+   * Builds the address index, before the map is shared between threads.
+   */
+  void publish() override;
+
   /*
    * Serialize to a folly::dynamic object
    */
@@ -113,9 +128,32 @@ class InterfaceMap : public NodeMapT<InterfaceMap, InterfaceMapTraits> {
   }
 
  private:
+  /*
+   * The addresses of the interfaces of a router, by address for the
+   * interface IPs and by longest prefix match for the connected subnets.
+   */
+  struct RouterAddresses {
+    std::unordered_map<folly::IPAddress, std::shared_ptr<Interface>>
+      addresses;
+    facebook::network::RadixTree<folly::IPAddressV4, IntfAddrToReach>
+      subnetsV4;
+    facebook::network::RadixTree<folly::IPAddressV6, IntfAddrToReach>
+      subnetsV6;
+  };
+  typedef std::map<RouterID, RouterAddresses> AddressIndex;
+
+  std::unique_ptr<AddressIndex> buildAddressIndex() const;
+  const std::shared_ptr<Interface>* lookupAddress(
+      RouterID router, const folly::IPAddress& ip) const;
+
   // Inherit the constructors required for clone()
   using NodeMapT::NodeMapT;
   friend class CloneAllocator;
+
+  // Only set once published, when the interfaces can no longer change.
+  // States that share the map share its index; clones start without one,
+  // and build their own when published.
+  std::unique_ptr<const AddressIndex> addressIndex_;
 };
 
 }} // facebook::fboss
@@ -0,0 +1,40 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "fboss/agent/state/MacEntry.h"
+#include "fboss/agent/state/NodeBase-defs.h"
+
+namespace {
+constexpr auto kMac = "mac";
+constexpr auto kPort = "portId";
+}
+
+namespace facebook { namespace fboss {
+
+folly::dynamic MacEntryFields::toFollyDynamic() const {
+  folly::dynamic entry = folly::dynamic::object;
+  entry[kMac] = mac.toString();
+  entry[kPort] = port.toFollyDynamic();
+  return entry;
+}
+
+MacEntryFields MacEntryFields::fromFollyDynamic(
+    const folly::dynamic& entryJson) {
+  return MacEntryFields(
+      folly::MacAddress(entryJson[kMac].stringPiece()),
+      PortDescriptor::fromFollyDynamic(entryJson[kPort]));
+}
+
+MacEntry::MacEntry(folly::MacAddress mac, PortDescriptor port)
+    : NodeBaseT(mac, port) {
+}
+
+template class NodeBaseT<MacEntry, MacEntryFields>;
+
+}} // facebook::fboss
@@ -0,0 +1,77 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#pragma once
+
+#include <folly/MacAddress.h>
+
+#include "fboss/agent/state/NodeBase.h"
+#include "fboss/agent/state/PortDescriptor.h"
+#include "fboss/agent/types.h"
+
+namespace facebook { namespace fboss {
+
+struct MacEntryFields {
+  MacEntryFields(folly::MacAddress mac, PortDescriptor port)
+      : mac(mac), port(port) {}
+
+  template<typename Fn>
+  void forEachChild(Fn) {}
+
+  folly::dynamic toFollyDynamic() const;
+  static MacEntryFields fromFollyDynamic(const folly::dynamic& json);
+
+  const folly::MacAddress mac;
+  PortDescriptor port;
+};
+
+/*
+ * MacEntry is a MAC address learned on a VLAN, and the port it was learned
+ * on.
+ */
+class MacEntry : public NodeBaseT<MacEntry, MacEntryFields> {
+ public:
+  MacEntry(folly::MacAddress mac, PortDescriptor port);
+
+  static std::shared_ptr<MacEntry>
+  fromFollyDynamic(const folly::dynamic& json) {
+    const auto& fields = MacEntryFields::fromFollyDynamic(json);
+    return std::make_shared<MacEntry>(fields);
+  }
+
+  static std::shared_ptr<MacEntry>
+  fromJson(const folly::fbstring& jsonStr) {
+    return fromFollyDynamic(folly::parseJson(jsonStr));
+  }
+
+  folly::dynamic toFollyDynamic() const override {
+    return getFields()->toFollyDynamic();
+  }
+
+  folly::MacAddress getID() const {
+    return getFields()->mac;
+  }
+  folly::MacAddress getMac() const {
+    return getFields()->mac;
+  }
+
+  PortDescriptor getPort() const {
+    return getFields()->port;
+  }
+  void setPort(PortDescriptor port) {
+    writableFields()->port = port;
+  }
+
+ private:
+  // Inherit the constructors required for clone()
+  using NodeBaseT::NodeBaseT;
+  friend class CloneAllocator;
+};
+
+}} // facebook::fboss
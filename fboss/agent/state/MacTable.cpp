@@ -0,0 +1,39 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "fboss/agent/state/MacTable.h"
+
+#include "fboss/agent/state/NodeMap-defs.h"
+#include "fboss/agent/state/SwitchState.h"
+#include "fboss/agent/state/Vlan.h"
+
+namespace facebook { namespace fboss {
+
+MacTable::MacTable() {
+}
+
+MacTable::~MacTable() {
+}
+
+MacTable* MacTable::modify(Vlan** vlan, std::shared_ptr<SwitchState>* state) {
+  if (!isPublished()) {
+    CHECK(!(*state)->isPublished());
+    return this;
+  }
+
+  *vlan = (*vlan)->modify(state);
+  auto newTable = clone();
+  auto* ptr = newTable.get();
+  (*vlan)->setMacTable(std::move(newTable));
+  return ptr;
+}
+
+FBOSS_INSTANTIATE_NODE_MAP(MacTable, MacTableTraits);
+
+}} // facebook::fboss
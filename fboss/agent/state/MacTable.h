@@ -0,0 +1,65 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#pragma once
+
+#include "fboss/agent/state/MacEntry.h"
+#include "fboss/agent/state/NodeMap.h"
+#include "fboss/agent/types.h"
+
+namespace facebook { namespace fboss {
+
+class SwitchState;
+class Vlan;
+
+using MacTableTraits = PersistentNodeMapTraits<folly::MacAddress, MacEntry>;
+
+/*
+ * The MAC addresses learned on a VLAN, with software MAC learning.
+ *
+ * The entries are stored in a PersistentNodeContainer, so a batch of
+ * learned MACs only copies the chunks of the table it touches.
+ */
+class MacTable : public NodeMapT<MacTable, MacTableTraits> {
+ public:
+  MacTable();
+  ~MacTable() override;
+
+  const std::shared_ptr<MacEntry>& getMac(folly::MacAddress mac) const {
+    return getNode(mac);
+  }
+  std::shared_ptr<MacEntry> getMacIf(folly::MacAddress mac) const {
+    return getNodeIf(mac);
+  }
+
+  MacTable* modify(Vlan** vlan, std::shared_ptr<SwitchState>* state);
+
+  /*
+   * The following functions modify the static state.
+   * These should only be called on unpublished objects which are only visible
+   * to a single thread.
+   */
+
+  void addEntry(const std::shared_ptr<MacEntry>& macEntry) {
+    addNode(macEntry);
+  }
+  void updateEntry(const std::shared_ptr<MacEntry>& macEntry) {
+    updateNode(macEntry);
+  }
+  void removeEntry(folly::MacAddress mac) {
+    removeNode(mac);
+  }
+
+ private:
+  // Inherit the constructors required for clone()
+  using NodeMapT::NodeMapT;
+  friend class CloneAllocator;
+};
+
+}} // facebook::fboss
@@ -17,7 +17,8 @@ namespace facebook { namespace fboss {
 
 using folly::MacAddress;
 
-enum class NeighborState { UNVERIFIED, PENDING, REACHABLE };
+// A byte, so that it packs into the padding after the port of an entry
+enum class NeighborState : uint8_t { UNVERIFIED, PENDING, REACHABLE };
 
 template<typename IPADDR>
 struct NeighborEntryFields {
@@ -29,7 +30,7 @@ struct NeighborEntryFields {
       PortDescriptor port,
       InterfaceID interfaceID,
       NeighborState state = NeighborState::REACHABLE)
-      : ip(ip), mac(mac), port(port), interfaceID(interfaceID), state(state) {}
+      : ip(ip), mac(mac), port(port), state(state), interfaceID(interfaceID) {}
 
   NeighborEntryFields(
       AddressType ip,
@@ -61,11 +62,13 @@ struct NeighborEntryFields {
   static constexpr auto kMac = "mac";
   static constexpr auto kPort = "portId";
   static constexpr auto kInterface = "interfaceId";
+  // Ordered so that the state fills the padding between the port and the
+  // interface, since there are tens of thousands of these alive per table.
   AddressType ip;
   folly::MacAddress mac;
   PortDescriptor port;
-  InterfaceID interfaceID;
   NeighborState state;
+  InterfaceID interfaceID;
 };
 
 template<typename IPADDR, typename SUBCLASS>
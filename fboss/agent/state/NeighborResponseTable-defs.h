@@ -40,4 +40,13 @@ NeighborResponseTable<IPADDR, SUBCLASS>::NeighborResponseTable(Table table)
   : Parent(std::move(table)) {
 }
 
+template<typename IPADDR, typename SUBCLASS>
+void NeighborResponseTable<IPADDR, SUBCLASS>::publish() {
+  if (this->isPublished()) {
+    return;
+  }
+  index_ = std::make_unique<NeighborResponseIndex<IPADDR>>(getTable());
+  Parent::publish();
+}
+
 }} // facebook::fboss
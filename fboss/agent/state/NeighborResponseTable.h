@@ -15,6 +15,10 @@
 
 #include <boost/container/flat_map.hpp>
 
+#include <functional>
+#include <memory>
+#include <vector>
+
 namespace facebook { namespace fboss {
 
 struct NeighborResponseEntry {
@@ -45,6 +49,55 @@ struct NeighborResponseEntry {
   InterfaceID interfaceID{0};
 };
 
+/*
+ * An open addressing hash of the entries of a NeighborResponseTable, with
+ * linear probing.  It is kept at most half full, so that looking up an
+ * address, as for every ARP request and neighbor solicitation received,
+ * mostly takes a single probe.
+ */
+template<typename IPADDR>
+class NeighborResponseIndex {
+ public:
+  template<typename Table>
+  explicit NeighborResponseIndex(const Table& table) {
+    size_t numSlots = 1;
+    while (numSlots < table.size() * 2) {
+      numSlots <<= 1;
+    }
+    slots_.resize(numSlots);
+    mask_ = numSlots - 1;
+    for (const auto& entry : table) {
+      auto slot = std::hash<IPADDR>()(entry.first) & mask_;
+      while (slots_[slot].used) {
+        slot = (slot + 1) & mask_;
+      }
+      slots_[slot].ip = entry.first;
+      slots_[slot].entry = entry.second;
+      slots_[slot].used = true;
+    }
+  }
+
+  const NeighborResponseEntry* find(const IPADDR& ip) const {
+    // There is always an unused slot to stop at
+    for (auto slot = std::hash<IPADDR>()(ip) & mask_; slots_[slot].used;
+         slot = (slot + 1) & mask_) {
+      if (slots_[slot].ip == ip) {
+        return &slots_[slot].entry;
+      }
+    }
+    return nullptr;
+  }
+
+ private:
+  struct Slot {
+    IPADDR ip;
+    NeighborResponseEntry entry;
+    bool used{false};
+  };
+  std::vector<Slot> slots_;
+  size_t mask_{0};
+};
+
 template<typename IPADDR>
 struct NeighborResponseTableFields {
   typedef IPADDR AddressType;
@@ -106,7 +159,12 @@ class NeighborResponseTable
     return this->getFields()->toFollyDynamic();
   }
 
-  folly::Optional<NeighborResponseEntry> getEntry(AddressType ip) {
+  folly::Optional<NeighborResponseEntry> getEntry(AddressType ip) const {
+    if (index_) {
+      auto entry = index_->find(ip);
+      return entry ? folly::Optional<NeighborResponseEntry>(*entry)
+                   : folly::Optional<NeighborResponseEntry>();
+    }
     const auto& table = getTable();
     auto it = table.find(ip);
     if (it == table.end()) {
@@ -135,11 +193,20 @@ class NeighborResponseTable
     entry.interfaceID = intfID;
   }
 
+  /*
+   * Builds the hash looked up by getEntry(), as the table can no longer
+   * change.
+   */
+  void publish() override;
+
  private:
   // Inherit the constructors required for clone()
   typedef NodeBaseT<SUBCLASS, NeighborResponseTableFields<IPADDR>> Parent;
   using Parent::Parent;
   friend class CloneAllocator;
+
+  // Only set once published.  Clones start without one.
+  std::unique_ptr<const NeighborResponseIndex<IPADDR>> index_;
 };
 
 }} // facebook::fboss
@@ -13,6 +13,7 @@
 #include <folly/dynamic.h>
 #include <folly/json.h>
 #include "fboss/agent/state/NeighborEntry.h"
+#include "fboss/agent/state/NodeAllocator.h"
 #include "fboss/agent/state/NodeMap.h"
 #include "fboss/agent/state/PortDescriptor.h"
 
@@ -30,6 +31,8 @@ struct NeighborTableTraits {
   typedef IPADDR KeyType;
   typedef ENTRY Node;
   typedef NodeMapNoExtraFields ExtraFields;
+  typedef PersistentNodeContainer<IPADDR, std::shared_ptr<ENTRY>>
+    NodeContainer;
 
   static KeyType getKey(const std::shared_ptr<Node>& entry) {
     return entry->getIP();
@@ -39,12 +42,9 @@ struct NeighborTableTraits {
 /*
  * A map of IP --> MAC for the IP addresses of other nodes on a VLAN.
  *
- * TODO: We should switch from NodeMap to PrefixMap when the new PrefixMap
- * implementation is ready.
- *
- * Any change to a NodeMap is O(N), so it is really only suitable for small
- * maps that do not change frequently.  Our new PrefixMap implementation will
- * allow us to perform cheaper copy-on-write updates.
+ * The entries are stored in a PersistentNodeContainer, so cloning the table
+ * to update a single neighbor only copies the chunk holding that neighbor
+ * rather than the whole table.
  */
 template<typename IPADDR, typename ENTRY, typename SUBCLASS>
 class NeighborTable
@@ -90,6 +90,18 @@ class NeighborTable
 
   void removeEntry(AddressType ip);
 
+  /*
+   * The approximate number of bytes each entry takes up: the pooled block
+   * holding the entry alongside its shared_ptr control block, plus its slot
+   * in the container.  Unmodified entries, and the chunks of slots holding
+   * them, are shared with the older generations of the table.
+   */
+  static constexpr size_t bytesPerEntry() {
+    return NodePool::roundedSize(sizeof(Entry) + 2 * sizeof(void*)) +
+        sizeof(typename NeighborTableTraits<IPADDR, ENTRY>::NodeContainer::
+                   value_type);
+  }
+
  private:
   typedef NodeMapT<SUBCLASS, NeighborTableTraits<IPADDR, ENTRY>> Parent;
   // Inherit the constructors required for clone()
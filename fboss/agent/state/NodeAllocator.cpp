@@ -0,0 +1,171 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "fboss/agent/state/NodeAllocator.h"
+
+#include <array>
+#include <map>
+#include <memory>
+#include <mutex>
+
+#include <folly/Demangle.h>
+#include <folly/SpinLock.h>
+#include <gflags/gflags.h>
+
+DEFINE_bool(pool_state_nodes, true,
+            "Recycle the memory of destroyed SwitchState nodes for new "
+            "clones instead of returning it to malloc");
+DEFINE_int32(state_node_pool_max_blocks, 65536,
+             "Maximum number of free blocks cached per node size class");
+
+namespace {
+
+using facebook::fboss::NodeAllocationCounters;
+using facebook::fboss::NodePool;
+
+struct FreeBlock {
+  FreeBlock* next;
+};
+
+struct SizeClass {
+  folly::SpinLock lock;
+  FreeBlock* head{nullptr};
+  int32_t numBlocks{0};
+};
+
+// These are intentionally leaked, since nodes may still be destroyed from
+// static destructors after they would otherwise have been torn down.
+std::array<SizeClass, NodePool::kNumSizeClasses>& sizeClasses() {
+  static auto* classes =
+    new std::array<SizeClass, NodePool::kNumSizeClasses>();
+  return *classes;
+}
+
+struct TypeRegistry {
+  std::mutex lock;
+  std::map<std::string, std::unique_ptr<NodeAllocationCounters>> types;
+};
+
+TypeRegistry& typeRegistry() {
+  static auto* registry = new TypeRegistry();
+  return *registry;
+}
+
+std::atomic<uint64_t> poolCachedBytes{0};
+
+size_t sizeClassIndex(size_t rounded) {
+  return rounded / NodePool::kGranularity - 1;
+}
+
+}
+
+namespace facebook { namespace fboss {
+
+constexpr size_t NodePool::kGranularity;
+constexpr size_t NodePool::kMaxPooledSize;
+constexpr size_t NodePool::kNumSizeClasses;
+
+void* NodePool::allocate(size_t size) {
+  auto rounded = roundedSize(size);
+  if (rounded > kMaxPooledSize || rounded == 0) {
+    return ::operator new(size);
+  }
+  if (FLAGS_pool_state_nodes) {
+    auto& sizeClass = sizeClasses()[sizeClassIndex(rounded)];
+    folly::SpinLockGuard guard(sizeClass.lock);
+    if (sizeClass.head) {
+      auto* block = sizeClass.head;
+      sizeClass.head = block->next;
+      --sizeClass.numBlocks;
+      poolCachedBytes.fetch_sub(rounded, std::memory_order_relaxed);
+      return block;
+    }
+  }
+  return ::operator new(rounded);
+}
+
+void NodePool::deallocate(void* ptr, size_t size) noexcept {
+  auto rounded = roundedSize(size);
+  if (rounded > kMaxPooledSize || rounded == 0 || !FLAGS_pool_state_nodes) {
+    ::operator delete(ptr);
+    return;
+  }
+  auto& sizeClass = sizeClasses()[sizeClassIndex(rounded)];
+  {
+    folly::SpinLockGuard guard(sizeClass.lock);
+    if (sizeClass.numBlocks < FLAGS_state_node_pool_max_blocks) {
+      auto* block = static_cast<FreeBlock*>(ptr);
+      block->next = sizeClass.head;
+      sizeClass.head = block;
+      ++sizeClass.numBlocks;
+      poolCachedBytes.fetch_add(rounded, std::memory_order_relaxed);
+      return;
+    }
+  }
+  ::operator delete(ptr);
+}
+
+uint64_t NodePool::cachedBytes() {
+  return poolCachedBytes.load(std::memory_order_relaxed);
+}
+
+void NodePool::trim() {
+  for (size_t i = 0; i < kNumSizeClasses; ++i) {
+    auto& sizeClass = sizeClasses()[i];
+    FreeBlock* head;
+    {
+      folly::SpinLockGuard guard(sizeClass.lock);
+      head = sizeClass.head;
+      sizeClass.head = nullptr;
+      poolCachedBytes.fetch_sub(
+          sizeClass.numBlocks * (i + 1) * kGranularity,
+          std::memory_order_relaxed);
+      sizeClass.numBlocks = 0;
+    }
+    while (head) {
+      auto* next = head->next;
+      ::operator delete(head);
+      head = next;
+    }
+  }
+}
+
+std::string NodeAllocationStats::typeName(const std::type_info& type) {
+  auto name = folly::demangle(type).toStdString();
+  // Strip our own namespace to keep the counter names short
+  static const std::string kNamespace = "facebook::fboss::";
+  if (name.compare(0, kNamespace.size(), kNamespace) == 0) {
+    name = name.substr(kNamespace.size());
+  }
+  return name;
+}
+
+NodeAllocationCounters* NodeAllocationStats::registerType(
+    const std::type_info& type) {
+  auto name = typeName(type);
+  auto& registry = typeRegistry();
+  std::lock_guard<std::mutex> g(registry.lock);
+  auto& counters = registry.types[name];
+  if (!counters) {
+    counters = std::make_unique<NodeAllocationCounters>();
+  }
+  return counters.get();
+}
+
+void NodeAllocationStats::forEach(
+    std::function<void(const std::string& name,
+                       const NodeAllocationCounters& counters)> fn) {
+  auto& registry = typeRegistry();
+  std::lock_guard<std::mutex> g(registry.lock);
+  for (const auto& entry : registry.types) {
+    fn(entry.first, *entry.second);
+  }
+}
+
+}} // facebook::fboss
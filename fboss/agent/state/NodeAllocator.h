@@ -0,0 +1,145 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <typeinfo>
+
+namespace facebook { namespace fboss {
+
+/*
+ * NodePool caches the memory for recently destroyed SwitchState nodes so that
+ * it can be handed straight back out to the next clone().
+ *
+ * Route churn destroys an old generation of nodes and clones a new one at
+ * roughly the same rate, all of the same handful of sizes.  Rather than going
+ * back to malloc for each of them, freed blocks are kept on per size-class
+ * free lists, and allocations are served from those lists first.
+ *
+ * Every pooled block is individually allocated with operator new, so a block
+ * can always be released with operator delete regardless of whether pooling
+ * was enabled when it was allocated.  The free lists are bounded, and blocks
+ * freed beyond that bound are released immediately.
+ */
+class NodePool {
+ public:
+  // Allocations are rounded up to a multiple of kGranularity bytes
+  static constexpr size_t kGranularity = 16;
+  // Allocations larger than this are not pooled
+  static constexpr size_t kMaxPooledSize = 512;
+  static constexpr size_t kNumSizeClasses = kMaxPooledSize / kGranularity;
+
+  /*
+   * The size of the block actually allocated for size bytes.
+   */
+  static constexpr size_t roundedSize(size_t size) {
+    return (size + kGranularity - 1) & ~(kGranularity - 1);
+  }
+
+  static void* allocate(size_t size);
+  static void deallocate(void* ptr, size_t size) noexcept;
+
+  /*
+   * Return the number of bytes currently held on the free lists.
+   */
+  static uint64_t cachedBytes();
+
+  /*
+   * Release all of the memory held on the free lists.
+   */
+  static void trim();
+};
+
+/*
+ * Allocation counters for a single node type.
+ */
+struct NodeAllocationCounters {
+  std::atomic<uint64_t> allocated{0};
+  std::atomic<uint64_t> freed{0};
+};
+
+class NodeAllocationStats {
+ public:
+  /*
+   * Return the counters for the specified node type.
+   */
+  template <typename NodeT>
+  static NodeAllocationCounters* forType() {
+    static NodeAllocationCounters* counters = registerType(typeid(NodeT));
+    return counters;
+  }
+
+  /*
+   * Invoke the specified function with the name and counters of every node
+   * type that has been allocated so far.
+   */
+  static void forEach(
+      std::function<void(const std::string& name,
+                         const NodeAllocationCounters& counters)> fn);
+
+  /*
+   * The name the counters of a node type are known by: its demangled name,
+   * without our own namespace.
+   */
+  static std::string typeName(const std::type_info& type);
+
+ private:
+  static NodeAllocationCounters* registerType(const std::type_info& type);
+};
+
+/*
+ * A standard allocator that draws memory from NodePool, and accounts for it
+ * in the NodeAllocationStats of NodeT.
+ *
+ * NodeT stays the same when the allocator is rebound, so the control block
+ * allocated by std::allocate_shared() is still attributed to the node type.
+ */
+template <typename T, typename NodeT = T>
+class NodePoolAllocator {
+ public:
+  using value_type = T;
+
+  template <typename U>
+  struct rebind {
+    using other = NodePoolAllocator<U, NodeT>;
+  };
+
+  NodePoolAllocator() {}
+  template <typename U>
+  /* implicit */ NodePoolAllocator(const NodePoolAllocator<U, NodeT>&) {}
+
+  T* allocate(size_t n) {
+    auto* ptr = static_cast<T*>(NodePool::allocate(n * sizeof(T)));
+    NodeAllocationStats::forType<NodeT>()->allocated.fetch_add(
+        1, std::memory_order_relaxed);
+    return ptr;
+  }
+
+  void deallocate(T* ptr, size_t n) noexcept {
+    NodePool::deallocate(ptr, n * sizeof(T));
+    NodeAllocationStats::forType<NodeT>()->freed.fetch_add(
+        1, std::memory_order_relaxed);
+  }
+
+  template <typename U>
+  bool operator==(const NodePoolAllocator<U, NodeT>&) const {
+    return true;
+  }
+  template <typename U>
+  bool operator!=(const NodePoolAllocator<U, NodeT>&) const {
+    return false;
+  }
+};
+
+}} // facebook::fboss
@@ -9,16 +9,56 @@
  */
 #include "fboss/agent/state/NodeBase.h"
 
+#include "fboss/agent/FbossError.h"
+
 #include <atomic>
 
+#include <folly/Conv.h>
+
 namespace {
 std::atomic<uint64_t> nextNodeID;
 }
 
 namespace facebook { namespace fboss {
 
+constexpr size_t NodeBase::kAllEntries;
+
 NodeBase::NodeBase()
   : nodeID_(nextNodeID.fetch_add(1, std::memory_order_relaxed)) {
 }
 
+namespace {
+// The value at path within json, which is either const or not
+template <typename DynamicT>
+DynamicT* findJsonPath(DynamicT* json, NodeBase::JsonPath path) {
+  DynamicT* current = json;
+  for (const auto& token : path) {
+    if (current->isObject()) {
+      current = current->get_ptr(token);
+    } else if (current->isArray()) {
+      auto index = folly::tryTo<size_t>(token);
+      current = (index.hasValue() && index.value() < current->size())
+          ? &(*current)[index.value()]
+          : nullptr;
+    } else {
+      current = nullptr;
+    }
+    if (!current) {
+      throw FbossError("no state found at path element \"", token, "\"");
+    }
+  }
+  return current;
+}
+} // anonymous namespace
+
+folly::dynamic NodeBase::selectJsonPath(
+    const folly::dynamic& json, JsonPath path) {
+  return *findJsonPath(&json, path);
+}
+
+void NodeBase::mergeJsonPatchAt(
+    folly::dynamic* json, JsonPath path, const folly::dynamic& patch) {
+  findJsonPath(json, path)->merge_patch(patch);
+}
+
 }} // facebook::fboss
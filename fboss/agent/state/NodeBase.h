@@ -11,18 +11,49 @@
 
 #include "fboss/agent/types.h"
 #include "fboss/agent/Utils.h"
+#include "fboss/agent/state/NodeAllocator.h"
 
 #include <boost/cast.hpp>
 #include <boost/container/flat_map.hpp>
 #include <glog/logging.h>
+#include <functional>
 #include <memory>
 #include <type_traits>
 
+#include <folly/Range.h>
 #include <folly/dynamic.h>
 #include <folly/json.h>
 
+#include <limits>
+#include <string>
+
 namespace facebook { namespace fboss {
 
+/*
+ * Receives the memory a node reports from NodeBase::accountMemory(), see
+ * StateMemoryAccounting.h.
+ */
+class NodeMemoryVisitor {
+ public:
+  virtual ~NodeMemoryVisitor() = default;
+  // Memory held by this node alone
+  virtual void ownBytes(size_t bytes) = 0;
+  // Memory that copies of the node may share, such as the chunks of a
+  // PersistentNodeContainer, counted once however many nodes hold it
+  virtual void sharedBlock(const void* block, size_t bytes) = 0;
+};
+
+namespace detail {
+template <typename FieldsT>
+auto accountFieldsMemory(
+    const FieldsT& fields, NodeMemoryVisitor* visitor, int)
+    -> decltype(fields.accountMemory(visitor)) {
+  return fields.accountMemory(visitor);
+}
+template <typename FieldsT>
+void accountFieldsMemory(const FieldsT&, NodeMemoryVisitor*, long) {}
+} // namespace detail
+
 /*
  * NodeBase is the base class for all nodes in our SwitchState tree.
  *
@@ -40,6 +71,13 @@ namespace facebook { namespace fboss {
  */
 class NodeBase {
  public:
+  /*
+   * A path into the serialized form of a node, given as the reference tokens
+   * of a JSON pointer.
+   */
+  using JsonPath = folly::Range<const std::string*>;
+  static constexpr size_t kAllEntries = std::numeric_limits<size_t>::max();
+
   virtual ~NodeBase() = default;
 
   /*
@@ -113,7 +151,32 @@ class NodeBase {
     return nodeID_;
   }
 
+  /*
+   * Report the memory this node takes to visitor, not counting the children
+   * it gives to forEachChildNode().  Only the storage the node owns
+   * directly is included, as an estimate: the children are accounted for
+   * as nodes of their own.
+   */
+  virtual void accountMemory(NodeMemoryVisitor* visitor) const {
+    visitor->ownBytes(sizeof(NodeBase));
+  }
+  virtual void forEachChildNode(
+      const std::function<void(const NodeBase*)>& /*fn*/) const {}
+
  protected:
+  /*
+   * Return the value found at path within json.  Throws FbossError if there
+   * is nothing at path.
+   */
+  static folly::dynamic selectJsonPath(
+      const folly::dynamic& json, JsonPath path);
+  /*
+   * Merge patch, as a JSON merge patch, into the value found at path within
+   * json.  Throws FbossError if there is nothing at path.
+   */
+  static void mergeJsonPatchAt(
+      folly::dynamic* json, JsonPath path, const folly::dynamic& patch);
+
   NodeBase();
   NodeBase(NodeID id, uint32_t generation)
     : nodeID_(id),
@@ -203,6 +266,25 @@ class NodeBaseT : public NodeBase {
   const Fields* getFields() const {
     return &fields_;
   }
+
+  /*
+   * Fields may define an accountMemory(NodeMemoryVisitor*) method to report
+   * the memory of their containers.
+   */
+  void accountMemory(NodeMemoryVisitor* visitor) const override {
+    visitor->ownBytes(sizeof(NodeT));
+    detail::accountFieldsMemory(fields_, visitor, 0);
+  }
+  void forEachChildNode(
+      const std::function<void(const NodeBase*)>& fn) const override {
+    // forEachChild() is not const, but only reads the child pointers
+    const_cast<Fields&>(fields_).forEachChild([&fn](const NodeBase* child) {
+      if (child) {
+        fn(child);
+      }
+    });
+  }
+
   Fields* writableFields() {
     CHECK(!isPublished());
     return &fields_;
@@ -215,6 +297,38 @@ class NodeBaseT : public NodeBase {
    */
   virtual folly::dynamic toFollyDynamic() const = 0;
 
+  /*
+   * Serialize only the part of this node found at path.
+   *
+   * If path leads to a NodeMap, only the entries in [offset, offset + limit)
+   * are included, which lets large maps be retrieved a page at a time.
+   *
+   * This implementation serializes the whole node and then selects the
+   * path from it.  Nodes with large children override it to only serialize
+   * the child that path leads to.
+   */
+  virtual folly::dynamic
+  toFollyDynamicAt(JsonPath path, size_t /*offset*/, size_t /*limit*/) const {
+    return selectJsonPath(toFollyDynamic(), path);
+  }
+
+  /*
+   * Return a new version of this node, with patch merged into the part of
+   * its serialized form found at path.
+   *
+   * This implementation round trips the whole node through folly::dynamic.
+   * Nodes with large children hide it with one that only deserializes the
+   * child that path leads to, and shares the rest with this node.  It is a
+   * template only so that it is instantiated just for the nodes patched.
+   */
+  template <typename NodeU = NodeT>
+  std::shared_ptr<NodeU> applyJsonPatch(
+      JsonPath path, const folly::dynamic& patch) const {
+    auto json = toFollyDynamic();
+    mergeJsonPatchAt(&json, path, patch);
+    return NodeU::fromFollyDynamic(json);
+  }
+
   /*
    * Serialize to JSON
    * Generate folly::dynamic toFollyDynamic if
@@ -237,7 +351,12 @@ class NodeBaseT : public NodeBase {
       fields_(orig->fields_, std::forward<Args>(args)...) {}
 
  protected:
-  class CloneAllocator : public std::allocator<NodeT> {
+  /*
+   * The allocator used by clone().  Memory for cloned nodes (and their
+   * shared_ptr control blocks) comes from NodePool, which recycles the memory
+   * of nodes freed along with old SwitchState generations.
+   */
+  class CloneAllocator : public NodePoolAllocator<NodeT> {
    public:
     template<typename... Args>
     void construct(void* p, Args&&... args) {
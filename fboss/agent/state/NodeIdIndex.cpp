@@ -0,0 +1,117 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "fboss/agent/state/NodeIdIndex.h"
+
+#include "fboss/agent/state/ControlPlane.h"
+#include "fboss/agent/state/RouteTable.h"
+#include "fboss/agent/state/RouteTableRib.h"
+#include "fboss/agent/state/StateDelta.h"
+#include "fboss/agent/state/SwitchState.h"
+#include "fboss/agent/state/Vlan.h"
+
+#include <folly/logging/xlog.h>
+
+namespace facebook { namespace fboss {
+
+void NodeIdIndex::stateChanged(const StateDelta& delta) {
+  if (indexedState_.lock() != delta.oldState()) {
+    // We don't know what the index currently reflects, so rebuild it
+    XLOG(DBG2) << "Rebuilding NodeID index for state generation "
+               << delta.newState()->getGeneration();
+    nodes_.clear();
+    applyDelta(StateDelta(std::make_shared<SwitchState>(), delta.newState()));
+  } else {
+    applyDelta(delta);
+  }
+  indexedState_ = delta.newState();
+}
+
+std::shared_ptr<NodeBase> NodeIdIndex::getNodeIf(NodeID id) const {
+  auto it = nodes_.find(id);
+  return it == nodes_.end() ? nullptr : it->second;
+}
+
+void NodeIdIndex::replace(
+    const std::shared_ptr<NodeBase>& oldNode,
+    const std::shared_ptr<NodeBase>& newNode) {
+  if (oldNode == newNode) {
+    return;
+  }
+  if (oldNode) {
+    nodes_.erase(oldNode->getNodeID());
+  }
+  if (newNode) {
+    nodes_[newNode->getNodeID()] = newNode;
+  }
+}
+
+template <typename MapDeltaT>
+void NodeIdIndex::applyMapDelta(const MapDeltaT& delta) {
+  for (const auto& entry : delta) {
+    replace(entry.getOld(), entry.getNew());
+  }
+}
+
+void NodeIdIndex::applyDelta(const StateDelta& delta) {
+  const auto& oldState = delta.oldState();
+  const auto& newState = delta.newState();
+  replace(oldState, newState);
+
+  replace(oldState->getPorts(), newState->getPorts());
+  applyMapDelta(delta.getPortsDelta());
+
+  replace(oldState->getAggregatePorts(), newState->getAggregatePorts());
+  applyMapDelta(delta.getAggregatePortsDelta());
+
+  replace(oldState->getInterfaces(), newState->getInterfaces());
+  applyMapDelta(delta.getIntfsDelta());
+
+  replace(oldState->getVlans(), newState->getVlans());
+  for (const auto& vlanDelta : delta.getVlansDelta()) {
+    replace(vlanDelta.getOld(), vlanDelta.getNew());
+    auto oldVlan = vlanDelta.getOld();
+    auto newVlan = vlanDelta.getNew();
+    replace(oldVlan ? oldVlan->getArpTable() : nullptr,
+            newVlan ? newVlan->getArpTable() : nullptr);
+    applyMapDelta(vlanDelta.getArpDelta());
+    replace(oldVlan ? oldVlan->getNdpTable() : nullptr,
+            newVlan ? newVlan->getNdpTable() : nullptr);
+    applyMapDelta(vlanDelta.getNdpDelta());
+  }
+
+  replace(oldState->getRouteTables(), newState->getRouteTables());
+  for (const auto& rtDelta : delta.getRouteTablesDelta()) {
+    replace(rtDelta.getOld(), rtDelta.getNew());
+    auto oldTable = rtDelta.getOld();
+    auto newTable = rtDelta.getNew();
+    replace(oldTable ? oldTable->getRibV4() : nullptr,
+            newTable ? newTable->getRibV4() : nullptr);
+    applyMapDelta(rtDelta.getRoutesV4Delta());
+    replace(oldTable ? oldTable->getRibV6() : nullptr,
+            newTable ? newTable->getRibV6() : nullptr);
+    applyMapDelta(rtDelta.getRoutesV6Delta());
+  }
+
+  // Walk the AclMap directly rather than through getAclsDelta(), which
+  // re-sorts the ACLs by priority.
+  replace(oldState->getAcls(), newState->getAcls());
+  applyMapDelta(NodeMapDelta<AclMap>(
+      oldState->getAcls().get(), newState->getAcls().get()));
+
+  replace(oldState->getSflowCollectors(), newState->getSflowCollectors());
+  applyMapDelta(delta.getSflowCollectorsDelta());
+
+  replace(oldState->getLoadBalancers(), newState->getLoadBalancers());
+  applyMapDelta(delta.getLoadBalancersDelta());
+
+  replace(oldState->getControlPlane(), newState->getControlPlane());
+}
+
+}} // facebook::fboss
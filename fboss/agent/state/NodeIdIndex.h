@@ -0,0 +1,77 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#pragma once
+
+#include "fboss/agent/types.h"
+
+#include <memory>
+#include <unordered_map>
+
+namespace facebook { namespace fboss {
+
+class NodeBase;
+class StateDelta;
+class SwitchState;
+
+/*
+ * NodeIdIndex maps each NodeID in a SwitchState to the node that currently
+ * carries it, so a node can be found from its NodeID without walking the
+ * state.
+ *
+ * The index is kept up to date by passing it the StateDelta of each update.
+ * When a delta starts from the state that the index currently reflects, only
+ * the nodes that changed in the delta are visited; otherwise (e.g. the first
+ * time, or after an update that was not passed in) the index is rebuilt from
+ * the delta's new state.
+ *
+ * NodeIdIndex is not thread safe.  SwSwitch only accesses its index from the
+ * update thread.
+ */
+class NodeIdIndex {
+ public:
+  NodeIdIndex() {}
+
+  /*
+   * Update the index to reflect delta.newState().
+   */
+  void stateChanged(const StateDelta& delta);
+
+  /*
+   * Return the node with the specified NodeID, or null if there is no such
+   * node in the indexed state.
+   */
+  std::shared_ptr<NodeBase> getNodeIf(NodeID id) const;
+
+  template <typename NodeT>
+  std::shared_ptr<NodeT> getNodeIf(NodeID id) const {
+    return std::dynamic_pointer_cast<NodeT>(getNodeIf(id));
+  }
+
+  size_t size() const {
+    return nodes_.size();
+  }
+
+ private:
+  // Forbidden copy constructor and assignment operator
+  NodeIdIndex(NodeIdIndex const&) = delete;
+  NodeIdIndex& operator=(NodeIdIndex const&) = delete;
+
+  void applyDelta(const StateDelta& delta);
+  template <typename MapDeltaT>
+  void applyMapDelta(const MapDeltaT& delta);
+  void replace(
+      const std::shared_ptr<NodeBase>& oldNode,
+      const std::shared_ptr<NodeBase>& newNode);
+
+  std::unordered_map<NodeID, std::shared_ptr<NodeBase>> nodes_;
+  std::weak_ptr<SwitchState> indexedState_;
+};
+
+}} // facebook::fboss
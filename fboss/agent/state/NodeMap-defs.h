@@ -13,6 +13,8 @@
 #include "fboss/agent/FbossError.h"
 
 #include "fboss/agent/state/NodeBase-defs.h"
+#include "fboss/agent/state/NodeSerializationCache.h"
+#include <folly/Conv.h>
 #include <folly/dynamic.h>
 #include <folly/json.h>
 
@@ -109,7 +111,7 @@ template <typename MapTypeT, typename TraitsT>
 folly::dynamic NodeMapT<MapTypeT, TraitsT>::toFollyDynamic() const {
   folly::dynamic nodesJson = folly::dynamic::array;
   for (const auto& node: *this) {
-    nodesJson.push_back(node->toFollyDynamic());
+    nodesJson.push_back(NodeSerializationCache::toFollyDynamic(node));
   }
   folly::dynamic json = folly::dynamic::object;
   json[kEntries] = std::move(nodesJson);
@@ -117,6 +119,74 @@ folly::dynamic NodeMapT<MapTypeT, TraitsT>::toFollyDynamic() const {
   return json;
 }
 
+template <typename MapTypeT, typename TraitsT>
+folly::dynamic NodeMapT<MapTypeT, TraitsT>::toFollyDynamicAt(
+    NodeBase::JsonPath path, size_t offset, size_t limit) const {
+  if (path.empty() || (path.size() == 1 && path[0] == kEntries)) {
+    folly::dynamic nodesJson = folly::dynamic::array;
+    auto it = this->begin();
+    for (size_t i = 0; i < offset && it != this->end(); ++i) {
+      ++it;
+    }
+    for (; it != this->end() && nodesJson.size() < limit; ++it) {
+      nodesJson.push_back(NodeSerializationCache::toFollyDynamic(*it));
+    }
+    if (!path.empty()) {
+      return nodesJson;
+    }
+    folly::dynamic json = folly::dynamic::object;
+    json[kEntries] = std::move(nodesJson);
+    json[kExtraFields] = getExtraFields().toFollyDynamic();
+    return json;
+  }
+  if (path[0] == kEntries) {
+    auto index = folly::tryTo<size_t>(path[1]);
+    if (!index.hasValue() || index.value() >= this->size()) {
+      throw FbossError("no entry \"", path[1], "\" in node map");
+    }
+    auto it = this->begin();
+    for (size_t i = 0; i < index.value(); ++i) {
+      ++it;
+    }
+    return (*it)->toFollyDynamicAt(path.subpiece(2), offset, limit);
+  }
+  if (path[0] == kExtraFields) {
+    return this->selectJsonPath(
+        getExtraFields().toFollyDynamic(), path.subpiece(1));
+  }
+  throw FbossError("no state found at path element \"", path[0], "\"");
+}
+
+template <typename MapTypeT, typename TraitsT>
+std::shared_ptr<MapTypeT> NodeMapT<MapTypeT, TraitsT>::applyJsonPatch(
+    NodeBase::JsonPath path, const folly::dynamic& patch) const {
+  if (path.size() < 2 || path[0] != kEntries) {
+    auto json = toFollyDynamic();
+    this->mergeJsonPatchAt(&json, path, patch);
+    return MapTypeT::fromFollyDynamic(json);
+  }
+  auto index = folly::tryTo<size_t>(path[1]);
+  if (!index.hasValue() || index.value() >= this->size()) {
+    throw FbossError("no entry \"", path[1], "\" in node map");
+  }
+  auto it = this->begin();
+  for (size_t i = 0; i < index.value(); ++i) {
+    ++it;
+  }
+  auto oldNode = *it;
+  std::shared_ptr<Node> newNode =
+      oldNode->applyJsonPatch(path.subpiece(2), patch);
+  auto map = this->clone();
+  if (TraitsT::getKey(newNode) == TraitsT::getKey(oldNode)) {
+    map->updateNode(newNode);
+  } else {
+    // The patch changed the entry's key
+    map->removeNode(oldNode);
+    map->addNode(newNode);
+  }
+  return map;
+}
+
 template <typename MapTypeT, typename TraitsT>
 std::shared_ptr<MapTypeT>
 NodeMapT<MapTypeT, TraitsT>::fromFollyDynamic(const folly::dynamic& nodesJson) {
@@ -13,9 +13,63 @@
 
 #include "fboss/agent/state/NodeBase.h"
 #include "fboss/agent/state/NodeMapIterator.h"
+#include "fboss/agent/state/PersistentNodeContainer.h"
 
 namespace facebook { namespace fboss {
 
+namespace detail {
+template <typename... Ts>
+struct MakeVoid {
+  using type = void;
+};
+
+/*
+ * NodeContainerFor selects the container used to store the children of a
+ * NodeMapT.  Traits classes may specify the container by defining a
+ * NodeContainer type; otherwise a flat_map is used.
+ */
+template <typename TraitsT, typename = void>
+struct NodeContainerFor {
+  using type = boost::container::flat_map<
+    typename TraitsT::KeyType, std::shared_ptr<typename TraitsT::Node>>;
+};
+
+template <typename TraitsT>
+struct NodeContainerFor<
+    TraitsT, typename MakeVoid<typename TraitsT::NodeContainer>::type> {
+  using type = typename TraitsT::NodeContainer;
+};
+
+/*
+ * The memory of the container of a NodeMapT, for NodeBase::accountMemory().
+ * The entries are counted as the capacity of the container, and the nodes
+ * they point to make their own reports.
+ */
+template <typename ContainerT>
+void accountContainerMemory(
+    const ContainerT& container, NodeMemoryVisitor* visitor) {
+  visitor->ownBytes(
+      container.size() * sizeof(typename ContainerT::value_type));
+}
+template <typename KeyT, typename ValueT>
+void accountContainerMemory(
+    const boost::container::flat_map<KeyT, ValueT>& container,
+    NodeMemoryVisitor* visitor) {
+  using Container = boost::container::flat_map<KeyT, ValueT>;
+  visitor->ownBytes(
+      container.capacity() * sizeof(typename Container::value_type));
+}
+template <typename KeyT, typename ValueT, std::size_t kChunkSize>
+void accountContainerMemory(
+    const PersistentNodeContainer<KeyT, ValueT, kChunkSize>& container,
+    NodeMemoryVisitor* visitor) {
+  visitor->ownBytes(container.numChunks() * sizeof(std::shared_ptr<void>));
+  container.forEachChunk([visitor](const void* chunk, size_t bytes) {
+    visitor->sharedBlock(chunk, bytes);
+  });
+}
+} // namespace detail
+
 /*
  * NodeMapFields defines the fields contained inside a NodeMapT instantiation
  */
@@ -24,8 +78,7 @@ struct NodeMapFields {
   using KeyType = typename TraitsT::KeyType;
   using Node = typename TraitsT::Node;
   using ExtraFields = typename TraitsT::ExtraFields;
-  using NodeContainer =
-      boost::container::flat_map<KeyType, std::shared_ptr<Node>>;
+  using NodeContainer = typename detail::NodeContainerFor<TraitsT>::type;
 
   NodeMapFields() {}
   NodeMapFields(const NodeMapFields& other, NodeContainer nodes)
@@ -34,12 +87,19 @@ struct NodeMapFields {
 
   template<typename Fn>
   void forEachChild(Fn fn) {
-    for (const auto& nodePtr : nodes) {
+    // Walk a const view of the nodes, so that containers which share storage
+    // with other copies don't unshare it.
+    const auto& constNodes = nodes;
+    for (const auto& nodePtr : constNodes) {
       fn(nodePtr.second.get());
     }
     extra.forEachChild(fn);
   }
 
+  void accountMemory(NodeMemoryVisitor* visitor) const {
+    detail::accountContainerMemory(nodes, visitor);
+  }
+
   NodeContainer nodes;
   ExtraFields extra;
 };
@@ -68,6 +128,19 @@ struct NodeMapTraits {
   }
 };
 
+/*
+ * Traits for large maps that are cloned frequently.
+ *
+ * These store the children in a PersistentNodeContainer, so cloning the map
+ * shares the storage with the original map and only the chunks that are
+ * subsequently modified get copied.
+ */
+template<typename KeyT, typename NodeT, typename ExtraT = NodeMapNoExtraFields>
+struct PersistentNodeMapTraits : public NodeMapTraits<KeyT, NodeT, ExtraT> {
+  using NodeContainer =
+    PersistentNodeContainer<KeyT, std::shared_ptr<NodeT>>;
+};
+
 /*
  * A helper class for implementing state nodes that store a set of Node
  * children.
@@ -141,6 +214,22 @@ class NodeMapT : public NodeBaseT<MapTypeT,
    */
   folly::dynamic toFollyDynamic() const override;
 
+  /*
+   * Serialize part of the map, without serializing the entries that path
+   * doesn't lead to.  If path names the map itself (or its entries list),
+   * only the entries in [offset, offset + limit) are serialized.
+   */
+  folly::dynamic toFollyDynamicAt(
+      NodeBase::JsonPath path, size_t offset, size_t limit) const override;
+
+  /*
+   * Return a new version of the map with patch merged in at path.  If path
+   * leads into an entry, only that entry is deserialized again and the
+   * other entries are shared with this map.
+   */
+  std::shared_ptr<MapTypeT> applyJsonPatch(
+      NodeBase::JsonPath path, const folly::dynamic& patch) const;
+
   /*
    * Serialize to json string
    */
@@ -30,12 +30,7 @@ NodeMapDelta<MAP, VALUE, MAPPOINTERTRAITS>::Iterator::Iterator(
     newMap_(newMap),
     value_(nullNode_, nullNode_) {
   // Advance to the first difference
-  while (oldIt_ != oldMap_->end() &&
-         newIt_ != newMap_->end() &&
-         *oldIt_ == *newIt_) {
-    ++oldIt_;
-    ++newIt_;
-  }
+  skipUnchanged();
   updateValue();
 }
 
@@ -103,13 +98,24 @@ void NodeMapDelta<MAP, VALUE, MAPPOINTERTRAITS>::Iterator::advance() {
   }
 
   // Advance past any unchanged nodes.
-  while (oldIt_ != oldMap_->end() &&
-         newIt_ != newMap_->end() &&
-         *oldIt_ == *newIt_) {
+  skipUnchanged();
+  updateValue();
+}
+
+template<typename MAP, typename VALUE, typename MAPPOINTERTRAITS>
+void NodeMapDelta<MAP, VALUE, MAPPOINTERTRAITS>::Iterator::skipUnchanged() {
+  while (oldIt_ != oldMap_->end() && newIt_ != newMap_->end()) {
+    // If the old and new maps share storage for the next range of nodes,
+    // skip over the whole range at once rather than comparing each node.
+    if (oldIt_.skipShared(newIt_)) {
+      continue;
+    }
+    if (*oldIt_ != *newIt_) {
+      break;
+    }
     ++oldIt_;
     ++newIt_;
   }
-  updateValue();
 }
 
 }} // facebook::fboss
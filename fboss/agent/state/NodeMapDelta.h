@@ -187,6 +187,7 @@ class NodeMapDelta<MAP, VALUE, MAPPOINTERTRAITS>::Iterator {
 
   void advance();
   void updateValue();
+  void skipUnchanged();
 
   InnerIter oldIt_{nullptr};
   InnerIter newIt_{nullptr};
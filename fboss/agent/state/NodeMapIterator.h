@@ -10,6 +10,7 @@
 #pragma once
 
 #include <boost/container/flat_map.hpp>
+#include <utility>
 
 /*
  * NodeMapIterator is a very small wrapper around flat_map::const_iterator.
@@ -53,7 +54,31 @@ class NodeMapIterator : public std::iterator<std::forward_iterator_tag,
     return it_ != other.it_;
   }
 
+  /*
+   * If this iterator and the other iterator point into storage that is
+   * shared between their two containers, advance both of them past the
+   * shared entries.
+   *
+   * Returns true if the iterators were advanced.  This is always false for
+   * containers that don't share storage between copies.
+   */
+  bool skipShared(NodeMapIterator& other) {
+    return skipSharedImpl<NodeContainer>(other, 0);
+  }
+
  private:
+  template <typename Container>
+  auto skipSharedImpl(NodeMapIterator& other, int)
+      -> decltype(Container::skipSharedEntries(
+          std::declval<typename Container::const_iterator&>(),
+          std::declval<typename Container::const_iterator&>())) {
+    return Container::skipSharedEntries(it_, other.it_);
+  }
+  template <typename Container>
+  bool skipSharedImpl(NodeMapIterator& /*other*/, long) {
+    return false;
+  }
+
   typename NodeContainer::const_iterator it_;
 };
 
@@ -0,0 +1,71 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "fboss/agent/state/NodeSerializationCache.h"
+
+#include "fboss/agent/state/NodeBase.h"
+
+namespace {
+thread_local facebook::fboss::NodeSerializationCache* currentCache{nullptr};
+}
+
+namespace facebook { namespace fboss {
+
+NodeSerializationCache::Scope::Scope(NodeSerializationCache* cache)
+    : guard_(cache->lock_), cache_(cache), prev_(currentCache) {
+  ++cache_->epoch_;
+  currentCache = cache_;
+}
+
+NodeSerializationCache::Scope::~Scope() {
+  currentCache = prev_;
+  cache_->sweep();
+}
+
+NodeSerializationCache* NodeSerializationCache::current() {
+  return currentCache;
+}
+
+size_t NodeSerializationCache::size() const {
+  std::lock_guard<std::mutex> g(lock_);
+  return entries_.size();
+}
+
+folly::dynamic NodeSerializationCache::lookupOrSerialize(
+    const std::shared_ptr<const NodeBase>& node,
+    folly::Function<folly::dynamic()> serialize) {
+  auto it = entries_.find(node.get());
+  if (it != entries_.end()) {
+    if (it->second.node.lock() == node) {
+      it->second.epoch = epoch_;
+      hits_.fetch_add(1, std::memory_order_relaxed);
+      return it->second.json;
+    }
+    // A destroyed node used to live at this address
+    entries_.erase(it);
+  }
+  misses_.fetch_add(1, std::memory_order_relaxed);
+  // Serializing may recursively add entries for the node's children, so don't
+  // hold on to an iterator across this call.
+  auto json = serialize();
+  entries_[node.get()] = Entry{node, json, epoch_};
+  return json;
+}
+
+void NodeSerializationCache::sweep() {
+  for (auto it = entries_.begin(); it != entries_.end();) {
+    if (it->second.epoch != epoch_ || it->second.node.expired()) {
+      it = entries_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
+}} // facebook::fboss
@@ -0,0 +1,112 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#pragma once
+
+#include <folly/Function.h>
+#include <folly/dynamic.h>
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+namespace facebook { namespace fboss {
+
+class NodeBase;
+
+/*
+ * NodeSerializationCache remembers the serialized form of published nodes,
+ * so that successive dumps of the SwitchState only need to serialize the
+ * nodes that were created since the previous dump.
+ *
+ * Published nodes are immutable, so a node's serialized form can never
+ * change.  Entries are keyed by node pointer and hold a weak_ptr to the node,
+ * so a new node allocated at the address of a destroyed one is never mistaken
+ * for it.
+ *
+ * The cache is only consulted by NodeMapT::toFollyDynamic() while a
+ * NodeSerializationCache::Scope is alive on the calling thread.  Entries that
+ * were not used during a scope are dropped when it ends, so the cache never
+ * holds more than the last dump.
+ */
+class NodeSerializationCache {
+ public:
+  /*
+   * Use the cache for all serialization done by this thread while the Scope
+   * exists.  Only one Scope at a time can use a given cache; others block
+   * until it is done, so Scopes for the same cache must not be nested.
+   */
+  class Scope {
+   public:
+    explicit Scope(NodeSerializationCache* cache);
+    ~Scope();
+
+   private:
+    Scope(Scope const&) = delete;
+    Scope& operator=(Scope const&) = delete;
+
+    std::unique_lock<std::mutex> guard_;
+    NodeSerializationCache* cache_;
+    NodeSerializationCache* prev_;
+  };
+
+  NodeSerializationCache() {}
+
+  /*
+   * Serialize node, using the cache in use by this thread if any.
+   */
+  template <typename NodeT>
+  static folly::dynamic toFollyDynamic(const std::shared_ptr<NodeT>& node) {
+    auto cache = current();
+    if (!cache || !node->isPublished()) {
+      return node->toFollyDynamic();
+    }
+    return cache->lookupOrSerialize(
+        node, [&node]() { return node->toFollyDynamic(); });
+  }
+
+  uint64_t hits() const {
+    return hits_.load(std::memory_order_relaxed);
+  }
+  uint64_t misses() const {
+    return misses_.load(std::memory_order_relaxed);
+  }
+  /*
+   * The number of cached nodes.  Must not be called from within a Scope
+   * using this cache.
+   */
+  size_t size() const;
+
+ private:
+  struct Entry {
+    std::weak_ptr<const NodeBase> node;
+    folly::dynamic json;
+    uint64_t epoch;
+  };
+
+  // Forbidden copy constructor and assignment operator
+  NodeSerializationCache(NodeSerializationCache const&) = delete;
+  NodeSerializationCache& operator=(NodeSerializationCache const&) = delete;
+
+  static NodeSerializationCache* current();
+
+  folly::dynamic lookupOrSerialize(
+      const std::shared_ptr<const NodeBase>& node,
+      folly::Function<folly::dynamic()> serialize);
+  void sweep();
+
+  mutable std::mutex lock_;
+  std::unordered_map<const NodeBase*, Entry> entries_;
+  uint64_t epoch_{0};
+  std::atomic<uint64_t> hits_{0};
+  std::atomic<uint64_t> misses_{0};
+};
+
+}} // facebook::fboss
@@ -0,0 +1,453 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <iterator>
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace facebook { namespace fboss {
+
+/*
+ * PersistentNodeContainer is a sorted associative container with the same
+ * interface as the boost::container::flat_map that NodeMapFields uses by
+ * default, but with cheap copies.
+ *
+ * Entries are kept in key order inside fixed size chunks, and the container
+ * itself only holds a vector of shared_ptrs to those chunks.  Copying the
+ * container (which is what NodeMapT::clone() does) therefore only copies the
+ * chunk pointers, and the new copy shares every chunk with the original.  A
+ * chunk is copied lazily the first time it is written to while shared, so
+ * updating a single entry of a cloned map only copies the one chunk holding
+ * that entry.
+ *
+ * Unlike a hash based persistent map, iteration stays in key order, which
+ * NodeMapDelta relies on to merge the old and new maps.
+ *
+ * Writes must follow the same rules as the rest of the SwitchState: only an
+ * unpublished container, visible to a single thread, may be modified.  A
+ * chunk with a use count of 1 is therefore never visible to anyone else and
+ * can be modified in place.
+ *
+ * Note that dereferencing a non-const iterator may copy the chunk it points
+ * into.  Read-only walks should go through a const reference to the
+ * container to avoid unsharing chunks unnecessarily.
+ */
+template <typename KeyT, typename ValueT, std::size_t kChunkSize = 128>
+class PersistentNodeContainer {
+ public:
+  using key_type = KeyT;
+  using mapped_type = ValueT;
+  using value_type = std::pair<KeyT, ValueT>;
+  using size_type = std::size_t;
+  using difference_type = std::ptrdiff_t;
+  using reference = value_type&;
+  using const_reference = const value_type&;
+
+  static_assert(kChunkSize >= 2, "chunks must hold at least two entries");
+
+ private:
+  using Chunk = std::vector<value_type>;
+  using ChunkPtr = std::shared_ptr<Chunk>;
+
+  template <bool kIsConst>
+  class IteratorBase {
+   public:
+    using ContainerPtr = typename std::conditional<
+      kIsConst, const PersistentNodeContainer*, PersistentNodeContainer*>::type;
+
+    using iterator_category = std::bidirectional_iterator_tag;
+    using value_type = typename PersistentNodeContainer::value_type;
+    using difference_type = std::ptrdiff_t;
+    using reference = typename std::conditional<
+      kIsConst, const value_type&, value_type&>::type;
+    using pointer = typename std::conditional<
+      kIsConst, const value_type*, value_type*>::type;
+
+    IteratorBase() {}
+    IteratorBase(ContainerPtr container, size_type chunk, size_type pos)
+      : container_(container),
+        chunk_(chunk),
+        pos_(pos) {}
+
+    // Allow implicit conversion from iterator to const_iterator
+    template <bool kOtherConst,
+              typename = std::enable_if_t<kIsConst && !kOtherConst>>
+    /* implicit */ IteratorBase(const IteratorBase<kOtherConst>& other)
+      : container_(other.container_),
+        chunk_(other.chunk_),
+        pos_(other.pos_) {}
+
+    reference operator*() const {
+      return container_->entryAt(chunk_, pos_);
+    }
+    pointer operator->() const {
+      return &container_->entryAt(chunk_, pos_);
+    }
+
+    IteratorBase& operator++() {
+      if (++pos_ == container_->chunks_[chunk_]->size()) {
+        ++chunk_;
+        pos_ = 0;
+      }
+      return *this;
+    }
+    IteratorBase operator++(int) {
+      IteratorBase tmp(*this);
+      ++(*this);
+      return tmp;
+    }
+    IteratorBase& operator--() {
+      if (pos_ == 0) {
+        --chunk_;
+        pos_ = container_->chunks_[chunk_]->size() - 1;
+      } else {
+        --pos_;
+      }
+      return *this;
+    }
+    IteratorBase operator--(int) {
+      IteratorBase tmp(*this);
+      --(*this);
+      return tmp;
+    }
+
+    template <bool kOtherConst>
+    bool operator==(const IteratorBase<kOtherConst>& other) const {
+      return chunk_ == other.chunk_ && pos_ == other.pos_;
+    }
+    template <bool kOtherConst>
+    bool operator!=(const IteratorBase<kOtherConst>& other) const {
+      return !operator==(other);
+    }
+
+   private:
+    friend class PersistentNodeContainer;
+    template <bool> friend class IteratorBase;
+
+    ContainerPtr container_{nullptr};
+    size_type chunk_{0};
+    size_type pos_{0};
+  };
+
+ public:
+  using iterator = IteratorBase<false>;
+  using const_iterator = IteratorBase<true>;
+  using reverse_iterator = std::reverse_iterator<iterator>;
+  using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+
+  PersistentNodeContainer() {}
+
+  template <typename InputIt>
+  PersistentNodeContainer(InputIt first, InputIt last) {
+    insert(first, last);
+  }
+
+  size_type size() const {
+    return size_;
+  }
+  bool empty() const {
+    return size_ == 0;
+  }
+
+  /*
+   * Returns true if the chunk at the given index is shared with another copy
+   * of this container.  This is mostly useful for tests and debugging.
+   */
+  bool isChunkShared(size_type chunk) const {
+    return chunks_[chunk].use_count() > 1;
+  }
+  size_type numChunks() const {
+    return chunks_.size();
+  }
+
+  /*
+   * Call fn(chunk, bytes) with the address and size of each chunk, which
+   * copies of the container may share, for memory accounting.
+   */
+  template <typename Fn>
+  void forEachChunk(Fn fn) const {
+    for (const auto& chunk : chunks_) {
+      fn(static_cast<const void*>(chunk.get()),
+         sizeof(Chunk) + chunk->capacity() * sizeof(value_type));
+    }
+  }
+
+  const_iterator begin() const {
+    return const_iterator(this, 0, 0);
+  }
+  const_iterator end() const {
+    return const_iterator(this, chunks_.size(), 0);
+  }
+  const_iterator cbegin() const {
+    return begin();
+  }
+  const_iterator cend() const {
+    return end();
+  }
+  iterator begin() {
+    return iterator(this, 0, 0);
+  }
+  iterator end() {
+    return iterator(this, chunks_.size(), 0);
+  }
+
+  const_reverse_iterator rbegin() const {
+    return const_reverse_iterator(end());
+  }
+  const_reverse_iterator rend() const {
+    return const_reverse_iterator(begin());
+  }
+  const_reverse_iterator crbegin() const {
+    return rbegin();
+  }
+  const_reverse_iterator crend() const {
+    return rend();
+  }
+  reverse_iterator rbegin() {
+    return reverse_iterator(end());
+  }
+  reverse_iterator rend() {
+    return reverse_iterator(begin());
+  }
+
+  const_iterator find(const key_type& key) const {
+    return findImpl<const_iterator>(this, key);
+  }
+  iterator find(const key_type& key) {
+    return findImpl<iterator>(this, key);
+  }
+  size_type count(const key_type& key) const {
+    return find(key) == end() ? 0 : 1;
+  }
+
+  const_iterator lower_bound(const key_type& key) const {
+    return lowerBoundImpl<const_iterator>(this, key);
+  }
+  iterator lower_bound(const key_type& key) {
+    return lowerBoundImpl<iterator>(this, key);
+  }
+
+  std::pair<iterator, bool> insert(value_type value);
+  iterator insert(const_iterator /*hint*/, value_type value) {
+    return insert(std::move(value)).first;
+  }
+  template <typename InputIt>
+  void insert(InputIt first, InputIt last) {
+    for (; first != last; ++first) {
+      insert(*first);
+    }
+  }
+
+  template <typename... Args>
+  std::pair<iterator, bool> emplace(Args&&... args) {
+    return insert(value_type(std::forward<Args>(args)...));
+  }
+  template <typename... Args>
+  iterator emplace_hint(const_iterator hint, Args&&... args) {
+    return insert(hint, value_type(std::forward<Args>(args)...));
+  }
+
+  iterator erase(const_iterator it);
+  size_type erase(const key_type& key) {
+    auto it = find(key);
+    if (it == end()) {
+      return 0;
+    }
+    erase(it);
+    return 1;
+  }
+
+  /*
+   * If the two iterators point at the same position of a chunk shared by
+   * both of their containers, advance both of them past the rest of that
+   * chunk, since the remaining entries are necessarily identical.
+   *
+   * Returns true if the iterators were advanced.  This allows callers that
+   * compare two versions of a container (such as NodeMapDelta) to skip over
+   * unchanged ranges without visiting every entry.
+   */
+  static bool skipSharedEntries(const_iterator& a, const_iterator& b) {
+    if (a.pos_ != b.pos_ ||
+        a.chunk_ >= a.container_->chunks_.size() ||
+        b.chunk_ >= b.container_->chunks_.size() ||
+        a.container_->chunks_[a.chunk_] != b.container_->chunks_[b.chunk_]) {
+      return false;
+    }
+    ++a.chunk_;
+    a.pos_ = 0;
+    ++b.chunk_;
+    b.pos_ = 0;
+    return true;
+  }
+
+  void clear() {
+    chunks_.clear();
+    size_ = 0;
+  }
+  void swap(PersistentNodeContainer& other) {
+    chunks_.swap(other.chunks_);
+    std::swap(size_, other.size_);
+  }
+
+ private:
+  const value_type& entryAt(size_type chunk, size_type pos) const {
+    return (*chunks_[chunk])[pos];
+  }
+  value_type& entryAt(size_type chunk, size_type pos) {
+    return mutableChunk(chunk)[pos];
+  }
+
+  /*
+   * Get a writable reference to a chunk, copying it first if it is still
+   * shared with another container.
+   */
+  Chunk& mutableChunk(size_type chunk) {
+    auto& ptr = chunks_[chunk];
+    if (ptr.use_count() > 1) {
+      ptr = std::make_shared<Chunk>(*ptr);
+    }
+    return *ptr;
+  }
+
+  /*
+   * Return the index of the first chunk whose last key is not less than the
+   * specified key, or chunks_.size() if there is no such chunk.
+   */
+  size_type chunkFor(const key_type& key) const {
+    auto it = std::lower_bound(
+        chunks_.begin(), chunks_.end(), key,
+        [](const ChunkPtr& chunk, const key_type& k) {
+          return chunk->back().first < k;
+        });
+    return it - chunks_.begin();
+  }
+
+  size_type posInChunk(size_type chunk, const key_type& key) const {
+    const auto& entries = *chunks_[chunk];
+    auto it = std::lower_bound(
+        entries.begin(), entries.end(), key,
+        [](const value_type& entry, const key_type& k) {
+          return entry.first < k;
+        });
+    return it - entries.begin();
+  }
+
+  template <typename IterT, typename ContainerPtr>
+  static IterT lowerBoundImpl(ContainerPtr self, const key_type& key) {
+    auto chunk = self->chunkFor(key);
+    if (chunk == self->chunks_.size()) {
+      return IterT(self, chunk, 0);
+    }
+    return IterT(self, chunk, self->posInChunk(chunk, key));
+  }
+
+  template <typename IterT, typename ContainerPtr>
+  static IterT findImpl(ContainerPtr self, const key_type& key) {
+    auto chunk = self->chunkFor(key);
+    if (chunk == self->chunks_.size()) {
+      return IterT(self, chunk, 0);
+    }
+    auto pos = self->posInChunk(chunk, key);
+    if (key < (*self->chunks_[chunk])[pos].first) {
+      return IterT(self, self->chunks_.size(), 0);
+    }
+    return IterT(self, chunk, pos);
+  }
+
+  std::vector<ChunkPtr> chunks_;
+  size_type size_{0};
+};
+
+template <typename KeyT, typename ValueT, std::size_t kChunkSize>
+std::pair<typename PersistentNodeContainer<KeyT, ValueT, kChunkSize>::iterator,
+          bool>
+PersistentNodeContainer<KeyT, ValueT, kChunkSize>::insert(value_type value) {
+  if (chunks_.empty()) {
+    chunks_.push_back(std::make_shared<Chunk>());
+    chunks_.back()->reserve(kChunkSize);
+    chunks_.back()->push_back(std::move(value));
+    size_ = 1;
+    return std::make_pair(iterator(this, 0, 0), true);
+  }
+
+  auto chunk = chunkFor(value.first);
+  if (chunk == chunks_.size()) {
+    // The new key is larger than every existing key.  If the last chunk is
+    // full start a new one, so that building a map in key order produces
+    // fully packed chunks.
+    chunk = chunks_.size() - 1;
+    if (chunks_[chunk]->size() >= kChunkSize) {
+      chunks_.push_back(std::make_shared<Chunk>());
+      chunks_.back()->reserve(kChunkSize);
+      chunks_.back()->push_back(std::move(value));
+      ++size_;
+      return std::make_pair(iterator(this, chunk + 1, 0), true);
+    }
+  }
+
+  auto pos = posInChunk(chunk, value.first);
+  const auto& entries = *chunks_[chunk];
+  if (pos < entries.size() && !(value.first < entries[pos].first)) {
+    return std::make_pair(iterator(this, chunk, pos), false);
+  }
+
+  auto& writable = mutableChunk(chunk);
+  writable.insert(writable.begin() + pos, std::move(value));
+  ++size_;
+
+  // Split chunks that have grown to twice the target size
+  if (writable.size() >= 2 * kChunkSize) {
+    auto half = writable.size() / 2;
+    auto upper = std::make_shared<Chunk>(
+        std::make_move_iterator(writable.begin() + half),
+        std::make_move_iterator(writable.end()));
+    writable.erase(writable.begin() + half, writable.end());
+    chunks_.insert(chunks_.begin() + chunk + 1, std::move(upper));
+    if (pos >= half) {
+      return std::make_pair(iterator(this, chunk + 1, pos - half), true);
+    }
+  }
+  return std::make_pair(iterator(this, chunk, pos), true);
+}
+
+template <typename KeyT, typename ValueT, std::size_t kChunkSize>
+typename PersistentNodeContainer<KeyT, ValueT, kChunkSize>::iterator
+PersistentNodeContainer<KeyT, ValueT, kChunkSize>::erase(const_iterator it) {
+  auto chunk = it.chunk_;
+  auto pos = it.pos_;
+  auto& writable = mutableChunk(chunk);
+  writable.erase(writable.begin() + pos);
+  --size_;
+
+  if (writable.empty()) {
+    chunks_.erase(chunks_.begin() + chunk);
+    return iterator(this, chunk, 0);
+  }
+
+  // Fold the next chunk into this one if they fit in a single chunk, so that
+  // a long run of deletions doesn't leave lots of tiny chunks behind.
+  if (chunk + 1 < chunks_.size() &&
+      writable.size() + chunks_[chunk + 1]->size() <= kChunkSize) {
+    const auto& next = *chunks_[chunk + 1];
+    writable.insert(writable.end(), next.begin(), next.end());
+    chunks_.erase(chunks_.begin() + chunk + 1);
+  }
+
+  if (pos == chunks_[chunk]->size()) {
+    return iterator(this, chunk + 1, 0);
+  }
+  return iterator(this, chunk, pos);
+}
+
+}} // facebook::fboss
@@ -88,6 +88,8 @@ PortFields PortFields::fromThrift(state::PortFields const& portThrift) {
         std::make_shared<PortQueue>(PortQueueFields::fromThrift(queue)));
   }
 
+  port.buffer = portThrift.buffer;
+
   return port;
 }
 
@@ -136,6 +138,8 @@ state::PortFields PortFields::toThrift() const {
     port.queues.push_back(queue->getFields()->toThrift());
   }
 
+  port.buffer = buffer;
+
   return port;
 }
 
@@ -70,6 +70,8 @@ struct PortFields {
   int64_t sFlowEgressRate{0};
   QueueConfig queues;
   cfg::PortFEC fec{cfg::PortFEC::OFF};  // TODO: should this default to ON?
+  // Ingress buffer policy; none keeps the hardware defaults
+  folly::Optional<cfg::PortBuffer> buffer;
 };
 
 /*
@@ -188,6 +190,12 @@ class Port : public ThriftyBaseT<state::PortFields, Port, PortFields> {
     writableFields()->fec = fec;
   }
 
+  const folly::Optional<cfg::PortBuffer>& getBuffer() const {
+    return getFields()->buffer;
+  }
+  void setBuffer(const folly::Optional<cfg::PortBuffer>& buffer) {
+    writableFields()->buffer = buffer;
+  }
 
   int64_t getSflowIngressRate() const {
     return getFields()->sFlowIngressRate;
@@ -21,7 +21,7 @@ namespace facebook { namespace fboss {
 
 class PortDescriptor {
  public:
-  enum class PortType {
+  enum class PortType : uint8_t {
     PHYSICAL,
     AGGREGATE,
   };
@@ -140,3 +140,15 @@ inline std::ostream& operator<<(std::ostream& out, const PortDescriptor& pd) {
 }
 
 }} // facebook::fboss
+
+namespace std {
+
+template <> struct hash<facebook::fboss::PortDescriptor> {
+  size_t operator()(const facebook::fboss::PortDescriptor& pd) const {
+    // Physical and aggregate ports with the same id hash apart
+    auto id = static_cast<size_t>(static_cast<uint16_t>(pd.asThriftPort()));
+    return pd.isPhysicalPort() ? id : id | (size_t(1) << 16);
+  }
+};
+
+}
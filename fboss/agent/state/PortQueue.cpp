@@ -17,6 +17,7 @@ state::PortQueueFields PortQueueFields::toThrift() const {
   state::PortQueueFields queue;
   queue.weight = weight;
   queue.reserved = reservedBytes;
+  queue.sharedBytes = sharedBytes;
   if (scalingFactor) {
     queue.scalingFactor =
         cfg::_MMUScalingFactor_VALUES_TO_NAMES.at(*scalingFactor);
@@ -44,6 +45,7 @@ PortQueueFields PortQueueFields::fromThrift(
   queue.scheduling = itrSched->second;
 
   queue.reservedBytes = queueThrift.reserved;
+  queue.sharedBytes = queueThrift.sharedBytes;
   queue.weight = queueThrift.weight;
 
   if (queueThrift.scalingFactor) {
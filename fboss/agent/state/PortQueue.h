@@ -38,6 +38,7 @@ struct PortQueueFields {
   cfg::StreamType streamType{cfg::StreamType::UNICAST};
   int weight{1};
   folly::Optional<int> reservedBytes{folly::none};
+  folly::Optional<int> sharedBytes{folly::none};
   folly::Optional<cfg::MMUScalingFactor> scalingFactor{folly::none};
   folly::Optional<cfg::ActiveQueueManagement> aqm{folly::none};
 };
@@ -54,6 +55,7 @@ class PortQueue :
            getFields()->streamType == queue.getStreamType() &&
            getFields()->weight == queue.getWeight() &&
            getFields()->reservedBytes == queue.getReservedBytes() &&
+           getFields()->sharedBytes == queue.getSharedBytes() &&
            getFields()->scalingFactor == queue.getScalingFactor() &&
            getFields()->scheduling == queue.getScheduling() &&
            getFields()->aqm == queue.getAqm();
@@ -98,6 +100,14 @@ class PortQueue :
     writableFields()->reservedBytes = reservedBytes;
   }
 
+  folly::Optional<int> getSharedBytes() const {
+    return getFields()->sharedBytes;
+  }
+
+  void setSharedBytes(int sharedBytes) {
+    writableFields()->sharedBytes = sharedBytes;
+  }
+
   folly::Optional<cfg::MMUScalingFactor> getScalingFactor() const {
     return getFields()->scalingFactor;
   }
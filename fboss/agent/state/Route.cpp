@@ -21,6 +21,8 @@ constexpr auto kPrefix = "prefix";
 constexpr auto kNextHopsMulti = "rib";
 constexpr auto kFwdInfo = "forwardingInfo";
 constexpr auto kFlags = "flags";
+constexpr auto kClassID = "classID";
+constexpr auto kClientClassIDs = "clientClassIDs";
 }
 namespace facebook { namespace fboss {
 
@@ -38,6 +40,8 @@ RouteFields<AddrT>::RouteFields(const RouteFields& rf,
   switch(copyBehavior) {
   case COPY_PREFIX_AND_NEXTHOPS:
     nexthopsmulti = rf.nexthopsmulti;
+    clientClassIDs = rf.clientClassIDs;
+    classID = rf.classID;
     break;
   default:
     throw FbossError("Unknown CopyBehavior passed to RouteFields ctor");
@@ -49,7 +53,9 @@ bool RouteFields<AddrT>::operator==(const RouteFields& rf) const {
   return (flags == rf.flags
           && prefix == rf.prefix
           && nexthopsmulti == rf.nexthopsmulti
-          && fwd == rf.fwd);
+          && fwd == rf.fwd
+          && clientClassIDs == rf.clientClassIDs
+          && classID == rf.classID);
 }
 
 template<typename AddrT>
@@ -60,6 +66,14 @@ folly::dynamic Route<AddrT>::toFollyDynamic() const {
     RouteBase::getFields()->nexthopsmulti.toFollyDynamic();
   routeFields[kFwdInfo] = RouteBase::getFields()->fwd.toFollyDynamic();
   routeFields[kFlags] = RouteBase::getFields()->flags;
+  routeFields[kClassID] =
+      static_cast<uint32_t>(RouteBase::getFields()->classID);
+  folly::dynamic clientClassIDs = folly::dynamic::object;
+  for (const auto& entry : RouteBase::getFields()->clientClassIDs) {
+    clientClassIDs[folly::to<std::string>(static_cast<int>(entry.first))] =
+        static_cast<uint32_t>(entry.second);
+  }
+  routeFields[kClientClassIDs] = std::move(clientClassIDs);
   return routeFields;
 }
 
@@ -71,6 +85,20 @@ std::shared_ptr<Route<AddrT>> Route<AddrT>::fromFollyDynamic(
       RouteNextHopsMulti::fromFollyDynamic(routeJson[kNextHopsMulti]);
   rt.fwd = RouteNextHopEntry::fromFollyDynamic(routeJson[kFwdInfo]);
   rt.flags = routeJson[kFlags].asInt();
+  // Not in the state of agents from before route classes
+  if (routeJson.count(kClassID)) {
+    rt.classID = RouteClassID(routeJson[kClassID].asInt());
+  }
+  if (routeJson.count(kClientClassIDs)) {
+    for (const auto& entry : routeJson[kClientClassIDs].items()) {
+      rt.clientClassIDs.emplace(
+          ClientID(entry.first.asInt()), RouteClassID(entry.second.asInt()));
+    }
+  } else if (rt.classID != RouteClassID(0) && !rt.nexthopsmulti.isEmpty()) {
+    // Agents from before classes were kept per client only had the one
+    rt.clientClassIDs.emplace(
+        rt.nexthopsmulti.getBestEntry().first, rt.classID);
+  }
   auto route = std::make_shared<Route<AddrT>>(rt);
   CHECK(!route->hasNoEntry());
   return route;
@@ -94,6 +122,10 @@ RouteDetails RouteFields<AddrT>::toRouteDetails() const {
 
   // Add the multi-nexthops
   rd.nextHopMulti = nexthopsmulti.toThrift();
+  if (classID != RouteClassID(0)) {
+    rd.classID = static_cast<uint32_t>(classID);
+    rd.__isset.classID = true;
+  }
   return rd;
 }
 
@@ -128,6 +160,36 @@ void Route<AddrT>::update(ClientID clientId, RouteNextHopEntry entry) {
   RouteBase::writableFields()->fwd.reset();
   RouteBase::writableFields()->nexthopsmulti.update(
       clientId, std::move(entry));
+  updateClassID();
+}
+
+template<typename AddrT>
+RouteClassID Route<AddrT>::getClassIDForClient(ClientID clientId) const {
+  const auto& clientClassIDs = RouteBase::getFields()->clientClassIDs;
+  auto it = clientClassIDs.find(clientId);
+  return it == clientClassIDs.end() ? RouteClassID(0) : it->second;
+}
+
+template<typename AddrT>
+void Route<AddrT>::setClassIDForClient(
+    ClientID clientId, RouteClassID classID) {
+  auto& clientClassIDs = RouteBase::writableFields()->clientClassIDs;
+  if (classID == RouteClassID(0)) {
+    clientClassIDs.erase(clientId);
+  } else {
+    clientClassIDs[clientId] = classID;
+  }
+  updateClassID();
+}
+
+template<typename AddrT>
+void Route<AddrT>::updateClassID() {
+  auto fields = RouteBase::writableFields();
+  fields->classID = RouteClassID(0);
+  if (!fields->nexthopsmulti.isEmpty()) {
+    fields->classID =
+        getClassIDForClient(fields->nexthopsmulti.getBestEntry().first);
+  }
 }
 
 template<typename AddrT>
@@ -146,6 +208,8 @@ bool Route<AddrT>::isSame(const Route<AddrT>* rt) const {
 template<typename AddrT>
 void Route<AddrT>::delEntryForClient(ClientID clientId) {
   RouteBase::writableFields()->nexthopsmulti.delEntryForClient(clientId);
+  RouteBase::writableFields()->clientClassIDs.erase(clientId);
+  updateClassID();
 }
 
 template<typename AddrT>
@@ -19,6 +19,7 @@
 #include "fboss/agent/types.h"
 #include "fboss/agent/if/gen-cpp2/ctrl_types.h"
 
+#include <boost/container/flat_map.hpp>
 #include <boost/container/flat_set.hpp>
 
 namespace facebook { namespace fboss {
@@ -38,6 +39,12 @@ struct RouteFields {
   RouteFields(const RouteFields& rf, CopyBehavior copyBehavior);
   template <typename Fn>
   void forEachChild(Fn /*fn*/) {}
+  void accountMemory(NodeMemoryVisitor* visitor) const {
+    nexthopsmulti.accountMemory(visitor);
+    fwd.accountMemory(visitor);
+    visitor->ownBytes(
+        clientClassIDs.capacity() * sizeof(*clientClassIDs.begin()));
+  }
   bool operator==(const RouteFields& rf) const;
   /*
    * Serialize to folly::dynamic
@@ -61,6 +68,11 @@ struct RouteFields {
   RouteNextHopEntry fwd{RouteNextHopEntry::Action::DROP,
                         AdminDistance::MAX_ADMIN_DISTANCE};
   uint32_t flags{0};
+  // The class each client added the route with, if not 0.  Unlike the
+  // forwarding, these are kept through clone().
+  boost::container::flat_map<ClientID, RouteClassID> clientClassIDs;
+  // The class of the client with the best entry, which is the one used
+  RouteClassID classID{0};
 };
 
 /// Route<> Class
@@ -130,11 +142,18 @@ class Route : public NodeBaseT<Route<AddrT>, RouteFields<AddrT>> {
   const RouteNextHopEntry& getForwardInfo() const {
     return RouteBase::getFields()->fwd;
   }
+  RouteClassID getClassID() const {
+    return RouteBase::getFields()->classID;
+  }
+  RouteClassID getClassIDForClient(ClientID clientId) const;
   const RouteNextHopEntry * FOLLY_NULLABLE getEntryForClient(
       ClientID clientId) const {
     return RouteBase::getFields()
       ->nexthopsmulti.getEntryForClient(clientId);
   }
+  std::vector<ClientID> getClientIDs() const {
+    return RouteBase::getFields()->nexthopsmulti.getClientIDs();
+  }
   std::pair<ClientID, const RouteNextHopEntry *> getBestEntry() const {
     return RouteBase::getFields()->nexthopsmulti.getBestEntry();
   }
@@ -163,6 +182,7 @@ class Route : public NodeBaseT<Route<AddrT>, RouteFields<AddrT>> {
   void clearForward();
 
   void update(ClientID clientId, RouteNextHopEntry entry);
+  void setClassIDForClient(ClientID clientId, RouteClassID classID);
 
   void delEntryForClient(ClientID clientId);
 
@@ -219,6 +239,8 @@ class Route : public NodeBaseT<Route<AddrT>, RouteFields<AddrT>> {
     auto& flags = RouteBase::writableFields()->flags;
     flags &= ~(RESOLVED|PROCESSING|CONNECTED|UNRESOLVABLE);
   }
+  // Use the class of the client with the best entry, as the forwarding does
+  void updateClassID();
 
   // Inherit the constructors required for clone()
   using NodeBaseT<Route<AddrT>, RouteFields<AddrT>>::NodeBaseT;
@@ -17,15 +17,19 @@ namespace facebook { namespace fboss {
 
 namespace util {
 NextHop fromThrift(const NextHopThrift& nht) {
-  auto address = network::toIPAddress(nht.address);
-  NextHopWeight weight = static_cast<NextHopWeight>(nht.weight);
+  return fromThrift(nht.address, static_cast<NextHopWeight>(nht.weight));
+}
+
+NextHop fromThrift(
+    const network::thrift::BinaryAddress& addr,
+    NextHopWeight weight) {
+  auto address = network::toIPAddress(addr);
   bool v6LinkLocal = address.isV6() and address.isLinkLocal();
   // Only honor interface specified over thrift if the address
   // is a v6 link-local. Otherwise, consume it as an unresolved
   // next hop and let route resolution populate the interface.
-  if (nht.address.get_ifName() and v6LinkLocal) {
-    InterfaceID intfID =
-        util::getIDFromTunIntfName(*(nht.address.get_ifName()));
+  if (addr.get_ifName() and v6LinkLocal) {
+    InterfaceID intfID = util::getIDFromTunIntfName(*(addr.get_ifName()));
     return ResolvedNextHop(std::move(address), intfID, weight);
   } else {
     return UnresolvedNextHop(std::move(address), weight);
@@ -151,6 +151,10 @@ bool operator==(const UnresolvedNextHop& a, const UnresolvedNextHop& b);
 
 namespace util {
 NextHop fromThrift(const NextHopThrift& nht);
+// The next hop to addr, parsed straight from its bytes
+NextHop fromThrift(
+    const network::thrift::BinaryAddress& addr,
+    NextHopWeight weight);
 NextHop nextHopFromFollyDynamic(const folly::dynamic& nhopJson);
 }
 }}
@@ -10,6 +10,13 @@
 #include "RouteNextHopEntry.h"
 
 #include "fboss/agent/FbossError.h"
+#include "fboss/agent/state/NodeBase.h"
+
+#include <folly/hash/Hash.h>
+
+#include <mutex>
+#include <unordered_map>
+#include <vector>
 
 namespace {
 constexpr auto kNexthops = "nexthops";
@@ -19,6 +26,119 @@ constexpr auto kAdminDistance = "adminDistance";
 
 namespace facebook { namespace fboss {
 
+namespace {
+using NextHopSet = RouteNextHopEntry::NextHopSet;
+
+size_t hashNextHops(const NextHopSet& nhops) {
+  size_t hash = nhops.size();
+  for (const auto& nhop : nhops) {
+    uint32_t intf = nhop.isResolved() ? static_cast<uint32_t>(nhop.intf()) : 0;
+    hash = folly::hash::hash_combine(
+        hash, nhop.addr().hash(), nhop.weight(), nhop.isResolved(), intf);
+  }
+  return hash;
+}
+
+/*
+ * The distinct next hop sets in use.  The table only holds weak references;
+ * a set removes itself from the table when the last entry using it goes away.
+ */
+class NextHopSetTable {
+ public:
+  // Takes a copy of nhops, or moves it if it is an rvalue, only if no
+  // equal set is interned yet
+  template <typename Set>
+  std::shared_ptr<const NextHopSet> intern(Set&& nhops) {
+    auto hash = hashNextHops(nhops);
+    // Sets we look at may be released by another thread meanwhile.  Keep them
+    // alive until the lock is dropped, since releasing the last reference to a
+    // set locks the table to remove it.
+    std::vector<std::shared_ptr<const NextHopSet>> candidates;
+    std::lock_guard<std::mutex> g(lock_);
+    auto range = sets_.equal_range(hash);
+    for (auto it = range.first; it != range.second; ++it) {
+      auto existing = it->second.set.lock();
+      if (existing && *existing == nhops) {
+        return existing;
+      }
+      candidates.push_back(std::move(existing));
+    }
+    auto deleter = [this, hash](const NextHopSet* set) {
+      remove(hash, set);
+      delete set;
+    };
+    std::shared_ptr<const NextHopSet> interned(
+        new NextHopSet(std::forward<Set>(nhops)), deleter);
+    sets_.emplace(hash, Entry{interned.get(), interned});
+    return interned;
+  }
+
+  size_t size() const {
+    std::lock_guard<std::mutex> g(lock_);
+    return sets_.size();
+  }
+
+ private:
+  struct Entry {
+    const NextHopSet* ptr;
+    std::weak_ptr<const NextHopSet> set;
+  };
+
+  void remove(size_t hash, const NextHopSet* set) {
+    std::lock_guard<std::mutex> g(lock_);
+    auto range = sets_.equal_range(hash);
+    for (auto it = range.first; it != range.second; ++it) {
+      if (it->second.ptr == set) {
+        sets_.erase(it);
+        return;
+      }
+    }
+  }
+
+  mutable std::mutex lock_;
+  std::unordered_multimap<size_t, Entry> sets_;
+};
+
+NextHopSetTable& nextHopSetTable() {
+  // Never destroyed, as entries in static objects may outlive it
+  static auto* table = new NextHopSetTable();
+  return *table;
+}
+} // anonymous namespace
+
+std::shared_ptr<const RouteNextHopEntry::NextHopSet>
+RouteNextHopEntry::internNextHopSet(NextHopSet&& nhops) {
+  if (nhops.empty()) {
+    return emptyNextHopSet();
+  }
+  return nextHopSetTable().intern(std::move(nhops));
+}
+
+std::shared_ptr<const RouteNextHopEntry::NextHopSet>
+RouteNextHopEntry::internNextHopSet(const NextHopSet& nhops) {
+  if (nhops.empty()) {
+    return emptyNextHopSet();
+  }
+  return nextHopSetTable().intern(nhops);
+}
+
+const std::shared_ptr<const RouteNextHopEntry::NextHopSet>&
+RouteNextHopEntry::emptyNextHopSet() {
+  static auto* empty =
+      new std::shared_ptr<const NextHopSet>(std::make_shared<NextHopSet>());
+  return *empty;
+}
+
+void RouteNextHopEntry::accountMemory(NodeMemoryVisitor* visitor) const {
+  visitor->sharedBlock(
+      nhopSet_.get(),
+      sizeof(NextHopSet) + nhopSet_->capacity() * sizeof(NextHop));
+}
+
+size_t RouteNextHopEntry::numInternedNextHopSets() {
+  return nextHopSetTable().size();
+}
+
 namespace util {
 
 RouteNextHopSet
@@ -31,6 +151,22 @@ toRouteNextHopSet(std::vector<NextHopThrift> const& nhs) {
   return rnhs;
 }
 
+void toRouteNextHopSet(const UnicastRoute& route, RouteNextHopSet* nhops) {
+  nhops->clear();
+  if (!route.nextHops.empty()) {
+    nhops->reserve(route.nextHops.size());
+    for (const auto& nht : route.nextHops) {
+      nhops->emplace(fromThrift(nht));
+    }
+  } else {
+    // Addresses without weights are ECMP next hops
+    nhops->reserve(route.nextHopAddrs.size());
+    for (const auto& addr : route.nextHopAddrs) {
+      nhops->emplace(fromThrift(addr, ECMP_WEIGHT));
+    }
+  }
+}
+
 std::vector<NextHopThrift>
 fromRouteNextHopSet(RouteNextHopSet const& nhs) {
   std::vector<NextHopThrift> nhts;
@@ -43,11 +179,24 @@ fromRouteNextHopSet(RouteNextHopSet const& nhs) {
 
 } // namespace util
 
-RouteNextHopEntry::RouteNextHopEntry(NextHopSet nhopSet, AdminDistance distance)
+RouteNextHopEntry::RouteNextHopEntry(
+    NextHopSet&& nhopSet,
+    AdminDistance distance)
+    : adminDistance_(distance),
+      action_(Action::NEXTHOPS),
+      nhopSet_(internNextHopSet(std::move(nhopSet))) {
+  if (nhopSet_->empty()) {
+    throw FbossError("Empty nexthop set is passed to the RouteNextHopEntry");
+  }
+}
+
+RouteNextHopEntry::RouteNextHopEntry(
+    const NextHopSet& nhopSet,
+    AdminDistance distance)
     : adminDistance_(distance),
       action_(Action::NEXTHOPS),
-      nhopSet_(std::move(nhopSet)) {
-  if (nhopSet_.size() == 0) {
+      nhopSet_(internNextHopSet(nhopSet)) {
+  if (nhopSet_->empty()) {
     throw FbossError("Empty nexthop set is passed to the RouteNextHopEntry");
   }
 }
@@ -78,8 +227,9 @@ std::string RouteNextHopEntry::str() const {
 }
 
 bool operator==(const RouteNextHopEntry& a, const RouteNextHopEntry& b) {
+  // Next hop sets are interned, so equal sets are the same object
   return (a.getAction() == b.getAction()
-          and a.getNextHopSet() == b.getNextHopSet()
+          and &a.getNextHopSet() == &b.getNextHopSet()
           and a.getAdminDistance() == b.getAdminDistance());
 }
 
@@ -87,9 +237,11 @@ bool operator< (const RouteNextHopEntry& a, const RouteNextHopEntry& b) {
   if (a.getAdminDistance() != b.getAdminDistance()) {
     return a.getAdminDistance() < b.getAdminDistance();
   }
-  return ((a.getAction() == b.getAction())
-          ? (a.getNextHopSet() < b.getNextHopSet())
-          : a.getAction() < b.getAction());
+  if (a.getAction() != b.getAction()) {
+    return a.getAction() < b.getAction();
+  }
+  return &a.getNextHopSet() != &b.getNextHopSet() &&
+      a.getNextHopSet() < b.getNextHopSet();
 }
 
 // Methods for RouteNextHopEntry
@@ -127,7 +279,7 @@ folly::dynamic RouteNextHopEntry::toFollyDynamic() const {
   folly::dynamic entry = folly::dynamic::object;
   entry[kAction] = forwardActionStr(action_);
   folly::dynamic nhops = folly::dynamic::array;
-  for (const auto& nhop: nhopSet_) {
+  for (const auto& nhop: *nhopSet_) {
     nhops.push_back(nhop.toFollyDynamic());
   }
   entry[kNexthops] = std::move(nhops);
@@ -144,9 +296,11 @@ RouteNextHopEntry::fromFollyDynamic(const folly::dynamic& entryJson) {
       : AdminDistance(entryJson[kAdminDistance].asInt());
   RouteNextHopEntry entry(Action::DROP, adminDistance);
   entry.action_ = action;
+  NextHopSet nhops;
   for (const auto& nhop : entryJson[kNexthops]) {
-    entry.nhopSet_.insert(util::nextHopFromFollyDynamic(nhop));
+    nhops.insert(util::nextHopFromFollyDynamic(nhop));
   }
+  entry.nhopSet_ = internNextHopSet(std::move(nhops));
   return entry;
 }
 
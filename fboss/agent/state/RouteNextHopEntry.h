@@ -13,27 +13,33 @@
 
 #include <folly/dynamic.h>
 
+#include <memory>
+
 #include "fboss/agent/state/RouteNextHop.h"
 #include "fboss/agent/state/RouteTypes.h"
 
 namespace facebook { namespace fboss {
 
+class NodeMemoryVisitor;
+
 class RouteNextHopEntry {
  public:
   using Action = RouteForwardAction;
   using NextHopSet = boost::container::flat_set<NextHop>;
 
   RouteNextHopEntry(Action action, AdminDistance distance)
-      : adminDistance_(distance), action_(action) {
+      : adminDistance_(distance),
+        action_(action),
+        nhopSet_(emptyNextHopSet()) {
     CHECK_NE(action_, Action::NEXTHOPS);
   }
 
-  RouteNextHopEntry(NextHopSet nhopSet, AdminDistance distance);
+  RouteNextHopEntry(NextHopSet&& nhopSet, AdminDistance distance);
+  // Only copies nhopSet if no other entry has the same next hops
+  RouteNextHopEntry(const NextHopSet& nhopSet, AdminDistance distance);
 
   RouteNextHopEntry(NextHop nhop, AdminDistance distance)
-      : adminDistance_(distance), action_(Action::NEXTHOPS) {
-    nhopSet_.emplace(std::move(nhop));
-  }
+      : RouteNextHopEntry(NextHopSet{std::move(nhop)}, distance) {}
 
   AdminDistance getAdminDistance() const {
     return adminDistance_;
@@ -44,7 +50,7 @@ class RouteNextHopEntry {
   }
 
   const NextHopSet& getNextHopSet() const {
-    return nhopSet_;
+    return *nhopSet_;
   }
 
   // Get the sum of the weights of all the nexthops in the entry
@@ -73,16 +79,37 @@ class RouteNextHopEntry {
     return entry.getAdminDistance() == getAdminDistance();
   }
 
+  // Report the next hop set, shared by all entries with the same next hops
+  void accountMemory(NodeMemoryVisitor* visitor) const;
+
   // Reset the NextHopSet
   void reset() {
-    nhopSet_.clear();
+    nhopSet_ = emptyNextHopSet();
     action_ = Action::DROP;
   }
 
+  /*
+   * The number of distinct non-empty next hop sets currently in use by any
+   * RouteNextHopEntry.
+   */
+  static size_t numInternedNextHopSets();
+
  private:
+  /*
+   * Next hop sets are interned: every entry with the same next hops points at
+   * the same immutable set, which is freed when the last such entry goes
+   * away.  This keeps a single copy of a next hop set shared by many routes,
+   * and lets entries be compared by set pointer.
+   */
+  static std::shared_ptr<const NextHopSet> internNextHopSet(
+      NextHopSet&& nhops);
+  static std::shared_ptr<const NextHopSet> internNextHopSet(
+      const NextHopSet& nhops);
+  static const std::shared_ptr<const NextHopSet>& emptyNextHopSet();
+
   AdminDistance adminDistance_;
   Action action_{Action::DROP};
-  NextHopSet nhopSet_;
+  std::shared_ptr<const NextHopSet> nhopSet_;
 };
 
 /**
@@ -109,6 +136,13 @@ namespace util {
 RouteNextHopSet
 toRouteNextHopSet(std::vector<NextHopThrift> const& nhts);
 
+/**
+ * Convert the next hops of a thrift route, taken from route.nextHops or
+ * else route.nextHopAddrs, into nhops.  nhops is cleared first, so one set
+ * can be reused for all the routes of a batch.
+ */
+void toRouteNextHopSet(const UnicastRoute& route, RouteNextHopSet* nhops);
+
 /**
  * Convert RouteNextHops to thrift representaion of nexthops
  */
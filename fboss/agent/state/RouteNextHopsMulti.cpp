@@ -11,6 +11,7 @@
 #include "fboss/agent/AddressUtil.h"
 #include "fboss/agent/FbossError.h"
 #include "fboss/agent/Utils.h"
+#include "fboss/agent/state/NodeBase.h"
 #include "fboss/agent/state/StateUtils.h"
 
 namespace {
@@ -129,6 +130,14 @@ void RouteNextHopsMulti::delEntryForClient(ClientID clientId) {
   }
 }
 
+void RouteNextHopsMulti::accountMemory(NodeMemoryVisitor* visitor) const {
+  using Entry = decltype(map_)::value_type;
+  visitor->ownBytes(map_.capacity() * sizeof(Entry));
+  for (const auto& entry : map_) {
+    entry.second.accountMemory(visitor);
+  }
+}
+
 const RouteNextHopEntry* RouteNextHopsMulti::getEntryForClient(
     ClientID clientId) const {
   auto iter = map_.find(clientId);
@@ -138,6 +147,15 @@ const RouteNextHopEntry* RouteNextHopsMulti::getEntryForClient(
   return &iter->second;
 }
 
+std::vector<ClientID> RouteNextHopsMulti::getClientIDs() const {
+  std::vector<ClientID> clients;
+  clients.reserve(map_.size());
+  for (const auto& entry : map_) {
+    clients.push_back(entry.first);
+  }
+  return clients;
+}
+
 bool RouteNextHopsMulti::isSame(ClientID id,
                                 const RouteNextHopEntry& nhe) const {
   auto entry = getEntryForClient(id);
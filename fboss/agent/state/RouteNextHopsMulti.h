@@ -73,9 +73,13 @@ class RouteNextHopsMulti {
 
   void delEntryForClient(ClientID clientId);
 
+  void accountMemory(NodeMemoryVisitor* visitor) const;
+
   const RouteNextHopEntry* FOLLY_NULLABLE
   getEntryForClient(ClientID clientId) const;
 
+  std::vector<ClientID> getClientIDs() const;
+
   std::pair<ClientID, const RouteNextHopEntry *> getBestEntry() const;
 
   bool isSame(ClientID clientId, const RouteNextHopEntry& nhe) const;
@@ -52,6 +52,31 @@ RouteTable* RouteTable::modify(std::shared_ptr<SwitchState>* state) {
   return clonedRT.get();
 }
 
+folly::dynamic RouteTable::toFollyDynamicAt(
+    JsonPath path, size_t offset, size_t limit) const {
+  // Don't serialize both RIBs when only one of them is wanted
+  if (!path.empty() && path[0] == kRibV4) {
+    return getRibV4()->toFollyDynamicAt(path.subpiece(1), offset, limit);
+  } else if (!path.empty() && path[0] == kRibV6) {
+    return getRibV6()->toFollyDynamicAt(path.subpiece(1), offset, limit);
+  }
+  return selectJsonPath(toFollyDynamic(), path);
+}
+
+std::shared_ptr<RouteTable> RouteTable::applyJsonPatch(
+    JsonPath path, const folly::dynamic& patch) const {
+  if (!path.empty() && path[0] == kRibV4) {
+    auto table = clone();
+    table->setRib(getRibV4()->applyJsonPatch(path.subpiece(1), patch));
+    return table;
+  } else if (!path.empty() && path[0] == kRibV6) {
+    auto table = clone();
+    table->setRib(getRibV6()->applyJsonPatch(path.subpiece(1), patch));
+    return table;
+  }
+  return NodeBaseT::applyJsonPatch(path, patch);
+}
+
 RouteTableFields
 RouteTableFields::fromFollyDynamic(const folly::dynamic& rtableJson) {
   RouteTableFields rtable(RouterID(rtableJson[kRouterId].asInt()));
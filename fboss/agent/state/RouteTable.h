@@ -67,6 +67,16 @@ class RouteTable : public NodeBaseT<RouteTable, RouteTableFields> {
     return this->getFields()->toFollyDynamic();
   }
 
+  folly::dynamic
+  toFollyDynamicAt(JsonPath path, size_t offset, size_t limit) const override;
+
+  /*
+   * Return a new version of the table with patch merged in at path, only
+   * deserializing the part of the rib that path leads into.
+   */
+  std::shared_ptr<RouteTable> applyJsonPatch(
+      JsonPath path, const folly::dynamic& patch) const;
+
   RouterID getID() const {
     return getFields()->id;
   }
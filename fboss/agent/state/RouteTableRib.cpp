@@ -45,8 +45,8 @@ FBOSS_INSTANTIATE_NODE_MAP(
     RouteTableRibNodeMap<folly::IPAddressV6>,
     RouteTableRibNodeMapTraits<folly::IPAddressV6>);
 
-template <typename AddrT>
-folly::dynamic RouteTableRib<AddrT>::toFollyDynamic() const {
+template <typename AddrT, typename LpmT>
+folly::dynamic RouteTableRib<AddrT, LpmT>::toFollyDynamic() const {
   folly::dynamic routesJson = folly::dynamic::array;
   for (const auto& route: *nodeMap_) {
     routesJson.push_back(route->toFollyDynamic());
@@ -56,21 +56,130 @@ folly::dynamic RouteTableRib<AddrT>::toFollyDynamic() const {
   return routes;
 }
 
-template <typename AddrT>
-std::shared_ptr<RouteTableRib<AddrT>>
-RouteTableRib<AddrT>::fromFollyDynamic(const folly::dynamic& routes) {
-  auto rib = std::make_shared<RouteTableRib<AddrT>>();
+template <typename AddrT, typename LpmT>
+folly::dynamic RouteTableRib<AddrT, LpmT>::toFollyDynamicAt(
+    JsonPath path, size_t offset, size_t limit) const {
+  if (path.empty() || (path.size() == 1 && path[0] == kRoutes)) {
+    folly::dynamic routesJson = folly::dynamic::array;
+    auto it = nodeMap_->begin();
+    for (size_t i = 0; i < offset && it != nodeMap_->end(); ++i) {
+      ++it;
+    }
+    for (; it != nodeMap_->end() && routesJson.size() < limit; ++it) {
+      routesJson.push_back((*it)->toFollyDynamic());
+    }
+    if (!path.empty()) {
+      return routesJson;
+    }
+    folly::dynamic routes = folly::dynamic::object;
+    routes[kRoutes] = std::move(routesJson);
+    return routes;
+  }
+  if (path[0] == kRoutes) {
+    auto index = folly::tryTo<size_t>(path[1]);
+    if (!index.hasValue() || index.value() >= size()) {
+      throw FbossError("no route \"", path[1], "\" in rib");
+    }
+    auto it = nodeMap_->begin();
+    for (size_t i = 0; i < index.value(); ++i) {
+      ++it;
+    }
+    return (*it)->toFollyDynamicAt(path.subpiece(2), offset, limit);
+  }
+  throw FbossError("no state found at path element \"", path[0], "\"");
+}
+
+template <typename AddrT, typename LpmT>
+std::shared_ptr<RouteTableRib<AddrT, LpmT>>
+RouteTableRib<AddrT, LpmT>::fromFollyDynamic(const folly::dynamic& routes) {
+  auto rib = std::make_shared<RouteTableRib<AddrT, LpmT>>();
   auto routesJson = routes[kRoutes];
   for (const auto& routeJson: routesJson) {
     auto route = Route<AddrT>::fromFollyDynamic(routeJson);
     rib->addRoute(route);
     rib->addRouteInRadixTree(route);
+    rib->reindexRoute(route->prefix(), nullptr, route.get());
   }
   return rib;
 }
 
-template <typename AddrT>
-RouteTableRib<AddrT>* RouteTableRib<AddrT>::modify(
+template <typename AddrT, typename LpmT>
+std::shared_ptr<RouteTableRib<AddrT, LpmT>>
+RouteTableRib<AddrT, LpmT>::applyJsonPatch(
+    JsonPath path, const folly::dynamic& patch) const {
+  if (path.size() < 2 || path[0] != kRoutes) {
+    auto json = toFollyDynamic();
+    mergeJsonPatchAt(&json, path, patch);
+    return fromFollyDynamic(json);
+  }
+  auto index = folly::tryTo<size_t>(path[1]);
+  if (!index.hasValue() || index.value() >= size()) {
+    throw FbossError("no route \"", path[1], "\" in rib");
+  }
+  auto it = nodeMap_->begin();
+  for (size_t i = 0; i < index.value(); ++i) {
+    ++it;
+  }
+  auto oldRoute = *it;
+  std::shared_ptr<RouteType> newRoute =
+      oldRoute->applyJsonPatch(path.subpiece(2), patch);
+
+  auto rib = clone();
+  if (!rib->radixTreeInSync_) {
+    // The clone did not keep a copy of radixTree_.  Fill it with the same
+    // routes, without clearing their forwarding info as
+    // cloneToRadixTreeWithForwardClear() would.
+    rib->radixTree_.clear();
+    for (const auto& route : *rib->nodeMap_) {
+      rib->addRouteInRadixTree(route);
+    }
+    rib->radixTreeInSync_ = true;
+  }
+  if (newRoute->prefix() == oldRoute->prefix()) {
+    rib->updateRoute(newRoute);
+    rib->reindexRoute(oldRoute->prefix(), oldRoute.get(), newRoute.get());
+  } else {
+    // The patch moved the route to another prefix
+    rib->removeRoute(oldRoute);
+    rib->reindexRoute(oldRoute->prefix(), oldRoute.get(), nullptr);
+    rib->addRoute(newRoute);
+    rib->reindexRoute(newRoute->prefix(), nullptr, newRoute.get());
+  }
+  return rib;
+}
+
+template <typename AddrT, typename LpmT>
+void RouteTableRib<AddrT, LpmT>::removeClientPrefix(
+    ClientID clientId, const Prefix& prefix) {
+  CHECK(!isPublished());
+  auto iter = clientPrefixes_.find(clientId);
+  if (iter == clientPrefixes_.end()) {
+    return;
+  }
+  iter->second.erase(prefix);
+  if (iter->second.empty()) {
+    clientPrefixes_.erase(iter);
+  }
+}
+
+template <typename AddrT, typename LpmT>
+void RouteTableRib<AddrT, LpmT>::reindexRoute(
+    const Prefix& prefix, const RouteType* oldRoute,
+    const RouteType* newRoute) {
+  if (oldRoute) {
+    for (auto clientId : oldRoute->getClientIDs()) {
+      removeClientPrefix(clientId, prefix);
+    }
+  }
+  if (newRoute) {
+    for (auto clientId : newRoute->getClientIDs()) {
+      addClientPrefix(clientId, prefix);
+    }
+  }
+}
+
+template <typename AddrT, typename LpmT>
+RouteTableRib<AddrT, LpmT>* RouteTableRib<AddrT, LpmT>::modify(
     RouterID id,
     std::shared_ptr<SwitchState>* state) {
   if (!isPublished()) {
@@ -88,9 +197,12 @@ RouteTableRib<AddrT>* RouteTableRib<AddrT>::modify(
   // modify() is that we have a cloned RouteTableRib return if the current one
   // is published. To make sure the cloned RouteTableRib works, we need to
   // ensure radixTree_ and nodeMap_ in sync before we return a newly cloned rib.
-  for (const auto& node: nodeMap_->getAllNodes()) {
-    clonedRib->radixTree_.insert(node.first.network, node.first.mask,
-                                 node.second);
+  if (!clonedRib->radixTreeInSync_) {
+    for (const auto& node: nodeMap_->getAllNodes()) {
+      clonedRib->radixTree_.insert(node.first.network, node.first.mask,
+                                   node.second);
+    }
+    clonedRib->radixTreeInSync_ = true;
   }
   CHECK_EQ(clonedRib->size(), clonedRib->radixTree_.size());
 
@@ -100,22 +212,31 @@ RouteTableRib<AddrT>* RouteTableRib<AddrT>::modify(
   return clonedRibPtr;
 }
 
-template <typename AddrT>
-void RouteTableRib<AddrT>::addRoute(
+template <typename AddrT, typename LpmT>
+void RouteTableRib<AddrT, LpmT>::addRoute(
     const std::shared_ptr<Route<AddrT>>& route) {
   nodeMap_->addRoute(route);
+  if (radixTreeInSync_) {
+    addRouteInRadixTree(route);
+  }
 }
 
-template <typename AddrT>
-void RouteTableRib<AddrT>::updateRoute(
+template <typename AddrT, typename LpmT>
+void RouteTableRib<AddrT, LpmT>::updateRoute(
     const std::shared_ptr<Route<AddrT>>& route) {
   nodeMap_->updateRoute(route);
+  if (radixTreeInSync_) {
+    updateRouteInRadixTree(route);
+  }
 }
 
-template <typename AddrT>
-void RouteTableRib<AddrT>::removeRoute(
+template <typename AddrT, typename LpmT>
+void RouteTableRib<AddrT, LpmT>::removeRoute(
     const std::shared_ptr<Route<AddrT>>& route) {
   nodeMap_->removeRoute(route);
+  if (radixTreeInSync_) {
+    removeRouteInRadixTree(route);
+  }
 }
 
 template class RouteTableRib<folly::IPAddressV4>;
@@ -13,8 +13,16 @@
 #include "fboss/agent/FbossError.h"
 #include "fboss/agent/types.h"
 #include "fboss/agent/state/NodeMap.h"
+#include "fboss/agent/state/PersistentNodeContainer.h"
 #include "fboss/agent/state/RouteTypes.h"
 #include "fboss/lib/RadixTree.h"
+#include "fboss/lib/StrideTrie.h"
+
+#include <boost/container/flat_map.hpp>
+#include <folly/Range.h>
+
+#include <type_traits>
+#include <utility>
 
 namespace facebook { namespace fboss {
 
@@ -22,11 +30,26 @@ template<typename AddrT>
 class Route;
 class SwitchState;
 
+/*
+ * The longest prefix match structure used by RouteTableRib.  The agent uses
+ * RadixTree unless built with FBOSS_RIB_STRIDE_TRIE, which switches every RIB
+ * to the StrideTrie.
+ */
+#ifdef FBOSS_RIB_STRIDE_TRIE
+template <typename AddrT>
+using RibLpm = facebook::network::StrideTrie<AddrT,
+      std::shared_ptr<Route<AddrT>>>;
+#else
 template <typename AddrT>
+using RibLpm = facebook::network::RadixTree<AddrT,
+      std::shared_ptr<Route<AddrT>>>;
+#endif
+
+template <typename AddrT, typename LpmT = RibLpm<AddrT>>
 class RouteTableRib;
 
 template<typename AddrT> using RouteTableRibNodeMapTraits
-  = NodeMapTraits<RoutePrefix<AddrT>, Route<AddrT>>;
+  = PersistentNodeMapTraits<RoutePrefix<AddrT>, Route<AddrT>>;
 
 template<typename AddrT>
 class RouteTableRibNodeMap
@@ -66,7 +89,12 @@ class RouteTableRibNodeMap
   friend class CloneAllocator;
 };
 
-template<typename AddrT>
+/*
+ * LpmT is the structure used for longest prefix matches on the RIB, with the
+ * interface of facebook::network::RadixTree.  Only RibLpm<AddrT> is
+ * instantiated in RouteTableRib.cpp.
+ */
+template<typename AddrT, typename LpmT>
 class RouteTableRib : public NodeBase {
  public:
   using RoutesNodeMap = RouteTableRibNodeMap<AddrT>;
@@ -78,8 +106,10 @@ class RouteTableRib : public NodeBase {
 
   using Prefix =  RoutePrefix<AddrT>;
   using RouteType = Route<AddrT>;
-  using RoutesRadixTree = facebook::network::RadixTree<AddrT,
-        std::shared_ptr<Route<AddrT>>>;
+  using RoutesRadixTree = LpmT;
+  // The prefixes of the routes that have next hops from a client.  The
+  // values are unused.
+  using ClientPrefixes = PersistentNodeContainer<Prefix, bool>;
 
   bool empty() const {
     return nodeMap_->empty();
@@ -119,6 +149,17 @@ class RouteTableRib : public NodeBase {
     // Note: this is the default NodeMap clone(), only the nodeMap pointer is
     // cloned, while all the routes are still the old route pointer.
     routeTableRib->nodeMap_ = nodeMap_->clone();
+    // Like nodeMap_, the client index shares its storage with the original
+    routeTableRib->clientPrefixes_ = clientPrefixes_;
+    // A persistent radix tree (one that shares its storage with its copies,
+    // like StrideTrie) is cheap to copy, so the clone keeps a copy of it in
+    // sync with nodeMap_ rather than rebuilding it in
+    // `cloneToRadixTreeWithForwardClear()`.  A published rib's radixTree_
+    // always holds the same routes as its nodeMap_.
+    if (isPublished()) {
+      copyRadixTree(routeTableRib.get(),
+          std::integral_constant<bool, kPersistentRadixTree>());
+    }
     return routeTableRib;
   }
 
@@ -127,6 +168,14 @@ class RouteTableRib : public NodeBase {
    */
   folly::dynamic toFollyDynamic() const;
 
+  /*
+   * Serialize part of the rib, without serializing the routes that path
+   * doesn't lead to.  If path names the rib itself (or its routes list),
+   * only the routes in [offset, offset + limit) are serialized.
+   */
+  folly::dynamic toFollyDynamicAt(
+      JsonPath path, size_t offset, size_t limit) const override;
+
    /*
     * Deserialize from folly::dynamic
     */
@@ -140,11 +189,20 @@ class RouteTableRib : public NodeBase {
        return fromFollyDynamic(folly::parseJson(jsonStr));
   }
 
+  /*
+   * Return a new version of the rib with patch merged in at path.  If path
+   * leads into a route, only that route is deserialized again and the other
+   * routes are shared with this rib.
+   */
+  std::shared_ptr<RouteTableRib> applyJsonPatch(
+      JsonPath path, const folly::dynamic& patch) const;
+
   /*
    * The following functions modify the static state.
    * These should only be called on unpublished objects which are only visible
    * to a single thread.
-   * To add/update/remove a route, we only do it on nodeMap_
+   * To add/update/remove a route, we only do it on nodeMap_, unless the
+   * radixTree_ is being kept in sync with it since the rib was cloned.
    */
   void addRoute(const std::shared_ptr<Route<AddrT>>& route);
   void updateRoute(const std::shared_ptr<Route<AddrT>>& route);
@@ -153,9 +211,49 @@ class RouteTableRib : public NodeBase {
     return nodeMap_->getRouteIf(prefix);
   }
 
+  /*
+   * The rib also indexes its prefixes by the clients that have next hops for
+   * them, so that a client's routes can be found without walking the whole
+   * rib.  RouteUpdater updates the index whenever it adds or deletes a
+   * client's next hops for a prefix.
+   */
+  const ClientPrefixes* FOLLY_NULLABLE getClientPrefixesIf(
+      ClientID clientId) const {
+    auto iter = clientPrefixes_.find(clientId);
+    return iter == clientPrefixes_.end() ? nullptr : &iter->second;
+  }
+  const boost::container::flat_map<ClientID, ClientPrefixes>&
+  getAllClientPrefixes() const {
+    return clientPrefixes_;
+  }
+  void addClientPrefix(ClientID clientId, const Prefix& prefix) {
+    CHECK(!isPublished());
+    clientPrefixes_[clientId].insert(std::make_pair(prefix, true));
+  }
+  void removeClientPrefix(ClientID clientId, const Prefix& prefix);
+  // Update the index for the route at prefix changing from oldRoute to
+  // newRoute, either of which may be null
+  void reindexRoute(const Prefix& prefix, const RouteType* oldRoute,
+                    const RouteType* newRoute);
+
   void cloneToRadixTreeWithForwardClear() {
     // We should expect this function is called only before we publish the rib
     CHECK(!isPublished());
+    if (radixTreeInSync_) {
+      // radixTree_ already holds every route, only clone and clear them.
+      // From here on the routes in radixTree_ differ from those in nodeMap_
+      // until dedupRoutes() puts them back in nodeMap_.
+      radixTreeInSync_ = false;
+      for (auto& node : radixTree_) {
+        auto& route = node.value();
+        if (route->isPublished()) {
+          route = route->clone(RouteType::Fields::COPY_PREFIX_AND_NEXTHOPS);
+        }
+        route->clearForward();
+      }
+      CHECK_EQ(size(), radixTree_.size());
+      return;
+    }
     radixTree_.clear();
     for (const auto& node: nodeMap_->getAllNodes()) {
       auto route = node.second;
@@ -182,6 +280,17 @@ class RouteTableRib : public NodeBase {
     return citr != radixTree_.end() ? citr->value() : nullptr;
   }
 
+  /*
+   * Look up the longest match of each of nexthops, storing the route for
+   * nexthops[i] (or null) in routes[i].  routes must be at least as long as
+   * nexthops.  If the radix tree supports batched lookups, as StrideTrie
+   * does, the lookups are run together so their memory accesses overlap.
+   */
+  void longestMatch(folly::Range<const AddrT*> nexthops,
+                    std::shared_ptr<Route<AddrT>>* routes) const {
+    longestMatchImpl(nexthops, routes, 0);
+  }
+
   void addRouteInRadixTree(const std::shared_ptr<Route<AddrT>>& route) {
     auto inserted = radixTree_.insert(route->prefix().network,
       route->prefix().mask, route).second;
@@ -209,8 +318,68 @@ class RouteTableRib : public NodeBase {
   }
 
  private:
+  static constexpr bool kPersistentRadixTree =
+    std::is_copy_constructible<RoutesRadixTree>::value;
+
+  void copyRadixTree(RouteTableRib* clone, std::true_type) const {
+    clone->radixTree_ = radixTree_;
+    clone->radixTreeInSync_ = true;
+  }
+  void copyRadixTree(RouteTableRib* /*clone*/, std::false_type) const {}
+
+  // A persistent radix tree reports the chunks it shares with its copies,
+  // and a RadixTree has at most two nodes per route
+  struct ChunkAccounter {
+    void operator()(const void* chunk, size_t bytes) const {
+      visitor->sharedBlock(chunk, bytes);
+    }
+    NodeMemoryVisitor* visitor;
+  };
+  template <typename TreeT = RoutesRadixTree>
+  auto accountRadixTreeMemory(NodeMemoryVisitor* visitor, int) const
+      -> decltype(std::declval<const TreeT&>().forEachChunk(
+             std::declval<ChunkAccounter>())) {
+    radixTree_.forEachChunk(ChunkAccounter{visitor});
+  }
+  template <typename TreeT = RoutesRadixTree>
+  void accountRadixTreeMemory(NodeMemoryVisitor* visitor, long) const {
+    visitor->ownBytes(
+        2 * radixTree_.size() * sizeof(typename TreeT::TreeNode));
+  }
+
+  // Batched lookups, for radix trees that support them
+  template <typename TreeT = RoutesRadixTree>
+  auto longestMatchImpl(folly::Range<const AddrT*> nexthops,
+                        std::shared_ptr<Route<AddrT>>* routes, int) const
+      -> decltype(std::declval<const TreeT&>().longestMatch(
+             nexthops, std::declval<typename TreeT::ConstIterator*>())) {
+    constexpr size_t kBatchSize = 64;
+    typename TreeT::ConstIterator matches[kBatchSize];
+    for (size_t start = 0; start < nexthops.size(); start += kBatchSize) {
+      auto batch = nexthops.subpiece(start, kBatchSize);
+      radixTree_.longestMatch(batch, matches);
+      for (size_t i = 0; i < batch.size(); ++i) {
+        routes[start + i] =
+          matches[i] != radixTree_.end() ? matches[i]->value() : nullptr;
+      }
+    }
+  }
+  void longestMatchImpl(folly::Range<const AddrT*> nexthops,
+                        std::shared_ptr<Route<AddrT>>* routes, long) const {
+    for (size_t i = 0; i < nexthops.size(); ++i) {
+      routes[i] = longestMatch(nexthops[i]);
+    }
+  }
+
   RoutesRadixTree radixTree_;
   std::shared_ptr<RoutesNodeMap> nodeMap_;
+  boost::container::flat_map<ClientID, ClientPrefixes> clientPrefixes_;
+  // Whether addRoute(), updateRoute() and removeRoute() also apply the change
+  // to radixTree_, which then holds the same routes as nodeMap_
+  bool radixTreeInSync_{false};
 };
 
+template <typename AddrT, typename LpmT>
+constexpr bool RouteTableRib<AddrT, LpmT>::kPersistentRadixTree;
+
 }}
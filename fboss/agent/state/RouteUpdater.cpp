@@ -10,10 +10,19 @@
 // Copyright 2004-present Facebook.  All rights reserved.
 #include "RouteUpdater.h"
 
+#include <algorithm>
+#include <map>
 #include <numeric>
+#include <thread>
+#include <tuple>
+#include <vector>
 
 #include <boost/math/common_factor.hpp>
+#include <folly/Range.h>
+#include <folly/ScopeGuard.h>
+#include <folly/small_vector.h>
 #include <folly/logging/xlog.h>
+#include <gflags/gflags.h>
 
 #include "fboss/agent/FbossError.h"
 #include "fboss/agent/if/gen-cpp2/ctrl_types.h"
@@ -33,12 +42,22 @@ using boost::container::flat_map;
 using boost::container::flat_set;
 using folly::CIDRNetwork;
 
+DEFINE_bool(batch_route_resolution, false,
+            "Resolve each distinct next hop set once, instead of resolving "
+            "every route that uses it");
+DEFINE_int32(route_resolution_threads, 0,
+             "Number of threads to apply batched route resolution results "
+             "on. 0 applies them on the thread doing the update");
+
 namespace facebook { namespace fboss {
 
 static const
 RouteUpdater::PrefixV6 kIPv6LinkLocalPrefix{folly::IPAddressV6("fe80::"), 64};
 static const auto kInterfaceRouteClientId =
   StdClientIds2ClientID(StdClientIds::INTERFACE_ROUTE);
+// Route lookups for this many next hops of a route are done without
+// allocating
+static constexpr size_t kInlineNextHops = 8;
 
 using std::make_shared;
 
@@ -99,11 +118,13 @@ auto RouteUpdater::makeClone(RibT* rib) -> decltype(rib->rib.get()) {
 
 template<typename PrefixT, typename RibT>
 void RouteUpdater::addRouteImpl(const PrefixT& prefix, RibT *ribCloned,
-                                ClientID clientId, RouteNextHopEntry entry) {
+                                ClientID clientId, RouteNextHopEntry entry,
+                                RouteClassID classID) {
   typedef Route<typename PrefixT::AddressT> RouteT;
   auto rib = ribCloned->rib.get();
   auto old = rib->exactMatch(prefix);
-  if (old && old->has(clientId, entry)) {
+  if (old && old->has(clientId, entry) &&
+      old->getClassIDForClient(clientId) == classID) {
       return;
   }
   rib = makeClone(ribCloned);
@@ -122,27 +143,30 @@ void RouteUpdater::addRouteImpl(const PrefixT& prefix, RibT *ribCloned,
       newRoute = old;
     }
     newRoute->update(clientId, std::move(entry));
+    newRoute->setClassIDForClient(clientId, classID);
     XLOG(DBG3) << "Updated route " << newRoute->str();
   } else {
     auto newRoute = make_shared<RouteT>(prefix, clientId, std::move(entry));
+    newRoute->setClassIDForClient(clientId, classID);
     rib->addRoute(newRoute);
     XLOG(DBG3) << "Added route " << newRoute->str();
   }
+  rib->addClientPrefix(clientId, prefix);
 }
 
 void RouteUpdater::addRoute(
     RouterID id, const folly::IPAddress& network, uint8_t mask,
-    ClientID clientId, RouteNextHopEntry entry) {
+    ClientID clientId, RouteNextHopEntry entry, RouteClassID classID) {
   if (network.isV4()) {
     PrefixV4 prefix{network.asV4().mask(mask), mask};
-    addRouteImpl(prefix, getRibV4(id), clientId, std::move(entry));
+    addRouteImpl(prefix, getRibV4(id), clientId, std::move(entry), classID);
   } else {
     PrefixV6 prefix{network.asV6().mask(mask), mask};
     if (prefix.network.isLinkLocal()) {
       XLOG(DBG2) << "Ignoring v6 link-local interface route: " << prefix.str();
       return;
     }
-    addRouteImpl(prefix, getRibV6(id), clientId, std::move(entry));
+    addRouteImpl(prefix, getRibV6(id), clientId, std::move(entry), classID);
   }
 }
 
@@ -192,6 +216,7 @@ void RouteUpdater::delRouteImpl(
     rib->updateRoute(old);
   }
   old->delEntryForClient(clientId);
+  rib->removeClientPrefix(clientId, prefix);
   // TODO Do I need to publish the change??
   XLOG(DBG3) << "Deleted nexthops for client " << clientId << " from route "
              << prefix.str();
@@ -216,28 +241,19 @@ void RouteUpdater::delRoute(
 template<typename AddrT, typename RibT>
 void RouteUpdater::removeAllRoutesForClientImpl(RibT *ribCloned,
                                                 ClientID clientId) {
-  auto rib = makeClone(ribCloned);
-
-  std::vector<std::shared_ptr<Route<AddrT>>> routesToDelete;
-
-  // make sure rib is cloned before any change
-  CHECK(ribCloned->cloned);
-  for (auto& routeNode : rib->writableRoutes()->writableNodes()) {
-    auto route = routeNode.second;
-    if (route->isPublished()) {
-      route = route->clone();
-      routeNode.second = route;
-    }
-    route->delEntryForClient(clientId);
-    if (route->hasNoEntry()) {
-      // The nexthops we removed was the only one.  Delete the route.
-      routesToDelete.push_back(routeNode.second);
-    }
+  // Only visit the client's own routes, found through the rib's client index
+  auto clientPrefixes = ribCloned->rib->getClientPrefixesIf(clientId);
+  if (!clientPrefixes) {
+    return;
   }
-
-  // Now, delete whatever routes went from 1 nexthoplist to 0.
-  for (std::shared_ptr<Route<AddrT>>& route : routesToDelete) {
-    rib->removeRoute(route);
+  // Copy the prefixes out first, as deleting the routes modifies the index
+  std::vector<RoutePrefix<AddrT>> prefixes;
+  prefixes.reserve(clientPrefixes->size());
+  for (const auto& entry : *clientPrefixes) {
+    prefixes.push_back(entry.first);
+  }
+  for (const auto& prefix : prefixes) {
+    delRouteImpl(prefix, ribCloned, clientId);
   }
 }
 
@@ -246,6 +262,49 @@ void RouteUpdater::removeAllRoutesForClient(RouterID rid, ClientID clientId) {
   removeAllRoutesForClientImpl<IPAddressV6>(getRibV6(rid), clientId);
 }
 
+template<typename PrefixT, typename RibT>
+void RouteUpdater::removeStaleRoutesForClientImpl(
+    RibT *ribCloned, ClientID clientId, std::vector<PrefixT> current) {
+  if (!ribCloned) {
+    return;
+  }
+  std::sort(current.begin(), current.end());
+  auto clientPrefixes = ribCloned->rib->getClientPrefixesIf(clientId);
+  if (!clientPrefixes) {
+    return;
+  }
+  // Find the stale prefixes first, as deleting them modifies the rib
+  std::vector<PrefixT> stale;
+  for (const auto& entry : *clientPrefixes) {
+    if (!std::binary_search(current.begin(), current.end(), entry.first)) {
+      stale.push_back(entry.first);
+    }
+  }
+  for (const auto& prefix : stale) {
+    delRouteImpl(prefix, ribCloned, clientId);
+  }
+}
+
+void RouteUpdater::removeStaleRoutesForClient(
+    RouterID rid, ClientID clientId,
+    const std::vector<folly::CIDRNetwork>& current) {
+  std::vector<PrefixV4> currentV4;
+  std::vector<PrefixV6> currentV6;
+  for (const auto& network : current) {
+    const auto& addr = network.first;
+    auto mask = network.second;
+    if (addr.isV4()) {
+      currentV4.push_back(PrefixV4{addr.asV4().mask(mask), mask});
+    } else {
+      currentV6.push_back(PrefixV6{addr.asV6().mask(mask), mask});
+    }
+  }
+  removeStaleRoutesForClientImpl(
+      getRibV4(rid, false), clientId, std::move(currentV4));
+  removeStaleRoutesForClientImpl(
+      getRibV6(rid, false), clientId, std::move(currentV6));
+}
+
 // Some helper functions for recursive weight resolution
 // These aren't really usefully reusable, but structuring them
 // this way helps with clarifying their meaning.
@@ -434,15 +493,14 @@ RouteNextHopSet mergeForwardInfos(
 }
 } // anonymous namespace
 
-template <typename RtRibT, typename AddrT>
+template <typename RouteT, typename AddrT>
 void RouteUpdater::getFwdInfoFromNhop(
-    RtRibT* nRib,
+    const std::shared_ptr<RouteT>& route,
     ClonedRib* ribCloned,
     const AddrT& nh,
     bool* hasToCpu,
     bool* hasDrop,
     RouteNextHopSet& fwd) {
-  auto route = nRib->longestMatch(nh);
   if (route == nullptr) {
     XLOG(DBG3) << " Could not find route for nhop :  " << nh;
     // Un resolvable next hop
@@ -495,8 +553,32 @@ void RouteUpdater::resolveOne(RouteT* route, ClonedRib* ribCloned) {
     hasToCpu = true;
   } else {
     NextHopForwardInfos nhToFwds;
+    const auto& nhops = bestEntry->getNextHopSet();
+    // Look up the routes to all the nexthops that need it together so that
+    // the lookups overlap, before resolving them one by one
+    folly::small_vector<IPAddressV4, kInlineNextHops> v4Nhops;
+    folly::small_vector<IPAddressV6, kInlineNextHops> v6Nhops;
+    for (const auto& nh : nhops) {
+      if (!nh.intfID().hasValue()) {
+        if (nh.addr().isV4()) {
+          v4Nhops.push_back(nh.addr().asV4());
+        } else {
+          v6Nhops.push_back(nh.addr().asV6());
+        }
+      }
+    }
+    folly::small_vector<std::shared_ptr<Route<IPAddressV4>>, kInlineNextHops>
+      v4Routes(v4Nhops.size());
+    folly::small_vector<std::shared_ptr<Route<IPAddressV6>>, kInlineNextHops>
+      v6Routes(v6Nhops.size());
+    ribCloned->v4.rib->longestMatch(
+        folly::range(v4Nhops.begin(), v4Nhops.end()), v4Routes.data());
+    ribCloned->v6.rib->longestMatch(
+        folly::range(v6Nhops.begin(), v6Nhops.end()), v6Routes.data());
+    size_t v4Index = 0;
+    size_t v6Index = 0;
     // loop through all nexthops to find out the forward info
-    for (const auto& nh : bestEntry->getNextHopSet()) {
+    for (const auto& nh : nhops) {
       const auto& addr = nh.addr();
       // There are two reasons why InterfaceID is specified in the next hop.
       // 1) The nexthop was generated for interface route.
@@ -513,13 +595,13 @@ void RouteUpdater::resolveOne(RouteT* route, ClonedRib* ribCloned) {
 
       // nexthops are a set of IPs
       if (addr.isV4()) {
-        auto nRib = ribCloned->v4.rib.get();
-        getFwdInfoFromNhop(nRib, ribCloned, nh.addr().asV4(), &hasToCpu,
-                           &hasDrop, nhToFwds[nh]);
+        getFwdInfoFromNhop(v4Routes[v4Index], ribCloned, v4Nhops[v4Index],
+                           &hasToCpu, &hasDrop, nhToFwds[nh]);
+        ++v4Index;
       } else {
-        auto nRib = ribCloned->v6.rib.get();
-        getFwdInfoFromNhop(nRib, ribCloned, nh.addr().asV6(), &hasToCpu,
-                           &hasDrop, nhToFwds[nh]);
+        getFwdInfoFromNhop(v6Routes[v6Index], ribCloned, v6Nhops[v6Index],
+                           &hasToCpu, &hasDrop, nhToFwds[nh]);
+        ++v6Index;
       }
     }
     fwd = mergeForwardInfos(nhToFwds, route->str());
@@ -545,7 +627,133 @@ void RouteUpdater::resolveOne(RouteT* route, ClonedRib* ribCloned) {
              << " route " << route->str();
 }
 
+namespace {
+// Don't start a thread for fewer routes than this
+constexpr size_t kMinRoutesPerResolveThread = 1024;
+
+/*
+ * Unresolved routes resolve the same way if their best entries have the same
+ * action and next hops, and they are either both interface routes or both
+ * not.  The key points at the next hops of the first route of the batch.
+ */
+struct ResolveKey {
+  bool interfaceRoute;
+  RouteForwardAction action;
+  const RouteNextHopEntry::NextHopSet* nhops;
+
+  bool operator<(const ResolveKey& other) const {
+    if (interfaceRoute != other.interfaceRoute) {
+      return interfaceRoute < other.interfaceRoute;
+    }
+    if (action != other.action) {
+      return action < other.action;
+    }
+    return *nhops < *other.nhops;
+  }
+};
+
+template <typename RouteT>
+bool coversOwnNextHop(const RouteT* route, const RouteNextHopEntry& entry) {
+  const auto& prefix = route->prefix();
+  folly::IPAddress network(prefix.network);
+  for (const auto& nh : entry.getNextHopSet()) {
+    if (nh.addr().inSubnet(network, prefix.mask)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+/*
+ * Call fn(begin, end) over [0, count), split across up to
+ * --route_resolution_threads threads.
+ */
+template <typename Fn>
+void forEachRange(size_t count, const Fn& fn) {
+  auto numThreads = std::min<size_t>(
+      std::max(FLAGS_route_resolution_threads, 0),
+      count / kMinRoutesPerResolveThread);
+  if (numThreads <= 1) {
+    fn(0, count);
+    return;
+  }
+  auto perThread = (count + numThreads - 1) / numThreads;
+  std::vector<std::thread> threads;
+  for (size_t begin = perThread; begin < count; begin += perThread) {
+    auto end = std::min(begin + perThread, count);
+    threads.emplace_back([&fn, begin, end]() { fn(begin, end); });
+  }
+  fn(0, perThread);
+  for (auto& thread : threads) {
+    thread.join();
+  }
+}
+} // anonymous namespace
+
+template <typename RibT>
+void RouteUpdater::resolveBatched(RibT* rib, ClonedRib* ribCloned) {
+  using RouteT = typename RibT::RouteType;
+  std::map<ResolveKey, std::vector<RouteT*>> batches;
+  for (auto& routeNode : rib->writableRoutesRadixTree()) {
+    auto route = routeNode.value().get();
+    if (!route->needResolve()) {
+      continue;
+    }
+    auto bestPair = route->getBestEntry();
+    if (coversOwnNextHop(route, *bestPair.second)) {
+      resolveOne(route, ribCloned);
+      continue;
+    }
+    ResolveKey key{bestPair.first == kInterfaceRouteClientId,
+                   bestPair.second->getAction(),
+                   &bestPair.second->getNextHopSet()};
+    batches[key].push_back(route);
+  }
+
+  // Resolve the first route of each batch.  This may recursively resolve
+  // other routes, including ones from other batches.
+  for (const auto& batch : batches) {
+    auto first = batch.second.front();
+    if (first->needResolve()) {
+      resolveOne(first, ribCloned);
+    }
+  }
+
+  // Copy the result to the rest of each batch.  Each route is only written
+  // by one thread, and the first routes are no longer modified.
+  std::vector<std::pair<RouteT*, const RouteT*>> toCopy;
+  for (const auto& batch : batches) {
+    auto first = batch.second.front();
+    for (auto it = batch.second.begin() + 1; it != batch.second.end(); ++it) {
+      if ((*it)->needResolve()) {
+        toCopy.emplace_back(*it, first);
+      }
+    }
+  }
+  forEachRange(toCopy.size(), [&toCopy](size_t begin, size_t end) {
+    for (auto i = begin; i < end; ++i) {
+      auto route = toCopy[i].first;
+      auto first = toCopy[i].second;
+      if (first->isResolved()) {
+        route->setResolved(first->getForwardInfo());
+        if (first->isConnected()) {
+          route->setConnected();
+        }
+      } else {
+        route->setUnresolvable();
+      }
+    }
+  });
+  XLOG(DBG3) << "Resolved " << batches.size() << " next hop sets, copied to "
+             << toCopy.size() << " routes";
+}
+
 void RouteUpdater::resolve() {
+  auto start = std::chrono::steady_clock::now();
+  SCOPE_EXIT {
+    resolveDuration_ = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - start);
+  };
   // First, we need to make sure every route of the changed rib is cloned
   // and the RadixTree of this changed rib is also generated.
   // The reason why we have to do the same for-loop separately is because the
@@ -566,6 +774,17 @@ void RouteUpdater::resolve() {
   // routes that are changed. In this case, we just simply loop through all
   // routes and resolve those that are not resolved yet.
   // TODO(joseph5wu) T23364375 will try to improve it in the future.
+  if (FLAGS_batch_route_resolution) {
+    for (auto& ribCloned : clonedRibs_) {
+      if (ribCloned.second.v4.cloned) {
+        resolveBatched(ribCloned.second.v4.rib.get(), &ribCloned.second);
+      }
+      if (ribCloned.second.v6.cloned) {
+        resolveBatched(ribCloned.second.v6.rib.get(), &ribCloned.second);
+      }
+    }
+    return;
+  }
   for (auto& ribCloned : clonedRibs_) {
     if (ribCloned.second.v4.cloned) {
       auto rib = ribCloned.second.v4.rib.get();
@@ -674,27 +893,33 @@ void RouteUpdater::staticRouteDelHelper(
 
 void RouteUpdater::updateStaticRoutes(const cfg::SwitchConfig& curCfg,
     const cfg::SwitchConfig& prevCfg) {
-  flat_map<RouterID, flat_set<CIDRNetwork>> newCfgVrf2StaticPfxs;
+  // Configs can carry tens of thousands of static routes, so they are all
+  // gathered and sorted first.  Repeated prefixes are then found in one walk,
+  // the routes go into the ribs in prefix order, and the prefix sets are
+  // built from sorted runs instead of one insert at a time.
+  struct StaticRoute {
+    RouterID rid;
+    CIDRNetwork network;
+    RouteNextHopEntry entry;
+    // Routes to null or CPU may not share a prefix with each other
+    bool checkDuplicate;
+  };
+  std::vector<StaticRoute> routes;
+  routes.reserve(curCfg.staticRoutesToNull.size() +
+                 curCfg.staticRoutesToCPU.size() +
+                 curCfg.staticRoutesWithNhops.size());
   auto processStaticRoutesNoNhops = [&](
-      const std::vector<cfg::StaticRouteNoNextHops>& routes,
+      const std::vector<cfg::StaticRouteNoNextHops>& cfgRoutes,
       RouteForwardAction action) {
-    for (const auto& route : routes) {
-      RouterID rid(route.routerID) ;
-      auto network = IPAddress::createNetwork(route.prefix);
-      if (newCfgVrf2StaticPfxs[rid].find(network)
-          != newCfgVrf2StaticPfxs[rid].end()) {
-        throw FbossError("Prefix : ",  network.first, "/",
-            (int)network.second, " in multiple static routes");
-      }
-      addRoute(rid, network.first, network.second,
-               StdClientIds2ClientID(StdClientIds::STATIC_ROUTE),
-               RouteNextHopEntry(action, AdminDistance::STATIC_ROUTE));
-      // Note down prefix for comparing with old static routes
-      newCfgVrf2StaticPfxs[rid].emplace(network);
+    for (const auto& route : cfgRoutes) {
+      routes.push_back(StaticRoute{
+          RouterID(route.routerID),
+          IPAddress::createNetwork(route.prefix),
+          RouteNextHopEntry(action, AdminDistance::STATIC_ROUTE),
+          true});
     }
   };
 
-
   if (curCfg.__isset.staticRoutesToNull) {
     processStaticRoutesNoNhops(curCfg.staticRoutesToNull, DROP);
   }
@@ -704,8 +929,6 @@ void RouteUpdater::updateStaticRoutes(const cfg::SwitchConfig& curCfg,
 
   if (curCfg.__isset.staticRoutesWithNhops) {
     for (const auto& route : curCfg.staticRoutesWithNhops) {
-      RouterID rid(route.routerID) ;
-      auto network = IPAddress::createNetwork(route.prefix);
       RouteNextHopSet nhops;
       // NOTE: Static routes use the default UCMP weight so that they
       // can be compatible with UCMP. (i.e., so that we can do ucmp where
@@ -717,14 +940,49 @@ void RouteUpdater::updateStaticRoutes(const cfg::SwitchConfig& curCfg,
         nhops.emplace(
             UnresolvedNextHop(folly::IPAddress(nhopStr), UCMP_DEFAULT_WEIGHT));
       }
-      addRoute(rid, network.first, network.second,
-               StdClientIds2ClientID(StdClientIds::STATIC_ROUTE),
-               RouteNextHopEntry(
-                   std::move(nhops), AdminDistance::STATIC_ROUTE));
-      // Note down prefix for comparing with old static routes
-      newCfgVrf2StaticPfxs[rid].emplace(network);
+      routes.push_back(StaticRoute{
+          RouterID(route.routerID),
+          IPAddress::createNetwork(route.prefix),
+          RouteNextHopEntry(std::move(nhops), AdminDistance::STATIC_ROUTE),
+          false});
     }
   }
+
+  // The sort is stable, so among routes for one prefix the one listed last
+  // stays last, and is the one that takes effect
+  auto before = [](const StaticRoute& a, const StaticRoute& b) {
+    return std::tie(a.rid, a.network) < std::tie(b.rid, b.network);
+  };
+  std::stable_sort(routes.begin(), routes.end(), before);
+
+  flat_map<RouterID, flat_set<CIDRNetwork>> newCfgVrf2StaticPfxs;
+  std::vector<CIDRNetwork> prefixes;
+  auto clientId = StdClientIds2ClientID(StdClientIds::STATIC_ROUTE);
+  for (auto it = routes.begin(); it != routes.end();) {
+    auto last = it;
+    bool seen = false;
+    for (; it != routes.end() && !before(*last, *it); last = it++) {
+      if (it->checkDuplicate) {
+        if (seen) {
+          throw FbossError("Prefix : ", it->network.first, "/",
+              (int)it->network.second, " in multiple static routes");
+        }
+        seen = true;
+      }
+    }
+    addRoute(last->rid, last->network.first, last->network.second,
+             clientId, std::move(last->entry));
+    // Note down prefix for comparing with old static routes
+    prefixes.push_back(last->network);
+    if (it == routes.end() || it->rid != last->rid) {
+      newCfgVrf2StaticPfxs.emplace_hint(
+          newCfgVrf2StaticPfxs.end(), last->rid,
+          flat_set<CIDRNetwork>(boost::container::ordered_unique_range,
+                                prefixes.begin(), prefixes.end()));
+      prefixes.clear();
+    }
+  }
+
   // Now blow away any static routes that are not in the config
   // Ideally after this we should replay the routes from lower
   // precedence route announcers (e.g. BGP) for deleted prefixes.
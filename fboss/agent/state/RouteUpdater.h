@@ -16,10 +16,14 @@
 #include "fboss/agent/state/RouteNextHopsMulti.h"
 #include "fboss/agent/state/RouteTypes.h"
 #include "fboss/agent/state/RouteTableMap.h"
+#include "fboss/agent/state/RouteTableRib.h"
 
 #include <boost/container/flat_map.hpp>
 #include <boost/container/flat_set.hpp>
 
+#include <chrono>
+#include <vector>
+
 namespace facebook { namespace fboss {
 
 namespace cfg {
@@ -27,7 +31,6 @@ class SwitchConfig;
 }
 
 class InterfaceMap;
-template<typename Addr> class RouteTableRib;
 
 /**
  * Expected behavior of RouteUpdater::resolve():
@@ -52,6 +55,13 @@ template<typename Addr> class RouteTableRib;
  *    only IP nexthops will be in the final ECMP group.
  * 5. If and only if TO_CPU is the only nexthop (directly or indirectly) of
  *    a route, TO_CPU action will be only path in the resolved ECMP group.
+ *
+ * With --batch_route_resolution, unresolved routes are grouped by the next
+ * hops of their best entry.  Only one route of each group is resolved, and
+ * its result is copied to the rest of the group, optionally across
+ * --route_resolution_threads threads.  Routes whose own prefix covers one of
+ * their next hops are still resolved one at a time, since they would be used
+ * to resolve themselves.
  */
 class RouteUpdater {
  public:
@@ -66,9 +76,10 @@ class RouteUpdater {
   typedef RoutePrefixV4 PrefixV4;
   typedef RoutePrefixV6 PrefixV6;
 
-  // method to add a route
+  // method to add a route, which then has the class it was last added with
   void addRoute(RouterID id, const folly::IPAddress& network, uint8_t mask,
-                ClientID clientId, RouteNextHopEntry entry);
+                ClientID clientId, RouteNextHopEntry entry,
+                RouteClassID classID = RouteClassID(0));
 
   // method to delete a route from a client
   void delRoute(RouterID id, const folly::IPAddress& network, uint8_t mask,
@@ -77,6 +88,13 @@ class RouteUpdater {
   // method to delete all routes from a client
   void removeAllRoutesForClient(RouterID rid, ClientID clientId);
 
+  // method to delete the routes from a client whose prefix is not in
+  // current.  Together with addRoute() for each route in current, this syncs
+  // a client's routes while leaving unchanged routes untouched.
+  void removeStaleRoutesForClient(
+      RouterID rid, ClientID clientId,
+      const std::vector<folly::CIDRNetwork>& current);
+
   std::shared_ptr<RouteTableMap> updateDone();
 
   // Add all interface routes (directly connected routes) and link local routes
@@ -87,9 +105,17 @@ class RouteUpdater {
   void addLinkLocalRoutes(RouterID id);
   void delLinkLocalRoutes(RouterID id);
 
+  // Sync the static routes with curCfg, deleting those only in prevCfg.
+  // The routes are added in bulk, and resolved along with everything else
+  // in updateDone().
   void updateStaticRoutes(const cfg::SwitchConfig& curCfg,
       const cfg::SwitchConfig& prevCfg);
 
+  // Time spent resolving routes in the last call to updateDone()
+  std::chrono::microseconds getResolveDuration() const {
+    return resolveDuration_;
+  }
+
  private:
   template<typename StaticRouteType>
   void staticRouteDelHelper(const std::vector<StaticRouteType>& oldRoutes,
@@ -114,6 +140,7 @@ class RouteUpdater {
   };
   boost::container::flat_map<RouterID, ClonedRib> clonedRibs_;
   const std::shared_ptr<RouteTableMap>& orig_;
+  std::chrono::microseconds resolveDuration_{0};
 
   // Helper functions to get/allocate the cloned RIB
   ClonedRib* createNewRib(RouterID id);
@@ -125,19 +152,25 @@ class RouteUpdater {
   // Helper functions to add or delete a route
   template<typename PrefixT, typename RibT>
   void addRouteImpl(const PrefixT& prefix, RibT *rib,
-                    ClientID clientId, RouteNextHopEntry entry);
+                    ClientID clientId, RouteNextHopEntry entry,
+                    RouteClassID classID = RouteClassID(0));
   template<typename PrefixT, typename RibT>
   void delRouteImpl(const PrefixT& prefix, RibT *ribCloned, ClientID clientId);
   template<typename AddrT, typename RibT>
   void removeAllRoutesForClientImpl(RibT *ribCloned, ClientID clientId);
+  template<typename PrefixT, typename RibT>
+  void removeStaleRoutesForClientImpl(RibT *ribCloned, ClientID clientId,
+                                      std::vector<PrefixT> current);
 
   // resolve all routes that are not resolved yet
   void resolve();
   template<typename RouteT>
   void resolveOne(RouteT* route, ClonedRib* clonedRib);
-  template <typename RtRibT, typename AddrT>
+  template <typename RibT>
+  void resolveBatched(RibT* rib, ClonedRib* clonedRib);
+  template <typename RouteT, typename AddrT>
   void getFwdInfoFromNhop(
-      RtRibT* nRib,
+      const std::shared_ptr<RouteT>& route,
       ClonedRib* ribCloned,
       const AddrT& nh,
       bool* hasToCpu,
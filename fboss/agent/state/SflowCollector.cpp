@@ -15,6 +15,7 @@
 namespace {
 constexpr auto kIp = "ip";
 constexpr auto kPort = "port";
+constexpr auto kMaxSamplesPerSec = "maxSamplesPerSec";
 }
 
 namespace facebook { namespace fboss {
@@ -23,6 +24,7 @@ folly::dynamic SflowCollectorFields::toFollyDynamic() const {
   folly::dynamic collector = folly::dynamic::object;
   collector[kIp] = address.getFullyQualified();
   collector[kPort] = address.getPort();
+  collector[kMaxSamplesPerSec] = maxSamplesPerSec;
 
   return collector;
 }
@@ -31,12 +33,17 @@ SflowCollectorFields SflowCollectorFields::fromFollyDynamic(
     const folly::dynamic& collectorJson) {
   std::string ip = collectorJson[kIp].asString();
   uint16_t port = collectorJson[kPort].asInt();
+  uint32_t maxSamplesPerSec =
+      collectorJson.getDefault(kMaxSamplesPerSec, 0).asInt();
 
-  return SflowCollectorFields(ip, port);
+  return SflowCollectorFields(ip, port, maxSamplesPerSec);
 }
 
-SflowCollector::SflowCollector(const std::string& ip, const uint16_t port)
-    : NodeBaseT(ip, port) {
+SflowCollector::SflowCollector(
+    const std::string& ip,
+    const uint16_t port,
+    const uint32_t maxSamplesPerSec)
+    : NodeBaseT(ip, port, maxSamplesPerSec) {
 }
 
 template class NodeBaseT<SflowCollector, SflowCollectorFields>;
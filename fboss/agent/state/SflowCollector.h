@@ -21,9 +21,13 @@
 namespace facebook { namespace fboss {
 
 struct SflowCollectorFields {
-  SflowCollectorFields(const std::string& ip, const uint16_t port)
+  SflowCollectorFields(
+      const std::string& ip,
+      const uint16_t port,
+      const uint32_t maxSamplesPerSec = 0)
       : address(ip, port), id(address.getFullyQualified() + ':'
-                              + folly::to<std::string>(address.getPort())) {}
+                              + folly::to<std::string>(address.getPort())),
+        maxSamplesPerSec(maxSamplesPerSec) {}
 
   template<typename Fn>
   void forEachChild(Fn) {}
@@ -33,6 +37,8 @@ struct SflowCollectorFields {
 
   const folly::SocketAddress address;
   const std::string id;
+  // The most samples a second to send the collector, 0 for no limit
+  const uint32_t maxSamplesPerSec{0};
 };
 
 /*
@@ -41,7 +47,10 @@ struct SflowCollectorFields {
  */
 class SflowCollector : public NodeBaseT<SflowCollector, SflowCollectorFields> {
  public:
-  SflowCollector(const std::string& ip, const uint16_t port);
+  SflowCollector(
+      const std::string& ip,
+      const uint16_t port,
+      const uint32_t maxSamplesPerSec = 0);
 
   static std::shared_ptr<SflowCollector>
   fromFollyDynamic(const folly::dynamic& json) {
@@ -66,6 +75,10 @@ class SflowCollector : public NodeBaseT<SflowCollector, SflowCollectorFields> {
     return getFields()->address;
   }
 
+  uint32_t getMaxSamplesPerSec() const {
+    return getFields()->maxSamplesPerSec;
+  }
+
  private:
   // Inherit the constructors required for clone()
   using NodeBaseT::NodeBaseT;
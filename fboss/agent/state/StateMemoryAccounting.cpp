@@ -0,0 +1,153 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "fboss/agent/state/StateMemoryAccounting.h"
+
+#include "fboss/agent/state/NodeAllocator.h"
+#include "fboss/agent/state/NodeBase.h"
+#include "fboss/agent/state/RouteTable.h"
+#include "fboss/agent/state/SwitchState.h"
+
+#include <folly/Optional.h>
+
+#include <typeinfo>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+
+namespace facebook { namespace fboss {
+
+namespace {
+
+// What a single node reports about itself
+class NodeReport : public NodeMemoryVisitor {
+ public:
+  void ownBytes(size_t bytes) override {
+    own += bytes;
+  }
+  void sharedBlock(const void* block, size_t bytes) override {
+    blocks.emplace_back(block, bytes);
+  }
+
+  void reset() {
+    own = 0;
+    blocks.clear();
+  }
+
+  size_t own{0};
+  std::vector<std::pair<const void*, size_t>> blocks;
+};
+
+/*
+ * Nodes and shared blocks are both keyed by their address.  The states
+ * walked are kept alive for the whole walk, so an address can't be reused.
+ */
+using BlockSizes = std::unordered_map<const void*, size_t>;
+
+// Record the nodes and blocks of an older generation, skipping the subtrees
+// an earlier one already had.
+void collectBlocks(const NodeBase* node, NodeReport* report,
+                   BlockSizes* blocks) {
+  report->reset();
+  node->accountMemory(report);
+  if (!blocks->emplace(node, report->own).second) {
+    return;
+  }
+  for (const auto& block : report->blocks) {
+    blocks->emplace(block.first, block.second);
+  }
+  node->forEachChildNode([report, blocks](const NodeBase* child) {
+    collectBlocks(child, report, blocks);
+  });
+}
+
+class CurrentStateWalker {
+ public:
+  CurrentStateWalker(const BlockSizes& older, StateMemoryUsage* usage)
+      : older_(older), usage_(usage) {}
+
+  void walk(const NodeBase* node, folly::Optional<RouterID> vrf) {
+    if (!seen_.insert(node).second) {
+      return;
+    }
+    if (auto table = dynamic_cast<const RouteTable*>(node)) {
+      vrf = table->getID();
+    }
+
+    report_.reset();
+    node->accountMemory(&report_);
+    uint64_t bytes = report_.own;
+    uint64_t shared = older_.count(node) ? bytes : 0;
+    for (const auto& block : report_.blocks) {
+      if (!seen_.insert(block.first).second) {
+        continue;
+      }
+      bytes += block.second;
+      if (older_.count(block.first)) {
+        shared += block.second;
+      }
+    }
+
+    add(&usage_->byNodeType[NodeAllocationStats::typeName(typeid(*node))],
+        bytes, shared);
+    if (vrf) {
+      add(&usage_->byVrf[*vrf], bytes, shared);
+    }
+    add(&usage_->total, bytes, shared);
+
+    node->forEachChildNode([this, vrf](const NodeBase* child) {
+      walk(child, vrf);
+    });
+  }
+
+  bool seen(const void* block) const {
+    return seen_.count(block) != 0;
+  }
+
+ private:
+  static void add(StateMemoryUsage::Usage* usage, uint64_t bytes,
+                  uint64_t shared) {
+    ++usage->nodes;
+    usage->bytes += bytes;
+    usage->sharedBytes += shared;
+  }
+
+  const BlockSizes& older_;
+  StateMemoryUsage* usage_;
+  NodeReport report_;
+  std::unordered_set<const void*> seen_;
+};
+
+} // unnamed namespace
+
+StateMemoryUsage accountStateMemory(
+    const std::shared_ptr<SwitchState>& state,
+    const std::vector<std::shared_ptr<SwitchState>>& older) {
+  StateMemoryUsage usage;
+  BlockSizes olderBlocks;
+  NodeReport report;
+  for (const auto& olderState : older) {
+    if (olderState && olderState != state) {
+      collectBlocks(olderState.get(), &report, &olderBlocks);
+      ++usage.olderGenerations;
+    }
+  }
+
+  CurrentStateWalker walker(olderBlocks, &usage);
+  walker.walk(state.get(), folly::none);
+
+  for (const auto& block : olderBlocks) {
+    if (!walker.seen(block.first)) {
+      usage.retainedBytes += block.second;
+    }
+  }
+  return usage;
+}
+
+}} // facebook::fboss
@@ -0,0 +1,59 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#pragma once
+
+#include "fboss/agent/types.h"
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace facebook { namespace fboss {
+
+class SwitchState;
+
+/*
+ * The memory a SwitchState takes, by node type and by VRF.
+ *
+ * Every node, and every block shared between nodes (the chunks of a
+ * PersistentNodeContainer or StrideTrie, and the interned next hop sets) is
+ * counted once, however many parents point to it.  The sizes are estimates
+ * made from the size and capacity of each node's containers, not what the
+ * allocator actually handed out.
+ */
+struct StateMemoryUsage {
+  struct Usage {
+    uint64_t nodes{0};
+    uint64_t bytes{0};
+    // The part of bytes that the older generations also hold
+    uint64_t sharedBytes{0};
+  };
+
+  std::map<std::string, Usage> byNodeType;
+  // The route tables of each VRF, and everything below them
+  std::map<RouterID, Usage> byVrf;
+  Usage total;
+  // The memory that only the older generations hold, i.e. what freeing them
+  // would give back
+  uint64_t retainedBytes{0};
+  uint32_t olderGenerations{0};
+};
+
+/*
+ * Account for the memory of state, and of the older generations of it that
+ * are still alive.  The states must be published.
+ */
+StateMemoryUsage accountStateMemory(
+    const std::shared_ptr<SwitchState>& state,
+    const std::vector<std::shared_ptr<SwitchState>>& older = {});
+
+}} // facebook::fboss
@@ -9,6 +9,8 @@
  */
 #pragma once
 
+#include <chrono>
+#include <cstdint>
 #include <memory>
 
 #include <folly/IntrusiveList.h>
@@ -18,6 +20,47 @@ namespace facebook { namespace fboss {
 
 class SwitchState;
 
+/*
+ * The kind of change a StateUpdate makes.
+ *
+ * Pending updates are handled in this order: while LINK or NEIGHBOR updates
+ * are pending, SwSwitch applies them on their own and leaves the other
+ * classes for the next batch, so that a port going down or a neighbor being
+ * resolved is not stuck behind a large route or config update.  Updates of
+ * the same class are always applied in the order they were scheduled, and
+ * never ahead of an update of an earlier class scheduled before them, so
+ * a ROUTE update is only applied after every update scheduled before it.
+ */
+enum class StateUpdateClass : uint8_t {
+  LINK,
+  NEIGHBOR,
+  DEFAULT,
+  CONFIG,
+  ROUTE,
+};
+
+constexpr size_t kNumStateUpdateClasses = 5;
+
+inline bool isUrgentStateUpdateClass(StateUpdateClass updateClass) {
+  return updateClass < StateUpdateClass::DEFAULT;
+}
+
+inline const char* stateUpdateClassName(StateUpdateClass updateClass) {
+  switch (updateClass) {
+    case StateUpdateClass::LINK:
+      return "link";
+    case StateUpdateClass::NEIGHBOR:
+      return "neighbor";
+    case StateUpdateClass::DEFAULT:
+      return "default";
+    case StateUpdateClass::CONFIG:
+      return "config";
+    case StateUpdateClass::ROUTE:
+      return "route";
+  }
+  return "unknown";
+}
+
 /*
  * StateUpdate objects are used to make changes to the SwitchState.
  *
@@ -32,9 +75,13 @@ class SwitchState;
  */
 class StateUpdate {
  public:
-  explicit StateUpdate(folly::StringPiece name, bool allowCoalesce = true)
+  explicit StateUpdate(
+      folly::StringPiece name,
+      bool allowCoalesce = true,
+      StateUpdateClass updateClass = StateUpdateClass::DEFAULT)
       : name_(name.str()),
-        allowCoalesce_(allowCoalesce) {}
+        allowCoalesce_(allowCoalesce),
+        updateClass_(updateClass) {}
   virtual ~StateUpdate() {}
 
   const std::string& getName() const {
@@ -45,6 +92,10 @@ class StateUpdate {
     return allowCoalesce_;
   }
 
+  StateUpdateClass getUpdateClass() const {
+    return updateClass_;
+  }
+
   /*
    * Apply the update, and return a new SwitchState.
    *
@@ -85,6 +136,9 @@ class StateUpdate {
 
   std::string name_;
   bool allowCoalesce_;
+  StateUpdateClass updateClass_;
+  // When the update was queued, set by SwSwitch
+  std::chrono::steady_clock::time_point queuedTime_;
 
   // An intrusive list hook for maintaining the list of pending updates.
   folly::IntrusiveListHook listHook_;
@@ -18,6 +18,7 @@
 
 #include <folly/Range.h>
 #include <folly/String.h>
+#include <folly/futures/Promise.h>
 #include <folly/logging/xlog.h>
 #include "fboss/agent/state/StateUpdate.h"
 
@@ -30,8 +31,9 @@ class FunctionStateUpdate : public StateUpdate {
     StateUpdateFn;
 
   FunctionStateUpdate(folly::StringPiece name, StateUpdateFn fn,
-                      bool allowCoalesce = true)
-    : StateUpdate(name, allowCoalesce),
+                      bool allowCoalesce = true,
+                      StateUpdateClass updateClass = StateUpdateClass::DEFAULT)
+    : StateUpdate(name, allowCoalesce, updateClass),
       function_(fn) {}
 
   std::shared_ptr<SwitchState> applyUpdate(
@@ -102,8 +104,9 @@ class BlockingStateUpdate : public StateUpdate {
   BlockingStateUpdate(folly::StringPiece name,
                       StateUpdateFn fn,
                       std::shared_ptr<BlockingUpdateResult> result,
-                      bool allowCoalesce = true)
-    : StateUpdate(name, allowCoalesce),
+                      bool allowCoalesce = true,
+                      StateUpdateClass updateClass = StateUpdateClass::DEFAULT)
+    : StateUpdate(name, allowCoalesce, updateClass),
       function_(fn),
       result_(result) {}
 
@@ -130,4 +133,44 @@ class BlockingStateUpdate : public StateUpdate {
   std::shared_ptr<BlockingUpdateResult> result_;
 };
 
+/*
+ * A StateUpdate that completes a promise once it has been applied, for
+ * callers that want the result of the update without blocking a thread
+ * waiting for it.
+ */
+class FutureStateUpdate : public StateUpdate {
+ public:
+  typedef std::function<
+    std::shared_ptr<SwitchState>(const std::shared_ptr<SwitchState>&)>
+    StateUpdateFn;
+
+  FutureStateUpdate(folly::StringPiece name,
+                    StateUpdateFn fn,
+                    folly::Promise<folly::Unit> promise,
+                    bool allowCoalesce = true,
+                    StateUpdateClass updateClass = StateUpdateClass::DEFAULT)
+    : StateUpdate(name, allowCoalesce, updateClass),
+      function_(fn),
+      promise_(std::move(promise)) {}
+
+  std::shared_ptr<SwitchState> applyUpdate(
+      const std::shared_ptr<SwitchState>& origState) override {
+    return function_(origState);
+  }
+
+  void onError(const std::exception& /*ex*/) noexcept override {
+    // As in BlockingStateUpdate, use std::current_exception() to keep the
+    // original exception type.
+    promise_.setException(folly::exception_wrapper(std::current_exception()));
+  }
+
+  void onSuccess() override {
+    promise_.setValue();
+  }
+
+ private:
+  StateUpdateFn function_;
+  folly::Promise<folly::Unit> promise_;
+};
+
 }} // facebook::fboss
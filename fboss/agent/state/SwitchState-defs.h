@@ -51,14 +51,14 @@ void SwitchState::revertNewRouteEntry(
                  ->getRouteTables()
                  ->getRouteTable(id)
                  ->template getRib<AddressT>();
+  // modify() returns a rib whose radix tree is kept in sync with its routes
   auto clonedRib = rib->modify(id, appliedState);
   if (oldRoute) {
     clonedRib->updateRoute(oldRoute);
-    clonedRib->updateRouteInRadixTree(oldRoute);
   } else {
     clonedRib->removeRoute(newRoute);
-    clonedRib->removeRouteInRadixTree(newRoute);
   }
+  clonedRib->reindexRoute(newRoute->prefix(), newRoute.get(), oldRoute.get());
   CHECK_EQ(clonedRib->size(), clonedRib->writableRoutesRadixTree().size());
 }
 
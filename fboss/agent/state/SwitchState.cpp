@@ -109,6 +109,70 @@ void SwitchState::modify(std::shared_ptr<SwitchState>* state) {
   *state = (*state)->clone();
 }
 
+folly::dynamic SwitchState::toFollyDynamicAt(
+    JsonPath path, size_t offset, size_t limit) const {
+  if (path.empty()) {
+    return toFollyDynamic();
+  }
+  // Only serialize the child that the path leads into
+  const auto& fields = getFields();
+  const auto& child = path[0];
+  auto rest = path.subpiece(1);
+  if (child == kInterfaces) {
+    return fields->interfaces->toFollyDynamicAt(rest, offset, limit);
+  } else if (child == kPorts) {
+    return fields->ports->toFollyDynamicAt(rest, offset, limit);
+  } else if (child == kVlans) {
+    return fields->vlans->toFollyDynamicAt(rest, offset, limit);
+  } else if (child == kRouteTables) {
+    return fields->routeTables->toFollyDynamicAt(rest, offset, limit);
+  } else if (child == kAcls) {
+    return fields->acls->toFollyDynamicAt(rest, offset, limit);
+  } else if (child == kSflowCollectors) {
+    return fields->sFlowCollectors->toFollyDynamicAt(rest, offset, limit);
+  } else if (child == kControlPlane) {
+    return fields->controlPlane->toFollyDynamicAt(rest, offset, limit);
+  } else if (child == kDefaultVlan) {
+    return selectJsonPath(static_cast<uint32_t>(fields->defaultVlan), rest);
+  }
+  throw FbossError("no state found at path element \"", child, "\"");
+}
+
+std::shared_ptr<SwitchState> SwitchState::applyJsonPatch(
+    JsonPath path, const folly::dynamic& patch) const {
+  if (path.empty()) {
+    return NodeBaseT::applyJsonPatch(path, patch);
+  }
+  const auto& fields = getFields();
+  const auto& child = path[0];
+  auto rest = path.subpiece(1);
+  auto state = clone();
+  if (child == kInterfaces) {
+    state->resetIntfs(fields->interfaces->applyJsonPatch(rest, patch));
+  } else if (child == kPorts) {
+    state->resetPorts(fields->ports->applyJsonPatch(rest, patch));
+  } else if (child == kVlans) {
+    state->resetVlans(fields->vlans->applyJsonPatch(rest, patch));
+  } else if (child == kRouteTables) {
+    state->resetRouteTables(fields->routeTables->applyJsonPatch(rest, patch));
+  } else if (child == kAcls) {
+    state->resetAcls(fields->acls->applyJsonPatch(rest, patch));
+  } else if (child == kSflowCollectors) {
+    state->resetSflowCollectors(
+        fields->sFlowCollectors->applyJsonPatch(rest, patch));
+  } else if (child == kControlPlane) {
+    state->resetControlPlane(
+        fields->controlPlane->applyJsonPatch(rest, patch));
+  } else if (child == kDefaultVlan) {
+    folly::dynamic defaultVlan = static_cast<uint32_t>(fields->defaultVlan);
+    mergeJsonPatchAt(&defaultVlan, rest, patch);
+    state->setDefaultVlan(VlanID(defaultVlan.asInt()));
+  } else {
+    throw FbossError("no state found at path element \"", child, "\"");
+  }
+  return state;
+}
+
 std::shared_ptr<Port> SwitchState::getPort(PortID id) const {
   return getFields()->ports->getPort(id);
 }
@@ -15,6 +15,8 @@
 #include <folly/FBString.h>
 #include <folly/dynamic.h>
 #include <folly/Memory.h>
+#include <folly/Optional.h>
+#include "fboss/agent/gen-cpp2/switch_config_types.h"
 
 #include "fboss/agent/state/AclMap.h"
 #include "fboss/agent/state/AggregatePortMap.h"
@@ -87,6 +89,8 @@ struct SwitchStateFields {
   // source IP of the DHCP reply pkt to the client host
   folly::IPAddressV4 dhcpV4ReplySrc;
   folly::IPAddressV6 dhcpV6ReplySrc;
+  // How flapping links are dampened, if they are
+  folly::Optional<cfg::LinkFlapDampening> linkFlapDampening;
 };
 
 /*
@@ -155,6 +159,17 @@ class SwitchState : public NodeBaseT<SwitchState, SwitchStateFields> {
     return getFields()->toFollyDynamic();
   }
 
+  folly::dynamic
+  toFollyDynamicAt(JsonPath path, size_t offset, size_t limit) const override;
+
+  /*
+   * Return a new state with patch merged in at path.  Only the node that
+   * path leads into is deserialized again, and cloned up to the root; the
+   * rest of the state is shared with this one.
+   */
+  std::shared_ptr<SwitchState> applyJsonPatch(
+      JsonPath path, const folly::dynamic& patch) const;
+
   static void modify(std::shared_ptr<SwitchState>* state);
 
   template <typename EntryClassT, typename NTableT>
@@ -268,6 +283,15 @@ class SwitchState : public NodeBaseT<SwitchState, SwitchStateFields> {
      writableFields()->dhcpV6ReplySrc = v6ReplySrc;
   }
 
+  const folly::Optional<cfg::LinkFlapDampening>& getLinkFlapDampening()
+      const {
+    return getFields()->linkFlapDampening;
+  }
+  void setLinkFlapDampening(
+      folly::Optional<cfg::LinkFlapDampening> linkFlapDampening) {
+    writableFields()->linkFlapDampening = std::move(linkFlapDampening);
+  }
+
   const std::shared_ptr<LoadBalancerMap>& getLoadBalancers() const;
 
   /*
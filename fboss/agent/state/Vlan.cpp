@@ -13,6 +13,7 @@
 #include "fboss/agent/gen-cpp2/switch_config_types.h"
 #include "fboss/agent/state/ArpResponseTable.h"
 #include "fboss/agent/state/ArpTable.h"
+#include "fboss/agent/state/MacTable.h"
 #include "fboss/agent/state/NdpResponseTable.h"
 #include "fboss/agent/state/NdpTable.h"
 #include "fboss/agent/state/SwitchState.h"
@@ -47,6 +48,7 @@ constexpr auto kArpTable = "arpTable";
 constexpr auto kArpResponseTable = "arpResponseTable";
 constexpr auto kNdpTable = "ndpTable";
 constexpr auto kNdpResponseTable = "ndpResponseTable";
+constexpr auto kMacTable = "macTable";
 }
 
 namespace facebook { namespace fboss {
@@ -68,7 +70,8 @@ VlanFields::VlanFields(VlanID _id, string _name)
     arpTable(new ArpTable),
     arpResponseTable(new ArpResponseTable),
     ndpTable(new NdpTable),
-    ndpResponseTable(new NdpResponseTable) {
+    ndpResponseTable(new NdpResponseTable),
+    macTable(new MacTable) {
 }
 
 VlanFields::VlanFields(VlanID _id,
@@ -86,7 +89,8 @@ VlanFields::VlanFields(VlanID _id,
     arpTable(new ArpTable),
     arpResponseTable(new ArpResponseTable),
     ndpTable(new NdpTable),
-    ndpResponseTable(new NdpResponseTable) {
+    ndpResponseTable(new NdpResponseTable),
+    macTable(new MacTable) {
 }
 
 folly::dynamic VlanFields::toFollyDynamic() const {
@@ -115,6 +119,7 @@ folly::dynamic VlanFields::toFollyDynamic() const {
   vlan[kNdpTable] = ndpTable->toFollyDynamic();
   vlan[kArpResponseTable] = arpResponseTable->toFollyDynamic();
   vlan[kNdpResponseTable] = ndpResponseTable->toFollyDynamic();
+  vlan[kMacTable] = macTable->toFollyDynamic();
   return vlan;
 }
 
@@ -144,6 +149,10 @@ VlanFields VlanFields::fromFollyDynamic(const folly::dynamic& vlanJson) {
       vlanJson[kArpResponseTable]);
   vlan.ndpResponseTable = NdpResponseTable::fromFollyDynamic(
       vlanJson[kNdpResponseTable]);
+  // Older versions didn't have MAC tables
+  if (vlanJson.find(kMacTable) != vlanJson.items().end()) {
+    vlan.macTable = MacTable::fromFollyDynamic(vlanJson[kMacTable]);
+  }
   return vlan;
 }
 
@@ -16,6 +16,7 @@
 #include "fboss/agent/state/NodeBase.h"
 #include "fboss/agent/state/ArpResponseTable.h"
 #include "fboss/agent/state/ArpTable.h"
+#include "fboss/agent/state/MacTable.h"
 #include "fboss/agent/state/NdpResponseTable.h"
 #include "fboss/agent/state/NdpTable.h"
 
@@ -66,6 +67,7 @@ struct VlanFields {
     fn(arpResponseTable.get());
     fn(ndpTable.get());
     fn(ndpResponseTable.get());
+    fn(macTable.get());
   }
 
   folly::dynamic toFollyDynamic() const;
@@ -92,6 +94,8 @@ struct VlanFields {
   std::shared_ptr<ArpResponseTable> arpResponseTable;
   std::shared_ptr<NdpTable> ndpTable;
   std::shared_ptr<NdpResponseTable> ndpResponseTable;
+  // Only populated with software MAC learning
+  std::shared_ptr<MacTable> macTable;
 };
 
 class Vlan : public NodeBaseT<Vlan, VlanFields> {
@@ -185,6 +189,13 @@ class Vlan : public NodeBaseT<Vlan, VlanFields> {
     writableFields()->ndpResponseTable.swap(table);
   }
 
+  const std::shared_ptr<MacTable> getMacTable() const {
+    return getFields()->macTable;
+  }
+  void setMacTable(std::shared_ptr<MacTable> table) {
+    writableFields()->macTable.swap(table);
+  }
+
   // dhcp relay
 
   folly::IPAddressV4 getDhcpV4Relay() const {
@@ -15,6 +15,7 @@ namespace facebook { namespace fboss {
 
 template class NodeMapDelta<ArpTable>;
 template class NodeMapDelta<NdpTable>;
+template class NodeMapDelta<MacTable>;
 template class NodeMapDelta<VlanMap, VlanDelta>;
 
 }} // facebook::fboss
@@ -10,6 +10,7 @@
 #pragma once
 
 #include "fboss/agent/state/ArpTable.h"
+#include "fboss/agent/state/MacTable.h"
 #include "fboss/agent/state/NdpTable.h"
 #include "fboss/agent/state/NodeMapDelta.h"
 #include "fboss/agent/state/Vlan.h"
@@ -27,6 +28,7 @@ class VlanDelta : public DeltaValue<Vlan> {
  public:
   typedef NodeMapDelta<ArpTable> ArpTableDelta;
   typedef NodeMapDelta<NdpTable> NdpTableDelta;
+  typedef NodeMapDelta<MacTable> MacTableDelta;
 
   using DeltaValue<Vlan>::DeltaValue;
 
@@ -38,6 +40,10 @@ class VlanDelta : public DeltaValue<Vlan> {
     return NdpTableDelta(getOld() ? getOld()->getNdpTable().get() : nullptr,
                          getNew() ? getNew()->getNdpTable().get() : nullptr);
   }
+  MacTableDelta getMacDelta() const {
+    return MacTableDelta(getOld() ? getOld()->getMacTable().get() : nullptr,
+                         getNew() ? getNew()->getMacTable().get() : nullptr);
+  }
   template <typename NTableT>
   NodeMapDelta<NTableT> getNeighborDelta() const;
 };
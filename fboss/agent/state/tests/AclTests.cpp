@@ -327,6 +327,50 @@ TEST(Acl, Icmp) {
     publishAndApplyConfig(stateV1, &config, platform.get()), FbossError);
 }
 
+TEST(Acl, unchangedConfig) {
+  auto platform = createMockPlatform();
+  auto stateV0 = make_shared<SwitchState>();
+  stateV0->registerPort(PortID(1), "port1");
+
+  cfg::SwitchConfig configV0;
+  configV0.ports.resize(1);
+  configV0.ports[0].logicalID = 1;
+  configV0.ports[0].name = "port1";
+  configV0.ports[0].state = cfg::PortState::ENABLED;
+  configV0.acls.resize(1);
+  configV0.acls[0].name = "acl1";
+  configV0.acls[0].actionType = cfg::AclActionType::DENY;
+  auto stateV1 = publishAndApplyConfig(stateV0, &configV0, platform.get());
+  ASSERT_NE(nullptr, stateV1);
+  ASSERT_NE(nullptr, stateV1->getAcl("acl1"));
+
+  // With the same ACLs as the config the state came from, the ACLs aren't
+  // looked at again, even though other sections changed
+  auto configV1 = configV0;
+  configV1.ports[0].name = "port1.0";
+  auto stateV2 = stateV1->clone();
+  stateV2->resetAcls(make_shared<AclMap>());
+  auto stateV3 = publishAndApplyConfig(
+      stateV2, &configV1, platform.get(), &configV0);
+  ASSERT_NE(nullptr, stateV3);
+  EXPECT_EQ("port1.0", stateV3->getPorts()->getPort(PortID(1))->getName());
+  EXPECT_EQ(nullptr, stateV3->getAcl("acl1"));
+
+  // Without the previous config, everything is computed
+  auto stateV4 = publishAndApplyConfig(stateV2, &configV1, platform.get());
+  ASSERT_NE(nullptr, stateV4);
+  EXPECT_NE(nullptr, stateV4->getAcl("acl1"));
+
+  // and changed ACLs are always applied
+  auto configV2 = configV0;
+  configV2.acls[0].__isset.srcPort = true;
+  configV2.acls[0].srcPort = 5;
+  auto stateV5 = publishAndApplyConfig(
+      stateV1, &configV2, platform.get(), &configV0);
+  ASSERT_NE(nullptr, stateV5);
+  EXPECT_EQ(5, stateV5->getAcl("acl1")->getSrcPort());
+}
+
 TEST(Acl, aclModifyUnpublished) {
   auto state = make_shared<SwitchState>();
   auto aclMap = state->getAcls();
@@ -59,6 +59,14 @@ shared_ptr<ControlPlane> generateDefaultControlPlane() {
   };
   controlPlane->resetRxReasonToQueue(reasons);
 
+  IcmpErrorRateLimit icmpErrorRateLimit;
+  icmpErrorRateLimit.packetsPerSec = 100;
+  icmpErrorRateLimit.burstSize = 10;
+  icmpErrorRateLimit.perSourcePacketsPerSec = 10;
+  icmpErrorRateLimit.perSourceBurstSize = 2;
+  icmpErrorRateLimit.v6SourcePrefixLength = 56;
+  controlPlane->setIcmpErrorRateLimit(icmpErrorRateLimit);
+
   return controlPlane;
 }
 
@@ -88,6 +88,69 @@ TEST(Interface, addrToReach) {
   EXPECT_EQ(0, ret.mask);
 }
 
+TEST(Interface, addrIndex) {
+  auto platform = createMockPlatform();
+  cfg::SwitchConfig config;
+  config.vlans.resize(2);
+  config.vlans[0].id = 1;
+  config.vlans[1].id = 2;
+  config.interfaces.resize(2);
+  for (int i = 0; i < 2; ++i) {
+    auto* intfConfig = &config.interfaces[i];
+    intfConfig->intfID = i + 1;
+    intfConfig->vlanID = i + 1;
+    intfConfig->routerID = 0;
+    intfConfig->mac = "00:02:00:11:22:33";
+    intfConfig->__isset.mac = true;
+  }
+  // The second interface's subnets are within the first's
+  config.interfaces[0].ipAddresses = {"10.0.0.1/16", "2401:db00::1/48"};
+  config.interfaces[1].ipAddresses = {"10.0.1.1/24", "2401:db00:0:1::1/64"};
+
+  shared_ptr<SwitchState> oldState = make_shared<SwitchState>();
+  auto state = publishAndApplyConfig(oldState, &config, platform.get());
+  ASSERT_NE(nullptr, state);
+  state->publish();
+  const auto& intfs = state->getInterfaces();
+  const auto& intf1 = intfs->getInterface(InterfaceID(1));
+  const auto& intf2 = intfs->getInterface(InterfaceID(2));
+
+  EXPECT_EQ(intf1, intfs->getInterfaceIf(RouterID(0), IPAddress("10.0.0.1")));
+  EXPECT_EQ(intf2, intfs->getInterface(RouterID(0), IPAddress("10.0.1.1")));
+  EXPECT_EQ(
+      intf2,
+      intfs->getInterfaceIf(RouterID(0), IPAddress("2401:db00:0:1::1")));
+  EXPECT_EQ(nullptr, intfs->getInterfaceIf(RouterID(0), IPAddress("10.0.1.2")));
+  EXPECT_EQ(nullptr, intfs->getInterfaceIf(RouterID(1), IPAddress("10.0.0.1")));
+  EXPECT_THROW(
+      intfs->getInterface(RouterID(0), IPAddress("10.0.1.2")), FbossError);
+
+  // The longest connected subnet is used
+  auto ret = intfs->getIntfAddrToReach(RouterID(0), IPAddress("10.0.1.100"));
+  EXPECT_EQ(intf2.get(), ret.intf);
+  EXPECT_EQ(IPAddress("10.0.1.1"), *ret.addr);
+  EXPECT_EQ(24, ret.mask);
+  ret = intfs->getIntfAddrToReach(RouterID(0), IPAddress("10.0.2.100"));
+  EXPECT_EQ(intf1.get(), ret.intf);
+  EXPECT_EQ(16, ret.mask);
+  ret = intfs->getIntfAddrToReach(RouterID(0), IPAddress("2401:db00:0:1::5"));
+  EXPECT_EQ(intf2.get(), ret.intf);
+  EXPECT_EQ(64, ret.mask);
+  ret = intfs->getIntfAddrToReach(RouterID(0), IPAddress("10.1.0.1"));
+  EXPECT_EQ(nullptr, ret.intf);
+  ret = intfs->getIntfAddrToReach(RouterID(1), IPAddress("10.0.1.100"));
+  EXPECT_EQ(nullptr, ret.intf);
+
+  // An unpublished clone finds the same, without the index
+  auto clone = intfs->clone();
+  EXPECT_EQ(intf2, clone->getInterfaceIf(RouterID(0), IPAddress("10.0.1.1")));
+  ret = clone->getIntfAddrToReach(RouterID(0), IPAddress("10.0.1.100"));
+  EXPECT_EQ(intf2.get(), ret.intf);
+  EXPECT_EQ(24, ret.mask);
+  ret = clone->getIntfAddrToReach(RouterID(0), IPAddress("10.0.2.100"));
+  EXPECT_EQ(intf1.get(), ret.intf);
+}
+
 TEST(Interface, applyConfig) {
   auto platform = createMockPlatform();
   cfg::SwitchConfig config;
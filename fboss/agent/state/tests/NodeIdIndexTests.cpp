@@ -0,0 +1,80 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "fboss/agent/state/NodeIdIndex.h"
+#include "fboss/agent/state/Port.h"
+#include "fboss/agent/state/PortMap.h"
+#include "fboss/agent/state/StateDelta.h"
+#include "fboss/agent/state/SwitchState.h"
+
+#include <gtest/gtest.h>
+
+using namespace facebook::fboss;
+using std::make_shared;
+using std::shared_ptr;
+
+namespace {
+shared_ptr<SwitchState> makeState() {
+  auto state = make_shared<SwitchState>();
+  for (int i = 1; i <= 4; ++i) {
+    state->registerPort(PortID(i), folly::to<std::string>("port", i));
+  }
+  state->publish();
+  return state;
+}
+}
+
+TEST(NodeIdIndex, incrementalUpdates) {
+  NodeIdIndex index;
+  auto state1 = makeState();
+  index.stateChanged(StateDelta(make_shared<SwitchState>(), state1));
+
+  auto port1 = state1->getPort(PortID(1));
+  EXPECT_EQ(port1, index.getNodeIf<Port>(port1->getNodeID()));
+  EXPECT_EQ(state1->getPorts(),
+            index.getNodeIf<PortMap>(state1->getPorts()->getNodeID()));
+  EXPECT_EQ(state1, index.getNodeIf<SwitchState>(state1->getNodeID()));
+  // The wrong type yields null
+  EXPECT_EQ(nullptr, index.getNodeIf<PortMap>(port1->getNodeID()));
+
+  // Modify port 1 and remove port 2
+  auto state2 = state1->clone();
+  auto newPort1 = port1->modify(&state2);
+  newPort1->setDescription("changed");
+  auto port2 = state1->getPort(PortID(2));
+  state2->getPorts()->modify(&state2)->removeNode(port2);
+  state2->publish();
+  index.stateChanged(StateDelta(state1, state2));
+
+  // NodeIDs are preserved across clones, so the old ID finds the new node
+  EXPECT_EQ(newPort1->getNodeID(), port1->getNodeID());
+  EXPECT_EQ(state2->getPort(PortID(1)),
+            index.getNodeIf<Port>(port1->getNodeID()));
+  EXPECT_EQ(nullptr, index.getNodeIf(port2->getNodeID()));
+  auto port3 = state2->getPort(PortID(3));
+  EXPECT_EQ(port3, index.getNodeIf<Port>(port3->getNodeID()));
+}
+
+TEST(NodeIdIndex, rebuildOnGap) {
+  NodeIdIndex index;
+  auto state1 = makeState();
+  index.stateChanged(StateDelta(make_shared<SwitchState>(), state1));
+  auto sizeBefore = index.size();
+
+  // A delta that doesn't start from the indexed state causes a rebuild
+  auto state2 = makeState();
+  auto state3 = state2->clone();
+  state3->publish();
+  index.stateChanged(StateDelta(state2, state3));
+  EXPECT_EQ(sizeBefore, index.size());
+  auto port = state3->getPort(PortID(4));
+  EXPECT_EQ(port, index.getNodeIf<Port>(port->getNodeID()));
+  EXPECT_EQ(nullptr,
+            index.getNodeIf(state1->getPort(PortID(4))->getNodeID()));
+}
@@ -0,0 +1,80 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "fboss/agent/state/NodeSerializationCache.h"
+#include "fboss/agent/state/Port.h"
+#include "fboss/agent/state/PortMap.h"
+
+#include <gtest/gtest.h>
+
+using namespace facebook::fboss;
+
+namespace {
+std::shared_ptr<PortMap> makePorts(int numPorts) {
+  auto ports = std::make_shared<PortMap>();
+  for (int i = 1; i <= numPorts; ++i) {
+    ports->registerPort(PortID(i), folly::to<std::string>("port", i));
+  }
+  ports->publish();
+  return ports;
+}
+}
+
+TEST(NodeSerializationCache, reusePublishedNodes) {
+  NodeSerializationCache cache;
+  auto ports = makePorts(10);
+  auto expected = ports->toFollyDynamic();
+
+  {
+    NodeSerializationCache::Scope scope(&cache);
+    EXPECT_EQ(expected, ports->toFollyDynamic());
+  }
+  EXPECT_EQ(0, cache.hits());
+  EXPECT_EQ(10, cache.misses());
+  EXPECT_EQ(10, cache.size());
+
+  // Change a single port
+  auto newPorts = ports->clone();
+  auto newPort = newPorts->getPort(PortID(3))->clone();
+  newPort->setDescription("changed");
+  newPorts->updatePort(newPort);
+  newPorts->publish();
+
+  folly::dynamic json;
+  {
+    NodeSerializationCache::Scope scope(&cache);
+    json = newPorts->toFollyDynamic();
+  }
+  EXPECT_EQ(9, cache.hits());
+  EXPECT_EQ(11, cache.misses());
+  // Compared to a serialization without the cache, outside of its scope
+  EXPECT_EQ(newPorts->toFollyDynamic(), json);
+  EXPECT_EQ("changed", json["entries"][2]["portDescription"].asString());
+  // The old version of port 3 was not used, and has been dropped
+  EXPECT_EQ(10, cache.size());
+}
+
+TEST(NodeSerializationCache, unpublishedNodesNotCached) {
+  NodeSerializationCache cache;
+  auto ports = std::make_shared<PortMap>();
+  ports->registerPort(PortID(1), "port1");
+  {
+    NodeSerializationCache::Scope scope(&cache);
+    ports->toFollyDynamic();
+  }
+  EXPECT_EQ(0, cache.size());
+  EXPECT_EQ(0, cache.misses());
+}
+
+TEST(NodeSerializationCache, noScope) {
+  NodeSerializationCache cache;
+  auto ports = makePorts(4);
+  ports->toFollyDynamic();
+  EXPECT_EQ(0, cache.size());
+}
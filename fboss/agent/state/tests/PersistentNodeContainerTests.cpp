@@ -0,0 +1,171 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "fboss/agent/state/PersistentNodeContainer.h"
+
+#include <gtest/gtest.h>
+#include <map>
+#include <random>
+
+using namespace facebook::fboss;
+
+namespace {
+// Use a small chunk size so that the tests exercise chunk splits and merges
+using TestContainer = PersistentNodeContainer<int, int, 4>;
+
+void checkSame(const std::map<int, int>& expected, const TestContainer& c) {
+  ASSERT_EQ(expected.size(), c.size());
+  auto it = c.begin();
+  for (const auto& entry : expected) {
+    ASSERT_TRUE(it != c.end());
+    EXPECT_EQ(entry.first, it->first);
+    EXPECT_EQ(entry.second, it->second);
+    ++it;
+  }
+  EXPECT_TRUE(it == c.end());
+}
+}
+
+TEST(PersistentNodeContainer, insertFindErase) {
+  TestContainer c;
+  EXPECT_TRUE(c.empty());
+  EXPECT_TRUE(c.begin() == c.end());
+
+  for (int i = 0; i < 20; i += 2) {
+    EXPECT_TRUE(c.insert(std::make_pair(i, i * 10)).second);
+  }
+  // Duplicate inserts are rejected and leave the old value in place.
+  auto ret = c.insert(std::make_pair(4, 0));
+  EXPECT_FALSE(ret.second);
+  EXPECT_EQ(40, ret.first->second);
+
+  for (int i = 1; i < 20; i += 2) {
+    c.emplace(i, i * 10);
+  }
+  EXPECT_EQ(20, c.size());
+  for (int i = 0; i < 20; ++i) {
+    auto it = c.find(i);
+    ASSERT_TRUE(it != c.end());
+    EXPECT_EQ(i * 10, it->second);
+  }
+  EXPECT_TRUE(c.find(100) == c.end());
+  EXPECT_TRUE(c.find(-1) == c.end());
+
+  EXPECT_EQ(1, c.erase(7));
+  EXPECT_EQ(0, c.erase(7));
+  EXPECT_TRUE(c.find(7) == c.end());
+  EXPECT_EQ(19, c.size());
+
+  // erase() returns the element following the erased one
+  auto next = c.erase(c.find(11));
+  ASSERT_TRUE(next != c.end());
+  EXPECT_EQ(12, next->first);
+}
+
+TEST(PersistentNodeContainer, reverseIteration) {
+  TestContainer c;
+  for (int i = 0; i < 10; ++i) {
+    c.insert(c.end(), std::make_pair(i, i));
+  }
+  int expected = 9;
+  for (auto it = c.rbegin(); it != c.rend(); ++it) {
+    EXPECT_EQ(expected--, it->first);
+  }
+  EXPECT_EQ(-1, expected);
+}
+
+TEST(PersistentNodeContainer, copiesShareChunks) {
+  TestContainer orig;
+  for (int i = 0; i < 16; ++i) {
+    orig.insert(orig.end(), std::make_pair(i, i));
+  }
+  // Building in key order produces fully packed chunks
+  EXPECT_EQ(4, orig.numChunks());
+
+  TestContainer copy(orig);
+  for (size_t i = 0; i < copy.numChunks(); ++i) {
+    EXPECT_TRUE(copy.isChunkShared(i));
+  }
+
+  // Writing through the copy only unshares the chunk that was touched
+  copy.find(5)->second = 500;
+  EXPECT_TRUE(copy.isChunkShared(0));
+  EXPECT_FALSE(copy.isChunkShared(1));
+  EXPECT_TRUE(copy.isChunkShared(2));
+  EXPECT_TRUE(copy.isChunkShared(3));
+  EXPECT_EQ(5, orig.find(5)->second);
+  EXPECT_EQ(500, copy.find(5)->second);
+
+  // Const lookups never unshare chunks
+  const auto& constCopy = copy;
+  EXPECT_EQ(10, constCopy.find(10)->second);
+  EXPECT_TRUE(copy.isChunkShared(2));
+
+  copy.erase(12);
+  EXPECT_TRUE(orig.find(12) != orig.end());
+  EXPECT_EQ(16, orig.size());
+  EXPECT_EQ(15, copy.size());
+}
+
+TEST(PersistentNodeContainer, randomOps) {
+  std::mt19937 gen(1234);
+  std::uniform_int_distribution<int> keyDist(0, 200);
+  std::map<int, int> expected;
+  TestContainer c;
+  std::vector<std::pair<std::map<int, int>, TestContainer>> snapshots;
+
+  for (int i = 0; i < 5000; ++i) {
+    auto key = keyDist(gen);
+    if (gen() % 3 == 0) {
+      EXPECT_EQ(expected.erase(key), c.erase(key));
+    } else {
+      auto value = static_cast<int>(gen());
+      auto ret = expected.insert(std::make_pair(key, value));
+      EXPECT_EQ(ret.second, c.insert(std::make_pair(key, value)).second);
+    }
+    if (i % 500 == 0) {
+      snapshots.emplace_back(expected, c);
+    }
+  }
+  checkSame(expected, c);
+  // Older copies must not have been affected by later modifications
+  for (const auto& snapshot : snapshots) {
+    checkSame(snapshot.first, snapshot.second);
+  }
+}
+
+TEST(PersistentNodeContainer, skipSharedEntries) {
+  TestContainer orig;
+  for (int i = 0; i < 16; ++i) {
+    orig.insert(orig.end(), std::make_pair(i, i));
+  }
+  TestContainer copy(orig);
+  copy.find(9)->second = 900;
+
+  // Walk both containers the way NodeMapDelta does, counting how many
+  // entries actually had to be compared.
+  auto oldIt = orig.cbegin();
+  auto newIt = copy.cbegin();
+  int compared = 0;
+  std::vector<int> changed;
+  while (oldIt != orig.cend() && newIt != copy.cend()) {
+    if (TestContainer::skipSharedEntries(oldIt, newIt)) {
+      continue;
+    }
+    ++compared;
+    if (oldIt->second != newIt->second) {
+      changed.push_back(oldIt->first);
+    }
+    ++oldIt;
+    ++newIt;
+  }
+  EXPECT_EQ(std::vector<int>{9}, changed);
+  // Only the unshared chunk holding key 9 should have been visited
+  EXPECT_EQ(4, compared);
+}
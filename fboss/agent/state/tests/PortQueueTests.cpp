@@ -29,6 +29,7 @@ TEST(PortQueue, serialization) {
   auto streamType = cfg::StreamType::UNICAST;
   int weight = 5;
   int reservedBytes = 1000;
+  int sharedBytes = 400000;
   auto scalingFactor = cfg::MMUScalingFactor::ONE;
   cfg::ActiveQueueManagement aqm;
   cfg::LinearQueueCongestionDetection lqcd;
@@ -43,6 +44,7 @@ TEST(PortQueue, serialization) {
   pqObject.setStreamType(streamType);
   pqObject.setWeight(weight);
   pqObject.setReservedBytes(reservedBytes);
+  pqObject.setSharedBytes(sharedBytes);
   pqObject.setScalingFactor(scalingFactor);
   pqObject.setAqm(aqm);
 
@@ -304,6 +304,54 @@ TEST(Port, pauseConfig) {
   changePause(expected);
 }
 
+TEST(Port, bufferConfig) {
+  auto platform = createMockPlatform();
+  auto state = make_shared<SwitchState>();
+  state->registerPort(PortID(1), "port1");
+  EXPECT_FALSE(state->getPort(PortID(1))->getBuffer().hasValue());
+
+  cfg::SwitchConfig config;
+  config.ports.resize(1);
+  config.ports[0].logicalID = 1;
+  config.ports[0].name = "port1";
+  config.ports[0].state = cfg::PortState::DISABLED;
+  cfg::PortBuffer buffer;
+  buffer.reservedBytes = 4160;
+  buffer.__isset.reservedBytes = true;
+  buffer.headroomBytes = 66560;
+  buffer.__isset.headroomBytes = true;
+  buffer.scalingFactor = cfg::MMUScalingFactor::ONE_HALF;
+  buffer.__isset.scalingFactor = true;
+  config.ports[0].buffer = buffer;
+  config.ports[0].__isset.buffer = true;
+
+  auto newState = publishAndApplyConfig(state, &config, platform.get());
+  ASSERT_NE(nullptr, newState);
+  auto port = newState->getPort(PortID(1));
+  ASSERT_TRUE(port->getBuffer().hasValue());
+  EXPECT_EQ(buffer, *port->getBuffer());
+
+  // The buffer policy survives a round trip through JSON
+  auto deserialized = Port::fromFollyDynamic(port->toFollyDynamic());
+  EXPECT_EQ(port->getBuffer(), deserialized->getBuffer());
+
+  // Applying the same config again changes nothing
+  EXPECT_EQ(nullptr, publishAndApplyConfig(newState, &config, platform.get()));
+
+  // Removing the policy goes back to the hardware defaults
+  config.ports[0].__isset.buffer = false;
+  auto defaultState =
+      publishAndApplyConfig(newState, &config, platform.get());
+  ASSERT_NE(nullptr, defaultState);
+  EXPECT_FALSE(defaultState->getPort(PortID(1))->getBuffer().hasValue());
+
+  config.ports[0].buffer.headroomBytes = -1;
+  config.ports[0].__isset.buffer = true;
+  EXPECT_THROW(
+      publishAndApplyConfig(defaultState, &config, platform.get()),
+      FbossError);
+}
+
 TEST(PortMap, registerPorts) {
   auto ports = make_shared<PortMap>();
   EXPECT_EQ(0, ports->getGeneration());
@@ -509,6 +557,31 @@ TEST(PortMap, applyConfig) {
   checkChangedPorts(portsV2, portsV3, {3});
 }
 
+TEST(PortMap, applyJsonPatch) {
+  auto ports = make_shared<PortMap>();
+  for (int i = 1; i <= 4; ++i) {
+    ports->registerPort(PortID(i), folly::to<std::string>("port", i));
+  }
+  ports->publish();
+
+  // Patching an entry only rebuilds that port
+  std::vector<std::string> path = {"entries", "2"};
+  auto patch = folly::dynamic::object("portDescription", "patched");
+  auto newPorts = ports->applyJsonPatch(path, patch);
+  EXPECT_EQ("patched", newPorts->getPort(PortID(3))->getDescription());
+  checkChangedPorts(ports, newPorts, {3});
+
+  // Patching the map itself rebuilds all of it
+  patch = folly::dynamic::object(
+      "entries", ports->toFollyDynamic()["entries"]);
+  auto rebuiltPorts = ports->applyJsonPatch({}, patch);
+  EXPECT_EQ(4, rebuiltPorts->size());
+  checkChangedPorts(ports, rebuiltPorts, {1, 2, 3, 4});
+
+  path = {"entries", "4"};
+  EXPECT_THROW(ports->applyJsonPatch(path, patch), FbossError);
+}
+
 TEST(PortMap, iterateOrder) {
   // The NodeMapDelta::Iterator code assumes that the PortMap iterator walks
   // through the ports in sorted order (sorted by PortID).
@@ -30,8 +30,11 @@
 #include "fboss/agent/gen-cpp2/switch_config_types.h"
 
 #include <folly/logging/xlog.h>
+#include <gflags/gflags.h>
 #include <gtest/gtest.h>
 
+DECLARE_bool(batch_route_resolution);
+
 using namespace facebook::fboss;
 using folly::IPAddress;
 using folly::IPAddressV4;
@@ -2008,6 +2011,69 @@ TEST(Route, serializeRoute) {
   ASSERT_TRUE(rt2->has(clientId, RouteNextHopEntry(nxtHops, DISTANCE)));
 }
 
+TEST(RouteUpdater, classID) {
+  auto stateV1 = applyInitConfig();
+  ASSERT_NE(nullptr, stateV1);
+  auto rid = RouterID(0);
+  RouteNextHopSet nhop1 = makeNextHops({"1.1.1.10"}); // resolved by intf 1
+  RouteV4::Prefix r1{IPAddressV4("10.1.1.0"), 24};
+
+  RouteUpdater u2(stateV1->getRouteTables());
+  u2.addRoute(rid, r1.network, r1.mask, CLIENT_A,
+              RouteNextHopEntry(nhop1, DISTANCE), RouteClassID(7));
+  auto tables2 = u2.updateDone();
+  ASSERT_NE(nullptr, tables2);
+  tables2->publish();
+  auto t2r1 = GET_ROUTE_V4(tables2, rid, r1);
+  EXPECT_TRUE(t2r1->isResolved());
+  EXPECT_EQ(RouteClassID(7), t2r1->getClassID());
+
+  // Kept through serialization
+  auto rt = RouteV4::fromFollyDynamic(t2r1->toFollyDynamic());
+  EXPECT_EQ(RouteClassID(7), rt->getClassID());
+  EXPECT_TRUE(*rt == *t2r1);
+
+  // The same class is no change, another class is
+  RouteUpdater u3(tables2);
+  u3.addInterfaceAndLinkLocalRoutes(stateV1->getInterfaces());
+  u3.addRoute(rid, r1.network, r1.mask, CLIENT_A,
+              RouteNextHopEntry(nhop1, DISTANCE), RouteClassID(7));
+  EXPECT_EQ(nullptr, u3.updateDone());
+
+  RouteUpdater u4(tables2);
+  u4.addInterfaceAndLinkLocalRoutes(stateV1->getInterfaces());
+  u4.addRoute(rid, r1.network, r1.mask, CLIENT_A,
+              RouteNextHopEntry(nhop1, DISTANCE));
+  auto tables4 = u4.updateDone();
+  ASSERT_NE(nullptr, tables4);
+  EXPECT_EQ(RouteClassID(0), GET_ROUTE_V4(tables4, rid, r1)->getClassID());
+
+  // With several clients, the class comes from the best entry, no matter
+  // which client added its route last
+  RouteUpdater u5(tables2);
+  u5.addInterfaceAndLinkLocalRoutes(stateV1->getInterfaces());
+  u5.addRoute(rid, r1.network, r1.mask, CLIENT_B,
+              RouteNextHopEntry(nhop1, AdminDistance::EBGP), RouteClassID(9));
+  u5.addRoute(rid, r1.network, r1.mask, CLIENT_A,
+              RouteNextHopEntry(nhop1, DISTANCE), RouteClassID(8));
+  auto tables5 = u5.updateDone();
+  ASSERT_NE(nullptr, tables5);
+  tables5->publish();
+  auto t5r1 = GET_ROUTE_V4(tables5, rid, r1);
+  EXPECT_EQ(RouteClassID(9), t5r1->getClassID());
+  EXPECT_EQ(RouteClassID(8), t5r1->getClassIDForClient(CLIENT_A));
+  auto rt5 = RouteV4::fromFollyDynamic(t5r1->toFollyDynamic());
+  EXPECT_TRUE(*rt5 == *t5r1);
+
+  // And goes back to the remaining client's once the best one is removed
+  RouteUpdater u6(tables5);
+  u6.addInterfaceAndLinkLocalRoutes(stateV1->getInterfaces());
+  u6.delRoute(rid, r1.network, r1.mask, CLIENT_B);
+  auto tables6 = u6.updateDone();
+  ASSERT_NE(nullptr, tables6);
+  EXPECT_EQ(RouteClassID(8), GET_ROUTE_V4(tables6, rid, r1)->getClassID());
+}
+
 TEST(Route, serializeRouteTable) {
   auto stateV1 = make_shared<SwitchState>();
   stateV1->publish();
@@ -2500,3 +2566,364 @@ TEST_F(UcmpTest, Twenty) {
 TEST_F(UcmpTest, Ten) {
   runVaryFromHundredTest(10, {10, 10, 10, 1});
 }
+
+TEST(RouteUpdater, batchedResolve) {
+  auto stateV1 = applyInitConfig();
+  ASSERT_NE(nullptr, stateV1);
+  auto rid = RouterID(0);
+
+  auto addRoutes = [&](RouteUpdater* updater) {
+    // Many routes sharing a few next hop sets, some resolved recursively
+    for (int i = 0; i < 50; ++i) {
+      auto nhops = makeNextHops({i % 2 ? "1.1.1.10" : "2.2.2.10"});
+      updater->addRoute(
+          rid, IPAddress(folly::to<std::string>("10.", i, ".0.0")), 16,
+          CLIENT_A, RouteNextHopEntry(nhops, DISTANCE));
+      updater->addRoute(
+          rid, IPAddress(folly::to<std::string>("20.", i, ".0.0")), 16,
+          CLIENT_A, RouteNextHopEntry(makeNextHops({"10.1.0.1"}), DISTANCE));
+    }
+    // A route used to resolve its own next hop, and another route with the
+    // same next hop
+    updater->addRoute(
+        rid, IPAddress("30.0.0.0"), 8, CLIENT_A,
+        RouteNextHopEntry(makeNextHops({"30.1.1.1", "1.1.1.10"}), DISTANCE));
+    updater->addRoute(
+        rid, IPAddress("40.0.0.0"), 8, CLIENT_A,
+        RouteNextHopEntry(makeNextHops({"30.1.1.1", "1.1.1.10"}), DISTANCE));
+    // Unresolvable routes
+    for (int i = 0; i < 10; ++i) {
+      updater->addRoute(
+          rid, IPAddress(folly::to<std::string>("50.", i, ".0.0")), 16,
+          CLIENT_A, RouteNextHopEntry(makeNextHops({"99.9.9.9"}), DISTANCE));
+    }
+  };
+
+  RouteUpdater serial(stateV1->getRouteTables());
+  addRoutes(&serial);
+  auto serialTables = serial.updateDone();
+  ASSERT_NE(nullptr, serialTables);
+
+  gflags::FlagSaver flagSaver;
+  FLAGS_batch_route_resolution = true;
+  RouteUpdater batched(stateV1->getRouteTables());
+  addRoutes(&batched);
+  auto batchedTables = batched.updateDone();
+  ASSERT_NE(nullptr, batchedTables);
+  EXPECT_NODEMAP_MATCH(batchedTables);
+
+  auto serialRib = serialTables->getRouteTable(rid)->getRibV4();
+  auto batchedRib = batchedTables->getRouteTable(rid)->getRibV4();
+  EXPECT_ROUTETABLERIB_MATCH(serialRib, batchedRib);
+  EXPECT_RESOLVED(batchedRib->exactMatch({IPAddressV4("20.7.0.0"), 16}));
+  EXPECT_TRUE(
+      batchedRib->exactMatch({IPAddressV4("50.3.0.0"), 16})->isUnresolvable());
+}
+
+TEST(RouteNextHopEntry, internedNextHopSets) {
+  auto numInterned = RouteNextHopEntry::numInternedNextHopSets();
+  {
+    RouteNextHopEntry entry1(makeNextHops({"1.1.1.10", "2.2.2.10"}), DISTANCE);
+    RouteNextHopEntry entry2(makeNextHops({"2.2.2.10", "1.1.1.10"}), DISTANCE);
+    RouteNextHopEntry entry3(makeNextHops({"1.1.1.10"}), DISTANCE);
+    EXPECT_EQ(&entry1.getNextHopSet(), &entry2.getNextHopSet());
+    EXPECT_NE(&entry1.getNextHopSet(), &entry3.getNextHopSet());
+    EXPECT_EQ(entry1, entry2);
+    EXPECT_FALSE(entry1 < entry2);
+    EXPECT_FALSE(entry2 < entry1);
+    EXPECT_FALSE(entry1 == entry3);
+    EXPECT_EQ(numInterned + 2, RouteNextHopEntry::numInternedNextHopSets());
+
+    auto parsed = RouteNextHopEntry::fromFollyDynamic(entry1.toFollyDynamic());
+    EXPECT_EQ(&entry1.getNextHopSet(), &parsed.getNextHopSet());
+    EXPECT_EQ(numInterned + 2, RouteNextHopEntry::numInternedNextHopSets());
+  }
+  EXPECT_EQ(numInterned, RouteNextHopEntry::numInternedNextHopSets());
+}
+
+TEST(Route, unicastRouteToNextHopSet) {
+  UnicastRoute withAddrs;
+  for (auto ip : {"10.0.0.1", "face:b00c::1"}) {
+    withAddrs.nextHopAddrs.push_back(
+        facebook::network::toBinaryAddress(folly::IPAddress(ip)));
+  }
+  UnicastRoute withNextHops;
+  auto nhops = makeNextHops({"10.0.0.2", "fe80::2"});
+  nhops.emplace(ResolvedNextHop(IPAddress("fe80::1"), InterfaceID(4), 3));
+  withNextHops.nextHops = util::fromRouteNextHopSet(nhops);
+  // nextHops wins over nextHopAddrs
+  withNextHops.nextHopAddrs = withAddrs.nextHopAddrs;
+
+  // The same scratch set is reused from one route to the next
+  RouteNextHopSet scratch;
+  util::toRouteNextHopSet(withAddrs, &scratch);
+  EXPECT_EQ(makeNextHops({"10.0.0.1", "face:b00c::1"}), scratch);
+  util::toRouteNextHopSet(withNextHops, &scratch);
+  EXPECT_EQ(nhops, scratch);
+  EXPECT_EQ(util::toRouteNextHopSet(withNextHops.nextHops), scratch);
+  util::toRouteNextHopSet(UnicastRoute(), &scratch);
+  EXPECT_TRUE(scratch.empty());
+
+  // Entries made from the scratch set share the interned set
+  util::toRouteNextHopSet(withNextHops, &scratch);
+  RouteNextHopEntry entry1(scratch, DISTANCE);
+  RouteNextHopEntry entry2(nhops, DISTANCE);
+  EXPECT_EQ(&entry1.getNextHopSet(), &entry2.getNextHopSet());
+  EXPECT_EQ(nhops, scratch);
+}
+
+TEST(RouteUpdater, removeStaleRoutesForClient) {
+  auto stateV1 = applyInitConfig();
+  ASSERT_NE(nullptr, stateV1);
+  auto rid = RouterID(0);
+  auto nhops = makeNextHops({"1.1.1.10"});
+  std::vector<folly::CIDRNetwork> prefixes{
+      {IPAddress("10.1.1.0"), 24},
+      {IPAddress("10.2.2.0"), 24},
+      {IPAddress("1001::"), 48}};
+
+  RouteUpdater u1(stateV1->getRouteTables());
+  for (const auto& prefix : prefixes) {
+    u1.addRoute(rid, prefix.first, prefix.second, CLIENT_A,
+                RouteNextHopEntry(nhops, DISTANCE));
+  }
+  u1.addRoute(rid, IPAddress("10.1.1.0"), 24, CLIENT_B,
+              RouteNextHopEntry(nhops, DISTANCE));
+  auto tables1 = u1.updateDone();
+  ASSERT_NE(nullptr, tables1);
+  tables1->publish();
+
+  // Syncing the same routes changes nothing
+  RouteUpdater u2(tables1);
+  for (const auto& prefix : prefixes) {
+    u2.addRoute(rid, prefix.first, prefix.second, CLIENT_A,
+                RouteNextHopEntry(nhops, DISTANCE));
+  }
+  u2.removeStaleRoutesForClient(rid, CLIENT_A, prefixes);
+  EXPECT_EQ(nullptr, u2.updateDone());
+
+  // Syncing a subset only deletes client A's entries for the rest
+  std::vector<folly::CIDRNetwork> subset{{IPAddress("10.2.2.0"), 24}};
+  RouteUpdater u3(tables1);
+  u3.addRoute(rid, IPAddress("10.2.2.0"), 24, CLIENT_A,
+              RouteNextHopEntry(nhops, DISTANCE));
+  u3.removeStaleRoutesForClient(rid, CLIENT_A, subset);
+  auto tables3 = u3.updateDone();
+  ASSERT_NE(nullptr, tables3);
+  EXPECT_NODEMAP_MATCH(tables3);
+
+  auto ribV4 = tables3->getRouteTable(rid)->getRibV4();
+  auto r1 = ribV4->exactMatch({IPAddressV4("10.1.1.0"), 24});
+  ASSERT_NE(nullptr, r1);
+  EXPECT_EQ(nullptr, r1->getEntryForClient(CLIENT_A));
+  EXPECT_NE(nullptr, r1->getEntryForClient(CLIENT_B));
+  EXPECT_NE(nullptr, ribV4->exactMatch({IPAddressV4("10.2.2.0"), 24}));
+  auto ribV6 = tables3->getRouteTable(rid)->getRibV6();
+  EXPECT_EQ(nullptr, ribV6->exactMatch({IPAddressV6("1001::"), 48}));
+}
+
+TEST(RouteTableRib, batchedLongestMatch) {
+  auto stateV1 = applyInitConfig();
+  ASSERT_NE(nullptr, stateV1);
+  auto rid = RouterID(0);
+  RouteUpdater u1(stateV1->getRouteTables());
+  auto nhops = makeNextHops({"1.1.1.10"});
+  u1.addRoute(rid, IPAddress("10.0.0.0"), 8, CLIENT_A,
+              RouteNextHopEntry(nhops, DISTANCE));
+  u1.addRoute(rid, IPAddress("10.1.0.0"), 16, CLIENT_A,
+              RouteNextHopEntry(nhops, DISTANCE));
+  u1.addRoute(rid, IPAddress("10.1.1.0"), 24, CLIENT_A,
+              RouteNextHopEntry(nhops, DISTANCE));
+  auto tables1 = u1.updateDone();
+  ASSERT_NE(nullptr, tables1);
+
+  auto rib = tables1->getRouteTable(rid)->getRibV4();
+  std::vector<IPAddressV4> addrs;
+  for (int i = 0; i < 100; ++i) {
+    addrs.emplace_back(folly::to<std::string>("10.", i % 3, ".", i % 5, ".1"));
+  }
+  addrs.emplace_back("11.0.0.1");
+  std::vector<std::shared_ptr<Route<IPAddressV4>>> routes(addrs.size());
+  rib->longestMatch(folly::range(addrs.begin(), addrs.end()), routes.data());
+  for (size_t i = 0; i < addrs.size(); ++i) {
+    EXPECT_EQ(rib->longestMatch(addrs[i]), routes[i]);
+  }
+  EXPECT_EQ(nullptr, routes.back());
+  EXPECT_EQ(24, routes[5 * 3 + 1]->prefix().mask);
+}
+
+TEST(RouteTableRib, clientPrefixIndex) {
+  auto stateV1 = applyInitConfig();
+  ASSERT_NE(nullptr, stateV1);
+  auto rid = RouterID(0);
+  auto nhops = makeNextHops({"1.1.1.10"});
+
+  RouteUpdater u1(stateV1->getRouteTables());
+  u1.addRoute(rid, IPAddress("10.1.1.0"), 24, CLIENT_A,
+              RouteNextHopEntry(nhops, DISTANCE));
+  u1.addRoute(rid, IPAddress("10.1.1.0"), 24, CLIENT_B,
+              RouteNextHopEntry(nhops, DISTANCE));
+  u1.addRoute(rid, IPAddress("10.2.2.0"), 24, CLIENT_A,
+              RouteNextHopEntry(nhops, DISTANCE));
+  u1.addRoute(rid, IPAddress("1001::"), 48, CLIENT_B,
+              RouteNextHopEntry(makeNextHops({"1::10"}), DISTANCE));
+  auto tables1 = u1.updateDone();
+  ASSERT_NE(nullptr, tables1);
+  tables1->publish();
+
+  auto checkIndex = [&](const std::shared_ptr<RouteTableMap>& tables) {
+    // Each client's index holds exactly the prefixes it has next hops for
+    for (const auto& rt : *tables) {
+      auto ribV4 = rt->getRibV4();
+      for (auto client : {CLIENT_A, CLIENT_B}) {
+        size_t numRoutes = 0;
+        for (const auto& route : *ribV4->routes()) {
+          if (route->getEntryForClient(client)) {
+            ++numRoutes;
+          }
+        }
+        auto prefixes = ribV4->getClientPrefixesIf(client);
+        EXPECT_EQ(numRoutes, prefixes ? prefixes->size() : 0);
+        if (!prefixes) {
+          continue;
+        }
+        for (const auto& prefix : *prefixes) {
+          auto route = ribV4->exactMatch(prefix.first);
+          ASSERT_NE(nullptr, route);
+          EXPECT_NE(nullptr, route->getEntryForClient(client));
+        }
+      }
+    }
+  };
+  checkIndex(tables1);
+  auto ribV4 = tables1->getRouteTable(rid)->getRibV4();
+  EXPECT_EQ(2, ribV4->getClientPrefixesIf(CLIENT_A)->size());
+  EXPECT_EQ(1, ribV4->getClientPrefixesIf(CLIENT_B)->size());
+
+  // The index is rebuilt when loading the rib
+  auto loaded = RouteTableMap::fromFollyDynamic(tables1->toFollyDynamic());
+  checkIndex(loaded);
+
+  RouteUpdater u2(tables1);
+  u2.delRoute(rid, IPAddress("10.1.1.0"), 24, CLIENT_A);
+  u2.removeAllRoutesForClient(rid, CLIENT_B);
+  auto tables2 = u2.updateDone();
+  ASSERT_NE(nullptr, tables2);
+  checkIndex(tables2);
+  auto ribV4v2 = tables2->getRouteTable(rid)->getRibV4();
+  EXPECT_EQ(1, ribV4v2->getClientPrefixesIf(CLIENT_A)->size());
+  EXPECT_EQ(nullptr, ribV4v2->getClientPrefixesIf(CLIENT_B));
+  EXPECT_EQ(nullptr, ribV4v2->exactMatch({IPAddressV4("10.1.1.0"), 24}));
+  auto ribV6 = tables2->getRouteTable(rid)->getRibV6();
+  EXPECT_EQ(nullptr, ribV6->getClientPrefixesIf(CLIENT_B));
+  EXPECT_EQ(nullptr, ribV6->exactMatch({IPAddressV6("1001::"), 48}));
+
+  // The original tables are unaffected
+  EXPECT_EQ(2, ribV4->getClientPrefixesIf(CLIENT_A)->size());
+  EXPECT_EQ(1, ribV4->getClientPrefixesIf(CLIENT_B)->size());
+}
+
+TEST(RouteTableRib, toFollyDynamicAt) {
+  auto stateV1 = applyInitConfig();
+  ASSERT_NE(nullptr, stateV1);
+  auto rid = RouterID(0);
+  RouteUpdater u1(stateV1->getRouteTables());
+  for (int i = 0; i < 5; ++i) {
+    u1.addRoute(rid, IPAddress(folly::to<std::string>("10.", i, ".0.0")), 16,
+                CLIENT_A,
+                RouteNextHopEntry(makeNextHops({"1.1.1.10"}), DISTANCE));
+  }
+  auto stateV2 = stateV1->clone();
+  stateV2->resetRouteTables(u1.updateDone());
+  stateV2->publish();
+  auto ribV4 = stateV2->getRouteTables()->getRouteTable(rid)->getRibV4();
+  auto allRoutes = ribV4->toFollyDynamic()["routes"];
+  ASSERT_LT(4, allRoutes.size());
+
+  // Only the requested page of routes is serialized
+  std::vector<std::string> path = {
+      "routeTables", "entries", "0", "ribV4", "routes"};
+  auto page = stateV2->toFollyDynamicAt(path, 2, 2);
+  ASSERT_EQ(2, page.size());
+  EXPECT_EQ(allRoutes[2], page[0]);
+  EXPECT_EQ(allRoutes[3], page[1]);
+  auto last = stateV2->toFollyDynamicAt(path, allRoutes.size() - 1, 10);
+  ASSERT_EQ(1, last.size());
+  EXPECT_EQ(allRoutes[allRoutes.size() - 1], last[0]);
+  EXPECT_EQ(0, stateV2->toFollyDynamicAt(path, allRoutes.size(), 10).size());
+
+  // The rib itself pages its routes the same way
+  path.pop_back();
+  auto rib = stateV2->toFollyDynamicAt(path, 1, 1);
+  ASSERT_EQ(1, rib["routes"].size());
+  EXPECT_EQ(allRoutes[1], rib["routes"][0]);
+
+  // A single route
+  path.push_back("routes");
+  path.push_back("3");
+  EXPECT_EQ(allRoutes[3], stateV2->toFollyDynamicAt(path, 0, 10));
+  path.back() = folly::to<std::string>(allRoutes.size());
+  EXPECT_THROW(stateV2->toFollyDynamicAt(path, 0, 10), FbossError);
+}
+
+TEST(RouteTableRib, applyJsonPatch) {
+  auto stateV1 = applyInitConfig();
+  ASSERT_NE(nullptr, stateV1);
+  auto rid = RouterID(0);
+  RouteUpdater u1(stateV1->getRouteTables());
+  u1.addRoute(rid, IPAddress("10.1.1.0"), 24, CLIENT_A,
+              RouteNextHopEntry(makeNextHops({"1.1.1.10"}), DISTANCE));
+  u1.addRoute(rid, IPAddress("10.2.2.0"), 24, CLIENT_A,
+              RouteNextHopEntry(makeNextHops({"1.1.1.10"}), DISTANCE));
+  auto stateV2 = stateV1->clone();
+  stateV2->resetRouteTables(u1.updateDone());
+  stateV2->publish();
+
+  auto table = stateV2->getRouteTables()->getRouteTable(rid);
+  auto ribV4 = table->getRibV4();
+  auto prefix = makePrefixV4("10.1.1.0/24");
+  auto oldRoute = ribV4->exactMatch(prefix);
+  ASSERT_NE(nullptr, oldRoute);
+  ASSERT_FALSE(oldRoute->isConnected());
+  size_t index = 0;
+  for (const auto& route : *ribV4->routes()) {
+    if (route == oldRoute) {
+      break;
+    }
+    ++index;
+  }
+  std::vector<std::string> path = {
+      "routeTables", "entries", "0", "ribV4", "routes",
+      folly::to<std::string>(index)};
+  folly::dynamic patch = folly::dynamic::object(
+      // Mark the route as connected
+      "flags", oldRoute->toFollyDynamic()["flags"].asInt() | 0x1);
+  auto stateV3 = stateV2->applyJsonPatch(path, patch);
+  stateV3->publish();
+
+  // Only the patched route and the nodes above it are new
+  auto newRib = stateV3->getRouteTables()->getRouteTable(rid)->getRibV4();
+  auto newRoute = newRib->exactMatch(prefix);
+  ASSERT_NE(nullptr, newRoute);
+  EXPECT_NE(oldRoute, newRoute);
+  EXPECT_TRUE(newRoute->isConnected());
+  EXPECT_EQ(oldRoute->getForwardInfo(), newRoute->getForwardInfo());
+  EXPECT_EQ(newRoute, newRib->longestMatch(IPAddressV4("10.1.1.1")));
+  auto otherPrefix = makePrefixV4("10.2.2.0/24");
+  EXPECT_EQ(ribV4->exactMatch(otherPrefix), newRib->exactMatch(otherPrefix));
+  EXPECT_EQ(ribV4->size(), newRib->size());
+  auto clientPrefixes = newRib->getClientPrefixesIf(CLIENT_A);
+  EXPECT_EQ(2, clientPrefixes->size());
+  EXPECT_NE(clientPrefixes->end(), clientPrefixes->find(prefix));
+  EXPECT_EQ(
+      table->getRibV6(),
+      stateV3->getRouteTables()->getRouteTable(rid)->getRibV6());
+  EXPECT_EQ(stateV2->getPorts(), stateV3->getPorts());
+  EXPECT_EQ(stateV2->getInterfaces(), stateV3->getInterfaces());
+
+  // Paths that lead nowhere are rejected
+  path[5] = folly::to<std::string>(ribV4->size());
+  EXPECT_THROW(stateV2->applyJsonPatch(path, patch), FbossError);
+  path = {"noSuchNode"};
+  EXPECT_THROW(stateV2->applyJsonPatch(path, patch), FbossError);
+}
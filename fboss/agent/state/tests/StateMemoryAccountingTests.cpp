@@ -0,0 +1,100 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "fboss/agent/state/StateMemoryAccounting.h"
+#include "fboss/agent/state/Port.h"
+#include "fboss/agent/state/PortMap.h"
+#include "fboss/agent/state/RouteUpdater.h"
+#include "fboss/agent/state/SwitchState.h"
+
+#include <gtest/gtest.h>
+
+using namespace facebook::fboss;
+
+namespace {
+std::shared_ptr<SwitchState> makeState(int numPorts) {
+  auto state = std::make_shared<SwitchState>();
+  for (int i = 1; i <= numPorts; ++i) {
+    state->registerPort(PortID(i), folly::to<std::string>("port", i));
+  }
+  state->publish();
+  return state;
+}
+}
+
+TEST(StateMemoryAccounting, nodeTypes) {
+  auto state = makeState(10);
+  auto usage = accountStateMemory(state);
+  EXPECT_EQ(0, usage.olderGenerations);
+  EXPECT_EQ(0, usage.total.sharedBytes);
+  EXPECT_EQ(0, usage.retainedBytes);
+  EXPECT_EQ(1, usage.byNodeType["SwitchState"].nodes);
+  EXPECT_EQ(10, usage.byNodeType["Port"].nodes);
+  EXPECT_LT(0, usage.byNodeType["PortMap"].bytes);
+
+  uint64_t nodes = 0;
+  uint64_t bytes = 0;
+  for (const auto& entry : usage.byNodeType) {
+    nodes += entry.second.nodes;
+    bytes += entry.second.bytes;
+  }
+  EXPECT_EQ(usage.total.nodes, nodes);
+  EXPECT_EQ(usage.total.bytes, bytes);
+}
+
+TEST(StateMemoryAccounting, sharedWithOlderGenerations) {
+  auto state1 = makeState(10);
+
+  // Change a single port
+  auto state2 = state1->clone();
+  auto ports = state2->getPorts()->clone();
+  auto port = ports->getPort(PortID(3))->clone();
+  port->setDescription("changed");
+  ports->updatePort(port);
+  state2->resetPorts(ports);
+  state2->publish();
+
+  auto usage = accountStateMemory(state2, {state1});
+  EXPECT_EQ(1, usage.olderGenerations);
+  const auto& ports2 = usage.byNodeType["Port"];
+  EXPECT_EQ(10, ports2.nodes);
+  // The other 9 ports are the same nodes in both states
+  EXPECT_EQ(ports2.bytes * 9, ports2.sharedBytes * 10);
+  EXPECT_EQ(0, usage.byNodeType["SwitchState"].sharedBytes);
+  // The old port 3, port map and switch state
+  EXPECT_LE(
+      usage.byNodeType["SwitchState"].bytes + ports2.bytes / 10,
+      usage.retainedBytes);
+
+  // A state is not its own older generation
+  usage = accountStateMemory(state2, {state2});
+  EXPECT_EQ(0, usage.olderGenerations);
+  EXPECT_EQ(0, usage.total.sharedBytes);
+}
+
+TEST(StateMemoryAccounting, byVrf) {
+  auto state = makeState(1)->clone();
+  RouteUpdater updater(state->getRouteTables());
+  updater.addRoute(
+      RouterID(1), folly::IPAddress("10.0.0.0"), 24, ClientID(1001),
+      RouteNextHopEntry(RouteForwardAction::DROP,
+                        AdminDistance::MAX_ADMIN_DISTANCE));
+  auto tables = updater.updateDone();
+  ASSERT_NE(nullptr, tables);
+  state->resetRouteTables(tables);
+  state->publish();
+
+  auto usage = accountStateMemory(state);
+  ASSERT_EQ(1, usage.byVrf.size());
+  const auto& vrf = usage.byVrf[RouterID(1)];
+  // The table, its two ribs and their route maps, and at least the new route
+  EXPECT_LE(6, vrf.nodes);
+  EXPECT_EQ(1, usage.byNodeType["RouteTable"].nodes);
+  EXPECT_LT(vrf.bytes, usage.total.bytes);
+}
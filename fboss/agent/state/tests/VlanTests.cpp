@@ -21,6 +21,7 @@
 #include "fboss/agent/state/VlanMap.h"
 #include "fboss/agent/gen-cpp2/switch_config_types.h"
 
+#include <folly/Conv.h>
 #include <gtest/gtest.h>
 #include <string>
 
@@ -271,6 +272,46 @@ void checkChangedVlans(const shared_ptr<VlanMap>& oldVlans,
   EXPECT_EQ(removedIDs, foundRemoved);
 }
 
+TEST(Vlan, responseTableLookup) {
+  // Enough entries for several to land in the same slots
+  auto arpResp = make_shared<ArpResponseTable>();
+  for (int i = 1; i <= 100; ++i) {
+    arpResp->setEntry(
+        IPAddressV4(folly::to<string>("10.0.", i / 10, ".", i % 10)),
+        MacAddress("00:02:00:00:00:01"),
+        InterfaceID(i));
+  }
+  auto ndpResp = make_shared<NdpResponseTable>();
+  ndpResp->setEntry(
+      IPAddressV6("2401:db00::1"),
+      MacAddress("00:02:00:00:00:02"),
+      InterfaceID(1));
+  auto emptyResp = make_shared<NdpResponseTable>();
+
+  // The same entries are found before and after the tables are published
+  for (bool published : {false, true}) {
+    if (published) {
+      arpResp->publish();
+      ndpResp->publish();
+      emptyResp->publish();
+    }
+    for (int i = 1; i <= 100; ++i) {
+      auto entry = arpResp->getEntry(
+          IPAddressV4(folly::to<string>("10.0.", i / 10, ".", i % 10)));
+      ASSERT_TRUE(entry.hasValue());
+      EXPECT_EQ(InterfaceID(i), entry->interfaceID);
+    }
+    EXPECT_FALSE(arpResp->getEntry(IPAddressV4("10.0.0.0")).hasValue());
+    EXPECT_FALSE(arpResp->getEntry(IPAddressV4("10.0.10.1")).hasValue());
+
+    auto entry = ndpResp->getEntry(IPAddressV6("2401:db00::1"));
+    ASSERT_TRUE(entry.hasValue());
+    EXPECT_EQ(MacAddress("00:02:00:00:00:02"), entry->mac);
+    EXPECT_FALSE(ndpResp->getEntry(IPAddressV6("2401:db00::2")).hasValue());
+    EXPECT_FALSE(emptyResp->getEntry(IPAddressV6("2401:db00::1")).hasValue());
+  }
+}
+
 TEST(VlanMap, applyConfig) {
   auto platform = createMockPlatform();
   auto stateV0 = make_shared<SwitchState>();
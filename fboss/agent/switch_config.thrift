@@ -332,9 +332,56 @@ struct TrafficPolicyConfig {
   1: list<MatchToAction> matchToAction = []
 }
 
+/**
+ * A rate limit the agent applies in software to packets trapped to the CPU,
+ * before parsing them.  This complements the CPU queue rate limits applied
+ * in hardware.
+ *
+ * A packet matches a policer if its ethertype matches, and its IP protocol
+ * and ingress port also match for policers that set them.  Each packet is
+ * only policed by the first policer it matches.
+ */
+struct CPUSoftwarePolicer {
+  1: string name
+  2: i32 etherType
+  // The IPv4 protocol or IPv6 next header
+  3: optional i16 ipProtocol
+  // The logical port the packet was received on
+  4: optional i32 port
+  5: i32 packetsPerSec
+  // The number of packets that may be admitted back to back
+  6: i32 burstSize = 1
+  // The bounds the agent may tune packetsPerSec within as the CPU load
+  // allows, raising it while the policer drops packets and the CPU keeps up,
+  // and lowering it while the CPU is backlogged.  The rate is only tuned if
+  // both are set and minPacketsPerSec is below maxPacketsPerSec.
+  7: optional i32 minPacketsPerSec
+  8: optional i32 maxPacketsPerSec
+}
+
+/**
+ * A limit on the ICMP errors (time exceeded and packet too big) the agent
+ * sends in reply to trapped packets, so that traceroutes and MTU mismatches
+ * don't take over the CPU.  Errors over either the switch-wide limit or the
+ * limit for the prefix of the packet's source are not sent.
+ */
+struct IcmpErrorRateLimit {
+  1: i32 packetsPerSec
+  // The number of errors that may be sent back to back
+  2: i32 burstSize = 1
+  // The limit for each source prefix, with 0 meaning no per-source limit
+  3: i32 perSourcePacketsPerSec = 0
+  4: i32 perSourceBurstSize = 1
+  // The length of the prefixes sources are limited by
+  5: i16 v4SourcePrefixLength = 24
+  6: i16 v6SourcePrefixLength = 64
+}
+
 struct CPUTrafficPolicyConfig {
   1: optional TrafficPolicyConfig trafficPolicy
   2: optional map<PacketRxReason, i16> rxReasonToCPUQueue
+  3: optional list<CPUSoftwarePolicer> softwarePolicers
+  4: optional IcmpErrorRateLimit icmpErrorRateLimit
 }
 
 enum PacketRxReason {
@@ -351,6 +398,18 @@ enum PacketRxReason {
 /**
  * Configuration for a single logical port
  */
+// Ingress buffer policy of a port.  Traffic arriving on the port first uses
+// its reserved cells, then competes for the shared pool; the headroom
+// absorbs what is still in flight after the port asks its peer to pause.
+struct PortBuffer {
+  // Bytes guaranteed to the port, outside the shared pool
+  1: optional i32 reservedBytes
+  // Bytes kept for packets arriving after PAUSE/PFC frames are sent
+  2: optional i32 headroomBytes
+  // How much of the free shared pool the port may use (dynamic alpha)
+  3: optional MMUScalingFactor scalingFactor
+}
+
 struct Port {
   1: i32 logicalID
   /*
@@ -431,6 +490,11 @@ struct Port {
    * Should FEC be on for this port?
    */
   16: PortFEC fec = PortFEC.OFF
+
+  /**
+   * Ingress buffer policy; the hardware defaults are kept if unset
+   */
+  17: optional PortBuffer buffer
 }
 
 enum LacpPortRate {
@@ -654,6 +718,11 @@ struct StaticRouteNoNextHops {
 struct SflowCollector {
   1: string ip
   2: i16 port
+  /*
+   * The most samples a second to send this collector.  Samples over the
+   * limit are dropped.  0 means no limit.
+   */
+  3: i32 maxSamplesPerSec = 0
 }
 
 enum LoadBalancerID {
@@ -696,6 +765,25 @@ struct LoadBalancer {
   4: optional i32 seed
 }
 
+/**
+ * Dampening of flapping links, along the lines of BGP route flap dampening
+ * (RFC 2439).
+ *
+ * Each time a port's link goes down the port gets penaltyPerFlap, and its
+ * penalty halves every halfLifeSeconds.  Once the penalty is over
+ * suppressThreshold the port is suppressed: it is kept down, without its
+ * link coming back up being passed on to the neighbor tables and routes,
+ * until the penalty has decayed under reuseThreshold, or for at most
+ * maxSuppressSeconds after its last flap.
+ */
+struct LinkFlapDampening {
+  1: i32 penaltyPerFlap = 1000
+  2: i32 suppressThreshold = 2000
+  3: i32 reuseThreshold = 750
+  4: i32 halfLifeSeconds = 15
+  5: i32 maxSuppressSeconds = 60
+}
+
 /**
  * The configuration for a switch.
  *
@@ -778,4 +866,6 @@ struct SwitchConfig {
   28: optional list<PortQueue> cpuQueues
   29: optional CPUTrafficPolicyConfig cpuTrafficPolicy
   30: list<LoadBalancer> loadBalancers = []
+  // Links don't flap dampen if not set
+  31: optional LinkFlapDampening linkFlapDampening
 }
@@ -23,6 +23,7 @@ struct PortQueueFields {
  // TODO: replace with switch_config.StreamType?
  6: string streamType
  7: optional switch_config.ActiveQueueManagement aqm;
+ 8: optional i32 sharedBytes
 }
 
 // Port configuration and oper state fields
@@ -48,4 +49,5 @@ struct PortFields {
  13: i32 sFlowIngressRate
  14: i32 sFlowEgressRate
  15: list<PortQueueFields> queues
+ 16: optional switch_config.PortBuffer buffer
 }
@@ -0,0 +1,123 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "fboss/agent/AclCompiler.h"
+#include "fboss/agent/state/AclEntry.h"
+
+#include <folly/IPAddress.h>
+#include <gtest/gtest.h>
+
+using namespace facebook::fboss;
+using folly::IPAddress;
+using std::make_shared;
+using std::shared_ptr;
+
+namespace {
+
+shared_ptr<AclEntry> makeAcl(
+    const std::string& name,
+    cfg::AclActionType action,
+    const std::string& dstIp = "") {
+  static int priority = 0;
+  auto acl = make_shared<AclEntry>(++priority, name);
+  acl->setActionType(action);
+  if (!dstIp.empty()) {
+    acl->setDstIp(IPAddress::createNetwork(dstIp));
+  }
+  return acl;
+}
+
+std::vector<std::string> names(const CompiledAcls& compiled) {
+  std::vector<std::string> result;
+  for (const auto& entry : compiled.entries) {
+    result.push_back(entry->getID());
+  }
+  return result;
+}
+
+const auto kDeny = cfg::AclActionType::DENY;
+const auto kPermit = cfg::AclActionType::PERMIT;
+
+} // unnamed namespace
+
+TEST(AclCompiler, shadowed) {
+  auto wide = makeAcl("wide", kDeny, "10.0.0.0/8");
+  auto narrow = makeAcl("narrow", kPermit, "10.1.0.0/16");
+  narrow->setProto(6);
+  auto other = makeAcl("other", kPermit, "11.0.0.0/8");
+
+  auto compiled = compileAcls({wide, narrow, other});
+  EXPECT_EQ((std::vector<std::string>{"wide", "other"}), names(compiled));
+  EXPECT_EQ(std::vector<std::string>{"narrow"}, compiled.shadowed);
+}
+
+TEST(AclCompiler, redundant) {
+  auto narrow = makeAcl("narrow", kDeny, "10.1.0.0/16");
+  auto unrelated = makeAcl("unrelated", kPermit, "11.0.0.0/8");
+  auto wide = makeAcl("wide", kDeny, "10.0.0.0/8");
+
+  auto compiled = compileAcls({narrow, unrelated, wide});
+  EXPECT_EQ((std::vector<std::string>{"unrelated", "wide"}), names(compiled));
+  EXPECT_EQ(std::vector<std::string>{"narrow"}, compiled.redundant);
+}
+
+TEST(AclCompiler, notRedundantPastConflict) {
+  // The permit in between catches some of what narrow denies
+  auto narrow = makeAcl("narrow", kDeny, "10.1.0.0/16");
+  auto overlap = makeAcl("overlap", kPermit);
+  overlap->setProto(6);
+  auto wide = makeAcl("wide", kDeny, "10.0.0.0/8");
+
+  auto compiled = compileAcls({narrow, overlap, wide});
+  EXPECT_EQ(3, compiled.entries.size());
+  EXPECT_TRUE(compiled.redundant.empty());
+}
+
+TEST(AclCompiler, mergeQuarters) {
+  auto compiled = compileAcls({
+      makeAcl("q0", kDeny, "10.0.0.0/26"),
+      makeAcl("q1", kDeny, "10.0.0.64/26"),
+      makeAcl("q2", kDeny, "10.0.0.128/26"),
+      makeAcl("q3", kDeny, "10.0.0.192/26"),
+  });
+  ASSERT_EQ(std::vector<std::string>{"q0"}, names(compiled));
+  EXPECT_EQ(IPAddress::createNetwork("10.0.0.0/24"),
+            compiled.entries[0]->getDstIp());
+  EXPECT_EQ(3, compiled.merged.size());
+}
+
+TEST(AclCompiler, mergePortRanges) {
+  auto low = makeAcl("low", kDeny);
+  low->setDstL4PortRange(AclL4PortRange(100, 199));
+  auto high = makeAcl("high", kDeny);
+  high->setDstL4PortRange(AclL4PortRange(200, 299));
+  auto compiled = compileAcls({low, high});
+  ASSERT_EQ(std::vector<std::string>{"low"}, names(compiled));
+  EXPECT_EQ(AclL4PortRange(100, 299),
+            *compiled.entries[0]->getDstL4PortRange());
+
+  // Single ports stay exact matches, rather than take a range checker
+  auto port80 = makeAcl("port80", kDeny);
+  port80->setDstL4PortRange(AclL4PortRange(80, 80));
+  auto port81 = makeAcl("port81", kDeny);
+  port81->setDstL4PortRange(AclL4PortRange(81, 81));
+  EXPECT_EQ(2, compileAcls({port80, port81}).entries.size());
+}
+
+TEST(AclCompiler, countersKept) {
+  MatchAction counted;
+  counted.setPacketCounter(cfg::PacketCounterMatchAction());
+  auto wide = makeAcl("wide", kDeny, "10.0.0.0/8");
+  auto narrow = makeAcl("narrow", kDeny, "10.1.0.0/16");
+  narrow->setAclAction(counted);
+
+  auto compiled = compileAcls({wide, narrow});
+  EXPECT_EQ(2, compiled.entries.size());
+  EXPECT_TRUE(compiled.shadowed.empty());
+}
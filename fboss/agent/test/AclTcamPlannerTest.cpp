@@ -0,0 +1,146 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "fboss/agent/hw/AclTcamPlanner.h"
+#include "fboss/agent/FbossError.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <set>
+
+using namespace facebook::fboss;
+using Action = AclTcamPlanner::Action;
+
+namespace {
+
+std::vector<AclTcamPlanner::Entry> makeEntries(
+    const std::vector<std::string>& names,
+    const std::set<std::string>& changed = {}) {
+  std::vector<AclTcamPlanner::Entry> entries;
+  for (const auto& name : names) {
+    entries.push_back({name, changed.count(name) > 0});
+  }
+  return entries;
+}
+
+// Check the entries are in slots that match them in order
+void checkOrder(
+    const AclTcamPlanner& planner,
+    const std::vector<std::string>& names) {
+  int last = -1;
+  for (const auto& name : names) {
+    auto slot = planner.getSlot(name);
+    ASSERT_TRUE(slot.hasValue()) << name;
+    EXPECT_LT(last, *slot) << name;
+    last = *slot;
+  }
+}
+
+int countSteps(const AclTcamPlanner::Plan& plan, Action action) {
+  return std::count_if(
+      plan.steps.begin(), plan.steps.end(), [=](const auto& step) {
+        return step.action == action;
+      });
+}
+
+} // unnamed namespace
+
+TEST(AclTcamPlanner, SpreadOverSlices) {
+  AclTcamPlanner planner(4, 8);
+  std::vector<std::string> names{"a", "b", "c", "d"};
+  auto plan = planner.plan(makeEntries(names));
+  EXPECT_EQ(4, countSteps(plan, Action::ADD));
+  EXPECT_EQ(0, plan.breakBeforeMake);
+  planner.apply(plan);
+  checkOrder(planner, names);
+  // One entry in each slice
+  for (int i = 0; i < names.size(); ++i) {
+    EXPECT_EQ(i, planner.getSlice(*planner.getSlot(names[i])));
+  }
+}
+
+TEST(AclTcamPlanner, InsertWithoutMoves) {
+  AclTcamPlanner planner(2, 16);
+  planner.apply(planner.plan(makeEntries({"a", "b", "c", "d"})));
+
+  // Inserting ahead of the others shifts their priorities, but not their
+  // order, so nothing moves.
+  std::vector<std::string> names{"new", "a", "b", "x", "c", "d"};
+  auto plan = planner.plan(makeEntries(names));
+  EXPECT_EQ(4, plan.unmoved);
+  EXPECT_EQ(2, countSteps(plan, Action::ADD));
+  EXPECT_EQ(0, countSteps(plan, Action::MOVE));
+  EXPECT_FALSE(plan.relaidOut);
+  planner.apply(plan);
+  checkOrder(planner, names);
+}
+
+TEST(AclTcamPlanner, MoveFewest) {
+  AclTcamPlanner planner(1, 32);
+  planner.apply(planner.plan(makeEntries({"a", "b", "c", "d", "e"})));
+
+  // Only e needs to move to keep the others in order
+  std::vector<std::string> names{"a", "e", "b", "c", "d"};
+  auto plan = planner.plan(makeEntries(names));
+  ASSERT_EQ(1, plan.steps.size());
+  EXPECT_EQ(Action::MOVE, plan.steps[0].action);
+  EXPECT_EQ("e", plan.steps[0].name);
+  EXPECT_EQ(4, plan.unmoved);
+  planner.apply(plan);
+  checkOrder(planner, names);
+}
+
+TEST(AclTcamPlanner, MakeBeforeBreak) {
+  AclTcamPlanner planner(2, 8);
+  planner.apply(planner.plan(makeEntries({"a", "b", "c"})));
+
+  std::vector<std::string> names{"a", "b2", "c"};
+  auto plan = planner.plan(makeEntries(names, {"a"}));
+  EXPECT_EQ(0, plan.breakBeforeMake);
+  // a is replaced into a free slot, and b2 added before b is removed
+  ASSERT_EQ(3, plan.steps.size());
+  EXPECT_EQ(Action::REPLACE, plan.steps[0].action);
+  EXPECT_EQ(Action::ADD, plan.steps[1].action);
+  EXPECT_EQ(Action::REMOVE, plan.steps[2].action);
+  EXPECT_EQ("b", plan.steps[2].name);
+  planner.apply(plan);
+  checkOrder(planner, names);
+  EXPECT_FALSE(planner.getSlot("b").hasValue());
+}
+
+TEST(AclTcamPlanner, FullTable) {
+  AclTcamPlanner planner(1, 3);
+  planner.apply(planner.plan(makeEntries({"a", "b", "c"})));
+
+  // With no free slots, c has to go before b2 can take its place
+  std::vector<std::string> names{"a", "b", "b2"};
+  auto plan = planner.plan(makeEntries(names));
+  EXPECT_EQ(1, plan.breakBeforeMake);
+  ASSERT_EQ(2, plan.steps.size());
+  EXPECT_EQ(Action::REMOVE, plan.steps[0].action);
+  EXPECT_EQ(Action::ADD, plan.steps[1].action);
+  planner.apply(plan);
+  checkOrder(planner, names);
+
+  EXPECT_THROW(
+      planner.plan(makeEntries({"a", "b", "c", "d"})), FbossError);
+}
+
+TEST(AclTcamPlanner, RelayOutWhenNoRoom) {
+  AclTcamPlanner planner(1, 4);
+  planner.apply(planner.plan(makeEntries({"a", "b"})));
+
+  // There is no room between a and b, so everything is laid out again
+  std::vector<std::string> names{"a", "x", "y", "b"};
+  auto plan = planner.plan(makeEntries(names));
+  EXPECT_TRUE(plan.relaidOut);
+  planner.apply(plan);
+  checkOrder(planner, names);
+}
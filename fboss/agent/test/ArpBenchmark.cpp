@@ -10,7 +10,9 @@
 #include <boost/cast.hpp>
 
 #include <folly/Benchmark.h>
+#include <folly/Conv.h>
 #include <folly/Memory.h>
+#include "fboss/agent/PacketRxPool.h"
 #include "fboss/agent/SwSwitch.h"
 #include "fboss/agent/TunManager.h"
 #include "fboss/agent/hw/mock/MockRxPacket.h"
@@ -37,6 +39,12 @@ namespace {
 unique_ptr<SwSwitch> sw;
 unique_ptr<MockRxPacket> arpRequest_10_0_0_1;
 unique_ptr<MockRxPacket> arpRequest_10_0_0_5;
+// A response table with as many addresses as a large VLAN interface, and
+// the same entries in a table that isn't published, so has no hash
+constexpr int kNumResponses = 256;
+shared_ptr<ArpResponseTable> publishedResponses;
+shared_ptr<ArpResponseTable> unpublishedResponses;
+std::vector<IPAddressV4> responseAddrs;
 
 unique_ptr<SwSwitch> setupSwitch() {
   MacAddress localMac("02:00:01:00:00:01");
@@ -134,6 +142,35 @@ void init() {
   arpRequest_10_0_0_5->padToLength(68);
   arpRequest_10_0_0_5->setSrcPort(PortID(1));
   arpRequest_10_0_0_5->setSrcVlan(VlanID(1));
+
+  publishedResponses = make_shared<ArpResponseTable>();
+  unpublishedResponses = make_shared<ArpResponseTable>();
+  for (int i = 0; i < kNumResponses; ++i) {
+    IPAddressV4 addr(folly::to<std::string>("10.1.", i / 100, ".", i % 100));
+    responseAddrs.push_back(addr);
+    publishedResponses->setEntry(
+        addr, MacAddress("00:02:00:00:00:01"), InterfaceID(1));
+    unpublishedResponses->setEntry(
+        addr, MacAddress("00:02:00:00:00:01"), InterfaceID(1));
+  }
+  // Half of the lookups are for addresses that aren't ours
+  for (int i = 0; i < kNumResponses; ++i) {
+    responseAddrs.push_back(
+        IPAddressV4(folly::to<std::string>("10.2.", i / 100, ".", i % 100)));
+  }
+  publishedResponses->publish();
+}
+
+// Look up each of the addresses in the table numIters times in all
+void lookupResponses(const ArpResponseTable& table, size_t numIters) {
+  size_t numFound = 0;
+  for (size_t n = 0; n < numIters; ++n) {
+    const auto& addr = responseAddrs[n % responseAddrs.size()];
+    if (table.getEntry(addr).hasValue()) {
+      ++numFound;
+    }
+  }
+  folly::doNotOptimizeAway(numFound);
 }
 
 } // unnamed namespace
@@ -157,6 +194,28 @@ BENCHMARK(ArpRequest, numIters) {
   }
 }
 
+BENCHMARK(ArpRequestBurst, numIters) {
+  BENCHMARK_SUSPEND {
+    SimSwitch* sim = boost::polymorphic_downcast<SimSwitch*>(sw->getHw());
+    sim->resetTxCount();
+  }
+
+  // As an RX worker would handle an ARP scan, sending the replies to each
+  // burst of requests in one batch.  The iterations per second are the
+  // replies per second.
+  for (size_t n = 0; n < numIters;) {
+    SwSwitch::TxPacketBatch batch(sw.get());
+    for (size_t i = 0; i < PacketRxPool::kMaxBurst && n < numIters; ++i, ++n) {
+      sw->packetReceived(arpRequest_10_0_0_1->clone());
+    }
+  }
+
+  BENCHMARK_SUSPEND {
+    SimSwitch* sim = boost::polymorphic_downcast<SimSwitch*>(sw->getHw());
+    CHECK_EQ(sim->getTxCount(), numIters);
+  }
+}
+
 BENCHMARK(ArpRequestNotMine, numIters) {
   BENCHMARK_SUSPEND {
     SimSwitch* sim = boost::polymorphic_downcast<SimSwitch*>(sw->getHw());
@@ -176,6 +235,15 @@ BENCHMARK(ArpRequestNotMine, numIters) {
   }
 }
 
+// The "is this mine" check of each ARP packet received
+BENCHMARK(ArpResponseLookupOrdered, numIters) {
+  lookupResponses(*unpublishedResponses, numIters);
+}
+
+BENCHMARK_RELATIVE(ArpResponseLookupHashed, numIters) {
+  lookupResponses(*publishedResponses, numIters);
+}
+
 int main(int argc, char** argv) {
   gflags::ParseCommandLineFlags(&argc, &argv, true);
 
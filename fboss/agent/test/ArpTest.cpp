@@ -1080,7 +1080,9 @@ TEST(ArpTest, ArpExpiration) {
   EXPECT_TRUE(arpExpirations[0]->wait());
 }
 
-TEST(ArpTest, PortFlapRecover) {
+namespace {
+
+void testPortFlapRecover() {
   auto handle = setupTestHandle(std::chrono::seconds(1));
   auto sw = handle->getSw();
 
@@ -1144,8 +1146,9 @@ TEST(ArpTest, PortFlapRecover) {
   EXPECT_HW_CALL(sw, stateChangedMock(_)).Times(testing::AtLeast(1));
   sw->linkStateChanged(PortID(1), false);
 
-  // purging neighbor entries occurs on the background EVB via NeighorUpdater as
-  // a StateObserver.
+  // purging neighbor entries occurs on the background EVB via NeighorUpdater,
+  // straight from the link event with the fast path, or else as a
+  // StateObserver.
   // block until NeighborUpdater::stateChanged() has been invoked
   waitForStateUpdates(sw);
   // block until neighbor purging logic has been executed on the background evb
@@ -1184,6 +1187,18 @@ TEST(ArpTest, PortFlapRecover) {
   EXPECT_EQ(unaffectedEntry->isPending(), false);
 }
 
+} // unnamed namespace
+
+TEST(ArpTest, PortFlapRecover) {
+  testPortFlapRecover();
+}
+
+TEST(ArpTest, PortFlapRecoverWithoutFastPath) {
+  gflags::FlagSaver saver;
+  FLAGS_link_down_fast_path = false;
+  testPortFlapRecover();
+}
+
 TEST(ArpTest, receivedPacketWithDirectlyConnectedDestination) {
   auto handle = setupTestHandle();
   auto sw = handle->getSw();
@@ -0,0 +1,87 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "fboss/agent/hw/BufferStatsLogger.h"
+
+#include <gtest/gtest.h>
+
+using namespace facebook::fboss;
+using Direction = BufferStatsLogger::Direction;
+
+namespace {
+
+class CountingBufferStatsLogger : public BufferStatsLogger {
+ public:
+  void logDeviceBufferStat(uint64_t, uint64_t) override {
+    ++deviceStats;
+  }
+  void logPortBufferStat(
+      const std::string&,
+      Direction,
+      unsigned int,
+      uint64_t,
+      uint64_t,
+      const XPEs&) override {
+    ++portStats;
+  }
+
+  int deviceStats{0};
+  int portStats{0};
+};
+
+} // unnamed namespace
+
+TEST(RecordingBufferStatsLogger, RecordsLatestStats) {
+  auto next = std::make_unique<CountingBufferStatsLogger>();
+  auto counting = next.get();
+  RecordingBufferStatsLogger recorder(std::move(next));
+
+  // Stats looked up before they are logged are unknown, and are updated
+  // in place once they are
+  const auto& egress = recorder.getPortStats("eth1/1/1", Direction::Egress, 2);
+  EXPECT_EQ(RecordingBufferStatsLogger::kUnknown, egress.bytesUsed);
+  EXPECT_EQ(
+      RecordingBufferStatsLogger::kUnknown,
+      recorder.getDeviceStats().bytesUsed);
+
+  recorder.logDeviceBufferStat(1000, 4000);
+  recorder.logPortBufferStat("eth1/1/1", Direction::Egress, 2, 300, 1, {0});
+  recorder.logPortBufferStat("eth1/1/1", Direction::Ingress, 2, 50, 0, {0});
+  recorder.logPortBufferStat("eth1/1/1", Direction::Egress, 2, 400, 3, {0});
+
+  EXPECT_EQ(1000, recorder.getDeviceStats().bytesUsed);
+  EXPECT_EQ(4000, recorder.getDeviceStats().bytesMax);
+  EXPECT_EQ(400, egress.bytesUsed);
+  EXPECT_EQ(3, egress.pktsDropped);
+  const auto& ingress =
+      recorder.getPortStats("eth1/1/1", Direction::Ingress, 2);
+  EXPECT_EQ(50, ingress.bytesUsed);
+  EXPECT_EQ(0, ingress.pktsDropped);
+  EXPECT_EQ(
+      RecordingBufferStatsLogger::kUnknown,
+      recorder.getPortStats("eth1/1/1", Direction::Egress, 3).bytesUsed);
+
+  // Every queue seen so far is visited, in order
+  std::vector<RecordingBufferStatsLogger::Key> keys;
+  recorder.forEachPortStats(
+      [&keys](const RecordingBufferStatsLogger::Key& key,
+              const RecordingBufferStatsLogger::Stats&) {
+        keys.push_back(key);
+      });
+  std::vector<RecordingBufferStatsLogger::Key> expectedKeys{
+      std::make_tuple("eth1/1/1", Direction::Ingress, 2u),
+      std::make_tuple("eth1/1/1", Direction::Egress, 2u),
+      std::make_tuple("eth1/1/1", Direction::Egress, 3u),
+  };
+  EXPECT_EQ(expectedKeys, keys);
+
+  // Everything is passed on to the next logger as well
+  EXPECT_EQ(1, counting->deviceStats);
+  EXPECT_EQ(3, counting->portStats);
+}
@@ -0,0 +1,119 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include <folly/Benchmark.h>
+#include <folly/Random.h>
+#include <folly/io/Cursor.h>
+#include <folly/io/IOBuf.h>
+#include <gflags/gflags.h>
+
+#include "fboss/agent/packet/PktUtil.h"
+
+#include <vector>
+
+using namespace facebook::fboss;
+using folly::IOBuf;
+using folly::io::Cursor;
+using ChecksumKernel = PktUtil::ChecksumKernel;
+
+/*
+ * Compares the checksum kernels with reading the data one 16-bit word at a
+ * time through a Cursor, as the checksum used to, for a minimum size packet,
+ * a full size one and a jumbo frame.
+ */
+
+namespace {
+
+std::vector<uint8_t> makeData(size_t size) {
+  std::vector<uint8_t> data(size);
+  for (auto& byte : data) {
+    byte = folly::Random::rand32(256);
+  }
+  return data;
+}
+
+uint16_t cursorChecksum(Cursor cursor, size_t length) {
+  uint32_t sum = 0;
+  while (length > 1) {
+    sum += cursor.readBE<uint16_t>();
+    length -= 2;
+  }
+  if (length) {
+    sum += cursor.read<uint8_t>() << 8;
+  }
+  return PktUtil::finalizeChecksum(sum);
+}
+
+void cursorBenchmark(uint32_t iters, size_t size) {
+  std::vector<uint8_t> data;
+  BENCHMARK_SUSPEND {
+    data = makeData(size);
+  }
+  IOBuf buf(IOBuf::WRAP_BUFFER, data.data(), data.size());
+  for (uint32_t i = 0; i < iters; ++i) {
+    folly::doNotOptimizeAway(cursorChecksum(Cursor(&buf), size));
+  }
+}
+
+void kernelBenchmark(uint32_t iters, size_t size, ChecksumKernel kernel) {
+  std::vector<uint8_t> data;
+  BENCHMARK_SUSPEND {
+    data = makeData(size);
+  }
+  if (!PktUtil::isSupported(kernel)) {
+    return;
+  }
+  for (uint32_t i = 0; i < iters; ++i) {
+    folly::doNotOptimizeAway(PktUtil::sumWords(data.data(), size, kernel));
+  }
+}
+
+void chainBenchmark(uint32_t iters, size_t size) {
+  // The packet in 256 byte buffers, as it arrives from some drivers
+  std::vector<uint8_t> data;
+  std::unique_ptr<IOBuf> buf;
+  BENCHMARK_SUSPEND {
+    data = makeData(size);
+    for (size_t offset = 0; offset < size; offset += 256) {
+      auto piece = IOBuf::wrapBuffer(
+          &data[offset], std::min<size_t>(256, size - offset));
+      if (buf) {
+        buf->prependChain(std::move(piece));
+      } else {
+        buf = std::move(piece);
+      }
+    }
+  }
+  for (uint32_t i = 0; i < iters; ++i) {
+    folly::doNotOptimizeAway(PktUtil::internetChecksum(buf.get()));
+  }
+}
+
+} // unnamed namespace
+
+#define CHECKSUM_BENCHMARKS(size)                                     \
+  BENCHMARK_NAMED_PARAM(cursorBenchmark, Cursor_##size, size)         \
+  BENCHMARK_RELATIVE_NAMED_PARAM(                                     \
+      kernelBenchmark, Scalar_##size, size, ChecksumKernel::SCALAR)   \
+  BENCHMARK_RELATIVE_NAMED_PARAM(                                     \
+      kernelBenchmark, SSE2_##size, size, ChecksumKernel::SSE2)       \
+  BENCHMARK_RELATIVE_NAMED_PARAM(                                     \
+      kernelBenchmark, AVX2_##size, size, ChecksumKernel::AVX2)       \
+  BENCHMARK_RELATIVE_NAMED_PARAM(chainBenchmark, Chained_##size, size) \
+  BENCHMARK_DRAW_LINE();
+
+CHECKSUM_BENCHMARKS(64)
+CHECKSUM_BENCHMARKS(1500)
+CHECKSUM_BENCHMARKS(9000)
+
+int main(int argc, char** argv) {
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+  folly::runBenchmarks();
+  return 0;
+}
@@ -0,0 +1,118 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "fboss/agent/ConfigStager.h"
+#include "fboss/agent/state/AclEntry.h"
+#include "fboss/agent/state/AclMap.h"
+#include "fboss/agent/state/StateDelta.h"
+#include "fboss/agent/state/SwitchState.h"
+
+#include <gtest/gtest.h>
+
+#include <utility>
+#include <vector>
+
+using namespace facebook::fboss;
+using std::make_shared;
+using std::shared_ptr;
+
+namespace {
+
+using Acls = std::vector<std::pair<std::string, int>>;
+
+shared_ptr<SwitchState> makeState(const Acls& acls) {
+  auto state = make_shared<SwitchState>();
+  for (const auto& acl : acls) {
+    state->addAcl(make_shared<AclEntry>(acl.second, acl.first));
+  }
+  state->publish();
+  return state;
+}
+
+// Apply every stage, checking no two entries ever share a priority
+shared_ptr<SwitchState> applyStages(
+    const ConfigStager& stager,
+    shared_ptr<SwitchState> state) {
+  for (size_t stage = 0; stage < stager.numAclStages(); ++stage) {
+    state = stager.applyAclStage(stage, state);
+    PrioAclMap byPriority;
+    EXPECT_NO_THROW(byPriority.addAcls(state->getAcls())) << stage;
+    state->publish();
+  }
+  return state;
+}
+
+void checkAcls(const shared_ptr<SwitchState>& state, const Acls& acls) {
+  EXPECT_EQ(acls.size(), state->getAcls()->numEntries());
+  for (const auto& acl : acls) {
+    auto entry = state->getAcls()->getEntryIf(acl.first);
+    ASSERT_NE(nullptr, entry) << acl.first;
+    EXPECT_EQ(acl.second, entry->getPriority()) << acl.first;
+  }
+}
+
+} // unnamed namespace
+
+TEST(ConfigStager, firstStageKeepsAcls) {
+  auto oldState = makeState({{"a", 1}});
+  auto newState = oldState->clone();
+  newState->setDefaultVlan(VlanID(2));
+  newState->resetAcls(makeState({{"b", 1}})->getAcls());
+
+  ConfigStager stager(oldState, newState, 0);
+  auto first = stager.getFirstStage();
+  EXPECT_EQ(VlanID(2), first->getDefaultVlan());
+  EXPECT_EQ(oldState->getAcls(), first->getAcls());
+  EXPECT_EQ(1, stager.numAclStages());
+  checkAcls(applyStages(stager, first), {{"b", 1}});
+}
+
+TEST(ConfigStager, noAclChange) {
+  auto oldState = makeState({{"a", 1}});
+  auto newState = oldState->clone();
+  newState->setDefaultVlan(VlanID(2));
+
+  ConfigStager stager(oldState, newState, 1);
+  EXPECT_EQ(newState, stager.getFirstStage());
+  EXPECT_EQ(0, stager.numAclStages());
+}
+
+TEST(ConfigStager, insertShiftsPriorities) {
+  // Inserting at the top moves every entry down a priority
+  auto oldState = makeState({{"a", 1}, {"b", 2}, {"c", 3}});
+  Acls newAcls{{"x", 1}, {"a", 2}, {"b", 3}, {"c", 4}};
+  auto newState = makeState(newAcls);
+
+  ConfigStager stager(oldState, newState, 1);
+  // Each entry only moves, none has to be removed first
+  EXPECT_EQ(4, stager.numAclStages());
+  checkAcls(applyStages(stager, stager.getFirstStage()), newAcls);
+}
+
+TEST(ConfigStager, swapPriorities) {
+  auto oldState = makeState({{"a", 1}, {"b", 2}, {"c", 5}});
+  Acls newAcls{{"a", 2}, {"b", 1}, {"d", 5}};
+  auto newState = makeState(newAcls);
+
+  ConfigStager stager(oldState, newState, 2);
+  checkAcls(applyStages(stager, stager.getFirstStage()), newAcls);
+}
+
+TEST(ConfigStager, countChanges) {
+  auto oldState = makeState({{"a", 1}, {"b", 2}});
+  auto newState = oldState->clone();
+  auto acls = newState->getAcls()->modify(&newState);
+  acls->removeEntry("a");
+  acls->addEntry(make_shared<AclEntry>(3, "c"));
+
+  auto changes = countStateChanges(StateDelta(oldState, newState));
+  EXPECT_EQ(2, changes["acls"]);
+  EXPECT_EQ(0, changes["ports"]);
+  EXPECT_EQ(0, changes["routes"]);
+}
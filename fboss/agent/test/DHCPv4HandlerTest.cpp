@@ -250,6 +250,9 @@ TxMatchFn checkDHCPPkt(MacAddress dstMac, VlanID vlan,
     }
     UDPHeader udpHdr;
     udpHdr.parse(&c);
+    if (udpHdr.computeChecksum(ipHdr, c) != udpHdr.csum) {
+      throw FbossError("bad UDP checksum ", udpHdr.csum);
+    }
     if (udpHdr.srcPort != srcPort) {
       throw FbossError("expected source port to be ", srcPort,
           "; got ", udpHdr.srcPort);
@@ -364,6 +367,48 @@ TEST(DHCPv4HandlerTest, DHCPRequest) {
   counters.checkDelta(SwitchStats::kCounterPrefix + "trapped.pkts.sum", 1);
 }
 
+TEST(DHCPv4HandlerTest, DHCPRequestMaxMessageSize) {
+  auto handle = setupTestHandle();
+  auto sw = handle->getSw();
+
+  const char* senderIP = "00 00 00 00";
+  auto senderMac = kClientMac.toString();
+  std::replace(senderMac.begin(), senderMac.end(), ':', ' ');
+  const string targetMac = "ff ff ff ff ff ff";
+  const string targetIP = "ff ff ff ff";
+  const string bootpOp = "01";
+  const string vlan = "00 01";
+  const string srcPort = "00 43";
+  const string dstPort = "00 44";
+  const string dhcpMsgTypeOpt = "35  01  01";
+  CounterCache counters(sw);
+
+  EXPECT_HW_CALL(sw, stateChangedMock(_)).Times(0);
+  EXPECT_PLATFORM_CALL(sw, getLocalMac()).
+    WillRepeatedly(Return(kPlatformMac));
+
+  // Maximum DHCP message size (option = 57, len = 2, size = 320), which
+  // leaves room for the agent option
+  EXPECT_PKT(sw, "DHCP request", checkDHCPReq());
+  sendDHCPPacket(handle.get(), senderMac, targetMac, vlan,
+      senderIP, targetIP, srcPort, dstPort, bootpOp, dhcpMsgTypeOpt,
+      "39  02  01  40");
+
+  counters.update();
+  counters.checkDelta(SwitchStats::kCounterPrefix + "dhcpV4.pkt.sum", 1);
+  counters.checkDelta(SwitchStats::kCounterPrefix + "dhcpV4.bad_pkt.sum", 0);
+
+  // Size 256, which is less than the minimum relayed message
+  EXPECT_HW_CALL(sw, sendPacketSwitched_(_)).Times(0);
+  sendDHCPPacket(handle.get(), senderMac, targetMac, vlan,
+      senderIP, targetIP, srcPort, dstPort, bootpOp, dhcpMsgTypeOpt,
+      "39  02  01  00");
+
+  counters.update();
+  counters.checkDelta(SwitchStats::kCounterPrefix + "dhcpV4.pkt.sum", 1);
+  counters.checkDelta(SwitchStats::kCounterPrefix + "dhcpV4.bad_pkt.sum", 1);
+}
+
 TEST(DHCPv4HandlerOverrideTest, DHCPRequest) {
   auto handle = setupTestHandle();
   auto sw = handle->getSw();
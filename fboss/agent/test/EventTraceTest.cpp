@@ -0,0 +1,107 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "fboss/agent/EventTrace.h"
+
+#include <folly/system/ThreadId.h>
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <thread>
+
+using namespace facebook::fboss;
+using Event = EventTrace::Event;
+
+namespace {
+
+// The events of one thread, since the trace is shared by the process
+std::vector<EventTrace::Entry> dumpThread(uint64_t threadId) {
+  std::vector<EventTrace::Entry> entries;
+  for (auto& entry : EventTrace::dump()) {
+    if (entry.threadId == threadId) {
+      entries.push_back(std::move(entry));
+    }
+  }
+  return entries;
+}
+
+} // unnamed namespace
+
+TEST(EventTrace, RecordEvents) {
+  auto begin = std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::system_clock::now().time_since_epoch()).count();
+  uint64_t threadId = 0;
+  std::thread thread([&] {
+    threadId = folly::getOSThreadID();
+    EventTrace::record(Event::STATE_UPDATE_START, 7);
+    {
+      EventTrace::Scope scope(EventTrace::HwPhase::NEIGHBORS);
+      EventTrace::record(
+          Event::NEIGHBOR_STATE,
+          5 << 8 | 1,
+          EventTrace::addressArg(folly::IPAddressV4("10.0.0.1")));
+    }
+    EventTrace::record(Event::STATE_UPDATE_END, 7, 1234);
+  });
+  thread.join();
+
+  auto entries = dumpThread(threadId);
+  ASSERT_EQ(5, entries.size());
+  EXPECT_EQ(Event::STATE_UPDATE_START, entries[0].event);
+  EXPECT_EQ(7, entries[0].arg0);
+  EXPECT_EQ(Event::HW_PHASE_START, entries[1].event);
+  EXPECT_EQ("neighbors", EventTrace::hwPhaseName(entries[1].arg0));
+  EXPECT_EQ(Event::NEIGHBOR_STATE, entries[2].event);
+  EXPECT_EQ(5 << 8 | 1, entries[2].arg0);
+  EXPECT_EQ(0x0a000001, entries[2].arg1);
+  EXPECT_EQ(Event::HW_PHASE_END, entries[3].event);
+  EXPECT_EQ(Event::STATE_UPDATE_END, entries[4].event);
+  EXPECT_EQ(1234, entries[4].arg1);
+  for (size_t i = 1; i < entries.size(); ++i) {
+    EXPECT_LE(entries[i - 1].timestampUs, entries[i].timestampUs);
+  }
+  // Within a second or so of when they were recorded
+  EXPECT_LE(begin - 1000000, entries[0].timestampUs);
+  EXPECT_GE(begin + 1000000, entries[4].timestampUs);
+}
+
+TEST(EventTrace, KeepsLatestRecords) {
+  uint64_t threadId = 0;
+  std::thread thread([&] {
+    threadId = folly::getOSThreadID();
+    for (uint32_t i = 0; i < EventTrace::kRecordsPerThread + 10; ++i) {
+      EventTrace::record(Event::PACKET_RX, i);
+    }
+  });
+  thread.join();
+
+  // Less the oldest, which a thread still running could be writing over
+  auto entries = dumpThread(threadId);
+  ASSERT_EQ(EventTrace::kRecordsPerThread - 1, entries.size());
+  EXPECT_EQ(11, entries.front().arg0);
+  EXPECT_EQ(EventTrace::kRecordsPerThread + 9, entries.back().arg0);
+}
+
+TEST(EventTrace, Disabled) {
+  auto threadId = folly::getOSThreadID();
+  EventTrace::record(Event::PACKET_RX, 1);
+  auto recorded = dumpThread(threadId).size();
+  EventTrace::setEnabled(false);
+  EventTrace::record(Event::PACKET_RX, 2);
+  EventTrace::setEnabled(true);
+  auto entries = dumpThread(threadId);
+  ASSERT_EQ(recorded, entries.size());
+  EXPECT_EQ(1, entries.back().arg0);
+}
+
+TEST(EventTrace, AddressArg) {
+  EXPECT_EQ(
+      0x0102030405060708,
+      EventTrace::addressArg(folly::IPAddressV6("2401::102:304:506:708")));
+}
@@ -0,0 +1,161 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "fboss/agent/hw/FibCompressor.h"
+
+#include <folly/IPAddressV4.h>
+#include <gtest/gtest.h>
+
+#include <map>
+#include <random>
+#include <string>
+#include <utility>
+
+using namespace facebook::fboss;
+using folly::IPAddressV4;
+
+namespace {
+
+using Compressor = FibCompressor<IPAddressV4, int>;
+using Change = Compressor::Change;
+
+std::string str(const Compressor::Changes& changes) {
+  std::string out;
+  for (const auto& change : changes) {
+    out += change.type == Change::Type::INSTALL ? "+" : "-";
+    out += change.network.str() + "/" + std::to_string(change.mask) + " ";
+  }
+  return out;
+}
+
+/*
+ * The hardware LPM table, with the changes applied to it, against the RIB
+ */
+class Fib {
+ public:
+  void update(const std::string& network, uint8_t mask, int forward) {
+    IPAddressV4 addr(network);
+    rib_[{addr, mask}] = forward;
+    changes_.clear();
+    compressor_.update(addr, mask, forward, &changes_);
+    apply();
+  }
+  void remove(const std::string& network, uint8_t mask) {
+    IPAddressV4 addr(network);
+    rib_.erase({addr, mask});
+    changes_.clear();
+    compressor_.remove(addr, mask, &changes_);
+    apply();
+  }
+  std::string changes() const {
+    return str(changes_);
+  }
+  const Compressor& compressor() const {
+    return compressor_;
+  }
+
+  // The RIB and hardware forward every address the same
+  void expectForwardsSame() const {
+    for (const auto& route : rib_) {
+      // Each route's network, and an address at its end
+      auto first = route.first.first;
+      auto hostBits = 32 - route.first.second;
+      auto last = IPAddressV4::fromLongHBO(
+          first.toLongHBO() | (hostBits ? ~0U >> (32 - hostBits) : 0));
+      for (const auto& addr : {first, last}) {
+        EXPECT_EQ(lookup(rib_, addr), lookup(hw_, addr)) << addr.str();
+      }
+    }
+    EXPECT_EQ(hw_.size(), compressor_.numInstalled());
+    EXPECT_EQ(rib_.size(), compressor_.numRoutes());
+  }
+
+ private:
+  using Table = std::map<std::pair<IPAddressV4, uint8_t>, int>;
+
+  static int lookup(const Table& table, const IPAddressV4& addr) {
+    for (int mask = 32; mask >= 0; --mask) {
+      auto iter = table.find({addr.mask(mask), uint8_t(mask)});
+      if (iter != table.end()) {
+        return iter->second;
+      }
+    }
+    return -1;
+  }
+
+  void apply() {
+    for (const auto& change : changes_) {
+      auto key = std::make_pair(change.network, change.mask);
+      if (change.type == Change::Type::INSTALL) {
+        hw_[key] = rib_.at(key);
+      } else {
+        EXPECT_EQ(1, hw_.erase(key)) << key.first.str();
+      }
+    }
+  }
+
+  Compressor compressor_;
+  Compressor::Changes changes_;
+  Table rib_;
+  Table hw_;
+};
+
+} // unnamed namespace
+
+TEST(FibCompressor, redundantRoutes) {
+  Fib fib;
+  fib.update("10.0.0.0", 8, 1);
+  EXPECT_EQ("+10.0.0.0/8 ", fib.changes());
+  // Forwards the same as the /8
+  fib.update("10.1.0.0", 16, 1);
+  EXPECT_EQ("", fib.changes());
+  fib.update("10.1.1.0", 24, 2);
+  EXPECT_EQ("+10.1.1.0/24 ", fib.changes());
+  EXPECT_FALSE(fib.compressor().isInstalled(IPAddressV4("10.1.0.0"), 16));
+
+  // The /16 forwarding differently from what covers it is installed, and
+  // the /24 it now covers that forwards the same is then removed
+  fib.update("10.1.0.0", 16, 2);
+  EXPECT_EQ("+10.1.0.0/16 -10.1.1.0/24 ", fib.changes());
+
+  // Removing the /16 needs the /24 back first
+  fib.remove("10.1.0.0", 16);
+  EXPECT_EQ("+10.1.1.0/24 -10.1.0.0/16 ", fib.changes());
+
+  // A covering route added above existing ones
+  fib.update("10.1.1.0", 24, 1);
+  EXPECT_EQ("-10.1.1.0/24 ", fib.changes());
+  fib.remove("10.0.0.0", 8);
+  EXPECT_EQ("+10.1.1.0/24 -10.0.0.0/8 ", fib.changes());
+  fib.update("0.0.0.0", 0, 1);
+  EXPECT_EQ("+0.0.0.0/0 -10.1.1.0/24 ", fib.changes());
+  EXPECT_EQ(1, fib.compressor().numInstalled());
+  fib.expectForwardsSame();
+}
+
+TEST(FibCompressor, randomChanges) {
+  Fib fib;
+  std::mt19937 rng(1);
+  for (int i = 1; i <= 2000; ++i) {
+    // Few prefixes and forwards, so that they often cover each other
+    uint8_t mask = 8 + rng() % 5 * 4;
+    auto network = IPAddressV4::fromLongHBO(0x0a000000 | (rng() % 64) << 18)
+                       .mask(mask)
+                       .str();
+    if (rng() % 4) {
+      fib.update(network, mask, rng() % 3);
+    } else {
+      fib.remove(network, mask);
+    }
+    if (i % 20 == 0) {
+      fib.expectForwardsSame();
+    }
+  }
+  EXPECT_LT(fib.compressor().numInstalled(), fib.compressor().numRoutes());
+}
@@ -0,0 +1,170 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "fboss/agent/HashSimulator.h"
+
+#include "fboss/agent/FbossError.h"
+#include "fboss/agent/packet/IPProto.h"
+#include "fboss/agent/packet/PktUtil.h"
+
+#include <folly/io/IOBuf.h>
+#include <gtest/gtest.h>
+
+using namespace facebook::fboss;
+using folly::IPAddress;
+
+namespace {
+
+std::shared_ptr<LoadBalancer> makeLoadBalancer(
+    uint32_t seed,
+    LoadBalancer::IPv4Fields v4Fields,
+    LoadBalancer::TransportFields transportFields) {
+  return std::make_shared<LoadBalancer>(
+      LoadBalancerID::ECMP,
+      cfg::HashingAlgorithm::CRC16_CCITT,
+      seed,
+      std::move(v4Fields),
+      LoadBalancer::IPv6Fields{},
+      std::move(transportFields));
+}
+
+std::shared_ptr<LoadBalancer> makeFullLoadBalancer(uint32_t seed) {
+  return makeLoadBalancer(
+      seed,
+      {LoadBalancer::IPv4Field::SOURCE_ADDRESS,
+       LoadBalancer::IPv4Field::DESTINATION_ADDRESS},
+      {LoadBalancer::TransportField::SOURCE_PORT,
+       LoadBalancer::TransportField::DESTINATION_PORT});
+}
+
+HashFlow makeFlow(const std::string& src, const std::string& dst,
+                  uint16_t srcPort, uint16_t dstPort) {
+  HashFlow flow;
+  flow.srcIp = IPAddress(src);
+  flow.dstIp = IPAddress(dst);
+  flow.protocol = IP_PROTO_TCP;
+  flow.hasPorts = true;
+  flow.srcPort = srcPort;
+  flow.dstPort = dstPort;
+  return flow;
+}
+
+} // unnamed namespace
+
+TEST(HashSimulatorTest, FlowFromPacket) {
+  // A VLAN tagged IPv4 UDP packet
+  auto buf = PktUtil::parseHexData(
+      "02 00 00 00 00 01  02 00 00 00 00 02  81 00 00 01  08 00"
+      "45 00 00 1c  00 00 00 00  40 11 00 00  0a 00 00 01  0a 00 00 02"
+      "1f 90 00 35  00 08 00 00");
+  auto flow = HashFlow::fromPacket(&buf);
+  ASSERT_TRUE(flow.hasValue());
+  EXPECT_EQ(IPAddress("10.0.0.1"), flow->srcIp);
+  EXPECT_EQ(IPAddress("10.0.0.2"), flow->dstIp);
+  EXPECT_EQ(IP_PROTO_UDP, flow->protocol);
+  EXPECT_TRUE(flow->hasPorts);
+  EXPECT_EQ(8080, flow->srcPort);
+  EXPECT_EQ(53, flow->dstPort);
+
+  // An IPv6 TCP packet cut short after the ports, as sFlow samples are
+  buf = PktUtil::parseHexData(
+      "02 00 00 00 00 01  02 00 00 00 00 02  86 dd"
+      "60 01 23 45  00 14 06 40"
+      "24 01 db 00 00 00 00 00  00 00 00 00 00 00 00 01"
+      "24 01 db 00 00 00 00 00  00 00 00 00 00 00 00 02"
+      "00 50 01 bb");
+  flow = HashFlow::fromPacket(&buf);
+  ASSERT_TRUE(flow.hasValue());
+  EXPECT_EQ(IPAddress("2401:db00::1"), flow->srcIp);
+  EXPECT_EQ(IPAddress("2401:db00::2"), flow->dstIp);
+  EXPECT_EQ(0x12345, flow->flowLabel);
+  EXPECT_TRUE(flow->hasPorts);
+  EXPECT_EQ(80, flow->srcPort);
+  EXPECT_EQ(443, flow->dstPort);
+
+  // Without the ports
+  buf = PktUtil::parseHexData(
+      "02 00 00 00 00 01  02 00 00 00 00 02  08 00"
+      "45 00 00 28  00 00 00 00  40 06 00 00  0a 00 00 01  0a 00 00 02"
+      "00 50");
+  flow = HashFlow::fromPacket(&buf);
+  ASSERT_TRUE(flow.hasValue());
+  EXPECT_FALSE(flow->hasPorts);
+
+  // ARP isn't hashed
+  buf = PktUtil::parseHexData(
+      "ff ff ff ff ff ff  02 00 00 00 00 02  08 06"
+      "00 01 08 00 06 04 00 01");
+  EXPECT_FALSE(HashFlow::fromPacket(&buf).hasValue());
+  HashSimulator sim(*makeFullLoadBalancer(0), 4);
+  EXPECT_FALSE(sim.addPacket(&buf));
+  EXPECT_EQ(1, sim.getNumUnhashed());
+  EXPECT_EQ(0, sim.getNumFlows());
+  EXPECT_EQ(0, sim.getMaxImbalance());
+}
+
+TEST(HashSimulatorTest, Distribution) {
+  // Many connections between two hosts spread out over the group
+  HashSimulator full(*makeFullLoadBalancer(0), 8);
+  for (uint16_t port = 0; port < 8000; ++port) {
+    full.addFlow(makeFlow("10.0.0.1", "10.0.0.2", 10000 + port, 443));
+  }
+  EXPECT_EQ(8000, full.getNumFlows());
+  EXPECT_LT(full.getMaxImbalance(), 1.2);
+  for (auto load : full.getLoads()) {
+    EXPECT_GT(load, 0);
+  }
+
+  // ... and all go to one member if only the addresses are hashed
+  HashSimulator addrsOnly(
+      *makeLoadBalancer(
+          0,
+          {LoadBalancer::IPv4Field::SOURCE_ADDRESS,
+           LoadBalancer::IPv4Field::DESTINATION_ADDRESS},
+          {}),
+      8);
+  for (uint16_t port = 0; port < 100; ++port) {
+    addrsOnly.addFlow(makeFlow("10.0.0.1", "10.0.0.2", 10000 + port, 443), 2);
+  }
+  EXPECT_DOUBLE_EQ(8, addrsOnly.getMaxImbalance());
+
+  auto distribution = addrsOnly.toThrift();
+  ASSERT_EQ(8, distribution.memberLoads.size());
+  EXPECT_EQ(100, distribution.numFlows);
+  int64_t total = 0;
+  for (auto load : distribution.memberLoads) {
+    EXPECT_TRUE(load == 0 || load == 200);
+    total += load;
+  }
+  EXPECT_EQ(200, total);
+}
+
+TEST(HashSimulatorTest, Seeds) {
+  HashSimulator seed0(*makeFullLoadBalancer(0), 16);
+  HashSimulator seed1(*makeFullLoadBalancer(0x12345678), 16);
+  auto flow = makeFlow("10.0.0.1", "10.0.0.2", 10000, 443);
+  EXPECT_EQ(seed0.hash(flow), seed0.hash(flow));
+  EXPECT_NE(seed0.hash(flow), seed1.hash(flow));
+
+  // Only the selected fields count
+  HashSimulator dstOnly(
+      *makeLoadBalancer(
+          0, {LoadBalancer::IPv4Field::DESTINATION_ADDRESS}, {}),
+      16);
+  EXPECT_EQ(
+      dstOnly.hash(flow),
+      dstOnly.hash(makeFlow("10.9.9.9", "10.0.0.2", 1, 2)));
+  EXPECT_NE(
+      dstOnly.hash(flow),
+      dstOnly.hash(makeFlow("10.0.0.1", "10.0.0.3", 10000, 443)));
+}
+
+TEST(HashSimulatorTest, NoMembers) {
+  EXPECT_THROW(HashSimulator(*makeFullLoadBalancer(0), 0), FbossError);
+}
@@ -0,0 +1,87 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "fboss/agent/HighresCounterUtil.h"
+
+#include <gtest/gtest.h>
+
+#include <limits>
+#include <stdexcept>
+
+using namespace facebook::fboss;
+using std::chrono::high_resolution_clock;
+using std::chrono::nanoseconds;
+
+namespace {
+
+CounterRequest makeRequest(const std::string& name) {
+  CounterRequest req;
+  req.namespaceName = "test";
+  req.counterName = name;
+  return req;
+}
+
+} // unnamed namespace
+
+TEST(HighresCounterUtilTest, Column) {
+  std::vector<int64_t> values{
+      0, 1, 1, 1, -5, 1000000, std::numeric_limits<int64_t>::max(),
+      std::numeric_limits<int64_t>::min(), 42};
+  auto column = SampleBatch::encodeColumn(values);
+  EXPECT_EQ(values, SampleBatch::decodeColumn(column));
+
+  // Unchanged values take a byte each
+  std::vector<int64_t> flat(100, 7);
+  EXPECT_EQ(100u, SampleBatch::encodeColumn(flat).size());
+
+  EXPECT_TRUE(SampleBatch::decodeColumn("").empty());
+  EXPECT_THROW(SampleBatch::decodeColumn("\x80"), std::invalid_argument);
+}
+
+TEST(HighresCounterUtilTest, Batch) {
+  SampleBatch batch(2);
+  auto start = high_resolution_clock::time_point(nanoseconds(5000000123));
+  for (int64_t idx = 0; idx < 3; ++idx) {
+    auto values = batch.addSample(start + nanoseconds(idx * 1000));
+    values[0] = idx;
+    values[1] = 100 - idx;
+  }
+  EXPECT_EQ(3u, batch.size());
+
+  std::vector<CounterRequest> counters{makeRequest("a"), makeRequest("b")};
+  CounterPublication pub;
+  batch.toPublication(counters, &pub);
+  ASSERT_EQ(3u, pub.times.size());
+  EXPECT_EQ(5, pub.times[0].seconds);
+  EXPECT_EQ(123, pub.times[0].nanoseconds);
+  EXPECT_EQ(2123, pub.times[2].nanoseconds);
+  EXPECT_EQ((std::vector<int64_t>{0, 1, 2}), pub.counterValues[counters[0]]);
+  EXPECT_EQ((std::vector<int64_t>{100, 99, 98}),
+            pub.counterValues[counters[1]]);
+
+  CompactCounterPublication compact;
+  batch.toCompactPublication(&compact);
+  EXPECT_EQ(3, compact.numSamples);
+  EXPECT_EQ((std::vector<int64_t>{5000000123, 5000001123, 5000002123}),
+            SampleBatch::decodeColumn(compact.times));
+  ASSERT_EQ(2u, compact.columns.size());
+  EXPECT_EQ((std::vector<int64_t>{0, 1, 2}),
+            SampleBatch::decodeColumn(compact.columns[0]));
+  EXPECT_EQ((std::vector<int64_t>{100, 99, 98}),
+            SampleBatch::decodeColumn(compact.columns[1]));
+
+  // The memory is kept, and the next batch starts from scratch
+  batch.clear();
+  EXPECT_EQ(0u, batch.size());
+  batch.addSample(start)[0] = 9;
+  CompactCounterPublication next;
+  batch.toCompactPublication(&next);
+  EXPECT_EQ(std::vector<int64_t>{9},
+            SampleBatch::decodeColumn(next.columns[0]));
+}
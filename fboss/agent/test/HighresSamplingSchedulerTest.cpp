@@ -0,0 +1,176 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "fboss/agent/HighresSamplingScheduler.h"
+
+#include <gtest/gtest.h>
+
+#include <future>
+#include <iterator>
+#include <map>
+
+using namespace facebook::fboss;
+using std::chrono::high_resolution_clock;
+
+namespace {
+
+CounterRequest makeRequest(const std::string& name) {
+  CounterRequest req;
+  req.namespaceName = "test";
+  req.counterName = name;
+  return req;
+}
+
+// Samples every counter it is asked for as the number of counters it read
+class CountingSampler : public HighresSampler {
+ public:
+  explicit CountingSampler(const std::set<CounterRequest>& counters)
+      : counters_(counters.begin(), counters.end()) {}
+
+  void sample(int64_t* values) override {
+    for (size_t idx = 0; idx < counters_.size(); ++idx) {
+      values[idx] = ++reads_;
+    }
+  }
+  int numCounters() const override {
+    return counters_.size();
+  }
+  void getCounters(std::vector<CounterRequest>* counters) const override {
+    counters->insert(counters->end(), counters_.begin(), counters_.end());
+  }
+
+ private:
+  std::vector<CounterRequest> counters_;
+  int64_t reads_{0};
+};
+
+int createSamplers(HighresSamplerList* samplers,
+                   const std::set<CounterRequest>& counters) {
+  samplers->push_back(std::make_unique<CountingSampler>(counters));
+  return counters.size();
+}
+
+using Samples =
+    std::map<high_resolution_clock::time_point, std::vector<int64_t>>;
+
+// Takes a given number of samples, then reports them
+class TestSubscriber : public HighresSubscriber {
+ public:
+  TestSubscriber(std::vector<CounterRequest> counters, int maxSamples)
+      : counters_(std::move(counters)), maxSamples_(maxSamples) {}
+
+  const std::vector<CounterRequest>& getCounters() const override {
+    return counters_;
+  }
+  bool addSample(const high_resolution_clock::time_point& time,
+                 const int64_t* values) override {
+    if (samples_.size() == static_cast<size_t>(maxSamples_)) {
+      return false;
+    }
+    samples_[time].assign(values, values + counters_.size());
+    return true;
+  }
+  void finish() override {
+    done_.set_value(samples_);
+  }
+
+  std::future<Samples> getDone() {
+    return done_.get_future();
+  }
+
+ private:
+  const std::vector<CounterRequest> counters_;
+  const int maxSamples_;
+  Samples samples_;
+  std::promise<Samples> done_;
+};
+
+CounterSubscribeRequest makeSubscribeRequest(int64_t intervalInNs) {
+  CounterSubscribeRequest req;
+  req.intervalInNs = intervalInNs;
+  req.sleepMethod = SleepMethod::NANOSLEEP;
+  req.veryNice = false;
+  req.samplerCpu = -1;
+  return req;
+}
+
+} // unnamed namespace
+
+TEST(HighresSamplingSchedulerTest, SharedSampling) {
+  HighresSamplingScheduler scheduler(createSamplers);
+
+  // Both subscribe to b
+  auto first = std::make_unique<TestSubscriber>(
+      std::vector<CounterRequest>{makeRequest("a"), makeRequest("b")}, 1000);
+  auto second = std::make_unique<TestSubscriber>(
+      std::vector<CounterRequest>{makeRequest("b"), makeRequest("c")}, 1000);
+  auto firstDone = first->getDone();
+  auto secondDone = second->getDone();
+  auto req = makeSubscribeRequest(1000);
+  scheduler.subscribe(std::move(first), req);
+  scheduler.subscribe(std::move(second), req);
+  EXPECT_EQ(1u, scheduler.numGroups());
+
+  // A different interval gets a group of its own
+  auto other = std::make_unique<TestSubscriber>(
+      std::vector<CounterRequest>{makeRequest("a")}, 1);
+  auto otherDone = other->getDone();
+  scheduler.subscribe(std::move(other), makeSubscribeRequest(2000));
+  EXPECT_EQ(1u, otherDone.get().size());
+
+  auto firstSamples = firstDone.get();
+  auto secondSamples = secondDone.get();
+  EXPECT_EQ(1000u, firstSamples.size());
+  ASSERT_EQ(1000u, secondSamples.size());
+
+  // Once the second joined, a, b and c were each read once per sample, and
+  // both were handed the same value of b
+  const auto& time = secondSamples.begin()->first;
+  ASSERT_EQ(1u, firstSamples.count(time));
+  const auto& firstValues = firstSamples[time];
+  const auto& secondValues = secondSamples[time];
+  EXPECT_EQ(firstValues[0] + 1, firstValues[1]);
+  EXPECT_EQ(firstValues[1], secondValues[0]);
+  EXPECT_EQ(secondValues[0] + 1, secondValues[1]);
+
+  auto next = std::next(secondSamples.begin());
+  EXPECT_EQ(secondValues[1] + 3, next->second[1]);
+}
+
+TEST(HighresSamplingSchedulerTest, GroupEnds) {
+  HighresSamplingScheduler scheduler(createSamplers);
+  auto req = makeSubscribeRequest(1000);
+
+  auto subscriber = std::make_unique<TestSubscriber>(
+      std::vector<CounterRequest>{makeRequest("a")}, 10);
+  auto done = subscriber->getDone();
+  scheduler.subscribe(std::move(subscriber), req);
+  EXPECT_EQ(10u, done.get().size());
+
+  // A new subscription starts a new thread for the group
+  subscriber = std::make_unique<TestSubscriber>(
+      std::vector<CounterRequest>{makeRequest("a")}, 10);
+  done = subscriber->getDone();
+  scheduler.subscribe(std::move(subscriber), req);
+  EXPECT_EQ(10u, done.get().size());
+}
+
+TEST(HighresSamplingSchedulerTest, Stop) {
+  std::future<Samples> done;
+  {
+    HighresSamplingScheduler scheduler(createSamplers);
+    auto subscriber = std::make_unique<TestSubscriber>(
+        std::vector<CounterRequest>{makeRequest("a")}, 1000000000);
+    done = subscriber->getDone();
+    scheduler.subscribe(std::move(subscriber), makeSubscribeRequest(1000));
+  }
+  // Subscriptions are finished when the scheduler goes away
+  EXPECT_EQ(std::future_status::ready,
+            done.wait_for(std::chrono::seconds(0)));
+}
@@ -0,0 +1,146 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "fboss/agent/HugePageAllocator.h"
+
+#include "fboss/agent/FbossError.h"
+#include "fboss/lib/SortedBlockMap.h"
+
+#include <gtest/gtest.h>
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+using namespace facebook::fboss;
+
+namespace {
+constexpr auto kHugePageSize = HugePageResource::kHugePageSize;
+}
+
+TEST(HugePageAllocator, parseMode) {
+  EXPECT_EQ(HugePageMode::NONE, HugePageResource::parseMode(""));
+  EXPECT_EQ(HugePageMode::NONE, HugePageResource::parseMode("none"));
+  EXPECT_EQ(
+      HugePageMode::TRANSPARENT, HugePageResource::parseMode("transparent"));
+  EXPECT_EQ(HugePageMode::EXPLICIT, HugePageResource::parseMode("explicit"));
+  EXPECT_THROW(HugePageResource::parseMode("2M"), FbossError);
+}
+
+TEST(HugePageAllocator, transparent) {
+  HugePageResource resource(HugePageMode::TRANSPARENT);
+
+  // Small allocations are not mapped
+  auto small = resource.allocate(64);
+  EXPECT_EQ(0, resource.mappedBytes());
+  resource.deallocate(small, 64);
+
+  auto bytes = kHugePageSize + 1;
+  auto large = static_cast<char*>(resource.allocate(bytes));
+  EXPECT_EQ(0, reinterpret_cast<uintptr_t>(large) % kHugePageSize);
+  EXPECT_EQ(2 * kHugePageSize, resource.mappedBytes());
+  large[0] = 1;
+  large[bytes - 1] = 1;
+  resource.deallocate(large, bytes);
+  EXPECT_EQ(0, resource.mappedBytes());
+}
+
+TEST(HugePageAllocator, explicitFallsBack) {
+  HugePageResource resource(HugePageMode::EXPLICIT);
+  // Whether or not huge pages are reserved, the allocation succeeds
+  auto ptr = static_cast<char*>(resource.allocate(kHugePageSize));
+  EXPECT_EQ(kHugePageSize, resource.mappedBytes());
+  EXPECT_EQ(0, reinterpret_cast<uintptr_t>(ptr) % kHugePageSize);
+  ptr[kHugePageSize - 1] = 1;
+  resource.deallocate(ptr, kHugePageSize);
+  EXPECT_EQ(0, resource.mappedBytes());
+}
+
+TEST(HugePageAllocator, flatMap) {
+  HugePageResource none(HugePageMode::NONE);
+  HugePageResource transparent(HugePageMode::TRANSPARENT);
+
+  HugePageFlatMap<uint32_t, std::unique_ptr<uint64_t>> map(&transparent);
+  constexpr uint32_t kEntries = 1 << 17;
+  map.reserve(kEntries);
+  EXPECT_LE(kEntries * sizeof(*map.begin()), transparent.mappedBytes());
+  for (uint32_t i = 0; i < kEntries; ++i) {
+    map.emplace_hint(map.end(), i, std::make_unique<uint64_t>(i));
+  }
+  EXPECT_EQ(kEntries - 1, *map.find(kEntries - 1)->second);
+
+  // Swapping hands each map's memory to the other
+  HugePageFlatMap<uint32_t, std::unique_ptr<uint64_t>> other(&none);
+  other.swap(map);
+  EXPECT_EQ(&transparent, other.get_allocator().getResource());
+  EXPECT_EQ(kEntries, other.size());
+  EXPECT_TRUE(map.empty());
+
+  other.clear();
+  other.shrink_to_fit();
+  EXPECT_EQ(0, transparent.mappedBytes());
+}
+
+TEST(HugePageAllocator, blockPool) {
+  HugePageResource transparent(HugePageMode::TRANSPARENT);
+  constexpr size_t kBlockBytes = 100;
+  HugePageBlockPool pool(&transparent, kBlockBytes);
+
+  // Blocks are carved from one huge page, and reused once freed
+  auto first = pool.allocate(kBlockBytes);
+  auto second = pool.allocate(kBlockBytes);
+  EXPECT_EQ(1, pool.numHugePages());
+  EXPECT_EQ(kHugePageSize, transparent.mappedBytes());
+  EXPECT_EQ(0, reinterpret_cast<uintptr_t>(second) % alignof(std::max_align_t));
+  pool.deallocate(first, kBlockBytes);
+  EXPECT_EQ(first, pool.allocate(kBlockBytes));
+
+  // Another huge page is only taken once the first is used up
+  std::vector<void*> blocks;
+  while (pool.numHugePages() == 1) {
+    blocks.push_back(pool.allocate(kBlockBytes));
+  }
+  EXPECT_LT(kHugePageSize / 128, blocks.size());
+  EXPECT_EQ(2 * kHugePageSize, transparent.mappedBytes());
+
+  // Other sizes go to the resource
+  auto other = pool.allocate(kBlockBytes + 1);
+  EXPECT_EQ(2, pool.numHugePages());
+  pool.deallocate(other, kBlockBytes + 1);
+
+  // Without huge pages, the pool takes none
+  HugePageResource none(HugePageMode::NONE);
+  HugePageBlockPool nonePool(&none, kBlockBytes);
+  auto block = nonePool.allocate(kBlockBytes);
+  EXPECT_EQ(0, nonePool.numHugePages());
+  nonePool.deallocate(block, kBlockBytes);
+}
+
+TEST(HugePageAllocator, sortedBlockMap) {
+  using Map = SortedBlockMap<
+      uint32_t,
+      std::unique_ptr<uint64_t>,
+      std::less<uint32_t>,
+      256,
+      HugePageBlockAllocator<std::pair<uint32_t, std::unique_ptr<uint64_t>>>>;
+  HugePageResource transparent(HugePageMode::TRANSPARENT);
+  {
+    HugePageBlockPool pool(&transparent, Map::kBlockBytes);
+    Map map(&pool);
+    constexpr uint32_t kEntries = 1 << 16;
+    for (uint32_t i = 0; i < kEntries; ++i) {
+      map.emplace(i, std::make_unique<uint64_t>(i));
+    }
+    EXPECT_EQ(kEntries - 1, *map.find(kEntries - 1)->second);
+    // The blocks all come from the pool's huge pages
+    EXPECT_LE(map.numBlocks() * Map::kBlockBytes, transparent.mappedBytes());
+    EXPECT_EQ(pool.numHugePages() * kHugePageSize, transparent.mappedBytes());
+  }
+  EXPECT_EQ(0, transparent.mappedBytes());
+}
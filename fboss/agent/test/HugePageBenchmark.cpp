@@ -0,0 +1,134 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include <folly/Benchmark.h>
+#include <folly/IPAddress.h>
+#include <folly/Random.h>
+#include <gflags/gflags.h>
+
+#include "fboss/agent/HugePageAllocator.h"
+
+#include <algorithm>
+#include <array>
+#include <memory>
+#include <vector>
+
+using namespace facebook::fboss;
+
+DEFINE_int32(huge_page_bench_routes, 500000,
+             "The number of routes in the benchmarked tables");
+
+/*
+ * Programming and lookup in a flat map of (prefix, vrf) to a pointer per
+ * route, laid out like the host and egress maps of BcmHostTable, with its
+ * memory from operator new, transparent huge pages and reserved huge pages.
+ * Without reserved huge pages the last falls back to transparent ones.
+ */
+
+namespace {
+
+struct Key {
+  folly::IPAddress network;
+  uint8_t mask;
+  int vrf;
+  bool operator<(const Key& other) const {
+    if (vrf != other.vrf) {
+      return vrf < other.vrf;
+    }
+    if (mask != other.mask) {
+      return mask < other.mask;
+    }
+    return network < other.network;
+  }
+};
+
+struct Route {
+  Key key;
+  uint64_t egress{0};
+};
+
+using Table = HugePageFlatMap<Key, std::unique_ptr<Route>>;
+
+std::vector<Key> makeKeys(size_t count) {
+  std::vector<Key> keys;
+  keys.reserve(count);
+  for (size_t i = 0; i < count; ++i) {
+    std::array<uint8_t, 16> bytes;
+    bytes[0] = 0x20;
+    bytes[1] = 0x01;
+    for (size_t j = 2; j < bytes.size(); ++j) {
+      bytes[j] = folly::Random::rand32(256);
+    }
+    keys.push_back(Key{folly::IPAddressV6(bytes), 64, 0});
+  }
+  return keys;
+}
+
+void fillTable(Table* table, const std::vector<Key>& keys) {
+  table->reserve(keys.size());
+  for (const auto& key : keys) {
+    table->emplace(key, std::make_unique<Route>(Route{key, 0}));
+  }
+}
+
+/*
+ * Route churn: each iteration removes a route and programs a new one at
+ * random places in the table, moving the entries after them.
+ */
+void programBenchmark(uint32_t iters, HugePageMode mode) {
+  HugePageResource resource(mode);
+  Table table(&resource);
+  std::vector<Key> keys;
+  std::vector<Key> newKeys;
+  BENCHMARK_SUSPEND {
+    keys = makeKeys(FLAGS_huge_page_bench_routes);
+    newKeys = makeKeys(iters);
+    fillTable(&table, keys);
+  }
+  for (uint32_t i = 0; i < iters; ++i) {
+    table.erase(keys[i % keys.size()]);
+    const auto& key = newKeys[i];
+    table.emplace(key, std::make_unique<Route>(Route{key, i}));
+  }
+}
+
+void lookupBenchmark(uint32_t iters, HugePageMode mode) {
+  HugePageResource resource(mode);
+  Table table(&resource);
+  std::vector<Key> keys;
+  BENCHMARK_SUSPEND {
+    keys = makeKeys(FLAGS_huge_page_bench_routes);
+    fillTable(&table, keys);
+    std::shuffle(keys.begin(), keys.end(), folly::ThreadLocalPRNG());
+  }
+  for (uint32_t i = 0; i < iters; ++i) {
+    auto iter = table.find(keys[i % keys.size()]);
+    folly::doNotOptimizeAway(iter->second->egress);
+  }
+}
+
+} // unnamed namespace
+
+BENCHMARK_NAMED_PARAM(programBenchmark, OperatorNew, HugePageMode::NONE)
+BENCHMARK_RELATIVE_NAMED_PARAM(
+    programBenchmark, Transparent, HugePageMode::TRANSPARENT)
+BENCHMARK_RELATIVE_NAMED_PARAM(
+    programBenchmark, Explicit, HugePageMode::EXPLICIT)
+BENCHMARK_DRAW_LINE();
+BENCHMARK_NAMED_PARAM(lookupBenchmark, OperatorNew, HugePageMode::NONE)
+BENCHMARK_RELATIVE_NAMED_PARAM(
+    lookupBenchmark, Transparent, HugePageMode::TRANSPARENT)
+BENCHMARK_RELATIVE_NAMED_PARAM(
+    lookupBenchmark, Explicit, HugePageMode::EXPLICIT)
+
+int main(int argc, char** argv) {
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+  folly::runBenchmarks();
+  return 0;
+}
@@ -0,0 +1,112 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "fboss/agent/IcmpErrorLimiter.h"
+#include "fboss/agent/state/ControlPlane.h"
+#include "fboss/agent/state/StateDelta.h"
+#include "fboss/agent/state/SwitchState.h"
+
+#include <gtest/gtest.h>
+#include <memory>
+
+using namespace facebook::fboss;
+using folly::IPAddress;
+
+namespace {
+
+// The time the buckets are checked at, far enough from 0 that they start full
+constexpr double kNow = 1000;
+
+IcmpErrorRateLimit makeLimit(uint32_t burstSize,
+                             uint32_t perSourceBurstSize = 0) {
+  IcmpErrorRateLimit limit;
+  // Rates low enough that no tokens are added between the checks
+  limit.packetsPerSec = 1;
+  limit.burstSize = burstSize;
+  if (perSourceBurstSize) {
+    limit.perSourcePacketsPerSec = 1;
+    limit.perSourceBurstSize = perSourceBurstSize;
+  }
+  return limit;
+}
+
+int admitted(IcmpErrorLimiter* limiter, const IPAddress& dst, int count,
+             double now = kNow) {
+  int admitted = 0;
+  for (int i = 0; i < count; ++i) {
+    admitted += limiter->admit(dst, now);
+  }
+  return admitted;
+}
+
+} // unnamed namespace
+
+TEST(IcmpErrorLimiter, AdmitAllWithoutLimit) {
+  IcmpErrorLimiter limiter;
+  EXPECT_EQ(100, admitted(&limiter, IPAddress("10.0.0.1"), 100));
+}
+
+TEST(IcmpErrorLimiter, GlobalLimit) {
+  IcmpErrorLimiter limiter;
+  limiter.setLimit(makeLimit(5));
+  EXPECT_EQ(3, admitted(&limiter, IPAddress("10.0.0.1"), 3));
+  EXPECT_EQ(2, admitted(&limiter, IPAddress("2401:db00::1"), 10));
+  EXPECT_EQ(0, admitted(&limiter, IPAddress("10.1.0.1"), 10));
+
+  // Two seconds later, two more tokens have been added
+  EXPECT_EQ(2, admitted(&limiter, IPAddress("10.1.0.1"), 10, kNow + 2));
+}
+
+TEST(IcmpErrorLimiter, PerSourceLimit) {
+  IcmpErrorLimiter limiter;
+  limiter.setLimit(makeLimit(100, 2));
+
+  // Sources in the same /24 or /64 share a bucket
+  EXPECT_EQ(1, admitted(&limiter, IPAddress("10.0.0.1"), 1));
+  EXPECT_EQ(1, admitted(&limiter, IPAddress("10.0.0.200"), 10));
+  EXPECT_EQ(2, admitted(&limiter, IPAddress("10.0.1.1"), 10));
+  EXPECT_EQ(2, admitted(&limiter, IPAddress("2401:db00::1"), 10));
+  EXPECT_EQ(0, admitted(&limiter, IPAddress("2401:db00::ffff"), 10));
+  EXPECT_EQ(2, admitted(&limiter, IPAddress("2401:db00:0:1::1"), 10));
+}
+
+TEST(IcmpErrorLimiter, PerSourceDropsDontUseGlobalTokens) {
+  IcmpErrorLimiter limiter;
+  limiter.setLimit(makeLimit(4, 2));
+  EXPECT_EQ(2, admitted(&limiter, IPAddress("10.0.0.1"), 100));
+  EXPECT_EQ(2, admitted(&limiter, IPAddress("10.0.1.1"), 10));
+}
+
+TEST(IcmpErrorLimiter, ReplaceLimit) {
+  IcmpErrorLimiter limiter;
+  for (int burstSize = 1; burstSize <= 10; ++burstSize) {
+    limiter.setLimit(makeLimit(burstSize));
+    EXPECT_EQ(burstSize, admitted(&limiter, IPAddress("10.0.0.1"), 20));
+  }
+  // Only the limiter in use is kept once no error is being checked
+  EXPECT_EQ(1, limiter.numLimiters());
+  limiter.setLimit(folly::none);
+  EXPECT_EQ(0, limiter.numLimiters());
+}
+
+TEST(IcmpErrorLimiter, UpdateFromState) {
+  IcmpErrorLimiter limiter;
+  auto oldState = std::make_shared<SwitchState>();
+  auto newState = oldState->clone();
+  auto controlPlane = newState->getControlPlane()->clone();
+  controlPlane->setIcmpErrorRateLimit(makeLimit(1));
+  newState->resetControlPlane(controlPlane);
+
+  limiter.stateUpdated(StateDelta(oldState, newState));
+  EXPECT_EQ(1, admitted(&limiter, IPAddress("10.0.0.1"), 10));
+
+  // And the limit goes away with the config
+  limiter.stateUpdated(StateDelta(newState, oldState));
+  EXPECT_EQ(10, admitted(&limiter, IPAddress("10.0.0.1"), 10));
+}
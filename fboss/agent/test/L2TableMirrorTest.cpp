@@ -0,0 +1,161 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "fboss/agent/L2TableMirror.h"
+
+#include "fboss/agent/FbossError.h"
+
+#include <folly/Conv.h>
+#include <gtest/gtest.h>
+
+using namespace facebook::fboss;
+using folly::MacAddress;
+
+namespace {
+
+// The entries of a page, as "<vlan>/<mac>@<port>"
+std::vector<std::string> toStrings(const std::vector<L2EntryThrift>& entries) {
+  std::vector<std::string> strs;
+  for (const auto& entry : entries) {
+    strs.push_back(folly::to<std::string>(
+        entry.vlanID, "/", entry.mac, "@", entry.port));
+  }
+  return strs;
+}
+
+// Every page of a query, maxEntries at a time
+std::vector<std::string> getPages(
+    const L2TableMirror& table,
+    const L2TableQuery& query,
+    size_t maxEntries,
+    size_t* numPages = nullptr) {
+  std::vector<std::string> entries;
+  std::string cursor;
+  size_t pages = 0;
+  do {
+    L2TablePage page;
+    table.getPage(query, cursor, maxEntries, &page);
+    EXPECT_LE(page.entries.size(), maxEntries);
+    auto strs = toStrings(page.entries);
+    entries.insert(entries.end(), strs.begin(), strs.end());
+    cursor = page.nextCursor;
+    ++pages;
+  } while (!cursor.empty());
+  if (numPages) {
+    *numPages = pages;
+  }
+  return entries;
+}
+
+void fillTable(L2TableMirror& table) {
+  table.learned(VlanID(2), MacAddress("02:00:00:00:00:02"), 1);
+  table.learned(VlanID(1), MacAddress("02:00:00:00:00:01"), 1);
+  table.learned(VlanID(1), MacAddress("02:00:01:00:00:01"), 2);
+  table.learned(VlanID(2), MacAddress("02:00:00:00:00:01"), 3);
+  table.learned(VlanID(1), MacAddress("04:00:00:00:00:01"), 2);
+}
+
+} // unnamed namespace
+
+TEST(L2TableMirrorTest, LearnAndAge) {
+  L2TableMirror table;
+  fillTable(table);
+  EXPECT_EQ(5, table.size());
+
+  // A station move, and an entry aged out
+  table.learned(VlanID(2), MacAddress("02:00:00:00:00:01"), 2);
+  table.aged(VlanID(1), MacAddress("04:00:00:00:00:01"));
+  table.aged(VlanID(3), MacAddress("04:00:00:00:00:01"));
+
+  std::vector<L2EntryThrift> entries;
+  table.getAll(&entries);
+  std::vector<std::string> expected{
+      "1/02:00:00:00:00:01@1",
+      "1/02:00:01:00:00:01@2",
+      "2/02:00:00:00:00:01@2",
+      "2/02:00:00:00:00:02@1"};
+  EXPECT_EQ(expected, toStrings(entries));
+
+  L2TableQuery byPort;
+  byPort.port = 2;
+  byPort.__isset.port = true;
+  expected = {"1/02:00:01:00:00:01@2", "2/02:00:00:00:00:01@2"};
+  EXPECT_EQ(expected, getPages(table, byPort, 10));
+  byPort.port = 3;
+  EXPECT_TRUE(getPages(table, byPort, 10).empty());
+
+  table.clear();
+  EXPECT_EQ(0, table.size());
+  EXPECT_TRUE(getPages(table, L2TableQuery(), 10).empty());
+}
+
+TEST(L2TableMirrorTest, Pages) {
+  L2TableMirror table;
+  fillTable(table);
+
+  size_t numPages;
+  auto all = getPages(table, L2TableQuery(), 2, &numPages);
+  EXPECT_EQ(3, numPages);
+  std::vector<std::string> expected{
+      "1/02:00:00:00:00:01@1",
+      "1/02:00:01:00:00:01@2",
+      "1/04:00:00:00:00:01@2",
+      "2/02:00:00:00:00:01@3",
+      "2/02:00:00:00:00:02@1"};
+  EXPECT_EQ(expected, all);
+
+  L2TableQuery byVlan;
+  byVlan.vlanID = 1;
+  byVlan.__isset.vlanID = true;
+  expected = {
+      "1/02:00:00:00:00:01@1",
+      "1/02:00:01:00:00:01@2",
+      "1/04:00:00:00:00:01@2"};
+  EXPECT_EQ(expected, getPages(table, byVlan, 1, &numPages));
+  EXPECT_EQ(3, numPages);
+
+  // Filters combine
+  byVlan.port = 2;
+  byVlan.__isset.port = true;
+  expected = {"1/02:00:01:00:00:01@2", "1/04:00:00:00:00:01@2"};
+  EXPECT_EQ(expected, getPages(table, byVlan, 1));
+
+  // MAC prefix pages are ordered by MAC instead
+  L2TableQuery byMac;
+  byMac.macPrefix = "02:00:0";
+  byMac.__isset.macPrefix = true;
+  expected = {
+      "1/02:00:00:00:00:01@1",
+      "2/02:00:00:00:00:01@3",
+      "2/02:00:00:00:00:02@1",
+      "1/02:00:01:00:00:01@2"};
+  EXPECT_EQ(expected, getPages(table, byMac, 3, &numPages));
+  EXPECT_EQ(2, numPages);
+  byMac.macPrefix = "0200:01";
+  expected = {"1/02:00:01:00:00:01@2"};
+  EXPECT_EQ(expected, getPages(table, byMac, 3));
+}
+
+TEST(L2TableMirrorTest, BadQueries) {
+  L2TableMirror table;
+  fillTable(table);
+  L2TablePage page;
+  EXPECT_THROW(
+      table.getPage(L2TableQuery(), "1-02:00:00:00:00:01", 10, &page),
+      FbossError);
+  EXPECT_THROW(
+      table.getPage(L2TableQuery(), "1/02:00", 10, &page), FbossError);
+
+  L2TableQuery query;
+  query.macPrefix = "02:0g";
+  query.__isset.macPrefix = true;
+  EXPECT_THROW(table.getPage(query, "", 10, &page), FbossError);
+  query.macPrefix = "02:00:00:00:00:00:0";
+  EXPECT_THROW(table.getPage(query, "", 10, &page), FbossError);
+}
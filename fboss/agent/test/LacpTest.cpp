@@ -28,6 +28,7 @@
 #include <gtest/gtest.h>
 
 #include "fboss/agent/LacpController.h"
+#include "fboss/agent/LacpTimer.h"
 #include "fboss/agent/LacpTypes.h"
 #include "fboss/agent/LinkAggregationManager.h"
 #include "fboss/agent/gen-cpp2/switch_config_types.h"
@@ -48,6 +49,7 @@ class LacpTest : public ::testing::Test {
       // TODO(samank): why doesn't this trip the CHECK...
       lacpEvb_.loopForever();
     }));
+    lacpTimer_ = std::make_unique<LacpTimer>(&lacpEvb_, nullptr);
   }
 
   folly::EventBase* lacpEvb() {
@@ -55,7 +57,13 @@ class LacpTest : public ::testing::Test {
     return &lacpEvb_;
   }
 
+  LacpTimer* lacpTimer() {
+    lacpEvb_.waitUntilRunning();
+    return lacpTimer_.get();
+  }
+
   void TearDown() override {
+    lacpTimer_.reset();
     lacpEvb_.terminateLoopSoon();
     lacpThread_->join();
   }
@@ -63,6 +71,7 @@ class LacpTest : public ::testing::Test {
  private:
   folly::EventBase lacpEvb_;
   std::unique_ptr<std::thread> lacpThread_{nullptr};
+  std::unique_ptr<LacpTimer> lacpTimer_;
 };
 
 class LacpServiceInterceptor : public LacpServicerIf {
@@ -75,6 +84,7 @@ class LacpServiceInterceptor : public LacpServicerIf {
     auto portToLastTransmissionLocked = portToLastTransmission_.wlock();
 
     (*portToLastTransmissionLocked)[portID] = lacpdu;
+    ++(*portToTransmissionCount_.wlock())[portID];
 
     // "Transmit" the frame
     return true;
@@ -117,29 +127,39 @@ class LacpServiceInterceptor : public LacpServicerIf {
   }
 
   // The following methods ensure all processing up to their invocation has
-  // has completed in the LACP eventbase.
+  // has completed in the LACP eventbase, including the transmissions it led
+  // to, which go out at the end of the loop iteration.
   LacpState lastActorStateTransmitted(PortID portID) {
     LacpState actorStateTransmitted = LacpState::NONE;
 
-    lacpEvb_->runInEventBaseThreadAndWait(
-        [this, portID, &actorStateTransmitted]() {
-          auto lastTransmission = portToLastTransmission_.rlock()->at(portID);
-          actorStateTransmitted = lastTransmission.actorInfo.state;
-        });
+    runAfterTransmissions([this, portID, &actorStateTransmitted]() {
+      auto lastTransmission = portToLastTransmission_.rlock()->at(portID);
+      actorStateTransmitted = lastTransmission.actorInfo.state;
+    });
 
     return actorStateTransmitted;
   }
   LacpState lastPartnerStateTransmitted(PortID portID) {
     LacpState partnerStateTransmitted = LacpState::NONE;
 
-    lacpEvb_->runInEventBaseThreadAndWait(
-        [this, portID, &partnerStateTransmitted]() {
-          auto lastTransmission = portToLastTransmission_.rlock()->at(portID);
-          partnerStateTransmitted = lastTransmission.partnerInfo.state;
-        });
+    runAfterTransmissions([this, portID, &partnerStateTransmitted]() {
+      auto lastTransmission = portToLastTransmission_.rlock()->at(portID);
+      partnerStateTransmitted = lastTransmission.partnerInfo.state;
+    });
 
     return partnerStateTransmitted;
   }
+  int transmissionCount(PortID portID) {
+    int count = 0;
+
+    runAfterTransmissions([this, portID, &count]() {
+      auto counts = portToTransmissionCount_.rlock();
+      auto it = counts->find(portID);
+      count = it == counts->end() ? 0 : it->second;
+    });
+
+    return count;
+  }
   bool isForwarding(PortID portID) {
     bool forwarding = false;
 
@@ -150,6 +170,21 @@ class LacpServiceInterceptor : public LacpServicerIf {
     return forwarding;
   }
 
+  void runAfterTransmissions(folly::Function<void()> fn) {
+    folly::Baton<> done;
+
+    // Loop callbacks run in the order they were scheduled, so this one runs
+    // after the LacpTimer has transmitted
+    lacpEvb_->runInEventBaseThread([this, &fn, &done]() {
+      lacpEvb_->runInLoop([&fn, &done]() {
+        fn();
+        done.post();
+      });
+    });
+
+    done.wait();
+  }
+
   ~LacpServiceInterceptor() {
     lacpEvb_->runInEventBaseThreadAndWait([this]() {
       for (auto& controller : controllers_) {
@@ -167,6 +202,9 @@ class LacpServiceInterceptor : public LacpServicerIf {
   using PortIDToLacpduMap = boost::container::flat_map<PortID, LACPDU>;
   folly::Synchronized<PortIDToLacpduMap> portToLastTransmission_;
 
+  using PortIDToCountMap = boost::container::flat_map<PortID, int>;
+  folly::Synchronized<PortIDToCountMap> portToTransmissionCount_;
+
   folly::EventBase* lacpEvb_{nullptr};
 };
 
@@ -199,7 +237,7 @@ TEST_F(LacpTest, nonAggregatablePortTransmitsIndividualBit) {
 
   // An LacpController's methods assume it is being managed by a shared_ptr
   auto controllerPtr = std::make_shared<LacpController>(
-      PortID(1), lacpEvb(), &serviceInterceptor);
+      PortID(1), lacpTimer(), &serviceInterceptor);
   serviceInterceptor.addController(controllerPtr);
 
   // At this point, the LacpController we would like to test and the
@@ -227,6 +265,54 @@ TEST_F(LacpTest, nonAggregatablePortTransmitsIndividualBit) {
   controllerPtr->stopMachines();
 }
 
+/*
+ * Every machine that signals NeedToTransmit while a frame is processed gets
+ * the same LACPDU out, so it should only be transmitted once, with the state
+ * the machines were left in.
+ */
+TEST_F(LacpTest, nttBatchedPerLoop) {
+  LacpServiceInterceptor serviceInterceptor(lacpEvb());
+
+  // A passive, slow port, so that there are no periodic transmissions to
+  // count
+  auto controllerPtr = std::make_shared<LacpController>(
+      PortID(1),
+      lacpTimer(),
+      32768 /* port priority */,
+      cfg::LacpPortRate::SLOW,
+      cfg::LacpPortActivity::PASSIVE,
+      AggregatePortID(1),
+      65535 /* system priority */,
+      MacAddress("02:90:fb:5e:1e:8d"),
+      1 /* minimum-link count */,
+      &serviceInterceptor);
+  serviceInterceptor.addController(controllerPtr);
+
+  controllerPtr->startMachines();
+  controllerPtr->portUp();
+
+  ASSERT_EQ(serviceInterceptor.transmissionCount(PortID(1)), 0);
+
+  // Selecting the LAG attaches the MuxMachine, which signals NeedToTransmit,
+  // as does the ReceiveMachine since the partner doesn't know about us yet
+  ParticipantInfo actorInfo;
+  actorInfo.systemPriority = 32768;
+  actorInfo.systemID = {{0x00, 0x1c, 0x73, 0x5b, 0xa8, 0x47}};
+  actorInfo.key = 609;
+  actorInfo.portPriority = 32768;
+  actorInfo.port = 499;
+  actorInfo.state = LacpState::ACTIVE | LacpState::AGGREGATABLE;
+  ParticipantInfo partnerInfo = ParticipantInfo::defaultParticipantInfo();
+  controllerPtr->received(LACPDU(actorInfo, partnerInfo));
+
+  ASSERT_EQ(serviceInterceptor.transmissionCount(PortID(1)), 1);
+  ASSERT_EQ(
+      serviceInterceptor.lastActorStateTransmitted(PortID(1)),
+      LacpState::AGGREGATABLE | LacpState::IN_SYNC);
+
+  controllerPtr->stopMachines();
+}
+
 /*
  * When link aggregation was first deployed to production, the following
  * logical sequence of events was observed:
@@ -250,8 +336,8 @@ TEST_F(LacpTest, frameReceivedOnDownPort) {
   MockLacpServicer lacpServicer;
 
   // An LacpController's methods assume it is being managed by a shared_ptr
-  auto controllerPtr =
-      std::make_shared<LacpController>(PortID(1), lacpEvb(), &lacpServicer);
+  auto controllerPtr = std::make_shared<LacpController>(
+      PortID(1), lacpTimer(), &lacpServicer);
 
   // At this point, the LacpController we would like to test is in place
   controllerPtr->startMachines();
@@ -308,7 +394,7 @@ TEST_F(LacpTest, DUColdBootReconvergenceWithESW) {
   // methods assume it is being managed by a shared_ptr
   auto duControllerPtr = std::make_shared<LacpController>(
       PortID(duInfo.port),
-      lacpEvb(),
+      lacpTimer(),
       duInfo.portPriority,
       cfg::LacpPortRate::FAST,
       cfg::LacpPortActivity::ACTIVE,
@@ -492,7 +578,7 @@ TEST_F(LacpTest, UUColdBootReconvergenceWithDR) {
 
     controllerPtrs[portIdx] = std::make_shared<LacpController>(
         PortID(info.port),
-        lacpEvb(),
+        lacpTimer(),
         info.portPriority,
         cfg::LacpPortRate::FAST,
         cfg::LacpPortActivity::ACTIVE,
@@ -0,0 +1,150 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "fboss/agent/LinkAggregationManager.h"
+
+#include "fboss/agent/SwSwitch.h"
+#include "fboss/agent/SwitchStats.h"
+#include "fboss/agent/packet/PktUtil.h"
+#include "fboss/agent/test/CounterCache.h"
+#include "fboss/agent/test/HwTestHandle.h"
+#include "fboss/agent/test/TestUtils.h"
+
+#include <folly/io/IOBuf.h>
+#include <folly/io/async/EventBase.h>
+#include <folly/synchronization/Baton.h>
+#include <gtest/gtest.h>
+
+using namespace facebook::fboss;
+using std::string;
+
+namespace {
+
+const PortID kPort(1);
+const VlanID kVlan(1);
+
+string zeros(size_t count) {
+  string hex;
+  for (size_t i = 0; i < count; ++i) {
+    hex += "00 ";
+  }
+  return hex;
+}
+
+// A LACPDU from port 1 of system 00:02:00:01:02:03, or just its actor
+// information when truncated, which the test handle pads to a frame that
+// is long enough to be handled
+std::unique_ptr<folly::IOBuf> lacpFrame(bool truncated = false) {
+  string hex =
+      // dst mac, src mac, 802.1q, VLAN 1
+      "01 80 c2 00 00 02  00 02 00 01 02 03  81 00 00 01"
+      // Slow protocols, subtype: LACP, version 1
+      "88 09  01  01"
+      // actor: system priority, system, key, port priority, port, state
+      "01 14  00 01  00 02 00 01 02 03  00 01  00 01  00 01  3d" +
+      zeros(3);
+  if (!truncated) {
+    hex +=
+        // partner
+        "02 14" + zeros(18) + zeros(3) +
+        // collector: max delay
+        "03 10  00 00" + zeros(12) +
+        // terminator
+        "00 00" + zeros(50);
+  }
+  return std::make_unique<folly::IOBuf>(PktUtil::parseHexData(hex));
+}
+
+class LinkAggregationManagerTest : public ::testing::Test {
+ public:
+  void SetUp() override {
+    handle_ = createTestHandle(
+        testStateA(), folly::none, SwitchFlags::ENABLE_LACP);
+    sw_ = handle_->getSw();
+    ASSERT_NE(nullptr, sw_->getLagManager());
+  }
+
+  void TearDown() override {
+    unblockLacpThread();
+  }
+
+  // Wait for the LACP thread to handle the LACPDUs queued so far
+  void waitForLacpThread() {
+    sw_->getLacpEvb()->runInEventBaseThreadAndWait([]() { return; });
+  }
+
+  // Keep the LACP thread busy until unblockLacpThread()
+  void blockLacpThread() {
+    folly::Baton<> blocked;
+    sw_->getLacpEvb()->runInEventBaseThread([this, &blocked]() {
+      blocked.post();
+      release_.wait();
+    });
+    blocked.wait();
+    blocked_ = true;
+  }
+
+  void unblockLacpThread() {
+    if (blocked_) {
+      release_.post();
+      blocked_ = false;
+    }
+  }
+
+ protected:
+  std::unique_ptr<HwTestHandle> handle_;
+  SwSwitch* sw_{nullptr};
+
+ private:
+  folly::Baton<> release_;
+  bool blocked_{false};
+};
+
+} // unnamed namespace
+
+TEST_F(LinkAggregationManagerTest, ParsedOnLacpThread) {
+  CounterCache counters(sw_);
+  blockLacpThread();
+
+  // The RX thread only queues the LACPDUs, so a truncated one isn't noticed
+  // until the LACP thread gets to it
+  handle_->rxPacket(lacpFrame(), kPort, kVlan);
+  handle_->rxPacket(lacpFrame(true), kPort, kVlan);
+  counters.update();
+  counters.checkDelta(SwitchStats::kCounterPrefix + "trapped.error.sum", 0);
+
+  unblockLacpThread();
+  waitForLacpThread();
+  counters.update();
+  counters.checkDelta(SwitchStats::kCounterPrefix + "trapped.error.sum", 1);
+  counters.checkDelta(SwitchStats::kCounterPrefix + "trapped.drops.sum", 1);
+}
+
+TEST_F(LinkAggregationManagerTest, QueueOverflowDropped) {
+  const size_t extra = 5;
+  CounterCache counters(sw_);
+  blockLacpThread();
+
+  for (size_t i = 0; i < LinkAggregationManager::kMaxPendingLacpdus + extra;
+       ++i) {
+    handle_->rxPacket(lacpFrame(), kPort, kVlan);
+  }
+  counters.update();
+  counters.checkDelta(
+      SwitchStats::kCounterPrefix + "trapped.drops.sum", extra);
+
+  // Once the LACP thread caught up, the queue takes LACPDUs again
+  unblockLacpThread();
+  waitForLacpThread();
+  handle_->rxPacket(lacpFrame(), kPort, kVlan);
+  waitForLacpThread();
+  counters.update();
+  counters.checkDelta(SwitchStats::kCounterPrefix + "trapped.drops.sum", 0);
+  counters.checkDelta(SwitchStats::kCounterPrefix + "trapped.error.sum", 0);
+}
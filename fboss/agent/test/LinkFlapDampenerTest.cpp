@@ -0,0 +1,164 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "fboss/agent/LinkFlapDampener.h"
+
+#include <gtest/gtest.h>
+
+using namespace facebook::fboss;
+using std::chrono::milliseconds;
+using std::chrono::seconds;
+using Clock = LinkFlapDampener::Clock;
+
+namespace {
+
+// The defaults: a penalty of 1000 per flap, suppressed over 2000, reused
+// under 750, with a half life of 15s and suppressed for at most 60s
+cfg::LinkFlapDampening makeConfig() {
+  return cfg::LinkFlapDampening();
+}
+
+// Flap the port down and back up at the times given, in seconds from start
+void flap(
+    LinkFlapDampener* dampener,
+    PortID port,
+    Clock::time_point start,
+    int downAt,
+    int upAt) {
+  dampener->linkChanged(port, false, start + seconds(downAt));
+  dampener->linkChanged(port, true, start + seconds(upAt));
+}
+
+} // unnamed namespace
+
+TEST(LinkFlapDampenerTest, Suppress) {
+  LinkFlapDampener dampener;
+  dampener.setConfig(makeConfig());
+  Clock::time_point start;
+  PortID port(1);
+
+  // Two flaps in quick succession decay to just under the threshold
+  EXPECT_TRUE(dampener.linkChanged(port, false, start));
+  EXPECT_TRUE(dampener.linkChanged(port, true, start + seconds(1)));
+  EXPECT_DOUBLE_EQ(1000, dampener.getPenalty(port, start));
+  EXPECT_TRUE(dampener.linkChanged(port, false, start + seconds(2)));
+  EXPECT_FALSE(dampener.isSuppressed(port));
+  EXPECT_TRUE(dampener.linkChanged(port, true, start + seconds(3)));
+  EXPECT_FALSE(dampener.getNextReuse().hasValue());
+
+  // The third is passed on, as it takes the port down, but the link coming
+  // back up isn't
+  EXPECT_TRUE(dampener.linkChanged(port, false, start + seconds(4)));
+  EXPECT_TRUE(dampener.isSuppressed(port));
+  EXPECT_FALSE(dampener.linkChanged(port, true, start + seconds(5)));
+  EXPECT_FALSE(dampener.linkChanged(port, false, start + seconds(6)));
+  EXPECT_FALSE(dampener.linkChanged(port, true, start + seconds(7)));
+
+  // Other ports aren't affected
+  EXPECT_TRUE(dampener.linkChanged(PortID(2), false, start + seconds(7)));
+  EXPECT_TRUE(dampener.linkChanged(PortID(2), true, start + seconds(7)));
+}
+
+TEST(LinkFlapDampenerTest, Reuse) {
+  LinkFlapDampener dampener;
+  dampener.setConfig(makeConfig());
+  Clock::time_point start;
+  PortID up(1);
+  PortID down(2);
+  for (int i = 0; i < 3; ++i) {
+    flap(&dampener, up, start, i, i);
+    flap(&dampener, down, start, i, i);
+  }
+  dampener.linkChanged(down, false, start + seconds(3));
+  ASSERT_TRUE(dampener.isSuppressed(up));
+  ASSERT_TRUE(dampener.isSuppressed(down));
+
+  // The penalty halves every half life
+  auto penalty = dampener.getPenalty(up, start + seconds(2));
+  EXPECT_NEAR(penalty / 2, dampener.getPenalty(up, start + seconds(17)), 1e-6);
+
+  auto next = dampener.getNextReuse();
+  ASSERT_TRUE(next.hasValue());
+  EXPECT_TRUE(dampener.reuse(*next - milliseconds(1)).empty());
+  EXPECT_TRUE(dampener.isSuppressed(up));
+
+  // Only the port whose link is up is released to be brought up, once the
+  // penalty has decayed to the reuse threshold
+  EXPECT_NEAR(750, dampener.getPenalty(up, *next), 1);
+  EXPECT_EQ(std::vector<PortID>{up}, dampener.reuse(*next));
+  EXPECT_FALSE(dampener.isSuppressed(up));
+  EXPECT_TRUE(dampener.linkChanged(up, false, *next));
+
+  // The port that flapped last is released later, and stays down
+  next = dampener.getNextReuse();
+  ASSERT_TRUE(next.hasValue());
+  EXPECT_TRUE(dampener.reuse(*next).empty());
+  EXPECT_FALSE(dampener.isSuppressed(down));
+  EXPECT_FALSE(dampener.getNextReuse().hasValue());
+  EXPECT_TRUE(dampener.linkChanged(down, true, *next));
+}
+
+TEST(LinkFlapDampenerTest, MaxSuppress) {
+  LinkFlapDampener dampener;
+  dampener.setConfig(makeConfig());
+  Clock::time_point start;
+  PortID port(1);
+  for (int i = 0; i < 100; ++i) {
+    flap(&dampener, port, start, i, i);
+  }
+  // Released no later than the max suppress time after the last flap
+  auto next = dampener.getNextReuse();
+  ASSERT_TRUE(next.hasValue());
+  EXPECT_LE(*next, start + seconds(99 + 60));
+  EXPECT_GT(*next, start + seconds(99 + 60) - milliseconds(1));
+  EXPECT_EQ(std::vector<PortID>{port}, dampener.reuse(*next));
+}
+
+TEST(LinkFlapDampenerTest, ConfigChange) {
+  LinkFlapDampener dampener;
+  Clock::time_point start;
+  PortID port(1);
+
+  // Nothing is dampened without a config
+  for (int i = 0; i < 5; ++i) {
+    EXPECT_TRUE(dampener.linkChanged(port, false, start + seconds(i)));
+    EXPECT_TRUE(dampener.linkChanged(port, true, start + seconds(i)));
+  }
+  EXPECT_EQ(0, dampener.getPenalty(port, start + seconds(5)));
+
+  EXPECT_TRUE(dampener.setConfig(makeConfig()).empty());
+  for (int i = 0; i < 3; ++i) {
+    flap(&dampener, port, start, i, i);
+  }
+  ASSERT_TRUE(dampener.isSuppressed(port));
+
+  // The same config leaves the penalties be
+  EXPECT_TRUE(dampener.setConfig(makeConfig()).empty());
+  EXPECT_TRUE(dampener.isSuppressed(port));
+
+  // A new one starts over, releasing the suppressed ports
+  auto config = makeConfig();
+  config.suppressThreshold = 5000;
+  EXPECT_EQ(std::vector<PortID>{port}, dampener.setConfig(config));
+  EXPECT_FALSE(dampener.isSuppressed(port));
+  EXPECT_EQ(0, dampener.getPenalty(port, start + seconds(3)));
+  for (int i = 3; i < 6; ++i) {
+    flap(&dampener, port, start, i, i);
+  }
+  EXPECT_FALSE(dampener.isSuppressed(port));
+  for (int i = 0; i < 3; ++i) {
+    flap(&dampener, port, start, 6, 6);
+  }
+  ASSERT_TRUE(dampener.isSuppressed(port));
+
+  // As does turning dampening off
+  EXPECT_EQ(std::vector<PortID>{port}, dampener.setConfig(folly::none));
+  EXPECT_TRUE(dampener.linkChanged(port, true, start + seconds(7)));
+  EXPECT_FALSE(dampener.getNextReuse().hasValue());
+}
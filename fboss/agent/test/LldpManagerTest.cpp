@@ -100,6 +100,28 @@ TxMatchFn checkLldpPDU() {
    };
 }
 
+// Matches the port ID TLV, which follows the tagged Ethernet header and the
+// chassis ID TLV
+TxMatchFn checkLldpPortName(const std::string& expected) {
+  return [=](const TxPacket* pkt) {
+    Cursor c(pkt->buf());
+    c += 18 + 2 + LldpManager::CHASSIS_TLV_LENGTH;
+
+    auto portTLVTypeLength = c.readBE<uint16_t>();
+    auto length = portTLVTypeLength & ((1 << 9) - 1);
+    auto subType = c.readBE<uint8_t>();
+    if (subType != LldpManager::PORT_TLV_SUB_TYPE_INTERFACE) {
+      throw FbossError("expected port tlv sub-type -",
+                       LldpManager::PORT_TLV_SUB_TYPE_INTERFACE,
+                       " found -", static_cast<int>(subType));
+    }
+    auto name = c.readFixedString(length - 1);
+    if (name != expected) {
+      throw FbossError("expected port id ", expected, "; got ", name);
+    }
+  };
+}
+
 TEST(LldpManagerTest, LldpSend) {
   auto handle = setupTestHandle();
   auto sw = handle->getSw();
@@ -112,6 +134,33 @@ TEST(LldpManagerTest, LldpSend) {
   lldpManager.sendLldpOnAllPorts(false);
 }
 
+TEST(LldpManagerTest, LldpSendAfterRename) {
+  auto handle = setupTestHandle();
+  auto sw = handle->getSw();
+
+  LldpManager lldpManager(sw);
+  EXPECT_HW_CALL(sw, sendPacketOutOfPort_(_, _)).Times(AtLeast(1));
+  lldpManager.sendLldpOnAllPorts(false);
+
+  // The frame cached for the port has to go with its name
+  auto renameFn = [](const shared_ptr<SwitchState>& state) {
+    shared_ptr<SwitchState> newState{state};
+    auto* port = newState->getPorts()->getPort(PortID(1)).get();
+    port = port->modify(&newState);
+    port->setName("renamed1");
+    return newState;
+  };
+  sw->updateStateBlocking("rename port", renameFn);
+  waitForStateUpdates(sw);
+
+  EXPECT_HW_CALL(
+      sw,
+      sendPacketOutOfPort_(TxPacketMatcher::createMatcher(
+                             "Lldp PDU", checkLldpPortName("renamed1")),
+                           PortID(1))).Times(1);
+  lldpManager.sendLldpOnAllPorts(false);
+}
+
 TEST(LldpManagerTest, NotEnabledTest) {
   // Setup switch without flags enabling LLDP, and
   // send an LLDP frame nevertheless. Used to segfault
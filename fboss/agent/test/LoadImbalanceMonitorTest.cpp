@@ -0,0 +1,197 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "fboss/agent/LoadImbalanceMonitor.h"
+
+#include "common/stats/ServiceData.h"
+#include "fboss/agent/state/AggregatePort.h"
+#include "fboss/agent/state/AggregatePortMap.h"
+#include "fboss/agent/state/ArpTable.h"
+#include "fboss/agent/state/RouteUpdater.h"
+#include "fboss/agent/state/SwitchState.h"
+#include "fboss/agent/state/Vlan.h"
+#include "fboss/agent/state/VlanMap.h"
+#include "fboss/agent/test/TestUtils.h"
+
+#include <gtest/gtest.h>
+
+using namespace facebook::fboss;
+using folly::IPAddress;
+using folly::IPAddressV4;
+using folly::MacAddress;
+using std::chrono::seconds;
+using std::make_shared;
+using std::shared_ptr;
+
+namespace {
+
+constexpr int64_t kMB = 1000 * 1000;
+
+// Each of the ports with the egress bytes given
+PortStatsSnapshot::Snapshot makeCounters(
+    std::vector<std::pair<int, int64_t>> portBytes) {
+  PortStatsSnapshot::Snapshot counters;
+  for (const auto& entry : portBytes) {
+    counters[PortID(entry.first)].output.bytes = entry.second;
+  }
+  return counters;
+}
+
+shared_ptr<SwitchState> addLag(const shared_ptr<SwitchState>& state) {
+  std::vector<AggregatePort::Subport> subports;
+  for (int port = 1; port <= 3; ++port) {
+    subports.emplace_back(
+        PortID(port),
+        0,
+        cfg::LacpPortRate::SLOW,
+        cfg::LacpPortActivity::ACTIVE);
+  }
+  auto aggPort = AggregatePort::fromSubportRange(
+      AggregatePortID(1),
+      "lag1",
+      "",
+      0,
+      MacAddress("02:00:00:00:00:01"),
+      1,
+      folly::range(subports.begin(), subports.end()));
+  // Port 3 isn't forwarding, so isn't a member
+  aggPort->setForwardingState(PortID(1), AggregatePort::Forwarding::ENABLED);
+  aggPort->setForwardingState(PortID(2), AggregatePort::Forwarding::ENABLED);
+  auto aggPorts = make_shared<AggregatePortMap>();
+  aggPorts->addNode(aggPort);
+  auto newState = state->clone();
+  newState->resetAggregatePorts(aggPorts);
+  return newState;
+}
+
+void addArpEntry(
+    shared_ptr<SwitchState>* state,
+    VlanID vlan,
+    InterfaceID intf,
+    const std::string& ip,
+    PortID port) {
+  auto arpTable =
+      (*state)->getVlans()->getVlan(vlan)->getArpTable()->modify(vlan, state);
+  arpTable->addEntry(
+      IPAddressV4(ip), MacAddress("02:00:00:00:00:02"), PortDescriptor(port),
+      intf);
+}
+
+shared_ptr<SwitchState> addEcmpRoutes(const shared_ptr<SwitchState>& state) {
+  RouteUpdater updater(state->getRouteTables());
+  for (const auto& prefix : {"10.10.0.0", "10.11.0.0"}) {
+    updater.addRoute(
+        RouterID(0), IPAddress(prefix), 16, ClientID(1),
+        RouteNextHopEntry(
+            makeNextHops({"10.0.0.22", "10.0.55.22", "10.0.55.23"}),
+            AdminDistance::EBGP));
+  }
+  auto newState = state->clone();
+  newState->resetRouteTables(updater.updateDone());
+  // The third next hop's neighbor isn't resolved, so it isn't a member
+  addArpEntry(
+      &newState, VlanID(1), InterfaceID(1), "10.0.0.22", PortID(1));
+  addArpEntry(
+      &newState, VlanID(55), InterfaceID(55), "10.0.55.22", PortID(11));
+  return newState;
+}
+
+} // unnamed namespace
+
+TEST(LoadImbalanceMonitorTest, FindGroups) {
+  auto state = addEcmpRoutes(addLag(testStateA()));
+  auto groups = LoadImbalanceMonitor::findGroups(*state);
+  ASSERT_EQ(2, groups.size());
+
+  EXPECT_EQ(LoadBalancedGroupType::LAG, groups[0].type);
+  EXPECT_EQ("lag1", groups[0].name);
+  ASSERT_EQ(2, groups[0].members.size());
+  EXPECT_EQ("port1", groups[0].members[0].name);
+  EXPECT_EQ("port2", groups[0].members[1].name);
+
+  // Both routes share the one group
+  EXPECT_EQ(LoadBalancedGroupType::ECMP, groups[1].type);
+  EXPECT_EQ("port1,port11", groups[1].name);
+  EXPECT_EQ(2, groups[1].numRoutes);
+  ASSERT_EQ(2, groups[1].members.size());
+  EXPECT_EQ(std::vector<PortID>{PortID(11)}, groups[1].members[1].ports);
+}
+
+TEST(LoadImbalanceMonitorTest, Measure) {
+  gflags::FlagSaver saver;
+  FLAGS_load_imbalance_interval_s = 10;
+  FLAGS_load_imbalance_min_bytes = 10 * kMB;
+
+  auto state = addEcmpRoutes(addLag(testStateA()));
+  LoadImbalanceMonitor monitor;
+  std::chrono::steady_clock::time_point start;
+  monitor.update(state, makeCounters({{1, 0}, {2, 0}, {11, 0}}), start);
+  EXPECT_TRUE(monitor.getTopImbalanced(10).empty());
+
+  // Not an interval yet
+  monitor.update(
+      state,
+      makeCounters({{1, 100 * kMB}, {2, 0}, {11, 0}}),
+      start + seconds(5));
+  EXPECT_TRUE(monitor.getTopImbalanced(10).empty());
+
+  // Port 1 is in both groups
+  monitor.update(
+      state,
+      makeCounters({{1, 30 * kMB}, {2, 10 * kMB}, {11, 1 * kMB}}),
+      start + seconds(10));
+  auto top = monitor.getTopImbalanced(10);
+  ASSERT_EQ(2, top.size());
+  EXPECT_EQ(LoadBalancedGroupType::ECMP, top[0].type);
+  EXPECT_DOUBLE_EQ(60.0 / 31, top[0].imbalance);
+  EXPECT_EQ(2, top[0].numRoutes);
+  EXPECT_EQ(LoadBalancedGroupType::LAG, top[1].type);
+  EXPECT_EQ("lag1", top[1].name);
+  std::vector<std::string> members{"port1", "port2"};
+  EXPECT_EQ(members, top[1].members);
+  std::vector<int64_t> bytes{30 * kMB, 10 * kMB};
+  EXPECT_EQ(bytes, top[1].memberBytes);
+  EXPECT_DOUBLE_EQ(1.5, top[1].imbalance);
+  EXPECT_EQ(1, monitor.getTopImbalanced(1).size());
+
+  // Only the change over the interval counts, and groups that carried too
+  // little are left out
+  monitor.update(
+      state,
+      makeCounters({{1, 35 * kMB}, {2, 15 * kMB}, {11, 2 * kMB}}),
+      start + seconds(20));
+  top = monitor.getTopImbalanced(10);
+  ASSERT_EQ(1, top.size());
+  EXPECT_EQ(LoadBalancedGroupType::LAG, top[0].type);
+  EXPECT_DOUBLE_EQ(1, top[0].imbalance);
+
+  // Reset counters leave a group out until the next interval
+  monitor.update(
+      state,
+      makeCounters({{1, 0}, {2, 30 * kMB}, {11, 12 * kMB}}),
+      start + seconds(30));
+  EXPECT_TRUE(monitor.getTopImbalanced(10).empty());
+}
+
+TEST(LoadImbalanceMonitorTest, RemovedLagCleared) {
+  gflags::FlagSaver saver;
+  FLAGS_load_imbalance_interval_s = 10;
+  const std::string counter = "load_imbalance.lag.lag1.pct";
+
+  auto state = addLag(testStateA());
+  LoadImbalanceMonitor monitor;
+  std::chrono::steady_clock::time_point start;
+  monitor.update(state, makeCounters({{1, 0}, {2, 0}}), start);
+  EXPECT_EQ(1, fbData->getCounters().count(counter));
+
+  // Once the aggregate port is gone, so is its counter
+  monitor.update(
+      testStateA(), makeCounters({{1, 0}, {2, 0}}), start + seconds(10));
+  EXPECT_EQ(0, fbData->getCounters().count(counter));
+}
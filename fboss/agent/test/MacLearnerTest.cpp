@@ -0,0 +1,151 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "fboss/agent/MacLearner.h"
+
+#include "fboss/agent/state/MacEntry.h"
+#include "fboss/agent/state/MacTable.h"
+#include "fboss/agent/state/SwitchState.h"
+#include "fboss/agent/state/Vlan.h"
+#include "fboss/agent/state/VlanMap.h"
+
+#include <folly/synchronization/Baton.h>
+#include <gtest/gtest.h>
+
+#include <chrono>
+
+using namespace facebook::fboss;
+using folly::MacAddress;
+using std::make_shared;
+using std::shared_ptr;
+
+namespace {
+
+const MacAddress kMac1("02:00:00:00:00:01");
+const MacAddress kMac2("02:00:00:00:00:02");
+
+L2LearningUpdate learn(VlanID vlan, MacAddress mac, PortDescriptor port) {
+  return L2LearningUpdate(L2LearningUpdate::Type::LEARN, vlan, mac, port);
+}
+
+L2LearningUpdate age(VlanID vlan, MacAddress mac) {
+  return L2LearningUpdate(
+      L2LearningUpdate::Type::AGE, vlan, mac, PortDescriptor(PortID(0)));
+}
+
+shared_ptr<SwitchState> makeState() {
+  auto state = make_shared<SwitchState>();
+  state->addVlan(make_shared<Vlan>(VlanID(1), "vlan1"));
+  state->publish();
+  return state;
+}
+
+} // unnamed namespace
+
+TEST(MacLearnerTest, ApplyBatch) {
+  auto state0 = makeState();
+
+  // Unknown VLANs are ignored
+  EXPECT_EQ(nullptr, MacLearner::applyBatch(
+      state0, {learn(VlanID(2), kMac1, PortDescriptor(PortID(1)))}));
+
+  auto state1 = MacLearner::applyBatch(state0, {
+      learn(VlanID(1), kMac1, PortDescriptor(PortID(1))),
+      learn(VlanID(1), kMac2, PortDescriptor(AggregatePortID(5)))});
+  ASSERT_NE(nullptr, state1);
+  auto macTable = state1->getVlans()->getVlan(VlanID(1))->getMacTable();
+  EXPECT_EQ(2, macTable->size());
+  EXPECT_EQ(PortDescriptor(PortID(1)), macTable->getMac(kMac1)->getPort());
+  EXPECT_EQ(
+      PortDescriptor(AggregatePortID(5)), macTable->getMac(kMac2)->getPort());
+  EXPECT_EQ(
+      0, state0->getVlans()->getVlan(VlanID(1))->getMacTable()->size());
+  state1->publish();
+
+  // Relearning a MAC on the same port changes nothing
+  EXPECT_EQ(nullptr, MacLearner::applyBatch(
+      state1, {learn(VlanID(1), kMac1, PortDescriptor(PortID(1)))}));
+
+  // A station move and an age out
+  auto state2 = MacLearner::applyBatch(state1, {
+      learn(VlanID(1), kMac1, PortDescriptor(PortID(2))),
+      age(VlanID(1), kMac2),
+      age(VlanID(1), MacAddress("02:00:00:00:00:03"))});
+  ASSERT_NE(nullptr, state2);
+  macTable = state2->getVlans()->getVlan(VlanID(1))->getMacTable();
+  EXPECT_EQ(1, macTable->size());
+  EXPECT_EQ(PortDescriptor(PortID(2)), macTable->getMac(kMac1)->getPort());
+  EXPECT_EQ(nullptr, macTable->getMacIf(kMac2));
+
+  // The MAC tables are kept across warm boots
+  auto vlan = state2->getVlans()->getVlan(VlanID(1));
+  auto restored = Vlan::fromFollyDynamic(vlan->toFollyDynamic());
+  EXPECT_EQ(1, restored->getMacTable()->size());
+  EXPECT_EQ(
+      PortDescriptor(PortID(2)),
+      restored->getMacTable()->getMac(kMac1)->getPort());
+}
+
+TEST(MacLearnerTest, Batches) {
+  gflags::FlagSaver saver;
+  FLAGS_mac_learning_queue_size = 3;
+  FLAGS_mac_learning_batch_ms = 200;
+  FLAGS_max_mac_learns_per_sec = 0;
+
+  folly::Baton<> applied;
+  MacLearner::Batch batch;
+  MacLearner learner([&](MacLearner::Batch b) {
+    batch = std::move(b);
+    applied.post();
+  });
+
+  // The updates queued together are applied together, keeping only the
+  // latest of each MAC
+  EXPECT_EQ(
+      MacLearner::EnqueueResult::QUEUED,
+      learner.enqueue(learn(VlanID(1), kMac1, PortDescriptor(PortID(1)))));
+  EXPECT_EQ(
+      MacLearner::EnqueueResult::QUEUED,
+      learner.enqueue(learn(VlanID(1), kMac2, PortDescriptor(PortID(1)))));
+  EXPECT_EQ(
+      MacLearner::EnqueueResult::QUEUED,
+      learner.enqueue(learn(VlanID(1), kMac1, PortDescriptor(PortID(2)))));
+  EXPECT_EQ(
+      MacLearner::EnqueueResult::QUEUE_FULL,
+      learner.enqueue(age(VlanID(1), kMac2)));
+  ASSERT_TRUE(applied.timed_wait(std::chrono::seconds(5)));
+
+  ASSERT_EQ(2, batch.size());
+  EXPECT_EQ(kMac1, batch[0].mac);
+  EXPECT_EQ(PortDescriptor(PortID(2)), batch[0].port);
+  EXPECT_EQ(kMac2, batch[1].mac);
+  EXPECT_EQ(L2LearningUpdate::Type::LEARN, batch[1].type);
+  learner.stop();
+}
+
+TEST(MacLearnerTest, RateLimit) {
+  gflags::FlagSaver saver;
+  FLAGS_mac_learning_batch_ms = 10;
+  FLAGS_max_mac_learns_per_sec = 2;
+
+  MacLearner learner([](MacLearner::Batch) {});
+  EXPECT_EQ(
+      MacLearner::EnqueueResult::QUEUED,
+      learner.enqueue(learn(VlanID(1), kMac1, PortDescriptor(PortID(1)))));
+  EXPECT_EQ(
+      MacLearner::EnqueueResult::QUEUED,
+      learner.enqueue(learn(VlanID(1), kMac2, PortDescriptor(PortID(1)))));
+  EXPECT_EQ(
+      MacLearner::EnqueueResult::RATE_LIMITED,
+      learner.enqueue(learn(VlanID(2), kMac1, PortDescriptor(PortID(1)))));
+  // Ageing isn't limited
+  EXPECT_EQ(
+      MacLearner::EnqueueResult::QUEUED,
+      learner.enqueue(age(VlanID(1), kMac1)));
+}
@@ -0,0 +1,216 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include <chrono>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+
+#include <boost/container/flat_map.hpp>
+#include <folly/io/Cursor.h>
+#include <folly/io/IOBuf.h>
+#include <folly/io/async/EventBase.h>
+#include <folly/synchronization/Baton.h>
+#include <folly/system/ThreadName.h>
+#include <gtest/gtest.h>
+
+#include "fboss/agent/BfdTypes.h"
+#include "fboss/agent/MicroBfdSession.h"
+#include "fboss/agent/types.h"
+
+using namespace facebook::fboss;
+using std::chrono::milliseconds;
+
+namespace {
+
+const PortID kPortA(1);
+const PortID kPortB(2);
+const milliseconds kInterval(10);
+const uint8_t kDetectMult = 3;
+const milliseconds kWait(5000);
+
+/*
+ * Connects the sessions of kPortA and kPortB to each other, delivering each
+ * packet from the next iteration of the loop, as the network would.
+ */
+class MicroBfdWire : public MicroBfdServicerIf {
+ public:
+  explicit MicroBfdWire(folly::EventBase* evb) : evb_(evb) {}
+
+  void transmit(PortID portID, const BfdControlPacket& pkt) override {
+    if (cut_) {
+      return;
+    }
+    auto peer = portID == kPortA ? kPortB : kPortA;
+    evb_->runInLoop([this, peer, pkt]() {
+      auto it = sessions_.find(peer);
+      if (it != sessions_.end()) {
+        it->second->received(pkt);
+      }
+    });
+  }
+
+  void sessionUp(PortID portID) override {
+    up_[portID].post();
+  }
+
+  void sessionDown(
+      PortID portID,
+      BfdControlPacket::Diag diag,
+      milliseconds silence) override {
+    diag_[portID] = diag;
+    silence_[portID] = silence;
+    down_[portID].post();
+  }
+
+  // Only on the EventBase
+  boost::container::flat_map<PortID, MicroBfdSession*> sessions_;
+  bool cut_{false};
+
+  // Set up before the sessions start, and only read once posted
+  std::map<PortID, folly::Baton<>> up_;
+  std::map<PortID, folly::Baton<>> down_;
+  boost::container::flat_map<PortID, BfdControlPacket::Diag> diag_;
+  boost::container::flat_map<PortID, milliseconds> silence_;
+
+ private:
+  folly::EventBase* evb_;
+};
+
+class MicroBfdTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    thread_ = std::thread([this] {
+      folly::setThreadName("testMicroBfdThread");
+      evb_.loopForever();
+    });
+    evb_.waitUntilRunning();
+
+    wire_ = std::make_unique<MicroBfdWire>(&evb_);
+    for (auto port : {kPortA, kPortB}) {
+      wire_->up_[port];
+      wire_->down_[port];
+    }
+    evb_.runInEventBaseThreadAndWait([this]() {
+      a_ = std::make_unique<MicroBfdSession>(
+          kPortA, &evb_, wire_.get(), 1, kInterval, kDetectMult);
+      b_ = std::make_unique<MicroBfdSession>(
+          kPortB, &evb_, wire_.get(), 2, kInterval, kDetectMult);
+      wire_->sessions_[kPortA] = a_.get();
+      wire_->sessions_[kPortB] = b_.get();
+      a_->start();
+      b_->start();
+    });
+  }
+
+  void TearDown() override {
+    evb_.runInEventBaseThreadAndWait([this]() {
+      wire_->sessions_.clear();
+      a_.reset();
+      b_.reset();
+    });
+    evb_.terminateLoopSoon();
+    thread_.join();
+  }
+
+  void waitUntilUp() {
+    ASSERT_TRUE(wire_->up_[kPortA].try_wait_for(kWait));
+    ASSERT_TRUE(wire_->up_[kPortB].try_wait_for(kWait));
+  }
+
+  BfdControlPacket::State state(const std::unique_ptr<MicroBfdSession>& s) {
+    BfdControlPacket::State state;
+    evb_.runInEventBaseThreadAndWait([&]() { state = s->state(); });
+    return state;
+  }
+
+  // Outlives the EventBase, which runs the deliveries still queued as it
+  // goes away
+  std::unique_ptr<MicroBfdWire> wire_;
+  folly::EventBase evb_;
+  std::thread thread_;
+  std::unique_ptr<MicroBfdSession> a_;
+  std::unique_ptr<MicroBfdSession> b_;
+};
+
+} // unnamed namespace
+
+TEST_F(MicroBfdTest, sessionsComeUp) {
+  waitUntilUp();
+
+  EXPECT_EQ(BfdControlPacket::State::UP, state(a_));
+  EXPECT_EQ(BfdControlPacket::State::UP, state(b_));
+}
+
+TEST_F(MicroBfdTest, silentPeerDetected) {
+  waitUntilUp();
+
+  evb_.runInEventBaseThreadAndWait([this]() { wire_->cut_ = true; });
+
+  for (auto port : {kPortA, kPortB}) {
+    ASSERT_TRUE(wire_->down_[port].try_wait_for(kWait));
+    EXPECT_EQ(
+        BfdControlPacket::Diag::DETECTION_TIME_EXPIRED, wire_->diag_[port]);
+    // Nothing heard for the detection time, and not much longer
+    EXPECT_GE(wire_->silence_[port], kDetectMult * kInterval - kInterval);
+    EXPECT_LT(wire_->silence_[port], milliseconds(1000));
+  }
+  EXPECT_EQ(BfdControlPacket::State::DOWN, state(a_));
+  EXPECT_EQ(BfdControlPacket::State::DOWN, state(b_));
+}
+
+TEST_F(MicroBfdTest, stopTellsPeer) {
+  waitUntilUp();
+
+  evb_.runInEventBaseThreadAndWait([this]() { a_->stop(); });
+
+  ASSERT_TRUE(wire_->down_[kPortB].try_wait_for(kWait));
+  EXPECT_EQ(BfdControlPacket::Diag::NEIGHBOR_DOWN, wire_->diag_[kPortB]);
+  EXPECT_EQ(BfdControlPacket::State::ADMIN_DOWN, state(a_));
+}
+
+TEST(BfdControlPacketTest, toFrom) {
+  BfdControlPacket pkt;
+  pkt.diag = BfdControlPacket::Diag::NEIGHBOR_DOWN;
+  pkt.state = BfdControlPacket::State::UP;
+  pkt.flags = BfdControlPacket::POLL;
+  pkt.detectMult = 3;
+  pkt.myDiscriminator = 0xdeadbeef;
+  pkt.yourDiscriminator = 7;
+  pkt.desiredMinTxInterval = std::chrono::microseconds(50000);
+  pkt.requiredMinRxInterval = std::chrono::microseconds(20000);
+
+  auto buf = folly::IOBuf::create(BfdControlPacket::LENGTH);
+  buf->append(BfdControlPacket::LENGTH);
+  folly::io::RWPrivateCursor writer(buf.get());
+  pkt.to(&writer);
+
+  folly::io::Cursor reader(buf.get());
+  auto parsed = BfdControlPacket::from(&reader);
+  EXPECT_TRUE(parsed.isValid());
+  EXPECT_EQ(BfdControlPacket::kVersion, parsed.version);
+  EXPECT_EQ(pkt.diag, parsed.diag);
+  EXPECT_EQ(pkt.state, parsed.state);
+  EXPECT_TRUE(parsed.hasFlag(BfdControlPacket::POLL));
+  EXPECT_FALSE(parsed.hasFlag(BfdControlPacket::FINAL));
+  EXPECT_EQ(pkt.detectMult, parsed.detectMult);
+  EXPECT_EQ(pkt.myDiscriminator, parsed.myDiscriminator);
+  EXPECT_EQ(pkt.yourDiscriminator, parsed.yourDiscriminator);
+  EXPECT_EQ(pkt.desiredMinTxInterval, parsed.desiredMinTxInterval);
+  EXPECT_EQ(pkt.requiredMinRxInterval, parsed.requiredMinRxInterval);
+  EXPECT_EQ(0, parsed.requiredMinEchoRxInterval.count());
+}
+
+TEST(BfdControlPacketTest, truncated) {
+  auto buf = folly::IOBuf::create(BfdControlPacket::LENGTH - 1);
+  buf->append(BfdControlPacket::LENGTH - 1);
+  folly::io::Cursor reader(buf.get());
+  EXPECT_THROW(BfdControlPacket::from(&reader), std::out_of_range);
+}
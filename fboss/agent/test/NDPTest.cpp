@@ -379,14 +379,9 @@ void sendNeighborAdvertisement(HwTestHandle* handle, StringPiece ipStr,
   handle->rxPacket(std::move(buf), PortID(port), vlan);
 }
 
-} // unnamed namespace
-
-TEST(NdpTest, UnsolicitedRequest) {
-  auto handle = setupTestHandle();
-  auto sw = handle->getSw();
-
+IOBuf createUnsolicitedRequest() {
   // Create an neighbor solicitation request
-  auto pkt = PktUtil::parseHexData(
+  return PktUtil::parseHexData(
       // dst mac, src mac
       "33 33 ff 00 00 0a  02 05 73 f9 46 fc"
       // 802.1q, VLAN 5
@@ -413,6 +408,44 @@ TEST(NdpTest, UnsolicitedRequest) {
       "00 00 00 00"
       // target address (2401:db00:2110:3004::a)
       "24 01 db 00 21 10 30 04 00 00 00 00 00 00 00 0a");
+}
+
+IOBuf createRouterSolicitation() {
+  // Create a router solicitation from 2401:db00:2110:1234::1:0
+  return PktUtil::parseHexData(
+      // dst mac, src mac
+      "33 33 00 00 00 02  02 05 73 f9 46 fc"
+      // 802.1q, VLAN 5
+      "81 00 00 05"
+      // IPv6
+      "86 dd"
+      // Version 6, traffic class, flow label
+      "6e 00 00 00"
+      // Payload length: 8
+      "00 08"
+      // Next Header: 58 (ICMPv6), Hop Limit (255)
+      "3a ff"
+      // src addr (2401:db00:2110:1234::1:0)
+      "24 01 db 00 21 10 12 34 00 00 00 00 00 01 00 00"
+      // dst addr (ff02::2)
+      "ff 02 00 00 00 00 00 00 00 00 00 00 00 00 00 02"
+      // type: router solicitation
+      "85"
+      // code
+      "00"
+      // checksum
+      "49 71"
+      // reserved
+      "00 00 00 00");
+}
+
+} // unnamed namespace
+
+TEST(NdpTest, UnsolicitedRequest) {
+  auto handle = setupTestHandle();
+  auto sw = handle->getSw();
+
+  auto pkt = createUnsolicitedRequest();
 
   // Cache the current stats
   CounterCache counters(sw);
@@ -434,6 +467,37 @@ TEST(NdpTest, UnsolicitedRequest) {
   counters.checkDelta(SwitchStats::kCounterPrefix + "trapped.ndp.sum", 1);
 }
 
+TEST(NdpTest, ResponseTableChange) {
+  auto handle = setupTestHandle();
+  auto sw = handle->getSw();
+
+  // Answer for 2401:db00:2110:3004::a with another MAC
+  MacAddress newMac("02:01:02:03:04:06");
+  auto updateFn = [=](const shared_ptr<SwitchState>& state) {
+    shared_ptr<SwitchState> newState{state};
+    auto* vlan = newState->getVlans()->getVlan(VlanID(5)).get();
+    vlan = vlan->modify(&newState);
+    auto respTable = vlan->getNdpResponseTable()->clone();
+    respTable->setEntry(IPAddressV6("2401:db00:2110:3004::a"), newMac,
+                        InterfaceID(1234));
+    vlan->setNdpResponseTable(respTable);
+    return newState;
+  };
+  sw->updateStateBlocking("change NDP response table", updateFn);
+  waitForStateUpdates(sw);
+
+  // The advertisement should be from the new MAC
+  EXPECT_PKT(sw, "neighbor advertisement",
+             checkNeighborAdvert(newMac,
+                                 IPAddressV6("2401:db00:2110:3004::a"),
+                                 MacAddress("02:05:73:f9:46:fc"),
+                                 IPAddressV6("ff01::1"),
+                                 VlanID(5), 0xa0));
+
+  handle->rxPacket(make_unique<IOBuf>(createUnsolicitedRequest()),
+                   PortID(1), VlanID(5));
+}
+
 TEST(NdpTest, TriggerSolicitation) {
   auto handle = setupTestHandle();
   auto sw = handle->getSw();
@@ -571,32 +635,7 @@ TEST(NdpTest, RouterAdvertisement) {
                                VlanID(5), intfConfig->getNdpConfig(),
                                9000, expectedPrefixes));
 
-  auto pkt = PktUtil::parseHexData(
-    // dst mac, src mac
-    "33 33 00 00 00 02  02 05 73 f9 46 fc"
-    // 802.1q, VLAN 5
-    "81 00 00 05"
-    // IPv6
-    "86 dd"
-    // Version 6, traffic class, flow label
-    "6e 00 00 00"
-    // Payload length: 8
-    "00 08"
-    // Next Header: 58 (ICMPv6), Hop Limit (255)
-    "3a ff"
-    // src addr (2401:db00:2110:1234::1:0)
-    "24 01 db 00 21 10 12 34 00 00 00 00 00 01 00 00"
-    // dst addr (ff02::2)
-    "ff 02 00 00 00 00 00 00 00 00 00 00 00 00 00 02"
-    // type: router solicitation
-    "85"
-    // code
-    "00"
-    // checksum
-    "49 71"
-    // reserved
-    "00 00 00 00"
-  );
+  auto pkt = createRouterSolicitation();
   handle->rxPacket(make_unique<IOBuf>(pkt), PortID(1), VlanID(5));
 
 
@@ -667,6 +706,54 @@ TEST(NdpTest, RouterAdvertisement) {
                                9000, expectedPrefixes));
 }
 
+TEST(NdpTest, RouterAdvertisementChange) {
+  // Long enough that only the solicited and final advertisements are sent
+  auto handle = setupTestHandle(seconds(1000), seconds(0));
+  auto sw = handle->getSw();
+
+  // Add another prefix to the interface
+  auto updateFn = [](const shared_ptr<SwitchState>& state) {
+    auto newState = state->clone();
+    auto intfs = newState->getInterfaces()->clone();
+    auto intf = intfs->getInterface(InterfaceID(1234))->clone();
+    auto addrs = intf->getAddresses();
+    addrs.emplace(IPAddress("2401:db00:2110:3005::a"), 64);
+    intf->setAddresses(addrs);
+    intfs->updateNode(intf);
+    newState->resetIntfs(intfs);
+    return newState;
+  };
+  sw->updateStateBlocking("add interface prefix", updateFn);
+  waitForStateUpdates(sw);
+
+  // Solicitations are answered with the new prefix
+  auto intfConfig =
+      sw->getState()->getInterfaces()->getInterface(InterfaceID(1234));
+  PrefixVector expectedPrefixes{
+    { IPAddressV6("2401:db00:2110:3004::"), 64 },
+    { IPAddressV6("2401:db00:2110:3005::"), 64 },
+    { IPAddressV6("fe80::"), 64 },
+  };
+  EXPECT_PKT(sw, "router advertisement",
+             checkRouterAdvert(kPlatformMac,
+                               IPAddressV6("fe80::1:02ff:fe03:0405"),
+                               MacAddress("02:05:73:f9:46:fc"),
+                               IPAddressV6("2401:db00:2110:1234::1:0"),
+                               VlanID(5), intfConfig->getNdpConfig(),
+                               9000, expectedPrefixes));
+  handle->rxPacket(make_unique<IOBuf>(createRouterSolicitation()),
+                   PortID(1), VlanID(5));
+
+  // ... as is the last advertisement, sent before shutdown
+  EXPECT_PKT(sw, "router advertisement",
+             checkRouterAdvert(kPlatformMac,
+                               IPAddressV6("fe80::1:02ff:fe03:0405"),
+                               MacAddress("33:33:00:00:00:01"),
+                               IPAddressV6("ff02::1"),
+                               VlanID(5), intfConfig->getNdpConfig(),
+                               9000, expectedPrefixes));
+}
+
 TEST(NdpTest, FlushEntry) {
   auto handle = setupTestHandle();
   auto sw = handle->getSw();
@@ -0,0 +1,217 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include <boost/cast.hpp>
+
+#include <folly/Benchmark.h>
+#include <folly/Memory.h>
+#include "fboss/agent/PacketRxPool.h"
+#include "fboss/agent/SwSwitch.h"
+#include "fboss/agent/TunManager.h"
+#include "fboss/agent/hw/mock/MockRxPacket.h"
+#include "fboss/agent/hw/sim/SimPlatform.h"
+#include "fboss/agent/hw/sim/SimSwitch.h"
+#include "fboss/agent/state/Interface.h"
+#include "fboss/agent/state/NdpResponseTable.h"
+#include "fboss/agent/state/SwitchState.h"
+#include "fboss/agent/state/Vlan.h"
+#include "fboss/agent/state/VlanMap.h"
+
+using namespace facebook::fboss;
+using folly::IPAddress;
+using folly::IPAddressV6;
+using folly::MacAddress;
+using std::make_unique;
+using std::make_shared;
+using std::shared_ptr;
+using std::unique_ptr;
+
+namespace {
+
+// Global state used by the benchmarks
+unique_ptr<SwSwitch> sw;
+unique_ptr<MockRxPacket> solicitation_3001_1;
+unique_ptr<MockRxPacket> solicitation_3001_5;
+
+unique_ptr<SwSwitch> setupSwitch() {
+  MacAddress localMac("02:00:01:00:00:01");
+  auto sw = make_unique<SwSwitch>(make_unique<SimPlatform>(localMac, 10));
+  sw->init(nullptr /* No custom TunManager */);
+
+  auto updateFn = [&](const shared_ptr<SwitchState>& oldState) {
+    auto state = oldState->clone();
+
+    // Add VLAN 1, and ports 1-9 which belong to it.
+    auto vlan1 = make_shared<Vlan>(VlanID(1), "Vlan1");
+    state->addVlan(vlan1);
+    for (int idx = 1; idx < 10; ++idx) {
+      vlan1->addPort(PortID(idx), false);
+    }
+    // Add Interface 1 to VLAN 1
+    auto intf1 = make_shared<Interface>(
+        InterfaceID(1),
+        RouterID(0),
+        VlanID(1),
+        "interface1",
+        MacAddress("02:00:01:00:00:01"),
+        9000,
+        false, /* is virtual */
+        false  /* is state_sync disabled*/);
+    Interface::Addresses addrs1;
+    addrs1.emplace(IPAddress("2401:db00:2110:3001::1"), 64);
+    addrs1.emplace(IPAddress("fe80::1"), 64);
+    intf1->setAddresses(addrs1);
+    state->addIntf(intf1);
+
+    // Set up an NDP response table for VLAN 1 with entries for
+    // 2401:db00:2110:3001::1 and fe80::1
+    auto respTable1 = make_shared<NdpResponseTable>();
+    respTable1->setEntry(IPAddressV6("2401:db00:2110:3001::1"),
+                         MacAddress("00:02:00:00:00:01"),
+                         InterfaceID(1));
+    respTable1->setEntry(IPAddressV6("fe80::1"),
+                         MacAddress("00:02:00:00:00:01"),
+                         InterfaceID(1));
+    state->getVlans()->getVlan(VlanID(1))->setNdpResponseTable(respTable1);
+    return state;
+  };
+
+  sw->updateStateBlocking("setup", updateFn);
+  return sw;
+}
+
+void init() {
+  // Initialize the switch
+  sw = setupSwitch();
+
+  // Create a neighbor solicitation for 2401:db00:2110:3001::1
+  solicitation_3001_1 = MockRxPacket::fromHex(
+      // dst mac, src mac
+      "33 33 ff 00 00 01  00 02 00 01 02 03"
+      // 802.1q, VLAN 1
+      "81 00  00 01"
+      // IPv6, version 6, traffic class, flow label
+      "86 dd  60 00 00 00"
+      // Payload length: 32, next header: 58 (ICMPv6), hop limit: 255
+      "00 20  3a  ff"
+      // src addr (2401:db00:2110:3001::f)
+      "24 01 db 00 21 10 30 01 00 00 00 00 00 00 00 0f"
+      // dst addr (ff02::1:ff00:1)
+      "ff 02 00 00 00 00 00 00 00 00 00 01 ff 00 00 01"
+      // type: neighbor solicitation, code, checksum
+      "87  00  d7 61"
+      // reserved
+      "00 00 00 00"
+      // target address (2401:db00:2110:3001::1)
+      "24 01 db 00 21 10 30 01 00 00 00 00 00 00 00 01"
+      // source link-layer address option
+      "01 01  00 02 00 01 02 03"
+      );
+  solicitation_3001_1->setSrcPort(PortID(1));
+  solicitation_3001_1->setSrcVlan(VlanID(1));
+
+  // Create a neighbor solicitation for 2401:db00:2110:3001::5
+  solicitation_3001_5 = MockRxPacket::fromHex(
+      // dst mac, src mac
+      "33 33 ff 00 00 05  00 02 00 01 02 03"
+      // 802.1q, VLAN 1
+      "81 00  00 01"
+      // IPv6, version 6, traffic class, flow label
+      "86 dd  60 00 00 00"
+      // Payload length: 32, next header: 58 (ICMPv6), hop limit: 255
+      "00 20  3a  ff"
+      // src addr (2401:db00:2110:3001::f)
+      "24 01 db 00 21 10 30 01 00 00 00 00 00 00 00 0f"
+      // dst addr (ff02::1:ff00:5)
+      "ff 02 00 00 00 00 00 00 00 00 00 01 ff 00 00 05"
+      // type: neighbor solicitation, code, checksum
+      "87  00  d7 59"
+      // reserved
+      "00 00 00 00"
+      // target address (2401:db00:2110:3001::5)
+      "24 01 db 00 21 10 30 01 00 00 00 00 00 00 00 05"
+      // source link-layer address option
+      "01 01  00 02 00 01 02 03"
+      );
+  solicitation_3001_5->setSrcPort(PortID(1));
+  solicitation_3001_5->setSrcVlan(VlanID(1));
+}
+
+} // unnamed namespace
+
+BENCHMARK(NeighborSolicitation, numIters) {
+  BENCHMARK_SUSPEND {
+    SimSwitch* sim = boost::polymorphic_downcast<SimSwitch*>(sw->getHw());
+    sim->resetTxCount();
+  }
+
+  // Send the packet to the switch numIters times
+  for (size_t n = 0; n < numIters; ++n) {
+    sw->packetReceived(solicitation_3001_1->clone());
+  }
+
+  BENCHMARK_SUSPEND {
+    // Make sure the SwSwitch sent out 1 packet for each iteration,
+    // just to verify that it was actually sending neighbor advertisements
+    SimSwitch* sim = boost::polymorphic_downcast<SimSwitch*>(sw->getHw());
+    CHECK_EQ(sim->getTxCount(), numIters);
+  }
+}
+
+BENCHMARK(NeighborSolicitationBurst, numIters) {
+  BENCHMARK_SUSPEND {
+    SimSwitch* sim = boost::polymorphic_downcast<SimSwitch*>(sw->getHw());
+    sim->resetTxCount();
+  }
+
+  // As an RX worker would handle a burst of solicitations, sending the
+  // advertisements in one batch.
+  for (size_t n = 0; n < numIters;) {
+    SwSwitch::TxPacketBatch batch(sw.get());
+    for (size_t i = 0; i < PacketRxPool::kMaxBurst && n < numIters; ++i, ++n) {
+      sw->packetReceived(solicitation_3001_1->clone());
+    }
+  }
+
+  BENCHMARK_SUSPEND {
+    SimSwitch* sim = boost::polymorphic_downcast<SimSwitch*>(sw->getHw());
+    CHECK_EQ(sim->getTxCount(), numIters);
+  }
+}
+
+BENCHMARK(NeighborSolicitationNotMine, numIters) {
+  BENCHMARK_SUSPEND {
+    SimSwitch* sim = boost::polymorphic_downcast<SimSwitch*>(sw->getHw());
+    sim->resetTxCount();
+  }
+
+  // Send the packet to the switch numIters times
+  for (size_t n = 0; n < numIters; ++n) {
+    sw->packetReceived(solicitation_3001_5->clone());
+  }
+
+  BENCHMARK_SUSPEND {
+    // This solicitation wasn't for one of our IPs, so no outgoing packets
+    // should have been generated.
+    SimSwitch* sim = boost::polymorphic_downcast<SimSwitch*>(sw->getHw());
+    CHECK_EQ(sim->getTxCount(), 0);
+  }
+}
+
+int main(int argc, char** argv) {
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+
+  // Setting up the switch is fairly expensive.  Do this once before we run the
+  // benchmark functions so we don't have to do it inside the benchmark
+  // functions.
+  init();
+
+  folly::runBenchmarks();
+  return 0;
+}
@@ -0,0 +1,123 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "fboss/agent/NeighborChangeStream.h"
+
+#include <folly/io/async/EventBase.h>
+#include <gflags/gflags.h>
+#include <gtest/gtest.h>
+
+using namespace facebook::fboss;
+using folly::IPAddress;
+
+namespace {
+
+const IPAddress kIp1("10.0.0.1");
+const IPAddress kIp2("10.0.0.2");
+const IPAddress kIp3("2401:db00::3");
+
+NeighborChangeStream::Changes toChanges(
+    const NeighborChangeStream::Batch& batch) {
+  NeighborChangeStream::Changes changes;
+  NeighborChangeStream::merge(*batch, &changes);
+  return changes;
+}
+
+NeighborChangeStream::Batch makeBatch(
+    int64_t sequence, std::vector<IPAddress> added) {
+  NeighborChangeStream::Changes changes;
+  for (const auto& ip : added) {
+    changes[ip] = true;
+  }
+  return NeighborChangeStream::makeBatch(sequence, changes);
+}
+
+} // unnamed namespace
+
+TEST(NeighborChangeStreamTest, Coalesce) {
+  gflags::FlagSaver saver;
+  FLAGS_neighbor_change_coalesce_ms = 1;
+
+  folly::EventBase evb;
+  std::vector<NeighborChangeStream::Batch> batches;
+  NeighborChangeStream stream(&evb, [&](NeighborChangeStream::Batch batch) {
+    batches.push_back(std::move(batch));
+  });
+
+  stream.neighborsChanged({kIp1, kIp2}, {});
+  stream.neighborsChanged({kIp3}, {kIp1});
+  evb.loop();
+
+  ASSERT_EQ(1, batches.size());
+  EXPECT_EQ(1, batches[0]->sequence);
+  EXPECT_FALSE(batches[0]->resync);
+  NeighborChangeStream::Changes expected{
+      {kIp1, false}, {kIp2, true}, {kIp3, true}};
+  EXPECT_EQ(expected, toChanges(batches[0]));
+  EXPECT_EQ(1, stream.getSequence());
+
+  stream.neighborsChanged({}, {kIp2});
+  evb.loop();
+  ASSERT_EQ(2, batches.size());
+  EXPECT_EQ(2, batches[1]->sequence);
+  EXPECT_EQ(2, stream.getSequence());
+}
+
+TEST(NeighborChangeStreamTest, Backlog) {
+  gflags::FlagSaver saver;
+  FLAGS_max_neighbor_change_batches_in_flight = 1;
+
+  NeighborChangeBacklog backlog;
+  auto first = makeBatch(1, {kIp1});
+  EXPECT_EQ(first, backlog.published(first));
+  EXPECT_EQ(1, backlog.getInFlight());
+
+  // These wait for the first to be acknowledged, and go out together
+  EXPECT_EQ(nullptr, backlog.published(makeBatch(2, {kIp2})));
+  EXPECT_EQ(nullptr, backlog.published(makeBatch(3, {kIp3})));
+  EXPECT_EQ(2, backlog.getLag());
+
+  auto merged = backlog.acked(1);
+  ASSERT_NE(nullptr, merged);
+  EXPECT_EQ(3, merged->sequence);
+  EXPECT_FALSE(merged->resync);
+  NeighborChangeStream::Changes expected{{kIp2, true}, {kIp3, true}};
+  EXPECT_EQ(expected, toChanges(merged));
+
+  EXPECT_EQ(nullptr, backlog.acked(3));
+  EXPECT_EQ(0, backlog.getLag());
+  EXPECT_EQ(0, backlog.getInFlight());
+  EXPECT_EQ(0, backlog.getDropped());
+}
+
+TEST(NeighborChangeStreamTest, Resync) {
+  gflags::FlagSaver saver;
+  FLAGS_max_neighbor_change_batches_in_flight = 1;
+  FLAGS_max_neighbor_change_backlog = 1;
+
+  NeighborChangeBacklog backlog;
+  backlog.published(makeBatch(1, {kIp1}));
+  EXPECT_EQ(nullptr, backlog.published(makeBatch(2, {kIp2, kIp3})));
+  EXPECT_EQ(2, backlog.getDropped());
+  // Already resyncing, so there is no point keeping these
+  EXPECT_EQ(nullptr, backlog.published(makeBatch(3, {kIp1})));
+  EXPECT_EQ(3, backlog.getDropped());
+
+  auto resync = backlog.acked(1);
+  ASSERT_NE(nullptr, resync);
+  EXPECT_EQ(3, resync->sequence);
+  EXPECT_TRUE(resync->resync);
+  EXPECT_TRUE(resync->added.empty());
+  EXPECT_TRUE(resync->removed.empty());
+
+  // Back to streaming once the listener has room again
+  EXPECT_EQ(nullptr, backlog.acked(3));
+  auto next = makeBatch(4, {kIp2});
+  EXPECT_EQ(next, backlog.published(next));
+}
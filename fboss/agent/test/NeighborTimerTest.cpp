@@ -0,0 +1,75 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "fboss/agent/NeighborTimer.h"
+#include "fboss/agent/SwSwitch.h"
+#include "fboss/agent/test/HwTestHandle.h"
+#include "fboss/agent/test/TestUtils.h"
+
+#include <folly/synchronization/Baton.h>
+#include <gtest/gtest.h>
+#include <chrono>
+
+using namespace facebook::fboss;
+using std::chrono::milliseconds;
+
+namespace {
+
+class CountingCallback : public NeighborTimer::Callback {
+ public:
+  explicit CountingCallback(NeighborTimer* timer) : timer_(timer) {}
+
+  void timeoutExpired() noexcept override {
+    timer_->expiring();
+    ++expired;
+    baton.post();
+  }
+  void callbackCanceled() noexcept override {}
+
+  int expired{0};
+  folly::Baton<> baton;
+
+ private:
+  NeighborTimer* timer_;
+};
+
+} // unnamed namespace
+
+TEST(NeighborTimerTest, Jitter) {
+  for (int i = 0; i < 100; ++i) {
+    auto timeout = NeighborTimer::jitter(milliseconds(1000));
+    EXPECT_LE(milliseconds(900), timeout);
+    EXPECT_GE(milliseconds(1000), timeout);
+  }
+  // Too short to spread out
+  EXPECT_EQ(milliseconds(5), NeighborTimer::jitter(milliseconds(5)));
+}
+
+TEST(NeighborTimerTest, Expire) {
+  auto handle = createTestHandle();
+  auto sw = handle->getSw();
+  NeighborTimer timer(sw);
+  CountingCallback first(&timer);
+  CountingCallback second(&timer);
+
+  auto evb = sw->getBackgroundEvb();
+  evb->runInEventBaseThreadAndWait([&]() {
+    timer.scheduleTimeout(&first, milliseconds(20));
+    timer.scheduleTimeout(&second, milliseconds(60 * 1000));
+  });
+  EXPECT_EQ(2, timer.getOccupancy());
+
+  first.baton.wait();
+  waitForBackgroundThread(sw);
+  EXPECT_EQ(1, first.expired);
+  EXPECT_EQ(0, second.expired);
+  EXPECT_EQ(1, timer.getOccupancy());
+
+  evb->runInEventBaseThreadAndWait([&]() { second.cancelTimeout(); });
+}
@@ -0,0 +1,122 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "fboss/agent/NexthopToRouteCount.h"
+#include "fboss/agent/state/RouteTypes.h"
+#include "fboss/agent/state/RouteUpdater.h"
+#include "fboss/agent/state/StateDelta.h"
+#include "fboss/agent/state/SwitchState.h"
+#include "fboss/agent/test/TestUtils.h"
+#include <folly/IPAddress.h>
+
+#include <gtest/gtest.h>
+#include <memory>
+#include <set>
+#include <vector>
+
+using namespace facebook::fboss;
+using folly::IPAddress;
+
+namespace {
+
+const RouterID kRid{0};
+const ClientID kClient{1001};
+
+/*
+ * Collect the routes using any next hop through the neighbor addr on
+ * interface 1
+ */
+NexthopToRouteCount::NexthopRoutes routesVia(
+    const NexthopToRouteCount& index,
+    const std::string& addr) {
+  NexthopToRouteCount::NexthopRoutes routes;
+  index.forEachNexthopVia(
+      kRid,
+      InterfaceID(1),
+      IPAddress(addr),
+      [&](const NextHop& nhop,
+          const NexthopToRouteCount::NexthopRoutes& nhopRoutes) {
+        EXPECT_EQ(nhopRoutes.size(), index.getRouteCount(kRid, nhop));
+        routes.v4.insert(nhopRoutes.v4.begin(), nhopRoutes.v4.end());
+        routes.v6.insert(nhopRoutes.v6.begin(), nhopRoutes.v6.end());
+      });
+  return routes;
+}
+
+} // unnamed namespace
+
+TEST(NexthopToRouteCount, TracksRoutesPerNexthop) {
+  auto emptyState = std::make_shared<SwitchState>();
+  // 10.1.1.0/24 via 10.0.0.22 and 10.0.0.23 on interface 1
+  auto stateA = testStateA();
+  NexthopToRouteCount index;
+  index.stateChanged(StateDelta(emptyState, stateA));
+
+  auto prefixA = makePrefixV4("10.1.1.0/24");
+  EXPECT_EQ(std::set<RoutePrefixV4>{prefixA}, routesVia(index, "10.0.0.22").v4);
+  EXPECT_EQ(std::set<RoutePrefixV4>{prefixA}, routesVia(index, "10.0.0.23").v4);
+  // Interface routes don't go through a next hop
+  EXPECT_EQ(0, routesVia(index, "10.0.0.1").size());
+
+  // Move 10.1.1.0/24 to just 10.0.0.23 and add routes via 10.0.0.22
+  auto prefixB = makePrefixV4("10.2.2.0/24");
+  auto prefixV6 = makePrefixV6("2401:db00:1::/64");
+  RouteUpdater updater(stateA->getRouteTables());
+  updater.addRoute(kRid, IPAddress("10.1.1.0"), 24, kClient,
+      RouteNextHopEntry(makeNextHops({"10.0.0.23"}),
+                        AdminDistance::MAX_ADMIN_DISTANCE));
+  updater.addRoute(kRid, IPAddress("10.2.2.0"), 24, kClient,
+      RouteNextHopEntry(makeNextHops({"10.0.0.22"}),
+                        AdminDistance::MAX_ADMIN_DISTANCE));
+  updater.addRoute(kRid, IPAddress("2401:db00:1::"), 64, kClient,
+      RouteNextHopEntry(makeNextHops({"2401:db00:2110:3001::22"}),
+                        AdminDistance::MAX_ADMIN_DISTANCE));
+  auto stateB = stateA->clone();
+  stateB->resetRouteTables(updater.updateDone());
+  index.stateChanged(StateDelta(stateA, stateB));
+
+  EXPECT_EQ(std::set<RoutePrefixV4>{prefixB}, routesVia(index, "10.0.0.22").v4);
+  EXPECT_EQ(std::set<RoutePrefixV4>{prefixA}, routesVia(index, "10.0.0.23").v4);
+  auto v6Routes = routesVia(index, "2401:db00:2110:3001::22");
+  EXPECT_EQ(0, v6Routes.v4.size());
+  EXPECT_EQ(std::set<RoutePrefixV6>{prefixV6}, v6Routes.v6);
+
+  // Removing all the routes leaves nothing behind
+  index.stateChanged(StateDelta(stateB, emptyState));
+  EXPECT_TRUE(index.begin() == index.end());
+}
+
+TEST(NexthopToRouteCount, ReportsNexthopsChanged) {
+  auto emptyState = std::make_shared<SwitchState>();
+  auto stateA = testStateA();
+  NexthopToRouteCount index;
+  std::vector<NexthopToRouteCount::RouterNexthop> changed;
+  index.stateChanged(StateDelta(emptyState, stateA), &changed);
+
+  std::set<IPAddress> addrs;
+  for (const auto& ridAndNhop : changed) {
+    EXPECT_EQ(kRid, ridAndNhop.first);
+    addrs.insert(ridAndNhop.second.addr());
+  }
+  EXPECT_EQ((std::set<IPAddress>{IPAddress("10.0.0.22"),
+                                 IPAddress("10.0.0.23")}),
+            addrs);
+
+  // Moving 10.1.1.0/24 to just 10.0.0.23 only loses 10.0.0.22
+  RouteUpdater updater(stateA->getRouteTables());
+  updater.addRoute(kRid, IPAddress("10.1.1.0"), 24, kClient,
+      RouteNextHopEntry(makeNextHops({"10.0.0.23"}),
+                        AdminDistance::MAX_ADMIN_DISTANCE));
+  auto stateB = stateA->clone();
+  stateB->resetRouteTables(updater.updateDone());
+  changed.clear();
+  index.stateChanged(StateDelta(stateA, stateB), &changed);
+  ASSERT_EQ(1, changed.size());
+  EXPECT_EQ(IPAddress("10.0.0.22"), changed[0].second.addr());
+}
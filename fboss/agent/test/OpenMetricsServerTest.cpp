@@ -0,0 +1,145 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "fboss/lib/OpenMetricsServer.h"
+
+#include "common/stats/ServiceData.h"
+
+#include <folly/Exception.h>
+#include <folly/FileUtil.h>
+#include <folly/ScopeGuard.h>
+#include <gtest/gtest.h>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using namespace facebook;
+using namespace facebook::fboss;
+
+namespace {
+
+using Labels = std::vector<std::pair<std::string, std::string>>;
+
+std::string httpGet(uint16_t port, const std::string& path) {
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  folly::checkUnixError(fd, "failed to create socket");
+  SCOPE_EXIT {
+    close(fd);
+  };
+  struct sockaddr_in addr = {};
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(port);
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  folly::checkUnixError(
+      connect(fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)),
+      "failed to connect");
+  auto request = "GET " + path + " HTTP/1.1\r\nHost: localhost\r\n\r\n";
+  folly::writeFull(fd, request.data(), request.size());
+
+  std::string response;
+  char buf[4096];
+  ssize_t len;
+  while ((len = folly::readNoInt(fd, buf, sizeof(buf))) > 0) {
+    response.append(buf, len);
+  }
+  return response;
+}
+
+} // unnamed namespace
+
+TEST(OpenMetricsServerTest, Parse) {
+  OpenMetricsRenderer renderer("fboss");
+
+  auto metric = renderer.parse("eth1/1/1.queue2.out_bytes.rate.60");
+  EXPECT_EQ("fboss_port_queue_bytes", metric.family);
+  Labels expected{{"port", "eth1/1/1"}, {"queue", "2"}, {"direction", "out"},
+                  {"export", "rate"}, {"window", "60"}};
+  EXPECT_EQ(expected, metric.labels);
+
+  metric = renderer.parse("port5.in_discards.sum");
+  EXPECT_EQ("fboss_port_discards", metric.family);
+  expected = {{"port", "port5"}, {"direction", "in"}, {"export", "sum"}};
+  EXPECT_EQ(expected, metric.labels);
+
+  metric = renderer.parse("port5.up");
+  EXPECT_EQ("fboss_port_up", metric.family);
+  expected = {{"port", "port5"}};
+  EXPECT_EQ(expected, metric.labels);
+
+  metric = renderer.parse("route_update.us.p95.600");
+  EXPECT_EQ("fboss_route_update_us", metric.family);
+  expected = {{"export", "p95"}, {"window", "600"}};
+  EXPECT_EQ(expected, metric.labels);
+
+  metric = renderer.parse("uptime");
+  EXPECT_EQ("fboss_uptime", metric.family);
+  EXPECT_TRUE(metric.labels.empty());
+}
+
+TEST(OpenMetricsServerTest, Update) {
+  OpenMetricsRenderer renderer("fboss");
+  EXPECT_EQ("# EOF\n", *renderer.getRendered());
+
+  std::map<std::string, int64_t> counters{
+      {"port1.in_bytes.sum", 10},
+      {"port2.in_bytes.sum", 20},
+      {"uptime", 5},
+  };
+  renderer.update(counters);
+  auto rendered = renderer.getRendered();
+  EXPECT_EQ(
+      "# TYPE fboss_port_bytes gauge\n"
+      "fboss_port_bytes{port=\"port1\",direction=\"in\",export=\"sum\"} 10\n"
+      "fboss_port_bytes{port=\"port2\",direction=\"in\",export=\"sum\"} 20\n"
+      "# TYPE fboss_uptime gauge\n"
+      "fboss_uptime 5\n"
+      "# EOF\n",
+      *rendered);
+
+  // Nothing changed, so the same snapshot is kept
+  renderer.update(counters);
+  EXPECT_EQ(rendered, renderer.getRendered());
+
+  // Changed values, and counters that are gone, are picked up
+  counters.erase("port2.in_bytes.sum");
+  counters["uptime"] = 6;
+  renderer.update(counters);
+  EXPECT_EQ(
+      "# TYPE fboss_port_bytes gauge\n"
+      "fboss_port_bytes{port=\"port1\",direction=\"in\",export=\"sum\"} 10\n"
+      "# TYPE fboss_uptime gauge\n"
+      "fboss_uptime 6\n"
+      "# EOF\n",
+      *renderer.getRendered());
+
+  renderer.update({});
+  EXPECT_EQ("# EOF\n", *renderer.getRendered());
+}
+
+TEST(OpenMetricsServerTest, Serve) {
+  fbData->setCounter("open_metrics_test.counter", 42);
+  OpenMetricsServer server("fboss", 0, std::chrono::milliseconds(10));
+  server.start();
+
+  auto response = httpGet(server.getPort(), "/metrics");
+  EXPECT_EQ(0, response.find("HTTP/1.1 200 OK\r\n"));
+  EXPECT_NE(std::string::npos,
+            response.find("Content-Type: application/openmetrics-text"));
+  EXPECT_NE(std::string::npos,
+            response.find("\nfboss_open_metrics_test_counter 42\n"));
+  EXPECT_NE(std::string::npos, response.find("# EOF\n"));
+
+  response = httpGet(server.getPort(), "/other");
+  EXPECT_EQ(0, response.find("HTTP/1.1 404 Not Found\r\n"));
+
+  server.stop();
+  fbData->clearCounter("open_metrics_test.counter");
+}
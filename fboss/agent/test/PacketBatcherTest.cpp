@@ -0,0 +1,109 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "fboss/pcap_distribution_service/PacketBatcher.h"
+
+#include <folly/io/async/EventBase.h>
+#include <gflags/gflags.h>
+#include <gtest/gtest.h>
+
+using namespace facebook::fboss;
+
+namespace {
+
+CapturedPacket makePacket(int16_t ethertype) {
+  TxPacketData data;
+  data.packetData = "packet";
+  CapturedPacket pkt;
+  pkt.rx = false;
+  pkt.pkt.set_txpkt(data);
+  pkt.ethertype = ethertype;
+  return pkt;
+}
+
+} // unnamed namespace
+
+TEST(PacketBatcherTest, Batch) {
+  gflags::FlagSaver saver;
+  FLAGS_pcap_batch_packets = 2;
+  FLAGS_pcap_batch_ms = 1;
+
+  folly::EventBase evb;
+  std::vector<PacketBatch> batches;
+  auto batcher = std::make_shared<PacketBatcher>(
+      &evb, [&](const PacketBatch& batch) {
+        batches.push_back(batch);
+        return folly::makeFuture();
+      });
+
+  for (int16_t idx = 0; idx < 5; ++idx) {
+    batcher->addPacket(makePacket(idx));
+  }
+  evb.loop();
+
+  ASSERT_EQ(3, batches.size());
+  EXPECT_EQ(2, batches[0].packets.size());
+  EXPECT_EQ(2, batches[1].packets.size());
+  // The last one waits for the first two to be acknowledged
+  ASSERT_EQ(1, batches[2].packets.size());
+  EXPECT_EQ(4, batches[2].packets[0].ethertype);
+  EXPECT_EQ(5, batcher->getSent());
+  EXPECT_EQ(0, batcher->getDropped());
+}
+
+TEST(PacketBatcherTest, Drop) {
+  gflags::FlagSaver saver;
+  FLAGS_pcap_batch_packets = 2;
+  FLAGS_pcap_max_batches_in_flight = 1;
+  FLAGS_pcap_max_queued_packets = 3;
+
+  folly::EventBase evb;
+  std::vector<PacketBatch> batches;
+  folly::Promise<folly::Unit> reply;
+  auto batcher = std::make_shared<PacketBatcher>(
+      &evb, [&](const PacketBatch& batch) {
+        batches.push_back(batch);
+        if (batches.size() == 1) {
+          return reply.getFuture();
+        }
+        return folly::makeFuture();
+      });
+
+  // The first batch is held up, while the rest queue behind it
+  batcher->addPacket(makePacket(0));
+  batcher->addPacket(makePacket(1));
+  evb.loopOnce();
+  ASSERT_EQ(1, batches.size());
+  for (int16_t idx = 2; idx < 7; ++idx) {
+    batcher->addPacket(makePacket(idx));
+  }
+  EXPECT_EQ(2, batcher->getDropped());
+
+  reply.setValue();
+  evb.loop();
+  ASSERT_EQ(3, batches.size());
+  EXPECT_EQ(2, batches[1].dropped);
+  EXPECT_EQ(2, batches[1].packets.size());
+  EXPECT_EQ(0, batches[2].dropped);
+  EXPECT_EQ(1, batches[2].packets.size());
+  EXPECT_EQ(5, batcher->getSent());
+}
+
+TEST(PacketBatcherTest, Compress) {
+  PacketBatch batch;
+  for (int16_t idx = 0; idx < 10; ++idx) {
+    batch.packets.push_back(makePacket(idx));
+  }
+  auto expected = batch.packets;
+  PacketBatcher::compress(&batch);
+  if (batch.compressed) {
+    EXPECT_TRUE(batch.packets.empty());
+  }
+  EXPECT_EQ(expected, PacketBatcher::takePackets(&batch));
+}
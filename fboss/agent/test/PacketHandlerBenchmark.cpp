@@ -0,0 +1,452 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include <boost/cast.hpp>
+
+#include <folly/Benchmark.h>
+#include <folly/Format.h>
+#include <folly/Memory.h>
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+#include "fboss/agent/SwSwitch.h"
+#include "fboss/agent/TunManager.h"
+#include "fboss/agent/hw/mock/MockRxPacket.h"
+#include "fboss/agent/hw/sim/SimPlatform.h"
+#include "fboss/agent/hw/sim/SimSwitch.h"
+#include "fboss/agent/state/ArpResponseTable.h"
+#include "fboss/agent/state/Interface.h"
+#include "fboss/agent/state/NdpResponseTable.h"
+#include "fboss/agent/state/SwitchState.h"
+#include "fboss/agent/state/Vlan.h"
+#include "fboss/agent/state/VlanMap.h"
+
+#include <array>
+#include <iostream>
+#include <string>
+#include <vector>
+
+/*
+ * Measures how fast SwSwitch::packetReceived() handles each kind of trapped
+ * packet, with a stream of copies of one packet per benchmark, on a SwSwitch
+ * set up on a SimPlatform.  The iterations per second are the packets per
+ * second.
+ *
+ * After the benchmarks, the heap allocations made on the receiving thread
+ * for each packet are printed for every stream.  Those are counted in
+ * malloc(), so this needs glibc malloc.
+ */
+
+DEFINE_int32(alloc_packets, 10000,
+             "Number of packets of each stream to count the allocations of");
+
+extern "C" {
+
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t num, size_t size);
+void* __libc_realloc(void* ptr, size_t size);
+
+}
+
+namespace {
+
+thread_local uint64_t allocations{0};
+
+} // unnamed namespace
+
+extern "C" {
+
+void* malloc(size_t size) {
+  ++allocations;
+  return __libc_malloc(size);
+}
+
+void* calloc(size_t num, size_t size) {
+  ++allocations;
+  return __libc_calloc(num, size);
+}
+
+void* realloc(void* ptr, size_t size) {
+  ++allocations;
+  return __libc_realloc(ptr, size);
+}
+
+}
+
+using namespace facebook::fboss;
+using folly::IPAddress;
+using folly::IPAddressV4;
+using folly::IPAddressV6;
+using folly::MacAddress;
+using std::make_unique;
+using std::make_shared;
+using std::shared_ptr;
+using std::string;
+using std::unique_ptr;
+
+namespace {
+
+enum Stream : size_t {
+  ARP_REQUEST,
+  ARP_REPLY,
+  NDP_SOLICITATION,
+  NDP_ADVERTISEMENT,
+  IPV4_TTL_EXPIRED,
+  IPV6_HOP_LIMIT_EXPIRED,
+  DHCPV4_REQUEST,
+  DHCPV6_SOLICIT,
+  LLDP_FRAME,
+  LACP_FRAME,
+  NUM_STREAMS,
+};
+
+struct PacketStream {
+  string name;
+  unique_ptr<MockRxPacket> pkt;
+  // The packets sent in reply to each one, or -1 if none are checked
+  int txPerPacket{-1};
+};
+
+// Global state used by the benchmarks
+unique_ptr<SwSwitch> sw;
+std::array<PacketStream, NUM_STREAMS> streams;
+
+const string kL2 =
+    // src mac
+    "00 02 00 01 02 03"
+    // 802.1q, VLAN 1
+    "81 00  00 01";
+
+string zeros(size_t count) {
+  string hex;
+  for (size_t i = 0; i < count; ++i) {
+    hex += "00 ";
+  }
+  return hex;
+}
+
+unique_ptr<SwSwitch> setupSwitch() {
+  MacAddress localMac("02:00:01:00:00:01");
+  auto sw = make_unique<SwSwitch>(make_unique<SimPlatform>(localMac, 10));
+  sw->init(
+      nullptr /* No custom TunManager */,
+      static_cast<SwitchFlags>(
+          SwitchFlags::ENABLE_LLDP | SwitchFlags::ENABLE_LACP));
+
+  auto updateFn = [&](const shared_ptr<SwitchState>& oldState) {
+    auto state = oldState->clone();
+
+    // Add VLAN 1, and ports 1-9 which belong to it.
+    auto vlan1 = make_shared<Vlan>(VlanID(1), "Vlan1");
+    state->addVlan(vlan1);
+    for (int idx = 1; idx < 10; ++idx) {
+      vlan1->addPort(PortID(idx), false);
+    }
+    vlan1->setDhcpV4Relay(IPAddressV4("20.20.20.20"));
+    vlan1->setDhcpV6Relay(IPAddressV6("2401:db00:2110:3002::20"));
+    // Add Interface 1 to VLAN 1
+    auto intf1 = make_shared<Interface>(
+        InterfaceID(1),
+        RouterID(0),
+        VlanID(1),
+        "interface1",
+        localMac,
+        9000,
+        false, /* is virtual */
+        false  /* is state_sync disabled*/);
+    Interface::Addresses addrs1;
+    addrs1.emplace(IPAddress("10.0.0.1"), 24);
+    addrs1.emplace(IPAddress("2401:db00:2110:3001::1"), 64);
+    addrs1.emplace(IPAddress("fe80::1"), 64);
+    intf1->setAddresses(addrs1);
+    state->addIntf(intf1);
+    vlan1->setInterfaceID(InterfaceID(1));
+
+    auto arpTable = make_shared<ArpResponseTable>();
+    arpTable->setEntry(IPAddressV4("10.0.0.1"), localMac, InterfaceID(1));
+    vlan1->setArpResponseTable(arpTable);
+    auto ndpTable = make_shared<NdpResponseTable>();
+    ndpTable->setEntry(
+        IPAddressV6("2401:db00:2110:3001::1"), localMac, InterfaceID(1));
+    ndpTable->setEntry(IPAddressV6("fe80::1"), localMac, InterfaceID(1));
+    vlan1->setNdpResponseTable(ndpTable);
+    return state;
+  };
+
+  sw->updateStateBlocking("setup", updateFn);
+  return sw;
+}
+
+void addStream(Stream stream, string name, const string& hex,
+               int txPerPacket) {
+  auto pkt = MockRxPacket::fromHex(hex);
+  pkt->padToLength(68);
+  pkt->setSrcPort(PortID(1));
+  pkt->setSrcVlan(VlanID(1));
+  streams[stream].name = std::move(name);
+  streams[stream].pkt = std::move(pkt);
+  streams[stream].txPerPacket = txPerPacket;
+}
+
+void init() {
+  // Initialize the switch
+  sw = setupSwitch();
+
+  addStream(ARP_REQUEST, "ArpRequest",
+      // dst mac
+      "ff ff ff ff ff ff" + kL2 +
+      // ARP, htype: ethernet, ptype: IPv4, hlen: 6, plen: 4, request
+      "08 06  00 01  08 00  06  04  00 01"
+      // Sender MAC, sender IP: 10.0.0.15
+      "00 02 00 01 02 03  0a 00 00 0f"
+      // Target MAC, target IP: 10.0.0.1
+      "00 00 00 00 00 00  0a 00 00 01",
+      1);
+
+  addStream(ARP_REPLY, "ArpReply",
+      // dst mac
+      "02 00 01 00 00 01" + kL2 +
+      // ARP, htype: ethernet, ptype: IPv4, hlen: 6, plen: 4, reply
+      "08 06  00 01  08 00  06  04  00 02"
+      // Sender MAC, sender IP: 10.0.0.15
+      "00 02 00 01 02 03  0a 00 00 0f"
+      // Target MAC, target IP: 10.0.0.1
+      "02 00 01 00 00 01  0a 00 00 01",
+      -1);
+
+  addStream(NDP_SOLICITATION, "NdpSolicitation",
+      // dst mac
+      "33 33 ff 00 00 01" + kL2 +
+      // IPv6, payload length: 32, next header: ICMPv6, hop limit: 255
+      "86 dd  60 00 00 00  00 20  3a  ff"
+      // src addr (2401:db00:2110:3001::f)
+      "24 01 db 00 21 10 30 01 00 00 00 00 00 00 00 0f"
+      // dst addr (ff02::1:ff00:1)
+      "ff 02 00 00 00 00 00 00 00 00 00 01 ff 00 00 01"
+      // type: neighbor solicitation, code, checksum, reserved
+      "87  00  d7 61  00 00 00 00"
+      // target address (2401:db00:2110:3001::1)
+      "24 01 db 00 21 10 30 01 00 00 00 00 00 00 00 01"
+      // source link-layer address option
+      "01 01  00 02 00 01 02 03",
+      1);
+
+  addStream(NDP_ADVERTISEMENT, "NdpAdvertisement",
+      // dst mac
+      "02 00 01 00 00 01" + kL2 +
+      // IPv6, payload length: 32, next header: ICMPv6, hop limit: 255
+      "86 dd  60 00 00 00  00 20  3a  ff"
+      // src addr (2401:db00:2110:3001::f)
+      "24 01 db 00 21 10 30 01 00 00 00 00 00 00 00 0f"
+      // dst addr (2401:db00:2110:3001::1)
+      "24 01 db 00 21 10 30 01 00 00 00 00 00 00 00 01"
+      // type: neighbor advertisement, code, checksum, solicited, override
+      "88  00  23 45  60 00 00 00"
+      // target address (2401:db00:2110:3001::f)
+      "24 01 db 00 21 10 30 01 00 00 00 00 00 00 00 0f"
+      // target link-layer address option
+      "02 01  00 02 00 01 02 03",
+      -1);
+
+  addStream(IPV4_TTL_EXPIRED, "IPv4TtlExpired",
+      // dst mac
+      "02 00 01 00 00 01" + kL2 +
+      // IPv4, version(4), IHL(5), total length(28)
+      "08 00  45 00 00 1c  00 00 00 00"
+      // TTL(1), protocol(UDP), checksum (fake)
+      "01 11 12 34"
+      // src IP (10.0.0.15), dst IP (10.1.0.10)
+      "0a 00 00 0f  0a 01 00 0a"
+      // src port (69), dst port (70), length (8), checksum (fake)
+      "00 45 00 46  00 08 12 34",
+      1);
+
+  addStream(IPV6_HOP_LIMIT_EXPIRED, "IPv6HopLimitExpired",
+      // dst mac
+      "02 00 01 00 00 01" + kL2 +
+      // IPv6, payload length: 8, next header: UDP, hop limit: 1
+      "86 dd  60 00 00 00  00 08  11  01"
+      // src addr (2401:db00:2110:3001::f)
+      "24 01 db 00 21 10 30 01 00 00 00 00 00 00 00 0f"
+      // dst addr (2401:db00:2110:3002::a)
+      "24 01 db 00 21 10 30 02 00 00 00 00 00 00 00 0a"
+      // src port (69), dst port (70), length (8), checksum (fake)
+      "00 45 00 46  00 08 12 34",
+      1);
+
+  addStream(DHCPV4_REQUEST, "DHCPv4Request",
+      // dst mac
+      "ff ff ff ff ff ff" + kL2 +
+      // IPv4, version(4), IHL(5), total length(272)
+      "08 00  45 00 01 10  00 00 00 00"
+      // TTL(255), protocol(UDP), checksum (fake)
+      "ff 11 00 00"
+      // src IP (0.0.0.0), dst IP (255.255.255.255)
+      "00 00 00 00  ff ff ff ff"
+      // src port (68), dst port (67), length (252), checksum
+      "00 44 00 43  00 fc 00 00"
+      // op: BOOTREQUEST, htype: ethernet, hlen: 6, hops: 0, xid
+      "01 01 06 00  0a 0a 0a 01"
+      // secs, flags, ciaddr, yiaddr, siaddr, giaddr
+      + zeros(20) +
+      // chaddr
+      "00 02 00 01 02 03" + zeros(10) +
+      // sname, file
+      zeros(192) +
+      // cookie, message type: DHCP discover, end
+      "63 82 53 63  35 01 01  ff",
+      1);
+
+  addStream(DHCPV6_SOLICIT, "DHCPv6Solicit",
+      // dst mac
+      "33 33 00 01 00 02" + kL2 +
+      // IPv6, payload length: 26, next header: UDP, hop limit: 1
+      "86 dd  60 00 00 00  00 1a  11  01"
+      // src addr (fe80::202:ff:fe01:203)
+      "fe 80 00 00 00 00 00 00 02 02 00 ff fe 01 02 03"
+      // dst addr (ff02::1:2)
+      "ff 02 00 00 00 00 00 00 00 00 00 00 00 01 00 02"
+      // src port (546), dst port (547), length (26), checksum
+      "02 22 02 23  00 1a 00 00"
+      // type: solicit, transaction id
+      "01  12 34 56"
+      // client id option, DUID-LL, ethernet
+      "00 01 00 0a  00 03 00 01  00 02 00 01 02 03",
+      1);
+
+  addStream(LLDP_FRAME, "LldpFrame",
+      // dst mac
+      "01 80 c2 00 00 0e" + kL2 +
+      // LLDP, chassis id (MAC address)
+      "88 cc  02 07  04  00 02 00 01 02 03"
+      // port id (interface name "eth1")
+      "04 05  05  65 74 68 31"
+      // TTL (120), end
+      "06 02  00 78  00 00",
+      -1);
+
+  addStream(LACP_FRAME, "LacpFrame",
+      // dst mac
+      "01 80 c2 00 00 02" + kL2 +
+      // Slow protocols, subtype: LACP, version 1
+      "88 09  01  01"
+      // actor: system priority, system, key, port priority, port, state
+      "01 14  00 01  00 02 00 01 02 03  00 01  00 01  00 01  3d" +
+      zeros(3) +
+      // partner
+      "02 14" + zeros(18) + zeros(3) +
+      // collector: max delay
+      "03 10  00 00" + zeros(12) +
+      // terminator
+      "00 00" + zeros(50),
+      -1);
+}
+
+SimSwitch* getSim() {
+  return boost::polymorphic_downcast<SimSwitch*>(sw->getHw());
+}
+
+void receiveStream(Stream stream, size_t numIters) {
+  const auto& pkt = streams[stream].pkt;
+  BENCHMARK_SUSPEND {
+    getSim()->resetTxCount();
+  }
+
+  // Send the packet to the switch numIters times
+  for (size_t n = 0; n < numIters; ++n) {
+    sw->packetReceived(pkt->clone());
+  }
+
+  BENCHMARK_SUSPEND {
+    // Make sure the packets were all handled the way they were meant to be
+    auto txPerPacket = streams[stream].txPerPacket;
+    if (txPerPacket >= 0) {
+      CHECK_EQ(getSim()->getTxCount(), numIters * txPerPacket)
+          << streams[stream].name;
+    }
+  }
+}
+
+/*
+ * The allocations made while handling each packet of the stream, leaving
+ * out copying the packet.
+ */
+double allocationsPerPacket(Stream stream) {
+  std::vector<unique_ptr<RxPacket>> pkts;
+  pkts.reserve(FLAGS_alloc_packets);
+  for (int n = 0; n < FLAGS_alloc_packets; ++n) {
+    pkts.push_back(streams[stream].pkt->clone());
+  }
+  auto before = allocations;
+  for (auto& pkt : pkts) {
+    sw->packetReceived(std::move(pkt));
+  }
+  return static_cast<double>(allocations - before) / FLAGS_alloc_packets;
+}
+
+} // unnamed namespace
+
+BENCHMARK(ArpRequest, numIters) {
+  receiveStream(ARP_REQUEST, numIters);
+}
+
+BENCHMARK(ArpReply, numIters) {
+  receiveStream(ARP_REPLY, numIters);
+}
+
+BENCHMARK(NdpSolicitation, numIters) {
+  receiveStream(NDP_SOLICITATION, numIters);
+}
+
+BENCHMARK(NdpAdvertisement, numIters) {
+  receiveStream(NDP_ADVERTISEMENT, numIters);
+}
+
+BENCHMARK(IPv4TtlExpired, numIters) {
+  receiveStream(IPV4_TTL_EXPIRED, numIters);
+}
+
+BENCHMARK(IPv6HopLimitExpired, numIters) {
+  receiveStream(IPV6_HOP_LIMIT_EXPIRED, numIters);
+}
+
+BENCHMARK(DHCPv4Request, numIters) {
+  receiveStream(DHCPV4_REQUEST, numIters);
+}
+
+BENCHMARK(DHCPv6Solicit, numIters) {
+  receiveStream(DHCPV6_SOLICIT, numIters);
+}
+
+BENCHMARK(LldpFrame, numIters) {
+  receiveStream(LLDP_FRAME, numIters);
+}
+
+BENCHMARK(LacpFrame, numIters) {
+  receiveStream(LACP_FRAME, numIters);
+}
+
+int main(int argc, char** argv) {
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+
+  // Setting up the switch is fairly expensive.  Do this once before we run the
+  // benchmark functions so we don't have to do it inside the benchmark
+  // functions.
+  init();
+
+  folly::runBenchmarks();
+
+  std::cout << folly::sformat("{:<24} {:>16}\n", "stream", "allocs/packet");
+  for (size_t stream = 0; stream < NUM_STREAMS; ++stream) {
+    std::cout << folly::sformat(
+        "{:<24} {:>16.2f}\n",
+        streams[stream].name,
+        allocationsPerPacket(static_cast<Stream>(stream)));
+  }
+  return 0;
+}
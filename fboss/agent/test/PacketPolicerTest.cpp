@@ -0,0 +1,151 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "fboss/agent/PacketPolicer.h"
+#include "fboss/agent/hw/mock/MockRxPacket.h"
+#include "fboss/agent/state/ControlPlane.h"
+#include "fboss/agent/state/StateDelta.h"
+#include "fboss/agent/state/SwitchState.h"
+
+#include <gtest/gtest.h>
+#include <memory>
+
+using namespace facebook::fboss;
+
+namespace {
+
+// Ethernet header up to and including the ethertype
+const std::string kEthHdr =
+    "02 00 00 00 00 01  02 00 00 00 00 02 ";
+
+std::unique_ptr<MockRxPacket> makePacket(const std::string& hex,
+                                         PortID port = PortID(1)) {
+  auto pkt = MockRxPacket::fromHex(kEthHdr + hex);
+  pkt->padToLength(64);
+  pkt->setSrcPort(port);
+  return pkt;
+}
+
+std::unique_ptr<MockRxPacket> arpPacket(PortID port = PortID(1)) {
+  return makePacket("08 06  00 01 08 00 06 04 00 01", port);
+}
+
+// An IPv4 header carrying protocol
+std::unique_ptr<MockRxPacket> ipv4Packet(const std::string& protocol) {
+  return makePacket(
+      "08 00  45 00 00 14 00 00 00 00 40 " + protocol +
+      " 00 00 0a 00 00 01 0a 00 00 02");
+}
+
+// A VLAN tagged IPv6 header carrying next header
+std::unique_ptr<MockRxPacket> taggedIPv6Packet(const std::string& nextHeader) {
+  return makePacket(
+      "81 00 00 01 86 dd  60 00 00 00 00 00 " + nextHeader + " ff");
+}
+
+CPUSoftwarePolicer makePolicer(const std::string& name,
+                               uint16_t etherType,
+                               uint32_t burstSize) {
+  CPUSoftwarePolicer policer;
+  policer.name = name;
+  policer.etherType = etherType;
+  // A rate low enough that no tokens are added while the test runs
+  policer.packetsPerSec = 1;
+  policer.burstSize = burstSize;
+  return policer;
+}
+
+} // unnamed namespace
+
+TEST(PacketPolicer, AdmitAllWithoutPolicers) {
+  PacketPolicer policer;
+  for (int i = 0; i < 100; ++i) {
+    EXPECT_TRUE(policer.admit(arpPacket().get()));
+  }
+}
+
+TEST(PacketPolicer, DropOverBurst) {
+  PacketPolicer policer;
+  policer.setPolicers({makePolicer("arp", 0x0806, 3)});
+  int admitted = 0;
+  for (int i = 0; i < 10; ++i) {
+    admitted += policer.admit(arpPacket().get());
+  }
+  EXPECT_EQ(3, admitted);
+  EXPECT_EQ(7, policer.getDropped("arp"));
+  // Other protocols are not policed
+  EXPECT_TRUE(policer.admit(ipv4Packet("06").get()));
+}
+
+TEST(PacketPolicer, MatchProtocolAndPort) {
+  auto icmp = makePolicer("icmp", 0x0800, 1);
+  icmp.ipProtocol = 1;
+  auto icmpv6 = makePolicer("icmpv6", 0x86dd, 1);
+  icmpv6.ipProtocol = 58;
+  auto arpPort5 = makePolicer("arp.port5", 0x0806, 1);
+  arpPort5.port = PortID(5);
+
+  PacketPolicer policer;
+  policer.setPolicers({icmp, icmpv6, arpPort5});
+
+  EXPECT_TRUE(policer.admit(ipv4Packet("01").get()));
+  EXPECT_FALSE(policer.admit(ipv4Packet("01").get()));
+  EXPECT_TRUE(policer.admit(ipv4Packet("11").get()));
+
+  EXPECT_TRUE(policer.admit(taggedIPv6Packet("3a").get()));
+  EXPECT_FALSE(policer.admit(taggedIPv6Packet("3a").get()));
+  EXPECT_TRUE(policer.admit(taggedIPv6Packet("11").get()));
+
+  EXPECT_TRUE(policer.admit(arpPacket(PortID(5)).get()));
+  EXPECT_FALSE(policer.admit(arpPacket(PortID(5)).get()));
+  EXPECT_TRUE(policer.admit(arpPacket(PortID(6)).get()));
+
+  EXPECT_EQ(1, policer.getDropped("icmp"));
+  EXPECT_EQ(1, policer.getDropped("icmpv6"));
+  EXPECT_EQ(1, policer.getDropped("arp.port5"));
+}
+
+TEST(PacketPolicer, UpdateFromState) {
+  PacketPolicer policer;
+  auto oldState = std::make_shared<SwitchState>();
+  auto newState = oldState->clone();
+  auto controlPlane = newState->getControlPlane()->clone();
+  controlPlane->resetSoftwarePolicers({makePolicer("arp", 0x0806, 1)});
+  newState->resetControlPlane(controlPlane);
+
+  policer.stateUpdated(StateDelta(oldState, newState));
+  EXPECT_TRUE(policer.admit(arpPacket().get()));
+  EXPECT_FALSE(policer.admit(arpPacket().get()));
+
+  // Drop counts carry over when the policers change
+  auto newerState = newState->clone();
+  auto newerControlPlane = newState->getControlPlane()->clone();
+  newerControlPlane->resetSoftwarePolicers({makePolicer("arp", 0x0806, 5)});
+  newerState->resetControlPlane(newerControlPlane);
+  policer.stateUpdated(StateDelta(newState, newerState));
+  EXPECT_TRUE(policer.admit(arpPacket().get()));
+  EXPECT_EQ(1, policer.getDropped("arp"));
+
+  // And the policers go away with the config
+  policer.stateUpdated(StateDelta(newerState, oldState));
+  for (int i = 0; i < 10; ++i) {
+    EXPECT_TRUE(policer.admit(arpPacket().get()));
+  }
+}
+
+TEST(PacketPolicer, ReplacePolicers) {
+  PacketPolicer policer;
+  for (uint32_t burstSize = 1; burstSize <= 10; ++burstSize) {
+    policer.setPolicers({makePolicer("arp", 0x0806, burstSize)});
+    EXPECT_TRUE(policer.admit(arpPacket().get()));
+  }
+  // Only the policers in use are kept once no packet is being policed
+  EXPECT_EQ(1, policer.numPolicerSets());
+  EXPECT_EQ(0, policer.getDropped("arp"));
+}
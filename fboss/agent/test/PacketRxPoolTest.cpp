@@ -0,0 +1,290 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "fboss/agent/PacketRxPool.h"
+#include "fboss/agent/hw/mock/MockRxPacket.h"
+#include <folly/io/IOBuf.h>
+#include <folly/synchronization/Baton.h>
+
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+using namespace facebook::fboss;
+
+namespace {
+
+class CosRxPacket : public MockRxPacket {
+ public:
+  CosRxPacket(std::unique_ptr<folly::IOBuf> buf, int cos)
+      : MockRxPacket(std::move(buf)), cos_(cos) {}
+
+  int cosQueue() const override {
+    return cos_;
+  }
+
+ private:
+  int cos_;
+};
+
+// A 64 byte packet whose source MAC ends in neighbor, carrying seq
+std::unique_ptr<RxPacket> makePacket(uint8_t neighbor, uint8_t seq,
+                                     int cos = -1) {
+  auto buf = folly::IOBuf::create(64);
+  buf->append(64);
+  std::fill(buf->writableData(), buf->writableData() + 64, 0);
+  buf->writableData()[11] = neighbor;
+  buf->writableData()[12] = seq;
+  return std::make_unique<CosRxPacket>(std::move(buf), cos);
+}
+
+uint8_t neighborOf(const RxPacket* pkt) {
+  return pkt->buf()->data()[11];
+}
+
+uint8_t seqOf(const RxPacket* pkt) {
+  return pkt->buf()->data()[12];
+}
+
+/*
+ * Records the packets handled, and lets the test block the handler on the
+ * first packet so that the ones after it queue up.
+ */
+class Recorder {
+ public:
+  explicit Recorder(bool blockFirst) : blockFirst_(blockFirst) {}
+
+  void handle(std::unique_ptr<RxPacket> pkt) {
+    if (blockFirst_.exchange(false)) {
+      started.post();
+      release.wait();
+    }
+    std::lock_guard<std::mutex> guard(lock_);
+    handled_.emplace_back(neighborOf(pkt.get()), seqOf(pkt.get()));
+    cv_.notify_all();
+  }
+
+  std::vector<std::pair<uint8_t, uint8_t>> waitFor(size_t numPackets) {
+    std::unique_lock<std::mutex> guard(lock_);
+    cv_.wait(guard, [&] { return handled_.size() >= numPackets; });
+    return handled_;
+  }
+
+  folly::Baton<> started;
+  folly::Baton<> release;
+
+ private:
+  std::atomic<bool> blockFirst_;
+  std::mutex lock_;
+  std::condition_variable cv_;
+  std::vector<std::pair<uint8_t, uint8_t>> handled_;
+};
+
+} // unnamed namespace
+
+TEST(PacketRxPool, PerNeighborOrder) {
+  Recorder recorder(false);
+  PacketRxPool pool(
+      [&](std::unique_ptr<RxPacket> pkt) { recorder.handle(std::move(pkt)); },
+      4, 1024, 0);
+  const uint8_t kNeighbors = 16;
+  const uint8_t kPackets = 50;
+  for (uint8_t seq = 0; seq < kPackets; ++seq) {
+    for (uint8_t neighbor = 0; neighbor < kNeighbors; ++neighbor) {
+      ASSERT_TRUE(pool.enqueue(makePacket(neighbor, seq)));
+    }
+  }
+  auto handled = recorder.waitFor(kNeighbors * kPackets);
+
+  std::map<uint8_t, std::vector<uint8_t>> seqs;
+  for (const auto& entry : handled) {
+    seqs[entry.first].push_back(entry.second);
+  }
+  ASSERT_EQ(kNeighbors, seqs.size());
+  for (const auto& entry : seqs) {
+    EXPECT_EQ(kPackets, entry.second.size());
+    EXPECT_TRUE(std::is_sorted(entry.second.begin(), entry.second.end()));
+  }
+
+  pool.stop();
+  uint64_t processed = 0;
+  for (size_t idx = 0; idx < pool.numWorkers(); ++idx) {
+    processed += pool.getWorkerStats(idx).processed;
+  }
+  EXPECT_EQ(kNeighbors * kPackets, processed);
+}
+
+TEST(PacketRxPool, HigherCosFirst) {
+  Recorder recorder(true);
+  PacketRxPool pool(
+      [&](std::unique_ptr<RxPacket> pkt) { recorder.handle(std::move(pkt)); },
+      1, 16, 0);
+  ASSERT_TRUE(pool.enqueue(makePacket(0, 0)));
+  recorder.started.wait();
+
+  // Queued behind the blocked packet, so handled by priority
+  ASSERT_TRUE(pool.enqueue(makePacket(0, 1, 0)));
+  ASSERT_TRUE(pool.enqueue(makePacket(0, 2, 7)));
+  ASSERT_TRUE(pool.enqueue(makePacket(0, 3, 3)));
+  EXPECT_EQ(3, pool.getWorkerStats(0).queueDepth);
+  recorder.release.post();
+
+  auto handled = recorder.waitFor(4);
+  std::vector<std::pair<uint8_t, uint8_t>> expected{
+      {0, 0}, {0, 2}, {0, 3}, {0, 1}};
+  EXPECT_EQ(expected, handled);
+}
+
+TEST(PacketRxPool, WeightedCos) {
+  Recorder recorder(true);
+  // CoS 0 and 1 take turns, 1 and 2 packets at a time
+  PacketRxPool pool(
+      [&](std::unique_ptr<RxPacket> pkt) { recorder.handle(std::move(pkt)); },
+      1, 16, 0, nullptr, 2);
+  ASSERT_TRUE(pool.enqueue(makePacket(0, 0, 7)));
+  recorder.started.wait();
+
+  for (uint8_t seq = 1; seq <= 6; ++seq) {
+    ASSERT_TRUE(pool.enqueue(makePacket(0, seq, 0)));
+    ASSERT_TRUE(pool.enqueue(makePacket(0, seq + 10, 1)));
+  }
+  // The strict priority queues still go first
+  ASSERT_TRUE(pool.enqueue(makePacket(0, 20, 5)));
+  EXPECT_EQ(6, pool.getCosStats(0).queueDepth);
+  recorder.release.post();
+
+  auto handled = recorder.waitFor(14);
+  std::vector<uint8_t> seqs;
+  for (const auto& entry : handled) {
+    seqs.push_back(entry.second);
+  }
+  std::vector<uint8_t> expected{
+      0, 20, 11, 12, 1, 13, 14, 2, 15, 16, 3, 4, 5, 6};
+  EXPECT_EQ(expected, seqs);
+
+  pool.stop();
+  EXPECT_EQ(6, pool.getCosStats(0).processed);
+  EXPECT_EQ(6, pool.getCosStats(1).processed);
+  EXPECT_EQ(1, pool.getCosStats(5).processed);
+  EXPECT_EQ(0, pool.getCosStats(0).queueDepth);
+}
+
+TEST(PacketRxPool, DropWhenFull) {
+  Recorder recorder(true);
+  PacketRxPool pool(
+      [&](std::unique_ptr<RxPacket> pkt) { recorder.handle(std::move(pkt)); },
+      1, 2, 0);
+  ASSERT_TRUE(pool.enqueue(makePacket(0, 0)));
+  recorder.started.wait();
+
+  EXPECT_TRUE(pool.enqueue(makePacket(0, 1)));
+  EXPECT_TRUE(pool.enqueue(makePacket(0, 2)));
+  EXPECT_FALSE(pool.enqueue(makePacket(0, 3)));
+  // Other CoS queues have room of their own
+  EXPECT_TRUE(pool.enqueue(makePacket(0, 4, 5)));
+  EXPECT_EQ(1, pool.getWorkerStats(0).dropped);
+  EXPECT_EQ(1, pool.getCosStats(0).dropped);
+  EXPECT_EQ(0, pool.getCosStats(5).dropped);
+  recorder.release.post();
+
+  recorder.waitFor(4);
+  pool.stop();
+  EXPECT_EQ(4, pool.getWorkerStats(0).processed);
+  EXPECT_EQ(0, pool.getWorkerStats(0).queueDepth);
+}
+
+TEST(PacketRxPool, IdleWorkersSteal) {
+  Recorder recorder(true);
+  PacketRxPool pool(
+      [&](std::unique_ptr<RxPacket> pkt) { recorder.handle(std::move(pkt)); },
+      2, 64, 4);
+  // All packets are from one neighbor, so go to the same worker.  Block it
+  // on the first one; the other worker takes over the rest.
+  ASSERT_TRUE(pool.enqueue(makePacket(0, 0)));
+  recorder.started.wait();
+  for (uint8_t seq = 1; seq <= 8; ++seq) {
+    ASSERT_TRUE(pool.enqueue(makePacket(0, seq)));
+  }
+  // Everything but the packets below the steal threshold gets stolen
+  recorder.waitFor(5);
+  recorder.release.post();
+  recorder.waitFor(9);
+  pool.stop();
+
+  uint64_t stolen = 0;
+  for (size_t idx = 0; idx < pool.numWorkers(); ++idx) {
+    stolen += pool.getWorkerStats(idx).stolen;
+  }
+  EXPECT_EQ(5, stolen);
+}
+
+TEST(PacketRxPool, Bursts) {
+  Recorder recorder(true);
+  std::atomic<size_t> inBurst{0};
+  std::vector<size_t> bursts;
+  PacketRxPool pool(
+      [&](std::unique_ptr<RxPacket> pkt) {
+        ++inBurst;
+        recorder.handle(std::move(pkt));
+      },
+      1, 64, 0,
+      [&](folly::FunctionRef<void()> burst) {
+        inBurst = 0;
+        burst();
+        if (inBurst > 0) {
+          bursts.push_back(inBurst);
+        }
+      });
+  // Queue up more than a burst behind the blocked packet
+  ASSERT_TRUE(pool.enqueue(makePacket(0, 0)));
+  recorder.started.wait();
+  const uint8_t kPackets = PacketRxPool::kMaxBurst + 8;
+  for (uint8_t seq = 1; seq < kPackets; ++seq) {
+    ASSERT_TRUE(pool.enqueue(makePacket(0, seq)));
+  }
+  recorder.release.post();
+  recorder.waitFor(kPackets);
+  pool.stop();
+
+  std::vector<size_t> expected{PacketRxPool::kMaxBurst, 8};
+  EXPECT_EQ(expected, bursts);
+}
+
+TEST(PacketRxPool, CurrentWorker) {
+  EXPECT_EQ(PacketRxPool::kNoWorker, PacketRxPool::currentWorker());
+
+  Recorder recorder(false);
+  std::mutex lock;
+  std::map<uint8_t, size_t> workerOf;
+  PacketRxPool pool(
+      [&](std::unique_ptr<RxPacket> pkt) {
+        {
+          std::lock_guard<std::mutex> guard(lock);
+          workerOf[neighborOf(pkt.get())] = PacketRxPool::currentWorker();
+        }
+        recorder.handle(std::move(pkt));
+      },
+      4, 64, 0);
+  const uint8_t kNeighbors = 16;
+  for (uint8_t neighbor = 0; neighbor < kNeighbors; ++neighbor) {
+    ASSERT_TRUE(pool.enqueue(makePacket(neighbor, 0)));
+  }
+  recorder.waitFor(kNeighbors);
+  pool.stop();
+
+  ASSERT_EQ(kNeighbors, workerOf.size());
+  for (const auto& entry : workerOf) {
+    EXPECT_LT(entry.second, pool.numWorkers());
+  }
+}
@@ -0,0 +1,130 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "fboss/pcap_distribution_service/PcapCircularBuffer.h"
+
+#include <gtest/gtest.h>
+
+using namespace facebook::fboss;
+
+namespace {
+
+// Packet n is captured at second n, on port n
+PcapPkt makePkt(int n) {
+  static const uint8_t kData[] = {0xde, 0xad, 0xbe, 0xef};
+  return PcapPkt(
+      true, PortID(n), VlanID(1),
+      PcapPkt::TimePoint(std::chrono::seconds(n)),
+      folly::ByteRange(kData, sizeof(kData)), sizeof(kData));
+}
+
+std::vector<int> ports(const PcapCircularBuffer::Packets& pkts) {
+  std::vector<int> result;
+  pkts.forEach([&](const PcapPkt& pkt) {
+    result.push_back(static_cast<int>(pkt.port()));
+  });
+  return result;
+}
+
+std::vector<int> range(int begin, int end) {
+  std::vector<int> result;
+  for (int n = begin; n < end; ++n) {
+    result.push_back(n);
+  }
+  return result;
+}
+
+} // unnamed namespace
+
+TEST(PcapCircularBufferTest, Wraparound) {
+  PcapCircularBuffer buffer(3);
+  for (int n = 0; n < 5; ++n) {
+    buffer.addPkt(makePkt(n));
+  }
+  EXPECT_EQ(3, buffer.size());
+
+  auto pkts = buffer.release();
+  EXPECT_EQ(3, pkts.size());
+  EXPECT_EQ(range(2, 5), ports(pkts));
+  // The buffer starts over, with the same capacity
+  EXPECT_EQ(0, buffer.size());
+  EXPECT_EQ(3, buffer.capacity());
+  buffer.addPkt(makePkt(5));
+  EXPECT_EQ(range(5, 6), ports(buffer.release()));
+}
+
+TEST(PcapCircularBufferTest, OverwriteAcrossSegments) {
+  const int capacity = PcapCircularBuffer::kSegmentSize + 10;
+  const int count = 2 * PcapCircularBuffer::kSegmentSize + 5;
+  PcapCircularBuffer buffer(capacity);
+  for (int n = 0; n < count; ++n) {
+    buffer.addPkt(makePkt(n));
+    EXPECT_EQ(std::min(n + 1, capacity), buffer.size());
+  }
+  EXPECT_EQ(range(count - capacity, count), ports(buffer.release()));
+}
+
+TEST(PcapCircularBufferTest, Resize) {
+  PcapCircularBuffer buffer(10);
+  for (int n = 0; n < 10; ++n) {
+    buffer.addPkt(makePkt(n));
+  }
+  // Shrinking drops the oldest packets
+  buffer.resize(4);
+  EXPECT_EQ(4, buffer.size());
+  // Growing keeps them all, until the packets added wrap around again
+  buffer.resize(6);
+  for (int n = 10; n < 13; ++n) {
+    buffer.addPkt(makePkt(n));
+  }
+  EXPECT_EQ(range(7, 13), ports(buffer.release()));
+
+  buffer.resize(0);
+  buffer.addPkt(makePkt(13));
+  EXPECT_EQ(0, buffer.size());
+  EXPECT_TRUE(buffer.release().empty());
+}
+
+TEST(PcapCircularBufferTest, PacketsSince) {
+  const int capacity = PcapCircularBuffer::kSegmentSize + 10;
+  const int count = 3 * PcapCircularBuffer::kSegmentSize;
+  PcapCircularBuffer buffer(capacity);
+  for (int n = 0; n < count; ++n) {
+    buffer.addPkt(makePkt(n));
+  }
+
+  auto since = [&](int n) {
+    return ports(buffer.getPacketsSince(
+        PcapPkt::TimePoint(std::chrono::seconds(n))));
+  };
+  // Before the oldest packet left, in a partly overwritten segment, and in
+  // the segment still being filled
+  EXPECT_EQ(range(count - capacity, count), since(0));
+  EXPECT_EQ(range(count - capacity + 3, count), since(count - capacity + 3));
+  EXPECT_EQ(range(count - 2, count), since(count - 2));
+  EXPECT_TRUE(since(count).empty());
+  // None of them are taken out of the buffer
+  EXPECT_EQ(capacity, buffer.size());
+}
+
+TEST(PcapCircularBufferTest, PacketsOutliveOverwrite) {
+  const int capacity = 2 * PcapCircularBuffer::kSegmentSize;
+  PcapCircularBuffer buffer(capacity);
+  for (int n = 0; n < capacity; ++n) {
+    buffer.addPkt(makePkt(n));
+  }
+  auto pkts = buffer.getPacketsSince(PcapPkt::TimePoint());
+
+  // Overwrite all of the packets the dump shares
+  for (int n = capacity; n < 3 * capacity; ++n) {
+    buffer.addPkt(makePkt(n));
+  }
+  EXPECT_EQ(range(0, capacity), ports(pkts));
+  EXPECT_EQ(range(2 * capacity, 3 * capacity), ports(buffer.release()));
+}
@@ -0,0 +1,145 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "fboss/agent/PolicerTuner.h"
+
+#include <gtest/gtest.h>
+
+using namespace facebook::fboss;
+using std::chrono::seconds;
+using Clock = PolicerTuner::Clock;
+
+namespace {
+
+CPUSoftwarePolicer makePolicer(
+    const std::string& name,
+    uint32_t packetsPerSec,
+    uint32_t minPacketsPerSec,
+    uint32_t maxPacketsPerSec) {
+  CPUSoftwarePolicer policer;
+  policer.name = name;
+  policer.etherType = 0x0806;
+  policer.packetsPerSec = packetsPerSec;
+  policer.minPacketsPerSec = minPacketsPerSec;
+  policer.maxPacketsPerSec = maxPacketsPerSec;
+  return policer;
+}
+
+PolicerTuner::Telemetry makeTelemetry(
+    uint64_t arpDrops,
+    uint64_t queueDrops = 0,
+    uint64_t queueWaitMaxUs = 0) {
+  PolicerTuner::Telemetry telemetry;
+  telemetry.policerDrops["arp"] = arpDrops;
+  telemetry.queueDrops = queueDrops;
+  telemetry.queueWaitMaxUs = queueWaitMaxUs;
+  return telemetry;
+}
+
+// Tune the policers at the given time, in seconds from start, and apply the
+// adjustments
+std::vector<PolicerTuner::Adjustment> tune(
+    PolicerTuner* tuner,
+    ControlPlane::SoftwarePolicers* policers,
+    const PolicerTuner::Telemetry& telemetry,
+    Clock::time_point start,
+    int at) {
+  auto adjustments = tuner->update(*policers, telemetry, start + seconds(at));
+  *policers = PolicerTuner::applyAdjustments(*policers, adjustments);
+  return adjustments;
+}
+
+} // unnamed namespace
+
+TEST(PolicerTunerTest, Headroom) {
+  gflags::FlagSaver saver;
+  FLAGS_policer_tuning_interval_s = 5;
+  PolicerTuner tuner;
+  Clock::time_point start;
+  ControlPlane::SoftwarePolicers policers{
+      makePolicer("arp", 100, 50, 200), makePolicer("untuned", 100, 100, 100)};
+
+  // The first update only takes the counters
+  EXPECT_TRUE(tune(&tuner, &policers, makeTelemetry(500), start, 0).empty());
+
+  // Nothing is tuned until an interval has passed
+  EXPECT_TRUE(tune(&tuner, &policers, makeTelemetry(600), start, 4).empty());
+
+  // Dropping while the CPU keeps up, as while a rack boots
+  auto adjustments = tune(&tuner, &policers, makeTelemetry(700), start, 5);
+  ASSERT_EQ(1, adjustments.size());
+  EXPECT_EQ("arp", adjustments[0].name);
+  EXPECT_EQ(100, adjustments[0].oldPacketsPerSec);
+  EXPECT_EQ(150, adjustments[0].newPacketsPerSec);
+  EXPECT_EQ(150, policers[0].currentPacketsPerSec());
+  EXPECT_EQ(100, policers[1].currentPacketsPerSec());
+
+  // Up to the maximum
+  tune(&tuner, &policers, makeTelemetry(800), start, 10);
+  EXPECT_EQ(200, policers[0].currentPacketsPerSec());
+  EXPECT_TRUE(tune(&tuner, &policers, makeTelemetry(900), start, 15).empty());
+
+  // Once it stops dropping, it drifts back to the configured rate
+  tune(&tuner, &policers, makeTelemetry(900), start, 20);
+  EXPECT_EQ(150, policers[0].currentPacketsPerSec());
+  for (int at = 25; at < 60; at += 5) {
+    tune(&tuner, &policers, makeTelemetry(900), start, at);
+  }
+  EXPECT_EQ(100, policers[0].currentPacketsPerSec());
+  EXPECT_FALSE(policers[0].tunedPacketsPerSec.hasValue());
+}
+
+TEST(PolicerTunerTest, Backlogged) {
+  gflags::FlagSaver saver;
+  FLAGS_policer_tuning_interval_s = 5;
+  FLAGS_policer_tuning_max_wait_us = 1000;
+  PolicerTuner tuner;
+  Clock::time_point start;
+  ControlPlane::SoftwarePolicers policers{makePolicer("arp", 100, 30, 200)};
+  tune(&tuner, &policers, makeTelemetry(0), start, 0);
+  tune(&tuner, &policers, makeTelemetry(10), start, 5);
+  ASSERT_EQ(150, policers[0].currentPacketsPerSec());
+
+  // A policer that isn't dropping gives up its headroom when packets wait
+  // too long in the queues, even if only for one stats interval
+  tuner.update(policers, makeTelemetry(10, 0, 5000), start + seconds(6));
+  auto adjustments = tune(&tuner, &policers, makeTelemetry(10), start, 10);
+  ASSERT_EQ(1, adjustments.size());
+  EXPECT_EQ(100, policers[0].currentPacketsPerSec());
+
+  // One that is dropping is tightened when the queues drop packets, as in a
+  // traceroute storm, down to the minimum
+  tune(&tuner, &policers, makeTelemetry(20, 5), start, 15);
+  EXPECT_EQ(50, policers[0].currentPacketsPerSec());
+  tune(&tuner, &policers, makeTelemetry(30, 10), start, 20);
+  EXPECT_EQ(30, policers[0].currentPacketsPerSec());
+  EXPECT_TRUE(
+      tune(&tuner, &policers, makeTelemetry(40, 15), start, 25).empty());
+
+  // And recovers once the CPU keeps up
+  tune(&tuner, &policers, makeTelemetry(40, 15), start, 30);
+  EXPECT_EQ(65, policers[0].currentPacketsPerSec());
+}
+
+TEST(PolicerTunerTest, ApplyAdjustments) {
+  ControlPlane::SoftwarePolicers policers{makePolicer("arp", 100, 50, 200)};
+  std::vector<PolicerTuner::Adjustment> adjustments{
+      {"arp", 100, 150, "test"}, {"gone", 100, 150, "test"}};
+  auto tuned = PolicerTuner::applyAdjustments(policers, adjustments);
+  ASSERT_EQ(1, tuned.size());
+  EXPECT_EQ(150, tuned[0].currentPacketsPerSec());
+  EXPECT_EQ(100, tuned[0].packetsPerSec);
+
+  // Adjustments from a rate the policer is no longer at, or out of its
+  // bounds, are left out
+  adjustments = {{"arp", 100, 120, "test"}};
+  EXPECT_EQ(tuned, PolicerTuner::applyAdjustments(tuned, adjustments));
+  adjustments = {{"arp", 150, 300, "test"}};
+  EXPECT_EQ(tuned, PolicerTuner::applyAdjustments(tuned, adjustments));
+}
@@ -0,0 +1,94 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "fboss/agent/PortCounterStore.h"
+
+#include <gtest/gtest.h>
+
+#include <thread>
+#include <vector>
+
+using namespace facebook;
+using namespace facebook::fboss;
+
+namespace {
+
+using TLStats = stats::ThreadCachedServiceData::ThreadLocalStatsMap;
+
+bool exported(const std::string& name) {
+  return fbData->getCounters().count(name) > 0;
+}
+
+} // unnamed namespace
+
+TEST(PortCounterStoreTest, Aggregate) {
+  TLStats stats;
+  PortCounterStore store(&stats);
+  auto row = store.getRow(PortID(1), "pcs_test1");
+  PortCounterStore::add<PortCounter::TRAPPED_PKTS>(row);
+  PortCounterStore::add<PortCounter::TRAPPED_PKTS>(row);
+  PortCounterStore::add<PortCounter::HOST_RX_BYTES>(row, 100);
+  EXPECT_EQ(2u, PortCounterStore::get(row, PortCounter::TRAPPED_PKTS));
+
+  // Nothing is exported until the store is aggregated
+  EXPECT_FALSE(exported("pcs_test1.trapped.pkts.sum"));
+  stats.aggregate();
+  EXPECT_EQ(2, fbData->getCounter("pcs_test1.trapped.pkts.sum"));
+  EXPECT_EQ(100, fbData->getCounter("pcs_test1.host.rx.bytes.sum"));
+  // Counters that never moved aren't exported
+  EXPECT_FALSE(exported("pcs_test1.trapped.drops.sum"));
+
+  // Only what changed since is added
+  PortCounterStore::add<PortCounter::TRAPPED_PKTS>(row);
+  stats.aggregate();
+  EXPECT_EQ(3, fbData->getCounter("pcs_test1.trapped.pkts.sum"));
+
+  // The same row is handed out again
+  EXPECT_EQ(row, store.getRow(PortID(1), "pcs_test1"));
+}
+
+TEST(PortCounterStoreTest, Rename) {
+  TLStats stats;
+  PortCounterStore store(&stats);
+  auto row = store.getRow(PortID(2), "pcs_test2");
+  PortCounterStore::add<PortCounter::LINK_STATE_FLAP>(row);
+  stats.aggregate();
+
+  store.setPortName(PortID(2), "pcs_test2_renamed");
+  PortCounterStore::add<PortCounter::LINK_STATE_FLAP>(row);
+  stats.aggregate();
+  EXPECT_EQ(1, fbData->getCounter("pcs_test2.link_state.flap.sum"));
+  EXPECT_EQ(1, fbData->getCounter("pcs_test2_renamed.link_state.flap.sum"));
+
+  // Ports without a name are counted, but not exported
+  auto unnamed = store.getRow(PortID(3), "");
+  PortCounterStore::add<PortCounter::ARP>(unnamed);
+  stats.aggregate();
+  EXPECT_FALSE(exported(".trapped.arp.sum"));
+}
+
+TEST(PortCounterStoreTest, Threads) {
+  std::vector<std::thread> threads;
+  for (int idx = 0; idx < 4; ++idx) {
+    threads.emplace_back([] {
+      PortCounterStore store(
+          stats::ThreadCachedServiceData::get()->getThreadStats());
+      auto row = store.getRow(PortID(4), "pcs_test4");
+      for (int count = 0; count < 1000; ++count) {
+        PortCounterStore::add<PortCounter::IPV4_RX>(row);
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  // Stores that are gone aggregated what they had left
+  EXPECT_EQ(4000, fbData->getCounter("pcs_test4.trapped.ipv4.sum"));
+}
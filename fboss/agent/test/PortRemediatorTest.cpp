@@ -15,8 +15,13 @@
 #include "fboss/agent/state/SwitchState.h"
 #include "fboss/agent/test/TestUtils.h"
 
+#include <gflags/gflags.h>
 #include <gtest/gtest.h>
 
+DECLARE_int32(port_remediation_delay_ms);
+DECLARE_int32(port_remediation_max_backoff_ms);
+DECLARE_int32(port_remediation_max_concurrent);
+
 namespace facebook { namespace fboss {
 using namespace ::testing;
 
@@ -40,10 +45,15 @@ class PortRemediatorTest : public ::testing::Test {
       port->setOperState(false);
     }
     handle = createTestHandle(state, folly::none);
-    portRemediator = std::make_unique<PortRemediator>(handle->getSw());
+    portRemediator = std::make_unique<PortRemediator>(
+        handle->getSw(), [this](PortID port) { remediated.push_back(port); });
   }
   std::unique_ptr<HwTestHandle> handle;
   std::unique_ptr<PortRemediator> portRemediator;
+  std::vector<PortID> remediated;
+  const std::chrono::steady_clock::time_point start{
+      std::chrono::steady_clock::now()};
+  const std::chrono::milliseconds delay{FLAGS_port_remediation_delay_ms};
 };
 
 TEST_F(PortRemediatorTest, AllEnabledAndUp) {
@@ -64,4 +74,67 @@ TEST_F(PortRemediatorTest, OneDisabledAndDown) {
   EXPECT_EQ(0, unexpected.size());
 }
 
+TEST_F(PortRemediatorTest, Backoff) {
+  setupPorts({}, {PortID(10)});
+  portRemediator->addCandidate(PortID(10), start);
+  portRemediator->remediatePorts(start);
+  EXPECT_TRUE(remediated.empty());
+
+  portRemediator->remediatePorts(start + delay);
+  EXPECT_EQ(std::vector<PortID>{PortID(10)}, remediated);
+  // Still down, so it is tried again, waiting twice as long each time
+  portRemediator->remediatePorts(start + 2 * delay - std::chrono::seconds(1));
+  EXPECT_EQ(1, remediated.size());
+  portRemediator->remediatePorts(start + 2 * delay);
+  EXPECT_EQ(2, remediated.size());
+  portRemediator->remediatePorts(start + 3 * delay);
+  EXPECT_EQ(2, remediated.size());
+  portRemediator->remediatePorts(start + 4 * delay);
+  EXPECT_EQ(3, remediated.size());
+
+  // Going down again keeps the backoff
+  portRemediator->addCandidate(PortID(10), start + 4 * delay);
+  EXPECT_EQ(3, portRemediator->candidates_.at(PortID(10)).attempts);
+}
+
+TEST_F(PortRemediatorTest, ConcurrencyLimit) {
+  std::vector<PortID> down;
+  for (int i = 0; i < FLAGS_port_remediation_max_concurrent + 2; ++i) {
+    down.push_back(PortID(10 + i));
+  }
+  setupPorts({}, down);
+  for (auto port : down) {
+    portRemediator->addCandidate(port, start);
+  }
+  portRemediator->remediatePorts(start + delay);
+  EXPECT_EQ(FLAGS_port_remediation_max_concurrent, remediated.size());
+  // The rest are still due
+  portRemediator->remediatePorts(start + delay);
+  EXPECT_EQ(down.size(), remediated.size());
+}
+
+TEST_F(PortRemediatorTest, UpOrDisabledDropped) {
+  setupPorts({PortID(11)}, {PortID(11)});
+  // A link change heard of after the port came up or was disabled
+  portRemediator->addCandidate(PortID(10), start);
+  portRemediator->addCandidate(PortID(11), start);
+  portRemediator->remediatePorts(start + delay);
+  EXPECT_TRUE(remediated.empty());
+  EXPECT_TRUE(portRemediator->candidates_.empty());
+}
+
+TEST_F(PortRemediatorTest, TransceiverResetsBackoff) {
+  setupPorts({}, {PortID(10)});
+  portRemediator->addCandidate(PortID(10), start);
+  portRemediator->remediatePorts(start + delay);
+  portRemediator->remediatePorts(start + 2 * delay);
+  const auto& candidate = portRemediator->candidates_.at(PortID(10));
+  EXPECT_EQ(4 * delay, candidate.backoff);
+
+  portRemediator->resetCandidate(PortID(10), start + 2 * delay);
+  EXPECT_EQ(0, candidate.attempts);
+  EXPECT_EQ(delay, candidate.backoff);
+  EXPECT_EQ(start + 3 * delay, candidate.due);
+}
+
 }} // facebook::fboss
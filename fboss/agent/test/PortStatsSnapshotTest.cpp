@@ -0,0 +1,75 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "fboss/agent/PortStatsSnapshot.h"
+
+#include "common/stats/ServiceData.h"
+#include "fboss/agent/state/Port.h"
+#include "fboss/agent/state/PortMap.h"
+#include "fboss/agent/state/PortQueue.h"
+
+#include <gtest/gtest.h>
+
+using namespace facebook::fboss;
+using std::make_shared;
+
+namespace {
+
+void addStat(const std::string& name, int64_t value) {
+  fbData->getStatMap()->getLockableStat(name).addValue(
+      facebook::stats::statsNow(), value);
+}
+
+} // unnamed namespace
+
+TEST(PortStatsSnapshotTest, Update) {
+  PortMap ports;
+  auto port1 = make_shared<Port>(PortID(1), "snapshot_test1");
+  port1->resetPortQueues({make_shared<PortQueue>(0)});
+  ports.addPort(port1);
+  // Ports without a name have their stats kept under their ID
+  ports.addPort(make_shared<Port>(PortID(2), ""));
+
+  PortStatsSnapshot snapshot;
+  EXPECT_TRUE(snapshot.get()->empty());
+
+  addStat("snapshot_test1.in_bytes", 100);
+  addStat("snapshot_test1.out_discards", 2);
+  addStat("snapshot_test1.queue0.out_bytes", 40);
+  addStat("port2.in_unicast_pkts", 7);
+  snapshot.update(ports);
+
+  auto stats = snapshot.get();
+  ASSERT_EQ(2, stats->size());
+  const auto& counters1 = stats->at(PortID(1));
+  EXPECT_EQ(100, counters1.input.bytes);
+  EXPECT_EQ(2, counters1.output.errors.discards);
+  ASSERT_EQ(1, counters1.output.unicast.size());
+  EXPECT_EQ(40, counters1.output.unicast[0].outBytes);
+  EXPECT_EQ(0, counters1.output.unicast[0].congestionDiscards);
+  EXPECT_EQ(7, stats->at(PortID(2)).input.ucastPkts);
+
+  // The snapshot already taken is left alone by the next update
+  addStat("snapshot_test1.in_bytes", 50);
+  snapshot.update(ports);
+  EXPECT_EQ(100, stats->at(PortID(1)).input.bytes);
+  EXPECT_EQ(150, snapshot.get()->at(PortID(1)).input.bytes);
+
+  // Renamed ports have their stats looked up again, and removed ones are
+  // dropped
+  PortMap renamed;
+  auto renamedPort = make_shared<Port>(PortID(1), "snapshot_test3");
+  renamed.addPort(renamedPort);
+  addStat("snapshot_test3.in_bytes", 9);
+  snapshot.update(renamed);
+  stats = snapshot.get();
+  ASSERT_EQ(1, stats->size());
+  EXPECT_EQ(9, stats->at(PortID(1)).input.bytes);
+  EXPECT_TRUE(stats->at(PortID(1)).output.unicast.empty());
+}
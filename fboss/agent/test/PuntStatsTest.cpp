@@ -0,0 +1,163 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "fboss/agent/PuntStats.h"
+#include "fboss/agent/hw/mock/MockRxPacket.h"
+#include "fboss/agent/packet/ParsedPacket.h"
+#include <folly/io/IOBuf.h>
+
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+
+using namespace facebook::fboss;
+using std::chrono::seconds;
+using std::chrono::steady_clock;
+using Protocol = PuntStats::Protocol;
+
+namespace {
+
+class CosRxPacket : public MockRxPacket {
+ public:
+  CosRxPacket(std::unique_ptr<folly::IOBuf> buf, int cos)
+      : MockRxPacket(std::move(buf)), cos_(cos) {}
+
+  int cosQueue() const override {
+    return cos_;
+  }
+
+ private:
+  int cos_;
+};
+
+std::unique_ptr<RxPacket> makePacket(uint16_t port, int cos,
+                                     uint32_t length = 64) {
+  auto buf = folly::IOBuf::create(length);
+  buf->append(length);
+  std::fill(buf->writableData(), buf->writableData() + length, 0);
+  auto pkt = std::make_unique<CosRxPacket>(std::move(buf), cos);
+  pkt->setSrcPort(PortID(port));
+  return std::move(pkt);
+}
+
+Protocol protocolOf(const std::string& hex) {
+  auto pkt = MockRxPacket::fromHex(hex);
+  return PuntStats::getProtocol(ParsedPacket::parse(pkt->buf()));
+}
+
+const std::string kL2 =
+    // dst mac, src mac
+    "02 00 01 00 00 01  02 00 02 01 02 03"
+    // 802.1q, VLAN 1
+    "81 00 00 01";
+
+// Version(4), IHL(5), Total Length(28), TTL(64), then the protocol, fake
+// checksum and addresses
+std::string ipv4(const std::string& proto) {
+  return "08 00  45 00 00 1c  00 00 00 00  40 " + proto +
+      " 12 34  0a 00 00 02  0a 00 00 01" + "00 00 00 00 00 00 00 00";
+}
+
+// Payload length(8), then the next header, hop limit(255) and addresses
+std::string ipv6(const std::string& nextHeader) {
+  return "86 dd  60 00 00 00  00 08 " + nextHeader + " ff" +
+      "fe 80 00 00 00 00 00 00 02 02 c9 ff fe bb 5e 0e"
+      "24 01 db 00 21 10 30 01 00 00 00 00 00 00 00 01"
+      "00 00 00 00 00 00 00 00";
+}
+
+} // unnamed namespace
+
+TEST(PuntStatsTest, Protocols) {
+  EXPECT_EQ(Protocol::ARP, protocolOf(kL2 + "08 06  00 01"));
+  EXPECT_EQ(Protocol::LLDP, protocolOf(kL2 + "88 cc  02 07"));
+  EXPECT_EQ(Protocol::LACP, protocolOf(kL2 + "88 09  01 01"));
+  EXPECT_EQ(Protocol::IPV4, protocolOf(kL2 + ipv4("11")));
+  EXPECT_EQ(Protocol::ICMPV4, protocolOf(kL2 + ipv4("01")));
+  EXPECT_EQ(Protocol::IPV6, protocolOf(kL2 + ipv6("11")));
+  EXPECT_EQ(Protocol::ICMPV6, protocolOf(kL2 + ipv6("3a")));
+  EXPECT_EQ(Protocol::OTHER, protocolOf(kL2 + "88 47  00 00"));
+  EXPECT_STREQ("icmpv6", PuntStats::getProtocolName(Protocol::ICMPV6));
+}
+
+TEST(PuntStatsTest, TopTalkers) {
+  PuntStats stats;
+  auto start = steady_clock::now();
+  stats.update(start);
+  EXPECT_TRUE(stats.getTopTalkers(10).empty());
+
+  for (int i = 0; i < 20; ++i) {
+    stats.record(makePacket(5, 7).get(), Protocol::ARP);
+  }
+  for (int i = 0; i < 10; ++i) {
+    stats.record(makePacket(3, 2, 100).get(), Protocol::LACP);
+  }
+  // Counted as CoS 0
+  stats.record(makePacket(1, -1).get(), Protocol::OTHER);
+  stats.update(start + seconds(2));
+
+  auto talkers = stats.getTopTalkers(10);
+  ASSERT_EQ(3, talkers.size());
+  EXPECT_EQ(PortID(5), talkers[0].port);
+  EXPECT_EQ(7, talkers[0].cosQueue);
+  EXPECT_EQ(Protocol::ARP, talkers[0].protocol);
+  EXPECT_EQ(20, talkers[0].packets);
+  EXPECT_EQ(20 * 64, talkers[0].bytes);
+  EXPECT_DOUBLE_EQ(10, talkers[0].packetsPerSec);
+  EXPECT_DOUBLE_EQ(10 * 64, talkers[0].bytesPerSec);
+  EXPECT_EQ(PortID(3), talkers[1].port);
+  EXPECT_EQ(2, talkers[1].cosQueue);
+  EXPECT_DOUBLE_EQ(500, talkers[1].bytesPerSec);
+  EXPECT_EQ(PortID(1), talkers[2].port);
+  EXPECT_EQ(0, talkers[2].cosQueue);
+  EXPECT_EQ(Protocol::OTHER, talkers[2].protocol);
+  EXPECT_EQ(1, stats.getTopTalkers(1).size());
+
+  // Only port 3 sends in the next interval, so it moves to the top, while
+  // the totals are kept.
+  for (int i = 0; i < 4; ++i) {
+    stats.record(makePacket(3, 2, 100).get(), Protocol::LACP);
+  }
+  stats.update(start + seconds(3));
+  talkers = stats.getTopTalkers(10);
+  ASSERT_EQ(3, talkers.size());
+  EXPECT_EQ(PortID(3), talkers[0].port);
+  EXPECT_EQ(14, talkers[0].packets);
+  EXPECT_DOUBLE_EQ(4, talkers[0].packetsPerSec);
+  EXPECT_EQ(PortID(5), talkers[1].port);
+  EXPECT_DOUBLE_EQ(0, talkers[1].packetsPerSec);
+}
+
+TEST(PuntStatsTest, Threads) {
+  PuntStats stats;
+  auto start = steady_clock::now();
+  stats.update(start);
+
+  stats.record(makePacket(1, 0).get(), Protocol::IPV6);
+  // The counts of a thread are kept after it exits
+  std::thread([&]() {
+    for (int i = 0; i < 5; ++i) {
+      stats.record(makePacket(1, 0).get(), Protocol::IPV6);
+    }
+    // Ports past the end are all counted on the last one
+    stats.record(makePacket(5000, 0).get(), Protocol::IPV4);
+  }).join();
+  stats.update(start + seconds(1));
+
+  auto talkers = stats.getTopTalkers(10);
+  ASSERT_EQ(2, talkers.size());
+  EXPECT_EQ(PortID(1), talkers[0].port);
+  EXPECT_EQ(6, talkers[0].packets);
+  EXPECT_DOUBLE_EQ(6, talkers[0].packetsPerSec);
+  EXPECT_EQ(PortID(PuntStats::kMaxPorts - 1), talkers[1].port);
+  EXPECT_EQ(Protocol::IPV4, talkers[1].protocol);
+}
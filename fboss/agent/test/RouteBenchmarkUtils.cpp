@@ -0,0 +1,133 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "fboss/agent/test/RouteBenchmarkUtils.h"
+
+#include <sys/resource.h>
+
+#include <folly/Format.h>
+
+#include "fboss/agent/AddressUtil.h"
+#include "fboss/agent/SwSwitch.h"
+#include "fboss/agent/hw/sim/SimPlatform.h"
+#include "fboss/agent/state/Interface.h"
+#include "fboss/agent/state/RouteUpdater.h"
+#include "fboss/agent/state/SwitchState.h"
+#include "fboss/agent/state/Vlan.h"
+
+#include <chrono>
+
+DEFINE_int32(num_routes, 100000, "Number of routes in the synthetic table");
+DEFINE_int32(batch_size, 1000, "Number of routes per thrift call");
+DEFINE_int32(v4_percent, 20, "Percentage of IPv4 routes in the table");
+DEFINE_int32(client_id, 786, "Client ID the routes are added with");
+
+using facebook::network::toBinaryAddress;
+using folly::IPAddress;
+using folly::IPAddressV4;
+using folly::IPAddressV6;
+using folly::MacAddress;
+using std::make_shared;
+using std::make_unique;
+using std::shared_ptr;
+using std::unique_ptr;
+
+namespace facebook { namespace fboss {
+
+namespace {
+const InterfaceID kIntf{1};
+} // unnamed namespace
+
+long peakRssKB() {
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return usage.ru_maxrss;
+}
+
+IpPrefix makeIpPrefix(const IPAddress& ip, int16_t length) {
+  IpPrefix prefix;
+  prefix.ip = toBinaryAddress(ip);
+  prefix.prefixLength = length;
+  return prefix;
+}
+
+IPAddress nthBenchmarkNextHop(bool v4, int n) {
+  if (v4) {
+    return IPAddress(IPAddressV4::fromLongHBO(0x0a000002 + n));
+  }
+  auto bytes = IPAddressV6("2401:db00:2110:3001::").toByteArray();
+  bytes[15] = 2 + n;
+  return IPAddress(IPAddressV6(bytes));
+}
+
+UnicastRoute nthBenchmarkRoute(int n, int ecmpWidth, int firstNextHop) {
+  bool v4 = (n % 100) < FLAGS_v4_percent;
+  UnicastRoute route;
+  if (v4) {
+    route.dest =
+        makeIpPrefix(IPAddress(IPAddressV4::fromLongHBO(0x0b000000 + (n << 8))),
+                     24);
+  } else {
+    route.dest = makeIpPrefix(
+        IPAddress(folly::sformat(
+            "2401:db01:{:x}:{:x}::", (n >> 16) & 0xffff, n & 0xffff)),
+        64);
+  }
+  for (int i = 0; i < ecmpWidth; ++i) {
+    route.nextHopAddrs.push_back(toBinaryAddress(nthBenchmarkNextHop(
+        v4, (firstNextHop + i) % kNumBenchmarkNextHops)));
+  }
+  return route;
+}
+
+unique_ptr<SwSwitch> createBenchmarkSwitch() {
+  auto sw = make_unique<SwSwitch>(
+      make_unique<SimPlatform>(MacAddress("02:00:01:00:00:01"), 10));
+  sw->init(nullptr /* No custom TunManager */);
+  return sw;
+}
+
+unique_ptr<SwSwitch> setupBenchmarkSwitch() {
+  auto sw = createBenchmarkSwitch();
+  auto updateFn = [&](const shared_ptr<SwitchState>& oldState) {
+    auto state = oldState->clone();
+
+    auto vlan1 = make_shared<Vlan>(VlanID(1), "Vlan1");
+    state->addVlan(vlan1);
+    for (int idx = 1; idx < 10; ++idx) {
+      vlan1->addPort(PortID(idx), false);
+    }
+    auto intf1 = make_shared<Interface>(
+        kIntf,
+        RouterID(0),
+        VlanID(1),
+        "interface1",
+        MacAddress("02:00:01:00:00:01"),
+        9000,
+        false, /* is virtual */
+        false  /* is state_sync disabled*/);
+    Interface::Addresses addrs1;
+    addrs1.emplace(IPAddress("10.0.0.1"), 24);
+    addrs1.emplace(IPAddress("2401:db00:2110:3001::1"), 64);
+    intf1->setAddresses(addrs1);
+    state->addIntf(intf1);
+    vlan1->setInterfaceID(kIntf);
+
+    RouteUpdater updater(state->getRouteTables());
+    updater.addInterfaceAndLinkLocalRoutes(state->getInterfaces());
+    state->resetRouteTables(updater.updateDone());
+    return state;
+  };
+  sw->updateStateBlocking("setup", updateFn);
+  sw->initialConfigApplied(std::chrono::steady_clock::now());
+  sw->fibSynced();
+  return sw;
+}
+
+}} // facebook::fboss
@@ -0,0 +1,83 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#pragma once
+
+#include <folly/IPAddress.h>
+#include <gflags/gflags.h>
+
+#include "fboss/agent/if/gen-cpp2/ctrl_types.h"
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+/*
+ * Helpers shared by the benchmarks that load a SwSwitch on a SimPlatform
+ * with a synthetic route table through ThriftHandler.
+ */
+
+DECLARE_int32(num_routes);
+DECLARE_int32(batch_size);
+DECLARE_int32(v4_percent);
+DECLARE_int32(client_id);
+
+namespace facebook { namespace fboss {
+
+class SwSwitch;
+
+// The next hops the synthetic routes pick from, which all fit in the
+// subnets of the benchmark interface
+constexpr int kNumBenchmarkNextHops = 200;
+
+/*
+ * Peak RSS of the process so far
+ */
+long peakRssKB();
+
+IpPrefix makeIpPrefix(const folly::IPAddress& ip, int16_t length);
+
+/*
+ * The nth next hop in the subnets of the interface set up by
+ * setupBenchmarkSwitch(), for n below kNumBenchmarkNextHops
+ */
+folly::IPAddress nthBenchmarkNextHop(bool v4, int n);
+
+/*
+ * The nth route of the synthetic table, through ecmpWidth next hops
+ * starting at the firstNextHop'th one, wrapping around after the last of
+ * kNumBenchmarkNextHops.  --v4_percent percent of the routes are IPv4.
+ */
+UnicastRoute nthBenchmarkRoute(int n, int ecmpWidth, int firstNextHop = 0);
+
+/*
+ * A SwSwitch on a SimPlatform, with no interfaces yet
+ */
+std::unique_ptr<SwSwitch> createBenchmarkSwitch();
+
+/*
+ * A SwSwitch on a SimPlatform with the interface the synthetic routes
+ * resolve through, past its initial config and FIB sync
+ */
+std::unique_ptr<SwSwitch> setupBenchmarkSwitch();
+
+/*
+ * Call fn(batch) with the items in batches of up to --batch_size, as they
+ * are sent to the thrift calls
+ */
+template <typename T, typename Fn>
+void forEachBenchmarkBatch(const std::vector<T>& items, Fn&& fn) {
+  for (size_t start = 0; start < items.size(); start += FLAGS_batch_size) {
+    auto end = std::min(items.size(), start + FLAGS_batch_size);
+    fn(std::make_unique<std::vector<T>>(
+        items.begin() + start, items.begin() + end));
+  }
+}
+
+}} // facebook::fboss
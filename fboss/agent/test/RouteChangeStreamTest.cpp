@@ -0,0 +1,189 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "fboss/agent/RouteChangeStream.h"
+
+#include "fboss/agent/AddressUtil.h"
+#include "fboss/agent/state/RouteUpdater.h"
+#include "fboss/agent/state/SwitchState.h"
+
+#include <folly/io/async/EventBase.h>
+#include <gflags/gflags.h>
+#include <gtest/gtest.h>
+
+using namespace facebook::fboss;
+using folly::IPAddress;
+using std::shared_ptr;
+
+namespace {
+
+const RouterID kVrf(0);
+const ClientID kClient(1);
+
+shared_ptr<SwitchState> updateRoutes(
+    const shared_ptr<SwitchState>& state,
+    std::vector<std::string> added,
+    std::vector<std::string> removed = {}) {
+  RouteUpdater updater(state->getRouteTables());
+  for (const auto& prefix : added) {
+    auto network = IPAddress::createNetwork(prefix);
+    updater.addRoute(
+        kVrf, network.first, network.second, kClient,
+        RouteNextHopEntry(RouteForwardAction::DROP, AdminDistance::EBGP));
+  }
+  for (const auto& prefix : removed) {
+    auto network = IPAddress::createNetwork(prefix);
+    updater.delRoute(kVrf, network.first, network.second, kClient);
+  }
+  auto newState = state->clone();
+  newState->resetRouteTables(updater.updateDone());
+  newState->publish();
+  return newState;
+}
+
+// The prefixes in a batch, and whether each is still there
+std::map<std::string, bool> toPrefixes(const RouteChangeStream::Batch& batch) {
+  std::map<std::string, bool> prefixes;
+  for (const auto& change : batch->changes.changes) {
+    EXPECT_EQ(kVrf, RouterID(change.vrfId));
+    auto prefix = folly::to<std::string>(
+        facebook::network::toIPAddress(change.prefix.ip).str(),
+        "/",
+        change.prefix.prefixLength);
+    prefixes[prefix] = change.__isset.route;
+  }
+  return prefixes;
+}
+
+RouteChangeStream::Batch makeBatch(
+    int64_t generation, const shared_ptr<SwitchState>& oldState,
+    const shared_ptr<SwitchState>& newState) {
+  return RouteChangeStream::makeBatch(
+      generation, RouteChangeStream::diff(oldState, newState), newState);
+}
+
+} // unnamed namespace
+
+TEST(RouteChangeStreamTest, Coalesce) {
+  gflags::FlagSaver saver;
+  FLAGS_route_change_coalesce_ms = 1;
+
+  folly::EventBase evb;
+  std::vector<RouteChangeStream::Batch> batches;
+  RouteChangeStream stream(&evb, [&](RouteChangeStream::Batch batch) {
+    batches.push_back(std::move(batch));
+  });
+
+  auto state1 = updateRoutes(
+      std::make_shared<SwitchState>(), {"10.1.0.0/16", "10.2.0.0/16"});
+  auto state2 = updateRoutes(state1, {"2401:db00::/64"}, {"10.1.0.0/16"});
+  stream.stateChanged(state1);
+  stream.stateChanged(state2);
+  evb.loop();
+
+  // Both states in one batch, and the route added and removed is left out
+  ASSERT_EQ(1, batches.size());
+  EXPECT_EQ(1, batches[0]->changes.generation);
+  EXPECT_FALSE(batches[0]->changes.snapshot);
+  std::map<std::string, bool> expected{
+      {"10.2.0.0/16", true}, {"2401:db00::/64", true}};
+  EXPECT_EQ(expected, toPrefixes(batches[0]));
+  EXPECT_EQ(1, stream.getGeneration());
+
+  // States that leave the routes alone publish nothing
+  auto state3 = state2->clone();
+  state3->publish();
+  stream.stateChanged(state3);
+  evb.loop();
+  EXPECT_EQ(1, batches.size());
+
+  stream.stateChanged(updateRoutes(state3, {}, {"10.2.0.0/16"}));
+  evb.loop();
+  ASSERT_EQ(2, batches.size());
+  EXPECT_EQ(2, batches[1]->changes.generation);
+  expected = {{"10.2.0.0/16", false}};
+  EXPECT_EQ(expected, toPrefixes(batches[1]));
+
+  auto snapshot = stream.getSnapshot();
+  EXPECT_EQ(2, snapshot->changes.generation);
+  EXPECT_TRUE(snapshot->changes.snapshot);
+  expected = {{"2401:db00::/64", true}};
+  EXPECT_EQ(expected, toPrefixes(snapshot));
+}
+
+TEST(RouteChangeStreamTest, Backlog) {
+  gflags::FlagSaver saver;
+  FLAGS_max_route_change_batches_in_flight = 1;
+
+  auto state0 = std::make_shared<SwitchState>();
+  auto state1 = updateRoutes(state0, {"10.1.0.0/16"});
+  auto state2 = updateRoutes(state1, {"10.2.0.0/16"});
+  auto state3 = updateRoutes(state2, {"10.3.0.0/16"}, {"10.1.0.0/16"});
+  auto state4 = updateRoutes(state3, {"10.4.0.0/16"});
+
+  // A listener subscribing at generation 1 has that batch in its snapshot
+  RouteChangeBacklog backlog;
+  auto snapshot = RouteChangeStream::makeSnapshot(1, state1);
+  backlog.subscribed(snapshot);
+  EXPECT_EQ(1, backlog.getInFlight());
+  EXPECT_EQ(nullptr, backlog.published(makeBatch(1, state0, state1)));
+
+  // These wait for the snapshot to be acknowledged, and go out together
+  EXPECT_EQ(nullptr, backlog.published(makeBatch(2, state1, state2)));
+  EXPECT_EQ(nullptr, backlog.published(makeBatch(3, state2, state3)));
+  EXPECT_EQ(2, backlog.getLag());
+
+  auto merged = backlog.acked(1);
+  ASSERT_NE(nullptr, merged);
+  EXPECT_EQ(3, merged->changes.generation);
+  EXPECT_FALSE(merged->changes.snapshot);
+  std::map<std::string, bool> expected{
+      {"10.1.0.0/16", false}, {"10.2.0.0/16", true}, {"10.3.0.0/16", true}};
+  EXPECT_EQ(expected, toPrefixes(merged));
+
+  EXPECT_EQ(nullptr, backlog.acked(3));
+  EXPECT_EQ(0, backlog.getLag());
+  EXPECT_EQ(0, backlog.getInFlight());
+  auto next = makeBatch(4, state3, state4);
+  EXPECT_EQ(next, backlog.published(next));
+  EXPECT_EQ(0, backlog.getDropped());
+}
+
+TEST(RouteChangeStreamTest, Resync) {
+  gflags::FlagSaver saver;
+  FLAGS_max_route_change_batches_in_flight = 1;
+  FLAGS_max_route_change_backlog = 1;
+
+  auto state0 = std::make_shared<SwitchState>();
+  auto state1 = updateRoutes(state0, {"10.1.0.0/16"});
+  auto state2 = updateRoutes(state1, {"10.2.0.0/16", "10.3.0.0/16"});
+  auto state3 = updateRoutes(state2, {}, {"10.1.0.0/16"});
+
+  RouteChangeBacklog backlog;
+  backlog.published(makeBatch(1, state0, state1));
+  EXPECT_EQ(nullptr, backlog.published(makeBatch(2, state1, state2)));
+  EXPECT_EQ(2, backlog.getDropped());
+  // Already resyncing, so there is no point keeping these
+  EXPECT_EQ(nullptr, backlog.published(makeBatch(3, state2, state3)));
+  EXPECT_EQ(3, backlog.getDropped());
+
+  // The listener is sent everything as of the latest generation instead
+  auto resync = backlog.acked(1);
+  ASSERT_NE(nullptr, resync);
+  EXPECT_EQ(3, resync->changes.generation);
+  EXPECT_TRUE(resync->changes.snapshot);
+  std::map<std::string, bool> expected{
+      {"10.2.0.0/16", true}, {"10.3.0.0/16", true}};
+  EXPECT_EQ(expected, toPrefixes(resync));
+
+  // Back to streaming changes once the listener has room again
+  EXPECT_EQ(nullptr, backlog.acked(3));
+  auto next = makeBatch(4, state3, updateRoutes(state3, {"10.4.0.0/16"}));
+  EXPECT_EQ(next, backlog.published(next));
+}
@@ -0,0 +1,339 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include <folly/Conv.h>
+#include <folly/FileUtil.h>
+#include <folly/Format.h>
+#include <folly/IPAddress.h>
+#include <folly/String.h>
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+#include "fboss/agent/AddressUtil.h"
+#include "fboss/agent/FbossError.h"
+#include "fboss/agent/SwSwitch.h"
+#include "fboss/agent/ThriftHandler.h"
+#include "fboss/agent/test/RouteBenchmarkUtils.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <new>
+#include <random>
+#include <string>
+#include <vector>
+
+/*
+ * Measures how fast route updates go through the agent.
+ *
+ * A SwSwitch is set up on a SimPlatform and route feeds are replayed through
+ * ThriftHandler, the same way a routing daemon would send them.  For each
+ * scenario the number of routes per second, the p50/p99/max latency of the
+ * thrift calls, the heap allocations made per route while the calls ran and
+ * the peak RSS of the process are printed.
+ *
+ * The synthetic scenarios are:
+ *  - load:  add --num_routes routes in batches of --batch_size
+ *  - flap:  --flap_rounds times, delete --flap_percent percent of the
+ *           routes at random and add them back
+ *  - ecmp:  change the number of next hops of every route to each width
+ *           in --ecmp_widths in turn
+ *  - sync:  syncFib() the full table, first unchanged and then with
+ *           --flap_percent percent of the routes replaced
+ *
+ * A recorded feed can be replayed with --route_feed instead.  Each line of
+ * the file is one of
+ *   add <prefix> <nexthop> [<nexthop>...]
+ *   del <prefix>
+ *   sync
+ * where "sync" calls syncFib() with every route added so far that has not
+ * been deleted.  Consecutive adds or deletes are sent in batches of up to
+ * --batch_size routes.  Blank lines and lines starting with '#' are skipped.
+ */
+
+DEFINE_int32(flap_percent, 10, "Percentage of routes flapped per round");
+DEFINE_int32(flap_rounds, 5, "Number of flap rounds");
+DEFINE_string(ecmp_widths, "1,8,32,64", "Comma separated ECMP widths");
+DEFINE_string(route_feed, "", "Replay this recorded route feed instead of "
+    "running the synthetic scenarios");
+
+using namespace facebook::fboss;
+using facebook::network::toBinaryAddress;
+using facebook::network::toIPAddress;
+using folly::IPAddress;
+using std::make_unique;
+using std::vector;
+
+namespace {
+// Heap allocations made by any thread, counted by operator new below
+std::atomic<uint64_t> numAllocations{0};
+} // unnamed namespace
+
+void* operator new(size_t size) {
+  numAllocations.fetch_add(1, std::memory_order_relaxed);
+  if (auto ptr = std::malloc(size ? size : 1)) {
+    return ptr;
+  }
+  throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept {
+  std::free(ptr);
+}
+
+void operator delete(void* ptr, size_t /* size */) noexcept {
+  std::free(ptr);
+}
+
+namespace {
+
+/*
+ * Latencies of the thrift calls made for one scenario
+ */
+class ScenarioStats {
+ public:
+  explicit ScenarioStats(std::string name)
+      : name_(std::move(name)), start_(std::chrono::steady_clock::now()) {}
+
+  template <typename Fn>
+  void time(size_t numRoutes, Fn&& fn) {
+    auto allocsBefore = numAllocations.load();
+    auto begin = std::chrono::steady_clock::now();
+    fn();
+    auto end = std::chrono::steady_clock::now();
+    allocations_ += numAllocations.load() - allocsBefore;
+    latenciesUsecs_.push_back(
+        std::chrono::duration<double, std::micro>(end - begin).count());
+    busyUsecs_ += latenciesUsecs_.back();
+    numRoutes_ += numRoutes;
+  }
+
+  void print() {
+    if (latenciesUsecs_.empty()) {
+      std::cout << folly::sformat("{:<8} no updates\n", name_);
+      return;
+    }
+    std::sort(latenciesUsecs_.begin(), latenciesUsecs_.end());
+    auto elapsed =
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - start_)
+            .count();
+    std::cout << folly::sformat(
+        "{:<8} {:>8} calls {:>10} routes {:>12.0f} routes/sec "
+        "p50 {:>10.0f}us p99 {:>10.0f}us max {:>10.0f}us "
+        "(wall {:.2f}s) {:.1f} allocs/route peak RSS {} KB\n",
+        name_,
+        latenciesUsecs_.size(),
+        numRoutes_,
+        numRoutes_ / (busyUsecs_ / 1e6),
+        percentile(0.50),
+        percentile(0.99),
+        latenciesUsecs_.back(),
+        elapsed,
+        static_cast<double>(allocations_) / std::max<size_t>(numRoutes_, 1),
+        peakRssKB());
+  }
+
+ private:
+  double percentile(double p) const {
+    auto idx = static_cast<size_t>(p * (latenciesUsecs_.size() - 1) + 0.5);
+    return latenciesUsecs_[idx];
+  }
+
+  std::string name_;
+  std::chrono::steady_clock::time_point start_;
+  vector<double> latenciesUsecs_;
+  double busyUsecs_{0};
+  size_t numRoutes_{0};
+  uint64_t allocations_{0};
+};
+
+IpPrefix parsePrefix(folly::StringPiece str) {
+  auto network = IPAddress::createNetwork(str, -1, false /* don't mask */);
+  return makeIpPrefix(network.first, network.second);
+}
+
+/*
+ * Send routes to addUnicastRoutes() in batches of --batch_size
+ */
+void addRoutes(
+    ThriftHandler* handler,
+    const vector<UnicastRoute>& routes,
+    ScenarioStats* stats) {
+  forEachBenchmarkBatch(
+      routes, [&](std::unique_ptr<vector<UnicastRoute>> batch) {
+        stats->time(batch->size(), [&] {
+          handler->addUnicastRoutes(FLAGS_client_id, std::move(batch));
+        });
+      });
+}
+
+void deleteRoutes(
+    ThriftHandler* handler,
+    const vector<IpPrefix>& prefixes,
+    ScenarioStats* stats) {
+  forEachBenchmarkBatch(
+      prefixes, [&](std::unique_ptr<vector<IpPrefix>> batch) {
+        stats->time(batch->size(), [&] {
+          handler->deleteUnicastRoutes(FLAGS_client_id, std::move(batch));
+        });
+      });
+}
+
+void syncFib(
+    ThriftHandler* handler,
+    const vector<UnicastRoute>& routes,
+    ScenarioStats* stats) {
+  auto table = make_unique<vector<UnicastRoute>>(routes);
+  stats->time(table->size(), [&] {
+    handler->syncFib(FLAGS_client_id, std::move(table));
+  });
+}
+
+void runSyntheticScenarios(ThriftHandler* handler) {
+  vector<UnicastRoute> table;
+  table.reserve(FLAGS_num_routes);
+  for (int n = 0; n < FLAGS_num_routes; ++n) {
+    table.push_back(nthBenchmarkRoute(n, 1));
+  }
+
+  {
+    ScenarioStats stats("load");
+    addRoutes(handler, table, &stats);
+    stats.print();
+  }
+
+  std::mt19937 rng(0);
+  auto numFlapped = table.size() * FLAGS_flap_percent / 100;
+  {
+    ScenarioStats stats("flap");
+    for (int round = 0; round < FLAGS_flap_rounds; ++round) {
+      std::shuffle(table.begin(), table.end(), rng);
+      vector<IpPrefix> prefixes;
+      for (size_t i = 0; i < numFlapped; ++i) {
+        prefixes.push_back(table[i].dest);
+      }
+      deleteRoutes(handler, prefixes, &stats);
+      addRoutes(
+          handler,
+          vector<UnicastRoute>(table.begin(), table.begin() + numFlapped),
+          &stats);
+    }
+    stats.print();
+  }
+
+  {
+    ScenarioStats stats("ecmp");
+    vector<folly::StringPiece> widths;
+    folly::split(',', FLAGS_ecmp_widths, widths);
+    for (auto widthStr : widths) {
+      auto width = std::min(folly::to<int>(widthStr), kNumBenchmarkNextHops);
+      for (auto& route : table) {
+        auto v4 = toIPAddress(route.dest.ip).isV4();
+        route.nextHopAddrs.clear();
+        for (int i = 0; i < width; ++i) {
+          route.nextHopAddrs.push_back(
+              toBinaryAddress(nthBenchmarkNextHop(v4, i)));
+        }
+      }
+      addRoutes(handler, table, &stats);
+    }
+    stats.print();
+  }
+
+  {
+    ScenarioStats stats("sync");
+    syncFib(handler, table, &stats);
+    // Replace some of the routes so the sync has work to do
+    std::shuffle(table.begin(), table.end(), rng);
+    for (size_t i = 0; i < numFlapped; ++i) {
+      table[i] = nthBenchmarkRoute(FLAGS_num_routes + i, 2, i);
+    }
+    syncFib(handler, table, &stats);
+    stats.print();
+  }
+}
+
+void replayRouteFeed(ThriftHandler* handler, const std::string& path) {
+  std::string contents;
+  if (!folly::readFile(path.c_str(), contents)) {
+    throw FbossError("unable to read route feed ", path);
+  }
+  vector<folly::StringPiece> lines;
+  folly::split('\n', contents, lines);
+
+  ScenarioStats stats("feed");
+  // Routes added by the feed and not deleted yet, for "sync"
+  std::map<std::string, UnicastRoute> table;
+  vector<UnicastRoute> adds;
+  vector<IpPrefix> dels;
+  auto flush = [&] {
+    addRoutes(handler, adds, &stats);
+    adds.clear();
+    deleteRoutes(handler, dels, &stats);
+    dels.clear();
+  };
+  for (size_t lineNum = 0; lineNum < lines.size(); ++lineNum) {
+    auto line = folly::trimWhitespace(lines[lineNum]);
+    if (line.empty() || line.startsWith('#')) {
+      continue;
+    }
+    vector<folly::StringPiece> fields;
+    folly::split(' ', line, fields, true /* ignore empty */);
+    if (fields[0] == "add" && fields.size() >= 3) {
+      if (!dels.empty()) {
+        flush();
+      }
+      UnicastRoute route;
+      route.dest = parsePrefix(fields[1]);
+      for (size_t i = 2; i < fields.size(); ++i) {
+        route.nextHopAddrs.push_back(toBinaryAddress(IPAddress(fields[i])));
+      }
+      table[fields[1].str()] = route;
+      adds.push_back(std::move(route));
+    } else if (fields[0] == "del" && fields.size() == 2) {
+      if (!adds.empty()) {
+        flush();
+      }
+      dels.push_back(parsePrefix(fields[1]));
+      table.erase(fields[1].str());
+    } else if (fields[0] == "sync" && fields.size() == 1) {
+      flush();
+      vector<UnicastRoute> routes;
+      for (const auto& prefixAndRoute : table) {
+        routes.push_back(prefixAndRoute.second);
+      }
+      syncFib(handler, routes, &stats);
+    } else {
+      throw FbossError(
+          "invalid line ", lineNum + 1, " in route feed ", path, ": ", line);
+    }
+  }
+  flush();
+  stats.print();
+}
+
+} // unnamed namespace
+
+int main(int argc, char** argv) {
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+  google::InitGoogleLogging(argv[0]);
+
+  auto sw = setupBenchmarkSwitch();
+  ThriftHandler handler(sw.get());
+
+  if (!FLAGS_route_feed.empty()) {
+    replayRouteFeed(&handler, FLAGS_route_feed);
+  } else {
+    runSyntheticScenarios(&handler);
+  }
+  return 0;
+}
@@ -0,0 +1,130 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "fboss/agent/RouteUpdateBinaryLog.h"
+
+#include "fboss/agent/FbossError.h"
+
+#include <folly/FileUtil.h>
+#include <folly/experimental/TestUtil.h>
+
+#include <gtest/gtest.h>
+
+using namespace facebook::fboss;
+using folly::IPAddress;
+using folly::IPAddressV4;
+
+namespace {
+
+const auto kClient = ClientID(1);
+
+std::shared_ptr<Route<IPAddressV4>> makeRoute(
+    const std::string& network,
+    uint8_t mask,
+    size_t numNextHops) {
+  RouteNextHopEntry::NextHopSet nhops;
+  for (size_t i = 0; i < numNextHops; ++i) {
+    nhops.emplace(ResolvedNextHop(
+        IPAddress(folly::to<std::string>("10.0.0.", i + 1)),
+        InterfaceID(i + 1), 1));
+  }
+  RouteNextHopEntry entry(nhops, AdminDistance::EBGP);
+  RoutePrefix<IPAddressV4> prefix{IPAddressV4(network), mask};
+  auto route = std::make_shared<Route<IPAddressV4>>(prefix, kClient, entry);
+  route->setResolved(entry);
+  return route;
+}
+
+std::vector<RouteLogRecord> readLog(const folly::test::TemporaryFile& tmp) {
+  std::string data;
+  EXPECT_TRUE(folly::readFile(tmp.path().c_str(), data));
+  bool truncated = true;
+  auto records = decodeRouteUpdateLog(folly::StringPiece(data), &truncated);
+  EXPECT_FALSE(truncated);
+  return records;
+}
+
+} // unnamed namespace
+
+TEST(RouteUpdateBinaryLog, roundTrip) {
+  folly::test::TemporaryFile tmp;
+  {
+    auto log = std::make_shared<RouteUpdateBinaryLog>(tmp.path().string());
+    BinaryRouteLogger<IPAddressV4> logger(log);
+    auto oldRoute = makeRoute("20.0.0.0", 24, 2);
+    auto newRoute = makeRoute("20.0.0.0", 24, 12);
+    logger.logAddedRoute(oldRoute, {"a", "b"});
+    logger.logChangedRoute(oldRoute, newRoute, {"a"});
+    logger.logRemovedRoute(newRoute, {"b"});
+  }
+
+  auto records = readLog(tmp);
+  // The identifiers are recorded where they are first used
+  ASSERT_EQ(6, records.size());
+  EXPECT_EQ(RouteLogRecordType::IDENTIFIER, records[0].type);
+  EXPECT_EQ(RouteLogRecordType::ADDED, records[1].type);
+  EXPECT_EQ(RouteLogRecordType::IDENTIFIER, records[2].type);
+  EXPECT_EQ(RouteLogRecordType::ADDED, records[3].type);
+  EXPECT_EQ("b", records[3].identifier);
+
+  const auto& changed = records[4];
+  EXPECT_EQ(RouteLogRecordType::CHANGED, changed.type);
+  EXPECT_EQ("a", changed.identifier);
+  EXPECT_EQ(IPAddress::createNetwork("20.0.0.0/24"), changed.network);
+  ASSERT_TRUE(changed.oldRoute.hasValue());
+  ASSERT_TRUE(changed.newRoute.hasValue());
+  EXPECT_TRUE(changed.oldRoute->resolved);
+  EXPECT_EQ(RouteForwardAction::NEXTHOPS, changed.oldRoute->action);
+  ASSERT_EQ(2, changed.oldRoute->nexthops.size());
+  EXPECT_EQ(IPAddress("10.0.0.1"), changed.oldRoute->nexthops[0].addr);
+  EXPECT_EQ(1, *changed.oldRoute->nexthops[0].intf);
+  // Only the first next hops of a wide route are kept
+  EXPECT_EQ(12, changed.newRoute->numNextHops);
+  EXPECT_EQ(kMaxLoggedNextHops, changed.newRoute->nexthops.size());
+
+  const auto& removed = records[5];
+  EXPECT_EQ(RouteLogRecordType::REMOVED, removed.type);
+  EXPECT_EQ("b", removed.identifier);
+  EXPECT_TRUE(removed.oldRoute.hasValue());
+  EXPECT_FALSE(removed.newRoute.hasValue());
+}
+
+TEST(RouteUpdateBinaryLog, appends) {
+  folly::test::TemporaryFile tmp;
+  for (int i = 0; i < 2; ++i) {
+    auto log = std::make_shared<RouteUpdateBinaryLog>(tmp.path().string());
+    BinaryRouteLogger<IPAddressV4> logger(log);
+    logger.logAddedRoute(makeRoute("20.0.0.0", 24, 1), {"a"});
+  }
+  // Identifier ids start over with each agent run, and are written again
+  auto records = readLog(tmp);
+  ASSERT_EQ(4, records.size());
+  EXPECT_EQ("a", records[3].identifier);
+}
+
+TEST(RouteUpdateBinaryLog, truncated) {
+  folly::test::TemporaryFile tmp;
+  {
+    auto log = std::make_shared<RouteUpdateBinaryLog>(tmp.path().string());
+    BinaryRouteLogger<IPAddressV4> logger(log);
+    logger.logAddedRoute(makeRoute("20.0.0.0", 24, 1), {"a"});
+  }
+  std::string data;
+  ASSERT_TRUE(folly::readFile(tmp.path().c_str(), data));
+  data.resize(data.size() - 3);
+  bool truncated = false;
+  auto records = decodeRouteUpdateLog(folly::StringPiece(data), &truncated);
+  EXPECT_TRUE(truncated);
+  ASSERT_EQ(1, records.size());
+  EXPECT_EQ(RouteLogRecordType::IDENTIFIER, records[0].type);
+
+  EXPECT_THROW(
+      decodeRouteUpdateLog(folly::StringPiece("not a log at all")),
+      FbossError);
+}
@@ -0,0 +1,128 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "common/stats/MonotonicCounter.h"
+#include "common/stats/ServiceData.h"
+
+#include <gtest/gtest.h>
+
+#include <thread>
+#include <vector>
+
+using namespace facebook;
+using namespace facebook::stats;
+
+namespace {
+
+std::chrono::seconds nowSecs() {
+  return std::chrono::duration_cast<std::chrono::seconds>(
+      statsNow().time_since_epoch());
+}
+
+} // unnamed namespace
+
+TEST(ServiceDataTest, Counters) {
+  fbData->setCounter("service_data_test.counter", 5);
+  EXPECT_EQ(7, fbData->incrementCounter("service_data_test.counter", 2));
+  EXPECT_EQ(1, fbData->incrementCounter("service_data_test.new"));
+
+  std::vector<std::thread> threads;
+  for (int idx = 0; idx < 4; ++idx) {
+    threads.emplace_back([] {
+      for (int count = 0; count < 1000; ++count) {
+        fbData->incrementCounter("service_data_test.counter");
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  EXPECT_EQ(4007, fbData->getCounter("service_data_test.counter"));
+
+  auto counters = fbData->getCounters();
+  EXPECT_EQ(4007, counters["service_data_test.counter"]);
+  EXPECT_EQ(1, counters["service_data_test.new"]);
+  EXPECT_EQ(1, fbData->clearCounter("service_data_test.new"));
+  EXPECT_EQ(0, fbData->clearCounter("service_data_test.new"));
+  EXPECT_EQ(0, fbData->getCounters().count("service_data_test.new"));
+}
+
+TEST(ServiceDataTest, Stat) {
+  auto statMap = fbData->getStatMap();
+  const auto type = SUM;
+  auto stat = statMap->getLockableStat("service_data_test.stat", &type);
+  statMap->exportStat("service_data_test.stat", AVG);
+  auto now = nowSecs();
+  stat.addValue(now, 10);
+  stat.addValue(now.count(), 30);
+
+  auto counters = fbData->getCounters();
+  EXPECT_EQ(40, counters["service_data_test.stat.sum"]);
+  EXPECT_EQ(40, counters["service_data_test.stat.sum.60"]);
+  EXPECT_EQ(20, counters["service_data_test.stat.avg.3600"]);
+  EXPECT_EQ(0, counters.count("service_data_test.stat.count"));
+
+  auto locked = statMap->getLockedStatPtr("service_data_test.stat");
+  EXPECT_EQ(40, locked->sum(locked->numLevels() - 1));
+}
+
+TEST(ServiceDataTest, MonotonicCounter) {
+  MonotonicCounter counter("service_data_test.monotonic", SUM, RATE);
+  auto now = nowSecs();
+  // The first value is only the starting point
+  counter.updateValue(now, 1000);
+  counter.updateValue(now, 1100);
+  counter.updateValue(now, 1150);
+  EXPECT_EQ(150, fbData->getCounter("service_data_test.monotonic.sum"));
+  EXPECT_GT(fbData->getCounter("service_data_test.monotonic.rate.60"), 0);
+
+  // A reset counts from zero again
+  counter.updateValue(now, 20);
+  EXPECT_EQ(170, fbData->getCounter("service_data_test.monotonic.sum"));
+
+  // Swapping in a new counter starts over from a new starting point
+  MonotonicCounter renamed("service_data_test.renamed", SUM, RATE);
+  counter.swap(renamed);
+  EXPECT_EQ("service_data_test.renamed", counter.getName());
+  counter.updateValue(now, 500);
+  counter.updateValue(now, 505);
+  EXPECT_EQ(5, fbData->getCounter("service_data_test.renamed.sum"));
+  EXPECT_EQ(170, fbData->getCounter("service_data_test.monotonic.sum"));
+}
+
+TEST(ServiceDataTest, Histogram) {
+  auto histMap = fbData->getHistogramMap();
+  EXPECT_FALSE(histMap->exportPercentile("service_data_test.hist", 50));
+  EXPECT_FALSE(
+      histMap->getOrCreateLockAndHistogram("service_data_test.hist", nullptr)
+          .second);
+
+  ExportedHistogram prototype(1, 0, 10);
+  bool created = false;
+  auto hist = histMap->getOrCreateLockableHistogram(
+      "service_data_test.hist", &prototype, &created);
+  EXPECT_TRUE(created);
+  histMap->getOrCreateLockableHistogram(
+      "service_data_test.hist", &prototype, &created);
+  EXPECT_FALSE(created);
+  EXPECT_TRUE(histMap->exportStat("service_data_test.hist", COUNT));
+  EXPECT_TRUE(histMap->exportPercentile("service_data_test.hist", 50));
+
+  auto now = nowSecs().count();
+  {
+    auto guard = hist.makeLockGuard();
+    hist.addValueLocked(guard, now, 2, 10);
+    hist.addValueLocked(guard, now, 8, 30);
+  }
+  auto counters = fbData->getCounters();
+  EXPECT_EQ(40, counters["service_data_test.hist.count"]);
+  auto p50 = counters["service_data_test.hist.p50.60"];
+  EXPECT_GE(p50, 8);
+  EXPECT_LE(p50, 9);
+}
@@ -0,0 +1,189 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "fboss/pcap_distribution_service/ShmPacketRing.h"
+
+#include <folly/Exception.h>
+#include <folly/io/IOBuf.h>
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using namespace facebook::fboss;
+
+namespace {
+
+constexpr size_t kCapacity = 64 * 1024;
+
+bool isSignalled(const ShmPacketRing& ring) {
+  struct pollfd pfd = {ring.eventFd(), POLLIN, 0};
+  return poll(&pfd, 1, 0) == 1;
+}
+
+} // unnamed namespace
+
+TEST(ShmPacketRingTest, ReadWrite) {
+  auto ring = ShmPacketRing::create(kCapacity);
+  EXPECT_EQ(kCapacity, ring->capacity());
+
+  // A chained buffer is copied out whole
+  auto buf = folly::IOBuf::copyBuffer("rx ");
+  buf->prependChain(folly::IOBuf::copyBuffer("packet"));
+  std::vector<RxPacket::RxReason> reasons{{1, "arp"}, {4, "l3 dst miss"}};
+  EXPECT_TRUE(ring->write(true, buf.get(), 0x0806, 5, 1000, reasons, 123));
+  auto txBuf = folly::IOBuf::copyBuffer("tx packet");
+  EXPECT_TRUE(ring->write(false, txBuf.get(), 0x86dd, 0, 0, {}, 456));
+  EXPECT_EQ(2, ring->getWritten());
+
+  CapturedPacket pkt;
+  ASSERT_TRUE(ring->read(&pkt));
+  EXPECT_TRUE(pkt.rx);
+  EXPECT_EQ(123, pkt.timestampUsec);
+  EXPECT_EQ(0x0806, pkt.ethertype);
+  const auto& rxPkt = pkt.pkt.get_rxpkt();
+  EXPECT_EQ(5, rxPkt.srcPort);
+  EXPECT_EQ(1000, rxPkt.srcVlan);
+  EXPECT_EQ("rx packet", rxPkt.packetData.toStdString());
+  ASSERT_EQ(2, rxPkt.reasons.size());
+  EXPECT_EQ(1, rxPkt.reasons[0].bytes);
+  EXPECT_EQ("arp", rxPkt.reasons[0].description);
+  EXPECT_EQ(4, rxPkt.reasons[1].bytes);
+  EXPECT_EQ("l3 dst miss", rxPkt.reasons[1].description);
+
+  ASSERT_TRUE(ring->read(&pkt));
+  EXPECT_FALSE(pkt.rx);
+  EXPECT_EQ(456, pkt.timestampUsec);
+  EXPECT_EQ("tx packet", pkt.pkt.get_txpkt().packetData.toStdString());
+  EXPECT_FALSE(ring->read(&pkt));
+}
+
+TEST(ShmPacketRingTest, Wrap) {
+  auto ring = ShmPacketRing::create(kCapacity);
+  // Doesn't divide the ring evenly, so records have to skip its end
+  std::string data(1000, 'x');
+  CapturedPacket pkt;
+  for (int idx = 0; idx < 500; ++idx) {
+    data[0] = 'a' + idx % 26;
+    auto buf = folly::IOBuf::copyBuffer(data);
+    ASSERT_TRUE(ring->write(false, buf.get(), 0x0800, 0, 0, {}, idx));
+    ASSERT_TRUE(ring->read(&pkt));
+    EXPECT_EQ(idx, pkt.timestampUsec);
+    EXPECT_EQ(data, pkt.pkt.get_txpkt().packetData.toStdString());
+  }
+  EXPECT_FALSE(ring->read(&pkt));
+}
+
+TEST(ShmPacketRingTest, Full) {
+  auto ring = ShmPacketRing::create(kCapacity);
+  auto buf = folly::IOBuf::copyBuffer(std::string(1000, 'x'));
+  int written = 0;
+  while (ring->write(false, buf.get(), 0x0800, 0, 0, {}, written)) {
+    ++written;
+  }
+  EXPECT_GT(written, 0);
+  EXPECT_EQ(1, ring->getDropped());
+
+  // Reading one makes room for one more
+  CapturedPacket pkt;
+  ASSERT_TRUE(ring->read(&pkt));
+  EXPECT_EQ(0, pkt.timestampUsec);
+  EXPECT_TRUE(ring->write(false, buf.get(), 0x0800, 0, 0, {}, written));
+
+  // Too big for the ring at all
+  auto huge = folly::IOBuf::copyBuffer(std::string(kCapacity, 'x'));
+  EXPECT_FALSE(ring->write(false, huge.get(), 0x0800, 0, 0, {}, 0));
+  EXPECT_EQ(2, ring->getDropped());
+}
+
+TEST(ShmPacketRingTest, ConcurrentWriters) {
+  constexpr int kWriters = 4;
+  constexpr int kPacketsPerWriter = 10000;
+  auto ring = ShmPacketRing::create(kCapacity);
+  std::atomic<int> running{kWriters};
+  std::vector<std::thread> writers;
+  for (int writer = 0; writer < kWriters; ++writer) {
+    writers.emplace_back([&, writer] {
+      auto buf = folly::IOBuf::copyBuffer(std::string(100 + writer, 'x'));
+      for (int idx = 0; idx < kPacketsPerWriter; ++idx) {
+        ring->write(true, buf.get(), 0x0800, writer, 0, {}, idx);
+      }
+      --running;
+    });
+  }
+
+  // Every packet that isn't dropped arrives whole, and each writer's
+  // packets arrive in the order it wrote them
+  std::vector<int64_t> last(kWriters, -1);
+  uint64_t received = 0;
+  auto check = [&](const CapturedPacket& pkt) {
+    const auto& rxPkt = pkt.pkt.get_rxpkt();
+    ASSERT_LE(0, rxPkt.srcPort);
+    ASSERT_GT(kWriters, rxPkt.srcPort);
+    EXPECT_EQ(100 + rxPkt.srcPort, rxPkt.packetData.length());
+    EXPECT_LT(last[rxPkt.srcPort], pkt.timestampUsec);
+    last[rxPkt.srcPort] = pkt.timestampUsec;
+    ++received;
+  };
+  CapturedPacket pkt;
+  while (running.load() > 0) {
+    if (ring->read(&pkt)) {
+      check(pkt);
+    }
+  }
+  // Each writer publishes its last packet before it stops running
+  while (ring->read(&pkt)) {
+    check(pkt);
+  }
+  for (auto& writer : writers) {
+    writer.join();
+  }
+  EXPECT_EQ(received, ring->getWritten());
+  EXPECT_EQ(kWriters * kPacketsPerWriter,
+            ring->getWritten() + ring->getDropped());
+}
+
+TEST(ShmPacketRingTest, Share) {
+  int fds[2];
+  folly::checkUnixError(socketpair(AF_UNIX, SOCK_STREAM, 0, fds),
+                        "failed to create socket pair");
+  auto consumer = ShmPacketRing::create(kCapacity);
+  consumer->sendTo(fds[0]);
+  auto producer = ShmPacketRing::receiveFrom(fds[1]);
+  close(fds[0]);
+  close(fds[1]);
+  EXPECT_EQ(kCapacity, producer->capacity());
+
+  std::vector<std::string> received;
+  auto callback = [&](CapturedPacket& pkt) {
+    received.push_back(pkt.pkt.get_txpkt().packetData.toStdString());
+  };
+
+  // Nothing is signalled until the consumer has drained the ring once
+  auto buf = folly::IOBuf::copyBuffer("first");
+  EXPECT_TRUE(producer->write(false, buf.get(), 0x0800, 0, 0, {}, 1));
+  EXPECT_FALSE(isSignalled(*consumer));
+  EXPECT_EQ(1, consumer->drain(callback));
+
+  // Now it is waiting, so the next packet wakes it, but only once
+  buf = folly::IOBuf::copyBuffer("second");
+  EXPECT_TRUE(producer->write(false, buf.get(), 0x0800, 0, 0, {}, 2));
+  EXPECT_TRUE(producer->write(false, buf.get(), 0x0800, 0, 0, {}, 3));
+  EXPECT_TRUE(isSignalled(*consumer));
+  EXPECT_EQ(2, consumer->drain(callback));
+  EXPECT_FALSE(isSignalled(*consumer));
+
+  std::vector<std::string> expected{"first", "second", "second"};
+  EXPECT_EQ(expected, received);
+}
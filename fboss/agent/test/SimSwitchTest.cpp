@@ -0,0 +1,111 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "fboss/agent/hw/sim/SimSwitch.h"
+
+#include "fboss/agent/state/RouteTable.h"
+#include "fboss/agent/state/RouteTableMap.h"
+#include "fboss/agent/state/RouteTableRib.h"
+#include "fboss/agent/state/RouteUpdater.h"
+#include "fboss/agent/state/StateDelta.h"
+#include "fboss/agent/state/SwitchState.h"
+#include "fboss/agent/test/TestUtils.h"
+
+#include <gtest/gtest.h>
+
+using namespace facebook::fboss;
+using folly::IPAddress;
+using std::chrono::microseconds;
+using std::shared_ptr;
+
+namespace {
+
+SimSwitch::HwModel makeModel() {
+  auto model = SimSwitch::HwModel::tomahawk();
+  for (auto& table : model.tables) {
+    table.latency = microseconds(0);
+  }
+  return model;
+}
+
+shared_ptr<SwitchState> addRoutes(
+    const shared_ptr<SwitchState>& state,
+    const std::vector<std::string>& prefixes,
+    const std::vector<std::string>& nhops) {
+  RouteUpdater updater(state->getRouteTables());
+  for (const auto& prefix : prefixes) {
+    updater.addRoute(
+        RouterID(0), IPAddress(prefix), 16, ClientID(1),
+        RouteNextHopEntry(makeNextHops(nhops), AdminDistance::EBGP));
+  }
+  auto newState = state->clone();
+  newState->resetRouteTables(updater.updateDone());
+  newState->publish();
+  return newState;
+}
+
+size_t numRoutesV4(const shared_ptr<SwitchState>& state) {
+  return state->getRouteTables()->getRouteTable(RouterID(0))->getRibV4()
+      ->size();
+}
+
+} // unnamed namespace
+
+TEST(SimSwitchTest, Instant) {
+  SimSwitch sim(nullptr, 10);
+  auto state = testStateA();
+  state->publish();
+  auto newState = addRoutes(state, {"10.10.0.0"}, {"10.0.0.22"});
+  EXPECT_EQ(newState, sim.stateChanged(StateDelta(state, newState)));
+  EXPECT_EQ(0, sim.getTableUsage(SimSwitch::LPM_V4));
+}
+
+TEST(SimSwitchTest, TableCapacity) {
+  auto model = makeModel();
+  model.tables[SimSwitch::LPM_V4].capacity = 2;
+  SimSwitch sim(nullptr, 10, model);
+  auto state = testStateA();
+  state->publish();
+
+  // Routes that don't fit are left out of the applied state, and the
+  // routes with the same next hops share an ECMP group
+  auto newState = addRoutes(
+      state, {"10.10.0.0", "10.11.0.0", "10.12.0.0"},
+      {"10.0.0.22", "10.0.55.22"});
+  auto applied = sim.stateChanged(StateDelta(state, newState));
+  EXPECT_EQ(numRoutesV4(state) + 2, numRoutesV4(applied));
+  EXPECT_EQ(2, sim.getTableUsage(SimSwitch::LPM_V4));
+  EXPECT_EQ(1, sim.getTableUsage(SimSwitch::ECMP_GROUPS));
+
+  // The applied state differs from the desired one, so the route left out
+  // is tried again with the next update
+  applied->publish();
+  auto retried = sim.stateChanged(StateDelta(applied, newState));
+  EXPECT_EQ(numRoutesV4(applied), numRoutesV4(retried));
+  EXPECT_EQ(2, sim.getTableUsage(SimSwitch::LPM_V4));
+
+  // Removing them frees their entries
+  auto emptied = sim.stateChanged(StateDelta(applied, state));
+  EXPECT_EQ(numRoutesV4(state), numRoutesV4(emptied));
+  EXPECT_EQ(0, sim.getTableUsage(SimSwitch::LPM_V4));
+  EXPECT_EQ(0, sim.getTableUsage(SimSwitch::ECMP_GROUPS));
+}
+
+TEST(SimSwitchTest, ProgrammingTime) {
+  auto model = makeModel();
+  model.tables[SimSwitch::LPM_V4].latency = microseconds(100);
+  model.tables[SimSwitch::LPM_V4].latencySigma = 0;
+  SimSwitch sim(nullptr, 10, model);
+  auto state = testStateA();
+  state->publish();
+  auto newState =
+      addRoutes(state, {"10.10.0.0", "10.11.0.0"}, {"10.0.0.22"});
+  sim.stateChanged(StateDelta(state, newState));
+  EXPECT_EQ(microseconds(200), sim.getProgrammingTime());
+}
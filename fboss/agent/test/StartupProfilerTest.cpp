@@ -0,0 +1,53 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "fboss/agent/StartupProfiler.h"
+
+#include <gtest/gtest.h>
+#include <algorithm>
+
+using namespace facebook::fboss;
+using std::chrono::milliseconds;
+
+TEST(StartupProfiler, RecordPhases) {
+  StartupProfiler profiler;
+  auto now = StartupProfiler::Clock::now();
+  profiler.record("outer", now, now + milliseconds(30));
+  profiler.record("inner", now + milliseconds(10), now + milliseconds(20));
+
+  auto phases = profiler.getPhases();
+  ASSERT_EQ(2, phases.size());
+  EXPECT_EQ("outer", phases[0].name);
+  EXPECT_EQ(milliseconds(30), phases[0].duration);
+  EXPECT_EQ("inner", phases[1].name);
+  EXPECT_EQ(milliseconds(10), phases[1].duration);
+  EXPECT_EQ(milliseconds(10), phases[1].start - phases[0].start);
+  EXPECT_NE(0, phases[0].threadId);
+
+  auto trace = profiler.toChromeTrace();
+  const auto& events = trace["traceEvents"];
+  ASSERT_EQ(2, events.size());
+  EXPECT_EQ("outer", events[0]["name"].asString());
+  EXPECT_EQ("X", events[0]["ph"].asString());
+  EXPECT_EQ(30000, events[0]["dur"].asInt());
+  EXPECT_EQ(
+      events[0]["ts"].asInt() + 10000, events[1]["ts"].asInt());
+}
+
+TEST(StartupProfiler, Scope) {
+  {
+    StartupProfiler::Scope scope("StartupProfilerTest.scope");
+  }
+  auto phases = StartupProfiler::get()->getPhases();
+  auto it = std::find_if(
+      phases.begin(), phases.end(), [](const StartupProfiler::Phase& phase) {
+        return phase.name == "StartupProfilerTest.scope";
+      });
+  EXPECT_NE(phases.end(), it);
+}
@@ -0,0 +1,158 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "fboss/agent/StateUpdateRecorder.h"
+
+#include "fboss/agent/AddressUtil.h"
+#include "fboss/agent/FbossError.h"
+#include "fboss/agent/hw/mock/MockRxPacket.h"
+
+#include <folly/FileUtil.h>
+#include <folly/experimental/TestUtil.h>
+
+#include <gtest/gtest.h>
+
+using namespace facebook::fboss;
+using facebook::network::toBinaryAddress;
+using folly::IPAddress;
+
+namespace {
+
+IpPrefix makePrefix(const std::string& ip, int16_t length) {
+  IpPrefix prefix;
+  prefix.ip = toBinaryAddress(IPAddress(ip));
+  prefix.prefixLength = length;
+  return prefix;
+}
+
+UnicastRoute makeRoute(const std::string& ip, const std::string& nhop) {
+  UnicastRoute route;
+  route.dest = makePrefix(ip, 24);
+  route.nextHopAddrs.push_back(toBinaryAddress(IPAddress(nhop)));
+  return route;
+}
+
+std::vector<StateUpdateRecord> readRecords(const std::string& path) {
+  std::string data;
+  EXPECT_TRUE(folly::readFile(path.c_str(), data));
+  bool truncated = true;
+  auto records =
+      decodeStateUpdateRecords(folly::StringPiece(data), &truncated);
+  EXPECT_FALSE(truncated);
+  return records;
+}
+
+} // unnamed namespace
+
+TEST(StateUpdateRecorder, roundTrip) {
+  folly::test::TemporaryDirectory tmpDir;
+  auto path = (tmpDir.path() / "record").string();
+  {
+    StateUpdateRecorder recorder(path, 1 << 20, 2);
+    recorder.recordConfig("{\"version\": 1}");
+    recorder.recordRoutes(
+        StateUpdateRecordType::SYNC_FIB, 786, RouterID(0),
+        {makeRoute("20.0.0.0", "10.0.0.1"), makeRoute("20.0.1.0", "10.0.0.2")});
+    recorder.recordDeletedRoutes(
+        786, RouterID(1), {makePrefix("20.0.0.0", 24)});
+    auto pkt = MockRxPacket::fromHex("01 02 03 04");
+    pkt->setSrcPort(PortID(5));
+    pkt->setSrcVlan(VlanID(6));
+    recorder.recordPacket(pkt.get());
+    recorder.recordLinkState(PortID(7), true);
+    recorder.recordStateUpdate("update routes", StateUpdateClass::ROUTE);
+  }
+
+  auto records = readRecords(path);
+  ASSERT_EQ(6, records.size());
+  EXPECT_EQ(StateUpdateRecordType::CONFIG, records[0].type);
+  EXPECT_EQ("{\"version\": 1}", records[0].name);
+
+  EXPECT_EQ(StateUpdateRecordType::SYNC_FIB, records[1].type);
+  EXPECT_EQ(786, records[1].client);
+  ASSERT_EQ(2, records[1].routes.size());
+  EXPECT_EQ(makeRoute("20.0.1.0", "10.0.0.2"), records[1].routes[1]);
+
+  EXPECT_EQ(StateUpdateRecordType::DELETE_ROUTES, records[2].type);
+  EXPECT_EQ(RouterID(1), records[2].vrf);
+  ASSERT_EQ(1, records[2].prefixes.size());
+  EXPECT_EQ(makePrefix("20.0.0.0", 24), records[2].prefixes[0]);
+
+  EXPECT_EQ(StateUpdateRecordType::PACKET, records[3].type);
+  EXPECT_EQ(PortID(5), records[3].port);
+  EXPECT_EQ(VlanID(6), records[3].vlan);
+  EXPECT_EQ(std::string("\x01\x02\x03\x04"), records[3].packet);
+
+  EXPECT_EQ(StateUpdateRecordType::LINK_STATE, records[4].type);
+  EXPECT_EQ(PortID(7), records[4].port);
+  EXPECT_TRUE(records[4].up);
+
+  EXPECT_EQ(StateUpdateRecordType::STATE_UPDATE, records[5].type);
+  EXPECT_EQ("update routes", records[5].name);
+  EXPECT_EQ(StateUpdateClass::ROUTE, records[5].updateClass);
+  EXPECT_LE(records[0].timestampUs, records[5].timestampUs);
+}
+
+TEST(StateUpdateRecorder, rotates) {
+  folly::test::TemporaryDirectory tmpDir;
+  auto path = (tmpDir.path() / "record").string();
+  {
+    // Every record fills a file
+    StateUpdateRecorder recorder(path, 1, 3);
+    recorder.recordConfig("config");
+    for (int i = 0; i < 4; ++i) {
+      recorder.recordLinkState(PortID(i), true);
+    }
+  }
+
+  // The oldest files are gone, and the ones kept each start with the config
+  auto records = readRecords(path);
+  ASSERT_EQ(2, records.size());
+  EXPECT_EQ(StateUpdateRecordType::CONFIG, records[0].type);
+  EXPECT_EQ("config", records[0].name);
+  EXPECT_EQ(PortID(3), records[1].port);
+  records = readRecords(path + ".1");
+  ASSERT_EQ(2, records.size());
+  EXPECT_EQ(StateUpdateRecordType::CONFIG, records[0].type);
+  EXPECT_EQ(PortID(2), records[1].port);
+  EXPECT_TRUE(readRecords(path + ".2").size() > 0);
+  std::string data;
+  EXPECT_FALSE(folly::readFile((path + ".3").c_str(), data));
+
+  // The file of the last run is kept when the next one starts
+  { StateUpdateRecorder recorder(path, 1 << 20, 3); }
+  EXPECT_EQ(0, readRecords(path).size());
+  records = readRecords(path + ".1");
+  ASSERT_EQ(2, records.size());
+  EXPECT_EQ(PortID(3), records[1].port);
+}
+
+TEST(StateUpdateRecorder, truncated) {
+  folly::test::TemporaryDirectory tmpDir;
+  auto path = (tmpDir.path() / "record").string();
+  {
+    StateUpdateRecorder recorder(path, 1 << 20, 1);
+    recorder.recordLinkState(PortID(1), false);
+    recorder.recordLinkState(PortID(2), true);
+  }
+  std::string data;
+  ASSERT_TRUE(folly::readFile(path.c_str(), data));
+  data.resize(data.size() - 3);
+  bool truncated = false;
+  auto records =
+      decodeStateUpdateRecords(folly::StringPiece(data), &truncated);
+  EXPECT_TRUE(truncated);
+  ASSERT_EQ(1, records.size());
+  EXPECT_EQ(PortID(1), records[0].port);
+  EXPECT_FALSE(records[0].up);
+
+  EXPECT_THROW(
+      decodeStateUpdateRecords(folly::StringPiece("not a record file")),
+      FbossError);
+}
@@ -14,6 +14,7 @@
 #include "fboss/agent/hw/mock/MockPlatform.h"
 #include "fboss/agent/gen-cpp2/switch_config_types.h"
 
+#include <folly/Format.h>
 #include <folly/IPAddressV4.h>
 #include <folly/IPAddressV6.h>
 #include <folly/IPAddress.h>
@@ -169,3 +170,67 @@ TEST(StaticRoutes, configureUnconfigure) {
   // No routes and hence no routing table
   ASSERT_EQ(nullptr, t2);
 }
+
+TEST(StaticRoutes, bulkLoad) {
+  auto platform = createMockPlatform();
+  auto stateV0 = make_shared<SwitchState>();
+
+  // Listed out of order, so that the routes have to be sorted to load
+  cfg::SwitchConfig config;
+  config.__isset.staticRoutesToNull = true;
+  config.__isset.staticRoutesWithNhops = true;
+  const int kNumRoutes = 1000;
+  config.staticRoutesToNull.resize(kNumRoutes);
+  for (int i = 0; i < kNumRoutes; ++i) {
+    auto n = kNumRoutes - 1 - i;
+    config.staticRoutesToNull[i].prefix = folly::sformat(
+        "10.{}.{}.0/24", n / 256, n % 256);
+  }
+  // A route with next hops for a prefix also sent to null takes over
+  config.staticRoutesWithNhops.resize(1);
+  config.staticRoutesWithNhops[0].prefix = "10.0.0.0/24";
+  config.staticRoutesWithNhops[0].nexthops.resize(1);
+  config.staticRoutesWithNhops[0].nexthops[0] = "10.0.1.1";
+
+  auto stateV1 = publishAndApplyConfig(stateV0, &config, platform.get());
+  ASSERT_NE(nullptr, stateV1);
+  auto rib = stateV1->getRouteTables()->getRouteTableIf(RouterID(0))
+    ->getRibV4();
+  EXPECT_EQ(kNumRoutes, rib->size());
+  auto route = rib->exactMatch(RouteV4::Prefix{IPAddressV4("10.0.0.0"), 24});
+  ASSERT_NE(nullptr, route);
+  EXPECT_TRUE(route->isResolved());
+  EXPECT_EQ(
+      route->getForwardInfo(),
+      RouteNextHopEntry(DROP, AdminDistance::MAX_ADMIN_DISTANCE));
+  EXPECT_FALSE(route->getEntryForClient(kStaticClient)->getNextHopSet()
+               .empty());
+
+  // Dropping most of them leaves just the rest
+  auto newConfig = config;
+  newConfig.staticRoutesToNull.resize(10);
+  auto stateV2 = publishAndApplyConfig(stateV1, &newConfig, platform.get(),
+      &config);
+  ASSERT_NE(nullptr, stateV2);
+  rib = stateV2->getRouteTables()->getRouteTableIf(RouterID(0))->getRibV4();
+  EXPECT_EQ(11, rib->size());
+  route = rib->exactMatch(RouteV4::Prefix{IPAddressV4("10.0.0.0"), 24});
+  ASSERT_NE(nullptr, route);
+  EXPECT_TRUE(route->isUnresolvable());
+}
+
+TEST(StaticRoutes, duplicatePrefix) {
+  auto platform = createMockPlatform();
+  auto stateV0 = make_shared<SwitchState>();
+
+  cfg::SwitchConfig config;
+  config.__isset.staticRoutesToNull = true;
+  config.__isset.staticRoutesToCPU = true;
+  config.staticRoutesToNull.resize(2);
+  config.staticRoutesToNull[0].prefix = "1.1.1.1/32";
+  config.staticRoutesToNull[1].prefix = "2.2.2.2/32";
+  config.staticRoutesToCPU.resize(1);
+  config.staticRoutesToCPU[0].prefix = "1.1.1.1/32";
+  EXPECT_THROW(
+      publishAndApplyConfig(stateV0, &config, platform.get()), FbossError);
+}
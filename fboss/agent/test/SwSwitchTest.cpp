@@ -8,9 +8,14 @@
  *
  */
 
+#include <algorithm>
+#include <cstring>
 #include <gtest/gtest.h>
+#include <folly/synchronization/Baton.h>
 
+#include "fboss/agent/FbossError.h"
 #include "fboss/agent/Main.h"
+#include "fboss/agent/StateObserver.h"
 #include "fboss/agent/SwitchStats.h"
 #include "fboss/agent/PortStats.h"
 #include "fboss/agent/state/Port.h"
@@ -79,3 +84,131 @@ TEST_F(SwSwitchTest, UpdateStatsExceptionCounter){
     SwitchStats::kCounterPrefix + "update_stats_exceptions.sum.60", 1);
 
 }
+
+TEST_F(SwSwitchTest, UrgentStateUpdatesFirst) {
+  // Hold the update thread so that all the updates below are pending at once
+  folly::Baton<> started;
+  folly::Baton<> release;
+  sw->getUpdateEvb()->runInEventBaseThread([&] {
+    started.post();
+    release.wait();
+  });
+  started.wait();
+
+  std::vector<string> applied;
+  auto recordFn = [&applied](string name) {
+    return [&applied, name](const std::shared_ptr<SwitchState>& /*state*/) {
+      applied.push_back(name);
+      return std::shared_ptr<SwitchState>();
+    };
+  };
+  sw->updateState("route", recordFn("route"), StateUpdateClass::ROUTE);
+  sw->updateState("default", recordFn("default"));
+  sw->updateState(
+      "neighbor", recordFn("neighbor"), StateUpdateClass::NEIGHBOR);
+  sw->updateState("link", recordFn("link"), StateUpdateClass::LINK);
+  release.post();
+  waitForStateUpdates(sw);
+
+  std::vector<string> expected{"link", "neighbor", "default", "route"};
+  EXPECT_EQ(expected, applied);
+}
+
+TEST_F(SwSwitchTest, UpdateStateAsync) {
+  // Hold the update thread so that the update is still pending below
+  folly::Baton<> started;
+  folly::Baton<> release;
+  sw->getUpdateEvb()->runInEventBaseThread([&] {
+    started.post();
+    release.wait();
+  });
+  started.wait();
+
+  auto oldGeneration = sw->getState()->getGeneration();
+  auto updated = sw->updateStateAsync(
+      "async update",
+      [](const std::shared_ptr<SwitchState>& state) {
+        return state->clone();
+      });
+  auto failed = sw->updateStateAsync(
+      "failed async update",
+      [](const std::shared_ptr<SwitchState>& /*state*/)
+          -> std::shared_ptr<SwitchState> {
+        throw FbossError("update failed");
+      });
+  EXPECT_FALSE(updated.isReady());
+  EXPECT_FALSE(failed.isReady());
+  release.post();
+
+  updated.get();
+  EXPECT_LT(oldGeneration, sw->getState()->getGeneration());
+  EXPECT_THROW(failed.get(), FbossError);
+}
+
+namespace {
+class RecordingObserver : public StateObserver {
+ public:
+  explicit RecordingObserver(SwSwitch* sw) : sw_(sw) {}
+
+  void stateUpdated(const StateDelta& delta) override {
+    generations.push_back(delta.newState()->getGeneration());
+    onUpdateThread =
+        onUpdateThread || sw_->getUpdateEvb()->isInEventBaseThread();
+  }
+
+  std::vector<uint32_t> generations;
+  bool onUpdateThread{false};
+
+ private:
+  SwSwitch* sw_;
+};
+} // unnamed namespace
+
+TEST_F(SwSwitchTest, AsyncStateObserver) {
+  RecordingObserver observer(sw);
+  sw->registerStateObserver(
+      &observer, "RecordingObserver", StateObserverDispatch::ASYNC);
+
+  auto cloneFn = [](const std::shared_ptr<SwitchState>& state) {
+    return state->clone();
+  };
+  for (int i = 0; i < 3; ++i) {
+    sw->updateStateNoCoalescing("clone", cloneFn);
+  }
+  auto lastGeneration = waitForStateUpdates(sw)->getGeneration();
+  // Unregistering waits for the deltas already queued for the observer
+  sw->unregisterStateObserver(&observer);
+
+  ASSERT_FALSE(observer.generations.empty());
+  EXPECT_EQ(lastGeneration, observer.generations.back());
+  EXPECT_TRUE(std::is_sorted(
+      observer.generations.begin(), observer.generations.end()));
+  EXPECT_FALSE(observer.onUpdateThread);
+}
+
+TEST_F(SwSwitchTest, TxPacketBatch) {
+  using ::testing::_;
+  auto makePkt = [&] {
+    auto pkt = sw->allocatePacket(68);
+    memset(pkt->buf()->writableData(), 0, pkt->buf()->length());
+    return pkt;
+  };
+  {
+    SwSwitch::TxPacketBatch batch(sw);
+    EXPECT_HW_CALL(sw, sendPacketOutOfPort_(_, _)).Times(0);
+    EXPECT_HW_CALL(sw, sendPacketSwitched_(_)).Times(0);
+    sw->sendPacketOutOfPort(makePkt(), PortID(1));
+    sw->sendPacketOutOfPort(makePkt(), PortID(2));
+    sw->sendPacketSwitched(makePkt());
+    // Nothing is sent until the batch goes out of scope
+    ::testing::Mock::VerifyAndClearExpectations(getMockHw(sw));
+    EXPECT_HW_CALL(sw, sendPacketOutOfPort_(_, _)).Times(2);
+    EXPECT_HW_CALL(sw, sendPacketSwitched_(_)).Times(1);
+  }
+  ::testing::Mock::VerifyAndClearExpectations(getMockHw(sw));
+
+  // Without a batch, packets go out straight away
+  EXPECT_HW_CALL(sw, sendPacketSwitched_(_)).Times(1);
+  sw->sendPacketSwitched(makePkt());
+  ::testing::Mock::VerifyAndClearExpectations(getMockHw(sw));
+}
@@ -0,0 +1,260 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include <folly/Benchmark.h>
+#include <folly/Format.h>
+#include "fboss/agent/Utils.h"
+#include "fboss/agent/state/ArpTable.h"
+#include "fboss/agent/state/NodeAllocator.h"
+#include "fboss/agent/state/NodeMapDelta.h"
+#include "fboss/agent/state/NodeMapDelta-defs.h"
+#include "fboss/agent/state/Route.h"
+#include "fboss/agent/state/RouteDelta.h"
+#include "fboss/agent/state/RouteTable.h"
+#include "fboss/agent/state/RouteTableMap.h"
+#include "fboss/agent/state/RouteTableRib.h"
+#include "fboss/agent/state/RouteUpdater.h"
+#include "fboss/agent/state/StateDelta.h"
+#include "fboss/agent/state/SwitchState.h"
+#include "fboss/agent/state/Vlan.h"
+#include "fboss/agent/state/VlanMap.h"
+
+#include <algorithm>
+#include <iostream>
+#include <map>
+
+/*
+ * Micro-benchmarks for the basic SwitchState operations that every state
+ * update goes through: cloning, modify() on a node deep in the tree, walking
+ * a StateDelta and serializing to and from folly::dynamic.
+ *
+ * Each benchmark is run against states holding 1k to 1M ARP entries or
+ * routes.  Along with the time per operation, the number of node allocations
+ * made per operation (as counted by NodeAllocationStats) is printed once all
+ * the benchmarks have run.
+ */
+
+using namespace facebook::fboss;
+using folly::IPAddressV4;
+using folly::MacAddress;
+using std::make_shared;
+using std::shared_ptr;
+
+namespace {
+
+const VlanID kVlan{1};
+const RouterID kRouter{0};
+
+// States used by the benchmarks, built on first use for each size
+std::map<size_t, shared_ptr<SwitchState>> states;
+// Node allocations per operation, by benchmark
+std::map<std::string, double> allocationsPerOp;
+
+IPAddressV4 nthAddress(size_t n) {
+  return IPAddressV4::fromLongHBO(0x0a000000 + n);
+}
+
+shared_ptr<SwitchState> buildState(size_t numEntries) {
+  auto state = make_shared<SwitchState>();
+
+  auto vlan = make_shared<Vlan>(kVlan, "Vlan1");
+  auto arpTable = make_shared<ArpTable>();
+  for (size_t n = 0; n < numEntries; ++n) {
+    arpTable->addEntry(
+        nthAddress(n),
+        MacAddress::fromHBO(0x020000000000 + n),
+        PortDescriptor(PortID(1)),
+        InterfaceID(1));
+  }
+  vlan->setArpTable(arpTable);
+  state->addVlan(vlan);
+
+  RouteUpdater updater(state->getRouteTables());
+  for (size_t n = 0; n < numEntries; ++n) {
+    updater.addRoute(
+        kRouter,
+        nthAddress(n),
+        32,
+        StdClientIds2ClientID(StdClientIds::STATIC_ROUTE),
+        RouteNextHopEntry(RouteForwardAction::DROP,
+                          AdminDistance::STATIC_ROUTE));
+  }
+  state->resetRouteTables(updater.updateDone());
+
+  state->publish();
+  return state;
+}
+
+const shared_ptr<SwitchState>& getState(size_t numEntries) {
+  auto& state = states[numEntries];
+  if (!state) {
+    state = buildState(numEntries);
+  }
+  return state;
+}
+
+uint64_t totalNodeAllocations() {
+  uint64_t total = 0;
+  NodeAllocationStats::forEach(
+      [&](const std::string& /*name*/, const NodeAllocationCounters& c) {
+        total += c.allocated.load(std::memory_order_relaxed);
+      });
+  return total;
+}
+
+/*
+ * Records the node allocations made during the lifetime of the object.
+ * Create it after the BENCHMARK_SUSPEND block that sets up the benchmark so
+ * only the timed operations are counted.
+ */
+class AllocationCounter {
+ public:
+  AllocationCounter(const char* benchmark, size_t numEntries, unsigned iters)
+      : name_(folly::sformat("{}({})", benchmark, numEntries)),
+        iters_(iters),
+        start_(totalNodeAllocations()) {}
+  ~AllocationCounter() {
+    allocationsPerOp[name_] =
+        double(totalNodeAllocations() - start_) / std::max(iters_, 1u);
+  }
+
+ private:
+  std::string name_;
+  unsigned iters_;
+  uint64_t start_;
+};
+
+} // unnamed namespace
+
+void SwitchStateClone(unsigned iters, size_t numEntries) {
+  shared_ptr<SwitchState> state;
+  BENCHMARK_SUSPEND {
+    state = getState(numEntries);
+  }
+  AllocationCounter counter("SwitchStateClone", numEntries, iters);
+  for (unsigned i = 0; i < iters; ++i) {
+    auto cloned = state->clone();
+    folly::doNotOptimizeAway(cloned);
+  }
+}
+
+void VlanModify(unsigned iters, size_t numEntries) {
+  shared_ptr<SwitchState> orig;
+  BENCHMARK_SUSPEND {
+    orig = getState(numEntries);
+  }
+  AllocationCounter counter("VlanModify", numEntries, iters);
+  for (unsigned i = 0; i < iters; ++i) {
+    // Clone the VLAN and its ARP table, and add an entry to it, as the
+    // neighbor updater does for each new neighbor.
+    auto state = orig;
+    auto arpTable = state->getVlans()->getVlan(kVlan)->getArpTable()->modify(
+        kVlan, &state);
+    arpTable->addEntry(
+        nthAddress(numEntries),
+        MacAddress::fromHBO(0x020000000000 + numEntries),
+        PortDescriptor(PortID(1)),
+        InterfaceID(1));
+    folly::doNotOptimizeAway(state);
+  }
+}
+
+void RouteTableRibModify(unsigned iters, size_t numEntries) {
+  shared_ptr<SwitchState> orig;
+  BENCHMARK_SUSPEND {
+    orig = getState(numEntries);
+  }
+  AllocationCounter counter("RouteTableRibModify", numEntries, iters);
+  for (unsigned i = 0; i < iters; ++i) {
+    auto state = orig;
+    auto rib = state->getRouteTables()->getRouteTable(kRouter)->getRibV4();
+    auto clonedRib = rib->modify(kRouter, &state);
+    folly::doNotOptimizeAway(clonedRib);
+  }
+}
+
+void NodeMapDeltaIteration(unsigned iters, size_t numEntries) {
+  shared_ptr<SwitchState> oldState;
+  shared_ptr<SwitchState> newState;
+  BENCHMARK_SUSPEND {
+    // Compare against an empty state, so every route and ARP entry is an
+    // added entry in the delta.
+    oldState = make_shared<SwitchState>();
+    oldState->publish();
+    newState = getState(numEntries);
+  }
+  AllocationCounter counter("NodeMapDeltaIteration", numEntries, iters);
+  for (unsigned i = 0; i < iters; ++i) {
+    StateDelta delta(oldState, newState);
+    size_t numChanged = 0;
+    for (const auto& vlanDelta : delta.getVlansDelta()) {
+      for (const auto& arpDelta : vlanDelta.getArpDelta()) {
+        folly::doNotOptimizeAway(arpDelta.getNew());
+        ++numChanged;
+      }
+    }
+    for (const auto& rtDelta : delta.getRouteTablesDelta()) {
+      for (const auto& routeDelta : rtDelta.getRoutesV4Delta()) {
+        folly::doNotOptimizeAway(routeDelta.getNew());
+        ++numChanged;
+      }
+    }
+    CHECK_EQ(numChanged, 2 * numEntries);
+  }
+}
+
+void JsonRoundTrip(unsigned iters, size_t numEntries) {
+  shared_ptr<SwitchState> state;
+  BENCHMARK_SUSPEND {
+    state = getState(numEntries);
+  }
+  AllocationCounter counter("JsonRoundTrip", numEntries, iters);
+  for (unsigned i = 0; i < iters; ++i) {
+    auto parsed = SwitchState::fromFollyDynamic(state->toFollyDynamic());
+    folly::doNotOptimizeAway(parsed);
+  }
+}
+
+BENCHMARK_PARAM(SwitchStateClone, 1000);
+BENCHMARK_PARAM(SwitchStateClone, 10000);
+BENCHMARK_PARAM(SwitchStateClone, 100000);
+BENCHMARK_PARAM(SwitchStateClone, 1000000);
+BENCHMARK_DRAW_LINE();
+BENCHMARK_PARAM(VlanModify, 1000);
+BENCHMARK_PARAM(VlanModify, 10000);
+BENCHMARK_PARAM(VlanModify, 100000);
+BENCHMARK_PARAM(VlanModify, 1000000);
+BENCHMARK_DRAW_LINE();
+BENCHMARK_PARAM(RouteTableRibModify, 1000);
+BENCHMARK_PARAM(RouteTableRibModify, 10000);
+BENCHMARK_PARAM(RouteTableRibModify, 100000);
+BENCHMARK_PARAM(RouteTableRibModify, 1000000);
+BENCHMARK_DRAW_LINE();
+BENCHMARK_PARAM(NodeMapDeltaIteration, 1000);
+BENCHMARK_PARAM(NodeMapDeltaIteration, 10000);
+BENCHMARK_PARAM(NodeMapDeltaIteration, 100000);
+BENCHMARK_PARAM(NodeMapDeltaIteration, 1000000);
+BENCHMARK_DRAW_LINE();
+BENCHMARK_PARAM(JsonRoundTrip, 1000);
+BENCHMARK_PARAM(JsonRoundTrip, 10000);
+BENCHMARK_PARAM(JsonRoundTrip, 100000);
+BENCHMARK_PARAM(JsonRoundTrip, 1000000);
+
+int main(int argc, char** argv) {
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+
+  folly::runBenchmarks();
+
+  std::cout << "\nNode allocations per operation:\n";
+  for (const auto& entry : allocationsPerOp) {
+    std::cout << folly::sformat("  {:<36} {:>12.1f}\n",
+                                entry.first, entry.second);
+  }
+  return 0;
+}
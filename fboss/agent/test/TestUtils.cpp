@@ -237,9 +237,10 @@ MockPlatform* getMockPlatform(std::unique_ptr<SwSwitch>& sw) {
 }
 
 std::shared_ptr<SwitchState> waitForStateUpdates(SwSwitch* sw) {
-  // All StateUpdates scheduled from this thread will be applied in order,
-  // so we can simply perform a blocking no-op update.  When it is done
-  // we can be sure that all previously scheduled updates have also been
+  // StateUpdates of the same class are applied in order, and the ROUTE
+  // class is applied after any earlier update of the other classes, so we
+  // can simply perform a blocking no-op ROUTE update.  When it is done we
+  // can be sure that all previously scheduled updates have also been
   // applied.
   std::shared_ptr<SwitchState> snapshot{nullptr};
   auto snapshotUpdate = [&snapshot](const shared_ptr<SwitchState>& state)
@@ -248,7 +249,8 @@ std::shared_ptr<SwitchState> waitForStateUpdates(SwSwitch* sw) {
     snapshot = state;
     return nullptr;
   };
-  sw->updateStateBlocking("waitForStateUpdates", snapshotUpdate);
+  sw->updateStateBlocking(
+      "waitForStateUpdates", snapshotUpdate, StateUpdateClass::ROUTE);
   return snapshot;
 }
 
@@ -0,0 +1,103 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "fboss/agent/ThreadHeartbeat.h"
+
+#include <folly/io/async/ScopedEventBaseThread.h>
+#include <gtest/gtest.h>
+
+#include <future>
+
+using namespace facebook::fboss;
+using namespace std::chrono;
+
+namespace {
+
+void noStats(const EventLoopStats& /*stats*/) {}
+
+} // unnamed namespace
+
+TEST(ThreadHeartbeat, Activity) {
+  folly::ScopedEventBaseThread thread;
+  ThreadHeartbeat heartbeat(thread.getEventBase(), "activityThread", 10,
+                            noStats);
+  std::string outer;
+  std::string inner;
+  thread.getEventBase()->runInEventBaseThreadAndWait([&] {
+    ThreadHeartbeat::Activity activity("outer");
+    {
+      ThreadHeartbeat::Activity nested("inner");
+      inner = heartbeat.getActivity();
+    }
+    outer = heartbeat.getActivity();
+  });
+  EXPECT_EQ("inner", inner);
+  EXPECT_EQ("outer", outer);
+  EXPECT_EQ("", heartbeat.getActivity());
+
+  // No effect on a thread without a heartbeat
+  ThreadHeartbeat::Activity activity("elsewhere");
+  EXPECT_EQ("", heartbeat.getActivity());
+}
+
+TEST(ThreadHeartbeatWatchdog, ReportsStall) {
+  folly::ScopedEventBaseThread thread;
+  ThreadHeartbeat heartbeat(thread.getEventBase(), "stallThread", 10,
+                            noStats);
+  std::promise<ThreadStall> stalled;
+  std::atomic<int> stalls{0};
+  ThreadHeartbeatWatchdog watchdog(100, [&](const ThreadStall& stall) {
+    if (stalls++ == 0) {
+      stalled.set_value(stall);
+    }
+  });
+  watchdog.watch(&heartbeat);
+
+  thread.getEventBase()->runInEventBaseThread([] {
+    ThreadHeartbeat::Activity activity("slow update");
+    EventTrace::record(EventTrace::Event::STATE_UPDATE_START, 42);
+    std::this_thread::sleep_for(seconds(1));
+  });
+  auto future = stalled.get_future();
+  ASSERT_EQ(std::future_status::ready, future.wait_for(seconds(5)));
+  auto stall = future.get();
+  EXPECT_EQ("stallThread", stall.threadName);
+  EXPECT_EQ("slow update", stall.activity);
+  EXPECT_EQ(1, stall.count);
+  EXPECT_LE(milliseconds(100), stall.duration);
+  EXPECT_FALSE(stall.stack.empty());
+  ASSERT_FALSE(stall.events.empty());
+  EXPECT_EQ(EventTrace::Event::STATE_UPDATE_START,
+            stall.events.back().event);
+  EXPECT_EQ(42, stall.events.back().arg0);
+
+  // Reported once, however long the stall goes on
+  thread.getEventBase()->runInEventBaseThreadAndWait([] {});
+  EXPECT_EQ(1, stalls);
+  EXPECT_EQ(1, heartbeat.getStalls());
+}
+
+TEST(ThreadHeartbeatWatchdog, NoStall) {
+  folly::ScopedEventBaseThread thread;
+  ThreadHeartbeat heartbeat(thread.getEventBase(), "busyThread", 10,
+                            noStats);
+  std::atomic<int> stalls{0};
+  ThreadHeartbeatWatchdog watchdog(100, [&](const ThreadStall& /*stall*/) {
+    ++stalls;
+  });
+  watchdog.watch(&heartbeat);
+  // Short callbacks don't hold up the heartbeat for long
+  for (int i = 0; i < 20; ++i) {
+    thread.getEventBase()->runInEventBaseThreadAndWait([] {
+      std::this_thread::sleep_for(milliseconds(10));
+    });
+  }
+  EXPECT_EQ(0, stalls);
+  EXPECT_EQ(0, heartbeat.getStalls());
+}
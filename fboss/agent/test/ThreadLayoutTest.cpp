@@ -0,0 +1,92 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "fboss/agent/ThreadLayout.h"
+
+#include "fboss/agent/FbossError.h"
+
+#include <folly/system/ThreadName.h>
+
+#include <gtest/gtest.h>
+
+#include <thread>
+
+using namespace facebook::fboss;
+using std::chrono::steady_clock;
+
+TEST(ThreadLayout, parseCpuList) {
+  EXPECT_EQ(std::vector<int>(), ThreadLayout::parseCpuList(""));
+  EXPECT_EQ(std::vector<int>({2}), ThreadLayout::parseCpuList("2"));
+  EXPECT_EQ(
+      std::vector<int>({0, 2, 3, 4, 7}),
+      ThreadLayout::parseCpuList("0, 2-4,7"));
+  EXPECT_THROW(ThreadLayout::parseCpuList("4-2"), FbossError);
+  EXPECT_THROW(ThreadLayout::parseCpuList("-1"), std::exception);
+  EXPECT_THROW(ThreadLayout::parseCpuList("two"), std::exception);
+}
+
+TEST(ThreadLayout, policies) {
+  ThreadLayout layout(
+      "fbossUpdateThread=cpus:2-3,6,nice:-5;"
+      "fbossRxWorker*=cpus:4;"
+      "fbossLacpThread=fifo:40",
+      "0-1");
+
+  // Names are compared as the kernel keeps them
+  const auto& update = layout.policyFor("fbossUpdateThre");
+  EXPECT_EQ(std::vector<int>({2, 3, 6}), update.cpus);
+  EXPECT_EQ(0, update.fifoPriority);
+  ASSERT_TRUE(update.nice.hasValue());
+  EXPECT_EQ(-5, *update.nice);
+  EXPECT_EQ(&update, &layout.policyFor("fbossUpdateThread"));
+
+  EXPECT_EQ(std::vector<int>({4}), layout.policyFor("fbossRxWorker3").cpus);
+
+  const auto& lacp = layout.policyFor("fbossLacpThread");
+  EXPECT_EQ(40, lacp.fifoPriority);
+  EXPECT_TRUE(lacp.cpus.empty());
+
+  const auto& other = layout.policyFor("bcmLINK.0");
+  EXPECT_EQ(std::vector<int>({0, 1}), other.cpus);
+  EXPECT_FALSE(other.nice.hasValue());
+
+  EXPECT_TRUE(ThreadLayout("", "").policyFor("fbossBgThread").empty());
+}
+
+TEST(ThreadLayout, badLayouts) {
+  EXPECT_THROW(ThreadLayout("fbossBgThread", ""), FbossError);
+  EXPECT_THROW(ThreadLayout("=cpus:1", ""), FbossError);
+  EXPECT_THROW(ThreadLayout("fbossBgThread=cpu:1", ""), FbossError);
+  EXPECT_THROW(ThreadLayout("fbossBgThread=fifo:100", ""), FbossError);
+  EXPECT_THROW(ThreadLayout("", "1-"), std::exception);
+}
+
+TEST(ThreadLayout, cpuUsage) {
+  ThreadLayout layout("", "");
+  layout.update(steady_clock::now());
+  EXPECT_TRUE(layout.getCpuPercent().empty());
+
+  std::thread spinner([] {
+    folly::setThreadName("layoutSpinner");
+    auto end = steady_clock::now() + std::chrono::milliseconds(200);
+    while (steady_clock::now() < end) {
+    }
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  layout.update(steady_clock::now());
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  layout.update(steady_clock::now());
+  spinner.join();
+  ASSERT_EQ(1, layout.getCpuPercent().count("layoutSpinner"));
+  EXPECT_LT(0, layout.getCpuPercent().at("layoutSpinner"));
+
+  // Threads that have exited are forgotten
+  layout.update(steady_clock::now());
+  EXPECT_EQ(0, layout.getCpuPercent().count("layoutSpinner"));
+}
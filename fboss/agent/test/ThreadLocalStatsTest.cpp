@@ -0,0 +1,112 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "common/stats/ThreadCachedServiceData.h"
+
+#include <gtest/gtest.h>
+
+#include <thread>
+#include <vector>
+
+using namespace facebook;
+using namespace facebook::stats;
+
+namespace {
+
+using TLStats = ThreadCachedServiceData::ThreadLocalStatsMap;
+
+void publish() {
+  ThreadCachedServiceData::get()->publishStats();
+}
+
+} // unnamed namespace
+
+TEST(ThreadLocalStatsTest, Timeseries) {
+  std::vector<std::thread> threads;
+  for (int idx = 0; idx < 4; ++idx) {
+    threads.emplace_back([] {
+      ThreadCachedServiceData::TLTimeseries timeseries(
+          ThreadCachedServiceData::get()->getThreadStats(),
+          "tlstats_test.timeseries", SUM, COUNT);
+      for (int value = 1; value <= 100; ++value) {
+        timeseries.addValue(value);
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  // Every thread's values, including those of stats that are already gone
+  publish();
+  EXPECT_EQ(4 * 5050, fbData->getCounter("tlstats_test.timeseries.sum"));
+  EXPECT_EQ(4 * 5050, fbData->getCounter("tlstats_test.timeseries.sum.60"));
+  EXPECT_EQ(400, fbData->getCounter("tlstats_test.timeseries.count"));
+}
+
+TEST(ThreadLocalStatsTest, Aggregate) {
+  TLStats stats;
+  TLStats::TLTimeseries timeseries(&stats, "tlstats_test.aggregate", SUM);
+  timeseries.addValue(3);
+  // Nothing is exported until the stats are aggregated
+  EXPECT_EQ(0, fbData->getCounter("tlstats_test.aggregate.sum"));
+  stats.aggregate();
+  EXPECT_EQ(3, fbData->getCounter("tlstats_test.aggregate.sum"));
+
+  // Aggregating again doesn't count the same values twice
+  timeseries.addValueAggregated(7, 2);
+  publish();
+  publish();
+  EXPECT_EQ(10, fbData->getCounter("tlstats_test.aggregate.sum"));
+}
+
+TEST(ThreadLocalStatsTest, Histogram) {
+  TLStats stats;
+  TLStats::TLHistogram histogram(
+      &stats, "tlstats_test.histogram", 10, 0, 100, AVG, 50, 100);
+  for (int value = 0; value < 100; ++value) {
+    histogram.addValue(value);
+  }
+  histogram.addRepeatedValue(95, 100);
+  publish();
+
+  EXPECT_EQ((4950 + 9500) / 200,
+            fbData->getCounter("tlstats_test.histogram.avg.60"));
+  auto p50 = fbData->getCounter("tlstats_test.histogram.p50.60");
+  EXPECT_GE(p50, 90);
+  EXPECT_LE(p50, 100);
+  EXPECT_LE(fbData->getCounter("tlstats_test.histogram.p100"), 100);
+}
+
+TEST(ThreadLocalStatsTest, Counter) {
+  TLStats stats;
+  TLStats::TLCounter counter(&stats, "tlstats_test.counter");
+  counter.incrementValue(5);
+  counter.incrementValue(-2);
+  publish();
+  EXPECT_EQ(3, fbData->getCounter("tlstats_test.counter"));
+  counter.incrementValue(1);
+  publish();
+  EXPECT_EQ(4, fbData->getCounter("tlstats_test.counter"));
+}
+
+TEST(ThreadLocalStatsTest, AddStatValue) {
+  std::thread([] {
+    tcData().addStatValue("tlstats_test.by_name", 2, SUM);
+    tcData().addStatValue("tlstats_test.by_name", 3, SUM);
+  }).join();
+  tcData().addStatValue("tlstats_test.by_name", 4, SUM);
+  publish();
+  EXPECT_EQ(9, fbData->getCounter("tlstats_test.by_name.sum"));
+
+  tcData().setCounter("tlstats_test.set", 12);
+  EXPECT_EQ(12, fbData->getCounter("tlstats_test.set"));
+  tcData().clearCounter("tlstats_test.set");
+  EXPECT_EQ(0, fbData->getCounters().count("tlstats_test.set"));
+}
@@ -8,6 +8,7 @@
  *
  */
 #include "fboss/agent/AddressUtil.h"
+#include "fboss/agent/EventTrace.h"
 #include "fboss/agent/SwSwitch.h"
 #include "fboss/agent/ThriftHandler.h"
 #include "fboss/agent/test/TestUtils.h"
@@ -19,8 +20,13 @@
 #include "fboss/agent/state/Route.h"
 
 #include <folly/IPAddress.h>
+#include <folly/system/ThreadId.h>
 #include <gtest/gtest.h>
 
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
 using namespace facebook::fboss;
 using folly::IPAddress;
 using folly::IPAddressV4;
@@ -32,6 +38,8 @@ using testing::UnorderedElementsAreArray;
 using facebook::network::toBinaryAddress;
 using cfg::PortSpeed;
 
+DECLARE_int32(route_transaction_idle_timeout_ms);
+
 namespace {
 
 unique_ptr<HwTestHandle> setupTestHandle() {
@@ -300,3 +308,249 @@ TEST(ThriftTest, syncFib) {
   EXPECT_EQ(4 + 1, tables3->getRouteTable(rid)->getRibV4()->size());
   EXPECT_EQ(4 + 1, tables3->getRouteTable(rid)->getRibV6()->size());
 }
+
+TEST(ThriftTest, getCurrentStateJSONPage) {
+  auto handle = setupTestHandle();
+  auto sw = handle->getSw();
+  ThriftHandler handler(sw);
+
+  // testStateA() has ports 1-20
+  std::string ret;
+  handler.getCurrentStateJSONPage(
+      ret, std::make_unique<std::string>("/ports"), 5, 3);
+  auto page = folly::parseJson(ret);
+  ASSERT_EQ(3, page["entries"].size());
+  for (int i = 0; i < 3; ++i) {
+    EXPECT_EQ(6 + i, page["entries"][i]["portId"].asInt());
+  }
+  EXPECT_TRUE(page.count("extraFields"));
+
+  // Paging past the end returns no entries
+  handler.getCurrentStateJSONPage(
+      ret, std::make_unique<std::string>("/ports/entries"), 20, 10);
+  EXPECT_EQ(0, folly::parseJson(ret).size());
+
+  // Paths into individual nodes match the full serialization
+  handler.getCurrentStateJSON(
+      ret, std::make_unique<std::string>("/ports/entries/0/portName"));
+  EXPECT_EQ("port1", folly::parseJson(ret).asString());
+  handler.getCurrentStateJSON(ret, std::make_unique<std::string>("/vlans"));
+  EXPECT_EQ(sw->getState()->getVlans()->toFollyDynamic(),
+            folly::parseJson(ret));
+
+  EXPECT_THROW(
+      handler.getCurrentStateJSON(
+          ret, std::make_unique<std::string>("/ports/entries/100")),
+      FbossError);
+  EXPECT_THROW(
+      handler.getCurrentStateJSON(
+          ret, std::make_unique<std::string>("/noSuchField")),
+      FbossError);
+}
+
+TEST(ThriftTest, routeTransaction) {
+  RouterID rid = RouterID(0);
+  auto handle = setupTestHandle();
+  auto sw = handle->getSw();
+  sw->fibSynced();
+  ThriftHandler handler(sw);
+
+  auto addChunk = [&](int64_t id, std::vector<std::string> prefixes) {
+    auto routes = std::make_unique<std::vector<UnicastRoute>>();
+    for (const auto& prefix : prefixes) {
+      routes->push_back(*makeUnicastRoute(prefix, "10.0.0.22"));
+    }
+    handler.addUnicastRoutesInTransaction(id, std::move(routes));
+  };
+
+  // Staged routes are not visible until the transaction is committed
+  auto id = handler.beginRouteTransaction(10);
+  addChunk(id, {"7.1.0.0/16", "7.2.0.0/16"});
+  addChunk(id, {"aaaa:1::0/64"});
+  EXPECT_NO_ROUTE(sw->getState()->getRouteTables(), rid, "7.1.0.0/16");
+  handler.commitRouteTransaction(id);
+  auto tables = sw->getState()->getRouteTables();
+  GET_ROUTE_V4(tables, rid, "7.1.0.0/16");
+  GET_ROUTE_V4(tables, rid, "7.2.0.0/16");
+  GET_ROUTE_V6(tables, rid, "aaaa:1::0/64");
+  EXPECT_THROW(handler.commitRouteTransaction(id), FbossError);
+
+  // Routes that change meanwhile are kept when the transaction commits
+  id = handler.beginRouteTransaction(10);
+  addChunk(id, {"7.3.0.0/16"});
+  handler.addUnicastRoute(20, makeUnicastRoute("7.4.0.0/16", "10.0.0.22"));
+  handler.commitRouteTransaction(id);
+  tables = sw->getState()->getRouteTables();
+  GET_ROUTE_V4(tables, rid, "7.3.0.0/16");
+  GET_ROUTE_V4(tables, rid, "7.4.0.0/16");
+
+  // Aborted transactions change nothing
+  id = handler.beginRouteTransaction(10);
+  addChunk(id, {"7.5.0.0/16"});
+  handler.abortRouteTransaction(id);
+  EXPECT_NO_ROUTE(sw->getState()->getRouteTables(), rid, "7.5.0.0/16");
+  EXPECT_THROW(addChunk(id, {"7.6.0.0/16"}), FbossError);
+}
+
+TEST(ThriftTest, routeTransactionIdleTimeout) {
+  gflags::FlagSaver flagSaver;
+  FLAGS_route_transaction_idle_timeout_ms = 50;
+  auto handle = setupTestHandle();
+  auto sw = handle->getSw();
+  sw->fibSynced();
+  ThriftHandler handler(sw);
+
+  auto id = handler.beginRouteTransaction(10);
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  // Idle for longer than the timeout, so it was aborted
+  EXPECT_THROW(handler.commitRouteTransaction(id), FbossError);
+
+  // Transactions that aren't idle for that long are kept
+  id = handler.beginRouteTransaction(10);
+  handler.commitRouteTransaction(id);
+}
+
+TEST(ThriftTest, routeTablePage) {
+  auto handle = setupTestHandle();
+  auto sw = handle->getSw();
+  sw->fibSynced();
+  ThriftHandler handler(sw);
+
+  for (auto prefix : {"7.1.0.0/16", "7.2.0.0/16", "7.2.1.0/24", "8.0.0.0/8"}) {
+    handler.addUnicastRoute(10, makeUnicastRoute(prefix, "10.0.0.22"));
+  }
+  handler.addUnicastRoute(
+      10, makeUnicastRoute("aaaa:1::0/64", "2401:db00:2110:3001::22"));
+  handler.addUnicastRoute(20, makeUnicastRoute("7.3.0.0/16", "10.0.0.22"));
+
+  // The prefixes of all the pages of routes matching filter
+  auto getAllPages = [&](const RouteFilter& filter, int32_t maxRoutes) {
+    std::vector<std::string> prefixes;
+    std::string cursor;
+    do {
+      RouteTablePage page;
+      handler.getRouteTablePage(
+          page,
+          std::make_unique<RouteFilter>(filter),
+          std::make_unique<std::string>(cursor),
+          maxRoutes);
+      EXPECT_LE(page.routes.size(), maxRoutes);
+      for (const auto& route : page.routes) {
+        prefixes.push_back(folly::to<std::string>(
+            facebook::network::toIPAddress(route.dest.ip).str(),
+            "/",
+            route.dest.prefixLength));
+      }
+      cursor = page.nextCursor;
+    } while (!cursor.empty());
+    return prefixes;
+  };
+
+  RouteFilter within;
+  within.within = ipPrefix("7.0.0.0", 8);
+  within.__isset.within = true;
+  std::vector<std::string> expected{
+      "7.1.0.0/16", "7.2.0.0/16", "7.3.0.0/16", "7.2.1.0/24"};
+  EXPECT_EQ(expected, getAllPages(within, 1));
+  EXPECT_EQ(expected, getAllPages(within, 10));
+  EXPECT_EQ(4, handler.getRouteCount(std::make_unique<RouteFilter>(within)));
+
+  within.clientId = 20;
+  within.__isset.clientId = true;
+  EXPECT_EQ(std::vector<std::string>{"7.3.0.0/16"}, getAllPages(within, 2));
+
+  // Every route once, whatever the page size
+  RouteFilter all;
+  auto allRoutes = getAllPages(all, 1000);
+  EXPECT_EQ(allRoutes, getAllPages(all, 3));
+  EXPECT_EQ(allRoutes.size(),
+            handler.getRouteCount(std::make_unique<RouteFilter>(all)));
+
+  std::vector<RouteTableSummary> summaries;
+  handler.getRouteTableSummary(summaries);
+  ASSERT_EQ(1, summaries.size());
+  EXPECT_EQ(0, summaries[0].vrfId);
+  EXPECT_EQ(allRoutes.size(),
+            summaries[0].numV4Routes + summaries[0].numV6Routes);
+  EXPECT_EQ(5, summaries[0].numRoutesByClient[10]);
+  EXPECT_EQ(1, summaries[0].numRoutesByClient[20]);
+
+  RouteFilter otherVrf;
+  otherVrf.vrfId = 1;
+  otherVrf.__isset.vrfId = true;
+  EXPECT_EQ(0, handler.getRouteCount(std::make_unique<RouteFilter>(otherVrf)));
+
+  RouteTablePage page;
+  EXPECT_THROW(
+      handler.getRouteTablePage(
+          page,
+          std::make_unique<RouteFilter>(all),
+          std::make_unique<std::string>("not a cursor"),
+          10),
+      FbossError);
+}
+
+TEST(ThriftTest, packetTraceSampling) {
+  auto handle = setupTestHandle();
+  auto sw = handle->getSw();
+  ThriftHandler handler(sw);
+
+  auto makeConfig = [](std::vector<std::string> destinations, int port) {
+    auto config = std::make_unique<PacketTraceSamplingConfig>();
+    config->destinations = std::move(destinations);
+    config->ingressPort = port;
+    return config;
+  };
+
+  // Bad configs are rejected before they reach the hardware
+  EXPECT_THROW(
+      handler.startPacketTraceSampling(makeConfig({}, 1)), FbossError);
+  EXPECT_THROW(
+      handler.startPacketTraceSampling(makeConfig({"not an ip"}, 1)),
+      FbossError);
+  EXPECT_THROW(
+      handler.startPacketTraceSampling(makeConfig({"10.0.0.1"}, 999)),
+      FbossError);
+
+  // The mock hardware can not trace packets
+  EXPECT_THROW(
+      handler.startPacketTraceSampling(makeConfig({"10.0.0.1"}, 1)),
+      FbossError);
+  std::vector<PacketTraceSample> samples;
+  handler.getPacketTraceSamples(samples);
+  EXPECT_TRUE(samples.empty());
+}
+
+TEST(ThriftTest, sdkCallProfiling) {
+  auto handle = setupTestHandle();
+  auto sw = handle->getSw();
+  ThriftHandler handler(sw);
+
+  // The mock hardware has no SDK calls to profile
+  EXPECT_THROW(handler.setSdkCallProfiling(true), FbossError);
+  std::vector<SdkCallProfile> profile;
+  handler.getSdkCallProfile(profile);
+  EXPECT_TRUE(profile.empty());
+}
+
+TEST(ThriftTest, eventTrace) {
+  auto handle = setupTestHandle();
+  auto sw = handle->getSw();
+  ThriftHandler handler(sw);
+
+  handler.setEventTracing(true);
+  EventTrace::record(EventTrace::Event::PACKET_RX, 3, 100);
+  std::vector<EventTraceEntry> trace;
+  handler.getEventTrace(trace);
+  ASSERT_FALSE(trace.empty());
+  // The last event of this thread
+  auto threadId = static_cast<int64_t>(folly::getOSThreadID());
+  auto last = std::find_if(
+      trace.rbegin(), trace.rend(), [&](const EventTraceEntry& entry) {
+        return entry.threadId == threadId;
+      });
+  ASSERT_NE(trace.rend(), last);
+  EXPECT_EQ("packet_rx", last->event);
+  EXPECT_EQ(3, last->arg0);
+  EXPECT_EQ(100, last->arg1);
+}
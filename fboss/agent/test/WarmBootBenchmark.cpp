@@ -0,0 +1,132 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include <folly/Format.h>
+#include <folly/experimental/TestUtil.h>
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+#include "fboss/agent/Constants.h"
+#include "fboss/agent/SwSwitch.h"
+#include "fboss/agent/ThriftHandler.h"
+#include "fboss/agent/hw/bcm/WarmBootStateFile.h"
+#include "fboss/agent/state/SwitchState.h"
+#include "fboss/agent/test/RouteBenchmarkUtils.h"
+
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+/*
+ * Measures the software side of a warm boot with a large route table.
+ *
+ * SimSwitch has no hardware to keep forwarding across a restart, so this
+ * covers what the agent itself does: a SwSwitch on a SimPlatform is loaded
+ * with --num_routes routes through ThriftHandler, and then each step of
+ * getting that state across a restart is timed in turn:
+ *  - serialize:  SwitchState::toFollyDynamic() of the applied state
+ *  - write:      WarmBootStateFile::write() of the dumped state
+ *  - read:       opening the state file and decoding all of it
+ *  - restore:    SwitchState::fromFollyDynamic() of the swSwitch section
+ *  - apply:      applying the restored state to a new SwSwitch
+ *  - fibSync:    syncFib() of the same routes against the restored state,
+ *                as the routing daemon does after a warm boot
+ * For each step the time taken and the peak RSS of the process so far are
+ * printed, along with the size of the state file.
+ */
+
+DEFINE_int32(ecmp_width, 4, "Number of next hops of each route");
+
+using namespace facebook::fboss;
+using std::make_unique;
+using std::shared_ptr;
+using std::vector;
+
+namespace {
+
+template <typename Fn>
+void timeStep(const std::string& name, Fn&& fn) {
+  auto begin = std::chrono::steady_clock::now();
+  fn();
+  auto elapsed = std::chrono::duration<double, std::milli>(
+      std::chrono::steady_clock::now() - begin);
+  std::cout << folly::sformat(
+      "{:<10} {:>10.1f}ms peak RSS {} KB\n",
+      name,
+      elapsed.count(),
+      peakRssKB());
+}
+
+void addRoutes(ThriftHandler* handler, const vector<UnicastRoute>& routes) {
+  forEachBenchmarkBatch(
+      routes, [&](std::unique_ptr<vector<UnicastRoute>> batch) {
+        handler->addUnicastRoutes(FLAGS_client_id, std::move(batch));
+      });
+}
+
+} // unnamed namespace
+
+int main(int argc, char** argv) {
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+  google::InitGoogleLogging(argv[0]);
+
+  vector<UnicastRoute> table;
+  table.reserve(FLAGS_num_routes);
+  for (int n = 0; n < FLAGS_num_routes; ++n) {
+    table.push_back(nthBenchmarkRoute(n, FLAGS_ecmp_width));
+  }
+
+  folly::test::TemporaryFile stateFile;
+  {
+    auto sw = setupBenchmarkSwitch();
+    ThriftHandler handler(sw.get());
+    timeStep("load", [&] { addRoutes(&handler, table); });
+
+    folly::dynamic switchState = folly::dynamic::object;
+    timeStep("serialize", [&] {
+      switchState[kSwSwitch] = sw->getAppliedState()->toFollyDynamic();
+    });
+    size_t bytes = 0;
+    timeStep("write", [&] {
+      bytes = WarmBootStateFile::write(
+          switchState, stateFile.path().string());
+    });
+    std::cout << folly::sformat("state file {} bytes\n", bytes);
+  }
+
+  // As after a restart, the state comes back from the file alone
+  folly::dynamic dumped;
+  timeStep("read", [&] {
+    WarmBootStateFile file(stateFile.path().string());
+    dumped = file.getAll();
+  });
+  shared_ptr<SwitchState> restored;
+  timeStep("restore", [&] {
+    restored = SwitchState::fromFollyDynamic(dumped[kSwSwitch]);
+  });
+  dumped = nullptr;
+
+  auto sw = createBenchmarkSwitch();
+  ThriftHandler handler(sw.get());
+  timeStep("apply", [&] {
+    sw->updateStateBlocking(
+        "warm boot state",
+        [&](const shared_ptr<SwitchState>& /*oldState*/) {
+          return restored;
+        });
+    sw->initialConfigApplied(std::chrono::steady_clock::now());
+  });
+  timeStep("fibSync", [&] {
+    handler.syncFib(
+        FLAGS_client_id, make_unique<vector<UnicastRoute>>(table));
+  });
+  return 0;
+}
@@ -0,0 +1,68 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "fboss/agent/WarmBootTimeline.h"
+
+#include <folly/FileUtil.h>
+#include <folly/experimental/TestUtil.h>
+
+#include <gtest/gtest.h>
+
+using namespace facebook::fboss;
+using Event = WarmBootTimeline::Event;
+
+TEST(WarmBootTimeline, FirstMarkCounts) {
+  WarmBootTimeline timeline;
+  timeline.mark(Event::FIB_SYNCED);
+  auto first = timeline.getEvents();
+  timeline.mark(Event::FIB_SYNCED);
+  timeline.mark(Event::PROCESS_START);
+
+  auto events = timeline.getEvents();
+  ASSERT_EQ(2, events.size());
+  // In the order of the steps, not of marking
+  EXPECT_EQ(Event::PROCESS_START, events[0].first);
+  EXPECT_EQ(Event::FIB_SYNCED, events[1].first);
+  EXPECT_EQ(first[0].second, events[1].second);
+  EXPECT_LE(events[1].second, events[0].second);
+}
+
+TEST(WarmBootTimeline, ExitEventsCarryOver) {
+  folly::test::TemporaryDirectory dir;
+  auto file = (dir.path() / "warm_boot_timeline.json").string();
+
+  WarmBootTimeline exiting;
+  exiting.mark(Event::PROCESS_START);
+  exiting.mark(Event::GRACEFUL_EXIT_START);
+  exiting.mark(Event::STATE_FILE_WRITTEN);
+  ASSERT_TRUE(exiting.saveExit(file));
+
+  WarmBootTimeline booting;
+  booting.mark(Event::PROCESS_START);
+  booting.loadPreviousExit(file);
+  auto events = booting.getEvents();
+  ASSERT_EQ(3, events.size());
+  EXPECT_EQ(Event::GRACEFUL_EXIT_START, events[0].first);
+  EXPECT_EQ(exiting.getEvents()[0].second, events[0].second);
+  EXPECT_EQ(Event::STATE_FILE_WRITTEN, events[1].first);
+  // The process start is this boot's, not the exiting agent's
+  EXPECT_EQ(Event::PROCESS_START, events[2].first);
+  EXPECT_LE(exiting.getEvents()[2].second, events[2].second);
+
+  // Loaded once only
+  std::string contents;
+  EXPECT_FALSE(folly::readFile(file.c_str(), contents));
+}
+
+TEST(WarmBootTimeline, NoPreviousExit) {
+  folly::test::TemporaryDirectory dir;
+  WarmBootTimeline timeline;
+  timeline.loadPreviousExit((dir.path() / "missing.json").string());
+  EXPECT_TRUE(timeline.getEvents().empty());
+}
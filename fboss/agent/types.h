@@ -50,6 +50,8 @@ FBOSS_STRONG_TYPE(uint32_t, RouterID)
 FBOSS_STRONG_TYPE(uint32_t, InterfaceID)
 FBOSS_STRONG_TYPE(int, VrfID)
 FBOSS_STRONG_TYPE(uint32_t, ClientID)
+// The class a route's traffic is counted under, 0 for none
+FBOSS_STRONG_TYPE(uint32_t, RouteClassID)
 
 /*
  * A unique ID identifying a node in our state tree.
@@ -33,8 +33,8 @@ HeaderParser::functionDeclMatcher() {
   return matcher;
 }
 
-HeaderParser::HeaderParser()
-    : file_(std::make_unique<ThriftFile>("BcmWrapper")) {}
+HeaderParser::HeaderParser(bool batchCalls)
+    : file_(std::make_unique<ThriftFile>("BcmWrapper", batchCalls)) {}
 
 void HeaderParser::run(
     const clang::ast_matchers::MatchFinder::MatchResult& result) {
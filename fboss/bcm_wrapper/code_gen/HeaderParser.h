@@ -30,10 +30,13 @@ namespace facebook { namespace fboss {
  * As we visit those declarations, we populate objects which represent ThrifIDL
  * objects corresponding to those declarations which we can finally use to
  * output thrift corresponding to the processed header file.
+ *
+ * With batchCalls set, the thrift also lets many of the functions be called
+ * in one request (see ThriftFile).
  */
 class HeaderParser : public clang::ast_matchers::MatchFinder::MatchCallback {
  public:
-  HeaderParser();
+  explicit HeaderParser(bool batchCalls = false);
   void run(
       const clang::ast_matchers::MatchFinder::MatchResult& result) override;
   // matcher for structs, unions, and classes
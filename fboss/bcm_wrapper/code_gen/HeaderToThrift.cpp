@@ -8,26 +8,71 @@
  *
  */
 #include "HeaderParser.h"
+#include "TracingShim.h"
 
 #include <clang/Tooling/CommonOptionsParser.h>
 #include <clang/Tooling/Tooling.h>
 #include <llvm/Support/CommandLine.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/raw_ostream.h>
 
 static llvm::cl::extrahelp commonHelp(
     clang::tooling::CommonOptionsParser::HelpMessage);
 static llvm::cl::OptionCategory headerToThriftCategory(
     "HeaderToThrift options");
+static llvm::cl::opt<bool> batchCalls(
+    "batch-calls",
+    llvm::cl::desc("Also generate a service method that makes a list of "
+                   "calls in one request"),
+    llvm::cl::cat(headerToThriftCategory));
+static llvm::cl::opt<std::string> tracingShim(
+    "tracing-shim",
+    llvm::cl::desc("Also write C++ that counts and times the calls of every "
+                   "function to this file"),
+    llvm::cl::value_desc("file"),
+    llvm::cl::cat(headerToThriftCategory));
+static llvm::cl::opt<std::string> wrapFlags(
+    "wrap-flags",
+    llvm::cl::desc("Write the linker flags that interpose the tracing shim "
+                   "to this file"),
+    llvm::cl::value_desc("file"),
+    llvm::cl::cat(headerToThriftCategory));
+
+namespace {
+bool writeFile(const std::string& path, const std::string& contents) {
+  std::error_code ec;
+  llvm::raw_fd_ostream os(path, ec, llvm::sys::fs::F_Text);
+  if (ec) {
+    llvm::errs() << "Can not write " << path << ": " << ec.message() << "\n";
+    return false;
+  }
+  os << contents;
+  return true;
+}
+} // unnamed namespace
 
 int main(int argc, char **argv) {
   clang::tooling::CommonOptionsParser optionsParser(
       argc, const_cast<const char**>(argv), headerToThriftCategory);
   clang::tooling::ClangTool tool(
       optionsParser.getCompilations(), optionsParser.getSourcePathList());
-  facebook::fboss::HeaderParser hp;
+  facebook::fboss::HeaderParser hp(batchCalls);
   clang::ast_matchers::MatchFinder mf;
   mf.addMatcher(facebook::fboss::HeaderParser::recordDeclMatcher(), &hp);
   mf.addMatcher(facebook::fboss::HeaderParser::enumDeclMatcher(), &hp);
   mf.addMatcher(facebook::fboss::HeaderParser::functionDeclMatcher(), &hp);
+  facebook::fboss::TracingShim shim(optionsParser.getSourcePathList());
+  if (!tracingShim.empty()) {
+    mf.addMatcher(facebook::fboss::HeaderParser::functionDeclMatcher(), &shim);
+  }
   tool.run(clang::tooling::newFrontendActionFactory(&mf).get());
   llvm::outs() << hp.getThrift() << "\n";
+  if (!tracingShim.empty()) {
+    if (!writeFile(tracingShim, shim.getCode())) {
+      return 1;
+    }
+    if (!wrapFlags.empty() && !writeFile(wrapFlags, shim.getWrapFlags())) {
+      return 1;
+    }
+  }
 }
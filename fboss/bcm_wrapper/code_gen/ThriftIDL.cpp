@@ -143,6 +143,11 @@ ThriftType::ThriftType() {
   name = boost::apply_visitor(ThriftType::ThriftGenVisitor(), type);
 }
 
+ThriftType::ThriftType(const ThriftType::Type& type) {
+  this->type = type;
+  name = boost::apply_visitor(ThriftType::ThriftGenVisitor(), type);
+}
+
 std::string ThriftType::getThrift() const {
   return name;
 }
@@ -233,6 +238,14 @@ ThriftField::ThriftField(
   type_ = ThriftType(qualifiedType);
 }
 
+ThriftField::ThriftField(
+    const std::string& name,
+    int index,
+    const ThriftType& type)
+    : index_(index), type_(type) {
+  this->name = name;
+}
+
 std::string ThriftField::getThrift() const {
   return folly::sformat("{}: {} {}", index_, type_.getThrift(), name);
 }
@@ -266,9 +279,17 @@ ThriftStruct::ThriftStruct(const clang::FunctionDecl& function) {
   }
 }
 
+ThriftStruct::ThriftStruct(
+    const std::string& name,
+    std::vector<std::unique_ptr<ThriftField>> fields,
+    bool isUnion)
+    : fields_(std::move(fields)), isUnion_(isUnion) {
+  this->name = name;
+}
+
 std::string ThriftStruct::getThrift() const {
   std::stringstream ss;
-  ss << "struct " << name << "\n{\n";
+  ss << (isUnion_ ? "union " : "struct ") << name << "\n{\n";
   for (const auto& field : fields_) {
     ss << "    " << field->getThrift() << "\n";
   }
@@ -290,6 +311,24 @@ ThriftMethod::ThriftMethod(const clang::FunctionDecl& function) {
   }
 }
 
+ThriftMethod::ThriftMethod(
+    const std::string& name,
+    const std::string& resultTypeName,
+    std::vector<std::unique_ptr<ThriftField>> parameters)
+    : resultTypeName(resultTypeName), parameters_(std::move(parameters)) {
+  this->name = name;
+}
+
+std::unique_ptr<ThriftStruct> ThriftMethod::getArgsStruct() const {
+  std::string argsName = folly::sformat("{}Args", name);
+  normalizeStructName(argsName);
+  std::vector<std::unique_ptr<ThriftField>> fields;
+  for (const auto& param : parameters_) {
+    fields.emplace_back(std::make_unique<ThriftField>(*param));
+  }
+  return std::make_unique<ThriftStruct>(argsName, std::move(fields));
+}
+
 std::string ThriftMethod::methodName(const std::string& functionName) {
   std::string s = functionName;
   snakeToCamel(s);
@@ -315,19 +354,74 @@ void ThriftService::addMethod(std::unique_ptr<ThriftMethod> method) {
   methods_.push_back(std::move(method));
 }
 
+void ThriftService::setLastMethod(std::unique_ptr<ThriftMethod> method) {
+  lastMethod_ = std::move(method);
+}
+
 std::string ThriftService::getThrift() const {
   std::stringstream ss;
   ss << "service " << name << "\n{\n";
   for (const auto& method : methods_) {
     ss << "    " << method->getThrift() << "\n";
   }
+  if (lastMethod_) {
+    ss << "    " << lastMethod_->getThrift() << "\n";
+  }
   ss << "}";
   return ss.str();
 }
 
-ThriftFile::ThriftFile(const std::string& name) {
+ThriftFile::ThriftFile(const std::string& name, bool batchCalls)
+    : batchCalls_(batchCalls) {
   this->name = name;
   service_.name = folly::sformat("{}Service", name);
+  if (batchCalls_) {
+    std::vector<std::unique_ptr<ThriftField>> params;
+    params.emplace_back(std::make_unique<ThriftField>(
+        "calls", 0, ThriftType(ThriftType::List(callUnionName()))));
+    service_.setLastMethod(std::make_unique<ThriftMethod>(
+        "batchCalls",
+        ThriftType(ThriftType::List(callResultUnionName())).getThrift(),
+        std::move(params)));
+  }
+}
+
+std::string ThriftFile::callUnionName() const {
+  return folly::sformat("{}Call", name);
+}
+
+std::string ThriftFile::callResultUnionName() const {
+  return folly::sformat("{}CallResult", name);
+}
+
+std::string ThriftFile::voidResultName() const {
+  return folly::sformat("{}VoidResult", name);
+}
+
+std::string ThriftFile::getBatchThrift() const {
+  std::stringstream ss;
+  std::vector<std::unique_ptr<ThriftField>> calls;
+  std::vector<std::unique_ptr<ThriftField>> results;
+  int index = 0;
+  for (const auto& method : service_.getMethods()) {
+    auto args = method->getArgsStruct();
+    ss << args->getThrift() << "\n";
+    calls.emplace_back(std::make_unique<ThriftField>(
+        method->name, index, ThriftType(args->name)));
+    auto resultType = method->resultTypeName == "void"
+        ? voidResultName()
+        : method->resultTypeName;
+    results.emplace_back(std::make_unique<ThriftField>(
+        method->name, index, ThriftType(resultType)));
+    ++index;
+  }
+  ss << ThriftStruct(voidResultName(), {}).getThrift() << "\n";
+  ss << ThriftStruct(callUnionName(), std::move(calls), true).getThrift()
+     << "\n";
+  ss << ThriftStruct(callResultUnionName(), std::move(results), true)
+            .getThrift()
+     << "\n";
+  return ss.str();
 }
 
 void ThriftFile::addEnum(std::unique_ptr<ThriftEnum> en) {
@@ -350,6 +444,9 @@ std::string ThriftFile::getThrift() const {
   for (const auto& st : structs_) {
     ss << st->getThrift() << "\n";
   }
+  if (batchCalls_) {
+    ss << getBatchThrift();
+  }
   ss << service_.getThrift() << "\n";
   return ss.str();
 }
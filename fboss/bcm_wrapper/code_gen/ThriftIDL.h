@@ -69,6 +69,9 @@ class ThriftType : public ThriftIDLObject {
     explicit List(const Type& elementType);
     Type elementType;
   };
+  // A type that is not generated from a clang type, such as a generated
+  // struct or a list of them
+  explicit ThriftType(const Type& type);
   Type type;
 
  private:
@@ -92,6 +95,7 @@ class ThriftField : public ThriftIDLObject {
       const std::string& name,
       int index,
       const clang::QualType& qualifiedType);
+  ThriftField(const std::string& name, int index, const ThriftType& type);
   std::string getThrift() const override;
  private:
   int index_;
@@ -107,10 +111,16 @@ class ThriftStruct : public ThriftIDLObject {
  public:
   explicit ThriftStruct(const clang::RecordDecl& record);
   explicit ThriftStruct(const clang::FunctionDecl& function);
+  // A struct with the given fields, which is a union if isUnion is set
+  ThriftStruct(
+      const std::string& name,
+      std::vector<std::unique_ptr<ThriftField>> fields,
+      bool isUnion = false);
   std::string getThrift() const override;
   bool hasFields() const;
  private:
   std::vector<std::unique_ptr<ThriftField>> fields_;
+  bool isUnion_{false};
 };
 
 /*
@@ -142,8 +152,15 @@ class ThriftEnum : public ThriftIDLObject {
 class ThriftMethod : public ThriftIDLObject {
  public:
   explicit ThriftMethod(const clang::FunctionDecl& function);
+  // A method that is not generated from a function declaration
+  ThriftMethod(
+      const std::string& name,
+      const std::string& resultTypeName,
+      std::vector<std::unique_ptr<ThriftField>> parameters);
   std::string getThrift() const override;
   static std::string methodName(const std::string& functionName);
+  // The struct holding the method's parameters, for batched calls
+  std::unique_ptr<ThriftStruct> getArgsStruct() const;
   std::string resultTypeName;
  private:
   std::vector<std::unique_ptr<ThriftField>> parameters_;
@@ -158,28 +175,50 @@ class ThriftService : public ThriftIDLObject {
  public:
   std::string getThrift() const override;
   void addMethod(std::unique_ptr<ThriftMethod> method);
+  const std::vector<std::unique_ptr<ThriftMethod>>& getMethods() const {
+    return methods_;
+  }
+  // A method listed after all the others
+  void setLastMethod(std::unique_ptr<ThriftMethod> method);
  private:
   std::vector<std::unique_ptr<ThriftMethod>> methods_;
+  std::unique_ptr<ThriftMethod> lastMethod_;
 };
 
 /*
  * Represents the entire thrift file. This is the top level object which
  * will contain all the other IDL objects.
+ *
+ * With batchCalls set, the file also gets the IDL for calling many methods
+ * in one request, for wrappers where a request per SDK call is too slow:
+ *  - a <Method>Args struct with the parameters of each method
+ *  - a <Name>Call union of the args of every method, naming one call
+ *  - a <Name>CallResult union of the result of every method, with
+ *    <Name>VoidResult for the methods that return nothing
+ *  - a batchCalls() service method, which makes a list of calls in order
+ *    and returns their results in the same order
  */
 class ThriftFile : public ThriftIDLObject {
  public:
-  explicit ThriftFile(const std::string& name);
+  explicit ThriftFile(const std::string& name, bool batchCalls = false);
   std::string getThrift() const override;
   void addEnum(std::unique_ptr<ThriftEnum> en);
   // Adding a method also adds the struct representing the return value
   void addMethod(std::unique_ptr<ThriftMethod> method);
   void addStruct(std::unique_ptr<ThriftStruct> st);
  private:
+  // The structs and unions for batched calls of the service's methods
+  std::string getBatchThrift() const;
+  std::string callUnionName() const;
+  std::string callResultUnionName() const;
+  std::string voidResultName() const;
+
   std::vector<std::unique_ptr<ThriftEnum>> enums_;
   // While thrift supports multiple services in a file, for now we generate
   // just one, so don't bother with the extra complication
   ThriftService service_;
   std::vector<std::unique_ptr<ThriftStruct>> structs_;
+  bool batchCalls_{false};
 };
 
 }} // facebook::fboss
@@ -0,0 +1,109 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "TracingShim.h"
+
+#include <sstream>
+
+#include <llvm/Support/raw_ostream.h>
+
+namespace facebook { namespace fboss {
+
+namespace {
+// Print a declaration of name with the given type, such as "int *x"
+std::string declare(
+    const clang::QualType& qt,
+    const std::string& name,
+    const clang::PrintingPolicy& policy) {
+  std::string decl;
+  llvm::raw_string_ostream os(decl);
+  qt.print(os, policy, name);
+  return os.str();
+}
+} // unnamed namespace
+
+TracingShim::TracingShim(std::vector<std::string> headers)
+    : headers_(std::move(headers)) {}
+
+void TracingShim::run(
+    const clang::ast_matchers::MatchFinder::MatchResult& result) {
+  const clang::FunctionDecl* fd =
+      result.Nodes.getNodeAs<clang::FunctionDecl>("fd");
+  if (!fd || fd->isImplicit() || fd->isVariadic() || fd->hasBody() ||
+      fd->getStorageClass() == clang::SC_Static ||
+      fd->getReturnType()->isFunctionPointerType()) {
+    return;
+  }
+  auto name = fd->getNameAsString();
+  if (!functions_.insert(name).second) {
+    // Declared again
+    return;
+  }
+
+  auto policy = fd->getASTContext().getPrintingPolicy();
+  policy.Bool = true;
+  auto returnType = fd->getReturnType();
+  std::string parameters;
+  std::string arguments;
+  for (unsigned i = 0; i < fd->getNumParams(); ++i) {
+    auto arg = "arg" + std::to_string(i);
+    if (i > 0) {
+      parameters += ", ";
+      arguments += ", ";
+    }
+    parameters += declare(fd->getParamDecl(i)->getType(), arg, policy);
+    arguments += arg;
+  }
+  auto returnTypeName = returnType.getAsString(policy);
+  auto stats = name + "Stats";
+
+  std::stringstream wrapper;
+  wrapper << "static BcmSdkCallStats " << stats << "(\"" << name << "\");\n"
+          << "extern \"C\" " << returnTypeName << " __real_" << name << "("
+          << parameters << ");\n"
+          << "extern \"C\" " << returnTypeName << " __wrap_" << name << "("
+          << parameters << ") {\n"
+          << "  BcmSdkCallTimer timer(&" << stats << ");\n"
+          << "  " << (returnType->isVoidType() ? "" : "return ")
+          << "__real_" << name << "(" << arguments << ");\n"
+          << "}\n";
+  wrappers_.push_back(wrapper.str());
+}
+
+std::string TracingShim::getCode() const {
+  std::stringstream code;
+  code << "// Generated by HeaderToThrift --tracing-shim\n"
+       << "#include \"fboss/agent/hw/bcm/BcmSdkCallProfiler.h\"\n"
+       << "\n"
+       << "extern \"C\" {\n";
+  for (const auto& header : headers_) {
+    code << "#include \"" << header << "\"\n";
+  }
+  code << "}\n"
+       << "\n"
+       << "using facebook::fboss::BcmSdkCallStats;\n"
+       << "using facebook::fboss::BcmSdkCallTimer;\n";
+  for (const auto& wrapper : wrappers_) {
+    code << "\n" << wrapper;
+  }
+  return code.str();
+}
+
+std::string TracingShim::getWrapFlags() const {
+  std::string flags;
+  for (const auto& function : functions_) {
+    if (!flags.empty()) {
+      flags += " ";
+    }
+    flags += "-Wl,--wrap=" + function;
+  }
+  return flags;
+}
+
+}} // facebook::fboss
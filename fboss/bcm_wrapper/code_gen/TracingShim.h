@@ -0,0 +1,46 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+
+#pragma once
+
+#include <set>
+#include <string>
+#include <vector>
+
+#include <clang/ASTMatchers/ASTMatchers.h>
+#include <clang/ASTMatchers/ASTMatchFinder.h>
+
+namespace facebook { namespace fboss {
+/*
+ * Generates C++ that wraps every function matched by
+ * HeaderParser::functionDeclMatcher() to count and time its calls with
+ * BcmSdkCallProfiler. Each function foo gets a __wrap_foo that calls
+ * __real_foo, so the shim is interposed by linking the agent with
+ * -Wl,--wrap=foo for each of them (see getWrapFlags()).
+ *
+ * Functions that can not be wrapped that way are skipped: variadic ones,
+ * and the static and inline ones defined in the headers.
+ */
+class TracingShim : public clang::ast_matchers::MatchFinder::MatchCallback {
+ public:
+  // The shim includes these headers, for the types of the functions
+  explicit TracingShim(std::vector<std::string> headers);
+  void run(
+      const clang::ast_matchers::MatchFinder::MatchResult& result) override;
+  // return the C++ code we have generated while processing the headers
+  std::string getCode() const;
+  // the linker flags that interpose the generated wrappers
+  std::string getWrapFlags() const;
+ private:
+  std::vector<std::string> headers_;
+  std::set<std::string> functions_;
+  std::vector<std::string> wrappers_;
+};
+}} // facebook::fboss
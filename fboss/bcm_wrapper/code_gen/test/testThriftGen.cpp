@@ -248,3 +248,51 @@ TEST_F(ThriftGenTest, FunctionPointerParameterFunction) {
   auto actual = genThrift(source);
   EXPECT_EQ(actual, expected);
 }
+
+/*
+ * Test that with batching, each method gets an args struct and an entry in
+ * the call and result unions, and the service gets a batch method
+ */
+TEST(BatchThriftGenTest, BatchCalls) {
+  facebook::fboss::HeaderParser hp(true /* batchCalls */);
+  clang::ast_matchers::MatchFinder mf;
+  mf.addMatcher(facebook::fboss::HeaderParser::functionDeclMatcher(), &hp);
+  clang::tooling::runToolOnCode(
+      clang::tooling::newFrontendActionFactory(&mf).get()->create(),
+      "int foo(int *x); void bar(int y);",
+      "lol.h");
+  auto expected = R"(struct FooResult
+{
+    0: i32 retVal
+    1: list<i32> x
+}
+struct FooArgs
+{
+    0: list<i32> x
+}
+struct BarArgs
+{
+    0: i32 y
+}
+struct BcmWrapperVoidResult
+{
+}
+union BcmWrapperCall
+{
+    0: FooArgs foo
+    1: BarArgs bar
+}
+union BcmWrapperCallResult
+{
+    0: FooResult foo
+    1: BcmWrapperVoidResult bar
+}
+service BcmWrapperService
+{
+    FooResult foo(0: list<i32> x)
+    void bar(0: i32 y)
+    list<BcmWrapperCallResult> batchCalls(0: list<BcmWrapperCall> calls)
+}
+)";
+  EXPECT_EQ(hp.getThrift(), expected);
+}
@@ -0,0 +1,56 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+
+#include <clang/Tooling/Tooling.h>
+#include <gtest/gtest.h>
+
+#include "fboss/bcm_wrapper/code_gen/HeaderParser.h"
+#include "fboss/bcm_wrapper/code_gen/TracingShim.h"
+
+/*
+ * Test that each function gets a wrapper which times it and calls the real
+ * function, and that the functions which can not be wrapped are skipped
+ */
+TEST(TracingShimTest, WrapFunctions) {
+  facebook::fboss::TracingShim shim({"lol.h"});
+  clang::ast_matchers::MatchFinder mf;
+  mf.addMatcher(facebook::fboss::HeaderParser::functionDeclMatcher(), &shim);
+  clang::tooling::runToolOnCode(
+      clang::tooling::newFrontendActionFactory(&mf).get()->create(),
+      "int foo(int *x); void bar(int y); int foo(int *x); "
+      "int baz(int x, ...); static int qux(void) { return 0; }",
+      "lol.h");
+  auto expected = R"(// Generated by HeaderToThrift --tracing-shim
+#include "fboss/agent/hw/bcm/BcmSdkCallProfiler.h"
+
+extern "C" {
+#include "lol.h"
+}
+
+using facebook::fboss::BcmSdkCallStats;
+using facebook::fboss::BcmSdkCallTimer;
+
+static BcmSdkCallStats fooStats("foo");
+extern "C" int __real_foo(int *arg0);
+extern "C" int __wrap_foo(int *arg0) {
+  BcmSdkCallTimer timer(&fooStats);
+  return __real_foo(arg0);
+}
+
+static BcmSdkCallStats barStats("bar");
+extern "C" void __real_bar(int arg0);
+extern "C" void __wrap_bar(int arg0) {
+  BcmSdkCallTimer timer(&barStats);
+  __real_bar(arg0);
+}
+)";
+  EXPECT_EQ(shim.getCode(), expected);
+  EXPECT_EQ(shim.getWrapFlags(), "-Wl,--wrap=bar -Wl,--wrap=foo");
+}
@@ -0,0 +1,415 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "fboss/lib/OpenMetricsServer.h"
+
+#include <folly/Conv.h>
+#include <folly/ExceptionString.h>
+#include <folly/String.h>
+#include <folly/io/IOBuf.h>
+#include <folly/io/async/AsyncSocket.h>
+#include <folly/logging/xlog.h>
+#include <folly/system/ThreadName.h>
+#include <gflags/gflags.h>
+
+#include <cctype>
+#include <cstring>
+
+#include "common/stats/ServiceData.h"
+
+DEFINE_int32(metrics_refresh_interval_ms, 1000,
+             "How often to render the counters served in the OpenMetrics "
+             "format");
+
+namespace {
+
+constexpr folly::StringPiece kContentType{
+    "application/openmetrics-text; version=1.0.0; charset=utf-8"};
+constexpr size_t kMaxRequestSize = 8192;
+constexpr std::chrono::seconds kRequestTimeout{10};
+constexpr int kListenBacklog = 16;
+
+bool isDigits(folly::StringPiece str) {
+  if (str.empty()) {
+    return false;
+  }
+  for (auto c : str) {
+    if (!isdigit(c)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// e.g. "queue2" for the prefix "queue"
+bool isNumbered(folly::StringPiece str, folly::StringPiece prefix) {
+  return str.startsWith(prefix) && isDigits(str.subpiece(prefix.size()));
+}
+
+// The port names of the config look like "eth1/1/1", and ports without a
+// name are called "port5"
+bool isPortName(folly::StringPiece str) {
+  return str.find('/') != folly::StringPiece::npos || isNumbered(str, "port");
+}
+
+// The ServiceData export types, and percentiles such as "p95"
+bool isExport(folly::StringPiece str) {
+  return str == "sum" || str == "count" || str == "avg" || str == "rate" ||
+      str == "pct" || isNumbered(str, "p");
+}
+
+char metricNameChar(char c) {
+  return isalnum(c) || c == '_' || c == ':' ? c : '_';
+}
+
+void appendLabelValue(folly::StringPiece value, std::string* out) {
+  for (auto c : value) {
+    switch (c) {
+      case '\\':
+        *out += "\\\\";
+        break;
+      case '"':
+        *out += "\\\"";
+        break;
+      case '\n':
+        *out += "\\n";
+        break;
+      default:
+        *out += c;
+    }
+  }
+}
+
+}
+
+namespace facebook { namespace fboss {
+
+OpenMetricsRenderer::OpenMetricsRenderer(std::string prefix)
+    : prefix_(std::move(prefix)),
+      rendered_(std::make_shared<std::string>("# EOF\n")) {}
+
+OpenMetricsRenderer::Metric OpenMetricsRenderer::parse(
+    folly::StringPiece counter) const {
+  std::vector<folly::StringPiece> parts;
+  folly::split('.', counter, parts);
+  size_t begin = 0;
+  size_t end = parts.size();
+
+  Metric metric;
+  std::vector<folly::StringPiece> nameParts{prefix_};
+  if (end - begin > 1 && isPortName(parts[begin])) {
+    metric.labels.emplace_back("port", parts[begin].str());
+    nameParts.push_back("port");
+    ++begin;
+    if (end - begin > 1 && isNumbered(parts[begin], "queue")) {
+      metric.labels.emplace_back(
+          "queue", parts[begin].subpiece(strlen("queue")).str());
+      nameParts.push_back("queue");
+      ++begin;
+    }
+    if (parts[begin].startsWith("in_")) {
+      metric.labels.emplace_back("direction", "in");
+      parts[begin].advance(strlen("in_"));
+    } else if (parts[begin].startsWith("out_")) {
+      metric.labels.emplace_back("direction", "out");
+      parts[begin].advance(strlen("out_"));
+    }
+  }
+
+  folly::StringPiece exportType;
+  folly::StringPiece window;
+  if (end - begin > 2 && isDigits(parts[end - 1]) &&
+      isExport(parts[end - 2])) {
+    window = parts[end - 1];
+    exportType = parts[end - 2];
+    end -= 2;
+  } else if (end - begin > 1 && isExport(parts[end - 1])) {
+    exportType = parts[end - 1];
+    --end;
+  }
+  if (!exportType.empty()) {
+    metric.labels.emplace_back("export", exportType.str());
+  }
+  if (!window.empty()) {
+    metric.labels.emplace_back("window", window.str());
+  }
+
+  nameParts.insert(nameParts.end(), parts.begin() + begin, parts.begin() + end);
+  metric.family = folly::join("_", nameParts);
+  for (auto& c : metric.family) {
+    c = metricNameChar(c);
+  }
+  return metric;
+}
+
+void OpenMetricsRenderer::update(
+    const std::map<std::string, int64_t>& counters) {
+  ++generation_;
+  for (const auto& counter : counters) {
+    auto it = samples_.find(counter.first);
+    if (it == samples_.end()) {
+      auto metric = parse(counter.first);
+      it = samples_.emplace(counter.first, Sample()).first;
+      auto& sample = it->second;
+      auto& family = families_[metric.family];
+      sample.family = &family;
+      sample.prefix = metric.family;
+      if (!metric.labels.empty()) {
+        const char* sep = "{";
+        for (const auto& label : metric.labels) {
+          folly::toAppend(sep, label.first, "=\"", &sample.prefix);
+          appendLabelValue(label.second, &sample.prefix);
+          sample.prefix += '"';
+          sep = ",";
+        }
+        sample.prefix += '}';
+      }
+      sample.prefix += ' ';
+      sample.value = counter.second;
+      family.samples.emplace(counter.first, &sample);
+      family.dirty = true;
+    } else if (it->second.value != counter.second) {
+      it->second.value = counter.second;
+      it->second.family->dirty = true;
+    }
+    it->second.generation = generation_;
+  }
+
+  for (auto it = samples_.begin(); it != samples_.end();) {
+    if (it->second.generation == generation_) {
+      ++it;
+      continue;
+    }
+    it->second.family->samples.erase(it->first);
+    it->second.family->dirty = true;
+    it = samples_.erase(it);
+  }
+
+  bool changed = false;
+  size_t size = 0;
+  for (auto it = families_.begin(); it != families_.end();) {
+    if (it->second.dirty) {
+      changed = true;
+      if (it->second.samples.empty()) {
+        it = families_.erase(it);
+        continue;
+      }
+      render(it->first, &it->second);
+    }
+    size += it->second.text.size();
+    ++it;
+  }
+  if (!changed) {
+    return;
+  }
+
+  // The families are only concatenated here, nothing is formatted again
+  auto rendered = std::make_shared<std::string>();
+  rendered->reserve(size + strlen("# EOF\n"));
+  for (const auto& family : families_) {
+    *rendered += family.second.text;
+  }
+  *rendered += "# EOF\n";
+  std::lock_guard<std::mutex> g(renderedLock_);
+  rendered_ = std::move(rendered);
+}
+
+std::shared_ptr<const std::string> OpenMetricsRenderer::getRendered() const {
+  std::lock_guard<std::mutex> g(renderedLock_);
+  return rendered_;
+}
+
+void OpenMetricsRenderer::render(const std::string& name,
+                                 Family* family) const {
+  family->text.clear();
+  folly::toAppend("# TYPE ", name, " gauge\n", &family->text);
+  for (const auto& entry : family->samples) {
+    folly::toAppend(
+        entry.second->prefix, entry.second->value, "\n", &family->text);
+  }
+  family->dirty = false;
+}
+
+/*
+ * A connection, which reads one request, answers it and closes.
+ */
+class OpenMetricsServer::Connection
+    : public folly::AsyncReader::ReadCallback,
+      public folly::AsyncWriter::WriteCallback,
+      public folly::AsyncTimeout {
+ public:
+  Connection(OpenMetricsServer* server, int fd)
+      : folly::AsyncTimeout(&server->evb_),
+        server_(server),
+        socket_(new folly::AsyncSocket(&server->evb_, fd)) {
+    socket_->setReadCB(this);
+    scheduleTimeout(kRequestTimeout);
+  }
+  ~Connection() override {
+    // Closing the socket may still fail the pending write
+    closing_ = true;
+    socket_->setReadCB(nullptr);
+  }
+
+  void getReadBuffer(void** bufReturn, size_t* lenReturn) override {
+    *bufReturn = readBuf_;
+    *lenReturn = sizeof(readBuf_);
+  }
+  void readDataAvailable(size_t len) noexcept override {
+    request_.append(readBuf_, len);
+    if (request_.find("\r\n\r\n") != std::string::npos) {
+      socket_->setReadCB(nullptr);
+      respond();
+    } else if (request_.size() > kMaxRequestSize) {
+      close();
+    }
+  }
+  void readEOF() noexcept override {
+    close();
+  }
+  void readErr(const folly::AsyncSocketException& /*ex*/) noexcept override {
+    close();
+  }
+
+  void writeSuccess() noexcept override {
+    close();
+  }
+  void writeErr(size_t /*bytesWritten*/,
+                const folly::AsyncSocketException& ex) noexcept override {
+    XLOG(DBG2) << "failed to send metrics: " << ex.what();
+    close();
+  }
+
+  void timeoutExpired() noexcept override {
+    close();
+  }
+
+ private:
+  void respond() {
+    // Only the request line matters, e.g. "GET /metrics HTTP/1.1"
+    auto line = folly::StringPiece(request_).split_step('\n');
+    auto method = line.split_step(' ');
+    auto path = line.split_step(' ').split_step('?');
+    std::unique_ptr<folly::IOBuf> buf;
+    if (method == "GET" && path == "/metrics") {
+      body_ = server_->renderer_.getRendered();
+      buf = folly::IOBuf::copyBuffer(folly::to<std::string>(
+          "HTTP/1.1 200 OK\r\nContent-Type: ", kContentType,
+          "\r\nContent-Length: ", body_->size(),
+          "\r\nConnection: close\r\n\r\n"));
+      // The snapshot is held until the write completes, so it is sent
+      // without a copy
+      buf->prependChain(folly::IOBuf::wrapBuffer(body_->data(), body_->size()));
+    } else {
+      buf = folly::IOBuf::copyBuffer(
+          "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\n"
+          "Connection: close\r\n\r\n");
+    }
+    socket_->writeChain(this, std::move(buf));
+  }
+
+  void close() {
+    if (closing_) {
+      return;
+    }
+    closing_ = true;
+    cancelTimeout();
+    socket_->setReadCB(nullptr);
+    socket_->closeNow();
+    // Destroys this
+    server_->removeConnection(this);
+  }
+
+  OpenMetricsServer* server_{nullptr};
+  folly::AsyncSocket::UniquePtr socket_;
+  char readBuf_[1024];
+  std::string request_;
+  std::shared_ptr<const std::string> body_;
+  bool closing_{false};
+};
+
+OpenMetricsServer::OpenMetricsServer(
+    std::string prefix, uint16_t port,
+    std::chrono::milliseconds refreshInterval)
+    : port_(port),
+      refreshInterval_(refreshInterval),
+      renderer_(std::move(prefix)) {
+  refreshTimeout_ = folly::AsyncTimeout::make(evb_, [this]() noexcept {
+    refresh();
+    refreshTimeout_->scheduleTimeout(refreshInterval_);
+  });
+}
+
+OpenMetricsServer::~OpenMetricsServer() {
+  stop();
+}
+
+void OpenMetricsServer::start() {
+  // So the first scrape already has the counters.  The event base isn't
+  // running yet, so it can be set up from this thread.
+  refresh();
+  socket_ = folly::AsyncServerSocket::newSocket(&evb_);
+  socket_->bind(port_);
+  socket_->listen(kListenBacklog);
+  socket_->addAcceptCallback(this, nullptr);
+  socket_->startAccepting();
+  refreshTimeout_->scheduleTimeout(refreshInterval_);
+
+  thread_ = std::thread([this] {
+    folly::setThreadName("OpenMetrics");
+    evb_.loopForever();
+  });
+  XLOG(INFO) << "serving OpenMetrics on port " << getPort();
+}
+
+void OpenMetricsServer::stop() {
+  if (!thread_.joinable()) {
+    return;
+  }
+  evb_.runInEventBaseThreadAndWait([this] {
+    refreshTimeout_->cancelTimeout();
+    socket_.reset();
+    connections_.clear();
+  });
+  evb_.terminateLoopSoon();
+  thread_.join();
+}
+
+uint16_t OpenMetricsServer::getPort() const {
+  if (!socket_) {
+    return port_;
+  }
+  folly::SocketAddress address;
+  socket_->getAddress(&address);
+  return address.getPort();
+}
+
+void OpenMetricsServer::connectionAccepted(
+    int fd, const folly::SocketAddress& /*clientAddr*/) noexcept {
+  auto conn = std::make_unique<Connection>(this, fd);
+  auto* ptr = conn.get();
+  connections_.emplace(ptr, std::move(conn));
+}
+
+void OpenMetricsServer::acceptError(const std::exception& ex) noexcept {
+  XLOG(ERR) << "failed to accept metrics connection: "
+            << folly::exceptionStr(ex);
+}
+
+void OpenMetricsServer::refresh() {
+  std::map<std::string, int64_t> counters;
+  fbData->getCounters(counters);
+  renderer_.update(counters);
+}
+
+void OpenMetricsServer::removeConnection(Connection* conn) {
+  connections_.erase(conn);
+}
+
+}} // facebook::fboss
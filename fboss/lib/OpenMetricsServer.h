@@ -0,0 +1,147 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#pragma once
+
+#include <folly/Range.h>
+#include <folly/io/async/AsyncServerSocket.h>
+#include <folly/io/async/AsyncTimeout.h>
+#include <folly/io/async/EventBase.h>
+#include <gflags/gflags.h>
+
+#include <chrono>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+DECLARE_int32(metrics_refresh_interval_ms);
+
+namespace facebook { namespace fboss {
+
+/*
+ * Renders ServiceData counters in the OpenMetrics text format.
+ *
+ * Counter names are turned into a metric family and labels once, the first
+ * time they are seen, e.g. "eth1/1/1.queue2.out_bytes.rate.60" becomes
+ *
+ *   <prefix>_port_queue_bytes{port="eth1/1/1",queue="2",direction="out",
+ *                             export="rate",window="60"}
+ *
+ * Each family keeps its rendered text, and update() only renders the
+ * families that had a value change, or a counter added or removed, again.
+ * The whole exposition is then rebuilt from those pieces, and handed out as
+ * an immutable snapshot, so readers never wait on rendering.
+ */
+class OpenMetricsRenderer {
+ public:
+  explicit OpenMetricsRenderer(std::string prefix);
+
+  struct Metric {
+    std::string family;
+    std::vector<std::pair<std::string, std::string>> labels;
+  };
+  /*
+   * The family and labels a counter is exported as.
+   */
+  Metric parse(folly::StringPiece counter) const;
+
+  /*
+   * Bring the exposition up to date with the current counters.  Counters
+   * that are no longer present are dropped.  Only one thread may update at
+   * a time.
+   */
+  void update(const std::map<std::string, int64_t>& counters);
+
+  std::shared_ptr<const std::string> getRendered() const;
+
+ private:
+  struct Family;
+  struct Sample {
+    Family* family{nullptr};
+    // The sample up to its value, e.g. "name{label="value"} "
+    std::string prefix;
+    int64_t value{0};
+    uint64_t generation{0};
+  };
+  struct Family {
+    std::string text;
+    std::map<std::string, const Sample*> samples;
+    bool dirty{true};
+  };
+
+  // Forbidden copy constructor and assignment operator
+  OpenMetricsRenderer(OpenMetricsRenderer const &) = delete;
+  OpenMetricsRenderer& operator=(OpenMetricsRenderer const &) = delete;
+
+  void render(const std::string& name, Family* family) const;
+
+  const std::string prefix_;
+  std::unordered_map<std::string, Sample> samples_;
+  std::map<std::string, Family> families_;
+  uint64_t generation_{0};
+
+  mutable std::mutex renderedLock_;
+  std::shared_ptr<const std::string> rendered_;
+};
+
+/*
+ * A minimal HTTP server for the OpenMetrics exposition of ServiceData, so
+ * counters can be scraped without a thrift client, and without rendering
+ * every counter for every request.
+ *
+ * It runs its own thread, which refreshes the exposition every
+ * refreshInterval and answers "GET /metrics" from the latest snapshot.
+ * Each connection serves one request and is then closed.
+ */
+class OpenMetricsServer : private folly::AsyncServerSocket::AcceptCallback {
+ public:
+  OpenMetricsServer(std::string prefix, uint16_t port,
+                    std::chrono::milliseconds refreshInterval);
+  ~OpenMetricsServer() override;
+
+  /*
+   * Bind the port and start serving.  Throws if the port can't be bound.
+   */
+  void start();
+  void stop();
+
+  uint16_t getPort() const;
+
+ private:
+  class Connection;
+
+  // Forbidden copy constructor and assignment operator
+  OpenMetricsServer(OpenMetricsServer const &) = delete;
+  OpenMetricsServer& operator=(OpenMetricsServer const &) = delete;
+
+  void connectionAccepted(
+      int fd, const folly::SocketAddress& clientAddr) noexcept override;
+  void acceptError(const std::exception& ex) noexcept override;
+
+  void refresh();
+  void removeConnection(Connection* conn);
+
+  const uint16_t port_;
+  const std::chrono::milliseconds refreshInterval_;
+  OpenMetricsRenderer renderer_;
+
+  folly::EventBase evb_;
+  std::thread thread_;
+  std::unique_ptr<folly::AsyncTimeout> refreshTimeout_;
+  std::shared_ptr<folly::AsyncServerSocket> socket_;
+  // Only used in the thread of the server
+  std::unordered_map<Connection*, std::unique_ptr<Connection>> connections_;
+};
+
+}} // facebook::fboss
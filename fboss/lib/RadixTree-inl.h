@@ -7,15 +7,15 @@ namespace facebook { namespace network {
 
 template<typename IPADDRTYPE, typename T>
 typename RadixTreeNode<IPADDRTYPE, T>::TreeDirection
-RadixTreeNode<IPADDRTYPE, T>::searchDirection(const IPADDRTYPE& toSearch,
+RadixTreeNode<IPADDRTYPE, T>::searchKeyDirection(const Key& toSearch,
     uint8_t toSearchMasklen) const {
   if (masklen_ < toSearchMasklen) {
     // My masklen is less than what is being searched, we are searching
     // a more specific address.
-    if (toSearch.mask(masklen_) == ipAddress_) {
+    if (KeyOps::prefixMatches(toSearch, key_, masklen_)) {
       // All the bits up to my bit length match, check the next bit
       // Note that bit lookup is 0 indexed.
-      return toSearch.getNthMSBit(masklen_) == 1 ? TreeDirection::RIGHT :
+      return KeyOps::bit(toSearch, masklen_) ? TreeDirection::RIGHT :
         TreeDirection::LEFT;
     } else {
       // Bits upto my mask len don't match. Go up towards the parent (i.e.
@@ -23,7 +23,7 @@ RadixTreeNode<IPADDRTYPE, T>::searchDirection(const IPADDRTYPE& toSearch,
       return TreeDirection::PARENT;
     }
   }
-  if (masklen_ == toSearchMasklen && ipAddress_ == toSearch) {
+  if (masklen_ == toSearchMasklen && key_ == toSearch) {
       return TreeDirection::THIS_NODE;
   }
   // 2 cases remain.
@@ -35,12 +35,9 @@ RadixTreeNode<IPADDRTYPE, T>::searchDirection(const IPADDRTYPE& toSearch,
 
 template<typename IPADDRTYPE, typename T, typename TreeTraits>
 const typename RadixTree<IPADDRTYPE, T, TreeTraits>::TreeNode*
-RadixTree<IPADDRTYPE, T, TreeTraits>::longestMatchImpl(const IPADDRTYPE& ipaddr,
+RadixTree<IPADDRTYPE, T, TreeTraits>::longestMatchKeyImpl(const Key& toMatch,
     uint8_t masklen, bool& foundExact, bool includeNonValueNodes,
     VecConstIterators* trail) const {
-  // Can't trust the clients to have 0s in all bits after mask length
-  const auto toMatch = ipaddr.mask(masklen);
-
   // Track parent pointer. This is done rather than relying
   // on node having a parent pointer always, to have the longest
   // match code be shared with implementations which don't
@@ -50,7 +47,7 @@ RadixTree<IPADDRTYPE, T, TreeTraits>::longestMatchImpl(const IPADDRTYPE& ipaddr,
   auto curNode = root_.get();
   auto done = false;
   while (curNode && !done) {
-    auto searchDirection = curNode->searchDirection(toMatch, masklen);
+    auto searchDirection = curNode->searchKeyDirection(toMatch, masklen);
     switch (searchDirection) {
       case TreeDirection::THIS_NODE:
         trailAppend(trail, includeNonValueNodes, curNode);
@@ -111,8 +108,9 @@ RadixTree<IPADDRTYPE, T, TreeTraits>::insert(const IPADDRTYPE& ipaddr,
     uint8_t mask, VALUE&& value) {
   auto foundExact = false;
   // Can't trust the clients to have 0s in all bits after mask length
-  auto toAdd = ipaddr.mask(mask);
-  auto bestMatch = longestMatchImpl(toAdd, mask, foundExact,
+  const auto toAddKey = KeyOps::mask(KeyOps::fromAddress(ipaddr), mask);
+  const auto toAdd = KeyOps::toAddress(toAddKey);
+  auto bestMatch = longestMatchKeyImpl(toAddKey, mask, foundExact,
       true /*include non value nodes*/);
   if (foundExact) {
     // Found exact match. Check if in use
@@ -138,15 +136,14 @@ RadixTree<IPADDRTYPE, T, TreeTraits>::insert(const IPADDRTYPE& ipaddr,
       // The root exists but this ipaddr, mask failed to
       // match even the root->ipaddr/mask. We need a less
       // specific root.
-      auto prefix = IPADDRTYPE::longestCommonPrefix(
-        {root_->ipAddress(), root_->masklen()}, {toAdd, mask});
+      auto prefix = commonPrefix(root_.get(), toAddKey, mask);
       std::unique_ptr<TreeNode> newRoot = nullptr;
-      if (prefix.first == toAdd && prefix.second == mask) {
+      if (prefix.second == mask) {
         // To be added node is the new root
         newRoot = std::move(newNode);
       } else {
         // Add new root as a non value internal node
-        newRoot = makeNode(prefix.first, prefix.second);
+        newRoot = makeNode(KeyOps::toAddress(prefix.first), prefix.second);
       }
       auto oldRootDirection = newRoot->searchDirection(root_.get());
       CHECK(oldRootDirection == TreeDirection::LEFT ||
@@ -166,7 +163,7 @@ RadixTree<IPADDRTYPE, T, TreeTraits>::insert(const IPADDRTYPE& ipaddr,
       makeRoot(std::move(newRoot));
     }
   } else {
-    auto toAddDirection = bestMatch->searchDirection(toAdd, mask);
+    auto toAddDirection = bestMatch->searchKeyDirection(toAddKey, mask);
     auto done = false;
     CHECK(toAddDirection == TreeDirection::LEFT ||
         toAddDirection == TreeDirection::RIGHT);
@@ -188,9 +185,7 @@ RadixTree<IPADDRTYPE, T, TreeTraits>::insert(const IPADDRTYPE& ipaddr,
       } else {
         bestMatchChild = bestMatch->right();
       }
-      auto prefix = IPADDRTYPE::longestCommonPrefix(
-        {bestMatchChild->ipAddress(), bestMatchChild->masklen()},
-        {toAdd, mask});
+      auto prefix = commonPrefix(bestMatchChild, toAddKey, mask);
       // Prefix should not already exist in the tree.
       // The reason for this is that the longest common prefix
       // should be a more specific than bestMatch but less specific
@@ -203,11 +198,13 @@ RadixTree<IPADDRTYPE, T, TreeTraits>::insert(const IPADDRTYPE& ipaddr,
       // a longest match. Since there are no nodes b/w bestMatch
       // and its child we know that the longest common prefix
       // should not be on tree.
-      DCHECK(exactMatch(prefix.first, prefix.second) == end());
-      if (prefix.first != toAdd || prefix.second != mask) {
+      DCHECK(exactMatch(KeyOps::toAddress(prefix.first), prefix.second) ==
+          end());
+      if (prefix.second != mask) {
         // We need to insert a non value internal node as a parent of
         // bestMatchChild and new node.
-        auto internalNode = makeNode(prefix.first, prefix.second);
+        auto internalNode =
+          makeNode(KeyOps::toAddress(prefix.first), prefix.second);
         auto internalNodeRaw = internalNode.get();
         std::unique_ptr<TreeNode> oldBestMatchChild = nullptr;
         if (toAddDirection ==  TreeDirection::LEFT) {
@@ -5,6 +5,7 @@
 
 #include <sys/socket.h>
 #include <algorithm>
+#include <cstring>
 #include <exception>
 #include <functional>
 #include <memory>
@@ -17,8 +18,126 @@
 #include <folly/IPAddress.h>
 #include <folly/IPAddressV4.h>
 #include <folly/IPAddressV6.h>
+#include <folly/lang/Bits.h>
 
 namespace facebook { namespace network {
+/*
+ * Operations on the keys that RadixTree nodes are compared by. The tree
+ * walks and inserts work on a Key, which for IPv4 and IPv6 addresses is a
+ * plain integer form of the address in host byte order, so that masking,
+ * bit tests and common prefixes are a few integer operations rather than
+ * address methods that build temporaries. The primary template keeps the
+ * address itself as the key, for any other address type.
+ */
+template<typename IPADDRTYPE>
+struct RadixTreeKeyOps {
+  typedef IPADDRTYPE Key;
+
+  static Key fromAddress(const IPADDRTYPE& ipAddr) { return ipAddr; }
+  static IPADDRTYPE toAddress(const Key& key) { return key; }
+  static Key mask(const Key& key, uint8_t masklen) {
+    return key.mask(masklen);
+  }
+  // Whether the first masklen bits of key and prefix are the same
+  static bool prefixMatches(const Key& key, const Key& prefix,
+      uint8_t masklen) {
+    return key.mask(masklen) == prefix;
+  }
+  // The bit after the first n bits; n must be less than the bit count
+  static bool bit(const Key& key, uint8_t n) {
+    return key.getNthMSBit(n);
+  }
+  // Number of leading bits a and b share, at most maxlen
+  static uint8_t commonPrefixLength(const Key& a, const Key& b,
+      uint8_t maxlen) {
+    return IPADDRTYPE::longestCommonPrefix({a, maxlen}, {b, maxlen}).second;
+  }
+};
+
+template<>
+struct RadixTreeKeyOps<folly::IPAddressV4> {
+  typedef uint32_t Key;
+
+  static Key fromAddress(const folly::IPAddressV4& ipAddr) {
+    return ipAddr.toLongHBO();
+  }
+  static folly::IPAddressV4 toAddress(Key key) {
+    return folly::IPAddressV4::fromLongHBO(key);
+  }
+  // Mask of the first masklen bits, for masklen up to 32
+  static constexpr uint32_t prefixMask(uint8_t masklen) {
+    return static_cast<uint32_t>(~uint64_t(0) << (32 - masklen));
+  }
+  static constexpr Key mask(Key key, uint8_t masklen) {
+    return key & prefixMask(masklen);
+  }
+  static constexpr bool prefixMatches(Key key, Key prefix, uint8_t masklen) {
+    return ((key ^ prefix) & prefixMask(masklen)) == 0;
+  }
+  static constexpr bool bit(Key key, uint8_t n) {
+    return (key >> (31 - n)) & 1;
+  }
+  static uint8_t commonPrefixLength(Key a, Key b, uint8_t maxlen) {
+    auto diff = a ^ b;
+    uint8_t common = diff ? __builtin_clz(diff) : 32;
+    return std::min(common, maxlen);
+  }
+};
+
+template<>
+struct RadixTreeKeyOps<folly::IPAddressV6> {
+  // The high and low 64 bits of the address
+  struct Key {
+    uint64_t hi;
+    uint64_t lo;
+    constexpr bool operator==(const Key& r) const {
+      return hi == r.hi && lo == r.lo;
+    }
+  };
+
+  static Key fromAddress(const folly::IPAddressV6& ipAddr) {
+    uint64_t words[2];
+    std::memcpy(words, ipAddr.bytes(), sizeof(words));
+    return Key{folly::Endian::big(words[0]), folly::Endian::big(words[1])};
+  }
+  static folly::IPAddressV6 toAddress(const Key& key) {
+    uint64_t words[2] = {
+      folly::Endian::big(key.hi), folly::Endian::big(key.lo)};
+    folly::ByteArray16 bytes;
+    std::memcpy(bytes.data(), words, sizeof(words));
+    return folly::IPAddressV6(bytes);
+  }
+  // Mask of the first masklen bits of a word, for masklen up to 64
+  static constexpr uint64_t wordMask(uint8_t masklen) {
+    return masklen == 0 ? 0 : ~uint64_t(0) << (64 - masklen);
+  }
+  static constexpr uint64_t hiMask(uint8_t masklen) {
+    return wordMask(masklen < 64 ? masklen : 64);
+  }
+  static constexpr uint64_t loMask(uint8_t masklen) {
+    return wordMask(masklen > 64 ? masklen - 64 : 0);
+  }
+  static constexpr Key mask(const Key& key, uint8_t masklen) {
+    return Key{key.hi & hiMask(masklen), key.lo & loMask(masklen)};
+  }
+  static constexpr bool prefixMatches(const Key& key, const Key& prefix,
+      uint8_t masklen) {
+    return (((key.hi ^ prefix.hi) & hiMask(masklen)) |
+            ((key.lo ^ prefix.lo) & loMask(masklen))) == 0;
+  }
+  static constexpr bool bit(const Key& key, uint8_t n) {
+    return ((n < 64 ? key.hi : key.lo) >> (63 - (n & 63))) & 1;
+  }
+  static uint8_t commonPrefixLength(const Key& a, const Key& b,
+      uint8_t maxlen) {
+    auto hiDiff = a.hi ^ b.hi;
+    auto loDiff = a.lo ^ b.lo;
+    uint8_t common = hiDiff ? __builtin_clzll(hiDiff) :
+      loDiff ? 64 + __builtin_clzll(loDiff) : 128;
+    return std::min(common, maxlen);
+  }
+};
+
 /*
  * Node in RadixTree, holds IP, mask. Will hold  value for nodes
  * created as a result of user inserts. Other type of nodes are
@@ -32,16 +151,19 @@ class RadixTreeNode {
   // Optional function parameter to call from destructor
   typedef std::function<void(const RadixTreeNode<IPADDRTYPE, T>&)>
     NodeDeleteCallback;
+  typedef RadixTreeKeyOps<IPADDRTYPE> KeyOps;
+  typedef typename KeyOps::Key Key;
 
   RadixTreeNode(const IPADDRTYPE& ipAddr, uint8_t mlen,
       NodeDeleteCallback deleteCallback):
-    ipAddress_(ipAddr), masklen_(mlen), deleteCallback_(deleteCallback) {}
+    ipAddress_(ipAddr), key_(KeyOps::fromAddress(ipAddr)), masklen_(mlen),
+    deleteCallback_(deleteCallback) {}
 
   template<typename VALUE>
   RadixTreeNode(const IPADDRTYPE& ipAddr, uint8_t mlen, VALUE&& val,
        NodeDeleteCallback deleteCallback): ipAddress_(ipAddr),
-  masklen_(mlen), value_(std::forward<VALUE>(val)),
-  deleteCallback_(deleteCallback) {}
+  key_(KeyOps::fromAddress(ipAddr)), masklen_(mlen),
+  value_(std::forward<VALUE>(val)), deleteCallback_(deleteCallback) {}
 
   ~RadixTreeNode() {
     if (deleteCallback_) {
@@ -52,6 +174,7 @@ class RadixTreeNode {
   enum class TreeDirection { LEFT, RIGHT, PARENT, THIS_NODE};
 
   const IPADDRTYPE&  ipAddress() const { return ipAddress_;  }
+  const Key& key() const { return key_; }
   bool  isNonValueNode() const { return !isValueNode(); }
   bool  isValueNode()   const  { return value_.hasValue(); }
   uint32_t masklen() const { return masklen_; }
@@ -76,13 +199,19 @@ class RadixTreeNode {
 
   // Given a IP, mask pair determine where that might lie w.r.t. this node
   TreeDirection  searchDirection(const IPADDRTYPE& toSearch,
-      uint8_t masklen) const;
+      uint8_t masklen) const {
+    return searchKeyDirection(KeyOps::fromAddress(toSearch), masklen);
+  }
 
   TreeDirection searchDirection(
       const RadixTreeNode<IPADDRTYPE, T>* node) const {
-    return searchDirection(node->ipAddress_, node->masklen_);
+    return searchKeyDirection(node->key_, node->masklen_);
   }
 
+  // As searchDirection, for a key whose bits after masklen are all 0
+  TreeDirection searchKeyDirection(const Key& toSearch,
+      uint8_t masklen) const;
+
   // Comparison with links (left, right, parent) ignored
   bool equalSansLinks(const RadixTreeNode& r) const {
     return ipAddress_ == r.ipAddress_ && masklen_ == r.masklen_ &&
@@ -124,6 +253,7 @@ class RadixTreeNode {
   }
  protected:
   IPADDRTYPE ipAddress_;
+  Key key_; // ipAddress_ as the tree compares it
   uint32_t masklen_{0}; // Number of bits to match.
   folly::Optional<T> value_;
   std::unique_ptr<RadixTreeNode> left_{nullptr};
@@ -344,6 +474,8 @@ class RadixTree {
   typedef RadixTreeNode<IPADDRTYPE, T>           TreeNode;
   typedef typename TreeNode::TreeDirection       TreeDirection;
   typedef typename TreeNode::NodeDeleteCallback  NodeDeleteCallback;
+  typedef typename TreeNode::KeyOps              KeyOps;
+  typedef typename TreeNode::Key                 Key;
   typedef typename TreeTraits::Iterator          Iterator;
   typedef typename TreeTraits::ConstIterator     ConstIterator;
   typedef typename std::vector<ConstIterator>    VecConstIterators;
@@ -530,17 +662,28 @@ class RadixTree {
   const TreeTraits&  traits() const { return traits_; }
  private:
   static std::unique_ptr<TreeNode> cloneSubTree(const TreeNode* node);
-  // Worker function to do the actual longest match lookup.
+  // Longest match lookup of a IP, mask
   const TreeNode* longestMatchImpl(const IPADDRTYPE& ipaddr,
+      uint8_t masklen, bool& foundExact, bool includeNonValueNodes = false,
+      VecConstIterators* trail = nullptr) const {
+    // Can't trust the clients to have 0s in all bits after mask length
+    return longestMatchKeyImpl(
+        KeyOps::mask(KeyOps::fromAddress(ipaddr), masklen), masklen,
+        foundExact, includeNonValueNodes, trail);
+  }
+
+  // Worker function to do the actual longest match lookup, of a key
+  // whose bits after masklen are all 0
+  const TreeNode* longestMatchKeyImpl(const Key& toMatch,
       uint8_t masklen, bool& foundExact, bool includeNonValueNodes = false,
       VecConstIterators* trail = nullptr) const;
 
   // Non const longest match lookup
-  TreeNode* longestMatchImpl(const IPADDRTYPE& ipaddr, uint8_t masklen,
+  TreeNode* longestMatchKeyImpl(const Key& toMatch, uint8_t masklen,
       bool& foundExact, bool includeNonValueNodes = false,
       VecConstIterators* trail = nullptr) {
     return const_cast<TreeNode*>(
-          const_cast<const RadixTree*>(this)->longestMatchImpl(ipaddr,
+          const_cast<const RadixTree*>(this)->longestMatchKeyImpl(toMatch,
             masklen, foundExact, includeNonValueNodes, trail));
   }
 
@@ -565,6 +708,15 @@ class RadixTree {
     root_ = std::move(newRoot);
   }
 
+  // The longest prefix covering both node and the key, masklen being
+  // inserted; the key is itself that prefix if its masklen is returned
+  static std::pair<Key, uint8_t> commonPrefix(const TreeNode* node,
+      const Key& key, uint8_t masklen) {
+    auto prefixlen = KeyOps::commonPrefixLength(node->key(), key,
+        std::min<uint8_t>(node->masklen(), masklen));
+    return std::make_pair(KeyOps::mask(key, prefixlen), prefixlen);
+  }
+
   inline void trailAppend(VecConstIterators* trail,
   bool includeNonValueNodes, const TreeNode* node) const;
 
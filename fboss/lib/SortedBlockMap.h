@@ -0,0 +1,487 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#pragma once
+
+#include <glog/logging.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace facebook { namespace fboss {
+
+/*
+ * SortedBlockMap is an ordered map laid out like a flat map cut into
+ * blocks: the entries are kept sorted in blocks of at most kBlockSize
+ * entries, and a sorted index of the first key of each block finds the
+ * block a key belongs in.
+ *
+ * Lookups are two binary searches over contiguous memory, as in a flat map.
+ * An insertion or erasure only moves the entries after it in its own block,
+ * plus, when a block splits or empties, the index entries after it, so a
+ * table of hundreds of thousands of entries can be changed one entry at a
+ * time without moving the whole table each time.
+ *
+ * insertSorted() and eraseSorted() apply a sorted batch of changes.  Large
+ * batches are merged with the map in a single pass that rebuilds the
+ * blocks; small ones are applied one entry at a time.
+ *
+ * The blocks come from AllocatorT, and each holds exactly kBlockSize
+ * entries' worth of memory, allocated up front, so an allocator can serve
+ * them from a pool of fixed size blocks.
+ *
+ * Any change to the map invalidates all of its iterators.
+ */
+template <
+    typename KeyT,
+    typename ValueT,
+    typename CompareT = std::less<KeyT>,
+    size_t kBlockSize = 256,
+    typename AllocatorT = std::allocator<std::pair<KeyT, ValueT>>>
+class SortedBlockMap {
+  static_assert(kBlockSize >= 4, "Blocks must hold at least 4 entries");
+
+ public:
+  using key_type = KeyT;
+  using mapped_type = ValueT;
+  using value_type = std::pair<KeyT, ValueT>;
+  using size_type = size_t;
+  using allocator_type = AllocatorT;
+  // The bytes of each block allocation
+  static constexpr size_t kBlockBytes = kBlockSize * sizeof(value_type);
+
+ private:
+  using Block = std::vector<value_type, AllocatorT>;
+  // Blocks are filled to this size when the map is rebuilt, leaving room
+  // for later insertions
+  static constexpr size_t kFillSize = kBlockSize * 3 / 4;
+  // A block this small is merged with a neighbor if they fit in one block
+  static constexpr size_t kMergeSize = kBlockSize / 4;
+
+  template <bool kConst>
+  class IteratorImpl {
+   public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = typename SortedBlockMap::value_type;
+    using difference_type = std::ptrdiff_t;
+    using pointer =
+        typename std::conditional<kConst, const value_type*, value_type*>::
+            type;
+    using reference =
+        typename std::conditional<kConst, const value_type&, value_type&>::
+            type;
+    using MapPtr = typename std::
+        conditional<kConst, const SortedBlockMap*, SortedBlockMap*>::type;
+
+    IteratorImpl() {}
+    IteratorImpl(MapPtr map, size_t block, size_t pos)
+        : map_(map), block_(block), pos_(pos) {}
+    // A mutable iterator converts to a const one
+    template <bool kOtherConst, typename = typename std::enable_if<
+        kConst && !kOtherConst>::type>
+    /* implicit */ IteratorImpl(const IteratorImpl<kOtherConst>& other)
+        : map_(other.map_), block_(other.block_), pos_(other.pos_) {}
+
+    reference operator*() const {
+      return (*map_->blocks_[block_])[pos_];
+    }
+    pointer operator->() const {
+      return &**this;
+    }
+    IteratorImpl& operator++() {
+      if (++pos_ == map_->blocks_[block_]->size()) {
+        ++block_;
+        pos_ = 0;
+      }
+      return *this;
+    }
+    IteratorImpl operator++(int) {
+      auto old = *this;
+      ++*this;
+      return old;
+    }
+    bool operator==(const IteratorImpl& other) const {
+      return block_ == other.block_ && pos_ == other.pos_;
+    }
+    bool operator!=(const IteratorImpl& other) const {
+      return !(*this == other);
+    }
+
+   private:
+    friend class SortedBlockMap;
+    template <bool>
+    friend class IteratorImpl;
+
+    MapPtr map_{nullptr};
+    size_t block_{0};
+    size_t pos_{0};
+  };
+
+ public:
+  using iterator = IteratorImpl<false>;
+  using const_iterator = IteratorImpl<true>;
+
+  SortedBlockMap() {}
+  explicit SortedBlockMap(const AllocatorT& alloc) : alloc_(alloc) {}
+  SortedBlockMap(SortedBlockMap&&) = default;
+  SortedBlockMap& operator=(SortedBlockMap&&) = default;
+
+  size_t size() const {
+    return size_;
+  }
+  bool empty() const {
+    return size_ == 0;
+  }
+  /*
+   * The number of entries the blocks have room for, so that the memory the
+   * map takes can be estimated.
+   */
+  size_t capacity() const {
+    return blocks_.size() * kBlockSize;
+  }
+  size_t numBlocks() const {
+    return blocks_.size();
+  }
+  AllocatorT get_allocator() const {
+    return alloc_;
+  }
+
+  iterator begin() {
+    return iterator(this, 0, 0);
+  }
+  iterator end() {
+    return iterator(this, blocks_.size(), 0);
+  }
+  const_iterator begin() const {
+    return const_iterator(this, 0, 0);
+  }
+  const_iterator end() const {
+    return const_iterator(this, blocks_.size(), 0);
+  }
+
+  iterator find(const KeyT& key) {
+    size_t block, pos;
+    return findPosition(key, &block, &pos) ? iterator(this, block, pos)
+                                           : end();
+  }
+  const_iterator find(const KeyT& key) const {
+    size_t block, pos;
+    return findPosition(key, &block, &pos) ? const_iterator(this, block, pos)
+                                           : end();
+  }
+
+  /*
+   * Insert an entry for key, with its value constructed from args, unless
+   * there already is one.  Returns an iterator to the entry for key and
+   * whether it was inserted, as std::map::emplace() does.
+   */
+  template <typename... Args>
+  std::pair<iterator, bool> emplace(const KeyT& key, Args&&... args) {
+    if (blocks_.empty()) {
+      blocks_.push_back(newBlock());
+      firstKeys_.push_back(key);
+      blocks_[0]->emplace_back(
+          std::piecewise_construct,
+          std::forward_as_tuple(key),
+          std::forward_as_tuple(std::forward<Args>(args)...));
+      ++size_;
+      return std::make_pair(begin(), true);
+    }
+    auto block = blockFor(key);
+    auto pos = lowerBound(*blocks_[block], key);
+    if (pos < blocks_[block]->size() &&
+        !compare_(key, (*blocks_[block])[pos].first)) {
+      return std::make_pair(iterator(this, block, pos), false);
+    }
+    if (blocks_[block]->size() == kBlockSize) {
+      split(block);
+      auto half = blocks_[block]->size();
+      if (pos > half) {
+        ++block;
+        pos -= half;
+      }
+    }
+    auto& entries = *blocks_[block];
+    entries.emplace(
+        entries.begin() + pos,
+        std::piecewise_construct,
+        std::forward_as_tuple(key),
+        std::forward_as_tuple(std::forward<Args>(args)...));
+    if (pos == 0) {
+      firstKeys_[block] = key;
+    }
+    ++size_;
+    return std::make_pair(iterator(this, block, pos), true);
+  }
+
+  std::pair<iterator, bool> insert(value_type&& entry) {
+    return emplace(entry.first, std::move(entry.second));
+  }
+
+  void erase(const_iterator iter) {
+    auto block = iter.block_;
+    auto pos = iter.pos_;
+    auto& entries = *blocks_[block];
+    entries.erase(entries.begin() + pos);
+    --size_;
+    if (entries.empty()) {
+      blocks_.erase(blocks_.begin() + block);
+      firstKeys_.erase(firstKeys_.begin() + block);
+      return;
+    }
+    if (pos == 0) {
+      firstKeys_[block] = entries.front().first;
+    }
+    if (entries.size() < kMergeSize) {
+      maybeMerge(block);
+    }
+  }
+
+  size_t erase(const KeyT& key) {
+    auto iter = find(key);
+    if (iter == end()) {
+      return 0;
+    }
+    erase(iter);
+    return 1;
+  }
+
+  void clear() {
+    blocks_.clear();
+    firstKeys_.clear();
+    size_ = 0;
+  }
+
+  /*
+   * Insert the entries in [first, last), which must be sorted by key and
+   * have no two entries with the same key, moving them out of the range.
+   * Entries whose key is already in the map are dropped, as with
+   * boost::container::flat_map's ordered_unique_range insertion.
+   */
+  template <typename InputIt>
+  void insertSorted(InputIt first, InputIt last) {
+    auto count = static_cast<size_t>(std::distance(first, last));
+    if (!useRebuild(count)) {
+      for (; first != last; ++first) {
+        emplace(first->first, std::move(first->second));
+      }
+      return;
+    }
+    Builder builder(this, count + size_);
+    auto old = begin();
+    auto oldEnd = end();
+    while (first != last) {
+      DCHECK(std::next(first) == last ||
+             compare_(first->first, std::next(first)->first));
+      if (old != oldEnd && !compare_(first->first, old->first)) {
+        if (!compare_(old->first, first->first)) {
+          // Already in the map
+          ++first;
+        }
+        builder.push(std::move(*old++));
+      } else {
+        builder.push(value_type(std::move(first->first),
+                                std::move(first->second)));
+        ++first;
+      }
+    }
+    for (; old != oldEnd; ++old) {
+      builder.push(std::move(*old));
+    }
+    builder.finish(this);
+  }
+
+  /*
+   * Erase the entries with the keys in [first, last), which must be sorted.
+   * Returns the number of entries erased.
+   */
+  template <typename InputIt>
+  size_t eraseSorted(InputIt first, InputIt last) {
+    auto count = static_cast<size_t>(std::distance(first, last));
+    size_t erased = 0;
+    if (!useRebuild(count)) {
+      for (; first != last; ++first) {
+        erased += erase(*first);
+      }
+      return erased;
+    }
+    Builder builder(this, size_ > count ? size_ - count : 0);
+    for (auto& entry : *this) {
+      while (first != last && compare_(*first, entry.first)) {
+        ++first;
+      }
+      if (first != last && !compare_(entry.first, *first)) {
+        ++first;
+        ++erased;
+        continue;
+      }
+      builder.push(std::move(entry));
+    }
+    // The erased entries are destroyed with the old blocks
+    builder.finish(this);
+    return erased;
+  }
+
+ private:
+  // Forbidden copy constructor and assignment operator
+  SortedBlockMap(SortedBlockMap const &) = delete;
+  SortedBlockMap& operator=(SortedBlockMap const &) = delete;
+
+  /*
+   * Fills new blocks in order for a rebuild.  The old blocks are only
+   * replaced in finish(), so that the entries being moved out of them stay
+   * valid until then.
+   */
+  class Builder {
+   public:
+    Builder(const SortedBlockMap* map, size_t expected) : map_(map) {
+      auto numBlocks = (expected + kFillSize - 1) / kFillSize;
+      blocks_.reserve(numBlocks);
+      firstKeys_.reserve(numBlocks);
+    }
+    void push(value_type&& entry) {
+      if (blocks_.empty() || blocks_.back()->size() == kFillSize) {
+        blocks_.push_back(map_->newBlock());
+        firstKeys_.push_back(entry.first);
+      }
+      blocks_.back()->push_back(std::move(entry));
+      ++size_;
+    }
+    void finish(SortedBlockMap* map) {
+      std::swap(map->blocks_, blocks_);
+      std::swap(map->firstKeys_, firstKeys_);
+      map->size_ = size_;
+    }
+
+   private:
+    const SortedBlockMap* map_;
+    std::vector<std::unique_ptr<Block>> blocks_;
+    std::vector<KeyT> firstKeys_;
+    size_t size_{0};
+  };
+
+  std::unique_ptr<Block> newBlock() const {
+    auto block = std::make_unique<Block>(alloc_);
+    block->reserve(kBlockSize);
+    return block;
+  }
+
+  /*
+   * Whether a batch of count changes is cheaper to merge in a rebuild of
+   * all blocks than one at a time, each moving half a block on average.
+   */
+  bool useRebuild(size_t count) const {
+    return count * (kBlockSize / 2) >= size_;
+  }
+
+  // The block key is in or would be inserted in, for a non-empty map
+  size_t blockFor(const KeyT& key) const {
+    auto iter = std::upper_bound(
+        firstKeys_.begin(), firstKeys_.end(), key, compare_);
+    return iter == firstKeys_.begin() ? 0 : iter - firstKeys_.begin() - 1;
+  }
+
+  size_t lowerBound(const Block& block, const KeyT& key) const {
+    auto iter = std::lower_bound(
+        block.begin(), block.end(), key,
+        [this](const value_type& entry, const KeyT& k) {
+          return compare_(entry.first, k);
+        });
+    return iter - block.begin();
+  }
+
+  bool findPosition(const KeyT& key, size_t* block, size_t* pos) const {
+    if (blocks_.empty()) {
+      return false;
+    }
+    *block = blockFor(key);
+    const auto& entries = *blocks_[*block];
+    *pos = lowerBound(entries, key);
+    return *pos < entries.size() && !compare_(key, entries[*pos].first);
+  }
+
+  // Move the upper half of a full block to a new block after it
+  void split(size_t block) {
+    auto& entries = *blocks_[block];
+    auto upper = newBlock();
+    auto half = entries.size() / 2;
+    std::move(
+        entries.begin() + half, entries.end(), std::back_inserter(*upper));
+    entries.erase(entries.begin() + half, entries.end());
+    firstKeys_.insert(firstKeys_.begin() + block + 1, upper->front().first);
+    blocks_.insert(blocks_.begin() + block + 1, std::move(upper));
+  }
+
+  // Merge a small block into a neighbor, if they fit in one block
+  void maybeMerge(size_t block) {
+    auto smallerNeighbor = [&]() -> size_t {
+      if (block == 0) {
+        return 1;
+      } else if (block + 1 == blocks_.size()) {
+        return block - 1;
+      }
+      return blocks_[block - 1]->size() < blocks_[block + 1]->size()
+          ? block - 1
+          : block + 1;
+    };
+    if (blocks_.size() < 2) {
+      return;
+    }
+    auto lower = std::min(block, smallerNeighbor());
+    auto& into = *blocks_[lower];
+    auto& from = *blocks_[lower + 1];
+    if (into.size() + from.size() > kFillSize) {
+      return;
+    }
+    std::move(from.begin(), from.end(), std::back_inserter(into));
+    blocks_.erase(blocks_.begin() + lower + 1);
+    firstKeys_.erase(firstKeys_.begin() + lower + 1);
+  }
+
+  std::vector<std::unique_ptr<Block>> blocks_;
+  // The first key of each block
+  std::vector<KeyT> firstKeys_;
+  size_t size_{0};
+  CompareT compare_;
+  AllocatorT alloc_;
+};
+
+template <
+    typename KeyT,
+    typename ValueT,
+    typename CompareT,
+    size_t kBlockSize,
+    typename AllocatorT>
+constexpr size_t SortedBlockMap<KeyT, ValueT, CompareT, kBlockSize,
+                                AllocatorT>::kBlockBytes;
+template <
+    typename KeyT,
+    typename ValueT,
+    typename CompareT,
+    size_t kBlockSize,
+    typename AllocatorT>
+constexpr size_t
+    SortedBlockMap<KeyT, ValueT, CompareT, kBlockSize, AllocatorT>::kFillSize;
+template <
+    typename KeyT,
+    typename ValueT,
+    typename CompareT,
+    size_t kBlockSize,
+    typename AllocatorT>
+constexpr size_t
+    SortedBlockMap<KeyT, ValueT, CompareT, kBlockSize, AllocatorT>::kMergeSize;
+
+}} // facebook::fboss
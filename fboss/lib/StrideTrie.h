@@ -0,0 +1,525 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#pragma once
+
+#include <folly/IPAddressV4.h>
+#include <folly/IPAddressV6.h>
+#include <folly/Optional.h>
+#include <folly/Range.h>
+#include <glog/logging.h>
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace facebook { namespace network {
+
+namespace detail {
+/*
+ * The storage for StrideTrie nodes and values: a vector whose elements are
+ * held in fixed size chunks shared between copies.  As with
+ * fboss::PersistentNodeContainer, a chunk is copied the first time it is
+ * written to while shared, so a copy only costs one pointer per chunk and
+ * writes to it only copy the chunks they touch.
+ */
+template <typename ElemT, size_t kChunkSize>
+class StrideTrieStorage {
+ public:
+  size_t size() const {
+    return size_;
+  }
+
+  const ElemT& operator[](uint32_t index) const {
+    return (*chunks_[index / kChunkSize])[index % kChunkSize];
+  }
+
+  ElemT& writable(uint32_t index) {
+    auto& chunk = chunks_[index / kChunkSize];
+    if (chunk.use_count() > 1) {
+      chunk = std::make_shared<Chunk>(*chunk);
+    }
+    return (*chunk)[index % kChunkSize];
+  }
+
+  // Append a default constructed element and return its index
+  uint32_t emplace_back() {
+    if (size_ % kChunkSize == 0) {
+      chunks_.push_back(std::make_shared<Chunk>());
+      return size_++;
+    }
+    writable(size_) = ElemT();
+    return size_++;
+  }
+
+  void clear() {
+    chunks_.clear();
+    size_ = 0;
+  }
+
+  // Call fn(chunk, bytes) for each chunk, which copies may share
+  template <typename Fn>
+  void forEachChunk(Fn fn) const {
+    for (const auto& chunk : chunks_) {
+      fn(static_cast<const void*>(chunk.get()), sizeof(Chunk));
+    }
+  }
+
+ private:
+  using Chunk = std::array<ElemT, kChunkSize>;
+
+  std::vector<std::shared_ptr<Chunk>> chunks_;
+  uint32_t size_{0};
+};
+} // namespace detail
+
+/*
+ * StrideTrie is a longest prefix match table with the same interface as
+ * RadixTree, laid out for lookup speed rather than update speed.
+ *
+ * Each level of the trie consumes STRIDE bits of the address.  A node holds
+ * the prefixes that end within its STRIDE bits (2^STRIDE - 1 of them, in
+ * tree bitmap order) and its 2^STRIDE children.  Nodes and values live in
+ * two contiguous vectors and refer to each other by index, so a lookup
+ * touches at most bitCount() / STRIDE + 1 nodes instead of one heap allocated
+ * node per bit of the matched prefix, and the whole trie is freed with two
+ * deallocations.
+ *
+ * Nodes are only created along the paths to inserted prefixes, which keeps
+ * sparse IPv6 tables compact with the default stride.  Erased nodes and
+ * values are reused by later inserts.
+ *
+ * The trie is persistent: copying it shares all nodes and values with the
+ * original, and later writes to either copy only copy the storage chunks
+ * they touch, i.e. the chunks holding the nodes on the path to the modified
+ * prefix.  As with the SwitchState, a trie that has been copied must not be
+ * modified while another thread may be copying or reading it.  Dereferencing
+ * a non-const iterator's value() may copy the chunk it points into, so
+ * read-only walks should go through a const reference.
+ *
+ * Unlike RadixTree, iteration is in insertion order rather than prefix order,
+ * and inserts may invalidate existing iterators.
+ */
+template <typename IPADDRTYPE, typename T, uint8_t STRIDE = 4>
+class StrideTrie {
+  static_assert(
+      STRIDE == 1 || STRIDE == 2 || STRIDE == 4 || STRIDE == 8,
+      "STRIDE must divide 8");
+
+  static constexpr uint32_t kFanout = 1 << STRIDE;
+  static constexpr uint32_t kNumPrefixSlots = kFanout - 1;
+  static constexpr uint32_t kNone = 0xffffffff;
+  static constexpr uint32_t kRoot = 0;
+
+  struct Node {
+    Node() {
+      std::fill(prefixes, prefixes + kNumPrefixSlots, kNone);
+      std::fill(children, children + kFanout, kNone);
+    }
+    // Index in entries_ of the prefix with in-node length l and bits b, at
+    // slot (1 << l) - 1 + b
+    uint32_t prefixes[kNumPrefixSlots];
+    // Index in nodes_ of the child for each value of the next STRIDE bits
+    uint32_t children[kFanout];
+    // Number of prefixes and children in use, for reclaiming empty nodes
+    uint32_t numUsed{0};
+  };
+
+  struct Entry {
+    IPADDRTYPE ipAddress;
+    uint8_t masklen{0};
+    // Empty for entries on the free list
+    folly::Optional<T> value;
+  };
+
+  template <typename TrieT, typename ValueT>
+  class IteratorImpl {
+   public:
+    IteratorImpl() {}
+    IteratorImpl(TrieT* trie, uint32_t index) : trie_(trie), index_(index) {
+      skipFree();
+    }
+    // Allow conversion from Iterator to ConstIterator
+    template <typename OtherTrieT, typename OtherValueT>
+    /* implicit */ IteratorImpl(
+        const IteratorImpl<OtherTrieT, OtherValueT>& other)
+        : trie_(other.trie_), index_(other.index_) {}
+
+    // As with RadixTree, the iterator doubles as the element
+    IteratorImpl& operator*() {
+      return *this;
+    }
+    const IteratorImpl& operator*() const {
+      return *this;
+    }
+    IteratorImpl* operator->() {
+      return this;
+    }
+    const IteratorImpl* operator->() const {
+      return this;
+    }
+
+    IteratorImpl& operator++() {
+      ++index_;
+      skipFree();
+      return *this;
+    }
+    IteratorImpl operator++(int) {
+      auto prev = *this;
+      ++(*this);
+      return prev;
+    }
+
+    bool operator==(const IteratorImpl& r) const {
+      return index() == r.index();
+    }
+    bool operator!=(const IteratorImpl& r) const {
+      return !(*this == r);
+    }
+
+    bool atEnd() const {
+      return !trie_ || index_ >= trie_->entries_.size();
+    }
+
+    ValueT& value() const {
+      CHECK(!atEnd()) << "Dereferencing end iterator";
+      return *entryOf(trie_, index_).value;
+    }
+    const IPADDRTYPE& ipAddress() const {
+      return entry().ipAddress;
+    }
+    uint8_t masklen() const {
+      return entry().masklen;
+    }
+
+   private:
+    friend class StrideTrie;
+    template <typename OtherTrieT, typename OtherValueT>
+    friend class IteratorImpl;
+
+    // All end iterators compare equal, including default constructed ones
+    uint32_t index() const {
+      return atEnd() ? kNone : index_;
+    }
+    const Entry& entry() const {
+      CHECK(!atEnd()) << "Dereferencing end iterator";
+      return trie_->entries_[index_];
+    }
+    static const Entry& entryOf(const StrideTrie* trie, uint32_t index) {
+      return trie->entries_[index];
+    }
+    static Entry& entryOf(StrideTrie* trie, uint32_t index) {
+      return trie->entries_.writable(index);
+    }
+    void skipFree() {
+      while (!atEnd() && !trie_->entries_[index_].value) {
+        ++index_;
+      }
+    }
+
+    TrieT* trie_{nullptr};
+    uint32_t index_{kNone};
+  };
+
+ public:
+  typedef IteratorImpl<StrideTrie, T> Iterator;
+  typedef IteratorImpl<const StrideTrie, const T> ConstIterator;
+
+  StrideTrie() {
+    nodes_.emplace_back();
+  }
+  StrideTrie(const StrideTrie& r) = default;
+  StrideTrie& operator=(const StrideTrie& r) = default;
+  StrideTrie(StrideTrie&& r) noexcept {
+    *this = std::move(r);
+  }
+  StrideTrie& operator=(StrideTrie&& r) noexcept {
+    nodes_ = std::move(r.nodes_);
+    entries_ = std::move(r.entries_);
+    freeNodes_ = std::move(r.freeNodes_);
+    freeEntries_ = std::move(r.freeEntries_);
+    size_ = r.size_;
+    r.clear();
+    return *this;
+  }
+
+  Iterator begin() { return Iterator(this, 0); }
+  Iterator end() { return Iterator(); }
+  ConstIterator begin() const { return ConstIterator(this, 0); }
+  ConstIterator end() const { return ConstIterator(); }
+
+  size_t size() const { return size_; }
+
+  /*
+   * Call fn(chunk, bytes) for each chunk of nodes and values, for memory
+   * accounting.  The chunks may be shared with copies of the trie.
+   */
+  template <typename Fn>
+  void forEachChunk(Fn fn) const {
+    nodes_.forEachChunk(fn);
+    entries_.forEachChunk(fn);
+  }
+
+  // Free all nodes and clear the trie.
+  void clear() {
+    nodes_.clear();
+    nodes_.emplace_back();
+    entries_.clear();
+    freeNodes_.clear();
+    freeEntries_.clear();
+    size_ = 0;
+  }
+
+  /*
+   * Insert a IP, mask, value in the trie. Returns the inserted element and
+   * true if it was inserted. If an element for IP, mask already existed,
+   * returns it and false.
+   */
+  template <typename VALUE>
+  std::pair<Iterator, bool> insert(const IPADDRTYPE& ipaddr,
+      uint8_t masklen, VALUE&& value) {
+    CHECK_LE(masklen, IPADDRTYPE::bitCount());
+    auto addr = ipaddr.mask(masklen);
+    uint32_t node = kRoot;
+    uint32_t depth = 0;
+    for (; (depth + 1) * STRIDE <= masklen; ++depth) {
+      auto bits = chunk(addr, depth);
+      auto child = nodes_[node].children[bits];
+      if (child == kNone) {
+        // allocNode() may reallocate the storage, so don't hold references
+        child = allocNode();
+        auto& parent = nodes_.writable(node);
+        parent.children[bits] = child;
+        ++parent.numUsed;
+      }
+      node = child;
+    }
+    auto slot = prefixSlot(addr, depth, masklen);
+    auto existing = nodes_[node].prefixes[slot];
+    if (existing != kNone) {
+      return std::make_pair(Iterator(this, existing), false);
+    }
+    auto index = allocEntry(addr, masklen, std::forward<VALUE>(value));
+    auto& n = nodes_.writable(node);
+    n.prefixes[slot] = index;
+    ++n.numUsed;
+    ++size_;
+    return std::make_pair(Iterator(this, index), true);
+  }
+
+  /*
+   * Erase the element for IP, mask. Returns true if an element was erased.
+   */
+  bool erase(const IPADDRTYPE& ipaddr, uint8_t masklen) {
+    if (masklen > IPADDRTYPE::bitCount()) {
+      return false;
+    }
+    uint32_t path[IPADDRTYPE::bitCount() / STRIDE + 1];
+    uint32_t node = kRoot;
+    uint32_t depth = 0;
+    for (; (depth + 1) * STRIDE <= masklen; ++depth) {
+      path[depth] = node;
+      node = nodes_[node].children[chunk(ipaddr, depth)];
+      if (node == kNone) {
+        return false;
+      }
+    }
+    auto slot = prefixSlot(ipaddr, depth, masklen);
+    auto index = nodes_[node].prefixes[slot];
+    if (index == kNone) {
+      return false;
+    }
+    freeEntry(index);
+    nodes_.writable(node).prefixes[slot] = kNone;
+    --size_;
+    // Reclaim the nodes that no longer lead to any prefix
+    while (--nodes_.writable(node).numUsed == 0 && node != kRoot) {
+      freeNode(node);
+      node = path[--depth];
+      nodes_.writable(node).children[chunk(ipaddr, depth)] = kNone;
+    }
+    return true;
+  }
+
+  bool erase(Iterator itr) {
+    if (itr.atEnd()) {
+      return false;
+    }
+    return erase(itr.ipAddress(), itr.masklen());
+  }
+
+  /*
+   * Find the longest prefix covering the first masklen bits of IP.
+   * Returns end() if no prefix matches.
+   */
+  ConstIterator longestMatch(const IPADDRTYPE& ipaddr,
+      uint8_t masklen) const {
+    masklen = std::min<uint8_t>(masklen, IPADDRTYPE::bitCount());
+    uint32_t best = kNone;
+    for (uint32_t node = kRoot, depth = 0; node != kNone; ++depth) {
+      node = matchInNode(node, ipaddr, depth, masklen, &best);
+    }
+    return best == kNone ? end() : ConstIterator(this, best);
+  }
+
+  /*
+   * Find the longest prefix covering each of addrs, storing the match for
+   * addrs[i] (or end()) in matches[i].  The lookups are run together a level
+   * of the trie at a time, prefetching the next node of each of them, so
+   * their cache misses overlap instead of being taken one after the other.
+   */
+  void longestMatch(folly::Range<const IPADDRTYPE*> addrs,
+      ConstIterator* matches) const {
+    constexpr size_t kBatchSize = 8;
+    uint32_t nodes[kBatchSize];
+    uint32_t best[kBatchSize];
+    for (size_t start = 0; start < addrs.size(); start += kBatchSize) {
+      auto count = std::min(kBatchSize, addrs.size() - start);
+      std::fill(nodes, nodes + count, kRoot);
+      std::fill(best, best + count, kNone);
+      auto active = count;
+      for (uint32_t depth = 0; active > 0; ++depth) {
+        for (size_t i = 0; i < count; ++i) {
+          if (nodes[i] == kNone) {
+            continue;
+          }
+          nodes[i] = matchInNode(nodes[i], addrs[start + i], depth,
+                                 IPADDRTYPE::bitCount(), &best[i]);
+          if (nodes[i] == kNone) {
+            --active;
+          } else {
+            __builtin_prefetch(&nodes_[nodes[i]]);
+          }
+        }
+      }
+      for (size_t i = 0; i < count; ++i) {
+        matches[start + i] =
+          best[i] == kNone ? end() : ConstIterator(this, best[i]);
+      }
+    }
+  }
+
+  Iterator longestMatch(const IPADDRTYPE& ipaddr, uint8_t masklen) {
+    return itrConstCast(
+        const_cast<const StrideTrie*>(this)->longestMatch(ipaddr, masklen));
+  }
+
+  /*
+   * Find the element for exactly IP, mask. Returns end() if there is none.
+   */
+  ConstIterator exactMatch(const IPADDRTYPE& ipaddr, uint8_t masklen) const {
+    if (masklen > IPADDRTYPE::bitCount()) {
+      return end();
+    }
+    uint32_t node = kRoot;
+    uint32_t depth = 0;
+    for (; (depth + 1) * STRIDE <= masklen; ++depth) {
+      node = nodes_[node].children[chunk(ipaddr, depth)];
+      if (node == kNone) {
+        return end();
+      }
+    }
+    auto index = nodes_[node].prefixes[prefixSlot(ipaddr, depth, masklen)];
+    return index == kNone ? end() : ConstIterator(this, index);
+  }
+
+  Iterator exactMatch(const IPADDRTYPE& ipaddr, uint8_t masklen) {
+    return itrConstCast(
+        const_cast<const StrideTrie*>(this)->exactMatch(ipaddr, masklen));
+  }
+
+ private:
+  Iterator itrConstCast(ConstIterator citr) {
+    return citr.atEnd() ? end() : Iterator(this, citr.index_);
+  }
+
+  /*
+   * Record in best the longest prefix of addr/masklen held by the node at
+   * depth, and return the child to continue with, or kNone if there is no
+   * longer match.
+   */
+  uint32_t matchInNode(uint32_t node, const IPADDRTYPE& addr, uint32_t depth,
+      uint8_t masklen, uint32_t* best) const {
+    const auto& n = nodes_[node];
+    auto base = depth * STRIDE;
+    auto bits = base < IPADDRTYPE::bitCount() ? chunk(addr, depth) : 0;
+    for (uint32_t len = 0; len < STRIDE && base + len <= masklen; ++len) {
+      auto index = n.prefixes[(1 << len) - 1 + (bits >> (STRIDE - len))];
+      if (index != kNone) {
+        *best = index;
+      }
+    }
+    return base + STRIDE > masklen ? kNone : n.children[bits];
+  }
+
+  // The STRIDE bits of addr consumed at depth
+  static uint32_t chunk(const IPADDRTYPE& addr, uint32_t depth) {
+    auto bit = depth * STRIDE;
+    auto byte = addr.getNthMSByte(bit / 8);
+    return (byte >> (8 - STRIDE - bit % 8)) & (kFanout - 1);
+  }
+
+  // The slot, in the node at depth, of the prefix addr/masklen
+  static uint32_t prefixSlot(
+      const IPADDRTYPE& addr, uint32_t depth, uint8_t masklen) {
+    auto len = masklen - depth * STRIDE;
+    if (len == 0) {
+      return 0;
+    }
+    return (1 << len) - 1 + (chunk(addr, depth) >> (STRIDE - len));
+  }
+
+  uint32_t allocNode() {
+    if (freeNodes_.empty()) {
+      return nodes_.emplace_back();
+    }
+    auto index = freeNodes_.back();
+    freeNodes_.pop_back();
+    return index;
+  }
+  void freeNode(uint32_t index) {
+    nodes_.writable(index) = Node();
+    freeNodes_.push_back(index);
+  }
+
+  template <typename VALUE>
+  uint32_t allocEntry(const IPADDRTYPE& addr, uint8_t masklen,
+      VALUE&& value) {
+    uint32_t index;
+    if (freeEntries_.empty()) {
+      index = entries_.emplace_back();
+    } else {
+      index = freeEntries_.back();
+      freeEntries_.pop_back();
+    }
+    auto& entry = entries_.writable(index);
+    entry.ipAddress = addr;
+    entry.masklen = masklen;
+    entry.value = std::forward<VALUE>(value);
+    return index;
+  }
+  void freeEntry(uint32_t index) {
+    entries_.writable(index).value.clear();
+    freeEntries_.push_back(index);
+  }
+
+  // 64 nodes of the default stride, or 256 values, make up 8KB chunks
+  detail::StrideTrieStorage<Node, 64> nodes_;
+  detail::StrideTrieStorage<Entry, 256> entries_;
+  std::vector<uint32_t> freeNodes_;
+  std::vector<uint32_t> freeEntries_;
+  size_t size_{0};
+};
+
+template <typename IPADDRTYPE, typename T, uint8_t STRIDE>
+constexpr uint32_t StrideTrie<IPADDRTYPE, T, STRIDE>::kFanout;
+template <typename IPADDRTYPE, typename T, uint8_t STRIDE>
+constexpr uint32_t StrideTrie<IPADDRTYPE, T, STRIDE>::kNumPrefixSlots;
+template <typename IPADDRTYPE, typename T, uint8_t STRIDE>
+constexpr uint32_t StrideTrie<IPADDRTYPE, T, STRIDE>::kNone;
+template <typename IPADDRTYPE, typename T, uint8_t STRIDE>
+constexpr uint32_t StrideTrie<IPADDRTYPE, T, STRIDE>::kRoot;
+
+}} // facebook::network
@@ -191,6 +191,104 @@ BENCHMARK_RELATIVE(RadixTreeLongestMatch6) {
   }
 }
 
+// Key operations, on the address against the integer keys the tree uses
+
+/*
+ * One step of a tree walk: whether a prefix lies under another one, and if
+ * so on which side
+ */
+template<typename PREFIX>
+void addressSearchStep(const set<PREFIX>& prefixes) {
+  const PREFIX* prev = nullptr;
+  for (const auto& pfx: prefixes) {
+    if (prev && prev->mask < pfx.mask) {
+      folly::doNotOptimizeAway(pfx.ip.mask(prev->mask) == prev->ip &&
+          pfx.ip.getNthMSBit(prev->mask));
+    }
+    prev = &pfx;
+  }
+}
+
+template<typename PREFIX, typename IPADDRTYPE>
+void keySearchStep(const set<PREFIX>& prefixes) {
+  using KeyOps = RadixTreeKeyOps<IPADDRTYPE>;
+  vector<pair<typename KeyOps::Key, uint8_t>> keys;
+  BENCHMARK_SUSPEND {
+    for (const auto& pfx: prefixes) {
+      keys.emplace_back(KeyOps::fromAddress(pfx.ip), pfx.mask);
+    }
+  }
+  for (size_t i = 1; i < keys.size(); ++i) {
+    const auto& prev = keys[i - 1];
+    if (prev.second < keys[i].second) {
+      folly::doNotOptimizeAway(
+          KeyOps::prefixMatches(keys[i].first, prev.first, prev.second) &&
+          KeyOps::bit(keys[i].first, prev.second));
+    }
+  }
+}
+
+// The internal node that an insert puts above two prefixes
+template<typename PREFIX, typename IPADDRTYPE>
+void addressCommonPrefix(const set<PREFIX>& prefixes) {
+  const PREFIX* prev = nullptr;
+  for (const auto& pfx: prefixes) {
+    if (prev) {
+      folly::doNotOptimizeAway(IPADDRTYPE::longestCommonPrefix(
+            {prev->ip, prev->mask}, {pfx.ip, pfx.mask}));
+    }
+    prev = &pfx;
+  }
+}
+
+template<typename PREFIX, typename IPADDRTYPE>
+void keyCommonPrefix(const set<PREFIX>& prefixes) {
+  using KeyOps = RadixTreeKeyOps<IPADDRTYPE>;
+  vector<pair<typename KeyOps::Key, uint8_t>> keys;
+  BENCHMARK_SUSPEND {
+    for (const auto& pfx: prefixes) {
+      keys.emplace_back(KeyOps::fromAddress(pfx.ip), pfx.mask);
+    }
+  }
+  for (size_t i = 1; i < keys.size(); ++i) {
+    auto masklen = KeyOps::commonPrefixLength(keys[i - 1].first,
+        keys[i].first, std::min(keys[i - 1].second, keys[i].second));
+    folly::doNotOptimizeAway(KeyOps::mask(keys[i].first, masklen));
+  }
+}
+
+BENCHMARK(AddressSearchStep4) {
+  addressSearchStep(insertSet4);
+}
+
+BENCHMARK_RELATIVE(KeySearchStep4) {
+  keySearchStep<Prefix4, IPAddressV4>(insertSet4);
+}
+
+BENCHMARK(AddressCommonPrefix4) {
+  addressCommonPrefix<Prefix4, IPAddressV4>(insertSet4);
+}
+
+BENCHMARK_RELATIVE(KeyCommonPrefix4) {
+  keyCommonPrefix<Prefix4, IPAddressV4>(insertSet4);
+}
+
+BENCHMARK(AddressSearchStep6) {
+  addressSearchStep(insertSet6);
+}
+
+BENCHMARK_RELATIVE(KeySearchStep6) {
+  keySearchStep<Prefix6, IPAddressV6>(insertSet6);
+}
+
+BENCHMARK(AddressCommonPrefix6) {
+  addressCommonPrefix<Prefix6, IPAddressV6>(insertSet6);
+}
+
+BENCHMARK_RELATIVE(KeyCommonPrefix6) {
+  keyCommonPrefix<Prefix6, IPAddressV6>(insertSet6);
+}
+
 }
 
 int main(int /*argc*/, char* /*argv*/ []) {
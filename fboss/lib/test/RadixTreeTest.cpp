@@ -1467,3 +1467,64 @@ TEST(RadixTree, SubTreeIterator) {
   }
   EXPECT_EQ(rtree.end().subTreeIterator(), rtree.end());
 }
+
+namespace {
+/*
+ * Check the integer keys of IPADDRTYPE against the address operations
+ * they stand in for, on prefixes that share some of their leading bits.
+ */
+template<typename IPADDRTYPE>
+void checkKeyOps(const vector<IPADDRTYPE>& addrs) {
+  using KeyOps = RadixTreeKeyOps<IPADDRTYPE>;
+  const uint8_t bitCount = IPADDRTYPE::bitCount();
+  for (const auto& a : addrs) {
+    auto keyA = KeyOps::fromAddress(a);
+    EXPECT_EQ(a, KeyOps::toAddress(keyA));
+    for (uint8_t n = 0; n < bitCount; ++n) {
+      EXPECT_EQ(a.getNthMSBit(n), KeyOps::bit(keyA, n));
+    }
+    for (const auto& b : addrs) {
+      auto keyB = KeyOps::fromAddress(b);
+      for (uint8_t masklen = 0; masklen <= bitCount; ++masklen) {
+        auto maskedB = b.mask(masklen);
+        EXPECT_EQ(maskedB, KeyOps::toAddress(KeyOps::mask(keyB, masklen)));
+        EXPECT_EQ(a.mask(masklen) == maskedB,
+            KeyOps::prefixMatches(keyA, KeyOps::fromAddress(maskedB),
+              masklen));
+        EXPECT_EQ(
+            IPADDRTYPE::longestCommonPrefix({a, masklen}, {b, masklen}).second,
+            KeyOps::commonPrefixLength(keyA, keyB, masklen));
+      }
+    }
+  }
+}
+}
+
+TEST(RadixTree, KeyOps4) {
+  vector<IPAddressV4> addrs{IPAddressV4("0.0.0.0"),
+    IPAddressV4("255.255.255.255")};
+  for (int i = 0; i < 8; ++i) {
+    // Random low bits under a few fixed high bits
+    auto ip = IPAddressV4::fromLongHBO(
+        0x0a000000 | (folly::Random::rand32() >> (i * 4)));
+    addrs.push_back(ip);
+  }
+  checkKeyOps(addrs);
+}
+
+TEST(RadixTree, KeyOps6) {
+  vector<IPAddressV6> addrs{IPAddressV6("::"),
+    IPAddressV6("ffff:ffff:ffff:ffff:ffff:ffff:ffff:ffff"),
+    IPAddressV6("2401:db00::1"), IPAddressV6("2401:db00::8000:0:0:1")};
+  for (int i = 0; i < 8; ++i) {
+    folly::ByteArray16 ba;
+    *(uint64_t*)(&ba[0]) = folly::Random::rand64();
+    *(uint64_t*)(&ba[8]) = folly::Random::rand64();
+    // Share the first i * 16 bits
+    for (int j = 0; j < i * 2; ++j) {
+      ba[j] = 0x20 + j;
+    }
+    addrs.push_back(IPAddressV6(ba));
+  }
+  checkKeyOps(addrs);
+}
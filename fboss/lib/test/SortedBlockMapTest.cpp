@@ -0,0 +1,143 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "fboss/lib/SortedBlockMap.h"
+
+#include <gtest/gtest.h>
+
+#include <map>
+#include <memory>
+#include <random>
+#include <vector>
+
+using namespace facebook::fboss;
+
+namespace {
+
+// Small blocks, so that the tests split and merge them often
+using TestMap = SortedBlockMap<uint32_t, std::unique_ptr<uint32_t>,
+                               std::less<uint32_t>, 8>;
+
+void expectSame(const std::map<uint32_t, uint32_t>& expected,
+                const TestMap& map) {
+  ASSERT_EQ(expected.size(), map.size());
+  auto iter = map.begin();
+  for (const auto& entry : expected) {
+    ASSERT_TRUE(iter != map.end());
+    EXPECT_EQ(entry.first, iter->first);
+    EXPECT_EQ(entry.second, *iter->second);
+    ++iter;
+  }
+  EXPECT_TRUE(iter == map.end());
+  EXPECT_LE(map.size(), map.capacity());
+}
+
+} // unnamed namespace
+
+TEST(SortedBlockMap, emplaceFindErase) {
+  TestMap map;
+  EXPECT_TRUE(map.empty());
+  EXPECT_TRUE(map.begin() == map.end());
+  EXPECT_TRUE(map.find(1) == map.end());
+
+  std::mt19937 rng(1);
+  std::map<uint32_t, uint32_t> expected;
+  for (int i = 0; i < 5000; ++i) {
+    uint32_t key = rng() % 1000;
+    if (rng() % 3) {
+      auto ret = map.emplace(key, std::make_unique<uint32_t>(i));
+      auto expectedRet = expected.emplace(key, i);
+      EXPECT_EQ(expectedRet.second, ret.second);
+      EXPECT_EQ(key, ret.first->first);
+      EXPECT_EQ(expectedRet.first->second, *ret.first->second);
+    } else {
+      EXPECT_EQ(expected.erase(key), map.erase(key));
+    }
+    auto iter = map.find(key);
+    if (expected.count(key)) {
+      ASSERT_TRUE(iter != map.end());
+      EXPECT_EQ(expected[key], *iter->second);
+    } else {
+      EXPECT_TRUE(iter == map.end());
+    }
+  }
+  expectSame(expected, map);
+  // Blocks are split rather than grown
+  EXPECT_LT(expected.size() / 8, map.numBlocks());
+
+  for (auto iter = map.begin(); iter != map.end(); iter = map.begin()) {
+    map.erase(iter);
+  }
+  EXPECT_TRUE(map.empty());
+  EXPECT_EQ(0, map.numBlocks());
+}
+
+TEST(SortedBlockMap, insertSorted) {
+  // From a few entries, applied one at a time, to many merged in a rebuild
+  for (size_t batchSize : {2, 50, 500}) {
+    TestMap map;
+    std::map<uint32_t, uint32_t> expected;
+    for (uint32_t key = 0; key < 400; key += 4) {
+      map.emplace(key, std::make_unique<uint32_t>(key));
+      expected.emplace(key, key);
+    }
+    std::vector<std::pair<uint32_t, std::unique_ptr<uint32_t>>> batch;
+    for (uint32_t i = 0; i < batchSize; ++i) {
+      // Some of the keys are already in the map, and are not replaced
+      auto key = i * 2 + 1 - (i % 5 == 0);
+      batch.emplace_back(key, std::make_unique<uint32_t>(key + 1000));
+      expected.emplace(key, key + 1000);
+    }
+    map.insertSorted(batch.begin(), batch.end());
+    expectSame(expected, map);
+  }
+}
+
+TEST(SortedBlockMap, eraseSorted) {
+  for (size_t batchSize : {2, 50, 500}) {
+    TestMap map;
+    std::map<uint32_t, uint32_t> expected;
+    for (uint32_t key = 0; key < 1000; ++key) {
+      map.emplace(key, std::make_unique<uint32_t>(key));
+      expected.emplace(key, key);
+    }
+    std::vector<uint32_t> keys;
+    size_t present = 0;
+    for (uint32_t i = 0; i < batchSize; ++i) {
+      // Keys that are not in the map are skipped
+      auto key = i * 3 + 500;
+      keys.push_back(key);
+      present += expected.erase(key);
+    }
+    EXPECT_EQ(present, map.eraseSorted(keys.begin(), keys.end()));
+    expectSame(expected, map);
+  }
+}
+
+TEST(SortedBlockMap, changesAfterRebuild) {
+  TestMap map;
+  std::vector<std::pair<uint32_t, std::unique_ptr<uint32_t>>> batch;
+  std::map<uint32_t, uint32_t> expected;
+  for (uint32_t key = 0; key < 100; ++key) {
+    batch.emplace_back(key * 2, std::make_unique<uint32_t>(key));
+    expected.emplace(key * 2, key);
+  }
+  map.insertSorted(batch.begin(), batch.end());
+  // The rebuilt blocks have room left in them
+  EXPECT_LT(100 / 8, map.numBlocks());
+  for (uint32_t key = 1; key < 200; key += 2) {
+    map.emplace(key, std::make_unique<uint32_t>(key));
+    expected.emplace(key, key);
+  }
+  for (uint32_t key = 0; key < 200; key += 3) {
+    map.erase(key);
+    expected.erase(key);
+  }
+  expectSame(expected, map);
+}
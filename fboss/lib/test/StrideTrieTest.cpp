@@ -0,0 +1,198 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+
+#include <memory>
+#include <random>
+#include <set>
+#include <vector>
+#include <gtest/gtest.h>
+
+#include <folly/Format.h>
+#include <folly/IPAddressV4.h>
+#include <folly/IPAddressV6.h>
+
+#include "fboss/lib/RadixTree.h"
+#include "fboss/lib/StrideTrie.h"
+
+using namespace facebook::network;
+using folly::IPAddressV4;
+using folly::IPAddressV6;
+
+namespace {
+
+template <typename IPAddrType>
+IPAddrType randomAddress(std::mt19937& rng);
+
+// Draw addresses from a small space so that prefixes overlap.
+template <>
+IPAddressV4 randomAddress<IPAddressV4>(std::mt19937& rng) {
+  return IPAddressV4::fromLongHBO(0x0a000000 | (rng() & 0x00f0f00f));
+}
+
+template <>
+IPAddressV6 randomAddress<IPAddressV6>(std::mt19937& rng) {
+  IPAddressV6::ByteArray16 bytes{};
+  bytes[0] = 0x20;
+  bytes[1] = 0x01;
+  bytes[2 + rng() % 14] = rng() & 0x31;
+  bytes[15] = rng() & 0x3;
+  return IPAddressV6(bytes);
+}
+
+/*
+ * Apply the same random inserts, erases and lookups to a StrideTrie and a
+ * RadixTree and check that they always agree.
+ */
+template <typename IPAddrType, uint8_t STRIDE>
+void compareWithRadixTree() {
+  std::mt19937 rng(0);
+  StrideTrie<IPAddrType, int, STRIDE> trie;
+  RadixTree<IPAddrType, int> tree;
+  auto bits = IPAddrType::bitCount();
+  for (int i = 0; i < 20000; ++i) {
+    auto addr = randomAddress<IPAddrType>(rng);
+    uint8_t masklen = rng() % (bits + 1);
+    switch (rng() % 3) {
+      case 0: {
+        auto trieRes = trie.insert(addr, masklen, i);
+        auto treeRes = tree.insert(addr, masklen, i);
+        ASSERT_EQ(treeRes.second, trieRes.second);
+        EXPECT_EQ(treeRes.first->value(), trieRes.first->value());
+        EXPECT_EQ(treeRes.first->ipAddress(), trieRes.first->ipAddress());
+        break;
+      }
+      case 1:
+        ASSERT_EQ(tree.erase(addr, masklen), trie.erase(addr, masklen));
+        break;
+      default: {
+        auto trieMatch = trie.longestMatch(addr, masklen);
+        auto treeMatch = tree.longestMatch(addr, masklen);
+        ASSERT_EQ(treeMatch == tree.end(), trieMatch == trie.end());
+        if (treeMatch != tree.end()) {
+          EXPECT_EQ(treeMatch->ipAddress(), trieMatch->ipAddress());
+          EXPECT_EQ(treeMatch->masklen(), trieMatch->masklen());
+          EXPECT_EQ(treeMatch->value(), trieMatch->value());
+        }
+        EXPECT_EQ(tree.exactMatch(addr, masklen) == tree.end(),
+                  trie.exactMatch(addr, masklen) == trie.end());
+      }
+    }
+    ASSERT_EQ(tree.size(), trie.size());
+  }
+
+  std::set<int> treeValues;
+  for (const auto& node : tree) {
+    treeValues.insert(node.value());
+  }
+  std::set<int> trieValues;
+  for (const auto& node : trie) {
+    trieValues.insert(node.value());
+  }
+  EXPECT_EQ(treeValues, trieValues);
+}
+
+} // unnamed namespace
+
+TEST(StrideTrie, CompareWithRadixTreeV4) {
+  compareWithRadixTree<IPAddressV4, 1>();
+  compareWithRadixTree<IPAddressV4, 4>();
+  compareWithRadixTree<IPAddressV4, 8>();
+}
+
+TEST(StrideTrie, CompareWithRadixTreeV6) {
+  compareWithRadixTree<IPAddressV6, 2>();
+  compareWithRadixTree<IPAddressV6, 4>();
+  compareWithRadixTree<IPAddressV6, 8>();
+}
+
+TEST(StrideTrie, Basic) {
+  StrideTrie<IPAddressV4, int> trie;
+  EXPECT_TRUE(trie.begin() == trie.end());
+  EXPECT_TRUE(trie.longestMatch(IPAddressV4("10.1.1.1"), 32) == trie.end());
+
+  // Host bits are masked off on insert
+  auto res = trie.insert(IPAddressV4("10.1.1.1"), 16, 16);
+  EXPECT_TRUE(res.second);
+  EXPECT_EQ(IPAddressV4("10.1.0.0"), res.first->ipAddress());
+  EXPECT_FALSE(trie.insert(IPAddressV4("10.1.0.0"), 16, 0).second);
+  EXPECT_TRUE(trie.insert(IPAddressV4("0.0.0.0"), 0, 0).second);
+  EXPECT_TRUE(trie.insert(IPAddressV4("10.1.1.0"), 24, 24).second);
+  EXPECT_TRUE(trie.insert(IPAddressV4("10.1.1.1"), 32, 32).second);
+  EXPECT_EQ(4, trie.size());
+
+  EXPECT_EQ(32, trie.longestMatch(IPAddressV4("10.1.1.1"), 32)->value());
+  EXPECT_EQ(24, trie.longestMatch(IPAddressV4("10.1.1.1"), 31)->value());
+  EXPECT_EQ(24, trie.longestMatch(IPAddressV4("10.1.1.2"), 32)->value());
+  EXPECT_EQ(16, trie.longestMatch(IPAddressV4("10.1.2.1"), 32)->value());
+  EXPECT_EQ(0, trie.longestMatch(IPAddressV4("10.2.1.1"), 32)->value());
+  EXPECT_TRUE(trie.exactMatch(IPAddressV4("10.1.1.0"), 23) == trie.end());
+
+  auto itr = trie.exactMatch(IPAddressV4("10.1.1.0"), 24);
+  ASSERT_TRUE(itr != trie.end());
+  itr->value() = 240;
+  EXPECT_EQ(240, trie.longestMatch(IPAddressV4("10.1.1.2"), 32)->value());
+
+  EXPECT_TRUE(trie.erase(IPAddressV4("10.1.1.1"), 32));
+  EXPECT_FALSE(trie.erase(IPAddressV4("10.1.1.1"), 32));
+  EXPECT_EQ(240, trie.longestMatch(IPAddressV4("10.1.1.1"), 32)->value());
+  EXPECT_TRUE(trie.erase(trie.exactMatch(IPAddressV4("0.0.0.0"), 0)));
+  EXPECT_TRUE(trie.longestMatch(IPAddressV4("10.2.1.1"), 32) == trie.end());
+  EXPECT_EQ(2, trie.size());
+
+  StrideTrie<IPAddressV4, int> moved(std::move(trie));
+  EXPECT_EQ(2, moved.size());
+  EXPECT_EQ(0, trie.size());
+  moved.clear();
+  EXPECT_EQ(0, moved.size());
+  EXPECT_TRUE(moved.begin() == moved.end());
+}
+
+TEST(StrideTrie, CopiesAreIndependent) {
+  StrideTrie<IPAddressV6, int> trie;
+  for (int i = 0; i < 1000; ++i) {
+    trie.insert(IPAddressV6(folly::sformat("2401:db00:{:x}::", i)), 48, i);
+  }
+  auto copy = trie;
+  EXPECT_EQ(1000, copy.size());
+
+  // Changes to the copy don't show up in the original, and vice versa
+  IPAddressV6 one("2401:db00:1::");
+  IPAddressV6 two("2401:db00:2::");
+  IPAddressV6 three("2401:db00:3::");
+  copy.exactMatch(one, 48)->value() = -1;
+  EXPECT_TRUE(copy.erase(two, 48));
+  EXPECT_TRUE(copy.insert(one, 64, 64).second);
+  EXPECT_TRUE(trie.erase(three, 48));
+
+  EXPECT_EQ(1, trie.exactMatch(one, 48)->value());
+  EXPECT_EQ(-1, copy.exactMatch(one, 48)->value());
+  EXPECT_TRUE(trie.exactMatch(two, 48) != trie.end());
+  EXPECT_TRUE(copy.exactMatch(two, 48) == copy.end());
+  EXPECT_EQ(1, trie.longestMatch(IPAddressV6("2401:db00:1::1"), 128)->value());
+  EXPECT_EQ(64, copy.longestMatch(IPAddressV6("2401:db00:1::1"), 128)->value());
+  EXPECT_TRUE(trie.exactMatch(three, 48) == trie.end());
+  EXPECT_TRUE(copy.exactMatch(three, 48) != copy.end());
+  EXPECT_EQ(999, trie.size());
+  EXPECT_EQ(1000, copy.size());
+}
+
+TEST(StrideTrie, BatchedLongestMatch) {
+  std::mt19937 rng(0);
+  StrideTrie<IPAddressV4, int> trie;
+  for (int i = 0; i < 1000; ++i) {
+    trie.insert(randomAddress<IPAddressV4>(rng), 8 + rng() % 25, i);
+  }
+  std::vector<IPAddressV4> addrs;
+  for (int i = 0; i < 1001; ++i) {
+    addrs.push_back(randomAddress<IPAddressV4>(rng));
+  }
+  addrs.emplace_back("192.168.0.1");
+  std::vector<StrideTrie<IPAddressV4, int>::ConstIterator> matches(
+      addrs.size());
+  const auto& constTrie = trie;
+  constTrie.longestMatch(folly::range(addrs.begin(), addrs.end()),
+                         matches.data());
+  for (size_t i = 0; i < addrs.size(); ++i) {
+    EXPECT_TRUE(matches[i] == constTrie.longestMatch(addrs[i], 32));
+  }
+  EXPECT_TRUE(matches.back() == constTrie.end());
+}
@@ -20,8 +20,10 @@ void BaseWedgeI2CBus::open() {
   dev_->open();
 
   selectedPort_ = NO_PORT;
+  selectionValid_ = false;
   verifyBus();
   initBus();
+  selectionValid_ = true;
 
   VLOG(4) << "successfully opened wedge CP2112 I2C bus";
 }
@@ -43,6 +45,8 @@ void BaseWedgeI2CBus::read(uint8_t address, int offset,
   // followed by a read.  This releases the I2C bus between operations, but
   // that's okay since there aren't any other master devices on the bus.
 
+  counters_.bytesRead += len;
+
   // Also note that we can't read more than 128 bytes at a time.
   dev_->writeByte(address, offset);
   if (len > 128) {
@@ -71,29 +75,49 @@ void BaseWedgeI2CBus::write(uint8_t address, int offset,
   output[0] = offset;
   memcpy(output + 1, buf, len);
   dev_->write(address, MutableByteRange(output, len + 1));
+  counters_.bytesWritten += len;
 }
 
 void BaseWedgeI2CBus::moduleRead(unsigned int module, uint8_t address,
                                  int offset, int len, uint8_t* buf) {
-  selectQsfp(module);
-  CHECK_NE(selectedPort_, NO_PORT);
-
-  read(address, offset, len, buf);
+  try {
+    selectQsfp(module);
+    CHECK_NE(selectedPort_, NO_PORT);
+
+    read(address, offset, len, buf);
+  } catch (const std::exception&) {
+    invalidateSelection();
+    throw;
+  }
 }
 
 void BaseWedgeI2CBus::moduleWrite(unsigned int module, uint8_t address,
                                   int offset, int len, const uint8_t* buf) {
-  selectQsfp(module);
-  CHECK_NE(selectedPort_, NO_PORT);
-
-  write(address, offset, len, buf);
+  try {
+    selectQsfp(module);
+    CHECK_NE(selectedPort_, NO_PORT);
+
+    write(address, offset, len, buf);
+  } catch (const std::exception&) {
+    invalidateSelection();
+    throw;
+  }
 }
 
 void BaseWedgeI2CBus::selectQsfp(unsigned int port) {
   VLOG(4) << "selecting QSFP " << port;
   CHECK_GT(port, 0);
+  if (!selectionValid_) {
+    VLOG(4) << "clearing all muxes before selecting QSFP " << port;
+    selectedPort_ = NO_PORT;
+    initBus();
+    selectionValid_ = true;
+  }
   if (port != selectedPort_) {
+    ++counters_.muxSelects;
     selectQsfpImpl(port);
+  } else {
+    ++counters_.muxSelectsSaved;
   }
 }
 
@@ -104,4 +128,9 @@ void BaseWedgeI2CBus::unselectQsfp() {
   }
 }
 
+void BaseWedgeI2CBus::invalidateSelection() {
+  VLOG(4) << "forgetting the selection of QSFP " << selectedPort_;
+  selectionValid_ = false;
+}
+
 }} // facebook::fboss
@@ -45,6 +45,21 @@ class BaseWedgeI2CBus : public TransceiverI2CApi {
   void read(uint8_t i2cAddress, int offset, int len, uint8_t* buf);
   void write(uint8_t i2cAddress, int offset, int len, const uint8_t* buf);
 
+  /*
+   * What the bus has done since it was created.
+   */
+  struct Counters {
+    // Module accesses that needed the muxes switched, and those that found
+    // the module already selected
+    uint64_t muxSelects{0};
+    uint64_t muxSelectsSaved{0};
+    uint64_t bytesRead{0};
+    uint64_t bytesWritten{0};
+  };
+  const Counters& getCounters() const {
+    return counters_;
+  }
+
  protected:
   enum : unsigned int {
     NO_PORT = 0,
@@ -65,6 +80,16 @@ class BaseWedgeI2CBus : public TransceiverI2CApi {
   void selectQsfp(unsigned int module);
   void unselectQsfp();
 
+  /*
+   * Forget which module is selected, after an I2C error left the muxes in
+   * a state we don't know.  The next module access clears them all first.
+   */
+  void invalidateSelection();
+
+  // Whether selectedPort_ is what the muxes are actually set to
+  bool selectionValid_{false};
+  Counters counters_;
+
   // Forbidden copy constructor and assignment operator
   BaseWedgeI2CBus(BaseWedgeI2CBus const &) = delete;
   BaseWedgeI2CBus& operator=(BaseWedgeI2CBus const &) = delete;
@@ -18,6 +18,12 @@ namespace fboss {
 // based on the hardware.
 
 class Wedge100I2CBus : public PCA9548MuxedBus<32> {
+ public:
+  // dev is for talking to something other than the real CP2112, e.g. to
+  // benchmark the bus without hardware
+  explicit Wedge100I2CBus(std::unique_ptr<CP2112Intf> dev = nullptr)
+      : PCA9548MuxedBus<32>(std::move(dev)) {}
+
  private:
   MuxLayer createMuxes() override;
   void wireUpPorts(PortLeaves& leaves) override;
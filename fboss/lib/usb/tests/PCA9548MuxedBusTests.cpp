@@ -10,6 +10,7 @@
 
 #include "fboss/lib/usb/CP2112.h"
 #include "fboss/lib/usb/PCA9548MuxedBus.h"
+#include "fboss/lib/usb/UsbError.h"
 
 #include <folly/container/Enumerate.h>
 #include <gmock/gmock.h>
@@ -18,6 +19,8 @@
 using namespace facebook::fboss;
 using ::testing::_;
 using ::testing::InSequence;
+using ::testing::Return;
+using ::testing::Throw;
 
 class MockCP2112 : public CP2112Intf {
  public:
@@ -56,6 +59,8 @@ class FakeMuxBus
       : PCA9548MuxedBus<pow(MUXES_PER_LAYER * PCA9548::WIDTH, LAYERS)>(
             std::make_unique<MockCP2112>()) {}
   MuxLayer createMuxes() override {
+    // The muxes are created again whenever the bus is reinitialized
+    leafMuxes_.clear();
     MuxLayer roots;
     for (int i = 0; i < MUXES_PER_LAYER; ++i) {
       roots.push_back(std::make_unique<QsfpMux>(this->dev_.get(), i));
@@ -300,3 +305,27 @@ TEST(PCA9548MuxedBusTests, MultiLayerMultiMux) {
     EXPECT_EQ(root2->children(7)[1]->mux()->selected(), 0);
   }
 }
+
+TEST(PCA9548MuxedBusTests, SelectionCache) {
+  FakeMuxBus<1, 1> bus;
+  bus.open();
+  uint8_t buf[2];
+
+  // Only the first read of a module needs it selected
+  bus.moduleRead(1, TransceiverI2CApi::ADDR_QSFP, 0, 2, buf);
+  bus.moduleRead(1, TransceiverI2CApi::ADDR_QSFP, 2, 2, buf);
+  EXPECT_EQ(1u, bus.getCounters().muxSelects);
+  EXPECT_EQ(1u, bus.getCounters().muxSelectsSaved);
+  EXPECT_EQ(4u, bus.getCounters().bytesRead);
+
+  // After a failure we can't trust what the muxes are set to, so they are
+  // all cleared and the module is selected again
+  EXPECT_CALL(*bus.fakeDev(), read(_, _, _))
+      .WillOnce(Throw(UsbError("read failed")))
+      .WillRepeatedly(Return());
+  EXPECT_THROW(
+      bus.moduleRead(1, TransceiverI2CApi::ADDR_QSFP, 0, 2, buf), UsbError);
+  bus.moduleRead(1, TransceiverI2CApi::ADDR_QSFP, 0, 2, buf);
+  EXPECT_EQ(2u, bus.getCounters().muxSelects);
+  EXPECT_TRUE(bus.roots()[0]->mux()->isSelected(0));
+}
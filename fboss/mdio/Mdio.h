@@ -11,9 +11,14 @@
 
 #include "fboss/mdio/Phy.h"
 
+#include <algorithm>
+#include <chrono>
 #include <cstdint>
 #include <mutex>
+#include <unordered_map>
 
+#include <folly/Optional.h>
+#include <folly/Range.h>
 #include <folly/Synchronized.h>
 
 namespace facebook {
@@ -41,8 +46,39 @@ namespace fboss {
  *
  * MdioController and MdioDevice are templated types based on the
  * variant of Mdio being used.
+ *
+ * MdioOp: One read or write of a transaction, a sequence of them that an
+ * MdioController runs without releasing the controller.
  */
 
+struct MdioOp {
+  enum class Type {
+    READ,
+    WRITE,
+  };
+
+  static MdioOp read(
+      phy::PhyAddress physAddr,
+      phy::Cl45DeviceAddress devAddr,
+      phy::Cl45RegisterAddress regAddr) {
+    return MdioOp{Type::READ, physAddr, devAddr, regAddr, 0};
+  }
+  static MdioOp write(
+      phy::PhyAddress physAddr,
+      phy::Cl45DeviceAddress devAddr,
+      phy::Cl45RegisterAddress regAddr,
+      phy::Cl45Data data) {
+    return MdioOp{Type::WRITE, physAddr, devAddr, regAddr, data};
+  }
+
+  Type type;
+  phy::PhyAddress physAddr;
+  phy::Cl45DeviceAddress devAddr;
+  phy::Cl45RegisterAddress regAddr;
+  // What to write, or once the op has run, what was read
+  phy::Cl45Data data;
+};
+
 class Mdio {
  public:
   virtual ~Mdio() {}
@@ -58,11 +94,40 @@ class Mdio {
       phy::Cl45DeviceAddress devAddr,
       phy::Cl45RegisterAddress regAddr,
       phy::Cl45Data data) = 0;
+
+  // Run the ops in order. Platforms that can burst a sequence of accesses
+  // override this, otherwise it reads and writes one register at a time.
+  virtual void runCl45(folly::Range<MdioOp*> ops) {
+    for (auto& op : ops) {
+      if (op.type == MdioOp::Type::READ) {
+        op.data = readCl45(op.physAddr, op.devAddr, op.regAddr);
+      } else {
+        writeCl45(op.physAddr, op.devAddr, op.regAddr, op.data);
+      }
+    }
+  }
 };
 
+/*
+ * Reads and writes through an MdioController are transactions: sequences
+ * of ops run under one acquisition of the controller. Registers that only
+ * change when they are written, such as PHY configuration, can be cached,
+ * so that polling them does not go out to the bus.
+ */
 template <typename IO>
 class MdioController {
  public:
+  // Of the transactions that completed
+  struct Stats {
+    uint64_t transactions{0};
+    uint64_t ops{0};
+    // Reads served from the cache
+    uint64_t cacheHits{0};
+    // How long the transactions held the controller
+    std::chrono::nanoseconds totalLatency{0};
+    std::chrono::nanoseconds maxLatency{0};
+  };
+
   template <typename... Args>
   explicit MdioController(Args&&... args)
       : io_(IO(std::forward<Args>(args)...)) {}
@@ -71,7 +136,9 @@ class MdioController {
       phy::PhyAddress physAddr,
       phy::Cl45DeviceAddress devAddr,
       phy::Cl45RegisterAddress regAddr) {
-    return io_.lock()->readCl45(physAddr, devAddr, regAddr);
+    auto op = MdioOp::read(physAddr, devAddr, regAddr);
+    runCl45(folly::Range<MdioOp*>(&op, 1));
+    return op.data;
   }
 
   void writeCl45(
@@ -79,7 +146,70 @@ class MdioController {
       phy::Cl45DeviceAddress devAddr,
       phy::Cl45RegisterAddress regAddr,
       phy::Cl45Data data) {
-    io_.lock()->writeCl45(physAddr, devAddr, regAddr, data);
+    auto op = MdioOp::write(physAddr, devAddr, regAddr, data);
+    runCl45(folly::Range<MdioOp*>(&op, 1));
+  }
+
+  /*
+   * Run the ops in order as one transaction, filling in the data of the
+   * reads. Reads of cached registers are served from the cache, and the
+   * ops between them are handed to the IO together.
+   */
+  void runCl45(folly::Range<MdioOp*> ops) {
+    auto io = io_.lock();
+    auto start = std::chrono::steady_clock::now();
+    try {
+      auto run = ops.begin();
+      for (auto op = ops.begin(); op != ops.end(); ++op) {
+        auto entry = cache_.find(cacheKey(*op));
+        if (entry == cache_.end()) {
+          continue;
+        }
+        if (op->type == MdioOp::Type::WRITE) {
+          entry->second = op->data;
+        } else if (entry->second.hasValue()) {
+          runOnIO(*io, folly::Range<MdioOp*>(run, op));
+          op->data = *entry->second;
+          run = op + 1;
+          ++stats_.cacheHits;
+        }
+      }
+      runOnIO(*io, folly::Range<MdioOp*>(run, ops.end()));
+    } catch (...) {
+      // The cache may have writes that never made it to the device
+      invalidateCacheLocked();
+      throw;
+    }
+    auto latency = std::chrono::steady_clock::now() - start;
+    ++stats_.transactions;
+    stats_.ops += ops.size();
+    stats_.totalLatency += latency;
+    stats_.maxLatency = std::max(
+        stats_.maxLatency,
+        std::chrono::duration_cast<std::chrono::nanoseconds>(latency));
+  }
+
+  /*
+   * Cache the value of a register once it is read or written. Only
+   * registers that never change on their own should be cached.
+   */
+  void cacheCl45(
+      phy::PhyAddress physAddr,
+      phy::Cl45DeviceAddress devAddr,
+      phy::Cl45RegisterAddress regAddr) {
+    auto io = io_.lock();
+    cache_.emplace(cacheKey(physAddr, devAddr, regAddr), folly::none);
+  }
+
+  // Forget the cached values, such as after resetting a PHY
+  void invalidateCache() {
+    auto io = io_.lock();
+    invalidateCacheLocked();
+  }
+
+  Stats getStats() {
+    auto io = io_.lock();
+    return stats_;
   }
 
   // This can be useful by clients to do multiple MDIO reads/writes
@@ -89,12 +219,50 @@ class MdioController {
   //   io->write(...);
   //   io->read(...);
   // }
+  // These bypass the cache, so invalidate it after writing cached
+  // registers this way.
   auto lock() {
     return io_.lock();
   }
 
  private:
+  static uint32_t cacheKey(
+      phy::PhyAddress physAddr,
+      phy::Cl45DeviceAddress devAddr,
+      phy::Cl45RegisterAddress regAddr) {
+    return (uint32_t(physAddr) << 24) | (uint32_t(devAddr) << 16) | regAddr;
+  }
+  static uint32_t cacheKey(const MdioOp& op) {
+    return cacheKey(op.physAddr, op.devAddr, op.regAddr);
+  }
+
+  void runOnIO(IO& io, folly::Range<MdioOp*> ops) {
+    if (ops.empty()) {
+      return;
+    }
+    io.runCl45(ops);
+    for (const auto& op : ops) {
+      if (op.type != MdioOp::Type::READ) {
+        continue;
+      }
+      auto entry = cache_.find(cacheKey(op));
+      // Unless a later write in the transaction already set it
+      if (entry != cache_.end() && !entry->second.hasValue()) {
+        entry->second = op.data;
+      }
+    }
+  }
+
+  void invalidateCacheLocked() {
+    for (auto& entry : cache_) {
+      entry.second = folly::none;
+    }
+  }
+
   folly::Synchronized<IO, std::mutex> io_;
+  // Protected by the lock of io_, like the IO itself
+  std::unordered_map<uint32_t, folly::Optional<phy::Cl45Data>> cache_;
+  Stats stats_;
 };
 
 template <typename IO>
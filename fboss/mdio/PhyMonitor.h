@@ -0,0 +1,241 @@
+/*
+ *  Copyright (c) 2018-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#pragma once
+
+#include "fboss/mdio/Mdio.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <folly/Optional.h>
+#include <folly/experimental/FunctionScheduler.h>
+
+namespace facebook {
+namespace fboss {
+
+/*
+ * PhyMonitor periodically polls health registers, such as link status,
+ * error counters and temperature, of the PHYs on one MDIO controller, and
+ * hands what it reads to a Callback, which publishes it as counters and
+ * link events.
+ *
+ * Each register is polled at its own interval, so that link status can be
+ * polled often and temperature rarely. Every tick, the registers that are
+ * due are read in one transaction on the controller, most overdue first,
+ * and at most maxOpsPerTick of them, so that monitoring never holds the
+ * bus for long. What doesn't fit is read on the next tick.
+ *
+ * Monitoring backs off while paused, such as while ports are programmed,
+ * so that it doesn't compete with them for the bus.
+ *
+ * The PHYs and registers are added before start(), and the callback is
+ * called on the thread of the monitor.
+ */
+template <typename IO>
+class PhyMonitor {
+ public:
+  struct Register {
+    std::string name;
+    phy::Cl45DeviceAddress devAddr;
+    phy::Cl45RegisterAddress regAddr;
+    std::chrono::milliseconds interval;
+    // For link status registers, the bits that are all set when link is up
+    folly::Optional<phy::Cl45Data> linkUpMask;
+  };
+
+  class Callback {
+   public:
+    virtual ~Callback() {}
+    virtual void phyRegisterRead(
+        const std::string& phy,
+        const Register& reg,
+        phy::Cl45Data value) = 0;
+    // Also called for the first read of each link status register
+    virtual void phyLinkChanged(const std::string& phy, bool up) = 0;
+    virtual void phyPollFailed(const std::exception& ex) = 0;
+  };
+
+  struct Stats {
+    uint64_t polls{0};
+    uint64_t reads{0};
+    uint64_t failures{0};
+    // Ticks skipped while paused
+    uint64_t pausedTicks{0};
+  };
+
+  PhyMonitor(
+      MdioController<IO>& controller,
+      Callback* callback,
+      std::chrono::milliseconds tickInterval = std::chrono::milliseconds(100),
+      size_t maxOpsPerTick = 16)
+      : controller_(controller),
+        callback_(callback),
+        tickInterval_(tickInterval),
+        maxOpsPerTick_(maxOpsPerTick) {}
+
+  ~PhyMonitor() {
+    stop();
+  }
+
+  void addPhy(const std::string& name, phy::PhyAddress address) {
+    phys_.push_back(Phy{name, address});
+    for (size_t reg = 0; reg < registers_.size(); ++reg) {
+      addItem(phys_.size() - 1, reg);
+    }
+  }
+
+  // Poll the register on every PHY
+  void addRegister(Register reg) {
+    registers_.push_back(std::move(reg));
+    for (size_t phy = 0; phy < phys_.size(); ++phy) {
+      addItem(phy, registers_.size() - 1);
+    }
+  }
+
+  void start() {
+    scheduler_.addFunction(
+        [this]() { poll(std::chrono::steady_clock::now()); },
+        tickInterval_,
+        "phyMonitor");
+    scheduler_.start();
+  }
+
+  void stop() {
+    scheduler_.shutdown();
+  }
+
+  /*
+   * Pauses nest, monitoring resumes with the last resume().  pause() waits
+   * for a tick in progress to finish, so that the bus is free once it
+   * returns, and so must not be called from the callback.
+   */
+  void pause() {
+    ++pauses_;
+    std::lock_guard<std::mutex> guard(tickLock_);
+  }
+  void resume() {
+    --pauses_;
+  }
+
+  // One tick: read the registers that are due by now
+  void poll(std::chrono::steady_clock::time_point now) {
+    std::lock_guard<std::mutex> guard(tickLock_);
+    if (pauses_.load() > 0) {
+      ++stats_.pausedTicks;
+      return;
+    }
+    due_.clear();
+    for (size_t i = 0; i < items_.size(); ++i) {
+      if (items_[i].nextPoll <= now) {
+        due_.push_back(i);
+      }
+    }
+    if (due_.empty()) {
+      return;
+    }
+    if (due_.size() > maxOpsPerTick_) {
+      std::partial_sort(
+          due_.begin(),
+          due_.begin() + maxOpsPerTick_,
+          due_.end(),
+          [this](size_t a, size_t b) {
+            return items_[a].nextPoll < items_[b].nextPoll;
+          });
+      due_.resize(maxOpsPerTick_);
+    }
+
+    ops_.clear();
+    for (auto i : due_) {
+      const auto& item = items_[i];
+      const auto& reg = registers_[item.reg];
+      ops_.push_back(MdioOp::read(
+          phys_[item.phy].address, reg.devAddr, reg.regAddr));
+    }
+    ++stats_.polls;
+    try {
+      controller_.runCl45(folly::Range<MdioOp*>(ops_.data(), ops_.size()));
+    } catch (const std::exception& ex) {
+      // The registers stay due, to be read on the next tick
+      ++stats_.failures;
+      callback_->phyPollFailed(ex);
+      return;
+    }
+    stats_.reads += ops_.size();
+
+    for (size_t j = 0; j < due_.size(); ++j) {
+      auto& item = items_[due_[j]];
+      const auto& phy = phys_[item.phy];
+      const auto& reg = registers_[item.reg];
+      auto value = ops_[j].data;
+      item.nextPoll = now + reg.interval;
+      callback_->phyRegisterRead(phy.name, reg, value);
+      if (reg.linkUpMask) {
+        bool up = (value & *reg.linkUpMask) == *reg.linkUpMask;
+        if (!item.linkUp || *item.linkUp != up) {
+          item.linkUp = up;
+          callback_->phyLinkChanged(phy.name, up);
+        }
+      }
+    }
+  }
+
+  // Only consistent while the monitor is stopped, or from the callback
+  const Stats& getStats() const {
+    return stats_;
+  }
+
+ private:
+  struct Phy {
+    std::string name;
+    phy::PhyAddress address;
+  };
+
+  // A register of a PHY
+  struct Item {
+    size_t phy;
+    size_t reg;
+    std::chrono::steady_clock::time_point nextPoll;
+    folly::Optional<bool> linkUp;
+  };
+
+  void addItem(size_t phy, size_t reg) {
+    // Due right away
+    items_.push_back(Item{phy, reg, {}, folly::none});
+  }
+
+  // Forbidden copy constructor and assignment operator
+  PhyMonitor(PhyMonitor const&) = delete;
+  PhyMonitor& operator=(PhyMonitor const&) = delete;
+
+  MdioController<IO>& controller_;
+  Callback* callback_{nullptr};
+  const std::chrono::milliseconds tickInterval_;
+  const size_t maxOpsPerTick_;
+  std::atomic<int> pauses_{0};
+  // Held for each tick, so that pause() can wait for one in progress
+  std::mutex tickLock_;
+
+  std::vector<Phy> phys_;
+  std::vector<Register> registers_;
+  std::vector<Item> items_;
+  // Reused by each tick
+  std::vector<size_t> due_;
+  std::vector<MdioOp> ops_;
+  Stats stats_;
+  folly::FunctionScheduler scheduler_;
+};
+
+} // namespace fboss
+} // namespace facebook
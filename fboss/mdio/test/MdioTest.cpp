@@ -0,0 +1,183 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "fboss/mdio/Mdio.h"
+#include "fboss/mdio/MdioError.h"
+
+#include <gtest/gtest.h>
+
+#include <map>
+#include <tuple>
+#include <vector>
+
+using namespace facebook::fboss;
+
+namespace {
+
+constexpr phy::PhyAddress kPhy = 1;
+constexpr phy::Cl45DeviceAddress kDev = 1;
+constexpr phy::Cl45RegisterAddress kConfigReg = 0x10;
+constexpr phy::Cl45RegisterAddress kStatusReg = 0x20;
+
+// The registers of the PHYs, and the accesses the controller made
+struct FakeBus {
+  using RegKey = std::tuple<
+      phy::PhyAddress,
+      phy::Cl45DeviceAddress,
+      phy::Cl45RegisterAddress>;
+
+  std::map<RegKey, phy::Cl45Data> registers;
+  // The number of ops in each runCl45() of the IO
+  std::vector<size_t> runs;
+  std::vector<MdioOp> ops;
+  // Fail the next runCl45() of the IO
+  bool fail{false};
+};
+
+class FakeIO : public Mdio {
+ public:
+  explicit FakeIO(FakeBus* bus) : bus_(bus) {}
+
+  phy::Cl45Data readCl45(
+      phy::PhyAddress physAddr,
+      phy::Cl45DeviceAddress devAddr,
+      phy::Cl45RegisterAddress regAddr) override {
+    bus_->ops.push_back(MdioOp::read(physAddr, devAddr, regAddr));
+    return bus_->registers[FakeBus::RegKey(physAddr, devAddr, regAddr)];
+  }
+
+  void writeCl45(
+      phy::PhyAddress physAddr,
+      phy::Cl45DeviceAddress devAddr,
+      phy::Cl45RegisterAddress regAddr,
+      phy::Cl45Data data) override {
+    bus_->ops.push_back(MdioOp::write(physAddr, devAddr, regAddr, data));
+    bus_->registers[FakeBus::RegKey(physAddr, devAddr, regAddr)] = data;
+  }
+
+  void runCl45(folly::Range<MdioOp*> ops) override {
+    if (bus_->fail) {
+      bus_->fail = false;
+      throw MdioError("injected MDIO failure");
+    }
+    bus_->runs.push_back(ops.size());
+    Mdio::runCl45(ops);
+  }
+
+ private:
+  FakeBus* bus_;
+};
+
+class MdioControllerTest : public ::testing::Test {
+ public:
+  void SetUp() override {
+    bus_.registers[FakeBus::RegKey(kPhy, kDev, kConfigReg)] = 0x1234;
+    bus_.registers[FakeBus::RegKey(kPhy, kDev, kStatusReg)] = 0x4;
+    controller_.cacheCl45(kPhy, kDev, kConfigReg);
+  }
+
+ protected:
+  FakeBus bus_;
+  MdioController<FakeIO> controller_{&bus_};
+};
+
+} // unnamed namespace
+
+TEST_F(MdioControllerTest, CachedReadsSkipTheBus) {
+  EXPECT_EQ(0x1234, controller_.readCl45(kPhy, kDev, kConfigReg));
+  EXPECT_EQ(1, bus_.ops.size());
+
+  // Once read, the cached register is served without going to the bus,
+  // but registers that aren't cached still are
+  bus_.registers[FakeBus::RegKey(kPhy, kDev, kConfigReg)] = 0xffff;
+  EXPECT_EQ(0x1234, controller_.readCl45(kPhy, kDev, kConfigReg));
+  EXPECT_EQ(1, bus_.ops.size());
+  EXPECT_EQ(0x4, controller_.readCl45(kPhy, kDev, kStatusReg));
+  EXPECT_EQ(2, bus_.ops.size());
+  EXPECT_EQ(1, controller_.getStats().cacheHits);
+  EXPECT_EQ(3, controller_.getStats().transactions);
+}
+
+TEST_F(MdioControllerTest, CachedReadsBetweenUncachedOps) {
+  controller_.readCl45(kPhy, kDev, kConfigReg);
+  bus_.runs.clear();
+  bus_.ops.clear();
+
+  // The ops on either side of the cached read go to the IO separately, in
+  // order, and the cached read is filled in from the cache
+  std::vector<MdioOp> ops{
+      MdioOp::read(kPhy, kDev, kStatusReg),
+      MdioOp::write(kPhy, kDev, 0x30, 0x7),
+      MdioOp::read(kPhy, kDev, kConfigReg),
+      MdioOp::read(kPhy, kDev, 0x30),
+  };
+  controller_.runCl45(folly::Range<MdioOp*>(ops.data(), ops.size()));
+  EXPECT_EQ(0x4, ops[0].data);
+  EXPECT_EQ(0x1234, ops[2].data);
+  EXPECT_EQ(0x7, ops[3].data);
+  EXPECT_EQ(std::vector<size_t>({2, 1}), bus_.runs);
+  ASSERT_EQ(3, bus_.ops.size());
+  EXPECT_EQ(kStatusReg, bus_.ops[0].regAddr);
+  EXPECT_EQ(MdioOp::Type::WRITE, bus_.ops[1].type);
+  EXPECT_EQ(0x30, bus_.ops[2].regAddr);
+
+  // Only a cached register that has been read or written is served
+  controller_.cacheCl45(kPhy, kDev, kStatusReg);
+  EXPECT_EQ(0x4, controller_.readCl45(kPhy, kDev, kStatusReg));
+  EXPECT_EQ(4, bus_.ops.size());
+}
+
+TEST_F(MdioControllerTest, WriteThenReadInOneTransaction) {
+  // The read of the register just written is served from the cache, after
+  // the write has gone to the bus
+  std::vector<MdioOp> ops{
+      MdioOp::write(kPhy, kDev, kConfigReg, 0x5678),
+      MdioOp::read(kPhy, kDev, kConfigReg),
+  };
+  controller_.runCl45(folly::Range<MdioOp*>(ops.data(), ops.size()));
+  EXPECT_EQ(0x5678, ops[1].data);
+  ASSERT_EQ(1, bus_.ops.size());
+  EXPECT_EQ(MdioOp::Type::WRITE, bus_.ops[0].type);
+  EXPECT_EQ(0x5678, (bus_.registers[FakeBus::RegKey(kPhy, kDev, kConfigReg)]));
+  EXPECT_EQ(0x5678, controller_.readCl45(kPhy, kDev, kConfigReg));
+  EXPECT_EQ(1, bus_.ops.size());
+
+  // A read before a write in the same transaction sees the old value, and
+  // the cache keeps the written one
+  ops = {
+      MdioOp::read(kPhy, kDev, kConfigReg),
+      MdioOp::write(kPhy, kDev, kConfigReg, 0x9abc),
+  };
+  controller_.invalidateCache();
+  controller_.runCl45(folly::Range<MdioOp*>(ops.data(), ops.size()));
+  EXPECT_EQ(0x5678, ops[0].data);
+  EXPECT_EQ(3, bus_.ops.size());
+  EXPECT_EQ(0x9abc, controller_.readCl45(kPhy, kDev, kConfigReg));
+  EXPECT_EQ(3, bus_.ops.size());
+}
+
+TEST_F(MdioControllerTest, FailureInvalidatesCache) {
+  EXPECT_EQ(0x1234, controller_.readCl45(kPhy, kDev, kConfigReg));
+
+  // A write that may not have reached the device isn't trusted
+  bus_.fail = true;
+  EXPECT_THROW(
+      controller_.writeCl45(kPhy, kDev, kConfigReg, 0x5678), MdioError);
+  EXPECT_EQ(0x1234, controller_.readCl45(kPhy, kDev, kConfigReg));
+  EXPECT_EQ(2, bus_.ops.size());
+  EXPECT_EQ(MdioOp::Type::READ, bus_.ops.back().type);
+
+  // Nor is anything cached before a failure in an unrelated transaction
+  bus_.fail = true;
+  EXPECT_THROW(controller_.readCl45(kPhy, kDev, kStatusReg), MdioError);
+  EXPECT_EQ(0x1234, controller_.readCl45(kPhy, kDev, kConfigReg));
+  EXPECT_EQ(3, bus_.ops.size());
+  // Only completed transactions are counted
+  EXPECT_EQ(3, controller_.getStats().transactions);
+}
@@ -0,0 +1,211 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "fboss/mdio/PhyMonitor.h"
+#include "fboss/mdio/MdioError.h"
+
+#include <folly/synchronization/Baton.h>
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+using namespace facebook::fboss;
+using std::chrono::milliseconds;
+using std::chrono::seconds;
+using std::chrono::steady_clock;
+
+namespace {
+
+struct FakeBus {
+  // What every register reads as
+  phy::Cl45Data value{0};
+  size_t runs{0};
+  bool fail{false};
+  // Block each runCl45() of the IO, after posting entered, until release
+  bool block{false};
+  folly::Baton<> entered;
+  folly::Baton<> release;
+};
+
+class FakeIO : public Mdio {
+ public:
+  explicit FakeIO(FakeBus* bus) : bus_(bus) {}
+
+  phy::Cl45Data readCl45(
+      phy::PhyAddress /*physAddr*/,
+      phy::Cl45DeviceAddress /*devAddr*/,
+      phy::Cl45RegisterAddress /*regAddr*/) override {
+    return bus_->value;
+  }
+
+  void writeCl45(
+      phy::PhyAddress /*physAddr*/,
+      phy::Cl45DeviceAddress /*devAddr*/,
+      phy::Cl45RegisterAddress /*regAddr*/,
+      phy::Cl45Data /*data*/) override {}
+
+  void runCl45(folly::Range<MdioOp*> ops) override {
+    ++bus_->runs;
+    if (bus_->block) {
+      bus_->entered.post();
+      bus_->release.wait();
+    }
+    if (bus_->fail) {
+      throw MdioError("injected MDIO failure");
+    }
+    Mdio::runCl45(ops);
+  }
+
+ private:
+  FakeBus* bus_;
+};
+
+using Monitor = PhyMonitor<FakeIO>;
+
+class RecordingCallback : public Monitor::Callback {
+ public:
+  void phyRegisterRead(
+      const std::string& phy,
+      const Monitor::Register& reg,
+      phy::Cl45Data /*value*/) override {
+    reads.push_back(phy + "." + reg.name);
+  }
+  void phyLinkChanged(const std::string& phy, bool up) override {
+    links.push_back(phy + (up ? " up" : " down"));
+  }
+  void phyPollFailed(const std::exception& /*ex*/) override {
+    ++failures;
+  }
+
+  std::vector<std::string> reads;
+  std::vector<std::string> links;
+  int failures{0};
+};
+
+Monitor::Register makeRegister(
+    const std::string& name,
+    milliseconds interval,
+    folly::Optional<phy::Cl45Data> linkUpMask = folly::none) {
+  return Monitor::Register{name, 1, 1, interval, linkUpMask};
+}
+
+} // unnamed namespace
+
+TEST(PhyMonitor, PollsDueRegisters) {
+  FakeBus bus;
+  MdioController<FakeIO> controller(&bus);
+  RecordingCallback callback;
+  Monitor monitor(controller, &callback, milliseconds(100), 3);
+  monitor.addPhy("phy1", 1);
+  monitor.addPhy("phy2", 2);
+  monitor.addRegister(makeRegister("link", milliseconds(100), 0x4));
+  monitor.addRegister(makeRegister("temp", seconds(10)));
+
+  // Everything is due at first, but only 3 reads fit in a tick
+  auto now = steady_clock::now();
+  bus.value = 0x4;
+  monitor.poll(now);
+  EXPECT_EQ(3, callback.reads.size());
+  EXPECT_EQ(1, bus.runs);
+  monitor.poll(now + milliseconds(50));
+  EXPECT_EQ(4, callback.reads.size());
+  auto links = callback.links;
+  std::sort(links.begin(), links.end());
+  EXPECT_EQ(std::vector<std::string>({"phy1 up", "phy2 up"}), links);
+
+  // Then link status is read on its own interval, and changes are reported
+  callback.reads.clear();
+  bus.value = 0;
+  monitor.poll(now + milliseconds(200));
+  EXPECT_EQ(
+      std::vector<std::string>({"phy1.link", "phy2.link"}), callback.reads);
+  EXPECT_EQ(4, callback.links.size());
+}
+
+TEST(PhyMonitor, FailedPollsRetry) {
+  FakeBus bus;
+  MdioController<FakeIO> controller(&bus);
+  RecordingCallback callback;
+  Monitor monitor(controller, &callback);
+  monitor.addPhy("phy1", 1);
+  monitor.addRegister(makeRegister("temp", seconds(10)));
+
+  auto now = steady_clock::now();
+  bus.fail = true;
+  monitor.poll(now);
+  EXPECT_EQ(1, callback.failures);
+  EXPECT_TRUE(callback.reads.empty());
+  bus.fail = false;
+  monitor.poll(now + milliseconds(100));
+  EXPECT_EQ(1, callback.reads.size());
+  EXPECT_EQ(1, monitor.getStats().failures);
+  EXPECT_EQ(1, monitor.getStats().reads);
+}
+
+TEST(PhyMonitor, PausedTicksSkipTheBus) {
+  FakeBus bus;
+  MdioController<FakeIO> controller(&bus);
+  RecordingCallback callback;
+  Monitor monitor(controller, &callback);
+  monitor.addPhy("phy1", 1);
+  monitor.addRegister(makeRegister("link", milliseconds(100), 0x4));
+
+  // Pauses nest
+  auto now = steady_clock::now();
+  monitor.pause();
+  monitor.pause();
+  monitor.poll(now);
+  monitor.resume();
+  monitor.poll(now);
+  EXPECT_EQ(0, bus.runs);
+  EXPECT_EQ(2, monitor.getStats().pausedTicks);
+  monitor.resume();
+  monitor.poll(now);
+  EXPECT_EQ(1, bus.runs);
+  EXPECT_EQ(1, callback.reads.size());
+}
+
+TEST(PhyMonitor, PauseWaitsForTickInProgress) {
+  FakeBus bus;
+  bus.block = true;
+  MdioController<FakeIO> controller(&bus);
+  RecordingCallback callback;
+  Monitor monitor(controller, &callback);
+  monitor.addPhy("phy1", 1);
+  monitor.addRegister(makeRegister("link", milliseconds(100), 0x4));
+
+  auto now = steady_clock::now();
+  std::thread ticker([&] { monitor.poll(now); });
+  bus.entered.wait();
+  std::atomic<bool> paused{false};
+  std::thread pauser([&] {
+    monitor.pause();
+    paused = true;
+  });
+  // Still on the bus, so the pause can't have finished
+  std::this_thread::sleep_for(milliseconds(50));
+  EXPECT_FALSE(paused.load());
+  bus.release.post();
+  pauser.join();
+  ticker.join();
+  EXPECT_TRUE(paused.load());
+  EXPECT_EQ(1, callback.reads.size());
+
+  // And no tick goes to the bus until it is resumed
+  bus.block = false;
+  monitor.poll(now + seconds(1));
+  EXPECT_EQ(1, bus.runs);
+  monitor.resume();
+  monitor.poll(now + seconds(1));
+  EXPECT_EQ(2, bus.runs);
+}
@@ -1,8 +1,13 @@
 #include "NetlinkManager.h"
+#include <algorithm>
 #include <chrono>
 #include "NetlinkManagerException.h"
+#include "common/stats/ServiceData.h"
+#include "fboss/agent/AddressUtil.h"
+#include "folly/Conv.h"
 #include "folly/Format.h"
 #include "folly/ScopeGuard.h"
+#include "folly/String.h"
 #include "folly/futures/Future.h"
 #include "folly/io/async/EventBase.h"
 #include "thrift/lib/cpp/async/TAsyncSocket.h"
@@ -17,16 +22,50 @@ DEFINE_string(
     interfaces,
     "",
     "comma-separated list of names of interfaces to listen to");
+DEFINE_int32(
+    route_batch_window_ms,
+    10,
+    "How long to collect route updates before sending them to the agent in "
+    "one batch. 0 sends what is read from netlink in one go");
+DEFINE_int32(
+    route_batch_max_size,
+    10000,
+    "Send the collected route updates as soon as there are this many");
+DEFINE_int32(
+    route_batch_max_inflight,
+    8,
+    "How many route batches can be sent to the agent before the first of "
+    "them is answered");
+DEFINE_int32(
+    route_resync_retry_ms,
+    1000,
+    "How long to wait before resyncing routes with the agent, after a call "
+    "to it failed");
+DEFINE_string(
+    route_tables,
+    "",
+    "comma-separated list of kernel_table:vrf pairs, e.g. 254:0,100:1, of "
+    "the kernel routing tables to mirror and the FBOSS agent VRF each goes "
+    "into. Empty mirrors all tables into VRF 0");
 
 namespace {
-struct nl_dump_params initDumpParams() {
-  struct nl_dump_params dumpParams;
-  memset(&dumpParams, 0, sizeof(dumpParams));
-  dumpParams.dp_type = NL_DUMP_STATS;
-  dumpParams.dp_fd = stdout;
-  return dumpParams;
+// How often the per table counters are published
+constexpr int kTableStatsIntervalMs = 10000;
+
+using VrfRoutes =
+    std::pair<int32_t, std::vector<facebook::fboss::UnicastRoute>>;
+
+// A route's next hops, in a form that compares equal for the same set
+std::set<std::string> nexthopSet(
+    const std::vector<facebook::fboss::BinaryAddress>& nexthops) {
+  std::set<std::string> result;
+  for (const auto& nexthop : nexthops) {
+    result.insert(nexthop.addr.toStdString());
+  }
+  return result;
 }
 } // namespace
+
 namespace facebook {
 namespace fboss {
 
@@ -36,10 +75,11 @@ NetlinkManager::NetlinkManager(folly::EventBase* eb)
 }
 
 void NetlinkManager::run() {
+  setRouteTables();
   setMonitoredInterfaces();
   testFbossClient();
   callSyncFib();
-  registerWNetlink();
+  nlResources_ = std::make_unique<NlResources>();
   startListening();
 }
 
@@ -108,13 +148,101 @@ void NetlinkManager::testFbossClient() {
 }
 
 // The fboss agent will not accept incremental route changes
-// (e.g., addUnicastRoute() ) until *after* syncFib() is called
-//  to unblock the open source, it's probably ok to call syncFib()
-// with an empty list of routes and then we'll go back and fix this.
+// (e.g., addUnicastRoute() ) until *after* syncFib() is called.  Syncing the
+// routes the agent already has from us unblocks it without changing any of
+// them, and tells us what the agent has.  The first dump of the kernel table
+// then only sends what changed, e.g. while netlink_manager was restarting.
 void NetlinkManager::callSyncFib() {
-  std::vector<UnicastRoute> routes;
   FbossClient fbossClient = getFbossClient(FLAGS_ip, FLAGS_fboss_port);
-  fbossClient->sync_syncFib(FBOSS_CLIENT_ID, routes);
+  for (auto vrf : getVrfs()) {
+    std::vector<UnicastRoute> routes;
+    if (tableVrfs_.empty()) {
+      fbossClient->sync_getRouteTableByClient(routes, FBOSS_CLIENT_ID);
+      fbossClient->sync_syncFib(FBOSS_CLIENT_ID, routes);
+    } else {
+      fbossClient->sync_getRouteTableByClientInVrf(
+          routes, FBOSS_CLIENT_ID, vrf);
+      fbossClient->sync_syncFibInVrf(FBOSS_CLIENT_ID, vrf, routes);
+    }
+    setAgentRoutes(vrf, routes);
+  }
+  agentRoutesKnown_ = true;
+}
+
+void NetlinkManager::setAgentRoutes(
+    int32_t vrf,
+    const std::vector<UnicastRoute>& routes) {
+  for (auto iter = sentRoutes_.begin(); iter != sentRoutes_.end();) {
+    if (iter->first.first == vrf) {
+      iter = sentRoutes_.erase(iter);
+    } else {
+      ++iter;
+    }
+  }
+  for (const auto& route : routes) {
+    const auto& ip = route.dest.ip.addr;
+    auto network = std::make_pair(
+        folly::IPAddress::fromBinary(folly::ByteRange(
+            reinterpret_cast<const unsigned char*>(ip.data()), ip.size())),
+        static_cast<uint8_t>(route.dest.prefixLength));
+    sentRoutes_[RouteKey(vrf, network)] =
+        SentRoute{nexthopSet(route.nextHopAddrs), generation_};
+  }
+  tableStats_[vrf].routes = routes.size();
+  VLOG(1) << "FBOSS agent has " << routes.size() << " of our routes in VRF "
+          << vrf;
+}
+
+void NetlinkManager::setRouteTables() {
+  std::vector<folly::StringPiece> pairs;
+  folly::split(",", FLAGS_route_tables, pairs, true);
+  std::set<int32_t> vrfs;
+  for (auto pair : pairs) {
+    folly::StringPiece table;
+    folly::StringPiece vrf;
+    if (!folly::split(':', pair, table, vrf)) {
+      throw NetlinkManagerException(folly::sformat(
+          "Bad route table {}, expected kernel_table:vrf", pair));
+    }
+    auto tableId = folly::to<uint32_t>(table);
+    auto vrfId = folly::to<int32_t>(vrf);
+    // Two tables in one VRF could have the same prefix, and only one of
+    // them can be in the agent
+    if (!tableVrfs_.emplace(tableId, vrfId).second ||
+        !vrfs.insert(vrfId).second) {
+      throw NetlinkManagerException(folly::sformat(
+          "Route table {} or VRF {} is listed more than once",
+          tableId,
+          vrfId));
+    }
+    tableStats_[vrfId].name =
+        folly::sformat("netlink_manager.table.{}", tableId);
+  }
+  if (tableVrfs_.empty()) {
+    tableStats_[0].name = "netlink_manager.table.all";
+  }
+}
+
+std::vector<int32_t> NetlinkManager::getVrfs() const {
+  std::vector<int32_t> vrfs;
+  for (const auto& entry : tableStats_) {
+    vrfs.push_back(entry.first);
+  }
+  return vrfs;
+}
+
+int32_t NetlinkManager::getVrf(uint32_t table) const {
+  // The listener only passes on the tables in tableVrfs_
+  return tableVrfs_.empty() ? 0 : tableVrfs_.at(table);
+}
+
+FbossCtrlAsyncClient* NetlinkManager::getBatchClient() {
+  // A client whose channel failed does not recover, so start a new one
+  if (!batchClient_ || batchClientFailed_) {
+    batchClient_ = getFbossClient(FLAGS_ip, FLAGS_fboss_port);
+    batchClientFailed_ = false;
+  }
+  return batchClient_.get();
 }
 
 void NetlinkManager::setMonitoredInterfaces() {
@@ -150,23 +278,37 @@ std::set<std::string> NetlinkManager::parseInterfacesArg(
       vectorInterfaces.begin(), vectorInterfaces.end());
 }
 
-void NetlinkManager::registerWNetlink() {
-  initDumpParams();
-
-  nlResources_ = std::make_unique<NlResources>();
-  auto errCode = nl_cache_mngr_add_cache(
-      nlResources_->manager,
-      nlResources_->routeCache,
-      netlinkRouteUpdated,
-      this);
-  checkError(errCode, "Failed to add route cache to cache manager");
-  VLOG(1) << "Added route cache to cache manager";
-  return;
+void NetlinkManager::startListening() {
+  std::set<uint32_t> tables;
+  for (const auto& entry : tableVrfs_) {
+    tables.insert(entry.first);
+  }
+  listener_ = std::make_unique<NetlinkRouteListener>(
+      eb_,
+      std::move(tables),
+      [this](NetlinkRouteListener::RouteUpdate update) {
+        routeUpdated(std::move(update));
+      },
+      [this](std::vector<NetlinkRouteListener::RouteUpdate> routes) {
+        routesResynced(std::move(routes));
+      });
+  listener_->start();
+  publishTableStats();
 }
 
-void NetlinkManager::startListening() {
-  int fd = nl_cache_mngr_get_fd(nlResources_->manager);
-  poller_ = std::make_unique<NetlinkPoller>(eb_, fd, nlResources_->manager);
+void NetlinkManager::publishTableStats() {
+  for (auto& entry : tableStats_) {
+    auto& stats = entry.second;
+    fbData->setCounter(stats.name + ".routes", stats.routes);
+    fbData->setCounter(stats.name + ".events", stats.events);
+    fbData->setCounter(
+        stats.name + ".events_per_sec",
+        (stats.events - stats.eventsPublished) * 1000 / kTableStatsIntervalMs);
+    stats.eventsPublished = stats.events;
+  }
+  fbData->setCounter(
+      "netlink_manager.routes_filtered", listener_->getFiltered());
+  eb_->runAfterDelay([this]() { publishTableStats(); }, kTableStatsIntervalMs);
 }
 
 void NetlinkManager::terminateEventBase() {
@@ -186,114 +328,378 @@ void NetlinkManager::checkError(int errCode, std::string message) {
   }
 }
 
-void NetlinkManager::netlinkRouteUpdated(
-    struct nl_cache* /*cache*/,
-    struct nl_object* obj,
-    int nlOperation,
-    void* data) {
-  NetlinkManager* nlm = static_cast<NetlinkManager*>(data);
-  std::string operation = nlm->nlOperationToStr(nlOperation);
-  if (operation == "unknown") {
-    VLOG(1) << "Ignoring an unknown route update";
-    return;
+std::vector<BinaryAddress> NetlinkManager::getGateways(
+    const NetlinkRouteListener::RouteUpdate& update) {
+  std::vector<BinaryAddress> gateways;
+  std::lock_guard<std::mutex> lock(interfacesMutex_);
+  for (const auto& nexthop : update.nexthops) {
+    char ifname[IFNAMSIZ] = {};
+    if_indextoname(nexthop.ifindex, ifname);
+    if (monitoredInterfaces_.find(ifname) == monitoredInterfaces_.end()) {
+      VLOG(1) << "Interface index  " << nexthop.ifindex
+              << "is not set to be monitored";
+    }
+    gateways.push_back(nexthop.gateway);
   }
+  return gateways;
+}
 
+void NetlinkManager::routeUpdated(NetlinkRouteListener::RouteUpdate update) {
+  auto vrf = getVrf(update.table);
+  ++tableStats_[vrf].events;
+  std::string operation = update.add ? "NEW" : "DELETE";
+  auto strDst = folly::sformat(
+      "{}/{}", update.network.first.str(), update.network.second);
   VLOG(2) << "Received a " << operation << " netlink route update message";
-  struct rtnl_route* route = (struct rtnl_route*)obj;
 
-  if (rtnl_route_get_type(route) != RTN_UNICAST) {
-    VLOG(1) << "Ignoring non-unicast route update";
+  auto nexthops = getGateways(update);
+  if (nexthops.empty()) {
+    VLOG(1) << operation << " Route update for " << strDst
+            << " has no valid nexthop";
     return;
   }
 
-  struct nl_addr* nlDst = rtnl_route_get_dst(route);
-  const uint8_t ipLen = nl_addr_get_prefixlen(nlDst);
-  char strDst[ipLen];
-  nl_addr2str(nlDst, strDst, ipLen);
-
-  int numNexthops = rtnl_route_get_nnexthops(route);
-  if (!numNexthops) {
-    VLOG(0) << "Could not find next hop for route update for " << strDst;
-    struct nl_dump_params dumpParams = initDumpParams();
-    nl_object_dump((nl_object*)route, &dumpParams);
+  if (FLAGS_debug) {
+    VLOG(1) << "Got " << operation << " route update for " << strDst;
     return;
   }
 
-  std::vector<BinaryAddress> nexthops;
-  {
-    std::lock_guard<std::mutex> lock(nlm->interfacesMutex_);
-    nexthops = getNextHops(route, ipLen, nlm->monitoredInterfaces_);
+  queueRouteUpdate(
+      RouteKey(vrf, update.network),
+      update.add ? std::move(nexthops) : std::vector<BinaryAddress>(),
+      update.add);
+}
+
+void NetlinkManager::routesResynced(
+    std::vector<NetlinkRouteListener::RouteUpdate> routes) {
+  ++routeResyncs_;
+  fbData->setCounter("netlink_manager.route_resyncs", routeResyncs_);
+  fbData->setCounter(
+      "netlink_manager.netlink_overflows", listener_->getOverflows());
+  if (FLAGS_debug) {
+    VLOG(1) << "Got " << routes.size() << " routes from the kernel";
+    return;
   }
 
-  if (nexthops.empty()) {
-    VLOG(1) << operation << " Route update for " << strDst
-            << " has no valid nexthop";
+  // The kernel table supersedes whatever was waiting to go out.  Anything
+  // queued from here on came in after the dump, so diffRoutes() leaves it.
+  pendingRoutes_.clear();
+  if (agentRoutesKnown_) {
+    diffRoutes(std::move(routes));
     return;
   }
+  // A call to the agent failed, so what it has is unknown until we ask.  If
+  // the agent restarted, it also needs a syncFib() before it takes route
+  // updates again, same as in callSyncFib().
+  bool inVrf = !tableVrfs_.empty();
+  std::vector<folly::Future<VrfRoutes>> synced;
+  for (auto vrf : getVrfs()) {
+    auto client = getBatchClient();
+    auto agentRoutes = inVrf
+        ? client->future_getRouteTableByClientInVrf(FBOSS_CLIENT_ID, vrf)
+        : client->future_getRouteTableByClient(FBOSS_CLIENT_ID);
+    auto syncVrf = [this, inVrf, vrf](std::vector<UnicastRoute> agentRoutes) {
+      auto client = getBatchClient();
+      auto done = inVrf
+          ? client->future_syncFibInVrf(FBOSS_CLIENT_ID, vrf, agentRoutes)
+          : client->future_syncFib(FBOSS_CLIENT_ID, agentRoutes);
+      return done.then(
+          [ vrf, agentRoutes = std::move(agentRoutes) ]() mutable {
+            return VrfRoutes(vrf, std::move(agentRoutes));
+          });
+    };
+    synced.push_back(std::move(agentRoutes).then(std::move(syncVrf)));
+  }
+  folly::collectAllSemiFuture(synced).toUnsafeFuture().then(
+      [ this, routes = std::move(routes) ](
+          std::vector<folly::Try<VrfRoutes>> results) mutable {
+        for (auto& result : results) {
+          if (result.hasException()) {
+            VLOG(0) << "Failed to get routes from FBOSS agent: "
+                    << result.exception().what();
+            batchClientFailed_ = true;
+            scheduleResync();
+            return;
+          }
+        }
+        for (auto& result : results) {
+          setAgentRoutes(result->first, result->second);
+        }
+        agentRoutesKnown_ = true;
+        diffRoutes(std::move(routes));
+      });
+}
 
-  if (FLAGS_debug) {
-    VLOG(1) << "Got " << operation << " route update for " << strDst;
+void NetlinkManager::diffRoutes(
+    std::vector<NetlinkRouteListener::RouteUpdate> routes) {
+  // Routes the kernel still has are marked with the new generation, and
+  // the ones left with an older generation are gone from the kernel
+  auto generation = ++generation_;
+  int64_t added = 0;
+  int64_t unchanged = 0;
+  for (auto& route : routes) {
+    auto nexthops = getGateways(route);
+    RouteKey key(getVrf(route.table), route.network);
+    if (nexthops.empty() || pendingRoutes_.count(key)) {
+      continue;
+    }
+    auto iter = sentRoutes_.find(key);
+    if (iter != sentRoutes_.end() &&
+        iter->second.nexthops == nexthopSet(nexthops)) {
+      iter->second.generation = generation;
+      ++unchanged;
+      continue;
+    }
+    ++added;
+    queueRouteUpdate(key, std::move(nexthops), true);
+  }
+  std::vector<RouteKey> gone;
+  for (const auto& entry : sentRoutes_) {
+    if (entry.second.generation != generation &&
+        !pendingRoutes_.count(entry.first)) {
+      gone.push_back(entry.first);
+    }
+  }
+  for (const auto& key : gone) {
+    queueRouteUpdate(key, {}, false);
+  }
+
+  VLOG(1) << "Resync found " << added << " routes to add, " << gone.size()
+          << " to delete and " << unchanged << " unchanged";
+  fbData->setCounter("netlink_manager.resync_routes_added", added);
+  fbData->setCounter("netlink_manager.resync_routes_deleted", gone.size());
+  fbData->setCounter("netlink_manager.resync_routes_unchanged", unchanged);
+}
+
+void NetlinkManager::scheduleResync() {
+  if (resyncScheduled_) {
     return;
   }
+  resyncScheduled_ = true;
+  eb_->runAfterDelay(
+      [this]() {
+        resyncScheduled_ = false;
+        listener_->resync();
+      },
+      FLAGS_route_resync_retry_ms);
+}
+
+void NetlinkManager::queueRouteUpdate(
+    const RouteKey& key,
+    std::vector<BinaryAddress> nexthops,
+    bool add) {
+  if (pendingRoutes_.empty()) {
+    batchStart_ = std::chrono::steady_clock::now();
+  }
+  const auto& network = key.second;
+  auto inserted = pendingRoutes_.emplace(key, PendingRoute());
+  if (!inserted.second) {
+    ++routesCoalesced_;
+  }
+  auto& pending = inserted.first->second;
+  pending.add = add;
+  pending.route.dest.ip = facebook::network::toBinaryAddress(network.first);
+  pending.route.dest.prefixLength = network.second;
+  pending.route.nextHopAddrs = std::move(nexthops);
+
+  if (pendingRoutes_.size() >=
+      static_cast<size_t>(FLAGS_route_batch_max_size)) {
+    flushRouteUpdates();
+  } else if (!flushScheduled_) {
+    flushScheduled_ = true;
+    eb_->runAfterDelay(
+        [this]() {
+          flushScheduled_ = false;
+          flushRouteUpdates();
+        },
+        FLAGS_route_batch_window_ms);
+  }
+}
 
-  switch (nlOperation) {
-    case NL_ACT_NEW: {
-      nlm->addRouteViaFbossThrift(nlDst, nexthops);
+void NetlinkManager::flushRouteUpdates() {
+  // Keep up to --route_batch_max_inflight batches on the one channel to the
+  // agent, which answers each as soon as it is applied.  The agent then
+  // never waits on our round trips, only we wait on it when it falls behind.
+  while (!pendingRoutes_.empty() &&
+         inflightBatches_ < FLAGS_route_batch_max_inflight) {
+    if (!sendRouteBatch()) {
       break;
     }
-    case NL_ACT_DEL: {
-      nlm->deleteRouteViaFbossThrift(nlDst);
-      break;
+  }
+}
+
+bool NetlinkManager::sendRouteBatch() {
+  struct VrfUpdates {
+    std::vector<UnicastRoute> toAdd;
+    std::vector<IpPrefix> toDelete;
+  };
+  std::map<int32_t, VrfUpdates> updates;
+  auto keys = std::make_shared<std::vector<RouteKey>>();
+  bool progress = false;
+  auto maxSize = static_cast<size_t>(FLAGS_route_batch_max_size);
+  for (auto iter = pendingRoutes_.begin();
+       iter != pendingRoutes_.end() && keys->size() < maxSize;) {
+    // Batches in flight may be applied in any order, so a prefix waits for
+    // the batch that has it to be answered before it goes out again
+    if (inflightRoutes_.count(iter->first)) {
+      ++iter;
+      continue;
     }
-    case NL_ACT_CHANGE: {
-      VLOG(2) << "Not updating state due to unimplemented"
-              << "NL_ACT_CHANGE netlink operation";
-      break;
+    progress = true;
+    auto vrf = iter->first.first;
+    auto& route = iter->second.route;
+    bool send = true;
+    if (iter->second.add) {
+      // Track what the agent has, and leave out what it already has
+      if (agentRoutesKnown_) {
+        auto nexthops = nexthopSet(route.nextHopAddrs);
+        auto inserted = sentRoutes_.emplace(iter->first, SentRoute());
+        auto& sent = inserted.first->second;
+        sent.generation = generation_;
+        if (inserted.second) {
+          ++tableStats_[vrf].routes;
+        } else if (sent.nexthops == nexthops) {
+          send = false;
+        }
+        sent.nexthops = std::move(nexthops);
+      }
+      if (send) {
+        updates[vrf].toAdd.push_back(std::move(route));
+      }
+    } else {
+      if (agentRoutesKnown_) {
+        if (sentRoutes_.erase(iter->first) == 0) {
+          send = false;
+        } else {
+          --tableStats_[vrf].routes;
+        }
+      }
+      if (send) {
+        updates[vrf].toDelete.push_back(std::move(route.dest));
+      }
     }
-    default: {
-      VLOG(0) << "Not updating state due to unknown netlink operation "
-              << std::to_string(nlOperation);
-      break; /* NL_ACT_??? */
+    if (send) {
+      inflightRoutes_.insert(iter->first);
+      keys->push_back(iter->first);
     }
+    iter = pendingRoutes_.erase(iter);
   }
-  return;
+  if (keys->empty()) {
+    return progress;
+  }
+
+  auto client = getBatchClient();
+  auto batchStart = batchStart_;
+  auto failed = std::make_shared<bool>(false);
+  std::vector<folly::Future<folly::Unit>> sent;
+  for (auto& entry : updates) {
+    sendRouteUpdates(
+        client,
+        entry.first,
+        std::move(entry.second.toAdd),
+        std::move(entry.second.toDelete),
+        failed,
+        &sent);
+  }
+  ++inflightBatches_;
+  maxInflightBatches_ = std::max(maxInflightBatches_, inflightBatches_);
+  folly::collectAllSemiFuture(sent).toUnsafeFuture().then(
+      [this, keys, batchStart, failed]() {
+        routeBatchDone(*keys, batchStart, *failed);
+      });
+  return true;
 }
 
-void NetlinkManager::addRouteViaFbossThrift(
-    struct nl_addr* nlDst,
-    const std::vector<BinaryAddress>& nexthops) {
-  UnicastRoute unicastRoute;
-  unicastRoute.dest = nlAddrToIpPrefix(nlDst);
-  unicastRoute.nextHopAddrs = nexthops;
-  eb_->runInEventBaseThread([this, unicastRoute]() {
-    FbossClient fbossClient = getFbossClient(FLAGS_ip, FLAGS_fboss_port);
-    fbossClient->future_addUnicastRoute(FBOSS_CLIENT_ID, unicastRoute)
-        .then([]() { VLOG(2) << "NetlinkManager route add success"; })
-        .onError([unicastRoute](const std::exception& ex) {
-          BinaryAddress binaryDst = unicastRoute.dest.ip;
-          VLOG(2) << folly::sformat(
-              "Route add failed for destination {}. Error sending thrift calls to FBOSS agent: {}",
-              binAddrToStr(binaryDst),
+void NetlinkManager::sendRouteUpdates(
+    FbossCtrlAsyncClient* client,
+    int32_t vrf,
+    std::vector<UnicastRoute> toAdd,
+    std::vector<IpPrefix> toDelete,
+    std::shared_ptr<bool> failed,
+    std::vector<folly::Future<folly::Unit>>* sent) {
+  // Without --route_tables, stick to the calls every agent has
+  bool inVrf = !tableVrfs_.empty();
+  if (!toDelete.empty()) {
+    auto numDeletes = toDelete.size();
+    auto deleted = inVrf
+        ? client->future_deleteUnicastRoutesInVrf(
+              FBOSS_CLIENT_ID, vrf, std::move(toDelete))
+        : client->future_deleteUnicastRoutes(
+              FBOSS_CLIENT_ID, std::move(toDelete));
+    sent->push_back(std::move(deleted).onError(
+        [failed, numDeletes, vrf](const std::exception& ex) {
+          *failed = true;
+          VLOG(0) << folly::sformat(
+              "Failed to delete {} routes in VRF {} from FBOSS agent: {}",
+              numDeletes,
+              vrf,
               ex.what());
-        });
-  });
-}
-
-void NetlinkManager::deleteRouteViaFbossThrift(struct nl_addr* nlDst) {
-  IpPrefix prefix = nlAddrToIpPrefix(nlDst);
-
-  eb_->runInEventBaseThread([this, prefix]() {
-    FbossClient fbossClient = getFbossClient(FLAGS_ip, FLAGS_fboss_port);
-    fbossClient->future_deleteUnicastRoute(FBOSS_CLIENT_ID, prefix)
-        .then([]() { VLOG(2) << "NetlinkManager route delete success"; })
-        .onError([prefix](const std::exception& ex) {
-          BinaryAddress binaryDst = prefix.ip;
-          VLOG(2) << folly::sformat(
-              "Route delete failed for destination {}. Error sending thrift calls to FBOSS agent: {}",
-              binAddrToStr(binaryDst),
+        }));
+  }
+  if (!toAdd.empty()) {
+    auto numAdds = toAdd.size();
+    auto added = inVrf
+        ? client->future_addUnicastRoutesInVrf(
+              FBOSS_CLIENT_ID, vrf, std::move(toAdd))
+        : client->future_addUnicastRoutes(FBOSS_CLIENT_ID, std::move(toAdd));
+    sent->push_back(std::move(added).onError(
+        [failed, numAdds, vrf](const std::exception& ex) {
+          *failed = true;
+          VLOG(0) << folly::sformat(
+              "Failed to add {} routes in VRF {} to FBOSS agent: {}",
+              numAdds,
+              vrf,
               ex.what());
-        });
-  });
+        }));
+  }
+}
+
+void NetlinkManager::routeBatchDone(
+    const std::vector<RouteKey>& keys,
+    std::chrono::steady_clock::time_point batchStart,
+    bool failed) {
+  --inflightBatches_;
+  for (const auto& key : keys) {
+    inflightRoutes_.erase(key);
+  }
+  auto batchSize = keys.size();
+  // From the first update of the batch coming in, to the agent having
+  // applied all of them
+  auto latencyMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+                       std::chrono::steady_clock::now() - batchStart)
+                       .count();
+  ++routeBatches_;
+  if (failed) {
+    // Some of the batch may not have made it, so resync from what the agent
+    // really has
+    ++routeBatchFailures_;
+    batchClientFailed_ = true;
+    agentRoutesKnown_ = false;
+    scheduleResync();
+  }
+  maxRouteBatchSize_ =
+      std::max(maxRouteBatchSize_, static_cast<int64_t>(batchSize));
+  maxRouteBatchLatencyMs_ = std::max(maxRouteBatchLatencyMs_, latencyMs);
+  VLOG(2) << "Sent a batch of " << batchSize << " route updates in "
+          << latencyMs << "ms";
+
+  fbData->setCounter("netlink_manager.route_batches", routeBatches_);
+  fbData->setCounter(
+      "netlink_manager.route_batch_failures", routeBatchFailures_);
+  fbData->setCounter("netlink_manager.routes_coalesced", routesCoalesced_);
+  fbData->setCounter("netlink_manager.route_batch_size.last", batchSize);
+  fbData->setCounter(
+      "netlink_manager.route_batch_size.max", maxRouteBatchSize_);
+  fbData->setCounter("netlink_manager.route_batch_latency_ms.last", latencyMs);
+  fbData->setCounter(
+      "netlink_manager.route_batch_latency_ms.max", maxRouteBatchLatencyMs_);
+  fbData->setCounter(
+      "netlink_manager.route_batches_inflight.max", maxInflightBatches_);
+
+  // What was held back for this batch, or for a free slot
+  if (!flushScheduled_) {
+    flushRouteUpdates();
+  }
 }
 } // namespace fboss
 } // namespace facebook
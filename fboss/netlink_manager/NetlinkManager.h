@@ -5,9 +5,15 @@ extern "C" {
 #include <netlink/socket.h>
 }
 
+#include <folly/IPAddress.h>
+#include <chrono>
+#include <map>
 #include <mutex>
+#include <set>
 #include <string>
-#include "NetlinkPoller.h"
+#include <utility>
+#include <vector>
+#include "NetlinkRouteListener.h"
 #include "NlResources.h"
 #include "fboss/agent/if/gen-cpp2/FbossCtrl.h"
 #include "fboss/netlink_manager/utils/AddressUtils.h"
@@ -32,51 +38,115 @@ class NetlinkManager {
   static void checkError(int errCode, std::string messages);
 
  private:
+  // A route as the agent has it: the VRF and the prefix
+  using RouteKey = std::pair<int32_t, folly::CIDRNetwork>;
+
   void setMonitoredInterfaces();
+  // Fill tableVrfs_ and tableStats_ from --route_tables
+  void setRouteTables();
   std::set<std::string> getFbossInterfaces();
   std::set<std::string> parseInterfacesArg(std::string interfacesStr);
-  void registerWNetlink();
   FbossClient getFbossClient(
       const std::string& ip,
       const int& port);
   void startListening();
   void testFbossClient();
   void callSyncFib();
-  static void netlinkRouteUpdated(
-      struct nl_cache* cache, // Route cache
-      struct nl_object* obj, // New route object
-      int nlOperation, // Type of operation (new, delete etc)
-      void* data); // NetlinkManager itself
-  inline std::string nlOperationToStr(int nlOperation) {
-    switch (nlOperation) {
-      case NL_ACT_UNSPEC:
-        return "UNSPECIFIED";
-      case NL_ACT_NEW:
-        return "NEW";
-      case NL_ACT_DEL:
-        return "DELETE";
-      case NL_ACT_CHANGE:
-        return "CHANGE";
-      case NL_ACT_SET:
-        return "SET";
-      case NL_ACT_GET:
-        return "GET";
-      default:
-        return "unknown";
-    }
-  }
-  void addRouteViaFbossThrift(
-      struct nl_addr* nlDst,
-      const std::vector<BinaryAddress>& nexthops);
-  void deleteRouteViaFbossThrift(struct nl_addr* nlDst);
+  void setAgentRoutes(int32_t vrf, const std::vector<UnicastRoute>& routes);
+  // The VRFs we put routes into
+  std::vector<int32_t> getVrfs() const;
+  int32_t getVrf(uint32_t table) const;
+  FbossCtrlAsyncClient* getBatchClient();
+  void routeUpdated(NetlinkRouteListener::RouteUpdate update);
+  void routesResynced(std::vector<NetlinkRouteListener::RouteUpdate> routes);
+  // Queue just what differs between the kernel's routes and what the agent
+  // has from us
+  void diffRoutes(std::vector<NetlinkRouteListener::RouteUpdate> routes);
+  void scheduleResync();
+  std::vector<BinaryAddress> getGateways(
+      const NetlinkRouteListener::RouteUpdate& update);
+  // Route updates are collected for --route_batch_window_ms and sent to the
+  // agent in batches.  Only the last update for each prefix is sent, so a
+  // prefix added and deleted within the window costs a single delete.
+  void queueRouteUpdate(
+      const RouteKey& key,
+      std::vector<BinaryAddress> nexthops,
+      bool add);
+  void flushRouteUpdates();
+  // Send one batch of up to --route_batch_max_size pending updates.  False
+  // if none of them could go out yet.
+  bool sendRouteBatch();
+  void sendRouteUpdates(
+      FbossCtrlAsyncClient* client,
+      int32_t vrf,
+      std::vector<UnicastRoute> toAdd,
+      std::vector<IpPrefix> toDelete,
+      std::shared_ptr<bool> failed,
+      std::vector<folly::Future<folly::Unit>>* sent);
+  void routeBatchDone(
+      const std::vector<RouteKey>& keys,
+      std::chrono::steady_clock::time_point batchStart,
+      bool failed);
+  // Publish the per table counters, and again every kTableStatsIntervalMs
+  void publishTableStats();
   void logAndDie(const char* msg);
   void terminateEventBase();
 
   std::set<std::string> monitoredInterfaces_;
   folly::EventBase* eb_;
-  std::unique_ptr<NetlinkPoller> poller_{nullptr};
+  std::unique_ptr<NetlinkRouteListener> listener_{nullptr};
   std::unique_ptr<NlResources> nlResources_{nullptr};
   std::mutex interfacesMutex_;
+
+  // The kernel tables we mirror and the VRF each goes into.  Empty mirrors
+  // all tables into VRF 0, for agents without the VRF calls.
+  std::map<uint32_t, int32_t> tableVrfs_;
+
+  // Only touched on the eb_ thread, which runs the netlink callbacks, the
+  // flush timer and the thrift callbacks
+  struct PendingRoute {
+    UnicastRoute route;
+    bool add{false};
+  };
+  std::map<RouteKey, PendingRoute> pendingRoutes_;
+  std::chrono::steady_clock::time_point batchStart_;
+  bool flushScheduled_{false};
+  FbossClient batchClient_{nullptr};
+  bool batchClientFailed_{false};
+  // Batches sent and not answered yet, and the routes in them
+  int32_t inflightBatches_{0};
+  std::set<RouteKey> inflightRoutes_;
+  int64_t routeBatches_{0};
+  int64_t routesCoalesced_{0};
+  int64_t routeBatchFailures_{0};
+  int64_t maxRouteBatchSize_{0};
+  int64_t maxRouteBatchLatencyMs_{0};
+  int32_t maxInflightBatches_{0};
+  int64_t routeResyncs_{0};
+
+  // The routes the agent has from us, as far as we know.  Each resync bumps
+  // generation_ and marks the routes still in the kernel with it.
+  struct SentRoute {
+    std::set<std::string> nexthops;
+    uint64_t generation{0};
+  };
+  std::map<RouteKey, SentRoute> sentRoutes_;
+  uint64_t generation_{0};
+  // False after a failed call, until the agent is asked again
+  bool agentRoutesKnown_{false};
+  bool resyncScheduled_{false};
+
+  // By VRF, since tables and VRFs map one to one
+  struct TableStats {
+    // What the counter names start with
+    std::string name;
+    // Routes the agent has from the table
+    int64_t routes{0};
+    // Route updates read from netlink, not counting dumps
+    int64_t events{0};
+    int64_t eventsPublished{0};
+  };
+  std::map<int32_t, TableStats> tableStats_;
 };
 } // namespace fboss
 } // namespace facebook
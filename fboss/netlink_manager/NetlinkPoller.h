@@ -1,8 +1,5 @@
-extern "C" {
-#include <netlink/cache.h>
-}
-
 #include <folly/io/async/EventHandler.h>
+#include <functional>
 
 namespace folly {
 class EventBase;
@@ -18,11 +15,14 @@ namespace fboss {
 
 class NetlinkPoller : public folly::EventHandler {
  public:
-  NetlinkPoller(folly::EventBase* eb, int fd, struct nl_cache_mngr* manager);
+  NetlinkPoller(
+      folly::EventBase* eb,
+      int fd,
+      std::function<void()> onReadable);
   void handlerReady(uint16_t events) noexcept override;
 
  private:
-  struct nl_cache_mngr* manager_;
+  std::function<void()> onReadable_;
 };
 
 } // namespace fboss
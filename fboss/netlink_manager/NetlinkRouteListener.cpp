@@ -0,0 +1,324 @@
+#include "NetlinkRouteListener.h"
+
+extern "C" {
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <sys/socket.h>
+#include <unistd.h>
+}
+
+#include <gflags/gflags.h>
+#include <cerrno>
+#include <cstring>
+#include "NetlinkManagerException.h"
+#include "folly/Format.h"
+#include "folly/io/async/EventBase.h"
+
+DEFINE_int32(
+    netlink_rcvbuf_bytes,
+    64 << 20,
+    "Receive buffer size of the netlink route socket. A full table pushed "
+    "into the kernel at once needs a large buffer to avoid resyncs");
+
+namespace {
+// Large enough for any single netlink datagram, even from a dump
+constexpr size_t kRecvBufferSize = 64 << 10;
+
+void throwErrno(const char* what) {
+  throw facebook::fboss::NetlinkManagerException(
+      folly::sformat("{}: {}", what, strerror(errno)));
+}
+} // namespace
+
+namespace facebook {
+namespace fboss {
+
+NetlinkRouteListener::NetlinkRouteListener(
+    folly::EventBase* eb,
+    std::set<uint32_t> tables,
+    UpdateCallback onUpdate,
+    ResyncCallback onResync)
+    : eb_(eb),
+      tables_(std::move(tables)),
+      onUpdate_(std::move(onUpdate)),
+      onResync_(std::move(onResync)),
+      buffer_(kRecvBufferSize) {}
+
+NetlinkRouteListener::~NetlinkRouteListener() {
+  poller_.reset();
+  if (fd_ >= 0) {
+    close(fd_);
+  }
+}
+
+void NetlinkRouteListener::start() {
+  openSocket();
+  poller_ =
+      std::make_unique<NetlinkPoller>(eb_, fd_, [this]() { readMessages(); });
+  requestDump();
+}
+
+void NetlinkRouteListener::openSocket() {
+  fd_ = socket(
+      AF_NETLINK, SOCK_RAW | SOCK_NONBLOCK | SOCK_CLOEXEC, NETLINK_ROUTE);
+  if (fd_ < 0) {
+    throwErrno("Opening netlink route socket failed");
+  }
+  // SO_RCVBUFFORCE goes past net.core.rmem_max, but needs CAP_NET_ADMIN
+  int rcvbuf = FLAGS_netlink_rcvbuf_bytes;
+  if (setsockopt(
+          fd_, SOL_SOCKET, SO_RCVBUFFORCE, &rcvbuf, sizeof(rcvbuf)) < 0 &&
+      setsockopt(fd_, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf)) < 0) {
+    throwErrno("Setting netlink receive buffer size failed");
+  }
+
+  struct sockaddr_nl addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.nl_family = AF_NETLINK;
+  addr.nl_groups = RTMGRP_IPV4_ROUTE | RTMGRP_IPV6_ROUTE;
+  if (bind(fd_, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) <
+      0) {
+    throwErrno("Binding netlink route socket failed");
+  }
+  // The kernel picked our port id, which it addresses its replies to
+  socklen_t addrLen = sizeof(addr);
+  if (getsockname(
+          fd_, reinterpret_cast<struct sockaddr*>(&addr), &addrLen) < 0) {
+    throwErrno("Getting netlink route socket address failed");
+  }
+  portId_ = addr.nl_pid;
+  VLOG(1) << "Listening for route updates on netlink socket " << fd_;
+}
+
+void NetlinkRouteListener::requestDump() {
+  struct {
+    struct nlmsghdr hdr;
+    struct rtmsg rtm;
+  } req;
+  memset(&req, 0, sizeof(req));
+  req.hdr.nlmsg_len = NLMSG_LENGTH(sizeof(req.rtm));
+  req.hdr.nlmsg_type = RTM_GETROUTE;
+  req.hdr.nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP;
+  // Never 0, which is what the kernel uses for notifications
+  if (++seq_ == 0) {
+    ++seq_;
+  }
+  req.hdr.nlmsg_seq = seq_;
+  req.rtm.rtm_family = AF_UNSPEC;
+
+  // Routes of an earlier dump cut short are not complete, so start over
+  dumpSeq_ = seq_;
+  dumpRoutes_.clear();
+
+  struct sockaddr_nl kernel;
+  memset(&kernel, 0, sizeof(kernel));
+  kernel.nl_family = AF_NETLINK;
+  if (sendto(
+          fd_,
+          &req,
+          req.hdr.nlmsg_len,
+          0,
+          reinterpret_cast<struct sockaddr*>(&kernel),
+          sizeof(kernel)) < 0) {
+    throwErrno("Requesting netlink route dump failed");
+  }
+  VLOG(1) << "Requested netlink route dump " << dumpSeq_;
+}
+
+void NetlinkRouteListener::readMessages() {
+  while (true) {
+    auto len = recv(fd_, buffer_.data(), buffer_.size(), 0);
+    if (len < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      if (errno == EAGAIN || errno == EWOULDBLOCK) {
+        return;
+      }
+      if (errno == ENOBUFS) {
+        // The kernel dropped updates, so what we passed on is stale
+        ++overflows_;
+        VLOG(0) << "Netlink route socket overflowed, resyncing routes";
+        requestDump();
+        continue;
+      }
+      throwErrno("Reading netlink route socket failed");
+    }
+    int remaining = len;
+    for (auto hdr = reinterpret_cast<const struct nlmsghdr*>(buffer_.data());
+         NLMSG_OK(hdr, remaining);
+         hdr = NLMSG_NEXT(hdr, remaining)) {
+      handleMessage(hdr);
+    }
+  }
+}
+
+void NetlinkRouteListener::handleMessage(const struct nlmsghdr* hdr) {
+  // Notifications carry the port id of whoever made the change, so only the
+  // replies to our own requests, which are all dumps, carry ours
+  if (hdr->nlmsg_pid == portId_ && hdr->nlmsg_seq != 0 &&
+      hdr->nlmsg_seq != dumpSeq_) {
+    // What is left of a dump we restarted, or gave up on.  Its routes are
+    // older than the dump in progress, so they can't be taken as updates.
+    VLOG(2) << "Dropping netlink message of old route dump "
+            << hdr->nlmsg_seq;
+    return;
+  }
+  bool fromDump = dumpSeq_ != 0 && hdr->nlmsg_seq == dumpSeq_;
+  switch (hdr->nlmsg_type) {
+    case NLMSG_DONE: {
+      if (fromDump) {
+        dumpDone();
+      }
+      return;
+    }
+    case NLMSG_ERROR: {
+      if (fromDump) {
+        auto err = reinterpret_cast<const struct nlmsgerr*>(NLMSG_DATA(hdr));
+        VLOG(0) << "Netlink route dump failed: " << strerror(-err->error)
+                << ". Retrying";
+        requestDump();
+      }
+      return;
+    }
+    case RTM_NEWROUTE:
+    case RTM_DELROUTE:
+      break;
+    default:
+      return;
+  }
+
+  if (fromDump && (hdr->nlmsg_flags & NLM_F_DUMP_INTR)) {
+    // The table changed while it was being dumped
+    VLOG(1) << "Netlink route dump interrupted, restarting it";
+    requestDump();
+    return;
+  }
+
+  RouteUpdate update;
+  if (!parseRoute(hdr, &update)) {
+    return;
+  }
+  if (fromDump) {
+    dumpRoutes_.push_back(std::move(update));
+  } else if (dumpSeq_ != 0) {
+    updatesDuringDump_.push_back(std::move(update));
+  } else {
+    onUpdate_(std::move(update));
+  }
+}
+
+void NetlinkRouteListener::dumpDone() {
+  VLOG(1) << "Netlink route dump " << dumpSeq_ << " found "
+          << dumpRoutes_.size() << " routes";
+  dumpSeq_ = 0;
+  auto updates = std::move(updatesDuringDump_);
+  updatesDuringDump_.clear();
+  onResync_(std::move(dumpRoutes_));
+  dumpRoutes_.clear();
+  for (auto& update : updates) {
+    onUpdate_(std::move(update));
+  }
+}
+
+bool NetlinkRouteListener::parseRoute(
+    const struct nlmsghdr* hdr,
+    RouteUpdate* update) {
+  if (hdr->nlmsg_len < NLMSG_LENGTH(sizeof(struct rtmsg))) {
+    return false;
+  }
+  auto rtm = reinterpret_cast<const struct rtmsg*>(NLMSG_DATA(hdr));
+  if (rtm->rtm_type != RTN_UNICAST) {
+    return false;
+  }
+  // rtm_table only has 8 bits.  The kernel sets it to RT_TABLE_COMPAT for
+  // the tables past those, and only then do we need to find RTA_TABLE.
+  uint32_t table = rtm->rtm_table;
+  if (table == RT_TABLE_COMPAT) {
+    int len = RTM_PAYLOAD(hdr);
+    for (auto rta = RTM_RTA(rtm); RTA_OK(rta, len);
+         rta = RTA_NEXT(rta, len)) {
+      if (rta->rta_type == RTA_TABLE &&
+          static_cast<size_t>(RTA_PAYLOAD(rta)) >= sizeof(table)) {
+        memcpy(&table, RTA_DATA(rta), sizeof(table));
+        break;
+      }
+    }
+  }
+  if (!tables_.empty() && tables_.find(table) == tables_.end()) {
+    ++filtered_;
+    return false;
+  }
+  size_t addrLen;
+  if (rtm->rtm_family == AF_INET) {
+    addrLen = 4;
+  } else if (rtm->rtm_family == AF_INET6) {
+    addrLen = 16;
+  } else {
+    return false;
+  }
+
+  auto addNextHop = [&](const struct rtattr* gateway, int ifindex) {
+    if (!gateway || static_cast<size_t>(RTA_PAYLOAD(gateway)) != addrLen) {
+      return;
+    }
+    NextHop nexthop;
+    nexthop.gateway.addr = folly::fbstring(
+        static_cast<const char*>(RTA_DATA(gateway)), addrLen);
+    nexthop.ifindex = ifindex;
+    update->nexthops.push_back(std::move(nexthop));
+  };
+
+  // No RTA_DST is the default route
+  uint8_t dst[16] = {};
+  const struct rtattr* gateway = nullptr;
+  int oif = 0;
+  int len = RTM_PAYLOAD(hdr);
+  for (auto rta = RTM_RTA(rtm); RTA_OK(rta, len); rta = RTA_NEXT(rta, len)) {
+    switch (rta->rta_type) {
+      case RTA_DST:
+        if (static_cast<size_t>(RTA_PAYLOAD(rta)) == addrLen) {
+          memcpy(dst, RTA_DATA(rta), addrLen);
+        }
+        break;
+      case RTA_GATEWAY:
+        gateway = rta;
+        break;
+      case RTA_OIF:
+        if (static_cast<size_t>(RTA_PAYLOAD(rta)) >= sizeof(int)) {
+          memcpy(&oif, RTA_DATA(rta), sizeof(int));
+        }
+        break;
+      case RTA_MULTIPATH: {
+        auto rtnh = static_cast<const struct rtnexthop*>(RTA_DATA(rta));
+        int remaining = RTA_PAYLOAD(rta);
+        while (RTNH_OK(rtnh, remaining)) {
+          const struct rtattr* nhGateway = nullptr;
+          int nhLen = rtnh->rtnh_len - RTNH_LENGTH(0);
+          for (auto nhAttr = RTNH_DATA(rtnh); RTA_OK(nhAttr, nhLen);
+               nhAttr = RTA_NEXT(nhAttr, nhLen)) {
+            if (nhAttr->rta_type == RTA_GATEWAY) {
+              nhGateway = nhAttr;
+            }
+          }
+          addNextHop(nhGateway, rtnh->rtnh_ifindex);
+          remaining -= RTNH_ALIGN(rtnh->rtnh_len);
+          rtnh = RTNH_NEXT(rtnh);
+        }
+        break;
+      }
+      default:
+        break;
+    }
+  }
+  addNextHop(gateway, oif);
+
+  update->add = hdr->nlmsg_type == RTM_NEWROUTE;
+  update->table = table;
+  update->network = std::make_pair(
+      folly::IPAddress::fromBinary(folly::ByteRange(dst, addrLen)),
+      rtm->rtm_dst_len);
+  return true;
+}
+} // namespace fboss
+} // namespace facebook
@@ -0,0 +1,118 @@
+#pragma once
+
+#include <folly/IPAddress.h>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <set>
+#include <vector>
+#include "NetlinkPoller.h"
+#include "fboss/netlink_manager/utils/AddressUtils.h"
+
+struct nlmsghdr;
+
+namespace folly {
+class EventBase;
+}
+namespace facebook {
+namespace fboss {
+
+/*
+ * NetlinkRouteListener reads RTM_NEWROUTE / RTM_DELROUTE messages straight
+ * off a NETLINK_ROUTE socket subscribed to the IPv4 and IPv6 route groups.
+ * Unlike the libnl cache manager, it keeps no copy of the kernel routing
+ * table, and parses each message in place into the few fields we send on.
+ *
+ * The socket has a large receive buffer, but a burst of updates can still
+ * overrun it.  The kernel then drops messages and reports ENOBUFS, which we
+ * leave on (no NETLINK_NO_ENOBUFS), since the dropped updates can not be
+ * recovered otherwise.  On ENOBUFS the listener dumps the routing table and
+ * hands the whole table to the resync callback.  The same happens once on
+ * start, so that routes already in the kernel are picked up.  A dump that
+ * is restarted may still have replies queued on the socket, which are
+ * dropped, as only the latest dump is current.
+ *
+ * The listener can be limited to some kernel routing tables.  Routes of the
+ * other tables are dropped from the rtmsg header, before any of their
+ * attributes are looked at, so busy tables nobody mirrors cost next to
+ * nothing.
+ *
+ * Everything runs on the thread of the EventBase given.
+ */
+class NetlinkRouteListener {
+ public:
+  struct NextHop {
+    BinaryAddress gateway;
+    int ifindex{0};
+  };
+  struct RouteUpdate {
+    bool add{false};
+    // The kernel routing table, e.g. RT_TABLE_MAIN
+    uint32_t table{0};
+    folly::CIDRNetwork network;
+    // Only the next hops with a gateway
+    std::vector<NextHop> nexthops;
+  };
+  using UpdateCallback = std::function<void(RouteUpdate)>;
+  using ResyncCallback = std::function<void(std::vector<RouteUpdate>)>;
+
+  // Only the routes of the tables given are passed on, or of all tables if
+  // there are none
+  NetlinkRouteListener(
+      folly::EventBase* eb,
+      std::set<uint32_t> tables,
+      UpdateCallback onUpdate,
+      ResyncCallback onResync);
+  ~NetlinkRouteListener();
+
+  void start();
+
+  // Dump the kernel table again, e.g. after the routes we passed on were
+  // lost downstream
+  void resync() {
+    requestDump();
+  }
+
+  uint64_t getOverflows() const {
+    return overflows_;
+  }
+
+  // Route messages of the tables we do not listen to
+  uint64_t getFiltered() const {
+    return filtered_;
+  }
+
+ private:
+  // Forbidden copy constructor and assignment operator
+  NetlinkRouteListener(NetlinkRouteListener const&) = delete;
+  NetlinkRouteListener& operator=(NetlinkRouteListener const&) = delete;
+
+  void openSocket();
+  void requestDump();
+  void readMessages();
+  void handleMessage(const struct nlmsghdr* hdr);
+  void dumpDone();
+  bool parseRoute(const struct nlmsghdr* hdr, RouteUpdate* update);
+
+  folly::EventBase* eb_;
+  std::set<uint32_t> tables_;
+  UpdateCallback onUpdate_;
+  ResyncCallback onResync_;
+  int fd_{-1};
+  // The port id the kernel bound the socket to
+  uint32_t portId_{0};
+  std::unique_ptr<NetlinkPoller> poller_;
+  std::vector<uint8_t> buffer_;
+
+  uint32_t seq_{0};
+  // The sequence number of the dump in progress, 0 if there is none
+  uint32_t dumpSeq_{0};
+  std::vector<RouteUpdate> dumpRoutes_;
+  // Updates that arrive during a dump, passed on after the resync, since
+  // the dump may or may not include them
+  std::vector<RouteUpdate> updatesDuringDump_;
+  uint64_t overflows_{0};
+  uint64_t filtered_{0};
+};
+} // namespace fboss
+} // namespace facebook
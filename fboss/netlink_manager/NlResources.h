@@ -12,9 +12,9 @@ struct NlResources {
   NlResources();
   ~NlResources();
 
-  struct nl_sock* sock; // pipe to RX/TX netlink messages
-  struct nl_cache* routeCache; // our copy of the system route state
-  struct nl_cache_mngr* manager; // wraps caches and notifies upon a change
+  // pipe to TX netlink messages.  Route updates are read from the kernel by
+  // NetlinkRouteListener on a socket of its own.
+  struct nl_sock* sock;
 };
 } // namespace fboss
 } // namespace facebook
@@ -0,0 +1,175 @@
+#include "fboss/pcap_distribution_service/PacketBatcher.h"
+
+#include <folly/io/Compression.h>
+#include <folly/io/async/EventBase.h>
+#include <thrift/lib/cpp2/protocol/Serializer.h>
+
+#include <algorithm>
+
+DEFINE_int32(pcap_batch_packets, 64,
+             "The most packets to send to the pcap distribution service, or "
+             "from it to a subscriber, in one call");
+DEFINE_int32(pcap_batch_ms, 10,
+             "How long to wait for a batch of packets to fill up before "
+             "sending what there is");
+DEFINE_bool(pcap_batch_compress, false,
+            "Compress the batches of packets with LZ4");
+DEFINE_int32(pcap_max_batches_in_flight, 2,
+             "How many batches of packets a receiver can have outstanding "
+             "before the rest queue up behind them");
+DEFINE_int32(pcap_max_queued_packets, 10000,
+             "How many packets can queue up for a receiver before the rest "
+             "are dropped");
+
+using apache::thrift::CompactSerializer;
+using folly::io::CodecType;
+
+namespace {
+
+// The uncompressed length goes at the start, so the receiver doesn't need
+// to be told it separately
+constexpr auto kCodec = CodecType::LZ4_VARINT_SIZE;
+
+size_t batchSize() {
+  return std::max(FLAGS_pcap_batch_packets, 1);
+}
+
+}
+
+namespace facebook { namespace fboss {
+
+PacketBatcher::PacketBatcher(folly::EventBase* evb, Send send)
+    : AsyncTimeout(evb),
+      evb_(evb),
+      send_(std::move(send)) {}
+
+PacketBatcher::~PacketBatcher() {
+  evb_->runImmediatelyOrRunInEventBaseThreadAndWait([this]() {
+    cancelTimeout();
+  });
+}
+
+void PacketBatcher::addPacket(CapturedPacket pkt) {
+  bool flushNow = false;
+  bool schedule = false;
+  {
+    std::lock_guard<std::mutex> g(lock_);
+    if (pending_.size() >= size_t(std::max(FLAGS_pcap_max_queued_packets, 1))) {
+      ++unreportedDrops_;
+      dropped_.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+    pending_.push_back(std::move(pkt));
+    if (pending_.size() == batchSize()) {
+      flushNow = true;
+    } else if (!scheduled_) {
+      schedule = true;
+      scheduled_ = true;
+    }
+  }
+  if (!flushNow && !schedule) {
+    return;
+  }
+
+  std::weak_ptr<PacketBatcher> self = shared_from_this();
+  if (flushNow) {
+    evb_->runInEventBaseThread([self]() {
+      if (auto batcher = self.lock()) {
+        batcher->flush();
+      }
+    });
+  } else if (schedule) {
+    evb_->runInEventBaseThread([self]() {
+      if (auto batcher = self.lock()) {
+        batcher->scheduleTimeout(FLAGS_pcap_batch_ms);
+      }
+    });
+  }
+}
+
+void PacketBatcher::timeoutExpired() noexcept {
+  {
+    std::lock_guard<std::mutex> g(lock_);
+    scheduled_ = false;
+  }
+  flush();
+}
+
+void PacketBatcher::flush() {
+  while (inFlight_ < size_t(std::max(FLAGS_pcap_max_batches_in_flight, 1))) {
+    PacketBatch batch;
+    {
+      std::lock_guard<std::mutex> g(lock_);
+      if (pending_.empty()) {
+        return;
+      }
+      auto count = std::min(pending_.size(), batchSize());
+      if (count == pending_.size()) {
+        batch.packets.swap(pending_);
+      } else {
+        batch.packets.assign(
+            std::make_move_iterator(pending_.begin()),
+            std::make_move_iterator(pending_.begin() + count));
+        pending_.erase(pending_.begin(), pending_.begin() + count);
+      }
+      batch.dropped = unreportedDrops_;
+      unreportedDrops_ = 0;
+    }
+    send(std::move(batch));
+  }
+  // Whatever is left goes out as the batches in flight are acknowledged
+}
+
+void PacketBatcher::send(PacketBatch batch) {
+  auto numPackets = batch.packets.size();
+  if (FLAGS_pcap_batch_compress) {
+    compress(&batch);
+  }
+  ++inFlight_;
+  std::weak_ptr<PacketBatcher> self = shared_from_this();
+  folly::makeFutureWith([&]() { return send_(batch); })
+      .then(evb_, [self, numPackets](folly::Try<folly::Unit>&& result) {
+        if (auto batcher = self.lock()) {
+          batcher->sent(numPackets, !result.hasException());
+        }
+      });
+}
+
+void PacketBatcher::sent(size_t numPackets, bool success) {
+  --inFlight_;
+  if (success) {
+    sent_.fetch_add(numPackets, std::memory_order_relaxed);
+  } else {
+    failed_.fetch_add(numPackets, std::memory_order_relaxed);
+  }
+  flush();
+}
+
+void PacketBatcher::compress(PacketBatch* batch) {
+  if (batch->compressed || !folly::io::hasCodec(kCodec)) {
+    return;
+  }
+  PacketBatch packets;
+  packets.packets.swap(batch->packets);
+  folly::IOBufQueue serialized(folly::IOBufQueue::cacheChainLength());
+  CompactSerializer::serialize(packets, &serialized);
+  auto compressed = folly::io::getCodec(kCodec)->compress(
+      serialized.front());
+  batch->compressedPackets = compressed->moveToFbString();
+  batch->compressed = true;
+}
+
+std::vector<CapturedPacket> PacketBatcher::takePackets(PacketBatch* batch) {
+  if (!batch->compressed) {
+    return std::move(batch->packets);
+  }
+  auto compressed = folly::IOBuf::wrapBuffer(
+      batch->compressedPackets.data(), batch->compressedPackets.size());
+  auto uncompressed = folly::io::getCodec(kCodec)->uncompress(
+      compressed.get());
+  PacketBatch packets;
+  CompactSerializer::deserialize(uncompressed.get(), packets);
+  return std::move(packets.packets);
+}
+
+}}
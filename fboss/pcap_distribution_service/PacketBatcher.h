@@ -0,0 +1,94 @@
+#pragma once
+
+#include "fboss/pcap_distribution_service/if/gen-cpp2/pcap_pubsub_types.h"
+
+#include <folly/futures/Future.h>
+#include <folly/io/async/AsyncTimeout.h>
+#include <gflags/gflags.h>
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+DECLARE_int32(pcap_batch_packets);
+DECLARE_int32(pcap_batch_ms);
+DECLARE_bool(pcap_batch_compress);
+DECLARE_int32(pcap_max_batches_in_flight);
+DECLARE_int32(pcap_max_queued_packets);
+
+namespace facebook { namespace fboss {
+
+/*
+ * Queues up the packets for one receiver, and sends them to it in batches
+ * of pcap_batch_packets, or whatever has been queued for pcap_batch_ms.
+ *
+ * Only pcap_max_batches_in_flight batches are outstanding at once, and the
+ * packets queued behind them are limited to pcap_max_queued_packets.  Past
+ * that new packets are dropped and counted, and the receiver is told how
+ * many it missed in the next batch, so a slow receiver never backs up the
+ * thread sending to it.
+ *
+ * Batches are sent from the EventBase's thread.  The batcher is owned
+ * through a shared_ptr, so that replies to batches still in flight can tell
+ * if it has gone.
+ */
+class PacketBatcher : private folly::AsyncTimeout,
+                      public std::enable_shared_from_this<PacketBatcher> {
+ public:
+  using Send = std::function<folly::Future<folly::Unit>(const PacketBatch&)>;
+
+  PacketBatcher(folly::EventBase* evb, Send send);
+  ~PacketBatcher() override;
+
+  /*
+   * Queue a packet to send.  Can be called from any thread, and never
+   * blocks.
+   */
+  void addPacket(CapturedPacket pkt);
+
+  uint64_t getSent() const {
+    return sent_.load(std::memory_order_relaxed);
+  }
+  uint64_t getDropped() const {
+    return dropped_.load(std::memory_order_relaxed);
+  }
+  // Packets in batches the receiver failed to take
+  uint64_t getFailed() const {
+    return failed_.load(std::memory_order_relaxed);
+  }
+
+  /*
+   * Compress the packets of a batch, if LZ4 is available.
+   */
+  static void compress(PacketBatch* batch);
+  /*
+   * Take the packets out of a batch, compressed or not.
+   */
+  static std::vector<CapturedPacket> takePackets(PacketBatch* batch);
+
+ private:
+  void timeoutExpired() noexcept override;
+
+  void flush();
+  void send(PacketBatch batch);
+  void sent(size_t numPackets, bool success);
+
+  folly::EventBase* evb_{nullptr};
+  Send send_;
+
+  std::mutex lock_;
+  std::vector<CapturedPacket> pending_;
+  uint64_t unreportedDrops_{0};
+  bool scheduled_{false};
+
+  // Only used in the EventBase's thread
+  size_t inFlight_{0};
+
+  std::atomic<uint64_t> sent_{0};
+  std::atomic<uint64_t> dropped_{0};
+  std::atomic<uint64_t> failed_{0};
+};
+
+}}
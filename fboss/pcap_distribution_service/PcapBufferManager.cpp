@@ -2,13 +2,18 @@
 
 #include "fboss/pcap_distribution_service/if/gen-cpp2/pcap_pubsub_types.h"
 
+#include <chrono>
+#include <tuple>
+
 namespace facebook { namespace fboss {
 
 uint16_t PcapBufferManager::UNKNOWN = 0xFFFF;
 
 PcapBufferManager::PcapBufferManager() {
   for(auto e : PcapBufferManager::getEthertypes()){
-    buffers_[e] = PcapCircularBuffer();
+    buffers_.emplace(std::piecewise_construct,
+                     std::forward_as_tuple(e),
+                     std::forward_as_tuple());
   }
 }
 
@@ -28,30 +33,51 @@ void PcapBufferManager::addPkt(PcapPkt&& pkt, uint16_t ethertype) {
 void PcapBufferManager::dumpPackets(
     std::vector<CapturedPacket>& out,
     uint16_t ethertype) {
-  auto buf = buffers_[ethertype].release();
-  for (int i = 0; i < buf.size(); i++) {
+  auto it = buffers_.find(ethertype);
+  if (it != buffers_.end()) {
+    appendPackets(out, it->second.release());
+  }
+}
+
+void PcapBufferManager::dumpPacketsSince(
+    std::vector<CapturedPacket>& out,
+    uint16_t ethertype,
+    PcapPkt::TimePoint timestamp) {
+  auto it = buffers_.find(ethertype);
+  if (it != buffers_.end()) {
+    appendPackets(out, it->second.getPacketsSince(timestamp));
+  }
+}
+
+void PcapBufferManager::appendPackets(
+    std::vector<CapturedPacket>& out,
+    const PcapCircularBuffer::Packets& pkts) {
+  out.reserve(out.size() + pkts.size());
+  pkts.forEach([&](const PcapPkt& pkt) {
     CapturedPacket p;
-    p.rx = buf[i].isRx();
+    p.rx = pkt.isRx();
+    p.timestampUsec = std::chrono::duration_cast<std::chrono::microseconds>(
+        pkt.timestamp().time_since_epoch()).count();
 
     PacketData data;
     folly::IOBuf packetData;
 
     if (p.rx) {
       RxPacketData r;
-      r.srcPort = buf[i].port();
-      r.srcVlan = buf[i].vlan();
-      buf[i].buf()->cloneInto(packetData);
+      r.srcPort = pkt.port();
+      r.srcVlan = pkt.vlan();
+      pkt.buf()->cloneInto(packetData);
       r.packetData = packetData.moveToFbString();
-      r.reasons = buf[i].getReasons();
+      r.reasons = pkt.getReasons();
       data.set_rxpkt(r);
     } else {
       TxPacketData t;
-      buf[i].buf()->cloneInto(packetData);
+      pkt.buf()->cloneInto(packetData);
       t.packetData = packetData.moveToFbString();
       data.set_txpkt(t);
     }
     p.pkt = data;
     out.emplace_back(std::move(p));
-  }
+  });
 }
 }}
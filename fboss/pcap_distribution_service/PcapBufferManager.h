@@ -21,6 +21,10 @@ class PcapBufferManager {
   PcapBufferManager();
   void addPkt(PcapPkt&& pkt, uint16_t ethertype);
   void dumpPackets(std::vector<CapturedPacket>& out, uint16_t ethertype);
+  void dumpPacketsSince(
+      std::vector<CapturedPacket>& out,
+      uint16_t ethertype,
+      PcapPkt::TimePoint timestamp);
   static uint16_t UNKNOWN;
   static const std::vector<uint16_t>& getEthertypes() {
     static const std::vector<uint16_t> ethertypes = {
@@ -33,6 +37,11 @@ class PcapBufferManager {
   }
 
  private:
+  void appendPackets(
+      std::vector<CapturedPacket>& out,
+      const PcapCircularBuffer::Packets& pkts);
+
+  // Only created by the constructor, so it can be read from any thread
   std::map<uint16_t, PcapCircularBuffer> buffers_;
 };
 }
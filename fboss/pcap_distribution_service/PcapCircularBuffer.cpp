@@ -0,0 +1,110 @@
+#include "fboss/pcap_distribution_service/PcapCircularBuffer.h"
+
+#include <algorithm>
+
+namespace facebook { namespace fboss {
+
+constexpr size_t PcapCircularBuffer::kSegmentSize;
+
+size_t PcapCircularBuffer::Packets::size() const {
+  size_t count = 0;
+  for (const auto& range : ranges_) {
+    count += range.segment->size() - range.begin;
+  }
+  return count;
+}
+
+size_t PcapCircularBuffer::State::segmentSize() const {
+  return std::max<size_t>(std::min(capacity, kSegmentSize), 1);
+}
+
+void PcapCircularBuffer::State::dropOldest() {
+  if (sealed.empty()) {
+    head->erase(head->begin());
+  } else if (++sealed.front().begin == sealed.front().segment->size()) {
+    sealed.pop_front();
+  }
+  --size;
+}
+
+void PcapCircularBuffer::addPkt(PcapPkt pkt) {
+  auto state = state_.wlock();
+  if (state->head && state->head->size() >= state->segmentSize()) {
+    Packets::Range range;
+    range.segment = std::move(state->head);
+    state->sealed.push_back(std::move(range));
+  }
+  if (!state->head) {
+    state->head = std::make_shared<Segment>();
+    state->head->reserve(state->segmentSize());
+  }
+  state->head->push_back(std::move(pkt));
+  ++state->size;
+  while (state->size > state->capacity) {
+    state->dropOldest();
+  }
+}
+
+void PcapCircularBuffer::resize(int n) {
+  auto state = state_.wlock();
+  state->capacity = std::max(n, 0);
+  while (state->size > state->capacity) {
+    state->dropOldest();
+  }
+}
+
+PcapCircularBuffer::Packets PcapCircularBuffer::release() {
+  State old;
+  {
+    auto state = state_.wlock();
+    old.capacity = state->capacity;
+    std::swap(*state, old);
+  }
+
+  Packets pkts;
+  pkts.ranges_.assign(old.sealed.begin(), old.sealed.end());
+  if (old.head && !old.head->empty()) {
+    Packets::Range range;
+    range.segment = std::move(old.head);
+    pkts.ranges_.push_back(std::move(range));
+  }
+  return pkts;
+}
+
+PcapCircularBuffer::Packets PcapCircularBuffer::getPacketsSince(
+    PcapPkt::TimePoint timestamp) {
+  auto before = [](const PcapPkt& pkt, PcapPkt::TimePoint ts) {
+    return pkt.timestamp() < ts;
+  };
+
+  Packets pkts;
+  auto state = state_.rlock();
+  // The first segment with any packets at or after the timestamp
+  auto it = std::lower_bound(
+      state->sealed.begin(), state->sealed.end(), timestamp,
+      [](const Packets::Range& range, PcapPkt::TimePoint ts) {
+        return range.segment->back().timestamp() < ts;
+      });
+  for (; it != state->sealed.end(); ++it) {
+    auto range = *it;
+    auto first = std::lower_bound(
+        range.segment->begin() + range.begin, range.segment->end(),
+        timestamp, before);
+    range.begin = first - range.segment->begin();
+    pkts.ranges_.push_back(std::move(range));
+  }
+
+  // The head is still being added to, so it has to be copied
+  if (state->head) {
+    auto first = std::lower_bound(
+        state->head->begin(), state->head->end(), timestamp, before);
+    if (first != state->head->end()) {
+      Packets::Range range;
+      range.segment = std::make_shared<Segment>(first, state->head->end());
+      pkts.ranges_.push_back(std::move(range));
+    }
+  }
+  return pkts;
+}
+
+}}
@@ -1,47 +1,101 @@
 #pragma once
 
-#include <boost/circular_buffer.hpp>
-
 #include "fboss/agent/capture/PcapPkt.h"
 
 #include "folly/Synchronized.h"
 
+#include <algorithm>
+#include <deque>
 #include <memory>
 #include <mutex>
+#include <vector>
 
 namespace facebook { namespace fboss {
 
+/*
+ * A ring of the most recent packets of one type.
+ *
+ * The packets are kept in segments of up to kSegmentSize, oldest first.
+ * Once a segment is full it is never changed again, so the packets can be
+ * handed out by sharing the segments rather than copying each packet, and
+ * only the segment still being filled is ever copied.  The packets are
+ * added in the order they were captured, so the segments are in time order
+ * too and can be searched by timestamp.
+ */
 class PcapCircularBuffer {
  public:
-  explicit PcapCircularBuffer(int n = 100)
-      : buf_(boost::circular_buffer<PcapPkt>(n)) {}
+  static constexpr size_t kSegmentSize = 256;
 
-  void addPkt(PcapPkt pkt) {
-    buf_.wlock()->push_back(std::move(pkt));
-  }
+  using Segment = std::vector<PcapPkt>;
+
+  /*
+   * Packets from a buffer, sharing its segments.
+   */
+  class Packets {
+   public:
+    size_t size() const;
+    bool empty() const {
+      return ranges_.empty();
+    }
+
+    template<typename Fn>
+    void forEach(const Fn& fn) const {
+      for (const auto& range : ranges_) {
+        for (auto idx = range.begin; idx < range.segment->size(); ++idx) {
+          fn((*range.segment)[idx]);
+        }
+      }
+    }
+
+    struct Range {
+      std::shared_ptr<const Segment> segment;
+      size_t begin{0};
+    };
+
+   private:
+    friend class PcapCircularBuffer;
 
-  void resize(int n) {
-    buf_.wlock()->set_capacity(n);
+    std::vector<Range> ranges_;
+  };
+
+  explicit PcapCircularBuffer(int n = 100) {
+    state_.wlock()->capacity = std::max(n, 0);
   }
 
+  void addPkt(PcapPkt pkt);
+  void resize(int n);
+
   int size() {
-    return buf_.rlock()->size();
+    return state_.rlock()->size;
   }
 
   int capacity() {
-    return buf_.rlock()->capacity();
+    return state_.rlock()->capacity;
   }
 
   // release the buffer to a user to dump, and swap in
   // a new buffer
-  boost::circular_buffer<PcapPkt> release() {
-    return buf_.copy();
-  }
+  Packets release();
 
-  // can add new functions, such as get after timestamp
+  /*
+   * The packets captured at or after timestamp, leaving them in the buffer.
+   */
+  Packets getPacketsSince(PcapPkt::TimePoint timestamp);
 
  private:
-  folly::Synchronized<boost::circular_buffer<PcapPkt>> buf_;
+  struct State {
+    // The full segments, with the packets before begin already dropped
+    std::deque<Packets::Range> sealed;
+    // The segment being filled
+    std::shared_ptr<Segment> head;
+    size_t size{0};
+    size_t capacity{0};
+
+    size_t segmentSize() const;
+    void dropOldest();
+  };
+
+  folly::Synchronized<State> state_;
 };
 
 }}
@@ -1,6 +1,8 @@
 #include "fboss/pcap_distribution_service/PcapDistributor.h"
 #include "fboss/pcap_distribution_service/ThriftHandler.h"
 #include "fboss/pcap_distribution_service/PcapBufferManager.h"
+#include "fboss/pcap_distribution_service/ShmPacketReceiver.h"
+#include "fboss/pcap_distribution_service/ShmPacketRing.h"
 
 #include <memory>
 
@@ -32,6 +34,15 @@ int main(int argc, char** argv) {
   auto buff = make_unique<PcapBufferManager>();
   auto pushsub = make_shared<ThriftHandler>(move(dist), move(buff));
 
+  // Has to be listening before the agent is asked to connect, so that it
+  // picks up a ring rather than falling back to thrift
+  unique_ptr<ShmPacketReceiver> receiver;
+  if (!FLAGS_pcap_shm_socket.empty()) {
+    receiver = make_unique<ShmPacketReceiver>(
+        evb.get(), FLAGS_pcap_shm_socket,
+        [pushsub](CapturedPacket& pkt) { pushsub->packetReceived(pkt); });
+  }
+
   SocketAddress ctrl_address("::1", ctrl_constants::DEFAULT_CTRL_PORT());
   auto socket = TAsyncSocket::newSocket(evb.get(), ctrl_address);
   auto chan = HeaderClientChannel::newChannel(socket);
@@ -37,36 +37,57 @@ void PcapDistributor::subscribe(unique_ptr<string> hostname, int port) {
     locked_callbacks->erase(key);
     locked_callbacks->emplace(key, move(closer));
     chan->setCloseCallback(&locked_callbacks->at(key));
-    locked_map->emplace(
-        key, make_unique<PcapSubscriberAsyncClient>(move(chan)));
+    Subscriber sub;
+    sub.client = make_shared<PcapSubscriberAsyncClient>(move(chan));
+    sub.batcher = make_shared<PacketBatcher>(
+        evb_.get(), [client = sub.client, key](const PacketBatch& batch) {
+          if (batch.dropped > 0) {
+            FB_LOG_EVERY_MS(WARNING, 1000)
+                << "dropped " << batch.dropped << " packets for subscriber "
+                << key.first << " " << key.second;
+          }
+          return client->future_receivePacketBatch(batch);
+        });
+    locked_map->emplace(key, move(sub));
     LOG(INFO) << "CREATED SUBSCRIBER: " << *hostname << " " << port;
   };
   evb_->runInEventBaseThread(move(creation));
 }
 
 void PcapDistributor::unsubscribe(const string& hostname, int port) {
-  subs_.wlock()->erase(pair<string, int>(hostname, port));
+  // Destroy the subscriber outside the lock, as its batcher waits for the
+  // EventBase thread, which may be waiting for the lock to subscribe someone
+  Subscriber sub;
+  {
+    auto locked_map = subs_.wlock();
+    auto it = locked_map->find(pair<string, int>(hostname, port));
+    if (it != locked_map->end()) {
+      sub = move(it->second);
+      locked_map->erase(it);
+    }
+  }
   callbacks_.wlock()->erase(pair<string, int>(hostname, port));
   LOG(INFO) << "UNSUBSCRIBED CLIENT: " << hostname << " " << port;
 }
 
 void PcapDistributor::distributeRxPacket(RxPacketData* packetData) {
-  auto locked_map = subs_.rlock();
-  auto onError = [](runtime_error& e) {
-    FB_LOG_EVERY_MS(ERROR, 1000) << e.what();
-  };
-  for (auto& i : *locked_map) {
-    i.second->future_receiveRxPacket(*packetData).onError(move(onError));
-  }
+  CapturedPacket pkt;
+  pkt.rx = true;
+  pkt.pkt.set_rxpkt(*packetData);
+  distributePacket(pkt);
 }
 
 void PcapDistributor::distributeTxPacket(TxPacketData* packetData) {
+  CapturedPacket pkt;
+  pkt.rx = false;
+  pkt.pkt.set_txpkt(*packetData);
+  distributePacket(pkt);
+}
+
+void PcapDistributor::distributePacket(const CapturedPacket& pkt) {
   auto locked_map = subs_.rlock();
-  auto onError = [](runtime_error& e) {
-    FB_LOG_EVERY_MS(ERROR, 1000) << e.what();
-  };
   for (auto& i : *locked_map) {
-    i.second->future_receiveTxPacket(*packetData).onError(move(onError));
+    i.second.batcher->addPacket(pkt);
   }
 }
 }}
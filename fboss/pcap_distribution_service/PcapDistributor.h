@@ -5,6 +5,7 @@
 
 #include <thrift/lib/cpp2/async/RequestChannel.h>
 
+#include "fboss/pcap_distribution_service/PacketBatcher.h"
 #include "fboss/pcap_distribution_service/if/gen-cpp2/PcapPushSubscriber.h"
 #include "fboss/pcap_distribution_service/if/gen-cpp2/PcapSubscriber.h"
 #include "fboss/pcap_distribution_service/if/gen-cpp2/pcap_pubsub_constants.h"
@@ -28,8 +29,19 @@ class PcapDistributor {
   void unsubscribe(const std::string& hostname, int port);
   void distributeRxPacket(RxPacketData* packetData);
   void distributeTxPacket(TxPacketData* packetData);
+  /*
+   * Queue a packet for every subscriber.  Each subscriber is sent its
+   * packets in batches, with its own bounded queue, so one that falls behind
+   * only drops its own packets.
+   */
+  void distributePacket(const CapturedPacket& pkt);
 
  private:
+  struct Subscriber {
+    std::shared_ptr<PcapSubscriberAsyncClient> client;
+    std::shared_ptr<PacketBatcher> batcher;
+  };
+
   /*
    * This class handles the callback to unsubscribe a client
    * whenever they disconnect from the distribution service
@@ -51,10 +63,7 @@ class PcapDistributor {
   };
 
   // Map of hostname and port to client object
-  folly::Synchronized<std::map<
-      std::pair<std::string, int>,
-      std::unique_ptr<PcapSubscriberAsyncClient>>>
-      subs_;
+  folly::Synchronized<std::map<std::pair<std::string, int>, Subscriber>> subs_;
   folly::Synchronized<std::map<std::pair<std::string, int>, ChannelCloserCB>>
       callbacks_;
   std::shared_ptr<folly::EventBase> evb_;
@@ -0,0 +1,108 @@
+#include "fboss/pcap_distribution_service/ShmPacketReceiver.h"
+
+#include "fboss/pcap_distribution_service/ShmPacketRing.h"
+
+#include "fboss/agent/FbossError.h"
+
+#include <folly/Exception.h>
+#include <folly/ExceptionString.h>
+#include <glog/logging.h>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <cstring>
+
+namespace facebook { namespace fboss {
+
+/*
+ * Reads the packets from one ring whenever its eventfd is signalled.
+ */
+class ShmPacketReceiver::Reader : public folly::EventHandler {
+ public:
+  Reader(folly::EventBase* evb, std::unique_ptr<ShmPacketRing> ring,
+         const Callback* callback)
+      : folly::EventHandler(evb, ring->eventFd()),
+        ring_(std::move(ring)),
+        callback_(callback) {
+    registerHandler(folly::EventHandler::READ | folly::EventHandler::PERSIST);
+    // Arms the eventfd, and picks up anything written already
+    ring_->drain(*callback_);
+  }
+  ~Reader() override {
+    unregisterHandler();
+  }
+
+ private:
+  void handlerReady(uint16_t /*events*/) noexcept override {
+    ring_->drain(*callback_);
+  }
+
+  std::unique_ptr<ShmPacketRing> ring_;
+  const Callback* callback_{nullptr};
+};
+
+ShmPacketReceiver::ShmPacketReceiver(
+    folly::EventBase* evb, const std::string& path, Callback callback)
+    : folly::EventHandler(evb),
+      evb_(evb),
+      path_(path),
+      callback_(std::move(callback)) {
+  struct sockaddr_un addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  if (path_.size() >= sizeof(addr.sun_path)) {
+    throw FbossError("packet ring socket path ", path_, " is too long");
+  }
+  memcpy(addr.sun_path, path_.data(), path_.size());
+
+  socket_ = folly::File(
+      socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0), true);
+  folly::checkUnixError(socket_.fd(), "failed to create packet ring socket");
+  // Left behind by an earlier run
+  unlink(path_.c_str());
+  folly::checkUnixError(
+      bind(socket_.fd(), reinterpret_cast<struct sockaddr*>(&addr),
+           sizeof(addr)),
+      "failed to bind packet ring socket ", path_);
+  folly::checkUnixError(listen(socket_.fd(), 1),
+                        "failed to listen on packet ring socket ", path_);
+
+  changeHandlerFD(socket_.fd());
+  registerHandler(folly::EventHandler::READ | folly::EventHandler::PERSIST);
+  LOG(INFO) << "Handing out packet rings on " << path_;
+}
+
+ShmPacketReceiver::~ShmPacketReceiver() {
+  unregisterHandler();
+  reader_.reset();
+  unlink(path_.c_str());
+}
+
+void ShmPacketReceiver::handlerReady(uint16_t /*events*/) noexcept {
+  while (true) {
+    folly::File conn(accept4(socket_.fd(), nullptr, nullptr, SOCK_CLOEXEC),
+                     true);
+    if (conn.fd() < 0) {
+      if (errno != EAGAIN && errno != EWOULDBLOCK) {
+        PLOG(ERROR) << "failed to accept on packet ring socket";
+      }
+      return;
+    }
+    try {
+      auto ring = ShmPacketRing::create(
+          static_cast<size_t>(FLAGS_pcap_shm_ring_kb) * 1024);
+      ring->sendTo(conn.fd());
+      // Drop the old ring first, so its packets don't outlive a newer one's
+      reader_.reset();
+      reader_ = std::make_unique<Reader>(evb_, std::move(ring), &callback_);
+      LOG(INFO) << "Handed out a packet ring to the switch";
+    } catch (const std::exception& ex) {
+      LOG(ERROR) << "unable to hand out packet ring: "
+                 << folly::exceptionStr(ex);
+    }
+  }
+}
+
+}}
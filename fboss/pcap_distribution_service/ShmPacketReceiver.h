@@ -0,0 +1,49 @@
+#pragma once
+
+#include "fboss/pcap_distribution_service/if/gen-cpp2/pcap_pubsub_types.h"
+
+#include <folly/File.h>
+#include <folly/io/async/EventHandler.h>
+
+#include <functional>
+#include <memory>
+#include <string>
+
+namespace facebook { namespace fboss {
+
+class ShmPacketRing;
+
+/*
+ * Listens on a unix socket for the agent, and gives each agent that connects
+ * a new shared memory ring to write its packets to.  The packets are read in
+ * the EventBase's thread whenever the ring's eventfd says there are some,
+ * and passed to the callback.
+ *
+ * Only the ring handed out last is read, since there is only one agent, and
+ * a new connection means it has restarted.
+ */
+class ShmPacketReceiver : private folly::EventHandler {
+ public:
+  using Callback = std::function<void(CapturedPacket&)>;
+
+  ShmPacketReceiver(folly::EventBase* evb, const std::string& path,
+                    Callback callback);
+  ~ShmPacketReceiver() override;
+
+ private:
+  class Reader;
+
+  // Forbidden copy constructor and assignment operator
+  ShmPacketReceiver(ShmPacketReceiver const &) = delete;
+  ShmPacketReceiver& operator=(ShmPacketReceiver const &) = delete;
+
+  void handlerReady(uint16_t events) noexcept override;
+
+  folly::EventBase* evb_{nullptr};
+  std::string path_;
+  Callback callback_;
+  folly::File socket_;
+  std::unique_ptr<Reader> reader_;
+};
+
+}}
@@ -0,0 +1,377 @@
+#include "fboss/pcap_distribution_service/ShmPacketRing.h"
+
+#include "fboss/agent/FbossError.h"
+
+#include <folly/Bits.h>
+#include <folly/Exception.h>
+#include <glog/logging.h>
+
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+#include <thread>
+
+DEFINE_string(pcap_shm_socket, "/var/run/fboss_pcap_distribution.sock",
+              "Unix socket the distribution service hands out shared memory "
+              "packet rings on.  Empty to send packets with thrift only");
+DEFINE_int32(pcap_shm_ring_kb, 4096,
+             "Size of the shared memory ring of packets for the "
+             "distribution service, in KB");
+
+namespace {
+
+constexpr uint64_t kMagic = 0x46424f5353524e47; // "FBOSSRNG"
+constexpr uint32_t kVersion = 1;
+// The header gets a page to itself, so the data starts page aligned
+constexpr size_t kHeaderSize = 4096;
+constexpr size_t kCacheLine = 64;
+constexpr size_t kRecordAlignment = 8;
+constexpr size_t kMinCapacity = 64 * 1024;
+// The bytes and the length of the description of each reason
+constexpr size_t kReasonHeaderSize = sizeof(int32_t) + sizeof(uint16_t);
+
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2 && ATOMIC_INT_LOCK_FREE == 2,
+              "the ring needs lock free atomics to be shared between "
+              "processes");
+
+size_t alignRecord(size_t length) {
+  return (length + kRecordAlignment - 1) & ~(kRecordAlignment - 1);
+}
+
+}
+
+namespace facebook { namespace fboss {
+
+/*
+ * The start of the shared memory.  head and tail are byte offsets that only
+ * ever grow, written by the producer and the consumer respectively, each on
+ * a cache line of its own.
+ */
+struct ShmPacketRing::Header {
+  uint64_t magic{kMagic};
+  uint32_t version{kVersion};
+  uint64_t capacity{0};
+  alignas(kCacheLine) std::atomic<uint64_t> head{0};
+  alignas(kCacheLine) std::atomic<uint64_t> tail{0};
+  // Set by the consumer when it is about to wait on the eventfd
+  alignas(kCacheLine) std::atomic<uint32_t> consumerWaiting{0};
+};
+
+/*
+ * Each record is followed by dataLength bytes of packet and reasonsLength
+ * bytes of reasons, and padded out to kRecordAlignment.  Records never wrap
+ * around the end of the ring: a length of 0 means the rest is unused and the
+ * next record is at the start.
+ */
+struct ShmPacketRing::Record {
+  uint32_t length{0};
+  uint8_t rx{0};
+  uint8_t pad{0};
+  uint16_t ethertype{0};
+  int32_t srcPort{0};
+  int32_t srcVlan{0};
+  uint32_t dataLength{0};
+  uint32_t reasonsLength{0};
+  int64_t timestampUsec{0};
+};
+
+ShmPacketRing::ShmPacketRing(
+    folly::File memfd, folly::File eventfd, size_t capacity)
+    : memfd_(std::move(memfd)),
+      eventfd_(std::move(eventfd)),
+      capacity_(capacity) {
+  static_assert(sizeof(Header) <= kHeaderSize,
+                "ring header doesn't fit in its page");
+  static_assert(sizeof(Record) == 32,
+                "ring records must be the same in both processes");
+  map_ = mmap(nullptr, kHeaderSize + capacity_, PROT_READ | PROT_WRITE,
+              MAP_SHARED, memfd_.fd(), 0);
+  if (map_ == MAP_FAILED) {
+    map_ = nullptr;
+    folly::throwSystemError("failed to map packet ring");
+  }
+  header_ = static_cast<Header*>(map_);
+  data_ = static_cast<uint8_t*>(map_) + kHeaderSize;
+}
+
+ShmPacketRing::~ShmPacketRing() {
+  if (map_) {
+    munmap(map_, kHeaderSize + capacity_);
+  }
+}
+
+std::unique_ptr<ShmPacketRing> ShmPacketRing::create(size_t capacity) {
+  capacity = folly::nextPowTwo(std::max(capacity, kMinCapacity));
+  folly::File memfd(memfd_create("fboss_pcap_ring", MFD_CLOEXEC), true);
+  folly::checkUnixError(memfd.fd(), "failed to create packet ring");
+  folly::checkUnixError(ftruncate(memfd.fd(), kHeaderSize + capacity),
+                        "failed to size packet ring");
+  folly::File eventfd(::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC), true);
+  folly::checkUnixError(eventfd.fd(), "failed to create packet ring eventfd");
+
+  std::unique_ptr<ShmPacketRing> ring(
+      new ShmPacketRing(std::move(memfd), std::move(eventfd), capacity));
+  auto* header = new (ring->map_) Header();
+  header->capacity = capacity;
+  return ring;
+}
+
+std::unique_ptr<ShmPacketRing> ShmPacketRing::attach(
+    folly::File memfd, folly::File eventfd) {
+  struct stat st;
+  folly::checkUnixError(fstat(memfd.fd(), &st), "failed to stat packet ring");
+  if (st.st_size <= off_t(kHeaderSize)) {
+    throw FbossError("packet ring of ", st.st_size, " bytes is too small");
+  }
+  size_t capacity = st.st_size - kHeaderSize;
+  if (!folly::isPowTwo(capacity)) {
+    throw FbossError("packet ring capacity ", capacity,
+                     " is not a power of two");
+  }
+
+  std::unique_ptr<ShmPacketRing> ring(
+      new ShmPacketRing(std::move(memfd), std::move(eventfd), capacity));
+  const auto* header = ring->header_;
+  if (header->magic != kMagic || header->version != kVersion ||
+      header->capacity != capacity) {
+    throw FbossError("not a version ", kVersion, " packet ring");
+  }
+  ring->reserved_.store(header->head.load(std::memory_order_acquire),
+                        std::memory_order_relaxed);
+  return ring;
+}
+
+void ShmPacketRing::sendTo(int socket) const {
+  int fds[2] = {memfd_.fd(), eventfd_.fd()};
+  char byte = 0;
+  struct iovec iov = {&byte, sizeof(byte)};
+  char control[CMSG_SPACE(sizeof(fds))];
+  memset(control, 0, sizeof(control));
+
+  struct msghdr msg;
+  memset(&msg, 0, sizeof(msg));
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control;
+  msg.msg_controllen = sizeof(control);
+  auto* cmsg = CMSG_FIRSTHDR(&msg);
+  cmsg->cmsg_level = SOL_SOCKET;
+  cmsg->cmsg_type = SCM_RIGHTS;
+  cmsg->cmsg_len = CMSG_LEN(sizeof(fds));
+  memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+
+  folly::checkUnixError(sendmsg(socket, &msg, MSG_NOSIGNAL),
+                        "failed to send packet ring");
+}
+
+std::unique_ptr<ShmPacketRing> ShmPacketRing::receiveFrom(int socket) {
+  int fds[2] = {-1, -1};
+  char byte = 0;
+  struct iovec iov = {&byte, sizeof(byte)};
+  char control[CMSG_SPACE(sizeof(fds))];
+
+  struct msghdr msg;
+  memset(&msg, 0, sizeof(msg));
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control;
+  msg.msg_controllen = sizeof(control);
+  auto ret = recvmsg(socket, &msg, MSG_CMSG_CLOEXEC);
+  folly::checkUnixError(ret, "failed to receive packet ring");
+
+  auto* cmsg = CMSG_FIRSTHDR(&msg);
+  if (ret != 1 || !cmsg || cmsg->cmsg_level != SOL_SOCKET ||
+      cmsg->cmsg_type != SCM_RIGHTS ||
+      cmsg->cmsg_len != CMSG_LEN(sizeof(fds))) {
+    throw FbossError("no packet ring received");
+  }
+  memcpy(fds, CMSG_DATA(cmsg), sizeof(fds));
+  return attach(folly::File(fds[0], true), folly::File(fds[1], true));
+}
+
+bool ShmPacketRing::write(bool rx, const folly::IOBuf* buf,
+                          uint16_t ethertype, int32_t srcPort,
+                          int32_t srcVlan,
+                          const std::vector<RxPacket::RxReason>& reasons,
+                          int64_t timestampUsec) {
+  size_t reasonsLength = 0;
+  for (const auto& reason : reasons) {
+    reasonsLength += kReasonHeaderSize +
+        std::min<size_t>(reason.description.size(), UINT16_MAX);
+  }
+  auto dataLength = buf->computeChainDataLength();
+  auto length = alignRecord(sizeof(Record) + dataLength + reasonsLength);
+  // A record has to fit even after skipping the end of the ring
+  if (length > capacity_ / 2) {
+    dropped_.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+
+  // Reserve room for the record, skipping the end of the ring if it doesn't
+  // fit there.  Nothing up to the tail can still be read by the consumer.
+  auto start = reserved_.load(std::memory_order_relaxed);
+  uint64_t contiguous;
+  uint64_t needed;
+  do {
+    auto tail = header_->tail.load(std::memory_order_acquire);
+    contiguous = capacity_ - (start & (capacity_ - 1));
+    needed = length + (contiguous < length ? contiguous : 0);
+    if (start + needed - tail > capacity_) {
+      dropped_.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    }
+  } while (!reserved_.compare_exchange_weak(
+      start, start + needed, std::memory_order_relaxed));
+
+  auto head = start;
+  if (contiguous < length) {
+    // contiguous is a multiple of kRecordAlignment, so there is always room
+    // for the length
+    uint32_t skip = 0;
+    memcpy(at(head), &skip, sizeof(skip));
+    head += contiguous;
+  }
+
+  auto* record = reinterpret_cast<Record*>(at(head));
+  record->length = length;
+  record->rx = rx;
+  record->ethertype = ethertype;
+  record->srcPort = srcPort;
+  record->srcVlan = srcVlan;
+  record->dataLength = dataLength;
+  record->reasonsLength = reasonsLength;
+  record->timestampUsec = timestampUsec;
+  auto* out = reinterpret_cast<uint8_t*>(record + 1);
+  for (auto range : *buf) {
+    memcpy(out, range.data(), range.size());
+    out += range.size();
+  }
+  for (const auto& reason : reasons) {
+    uint16_t descLength =
+        std::min<size_t>(reason.description.size(), UINT16_MAX);
+    int32_t bytes = reason.bytes;
+    memcpy(out, &bytes, sizeof(bytes));
+    memcpy(out + sizeof(bytes), &descLength, sizeof(descLength));
+    memcpy(out + kReasonHeaderSize, reason.description.data(), descLength);
+    out += kReasonHeaderSize + descLength;
+  }
+
+  // The consumer reads up to head, so records are published in the order
+  // they were reserved, once the writers ahead of us have copied theirs.
+  while (header_->head.load(std::memory_order_acquire) != start) {
+    std::this_thread::yield();
+  }
+  // Publishing the record and checking for a waiting consumer are both
+  // sequentially consistent, pairing with prepareWait(), so either the
+  // consumer sees the record or we see that it is waiting.
+  header_->head.store(head + length, std::memory_order_seq_cst);
+  written_.fetch_add(1, std::memory_order_relaxed);
+  if (header_->consumerWaiting.load(std::memory_order_seq_cst) &&
+      header_->consumerWaiting.exchange(0, std::memory_order_seq_cst)) {
+    uint64_t one = 1;
+    if (::write(eventfd_.fd(), &one, sizeof(one)) < 0) {
+      PLOG(ERROR) << "failed to wake packet ring consumer";
+    }
+  }
+  return true;
+}
+
+bool ShmPacketRing::read(CapturedPacket* pkt) {
+  auto tail = header_->tail.load(std::memory_order_relaxed);
+  auto head = header_->head.load(std::memory_order_acquire);
+  if (tail == head) {
+    return false;
+  }
+  uint32_t length = 0;
+  memcpy(&length, at(tail), sizeof(length));
+  if (length == 0) {
+    tail += capacity_ - (tail & (capacity_ - 1));
+    if (tail < head) {
+      memcpy(&length, at(tail), sizeof(length));
+    }
+  }
+
+  const auto* record = reinterpret_cast<const Record*>(at(tail));
+  if (tail >= head || length < sizeof(Record) ||
+      length % kRecordAlignment != 0 || length > head - tail ||
+      sizeof(Record) + uint64_t(record->dataLength) +
+              record->reasonsLength > length) {
+    // Nothing else can be trusted, so throw away everything written so far
+    LOG(ERROR) << "corrupt packet ring record, dropping "
+               << head - header_->tail.load(std::memory_order_relaxed)
+               << " bytes";
+    header_->tail.store(head, std::memory_order_release);
+    return false;
+  }
+
+  const auto* data = reinterpret_cast<const char*>(record + 1);
+  pkt->rx = record->rx;
+  pkt->timestampUsec = record->timestampUsec;
+  pkt->ethertype = record->ethertype;
+  if (record->rx) {
+    RxPacketData rxPkt;
+    rxPkt.srcPort = record->srcPort;
+    rxPkt.srcVlan = record->srcVlan;
+    rxPkt.packetData.assign(data, record->dataLength);
+    const auto* reason = data + record->dataLength;
+    const auto* end = reason + record->reasonsLength;
+    while (reason + kReasonHeaderSize <= end) {
+      RxReason rxReason;
+      uint16_t descLength = 0;
+      memcpy(&rxReason.bytes, reason, sizeof(rxReason.bytes));
+      memcpy(&descLength, reason + sizeof(rxReason.bytes),
+             sizeof(descLength));
+      reason += kReasonHeaderSize;
+      if (reason + descLength > end) {
+        break;
+      }
+      rxReason.description.assign(reason, descLength);
+      reason += descLength;
+      rxPkt.reasons.push_back(std::move(rxReason));
+    }
+    pkt->pkt.set_rxpkt(std::move(rxPkt));
+  } else {
+    TxPacketData txPkt;
+    txPkt.packetData.assign(data, record->dataLength);
+    pkt->pkt.set_txpkt(std::move(txPkt));
+  }
+
+  header_->tail.store(tail + length, std::memory_order_release);
+  return true;
+}
+
+bool ShmPacketRing::prepareWait() {
+  header_->consumerWaiting.store(1, std::memory_order_seq_cst);
+  if (header_->head.load(std::memory_order_seq_cst) !=
+      header_->tail.load(std::memory_order_relaxed)) {
+    header_->consumerWaiting.store(0, std::memory_order_relaxed);
+    return false;
+  }
+  return true;
+}
+
+size_t ShmPacketRing::drain(
+    const std::function<void(CapturedPacket&)>& callback) {
+  // Clear the eventfd before reading, so a wakeup for a packet that arrives
+  // from here on isn't lost
+  uint64_t count;
+  if (::read(eventfd_.fd(), &count, sizeof(count)) < 0 && errno != EAGAIN) {
+    PLOG(ERROR) << "failed to read packet ring eventfd";
+  }
+  size_t packets = 0;
+  CapturedPacket pkt;
+  do {
+    while (read(&pkt)) {
+      callback(pkt);
+      ++packets;
+    }
+  } while (!prepareWait());
+  return packets;
+}
+
+}}
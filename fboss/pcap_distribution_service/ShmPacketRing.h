@@ -0,0 +1,126 @@
+#pragma once
+
+#include "fboss/agent/RxPacket.h"
+#include "fboss/pcap_distribution_service/if/gen-cpp2/pcap_pubsub_types.h"
+
+#include <folly/File.h>
+#include <folly/io/IOBuf.h>
+#include <gflags/gflags.h>
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <vector>
+
+DECLARE_string(pcap_shm_socket);
+DECLARE_int32(pcap_shm_ring_kb);
+
+namespace facebook { namespace fboss {
+
+/*
+ * A single producer, single consumer ring of packets in shared memory, for
+ * the agent to hand packets to the distribution service without encoding
+ * each one as a thrift call.
+ *
+ * The ring lives in a memfd, and the consumer is woken through an eventfd,
+ * but only when it has said it is about to sleep, so a busy consumer costs
+ * the producer no system calls at all.  Both fds are passed from the
+ * consumer to the producer over a unix socket, and the ring goes away when
+ * both sides have closed them.
+ *
+ * Each packet is a record holding its metadata followed by the raw packet
+ * bytes and RX reasons, so the producer copies the packet once, straight out
+ * of its buffer.  A full ring drops the packet and counts it, rather than
+ * ever blocking the producer.
+ *
+ * write() may be called from several threads at once: each reserves room
+ * for its record and copies into it in parallel, and records are published
+ * to the consumer in the order they were reserved.  read() may only be
+ * called from one thread at a time.
+ */
+class ShmPacketRing {
+ public:
+  ~ShmPacketRing();
+
+  /*
+   * Create a new ring with room for capacity bytes of records, rounded up
+   * to a power of two.
+   */
+  static std::unique_ptr<ShmPacketRing> create(size_t capacity);
+  /*
+   * Map a ring created by another process.  Throws if the fds don't hold a
+   * ring.
+   */
+  static std::unique_ptr<ShmPacketRing> attach(
+      folly::File memfd, folly::File eventfd);
+
+  /*
+   * Pass the fds of the ring over a connected unix socket, or receive them
+   * and attach to the ring.
+   */
+  void sendTo(int socket) const;
+  static std::unique_ptr<ShmPacketRing> receiveFrom(int socket);
+
+  /*
+   * Add a packet to the ring, and wake the consumer if it is waiting.
+   * Returns false if the ring has no room for it.  The port, VLAN and
+   * reasons are only kept for RX packets.
+   */
+  bool write(bool rx, const folly::IOBuf* buf, uint16_t ethertype,
+             int32_t srcPort, int32_t srcVlan,
+             const std::vector<RxPacket::RxReason>& reasons,
+             int64_t timestampUsec);
+
+  /*
+   * Take the next packet from the ring, if there is one.
+   */
+  bool read(CapturedPacket* pkt);
+  /*
+   * Read every packet in the ring, and arm the eventfd to be signalled when
+   * the next one arrives.  Call this when the eventfd is readable.
+   */
+  size_t drain(const std::function<void(CapturedPacket&)>& callback);
+
+  int eventFd() const {
+    return eventfd_.fd();
+  }
+  size_t capacity() const {
+    return capacity_;
+  }
+  uint64_t getWritten() const {
+    return written_.load(std::memory_order_relaxed);
+  }
+  uint64_t getDropped() const {
+    return dropped_.load(std::memory_order_relaxed);
+  }
+
+ private:
+  struct Header;
+  struct Record;
+
+  ShmPacketRing(folly::File memfd, folly::File eventfd, size_t capacity);
+
+  // Forbidden copy constructor and assignment operator
+  ShmPacketRing(ShmPacketRing const &) = delete;
+  ShmPacketRing& operator=(ShmPacketRing const &) = delete;
+
+  uint8_t* at(uint64_t offset) const {
+    return data_ + (offset & (capacity_ - 1));
+  }
+  bool prepareWait();
+
+  folly::File memfd_;
+  folly::File eventfd_;
+  size_t capacity_{0};
+  void* map_{nullptr};
+  Header* header_{nullptr};
+  uint8_t* data_{nullptr};
+  // The end of the records reserved by writers in this process, which may
+  // not all be published to the consumer through the header's head yet
+  std::atomic<uint64_t> reserved_{0};
+
+  std::atomic<uint64_t> written_{0};
+  std::atomic<uint64_t> dropped_{0};
+};
+
+}}
@@ -1,10 +1,14 @@
 #include "fboss/pcap_distribution_service/ThriftHandler.h"
 
+#include "fboss/pcap_distribution_service/PacketBatcher.h"
 #include "fboss/pcap_distribution_service/PcapBufferManager.h"
 #include "fboss/pcap_distribution_service/PcapDistributor.h"
 
 #include "fboss/agent/capture/PcapPkt.h"
 
+#include <folly/GLog.h>
+
+#include <chrono>
 #include <memory>
 
 using namespace std;
@@ -33,6 +37,28 @@ void ThriftHandler::receiveTxPacket(
   buffMgr_->addPkt(PcapPkt(pkt.get()), ethertype);
 }
 
+void ThriftHandler::receivePacketBatch(unique_ptr<PacketBatch> batch) {
+  if (batch->dropped > 0) {
+    FB_LOG_EVERY_MS(WARNING, 1000)
+        << "switch dropped " << batch->dropped << " packets";
+  }
+  for (const auto& pkt : PacketBatcher::takePackets(batch.get())) {
+    packetReceived(pkt);
+  }
+}
+
+void ThriftHandler::packetReceived(const CapturedPacket& pkt) {
+  dist_->distributePacket(pkt);
+  PcapPkt::TimePoint timestamp(chrono::microseconds(pkt.timestampUsec));
+  if (pkt.rx) {
+    buffMgr_->addPkt(PcapPkt(&pkt.pkt.get_rxpkt(), timestamp),
+                     pkt.ethertype);
+  } else {
+    buffMgr_->addPkt(PcapPkt(&pkt.pkt.get_txpkt(), timestamp),
+                     pkt.ethertype);
+  }
+}
+
 void ThriftHandler::kill(){
   LOG(INFO) << "KILL SIGNAL FROM AGENT";
   exit(0);
@@ -51,4 +77,20 @@ void ThriftHandler::dumpPacketsByType(
     buffMgr_->dumpPackets(out, type);
   }
 }
+
+void ThriftHandler::dumpPacketsSince(
+    vector<CapturedPacket>& out,
+    int64_t timestampUsec,
+    unique_ptr<vector<int16_t>> ethertypes) {
+  PcapPkt::TimePoint timestamp(chrono::microseconds(timestampUsec));
+  if (ethertypes->empty()) {
+    for(const auto& type : PcapBufferManager::getEthertypes()) {
+      buffMgr_->dumpPacketsSince(out, type, timestamp);
+    }
+    return;
+  }
+  for(const auto& type : *ethertypes){
+    buffMgr_->dumpPacketsSince(out, type, timestamp);
+  }
+}
 }}
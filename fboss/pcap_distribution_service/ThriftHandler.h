@@ -32,6 +32,11 @@ class ThriftHandler : virtual public PcapPushSubscriberSvIf {
       override;
   void receiveTxPacket(std::unique_ptr<TxPacketData> pkt, int16_t ethertype)
       override;
+  void receivePacketBatch(std::unique_ptr<PacketBatch> batch) override;
+  /*
+   * Distribute and buffer a packet from SwSwitch, however it arrived
+   */
+  void packetReceived(const CapturedPacket& pkt);
   /*
    * A thrift kill switch for the service
    */
@@ -44,6 +49,10 @@ class ThriftHandler : virtual public PcapPushSubscriberSvIf {
   void dumpPacketsByType(
       std::vector<CapturedPacket>& out,
       std::unique_ptr<std::vector<int16_t>> ethertypes) override;
+  void dumpPacketsSince(
+      std::vector<CapturedPacket>& out,
+      int64_t timestampUsec,
+      std::unique_ptr<std::vector<int16_t>> ethertypes) override;
 
  private:
   std::unique_ptr<PcapDistributor> dist_;
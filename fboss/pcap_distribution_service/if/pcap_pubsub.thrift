@@ -41,6 +41,22 @@ union PacketData {
 struct CapturedPacket {
   1: required bool rx,
   2: required PacketData pkt
+  // When the packet was captured, in microseconds since the epoch
+  3: i64 timestampUsec
+  4: i16 ethertype
+}
+
+// Packets sent together in one call
+struct PacketBatch {
+  // The packets, unless the batch is compressed
+  1: list<CapturedPacket> packets
+  // If set, the packets are instead in compressedPackets, as a PacketBatch
+  // serialized with the compact protocol and compressed with LZ4
+  2: bool compressed = false
+  3: fbbinary compressedPackets
+  // How many packets were dropped since the last batch, because the
+  // receiver was falling behind
+  4: i64 dropped
 }
 
 // This interface is for a user to connect to the service,
@@ -50,6 +66,9 @@ service PcapPushSubscriber {
   // distributor
   void receiveRxPacket(1: RxPacketData packet, 2: i16 type)
   void receiveTxPacket(1: TxPacketData packet, 2: i16 type)
+  // Called by the switch to send a batch of packets, each with its
+  // ethertype
+  void receivePacketBatch(1: PacketBatch batch)
 
   // Give the switch the ability to kill the distribution
   // process if needed
@@ -64,13 +83,21 @@ service PcapPushSubscriber {
   // Request by type of packet, or get all ethertypes
   list<CapturedPacket> dumpAllPackets()
   list<CapturedPacket> dumpPacketsByType(1: list<i16> ethertypes)
+  // Get the packets received at or after a time, in microseconds since the
+  // epoch, without removing them from the buffers.  All ethertypes if the
+  // list is empty.
+  list<CapturedPacket> dumpPacketsSince(
+    1: i64 timestampUsec,
+    2: list<i16> ethertypes)
 }
 
 // This interface is for a subscriber to receive a packet stream
 // from the service
 service PcapSubscriber {
-  // Both of these functions will be called by the
-  // distributor upon receiving a packet from the switch.
+  // Packets are no longer sent one at a time, but these are kept for
+  // subscribers built against them
   void receiveRxPacket(1: RxPacketData packet)
   void receiveTxPacket(1: TxPacketData packet)
+  // Called by the distributor with the packets received from the switch
+  void receivePacketBatch(1: PacketBatch batch)
 }
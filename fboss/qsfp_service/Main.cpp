@@ -5,6 +5,7 @@
 #include "fboss/qsfp_service/QsfpServiceHandler.h"
 #include "fboss/qsfp_service/StatsPublisher.h"
 #include "fboss/qsfp_service/platforms/wedge/WedgeManagerInit.h"
+#include "fboss/lib/OpenMetricsServer.h"
 
 using namespace facebook;
 using namespace facebook::fboss;
@@ -19,6 +20,16 @@ DEFINE_int32(
     5,
     "Interval (in seconds) to run the main loop that determines "
     "if we need to change or fetch data for transceivers");
+DEFINE_int32(
+    presence_check_interval_ms,
+    1000,
+    "Interval (in milliseconds) to check if transceivers were plugged in or "
+    "removed, and refresh just those, or 0 to leave it to the main loop");
+DEFINE_int32(
+    metrics_port,
+    0,
+    "Port to serve the counters on over HTTP, in the OpenMetrics format, "
+    "or 0 to not serve them");
 
 int doServerLoop(std::shared_ptr<apache::thrift::ThriftServer>
         thriftServer, std::shared_ptr<QsfpServiceHandler>);
@@ -58,6 +69,26 @@ int main(int argc, char **argv) {
   // Note: This doesn't block, this merely starts it's own thread
   scheduler.start();
 
+  // Separate from the main loop, so a slow refresh cycle doesn't hold up
+  // noticing modules going in or out
+  folly::FunctionScheduler presenceScheduler;
+  if (FLAGS_presence_check_interval_ms > 0) {
+    presenceScheduler.addFunction(
+        [mgr = handler->getTransceiverManager()]() {
+          mgr->refreshPresenceChanges();
+        },
+        std::chrono::milliseconds(FLAGS_presence_check_interval_ms),
+        "refreshPresenceChanges");
+    presenceScheduler.start();
+  }
+
+  std::unique_ptr<OpenMetricsServer> metricsServer;
+  if (FLAGS_metrics_port > 0) {
+    metricsServer = std::make_unique<OpenMetricsServer>(
+        "fboss_qsfp", FLAGS_metrics_port,
+        std::chrono::milliseconds(FLAGS_metrics_refresh_interval_ms));
+    metricsServer->start();
+  }
 
   doServerLoop(server, handler);
 
@@ -1,5 +1,9 @@
 #include "fboss/qsfp_service/QsfpServiceHandler.h"
+#include <algorithm>
 #include <folly/logging/xlog.h>
+#include <folly/system/ThreadName.h>
+
+#include "fboss/qsfp_service/platforms/wedge/WedgeI2CBusLock.h"
 
 namespace facebook { namespace fboss {
 
@@ -7,6 +11,17 @@ QsfpServiceHandler::QsfpServiceHandler(
   std::unique_ptr<TransceiverManager> manager) :
     FacebookBase2("QsfpService"),
     manager_(std::move(manager)) {
+  i2cThread_ = std::thread([this] {
+    folly::setThreadName("QsfpI2CThread");
+    i2cEventBase_.loopForever();
+  });
+}
+
+QsfpServiceHandler::~QsfpServiceHandler() {
+  // Let the calls already scheduled finish first
+  i2cEventBase_.runInEventBaseThread(
+      [this] { i2cEventBase_.terminateLoopSoon(); });
+  i2cThread_.join();
 }
 
 void QsfpServiceHandler::init() {
@@ -26,11 +41,14 @@ void QsfpServiceHandler::getTransceiverInfo(std::map<int32_t,
   manager_->getTransceiversInfo(info, std::move(ids));
 }
 
-void QsfpServiceHandler::customizeTransceiver(int32_t idx,
-    cfg::PortSpeed speed) {
+folly::Future<folly::Unit> QsfpServiceHandler::future_customizeTransceiver(
+    int32_t idx, cfg::PortSpeed speed) {
   XLOG(INFO) << "customizeTransceiver request for " << idx << " to speed "
              << cfg::_PortSpeed_VALUES_TO_NAMES.find(speed)->second;
-  manager_->customizeTransceiver(idx, speed);
+  return folly::via(&i2cEventBase_, [this, idx, speed] {
+    I2CPriorityScope priority(I2CPriority::INTERACTIVE);
+    manager_->customizeTransceiver(idx, speed);
+  });
 }
 
 void QsfpServiceHandler::getTransceiverRawDOMData(
@@ -39,10 +57,27 @@ void QsfpServiceHandler::getTransceiverRawDOMData(
   manager_->getTransceiversRawDOMData(info, std::move(ids));
 }
 
-void QsfpServiceHandler::syncPorts(
-    std::map<int32_t, TransceiverInfo>& info,
+folly::Future<std::unique_ptr<std::map<int32_t, TransceiverInfo>>>
+QsfpServiceHandler::future_syncPorts(
     std::unique_ptr<std::map<int32_t, PortStatus>> ports) {
-  manager_->syncPorts(info, std::move(ports));
+  return folly::via(
+      &i2cEventBase_, [this, ports = std::move(ports)]() mutable {
+        I2CPriorityScope priority(I2CPriority::INTERACTIVE);
+        auto info = std::make_unique<std::map<int32_t, TransceiverInfo>>();
+        manager_->syncPorts(*info, std::move(ports));
+        return info;
+      });
+}
+
+folly::Future<std::unique_ptr<TransceiverUpdates>>
+QsfpServiceHandler::future_getTransceiverUpdates(
+    int64_t sinceSequence, int32_t maxWaitMs) {
+  return manager_
+      ->getTransceiverUpdates(
+          sinceSequence, std::chrono::milliseconds(std::max(maxWaitMs, 0)))
+      .then([](TransceiverUpdates&& updates) {
+        return std::make_unique<TransceiverUpdates>(std::move(updates));
+      });
 }
 
 }} // facebook::fboss
@@ -1,6 +1,9 @@
 #pragma once
 
 #include <folly/futures/Future.h>
+#include <folly/io/async/EventBase.h>
+
+#include <thread>
 
 #include "common/fb303/cpp/FacebookBase2.h"
 
@@ -14,7 +17,7 @@ class QsfpServiceHandler : public facebook::fboss::QsfpServiceSvIf,
                            public facebook::fb303::FacebookBase2 {
  public:
   explicit QsfpServiceHandler(std::unique_ptr<TransceiverManager> manager);
-  ~QsfpServiceHandler() override = default;
+  ~QsfpServiceHandler() override;
 
   void init();
   facebook::fb303::cpp2::fb_status getStatus() override;
@@ -34,16 +37,28 @@ class QsfpServiceHandler : public facebook::fboss::QsfpServiceSvIf,
 
   /*
    * Store port status information and return relevant transceiver map.
+   *
+   * This and customizeTransceiver() may need the I2C bus, so they run on
+   * the I2C thread rather than holding on to a thrift thread meanwhile.
    */
-  void syncPorts(
-    std::map<int32_t, TransceiverInfo>& info,
+  folly::Future<std::unique_ptr<std::map<int32_t, TransceiverInfo>>>
+  future_syncPorts(
     std::unique_ptr<std::map<int32_t, PortStatus>> ports) override;
 
   /*
    * Customise the transceiver based on the speed at which it has
    * been configured to operate at
    */
-  void customizeTransceiver(int32_t idx, cfg::PortSpeed speed) override;
+  folly::Future<folly::Unit> future_customizeTransceiver(
+    int32_t idx, cfg::PortSpeed speed) override;
+
+  /*
+   * Return the transceivers that changed after sinceSequence, or wait for
+   * one to.  Waiting takes no thread.
+   */
+  folly::Future<std::unique_ptr<TransceiverUpdates>>
+  future_getTransceiverUpdates(int64_t sinceSequence, int32_t maxWaitMs)
+    override;
 
   /*
    * Return a pointer to the transceiver manager.
@@ -58,5 +73,9 @@ class QsfpServiceHandler : public facebook::fboss::QsfpServiceSvIf,
   QsfpServiceHandler& operator=(QsfpServiceHandler const &) = delete;
 
   std::unique_ptr<TransceiverManager> manager_{nullptr};
+
+  // Where the thrift calls that need the I2C bus run
+  folly::EventBase i2cEventBase_;
+  std::thread i2cThread_;
 };
 }} // facebook::fboss
@@ -10,6 +10,9 @@
 
 #pragma once
 
+#include <chrono>
+
+#include <folly/Range.h>
 #include <folly/io/async/EventBase.h>
 #include "fboss/qsfp_service/TransceiverManager.h"
 
@@ -24,6 +27,25 @@ class StatsPublisher {
   static void bumpReadFailure();
   static void bumpWriteFailure();
   static void missingPorts(TransceiverID module);
+  // How long refreshing one module, and a whole refresh cycle, took
+  static void moduleRefreshLatency(
+      TransceiverID module, std::chrono::milliseconds latency);
+  static void refreshCycleLatency(std::chrono::milliseconds latency);
+  // How long customizing the modules whose ports changed together took
+  static void customizeBatchLatency(
+      int modules, std::chrono::milliseconds latency);
+  // How long it took from seeing a module plugged in or removed to having
+  // refreshed its data
+  static void presenceChangeLatency(
+      TransceiverID module, std::chrono::milliseconds latency);
+  // How long an I2C transaction of a priority took, waiting for the bus
+  // included
+  static void i2cTransactionLatency(
+      folly::StringPiece priority, std::chrono::microseconds latency);
+  // What a hold of the I2C bus moved, and how many mux selects it could
+  // skip since the module was still selected
+  static void i2cTransactionBytes(uint64_t bytes);
+  static void muxSelectsSaved(uint64_t count);
 
  private:
   TransceiverManager* transceiverManager_{nullptr};
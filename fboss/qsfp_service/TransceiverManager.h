@@ -1,7 +1,10 @@
 #pragma once
 
+#include <chrono>
 #include <vector>
 
+#include <folly/futures/Future.h>
+
 #include "fboss/agent/types.h"
 #include "fboss/qsfp_service/sff/Transceiver.h"
 #include "fboss/agent/gen-cpp2/switch_config_types.h"
@@ -26,6 +29,11 @@ class TransceiverManager {
   }
   virtual int getNumQsfpModules() = 0;
   virtual void refreshTransceivers() = 0;
+  // Refresh only the transceivers that were plugged in or removed
+  virtual void refreshPresenceChanges() = 0;
+  // The transceivers that changed after sinceSequence, see qsfp.thrift
+  virtual folly::Future<TransceiverUpdates> getTransceiverUpdates(
+    int64_t sinceSequence, std::chrono::milliseconds maxWait) = 0;
   virtual int numPortsPerTransceiver() = 0;
  private:
   // Forbidden copy constructor and assignment operator
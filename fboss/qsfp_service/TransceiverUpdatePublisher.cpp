@@ -0,0 +1,73 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#include "fboss/qsfp_service/TransceiverUpdatePublisher.h"
+
+namespace facebook { namespace fboss {
+
+bool TransceiverUpdatePublisher::update(
+    TransceiverID id, TransceiverInfo info) {
+  folly::SharedPromise<folly::Unit> changed;
+  {
+    std::lock_guard<std::mutex> g(lock_);
+    auto it = latest_.find(id);
+    if (it != latest_.end()) {
+      // Every snapshot has a new time, which alone doesn't make a change
+      auto timeCollected = info.timeCollected;
+      info.timeCollected = it->second.info.timeCollected;
+      if (info == it->second.info) {
+        return false;
+      }
+      info.timeCollected = timeCollected;
+    }
+    latest_[id] = Entry{++sequence_, std::move(info)};
+    changed = std::move(changed_);
+    changed_ = folly::SharedPromise<folly::Unit>();
+  }
+  // Outside of the lock, as the waiters take it to collect the changes
+  changed.setValue();
+  return true;
+}
+
+folly::Future<TransceiverUpdates> TransceiverUpdatePublisher::getUpdates(
+    int64_t sinceSequence, std::chrono::milliseconds maxWait) {
+  folly::Future<folly::Unit> changed = folly::makeFuture();
+  {
+    std::lock_guard<std::mutex> g(lock_);
+    if (sinceSequence > sequence_) {
+      // The client saw a sequence from before we restarted
+      sinceSequence = 0;
+    }
+    if (sequence_ > sinceSequence) {
+      return collectLocked(sinceSequence);
+    }
+    changed = changed_.getFuture();
+  }
+
+  return changed.within(maxWait)
+      .onError([](const folly::TimedOut&) {})
+      .then([this, sinceSequence]() {
+        std::lock_guard<std::mutex> g(lock_);
+        return collectLocked(sinceSequence);
+      });
+}
+
+TransceiverUpdates TransceiverUpdatePublisher::collectLocked(
+    int64_t sinceSequence) const {
+  TransceiverUpdates updates;
+  updates.sequence = sequence_;
+  for (const auto& item : latest_) {
+    if (item.second.sequence > sinceSequence) {
+      updates.changed[static_cast<int32_t>(item.first)] = item.second.info;
+    }
+  }
+  return updates;
+}
+
+}} // facebook::fboss
@@ -0,0 +1,72 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+#pragma once
+
+#include <chrono>
+#include <map>
+#include <mutex>
+
+#include <folly/futures/Future.h>
+#include <folly/futures/SharedPromise.h>
+
+#include "fboss/agent/types.h"
+#include "fboss/qsfp_service/if/gen-cpp2/transceiver_types.h"
+
+namespace facebook { namespace fboss {
+
+/*
+ * Keeps the latest TransceiverInfo of every transceiver, numbered by the
+ * order they changed in, for the getTransceiverUpdates() thrift call.
+ *
+ * Every change gets the next sequence number.  A client hands back the
+ * sequence of the updates it got last, and gets every transceiver that
+ * changed since, or waits for the next change.  Only the latest info of a
+ * transceiver is kept, so a client that falls behind gets each transceiver
+ * once, as it is now.
+ */
+class TransceiverUpdatePublisher {
+ public:
+  TransceiverUpdatePublisher() {}
+
+  /*
+   * Record the info of a transceiver after a refresh.  Returns whether it
+   * changed, not counting when it was collected.
+   */
+  bool update(TransceiverID id, TransceiverInfo info);
+
+  /*
+   * The transceivers that changed after sinceSequence, as soon as there is
+   * one, or none once maxWait is over.
+   */
+  folly::Future<TransceiverUpdates> getUpdates(
+      int64_t sinceSequence, std::chrono::milliseconds maxWait);
+
+ private:
+  struct Entry {
+    int64_t sequence{0};
+    TransceiverInfo info;
+  };
+
+  // Forbidden copy constructor and assignment operator
+  TransceiverUpdatePublisher(TransceiverUpdatePublisher const &) = delete;
+  TransceiverUpdatePublisher& operator=(
+      TransceiverUpdatePublisher const &) = delete;
+
+  // Must be called with lock_ held
+  TransceiverUpdates collectLocked(int64_t sinceSequence) const;
+
+  mutable std::mutex lock_;
+  int64_t sequence_{0};
+  std::map<TransceiverID, Entry> latest_;
+  // Fulfilled, and replaced, on every change
+  folly::SharedPromise<folly::Unit> changed_;
+};
+
+}} // facebook::fboss
@@ -36,4 +36,15 @@ service QsfpService extends fb303.FacebookService {
   map<i32, transceiver.TransceiverInfo> syncPorts(1: map<i32, ctrl.PortStatus> ports)
     throws (1: fboss.FbossBaseError error)
 
+  /*
+   * Return the transceivers that changed after sinceSequence, waiting up to
+   * maxWaitMs for one to if none did yet.  Asking again with the sequence
+   * returned gets the next changes, so a client can follow every change
+   * without polling all of the transceivers.  A sinceSequence of 0, or one
+   * ahead of the service (e.g. from before it restarted), gets them all.
+   */
+  transceiver.TransceiverUpdates getTransceiverUpdates(
+      1: i64 sinceSequence, 2: i32 maxWaitMs)
+    throws (1: fboss.FbossBaseError error)
+
 }
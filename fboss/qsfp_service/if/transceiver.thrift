@@ -148,6 +148,16 @@ struct TransceiverInfo {
   10: optional Cable cable,
   12: list<Channel> channels,
   13: optional TransceiverSettings settings,
+  // When the data was read, in seconds since the epoch
+  14: optional i64 timeCollected,
+}
+
+struct TransceiverUpdates {
+  // The sequence number of the latest change, to ask for the updates
+  // after it next
+  1: i64 sequence,
+  // The transceivers that changed, each as of its latest change
+  2: map<i32, TransceiverInfo> changed,
 }
 
 typedef binary (cpp2.type = "folly::IOBuf") IOBuf
@@ -162,4 +172,6 @@ struct RawDOMData {
   1: IOBuf lower,
   2: IOBuf page0,
   3: optional IOBuf page3,
+  // When the data was read, in seconds since the epoch
+  4: optional i64 timeCollected,
 }
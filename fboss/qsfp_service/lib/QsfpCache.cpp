@@ -18,6 +18,10 @@ namespace facebook { namespace fboss {
 
 namespace {
 constexpr std::chrono::seconds kLivenessCheckInterval(30);
+// How long qsfp_service may wait for transceivers to change before
+// answering, and how long to wait before asking again after an error
+constexpr std::chrono::milliseconds kUpdateWait(30000);
+constexpr std::chrono::milliseconds kUpdateRetryInterval(5000);
 }
 
 void QsfpCache::init(folly::EventBase* evb, const PortMapThrift& ports) {
@@ -37,6 +41,7 @@ void QsfpCache::init(folly::EventBase* evb, const PortMapThrift& ports) {
   attachEventBase(evb);
   scheduleTimeout(kLivenessCheckInterval);
 
+  folly::via(evb_).then(&QsfpCache::watchUpdates, this);
 }
 
 void QsfpCache::init(folly::EventBase* evb) {
@@ -132,6 +137,39 @@ folly::Future<folly::Unit> QsfpCache::confirmAlive() {
     .then(storeIt);
 }
 
+void QsfpCache::watchUpdates() {
+  CHECK(evb_->isInEventBaseThread());
+
+  auto getUpdates = [since = updateSequence_](
+                        std::unique_ptr<QsfpServiceAsyncClient> client) {
+    auto options = QsfpClient::getRpcOptions();
+    // qsfp_service may hold on to the request for up to kUpdateWait
+    options.setTimeout(options.getTimeout() + kUpdateWait);
+    return client->future_getTransceiverUpdates(
+        options, since, kUpdateWait.count());
+  };
+  auto onUpdates = [this](TransceiverUpdates&& updates) {
+    XLOG(DBG3) << "Got " << updates.changed.size()
+               << " changed transceivers from qsfp_service, sequence "
+               << updates.sequence;
+    this->updateCache(updates.changed);
+    updateSequence_ = updates.sequence;
+    this->watchUpdates();
+  };
+
+  QsfpClient::createClient(evb_)
+      .then(evb_, getUpdates)
+      .then(evb_, onUpdates)
+      .onError([this](const std::exception& e) {
+        XLOG(ERR) << "Exception getting transceiver updates from "
+                  << "qsfp_service: " << e.what();
+        // qsfp_service may have restarted, so get all of them again
+        updateSequence_ = 0;
+        evb_->runAfterDelay(
+            [this]() { this->watchUpdates(); }, kUpdateRetryInterval.count());
+      });
+}
+
 folly::Future<folly::Unit> QsfpCache::doSync(PortMapThrift&& toSync) {
   CHECK(evb_->isInEventBaseThread());
 
@@ -179,6 +217,13 @@ void QsfpCache::updateCache(const TcvrMapThrift& tcvrs) {
       lockedTcvrs[TransceiverID(item.first)] = item.second;
     }
   });
+  if (transceiversChanged_ && !tcvrs.empty()) {
+    std::vector<TransceiverID> changed;
+    for (const auto& item : tcvrs) {
+      changed.push_back(TransceiverID(item.first));
+    }
+    transceiversChanged_(changed);
+  }
 }
 
 folly::Optional<TransceiverInfo> QsfpCache::getIf(TransceiverID tcvrId) {
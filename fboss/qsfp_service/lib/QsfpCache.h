@@ -10,7 +10,9 @@
 #pragma once
 
 #include <atomic>
+#include <functional>
 #include <mutex>
+#include <vector>
 
 #include <boost/container/flat_map.hpp>
 #include <folly/futures/SharedPromise.h>
@@ -58,6 +60,15 @@
  * and store the last aliveSince. If this changes, we reset remoteGen_
  * back to zero so we will re-sync all ports.
  *
+ * Following transceiver changes
+ * ------------------------------
+ * syncPorts only returns transceivers when ports change.  To see every
+ * other change too (alarms, modules going in or out) within a refresh of
+ * qsfp_service, we always keep a getTransceiverUpdates call outstanding.
+ * It returns as soon as any transceiver changes, with just the ones that
+ * did, and the sequence number to ask for the next changes with.  On any
+ * error we start over from sequence 0, which gets every transceiver.
+ *
  * Threading model
  * ---------------
  * All thrift calls to qsfp_service are done on evb_. No guarantee for
@@ -112,6 +123,16 @@ class QsfpCache : private folly::AsyncTimeout {
   // output state of the cache. Useful for debugging
   void dump();
 
+  /*
+   * Called on the evb with the transceivers that changed, whenever we
+   * hear of changes from qsfp_service.  Set before init.
+   */
+  using TransceiversChangedCallback =
+      std::function<void(const std::vector<TransceiverID>&)>;
+  void setTransceiversChangedCallback(TransceiversChangedCallback callback) {
+    transceiversChanged_ = std::move(callback);
+  }
+
  private:
   // Forbidden copy constructor and assignment operator
   QsfpCache(QsfpCache const &) = delete;
@@ -127,6 +148,11 @@ class QsfpCache : private folly::AsyncTimeout {
   // actually does a syncPorts call to qsfp_service
   folly::Future<folly::Unit> doSync(PortMapThrift&& portsToSync);
 
+  /* Waits for transceivers to change on qsfp_service, updates the cache
+   * with them, and then waits for the next changes.
+   */
+  void watchUpdates();
+
   // checks qsfp_service is alive and detects restarts
   folly::Future<folly::Unit> confirmAlive();
 
@@ -158,7 +184,12 @@ class QsfpCache : private folly::AsyncTimeout {
   // last aliveSince from qsfp_service
   int64_t remoteAliveSince_{-1};
 
+  // sequence of the last transceiver updates we got from qsfp_service
+  int64_t updateSequence_{0};
+
   std::atomic_bool initialized_{false};
+
+  TransceiversChangedCallback transceiversChanged_;
 };
 
 }} // facebook::fboss
@@ -26,4 +26,30 @@ void StatsPublisher::bumpWriteFailure() {
 //static
 void StatsPublisher::missingPorts(TransceiverID /* unused */) {
 }
+// static
+void StatsPublisher::moduleRefreshLatency(
+    TransceiverID /* unused */, std::chrono::milliseconds /* unused */) {
+}
+// static
+void StatsPublisher::refreshCycleLatency(
+    std::chrono::milliseconds /* unused */) {
+}
+// static
+void StatsPublisher::customizeBatchLatency(
+    int /* unused */, std::chrono::milliseconds /* unused */) {
+}
+// static
+void StatsPublisher::presenceChangeLatency(
+    TransceiverID /* unused */, std::chrono::milliseconds /* unused */) {
+}
+// static
+void StatsPublisher::i2cTransactionLatency(
+    folly::StringPiece /* unused */, std::chrono::microseconds /* unused */) {
+}
+// static
+void StatsPublisher::i2cTransactionBytes(uint64_t /* unused */) {
+}
+// static
+void StatsPublisher::muxSelectsSaved(uint64_t /* unused */) {
+}
 }}
@@ -10,16 +10,140 @@
 #include "fboss/qsfp_service/platforms/wedge/WedgeI2CBusLock.h"
 #include "fboss/lib/usb/UsbError.h"
 
+#include <gflags/gflags.h>
+
 #include "fboss/qsfp_service/StatsPublisher.h"
 
+DEFINE_int32(
+    i2c_critical_deadline_ms,
+    10,
+    "how long a critical I2C transaction waits before going first");
+DEFINE_int32(
+    i2c_interactive_deadline_ms,
+    100,
+    "how long an interactive I2C transaction waits before going first");
+DEFINE_int32(
+    i2c_background_deadline_ms,
+    2000,
+    "how long a background I2C transaction waits before going first");
+
 using folly::MutableByteRange;
 using std::lock_guard;
+using std::chrono::steady_clock;
 
 namespace facebook { namespace fboss {
 
+namespace {
+
+thread_local I2CPriority threadPriority = I2CPriority::BACKGROUND;
+
+std::chrono::milliseconds getDeadline(I2CPriority priority) {
+  switch (priority) {
+    case I2CPriority::CRITICAL:
+      return std::chrono::milliseconds(FLAGS_i2c_critical_deadline_ms);
+    case I2CPriority::INTERACTIVE:
+      return std::chrono::milliseconds(FLAGS_i2c_interactive_deadline_ms);
+    case I2CPriority::BACKGROUND:
+      break;
+  }
+  return std::chrono::milliseconds(FLAGS_i2c_background_deadline_ms);
+}
+
+} // unnamed namespace
+
+folly::StringPiece i2cPriorityName(I2CPriority priority) {
+  switch (priority) {
+    case I2CPriority::CRITICAL:
+      return "critical";
+    case I2CPriority::INTERACTIVE:
+      return "interactive";
+    case I2CPriority::BACKGROUND:
+      break;
+  }
+  return "background";
+}
+
+I2CPriorityScope::I2CPriorityScope(I2CPriority priority)
+    : previous_(threadPriority) {
+  threadPriority = priority;
+}
+
+I2CPriorityScope::~I2CPriorityScope() {
+  threadPriority = previous_;
+}
+
+I2CPriority I2CPriorityScope::current() {
+  return threadPriority;
+}
+
+bool WedgeI2CBusLock::Waiter::goesBefore(
+    const Waiter& other, steady_clock::time_point now) const {
+  auto overdue = deadline <= now;
+  if (overdue != (other.deadline <= now)) {
+    return overdue;
+  }
+  if (overdue && deadline != other.deadline) {
+    // Whoever should have had the bus first
+    return deadline < other.deadline;
+  }
+  if (!overdue && priority != other.priority) {
+    return priority < other.priority;
+  }
+  return sequence < other.sequence;
+}
+
 WedgeI2CBusLock::WedgeI2CBusLock(std::unique_ptr<BaseWedgeI2CBus> wedgeI2CBus)
     : wedgeI2CBus_(std::move(wedgeI2CBus)) {}
 
+void WedgeI2CBusLock::acquire(I2CPriority priority) {
+  std::unique_lock<std::mutex> g(waitMutex_);
+  if (!busy_ && waiters_.empty()) {
+    busy_ = true;
+    owner_ = std::this_thread::get_id();
+    return;
+  }
+
+  Waiter waiter;
+  waiter.priority = priority;
+  waiter.deadline = steady_clock::now() + getDeadline(priority);
+  waiter.sequence = nextSequence_++;
+  waiters_.push_back(&waiter);
+  // release() hands the bus over, and takes us off waiters_
+  waitCV_.wait(g, [&] { return waiter.granted; });
+  owner_ = std::this_thread::get_id();
+}
+
+void WedgeI2CBusLock::release() {
+  lock_guard<std::mutex> g(waitMutex_);
+  owner_ = std::thread::id();
+  if (waiters_.empty()) {
+    busy_ = false;
+    return;
+  }
+
+  auto now = steady_clock::now();
+  auto next = waiters_.begin();
+  for (auto it = next + 1; it != waiters_.end(); ++it) {
+    if ((*it)->goesBefore(**next, now)) {
+      next = it;
+    }
+  }
+  // The bus stays busy, it just changes hands
+  (*next)->granted = true;
+  waiters_.erase(next);
+  waitCV_.notify_all();
+}
+
+bool WedgeI2CBusLock::heldByThisThread() const {
+  lock_guard<std::mutex> g(waitMutex_);
+  return busy_ && owner_ == std::this_thread::get_id();
+}
+
+size_t WedgeI2CBusLock::numWaiting() const {
+  lock_guard<std::mutex> g(waitMutex_);
+  return waiters_.size();
+}
+
 void WedgeI2CBusLock::openLocked() {
   StatsPublisher::bumpPciLockHeld();
   wedgeI2CBus_->open();
@@ -27,8 +151,18 @@ void WedgeI2CBusLock::openLocked() {
 }
 
 void WedgeI2CBusLock::open() {
-  lock_guard<std::mutex> g(busMutex_);
-  openLocked();
+  if (heldByThisThread()) {
+    openLocked();
+    return;
+  }
+  acquire(I2CPriorityScope::current());
+  try {
+    openLocked();
+  } catch (...) {
+    release();
+    throw;
+  }
+  release();
 }
 
 void WedgeI2CBusLock::closeLocked() {
@@ -37,8 +171,18 @@ void WedgeI2CBusLock::closeLocked() {
 }
 
 void WedgeI2CBusLock::close() {
-  lock_guard<std::mutex> g(busMutex_);
-  closeLocked();
+  if (heldByThisThread()) {
+    closeLocked();
+    return;
+  }
+  acquire(I2CPriorityScope::current());
+  try {
+    closeLocked();
+  } catch (...) {
+    release();
+    throw;
+  }
+  release();
 }
 
 void WedgeI2CBusLock::moduleRead(unsigned int module, uint8_t address,
@@ -65,4 +209,46 @@ void WedgeI2CBusLock::write(uint8_t address, int offset,
   wedgeI2CBus_->write(address, offset, len, buf);
 }
 
+WedgeI2CBusLock::BusGuard::BusGuard(WedgeI2CBusLock* busLock)
+    : busLock_(busLock),
+      priority_(I2CPriorityScope::current()),
+      start_(steady_clock::now()),
+      nested_(busLock->heldByThisThread()) {
+  if (nested_) {
+    return;
+  }
+  busLock_->acquire(priority_);
+  startCounters_ = busLock_->wedgeI2CBus_->getCounters();
+  if (!busLock_->opened_) {
+    try {
+      busLock_->openLocked();
+    } catch (...) {
+      busLock_->release();
+      throw;
+    }
+    performedOpen_ = true;
+  }
+}
+
+WedgeI2CBusLock::BusGuard::~BusGuard() {
+  if (nested_) {
+    return;
+  }
+  if (performedOpen_) {
+    busLock_->closeLocked();
+  }
+  const auto& counters = busLock_->wedgeI2CBus_->getCounters();
+  auto bytes = counters.bytesRead - startCounters_.bytesRead +
+      counters.bytesWritten - startCounters_.bytesWritten;
+  auto selectsSaved = counters.muxSelectsSaved - startCounters_.muxSelectsSaved;
+  busLock_->release();
+
+  StatsPublisher::i2cTransactionLatency(
+      i2cPriorityName(priority_),
+      std::chrono::duration_cast<std::chrono::microseconds>(
+          steady_clock::now() - start_));
+  StatsPublisher::i2cTransactionBytes(bytes);
+  StatsPublisher::muxSelectsSaved(selectsSaved);
+}
+
 }} // facebook::fboss
@@ -11,14 +11,56 @@
 
 #include "fboss/lib/usb/BaseWedgeI2CBus.h"
 
+#include <chrono>
+#include <condition_variable>
 #include <mutex>
+#include <thread>
+#include <vector>
 #include <folly/Range.h>
 
 namespace facebook { namespace fboss {
 
+/*
+ * Which transactions get the bus first, when several threads want it.
+ */
+enum class I2CPriority : uint8_t {
+  // Presence detection, and the writes that bring links up
+  CRITICAL,
+  // What a thrift call is waiting on
+  INTERACTIVE,
+  // Periodic DOM polling
+  BACKGROUND,
+};
+
+folly::StringPiece i2cPriorityName(I2CPriority priority);
+
+/*
+ * Sets the priority of the I2C transactions this thread issues while it is
+ * in scope.  Threads start out at BACKGROUND.
+ */
+class I2CPriorityScope {
+ public:
+  explicit I2CPriorityScope(I2CPriority priority);
+  ~I2CPriorityScope();
+
+  static I2CPriority current();
+
+ private:
+  // Forbidden copy constructor and assignment operator
+  I2CPriorityScope(I2CPriorityScope const &) = delete;
+  I2CPriorityScope& operator=(I2CPriorityScope const &) = delete;
+
+  const I2CPriority previous_;
+};
+
 /*
  * A small wrapper around CP2112 which is aware of the topology of wedge's QSFP
  * I2C bus, and can select specific QSFPs to query.
+ *
+ * Threads waiting for the bus are handed it in order of the priority of
+ * their transaction, and then of arrival.  Every priority also has a
+ * deadline: once a transaction has waited longer than that, it goes before
+ * any that hasn't, so background polling is delayed but never starved.
  */
 class WedgeI2CBusLock {
  public:
@@ -32,49 +74,76 @@ class WedgeI2CBusLock {
   void read(uint8_t i2cAddress, int offset, int len, uint8_t* buf);
   void write(uint8_t i2cAddress, int offset, int len, const uint8_t* buf);
 
- private:
-  // Forbidden copy constructor and assignment operator
-  WedgeI2CBusLock(WedgeI2CBusLock const &) = delete;
-  WedgeI2CBusLock& operator=(WedgeI2CBusLock const &) = delete;
-
-  void openLocked();
-  void closeLocked();
-
-  std::unique_ptr<BaseWedgeI2CBus> wedgeI2CBus_{nullptr};
-  mutable std::mutex busMutex_;
-  bool opened_{false};
+  /*
+   * The number of transactions waiting for the bus.
+   */
+  size_t numWaiting() const;
 
   class BusGuard {
     /* This class is a simple guard that:
-       1. locks access to the device
+       1. waits for its turn on the device, at the priority of the thread
        2. opens/closes the device if it is not already open
+       3. reports how long the transaction took, waiting included, and how
+          much it moved
 
        This makes sure that only one person is accessing the device,
        but allows us to only open the device once in the case of batch
-       read/writes.
+       read/writes: a thread can hold one around a batch, and the
+       transactions in it go straight to the device, which stays open and
+       remembers which module is selected.
     */
    public:
-    explicit BusGuard(WedgeI2CBusLock* busLock) :
-        busLock_(busLock),
-        lock_(busLock->busMutex_)
-      {
-        if (!busLock_->opened_) {
-          busLock_->openLocked();
-          performedOpen_ = true;
-        }
-      }
-
-    ~BusGuard() {
-      if (performedOpen_) {
-        busLock_->closeLocked();
-      }
-    }
+    explicit BusGuard(WedgeI2CBusLock* busLock);
+    ~BusGuard();
 
    private:
+    // Forbidden copy constructor and assignment operator
+    BusGuard(BusGuard const &) = delete;
+    BusGuard& operator=(BusGuard const &) = delete;
+
     WedgeI2CBusLock* busLock_{nullptr};
+    const I2CPriority priority_;
+    const std::chrono::steady_clock::time_point start_;
+    // Whether this thread already had the bus, from an outer guard
+    bool nested_{false};
     bool performedOpen_{false};
-    std::lock_guard<std::mutex> lock_;
+    BaseWedgeI2CBus::Counters startCounters_;
   };
+
+ private:
+  struct Waiter {
+    bool goesBefore(const Waiter& other,
+                    std::chrono::steady_clock::time_point now) const;
+
+    I2CPriority priority;
+    std::chrono::steady_clock::time_point deadline;
+    uint64_t sequence;
+    bool granted{false};
+  };
+
+  // Forbidden copy constructor and assignment operator
+  WedgeI2CBusLock(WedgeI2CBusLock const &) = delete;
+  WedgeI2CBusLock& operator=(WedgeI2CBusLock const &) = delete;
+
+  // Wait until this thread has the bus to itself, and give it up again
+  void acquire(I2CPriority priority);
+  void release();
+  bool heldByThisThread() const;
+
+  void openLocked();
+  void closeLocked();
+
+  std::unique_ptr<BaseWedgeI2CBus> wedgeI2CBus_{nullptr};
+  bool opened_{false};
+
+  // Who has the bus, and who is waiting for it
+  mutable std::mutex waitMutex_;
+  std::condition_variable waitCV_;
+  bool busy_{false};
+  std::thread::id owner_;
+  std::vector<Waiter*> waiters_;
+  uint64_t nextSequence_{0};
+
 };
 
 }} // facebook::fboss
@@ -1,9 +1,18 @@
 #include "fboss/qsfp_service/platforms/wedge/WedgeManager.h"
 
+#include <folly/Optional.h>
 #include <folly/gen/Base.h>
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <numeric>
+
 #include <folly/logging/xlog.h>
+#include "fboss/agent/FbossError.h"
 #include "fboss/lib/usb/UsbError.h"
+#include "fboss/qsfp_service/StatsPublisher.h"
 #include "fboss/qsfp_service/platforms/wedge/WedgeQsfp.h"
 #include "fboss/qsfp_service/sff/QsfpModule.h"
 
@@ -16,7 +25,10 @@ void WedgeManager::initTransceiverMap() {
   // create the QSFP objects;  this is likely to be a permanent
   // error.
   try {
-    wedgeI2CBusLock_ = std::make_unique<WedgeI2CBusLock>(getI2CBus());
+    for (int bus = 0; bus < getNumI2CBuses(); bus++) {
+      wedgeI2CBusLocks_.push_back(
+          std::make_unique<WedgeI2CBusLock>(createI2CBus(bus)));
+    }
   } catch (const LibusbError& ex) {
     XLOG(ERR) << "failed to initialize USB to I2C interface";
     return;
@@ -25,7 +37,8 @@ void WedgeManager::initTransceiverMap() {
   // Wedge port 0 is the CPU port, so the first port associated with
   // a QSFP+ is port 1.  We start the transceiver IDs with 0, though.
   for (int idx = 0; idx < getNumQsfpModules(); idx++) {
-    auto qsfpImpl = std::make_unique<WedgeQsfp>(idx, wedgeI2CBusLock_.get());
+    auto qsfpImpl = std::make_unique<WedgeQsfp>(
+        idx, wedgeI2CBusLocks_.at(getI2CBusIndex(idx)).get());
     auto qsfp = std::make_unique<QsfpModule>(
         std::move(qsfpImpl), numPortsPerTransceiver());
     qsfp->refresh();
@@ -87,19 +100,144 @@ void WedgeManager::syncPorts(
       })
     | folly::gen::as<std::vector>();
 
+  std::vector<int> synced;
   for (auto& group : groups) {
     int32_t transceiverIdx = group.key();
     XLOG(INFO) << "Syncing ports of transceiver " << transceiverIdx;
 
-    auto transceiver = transceivers_.at(transceiverIdx).get();
-    transceiver->transceiverPortsChanged(group.values());
-    info[transceiverIdx] = transceiver->getTransceiverInfo();
+    transceivers_.at(transceiverIdx)->transceiverPortsChanged(group.values());
+    synced.push_back(transceiverIdx);
+  }
+
+  // Customize all of the modules whose ports changed in one go, rather than
+  // leaving each for the next refresh cycle
+  customizeTransceivers(synced);
+
+  for (auto idx : synced) {
+    info[idx] = transceivers_[idx]->getTransceiverInfo();
+    updates_.update(TransceiverID(idx), info[idx]);
+  }
+}
+
+void WedgeManager::customizeTransceivers(const std::vector<int>& modules) {
+  auto start = std::chrono::steady_clock::now();
+  std::atomic<int> customized{0};
+  forEachModuleByBus(modules, [this, &customized](int idx) {
+    if (transceivers_[idx]->customizeIfWanted()) {
+      ++customized;
+    }
+  });
+  if (customized == 0) {
+    return;
   }
+
+  auto latency = std::chrono::duration_cast<std::chrono::milliseconds>(
+      std::chrono::steady_clock::now() - start);
+  XLOG(INFO) << "Customized " << customized.load() << " of "
+             << modules.size() << " transceivers in " << latency.count()
+             << "ms";
+  StatsPublisher::customizeBatchLatency(customized.load(), latency);
 }
 
 void WedgeManager::refreshTransceivers() {
-  for (const auto& transceiver : transceivers_) {
-    transceiver->refresh();
+  auto start = std::chrono::steady_clock::now();
+
+  std::vector<int> modules(transceivers_.size());
+  std::iota(modules.begin(), modules.end(), 0);
+  forEachModuleByBus(modules, [this](int idx) {
+    auto moduleStart = std::chrono::steady_clock::now();
+    transceivers_[idx]->refresh();
+    StatsPublisher::moduleRefreshLatency(
+        TransceiverID(idx),
+        std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - moduleStart));
+    publishUpdate(idx);
+  });
+
+  auto latency = std::chrono::duration_cast<std::chrono::milliseconds>(
+      std::chrono::steady_clock::now() - start);
+  XLOG(DBG2) << "Refreshed " << transceivers_.size() << " transceivers on "
+             << getNumI2CBuses() << " buses in " << latency.count() << "ms";
+  StatsPublisher::refreshCycleLatency(latency);
+}
+
+void WedgeManager::forEachModuleByBus(
+    const std::vector<int>& modules, const std::function<void(int)>& fn) {
+  std::vector<std::vector<int>> buses(getNumI2CBuses());
+  for (auto idx : modules) {
+    buses.at(getI2CBusIndex(idx)).push_back(idx);
+  }
+
+  // The first bus is handled on this thread, every other one on a thread
+  // of its own
+  std::vector<std::future<void>> runs;
+  for (int bus = 1; bus < buses.size(); bus++) {
+    if (!buses[bus].empty()) {
+      runs.push_back(std::async(std::launch::async, [this, &buses, bus, &fn] {
+        runOnBus(buses[bus], fn);
+      }));
+    }
+  }
+  runOnBus(buses.front(), fn);
+  for (auto& run : runs) {
+    run.wait();
+  }
+  for (auto& run : runs) {
+    run.get();
+  }
+}
+
+void WedgeManager::refreshPresenceChanges() {
+  // Checking presence is a single byte read per module, cheap enough to do
+  // much more often than a refresh cycle
+  for (int idx = 0; idx < transceivers_.size(); idx++) {
+    auto start = std::chrono::steady_clock::now();
+    if (!transceivers_[idx]->refreshIfPresenceChanged()) {
+      continue;
+    }
+    auto latency = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - start);
+    XLOG(INFO) << "Presence of transceiver " << idx
+               << " changed, refreshed it in " << latency.count() << "ms";
+    StatsPublisher::presenceChangeLatency(TransceiverID(idx), latency);
+    publishUpdate(idx);
+  }
+}
+
+folly::Future<TransceiverUpdates> WedgeManager::getTransceiverUpdates(
+    int64_t sinceSequence, std::chrono::milliseconds maxWait) {
+  return updates_.getUpdates(sinceSequence, maxWait);
+}
+
+void WedgeManager::publishUpdate(int idx) {
+  try {
+    updates_.update(
+        TransceiverID(idx), transceivers_[idx]->getTransceiverInfo());
+  } catch (const FbossError& ex) {
+    // Not refreshed successfully yet, so there is nothing to tell
+    XLOG(DBG2) << "No info for transceiver " << idx << ": " << ex.what();
+  }
+}
+
+void WedgeManager::runOnBus(
+    std::vector<int> modules, const std::function<void(int)>& fn) {
+  // Going in order keeps neighbouring modules, which sit on the same
+  // PCA9548 branch, next to each other, so that only the last channel of
+  // the path needs to change between them
+  std::sort(modules.begin(), modules.end());
+  for (auto idx : modules) {
+    // Hold on to the bus for all of the module's transactions, so that it
+    // is opened, and the module selected, once rather than for each
+    folly::Optional<WedgeI2CBusLock::BusGuard> batch;
+    if (!wedgeI2CBusLocks_.empty()) {
+      try {
+        batch.emplace(wedgeI2CBusLocks_.at(getI2CBusIndex(idx)).get());
+      } catch (const UsbError& ex) {
+        XLOG(DBG2) << "Failed to open the bus of transceiver " << idx
+                   << ": " << ex.what();
+      }
+    }
+    fn(idx);
   }
 }
 
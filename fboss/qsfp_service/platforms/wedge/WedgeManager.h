@@ -2,7 +2,11 @@
 
 #include <boost/container/flat_map.hpp>
 
+#include <functional>
+#include <vector>
+
 #include "fboss/lib/usb/WedgeI2CBus.h"
+#include "fboss/qsfp_service/TransceiverUpdatePublisher.h"
 #include "fboss/qsfp_service/platforms/wedge/WedgeI2CBusLock.h"
 #include "fboss/qsfp_service/TransceiverManager.h"
 
@@ -31,14 +35,53 @@ class WedgeManager : public TransceiverManager {
     return 4;
   }
   void refreshTransceivers() override;
+  void refreshPresenceChanges() override;
+  folly::Future<TransceiverUpdates> getTransceiverUpdates(
+    int64_t sinceSequence, std::chrono::milliseconds maxWait) override;
 
  protected:
   virtual std::unique_ptr<BaseWedgeI2CBus> getI2CBus();
-  std::unique_ptr<WedgeI2CBusLock> wedgeI2CBusLock_;
+
+  /*
+   * The number of independent I2C buses (i.e. CP2112s) the QSFPs are
+   * behind, and which one each module is on.  Every bus gets a
+   * WedgeI2CBusLock of its own, and the modules of different buses are
+   * refreshed concurrently.  All of our platforms have a single bus.
+   */
+  virtual int getNumI2CBuses() {
+    return 1;
+  }
+  virtual int getI2CBusIndex(int /* module */) {
+    return 0;
+  }
+  virtual std::unique_ptr<BaseWedgeI2CBus> createI2CBus(int /* bus */) {
+    return getI2CBus();
+  }
+
+  std::vector<std::unique_ptr<WedgeI2CBusLock>> wedgeI2CBusLocks_;
 
  private:
+  /*
+   * Customize the modules that want it, right away and back to back.  See
+   * Transceiver::customizeIfWanted().
+   */
+  void customizeTransceivers(const std::vector<int>& modules);
+
+  /*
+   * Call fn for each of the modules, with the bus held for the module.
+   * The modules of each bus are handled in order, one after another, and
+   * different buses concurrently.
+   */
+  void forEachModuleByBus(
+      const std::vector<int>& modules, const std::function<void(int)>& fn);
+  void runOnBus(std::vector<int> modules, const std::function<void(int)>& fn);
+  // Hand the info of a transceiver to updates_, once it was refreshed
+  void publishUpdate(int idx);
+
   // Forbidden copy constructor and assignment operator
   WedgeManager(WedgeManager const &) = delete;
   WedgeManager& operator=(WedgeManager const &) = delete;
+
+  TransceiverUpdatePublisher updates_;
 };
 }} // facebook::fboss
@@ -37,6 +37,8 @@ WedgeQsfp::~WedgeQsfp() {
 // assumes that QSFP module numbers extend from 1 to 16.
 //
 bool WedgeQsfp::detectTransceiver() {
+  // Link bring up waits on knowing what is plugged in
+  I2CPriorityScope priority(I2CPriority::CRITICAL);
   uint8_t buf[1];
   try {
     wedgeI2CBusLock_->moduleRead(module_ + 1, TransceiverI2CApi::ADDR_QSFP,
@@ -69,6 +71,8 @@ int WedgeQsfp::readTransceiver(int dataAddress, int offset,
 
 int WedgeQsfp::writeTransceiver(int dataAddress, int offset,
                             int len, uint8_t* fieldValue) {
+  // Writes are few, and what turns TX on and links up
+  I2CPriorityScope priority(I2CPriority::CRITICAL);
   try {
     wedgeI2CBusLock_->moduleWrite(module_ + 1, dataAddress, offset, len,
                                    fieldValue);
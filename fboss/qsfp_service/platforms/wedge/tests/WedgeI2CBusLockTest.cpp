@@ -0,0 +1,175 @@
+/*
+ *  Copyright (c) 2004-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under the BSD-style license found in the
+ *  LICENSE file in the root directory of this source tree. An additional grant
+ *  of patent rights can be found in the PATENTS file in the same directory.
+ *
+ */
+
+#include "fboss/qsfp_service/platforms/wedge/WedgeI2CBusLock.h"
+
+#include <gflags/gflags.h>
+#include <gtest/gtest.h>
+
+#include <future>
+#include <thread>
+#include <vector>
+
+DECLARE_int32(i2c_background_deadline_ms);
+
+using namespace facebook::fboss;
+
+namespace {
+
+class NullCP2112 : public CP2112Intf {
+ public:
+  void open(bool /* setSmbusConfig */) override {}
+  void close() override {}
+  void resetDevice() override {}
+  void read(uint8_t, folly::MutableByteRange, std::chrono::milliseconds)
+      override {}
+  void write(uint8_t, folly::ByteRange, std::chrono::milliseconds)
+      override {}
+  std::chrono::milliseconds getDefaultTimeout() const override {
+    return std::chrono::milliseconds(500);
+  }
+};
+
+// Remembers the order modules were read in, and holds on to the bus while
+// reading module 1 until told to go on
+class FakeBus : public BaseWedgeI2CBus {
+ public:
+  FakeBus(std::vector<unsigned int>* reads, std::shared_future<void> go)
+      : BaseWedgeI2CBus(std::make_unique<NullCP2112>()),
+        reads_(reads),
+        go_(std::move(go)) {}
+
+  void open() override {}
+  void close() override {}
+  void moduleRead(unsigned int module, uint8_t, int, int, uint8_t*)
+      override {
+    if (module == 1) {
+      started_.set_value();
+      go_.wait();
+    }
+    reads_->push_back(module);
+  }
+
+  std::future<void> getStarted() {
+    return started_.get_future();
+  }
+
+ protected:
+  void initBus() override {}
+  void verifyBus(bool /* autoReset */) override {}
+  void selectQsfpImpl(unsigned int /* module */) override {}
+
+ private:
+  std::vector<unsigned int>* reads_;
+  std::shared_future<void> go_;
+  std::promise<void> started_;
+};
+
+class WedgeI2CBusLockTest : public ::testing::Test {
+ public:
+  void SetUp() override {
+    auto bus = std::make_unique<FakeBus>(&reads_, go_.get_future().share());
+    started_ = bus->getStarted();
+    busLock_ = std::make_unique<WedgeI2CBusLock>(std::move(bus));
+  }
+
+  // Hold the bus with a read of module 1
+  void holdBus() {
+    threads_.emplace_back([this] { read(1, I2CPriority::BACKGROUND); });
+    started_.wait();
+  }
+
+  // Queue up a read, and wait until it is waiting for the bus
+  void queueRead(unsigned int module, I2CPriority priority) {
+    auto waiting = busLock_->numWaiting();
+    threads_.emplace_back([=] { read(module, priority); });
+    while (busLock_->numWaiting() == waiting) {
+      std::this_thread::yield();
+    }
+  }
+
+  void finish() {
+    go_.set_value();
+    for (auto& thread : threads_) {
+      thread.join();
+    }
+  }
+
+  void read(unsigned int module, I2CPriority priority) {
+    I2CPriorityScope scope(priority);
+    uint8_t buf[1];
+    busLock_->moduleRead(module, TransceiverI2CApi::ADDR_QSFP, 0, 1, buf);
+  }
+
+  std::vector<unsigned int> reads_;
+  std::unique_ptr<WedgeI2CBusLock> busLock_;
+
+ private:
+
+  std::promise<void> go_;
+  std::future<void> started_;
+  std::vector<std::thread> threads_;
+};
+
+} // unnamed namespace
+
+TEST_F(WedgeI2CBusLockTest, priorityOrder) {
+  holdBus();
+  queueRead(2, I2CPriority::BACKGROUND);
+  queueRead(3, I2CPriority::INTERACTIVE);
+  queueRead(4, I2CPriority::CRITICAL);
+  queueRead(5, I2CPriority::CRITICAL);
+  finish();
+
+  // Highest priority first, and in order within a priority
+  EXPECT_EQ((std::vector<unsigned int>{1, 4, 5, 3, 2}), reads_);
+  EXPECT_EQ(0u, busLock_->numWaiting());
+}
+
+TEST_F(WedgeI2CBusLockTest, deadline) {
+  auto deadline = FLAGS_i2c_background_deadline_ms;
+  FLAGS_i2c_background_deadline_ms = 0;
+
+  holdBus();
+  queueRead(2, I2CPriority::BACKGROUND);
+  queueRead(3, I2CPriority::INTERACTIVE);
+  finish();
+  FLAGS_i2c_background_deadline_ms = deadline;
+
+  // The background read waited past its deadline, so it went first
+  EXPECT_EQ((std::vector<unsigned int>{1, 2, 3}), reads_);
+}
+
+TEST_F(WedgeI2CBusLockTest, batch) {
+  {
+    WedgeI2CBusLock::BusGuard batch(busLock_.get());
+    // Others wait for the whole batch, whatever their priority
+    queueRead(2, I2CPriority::CRITICAL);
+    // while the reads in it go straight to the bus
+    read(3, I2CPriority::BACKGROUND);
+    read(4, I2CPriority::BACKGROUND);
+  }
+  finish();
+
+  EXPECT_EQ((std::vector<unsigned int>{3, 4, 2}), reads_);
+}
+
+TEST(I2CPriorityScopeTest, nesting) {
+  EXPECT_EQ(I2CPriority::BACKGROUND, I2CPriorityScope::current());
+  {
+    I2CPriorityScope interactive(I2CPriority::INTERACTIVE);
+    {
+      I2CPriorityScope critical(I2CPriority::CRITICAL);
+      EXPECT_EQ(I2CPriority::CRITICAL, I2CPriorityScope::current());
+    }
+    EXPECT_EQ(I2CPriority::INTERACTIVE, I2CPriorityScope::current());
+  }
+  EXPECT_EQ(I2CPriority::BACKGROUND, I2CPriorityScope::current());
+}
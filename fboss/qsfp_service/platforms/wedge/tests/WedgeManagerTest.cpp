@@ -18,6 +18,9 @@
 #include <gtest/gtest.h>
 #include <gmock/gmock.h>
 
+#include <mutex>
+#include <thread>
+
 using namespace facebook::fboss;
 using namespace ::testing;
 namespace {
@@ -37,6 +40,59 @@ class MockWedgeManager : public WedgeManager {
   std::vector<MockQsfpModule*> mockTransceivers_;
 };
 
+// Remembers which thread refreshed it
+class RefreshQsfpModule : public MockQsfpModule {
+ public:
+  RefreshQsfpModule(unsigned int portsPerTransceiver, std::mutex* lock)
+      : MockQsfpModule(nullptr, portsPerTransceiver), lock_(lock) {}
+
+  void refresh() override {
+    std::lock_guard<std::mutex> g(*lock_);
+    ++refreshes_;
+    refreshedBy_ = std::this_thread::get_id();
+  }
+  void transceiverPortsChanged(
+      const std::vector<std::pair<const int, PortStatus>>& ports) override {
+    portsChanged_ += ports.size();
+  }
+  bool customizeIfWanted() override {
+    std::lock_guard<std::mutex> g(*lock_);
+    ++customizations_;
+    return true;
+  }
+
+  int refreshes_{0};
+  std::thread::id refreshedBy_;
+  int portsChanged_{0};
+  int customizations_{0};
+
+ private:
+  std::mutex* lock_;
+};
+
+// Every other module is on a second bus
+class TwoBusWedgeManager : public WedgeManager {
+ public:
+  void makeTransceiverMap() {
+    for (int idx = 0; idx < getNumQsfpModules(); idx++) {
+      auto qsfp = std::make_unique<RefreshQsfpModule>(
+          numPortsPerTransceiver(), &lock_);
+      qsfps_.push_back(qsfp.get());
+      transceivers_.push_back(move(qsfp));
+    }
+  }
+
+  int getNumI2CBuses() override {
+    return 2;
+  }
+  int getI2CBusIndex(int module) override {
+    return module % 2;
+  }
+
+  std::mutex lock_;
+  std::vector<RefreshQsfpModule*> qsfps_;
+};
+
 class WedgeManagerTest : public ::testing::Test {
  public:
   void SetUp() override {
@@ -65,4 +121,71 @@ TEST_F(WedgeManagerTest, getTransceiverInfo) {
       std::make_unique<std::vector<int32_t>>(data));
 }
 
+TEST(WedgeManagerRefreshTest, refreshPerBus) {
+  TwoBusWedgeManager manager;
+  manager.makeTransceiverMap();
+  manager.refreshTransceivers();
+
+  // All modules of a bus were refreshed by the same thread, and the two
+  // buses by different ones
+  const auto& qsfps = manager.qsfps_;
+  for (int idx = 0; idx < qsfps.size(); idx++) {
+    EXPECT_EQ(1, qsfps[idx]->refreshes_);
+    EXPECT_EQ(qsfps[idx % 2]->refreshedBy_, qsfps[idx]->refreshedBy_);
+  }
+  EXPECT_EQ(std::this_thread::get_id(), qsfps[0]->refreshedBy_);
+  EXPECT_NE(qsfps[0]->refreshedBy_, qsfps[1]->refreshedBy_);
+}
+
+TEST(WedgeManagerRefreshTest, syncPortsCustomizes) {
+  TwoBusWedgeManager manager;
+  manager.makeTransceiverMap();
+
+  auto ports = std::make_unique<std::map<int32_t, PortStatus>>();
+  for (int32_t port = 0; port < 6; port++) {
+    // Two ports each for transceivers 2, 3 and 4
+    auto& status = (*ports)[port];
+    status.transceiverIdx.transceiverId = 2 + port / 2;
+    status.__isset.transceiverIdx = true;
+  }
+  std::map<int32_t, TransceiverInfo> info;
+  manager.syncPorts(info, std::move(ports));
+
+  // All of the ports are known before any transceiver is customized
+  const auto& qsfps = manager.qsfps_;
+  for (int idx = 0; idx < qsfps.size(); idx++) {
+    auto synced = idx >= 2 && idx <= 4;
+    EXPECT_EQ(synced ? 2 : 0, qsfps[idx]->portsChanged_);
+    EXPECT_EQ(synced ? 1 : 0, qsfps[idx]->customizations_);
+  }
+  EXPECT_EQ(3u, info.size());
+}
+
+TEST(WedgeManagerRefreshTest, transceiverUpdates) {
+  TwoBusWedgeManager manager;
+  manager.makeTransceiverMap();
+  manager.refreshTransceivers();
+  auto noWait = std::chrono::milliseconds(0);
+
+  // Every transceiver is new after the first refresh
+  auto updates = manager.getTransceiverUpdates(0, noWait).get();
+  EXPECT_EQ(manager.qsfps_.size(), updates.changed.size());
+
+  // and only those that changed are handed out after that
+  TransceiverInfo present;
+  present.present = true;
+  EXPECT_CALL(*manager.qsfps_[3], getTransceiverInfo())
+      .WillRepeatedly(Return(present));
+  manager.refreshTransceivers();
+  auto next = manager.getTransceiverUpdates(updates.sequence, noWait).get();
+  EXPECT_EQ(updates.sequence + 1, next.sequence);
+  ASSERT_EQ(1u, next.changed.size());
+  EXPECT_TRUE(next.changed[3].present);
+
+  manager.refreshTransceivers();
+  auto last = manager.getTransceiverUpdates(next.sequence, noWait).get();
+  EXPECT_EQ(next.sequence, last.sequence);
+  EXPECT_TRUE(last.changed.empty());
+}
+
 }
@@ -10,6 +10,7 @@
 #include "QsfpModule.h"
 
 #include <boost/assign.hpp>
+#include <algorithm>
 #include <string>
 #include <iomanip>
 #include "fboss/agent/FbossError.h"
@@ -26,6 +27,11 @@ DEFINE_int32(
     qsfp_data_refresh_interval,
     10,
     "how often to refetch qsfp data that changes frequently");
+DEFINE_int32(
+    qsfp_sensor_refresh_interval,
+    30,
+    "how often to refetch the qsfp sensor values, which matter less than "
+    "the flags and alarms refetched every qsfp_data_refresh_interval");
 DEFINE_int32(
     customize_interval,
     30,
@@ -105,6 +111,33 @@ static SffFieldMultiplier qsfpMultiplier = {
   {SffField::LENGTH_COPPER_DECIMETERS, 0.1},
 };
 
+// The lower page fields partial refreshes read, in tiers with their own
+// rates.  The rest of the lower page, and the other pages, only change when
+// the module does, and are read by full refreshes.
+static const std::vector<SffField> qsfpFlagFields = {
+  SffField::STATUS,
+  SffField::TEMPERATURE_ALARMS,
+  SffField::VCC_ALARMS,
+  SffField::CHANNEL_RX_PWR_ALARMS,
+  SffField::CHANNEL_TX_BIAS_ALARMS,
+  SffField::CHANNEL_TX_PWR_ALARMS,
+};
+static const std::vector<SffField> qsfpSensorFields = {
+  SffField::TEMPERATURE,
+  SffField::VCC,
+  SffField::CHANNEL_RX_PWR,
+  SffField::CHANNEL_TX_BIAS,
+  SffField::CHANNEL_TX_PWR,
+};
+// What customization writes
+static const std::vector<SffField> qsfpControlFields = {
+  SffField::TX_DISABLE,
+  SffField::RATE_SELECT_RX,
+  SffField::RATE_SELECT_TX,
+  SffField::POWER_CONTROL,
+  SffField::CDR_CONTROL,
+};
+
 void getQsfpFieldAddress(SffField field, int &dataAddress,
                          int &offset, int &length) {
   auto info = SffFieldInfo::getSffFieldAddress(qsfpFields, field);
@@ -615,11 +648,11 @@ bool QsfpModule::cacheIsValid() const {
 }
 
 TransceiverInfo QsfpModule::getTransceiverInfo() {
-  auto cachedInfo = info_.rlock();
-  if (!cachedInfo->hasValue()) {
+  auto snapshot = getSnapshot();
+  if (!snapshot) {
     throw FbossError("Still populating data...");
   }
-  return **cachedInfo;
+  return snapshot->info;
 }
 
 bool QsfpModule::detectPresence() {
@@ -676,14 +709,20 @@ TransceiverInfo QsfpModule::parseDataLocked() {
 }
 
 RawDOMData QsfpModule::getRawDOMData() {
-  lock_guard<std::mutex> g(qsfpModuleMutex_);
+  auto snapshot = getSnapshot();
+  return snapshot ? snapshot->rawDomData : RawDOMData();
+}
+
+RawDOMData QsfpModule::copyRawDOMDataLocked() const {
+  // Copy the pages, so the cached data doesn't change under readers as
+  // the next refresh writes to them
   RawDOMData data;
   if (present_) {
-    data.lower = IOBuf::wrapBufferAsValue(lowerPage_, MAX_QSFP_PAGE_SIZE);
-    data.page0 = IOBuf::wrapBufferAsValue(page0_, MAX_QSFP_PAGE_SIZE);
+    data.lower = IOBuf(IOBuf::COPY_BUFFER, lowerPage_, MAX_QSFP_PAGE_SIZE);
+    data.page0 = IOBuf(IOBuf::COPY_BUFFER, page0_, MAX_QSFP_PAGE_SIZE);
     if (!flatMem_) {
       data.__isset.page3 = true;
-      data.page3 = IOBuf::wrapBufferAsValue(page3_, MAX_QSFP_PAGE_SIZE);
+      data.page3 = IOBuf(IOBuf::COPY_BUFFER, page3_, MAX_QSFP_PAGE_SIZE);
     }
   }
   return data;
@@ -784,6 +823,32 @@ void QsfpModule::refresh() {
   refreshLocked();
 }
 
+bool QsfpModule::refreshIfPresenceChanged() {
+  lock_guard<std::mutex> g(qsfpModuleMutex_);
+  auto wasPresent = present_;
+  if (detectPresenceLocked() == wasPresent) {
+    return false;
+  }
+  // detectPresenceLocked() marked the cache dirty, so this is a full refresh
+  refreshLocked();
+  return true;
+}
+
+void QsfpModule::publishSnapshotLocked() {
+  auto snapshot = std::make_shared<Snapshot>();
+  snapshot->info = parseDataLocked();
+  snapshot->rawDomData = copyRawDOMDataLocked();
+  // So that readers can tell how old the data they got is
+  auto now = static_cast<int64_t>(std::time(nullptr));
+  snapshot->info.timeCollected = now;
+  snapshot->info.__isset.timeCollected = true;
+  snapshot->rawDomData.timeCollected = now;
+  snapshot->rawDomData.__isset.timeCollected = true;
+
+  folly::SpinLockGuard guard(snapshotLock_);
+  snapshot_ = std::move(snapshot);
+}
+
 void QsfpModule::refreshLocked() {
   detectPresenceLocked();
 
@@ -814,7 +879,7 @@ void QsfpModule::refreshLocked() {
     }
 
     // assign
-    info_.wlock()->assign(parseDataLocked());
+    publishSnapshotLocked();
   } catch (const UsbError& ex) {
     XLOG(ERR) << "Error during refreshLocked(): " << ex.what();
   }
@@ -848,18 +913,36 @@ void QsfpModule::updateQsfpData(bool allPages) {
       XLOG(DBG2) << "Performing " << ((allPages) ? "full" : "partial")
                  << " qsfp data cache refresh for transceiver "
                  << folly::to<std::string>(qsfpImpl_->getName());
-      qsfpImpl_->readTransceiver(TransceiverI2CApi::ADDR_QSFP, 0,
-          sizeof(lowerPage_), lowerPage_);
-      lastRefreshTime_ = std::time(nullptr);
+      auto now = std::time(nullptr);
+      if (allPages) {
+        qsfpImpl_->readTransceiver(TransceiverI2CApi::ADDR_QSFP, 0,
+            sizeof(lowerPage_), lowerPage_);
+        lastSensorRefreshTime_ = now;
+        controlsStale_ = false;
+      } else {
+        // Only the first page has fields that change often, and only some
+        // of them, so only fetch those: the flags and alarms every time,
+        // the sensors at their own slower rate, and the controls once we
+        // may have written them.
+        readLowerPageFields(qsfpFlagFields);
+        if (now - lastSensorRefreshTime_ >=
+            FLAGS_qsfp_sensor_refresh_interval) {
+          readLowerPageFields(qsfpSensorFields);
+          lastSensorRefreshTime_ = now;
+        }
+        if (controlsStale_) {
+          readLowerPageFields(qsfpControlFields);
+          controlsStale_ = false;
+        }
+      }
+      lastRefreshTime_ = now;
       dirty_ = false;
       setQsfpIdprom();
 
       if (!allPages) {
-        // Only the first page has fields that change often so provide
-        // an option to only fetch that page. Also the write path is
-        // particularly slow due to using an i2c bus, so writing the
-        // bytes needed to select later pages on non-flat memories can
-        // be quite expensive.
+        // Also the write path is particularly slow due to using an i2c
+        // bus, so writing the bytes needed to select later pages on
+        // non-flat memories can be quite expensive.
         return;
       }
 
@@ -888,6 +971,23 @@ void QsfpModule::updateQsfpData(bool allPages) {
   }
 }
 
+void QsfpModule::readLowerPageFields(const std::vector<SffField>& fields) {
+  // Read the smallest range that covers all of them in one go
+  int first = MAX_QSFP_PAGE_SIZE;
+  int last = 0;
+  for (auto field : fields) {
+    int dataAddress;
+    int offset;
+    int length;
+    getQsfpFieldAddress(field, dataAddress, offset, length);
+    CHECK_EQ(dataAddress, QsfpPages::LOWER);
+    first = std::min(first, offset);
+    last = std::max(last, offset + length);
+  }
+  qsfpImpl_->readTransceiver(TransceiverI2CApi::ADDR_QSFP, first,
+      last - first, lowerPage_ + first);
+}
+
 void QsfpModule::customizeTransceiver(cfg::PortSpeed speed) {
   lock_guard<std::mutex> g(qsfpModuleMutex_);
   if (present_) {
@@ -895,6 +995,16 @@ void QsfpModule::customizeTransceiver(cfg::PortSpeed speed) {
   }
 }
 
+bool QsfpModule::customizeIfWanted() {
+  lock_guard<std::mutex> g(qsfpModuleMutex_);
+  if (!present_ || !customizationWanted(FLAGS_customize_interval)) {
+    return false;
+  }
+  // Customizes, reads back what it wrote, and publishes the result
+  refreshLocked();
+  return true;
+}
+
 void QsfpModule::customizeTransceiverLocked(cfg::PortSpeed speed) {
   /*
    * This must be called with a lock held on qsfpModuleMutex_
@@ -921,6 +1031,8 @@ void QsfpModule::customizeTransceiverLocked(cfg::PortSpeed speed) {
 
     lastCustomizeTime_ = std::time(nullptr);
     needsCustomization_ = false;
+    // What we wrote is read back on the next partial refresh
+    controlsStale_ = true;
   } catch (const std::exception& e) {
     XLOG(ERR) << " Unable to customize transceiver: "
               << folly::to<std::string>(qsfpImpl_->getName()) << " "
@@ -9,13 +9,15 @@
  */
 #pragma once
 #include <cstdint>
+#include <memory>
 #include <mutex>
+#include <vector>
 #include "fboss/qsfp_service/sff/Transceiver.h"
 #include "fboss/agent/gen-cpp2/switch_config_types.h"
 #include "fboss/qsfp_service/if/gen-cpp2/transceiver_types.h"
 
 #include <folly/Optional.h>
-#include <folly/Synchronized.h>
+#include <folly/SpinLock.h>
 
 namespace facebook { namespace fboss {
 
@@ -69,8 +71,10 @@ class QsfpModule : public Transceiver {
 
   bool detectPresenceLocked();
   TransceiverInfo parseDataLocked();
+  RawDOMData copyRawDOMDataLocked() const;
 
   virtual void refresh() override;
+  bool refreshIfPresenceChanged() override;
   void refreshLocked();
 
   /*
@@ -85,12 +89,16 @@ class QsfpModule : public Transceiver {
    * different qsfp settings based on speed
    */
   void customizeTransceiver(cfg::PortSpeed speed) override;
+  bool customizeIfWanted() override;
 
   /*
    * Returns the entire QSFP information
    */
   TransceiverInfo getTransceiverInfo() override;
 
+  /*
+   * Returns the raw pages as of the last refresh
+   */
   RawDOMData getRawDOMData() override;
 
   void transceiverPortsChanged(
@@ -140,8 +148,28 @@ class QsfpModule : public Transceiver {
   bool flatMem_{false};
   // This transceiver needs customization
   bool needsCustomization_{false};
+  // The control bytes may have been written since they were last read
+  bool controlsStale_{false};
 
-  folly::Synchronized<folly::Optional<TransceiverInfo>> info_;
+  /*
+   * What the module looked like as of its last refresh, which is what
+   * getTransceiverInfo() and getRawDOMData() return.  A snapshot is never
+   * modified once published, so readers only take snapshotLock_ to copy
+   * the pointer, and never wait for a refresh.
+   */
+  struct Snapshot {
+    TransceiverInfo info;
+    RawDOMData rawDomData;
+  };
+  std::shared_ptr<const Snapshot> getSnapshot() const {
+    folly::SpinLockGuard guard(snapshotLock_);
+    return snapshot_;
+  }
+  // Build a new snapshot from the cached pages, and publish it
+  void publishSnapshotLocked();
+
+  mutable folly::SpinLock snapshotLock_;
+  std::shared_ptr<const Snapshot> snapshot_;
   /*
    * qsfpModuleMutex_ is held around all the read and writes to the qsfpModule
    *
@@ -156,6 +184,7 @@ class QsfpModule : public Transceiver {
    * too frequently. These MUST be accessed holding qsfpModuleMutex_.
    */
   time_t lastRefreshTime_{0};
+  time_t lastSensorRefreshTime_{0};
   time_t lastCustomizeTime_{0};
   time_t lastTxEnable_{0};
 
@@ -293,8 +322,15 @@ class QsfpModule : public Transceiver {
    * on the first page holds most of the fields that actually change,
    * so unless we have reason to believe the transceiver was unplugged
    * there is not much point in refreshing static data on other pages.
+   * Without it, only the flags and alarms of the first page are read
+   * every time, and its sensors every qsfp_sensor_refresh_interval.
    */
   virtual void updateQsfpData(bool allPages = true);
+  /*
+   * Read the part of the lower page that covers all of fields into the
+   * cache.  The thread needs to have the lock before calling the function.
+   */
+  void readLowerPageFields(const std::vector<SffField>& fields);
 
  private:
   /*
@@ -44,6 +44,12 @@ class Transceiver {
    */
   virtual void refresh() = 0;
 
+  /*
+   * Check if the transceiver was plugged in or removed, and if so refresh
+   * its data right away.  Returns whether it was.
+   */
+  virtual bool refreshIfPresenceChanged() = 0;
+
   /*
    * Return all of the transceiver information
    */
@@ -59,6 +65,12 @@ class Transceiver {
    */
   virtual void customizeTransceiver(cfg::PortSpeed speed) = 0;
 
+  /*
+   * Customize the transceiver for the speed of its ports now, if it needs
+   * it, rather than on its next refresh.  Returns whether it did.
+   */
+  virtual bool customizeIfWanted() = 0;
+
   /*
    * Register that a logical port that is part of this transceiver has changed.
    */
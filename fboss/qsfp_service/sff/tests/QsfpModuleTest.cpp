@@ -332,6 +332,25 @@ TEST_F(QsfpModuleTest, portsChangedNotDirtySafeToCustomize) {
   qsfp_->refresh();
 }
 
+TEST_F(QsfpModuleTest, customizeIfWanted) {
+  qsfp_->refresh();
+
+  // Nothing to do until all of the ports are known
+  EXPECT_FALSE(qsfp_->customizeIfWanted());
+  qsfp_->transceiverPortsChanged({
+      {1, portStatus(true, false)},
+      {2, portStatus(true, false)},
+      {3, portStatus(true, false)},
+      {4, portStatus(true, false)},
+    });
+
+  // Then customized right away, rather than on the next refresh
+  EXPECT_CALL(*qsfp_, setCdrIfSupported(_, _, _)).Times(1);
+  EXPECT_TRUE(qsfp_->customizeIfWanted());
+  EXPECT_FALSE(qsfp_->customizeIfWanted());
+  qsfp_->refresh();
+}
+
 TEST_F(QsfpModuleTest, portsChangedNotDirtySafeToCustomizeStale) {
   // refresh, which should set module dirty_ = false
   qsfp_->refresh();
@@ -380,6 +399,16 @@ TEST_F(QsfpModuleTest, refreshDirtyNoPorts) {
   qsfp_->refresh();
 }
 
+TEST_F(QsfpModuleTest, refreshIfPresenceChanged) {
+  // Only the removal leads to a refresh
+  EXPECT_CALL(*qsfp_, updateQsfpData(_)).Times(1);
+  EXPECT_FALSE(qsfp_->refreshIfPresenceChanged());
+
+  EXPECT_CALL(*transImpl_, detectTransceiver()).WillRepeatedly(Return(false));
+  EXPECT_TRUE(qsfp_->refreshIfPresenceChanged());
+  EXPECT_FALSE(qsfp_->refreshIfPresenceChanged());
+}
+
 TEST_F(QsfpModuleTest, updateQsfpDataPartial) {
   // Ensure that partial updates don't ever call writeTranscevier,
   // which needs to gain control of the bus and slows the call
@@ -388,6 +417,26 @@ TEST_F(QsfpModuleTest, updateQsfpDataPartial) {
   qsfp_->actualUpdateQsfpData(false);
 }
 
+TEST_F(QsfpModuleTest, updateQsfpDataTiers) {
+  // Partial updates read the flags, and the sensors the first time
+  {
+    InSequence dummy;
+    EXPECT_CALL(*transImpl_, readTransceiver(_, 1, 14, _)).Times(1);
+    EXPECT_CALL(*transImpl_, readTransceiver(_, 22, 36, _)).Times(1);
+  }
+  qsfp_->actualUpdateQsfpData(false);
+
+  // Then only the flags, until the sensors are due again
+  EXPECT_CALL(*transImpl_, readTransceiver(_, 1, 14, _)).Times(1);
+  qsfp_->actualUpdateQsfpData(false);
+
+  // Once customized, the controls are read back
+  qsfp_->customizeTransceiver(cfg::PortSpeed::DEFAULT);
+  EXPECT_CALL(*transImpl_, readTransceiver(_, 1, 14, _)).Times(1);
+  EXPECT_CALL(*transImpl_, readTransceiver(_, 86, 13, _)).Times(1);
+  qsfp_->actualUpdateQsfpData(false);
+}
+
 TEST_F(QsfpModuleTest, updateQsfpDataFull) {
   // Bit of a hack to ensure we have flatMem_ == false.
   ON_CALL(*transImpl_, readTransceiver(_, _, _, _)).
@@ -181,6 +181,12 @@ TEST(SffTest, simpleRead) {
   EXPECT_DOUBLE_EQ(-5.0, info.thresholds.temp.alarm.low);
   EXPECT_TRUE(info.channels[0].sensors.txBias.flags.alarm.low);
   EXPECT_FALSE(info.channels[1].sensors.txBias.flags.alarm.low);
+
+  // The info and the raw pages come from the same snapshot
+  auto raw = qsfp->getRawDOMData();
+  EXPECT_TRUE(info.__isset.timeCollected);
+  EXPECT_EQ(info.timeCollected, raw.timeCollected);
+  EXPECT_EQ(QsfpModule::MAX_QSFP_PAGE_SIZE, raw.lower.computeChainDataLength());
 }
 
 } // namespace facebook::fboss
@@ -58,6 +58,14 @@ service TestService extends fb303.FacebookService {
   void sendPkt(1: string interfaceName, 2: ctrl.fbbinary pkt)
                throws (1: fboss.FbossBaseError error)
 
+  /* Send the raw packets out this interface, in order, repeat times over,
+     as fast as the host can.  For packet storms, e.g. of ARP requests, that
+     a sendPkt() per packet can't generate fast enough */
+  void sendPktBurst(1: string interfaceName,
+                    2: list<ctrl.fbbinary> pkts,
+                    3: i32 repeat)
+                    throws (1: fboss.FbossBaseError error)
+
   /* initialize and listen to an iperf3 client test request. Returns a JSON
   formatted string which can be deserialized/loaded for post processing
   server-side test results.
@@ -76,9 +84,12 @@ service TestService extends fb303.FacebookService {
 
   /* initiate an iperf3 test to host server @ server_ip. server_ip can be
   ipv4 or ipv6. Returns a JSON formatted string which can be deserialized/loaded
-  for post-processing of iperf3 client-side test results */
+  for post-processing of iperf3 client-side test results.  options are
+  added to the client's, e.g. ['-u', '-b', '10G', '-t', '30'] for 30 seconds
+  of UDP at 10Gbps */
 
-  string iperf3_client(1: string server_ip) throws
+  string iperf3_client(1: string server_ip,
+                       2: optional list<string> options) throws
                       (1: fboss.FbossBaseError error)
 
   void flap_server_port(1: string interfaceName,
@@ -27,6 +27,13 @@ Defaults = {
     "tags": user_requested_tags,
     "list_tests": False,
     "test_dirs": ["tests"],
+    "perf_results_file": "{dir}/perf-results.jsonl",
+    "perf_thresholds": None,
+    "perf_build": None,
+    "perf_max_regression_pct": 10,
+    "perf_history": 10,
+    "warm_boot_cmd": None,
+    "switch_ssh_user": "root",
 }
 
 
@@ -79,6 +86,32 @@ def generate_default_test_argparse(**kwargs):
                         help="List all tests without running them",
                         action="store_true",
                         default=Defaults['list_tests'])
+    parser.add_argument('--perf_results_file',
+                        help="JSON lines file the performance tests append "
+                             "their results to, {dir} is the log_dir",
+                        default=Defaults['perf_results_file'])
+    parser.add_argument('--perf_thresholds',
+                        help="JSON file of per metric 'min', 'max' and "
+                             "'max_regression_pct' performance gates",
+                        default=Defaults['perf_thresholds'])
+    parser.add_argument('--perf_build',
+                        help="Build the performance results are recorded for",
+                        default=Defaults['perf_build'])
+    parser.add_argument('--perf_max_regression_pct', type=float,
+                        help="Percentage a performance result may regress "
+                             "from the median of past runs",
+                        default=Defaults['perf_max_regression_pct'])
+    parser.add_argument('--perf_history', type=int,
+                        help="Number of past runs a performance result is "
+                             "compared to",
+                        default=Defaults['perf_history'])
+    parser.add_argument('--warm_boot_cmd',
+                        help="Command run on the switch to warm boot the "
+                             "agent, the warm boot test is skipped without it",
+                        default=Defaults['warm_boot_cmd'])
+    parser.add_argument('--switch_ssh_user',
+                        help="User to run commands on the switch as",
+                        default=Defaults['switch_ssh_user'])
 
     return parser
 
@@ -210,6 +243,10 @@ def run_tests(options):
     :options : a dict of testing options, as described above
     """
     setup_logging(options)
+    # --tags is a comma separated string on the command line
+    if isinstance(options.tags, str):
+        user_requested_tags.extend(
+            tag for tag in options.tags.split(',') if tag)
     # Skipping some work when we are just listing the tests
     if not options.list_tests:
         options.test_topology = dynamic_generate_test_topology(options)
@@ -165,6 +165,16 @@ class TestServer(TestService.Iface):
         raw.bind((interface_name, 0))
         raw.send(pkt)
 
+    def sendPktBurst(self, interface_name, pkts, repeat):
+        raw = socket.socket(socket.AF_PACKET, socket.SOCK_RAW)
+        try:
+            raw.bind((interface_name, 0))
+            for _i in range(repeat):
+                for pkt in pkts:
+                    raw.send(pkt)
+        finally:
+            raw.close()
+
     @staticmethod
     def check_output(cmd, **kwargs):
         return subprocess.check_output(cmd.split(' '), **kwargs)
@@ -202,14 +212,18 @@ class TestServer(TestService.Iface):
                 self.check_output('kill -9 {pid}'.format(pid=pid))
         return response
 
-    def iperf3_client(self, server_ip, client_retries=3):
+    def iperf3_client(self, server_ip, options=None, client_retries=3):
         ''' @param ip : a string, e.g., "128.8.128.118"
+            @param options: list of additional client flags, e.g. ['-u']
             @param client_retries: int, how many retries client attempts
         '''
 
         self.kill_iperf3()  # kill lingering iperf3 processes (server or client)
         is_ipv6 = '-6' if ':' in server_ip else ''
         command = "iperf3 {} -J -t 1 -c {}".format(is_ipv6, server_ip)
+        if options:
+            # later flags, e.g. a longer -t, win over the defaults
+            command += ' ' + ' '.join(options)
         client_loop_cnt = 0
         while client_loop_cnt < client_retries:
             try:
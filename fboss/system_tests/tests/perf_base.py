@@ -0,0 +1,55 @@
+#!/usr/bin/env python3
+
+import unittest
+
+from fboss.system_tests.system_tests import FbossBaseSystemTest
+from fboss.system_tests.testutils.perf_results import PerfResults
+
+PERF_TAG = "perf"
+
+
+class PerfTestBase(FbossBaseSystemTest):
+    """ Base of the performance tests
+
+        These load the switch for minutes at a time and some, like warm
+        boot, disrupt it, so they only run when asked for with
+        '--tags perf'.  Each measurement is added to the perf results time
+        series and fails the test if it breaks its gates.
+
+        NOTE: this file must NOT match '*test*.py', so that the base isn't
+        discovered as a test of its own.
+    """
+
+    def setUp(self):
+        tags = self.options.tags
+        if isinstance(tags, str):
+            tags = tags.split(',')
+        if PERF_TAG not in tags:
+            raise unittest.SkipTest("Performance tests need '--tags %s'" %
+                                    PERF_TAG)
+        super(PerfTestBase, self).setUp()
+        results_file = self.options.perf_results_file.format(
+            dir=self.options.log_dir)
+        self.perf_results = PerfResults(
+            results_file,
+            thresholds_file=self.options.perf_thresholds,
+            build=self.options.perf_build,
+            max_regression_pct=self.options.perf_max_regression_pct,
+            history=self.options.perf_history)
+        self.perf_failures = []
+
+    def record_perf(self, metric, value, unit, higher_is_better=True):
+        """ Records the measurement; the test fails at the end if any
+            measurement broke its gates, so that every one is recorded
+        """
+        self.log.info("perf %s: %s %s" % (metric, value, unit))
+        failures = self.perf_results.record(metric, value, unit,
+                                            higher_is_better)
+        for failure in failures:
+            self.log.warning("perf gate failed: %s" % failure)
+        self.perf_failures.extend(failures)
+
+    def assertPerfGatesPassed(self):
+        self.assertFalse(self.perf_failures,
+                         "Performance gates failed:\n" +
+                         "\n".join(self.perf_failures))
@@ -0,0 +1,370 @@
+#!/usr/bin/env python3
+
+import ipaddress
+import threading
+import time
+import unittest
+
+import scapy.all as scapy
+
+from facebook.network.Address.ttypes import Address, AddressType
+from fboss.system_tests.system_tests import test_tags
+from fboss.system_tests.tests.copp_base import HIGH_PRI_QUEUE, MID_PRI_QUEUE
+from fboss.system_tests.tests.perf_base import PerfTestBase
+from fboss.system_tests.testutils import packet
+from fboss.system_tests.testutils.ip_conversion import ip_addr_to_str
+from fboss.system_tests.testutils.ip_conversion import ip_str_to_addr
+from fboss.system_tests.testutils.paramiko_utils import (ParamikoClient,
+                                                         connect_to_client)
+from neteng.fboss.ctrl.ttypes import IpPrefix
+from neteng.fboss.ctrl.ttypes import UnicastRoute
+
+# Not one of the StdClientIds, so the perf routes replace nobody's
+PERF_CLIENT_ID = 4242
+# Benchmarking and documentation ranges, clear of anything real
+PERF_V4_NETWORK = "198.18.0.0/15"
+PERF_V6_NETWORK = "2001:db8::/32"
+POLL_INTERVAL = 0.05  # in seconds
+
+
+def _host_ip(test, v6):
+    """ The first host interface, and its IP, of the address family """
+    for host in test.test_topology.hosts():
+        for intf, info in host.interface_map.items():
+            if info['ip'] and packet.is_v6(info['ip']) == v6:
+                return host, intf, info['ip']
+    raise unittest.SkipTest("No %s host in the topology" %
+                            ("v6" if v6 else "v4"))
+
+
+def _neighbor_table(sw_client, v6):
+    return sw_client.getNdpTable() if v6 else sw_client.getArpTable()
+
+
+def _neighbor_states(sw_client, v6):
+    return {ip_addr_to_str(entry.ip): entry.state
+            for entry in _neighbor_table(sw_client, v6)}
+
+
+@test_tags("perf")
+class RouteProgrammingPerf(PerfTestBase):
+    """ How fast the agent programs, and removes, a batch of routes """
+    NUM_ROUTES = 4096
+
+    def _measure(self, v6):
+        _host, _intf, nexthop = _host_ip(self, v6)
+        network = ipaddress.ip_network(PERF_V6_NETWORK if v6
+                                       else PERF_V4_NETWORK)
+        prefix_len = 64 if v6 else 27
+        prefixes = []
+        for subnet in network.subnets(new_prefix=prefix_len):
+            prefixes.append(IpPrefix(ip=ip_str_to_addr(str(subnet[0])),
+                                     prefixLength=prefix_len))
+            if len(prefixes) == self.NUM_ROUTES:
+                break
+        last = Address(addr=ip_addr_to_str(prefixes[-1].ip),
+                       type=AddressType.V6 if v6 else AddressType.V4)
+        routes = [UnicastRoute(dest=prefix,
+                               nextHopAddrs=[ip_str_to_addr(nexthop)])
+                  for prefix in prefixes]
+        family = "v6" if v6 else "v4"
+        with self.test_topology.switch_thrift() as sw_client:
+            try:
+                # Returns once the routes are programmed in hardware
+                start = time.time()
+                sw_client.addUnicastRoutes(PERF_CLIENT_ID, routes)
+                added = time.time() - start
+                route = sw_client.getIpRoute(last, 0)
+                self.assertEqual(prefix_len, route.dest.prefixLength)
+            finally:
+                start = time.time()
+                sw_client.deleteUnicastRoutes(PERF_CLIENT_ID, prefixes)
+                deleted = time.time() - start
+        self.record_perf("route_programming.%s.add_routes_per_sec" % family,
+                         len(routes) / added, "routes/s")
+        self.record_perf("route_programming.%s.delete_routes_per_sec" %
+                         family, len(routes) / deleted, "routes/s")
+
+    def test_route_programming_rate(self):
+        self.test_topology.min_hosts_or_skip(1)
+        for v6 in [False, True]:
+            try:
+                self._measure(v6)
+            except unittest.SkipTest as e:
+                self.log.info("Skipping: %s" % e)
+        self.assertPerfGatesPassed()
+
+
+@test_tags("perf")
+class LinkDownReroutePerf(PerfTestBase):
+    """ From a host's link going down to the switch no longer forwarding to
+        it: the neighbor entries behind the port going pending is what
+        takes the next hop out of its ECMP groups in hardware
+    """
+    DOWN_TIME = 10  # in seconds, how long the link stays down
+    MAX_REROUTE = 5  # in seconds
+    MAX_RECOVERY = 60  # in seconds
+
+    def _flap(self, host, intf):
+        with host.thrift_client() as client:
+            try:
+                client.flap_server_port(intf, 1, self.DOWN_TIME)
+            # Taking the link down can also take down the thrift connection
+            except Exception as e:
+                self.log.info("Exception caught {}".format(e))
+
+    def test_link_down_reroute(self):
+        self.test_topology.min_hosts_or_skip(1)
+        v6 = True
+        try:
+            host, intf, ip = _host_ip(self, v6)
+        except unittest.SkipTest:
+            v6 = False
+            host, intf, ip = _host_ip(self, v6)
+        with host.thrift_client() as client:
+            # Resolves the switch's neighbor entry of the host
+            self.assertTrue(client.ping(ip_addr_to_str(
+                self._switch_ip(v6))))
+        with self.test_topology.switch_thrift() as sw_client:
+            self.assertEqual("REACHABLE",
+                             _neighbor_states(sw_client, v6).get(ip))
+            thread = threading.Thread(target=self._flap, args=(host, intf))
+            start = time.time()
+            thread.start()
+            rerouted = None
+            while time.time() < start + self.MAX_REROUTE:
+                if _neighbor_states(sw_client, v6).get(ip) != "REACHABLE":
+                    rerouted = time.time() - start
+                    break
+                time.sleep(POLL_INTERVAL)
+        thread.join()
+        # Give the link and the neighbor time to come back
+        switch_ip = ip_addr_to_str(self._switch_ip(v6))
+        start = time.time()
+        while time.time() < start + self.MAX_RECOVERY:
+            try:
+                with host.thrift_client() as client:
+                    if client.ping(switch_ip):
+                        break
+            except Exception as e:
+                self.log.info("Exception caught {}".format(e))
+            time.sleep(1)
+        self.assertIsNotNone(rerouted, "%s still reachable after %ds" %
+                             (ip, self.MAX_REROUTE))
+        self.record_perf("link_down_reroute.ms", rerouted * 1000, "ms",
+                         higher_is_better=False)
+        self.assertPerfGatesPassed()
+
+    def _switch_ip(self, v6):
+        with self.test_topology.switch_thrift() as sw_client:
+            interfaces = sw_client.getAllInterfaces()
+        addr_len = 16 if v6 else 4
+        for interface in interfaces.values():
+            for prefix in interface.address:
+                if len(prefix.ip.addr) == addr_len:
+                    return prefix.ip
+        raise unittest.SkipTest("Switch has no %s interface" %
+                                ("v6" if v6 else "v4"))
+
+
+@test_tags("perf")
+class NeighborStormPerf(PerfTestBase):
+    """ How fast the switch resolves neighbors while a host storms it with
+        ARP requests or neighbor solicitations from many new addresses
+    """
+    NUM_NEIGHBORS = 500
+    # Each address is sent this many times, for the storm to outlast the
+    # neighbor programming
+    REPEAT = 20
+    MAX_RESOLVE = 60  # in seconds
+
+    def _interface(self, sw_client, ip):
+        """ The switch interface, and its address, on the host's subnet """
+        for interface in sw_client.getAllInterfaces().values():
+            for prefix in interface.address:
+                addr = ip_addr_to_str(prefix.ip)
+                subnet = ipaddress.ip_network(
+                    "%s/%d" % (addr, prefix.prefixLength), strict=False)
+                if ipaddress.ip_address(ip) in subnet:
+                    return interface, addr, subnet
+        raise unittest.SkipTest("No switch interface on the subnet of %s" %
+                                ip)
+
+    @staticmethod
+    def _fake_neighbors(subnet, exclude, count):
+        """ Addresses, from the top of the subnet down, nobody has """
+        neighbors = []
+        addr = subnet.broadcast_address - 1
+        while len(neighbors) < count and addr > subnet.network_address:
+            if str(addr) not in exclude:
+                neighbors.append(str(addr))
+            addr -= 1
+        return neighbors
+
+    @staticmethod
+    def _fake_mac(i):
+        return "02:00:00:00:%02x:%02x" % (i >> 8 & 0xff, i & 0xff)
+
+    def _request(self, v6, i, neighbor, switch_ip):
+        mac = self._fake_mac(i)
+        if not v6:
+            return bytes(scapy.Ether(src=mac, dst="ff:ff:ff:ff:ff:ff") /
+                         scapy.ARP(op=1, hwsrc=mac, psrc=neighbor,
+                                   pdst=switch_ip))
+        target = ipaddress.ip_address(switch_ip).packed
+        solicited = "ff02::1:ff%02x:%02x%02x" % tuple(target[-3:])
+        dst_mac = "33:33:ff:%02x:%02x:%02x" % tuple(target[-3:])
+        return bytes(scapy.Ether(src=mac, dst=dst_mac) /
+                     scapy.IPv6(src=neighbor, dst=solicited, hlim=255) /
+                     scapy.ICMPv6ND_NS(tgt=switch_ip) /
+                     scapy.ICMPv6NDOptSrcLLAddr(lladdr=mac))
+
+    def _measure(self, v6):
+        host, intf, ip = _host_ip(self, v6)
+        family = "v6" if v6 else "v4"
+        with self.test_topology.switch_thrift() as sw_client:
+            interface, switch_ip, subnet = self._interface(sw_client, ip)
+            known = set(_neighbor_states(sw_client, v6))
+            known.update([ip, switch_ip])
+            neighbors = self._fake_neighbors(subnet, known,
+                                             self.NUM_NEIGHBORS)
+            pkts = [self._request(v6, i, neighbor, switch_ip)
+                    for i, neighbor in enumerate(neighbors)]
+            storm = threading.Thread(target=self._storm,
+                                     args=(host, intf, pkts))
+            start = time.time()
+            storm.start()
+            resolved = 0
+            elapsed = self.MAX_RESOLVE
+            try:
+                while time.time() < start + self.MAX_RESOLVE:
+                    states = _neighbor_states(sw_client, v6)
+                    resolved = sum(1 for neighbor in neighbors
+                                   if states.get(neighbor) == "REACHABLE")
+                    if resolved == len(neighbors):
+                        elapsed = time.time() - start
+                        break
+                    time.sleep(POLL_INTERVAL)
+            finally:
+                storm.join()
+                for neighbor in neighbors:
+                    sw_client.flushNeighborEntry(ip_str_to_addr(neighbor),
+                                                 interface.vlanId)
+        self.log.info("%d of %d %s neighbors resolved in %fs" %
+                      (resolved, len(neighbors), family, elapsed))
+        self.record_perf("neighbor_storm.%s.resolved_per_sec" % family,
+                         resolved / elapsed, "neighbors/s")
+        self.assertEqual(resolved, len(neighbors),
+                         "Not every %s neighbor resolved in %ds" %
+                         (family, self.MAX_RESOLVE))
+
+    def _storm(self, host, intf, pkts):
+        with host.thrift_client() as client:
+            client.sendPktBurst(intf, pkts, self.REPEAT)
+
+    def test_arp_storm(self):
+        self.test_topology.min_hosts_or_skip(1)
+        self._measure(v6=False)
+        self.assertPerfGatesPassed()
+
+    def test_ndp_storm(self):
+        self.test_topology.min_hosts_or_skip(1)
+        self._measure(v6=True)
+        self.assertPerfGatesPassed()
+
+
+@test_tags("perf")
+class WarmBootPerf(PerfTestBase):
+    """ Traffic lost between two hosts while the agent warm boots """
+    DURATION = 60  # in seconds, of traffic
+    WARM_BOOT_AFTER = 10  # in seconds, into the traffic
+    BANDWIDTH = "1G"
+    MAX_RESTART = 120  # in seconds
+
+    def _warm_boot(self):
+        time.sleep(self.WARM_BOOT_AFTER)
+        self.log.info("Warm booting: %s" % self.options.warm_boot_cmd)
+        with ParamikoClient() as client:
+            connect_to_client(client, self.test_topology.switch.name,
+                              self.options.switch_ssh_user, None)
+            _stdin, stdout, _stderr = client.exec_command(
+                self.options.warm_boot_cmd)
+            self.warm_boot_status = stdout.channel.recv_exit_status()
+
+    def test_warm_boot_traffic_loss(self):
+        if not self.options.warm_boot_cmd:
+            raise unittest.SkipTest("Warm boot test needs --warm_boot_cmd")
+        self.test_topology.min_hosts_or_skip(2)
+        hosts = self.test_topology.hosts()
+        server_ip = next(iter(hosts[0].ips()))
+        self.warm_boot_status = None
+        warm_boot = threading.Thread(target=self._warm_boot)
+        warm_boot.start()
+        resp = packet.run_iperf(
+            hosts[0], hosts[1], server_ip,
+            duration=self.DURATION + self.MAX_RESTART,
+            client_options=['-u', '-b', self.BANDWIDTH,
+                            '-t', str(self.DURATION)])[server_ip]
+        warm_boot.join()
+        self.assertEqual(0, self.warm_boot_status, "Warm boot command failed")
+        # Back before the next test
+        start = time.time()
+        while not self.test_topology.verify_switch(log=self.log):
+            self.assertLess(time.time(), start + self.MAX_RESTART,
+                            "Agent never came back from warm boot")
+            time.sleep(1)
+        server_resp = resp['server_resp']
+        self.assertNotIn('error', server_resp)
+        total = server_resp['end']['sum']
+        self.log.info("iperf3 server: %s" % total)
+        lost_ms = 1000.0 * self.DURATION * total['lost_packets'] / \
+            total['packets']
+        self.record_perf("warm_boot.lost_ms", lost_ms, "ms",
+                         higher_is_better=False)
+        self.assertPerfGatesPassed()
+
+
+@test_tags("perf")
+class CpuQueuePerf(PerfTestBase):
+    """ While hosts flood the CPU with mid-priority punts, the control plane
+        policing must keep the BGP-like packets on the high-priority queue
+    """
+    NUM_PUNTS = 100000
+    # One BGP-like packet in so many punts
+    BGP_EVERY = 100
+
+    def test_cpu_queue_under_punt_storm(self):
+        self.test_topology.min_hosts_or_skip(1)
+        host = self.test_topology.hosts()[0]
+        intf = host.intfs()[0]
+        mid_pkt = packet.gen_pkt_to_switch(self, dst_port=12345)
+        bgp_pkt = packet.gen_pkt_to_switch(self, dst_port=179)
+        pkts = [mid_pkt] * (self.BGP_EVERY - 1) + [bgp_pkt]
+        repeat = self.NUM_PUNTS // self.BGP_EVERY
+        counters = {
+            'mid_in': "cpu.queue%d.in_pkts.sum" % MID_PRI_QUEUE,
+            'mid_dropped': "cpu.queue%d.in_dropped_pkts.sum" % MID_PRI_QUEUE,
+            'high_in': "cpu.queue%d.in_pkts.sum" % HIGH_PRI_QUEUE,
+            'high_dropped': "cpu.queue%d.in_dropped_pkts.sum" %
+                            HIGH_PRI_QUEUE,
+        }
+        with self.test_topology.switch_thrift() as sw_client:
+            before = {name: packet._wait_for_counter_to_stop(
+                          self, sw_client, counter, packet.MAX_COUNTER_DELAY)
+                      for name, counter in counters.items()}
+            with host.thrift_client() as client:
+                start = time.time()
+                client.sendPktBurst(intf, pkts, repeat)
+                elapsed = time.time() - start
+            after = {name: packet._wait_for_counter_to_stop(
+                         self, sw_client, counter, packet.MAX_COUNTER_DELAY)
+                     for name, counter in counters.items()}
+        delta = {name: after[name] - before[name] for name in counters}
+        # The offered rate is the host's, so it's logged but not gated
+        self.log.info("Sent %d punts in %fs: %s" %
+                      (len(pkts) * repeat, elapsed, delta))
+        self.record_perf("cpu_queue.mid_pri.punted_pps",
+                         delta['mid_in'] / elapsed, "pkts/s")
+        self.record_perf("cpu_queue.high_pri.delivered_pct",
+                         100.0 * delta['high_in'] / repeat, "%")
+        self.assertPerfGatesPassed()
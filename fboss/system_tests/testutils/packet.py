@@ -38,7 +38,8 @@ def is_v6(addr):
     return isinstance(ipaddress.ip_address(addr), ipaddress.IPv6Address)
 
 
-def run_iperf(src_host, dst_host, server_ip=None, duration=10, options=None):
+def run_iperf(src_host, dst_host, server_ip=None, duration=10, options=None,
+              client_options=None):
     '''
     Inputs
     1. src_host and dst_host of type TestHost
@@ -47,6 +48,7 @@ def run_iperf(src_host, dst_host, server_ip=None, duration=10, options=None):
         b. duration for which server would be running
         c. default server options - '-J -1 -s', For additional flags
            update options
+        d. client_options - additional client flags, e.g. ['-u', '-t', '30']
     Returns:
     {
         'server_ip1':{'server_resp':serv_resp, 'client_resp':client_resp},
@@ -66,7 +68,8 @@ def run_iperf(src_host, dst_host, server_ip=None, duration=10, options=None):
                                                                  args=(que, ))
             srv_thread.start()
             with dst_host.thrift_client() as iperf_client:
-                client_resp = iperf_client.iperf3_client(server_ip)
+                client_resp = iperf_client.iperf3_client(server_ip,
+                                                         client_options)
                 client_resp = json.loads(client_resp)
                 srv_thread.join()
                 server_resp = json.loads(que.get())
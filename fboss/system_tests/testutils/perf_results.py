@@ -0,0 +1,105 @@
+from __future__ import absolute_import
+from __future__ import division
+from __future__ import print_function
+from __future__ import unicode_literals
+
+import json
+import os
+import time
+
+
+class PerfResults(object):
+    """ The results of the performance tests, as a time series
+
+        Each measurement is appended as one JSON line to the results file,
+        so that the file keeps the history of every build it was run on.
+        A measurement fails its gate if it's worse than the absolute
+        bound in the thresholds file, or if it regresses by more than the
+        allowed percentage from the median of the last runs.
+
+        The thresholds file is JSON, keyed by metric name, e.g.:
+
+          {"route_programming.v6.routes_per_sec": {"min": 5000},
+           "link_down_reroute.ms": {"max": 500, "max_regression_pct": 25}}
+    """
+
+    def __init__(self, results_file, thresholds_file=None, build=None,
+                 max_regression_pct=10, history=10):
+        self.results_file = results_file
+        self.build = build
+        self.max_regression_pct = max_regression_pct
+        self.history = history
+        self.thresholds = {}
+        if thresholds_file is not None:
+            with open(thresholds_file) as f:
+                self.thresholds = json.load(f)
+
+    def _past_values(self, metric):
+        if not os.path.exists(self.results_file):
+            return []
+        values = []
+        with open(self.results_file) as f:
+            for line in f:
+                line = line.strip()
+                if not line:
+                    continue
+                result = json.loads(line)
+                # Runs that failed their gates don't move the baseline
+                if result['metric'] == metric and result.get('passed', True):
+                    values.append(result['value'])
+        return values[-self.history:]
+
+    @staticmethod
+    def _median(values):
+        ordered = sorted(values)
+        middle = len(ordered) // 2
+        if len(ordered) % 2:
+            return ordered[middle]
+        return (ordered[middle - 1] + ordered[middle]) / 2
+
+    def check(self, metric, value, higher_is_better, past_values):
+        """ Returns the reasons the value fails its gates, if any """
+        failures = []
+        threshold = self.thresholds.get(metric, {})
+        if 'min' in threshold and value < threshold['min']:
+            failures.append("%s=%s below the minimum %s" %
+                            (metric, value, threshold['min']))
+        if 'max' in threshold and value > threshold['max']:
+            failures.append("%s=%s above the maximum %s" %
+                            (metric, value, threshold['max']))
+        pct = threshold.get('max_regression_pct', self.max_regression_pct)
+        median = self._median(past_values) if past_values else None
+        # No relative gate on a zero baseline, e.g. of lost traffic: any
+        # value would be an infinite regression, that's for 'max' to bound
+        if median and pct is not None:
+            if higher_is_better:
+                regressed = value < median * (1 - pct / 100)
+            else:
+                regressed = value > median * (1 + pct / 100)
+            if regressed:
+                failures.append(
+                    "%s=%s regressed more than %s%% from the median %s "
+                    "of the last %d runs" %
+                    (metric, value, pct, median, len(past_values)))
+        return failures
+
+    def record(self, metric, value, unit, higher_is_better):
+        """ Appends the measurement to the results, and returns the reasons
+            it fails its gates, if any
+        """
+        failures = self.check(metric, value, higher_is_better,
+                              self._past_values(metric))
+        result = {
+            'time': int(time.time()),
+            'build': self.build,
+            'metric': metric,
+            'value': value,
+            'unit': unit,
+            'passed': not failures,
+        }
+        directory = os.path.dirname(self.results_file)
+        if directory and not os.path.exists(directory):
+            os.makedirs(directory)
+        with open(self.results_file, 'a') as f:
+            f.write(json.dumps(result, sort_keys=True) + '\n')
+        return failures
@@ -0,0 +1,157 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+#include "fboss/agent/HashSimulator.h"
+
+#include <folly/Conv.h>
+#include <folly/String.h>
+#include <folly/init/Init.h>
+#include <folly/io/IOBuf.h>
+#include <gflags/gflags.h>
+#include <pcap/pcap.h>
+
+#include <sysexits.h>
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace facebook::fboss;
+
+DEFINE_int32(members, 8, "The number of members of the group");
+DEFINE_string(seeds, "0",
+              "The hash seeds to try, separated by commas");
+DEFINE_string(ipv4_fields, "src,dst",
+              "The IPv4 fields to hash on, any of src and dst");
+DEFINE_string(ipv6_fields, "src,dst",
+              "The IPv6 fields to hash on, any of src, dst and flow_label");
+DEFINE_string(transport_fields, "src,dst",
+              "The TCP and UDP fields to hash on, any of src and dst");
+DEFINE_bool(bytes, false,
+            "Weigh packets by their length, rather than counting them");
+
+namespace {
+
+std::vector<std::string> splitFields(const std::string& str) {
+  std::vector<std::string> fields;
+  folly::split(',', str, fields, true);
+  return fields;
+}
+
+std::shared_ptr<LoadBalancer> makeLoadBalancer(uint32_t seed) {
+  LoadBalancer::IPv4Fields v4Fields;
+  for (const auto& field : splitFields(FLAGS_ipv4_fields)) {
+    if (field == "src") {
+      v4Fields.insert(LoadBalancer::IPv4Field::SOURCE_ADDRESS);
+    } else if (field == "dst") {
+      v4Fields.insert(LoadBalancer::IPv4Field::DESTINATION_ADDRESS);
+    } else {
+      throw std::invalid_argument("unknown IPv4 field " + field);
+    }
+  }
+  LoadBalancer::IPv6Fields v6Fields;
+  for (const auto& field : splitFields(FLAGS_ipv6_fields)) {
+    if (field == "src") {
+      v6Fields.insert(LoadBalancer::IPv6Field::SOURCE_ADDRESS);
+    } else if (field == "dst") {
+      v6Fields.insert(LoadBalancer::IPv6Field::DESTINATION_ADDRESS);
+    } else if (field == "flow_label") {
+      v6Fields.insert(LoadBalancer::IPv6Field::FLOW_LABEL);
+    } else {
+      throw std::invalid_argument("unknown IPv6 field " + field);
+    }
+  }
+  LoadBalancer::TransportFields transportFields;
+  for (const auto& field : splitFields(FLAGS_transport_fields)) {
+    if (field == "src") {
+      transportFields.insert(LoadBalancer::TransportField::SOURCE_PORT);
+    } else if (field == "dst") {
+      transportFields.insert(LoadBalancer::TransportField::DESTINATION_PORT);
+    } else {
+      throw std::invalid_argument("unknown transport field " + field);
+    }
+  }
+  return std::make_shared<LoadBalancer>(
+      LoadBalancerID::ECMP,
+      cfg::HashingAlgorithm::CRC16_CCITT,
+      seed,
+      std::move(v4Fields),
+      std::move(v6Fields),
+      std::move(transportFields));
+}
+
+// Add every packet of the file to each of the simulators
+bool replayPcapFile(const char* path, std::vector<HashSimulator>* sims) {
+  char errbuf[PCAP_ERRBUF_SIZE]{0};
+  pcap_t* pcap = pcap_open_offline(path, errbuf);
+  if (pcap == nullptr) {
+    std::cerr << path << ": " << errbuf << std::endl;
+    return false;
+  }
+  bool ok = true;
+  while (true) {
+    struct pcap_pkthdr* hdr;
+    const uint8_t* data;
+    int rc = pcap_next_ex(pcap, &hdr, &data);
+    if (rc == -2) {
+      break;
+    } else if (rc <= 0) {
+      std::cerr << path << ": " << pcap_geterr(pcap) << std::endl;
+      ok = false;
+      break;
+    }
+    auto buf = folly::IOBuf::wrapBufferAsValue(data, hdr->caplen);
+    // The original length, since captures may be cut short
+    uint64_t weight = FLAGS_bytes ? hdr->len : 1;
+    for (auto& sim : *sims) {
+      sim.addPacket(&buf, weight);
+    }
+  }
+  pcap_close(pcap);
+  return ok;
+}
+
+} // unnamed namespace
+
+/*
+ * Replay the packets of pcap files, such as captures of sFlow samples,
+ * through the model of the hardware hash, and print how evenly each seed
+ * spreads them over the members of a group.
+ */
+int main(int argc, char* argv[]) {
+  gflags::SetUsageMessage("hash_simulator [options] <pcap file>...");
+  folly::init(&argc, &argv, true);
+  if (argc < 2 || FLAGS_members <= 0) {
+    std::cerr << gflags::ProgramUsage() << std::endl;
+    return EX_USAGE;
+  }
+
+  std::vector<uint32_t> seeds;
+  std::vector<HashSimulator> sims;
+  try {
+    for (const auto& seed : splitFields(FLAGS_seeds)) {
+      seeds.push_back(folly::to<uint32_t>(seed));
+      sims.emplace_back(*makeLoadBalancer(seeds.back()), FLAGS_members);
+    }
+  } catch (const std::exception& ex) {
+    std::cerr << ex.what() << std::endl;
+    return EX_USAGE;
+  }
+
+  int ret = 0;
+  for (int i = 1; i < argc; ++i) {
+    if (!replayPcapFile(argv[i], &sims)) {
+      ret = EX_DATAERR;
+    }
+  }
+  if (sims.empty()) {
+    return ret;
+  }
+
+  std::cout << sims[0].getNumFlows() << " IP packets, "
+            << sims[0].getNumUnhashed() << " others" << std::endl;
+  for (size_t i = 0; i < sims.size(); ++i) {
+    std::cout << "seed " << seeds[i] << ": max imbalance "
+              << sims[i].getMaxImbalance() << ", loads "
+              << folly::join(" ", sims[i].getLoads()) << std::endl;
+  }
+  return ret;
+}
@@ -0,0 +1,60 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+#include "fboss/agent/RouteUpdateBinaryLog.h"
+
+#include <folly/FileUtil.h>
+#include <folly/init/Init.h>
+#include <gflags/gflags.h>
+
+#include <sysexits.h>
+
+#include <iostream>
+#include <string>
+
+using namespace facebook::fboss;
+
+DEFINE_string(identifier, "",
+              "Only print the route updates logged for this identifier");
+
+/*
+ * Print the records of the route update logs given, as written by the
+ * agent with --route_update_log_file, one per line.
+ */
+int main(int argc, char* argv[]) {
+  gflags::SetUsageMessage("route_update_log_decoder <log file>...");
+  folly::init(&argc, &argv, true);
+  if (argc < 2) {
+    std::cerr << gflags::ProgramUsage() << std::endl;
+    return EX_USAGE;
+  }
+
+  int ret = 0;
+  for (int i = 1; i < argc; ++i) {
+    std::string data;
+    if (!folly::readFile(argv[i], data)) {
+      std::cerr << "Failed to read " << argv[i] << std::endl;
+      ret = EX_NOINPUT;
+      continue;
+    }
+    bool truncated = false;
+    try {
+      for (const auto& record :
+           decodeRouteUpdateLog(folly::StringPiece(data), &truncated)) {
+        if (record.type == RouteLogRecordType::IDENTIFIER ||
+            (!FLAGS_identifier.empty() &&
+             record.type != RouteLogRecordType::DROPPED &&
+             record.identifier != FLAGS_identifier)) {
+          continue;
+        }
+        std::cout << record.str() << std::endl;
+      }
+    } catch (const std::exception& ex) {
+      std::cerr << argv[i] << ": " << ex.what() << std::endl;
+      ret = EX_DATAERR;
+      continue;
+    }
+    if (truncated) {
+      std::cerr << argv[i] << ": last record cut short" << std::endl;
+    }
+  }
+  return ret;
+}
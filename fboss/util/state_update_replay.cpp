@@ -0,0 +1,252 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+#include "fboss/agent/StateUpdateRecorder.h"
+#include "fboss/agent/SwSwitch.h"
+#include "fboss/agent/ThriftHandler.h"
+#include "fboss/agent/hw/mock/MockRxPacket.h"
+#include "fboss/agent/hw/sim/SimPlatform.h"
+#include "fboss/agent/hw/sim/SimSwitch.h"
+#include "fboss/agent/state/SwitchState.h"
+
+#include <folly/FileUtil.h>
+#include <folly/Format.h>
+#include <folly/MacAddress.h>
+#include <folly/experimental/TestUtil.h>
+#include <folly/init/Init.h>
+#include <folly/io/IOBuf.h>
+#include <gflags/gflags.h>
+
+#include <sysexits.h>
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+DECLARE_string(config);
+
+DEFINE_double(replay_speed, 0,
+              "How fast to replay the records: 1 keeps the time between "
+              "them as recorded, 2 halves it and so on, and 0 replays each "
+              "as soon as the last is done");
+DEFINE_int32(replay_num_ports, 64,
+             "The number of ports of the simulated switch");
+DEFINE_string(replay_mac, "02:00:00:00:00:01",
+              "The MAC address of the simulated switch");
+DEFINE_bool(replay_quiet, false,
+            "Only print the summary, not the latency of each record");
+
+using namespace facebook::fboss;
+using std::chrono::duration_cast;
+using std::chrono::microseconds;
+using std::chrono::steady_clock;
+
+namespace {
+
+/*
+ * Feeds the inputs recorded by StateUpdateRecorder to a SwSwitch on a
+ * SimPlatform, so that --sim_high_fidelity and the other SimSwitch flags
+ * apply.  Configs are applied through a file like the agent's own, and
+ * routes go through the platform's ThriftHandler.
+ */
+class Replayer {
+ public:
+  Replayer()
+      : sw_(std::make_unique<SwSwitch>(std::make_unique<SimPlatform>(
+            folly::MacAddress(FLAGS_replay_mac), FLAGS_replay_num_ports))) {
+    sw_->init(nullptr /* No custom TunManager */);
+    handler_ = sw_->getPlatform()->createHandler(sw_.get());
+    FLAGS_config = configFile_.path().string();
+  }
+
+  // Returns false for the records that are not inputs
+  bool replay(const StateUpdateRecord& record) {
+    switch (record.type) {
+      case StateUpdateRecordType::CONFIG:
+        replayConfig(record.name);
+        break;
+      case StateUpdateRecordType::ADD_ROUTES:
+        ensureFibSynced();
+        handler_->addUnicastRoutesInVrf(
+            record.client, static_cast<int32_t>(record.vrf),
+            std::make_unique<std::vector<UnicastRoute>>(record.routes));
+        break;
+      case StateUpdateRecordType::SYNC_FIB:
+        handler_->syncFibInVrf(
+            record.client, static_cast<int32_t>(record.vrf),
+            std::make_unique<std::vector<UnicastRoute>>(record.routes));
+        break;
+      case StateUpdateRecordType::DELETE_ROUTES:
+        ensureFibSynced();
+        handler_->deleteUnicastRoutesInVrf(
+            record.client, static_cast<int32_t>(record.vrf),
+            std::make_unique<std::vector<IpPrefix>>(record.prefixes));
+        break;
+      case StateUpdateRecordType::PACKET: {
+        auto pkt = std::make_unique<MockRxPacket>(
+            folly::IOBuf::copyBuffer(record.packet));
+        pkt->setSrcPort(record.port);
+        pkt->setSrcVlan(record.vlan);
+        static_cast<SimSwitch*>(sw_->getHw())->injectPacket(std::move(pkt));
+        break;
+      }
+      case StateUpdateRecordType::LINK_STATE:
+        sw_->linkStateChanged(record.port, record.up);
+        break;
+      case StateUpdateRecordType::STATE_UPDATE:
+      case StateUpdateRecordType::DROPPED:
+        return false;
+    }
+    // Route updates are applied before the thrift calls return, but
+    // packets and link changes only queue updates.  The route class is
+    // handled last, so once a no-op of it is through so is everything the
+    // record queued.
+    sw_->updateStateBlocking(
+        "replay barrier",
+        [](const std::shared_ptr<SwitchState>&) {
+          return std::shared_ptr<SwitchState>();
+        },
+        StateUpdateClass::ROUTE);
+    return true;
+  }
+
+ private:
+  void replayConfig(const std::string& config) {
+    if (!folly::writeFile(config, FLAGS_config.c_str())) {
+      throw std::runtime_error("failed to write " + FLAGS_config);
+    }
+    sw_->applyConfig("replayed config");
+    if (!sw_->isConfigured()) {
+      sw_->initialConfigApplied(steady_clock::now());
+    }
+  }
+
+  // Recording may have begun after the routing daemon's first sync
+  void ensureFibSynced() {
+    if (!sw_->isFibSynced()) {
+      sw_->fibSynced();
+    }
+  }
+
+  folly::test::TemporaryFile configFile_{"state_update_replay"};
+  std::unique_ptr<SwSwitch> sw_;
+  std::unique_ptr<ThriftHandler> handler_;
+};
+
+class LatencySummary {
+ public:
+  void add(const std::string& type, microseconds latency) {
+    latencies_[type].push_back(latency.count());
+  }
+
+  void print() {
+    std::cout << folly::sformat(
+        "{:<14} {:>8} {:>10} {:>10} {:>10}\n",
+        "record", "count", "p50 us", "p99 us", "max us");
+    for (auto& entry : latencies_) {
+      auto& values = entry.second;
+      std::sort(values.begin(), values.end());
+      std::cout << folly::sformat(
+          "{:<14} {:>8} {:>10} {:>10} {:>10}\n",
+          entry.first,
+          values.size(),
+          percentile(values, 50),
+          percentile(values, 99),
+          values.back());
+    }
+  }
+
+ private:
+  static int64_t percentile(const std::vector<int64_t>& sorted, int pct) {
+    auto idx = (sorted.size() - 1) * pct / 100;
+    return sorted[idx];
+  }
+
+  std::map<std::string, std::vector<int64_t>> latencies_;
+};
+
+} // unnamed namespace
+
+/*
+ * Replay the state update record files given, oldest first, as written by
+ * the agent with --state_update_record_file, and print how long the
+ * SwSwitch took to apply each record and a summary of those latencies.
+ */
+int main(int argc, char* argv[]) {
+  gflags::SetUsageMessage("state_update_replay <record file>...");
+  folly::init(&argc, &argv, true);
+  if (argc < 2) {
+    std::cerr << gflags::ProgramUsage() << std::endl;
+    return EX_USAGE;
+  }
+
+  std::vector<StateUpdateRecord> records;
+  for (int i = 1; i < argc; ++i) {
+    std::string data;
+    if (!folly::readFile(argv[i], data)) {
+      std::cerr << "Failed to read " << argv[i] << std::endl;
+      return EX_NOINPUT;
+    }
+    bool truncated = false;
+    try {
+      auto decoded =
+          decodeStateUpdateRecords(folly::StringPiece(data), &truncated);
+      records.insert(
+          records.end(),
+          std::make_move_iterator(decoded.begin()),
+          std::make_move_iterator(decoded.end()));
+    } catch (const std::exception& ex) {
+      std::cerr << argv[i] << ": " << ex.what() << std::endl;
+      return EX_DATAERR;
+    }
+    if (truncated) {
+      std::cerr << argv[i] << ": last record cut short" << std::endl;
+    }
+  }
+  if (records.empty()) {
+    return 0;
+  }
+
+  Replayer replayer;
+  LatencySummary summary;
+  int ret = 0;
+  auto firstUs = records.front().timestampUs;
+  auto start = steady_clock::now();
+  for (const auto& record : records) {
+    if (record.type == StateUpdateRecordType::DROPPED) {
+      std::cerr << "Recording dropped " << record.dropped
+                << " records here, the replay may differ" << std::endl;
+      continue;
+    }
+    if (FLAGS_replay_speed > 0 && record.timestampUs > firstUs) {
+      std::this_thread::sleep_until(
+          start +
+          microseconds(static_cast<int64_t>(
+              (record.timestampUs - firstUs) / FLAGS_replay_speed)));
+    }
+    auto begin = steady_clock::now();
+    bool replayed;
+    try {
+      replayed = replayer.replay(record);
+    } catch (const std::exception& ex) {
+      std::cerr << "Replaying " << record.str() << " failed: " << ex.what()
+                << std::endl;
+      ret = EX_SOFTWARE;
+      continue;
+    }
+    if (!replayed) {
+      continue;
+    }
+    auto latency = duration_cast<microseconds>(steady_clock::now() - begin);
+    summary.add(stateUpdateRecordTypeName(record.type), latency);
+    if (!FLAGS_replay_quiet) {
+      std::cout << folly::sformat(
+          "{} took {}us\n", record.str(), latency.count());
+    }
+  }
+  summary.print();
+  return ret;
+}
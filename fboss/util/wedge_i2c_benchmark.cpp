@@ -0,0 +1,393 @@
+// Copyright 2004-present Facebook. All Rights Reserved.
+#include "fboss/lib/usb/CP2112.h"
+#include "fboss/lib/usb/GalaxyI2CBus.h"
+#include "fboss/lib/usb/UsbError.h"
+#include "fboss/lib/usb/Wedge100I2CBus.h"
+#include "fboss/lib/usb/WedgeI2CBus.h"
+
+#include <folly/Conv.h>
+#include <folly/Optional.h>
+#include <folly/String.h>
+#include <folly/init/Init.h>
+#include <gflags/gflags.h>
+
+#include <sysexits.h>
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+using namespace facebook::fboss;
+using folly::ByteRange;
+using folly::MutableByteRange;
+using std::chrono::duration_cast;
+using std::chrono::microseconds;
+using std::chrono::milliseconds;
+using std::chrono::steady_clock;
+
+DEFINE_bool(simulate, false,
+            "Benchmark against a simulated CP2112 behind Wedge100 muxes, "
+            "rather than the hardware");
+DEFINE_int32(sim_transaction_us, 500,
+             "Simulated time each CP2112 transaction takes, whatever its "
+             "size (USB round trips and the I2C address phase)");
+DEFINE_int32(sim_byte_us, 90,
+             "Simulated time of each byte on the I2C bus (90us at 100kHz)");
+DEFINE_string(platform, "wedge100",
+              "Platform whose bus to benchmark without --simulate. "
+              "One of (galaxy, wedge100, wedge)");
+DEFINE_int32(module, 1, "The module to read from, as numbered by the bus");
+DEFINE_int32(other_module, 9,
+             "A module behind another mux than --module, to alternate with "
+             "when measuring mux selects");
+DEFINE_int32(num_modules, 32, "The number of modules on the bus");
+DEFINE_int32(iterations, 100, "How many of each transaction to time");
+DEFINE_int32(refresh_iterations, 3, "How many times to time each refresh");
+DEFINE_string(sizes, "1,8,32,128", "The transfer sizes to time reads of");
+DEFINE_string(replay, "",
+              "Replay the transactions in this file, one per line, as "
+              "'read <module> <address> <offset> <length>' or "
+              "'write <module> <address> <offset> <byte>...', instead of "
+              "running the benchmarks. Writes go to the modules as is.");
+DEFINE_string(record, "",
+              "Write every transaction we make to this file, in the format "
+              "of --replay");
+
+namespace {
+
+// Takes as long as a CP2112 would, and reads zeroes
+class SimulatedCP2112 : public CP2112Intf {
+ public:
+  void open(bool /* setSmbusConfig */) override {}
+  void close() override {}
+  void resetDevice() override {}
+  void read(uint8_t /* address */, MutableByteRange buf,
+            milliseconds /* timeout */) override {
+    transfer(buf.size());
+    std::fill(buf.begin(), buf.end(), 0);
+  }
+  void write(uint8_t /* address */, ByteRange buf,
+             milliseconds /* timeout */) override {
+    transfer(buf.size());
+  }
+  milliseconds getDefaultTimeout() const override {
+    return milliseconds(500);
+  }
+
+ private:
+  void transfer(size_t bytes) {
+    std::this_thread::sleep_for(microseconds(
+        FLAGS_sim_transaction_us + bytes * FLAGS_sim_byte_us));
+  }
+};
+
+struct Transaction {
+  bool write{false};
+  unsigned int module{0};
+  uint8_t address{TransceiverI2CApi::ADDR_QSFP};
+  int offset{0};
+  int length{0};
+  // What to write
+  std::vector<uint8_t> data;
+
+  std::string str() const {
+    auto line = folly::to<std::string>(
+        write ? "write " : "read ", module, " ", unsigned(address), " ",
+        offset);
+    if (write) {
+      for (auto byte : data) {
+        folly::toAppend(" ", unsigned(byte), &line);
+      }
+    } else {
+      folly::toAppend(" ", length, &line);
+    }
+    return line;
+  }
+};
+
+Transaction parseTransaction(const std::string& line) {
+  std::istringstream in(line);
+  std::string kind;
+  unsigned int address;
+  Transaction tx;
+  if (!(in >> kind >> tx.module >> address >> tx.offset) ||
+      (kind != "read" && kind != "write")) {
+    throw std::invalid_argument("bad transaction: " + line);
+  }
+  tx.address = address;
+  if (kind == "read") {
+    in >> tx.length;
+  } else {
+    tx.write = true;
+    unsigned int byte;
+    while (in >> byte) {
+      tx.data.push_back(byte);
+    }
+    tx.length = tx.data.size();
+  }
+  if (tx.length <= 0 || tx.length > 128) {
+    throw std::invalid_argument("bad transaction: " + line);
+  }
+  return tx;
+}
+
+std::vector<Transaction> readTrace(const std::string& path) {
+  std::ifstream in(path);
+  if (!in) {
+    throw std::runtime_error("cannot open " + path);
+  }
+  std::vector<Transaction> trace;
+  std::string line;
+  while (std::getline(in, line)) {
+    if (!line.empty() && line[0] != '#') {
+      trace.push_back(parseTransaction(line));
+    }
+  }
+  return trace;
+}
+
+/*
+ * What QsfpModule does on a full refresh of a module with paged memory:
+ * the presence check, the lower page, then pages 0 and 3.
+ */
+std::vector<Transaction> fullRefresh(unsigned int module) {
+  auto read = [module](int offset, int length) {
+    Transaction tx;
+    tx.module = module;
+    tx.offset = offset;
+    tx.length = length;
+    return tx;
+  };
+  auto selectPage = [module](uint8_t page) {
+    Transaction tx;
+    tx.write = true;
+    tx.module = module;
+    tx.offset = 127;
+    tx.length = 1;
+    tx.data = {page};
+    return tx;
+  };
+  return {read(0, 1), read(0, 128), selectPage(0), read(128, 128),
+          selectPage(3), read(128, 128)};
+}
+
+class Runner {
+ public:
+  explicit Runner(BaseWedgeI2CBus* bus) : bus_(bus) {
+    if (!FLAGS_record.empty()) {
+      record_.open(FLAGS_record);
+      if (!record_) {
+        throw std::runtime_error("cannot open " + FLAGS_record);
+      }
+    }
+  }
+
+  // Returns how long the transaction took, or nothing if it failed
+  folly::Optional<microseconds> run(const Transaction& tx) {
+    uint8_t buf[128];
+    if (record_.is_open()) {
+      record_ << tx.str() << "\n";
+    }
+    auto start = steady_clock::now();
+    try {
+      if (tx.write) {
+        bus_->moduleWrite(
+            tx.module, tx.address, tx.offset, tx.length, tx.data.data());
+      } else {
+        bus_->moduleRead(tx.module, tx.address, tx.offset, tx.length, buf);
+      }
+    } catch (const UsbError& ex) {
+      // Typically a module that isn't there
+      ++failures_;
+      return folly::none;
+    }
+    return duration_cast<microseconds>(steady_clock::now() - start);
+  }
+
+  BaseWedgeI2CBus* bus() const {
+    return bus_;
+  }
+  uint64_t failures() const {
+    return failures_;
+  }
+
+ private:
+  BaseWedgeI2CBus* bus_;
+  std::ofstream record_;
+  uint64_t failures_{0};
+};
+
+void printLatencies(const std::string& name, std::vector<microseconds> us) {
+  if (us.empty()) {
+    printf("%-24s no successful transactions\n", name.c_str());
+    return;
+  }
+  std::sort(us.begin(), us.end());
+  microseconds total(0);
+  for (auto latency : us) {
+    total += latency;
+  }
+  auto percentile = [&us](double p) {
+    return us[std::min(us.size() - 1, size_t(us.size() * p))].count();
+  };
+  printf("%-24s %8.1f tx/s  min %6ld  p50 %6ld  p90 %6ld  p99 %6ld  "
+         "max %6ld us\n",
+         name.c_str(), us.size() * 1e6 / total.count(), us.front().count(),
+         percentile(0.5), percentile(0.9), percentile(0.99),
+         us.back().count());
+}
+
+double mean(const std::vector<microseconds>& us) {
+  double total = 0;
+  for (auto latency : us) {
+    total += latency.count();
+  }
+  return us.empty() ? 0 : total / us.size();
+}
+
+std::vector<microseconds> timeReads(
+    Runner* runner, const std::vector<unsigned int>& modules, int length) {
+  std::vector<microseconds> latencies;
+  Transaction tx;
+  tx.length = length;
+  for (int i = 0; i < FLAGS_iterations; i++) {
+    tx.module = modules[i % modules.size()];
+    if (auto latency = runner->run(tx)) {
+      latencies.push_back(*latency);
+    }
+  }
+  return latencies;
+}
+
+void benchmarkSizes(Runner* runner) {
+  printf("Reads of module %d, by size:\n", FLAGS_module);
+  std::vector<folly::StringPiece> sizes;
+  folly::split(',', FLAGS_sizes, sizes);
+  for (auto size : sizes) {
+    printLatencies(
+        folly::to<std::string>(size, " bytes"),
+        timeReads(runner, {unsigned(FLAGS_module)}, folly::to<int>(size)));
+  }
+}
+
+void benchmarkMuxSelects(Runner* runner) {
+  printf("\nMux selects, with 1 byte reads:\n");
+  auto before = runner->bus()->getCounters();
+  auto same = timeReads(runner, {unsigned(FLAGS_module)}, 1);
+  auto alternating = timeReads(
+      runner, {unsigned(FLAGS_module), unsigned(FLAGS_other_module)}, 1);
+  auto after = runner->bus()->getCounters();
+  printLatencies("same module", same);
+  printLatencies("alternating modules", alternating);
+  printf("%-24s %8.1f us per select, %lu selects, %lu saved\n",
+         "overhead", mean(alternating) - mean(same),
+         after.muxSelects - before.muxSelects,
+         after.muxSelectsSaved - before.muxSelectsSaved);
+}
+
+void benchmarkRefresh(Runner* runner) {
+  printf("\nFull refresh, by number of modules:\n");
+  std::vector<int> counts;
+  for (int count = 1; count < FLAGS_num_modules; count *= 2) {
+    counts.push_back(count);
+  }
+  counts.push_back(FLAGS_num_modules);
+  for (auto count : counts) {
+    std::vector<Transaction> refresh;
+    for (int module = 1; module <= count; module++) {
+      auto txs = fullRefresh(module);
+      refresh.insert(refresh.end(), txs.begin(), txs.end());
+    }
+    microseconds total(0);
+    for (int i = 0; i < FLAGS_refresh_iterations; i++) {
+      auto start = steady_clock::now();
+      for (const auto& tx : refresh) {
+        runner->run(tx);
+      }
+      total += duration_cast<microseconds>(steady_clock::now() - start);
+    }
+    auto ms = total.count() / 1000.0 / FLAGS_refresh_iterations;
+    printf("%-24s %8.1f ms, %.1f ms per module\n",
+           folly::to<std::string>(count, " modules").c_str(), ms,
+           ms / count);
+  }
+}
+
+void replay(Runner* runner, const std::vector<Transaction>& trace) {
+  std::vector<microseconds> reads;
+  std::vector<microseconds> writes;
+  auto start = steady_clock::now();
+  for (const auto& tx : trace) {
+    if (auto latency = runner->run(tx)) {
+      (tx.write ? writes : reads).push_back(*latency);
+    }
+  }
+  auto total = duration_cast<milliseconds>(steady_clock::now() - start);
+  printf("Replayed %lu transactions in %ld ms\n", trace.size(),
+         total.count());
+  printLatencies("reads", reads);
+  printLatencies("writes", writes);
+}
+
+std::unique_ptr<BaseWedgeI2CBus> createBus() {
+  if (FLAGS_simulate) {
+    return std::make_unique<Wedge100I2CBus>(
+        std::make_unique<SimulatedCP2112>());
+  } else if (FLAGS_platform == "galaxy") {
+    return std::make_unique<GalaxyI2CBus>();
+  } else if (FLAGS_platform == "wedge100") {
+    return std::make_unique<Wedge100I2CBus>();
+  } else if (FLAGS_platform == "wedge") {
+    return std::make_unique<WedgeI2CBus>();
+  }
+  return nullptr;
+}
+
+} // unnamed namespace
+
+int main(int argc, char* argv[]) {
+  folly::init(&argc, &argv, true);
+
+  auto bus = createBus();
+  if (!bus) {
+    fprintf(stderr, "Unknown platform %s\n", FLAGS_platform.c_str());
+    return EX_USAGE;
+  }
+  std::vector<Transaction> trace;
+  try {
+    if (!FLAGS_replay.empty()) {
+      trace = readTrace(FLAGS_replay);
+    }
+  } catch (const std::exception& ex) {
+    fprintf(stderr, "error: %s\n", ex.what());
+    return EX_USAGE;
+  }
+
+  try {
+    bus->open();
+  } catch (const std::exception& ex) {
+    fprintf(stderr, "error: unable to open device: %s\n", ex.what());
+    return EX_IOERR;
+  }
+
+  try {
+    Runner runner(bus.get());
+    if (!FLAGS_replay.empty()) {
+      replay(&runner, trace);
+    } else {
+      benchmarkSizes(&runner);
+      benchmarkMuxSelects(&runner);
+      benchmarkRefresh(&runner);
+    }
+    if (runner.failures()) {
+      printf("\n%lu transactions failed\n", runner.failures());
+    }
+  } catch (const std::exception& ex) {
+    fprintf(stderr, "error: %s\n", ex.what());
+    return EX_SOFTWARE;
+  }
+  return EX_OK;
+}